@@ -70,6 +70,15 @@ switch (task) {
     }
     break;
 
+  case 'copy-whisper-python':
+    if (!fs.existsSync('dist/whisper')) fs.mkdirSync('dist/whisper', { recursive: true });
+    if (fs.existsSync('src/whisper')) {
+      fs.readdirSync('src/whisper').filter(f => f.endsWith('.py')).forEach(f => {
+        copyFile(path.join('src/whisper', f), path.join('dist/whisper', f));
+      });
+    }
+    break;
+
   case 'copy-ui':
     copyDir('dist/renderer/ui', 'dist/ui');
     break;
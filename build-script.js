@@ -30,6 +30,7 @@ execSync('npm run copy-components', { stdio: 'inherit' });
 execSync('npm run copy-utils', { stdio: 'inherit' });
 execSync('npm run copy-paddle-python', { stdio: 'inherit' });
 execSync('npm run copy-paddle', { stdio: 'inherit' });
+execSync('npm run copy-whisper-python', { stdio: 'inherit' });
 execSync('npm run copy-diagnostic', { stdio: 'inherit' });
 execSync('npm run copy-assets', { stdio: 'inherit' });
 
@@ -65,7 +66,9 @@ const platform = process.platform;
 if (platform === 'win32') {
   console.log('🔧 Building native WASAPI addon for Electron...');
   const electronVersion = require('./package.json').devDependencies.electron.replace('^', '');
-  const addonCommand = `cd native-wasapi-loopback && node-gyp rebuild --target=${electronVersion} --arch=x64 --dist-url=https://electronjs.org/headers --runtime=electron`;
+  // Native ARM64 on Windows on ARM; `npm run build:complete --arch=arm64` cross-builds from x64
+  const arch = process.env.npm_config_arch || (process.arch === 'arm64' ? 'arm64' : 'x64');
+  const addonCommand = `cd native-wasapi-loopback && node-gyp rebuild --target=${electronVersion} --arch=${arch} --dist-url=https://electronjs.org/headers --runtime=electron`;
   execSync(addonCommand, { stdio: 'inherit' });
 
   // Step 5: Copy native addon
@@ -104,6 +107,16 @@ if (platform === 'win32') {
   console.log(`ℹ️  Skipping native addon build (not supported on platform: ${platform})`);
 }
 
+// Step 5b: WebAssembly DSP module for the renderer (needs Emscripten)
+console.log('🔧 Building WebAssembly DSP module...');
+try {
+  execSync('npm run build:dsp-wasm', { stdio: 'inherit' });
+  execSync('npm run copy-dsp-wasm', { stdio: 'inherit' });
+  console.log('✅ Copied dsp_wasm.wasm to dist/assets/wasm/');
+} catch (error) {
+  console.warn('⚠️  WebAssembly DSP module not built (is emcmake on the PATH?); the renderer keeps its JS DSP');
+}
+
 // Step 6: Verify critical files exist
 console.log('✅ Verifying build artifacts...');
 const criticalFiles = [
@@ -156,7 +169,9 @@ for (const file of criticalFiles) {
 console.log('✅ Verifying Python files...');
 const pythonFiles = [
   'dist/paddle/ocr_service.py',
-  'dist/paddle/ocr_screen.py'
+  'dist/paddle/ocr_screen.py',
+  'dist/whisper/whispra_ring.py',
+  'dist/whisper/whisper_worker.py'
 ];
 
 for (const file of pythonFiles) {
@@ -0,0 +1,113 @@
+#pragma once
+
+// Per-environment addon state. Electron's main thread and every worker_thread
+// that loads an addon are separate Node environments, each with its own JS
+// thread; the addon keeps one AddonInstance per environment through
+// Napi::Env::SetInstanceData, so capture, VAD and chunking can run in a
+// worker without touching the main thread. Bindings reach their state with
+// PerEnv<T>(env): one T per environment, created on first use. What is truly
+// process-wide (the log ring, the whisper model, the OS session table,
+// processing parameters) stays a singleton behind its own lock.
+//
+// Slots are destroyed last-created first when the environment tears down.
+// Node runs env cleanup hooks last-added first and closes an environment's
+// thread-safe functions from hooks of its own, so a binding that creates one
+// calls ArmTeardown(env) afterwards: its slots, and any capture thread that
+// calls into the function, are then gone before the function is.
+
+#include <napi.h>
+
+#include <memory>
+#include <vector>
+
+class AddonInstance {
+public:
+	explicit AddonInstance(napi_env env) : env_(env) {}
+	AddonInstance(const AddonInstance&) = delete;
+	AddonInstance& operator=(const AddonInstance&) = delete;
+	~AddonInstance() { Teardown(); }
+
+	// JS thread.
+	template <typename T>
+	T& Slot() {
+		const void* key = &SlotKey<T>::id;
+		for (const Entry& entry : slots_) {
+			if (entry.key == key) return *static_cast<T*>(entry.value.get());
+		}
+		slots_.push_back(Entry{ key, Holder(new T(), [](void* value) { delete static_cast<T*>(value); }) });
+		return *static_cast<T*>(slots_.back().value.get());
+	}
+
+	// Moves the teardown hook behind every cleanup hook registered so far.
+	void Arm() {
+		if (armed_) napi_remove_env_cleanup_hook(env_, OnCleanup, this);
+		armed_ = napi_add_env_cleanup_hook(env_, OnCleanup, this) == napi_ok;
+	}
+
+private:
+	using Holder = std::unique_ptr<void, void (*)(void*)>;
+	struct Entry {
+		const void* key;
+		Holder value;
+	};
+	template <typename T>
+	struct SlotKey { static const char id; };
+
+	static void OnCleanup(void* arg) {
+		AddonInstance* self = static_cast<AddonInstance*>(arg);
+		self->armed_ = false;
+		self->Teardown();
+	}
+
+	void Teardown() {
+		if (armed_) napi_remove_env_cleanup_hook(env_, OnCleanup, this);
+		armed_ = false;
+		// A slot's destructor may reach for another slot; those go in later rounds
+		while (!slots_.empty()) {
+			std::vector<Entry> slots;
+			slots.swap(slots_);
+			while (!slots.empty()) slots.pop_back();
+		}
+	}
+
+	const napi_env env_;
+	std::vector<Entry> slots_;
+	bool armed_ = false;
+};
+
+template <typename T>
+const char AddonInstance::SlotKey<T>::id = 0;
+
+// Each addon's Init calls this first, so every environment has its instance
+// before any binding runs.
+inline AddonInstance& Instance(Napi::Env env) {
+	AddonInstance* instance = env.GetInstanceData<AddonInstance>();
+	if (!instance) {
+		instance = new AddonInstance(env);
+		env.SetInstanceData(instance);
+	}
+	return *instance;
+}
+
+template <typename T>
+inline T& PerEnv(Napi::Env env) {
+	return Instance(env).Slot<T>();
+}
+
+inline void ArmTeardown(Napi::Env env) {
+	Instance(env).Arm();
+}
+
+// Process-wide registries that hold thread-safe functions of several
+// environments drop an environment's with Detach(env) when it tears down.
+template <void (*Detach)(napi_env)>
+struct EnvTeardown {
+	napi_env env = nullptr;
+	~EnvTeardown() { if (env) Detach(env); }
+};
+
+template <void (*Detach)(napi_env)>
+inline void DetachAtTeardown(Napi::Env env) {
+	PerEnv<EnvTeardown<Detach>>(env).env = env;
+	ArmTeardown(env);
+}
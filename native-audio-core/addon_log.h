@@ -0,0 +1,167 @@
+#pragma once
+
+// Native log ring. AddonLog() formats into a preallocated cell of a bounded
+// lock-free MPMC queue, so capture and IO threads never touch stdio; messages
+// are collected on demand (getLogs), echoed to stdout by a low-priority
+// thread or delivered by the event bus (event_bus.h). The level defaults to
+// Silent, where AddonLog() is a single load.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "thread_cpu.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+enum class LogLevel { Silent, Error, Warn, Info, Debug };
+
+inline const char* LogLevelName(LogLevel level) {
+	switch (level) {
+	case LogLevel::Error: return "error";
+	case LogLevel::Warn: return "warn";
+	case LogLevel::Info: return "info";
+	case LogLevel::Debug: return "debug";
+	default: return "silent";
+	}
+}
+
+struct LogRecord {
+	LogLevel level = LogLevel::Info;
+	double timeMs = 0; // ms since the Unix epoch
+	char text[240];
+};
+
+class LogRing {
+public:
+	static constexpr size_t kCapacity = 512;
+
+	LogRing() {
+		for (size_t i = 0; i < kCapacity; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	~LogRing() { SetEcho(false); }
+
+	void SetLevel(LogLevel level) { level_.store((int)level, std::memory_order_relaxed); }
+	LogLevel Level() const { return (LogLevel)level_.load(std::memory_order_relaxed); }
+	bool Enabled(LogLevel level) const {
+		return level != LogLevel::Silent && (int)level <= level_.load(std::memory_order_relaxed);
+	}
+
+	// Any thread. Drops the message (and counts it) when the ring is full.
+	void Write(LogLevel level, const char* fmt, va_list args) {
+		uint64_t pos = enqueue_.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;) {
+			cell = &cells_[pos & (kCapacity - 1)];
+			const uint64_t seq = cell->seq.load(std::memory_order_acquire);
+			const int64_t dif = (int64_t)seq - (int64_t)pos;
+			if (dif == 0) {
+				if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			} else if (dif < 0) {
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			} else {
+				pos = enqueue_.load(std::memory_order_relaxed);
+			}
+		}
+		cell->record.level = level;
+		cell->record.timeMs = (double)std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		vsnprintf(cell->record.text, sizeof(cell->record.text), fmt, args);
+		cell->seq.store(pos + 1, std::memory_order_release);
+		if (void (*notify)() = notify_.load(std::memory_order_acquire)) notify();
+	}
+
+	// Called from Write() after every queued message while set (the event bus
+	// waking its drain); null to stop.
+	void SetNotify(void (*notify)()) { notify_.store(notify, std::memory_order_release); }
+
+	// Consumer side (JS thread or the echo thread). Calls sink(const LogRecord&)
+	// for every queued message in order; returns the number of messages dropped
+	// since the previous drain.
+	template <typename Sink>
+	uint64_t Drain(Sink&& sink) {
+		std::lock_guard<std::mutex> lock(drainMutex_);
+		for (;;) {
+			Cell* cell = &cells_[dequeue_ & (kCapacity - 1)];
+			if (cell->seq.load(std::memory_order_acquire) != dequeue_ + 1) break;
+			sink(cell->record);
+			cell->seq.store(dequeue_ + kCapacity, std::memory_order_release);
+			++dequeue_;
+		}
+		return dropped_.exchange(0, std::memory_order_relaxed);
+	}
+
+	// Starts or stops the background thread that prints queued messages.
+	void SetEcho(bool enabled) {
+		std::unique_lock<std::mutex> lock(echoMutex_);
+		if (enabled == echoRunning_) return;
+		echoRunning_ = enabled;
+		if (enabled) {
+			echoThread_ = std::thread([this]() { EchoLoop(); });
+			return;
+		}
+		lock.unlock();
+		echoWake_.notify_all();
+		if (echoThread_.joinable()) echoThread_.join();
+	}
+
+private:
+	struct Cell {
+		std::atomic<uint64_t> seq;
+		LogRecord record;
+	};
+
+	void EchoLoop() {
+		ThreadCpuScope cpu("log-echo");
+#if defined(_WIN32)
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#endif
+		std::unique_lock<std::mutex> lock(echoMutex_);
+		while (echoRunning_) {
+			lock.unlock();
+			uint64_t dropped = Drain([](const LogRecord& r) { printf("[addon] %s\n", r.text); });
+			if (dropped) printf("[addon] (%llu log messages dropped)\n", (unsigned long long)dropped);
+			fflush(stdout);
+			lock.lock();
+			echoWake_.wait_for(lock, std::chrono::milliseconds(50));
+		}
+	}
+
+	Cell cells_[kCapacity];
+	alignas(64) std::atomic<uint64_t> enqueue_{0};
+	alignas(64) std::atomic<int> level_{(int)LogLevel::Silent};
+	std::atomic<uint64_t> dropped_{0};
+	std::atomic<void (*)()> notify_{nullptr};
+	std::mutex drainMutex_;
+	uint64_t dequeue_ = 0;
+	std::mutex echoMutex_;
+	std::condition_variable echoWake_;
+	std::thread echoThread_;
+	bool echoRunning_ = false;
+};
+
+inline LogRing& AddonLogRing() {
+	static LogRing ring;
+	return ring;
+}
+
+#if defined(__GNUC__)
+__attribute__((format(printf, 2, 3)))
+#endif
+inline void AddonLog(LogLevel level, const char* fmt, ...) {
+	LogRing& ring = AddonLogRing();
+	if (!ring.Enabled(level)) return;
+	va_list args;
+	va_start(args, fmt);
+	ring.Write(level, fmt, args);
+	va_end(args);
+}
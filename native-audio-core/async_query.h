@@ -0,0 +1,157 @@
+#pragma once
+
+// Promise-returning wrapper for blocking queries (process snapshots, session
+// enumeration) so they run on the addon's task pool (task_pool.h) instead of
+// the Electron main thread. work() runs on the pool at the given priority and
+// returns plain C++ data; toJs() converts it on the JS thread in one pass. A
+// JS exception left pending by toJs() rejects the promise instead of
+// resolving it.
+//
+// Finished queries come back through one thread-safe function per
+// environment, referenced only while some are outstanding. Queries still out
+// when their environment tears down are never settled; what they hold is
+// leaked rather than released into a dead environment.
+
+#include <napi.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "addon_instance.h"
+#include "platform_trace.h"
+#include "task_pool.h"
+
+class PendingQuery {
+public:
+	virtual ~PendingQuery() = default;
+	virtual void Run() = 0;                // pool thread
+	virtual void Settle(Napi::Env env) = 0; // JS thread
+};
+
+class QueryCompletions;
+inline void SettleQueries(Napi::Env env, Napi::Function, QueryCompletions* completions, void*);
+using QueryTsfn = Napi::TypedThreadSafeFunction<QueryCompletions, void, SettleQueries>;
+
+class QueryCompletions {
+public:
+	// JS thread: one more query out.
+	void Begin(Napi::Env env) {
+		if (!hasTsfn_) {
+			tsfn_ = QueryTsfn::New(env, "QueryCompletions", 0, 1, this);
+			tsfn_.Unref(env);
+			hasTsfn_ = true;
+			ArmTeardown(env);
+		}
+		if (outstanding_++ == 0) tsfn_.Ref(env);
+	}
+
+	// Pool thread.
+	void Post(PendingQuery* query) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (closed_) return; // leaked, see above
+		done_.push_back(query);
+		if (done_.size() == 1) tsfn_.NonBlockingCall();
+	}
+
+	// JS thread.
+	void Settle(Napi::Env env) {
+		std::vector<PendingQuery*> done;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			done.swap(done_);
+		}
+		for (PendingQuery* query : done) {
+			Napi::HandleScope scope(env);
+			query->Settle(env);
+			delete query;
+		}
+		outstanding_ -= done.size();
+		if (!done.empty() && outstanding_ == 0) tsfn_.Unref(env);
+	}
+
+	// Environment teardown.
+	void Close() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		closed_ = true;
+		done_.clear(); // leaked, see above
+		if (hasTsfn_) tsfn_.Release();
+		hasTsfn_ = false;
+	}
+
+private:
+	QueryTsfn tsfn_;
+	bool hasTsfn_ = false;    // JS thread
+	size_t outstanding_ = 0;  // JS thread
+	std::mutex mutex_;        // the two below
+	bool closed_ = false;
+	std::vector<PendingQuery*> done_;
+};
+
+inline void SettleQueries(Napi::Env env, Napi::Function, QueryCompletions* completions, void*) {
+	if (env) completions->Settle(env);
+}
+
+// The per-environment slot; the completions outlive it while queries are out.
+struct QueryCompletionsSlot {
+	std::shared_ptr<QueryCompletions> completions = std::make_shared<QueryCompletions>();
+	~QueryCompletionsSlot() { completions->Close(); }
+};
+
+template <class Work, class ToJs>
+class QueryWorker : public PendingQuery {
+public:
+	typedef decltype(std::declval<Work&>()()) Result;
+
+	QueryWorker(Napi::Env env, const char* name, Work work, ToJs toJs)
+		: name_(name),
+		  deferred_(Napi::Promise::Deferred::New(env)),
+		  work_(std::move(work)),
+		  toJs_(std::move(toJs)) {}
+
+	Napi::Promise Promise() const { return deferred_.Promise(); }
+
+	void Run() override {
+		TraceInterval trace(TraceStage::Work, 0, name_);
+		result_ = work_();
+	}
+
+	void Settle(Napi::Env env) override {
+		Napi::Value value = toJs_(env, result_);
+		if (env.IsExceptionPending()) deferred_.Reject(env.GetAndClearPendingException().Value());
+		else deferred_.Resolve(value);
+	}
+
+private:
+	const char* name_; // a literal
+	Napi::Promise::Deferred deferred_;
+	Work work_;
+	ToJs toJs_;
+	Result result_{};
+};
+
+// As QueueQuery, with submit(task) running the work instead of the pool:
+// for work bound to a thread of its own (the WASAPI control thread).
+template <class Submit, class Work, class ToJs>
+Napi::Promise QueueQueryVia(Napi::Env env, const char* name, Submit submit, Work work, ToJs toJs) {
+	auto* query = new QueryWorker<Work, ToJs>(env, name, std::move(work), std::move(toJs));
+	Napi::Promise promise = query->Promise();
+	std::shared_ptr<QueryCompletions> completions = PerEnv<QueryCompletionsSlot>(env).completions;
+	completions->Begin(env);
+	submit(std::function<void()>([completions, query] {
+		query->Run();
+		completions->Post(query);
+	}));
+	return promise;
+}
+
+// Queues work on the task pool; the query is deleted after settling.
+template <class Work, class ToJs>
+Napi::Promise QueueQuery(Napi::Env env, const char* name, Work work, ToJs toJs,
+                         TaskPriority priority = TaskPriority::Normal) {
+	return QueueQueryVia(env, name,
+		[priority](std::function<void()> task) { AddonTaskPool().Submit(priority, std::move(task)); },
+		std::move(work), std::move(toJs));
+}
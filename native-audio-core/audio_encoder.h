@@ -0,0 +1,238 @@
+#pragma once
+
+// Whole-clip encoding for uploads and exports (AudioFormatConverter), as
+// background work on the task pool (task_pool.h) so several conversions run
+// at once and none on the main thread:
+//
+//   encodeAudio(samples: Float32Array, { sampleRate, channels?, format, bitrate?, level?, complexity?,
+//                                        uploadBudgetMs? }) -> Promise<Buffer>
+//
+// samples are interleaved floats (channels 1 or 2, default 1), copied on the
+// call. format picks the container:
+//   'wav'  - 16-bit PCM
+//   'flac' - flac_chunk_encoder.h at level 0..2 (mono)
+//   'opus' - Ogg-Opus, opus_chunk_encoder.h (mono; other rates go to 48 kHz
+//            first); uploadBudgetMs picks the bitrate (upload_rate.h); needs
+//            use_opus=1
+//   'mp3'  - CBR at bitrate through libavcodec's MP3 encoder (LAME in the
+//            vendored FFmpeg) at an MPEG rate; needs use_avcodec=1
+// A format that is not built in rejects, and callers keep their WAV.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "async_query.h"
+#include "capture_options.h"
+#include "flac_chunk_encoder.h"
+#include "opus_chunk_encoder.h"
+#include "pcm_quantize.h"
+#include "resampler.h"
+
+#if defined(AUDIO_CORE_AVCODEC)
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+}
+#endif
+
+enum class EncodeFormat { Wav, Flac, Opus, Mp3 };
+
+struct AudioEncodeConfig {
+	EncodeFormat format = EncodeFormat::Wav;
+	uint32_t sampleRate = 0;
+	uint32_t channels = 1;
+	uint32_t bitrate = 0; // 0: the format's default
+	FlacChunkConfig flac;
+	OpusChunkConfig opus;
+};
+
+inline void EncodeWavFile(const float* pcm, size_t samples, uint32_t rate, uint32_t channels, std::vector<uint8_t>* out) {
+	out->resize(44 + samples * sizeof(int16_t));
+	WriteWavHeader(out->data(), rate, (uint16_t)channels, (uint32_t)(samples * sizeof(int16_t)));
+	QuantizeToInt16(pcm, samples, 1.0f, reinterpret_cast<int16_t*>(out->data() + 44));
+}
+
+#if defined(AUDIO_CORE_AVCODEC)
+
+// CBR MP3 of interleaved float PCM; the encoder takes planar float or int16.
+inline bool EncodeMp3File(const float* pcm, size_t samples, uint32_t rate, uint32_t channels, uint32_t bitrate,
+                          std::vector<uint8_t>* out, std::string* error) {
+	const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_MP3);
+	if (!codec) {
+		*error = "This FFmpeg build has no MP3 encoder";
+		return false;
+	}
+	AVCodecContext* ctx = avcodec_alloc_context3(codec);
+	AVFrame* frame = av_frame_alloc();
+	AVPacket* packet = av_packet_alloc();
+	bool ok = ctx && frame && packet;
+	if (ok) {
+		ctx->bit_rate = bitrate;
+		ctx->sample_rate = (int)rate;
+		av_channel_layout_default(&ctx->ch_layout, (int)channels);
+		ctx->sample_fmt = AV_SAMPLE_FMT_S16P;
+		for (const AVSampleFormat* f = codec->sample_fmts; f && *f != AV_SAMPLE_FMT_NONE; ++f) {
+			if (*f == AV_SAMPLE_FMT_FLTP) ctx->sample_fmt = AV_SAMPLE_FMT_FLTP;
+		}
+		ok = avcodec_open2(ctx, codec, nullptr) == 0;
+		if (!ok) *error = "MP3 encoder rejected " + std::to_string(rate) + " Hz";
+	}
+	if (ok) {
+		frame->nb_samples = ctx->frame_size;
+		frame->format = ctx->sample_fmt;
+		frame->sample_rate = ctx->sample_rate;
+		ok = av_channel_layout_copy(&frame->ch_layout, &ctx->ch_layout) == 0 && av_frame_get_buffer(frame, 0) == 0;
+		if (!ok) *error = "Out of memory for MP3 frames";
+	}
+	out->clear();
+	auto drain = [&]() {
+		while (avcodec_receive_packet(ctx, packet) == 0) {
+			out->insert(out->end(), packet->data, packet->data + packet->size);
+			av_packet_unref(packet);
+		}
+	};
+	const size_t frames = samples / channels;
+	for (size_t at = 0; ok && at < frames; at += (size_t)ctx->frame_size) {
+		const size_t n = std::min(frames - at, (size_t)ctx->frame_size);
+		ok = av_frame_make_writable(frame) == 0;
+		frame->nb_samples = (int)n;
+		for (uint32_t c = 0; ok && c < channels; ++c) {
+			const float* src = pcm + at * channels + c;
+			if (ctx->sample_fmt == AV_SAMPLE_FMT_FLTP) {
+				float* dst = reinterpret_cast<float*>(frame->data[c]);
+				for (size_t i = 0; i < n; ++i) dst[i] = src[i * channels];
+			} else {
+				int16_t* dst = reinterpret_cast<int16_t*>(frame->data[c]);
+				for (size_t i = 0; i < n; ++i) QuantizeToInt16(src + i * channels, 1, 1.0f, dst + i);
+			}
+		}
+		ok = ok && avcodec_send_frame(ctx, frame) == 0;
+		if (ok) drain();
+		else *error = "MP3 encoding failed";
+	}
+	if (ok && avcodec_send_frame(ctx, nullptr) == 0) drain();
+	av_packet_free(&packet);
+	av_frame_free(&frame);
+	avcodec_free_context(&ctx);
+	return ok;
+}
+
+#endif
+
+// Threadpool side of encodeAudio().
+inline bool EncodeAudioFile(const std::vector<float>& pcm, const AudioEncodeConfig& config, std::vector<uint8_t>* out,
+                            std::string* error) {
+	switch (config.format) {
+	case EncodeFormat::Wav:
+		EncodeWavFile(pcm.data(), pcm.size(), config.sampleRate, config.channels, out);
+		return true;
+	case EncodeFormat::Flac: {
+		std::vector<int16_t> pcm16(pcm.size());
+		QuantizeToInt16(pcm.data(), pcm.size(), 1.0f, pcm16.data());
+		EncodeFlacFile(pcm16.data(), pcm16.size(), config.sampleRate, config.flac, out);
+		return true;
+	}
+	case EncodeFormat::Opus: {
+#if defined(AUDIO_CORE_OPUS)
+		const uint32_t rate = config.sampleRate;
+		const bool native = rate == 8000 || rate == 12000 || rate == 16000 || rate == 24000 || rate == 48000;
+		std::vector<float> resampled;
+		const float* in = pcm.data();
+		size_t n = pcm.size();
+		if (!native) {
+			PolyphaseResampler resampler;
+			resampler.Configure(rate, 48000, ResamplerQuality::Medium, 4096);
+			resampled.resize(resampler.MaxOutput(n));
+			n = resampler.Process(in, n, resampled.data());
+			in = resampled.data();
+		}
+		std::vector<int16_t> pcm16(n);
+		QuantizeToInt16(in, n, 1.0f, pcm16.data());
+		OpusChunkConfig opus = config.opus;
+		if (config.bitrate) opus.bitrate = config.bitrate;
+		return EncodeOggOpus(pcm16.data(), n, native ? rate : 48000, opus, out, error);
+#else
+		*error = "Opus encoding is not built in (use_opus=0)";
+		return false;
+#endif
+	}
+	case EncodeFormat::Mp3:
+#if defined(AUDIO_CORE_AVCODEC)
+		return EncodeMp3File(pcm.data(), pcm.size(), config.sampleRate, config.channels, config.bitrate ? config.bitrate : 64000,
+		                     out, error);
+#else
+		*error = "MP3 encoding is not built in (use_avcodec=0)";
+		return false;
+#endif
+	}
+	return false;
+}
+
+// encodeAudio(samples: Float32Array, { sampleRate, channels?, format, bitrate?, level?, complexity?, uploadBudgetMs? })
+//   -> Promise<Buffer>
+inline Napi::Value EncodeAudio(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsTypedArray() || info[0].As<Napi::TypedArray>().TypedArrayType() != napi_float32_array ||
+	    !info[1].IsObject()) {
+		Napi::TypeError::New(env, "Float32Array and options required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Object obj = info[1].As<Napi::Object>();
+	AudioEncodeConfig config;
+	int format = -1;
+	uint32_t budgetMs = 0;
+	std::string error;
+	if (!ReadEnumOption(obj, "format", { "wav", "flac", "opus", "mp3" }, &format, &error) ||
+	    !ReadUint32Option(obj, "sampleRate", 8000, 192000, &config.sampleRate, &error) ||
+	    !ReadUint32Option(obj, "channels", 1, 2, &config.channels, &error) ||
+	    !ReadUint32Option(obj, "bitrate", 6000, 320000, &config.bitrate, &error) ||
+	    !ReadUint32Option(obj, "level", 0, 2, &config.flac.level, &error) ||
+	    !ReadUint32Option(obj, "complexity", 0, 10, &config.opus.complexity, &error) ||
+	    !ReadUploadBudget(obj, &budgetMs, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (format < 0 || config.sampleRate == 0) {
+		Napi::TypeError::New(env, "Options 'format' and 'sampleRate' required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	config.format = (EncodeFormat)format;
+	if ((config.format == EncodeFormat::Flac || config.format == EncodeFormat::Opus) && config.channels != 1) {
+		Napi::TypeError::New(env, "FLAC and Opus encoding take mono samples").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (config.format == EncodeFormat::Opus && config.bitrate > 128000) {
+		Napi::TypeError::New(env, "Option 'bitrate' is out of range").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (budgetMs && config.format != EncodeFormat::Opus) {
+		Napi::TypeError::New(env, "Option 'uploadBudgetMs' needs format 'opus'").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	// Copied so JS may go on using the array
+	Napi::Float32Array samples = info[0].As<Napi::Float32Array>();
+	std::vector<float> pcm(samples.Data(), samples.Data() + samples.ElementLength() / config.channels * config.channels);
+	if (budgetMs) PickUploadRate(env, obj, (double)pcm.size() * 1000.0 / config.sampleRate, budgetMs, &config.opus);
+
+	struct Encoded {
+		std::vector<uint8_t> bytes;
+		std::string error;
+	};
+	return QueueQuery(env, "EncodeAudio",
+		[pcm = std::move(pcm), config]() {
+			Encoded result;
+			if (!EncodeAudioFile(pcm, config, &result.bytes, &result.error) && result.error.empty()) result.error = "Encoding failed";
+			return result;
+		},
+		[picked = budgetMs != 0, opus = config.opus](Napi::Env env, Encoded& result) -> Napi::Value {
+			if (!result.error.empty()) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			return OpusUploadToJs(env, result.bytes, picked, opus);
+		}, TaskPriority::Background);
+}
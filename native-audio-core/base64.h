@@ -0,0 +1,106 @@
+#pragma once
+
+// Base64 (RFC 4648, '+' '/', '=' padded) for the text packet formats
+// (pcm_channel.h), which hand JS realtime-API payloads it forwards as they
+// are instead of running Buffer.toString('base64') per packet on the main
+// thread. 24 input bytes become 32 characters per AVX2 step, 48 become 64
+// per NEON step on arm64 (vld3/vqtbl4/vst4); the tail, and CPUs without
+// either, take the scalar table. All paths give identical output.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.h"
+
+constexpr size_t Base64Length(size_t bytes) { return (bytes + 2) / 3 * 4; }
+
+inline const char* Base64Alphabet() { return "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"; }
+
+// Whole 3-byte groups from src, then the padded remainder. Returns the
+// characters written (Base64Length(n)).
+inline size_t Base64EncodeScalar(const uint8_t* src, size_t n, char* dst) {
+	const char* alphabet = Base64Alphabet();
+	char* out = dst;
+	size_t i = 0;
+	for (; i + 3 <= n; i += 3) {
+		const uint32_t v = ((uint32_t)src[i] << 16) | ((uint32_t)src[i + 1] << 8) | src[i + 2];
+		out[0] = alphabet[v >> 18];
+		out[1] = alphabet[(v >> 12) & 63];
+		out[2] = alphabet[(v >> 6) & 63];
+		out[3] = alphabet[v & 63];
+		out += 4;
+	}
+	if (i < n) {
+		const uint32_t v = ((uint32_t)src[i] << 16) | (i + 1 < n ? (uint32_t)src[i + 1] << 8 : 0);
+		out[0] = alphabet[v >> 18];
+		out[1] = alphabet[(v >> 12) & 63];
+		out[2] = i + 1 < n ? alphabet[(v >> 6) & 63] : '=';
+		out[3] = '=';
+		out += 4;
+	}
+	return (size_t)(out - dst);
+}
+
+#if defined(AUDIO_CORE_AVX2)
+// Muła's method: each 128-bit lane takes 12 bytes, spreads every 3-byte
+// group over a 32-bit word, pulls out the four 6-bit indices with two
+// multiplies and maps them to characters through a 16-entry offset table.
+// Returns the input bytes consumed, a multiple of 24; reads 4 bytes past them.
+AUDIO_CORE_TARGET_AVX2 inline size_t Base64EncodeAvx2(const uint8_t* src, size_t n, char* dst) {
+	const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+	                                        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const __m256i offsets = _mm256_setr_epi8(
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	size_t i = 0;
+	for (; i + 28 <= n; i += 24) {
+		const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 12));
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		in = _mm256_shuffle_epi8(in, spread);
+		// Bits aaaaaabb bbbbcccc ccdddddd of each group to bytes 00aaaaaa 00bbbbbb 00cccccc 00dddddd
+		const __m256i ac = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+		const __m256i bd = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+		const __m256i indices = _mm256_or_si256(ac, bd);
+		// 0..25 -> 13, 26..51 -> 0, 52..63 -> 1..12: the offset table's slot
+		__m256i slot = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+		slot = _mm256_or_si256(slot, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices), _mm256_set1_epi8(13)));
+		const __m256i chars = _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, slot));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i / 3 * 4), chars);
+	}
+	return i;
+}
+#endif
+
+#if defined(AUDIO_CORE_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+// Returns the input bytes consumed, a multiple of 48.
+inline size_t Base64EncodeNeon(const uint8_t* src, size_t n, char* dst) {
+	const uint8_t* alphabet = reinterpret_cast<const uint8_t*>(Base64Alphabet());
+	const uint8x16x4_t table = { { vld1q_u8(alphabet), vld1q_u8(alphabet + 16), vld1q_u8(alphabet + 32), vld1q_u8(alphabet + 48) } };
+	const uint8x16_t mask = vdupq_n_u8(63);
+	size_t i = 0;
+	for (; i + 48 <= n; i += 48) {
+		const uint8x16x3_t in = vld3q_u8(src + i);
+		uint8x16x4_t out;
+		out.val[0] = vshrq_n_u8(in.val[0], 2);
+		out.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[1], 4), vshlq_n_u8(in.val[0], 4)), mask);
+		out.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[2], 6), vshlq_n_u8(in.val[1], 2)), mask);
+		out.val[3] = vandq_u8(in.val[2], mask);
+		for (int k = 0; k < 4; ++k) out.val[k] = vqtbl4q_u8(table, out.val[k]);
+		vst4q_u8(reinterpret_cast<uint8_t*>(dst) + i / 3 * 4, out);
+	}
+	return i;
+}
+#endif
+
+// Encodes n bytes of src to dst, which holds Base64Length(n) characters; no
+// terminator. Returns the characters written.
+inline size_t Base64Encode(const uint8_t* src, size_t n, char* dst) {
+	size_t done = 0;
+#if defined(AUDIO_CORE_AVX2)
+	if (CpuUses(CpuIsa::Avx2)) done = Base64EncodeAvx2(src, n, dst);
+#elif defined(AUDIO_CORE_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+	if (CpuUses(CpuIsa::Neon)) done = Base64EncodeNeon(src, n, dst);
+#endif
+	return done / 3 * 4 + Base64EncodeScalar(src + done, n - done, dst + done / 3 * 4);
+}
@@ -0,0 +1,312 @@
+#pragma once
+
+// Batch transcription of media files: an hour-long recording or video
+// transcribed as fast as the cores allow instead of at the speed it plays.
+//
+//   transcribeMedia(file, { capture?, language?, translate?, prompt?, threads?, model?, concurrency? })
+//     -> Promise<{ text, language, segments: [{ startMs, endMs, text }], pieces, failed, audioMs,
+//                  decodeMs, transcribeMs, wallMs, error? }>
+//
+// One pass decodes the file (file_replay_source.h: libavformat and
+// libavcodec), downmixes and resamples it to 16 kHz and runs it through the
+// voice chain, VAD and utterance chunker a capture would, with capture
+// options as for evaluateDsp() configurations (dsp_eval.h); the chunker
+// defaults to pieces of up to kBatchMaxPieceMs cut at pauses, with no
+// overlap, so every piece is independent. The chain stays in that one pass:
+// its state runs through the whole file, and it costs microseconds a sample
+// next to the seconds a piece takes to transcribe.
+//
+// Each piece goes to the task pool (task_pool.h) as soon as it is cut, at
+// normal priority, and is transcribed there by the local Whisper engine on
+// stream 'batch:<file>'. Up to `concurrency` pieces are out at once (default:
+// the model's lanes plus one, so a lane never waits for the next piece); the
+// decode pass waits while that many are, which also bounds the memory an
+// hour of audio takes. Concurrency past one needs a model loaded with lanes
+// > 1. The pieces are stitched in order at the end: texts joined, segment
+// times moved to the file's clock (through a piece's time map when
+// chunker.compact shortened it). A piece that fails is counted in failed and
+// its error kept; the promise rejects only when every piece failed.
+// Needs use_avformat=1 and use_whisper=1.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "async_query.h"
+#include "capture_options.h"
+#include "downmix.h"
+#include "dsp_blocks.h"
+#include "file_replay_source.h"
+#include "pcm_quantize.h"
+#include "resampler.h"
+#include "task_pool.h"
+#include "utterance_chunker.h"
+#include "vad.h"
+#include "whisper_engine.h"
+
+constexpr uint32_t kBatchRate = 16000;
+constexpr uint32_t kBatchMaxPieceMs = 28000; // inside Whisper's 30 s window
+
+struct BatchTranscribeConfig {
+	CaptureOptions capture;
+	WhisperJobConfig job;
+	std::string model;
+	uint32_t concurrency = 0; // 0: the model's lanes plus one
+};
+
+struct BatchTranscribeResult {
+	std::string text;
+	std::string language;
+	std::vector<WhisperSegment> segments;
+	uint32_t pieces = 0;
+	uint32_t failed = 0;
+	uint64_t samples = 0; // 16 kHz, the replay tail included
+	double decodeMs = 0;     // the decode, DSP and chunking pass, waits for the pool included
+	double transcribeMs = 0; // Whisper's processing, summed over the pieces
+	double wallMs = 0;
+	std::string error; // the first failure
+};
+
+// One piece of the file on its way through the pool.
+struct BatchPiece {
+	uint64_t start = 0; // first sample's index in the 16 kHz stream
+	std::vector<int16_t> pcm;
+	std::vector<uint32_t> timeMap; // chunker.compact (utterance_chunker.h)
+	WhisperResult result;
+};
+
+// The pieces of one run and the pool tasks still transcribing them.
+class BatchRun {
+public:
+	BatchRun(const BatchTranscribeConfig& config, const std::string& stream, uint32_t limit)
+		: config_(config), stream_(stream), limit_(limit) {}
+
+	// Decode pass: hands a piece to the pool, once fewer than the limit are out.
+	void Submit(std::unique_ptr<BatchPiece> piece, const std::shared_ptr<BatchRun>& self) {
+		BatchPiece* p = piece.get();
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			idle_.wait(lock, [&] { return out_ < limit_; });
+			++out_;
+			pieces_.push_back(std::move(piece));
+		}
+		AddonTaskPool().Submit(TaskPriority::Normal, [self, p] { self->Transcribe(p); });
+	}
+
+	// Decode pass, at the end: every piece transcribed, in order.
+	const std::vector<std::unique_ptr<BatchPiece>>& Finish() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		idle_.wait(lock, [&] { return out_ == 0; });
+		return pieces_;
+	}
+
+private:
+	void Transcribe(BatchPiece* piece) {
+		std::vector<float> pcm(piece->pcm.size());
+		for (size_t i = 0; i < pcm.size(); ++i) pcm[i] = (float)piece->pcm[i] / 32768.0f;
+		piece->pcm = std::vector<int16_t>(); // the float copy is all Whisper needs
+		piece->result = RunWhisperJob(pcm, nullptr, config_.job, stream_, config_.model, WhisperDraftConfig(),
+		                              std::chrono::steady_clock::time_point::max());
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			--out_;
+		}
+		idle_.notify_all();
+	}
+
+	const BatchTranscribeConfig config_;
+	const std::string stream_;
+	const uint32_t limit_;
+	std::mutex mutex_; // the two below
+	std::condition_variable idle_;
+	uint32_t out_ = 0;
+	std::vector<std::unique_ptr<BatchPiece>> pieces_;
+};
+
+// Piece time ms as ms since the piece's first sample in the file.
+inline double BatchSourceMs(const std::vector<uint32_t>& timeMap, double ms) {
+	double shift = 0.0;
+	for (size_t i = 0; i + 1 < timeMap.size() && timeMap[i] * 1000.0 / kBatchRate <= ms; i += 2) {
+		shift = ((double)timeMap[i + 1] - (double)timeMap[i]) * 1000.0 / kBatchRate;
+	}
+	return ms + shift;
+}
+
+// The pieces' transcripts as one, in file order.
+inline void StitchBatch(const std::vector<std::unique_ptr<BatchPiece>>& pieces, BatchTranscribeResult* result) {
+	std::map<std::string, uint32_t> languages;
+	for (const std::unique_ptr<BatchPiece>& piece : pieces) {
+		const WhisperResult& r = piece->result;
+		++result->pieces;
+		if (!r.error.empty()) {
+			++result->failed;
+			if (result->error.empty()) result->error = r.error;
+			continue;
+		}
+		result->transcribeMs += r.processingMs;
+		const double offsetMs = piece->start * 1000.0 / kBatchRate;
+		for (const WhisperSegment& s : r.segments) {
+			WhisperSegment out = s;
+			out.startMs = offsetMs + BatchSourceMs(piece->timeMap, s.startMs);
+			out.endMs = offsetMs + BatchSourceMs(piece->timeMap, s.endMs);
+			result->segments.push_back(std::move(out));
+		}
+		const size_t first = r.text.find_first_not_of(" \t\n");
+		if (first == std::string::npos) continue;
+		if (!result->text.empty()) result->text.push_back(' ');
+		result->text += r.text.substr(first, r.text.find_last_not_of(" \t\n") - first + 1);
+		if (!r.language.empty()) ++languages[r.language];
+	}
+	uint32_t most = 0;
+	for (const auto& l : languages) {
+		if (l.second > most) {
+			most = l.second;
+			result->language = l.first;
+		}
+	}
+}
+
+// Threadpool side of transcribeMedia(): the decode pass, cutting pieces and
+// handing them to the pool as it goes, then the stitch.
+inline BatchTranscribeResult RunBatchTranscribe(const std::string& file, const BatchTranscribeConfig& config) {
+	const auto started = std::chrono::steady_clock::now();
+	BatchTranscribeResult result;
+	FileReplaySource source;
+	if (!source.Open(file, &result.error)) return result;
+	const CaptureOptions& o = config.capture;
+	const size_t blockFrames = source.BlockFrames();
+	const DownmixPlan downmix = MakeDownmixPlan(PcmSampleType::Float32, source.Channels(), source.ChannelMask());
+	PolyphaseResampler resampler;
+	resampler.Configure(source.SampleRate(), kBatchRate, o.resampler, blockFrames);
+	VoiceChain chain;
+	chain.Configure((float)kBatchRate, o.loudness, o.denoise, o.filterGraph);
+	const size_t frameSamples = (size_t)kBatchRate * o.frameMs / 1000;
+	VoiceActivityDetector vad;
+	vad.Configure((float)kBatchRate, frameSamples, o.vad);
+	UtteranceChunker chunker;
+	chunker.Configure(o.chunker, frameSamples, o.frameMs);
+
+	const uint32_t lanes = Whisper(config.model)->Stats().lanes;
+	auto run = std::make_shared<BatchRun>(config, "batch:" + file, config.concurrency ? config.concurrency : std::max(1u, lanes) + 1);
+	std::vector<float> block(blockFrames * source.Channels());
+	std::vector<float> mono(blockFrames);
+	std::vector<float> out(resampler.MaxOutput(blockFrames));
+	const uint64_t tailSamples = (uint64_t)kBatchRate * kReplayTailMs / 1000;
+	uint64_t tail = 0, at = 0;
+	uint32_t speech = 0, frame = 0;
+	while (tail < tailSamples) {
+		const size_t n = source.Read(block.data());
+		size_t m;
+		if (n > 0) {
+			downmix.Run(block.data(), n, mono.data());
+			m = resampler.Process(mono.data(), n, out.data());
+		} else {
+			// Silence closes the last piece
+			m = std::min<uint64_t>(kBatchRate / 100, tailSamples - tail);
+			std::fill(out.begin(), out.begin() + m, 0.0f);
+			tail += m;
+		}
+		const float gain = chain.Process(out.data(), m);
+		const float* x = out.data();
+		for (size_t left = m; left > 0;) {
+			const size_t take = std::min(left, chunker.FrameRoom());
+			vad.Process(x, take, gain, &speech, &frame);
+			QuantizeToInt16(x, take, gain, chunker.Extend(take));
+			at += take;
+			if (frame > 0) {
+				if (chunker.EndFrame((speech & 1) != 0, o.chunker.minChunkMs, (speech & 1) != 0 && vad.Voiced())) {
+					auto piece = std::make_unique<BatchPiece>();
+					// A cut at a dip leaves its last frames open for the next piece
+					const uint64_t end = at - (uint64_t)chunker.KeepFrames() * frameSamples - chunker.TrimTailSamples();
+					piece->start = end - chunker.ChunkSamples() - chunker.CompactedSamples();
+					piece->pcm.resize(chunker.ChunkSamples());
+					chunker.TakeChunk(piece->pcm.data(), &piece->timeMap);
+					run->Submit(std::move(piece), run);
+				}
+				speech = frame = 0;
+			}
+			x += take;
+			left -= take;
+		}
+		result.samples += m;
+	}
+	result.decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+	StitchBatch(run->Finish(), &result);
+	result.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+	return result;
+}
+
+// transcribeMedia(file, options?) -> Promise<result>
+inline Napi::Value TranscribeMedia(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Media file path required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+#if !defined(AUDIO_CORE_AVFORMAT)
+	Napi::Error::New(env, "transcribeMedia needs an addon built with use_avformat=1").ThrowAsJavaScriptException();
+	return env.Null();
+#endif
+	const std::string file = info[0].As<Napi::String>().Utf8Value();
+	Napi::Object obj = info.Length() > 1 && info[1].IsObject() ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+	BatchTranscribeConfig config;
+	CaptureOptions& o = config.capture;
+	o.vad = VadMode::Quality;
+	o.frameMs = 20;
+	o.chunker.enabled = true;
+	o.chunker.maxChunkMs = kBatchMaxPieceMs;
+	o.chunker.pauseMs = 400;
+	o.chunker.overlapMs = 0;
+	o.chunker.trimMs = 150;
+	std::string error;
+	WhisperDraftConfig draft; // drafts are for live latency; batch runs the one model
+	uint32_t maxStaleMs = 0;
+	if (!ParseCaptureOptions(obj.Get("capture"), &o, &error) ||
+	    !ReadWhisperJobOptions(obj, &config.job, &config.model, &draft, &maxStaleMs, &error) ||
+	    !ReadUint32Option(obj, "concurrency", 1, 16, &config.concurrency, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (o.vad == VadMode::Off || (o.frameMs != 10 && o.frameMs != 20 && o.frameMs != 30) || o.chunker.maxChunkMs > 30000) {
+		Napi::TypeError::New(env, "Option 'capture' needs 'vad', a frameMs of 10, 20 or 30 and chunks of at most 30 s").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	o.chunker.stream.enabled = false;
+
+	return QueueQuery(env, "TranscribeMedia",
+		[file, config]() { return RunBatchTranscribe(file, config); },
+		[](Napi::Env env, BatchTranscribeResult& r) -> Napi::Value {
+			if (r.pieces == 0 ? !r.error.empty() : r.failed == r.pieces) {
+				Napi::Error::New(env, r.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object out = Napi::Object::New(env);
+			out.Set("text", Napi::String::New(env, r.text));
+			out.Set("language", Napi::String::New(env, r.language));
+			Napi::Array segments = Napi::Array::New(env, r.segments.size());
+			for (size_t i = 0; i < r.segments.size(); ++i) {
+				Napi::Object s = Napi::Object::New(env);
+				s.Set("startMs", Napi::Number::New(env, r.segments[i].startMs));
+				s.Set("endMs", Napi::Number::New(env, r.segments[i].endMs));
+				s.Set("text", Napi::String::New(env, r.segments[i].text));
+				segments.Set((uint32_t)i, s);
+			}
+			out.Set("segments", segments);
+			out.Set("pieces", Napi::Number::New(env, r.pieces));
+			out.Set("failed", Napi::Number::New(env, r.failed));
+			out.Set("audioMs", Napi::Number::New(env, (double)r.samples * 1000.0 / kBatchRate));
+			out.Set("decodeMs", Napi::Number::New(env, r.decodeMs));
+			out.Set("transcribeMs", Napi::Number::New(env, r.transcribeMs));
+			out.Set("wallMs", Napi::Number::New(env, r.wallMs));
+			if (!r.error.empty()) out.Set("error", Napi::String::New(env, r.error));
+			return out;
+		}, TaskPriority::Background);
+}
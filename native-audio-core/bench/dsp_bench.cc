@@ -0,0 +1,564 @@
+// Per-kernel and whole-chain timings for the capture DSP, reported as ns per
+// input sample so formats with different rates and channel counts compare
+// directly. Input is a deterministic voice-like signal in 10 ms packets, the
+// size WASAPI and CoreAudio deliver most often.
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "base64.h"
+#include "content_classifier.h"
+#include "downmix.h"
+#include "dsp_blocks.h"
+#include "fuzzy_text_index.h"
+#include "keyword_spotter.h"
+#include "language_id.h"
+#include "log_mel.h"
+#include "ocr_preprocess.h"
+#include "pcm_quantize.h"
+#include "planar_frame.h"
+#include "rate_tree.h"
+#include "resampler.h"
+#include "speaker_change.h"
+#include "text_regions.h"
+#include "tile_hash.h"
+
+namespace {
+
+constexpr uint32_t kOutRate = 16000;
+constexpr size_t kOutPacket = kOutRate / 100;
+
+struct BenchFormat {
+	const char* name;
+	PcmSampleType type;
+	uint16_t channels;
+	uint32_t rate;
+	uint32_t mask;
+};
+
+const BenchFormat kFormats[] = {
+	{ "48k_f32_stereo", PcmSampleType::Float32, 2, 48000, 0x3 },
+	{ "44k1_s16_stereo", PcmSampleType::Int16, 2, 44100, 0x3 },
+	{ "96k_f32_7.1", PcmSampleType::Float32, 8, 96000, 0x63f },
+};
+
+// Two partials with a slow envelope plus a little noise; every channel is a
+// phase-shifted copy so downmix weights all matter.
+float TestSample(size_t frame, uint32_t rate, uint16_t channel) {
+	const float t = (float)frame / (float)rate;
+	const float env = 0.5f + 0.5f * sinf(6.2831853f * 3.0f * t);
+	const float phase = 0.3f * channel;
+	const float noise = (float)((frame * 1103515245u + 12345u + channel) & 0xffff) / 65536.0f - 0.5f;
+	return 0.4f * env * (sinf(6.2831853f * 220.0f * t + phase) + 0.5f * sinf(6.2831853f * 1870.0f * t + phase)) +
+	       0.01f * noise;
+}
+
+// One 10 ms packet of interleaved input in the format's sample type.
+std::vector<uint8_t> MakePacket(const BenchFormat& format) {
+	const size_t frames = format.rate / 100;
+	const size_t count = frames * format.channels;
+	std::vector<uint8_t> bytes(count * (format.type == PcmSampleType::Int16 ? sizeof(int16_t) : sizeof(float)));
+	for (size_t f = 0; f < frames; ++f) {
+		for (uint16_t c = 0; c < format.channels; ++c) {
+			const float s = TestSample(f, format.rate, c);
+			if (format.type == PcmSampleType::Int16) {
+				reinterpret_cast<int16_t*>(bytes.data())[f * format.channels + c] = (int16_t)(s * 32767.0f);
+			} else {
+				reinterpret_cast<float*>(bytes.data())[f * format.channels + c] = s;
+			}
+		}
+	}
+	return bytes;
+}
+
+std::vector<float> MakeVoice(size_t n) {
+	std::vector<float> x(n);
+	for (size_t i = 0; i < n; ++i) x[i] = TestSample(i, kOutRate, 0);
+	return x;
+}
+
+void SetPerSample(benchmark::State& state, size_t samplesPerIteration) {
+	state.counters["ns/sample"] = benchmark::Counter((double)samplesPerIteration,
+		benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+	state.SetItemsProcessed((int64_t)state.iterations() * (int64_t)samplesPerIteration);
+}
+
+void BM_Downmix(benchmark::State& state, BenchFormat format) {
+	const std::vector<uint8_t> packet = MakePacket(format);
+	const size_t frames = format.rate / 100;
+	const DownmixPlan plan = MakeDownmixPlan(format.type, format.channels, format.mask);
+	std::vector<float> mono(frames);
+	for (auto _ : state) {
+		plan.Run(packet.data(), frames, mono.data());
+		benchmark::DoNotOptimize(mono.data());
+		benchmark::ClobberMemory();
+	}
+	SetPerSample(state, frames * format.channels);
+	state.SetLabel(plan.kernelName);
+}
+
+void BM_Deinterleave(benchmark::State& state, BenchFormat format) {
+	const std::vector<uint8_t> packet = MakePacket(format);
+	const size_t frames = format.rate / 100;
+	PlanarIngest ingest;
+	ingest.Configure(format.type, format.channels);
+	PlanarFrame planar;
+	planar.Configure(format.channels, format.rate, frames);
+	for (auto _ : state) {
+		ingest.Run(packet.data(), frames, 0, &planar);
+		benchmark::DoNotOptimize(planar.Channel(0));
+		benchmark::ClobberMemory();
+	}
+	SetPerSample(state, frames * format.channels);
+	state.SetLabel(ingest.KernelName());
+}
+
+void BM_Resample(benchmark::State& state, BenchFormat format) {
+	const size_t frames = format.rate / 100;
+	std::vector<float> mono(frames);
+	for (size_t i = 0; i < frames; ++i) mono[i] = TestSample(i, format.rate, 0);
+	PolyphaseResampler resampler;
+	resampler.Configure(format.rate, kOutRate, ResamplerQuality::Medium, frames);
+	std::vector<float> out(resampler.MaxOutput(frames));
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(resampler.Process(mono.data(), frames, out.data()));
+		benchmark::ClobberMemory();
+	}
+	SetPerSample(state, frames);
+}
+
+// The 16 kHz stages below run in place, so each iteration starts from a
+// fresh copy; the copy is a few hundred bytes and shows up in every result
+// equally.
+void BM_HighPass(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(kOutPacket);
+	std::vector<float> x(kOutPacket);
+	BlockBiquad highPass;
+	highPass.Setup(MakeProcessingBlock(ProcessingParams(), kProcessingRate).highPass);
+	for (auto _ : state) {
+		x = voice;
+		highPass.Process(x.data(), x.size());
+		benchmark::DoNotOptimize(x.data());
+	}
+	SetPerSample(state, kOutPacket);
+}
+
+void BM_NoiseGate(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(kOutPacket);
+	std::vector<float> x(kOutPacket);
+	NoiseGate gate;
+	gate.Configure(kProcessingRate);
+	for (auto _ : state) {
+		x = voice;
+		benchmark::DoNotOptimize(gate.Process(x.data(), x.size()));
+	}
+	SetPerSample(state, kOutPacket);
+}
+
+void BM_BoostPeak(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(kOutPacket);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(VoiceBoostGainForPeak(PeakMagnitude(voice.data(), voice.size())));
+	}
+	SetPerSample(state, kOutPacket);
+}
+
+void BM_Quantize(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(kOutPacket);
+	std::vector<int16_t> pcm(kOutPacket);
+	for (auto _ : state) {
+		QuantizeToInt16(voice.data(), voice.size(), 1.5f, pcm.data());
+		benchmark::DoNotOptimize(pcm.data());
+		benchmark::ClobberMemory();
+	}
+	SetPerSample(state, kOutPacket);
+}
+
+void BM_WavPack(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(kOutPacket);
+	std::vector<uint8_t> wav(44 + kOutPacket * sizeof(int16_t));
+	for (auto _ : state) {
+		WriteWavHeader(wav.data(), kOutRate, 1, (uint32_t)(kOutPacket * sizeof(int16_t)));
+		QuantizeToInt16(voice.data(), voice.size(), 1.0f, reinterpret_cast<int16_t*>(wav.data() + 44));
+		benchmark::DoNotOptimize(wav.data());
+		benchmark::ClobberMemory();
+	}
+	SetPerSample(state, kOutPacket);
+}
+
+void BM_VoiceChain(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(kOutPacket);
+	std::vector<float> x(kOutPacket);
+	VoiceChain chain;
+	chain.Configure(kProcessingRate);
+	for (auto _ : state) {
+		x = voice;
+		benchmark::DoNotOptimize(chain.Process(x.data(), x.size()));
+	}
+	SetPerSample(state, kOutPacket);
+}
+
+// Change detection on a typical watch-box grab: an 800x200 BGRA region whose
+// tiles all get hashed (no dirty-rect hints). Reported per byte, not sample.
+void BM_TileHash(benchmark::State& state) {
+	const uint32_t width = 800, height = 200;
+	std::vector<uint8_t> frame((size_t)width * height * 4);
+	for (size_t i = 0; i < frame.size(); ++i) frame[i] = (uint8_t)(i * 2654435761u >> 24);
+	TileHasher hasher;
+	hasher.Configure(32);
+	for (auto _ : state) {
+		hasher.Reset();
+		benchmark::DoNotOptimize(hasher.Update(frame.data(), width, height, (size_t)width * 4, 4, nullptr));
+	}
+	state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)frame.size());
+}
+
+// A watch-box band: 800x96 BGRA, upscaled 2x to gray with a contrast stretch.
+void BM_OcrPreprocess(benchmark::State& state) {
+	const uint32_t width = 800, height = 96;
+	std::vector<uint8_t> frame((size_t)width * height * 4);
+	for (size_t i = 0; i < frame.size(); ++i) frame[i] = (uint8_t)(i * 2654435761u >> 24);
+	OcrPreprocessor preprocessor;
+	OcrPreprocessConfig config;
+	config.scale = 2.0f;
+	config.contrast = OcrContrast::Stretch;
+	OcrImage image;
+	std::string error;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(preprocessor.Process(frame.data(), width, height, (size_t)width * 4, true, config, &image, &error));
+	}
+	state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)frame.size());
+}
+
+// Text proposals on a 1280x720 gray watch box: noise, with a band of glyphs.
+void BM_TextRegions(benchmark::State& state) {
+	const uint32_t width = 1280, height = 720;
+	std::vector<uint8_t> frame((size_t)width * height);
+	for (size_t i = 0; i < frame.size(); ++i) frame[i] = (uint8_t)(i * 2654435761u >> 24);
+	for (uint32_t y = 600; y < 612; ++y) {
+		for (uint32_t x = 0; x < width; ++x) frame[(size_t)y * width + x] = (x % 9 < 2 || y == 600) ? 20 : 220;
+	}
+	TextRegionFinder finder;
+	TextRegionConfig config;
+	std::vector<TileRect> regions;
+	for (auto _ : state) {
+		finder.Find(frame.data(), width, height, width, config, &regions);
+		benchmark::DoNotOptimize(regions.data());
+	}
+	state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)frame.size());
+}
+
+// One keyword inference of a DS-CNN S sized model (98 x 10 MFCCs, 10x4
+// stride 2x2 convolution, four 64-channel blocks, 12 labels) with random
+// weights; the spotter runs one every 40 ms while speech is around.
+void BM_KeywordSpotter(benchmark::State& state) {
+	auto model = std::make_shared<KeywordModel>();
+	KeywordModel& m = *model;
+	m.frames = 98, m.coeffs = 10, m.kernelT = 10, m.kernelF = 4, m.strideT = 2, m.strideF = 2;
+	m.channels = 64, m.blocks = 4, m.labels = 12;
+	m.names.assign(m.labels, "word");
+	uint32_t seed = 1;
+	auto fill = [&](std::vector<float>* v, size_t n) {
+		v->resize(n);
+		for (float& w : *v) w = (float)((seed = seed * 1664525u + 1013904223u) >> 8) / 16777216.0f * 0.2f - 0.1f;
+	};
+	fill(&m.convWeights, (size_t)m.channels * m.kernelT * m.kernelF);
+	fill(&m.convBias, m.channels);
+	m.block.resize(m.blocks);
+	for (KeywordModel::Block& b : m.block) {
+		fill(&b.depthwise, (size_t)m.channels * 9);
+		fill(&b.depthwiseBias, m.channels);
+		fill(&b.pointwise, (size_t)m.channels * m.channels);
+		fill(&b.pointwiseBias, m.channels);
+	}
+	fill(&m.fcWeights, (size_t)m.labels * m.channels);
+	fill(&m.fcBias, m.labels);
+	KeywordSpotterConfig config;
+	config.enabled = true;
+	config.model = model;
+	KeywordSpotter spotter;
+	spotter.Configure(kOutRate, config);
+	const std::vector<float> voice = MakeVoice(kOutRate);
+	std::vector<int16_t> pcm(voice.size());
+	QuantizeToInt16(voice.data(), voice.size(), 1.0f, pcm.data());
+	LogMelFrontEnd mel;
+	mel.Configure(m.frames);
+	mel.Push(pcm.data(), pcm.size()); // a full window of features
+	KeywordHit hit;
+	for (uint64_t k = mel.FirstFrame(); k < mel.NextFrame(); ++k) spotter.PushFrame(mel.Frame(k), &hit);
+	for (auto _ : state) {
+		spotter.Infer();
+		benchmark::DoNotOptimize(spotter.Posteriors()[0]);
+	}
+}
+
+// The shared log-mel front end over one second of voice: 100 frames of 80
+// bands, what every capture with the keyword spotter or Whisper features runs.
+void BM_LogMel(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(kOutRate);
+	std::vector<int16_t> pcm(voice.size());
+	QuantizeToInt16(voice.data(), voice.size(), 1.0f, pcm.data());
+	LogMelFrontEnd mel;
+	mel.Configure(128);
+	for (auto _ : state) {
+		mel.Reset(0);
+		mel.Push(pcm.data(), pcm.size());
+		benchmark::DoNotOptimize(mel.Frame(mel.NextFrame() - 1)[0]);
+	}
+	SetPerSample(state, pcm.size());
+}
+
+// The content classifier over one second of log-mel frames: ten decisions,
+// on top of BM_LogMel's front end.
+void BM_ContentClassifier(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(kOutRate);
+	std::vector<int16_t> pcm(voice.size());
+	QuantizeToInt16(voice.data(), voice.size(), 1.0f, pcm.data());
+	LogMelFrontEnd mel;
+	mel.Configure(128);
+	mel.Push(pcm.data(), pcm.size());
+	ContentClassifierConfig config;
+	config.enabled = true;
+	ContentClassifier classifier;
+	classifier.Configure(kOutRate, config, 32);
+	uint64_t frame = 0;
+	for (auto _ : state) {
+		for (uint64_t k = mel.FirstFrame(); k < mel.NextFrame(); ++k) classifier.PushFrame(frame++, mel.Frame(k));
+		benchmark::DoNotOptimize(classifier.Features()[0]);
+	}
+	SetPerSample(state, pcm.size());
+}
+
+// The language identifier over an utterance's first second of log-mel frames
+// and its decision, with a 64-unit hidden layer over 32 languages of random
+// weights (the cost does not depend on them).
+void BM_LanguageId(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(kOutRate);
+	std::vector<int16_t> pcm(voice.size());
+	QuantizeToInt16(voice.data(), voice.size(), 1.0f, pcm.data());
+	LogMelFrontEnd mel;
+	mel.Configure(128);
+	mel.Push(pcm.data(), pcm.size());
+	auto model = std::make_shared<LanguageIdModel>();
+	model->languages.assign(32, "xx");
+	model->net.hidden = 64;
+	model->net.outputs = 32;
+	model->net.mean.assign(kPooledMelFeatures, 0.0f);
+	model->net.scale.assign(kPooledMelFeatures, 1.0f);
+	uint32_t seed = 1;
+	auto weights = [&seed](size_t n) {
+		std::vector<float> w(n);
+		for (float& x : w) x = (float)((seed = seed * 1664525u + 1013904223u) >> 8) / 16777216.0f - 0.5f;
+		return w;
+	};
+	model->net.hiddenWeights = weights(64 * kPooledMelFeatures);
+	model->net.hiddenBias = weights(64);
+	model->net.outputWeights = weights(32 * 64);
+	model->net.outputBias = weights(32);
+	LanguageIdConfig config;
+	config.enabled = true;
+	config.model = model;
+	LanguageIdentifier lid;
+	lid.Configure(kOutRate, config);
+	for (auto _ : state) {
+		lid.Begin(mel.FirstFrame());
+		for (uint64_t k = mel.FirstFrame(); k < mel.NextFrame(); ++k) lid.PushFrame(k, mel.Frame(k));
+		lid.Finish();
+		benchmark::DoNotOptimize(lid.Confidence());
+	}
+	SetPerSample(state, pcm.size());
+}
+
+// The speaker-change detector over one second of speech frames with the
+// built-in embedding: two window comparisons.
+void BM_SpeakerChange(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(kOutRate);
+	std::vector<int16_t> pcm(voice.size());
+	QuantizeToInt16(voice.data(), voice.size(), 1.0f, pcm.data());
+	LogMelFrontEnd mel;
+	mel.Configure(128);
+	mel.Push(pcm.data(), pcm.size());
+	SpeakerChangeConfig config;
+	config.enabled = true;
+	SpeakerChangeDetector detector;
+	detector.Configure(kOutRate, config);
+	uint64_t frame = 0;
+	for (auto _ : state) {
+		for (uint64_t k = mel.FirstFrame(); k < mel.NextFrame(); ++k) detector.PushFrame(frame++, mel.Frame(k), true);
+		benchmark::DoNotOptimize(detector.Distance());
+	}
+	SetPerSample(state, pcm.size());
+}
+
+// A 40 ms realtime-append packet: 960 samples at 24 kHz to base64.
+void BM_Base64(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(960);
+	std::vector<int16_t> pcm(voice.size());
+	QuantizeToInt16(voice.data(), voice.size(), 1.0f, pcm.data());
+	std::vector<char> text(Base64Length(pcm.size() * sizeof(int16_t)));
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(Base64Encode(reinterpret_cast<const uint8_t*>(pcm.data()), pcm.size() * sizeof(int16_t), text.data()));
+		benchmark::ClobberMemory();
+	}
+	SetPerSample(state, pcm.size());
+}
+
+// A translation-cache miss: one fuzzy lookup among 1000 caption-length
+// texts, half the queries a few edits from a cached text. Time per
+// iteration is per lookup.
+void BM_FuzzyTextIndex(benchmark::State& state) {
+	uint32_t seed = 12345;
+	auto next = [&seed](uint32_t n) {
+		seed = seed * 1103515245u + 12345u;
+		return (seed >> 16) % n;
+	};
+	FuzzyTextIndex index;
+	std::vector<std::u16string> texts;
+	for (uint32_t id = 0; id < 1000; ++id) {
+		std::u16string text;
+		for (uint32_t word = 0, words = 6 + next(10); word < words; ++word) {
+			for (uint32_t c = 0, letters = 2 + next(7); c < letters; ++c) text += (char16_t)('a' + next(26));
+			text += u' ';
+		}
+		index.Add(id, text, "de");
+		texts.push_back(std::move(text));
+	}
+	std::vector<std::u16string> queries;
+	for (size_t i = 0; i < 64; ++i) {
+		std::u16string q = texts[next(1000)];
+		if (i % 2) {
+			for (uint32_t e = 0; e < 3; ++e) q[next((uint32_t)q.size())] = (char16_t)('a' + next(26));
+		} else {
+			for (char16_t& c : q) c = c == u' ' ? c : (char16_t)('a' + next(26));
+		}
+		queries.push_back(std::move(q));
+	}
+	size_t i = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(index.Find(queries[i++ % queries.size()], 0.8, "de", 16));
+	}
+}
+
+// The subscriber fanout's resampling for 8, 24 and 48 kHz subscribers off
+// the processed 16 kHz stream: a polyphase resampler per rate (what the
+// fanout ran before the rate tree), against the tree sharing its stages.
+const uint32_t kFanoutRates[] = { 8000, 24000, 48000 };
+
+void BM_FanoutResamplers(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(kOutPacket);
+	std::vector<PolyphaseResampler> resamplers(3);
+	std::vector<std::vector<float>> outs(3);
+	for (size_t i = 0; i < 3; ++i) {
+		resamplers[i].Configure((uint32_t)kProcessingRate, kFanoutRates[i], ResamplerQuality::Medium, kOutPacket);
+		outs[i].resize(resamplers[i].MaxOutput(kOutPacket));
+	}
+	for (auto _ : state) {
+		for (size_t i = 0; i < 3; ++i) benchmark::DoNotOptimize(resamplers[i].Process(voice.data(), kOutPacket, outs[i].data()));
+		benchmark::ClobberMemory();
+	}
+	SetPerSample(state, kOutPacket);
+}
+
+void BM_FanoutRateTree(benchmark::State& state) {
+	const std::vector<float> voice = MakeVoice(kOutPacket);
+	RateTree tree;
+	tree.Configure((uint32_t)kProcessingRate, ResamplerQuality::Medium, kOutPacket);
+	std::vector<int> taps;
+	tree.Plan(std::vector<uint32_t>(std::begin(kFanoutRates), std::end(kFanoutRates)), &taps);
+	for (auto _ : state) {
+		tree.Process(voice.data(), kOutPacket);
+		benchmark::DoNotOptimize(tree.Output(taps[0]));
+		benchmark::ClobberMemory();
+	}
+	SetPerSample(state, kOutPacket);
+}
+
+// What the capture thread does per packet: downmix, resample to 16 kHz, the
+// voice chain, then quantize.
+void BM_FusedChain(benchmark::State& state, BenchFormat format) {
+	const std::vector<uint8_t> packet = MakePacket(format);
+	const size_t frames = format.rate / 100;
+	const DownmixPlan plan = MakeDownmixPlan(format.type, format.channels, format.mask);
+	PolyphaseResampler resampler;
+	resampler.Configure(format.rate, kOutRate, ResamplerQuality::Medium, frames);
+	VoiceChain chain;
+	chain.Configure(kProcessingRate);
+	std::vector<float> mono(frames);
+	std::vector<float> out(resampler.MaxOutput(frames));
+	std::vector<int16_t> pcm(out.size());
+	for (auto _ : state) {
+		plan.Run(packet.data(), frames, mono.data());
+		const size_t n = resampler.Process(mono.data(), frames, out.data());
+		const float gain = chain.Process(out.data(), n);
+		QuantizeToInt16(out.data(), n, gain, pcm.data());
+		benchmark::DoNotOptimize(pcm.data());
+		benchmark::ClobberMemory();
+	}
+	SetPerSample(state, frames * format.channels);
+}
+
+// The same per packet for a WASAPI stream the audio engine already
+// converted to 16 kHz mono float (conversion 'engine-converted'): the front
+// end is a copy and the resampler is bypassed. Time per iteration is per
+// 10 ms packet, as for FusedChain.
+void BM_EngineConvertedChain(benchmark::State& state) {
+	const BenchFormat format = { "16k_f32_mono", PcmSampleType::Float32, 1, kOutRate, 0x4 };
+	const std::vector<uint8_t> packet = MakePacket(format);
+	const DownmixPlan plan = MakeDownmixPlan(format.type, format.channels, format.mask);
+	VoiceChain chain;
+	chain.Configure(kProcessingRate);
+	std::vector<float> out(kOutPacket);
+	std::vector<int16_t> pcm(kOutPacket);
+	for (auto _ : state) {
+		plan.Run(packet.data(), kOutPacket, out.data());
+		const float gain = chain.Process(out.data(), kOutPacket);
+		QuantizeToInt16(out.data(), kOutPacket, gain, pcm.data());
+		benchmark::DoNotOptimize(pcm.data());
+		benchmark::ClobberMemory();
+	}
+	SetPerSample(state, kOutPacket);
+}
+
+void RegisterFormatBenchmarks() {
+	for (const BenchFormat& format : kFormats) {
+		benchmark::RegisterBenchmark((std::string("Downmix/") + format.name).c_str(), BM_Downmix, format);
+		benchmark::RegisterBenchmark((std::string("Deinterleave/") + format.name).c_str(), BM_Deinterleave, format);
+		benchmark::RegisterBenchmark((std::string("Resample/") + format.name).c_str(), BM_Resample, format);
+		benchmark::RegisterBenchmark((std::string("FusedChain/") + format.name).c_str(), BM_FusedChain, format);
+	}
+}
+
+} // namespace
+
+BENCHMARK(BM_HighPass);
+BENCHMARK(BM_NoiseGate);
+BENCHMARK(BM_BoostPeak);
+BENCHMARK(BM_Quantize);
+BENCHMARK(BM_WavPack);
+BENCHMARK(BM_VoiceChain);
+BENCHMARK(BM_EngineConvertedChain);
+BENCHMARK(BM_TileHash);
+BENCHMARK(BM_OcrPreprocess);
+BENCHMARK(BM_TextRegions);
+BENCHMARK(BM_KeywordSpotter);
+BENCHMARK(BM_LogMel);
+BENCHMARK(BM_ContentClassifier);
+BENCHMARK(BM_LanguageId);
+BENCHMARK(BM_SpeakerChange);
+BENCHMARK(BM_Base64);
+BENCHMARK(BM_FuzzyTextIndex);
+BENCHMARK(BM_FanoutResamplers);
+BENCHMARK(BM_FanoutRateTree);
+
+int main(int argc, char** argv) {
+	RegisterFormatBenchmarks();
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
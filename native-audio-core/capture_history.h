@@ -0,0 +1,295 @@
+#pragma once
+
+// Retroactive capture history (capture option "history"), for "what did they
+// just say?" after the fact: the capture keeps the last `seconds` of its
+// processed 16 kHz stream natively, so nothing is buffered in JS and audio
+// that never became an utterance chunk can still be fetched.
+//
+//   getHistory(fromMs, toMs)          // the default capture
+//   session.getHistory(fromMs, toMs)  // a CaptureSession
+//     -> Promise<{ data, format: 'wav' | 'ogg', fromMs, toMs, sampleRate } | null>
+//
+// fromMs/toMs are on the deviceClockMs() clock; the result covers the 20 ms
+// frames overlapping that span that are still held (fromMs/toMs report what
+// it actually spans) and is null when there are none or the capture keeps no
+// history. data is one external buffer: a WAV file, or with codec 'opus' an
+// Ogg-Opus file. A history outlives stop() until the capture starts again.
+//
+// The stream is cut into 20 ms frames. Each is stored, quantized to pcm16 or
+// Opus-encoded (the encoder runs on the capture thread; about 40 bytes a
+// frame at 16 kbps instead of 640), in a fixed ring of frame slots, each
+// guarded by a sequence number: a reader on the threadpool copies the frames
+// it wants and drops any the capture thread overwrote meanwhile. Silence the
+// capture skips is recorded as zeros so the timeline has no holes; gaps in
+// the stream itself (a held armed capture, a device reopen) simply join.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "async_query.h"
+#include "capture_options.h"
+#include "memory_budget.h"
+#include "opus_chunk_encoder.h"
+#include "pcm_channel.h"
+#include "pcm_quantize.h"
+
+class CaptureHistory {
+public:
+	static constexpr uint32_t kRate = 16000;
+	static constexpr size_t kFrame = kRate / 50; // 20 ms
+	static constexpr uint64_t kFrameNs = 20000000;
+	static constexpr size_t kMinShrinkSeconds = 30;
+	static constexpr uint64_t kReleaseFrames = 64; // frames behind the window given back at a time
+
+	CaptureHistory() = default;
+	CaptureHistory(const CaptureHistory&) = delete;
+	CaptureHistory& operator=(const CaptureHistory&) = delete;
+	~CaptureHistory() {
+#if defined(AUDIO_CORE_OPUS)
+		if (encoder_) opus_encoder_destroy(encoder_);
+#endif
+	}
+
+	// Before the capture thread starts; the capture thread never allocates.
+	bool Configure(const HistoryConfig& config, std::string* error) {
+		frames_ = std::max<size_t>(2, (size_t)config.seconds * kRate / kFrame);
+		opus_ = config.opus;
+		// Constrained VBR stays near the bitrate; twice its average frame is room enough
+		slotBytes_ = opus_ ? std::clamp<size_t>(config.bitrate / 400 * 2, 64, 1275) : kFrame * sizeof(int16_t);
+		slots_.reset(new Slot[frames_]);
+		data_.assign(frames_ * slotBytes_, 0);
+		window_.store(frames_, std::memory_order_release);
+		charged_ = frames_;
+		charge_.Set(frames_ * (slotBytes_ + sizeof(Slot)));
+		released_ = 0;
+		committed_.store(0, std::memory_order_relaxed);
+		fill_ = 0;
+		nextNs_ = 0;
+#if defined(AUDIO_CORE_OPUS)
+		if (opus_) {
+			int err = OPUS_OK;
+			encoder_ = opus_encoder_create((opus_int32)kRate, 1, OPUS_APPLICATION_VOIP, &err);
+			if (err != OPUS_OK || !encoder_) {
+				*error = std::string("opus_encoder_create failed: ") + opus_strerror(err);
+				encoder_ = nullptr;
+				return false;
+			}
+			opus_encoder_ctl(encoder_, OPUS_SET_BITRATE((opus_int32)config.bitrate));
+			opus_encoder_ctl(encoder_, OPUS_SET_VBR(1));
+			opus_encoder_ctl(encoder_, OPUS_SET_VBR_CONSTRAINT(1));
+			opus_encoder_ctl(encoder_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+			opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(3)); // capture thread: cheap over perfect
+			opus_int32 lookahead = 0;
+			opus_encoder_ctl(encoder_, OPUS_GET_LOOKAHEAD(&lookahead));
+			lookahead_ = (uint32_t)lookahead;
+		}
+#else
+		if (opus_) {
+			*error = "Opus encoding is not built in (use_opus=0)";
+			return false;
+		}
+#endif
+		return true;
+	}
+
+	// Capture thread: processed samples, before the chain's output gain is
+	// applied; timeNs is when samples[0] was captured (0 when unknown).
+	void Write(const float* samples, size_t count, uint64_t timeNs, float gain) {
+		if (timeNs == 0) timeNs = nextNs_;
+		for (size_t at = 0; at < count;) {
+			if (fill_ == 0) openNs_ = timeNs + (uint64_t)at * 1000000000ull / kRate;
+			const size_t n = std::min(count - at, kFrame - fill_);
+			if (samples) QuantizeToInt16(samples + at, n, gain, open_ + fill_);
+			else memset(open_ + fill_, 0, n * sizeof(int16_t));
+			fill_ += n;
+			at += n;
+			if (fill_ == kFrame) {
+				Commit();
+				fill_ = 0;
+			}
+		}
+		if (timeNs != 0) nextNs_ = timeNs + (uint64_t)count * 1000000000ull / kRate;
+	}
+
+	// Capture thread: count samples of silence that bypassed the chain.
+	void Skip(size_t count, uint64_t timeNs) { Write(nullptr, count, timeNs, 1.0f); }
+
+	struct Extract {
+		std::vector<uint8_t> bytes;
+		bool ogg = false;
+		uint64_t fromNs = 0, toNs = 0;
+		size_t frames = 0;
+	};
+
+	// Any thread: the held frames overlapping [fromNs, toNs) as a WAV or
+	// Ogg-Opus file. False when there are none.
+	bool Read(uint64_t fromNs, uint64_t toNs, Extract* out) const {
+		const uint64_t end = committed_.load(std::memory_order_acquire);
+		// The oldest slot is the next the capture thread overwrites; leave it be
+		const size_t window = window_.load(std::memory_order_acquire);
+		const uint64_t begin = end > window - 1 ? end - (window - 1) : 0;
+		std::vector<uint8_t> frame(slotBytes_);
+		std::vector<uint8_t> payload;
+		std::vector<uint32_t> sizes;
+		for (uint64_t k = begin; k < end; ++k) {
+			const Slot& slot = slots_[k % frames_];
+			const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+			if (seq != k * 2 + 2) continue;
+			const uint64_t timeNs = slot.timeNs.load(std::memory_order_relaxed);
+			const uint32_t bytes = slot.bytes.load(std::memory_order_relaxed);
+			if (timeNs + kFrameNs <= fromNs || timeNs >= toNs) continue;
+			memcpy(frame.data(), &data_[(k % frames_) * slotBytes_], bytes);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.seq.load(std::memory_order_relaxed) != seq) continue; // overwritten under us
+			if (out->frames == 0) out->fromNs = timeNs;
+			out->toNs = timeNs + kFrameNs;
+			++out->frames;
+			payload.insert(payload.end(), frame.begin(), frame.begin() + bytes);
+			sizes.push_back(bytes);
+		}
+		if (out->frames == 0) return false;
+		out->ogg = opus_;
+		if (!opus_) {
+			out->bytes.resize(kWavHeaderBytes + payload.size());
+			WriteWavHeader(out->bytes.data(), kRate, 1, (uint32_t)payload.size());
+			memcpy(out->bytes.data() + kWavHeaderBytes, payload.data(), payload.size());
+			return true;
+		}
+		// Granule positions count 48 kHz samples; one page per second
+		out->bytes.reserve(payload.size() + sizes.size() + 1024);
+		OggStreamWriter ogg(&out->bytes, 0x57487368u);
+		WriteOpusHeaders(&ogg, kRate, (uint16_t)(lookahead_ * 3));
+		const uint8_t* packet = payload.data();
+		int64_t granule = 0;
+		for (size_t i = 0; i < sizes.size(); ++i) {
+			granule += (int64_t)kFrame * 3;
+			ogg.Packet(packet, sizes[i], granule);
+			packet += sizes[i];
+			if ((i + 1) % 50 == 0 && i + 1 < sizes.size()) ogg.Flush(false);
+		}
+		ogg.Flush(true);
+		return true;
+	}
+
+private:
+	struct Slot {
+		std::atomic<uint64_t> seq{0}; // frame * 2 + 1 while written, + 2 once complete
+		std::atomic<uint64_t> timeNs{0};
+		std::atomic<uint32_t> bytes{0};
+	};
+
+	void Commit() {
+		const uint64_t k = committed_.load(std::memory_order_relaxed);
+		Slot& slot = slots_[k % frames_];
+		slot.seq.store(k * 2 + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		uint8_t* dst = &data_[(k % frames_) * slotBytes_];
+		uint32_t bytes = (uint32_t)slotBytes_;
+#if defined(AUDIO_CORE_OPUS)
+		if (opus_) {
+			const opus_int32 n = opus_encode(encoder_, open_, (int)kFrame, dst, (opus_int32)slotBytes_);
+			bytes = n > 0 ? (uint32_t)n : 0;
+		} else
+#endif
+		memcpy(dst, open_, bytes);
+		slot.timeNs.store(openNs_, std::memory_order_relaxed);
+		slot.bytes.store(bytes, std::memory_order_relaxed);
+		slot.seq.store(k * 2 + 2, std::memory_order_release);
+		committed_.store(k + 1, std::memory_order_release);
+		if (window_.load(std::memory_order_relaxed) < frames_) ReleaseBehind(k + 1);
+	}
+
+	// Pressure watch: halve the window; Read() honours it at once.
+	void Shrink() {
+		const size_t window = window_.load(std::memory_order_acquire);
+		const size_t floor = kMinShrinkSeconds * 50;
+		if (window <= floor) return;
+		window_.store(std::max(floor, window / 2), std::memory_order_release);
+	}
+
+	// Capture thread, once the window has shrunk: the frames in the slots
+	// outside it, up to frame `end`, are invalidated (a reader still on the
+	// old window drops them) and their pages go back to the OS.
+	void ReleaseBehind(uint64_t end) {
+		const size_t window = window_.load(std::memory_order_acquire);
+		if (window != charged_) {
+			charged_ = window;
+			charge_.Set(window * slotBytes_ + frames_ * sizeof(Slot));
+		}
+		if (end <= window) return;
+		const uint64_t out = end - window; // frames before this one are outside
+		const uint64_t from = std::max<uint64_t>(released_, out > frames_ - window ? out - (frames_ - window) : 0);
+		if (out < from + kReleaseFrames) return;
+		for (uint64_t k = from; k < out; ++k) slots_[k % frames_].seq.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (uint64_t k = from; k < out;) {
+			const size_t first = k % frames_;
+			const size_t run = (size_t)std::min<uint64_t>(out - k, frames_ - first); // up to the ring's end
+			DiscardPages(&data_[first * slotBytes_], run * slotBytes_);
+			k += run;
+		}
+		released_ = out;
+	}
+
+	size_t frames_ = 0;
+	size_t slotBytes_ = 0;
+	bool opus_ = false;
+	uint32_t lookahead_ = 0; // encoder delay, 16 kHz samples
+	std::unique_ptr<Slot[]> slots_;
+	std::vector<uint8_t> data_; // frames_ x slotBytes_
+	std::atomic<uint64_t> committed_{0}; // frames completed since Configure()
+	int16_t open_[kFrame] = {};          // capture thread: the frame being filled
+	size_t fill_ = 0;
+	uint64_t openNs_ = 0;
+	uint64_t nextNs_ = 0;                // extrapolated time of the next sample
+#if defined(AUDIO_CORE_OPUS)
+	OpusEncoder* encoder_ = nullptr;
+#endif
+	std::atomic<size_t> window_{0};      // newest frames Read() returns, <= frames_
+	size_t charged_ = 0;                 // capture thread: the window charge_ holds
+	uint64_t released_ = 0;              // capture thread: frames before this have given their pages back
+	MemoryCharge charge_{ MemoryKind::History };
+	MemoryTrimHook trim_{ [this] { Shrink(); } }; // last: gone first
+};
+
+// getHistory(fromMs, toMs) on `history`, which may be null (no option
+// 'history' or never started). Copies on the threadpool.
+inline Napi::Value QueueHistoryQuery(const Napi::CallbackInfo& info, std::shared_ptr<const CaptureHistory> history) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber()) {
+		Napi::TypeError::New(env, "fromMs and toMs required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const double fromMs = std::max(0.0, info[0].As<Napi::Number>().DoubleValue());
+	const double toMs = std::max(fromMs, info[1].As<Napi::Number>().DoubleValue());
+	struct Result {
+		CaptureHistory::Extract extract;
+		bool found = false;
+	};
+	return QueueQuery(env, "GetHistory",
+		[history = std::move(history), fromNs = (uint64_t)(fromMs * 1e6), toNs = (uint64_t)(toMs * 1e6)]() {
+			Result result;
+			if (history) result.found = history->Read(fromNs, toNs, &result.extract);
+			return result;
+		},
+		[](Napi::Env env, Result& result) -> Napi::Value {
+			if (!result.found) return env.Null();
+			CaptureHistory::Extract& extract = result.extract;
+			Napi::Object o = Napi::Object::New(env);
+			auto* bytes = new std::vector<uint8_t>(std::move(extract.bytes));
+			o.Set("data", Napi::Buffer<uint8_t>::New(env, bytes->data(), bytes->size(),
+				[](Napi::Env, uint8_t*, std::vector<uint8_t>* p) { delete p; }, bytes));
+			o.Set("format", Napi::String::New(env, extract.ogg ? "ogg" : "wav"));
+			o.Set("fromMs", Napi::Number::New(env, extract.fromNs / 1e6));
+			o.Set("toMs", Napi::Number::New(env, extract.toNs / 1e6));
+			o.Set("sampleRate", Napi::Number::New(env, CaptureHistory::kRate));
+			return o;
+		}, TaskPriority::Interactive);
+}
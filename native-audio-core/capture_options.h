@@ -0,0 +1,948 @@
+#pragma once
+
+// Options object accepted as the trailing argument of the startCapture* calls.
+// Shared by the WASAPI and CoreAudio addons; unknown keys are ignored so JS can
+// pass the same object to either platform.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "delivery_gate.h"
+#include "dsp_warm_state.h"
+#include "echo_canceller.h"
+#include "file_replay_source.h"
+#include "loudness.h"
+#include "pcm_channel.h"
+#include "power_state.h"
+#include "quality_governor.h"
+#include "resampler.h"
+#include "spectral_denoise.h"
+#include "thread_schedule.h"
+
+// Shared-mode stream timing (WASAPI; CoreAudio keeps the HAL defaults):
+//   Default   - engine default period (~10 ms) and buffer
+//   Lowest    - minimum engine period via IAudioClient3::InitializeSharedAudioStream
+//   PowerSave - 200 ms buffer drained by polling every 100 ms instead of per-period events
+enum class LatencyMode { Default, Lowest, PowerSave };
+
+inline const char* LatencyModeName(LatencyMode mode) {
+	switch (mode) {
+	case LatencyMode::Lowest: return "lowest";
+	case LatencyMode::PowerSave: return "powersave";
+	default: return "default";
+	}
+}
+
+// What a capture with option "power" runs as on one power source (power_state.h):
+//   quality    - the least the quality governor (quality_governor.h) may go
+//                down to: 'light-resampler' swaps the resampler, 'no-denoise'
+//                also drops option 'denoise', 'sparse-features' also halves
+//                the chunk feature analysis. Applies with or without option
+//                'governor'; with it, load can still step further down.
+//   throttleMs - JS wakeups at most this often
+//   latencyMode - the device stream's; a stream is set up once, so this one
+//                applies to captures started on that source
+// On AC everything defaults to the top-level options; on battery to
+// 'no-denoise', at least 100 ms between wakeups and 'powersave'.
+struct PowerProfile {
+	QualityLevel quality = QualityLevel::Full;
+	uint32_t throttleMs = 0;
+	LatencyMode latency = LatencyMode::Default;
+};
+
+struct PowerConfig {
+	bool enabled = false;
+	PowerProfile ac;
+	PowerProfile battery{ QualityLevel::NoDenoise, 100, LatencyMode::PowerSave };
+
+	// An unknown source (no battery to ask, or not read yet) counts as AC
+	const PowerProfile& For(PowerSource source) const { return source == PowerSource::Battery ? battery : ac; }
+};
+
+// Idle release of a loopback stream (option "idle"): once no audio session has
+// played for `minutes`, the device stream is stopped and released, and the
+// capture waits on the session registry (session_table.h) to reopen it the
+// moment any app starts playing. What plays before the stream is back is not
+// captured. Needs the registry (macOS 14+); microphones and files ignore it.
+struct IdleConfig {
+	bool enabled = false;
+	uint32_t afterMs = 5 * 60 * 1000;
+};
+
+// Who converts the device stream to 16 kHz mono (option "conversion"; each
+// platform reads the other's value as 'native'):
+//   Native - 'native': render the device format, downmix/resample here
+//   Hal    - 'hal-converted': CoreAudio, 16 kHz mono float client format, the AudioUnit converts
+//   Engine - 'engine-converted': WASAPI, 16 kHz mono float client format, the
+//            audio engine converts (AUTOCONVERTPCM, default-quality SRC)
+enum class FormatConversion { Native, Hal, Engine };
+
+// How CoreAudio reads a BlackHole or microphone device (option "backend";
+// process taps always use an IOProc, WASAPI ignores it):
+//   AudioUnit - 'audio-unit': an AUHAL unit, pulled with AudioUnitRender
+//   IoProc    - 'ioproc': an IOProc on the device itself, handed the input
+//               buffer list in place; conversion is always 'native'
+enum class HalBackend { AudioUnit, IoProc };
+
+// What a capture records (option "source"):
+//   Loopback   - 'loopback': what the system plays (pid selects an app)
+//   Microphone - 'microphone': an input device (pid ignored), through the same
+//                16 kHz front end, voice chain, VAD and chunker
+//   File       - 'file': option "file" decoded and replayed through that chain
+//                (file_replay_source.h); the capture ends with the file
+enum class CaptureSource { Loopback, Microphone, File };
+
+// How a WASAPI microphone stream is opened (option "micMode"; CoreAudio
+// ignores it):
+//   Default - 'default': the endpoint's effects (APOs) run: noise
+//             suppression, AGC, beamforming, whatever the driver ships
+//   Raw     - 'raw': AUDCLNT_STREAMOPTIONS_RAW, the signal without them where
+//             the driver supports raw processing; the voice chain and echo
+//             canceller condition it instead
+enum class MicMode { Default, Raw };
+
+// Which default input a WASAPI microphone without inputDevice opens, and the
+// stream category it declares (option "micRole"): 'console' or
+// 'communications' (the device and effects Windows picks for calls).
+enum class MicRole { Console, Communications };
+
+inline const char* CaptureSourceName(CaptureSource source) {
+	return source == CaptureSource::Microphone ? "microphone" : source == CaptureSource::File ? "file replay" : "loopback";
+}
+
+// Retroactive capture history (option "history"; capture_history.h): the
+// last `seconds` of the processed 16 kHz stream, kept as pcm16 or, with codec
+// 'opus', as 20 ms Opus packets (a sixteenth the size at 16 kbps).
+struct HistoryConfig {
+	bool enabled = false;
+	uint32_t seconds = 120;
+	bool opus = false;
+	uint32_t bitrate = 16000; // codec 'opus'
+};
+
+// Session recording to disk (option "record"; session_recorder.h): the
+// processed 16 kHz stream, or with stream 'raw' the chain's input, written as
+// rotating segment files <path>-0001.<wav|flac|opus> by a dedicated I/O thread.
+enum class RecordCodec { Wav, Flac, Opus };
+
+inline const char* RecordCodecExtension(RecordCodec codec) {
+	return codec == RecordCodec::Flac ? "flac" : codec == RecordCodec::Opus ? "opus" : "wav";
+}
+
+struct RecordConfig {
+	bool enabled = false;
+	std::string path;              // segment files are path-0001.<ext>, path-0002.<ext>, ...
+	RecordCodec codec = RecordCodec::Wav;
+	bool raw = false;              // the chain's input (after downmix and resampling) instead of its output
+	uint32_t segmentSeconds = 600; // a new file every segmentSeconds of stream
+	uint32_t bitrate = 24000;      // codec 'opus'
+};
+
+struct CaptureOptions {
+	DeliveryMode delivery = DeliveryMode::Copy;
+	OverflowPolicy overflow = OverflowPolicy::DropOldest;
+	uint32_t queueDepth = 64; // packets; ~640 ms of 10 ms WASAPI packets
+	uint32_t throttleMs = 0;  // minimum interval between JS wakeups
+	uint32_t frameMs = 0;     // 0 = one packet per capture buffer
+	uint32_t framesPerPacket = 1;
+	SampleFormat format = SampleFormat::Wav;
+	ResamplerQuality resampler = ResamplerQuality::Medium;
+	ThreadSchedule schedule = ThreadSchedule::Audio;
+	ThreadPriority priority = ThreadPriority::Normal;
+	LatencyMode latency = LatencyMode::Default;
+	FormatConversion conversion = FormatConversion::Native;
+	HalBackend backend = HalBackend::AudioUnit;
+	VadMode vad = VadMode::Off; // needs frameMs of 10, 20 or 30 ms
+	NeuralVadConfig neuralVad;  // option "neuralVad": { model, threshold, hangoverMs }; needs vad
+	SelfEchoConfig selfEcho;    // option "selfEcho": true or { threshold, maxLagMs }; needs vad
+	TransientMaskConfig declick; // option "declick": true or { onsetDb, maxClickMs }; clicks hidden from the VAD; needs vad
+	UtteranceChunkerConfig chunker; // option "chunker": { minChunkMs, ..., compact, stream }; needs vad
+	KeywordSpotterConfig keyword;   // option "keyword": { model, threshold, windowMs, strideMs }; needs chunker
+	bool mel = false;               // option "mel": chunks' log-mel frames kept for the Whisper engine; needs chunker
+	ContentClassifierConfig content; // option "content": true or { model, dropMusic, dropNoise }; needs chunker
+	LanguageIdConfig languageId;    // option "languageId": { model, minConfidence, minChunkMs }; needs chunker
+	SpeakerChangeConfig speaker;    // option "speaker": true or { model, threshold, cut }; needs chunker
+	LoudnessConfig loudness;        // option "loudness": { targetLufs, ... }; replaces the voice boost
+	DenoiseConfig denoise;          // option "denoise": { budgetUs, floorDb }; spectral suppression before the gate
+	std::string filterGraph;        // option "filterGraph": libavfilter graph replacing the voice chain
+	bool excludeSelf = false;       // option "excludeSelf": a system-wide capture leaves out this app's process tree
+	bool dialogue = false;          // option "dialogue": centre channel or stereo centre extraction before the downmix (dialogue_focus.h)
+	CaptureSource source = CaptureSource::Loopback;
+	std::string inputDevice;        // option "inputDevice": lowercased name substring; empty = default input
+	std::vector<std::string> outputDevices; // option "outputDevice": render endpoints (lowercased IDs or name substrings) to loopback; several are mixed
+	MicMode micMode = MicMode::Default; // option "micMode": 'default' or 'raw'; microphone only
+	MicRole micRole = MicRole::Console; // option "micRole": 'console' or 'communications'; likewise
+	std::string file;               // option "file": path replayed by source 'file'
+	ReplayPace pace = ReplayPace::Realtime; // option "pace": 'realtime' or 'fast'; source 'file' only
+	EchoCancelConfig echo;          // option "echoCancel": true or { tailMs }; microphone only
+	bool timestamps = false;        // option "timestamps": sample index and capture time per packet and chunk
+	bool batch = false;             // option "batch": one callback call per wakeup with an array of its calls
+	DtxConfig dtx;                  // option "dtx": true or { hangoverMs, prerollMs, thresholdDb }; packets pause in silence
+	GovernorConfig governor;        // option "governor": true or { highLoad, lowLoad, holdMs }; quality steps down under load
+	PowerConfig power;              // option "power": true or { ac, battery } profiles; follows the power source
+	IdleConfig idle;                // option "idle": true or { minutes }; the device stream is released while nothing plays
+	HistoryConfig history;          // option "history": true or { seconds, codec, bitrate }; queried with getHistory()
+	RecordConfig record;            // option "record": { path, codec, stream, segmentSeconds, bitrate }; segment files on disk
+	WarmStartConfig warmStart;      // option "warmStart": { path, key }; the voice chain resumes the endpoint's adaptive state
+	bool feedSubscribers = true;    // not an option: false for CaptureSession instances (capture_session.h)
+	ArmConfig arm;                  // not an option: CaptureSession.arm() (capture_session.h, delivery_gate.h)
+
+	// Samples per emitted packet at `rate`, or 0 when re-framing is off.
+	size_t PacketSamples(uint32_t rate) const {
+		return (size_t)rate * frameMs / 1000 * framesPerPacket;
+	}
+
+	PcmChannelConfig ChannelConfig(uint32_t rate) const {
+		PcmChannelConfig c;
+		c.delivery = delivery;
+		c.overflow = overflow;
+		c.queueDepth = queueDepth;
+		c.throttleMs = throttleMs;
+		c.format = format;
+		c.sampleRate = rate;
+		c.packetSamples = (uint32_t)PacketSamples(rate);
+		c.vad = vad;
+		c.vadFrameSamples = vad == VadMode::Off ? 0 : rate * frameMs / 1000;
+		c.neuralVad = neuralVad;
+		c.selfEcho = selfEcho;
+		c.declick = declick;
+		c.chunker = chunker;
+		// Opus takes 8, 12, 16, 24 and 48 kHz; a subscriber at another rate streams pcm16
+		if (rate != 8000 && rate != 12000 && rate != 16000 && rate != 24000 && rate != 48000) c.chunker.stream.opus = false;
+		c.keyword = keyword;
+		c.mel = mel;
+		c.content = content;
+		c.languageId = languageId;
+		c.speaker = speaker;
+		c.timestamps = timestamps;
+		c.batch = batch;
+		c.dtx = dtx;
+		return c;
+	}
+};
+
+// Reads a string option that must be one of `names`; *index receives the
+// position of the match. Missing keys leave *index untouched.
+inline bool ReadEnumOption(const Napi::Object& obj, const char* key,
+                           std::initializer_list<const char*> names, int* index, std::string* error) {
+	if (!obj.Has(key)) return true;
+	Napi::Value v = obj.Get(key);
+	if (v.IsUndefined()) return true;
+	if (v.IsString()) {
+		std::string s = v.As<Napi::String>().Utf8Value();
+		int i = 0;
+		for (const char* name : names) {
+			if (s == name) { *index = i; return true; }
+			++i;
+		}
+	}
+	*error = std::string("Invalid value for option '") + key + "'";
+	return false;
+}
+
+// Reads a numeric option clamped to [lo, hi]. Missing keys leave *out untouched.
+inline bool ReadUint32Option(const Napi::Object& obj, const char* key, uint32_t lo, uint32_t hi,
+                             uint32_t* out, std::string* error) {
+	if (!obj.Has(key)) return true;
+	Napi::Value v = obj.Get(key);
+	if (v.IsUndefined()) return true;
+	if (!v.IsNumber()) {
+		*error = std::string("Option '") + key + "' must be a number";
+		return false;
+	}
+	double d = v.As<Napi::Number>().DoubleValue();
+	if (!(d >= lo && d <= hi)) {
+		*error = std::string("Option '") + key + "' is out of range";
+		return false;
+	}
+	*out = (uint32_t)d;
+	return true;
+}
+
+// Same for fractional (and negative) values.
+inline bool ReadFloatOption(const Napi::Object& obj, const char* key, float lo, float hi,
+                            float* out, std::string* error) {
+	if (!obj.Has(key)) return true;
+	Napi::Value v = obj.Get(key);
+	if (v.IsUndefined()) return true;
+	if (!v.IsNumber()) {
+		*error = std::string("Option '") + key + "' must be a number";
+		return false;
+	}
+	double d = v.As<Napi::Number>().DoubleValue();
+	if (!(d >= lo && d <= hi)) {
+		*error = std::string("Option '") + key + "' is out of range";
+		return false;
+	}
+	*out = (float)d;
+	return true;
+}
+
+// Parses `value` into *out. undefined/null keep the defaults; anything else that
+// isn't a valid options object fills *error and returns false.
+inline bool ParseCaptureOptions(const Napi::Value& value, CaptureOptions* out, std::string* error) {
+	if (value.IsUndefined() || value.IsNull()) return true;
+	if (!value.IsObject()) {
+		*error = "Capture options must be an object";
+		return false;
+	}
+	Napi::Object obj = value.As<Napi::Object>();
+
+	int delivery = (int)out->delivery;
+	if (!ReadEnumOption(obj, "delivery", { "copy", "pooled" }, &delivery, error)) return false;
+	out->delivery = (DeliveryMode)delivery;
+
+	int overflow = (int)out->overflow;
+	if (!ReadEnumOption(obj, "overflow", { "drop-oldest", "drop-newest", "coalesce" }, &overflow, error)) return false;
+	out->overflow = (OverflowPolicy)overflow;
+
+	if (!ReadUint32Option(obj, "queueDepth", 2, 4096, &out->queueDepth, error)) return false;
+	if (!ReadUint32Option(obj, "throttleMs", 0, 1000, &out->throttleMs, error)) return false;
+	int format = (int)out->format;
+	if (!ReadEnumOption(obj, "format", { "wav", "pcm16", "float32", "pcm16-base64", "realtime-append" }, &format, error)) return false;
+	out->format = (SampleFormat)format;
+	// A text packet can't take another's samples on its end
+	if (IsTextFormat(out->format) && out->overflow == OverflowPolicy::Coalesce) {
+		*error = "Option 'overflow' 'coalesce' does not work with the text formats";
+		return false;
+	}
+
+	int resampler = (int)out->resampler;
+	if (!ReadEnumOption(obj, "resampler", { "low", "medium", "high" }, &resampler, error)) return false;
+	out->resampler = (ResamplerQuality)resampler;
+
+	int schedule = (int)out->schedule;
+	if (!ReadEnumOption(obj, "schedule", { "normal", "audio", "pro-audio" }, &schedule, error)) return false;
+	out->schedule = (ThreadSchedule)schedule;
+
+	int priority = (int)out->priority;
+	if (!ReadEnumOption(obj, "priority", { "low", "normal", "high", "critical" }, &priority, error)) return false;
+	out->priority = (ThreadPriority)priority;
+
+	int latency = (int)out->latency;
+	if (!ReadEnumOption(obj, "latencyMode", { "default", "lowest", "powersave" }, &latency, error)) return false;
+	out->latency = (LatencyMode)latency;
+
+	int conversion = (int)out->conversion;
+	if (!ReadEnumOption(obj, "conversion", { "native", "hal-converted", "engine-converted" }, &conversion, error)) return false;
+	out->conversion = (FormatConversion)conversion;
+
+	int backend = (int)out->backend;
+	if (!ReadEnumOption(obj, "backend", { "audio-unit", "ioproc" }, &backend, error)) return false;
+	out->backend = (HalBackend)backend;
+
+	if (!ReadUint32Option(obj, "frameMs", 0, 1000, &out->frameMs, error)) return false;
+	if (!ReadUint32Option(obj, "framesPerPacket", 1, 100, &out->framesPerPacket, error)) return false;
+
+	int vad = (int)out->vad;
+	if (!ReadEnumOption(obj, "vad", { "off", "quality", "low-bitrate", "aggressive", "very-aggressive" }, &vad, error)) return false;
+	out->vad = (VadMode)vad;
+	// One speech bit per frame, all of them in a single 32-bit number
+	if (out->vad != VadMode::Off &&
+	    ((out->frameMs != 10 && out->frameMs != 20 && out->frameMs != 30) || out->framesPerPacket > 32)) {
+		*error = "Option 'vad' needs frameMs of 10, 20 or 30 and at most 32 framesPerPacket";
+		return false;
+	}
+
+	if (obj.Has("neuralVad") && !obj.Get("neuralVad").IsUndefined()) {
+		Napi::Value v = obj.Get("neuralVad");
+		if (!v.IsObject() || !v.As<Napi::Object>().Get("model").IsString()) {
+			*error = "Option 'neuralVad' must be an object with a 'model' path";
+			return false;
+		}
+		Napi::Object neural = v.As<Napi::Object>();
+		NeuralVadConfig& c = out->neuralVad;
+		if (!ReadFloatOption(neural, "threshold", 0.2f, 0.95f, &c.threshold, error)) return false;
+		if (!ReadUint32Option(neural, "hangoverMs", 0, 2000, &c.hangoverMs, error)) return false;
+		if (out->vad == VadMode::Off) {
+			*error = "Option 'neuralVad' needs 'vad'";
+			return false;
+		}
+		c.model = NeuralVadModel::Load(neural.Get("model").As<Napi::String>().Utf8Value(), error);
+		if (!c.model) return false;
+	}
+
+	if (obj.Has("selfEcho") && !obj.Get("selfEcho").IsUndefined()) {
+		Napi::Value v = obj.Get("selfEcho");
+		SelfEchoConfig& c = out->selfEcho;
+		if (v.IsBoolean()) {
+			c.enabled = v.As<Napi::Boolean>().Value();
+		} else if (v.IsObject()) {
+			Napi::Object echo = v.As<Napi::Object>();
+			c.enabled = true;
+			if (!ReadFloatOption(echo, "threshold", 0.2f, 0.95f, &c.threshold, error)) return false;
+			if (!ReadUint32Option(echo, "maxLagMs", 0, 1000, &c.maxLagMs, error)) return false;
+		} else {
+			*error = "Option 'selfEcho' must be a boolean or an object";
+			return false;
+		}
+		if (c.enabled && out->vad == VadMode::Off) {
+			*error = "Option 'selfEcho' needs 'vad'";
+			return false;
+		}
+	}
+
+	if (obj.Has("declick") && !obj.Get("declick").IsUndefined()) {
+		Napi::Value v = obj.Get("declick");
+		TransientMaskConfig& c = out->declick;
+		if (v.IsBoolean()) {
+			c.enabled = v.As<Napi::Boolean>().Value();
+		} else if (v.IsObject()) {
+			Napi::Object declick = v.As<Napi::Object>();
+			c.enabled = true;
+			if (!ReadFloatOption(declick, "onsetDb", 6.0f, 40.0f, &c.onsetDb, error)) return false;
+			if (!ReadUint32Option(declick, "maxClickMs", 10, 200, &c.maxClickMs, error)) return false;
+		} else {
+			*error = "Option 'declick' must be a boolean or an object";
+			return false;
+		}
+		if (c.enabled && out->vad == VadMode::Off) {
+			*error = "Option 'declick' needs 'vad'";
+			return false;
+		}
+	}
+
+	if (obj.Has("chunker") && !obj.Get("chunker").IsUndefined()) {
+		Napi::Value v = obj.Get("chunker");
+		if (!v.IsObject()) {
+			*error = "Option 'chunker' must be an object";
+			return false;
+		}
+		Napi::Object chunker = v.As<Napi::Object>();
+		UtteranceChunkerConfig& c = out->chunker;
+		if (!ReadUint32Option(chunker, "minChunkMs", 0, 30000, &c.minChunkMs, error)) return false;
+		if (!ReadUint32Option(chunker, "maxChunkMs", 100, 30000, &c.maxChunkMs, error)) return false;
+		if (!ReadUint32Option(chunker, "pauseMs", 10, 10000, &c.pauseMs, error)) return false;
+		if (!ReadUint32Option(chunker, "overlapMs", 0, 1000, &c.overlapMs, error)) return false;
+		if (!ReadUint32Option(chunker, "prerollMs", 0, 1000, &c.prerollMs, error)) return false;
+		if (!ReadUint32Option(chunker, "flushSilenceMs", 10, 30000, &c.flushSilenceMs, error)) return false;
+		if (!ReadUint32Option(chunker, "resetSilenceMs", 10, 30000, &c.resetSilenceMs, error)) return false;
+		if (!ReadUint32Option(chunker, "valleyMs", 0, 1000, &c.valleyMs, error)) return false;
+		if (!ReadUint32Option(chunker, "trimMs", 0, 1000, &c.trimMs, error)) return false;
+		if (!chunker.Get("adaptive").IsUndefined()) {
+			if (!chunker.Get("adaptive").IsBoolean()) {
+				*error = "Option 'chunker.adaptive' must be a boolean";
+				return false;
+			}
+			c.adaptive = chunker.Get("adaptive").As<Napi::Boolean>().Value();
+		}
+		if (chunker.Has("compact") && !chunker.Get("compact").IsUndefined()) {
+			Napi::Value cv = chunker.Get("compact");
+			PauseCompactConfig& pc = c.compact;
+			if (cv.IsBoolean()) {
+				pc.enabled = cv.As<Napi::Boolean>().Value();
+			} else if (cv.IsObject()) {
+				Napi::Object compact = cv.As<Napi::Object>();
+				if (!ReadUint32Option(compact, "minPauseMs", 100, 10000, &pc.minPauseMs, error)) return false;
+				if (!ReadUint32Option(compact, "gapMs", 20, 2000, &pc.gapMs, error)) return false;
+				if (pc.gapMs >= pc.minPauseMs) {
+					*error = "Option 'chunker.compact' gapMs must be below minPauseMs";
+					return false;
+				}
+				pc.enabled = true;
+			} else {
+				*error = "Option 'chunker.compact' must be a boolean or an object";
+				return false;
+			}
+		}
+		if (chunker.Has("stream") && !chunker.Get("stream").IsUndefined()) {
+			Napi::Value sv = chunker.Get("stream");
+			UtteranceStreamConfig& sc = c.stream;
+			if (sv.IsBoolean()) {
+				sc.enabled = sv.As<Napi::Boolean>().Value();
+			} else if (sv.IsObject()) {
+				Napi::Object stream = sv.As<Napi::Object>();
+				int codec = sc.opus ? 1 : 0;
+				if (!ReadUint32Option(stream, "intervalMs", 20, 5000, &sc.intervalMs, error)) return false;
+				if (!ReadEnumOption(stream, "codec", { "pcm16", "opus" }, &codec, error)) return false;
+				if (!ReadUint32Option(stream, "bitrate", 6000, 128000, &sc.bitrate, error)) return false;
+				sc.opus = codec == 1;
+				sc.enabled = true;
+			} else {
+				*error = "Option 'chunker.stream' must be a boolean or an object";
+				return false;
+			}
+#if !defined(AUDIO_CORE_OPUS)
+			if (sc.opus) {
+				*error = "Option 'chunker.stream' codec 'opus' is not built in (use_opus=0)";
+				return false;
+			}
+#endif
+		}
+		if (out->vad == VadMode::Off) {
+			*error = "Option 'chunker' needs 'vad'";
+			return false;
+		}
+		c.enabled = true;
+	}
+
+	if (obj.Has("keyword") && !obj.Get("keyword").IsUndefined()) {
+		Napi::Value v = obj.Get("keyword");
+		if (!v.IsObject() || !v.As<Napi::Object>().Get("model").IsString()) {
+			*error = "Option 'keyword' must be an object with a 'model' path";
+			return false;
+		}
+		Napi::Object keyword = v.As<Napi::Object>();
+		KeywordSpotterConfig& c = out->keyword;
+		if (!ReadFloatOption(keyword, "threshold", 0.05f, 1.0f, &c.threshold, error)) return false;
+		if (!ReadUint32Option(keyword, "windowMs", 1000, 600000, &c.windowMs, error)) return false;
+		if (!ReadUint32Option(keyword, "strideMs", 10, 500, &c.strideMs, error)) return false;
+		if (!out->chunker.enabled) {
+			*error = "Option 'keyword' needs 'chunker'";
+			return false;
+		}
+		c.model = KeywordModel::Load(keyword.Get("model").As<Napi::String>().Utf8Value(), error);
+		if (!c.model) return false;
+		c.enabled = true;
+	}
+
+	if (obj.Has("mel") && !obj.Get("mel").IsUndefined()) {
+		Napi::Value v = obj.Get("mel");
+		if (!v.IsBoolean()) {
+			*error = "Option 'mel' must be a boolean";
+			return false;
+		}
+		out->mel = v.As<Napi::Boolean>().Value();
+		if (out->mel && !out->chunker.enabled) {
+			*error = "Option 'mel' needs 'chunker'";
+			return false;
+		}
+	}
+
+	if (obj.Has("content") && !obj.Get("content").IsUndefined()) {
+		Napi::Value v = obj.Get("content");
+		ContentClassifierConfig& c = out->content;
+		if (v.IsBoolean()) {
+			c.enabled = v.As<Napi::Boolean>().Value();
+		} else if (v.IsObject()) {
+			Napi::Object content = v.As<Napi::Object>();
+			if (!ReadFloatOption(content, "dropMusic", 0.3f, 1.0f, &c.dropMusic, error)) return false;
+			if (!ReadFloatOption(content, "dropNoise", 0.3f, 1.0f, &c.dropNoise, error)) return false;
+			if (content.Has("model") && !content.Get("model").IsUndefined()) {
+				if (!content.Get("model").IsString()) {
+					*error = "Option 'content.model' must be a path";
+					return false;
+				}
+				c.model = ContentModel::Load(content.Get("model").As<Napi::String>().Utf8Value(), error);
+				if (!c.model) return false;
+			}
+			c.enabled = true;
+		} else {
+			*error = "Option 'content' must be a boolean or an object";
+			return false;
+		}
+		if (c.enabled && !out->chunker.enabled) {
+			*error = "Option 'content' needs 'chunker'";
+			return false;
+		}
+		// A dropped chunk would leave the utterance its stream carried ahead unfinished
+		if ((c.dropMusic > 0.0f || c.dropNoise > 0.0f) && out->chunker.stream.enabled) {
+			*error = "Options 'content.dropMusic' and 'content.dropNoise' do not work with 'chunker.stream'";
+			return false;
+		}
+	}
+
+	if (obj.Has("languageId") && !obj.Get("languageId").IsUndefined()) {
+		Napi::Value v = obj.Get("languageId");
+		if (!v.IsObject() || !v.As<Napi::Object>().Get("model").IsString()) {
+			*error = "Option 'languageId' must be an object with a 'model' path";
+			return false;
+		}
+		Napi::Object languageId = v.As<Napi::Object>();
+		LanguageIdConfig& c = out->languageId;
+		if (!ReadFloatOption(languageId, "minConfidence", 0.0f, 1.0f, &c.minConfidence, error)) return false;
+		if (!out->chunker.enabled) {
+			*error = "Option 'languageId' needs 'chunker'";
+			return false;
+		}
+		c.model = LanguageIdModel::Load(languageId.Get("model").As<Napi::String>().Utf8Value(), error);
+		if (!c.model) return false;
+		// Codes the model does not know are ignored, so JS can pass one table for any model
+		c.minChunkMs.assign(c.model->languages.size(), 0);
+		if (languageId.Has("minChunkMs") && !languageId.Get("minChunkMs").IsUndefined()) {
+			if (!languageId.Get("minChunkMs").IsObject()) {
+				*error = "Option 'languageId.minChunkMs' must map language codes to milliseconds";
+				return false;
+			}
+			Napi::Object table = languageId.Get("minChunkMs").As<Napi::Object>();
+			Napi::Array codes = table.GetPropertyNames();
+			for (uint32_t i = 0; i < codes.Length(); ++i) {
+				const std::string code = codes.Get(i).ToString().Utf8Value();
+				uint32_t ms = 0;
+				if (!ReadUint32Option(table, code.c_str(), 100, 10000, &ms, error)) return false;
+				const int index = c.model->Find(code);
+				if (index >= 0) c.minChunkMs[index] = ms;
+			}
+		}
+		c.enabled = true;
+	}
+
+	if (obj.Has("speaker") && !obj.Get("speaker").IsUndefined()) {
+		Napi::Value v = obj.Get("speaker");
+		SpeakerChangeConfig& c = out->speaker;
+		if (v.IsBoolean()) {
+			c.enabled = v.As<Napi::Boolean>().Value();
+		} else if (v.IsObject()) {
+			Napi::Object speaker = v.As<Napi::Object>();
+			if (!ReadFloatOption(speaker, "threshold", 0.01f, 1.5f, &c.threshold, error)) return false;
+			if (speaker.Has("cut") && !speaker.Get("cut").IsUndefined()) {
+				if (!speaker.Get("cut").IsBoolean()) {
+					*error = "Option 'speaker.cut' must be a boolean";
+					return false;
+				}
+				c.cut = speaker.Get("cut").As<Napi::Boolean>().Value();
+			}
+			if (speaker.Has("model") && !speaker.Get("model").IsUndefined()) {
+				if (!speaker.Get("model").IsString()) {
+					*error = "Option 'speaker.model' must be a path";
+					return false;
+				}
+				c.model = SpeakerModel::Load(speaker.Get("model").As<Napi::String>().Utf8Value(), error);
+				if (!c.model) return false;
+			}
+			c.enabled = true;
+		} else {
+			*error = "Option 'speaker' must be a boolean or an object";
+			return false;
+		}
+		if (c.enabled && !out->chunker.enabled) {
+			*error = "Option 'speaker' needs 'chunker'";
+			return false;
+		}
+	}
+
+	if (obj.Has("loudness") && !obj.Get("loudness").IsUndefined()) {
+		Napi::Value v = obj.Get("loudness");
+		if (!v.IsObject()) {
+			*error = "Option 'loudness' must be an object";
+			return false;
+		}
+		Napi::Object loudness = v.As<Napi::Object>();
+		LoudnessConfig& c = out->loudness;
+		if (!ReadFloatOption(loudness, "targetLufs", -40.0f, -5.0f, &c.targetLufs, error)) return false;
+		if (!ReadFloatOption(loudness, "gateLufs", -70.0f, -20.0f, &c.gateLufs, error)) return false;
+		if (!ReadFloatOption(loudness, "maxGainDb", 0.0f, 30.0f, &c.maxGainDb, error)) return false;
+		if (!ReadFloatOption(loudness, "ceilingDb", -20.0f, 0.0f, &c.ceilingDb, error)) return false;
+		if (!ReadUint32Option(loudness, "lookaheadMs", 1, 20, &c.lookaheadMs, error)) return false;
+		c.enabled = true;
+	}
+
+	if (obj.Has("denoise") && !obj.Get("denoise").IsUndefined()) {
+		Napi::Value v = obj.Get("denoise");
+		if (!v.IsObject()) {
+			*error = "Option 'denoise' must be an object";
+			return false;
+		}
+		Napi::Object denoise = v.As<Napi::Object>();
+		DenoiseConfig& c = out->denoise;
+		if (!ReadUint32Option(denoise, "budgetUs", 50, 10000, &c.budgetUs, error)) return false;
+		if (!ReadFloatOption(denoise, "floorDb", -40.0f, -3.0f, &c.floorDb, error)) return false;
+		c.enabled = true;
+	}
+
+	if (obj.Has("filterGraph") && !obj.Get("filterGraph").IsUndefined()) {
+		Napi::Value v = obj.Get("filterGraph");
+		if (!v.IsString()) {
+			*error = "Option 'filterGraph' must be a string";
+			return false;
+		}
+		out->filterGraph = v.As<Napi::String>().Utf8Value();
+	}
+
+	if (obj.Has("excludeSelf") && !obj.Get("excludeSelf").IsUndefined()) {
+		Napi::Value v = obj.Get("excludeSelf");
+		if (!v.IsBoolean()) {
+			*error = "Option 'excludeSelf' must be a boolean";
+			return false;
+		}
+		out->excludeSelf = v.As<Napi::Boolean>().Value();
+	}
+
+	if (obj.Has("dialogue") && !obj.Get("dialogue").IsUndefined()) {
+		Napi::Value v = obj.Get("dialogue");
+		if (!v.IsBoolean()) {
+			*error = "Option 'dialogue' must be a boolean";
+			return false;
+		}
+		out->dialogue = v.As<Napi::Boolean>().Value();
+	}
+
+	if (obj.Has("timestamps") && !obj.Get("timestamps").IsUndefined()) {
+		Napi::Value v = obj.Get("timestamps");
+		if (!v.IsBoolean()) {
+			*error = "Option 'timestamps' must be a boolean";
+			return false;
+		}
+		out->timestamps = v.As<Napi::Boolean>().Value();
+	}
+
+	if (obj.Has("batch") && !obj.Get("batch").IsUndefined()) {
+		Napi::Value v = obj.Get("batch");
+		if (!v.IsBoolean()) {
+			*error = "Option 'batch' must be a boolean";
+			return false;
+		}
+		out->batch = v.As<Napi::Boolean>().Value();
+	}
+
+	if (obj.Has("dtx") && !obj.Get("dtx").IsUndefined()) {
+		Napi::Value v = obj.Get("dtx");
+		if (v.IsBoolean()) {
+			out->dtx.enabled = v.As<Napi::Boolean>().Value();
+		} else if (v.IsObject()) {
+			Napi::Object dtx = v.As<Napi::Object>();
+			DtxConfig& c = out->dtx;
+			if (!ReadUint32Option(dtx, "hangoverMs", 100, 60000, &c.hangoverMs, error)) return false;
+			if (!ReadUint32Option(dtx, "prerollMs", 0, 1000, &c.prerollMs, error)) return false;
+			if (!ReadFloatOption(dtx, "thresholdDb", -90.0f, -10.0f, &c.thresholdDb, error)) return false;
+			c.enabled = true;
+		} else {
+			*error = "Option 'dtx' must be a boolean or an object";
+			return false;
+		}
+	}
+
+	int source = (int)out->source;
+	if (!ReadEnumOption(obj, "source", { "loopback", "microphone", "file" }, &source, error)) return false;
+	out->source = (CaptureSource)source;
+
+	if (obj.Has("file") && !obj.Get("file").IsUndefined()) {
+		Napi::Value v = obj.Get("file");
+		if (!v.IsString()) {
+			*error = "Option 'file' must be a string";
+			return false;
+		}
+		out->file = v.As<Napi::String>().Utf8Value();
+	}
+	if (out->source == CaptureSource::File && out->file.empty()) {
+		*error = "Source 'file' needs option 'file'";
+		return false;
+	}
+	int pace = (int)out->pace;
+	if (!ReadEnumOption(obj, "pace", { "realtime", "fast" }, &pace, error)) return false;
+	out->pace = (ReplayPace)pace;
+
+	if (obj.Has("inputDevice") && !obj.Get("inputDevice").IsUndefined()) {
+		Napi::Value v = obj.Get("inputDevice");
+		if (!v.IsString()) {
+			*error = "Option 'inputDevice' must be a string";
+			return false;
+		}
+		out->inputDevice = v.As<Napi::String>().Utf8Value();
+		for (char& c : out->inputDevice) {
+			if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+		}
+	}
+
+	if (obj.Has("outputDevice") && !obj.Get("outputDevice").IsUndefined()) {
+		Napi::Value v = obj.Get("outputDevice");
+		std::vector<Napi::Value> entries;
+		if (v.IsString()) {
+			entries.push_back(v);
+		} else if (v.IsArray()) {
+			Napi::Array list = v.As<Napi::Array>();
+			for (uint32_t i = 0; i < list.Length(); ++i) entries.push_back(list.Get(i));
+		}
+		if (entries.empty() || entries.size() > 8) {
+			*error = "Option 'outputDevice' must be a string or an array of 1 to 8 strings";
+			return false;
+		}
+		for (const Napi::Value& entry : entries) {
+			if (!entry.IsString() || entry.As<Napi::String>().Utf8Value().empty()) {
+				*error = "Option 'outputDevice' entries must be non-empty strings";
+				return false;
+			}
+			std::string device = entry.As<Napi::String>().Utf8Value();
+			for (char& c : device) {
+				if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+			}
+			out->outputDevices.push_back(device);
+		}
+		if (out->source != CaptureSource::Loopback || out->excludeSelf) {
+			*error = "Option 'outputDevice' needs source 'loopback' without excludeSelf";
+			return false;
+		}
+	}
+
+	int micMode = (int)out->micMode;
+	if (!ReadEnumOption(obj, "micMode", { "default", "raw" }, &micMode, error)) return false;
+	out->micMode = (MicMode)micMode;
+	int micRole = (int)out->micRole;
+	if (!ReadEnumOption(obj, "micRole", { "console", "communications" }, &micRole, error)) return false;
+	out->micRole = (MicRole)micRole;
+
+	if (obj.Has("echoCancel") && !obj.Get("echoCancel").IsUndefined()) {
+		Napi::Value v = obj.Get("echoCancel");
+		if (v.IsBoolean()) {
+			out->echo.enabled = v.As<Napi::Boolean>().Value();
+		} else if (v.IsObject()) {
+			if (!ReadUint32Option(v.As<Napi::Object>(), "tailMs", 32, 1000, &out->echo.tailMs, error)) return false;
+			out->echo.enabled = true;
+		} else {
+			*error = "Option 'echoCancel' must be a boolean or an object";
+			return false;
+		}
+		if (out->echo.enabled && out->source != CaptureSource::Microphone) {
+			*error = "Option 'echoCancel' needs source 'microphone'";
+			return false;
+		}
+	}
+
+	if (obj.Has("governor") && !obj.Get("governor").IsUndefined()) {
+		Napi::Value v = obj.Get("governor");
+		if (v.IsBoolean()) {
+			out->governor.enabled = v.As<Napi::Boolean>().Value();
+		} else if (v.IsObject()) {
+			Napi::Object governor = v.As<Napi::Object>();
+			GovernorConfig& c = out->governor;
+			if (!ReadFloatOption(governor, "highLoad", 0.05f, 1.0f, &c.highLoad, error)) return false;
+			if (!ReadFloatOption(governor, "lowLoad", 0.01f, 1.0f, &c.lowLoad, error)) return false;
+			if (!ReadUint32Option(governor, "holdMs", 250, 60000, &c.holdMs, error)) return false;
+			c.enabled = true;
+		} else {
+			*error = "Option 'governor' must be a boolean or an object";
+			return false;
+		}
+		if (out->governor.lowLoad >= out->governor.highLoad) {
+			*error = "Option 'governor' needs lowLoad below highLoad";
+			return false;
+		}
+	}
+
+	if (obj.Has("power") && !obj.Get("power").IsUndefined()) {
+		Napi::Value v = obj.Get("power");
+		PowerConfig& c = out->power;
+		c.ac = PowerProfile{ QualityLevel::Full, out->throttleMs, out->latency };
+		c.battery.throttleMs = std::max<uint32_t>(c.battery.throttleMs, out->throttleMs);
+		if (v.IsBoolean()) {
+			c.enabled = v.As<Napi::Boolean>().Value();
+		} else if (v.IsObject()) {
+			Napi::Object power = v.As<Napi::Object>();
+			for (const char* key : { "ac", "battery" }) {
+				if (!power.Has(key) || power.Get(key).IsUndefined()) continue;
+				if (!power.Get(key).IsObject()) {
+					*error = std::string("Option 'power.") + key + "' must be an object";
+					return false;
+				}
+				Napi::Object profile = power.Get(key).As<Napi::Object>();
+				PowerProfile& p = key[0] == 'a' ? c.ac : c.battery;
+				int quality = (int)p.quality;
+				if (!ReadEnumOption(profile, "quality", { "full", "light-resampler", "no-denoise", "sparse-features" }, &quality, error)) return false;
+				p.quality = (QualityLevel)quality;
+				if (!ReadUint32Option(profile, "throttleMs", 0, 1000, &p.throttleMs, error)) return false;
+				int latency = (int)p.latency;
+				if (!ReadEnumOption(profile, "latencyMode", { "default", "lowest", "powersave" }, &latency, error)) return false;
+				p.latency = (LatencyMode)latency;
+			}
+			c.enabled = true;
+		} else {
+			*error = "Option 'power' must be a boolean or an object";
+			return false;
+		}
+	}
+
+	if (obj.Has("idle") && !obj.Get("idle").IsUndefined()) {
+		Napi::Value v = obj.Get("idle");
+		if (v.IsBoolean()) {
+			out->idle.enabled = v.As<Napi::Boolean>().Value();
+		} else if (v.IsObject()) {
+			float minutes = out->idle.afterMs / 60000.0f;
+			if (!ReadFloatOption(v.As<Napi::Object>(), "minutes", 0.05f, 1440.0f, &minutes, error)) return false;
+			out->idle.afterMs = (uint32_t)(minutes * 60000.0f);
+			out->idle.enabled = true;
+		} else {
+			*error = "Option 'idle' must be a boolean or an object";
+			return false;
+		}
+	}
+
+	if (obj.Has("history") && !obj.Get("history").IsUndefined()) {
+		Napi::Value v = obj.Get("history");
+		if (v.IsBoolean()) {
+			out->history.enabled = v.As<Napi::Boolean>().Value();
+		} else if (v.IsObject()) {
+			Napi::Object history = v.As<Napi::Object>();
+			HistoryConfig& c = out->history;
+			int codec = c.opus ? 1 : 0;
+			if (!ReadUint32Option(history, "seconds", 1, 3600, &c.seconds, error)) return false;
+			if (!ReadEnumOption(history, "codec", { "pcm16", "opus" }, &codec, error)) return false;
+			if (!ReadUint32Option(history, "bitrate", 6000, 64000, &c.bitrate, error)) return false;
+			c.opus = codec == 1;
+			c.enabled = true;
+		} else {
+			*error = "Option 'history' must be a boolean or an object";
+			return false;
+		}
+#if !defined(AUDIO_CORE_OPUS)
+		if (out->history.opus) {
+			*error = "Option 'history' codec 'opus' is not built in (use_opus=0)";
+			return false;
+		}
+#endif
+	}
+
+	if (obj.Has("record") && !obj.Get("record").IsUndefined()) {
+		Napi::Value v = obj.Get("record");
+		if (!v.IsObject() || !v.As<Napi::Object>().Get("path").IsString()) {
+			*error = "Option 'record' must be an object with a string 'path'";
+			return false;
+		}
+		Napi::Object record = v.As<Napi::Object>();
+		RecordConfig& c = out->record;
+		c.path = record.Get("path").As<Napi::String>().Utf8Value();
+		if (c.path.empty()) {
+			*error = "Option 'record' path must not be empty";
+			return false;
+		}
+		int codec = (int)c.codec;
+		int stream = c.raw ? 1 : 0;
+		if (!ReadEnumOption(record, "codec", { "wav", "flac", "opus" }, &codec, error)) return false;
+		if (!ReadEnumOption(record, "stream", { "processed", "raw" }, &stream, error)) return false;
+		if (!ReadUint32Option(record, "segmentSeconds", 10, 86400, &c.segmentSeconds, error)) return false;
+		if (!ReadUint32Option(record, "bitrate", 6000, 128000, &c.bitrate, error)) return false;
+		c.codec = (RecordCodec)codec;
+		c.raw = stream == 1;
+		c.enabled = true;
+#if !defined(AUDIO_CORE_OPUS)
+		if (c.codec == RecordCodec::Opus) {
+			*error = "Option 'record' codec 'opus' is not built in (use_opus=0)";
+			return false;
+		}
+#endif
+	}
+
+	if (obj.Has("warmStart") && !obj.Get("warmStart").IsUndefined()) {
+		Napi::Value v = obj.Get("warmStart");
+		if (!v.IsObject() || !v.As<Napi::Object>().Get("path").IsString() || !v.As<Napi::Object>().Get("key").IsString()) {
+			*error = "Option 'warmStart' must be an object with string 'path' and 'key'";
+			return false;
+		}
+		Napi::Object warm = v.As<Napi::Object>();
+		WarmStartConfig& c = out->warmStart;
+		c.path = warm.Get("path").As<Napi::String>().Utf8Value();
+		c.key = warm.Get("key").As<Napi::String>().Utf8Value();
+		if (c.path.empty() || c.key.empty() || c.key.size() > 1024) {
+			*error = "Option 'warmStart' needs a path and a key of 1 to 1024 bytes";
+			return false;
+		}
+		c.enabled = true;
+	}
+
+	return true;
+}
+
+// Reads the optional options argument at info[index]. Throws a TypeError into JS
+// and returns false on invalid input.
+inline bool ReadCaptureOptionsArg(const Napi::CallbackInfo& info, size_t index, CaptureOptions* out) {
+	std::string error;
+	if (info.Length() > index && !ParseCaptureOptions(info[index], out, &error)) {
+		Napi::TypeError::New(info.Env(), error).ThrowAsJavaScriptException();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+// A capture's processed 16 kHz stream as a RenderSource, for a render
+// session's mixer (render_mixer.h): the user's own microphone, ducked under
+// TTS, on the virtual microphone. While a session has claimed it, the
+// capture thread (SubscriberFanout) writes every packet into a ring - the
+// first capture to write owns it until it ends, so concurrent captures never
+// interleave - and the
+// output's render thread reads it about kTargetMs behind the writer, upsampled
+// to 48 kHz by cubic interpolation. The read step is trimmed by a
+// DriftController on the fill level, so the capture and output clocks never
+// pull the delay away (drift_resampler.h). When the writer stops, the reader
+// plays silence and picks up again kTargetMs behind it.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "drift_resampler.h"
+#include "render_source.h"
+
+class CaptureReturn : public RenderSource {
+public:
+	static constexpr uint32_t kRate = 16000;
+	static constexpr uint32_t kOutRate = 48000; // kSoundboardRate
+	static constexpr size_t kCapacity = 16384;  // ~1 s
+	static constexpr size_t kWriteMargin = 4096; // slots the writer may be filling next
+	static constexpr double kTargetMs = 40.0;
+	static constexpr double kTargetSamples = kRate * kTargetMs / 1000.0;
+
+	// JS thread: one session at a time plays the capture.
+	bool Claim(const void* owner) {
+		const void* none = nullptr;
+		return owner_.compare_exchange_strong(none, owner, std::memory_order_acq_rel);
+	}
+	void Release(const void* owner) {
+		const void* expected = owner;
+		owner_.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+	}
+
+	// Capture thread; nothing is kept unless claimed.
+	void Write(const void* writer, const float* samples, size_t n, float gain) {
+		if (!owner_.load(std::memory_order_relaxed) || !Own(writer)) return;
+		const uint64_t start = written_.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < n; ++i) ring_[(start + i) & (kCapacity - 1)] = samples[i] * gain;
+		written_.store(start + n, std::memory_order_release);
+	}
+	// Capture thread: skipped digital silence keeps the stream continuous.
+	void WriteSilence(const void* writer, size_t n) {
+		if (!owner_.load(std::memory_order_relaxed) || !Own(writer)) return;
+		const uint64_t start = written_.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < n; ++i) ring_[(start + i) & (kCapacity - 1)] = 0.0f;
+		written_.store(start + n, std::memory_order_release);
+	}
+	// Capture thread, at capture end: another capture may write.
+	void EndWriter(const void* writer) {
+		const void* expected = writer;
+		writer_.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+	}
+
+	void Attach() override {
+		playing_ = false;
+		drift_.Configure(kRate / 100, 100.0, kRate * 0.1);
+	}
+	void Detach() override {}
+
+	void Render(float* out, size_t frames, uint32_t channels) override {
+		memset(out, 0, frames * channels * sizeof(float));
+		const uint64_t written = written_.load(std::memory_order_acquire);
+		const double target = (double)written - kTargetSamples;
+		if (!playing_) {
+			// Wait for kTargetMs queued, then start there
+			if (written < kTargetSamples || target < readIndex_) return;
+			playing_ = true;
+			drift_.Unlock();
+		}
+		if (!drift_.Update(target - readIndex_)) readIndex_ = std::max(readIndex_, target);
+		const double step = drift_.Step() * kRate / kOutRate;
+		if ((double)written - 3.0 < readIndex_ + step * (double)frames) {
+			playing_ = false; // ran dry: silence until the writer is ahead again
+			return;
+		}
+		const double oldest = (double)written - (double)(kCapacity - kWriteMargin);
+		if (readIndex_ < oldest) readIndex_ = target; // fell a ring behind
+		for (size_t i = 0; i < frames; ++i) {
+			const double whole = std::floor(readIndex_);
+			const uint64_t k = (uint64_t)whole;
+			const float v = HermiteAt(ring_[(k - 1) & (kCapacity - 1)], ring_[k & (kCapacity - 1)],
+			                          ring_[(k + 1) & (kCapacity - 1)], ring_[(k + 2) & (kCapacity - 1)], (float)(readIndex_ - whole));
+			out[i * channels] = v;
+			if (channels > 1) out[i * channels + 1] = v;
+			readIndex_ += step;
+		}
+	}
+
+private:
+	bool Own(const void* writer) {
+		const void* current = writer_.load(std::memory_order_acquire);
+		if (current == writer) return true;
+		return !current && writer_.compare_exchange_strong(current, writer, std::memory_order_acq_rel);
+	}
+
+	std::atomic<const void*> owner_{nullptr};
+	std::atomic<const void*> writer_{nullptr}; // the capture feeding the ring
+	float ring_[kCapacity] = {};
+	std::atomic<uint64_t> written_{0};
+	// Render thread
+	bool playing_ = false;
+	double readIndex_ = 0.0; // stream position of the next output sample
+	DriftController drift_;
+};
+
+// The captures' feed; SubscriberFanout writes it.
+inline CaptureReturn& SharedCaptureReturn() {
+	static CaptureReturn feed;
+	return feed;
+}
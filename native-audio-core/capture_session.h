@@ -0,0 +1,231 @@
+#pragma once
+
+// CaptureSession: a JS-owned loopback capture, so several apps (a meeting
+// client and a browser, say) can be captured at once and stopped one by one.
+//
+//   const session = new addon.CaptureSession();
+//   session.start(pid, callback, options?) -> boolean   (pid 0: system-wide)
+//   session.stop();
+//   session.getStats()          // same shape as the module-level getStats()
+//   session.setMinChunkMs(ms);
+//   session.getHistory(fromMs, toMs)  // option 'history' (capture_history.h)
+//   session.switchSource(pid | endpointId) -> boolean
+//   session.running             // read-only
+//
+// switchSource moves a running session to another app, render endpoint or
+// (source 'microphone') input device id. The new stream opens beside the old
+// one and takes over at a block boundary with a short crossfade
+// (source_switch.h); the back end - gate, noise floor, VAD, chunker, an
+// utterance in progress - carries on as it was. False leaves the session on
+// its old source.
+//
+// For push-to-talk a session can be armed instead of started:
+//
+//   session.arm(pid, callback, options?) -> boolean   (options.arm: { prerollMs, drainMs })
+//   session.beginDelivery();    // the pre-roll, then live audio
+//   session.endDelivery();      // back to the pre-roll once the utterance is out
+//   session.delivering          // read-only
+//
+// The device is opened and running from arm() on, so starting to talk costs
+// an atomic store instead of a device setup (delivery_gate.h).
+//
+// With option source: 'microphone' a session records an input device instead
+// (pid ignored), so mic audio reaches the main process without the renderer.
+//
+// Each instance owns its capture object: PCM channel (slot ring and tsfn),
+// back-end stages and counters; on Windows, captures with the same thread
+// options share one endpoint client and front end (see LoopbackEndpoint). The
+// module-level startCapture/stopCapture/getStats keep driving the addon's
+// default capture as before. subscribe() streams, capture-fed audio rings and
+// watchLevels meters are fed by the default capture only: one subscriber
+// written by two captures would get both streams interleaved, and the first
+// capture to stop would close it under the other. Sessions stop when stopped
+// or garbage collected, whichever comes first, and at the latest when their
+// environment (a worker_thread, say) tears down.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "addon_instance.h"
+#include "capture_history.h"
+#include "capture_options.h"
+#include "delivery_gate.h"
+#include "latency_histogram.h"
+#include "pcm_channel.h"
+#include "quality_governor.h"
+
+// One stage of getStats().timing.
+inline Napi::Object LatencySummaryToJs(Napi::Env env, const LatencySummary& s) {
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("count", Napi::Number::New(env, (double)s.count));
+	o.Set("meanUs", Napi::Number::New(env, s.meanUs));
+	o.Set("p50Us", Napi::Number::New(env, s.p50Us));
+	o.Set("p99Us", Napi::Number::New(env, s.p99Us));
+	o.Set("maxUs", Napi::Number::New(env, s.maxUs));
+	return o;
+}
+
+// getStats().quality (option 'governor').
+inline Napi::Object QualityStatsToJs(Napi::Env env, const QualityStats& s) {
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("level", Napi::String::New(env, QualityLevelName(s.level)));
+	o.Set("load", Napi::Number::New(env, s.load));
+	o.Set("steps", Napi::Number::New(env, (double)s.steps));
+	return o;
+}
+
+// An environment's running sessions, stopped at its teardown before Node
+// closes their tsfns (addon_instance.h). JS thread.
+template <typename Capture>
+struct RunningCaptures {
+	std::vector<Capture*> captures;
+	~RunningCaptures() { for (Capture* capture : captures) capture->Stop(); }
+
+	void Add(Capture* capture) {
+		if (std::find(captures.begin(), captures.end(), capture) == captures.end()) captures.push_back(capture);
+	}
+	void Remove(Capture* capture) {
+		captures.erase(std::remove(captures.begin(), captures.end(), capture), captures.end());
+	}
+};
+
+// Capture provides Start(pid, PcmTsfn, const CaptureOptions&) -> bool, Stop(),
+// Running(), SetMinChunkMs(ms), SetDelivery(open), Delivering(), History() and
+// SwitchSource(pid, endpointId) -> bool; StatsToJs formats its counters.
+template <typename Capture, Napi::Object (*StatsToJs)(Napi::Env, const Capture*)>
+class CaptureSessionWrap : public Napi::ObjectWrap<CaptureSessionWrap<Capture, StatsToJs>> {
+public:
+	static void Init(Napi::Env env, Napi::Object exports) {
+		Napi::Function ctor = CaptureSessionWrap::DefineClass(env, "CaptureSession", {
+			CaptureSessionWrap::InstanceMethod("start", &CaptureSessionWrap::Start),
+			CaptureSessionWrap::InstanceMethod("arm", &CaptureSessionWrap::Arm),
+			CaptureSessionWrap::InstanceMethod("beginDelivery", &CaptureSessionWrap::BeginDelivery),
+			CaptureSessionWrap::InstanceMethod("endDelivery", &CaptureSessionWrap::EndDelivery),
+			CaptureSessionWrap::InstanceMethod("stop", &CaptureSessionWrap::Stop),
+			CaptureSessionWrap::InstanceMethod("getStats", &CaptureSessionWrap::GetStats),
+			CaptureSessionWrap::InstanceMethod("setMinChunkMs", &CaptureSessionWrap::SetMinChunkMs),
+			CaptureSessionWrap::InstanceMethod("getHistory", &CaptureSessionWrap::GetHistory),
+			CaptureSessionWrap::InstanceMethod("switchSource", &CaptureSessionWrap::SwitchSource),
+			CaptureSessionWrap::InstanceAccessor("running", &CaptureSessionWrap::Running, nullptr),
+			CaptureSessionWrap::InstanceAccessor("delivering", &CaptureSessionWrap::Delivering, nullptr),
+		});
+		exports.Set("CaptureSession", ctor);
+	}
+
+	explicit CaptureSessionWrap(const Napi::CallbackInfo& info)
+		: Napi::ObjectWrap<CaptureSessionWrap>(info), capture_(std::make_unique<Capture>()) {}
+
+	~CaptureSessionWrap() { PerEnv<RunningCaptures<Capture>>(this->Env()).Remove(capture_.get()); }
+
+private:
+	// start(pid, callback, options?)
+	Napi::Value Start(const Napi::CallbackInfo& info) {
+		return StartCapture(info, false);
+	}
+
+	// arm(pid, callback, options?): started with delivery held
+	Napi::Value Arm(const Napi::CallbackInfo& info) {
+		return StartCapture(info, true);
+	}
+
+	Napi::Value StartCapture(const Napi::CallbackInfo& info, bool arm) {
+		Napi::Env env = info.Env();
+		if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsFunction()) {
+			Napi::TypeError::New(env, "PID and callback required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		CaptureOptions options;
+		options.feedSubscribers = false;
+		if (!ReadCaptureOptionsArg(info, 2, &options)) return env.Null();
+		if (arm && !ReadArmOptions(info, &options.arm)) return env.Null();
+		auto tsfn = CreatePcmTsfn(env, info[1].As<Napi::Function>(), options.ChannelConfig(16000));
+		const bool ok = capture_->Start(info[0].As<Napi::Number>().Uint32Value(), tsfn, options);
+		if (!ok) {
+			tsfn.Release(); // already running; the capture never took it
+		} else {
+			PerEnv<RunningCaptures<Capture>>(env).Add(capture_.get());
+			ArmTeardown(env);
+		}
+		return Napi::Boolean::New(env, ok);
+	}
+
+	// options.arm: { prerollMs, drainMs }
+	static bool ReadArmOptions(const Napi::CallbackInfo& info, ArmConfig* out) {
+		out->enabled = true;
+		if (info.Length() < 3 || !info[2].IsObject()) return true;
+		Napi::Object obj = info[2].As<Napi::Object>();
+		if (!obj.Has("arm") || obj.Get("arm").IsUndefined()) return true;
+		std::string error;
+		if (!obj.Get("arm").IsObject()) {
+			error = "Option 'arm' must be an object";
+		} else {
+			Napi::Object arm = obj.Get("arm").As<Napi::Object>();
+			if (ReadUint32Option(arm, "prerollMs", 0, 2000, &out->prerollMs, &error) &&
+			    ReadUint32Option(arm, "drainMs", 0, 10000, &out->drainMs, &error)) return true;
+		}
+		Napi::TypeError::New(info.Env(), error).ThrowAsJavaScriptException();
+		return false;
+	}
+
+	Napi::Value BeginDelivery(const Napi::CallbackInfo& info) {
+		capture_->SetDelivery(true);
+		return info.Env().Undefined();
+	}
+
+	Napi::Value EndDelivery(const Napi::CallbackInfo& info) {
+		capture_->SetDelivery(false);
+		return info.Env().Undefined();
+	}
+
+	Napi::Value Stop(const Napi::CallbackInfo& info) {
+		capture_->Stop();
+		PerEnv<RunningCaptures<Capture>>(info.Env()).Remove(capture_.get());
+		return info.Env().Undefined();
+	}
+
+	Napi::Value GetStats(const Napi::CallbackInfo& info) {
+		return StatsToJs(info.Env(), capture_.get());
+	}
+
+	Napi::Value SetMinChunkMs(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		if (info.Length() < 1 || !info[0].IsNumber()) {
+			Napi::TypeError::New(env, "Minimum chunk length (ms) required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		capture_->SetMinChunkMs(info[0].As<Napi::Number>().Uint32Value());
+		return env.Undefined();
+	}
+
+	Napi::Value GetHistory(const Napi::CallbackInfo& info) {
+		return QueueHistoryQuery(info, capture_->History());
+	}
+
+	// switchSource(pid | endpointId)
+	Napi::Value SwitchSource(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		if (info.Length() < 1 || !(info[0].IsNumber() || (info[0].IsString() && !info[0].As<Napi::String>().Utf8Value().empty()))) {
+			Napi::TypeError::New(env, "PID or endpoint id required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		const bool ok = info[0].IsNumber()
+			? capture_->SwitchSource(info[0].As<Napi::Number>().Uint32Value(), std::string())
+			: capture_->SwitchSource(0, info[0].As<Napi::String>().Utf8Value());
+		return Napi::Boolean::New(env, ok);
+	}
+
+	Napi::Value Running(const Napi::CallbackInfo& info) {
+		return Napi::Boolean::New(info.Env(), capture_->Running());
+	}
+
+	Napi::Value Delivering(const Napi::CallbackInfo& info) {
+		return Napi::Boolean::New(info.Env(), capture_->Delivering());
+	}
+
+	std::unique_ptr<Capture> capture_; // destroyed (and stopped) on GC
+};
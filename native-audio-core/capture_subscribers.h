@@ -0,0 +1,259 @@
+#pragma once
+
+// Named extra consumers of the running capture: subscribe(name, callback,
+// options) / unsubscribe(name). Each subscriber gets its own PcmChannel (format,
+// packet framing, throttle, VAD) fed from the capture's processed 16 kHz stream
+// after downmix, resampling and the voice chain, so those stages run once no
+// matter how many consumers there are. Subscribers asking for other
+// sampleRates take taps off one rate tree (rate_tree.h), whose half-band and
+// polyphase stages are shared between rates. Subscriptions outlive captures: a
+// subscriber keeps receiving packets from every capture started after it.
+// Capture-fed shared-memory rings (shm_audio_ring.h) and the render
+// sessions' capture return (capture_return.h) ride the same fanout.
+// The registry is process-wide: a capture started in one Node environment
+// feeds subscribers from all of them, and an environment's subscribers go
+// when it tears down.
+
+#include <napi.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "addon_instance.h"
+#include "capture_options.h"
+#include "capture_return.h"
+#include "pcm_channel.h"
+#include "pcm_packet_writer.h"
+#include "rate_tree.h"
+#include "resampler.h"
+#include "shm_audio_ring.h"
+
+struct CaptureSubscriber {
+	CaptureSubscriber(const std::string& subscriberName, uint32_t rate, const CaptureOptions& subscriberOptions, PcmTsfn subscriberTsfn, napi_env ownerEnv)
+		: name(subscriberName), sampleRate(rate), options(subscriberOptions), tsfn(subscriberTsfn), channel(tsfn.GetContext()), env(ownerEnv) {
+		channel->AddRef();
+	}
+	// Runs on whichever thread drops the last reference: the JS thread when no
+	// capture holds the subscriber, otherwise the capture thread.
+	~CaptureSubscriber() {
+		writer.Discard();
+		ClosePcmChannel(tsfn, channel);
+		tsfn.Release();
+		channel->Unref();
+	}
+
+	const std::string name;
+	const uint32_t sampleRate;
+	const CaptureOptions options;
+	PcmTsfn tsfn;
+	PcmChannel* const channel;
+	const napi_env env; // the environment tsfn calls into
+	PcmPacketWriter writer; // capture thread only
+};
+
+// JS thread adds and removes; the capture thread copies the list whenever the
+// generation moves.
+class SubscriberRegistry {
+public:
+	// Replaces any subscriber of the same name.
+	void Add(std::shared_ptr<CaptureSubscriber> subscriber) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto& existing : subscribers_) {
+			if (existing->name == subscriber->name) {
+				existing = std::move(subscriber);
+				generation_.fetch_add(1, std::memory_order_release);
+				return;
+			}
+		}
+		subscribers_.push_back(std::move(subscriber));
+		generation_.fetch_add(1, std::memory_order_release);
+	}
+
+	bool Remove(const std::string& name) {
+		std::shared_ptr<CaptureSubscriber> removed; // released after the lock
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (size_t i = 0; i < subscribers_.size(); ++i) {
+			if (subscribers_[i]->name != name) continue;
+			removed = std::move(subscribers_[i]);
+			subscribers_.erase(subscribers_.begin() + i);
+			generation_.fetch_add(1, std::memory_order_release);
+			return true;
+		}
+		return false;
+	}
+
+	// At env teardown: drops every subscriber whose callback lives in env.
+	void RemoveEnv(napi_env env) {
+		std::vector<std::shared_ptr<CaptureSubscriber>> removed; // released after the lock
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (size_t i = 0; i < subscribers_.size();) {
+			if (subscribers_[i]->env != env) { ++i; continue; }
+			removed.push_back(std::move(subscribers_[i]));
+			subscribers_.erase(subscribers_.begin() + i);
+		}
+		if (!removed.empty()) generation_.fetch_add(1, std::memory_order_release);
+	}
+
+	uint64_t Generation() const { return generation_.load(std::memory_order_acquire); }
+
+	void Snapshot(std::vector<std::shared_ptr<CaptureSubscriber>>* out, uint64_t* generation) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		*generation = generation_.load(std::memory_order_relaxed);
+		*out = subscribers_;
+	}
+
+private:
+	mutable std::mutex mutex_;
+	std::vector<std::shared_ptr<CaptureSubscriber>> subscribers_;
+	std::atomic<uint64_t> generation_{0};
+};
+
+inline SubscriberRegistry& CaptureSubscribers() {
+	static SubscriberRegistry registry;
+	return registry;
+}
+
+inline void RemoveEnvSubscribers(napi_env env) {
+	CaptureSubscribers().RemoveEnv(env);
+}
+
+// Capture-thread side: feeds every subscriber from the processed stream.
+class SubscriberFanout {
+public:
+	// At capture start. inRate is the processed stream's rate; maxWriteSamples
+	// sizes the per-subscriber pools and the rate tree's outputs.
+	void Configure(uint32_t inRate, ResamplerQuality quality, size_t maxWriteSamples) {
+		inRate_ = inRate;
+		maxWriteSamples_ = maxWriteSamples;
+		generation_ = ~0ull;
+		subscribers_.clear();
+		tree_.Configure(inRate, quality, maxWriteSamples);
+	}
+
+	// timeNs: capture time of samples[0] on the device clock (0 when unknown)
+	void Write(const float* samples, size_t count, uint64_t timeNs, float gain, bool* grew) {
+		skipping_ = false;
+		rings_.Write(samples, count, gain);
+		SharedCaptureReturn().Write(this, samples, count, gain);
+		if (CaptureSubscribers().Generation() != generation_) Refresh(grew);
+		if (subscribers_.empty()) return;
+		if (tree_.Reserve(count)) *grew = true;
+		tree_.Process(samples, count);
+		for (size_t i = 0; i < subscribers_.size(); ++i) {
+			CaptureSubscriber& sub = *subscribers_[i];
+			const int tap = tapOf_[i];
+			if (tap == RateTree::kRoot) {
+				sub.writer.Write(sub.tsfn, samples, count, timeNs, gain, grew);
+			} else if (tree_.Produced(tap) > 0) {
+				sub.writer.Write(sub.tsfn, tree_.Output(tap), tree_.Produced(tap), timeNs, gain, grew);
+			}
+		}
+	}
+
+	// Every subscriber's writer is Idle(), so silence can be skipped.
+	bool Idle() const {
+		for (const auto& sub : subscribers_) {
+			if (!sub->writer.Idle()) return false;
+		}
+		return true;
+	}
+
+	// Digital silence while Idle(): advances each subscriber's stream index at
+	// its own rate. The rings get nothing; the rate tree restarts from silence.
+	void Skip(size_t count, uint64_t timeNs, bool* grew) {
+		SharedCaptureReturn().WriteSilence(this, count);
+		if (CaptureSubscribers().Generation() != generation_) Refresh(grew);
+		tree_.Skip(count, !skipping_);
+		skipping_ = true;
+		for (size_t i = 0; i < subscribers_.size(); ++i) {
+			const int tap = tapOf_[i];
+			subscribers_[i]->writer.Skip(tap == RateTree::kRoot ? count : tree_.Produced(tap), timeNs);
+		}
+	}
+
+	// At capture end: drop partial packets and let JS have what is queued.
+	void Discard() {
+		for (auto& sub : subscribers_) {
+			sub->writer.Discard();
+			ClosePcmChannel(sub->tsfn, sub->channel);
+		}
+		subscribers_.clear();
+		tapOf_.clear();
+		tree_.Configure(inRate_, tree_.Quality(), maxWriteSamples_);
+		generation_ = ~0ull;
+		rings_.Clear();
+		SharedCaptureReturn().EndWriter(this);
+	}
+
+private:
+	// Subscription change: configure writers for new subscribers, keep the
+	// tree's stages (and their history) for rates still in use.
+	void Refresh(bool* grew) {
+		std::vector<std::shared_ptr<CaptureSubscriber>> previous;
+		previous.swap(subscribers_);
+		CaptureSubscribers().Snapshot(&subscribers_, &generation_);
+		for (auto& sub : subscribers_) {
+			bool known = false;
+			for (auto& old : previous) known = known || old == sub;
+			const size_t maxSamples = (size_t)((uint64_t)maxWriteSamples_ * sub->sampleRate / inRate_) + 2;
+			if (!known) sub->writer.Configure(sub->channel, sub->options.PacketSamples(sub->sampleRate), maxSamples, false);
+		}
+
+		std::vector<uint32_t> rates(subscribers_.size());
+		for (size_t i = 0; i < subscribers_.size(); ++i) rates[i] = subscribers_[i]->sampleRate;
+		tree_.Plan(rates, &tapOf_);
+		*grew = true;
+		// previous goes out of scope here; removed subscribers finish on this thread
+	}
+
+	uint32_t inRate_ = 16000;
+	size_t maxWriteSamples_ = 0;
+	uint64_t generation_ = ~0ull;
+	std::vector<std::shared_ptr<CaptureSubscriber>> subscribers_;
+	RateTree tree_;
+	std::vector<int> tapOf_; // per subscriber; RateTree::kRoot when it takes the stream as is
+	bool skipping_ = false;
+	AudioRingFanout rings_;
+};
+
+// subscribe(name, callback, options?) - options are the capture options that
+// shape a packet stream (format, frameMs, framesPerPacket, throttleMs,
+// delivery, overflow, queueDepth, vad, chunker, timestamps) plus sampleRate
+// (8000-48000, default 16000; 24000, the realtime API's rate, with format
+// 'realtime-append'). Callbacks follow the startCapture packet conventions.
+inline Napi::Value Subscribe(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsString() || !info[1].IsFunction()) {
+		Napi::TypeError::New(env, "Subscriber name and callback required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	CaptureOptions options;
+	if (!ReadCaptureOptionsArg(info, 2, &options)) return env.Null();
+	uint32_t sampleRate = options.format == SampleFormat::RealtimeAppend ? 24000 : 16000;
+	if (info.Length() > 2 && info[2].IsObject()) {
+		std::string error;
+		if (!ReadUint32Option(info[2].As<Napi::Object>(), "sampleRate", 8000, 48000, &sampleRate, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+	PcmTsfn tsfn = CreatePcmTsfn(env, info[1].As<Napi::Function>(), options.ChannelConfig(sampleRate));
+	tsfn.Unref(env); // a subscription alone never keeps the process alive
+	CaptureSubscribers().Add(std::make_shared<CaptureSubscriber>(info[0].As<Napi::String>().Utf8Value(), sampleRate, options, tsfn, env));
+	DetachAtTeardown<RemoveEnvSubscribers>(env);
+	return Napi::Boolean::New(env, true);
+}
+
+// unsubscribe(name) -> whether the subscriber existed.
+inline Napi::Value Unsubscribe(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Subscriber name required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	return Napi::Boolean::New(env, CaptureSubscribers().Remove(info[0].As<Napi::String>().Utf8Value()));
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+// Stall watchdog for a capture stream. A device stream can stop without
+// saying so: a WASAPI client whose event is never signalled again after a
+// driver hiccup, a HAL device that stops calling its IOProc when BlackHole
+// sleeps and wakes. Explicit invalidation already reopens the client; this
+// covers the streams that just go quiet while JS still thinks they are live.
+//
+// The endpoint thread reports the device frames it reads and, on every
+// wake-up, whether the device should be producing them right now (a
+// microphone or a HAL IO cycle always is; a WASAPI loopback only while the
+// endpoint is playing something, or while data waits unsignalled). Over
+// windows of stallMs - four device periods, at least kMinStallMs - a window
+// that read under a quarter of the frames it should have is a stall. Each
+// stall escalates one step per kStepMs window until frames flow again:
+//
+//   restart      - stop and start the same stream
+//   reinitialize - a new stream on the same device
+//   reactivate   - the device looked up and activated again, as after a loss
+//
+// then reactivates every kRetryMs for as long as it stays stalled, still
+// looking every kStepMs for the frames to come back. Every step, and the
+// recovery, is one { type: 'stall', step, stalledMs, sampleIndex } event
+// (pcm_channel.h); a stall caught at once is over in well under a second
+// without JS being involved.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+enum class StallStep { None, Restart, Reinitialize, Reactivate };
+
+inline const char* StallStepName(StallStep step) {
+	switch (step) {
+	case StallStep::Restart: return "restart";
+	case StallStep::Reinitialize: return "reinitialize";
+	case StallStep::Reactivate: return "reactivate";
+	default: return "recovered";
+	}
+}
+
+struct CaptureWatchdogStats {
+	uint64_t stalls = 0;            // stalls detected
+	uint64_t restarts = 0;
+	uint64_t reinitializations = 0;
+	uint64_t reactivations = 0;
+	uint64_t recovered = 0;         // stalls the frames came back from
+	double lastRecoveryMs = 0.0;    // the latest one: detected to flowing again
+};
+
+class CaptureWatchdog {
+public:
+	static constexpr uint32_t kMinStallMs = 150;
+	static constexpr uint32_t kStepMs = 150;    // each step's time to bring the frames back
+	static constexpr uint32_t kRetryMs = 2000;  // between reactivations once all three failed
+	static constexpr uint32_t kPollMs = 50;     // longest the endpoint thread should wait between polls
+
+	// Endpoint thread, whenever a stream starts with this rate and period; an
+	// escalation under way carries on from where it was.
+	void Configure(uint32_t rate, double periodMs, uint64_t nowMs) {
+		rate_ = rate;
+		stallMs_ = std::max<uint32_t>(kMinStallMs, (uint32_t)(periodMs * 4.0));
+		Rebase(nowMs);
+	}
+
+	// Endpoint thread, before a capture starts: clears the stats and any
+	// escalation left from the last one.
+	void Reset() {
+		step_ = StallStep::None;
+		recoveredPending_ = false;
+		stalls_ = 0;
+		restarts_ = 0;
+		reinitializations_ = 0;
+		reactivations_ = 0;
+		recovered_ = 0;
+		lastRecoveryMs_ = 0.0;
+	}
+
+	// Endpoint thread: device frames read.
+	void Delivered(uint64_t frames) { windowFrames_ += frames; }
+
+	// Endpoint thread, on every wake-up. Returns the step to take now, if any.
+	StallStep Poll(uint64_t nowMs, bool expecting) {
+		if (expecting) expectedMs_ += nowMs - lastPollMs_;
+		lastPollMs_ = nowMs;
+		if (nowMs - windowStartMs_ < (step_ == StallStep::None ? stallMs_ : kStepMs)) return StallStep::None;
+		const uint64_t expected = expectedMs_ * rate_ / 1000;
+		if (windowFrames_ * 4 >= expected) {
+			if (step_ != StallStep::None) {
+				recoveredMs_ = nowMs - stalledAtMs_;
+				recovered_.fetch_add(1, std::memory_order_relaxed);
+				lastRecoveryMs_.store((double)recoveredMs_, std::memory_order_relaxed);
+				step_ = StallStep::None;
+				recoveredPending_ = true;
+			}
+			Rebase(nowMs);
+			return StallStep::None;
+		}
+		if (step_ == StallStep::Reactivate && nowMs - stepAtMs_ < kRetryMs) {
+			Rebase(nowMs);
+			return StallStep::None;
+		}
+		stepAtMs_ = nowMs;
+		if (step_ == StallStep::None) {
+			stalledAtMs_ = nowMs;
+			stalls_.fetch_add(1, std::memory_order_relaxed);
+		}
+		step_ = step_ == StallStep::None ? StallStep::Restart
+		      : step_ == StallStep::Restart ? StallStep::Reinitialize : StallStep::Reactivate;
+		(step_ == StallStep::Restart ? restarts_ : step_ == StallStep::Reinitialize ? reinitializations_ : reactivations_)
+			.fetch_add(1, std::memory_order_relaxed);
+		Rebase(nowMs);
+		return step_;
+	}
+
+	// Endpoint thread: true once after frames came back, with the time since
+	// the stall was detected.
+	bool TakeRecovered(uint64_t* stalledMs) {
+		if (!recoveredPending_) return false;
+		recoveredPending_ = false;
+		*stalledMs = recoveredMs_;
+		return true;
+	}
+
+	// Endpoint thread: time since the current stall was detected, 0 when none is.
+	uint64_t StalledMs(uint64_t nowMs) const { return step_ == StallStep::None ? 0 : nowMs - stalledAtMs_; }
+
+	// Any thread.
+	CaptureWatchdogStats Stats() const {
+		CaptureWatchdogStats s;
+		s.stalls = stalls_.load(std::memory_order_relaxed);
+		s.restarts = restarts_.load(std::memory_order_relaxed);
+		s.reinitializations = reinitializations_.load(std::memory_order_relaxed);
+		s.reactivations = reactivations_.load(std::memory_order_relaxed);
+		s.recovered = recovered_.load(std::memory_order_relaxed);
+		s.lastRecoveryMs = lastRecoveryMs_.load(std::memory_order_relaxed);
+		return s;
+	}
+
+private:
+	void Rebase(uint64_t nowMs) {
+		windowStartMs_ = nowMs;
+		lastPollMs_ = nowMs;
+		windowFrames_ = 0;
+		expectedMs_ = 0;
+	}
+
+	// Endpoint thread
+	uint32_t rate_ = 48000;
+	uint32_t stallMs_ = kMinStallMs;
+	uint64_t windowStartMs_ = 0;
+	uint64_t lastPollMs_ = 0;
+	uint64_t windowFrames_ = 0;
+	uint64_t expectedMs_ = 0;  // of the window, spent expecting frames
+	StallStep step_ = StallStep::None;
+	uint64_t stalledAtMs_ = 0;
+	uint64_t stepAtMs_ = 0;
+	uint64_t recoveredMs_ = 0;
+	bool recoveredPending_ = false;
+	// Any thread
+	std::atomic<uint64_t> stalls_{0};
+	std::atomic<uint64_t> restarts_{0};
+	std::atomic<uint64_t> reinitializations_{0};
+	std::atomic<uint64_t> reactivations_{0};
+	std::atomic<uint64_t> recovered_{0};
+	std::atomic<double> lastRecoveryMs_{0.0};
+};
+
+// getStats().stalls
+inline Napi::Object CaptureWatchdogStatsToJs(Napi::Env env, const CaptureWatchdogStats& s) {
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("stalls", Napi::Number::New(env, (double)s.stalls));
+	o.Set("restarts", Napi::Number::New(env, (double)s.restarts));
+	o.Set("reinitializations", Napi::Number::New(env, (double)s.reinitializations));
+	o.Set("reactivations", Napi::Number::New(env, (double)s.reactivations));
+	o.Set("recovered", Napi::Number::New(env, (double)s.recovered));
+	o.Set("lastRecoveryMs", Napi::Number::New(env, s.lastRecoveryMs));
+	return o;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+// How hard an utterance chunk should be to transcribe, from what the packet
+// writer already measures frame by frame, so JS can route easy chunks to a
+// cheap or local recognizer and keep the expensive one for the rest. Every
+// chunk carries difficulty: { snrDb, speechRatio, lufs, clippingRatio,
+// musicProbability, score, level }.
+//
+//   snrDb            - mean power of the chunk's speech frames over its noise:
+//                      the mean of its non-speech frames, or, for a chunk that
+//                      is speech throughout, the stream's floor (decayed over
+//                      the non-speech frames of the chunks before). Measured
+//                      before the noise gate when the chain has its pre-gate
+//                      samples, since the gate would hide the very noise
+//   speechRatio      - share of the chunk's VAD frames called speech
+//   clippingRatio    - share of its samples at int16 full scale after the gain
+//   musicProbability - the content classifier's (option 'content'), else a
+//                      guess from the pre-filter features: a steady pitch
+//                      (harmonic content) without the syllable-rate amplitude
+//                      modulation of speech
+//   score            - 0 for clean, loud, unclipped speech up to 1: each of the
+//                      above adds a chance of trouble and the score is one
+//                      minus the chance of none (Score())
+//   level            - 'easy' below kEasyScore, 'hard' from kHardScore
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "spectral_features.h"
+
+struct ChunkDifficulty {
+	float snrDb = 0.0f;
+	float speechRatio = 0.0f;
+	float clippingRatio = 0.0f;
+	float musicProbability = 0.0f;
+	float score = 0.0f;
+};
+
+constexpr float kEasyScore = 0.3f;
+constexpr float kHardScore = 0.6f;
+
+inline const char* DifficultyLevelName(float score) {
+	return score < kEasyScore ? "easy" : score < kHardScore ? "moderate" : "hard";
+}
+
+class ChunkDifficultyMeter {
+public:
+	static constexpr float kMinSnrDb = -10.0f;
+	static constexpr float kMaxSnrDb = 60.0f;
+	static constexpr double kFloorDecay = 0.95; // per non-speech frame
+	static constexpr double kPowerFloor = 1e-10; // -100 dBFS
+
+	// Samples of the open VAD frame: x as measured (pre-gate when known) and
+	// quantized as the chunk stores them.
+	void Push(const float* x, size_t n, float gain, const int16_t* quantized) {
+		double energy = 0.0;
+		for (size_t i = 0; i < n; ++i) {
+			const double v = (double)x[i] * gain;
+			energy += v * v;
+			if (quantized[i] >= 32767 || quantized[i] <= -32767) ++clipped_;
+		}
+		frameEnergy_ += energy;
+		frameSamples_ += n;
+		samples_ += n;
+	}
+
+	// The open frame closed with this VAD decision.
+	void EndFrame(bool speech) {
+		if (frameSamples_ == 0) return;
+		const double power = frameEnergy_ / (double)frameSamples_;
+		if (speech) {
+			speechPower_ += power;
+			++speechFrames_;
+		} else {
+			noisePower_ += power;
+			++noiseFrames_;
+			floor_ = floorKnown_ ? kFloorDecay * floor_ + (1.0 - kFloorDecay) * power : power;
+			floorKnown_ = true;
+		}
+		frameEnergy_ = 0.0;
+		frameSamples_ = 0;
+	}
+
+	// The chunk just cut; music is the classifier's probability, or negative
+	// for a guess from its features. Starts the next chunk.
+	ChunkDifficulty Take(float lufs, const SpectralFeatures& features, float music) {
+		ChunkDifficulty d;
+		const uint64_t frames = speechFrames_ + noiseFrames_;
+		d.speechRatio = frames > 0 ? (float)speechFrames_ / (float)frames : 0.0f;
+		d.clippingRatio = samples_ > 0 ? (float)clipped_ / (float)samples_ : 0.0f;
+		d.snrDb = kMinSnrDb;
+		if (speechFrames_ > 0) {
+			const double noise = std::max(noiseFrames_ > 0 ? noisePower_ / (double)noiseFrames_ : floorKnown_ ? floor_ : 0.0, kPowerFloor);
+			const double signal = std::max(speechPower_ / (double)speechFrames_ - noise, kPowerFloor * 1e-2);
+			d.snrDb = std::clamp((float)(10.0 * std::log10(signal / noise)), kMinSnrDb, kMaxSnrDb);
+		}
+		d.musicProbability = music >= 0.0f ? music : GuessMusic(features);
+		d.score = Score(d, lufs);
+		Reset();
+		return d;
+	}
+
+	// The chunk's counts; the stream's noise floor stays.
+	void Reset() {
+		frameEnergy_ = speechPower_ = noisePower_ = 0.0;
+		frameSamples_ = 0;
+		samples_ = clipped_ = 0;
+		speechFrames_ = noiseFrames_ = 0;
+	}
+
+	void ResetStream() {
+		Reset();
+		floor_ = 0.0;
+		floorKnown_ = false;
+	}
+
+	// Each term is a chance the recognizer stumbles: noise below 25 dB SNR
+	// (certain at 5 dB), music, clipping (certain at 2% of samples), a level
+	// under -35 LUFS (certain at -50) and a chunk mostly not speech.
+	static float Score(const ChunkDifficulty& d, float lufs) {
+		const float terms[] = {
+			(25.0f - d.snrDb) / 20.0f,
+			d.musicProbability,
+			d.clippingRatio * 50.0f,
+			(-35.0f - lufs) / 15.0f,
+			(1.0f - d.speechRatio) * 0.5f,
+		};
+		float clean = 1.0f;
+		for (float t : terms) clean *= 1.0f - std::clamp(t, 0.0f, 1.0f);
+		return 1.0f - clean;
+	}
+
+private:
+	static float GuessMusic(const SpectralFeatures& f) {
+		const float steady = std::clamp((0.5f - f.modulationDepth) / 0.4f, 0.0f, 1.0f);
+		return std::clamp(f.harmonicContent, 0.0f, 1.0f) * steady;
+	}
+
+	double frameEnergy_ = 0.0;
+	size_t frameSamples_ = 0;
+	uint64_t samples_ = 0;
+	uint64_t clipped_ = 0;
+	double speechPower_ = 0.0, noisePower_ = 0.0; // sums of frame mean powers
+	uint64_t speechFrames_ = 0, noiseFrames_ = 0;
+	double floor_ = 0.0; // the stream's non-speech power, decayed
+	bool floorKnown_ = false;
+};
@@ -0,0 +1,314 @@
+#pragma once
+
+// Speech / music / noise discrimination (capture option "content") on the
+// capture's shared log-mel frames (log_mel.h), so chunks of music, game
+// effects or applause can be flagged or dropped before they are encoded or
+// uploaded, instead of WhisperPreFilter guessing from the JS features.
+//
+// Every 10 ms frame gives five measurements: its energy, spectral flux
+// against the previous frame, flatness across the 80 bands, band centroid and
+// the share of energy below 1 kHz. Every 100 ms the last second of them is
+// summarised into kContentFeatures statistics after Scheirer and Slaney
+// ("Construction and evaluation of a robust multifeature speech/music
+// discriminator"): the low-energy frame ratio and energy spread (syllabic
+// modulation), the mean and spread of the flux, the mean flatness, the
+// centroid's spread, the low-band share and the level. A gradient-boosted
+// tree ensemble turns them into one logit per class and a softmax into
+// probabilities. The built-in ensemble is a few hand-set stumps per class,
+// tuned on synthetic speech, music, white and pink noise and applause; a
+// trained one replaces it with option content.model.
+//
+// Model file, little-endian: "CCG1", three uint32 (features, which must be
+// kContentFeatures; classes, which must be 3; trees), a float32 base score
+// per class, then per tree a uint32 node count and its nodes as { int32
+// feature (-1 for a leaf), float32 threshold (the leaf's value), uint32 left,
+// uint32 right }; a sample goes left when feature < threshold. Tree t adds
+// to class t % 3 (speech, music, noise), as LightGBM and XGBoost lay out
+// multiclass ensembles.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log_mel.h"
+#include "mapped_file.h"
+
+enum class ContentClass { Speech, Music, Noise };
+constexpr uint32_t kContentClasses = 3;
+constexpr uint32_t kContentFeatures = 8;
+
+inline const char* ContentClassName(ContentClass c) {
+	switch (c) {
+	case ContentClass::Music: return "music";
+	case ContentClass::Noise: return "noise";
+	default: return "speech";
+	}
+}
+
+struct ContentModel {
+	struct Node {
+		int32_t feature = -1; // -1: leaf
+		float threshold = 0.0f; // a leaf's value
+		uint32_t left = 0, right = 0;
+	};
+	float base[kContentClasses] = {};
+	std::vector<std::vector<Node>> trees;
+
+	void Logits(const float* features, float* logits) const {
+		for (uint32_t c = 0; c < kContentClasses; ++c) logits[c] = base[c];
+		for (size_t t = 0; t < trees.size(); ++t) {
+			const std::vector<Node>& nodes = trees[t];
+			uint32_t i = 0;
+			while (nodes[i].feature >= 0) i = features[nodes[i].feature] < nodes[i].threshold ? nodes[i].left : nodes[i].right;
+			logits[t % kContentClasses] += nodes[i].threshold;
+		}
+	}
+
+	// JS thread (option parsing). Null with *error set when the file is not a
+	// model this classifier can run.
+	static std::shared_ptr<const ContentModel> Load(const std::string& path, std::string* error) {
+		MappedFile file;
+		if (!file.Open(path, error)) {
+			*error = "Content model: " + *error;
+			return nullptr;
+		}
+		const uint8_t* p = file.Data();
+		const uint8_t* end = p + file.Size();
+		auto fail = [&](const char* what) {
+			*error = std::string("Content model ") + path + ": " + what;
+			return nullptr;
+		};
+		auto u32 = [&]() {
+			const uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+			p += 4;
+			return v;
+		};
+		if (end - p < 4 + 3 * 4 + (ptrdiff_t)(kContentClasses * 4) || memcmp(p, "CCG1", 4) != 0) return fail("not a CCG1 file");
+		p += 4;
+		const uint32_t features = u32(), classes = u32(), trees = u32();
+		if (features != kContentFeatures || classes != kContentClasses || trees > 100000) return fail("unsupported dimensions");
+		auto model = std::make_shared<ContentModel>();
+		memcpy(model->base, p, sizeof(model->base)); // little-endian hosts only (x64, arm64)
+		p += sizeof(model->base);
+		model->trees.resize(trees);
+		for (std::vector<Node>& nodes : model->trees) {
+			if (end - p < 4) return fail("truncated trees");
+			const uint32_t count = u32();
+			if (count == 0 || (size_t)(end - p) / 16 < count) return fail("truncated trees");
+			nodes.resize(count);
+			for (Node& n : nodes) {
+				memcpy(&n.feature, p, 4);
+				memcpy(&n.threshold, p + 4, 4);
+				p += 8;
+				n.left = u32();
+				n.right = u32();
+				// Children only point forward, so every walk ends at a leaf
+				if (n.feature >= (int32_t)kContentFeatures || (n.feature >= 0 && (n.left >= count || n.right >= count))) {
+					return fail("malformed tree");
+				}
+			}
+			for (size_t i = 0; i < nodes.size(); ++i) {
+				if (nodes[i].feature >= 0 && (nodes[i].left <= i || nodes[i].right <= i)) return fail("malformed tree");
+			}
+		}
+		if (p != end) return fail("trailing bytes after the trees");
+		return model;
+	}
+
+	// One stump per (class, feature): value below the split, value above.
+	static std::shared_ptr<const ContentModel> BuiltIn() {
+		static const struct { ContentClass c; uint32_t feature; float split, below, above; } kStumps[] = {
+			{ ContentClass::Speech, 0, 0.20f, -0.8f, 0.9f },  // low-energy frames: pauses between syllables
+			{ ContentClass::Speech, 1, 5.0f, -0.6f, 0.6f },   // energy spread, dB
+			{ ContentClass::Speech, 5, 0.06f, -0.5f, 0.5f },  // centroid spread: vowels against fricatives
+			{ ContentClass::Speech, 3, 1.4f, -0.3f, 0.3f },   // flux spread: onsets
+			{ ContentClass::Music, 4, 0.1f, 0.9f, -0.6f },    // tonal: far from flat
+			{ ContentClass::Music, 0, 0.12f, 0.4f, -0.5f },   // no pauses
+			{ ContentClass::Music, 1, 4.0f, 0.3f, -0.4f },
+			{ ContentClass::Noise, 3, 0.9f, 0.6f, -0.6f },    // stationary...
+			{ ContentClass::Noise, 2, 2.0f, -0.5f, 0.6f },    // ...though every band fluctuates
+			{ ContentClass::Noise, 4, 0.2f, -0.8f, 0.8f },    // flat spectrum
+			{ ContentClass::Noise, 5, 0.06f, 0.3f, -0.3f },
+		};
+		auto model = std::make_shared<ContentModel>();
+		// One tree per class in turn, a zero leaf for classes without a stump left
+		std::vector<std::vector<Node>> perClass[kContentClasses];
+		for (const auto& s : kStumps) {
+			std::vector<Node> nodes(3);
+			nodes[0] = { (int32_t)s.feature, s.split, 1, 2 };
+			nodes[1].threshold = s.below;
+			nodes[2].threshold = s.above;
+			perClass[(int)s.c].push_back(std::move(nodes));
+		}
+		size_t rounds = 0;
+		for (const auto& trees : perClass) rounds = std::max(rounds, trees.size());
+		for (size_t r = 0; r < rounds; ++r) {
+			for (uint32_t c = 0; c < kContentClasses; ++c) {
+				model->trees.push_back(r < perClass[c].size() ? perClass[c][r] : std::vector<Node>(1));
+			}
+		}
+		return model;
+	}
+};
+
+struct ContentClassifierConfig {
+	bool enabled = false;
+	std::shared_ptr<const ContentModel> model; // option "model": path, loaded while parsing; the built-in one otherwise
+	float dropMusic = 0.0f; // chunks whose mean music probability reaches this are dropped; 0 keeps them
+	float dropNoise = 0.0f; // likewise for noise
+};
+
+// One 100 ms decision.
+struct ContentProbabilities {
+	float p[kContentClasses] = { 1.0f, 0.0f, 0.0f };
+};
+
+class ContentClassifier {
+public:
+	static constexpr uint32_t kSegmentFrames = 10;  // 100 ms of 10 ms hops
+	static constexpr uint32_t kContextFrames = 100; // statistics over the last second
+
+	// segments: decisions kept for Take(), about the longest chunk's worth.
+	void Configure(uint32_t sampleRate, const ContentClassifierConfig& config, size_t segments) {
+		model_ = nullptr;
+		if (!config.enabled || sampleRate != 16000) return;
+		model_ = config.model ? config.model : ContentModel::BuiltIn();
+		segments_.assign(std::max<size_t>(segments, 1), Segment());
+		// Band below which energy counts as low: the mel band centred nearest 1 kHz
+		const LogMelTables& t = MelTables();
+		lowBands_ = 0;
+		while (lowBands_ < LogMelTables::kBands && (t.first[lowBands_] + t.count[lowBands_] / 2) * 16000.0 / LogMelTables::kWindow < 1000.0) {
+			++lowBands_;
+		}
+		Reset(0);
+	}
+
+	bool Enabled() const { return model_ != nullptr; }
+
+	// Frames restart at stream frame `frame` (after a gap).
+	void Reset(uint64_t frame) {
+		frames_ = 0;
+		nextFrame_ = frame;
+		segmentCount_ = 0;
+		havePrev_ = false;
+	}
+
+	// Capture thread: stream frame k's kBands log-mel values, in order.
+	void PushFrame(uint64_t k, const float* logMel) {
+		if (k != nextFrame_) Reset(k);
+		nextFrame_ = k + 1;
+		FrameStats& f = context_[frames_ % kContextFrames];
+		float total = 0.0f, low = 0.0f, weighted = 0.0f, logSum = 0.0f, flux = 0.0f;
+		for (uint32_t b = 0; b < LogMelTables::kBands; ++b) {
+			const float e = std::pow(10.0f, logMel[b]);
+			total += e;
+			if (b < lowBands_) low += e;
+			weighted += e * (float)b;
+			logSum += logMel[b];
+			if (havePrev_) flux += std::fabs(logMel[b] - prev_[b]);
+		}
+		memcpy(prev_, logMel, sizeof(prev_));
+		havePrev_ = true;
+		const float mean = total / LogMelTables::kBands;
+		f.power = total;
+		f.flux = 10.0f * flux / LogMelTables::kBands; // dB
+		f.flatness = mean > 1e-10f ? std::pow(10.0f, logSum / LogMelTables::kBands) / mean : 1.0f;
+		f.centroid = total > 0.0f ? weighted / total / LogMelTables::kBands : 0.0f;
+		f.lowShare = total > 0.0f ? low / total : 0.0f;
+		if (++frames_ % kSegmentFrames == 0) Classify(k + 1 - kSegmentFrames);
+	}
+
+	// Decisions of the 100 ms segments starting in stream frames [from, to),
+	// three floats each, appended to *timeline; *mean gets their average.
+	// Segments cut off by a reset are not there.
+	void Take(uint64_t from, uint64_t to, std::vector<float>* timeline, ContentProbabilities* mean) const {
+		timeline->clear();
+		float sum[kContentClasses] = {};
+		size_t count = 0;
+		const size_t kept = std::min(segmentCount_, segments_.size());
+		for (size_t i = segmentCount_ - kept; i < segmentCount_; ++i) {
+			const Segment& s = segments_[i % segments_.size()];
+			if (s.frame < from || s.frame >= to) continue;
+			for (uint32_t c = 0; c < kContentClasses; ++c) {
+				timeline->push_back(s.probabilities.p[c]);
+				sum[c] += s.probabilities.p[c];
+			}
+			++count;
+		}
+		*mean = ContentProbabilities();
+		if (count > 0) {
+			for (uint32_t c = 0; c < kContentClasses; ++c) mean->p[c] = sum[c] / (float)count;
+		}
+	}
+
+	// Statistics behind the latest decision, for the bench.
+	const float* Features() const { return features_; }
+
+private:
+	struct FrameStats {
+		float power = 0.0f;
+		float flux = 0.0f;
+		float flatness = 1.0f;
+		float centroid = 0.0f;
+		float lowShare = 0.0f;
+	};
+
+	struct Segment {
+		uint64_t frame = 0; // first stream frame
+		ContentProbabilities probabilities;
+	};
+
+	void Classify(uint64_t firstFrame) {
+		const size_t n = std::min<size_t>(frames_, kContextFrames);
+		double power = 0.0, db = 0.0, db2 = 0.0, flux = 0.0, flux2 = 0.0, flat = 0.0, centroid = 0.0, centroid2 = 0.0, low = 0.0;
+		for (size_t i = 0; i < n; ++i) {
+			const FrameStats& f = context_[i];
+			const double d = 10.0 * std::log10(std::max(f.power, 1e-10f));
+			power += f.power;
+			db += d;
+			db2 += d * d;
+			flux += f.flux;
+			flux2 += (double)f.flux * f.flux;
+			flat += f.flatness;
+			centroid += f.centroid;
+			centroid2 += (double)f.centroid * f.centroid;
+			low += f.lowShare;
+		}
+		const double meanPower = power / n;
+		size_t quiet = 0;
+		for (size_t i = 0; i < n; ++i) quiet += context_[i].power < 0.5 * meanPower ? 1 : 0;
+		auto spread = [n](double sum, double sum2) { return (float)std::sqrt(std::max(0.0, sum2 / n - (sum / n) * (sum / n))); };
+		features_[0] = (float)quiet / (float)n;
+		features_[1] = spread(db, db2);
+		features_[2] = (float)(flux / n);
+		features_[3] = spread(flux, flux2);
+		features_[4] = (float)(flat / n);
+		features_[5] = spread(centroid, centroid2);
+		features_[6] = (float)(low / n);
+		features_[7] = (float)(10.0 * std::log10(std::max(meanPower, 1e-10)));
+
+		float logits[kContentClasses];
+		model_->Logits(features_, logits);
+		const float top = std::max({ logits[0], logits[1], logits[2] });
+		float sum = 0.0f;
+		Segment& s = segments_[segmentCount_++ % segments_.size()];
+		s.frame = firstFrame;
+		for (uint32_t c = 0; c < kContentClasses; ++c) sum += s.probabilities.p[c] = std::exp(logits[c] - top);
+		for (uint32_t c = 0; c < kContentClasses; ++c) s.probabilities.p[c] /= sum;
+	}
+
+	std::shared_ptr<const ContentModel> model_;
+	uint32_t lowBands_ = 0;
+	FrameStats context_[kContextFrames];
+	uint64_t frames_ = 0;    // since the last reset
+	uint64_t nextFrame_ = 0; // stream frame expected next
+	float prev_[LogMelTables::kBands] = {};
+	bool havePrev_ = false;
+	float features_[kContentFeatures] = {};
+	std::vector<Segment> segments_; // ring of the latest decisions
+	size_t segmentCount_ = 0;
+};
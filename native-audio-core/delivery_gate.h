@@ -0,0 +1,138 @@
+#pragma once
+
+// Armed captures (CaptureSession.arm(), capture_session.h) for push-to-talk:
+// the device stream is opened and running, but its 16 kHz blocks only go into
+// a pre-roll ring and the voice chain, VAD and delivery stay idle. JS flips
+// delivery on with beginDelivery() - one atomic store, no device setup - and
+// the next block delivers the pre-roll ahead of itself, so the words spoken
+// just before the key went down are not clipped. endDelivery() lets the chain
+// finish the utterance it is in (up to drainMs) before the capture holds
+// again; whatever is still open after that is dropped.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "memory_budget.h"
+#include "realtime_memory.h"
+
+struct ArmConfig {
+	bool enabled = false;
+	uint32_t prerollMs = 300; // captured audio delivered ahead of beginDelivery()
+	uint32_t drainMs = 500;   // the chain keeps running after endDelivery() until idle, at most this long
+};
+
+class DeliveryGate {
+public:
+	enum class Step {
+		Pass,  // run the block through the chain
+		Hold,  // the block went to the pre-roll; skip the chain
+		Open,  // run Preroll() through the chain, then the block
+		Close, // delivery just ended: drop what the chain still holds; the block went to the pre-roll
+	};
+
+	// Before the capture thread starts; the capture thread never allocates.
+	void Configure(const ArmConfig& config, uint32_t sampleRate) {
+		armed_ = config.enabled;
+		const size_t preroll = armed_ ? (size_t)sampleRate * config.prerollMs / 1000 : 0;
+		ring_.assign(preroll, 0.0f);
+		linear_.assign(preroll, 0.0f);
+		charge_.Set(2 * preroll * sizeof(float));
+		drainSamples_ = (uint64_t)sampleRate * config.drainMs / 1000;
+		sampleRate_ = sampleRate;
+		head_ = 0;
+		filled_ = 0;
+		prerollSamples_ = 0;
+		draining_ = 0;
+		delivering_ = false;
+		requested_.store(false, std::memory_order_relaxed);
+		opens_.store(0, std::memory_order_relaxed);
+	}
+
+	bool Armed() const { return armed_; }
+
+	// Any thread: beginDelivery() / endDelivery().
+	void Request(bool open) { requested_.store(open, std::memory_order_release); }
+	bool Requested() const { return requested_.load(std::memory_order_relaxed); }
+
+	// Times delivery has opened since Configure(); from the second on, the
+	// stream has a gap behind it.
+	uint64_t Opens() const { return opens_.load(std::memory_order_relaxed); }
+
+	// Capture thread, per block ahead of the chain. idle: the chain has no
+	// partial packet or utterance open (PcmPacketWriter::Idle()).
+	Step Admit(const float* samples, size_t count, bool idle) {
+		const bool open = requested_.load(std::memory_order_acquire);
+		if (delivering_) {
+			if (open) {
+				draining_ = 0;
+				return Step::Pass;
+			}
+			if (!idle && draining_ < drainSamples_) {
+				draining_ += count;
+				return Step::Pass;
+			}
+			delivering_ = false;
+			draining_ = 0;
+			Hold(samples, count);
+			return idle ? Step::Hold : Step::Close;
+		}
+		if (!open) {
+			Hold(samples, count);
+			return Step::Hold;
+		}
+		// Oldest pre-roll sample first; until the ring wraps it starts at 0
+		const size_t start = filled_ == ring_.size() ? head_ : 0;
+		memcpy(linear_.data(), ring_.data() + start, (filled_ - start) * sizeof(float));
+		memcpy(linear_.data() + filled_ - start, ring_.data(), start * sizeof(float));
+		prerollSamples_ = filled_;
+		head_ = 0;
+		filled_ = 0;
+		delivering_ = true;
+		opens_.fetch_add(1, std::memory_order_relaxed);
+		return Step::Open;
+	}
+
+	// After Step::Open: the pre-roll, writable, and when its first sample was
+	// captured given the block's time (0 when unknown).
+	float* Preroll() { return linear_.data(); }
+	size_t PrerollSamples() const { return prerollSamples_; }
+	uint64_t PrerollNs(uint64_t blockNs) const {
+		const uint64_t ns = (uint64_t)prerollSamples_ * 1000000000ull / sampleRate_;
+		return blockNs > ns ? blockNs - ns : 0;
+	}
+
+private:
+	void Hold(const float* samples, size_t count) {
+		const size_t size = ring_.size();
+		if (size == 0) return;
+		if (count >= size) {
+			memcpy(ring_.data(), samples + count - size, size * sizeof(float));
+			head_ = 0;
+			filled_ = size;
+			return;
+		}
+		const size_t first = std::min(count, size - head_);
+		memcpy(ring_.data() + head_, samples, first * sizeof(float));
+		memcpy(ring_.data(), samples + first, (count - first) * sizeof(float));
+		head_ = (head_ + count) % size;
+		filled_ = std::min(size, filled_ + count);
+	}
+
+	bool armed_ = false;
+	RealtimeVector<float> ring_;   // capture thread: the latest prerollMs of the stream
+	RealtimeVector<float> linear_; // capture thread: the pre-roll in order, handed to the chain
+	size_t head_ = 0;           // next write; the oldest sample once the ring is full
+	size_t filled_ = 0;
+	size_t prerollSamples_ = 0;
+	uint64_t drainSamples_ = 0;
+	uint64_t draining_ = 0;
+	uint32_t sampleRate_ = 16000;
+	MemoryCharge charge_{ MemoryKind::Preroll };
+	bool delivering_ = false; // capture thread
+	std::atomic<bool> requested_{false};
+	std::atomic<uint64_t> opens_{0};
+};
@@ -0,0 +1,215 @@
+#pragma once
+
+// DeliveryStress: a backpressure harness for the PCM delivery path
+// (scripts/delivery-stress.js). A synthetic producer thread stands in for the
+// capture thread: every periodMs it writes a device period of 16 kHz samples
+// through a PcmPacketWriter into a real PcmChannel and ThreadSafeFunction, so
+// overflow policy, queue depth, throttling and delivery mode behave exactly as
+// in a capture, while the JS consumer stalls however the script tells it to.
+//
+//   const stress = new addon.DeliveryStress();
+//   stress.start(callback, options?) -> boolean
+//   stress.stop();
+//   stress.getStats() // { periods, overruns, occupancy, delivery }
+//   stress.running    // read-only
+//
+// options are capture options (overflow, queueDepth, throttleMs, frameMs,
+// framesPerPacket, format, delivery, timestamps) plus periodMs (producer
+// period, default 10), durationMs (default 10000) and wait. With wait the
+// producer holds off while the ring is half full, the way a BlockingCall
+// parks the capture thread; every device period it misses that way (or to
+// scheduling) counts as an overrun, audio the device would have lost. After
+// durationMs the callback gets { type: 'end' }. occupancy is the ring depth
+// seen after each push: { mean, p50, p99, max } in packets.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "capture_options.h"
+#include "latency_trace.h"
+#include "pcm_channel.h"
+#include "pcm_packet_writer.h"
+#include "thread_cpu.h"
+
+struct DeliveryStressConfig {
+	uint32_t periodMs = 10;
+	uint32_t durationMs = 10000;
+	bool wait = false;
+};
+
+class DeliveryStressProducer {
+public:
+	~DeliveryStressProducer() { Stop(); if (channel_) channel_->Unref(); }
+
+	bool Start(PcmTsfn tsfn, const CaptureOptions& options, const DeliveryStressConfig& config) {
+		if (running_) return false;
+		if (thread_.joinable()) thread_.join();
+		tsfn_ = tsfn;
+		if (channel_) channel_->Unref();
+		channel_ = tsfn_.GetContext();
+		channel_->AddRef();
+		config_ = config;
+		const size_t periodSamples = (size_t)16 * config.periodMs;
+		writer_.Configure(channel_, options.PacketSamples(16000), periodSamples, false);
+		samples_.assign(periodSamples, 0.0f);
+		occupancy_ = std::make_unique<std::atomic<uint64_t>[]>(channel_->Stats().capacity + 1);
+		depths_ = channel_->Stats().capacity + 1;
+		periods_ = 0;
+		overruns_ = 0;
+		running_ = true;
+		thread_ = std::thread([this] { Run(); });
+		return true;
+	}
+
+	void Stop() {
+		running_ = false;
+		if (thread_.joinable()) thread_.join();
+	}
+
+	bool Running() const { return running_; }
+
+	Napi::Object StatsToJs(Napi::Env env) {
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("periods", Napi::Number::New(env, (double)periods_.load(std::memory_order_relaxed)));
+		o.Set("overruns", Napi::Number::New(env, (double)overruns_.load(std::memory_order_relaxed)));
+		uint64_t total = 0, sum = 0, max = 0;
+		for (size_t d = 0; d < depths_; ++d) {
+			const uint64_t n = occupancy_[d].load(std::memory_order_relaxed);
+			total += n;
+			sum += n * d;
+			if (n) max = d;
+		}
+		auto percentile = [&](double p) {
+			const uint64_t rank = (uint64_t)std::ceil(p * (double)total);
+			uint64_t seen = 0;
+			for (size_t d = 0; d < depths_; ++d) {
+				seen += occupancy_[d].load(std::memory_order_relaxed);
+				if (seen >= rank) return (double)d;
+			}
+			return (double)max;
+		};
+		Napi::Object occupancy = Napi::Object::New(env);
+		occupancy.Set("mean", Napi::Number::New(env, total ? (double)sum / (double)total : 0.0));
+		occupancy.Set("p50", Napi::Number::New(env, total ? percentile(0.5) : 0.0));
+		occupancy.Set("p99", Napi::Number::New(env, total ? percentile(0.99) : 0.0));
+		occupancy.Set("max", Napi::Number::New(env, (double)max));
+		o.Set("occupancy", occupancy);
+		o.Set("delivery", DeliveryStatsToJs(env, channel_ ? channel_->Stats() : PcmDeliveryStats()));
+		return o;
+	}
+
+private:
+	// A periodic timeline like a device clock: periods the thread wakes up too
+	// late for are skipped and counted, not caught up on.
+	void Run() {
+		ThreadCpuScope cpu("delivery-stress");
+		using Clock = std::chrono::steady_clock;
+		const auto period = std::chrono::milliseconds(config_.periodMs);
+		const uint64_t total = config_.durationMs / config_.periodMs;
+		auto next = Clock::now();
+		uint64_t sample = 0;
+		bool grew = false;
+		for (uint64_t i = 0; running_ && i < total; ++i) {
+			while (config_.wait && running_ && channel_->Backlogged()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			const auto now = Clock::now();
+			if (now >= next + period) {
+				const uint64_t missed = (uint64_t)((now - next) / period);
+				overruns_.fetch_add(missed, std::memory_order_relaxed);
+				i += missed;
+				sample += missed * samples_.size();
+				next += period * missed;
+			}
+			// A quiet ramp; the content does not matter, only that it is fresh.
+			// Stamped like a device period that has just finished.
+			for (float& s : samples_) s = (float)(sample++ % 1600) / 16000.0f;
+			const uint64_t periodNs = (uint64_t)config_.periodMs * 1000000;
+			writer_.Write(tsfn_, samples_.data(), samples_.size(), DeviceClockNs() - periodNs, 1.0f, &grew);
+			occupancy_[std::min<size_t>(channel_->Queued(), depths_ - 1)].fetch_add(1, std::memory_order_relaxed);
+			periods_.fetch_add(1, std::memory_order_relaxed);
+			next += period;
+			std::this_thread::sleep_until(next);
+		}
+		writer_.Discard();
+		ClosePcmChannel(tsfn_, channel_, true);
+		tsfn_.Release();
+		running_ = false;
+	}
+
+	std::thread thread_;
+	std::atomic<bool> running_{false};
+	PcmTsfn tsfn_;
+	PcmChannel* channel_ = nullptr; // tsfn_ context; we hold a ref so stats outlive the run
+	DeliveryStressConfig config_;
+	PcmPacketWriter writer_;
+	std::vector<float> samples_;
+	std::unique_ptr<std::atomic<uint64_t>[]> occupancy_; // pushes per ring depth
+	size_t depths_ = 0;
+	std::atomic<uint64_t> periods_{0};
+	std::atomic<uint64_t> overruns_{0};
+};
+
+class DeliveryStressWrap : public Napi::ObjectWrap<DeliveryStressWrap> {
+public:
+	static void Init(Napi::Env env, Napi::Object exports) {
+		Napi::Function ctor = DefineClass(env, "DeliveryStress", {
+			InstanceMethod("start", &DeliveryStressWrap::Start),
+			InstanceMethod("stop", &DeliveryStressWrap::Stop),
+			InstanceMethod("getStats", &DeliveryStressWrap::GetStats),
+			InstanceAccessor("running", &DeliveryStressWrap::Running, nullptr),
+		});
+		exports.Set("DeliveryStress", ctor);
+	}
+
+	explicit DeliveryStressWrap(const Napi::CallbackInfo& info)
+		: Napi::ObjectWrap<DeliveryStressWrap>(info), producer_(std::make_unique<DeliveryStressProducer>()) {}
+
+private:
+	// start(callback, options?)
+	Napi::Value Start(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		if (info.Length() < 1 || !info[0].IsFunction()) {
+			Napi::TypeError::New(env, "Callback required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		CaptureOptions options;
+		if (!ReadCaptureOptionsArg(info, 1, &options)) return env.Null();
+		DeliveryStressConfig config;
+		if (info.Length() > 1 && info[1].IsObject()) {
+			Napi::Object obj = info[1].As<Napi::Object>();
+			std::string error;
+			if (!ReadUint32Option(obj, "periodMs", 1, 100, &config.periodMs, &error) ||
+			    !ReadUint32Option(obj, "durationMs", 100, 3600000, &config.durationMs, &error)) {
+				Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+				return env.Null();
+			}
+			config.wait = obj.Has("wait") && obj.Get("wait").ToBoolean().Value();
+		}
+		auto tsfn = CreatePcmTsfn(env, info[0].As<Napi::Function>(), options.ChannelConfig(16000));
+		const bool ok = producer_->Start(tsfn, options, config);
+		if (!ok) tsfn.Release();
+		return Napi::Boolean::New(env, ok);
+	}
+
+	Napi::Value Stop(const Napi::CallbackInfo& info) {
+		producer_->Stop();
+		return info.Env().Undefined();
+	}
+
+	Napi::Value GetStats(const Napi::CallbackInfo& info) {
+		return producer_->StatsToJs(info.Env());
+	}
+
+	Napi::Value Running(const Napi::CallbackInfo& info) {
+		return Napi::Boolean::New(info.Env(), producer_->Running());
+	}
+
+	std::unique_ptr<DeliveryStressProducer> producer_; // destroyed (and stopped) on GC
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+// Capture option "dialogue": emphasise speech over music and effects in the
+// downmix of a film or game, so the VAD and chunker stop opening on the
+// score. It takes the downmix's place (downmix.h) on the device format:
+//
+//   centre speaker (5.1, 7.1) - the plan keeps the centre channel (and the
+//                 front left/right of centre), where mixes put dialogue
+//   stereo      - the centre is extracted in the frequency domain: per bin,
+//                 the mid (L + R) / 2 is kept by how alike L and R are,
+//                 2 Re(L R*) / (|L|^2 + |R|^2) from spectra smoothed over
+//                 kSmoothing of a hop, squared and floored at kFloor
+//
+// The stereo extractor is a sqrt-Hann STFT of kFrameMs at 50% overlap (one
+// packed complex FFT analyses both channels, one resynthesises), so it adds
+// a frame of latency; a mono source has nothing to extract and passes through.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "downmix.h"
+#include "planar_frame.h"
+#include "spectral_features.h"
+
+class DialogueFocus {
+public:
+	static constexpr float kFrameMs = 21.0f;  // rounded up to a power of two of frames
+	static constexpr float kSmoothing = 0.6f; // of the previous hop's spectra
+	static constexpr float kFloor = 0.1f;     // -20 dB: what is off centre is lowered, not gated
+
+	enum class Mode { Off, CentreChannel, MidSide };
+
+	// Per stream, on the plan made for its format (channelMask as given to
+	// MakeDownmixPlan: 0 = the usual layout). With a centre speaker the plan's
+	// weights become the centre selection; stereo arms the extractor.
+	Mode Configure(bool enabled, DownmixPlan* plan, uint32_t channelMask, uint32_t rate) {
+		mode_ = Mode::Off;
+		if (!enabled || plan->channels < 2) return mode_;
+		uint32_t mask = channelMask ? channelMask : downmix_detail::DefaultChannelMask(plan->channels);
+		if (plan->channels > 2 && (mask & kSpeakerFrontCenter)) {
+			const size_t used = std::min<size_t>(plan->channels, kMaxDownmixChannels);
+			float total = 0.0f;
+			for (size_t c = 0; c < used; ++c) {
+				const uint32_t bit = mask & (~mask + 1);
+				mask &= mask - 1;
+				const float w = bit == kSpeakerFrontCenter ? 1.0f
+					: (bit == kSpeakerFrontLeftOfCenter || bit == kSpeakerFrontRightOfCenter) ? 0.7071f : 0.0f;
+				plan->weights[c] = w;
+				total += w;
+			}
+			for (size_t c = 0; c < used; ++c) plan->weights[c] /= total;
+			mode_ = Mode::CentreChannel;
+			return mode_;
+		}
+		if (plan->channels != 2) return mode_;
+		size_t frame = 2;
+		while ((float)frame * 1000.0f < kFrameMs * (float)rate) frame *= 2;
+		fft_.Configure(frame);
+		hop_ = frame / 2;
+		window_.resize(frame);
+		// Periodic sqrt-Hann: its square overlap-adds to one at half a frame
+		for (size_t n = 0; n < frame; ++n) window_[n] = std::sqrt(0.5f - 0.5f * std::cos(6.2831853f * (float)n / (float)frame));
+		ingest_.Configure(plan->type, 2);
+		split_.Configure(2, rate, hop_);
+		l_.assign(frame, 0.0f);
+		r_.assign(frame, 0.0f);
+		re_.assign(frame, 0.0f);
+		im_.assign(frame, 0.0f);
+		ola_.assign(frame, 0.0f);
+		ready_.assign(hop_, 0.0f);
+		powerL_.assign(frame / 2 + 1, 0.0f);
+		powerR_.assign(frame / 2 + 1, 0.0f);
+		cross_.assign(frame / 2 + 1, 0.0f);
+		Reset();
+		mode_ = Mode::MidSide;
+		return mode_;
+	}
+
+	Mode Current() const { return mode_; }
+
+	static const char* ModeName(Mode mode) {
+		return mode == Mode::CentreChannel ? "centre-channel" : mode == Mode::MidSide ? "mid-side" : "off";
+	}
+
+	// Frames of delay the stereo extractor adds.
+	size_t LatencyFrames() const { return mode_ == Mode::MidSide ? 2 * hop_ : 0; }
+
+	// A gap in the stream: the extractor starts over.
+	void Reset() {
+		std::fill(l_.begin(), l_.end(), 0.0f);
+		std::fill(r_.begin(), r_.end(), 0.0f);
+		std::fill(ola_.begin(), ola_.end(), 0.0f);
+		std::fill(ready_.begin(), ready_.end(), 0.0f);
+		std::fill(powerL_.begin(), powerL_.end(), 0.0f);
+		std::fill(powerR_.begin(), powerR_.end(), 0.0f);
+		std::fill(cross_.begin(), cross_.end(), 0.0f);
+		fill_ = 0;
+	}
+
+	// In place of plan.Run(src, frames, out).
+	void Run(const DownmixPlan& plan, const void* src, size_t frames, float* out) {
+		if (mode_ != Mode::MidSide) {
+			plan.Run(src, frames, out);
+			return;
+		}
+		const uint8_t* in = static_cast<const uint8_t*>(src);
+		const size_t stride = 2 * SampleBytes(plan.type);
+		while (frames > 0) {
+			// Up to the end of the hop: split, queue, and hand out what the last hop finished
+			const size_t n = std::min(frames, hop_ - fill_);
+			ingest_.Run(in, n, 0, &split_);
+			memcpy(l_.data() + hop_ + fill_, split_.Channel(0), n * sizeof(float));
+			memcpy(r_.data() + hop_ + fill_, split_.Channel(1), n * sizeof(float));
+			memcpy(out, ready_.data() + fill_, n * sizeof(float));
+			fill_ += n;
+			in += n * stride;
+			out += n;
+			frames -= n;
+			if (fill_ == hop_) {
+				Frame();
+				fill_ = 0;
+			}
+		}
+	}
+
+private:
+	void Frame() {
+		const size_t size = fft_.Size();
+		for (size_t n = 0; n < size; ++n) {
+			re_[n] = l_[n] * window_[n];
+			im_[n] = r_[n] * window_[n];
+		}
+		fft_.Forward(re_.data(), im_.data());
+		// z = l + i r: L[k] = (Z[k] + Z*[N-k]) / 2, R[k] = (Z[k] - Z*[N-k]) / 2i.
+		// The kept mid goes back as a Hermitian spectrum, conjugated, through
+		// the forward FFT: the real part is N times the frame.
+		for (size_t k = 0; k <= size / 2; ++k) {
+			const size_t m = (size - k) % size;
+			const float zr = re_[k], zi = im_[k], wr = re_[m], wi = im_[m];
+			const float lr = 0.5f * (zr + wr), li = 0.5f * (zi - wi);
+			const float rr = 0.5f * (zi + wi), ri = 0.5f * (wr - zr);
+			powerL_[k] = kSmoothing * powerL_[k] + (1.0f - kSmoothing) * (lr * lr + li * li);
+			powerR_[k] = kSmoothing * powerR_[k] + (1.0f - kSmoothing) * (rr * rr + ri * ri);
+			cross_[k] = kSmoothing * cross_[k] + (1.0f - kSmoothing) * (lr * rr + li * ri);
+			const float power = powerL_[k] + powerR_[k];
+			const float alike = power > 1e-12f ? std::max(0.0f, 2.0f * cross_[k] / power) : 0.0f;
+			const float g = 0.5f * std::max(kFloor, std::min(1.0f, alike * alike));
+			const float mr = g * (lr + rr), mi = g * (li + ri);
+			re_[k] = mr;
+			im_[k] = -mi;
+			re_[m] = mr;
+			im_[m] = mi;
+		}
+		fft_.Forward(re_.data(), im_.data());
+		const float scale = 1.0f / (float)size;
+		for (size_t n = 0; n < size; ++n) ola_[n] += re_[n] * scale * window_[n];
+		memcpy(ready_.data(), ola_.data(), hop_ * sizeof(float));
+		memmove(ola_.data(), ola_.data() + hop_, (size - hop_) * sizeof(float));
+		std::fill(ola_.begin() + (size - hop_), ola_.end(), 0.0f);
+		memmove(l_.data(), l_.data() + hop_, (size - hop_) * sizeof(float));
+		memmove(r_.data(), r_.data() + hop_, (size - hop_) * sizeof(float));
+	}
+
+	Mode mode_ = Mode::Off;
+	RadixTwoFft fft_;
+	size_t hop_ = 0;
+	size_t fill_ = 0; // frames of the current hop
+	PlanarIngest ingest_;      // the packet split once into left and right
+	PlanarFrame split_;
+	std::vector<float> window_;
+	std::vector<float> l_, r_;   // the last frame of input; the newest hop fills its second half
+	std::vector<float> re_, im_;
+	std::vector<float> ola_;     // overlap-add of the resynthesised frames
+	std::vector<float> ready_;   // the finished hop, handed out during the next
+	std::vector<float> powerL_, powerR_, cross_; // smoothed per bin
+};
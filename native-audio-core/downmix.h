@@ -0,0 +1,395 @@
+#pragma once
+
+// Interleaved multichannel PCM -> mono float [-1, 1] in one pass. The sample
+// conversion is fused into the load, channel weights come from the speaker
+// mask (LFE dropped, centre and surrounds at -3 dB, normalised to unity sum)
+// and the kernel is picked once per stream (simd.h dispatch): AVX2 or SSE2 on
+// x64, vDSP or NEON on macOS, scalar elsewhere or under AUDIO_CORE_ISA=scalar.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "simd.h"
+
+enum class PcmSampleType { Float32, Int16, Int24Packed, Int24In32, Int32 };
+
+inline size_t SampleBytes(PcmSampleType type) {
+	switch (type) {
+	case PcmSampleType::Int16: return 2;
+	case PcmSampleType::Int24Packed: return 3;
+	default: return 4;
+	}
+}
+
+// Speaker positions, same bit values as the WAVEFORMATEXTENSIBLE channel mask.
+enum : uint32_t {
+	kSpeakerFrontLeft = 0x1, kSpeakerFrontRight = 0x2, kSpeakerFrontCenter = 0x4,
+	kSpeakerLowFrequency = 0x8, kSpeakerBackLeft = 0x10, kSpeakerBackRight = 0x20,
+	kSpeakerFrontLeftOfCenter = 0x40, kSpeakerFrontRightOfCenter = 0x80,
+	kSpeakerBackCenter = 0x100, kSpeakerSideLeft = 0x200, kSpeakerSideRight = 0x400,
+};
+
+constexpr size_t kMaxDownmixChannels = 32; // channels beyond this get zero weight
+
+struct DownmixPlan;
+using DownmixKernel = void (*)(const DownmixPlan& plan, const uint8_t* src, size_t frames, float* out);
+
+struct DownmixPlan {
+	PcmSampleType type = PcmSampleType::Float32;
+	uint16_t channels = 1;
+	alignas(32) float weights[kMaxDownmixChannels] = {};
+	DownmixKernel kernel = nullptr;
+	const char* kernelName = "none";
+
+	void Run(const void* src, size_t frames, float* out) const {
+		kernel(*this, static_cast<const uint8_t*>(src), frames, out);
+	}
+};
+
+namespace downmix_detail {
+
+inline float Clamp1(float x) { return x > 1.0f ? 1.0f : (x < -1.0f ? -1.0f : x); }
+
+inline int32_t ReadInt24(const uint8_t* p) {
+	return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+}
+
+// Scalar loaders: sample idx of the interleaved stream as float.
+template <PcmSampleType T> inline float Load1(const uint8_t* src, size_t idx);
+template <> inline float Load1<PcmSampleType::Float32>(const uint8_t* src, size_t idx) {
+	float f; memcpy(&f, src + idx * 4, 4); return f;
+}
+template <> inline float Load1<PcmSampleType::Int16>(const uint8_t* src, size_t idx) {
+	int16_t s; memcpy(&s, src + idx * 2, 2); return (float)s * (1.0f / 32768.0f);
+}
+template <> inline float Load1<PcmSampleType::Int24Packed>(const uint8_t* src, size_t idx) {
+	return (float)ReadInt24(src + idx * 3) * (1.0f / 8388608.0f);
+}
+// 24-in-32 is left-justified, so it reads exactly like int32
+template <> inline float Load1<PcmSampleType::Int24In32>(const uint8_t* src, size_t idx) {
+	int32_t s; memcpy(&s, src + idx * 4, 4); return (float)s * (1.0f / 2147483648.0f);
+}
+template <> inline float Load1<PcmSampleType::Int32>(const uint8_t* src, size_t idx) {
+	int32_t s; memcpy(&s, src + idx * 4, 4); return (float)s * (1.0f / 2147483648.0f);
+}
+
+template <PcmSampleType T>
+void DownmixScalar(const DownmixPlan& plan, const uint8_t* src, size_t frames, float* out) {
+	const size_t ch = plan.channels;
+	const size_t used = std::min(ch, kMaxDownmixChannels);
+	for (size_t i = 0; i < frames; ++i) {
+		float sum = 0.0f;
+		for (size_t c = 0; c < used; ++c) sum += plan.weights[c] * Load1<T>(src, i * ch + c);
+		out[i] = Clamp1(sum);
+	}
+}
+
+#if defined(AUDIO_CORE_SSE)
+template <PcmSampleType T> inline __m128 Load4(const uint8_t* src, size_t idx);
+template <> inline __m128 Load4<PcmSampleType::Float32>(const uint8_t* src, size_t idx) {
+	return _mm_loadu_ps(reinterpret_cast<const float*>(src) + idx);
+}
+template <> inline __m128 Load4<PcmSampleType::Int16>(const uint8_t* src, size_t idx) {
+	__m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + idx * 2));
+	v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+	return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / 32768.0f));
+}
+template <> inline __m128 Load4<PcmSampleType::Int24Packed>(const uint8_t* src, size_t idx) {
+	const uint8_t* p = src + idx * 3;
+	__m128i v = _mm_setr_epi32(ReadInt24(p), ReadInt24(p + 3), ReadInt24(p + 6), ReadInt24(p + 9));
+	return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / 8388608.0f));
+}
+template <> inline __m128 Load4<PcmSampleType::Int32>(const uint8_t* src, size_t idx) {
+	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + idx * 4));
+	return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / 2147483648.0f));
+}
+template <> inline __m128 Load4<PcmSampleType::Int24In32>(const uint8_t* src, size_t idx) {
+	return Load4<PcmSampleType::Int32>(src, idx);
+}
+
+inline __m128 Clamp4(__m128 v) {
+	return _mm_max_ps(_mm_set1_ps(-1.0f), _mm_min_ps(_mm_set1_ps(1.0f), v));
+}
+
+inline float HorizontalSum(__m128 v) {
+	__m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+
+template <PcmSampleType T>
+void DownmixSse2(const DownmixPlan& plan, const uint8_t* src, size_t frames, float* out) {
+	const size_t ch = plan.channels;
+	size_t i = 0;
+	if (ch == 1) {
+		const __m128 w = _mm_set1_ps(plan.weights[0]);
+		for (; i + 4 <= frames; i += 4) _mm_storeu_ps(out + i, Clamp4(_mm_mul_ps(w, Load4<T>(src, i))));
+	} else if (ch == 2) {
+		const __m128 wl = _mm_set1_ps(plan.weights[0]);
+		const __m128 wr = _mm_set1_ps(plan.weights[1]);
+		for (; i + 4 <= frames; i += 4) {
+			__m128 a = Load4<T>(src, i * 2);
+			__m128 b = Load4<T>(src, i * 2 + 4);
+			__m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			_mm_storeu_ps(out + i, Clamp4(_mm_add_ps(_mm_mul_ps(wl, left), _mm_mul_ps(wr, right))));
+		}
+	} else if (ch <= kMaxDownmixChannels) {
+		// One frame at a time: groups of four channels, scalar tail
+		const size_t groups = ch / 4;
+		for (; i < frames; ++i) {
+			const size_t base = i * ch;
+			__m128 acc = _mm_setzero_ps();
+			for (size_t g = 0; g < groups; ++g)
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(plan.weights + g * 4), Load4<T>(src, base + g * 4)));
+			float sum = HorizontalSum(acc);
+			for (size_t c = groups * 4; c < ch; ++c) sum += plan.weights[c] * Load1<T>(src, base + c);
+			out[i] = Clamp1(sum);
+		}
+		return;
+	}
+	// Tail (or channel counts beyond the weight table)
+	if (i < frames) DownmixScalar<T>(plan, src + i * ch * SampleBytes(T), frames - i, out + i);
+}
+#endif
+
+#if defined(AUDIO_CORE_AVX2)
+template <PcmSampleType T> AUDIO_CORE_TARGET_AVX2 inline __m256 Load8(const uint8_t* src, size_t idx);
+template <> AUDIO_CORE_TARGET_AVX2 inline __m256 Load8<PcmSampleType::Float32>(const uint8_t* src, size_t idx) {
+	return _mm256_loadu_ps(reinterpret_cast<const float*>(src) + idx);
+}
+template <> AUDIO_CORE_TARGET_AVX2 inline __m256 Load8<PcmSampleType::Int16>(const uint8_t* src, size_t idx) {
+	__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + idx * 2)));
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(1.0f / 32768.0f));
+}
+template <> AUDIO_CORE_TARGET_AVX2 inline __m256 Load8<PcmSampleType::Int32>(const uint8_t* src, size_t idx) {
+	__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + idx * 4));
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(1.0f / 2147483648.0f));
+}
+template <> AUDIO_CORE_TARGET_AVX2 inline __m256 Load8<PcmSampleType::Int24In32>(const uint8_t* src, size_t idx) {
+	return Load8<PcmSampleType::Int32>(src, idx);
+}
+
+// Stereo and 8-channel fast paths; everything else goes through SSE2.
+template <PcmSampleType T>
+AUDIO_CORE_TARGET_AVX2 void DownmixAvx2(const DownmixPlan& plan, const uint8_t* src, size_t frames, float* out) {
+	const size_t ch = plan.channels;
+	const __m256 lo = _mm256_set1_ps(-1.0f), hi = _mm256_set1_ps(1.0f);
+	size_t i = 0;
+	if (ch == 2) {
+		const __m256 wl = _mm256_set1_ps(plan.weights[0]);
+		const __m256 wr = _mm256_set1_ps(plan.weights[1]);
+		for (; i + 8 <= frames; i += 8) {
+			__m256 a = Load8<T>(src, i * 2);
+			__m256 b = Load8<T>(src, i * 2 + 8);
+			// In-lane deinterleave, then fix the 128-bit lane order
+			__m256 left = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			__m256 right = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			left = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(left), _MM_SHUFFLE(3, 1, 2, 0)));
+			right = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(right), _MM_SHUFFLE(3, 1, 2, 0)));
+			__m256 m = _mm256_add_ps(_mm256_mul_ps(wl, left), _mm256_mul_ps(wr, right));
+			_mm256_storeu_ps(out + i, _mm256_max_ps(lo, _mm256_min_ps(hi, m)));
+		}
+	} else if (ch == 8) {
+		const __m256 w = _mm256_load_ps(plan.weights);
+		for (; i < frames; ++i) {
+			__m256 m = _mm256_mul_ps(w, Load8<T>(src, i * 8));
+			__m128 s = _mm_add_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+			out[i] = Clamp1(HorizontalSum(s));
+		}
+	}
+	if (i < frames) DownmixSse2<T>(plan, src + i * ch * SampleBytes(T), frames - i, out + i);
+}
+#endif
+
+#if defined(AUDIO_CORE_NEON)
+template <PcmSampleType T> inline float32x4_t Load4(const uint8_t* src, size_t idx);
+template <> inline float32x4_t Load4<PcmSampleType::Float32>(const uint8_t* src, size_t idx) {
+	return vld1q_f32(reinterpret_cast<const float*>(src) + idx);
+}
+template <> inline float32x4_t Load4<PcmSampleType::Int16>(const uint8_t* src, size_t idx) {
+	int32x4_t v = vmovl_s16(vld1_s16(reinterpret_cast<const int16_t*>(src) + idx));
+	return vmulq_n_f32(vcvtq_f32_s32(v), 1.0f / 32768.0f);
+}
+template <> inline float32x4_t Load4<PcmSampleType::Int24Packed>(const uint8_t* src, size_t idx) {
+	const uint8_t* p = src + idx * 3;
+	const int32_t s[4] = { ReadInt24(p), ReadInt24(p + 3), ReadInt24(p + 6), ReadInt24(p + 9) };
+	return vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(s)), 1.0f / 8388608.0f);
+}
+template <> inline float32x4_t Load4<PcmSampleType::Int32>(const uint8_t* src, size_t idx) {
+	return vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(reinterpret_cast<const int32_t*>(src) + idx)), 1.0f / 2147483648.0f);
+}
+template <> inline float32x4_t Load4<PcmSampleType::Int24In32>(const uint8_t* src, size_t idx) {
+	return Load4<PcmSampleType::Int32>(src, idx);
+}
+
+inline float32x4_t Clamp4(float32x4_t v) {
+	return vmaxq_f32(vdupq_n_f32(-1.0f), vminq_f32(vdupq_n_f32(1.0f), v));
+}
+
+template <PcmSampleType T>
+void DownmixNeon(const DownmixPlan& plan, const uint8_t* src, size_t frames, float* out) {
+	const size_t ch = plan.channels;
+	size_t i = 0;
+	if (ch == 1) {
+		for (; i + 4 <= frames; i += 4) vst1q_f32(out + i, Clamp4(vmulq_n_f32(Load4<T>(src, i), plan.weights[0])));
+	} else if (ch == 2) {
+		for (; i + 4 <= frames; i += 4) {
+			float32x4_t a = Load4<T>(src, i * 2);
+			float32x4_t b = Load4<T>(src, i * 2 + 4);
+			float32x4x2_t lr = vuzpq_f32(a, b);
+			float32x4_t m = vmlaq_n_f32(vmulq_n_f32(lr.val[0], plan.weights[0]), lr.val[1], plan.weights[1]);
+			vst1q_f32(out + i, Clamp4(m));
+		}
+	} else if (ch <= kMaxDownmixChannels) {
+		const size_t groups = ch / 4;
+		for (; i < frames; ++i) {
+			const size_t base = i * ch;
+			float32x4_t acc = vdupq_n_f32(0.0f);
+			for (size_t g = 0; g < groups; ++g)
+				acc = vmlaq_f32(acc, vld1q_f32(plan.weights + g * 4), Load4<T>(src, base + g * 4));
+			float sum = vaddvq_f32(acc);
+			for (size_t c = groups * 4; c < ch; ++c) sum += plan.weights[c] * Load1<T>(src, base + c);
+			out[i] = Clamp1(sum);
+		}
+		return;
+	}
+	if (i < frames) DownmixScalar<T>(plan, src + i * ch * SampleBytes(T), frames - i, out + i);
+}
+#endif
+
+template <PcmSampleType T>
+inline void SelectKernel(DownmixPlan* plan) {
+#if defined(AUDIO_CORE_ACCELERATE)
+	// vDSP unless AUDIO_CORE_ISA=scalar
+	if constexpr (T != PcmSampleType::Int24Packed) {
+		if (Cpu().best != CpuIsa::Scalar) {
+			plan->kernel = DownmixAccelerate<T>;
+			plan->kernelName = "vdsp";
+			return;
+		}
+	}
+#endif
+	IsaKernels<DownmixKernel> kernels;
+	kernels.With(CpuIsa::Scalar, DownmixScalar<T>);
+#if defined(AUDIO_CORE_SSE)
+	kernels.With(CpuIsa::Sse2, DownmixSse2<T>);
+#endif
+#if defined(AUDIO_CORE_AVX2)
+	if constexpr (T != PcmSampleType::Int24Packed) {
+		if (plan->channels == 2 || plan->channels == 8) kernels.With(CpuIsa::Avx2, DownmixAvx2<T>);
+	}
+#endif
+#if defined(AUDIO_CORE_NEON)
+	kernels.With(CpuIsa::Neon, DownmixNeon<T>);
+#endif
+	CpuIsa isa = CpuIsa::Scalar;
+	plan->kernel = kernels.Pick(&isa);
+	plan->kernelName = CpuIsaName(isa);
+}
+
+#if defined(AUDIO_CORE_ACCELERATE)
+// vDSP: one strided multiply-add per channel into out, converting integer
+// samples a chunk at a time.
+template <PcmSampleType T>
+void DownmixAccelerate(const DownmixPlan& plan, const uint8_t* src, size_t frames, float* out) {
+	const size_t ch = plan.channels;
+	const size_t used = std::min(ch, kMaxDownmixChannels);
+	const float lo = -1.0f, hi = 1.0f;
+	if constexpr (T == PcmSampleType::Float32) {
+		const float* in = reinterpret_cast<const float*>(src);
+		vDSP_vsmul(in, (vDSP_Stride)ch, &plan.weights[0], out, 1, frames);
+		for (size_t c = 1; c < used; ++c) vDSP_vsma(in + c, (vDSP_Stride)ch, &plan.weights[c], out, 1, out, 1, frames);
+	} else {
+		float converted[256];
+		for (size_t at = 0; at < frames; at += 256) {
+			const vDSP_Length n = (vDSP_Length)std::min<size_t>(256, frames - at);
+			float* dst = out + at;
+			for (size_t c = 0; c < used; ++c) {
+				float scale;
+				if constexpr (T == PcmSampleType::Int16) {
+					vDSP_vflt16(reinterpret_cast<const short*>(src) + at * ch + c, (vDSP_Stride)ch, converted, 1, n);
+					scale = plan.weights[c] * (1.0f / 32768.0f);
+				} else {
+					vDSP_vflt32(reinterpret_cast<const int*>(src) + at * ch + c, (vDSP_Stride)ch, converted, 1, n);
+					scale = plan.weights[c] * (1.0f / 2147483648.0f);
+				}
+				if (c == 0) vDSP_vsmul(converted, 1, &scale, dst, 1, n);
+				else vDSP_vsma(converted, 1, &scale, dst, 1, dst, 1, n);
+			}
+		}
+	}
+	vDSP_vclip(out, 1, &lo, &hi, out, 1, frames);
+}
+#endif
+
+inline float SpeakerWeight(uint32_t bit) {
+	switch (bit) {
+	case kSpeakerFrontLeft: case kSpeakerFrontRight:
+	case kSpeakerFrontLeftOfCenter: case kSpeakerFrontRightOfCenter:
+		return 1.0f;
+	case kSpeakerLowFrequency:
+		return 0.0f;
+	case kSpeakerFrontCenter: case kSpeakerBackLeft: case kSpeakerBackRight:
+	case kSpeakerBackCenter: case kSpeakerSideLeft: case kSpeakerSideRight:
+		return 0.7071f;
+	default:
+		return 0.5f; // top/height speakers
+	}
+}
+
+// Usual masks when the format doesn't carry one.
+inline uint32_t DefaultChannelMask(uint16_t channels) {
+	switch (channels) {
+	case 1: return kSpeakerFrontCenter;
+	case 2: return kSpeakerFrontLeft | kSpeakerFrontRight;
+	case 4: return kSpeakerFrontLeft | kSpeakerFrontRight | kSpeakerBackLeft | kSpeakerBackRight;
+	case 6: return kSpeakerFrontLeft | kSpeakerFrontRight | kSpeakerFrontCenter | kSpeakerLowFrequency |
+	               kSpeakerBackLeft | kSpeakerBackRight;
+	case 8: return kSpeakerFrontLeft | kSpeakerFrontRight | kSpeakerFrontCenter | kSpeakerLowFrequency |
+	               kSpeakerBackLeft | kSpeakerBackRight | kSpeakerSideLeft | kSpeakerSideRight;
+	default: return 0;
+	}
+}
+
+} // namespace downmix_detail
+
+// channelMask uses WAVEFORMATEXTENSIBLE bits; 0 picks the usual layout for the
+// channel count (or equal weights if there is none).
+inline DownmixPlan MakeDownmixPlan(PcmSampleType type, uint16_t channels, uint32_t channelMask) {
+	using namespace downmix_detail;
+	DownmixPlan plan;
+	plan.type = type;
+	plan.channels = channels ? channels : 1;
+	const size_t used = std::min<size_t>(plan.channels, kMaxDownmixChannels);
+	uint32_t mask = channelMask ? channelMask : DefaultChannelMask(plan.channels);
+
+	// Channels are stored in ascending speaker-bit order; unassigned ones get 1
+	float total = 0.0f;
+	for (size_t c = 0; c < used; ++c) {
+		float w = 1.0f;
+		if (mask) {
+			uint32_t bit = mask & (~mask + 1);
+			mask &= mask - 1;
+			w = SpeakerWeight(bit);
+		}
+		plan.weights[c] = w;
+		total += w;
+	}
+	if (total <= 0.0f) {
+		for (size_t c = 0; c < used; ++c) plan.weights[c] = 1.0f;
+		total = (float)used;
+	}
+	for (size_t c = 0; c < used; ++c) plan.weights[c] /= total;
+
+	switch (type) {
+	case PcmSampleType::Float32: SelectKernel<PcmSampleType::Float32>(&plan); break;
+	case PcmSampleType::Int16: SelectKernel<PcmSampleType::Int16>(&plan); break;
+	case PcmSampleType::Int24Packed: SelectKernel<PcmSampleType::Int24Packed>(&plan); break;
+	case PcmSampleType::Int24In32: SelectKernel<PcmSampleType::Int24In32>(&plan); break;
+	case PcmSampleType::Int32: SelectKernel<PcmSampleType::Int32>(&plan); break;
+	}
+	return plan;
+}
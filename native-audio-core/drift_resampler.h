@@ -0,0 +1,81 @@
+#pragma once
+
+// Asynchronous rate conversion between two device clocks. A consumer on one
+// clock (a microphone) reads a stream produced on another (the loopback of
+// the render endpoint) at a fractional position that advances by Step() per
+// sample instead of exactly one. DriftController steers that step with a PI
+// loop on the read position's error against where the device timestamps say
+// it should be, i.e. on the fill level the consumer should see in the
+// producer's ring. The proportional term absorbs timestamp jitter over a few
+// seconds, the integral term learns the clocks' rate offset (tens of ppm is
+// typical), so a session stays aligned for hours without the position ever
+// jumping; only errors past the resync threshold (a device change, a gap)
+// snap it back. Samples between ring positions come from a 4-point cubic
+// Hermite interpolator, transparent for 16 kHz speech.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Cubic Hermite (Catmull-Rom) through x0..x1 at t in [0, 1), with neighbours xm1 and x2.
+inline float HermiteAt(float xm1, float x0, float x1, float x2, float t) {
+	const float c1 = 0.5f * (x1 - xm1);
+	const float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+	const float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+	return ((c3 * t + c2) * t + c1) * t + x0;
+}
+
+class DriftController {
+public:
+	static constexpr double kMaxCorrection = 1e-3; // +-1000 ppm, well past real crystals
+
+	// blockSamples: samples read per Update(); settleBlocks: the proportional
+	// time constant, in blocks; resyncSamples: larger errors snap instead.
+	void Configure(size_t blockSamples, double settleBlocks, double resyncSamples) {
+		kp_ = 1.0 / ((double)blockSamples * settleBlocks);
+		ki_ = kp_ / (4.0 * settleBlocks); // critically damped-ish: the integral is 4x slower
+		resync_ = resyncSamples;
+		resyncs_ = 0;
+		Reset();
+	}
+
+	void Reset() {
+		integral_ = 0.0;
+		step_ = 1.0;
+		locked_ = false;
+	}
+
+	// error: target minus actual read position, in samples, before reading
+	// the next block. Returns false when the caller should jump to the target
+	// (first block, or the error is past the resync threshold).
+	bool Update(double error) {
+		if (!locked_ || std::fabs(error) > resync_) {
+			if (locked_) ++resyncs_;
+			integral_ = 0.0;
+			step_ = 1.0;
+			locked_ = true;
+			return false;
+		}
+		integral_ = std::clamp(integral_ + ki_ * error, -kMaxCorrection, kMaxCorrection);
+		step_ = 1.0 + std::clamp(kp_ * error + integral_, -kMaxCorrection, kMaxCorrection);
+		return true;
+	}
+
+	// Drop the lock (the reference went away); the next Update() resyncs.
+	void Unlock() { locked_ = false; }
+
+	// Read positions advanced per output sample.
+	double Step() const { return step_; }
+	// Learnt rate offset of the producer's clock against the consumer's.
+	double DriftPpm() const { return integral_ * 1e6; }
+	// Jumps while locked.
+	uint64_t Resyncs() const { return resyncs_; }
+
+private:
+	double kp_ = 0.0, ki_ = 0.0, resync_ = 0.0;
+	double integral_ = 0.0;
+	double step_ = 1.0;
+	bool locked_ = false;
+	uint64_t resyncs_ = 0;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+// setProcessingParams() / setVoiceBoostEnabled() / setVoiceBoostLevel()
+// exports shared by the capture addons, and the kernel ISA getStats() reports. The DSP headers they tune stay free of
+// N-API so they build on their own (bench/).
+
+#include <napi.h>
+
+#include <string>
+
+#include "capture_options.h"
+#include "processing_params.h"
+#include "simd.h"
+#include "voice_boost.h"
+
+// { active, detected: [...], override? }: the highest instruction set a
+// kernel may dispatch to (simd.h; kernels without such a variant take the
+// next one down) and what the CPU offers.
+inline Napi::Object CpuIsaToJs(Napi::Env env) {
+	const CpuDispatch& cpu = Cpu();
+	Napi::Object result = Napi::Object::New(env);
+	result.Set("active", Napi::String::New(env, CpuIsaName(cpu.best)));
+	Napi::Array detected = Napi::Array::New(env);
+	for (int i = 0; i < kCpuIsaCount; ++i) {
+		if (cpu.detected[i]) detected.Set(detected.Length(), Napi::String::New(env, CpuIsaName((CpuIsa)i)));
+	}
+	result.Set("detected", detected);
+	if (cpu.override) result.Set("override", Napi::String::New(env, cpu.override));
+	return result;
+}
+
+// setVoiceBoostEnabled(enabled)
+inline Napi::Value SetVoiceBoostEnabled(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsBoolean()) {
+		Napi::TypeError::New(env, "Voice boost enabled flag required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	VoiceBoost().SetEnabled(info[0].As<Napi::Boolean>().Value());
+	return env.Undefined();
+}
+
+// setVoiceBoostLevel(level) - makeup gain, 1..50 (1 = no boost)
+inline Napi::Value SetVoiceBoostLevel(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsNumber()) {
+		Napi::TypeError::New(env, "Voice boost level required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const double level = info[0].As<Napi::Number>().DoubleValue();
+	if (!(level >= 1 && level <= 50)) {
+		Napi::TypeError::New(env, "Voice boost level is out of range").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	VoiceBoost().SetLevel((float)level);
+	return env.Undefined();
+}
+
+// setProcessingParams({ highPassHz, highPassQ, gateRatio, gateEnvelopeMs,
+// gateFloorRiseMs, gateAttackMs, gateReleaseMs, boost }) - missing keys keep
+// their current value. Returns the parameters now in effect; with no argument
+// it only returns them.
+inline Napi::Value SetProcessingParams(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	ProcessingParamsStore& store = LiveProcessingParams();
+	ProcessingParams params = store.Current();
+	size_t count = 0;
+	const ProcessingParamField* fields = ProcessingParamFields(&count);
+	if (info.Length() > 0 && !info[0].IsUndefined()) {
+		if (!info[0].IsObject()) {
+			Napi::TypeError::New(env, "Processing parameters must be an object").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		Napi::Object obj = info[0].As<Napi::Object>();
+		std::string error;
+		for (size_t i = 0; i < count; ++i) {
+			if (!ReadFloatOption(obj, fields[i].key, fields[i].lo, fields[i].hi, &(params.*fields[i].member), &error)) {
+				Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+				return env.Null();
+			}
+		}
+		store.Publish(params);
+	}
+	Napi::Object out = Napi::Object::New(env);
+	for (size_t i = 0; i < count; ++i) out.Set(fields[i].key, Napi::Number::New(env, params.*fields[i].member));
+	return out;
+}
@@ -0,0 +1,403 @@
+#pragma once
+
+// Block DSP for the capture chain shared by both addons: high-pass, optional
+// spectral denoise (spectral_denoise.h), adaptive noise gate, then the loudness
+// normalizer (loudness.h), the voice_boost.h compressor or a fixed boost, each
+// over N samples at a time. With AUDIO_CORE_ACCELERATE the vectorisable stages
+// run on vDSP (NEON for the peak on other arm64 builds); the scalar versions
+// are the reference and the fallback. Corner,
+// gate and boost settings follow setProcessingParams() while running
+// (processing_params.h). The adaptive state can be saved and restored across
+// captures (dsp_warm_state.h). Quantization and WAV packing live in
+// pcm_quantize.h.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "filter_graph_stage.h"
+#include "loudness.h"
+#include "processing_params.h"
+#include "simd.h"
+#include "spectral_denoise.h"
+#include "voice_boost.h"
+
+inline float PeakMagnitudeScalar(const float* x, size_t n) {
+	float peak = 0.0f;
+	for (size_t i = 0; i < n; ++i) {
+		const float a = x[i] < 0 ? -x[i] : x[i];
+		if (a > peak) peak = a;
+	}
+	return peak;
+}
+
+inline float PeakMagnitude(const float* x, size_t n) {
+#if defined(AUDIO_CORE_ACCELERATE)
+	if (n == 0) return 0.0f;
+	float peak = 0.0f;
+	vDSP_maxmgv(x, 1, &peak, (vDSP_Length)n);
+	return peak;
+#elif defined(AUDIO_CORE_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+	float32x4_t m0 = vdupq_n_f32(0.0f), m1 = vdupq_n_f32(0.0f);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		m0 = vmaxq_f32(m0, vabsq_f32(vld1q_f32(x + i)));
+		m1 = vmaxq_f32(m1, vabsq_f32(vld1q_f32(x + i + 4)));
+	}
+	return std::max(vmaxvq_f32(vmaxq_f32(m0, m1)), PeakMagnitudeScalar(x + i, n - i));
+#elif defined(AUDIO_CORE_WASM_SIMD)
+	v128_t m0 = wasm_f32x4_splat(0.0f), m1 = wasm_f32x4_splat(0.0f);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		m0 = wasm_f32x4_pmax(m0, wasm_f32x4_abs(wasm_v128_load(x + i)));
+		m1 = wasm_f32x4_pmax(m1, wasm_f32x4_abs(wasm_v128_load(x + i + 4)));
+	}
+	m0 = wasm_f32x4_pmax(m0, m1);
+	const float lanes = std::max(std::max(wasm_f32x4_extract_lane(m0, 0), wasm_f32x4_extract_lane(m0, 1)),
+	                             std::max(wasm_f32x4_extract_lane(m0, 2), wasm_f32x4_extract_lane(m0, 3)));
+	return std::max(lanes, PeakMagnitudeScalar(x + i, n - i));
+#else
+	return PeakMagnitudeScalar(x, n);
+#endif
+}
+
+// One biquad section (a0 normalised to 1) filtering a block in place. State
+// carries across calls; Setup() resets it.
+class BlockBiquad {
+public:
+	BlockBiquad() = default;
+	BlockBiquad(const BlockBiquad&) = delete;
+	BlockBiquad& operator=(const BlockBiquad&) = delete;
+	~BlockBiquad() {
+#if defined(AUDIO_CORE_ACCELERATE)
+		if (setup_) vDSP_biquad_DestroySetup(setup_);
+#endif
+	}
+
+	void Setup(float b0, float b1, float b2, float a1, float a2) {
+		b0_ = b0; b1_ = b1; b2_ = b2; a1_ = a1; a2_ = a2;
+		x1_ = x2_ = y1_ = y2_ = 0.0f;
+#if defined(AUDIO_CORE_ACCELERATE)
+		if (setup_) vDSP_biquad_DestroySetup(setup_);
+		const double coefficients[5] = { b0, b1, b2, a1, a2 };
+		setup_ = vDSP_biquad_CreateSetup(coefficients, 1);
+		delay_[0] = delay_[1] = delay_[2] = delay_[3] = 0.0f;
+		retuned_ = false;
+#endif
+	}
+
+	void Setup(const BiquadCoefficients& k) { Setup(k.b0, k.b1, k.b2, k.a1, k.a2); }
+
+	// RBJ high-pass.
+	void SetupHighPass(float fs, float fc, float q = 0.7071f) { Setup(HighPassCoefficients(fs, fc, q)); }
+
+	// New coefficients, keeping the filter state so a running stream doesn't
+	// click. Never allocates: with vDSP the filter moves to the scalar kernel
+	// (carrying its delay line over) until the next Setup().
+	void Retune(const BiquadCoefficients& k) {
+		b0_ = k.b0; b1_ = k.b1; b2_ = k.b2; a1_ = k.a1; a2_ = k.a2;
+#if defined(AUDIO_CORE_ACCELERATE)
+		if (setup_ && !retuned_) {
+			x1_ = delay_[0]; x2_ = delay_[1]; y1_ = delay_[2]; y2_ = delay_[3];
+			retuned_ = true;
+		}
+#endif
+	}
+
+	void Process(float* x, size_t n) {
+#if defined(AUDIO_CORE_ACCELERATE)
+		if (setup_ && !retuned_) {
+			vDSP_biquad(setup_, delay_, x, 1, x, 1, (vDSP_Length)n);
+			return;
+		}
+#endif
+		ProcessScalar(x, n);
+	}
+
+	// Direct form I with the state held in locals, so fused loops can run the
+	// filter per sample: Load(), call per sample, Store(). Only a1 * y1 sits on
+	// the loop-carried path, half the latency of transposed form II.
+	struct Kernel {
+		float b0, b1, b2, a1, a2, x1, x2, y1, y2;
+		float operator()(float in) {
+			const float t = b0 * in + b1 * x1 + b2 * x2 - a2 * y2;
+			const float y = t - a1 * y1;
+			x2 = x1; x1 = in;
+			y2 = y1; y1 = y;
+			return y;
+		}
+	};
+	Kernel Load() const { return Kernel{ b0_, b1_, b2_, a1_, a2_, x1_, x2_, y1_, y2_ }; }
+	void Store(const Kernel& k) { x1_ = k.x1; x2_ = k.x2; y1_ = k.y1; y2_ = k.y2; }
+
+	// The reference for the vDSP path.
+	void ProcessScalar(float* x, size_t n) {
+		Kernel k = Load();
+		for (size_t i = 0; i < n; ++i) x[i] = k(x[i]);
+		Store(k);
+	}
+
+private:
+	float b0_ = 1.0f, b1_ = 0.0f, b2_ = 0.0f, a1_ = 0.0f, a2_ = 0.0f;
+	float x1_ = 0.0f, x2_ = 0.0f, y1_ = 0.0f, y2_ = 0.0f;
+#if defined(AUDIO_CORE_ACCELERATE)
+	vDSP_biquad_Setup setup_ = nullptr;
+	float delay_[4] = {}; // x[n-1], x[n-2], y[n-1], y[n-2]
+	bool retuned_ = false;
+#endif
+};
+
+// Adaptive noise gate: envelope follower, noise floor that drops fast and
+// rises slowly, soft-knee gain with fast attack and slower release. Control
+// runs once per kGateBlock samples (1 ms at 16 kHz, well inside the 5 ms
+// attack and 10 ms envelope): the envelope follows the sub-block's mean
+// magnitude and the gain is ramped linearly across it, so the only per-sample
+// recursion left is whatever pre() carries.
+class NoiseGate {
+public:
+	static constexpr size_t kGateBlock = 16;
+
+	// Defaults: 10 ms envelope, 500 ms noise floor rise, 5 ms attack, 50 ms
+	// release, threshold 2.5x the floor.
+	void Configure(float fs, const ProcessingParams& params = ProcessingParams()) {
+		SetTimings(GateTimingsFor(fs, params), params.gateRatio);
+		Reset();
+	}
+
+	// Live update; envelope, floor and gain carry on from where they are.
+	void SetTimings(const GateTimings& t, float ratio) {
+		aEnv_ = t.env;
+		aRise_ = t.rise;
+		aAtk_ = t.atk;
+		aRel_ = t.rel;
+		ratio_ = ratio;
+	}
+
+	void Reset() {
+		env_ = 0.0f;
+		noiseFloor_ = 0.003f; // ~-50 dBFS initial floor
+		gainSmooth_ = 1.0f;
+	}
+
+	// Warm start: the floor a previous capture converged to, with the envelope
+	// on it so the gate opens on the first speech rather than the first block.
+	float NoiseFloor() const { return noiseFloor_; }
+	void RestoreFloor(float floor) {
+		noiseFloor_ = env_ = std::min(std::max(floor, 1e-6f), 0.1f);
+	}
+
+	// Gates x in place and returns the peak magnitude of the output.
+	float Process(float* x, size_t n) {
+		PassThrough none;
+		return Process(x, n, none);
+	}
+
+	// Same, applying pre(sample) ahead of the envelope in the same pass. pre is
+	// copied into a local for the loop (so its state can't alias x and stays in
+	// registers) and written back at the end.
+	template <class Pre>
+	float Process(float* x, size_t n, Pre& preState) {
+		Pre pre = preState;
+		const Coefficients full = CoefficientsFor(kGateBlock);
+		float peak = 0.0f;
+		size_t at = 0;
+		// Constant trip count for the common case so the inner loops vectorise
+		for (; at + kGateBlock <= n; at += kGateBlock) peak = std::max(peak, Step(x + at, kGateBlock, full, pre));
+		if (at < n) peak = std::max(peak, Step(x + at, n - at, CoefficientsFor(n - at), pre));
+		preState = pre;
+		return peak;
+	}
+
+private:
+	struct PassThrough {
+		float operator()(float v) const { return v; }
+	};
+
+	// Per-sample coefficients raised to a sub-block of len samples.
+	struct Coefficients {
+		float env, rise, atk, rel;
+	};
+	Coefficients CoefficientsFor(size_t len) const {
+		const float l = (float)len;
+		return Coefficients{ powf(aEnv_, l), powf(aRise_, l), powf(aAtk_, l), powf(aRel_, l) };
+	}
+
+	// One sub-block: pre() and the magnitude sum per sample, then the control
+	// update, then the gain ramp and peak. Returns the peak.
+	template <class Pre>
+	float Step(float* block, size_t len, const Coefficients& c, Pre& pre) {
+		float sum = 0.0f;
+		for (size_t i = 0; i < len; ++i) {
+			const float y = pre(block[i]);
+			sum += y < 0 ? -y : y;
+			block[i] = y;
+		}
+		env_ = c.env * env_ + (1.0f - c.env) * (sum / (float)len);
+		if (env_ < noiseFloor_) noiseFloor_ = env_;
+		else noiseFloor_ = noiseFloor_ + (env_ - noiseFloor_) * (1.0f - c.rise);
+		if (noiseFloor_ < 1e-6f) noiseFloor_ = 1e-6f;
+		const float thr = noiseFloor_ * ratio_ + 1e-6f;
+		const float target = sqrtf((env_ > thr) ? 1.0f : (env_ / thr));
+		const float next = target + (gainSmooth_ - target) * (target < gainSmooth_ ? c.atk : c.rel);
+		const float gain = gainSmooth_, step = (next - gainSmooth_) / (float)len;
+		float peak = 0.0f;
+		for (size_t i = 0; i < len; ++i) {
+			const float y = block[i] * (gain + step * (float)(i + 1));
+			peak = std::max(peak, y < 0 ? -y : y);
+			block[i] = y;
+		}
+		gainSmooth_ = next;
+		return peak;
+	}
+
+	float aEnv_ = 0.0f, aRise_ = 0.0f, aAtk_ = 0.0f, aRel_ = 0.0f;
+	float ratio_ = 2.5f;
+	float env_ = 0.0f, noiseFloor_ = 0.003f, gainSmooth_ = 1.0f;
+};
+
+// VoiceChain::SaveState(): what the next capture on the endpoint starts from.
+struct VoiceChainState {
+	float gateFloor = 0.0f;          // NoiseGate, 0 when unknown
+	std::vector<float> denoiseNoise; // SpectralDenoiser noise power per bin; empty without option 'denoise'
+	float loudnessGain = 0.0f;       // LoudnessNormalizer makeup gain; 0 without option 'loudness'
+};
+
+// Mild voice boost (~+3.5 dB) limited so the block peak stays under 0.99.
+// Returns the gain for the quantizer.
+inline float VoiceBoostGainForPeak(float peak, float boost = 1.5f) {
+	if (peak < 1e-6f) return boost;
+	return (peak * boost > 0.99f) ? (0.99f / peak) : boost;
+}
+
+inline float VoiceBoostGain(const float* x, size_t n, float boost = 1.5f) {
+	return VoiceBoostGainForPeak(PeakMagnitude(x, n), boost);
+}
+
+// The full pre-quantization chain on 16 kHz mono: 90 Hz high-pass to remove
+// steady LF rumble (wind/fans), noise gate, then the boost/limiter gain. The
+// filter, gate and peak scan share one pass (the high-pass runs ahead on vDSP
+// when that is available); the limiter needs the whole block's peak, so
+// quantization with the returned gain is the only other pass. With loudness
+// normalization on, the normalizer and its limiter take the boost's place, and
+// while JS has the voice boost on its compressor does; the returned gain is
+// then unity. A "filterGraph" capture option (filter_graph_stage.h) replaces
+// the whole chain with a libavfilter graph, also at unity gain.
+class VoiceChain {
+public:
+	void Configure(float fs, const LoudnessConfig& loudness = LoudnessConfig(), const DenoiseConfig& denoise = DenoiseConfig(),
+	               const std::string& filterGraph = std::string()) {
+		fs_ = fs;
+		seen_ = 0;
+		pinned_ = false;
+		ProcessingBlock block = MakeProcessingBlock(ProcessingParams(), fs);
+		if (LiveProcessingParams().Read(&seen_, &block) && block.sampleRate != fs) block = MakeProcessingBlock(block.params, fs);
+		hpf_.Setup(block.highPass);
+		gate_.Configure(fs, block.params);
+		boostGain_ = block.params.boost;
+		denoise_.Configure(fs, denoise);
+		loudness_.Configure(fs, loudness);
+		boost_.Configure(fs);
+		graph_.Configure(fs, filterGraph);
+	}
+
+	// Filters x in place and returns the output gain. With preGate (room for n),
+	// the gate's input is copied there too; PreGateTapped() tells whether that
+	// copy times the returned gain is the output level with the gate held open.
+	float Process(float* x, size_t n, float* preGate = nullptr) {
+		if (!pinned_ && LiveProcessingParams().Read(&seen_, &pending_)) Retune(pending_);
+		tapped_ = false;
+		if (graph_.Enabled()) {
+			graph_.Process(x, n);
+			return 1.0f;
+		}
+#if defined(AUDIO_CORE_ACCELERATE)
+		hpf_.Process(x, n);
+		if (denoise_.Enabled()) denoise_.Process(x, n);
+		if (preGate) memcpy(preGate, x, n * sizeof(float));
+		const float peak = gate_.Process(x, n);
+#else
+		float peak;
+		if (denoise_.Enabled() || preGate) {
+			// The denoiser and the tap sit between the high-pass and the gate, so the fused kernel splits
+			hpf_.Process(x, n);
+			if (denoise_.Enabled()) denoise_.Process(x, n);
+			if (preGate) memcpy(preGate, x, n * sizeof(float));
+			peak = gate_.Process(x, n);
+		} else {
+			BlockBiquad::Kernel hpf = hpf_.Load();
+			peak = gate_.Process(x, n, hpf);
+			hpf_.Store(hpf);
+		}
+#endif
+		if (loudness_.Enabled()) {
+			loudness_.Process(x, n);
+			return 1.0f;
+		}
+		if (boost_.Process(x, n)) return 1.0f;
+		tapped_ = preGate != nullptr;
+		return VoiceBoostGainForPeak(peak, boostGain_);
+	}
+
+	// The last Process() filled preGate at the output's level: false under the
+	// filter graph, the loudness normalizer or the voice boost compressor.
+	bool PreGateTapped() const { return tapped_; }
+
+	// Delay added by the filter graph stage so far (0 without one).
+	float FilterGraphLatencyMs() const { return graph_.LatencyMs(); }
+
+	// Runs on params from now on instead of following setProcessingParams()
+	// (offline evaluation, dsp_eval.h).
+	void Pin(const ProcessingParams& params) {
+		pending_ = MakeProcessingBlock(params, fs_);
+		Retune(pending_);
+		pinned_ = true;
+	}
+
+	// Quality governor: option 'denoise' passes its input through while suspended.
+	void SuspendDenoise(bool suspended) { denoise_.Suspend(suspended); }
+
+	// The adaptive stages' converged state, for the next capture on the same
+	// endpoint (dsp_warm_state.h); RestoreState() right after Configure().
+	// Stages that are off leave their fields empty and ignore them.
+	VoiceChainState SaveState() const {
+		VoiceChainState state;
+		if (graph_.Enabled()) return state;
+		state.gateFloor = gate_.NoiseFloor();
+		denoise_.SaveNoise(&state.denoiseNoise);
+		state.loudnessGain = loudness_.Gain();
+		return state;
+	}
+
+	void RestoreState(const VoiceChainState& state) {
+		if (graph_.Enabled()) return;
+		if (state.gateFloor > 0.0f) gate_.RestoreFloor(state.gateFloor);
+		denoise_.RestoreNoise(state.denoiseNoise);
+		if (state.loudnessGain > 0.0f) loudness_.RestoreGain(state.loudnessGain);
+	}
+
+private:
+	// Block boundary: swap in published parameters (derived for the chain's rate
+	// on the JS thread; anything else is derived here, once per change).
+	void Retune(ProcessingBlock& block) {
+		if (block.sampleRate != fs_) block = MakeProcessingBlock(block.params, fs_);
+		hpf_.Retune(block.highPass);
+		gate_.SetTimings(block.gate, block.params.gateRatio);
+		boostGain_ = block.params.boost;
+	}
+
+	BlockBiquad hpf_;
+	SpectralDenoiser denoise_;
+	NoiseGate gate_;
+	LoudnessNormalizer loudness_;
+	VoiceBoostCompressor boost_;
+	FilterGraphStage graph_;
+	float fs_ = 16000.0f;
+	float boostGain_ = 1.5f;
+	bool tapped_ = false;
+	bool pinned_ = false;      // Pin(): live parameters ignored
+	uint64_t seen_ = 0;        // parameter version in effect
+	ProcessingBlock pending_;  // last block read
+};
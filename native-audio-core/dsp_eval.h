@@ -0,0 +1,393 @@
+#pragma once
+
+// Offline accuracy-vs-cost evaluation of DSP settings, so defaults are picked
+// on evidence: every file of a labelled corpus is replayed
+// (file_replay_source.h) through each configuration's front end, voice chain,
+// VAD and utterance chunker, every chunk is encoded for upload and
+// transcribed by the local Whisper engine, and the transcripts are scored
+// against the labels.
+//
+//   evaluateDsp({ corpus: [{ file, text }], configs: [{ name?, ...captureOptions, params?, upload? }],
+//                 language?, transcribe? })
+//     -> Promise<[{ name, files, audioMs, samples, chunks, uploadBytes, nsPerSample: { front, chain, encode, total },
+//                   words?, errors?, wer?, transcribeMs?, decoded?, transcribeError?, error? }]>
+//
+// A configuration takes the capture options that shape the stream
+// (resampler, vad, frameMs, chunker, loudness, denoise, filterGraph; vad
+// defaults to 'quality' at 20 ms frames, with the chunker on), params as for
+// setProcessingParams() (pinned for the run, so live tuning doesn't leak in)
+// and upload: { format: 'wav' | 'flac' | 'opus', bitrate? } (default opus
+// where built in, else wav). Timings are wall time on one threadpool thread
+// per 16 kHz sample; run with nothing else busy. WER is word-level
+// (lowercased, punctuation dropped) over the whole corpus, and needs
+// loadWhisperModel() first; without a model (transcribeError says so), or
+// with transcribe: false, only the costs come back. A file that can't be
+// replayed ends its configuration with error. Opus chunks are transcribed as
+// decoded (decoded: true) where libavcodec is built in, so the bitrate's loss
+// counts. Chunk overlap is transcribed twice, as uploads are. Needs
+// use_avformat=1.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "async_query.h"
+#include "audio_encoder.h"
+#include "capture_options.h"
+#include "downmix.h"
+#include "dsp_blocks.h"
+#include "file_replay_source.h"
+#include "pcm_quantize.h"
+#include "processing_params.h"
+#include "resampler.h"
+#include "stream_decoder.h"
+#include "utterance_chunker.h"
+#include "vad.h"
+#include "whisper_engine.h"
+
+constexpr uint32_t kEvalRate = 16000;
+
+struct DspEvalItem {
+	std::string file;
+	std::string text; // reference transcript
+};
+
+struct DspEvalConfig {
+	std::string name;
+	CaptureOptions capture;
+	ProcessingParams params;
+	AudioEncodeConfig upload;
+};
+
+struct DspEvalResult {
+	std::string name;
+	uint32_t files = 0;
+	uint64_t samples = 0; // 16 kHz, the replay tail included
+	uint64_t frontNs = 0, chainNs = 0, encodeNs = 0;
+	uint32_t chunks = 0;
+	uint64_t uploadBytes = 0;
+	bool transcribed = false;
+	bool decoded = false;
+	uint64_t words = 0;  // in the references
+	uint64_t errors = 0; // substitutions, insertions and deletions
+	double transcribeMs = 0;
+	std::string transcribeError; // why transcription stopped (e.g. no model loaded)
+	std::string error;
+};
+
+// Lowercased words with punctuation other than apostrophes dropped.
+inline std::vector<std::string> EvalWords(const std::string& text) {
+	std::vector<std::string> words;
+	std::string word;
+	for (unsigned char c : text) {
+		if (c >= 'A' && c <= 'Z') c = (unsigned char)(c - 'A' + 'a');
+		if (c >= 0x80 || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '\'') {
+			word.push_back((char)c);
+		} else if (!word.empty()) {
+			words.push_back(std::move(word));
+			word.clear();
+		}
+	}
+	if (!word.empty()) words.push_back(std::move(word));
+	return words;
+}
+
+// Word-level edit distance (Levenshtein over words), one row at a time.
+inline uint64_t WordErrors(const std::vector<std::string>& ref, const std::vector<std::string>& hyp) {
+	std::vector<uint64_t> row(hyp.size() + 1);
+	for (size_t j = 0; j <= hyp.size(); ++j) row[j] = j;
+	for (size_t i = 1; i <= ref.size(); ++i) {
+		uint64_t diagonal = row[0];
+		row[0] = i;
+		for (size_t j = 1; j <= hyp.size(); ++j) {
+			const uint64_t above = row[j];
+			row[j] = std::min({ above + 1, row[j - 1] + 1, diagonal + (ref[i - 1] == hyp[j - 1] ? 0 : 1) });
+			diagonal = above;
+		}
+	}
+	return row[hyp.size()];
+}
+
+inline uint64_t EvalElapsedNs(std::chrono::steady_clock::time_point since) {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+// One file through one configuration: chunks into *chunks, costs into *result.
+inline bool EvalReplay(const DspEvalItem& item, const DspEvalConfig& config, std::vector<std::vector<int16_t>>* chunks,
+                       DspEvalResult* result, std::string* error) {
+	FileReplaySource source;
+	if (!source.Open(item.file, error)) return false;
+	const CaptureOptions& o = config.capture;
+	const uint32_t inRate = source.SampleRate();
+	const size_t blockFrames = source.BlockFrames();
+	const DownmixPlan downmix = MakeDownmixPlan(PcmSampleType::Float32, source.Channels(), source.ChannelMask());
+	PolyphaseResampler resampler;
+	resampler.Configure(inRate, kEvalRate, o.resampler, blockFrames);
+	VoiceChain chain;
+	chain.Configure((float)kEvalRate, o.loudness, o.denoise, o.filterGraph);
+	chain.Pin(config.params);
+	const size_t frameSamples = (size_t)kEvalRate * o.frameMs / 1000;
+	VoiceActivityDetector vad;
+	vad.Configure((float)kEvalRate, frameSamples, o.vad);
+	UtteranceChunker chunker;
+	chunker.Configure(o.chunker, frameSamples, o.frameMs);
+
+	std::vector<float> block(blockFrames * source.Channels());
+	std::vector<float> mono(blockFrames);
+	std::vector<float> out(resampler.MaxOutput(blockFrames));
+	const uint64_t tailSamples = (uint64_t)kEvalRate * kReplayTailMs / 1000;
+	uint64_t tail = 0;
+	uint32_t speech = 0, frame = 0;
+	while (tail < tailSamples) {
+		auto start = std::chrono::steady_clock::now();
+		const size_t n = source.Read(block.data());
+		size_t m;
+		if (n > 0) {
+			downmix.Run(block.data(), n, mono.data());
+			m = resampler.Process(mono.data(), n, out.data());
+			result->frontNs += EvalElapsedNs(start);
+		} else {
+			// Silence flushes the chain and closes the last utterance
+			m = std::min<uint64_t>(kEvalRate / 100, tailSamples - tail);
+			std::fill(out.begin(), out.begin() + m, 0.0f);
+			tail += m;
+		}
+		start = std::chrono::steady_clock::now();
+		const float gain = chain.Process(out.data(), m);
+		const float* x = out.data();
+		for (size_t left = m; left > 0;) {
+			const size_t take = std::min(left, chunker.FrameRoom());
+			vad.Process(x, take, gain, &speech, &frame);
+			QuantizeToInt16(x, take, gain, chunker.Extend(take));
+			if (frame > 0) {
+				if (chunker.EndFrame((speech & 1) != 0, o.chunker.minChunkMs, (speech & 1) != 0 && vad.Voiced())) {
+					std::vector<int16_t> chunk(chunker.ChunkSamples());
+					chunker.TakeChunk(chunk.data());
+					chunks->push_back(std::move(chunk));
+				}
+				speech = frame = 0;
+			}
+			x += take;
+			left -= take;
+		}
+		result->chainNs += EvalElapsedNs(start);
+		result->samples += m;
+	}
+	return true;
+}
+
+// Transcript of one chunk as it would be uploaded: the encoded bytes decoded
+// again when they are Opus and libavcodec is built in.
+inline bool EvalTranscribe(const std::vector<int16_t>& chunk, const std::vector<uint8_t>& bytes, const DspEvalConfig& config,
+                           const WhisperJobConfig& job, DspEvalResult* result, std::string* text) {
+	std::vector<int16_t> decoded;
+	const std::vector<int16_t>* pcm = &chunk;
+#if defined(AUDIO_CORE_AVCODEC)
+	if (config.upload.format == EncodeFormat::Opus) {
+		StreamDecoder decoder;
+		std::string ignored;
+		if (decoder.Open(StreamCodec::Opus, kEvalRate, &ignored) && decoder.Feed(bytes.data(), bytes.size(), &decoded, &ignored) &&
+		    decoder.Finish(&decoded, &ignored)) {
+			pcm = &decoded;
+			result->decoded = true;
+		}
+	}
+#else
+	(void)bytes;
+	(void)config;
+#endif
+	std::vector<float> samples(pcm->size());
+	for (size_t i = 0; i < samples.size(); ++i) samples[i] = (float)(*pcm)[i] / 32768.0f;
+	WhisperResult transcript;
+	if (!Whisper()->Transcribe(samples.data(), samples.size(), job, "evaluateDsp", &transcript)) {
+		result->transcribeError = transcript.error;
+		return false;
+	}
+	result->transcribeMs += transcript.processingMs;
+	if (!text->empty()) text->push_back(' ');
+	*text += transcript.text;
+	return true;
+}
+
+// Threadpool side of evaluateDsp(): the corpus through each configuration in turn.
+inline std::vector<DspEvalResult> EvaluateDspConfigs(const std::vector<DspEvalItem>& corpus, const std::vector<DspEvalConfig>& configs,
+                                                     const WhisperJobConfig& job, bool transcribe) {
+	std::vector<DspEvalResult> results;
+	for (const DspEvalConfig& config : configs) {
+		DspEvalResult result;
+		result.name = config.name;
+		result.transcribed = transcribe;
+		for (const DspEvalItem& item : corpus) {
+			std::vector<std::vector<int16_t>> chunks;
+			std::string error;
+			if (!EvalReplay(item, config, &chunks, &result, &error)) {
+				result.error = error;
+				break;
+			}
+			++result.files;
+			result.chunks += (uint32_t)chunks.size();
+			std::string text;
+			for (const std::vector<int16_t>& chunk : chunks) {
+				std::vector<float> pcm(chunk.size());
+				for (size_t i = 0; i < pcm.size(); ++i) pcm[i] = (float)chunk[i] / 32768.0f;
+				std::vector<uint8_t> bytes;
+				const auto start = std::chrono::steady_clock::now();
+				if (!EncodeAudioFile(pcm, config.upload, &bytes, &error)) {
+					result.error = error;
+					break;
+				}
+				result.encodeNs += EvalElapsedNs(start);
+				result.uploadBytes += bytes.size();
+				// A missing model ends transcription for the rest of the run, not the costs
+				if (result.transcribed && !EvalTranscribe(chunk, bytes, config, job, &result, &text)) result.transcribed = false;
+			}
+			if (!result.error.empty()) break;
+			const std::vector<std::string> ref = EvalWords(item.text);
+			result.words += ref.size();
+			if (result.transcribed) result.errors += WordErrors(ref, EvalWords(text));
+		}
+		results.push_back(std::move(result));
+	}
+	return results;
+}
+
+inline bool ParseDspEvalConfig(const Napi::Value& value, size_t index, DspEvalConfig* out, std::string* error) {
+	if (!value.IsObject()) {
+		*error = "Each config must be an object";
+		return false;
+	}
+	Napi::Object obj = value.As<Napi::Object>();
+	CaptureOptions& o = out->capture;
+	o.vad = VadMode::Quality;
+	o.frameMs = 20;
+	o.chunker.enabled = true;
+	if (!ParseCaptureOptions(obj, &o, error)) return false;
+	if (o.vad == VadMode::Off || (o.frameMs != 10 && o.frameMs != 20 && o.frameMs != 30)) {
+		*error = "Each config needs 'vad' and a frameMs of 10, 20 or 30";
+		return false;
+	}
+	out->name = obj.Get("name").IsString() ? obj.Get("name").As<Napi::String>().Utf8Value() : "config " + std::to_string(index);
+
+	if (obj.Has("params") && !obj.Get("params").IsUndefined()) {
+		if (!obj.Get("params").IsObject()) {
+			*error = "Option 'params' must be an object";
+			return false;
+		}
+		Napi::Object params = obj.Get("params").As<Napi::Object>();
+		size_t count = 0;
+		const ProcessingParamField* fields = ProcessingParamFields(&count);
+		for (size_t i = 0; i < count; ++i) {
+			if (!ReadFloatOption(params, fields[i].key, fields[i].lo, fields[i].hi, &(out->params.*fields[i].member), error)) return false;
+		}
+	}
+
+	AudioEncodeConfig& upload = out->upload;
+	upload.sampleRate = kEvalRate;
+#if defined(AUDIO_CORE_OPUS)
+	upload.format = EncodeFormat::Opus;
+#endif
+	if (obj.Has("upload") && !obj.Get("upload").IsUndefined()) {
+		if (!obj.Get("upload").IsObject()) {
+			*error = "Option 'upload' must be an object";
+			return false;
+		}
+		Napi::Object u = obj.Get("upload").As<Napi::Object>();
+		int format = (int)upload.format;
+		if (!ReadEnumOption(u, "format", { "wav", "flac", "opus" }, &format, error) ||
+		    !ReadUint32Option(u, "bitrate", 6000, 128000, &upload.bitrate, error)) {
+			return false;
+		}
+		upload.format = (EncodeFormat)format;
+	}
+#if !defined(AUDIO_CORE_OPUS)
+	if (upload.format == EncodeFormat::Opus) {
+		*error = "Option 'upload' format 'opus' is not built in (use_opus=0)";
+		return false;
+	}
+#endif
+	return true;
+}
+
+inline Napi::Object DspEvalResultToJs(Napi::Env env, const DspEvalResult& r) {
+	Napi::Object out = Napi::Object::New(env);
+	out.Set("name", Napi::String::New(env, r.name));
+	out.Set("files", Napi::Number::New(env, r.files));
+	out.Set("audioMs", Napi::Number::New(env, (double)r.samples * 1000.0 / kEvalRate));
+	out.Set("samples", Napi::Number::New(env, (double)r.samples));
+	out.Set("chunks", Napi::Number::New(env, r.chunks));
+	out.Set("uploadBytes", Napi::Number::New(env, (double)r.uploadBytes));
+	const double samples = r.samples ? (double)r.samples : 1.0;
+	Napi::Object ns = Napi::Object::New(env);
+	ns.Set("front", Napi::Number::New(env, (double)r.frontNs / samples));
+	ns.Set("chain", Napi::Number::New(env, (double)r.chainNs / samples));
+	ns.Set("encode", Napi::Number::New(env, (double)r.encodeNs / samples));
+	ns.Set("total", Napi::Number::New(env, (double)(r.frontNs + r.chainNs + r.encodeNs) / samples));
+	out.Set("nsPerSample", ns);
+	if (r.transcribed) {
+		out.Set("words", Napi::Number::New(env, (double)r.words));
+		out.Set("errors", Napi::Number::New(env, (double)r.errors));
+		out.Set("wer", Napi::Number::New(env, r.words ? (double)r.errors / (double)r.words : 0.0));
+		out.Set("transcribeMs", Napi::Number::New(env, r.transcribeMs));
+		out.Set("decoded", Napi::Boolean::New(env, r.decoded));
+	}
+	if (!r.transcribeError.empty()) out.Set("transcribeError", Napi::String::New(env, r.transcribeError));
+	if (!r.error.empty()) out.Set("error", Napi::String::New(env, r.error));
+	return out;
+}
+
+// evaluateDsp({ corpus, configs, language?, transcribe? }) -> Promise<results>
+inline Napi::Value EvaluateDsp(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsObject()) {
+		Napi::TypeError::New(env, "Options object required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Object obj = info[0].As<Napi::Object>();
+	if (!obj.Get("corpus").IsArray() || !obj.Get("configs").IsArray()) {
+		Napi::TypeError::New(env, "Options 'corpus' and 'configs' must be arrays").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+#if !defined(AUDIO_CORE_AVFORMAT)
+	Napi::Error::New(env, "evaluateDsp needs an addon built with use_avformat=1").ThrowAsJavaScriptException();
+	return env.Null();
+#endif
+	std::vector<DspEvalItem> corpus;
+	Napi::Array items = obj.Get("corpus").As<Napi::Array>();
+	for (uint32_t i = 0; i < items.Length(); ++i) {
+		Napi::Value v = items.Get(i);
+		if (!v.IsObject() || !v.As<Napi::Object>().Get("file").IsString() || !v.As<Napi::Object>().Get("text").IsString()) {
+			Napi::TypeError::New(env, "Each corpus entry needs string 'file' and 'text'").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		Napi::Object item = v.As<Napi::Object>();
+		corpus.push_back({ item.Get("file").As<Napi::String>().Utf8Value(), item.Get("text").As<Napi::String>().Utf8Value() });
+	}
+	std::vector<DspEvalConfig> configs;
+	Napi::Array list = obj.Get("configs").As<Napi::Array>();
+	for (uint32_t i = 0; i < list.Length(); ++i) {
+		DspEvalConfig config;
+		std::string error;
+		if (!ParseDspEvalConfig(list.Get(i), i, &config, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		configs.push_back(std::move(config));
+	}
+	WhisperJobConfig job;
+	if (obj.Get("language").IsString()) job.language = obj.Get("language").As<Napi::String>().Utf8Value();
+	const bool transcribe = !obj.Get("transcribe").IsBoolean() || obj.Get("transcribe").As<Napi::Boolean>().Value();
+
+	return QueueQuery(env, "EvaluateDsp",
+		[corpus = std::move(corpus), configs = std::move(configs), job, transcribe]() {
+			return EvaluateDspConfigs(corpus, configs, job, transcribe);
+		},
+		[](Napi::Env env, std::vector<DspEvalResult>& results) -> Napi::Value {
+			Napi::Array out = Napi::Array::New(env, results.size());
+			for (size_t i = 0; i < results.size(); ++i) out.Set((uint32_t)i, DspEvalResultToJs(env, results[i]));
+			return out;
+		}, TaskPriority::Background);
+}
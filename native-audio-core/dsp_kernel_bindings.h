@@ -0,0 +1,283 @@
+#pragma once
+
+// The capture chain's DSP kernels as synchronous functions on JS typed
+// arrays, for the TS services that condition whole clips in the main process
+// (AudioFormatConverter, WhisperAudioConditioner) instead of looping over
+// Float32Arrays in JS. They work on the arrays' own memory: filters, gates
+// and gains in place, conversions into an output array the caller passes.
+// Every call starts from rest; nothing carries over between calls.
+//
+//   dspResample(input, output, { inRate, outRate, quality? }) -> samples written
+//   dspFilter(samples, { sampleRate, highPassHz?, lowPassHz?, q? })
+//   dspGate(samples, { sampleRate, threshold? }) -> peak after the gate
+//   dspNormalize(samples, { peak?, maxGainDb? }) -> gain applied
+//   dspMeasure(samples, { sampleRate? }) -> { peak, rms, lufs? }
+//   dspInt16ToFloat(input: Int16Array, output: Float32Array)
+//   dspFloatToInt16(input: Float32Array, output: Int16Array, gain?)
+//
+// dspResample is the capture's polyphase resampler with its filter delay
+// taken out, so it writes floor(length * outRate / inRate) samples aligned
+// with the input. dspFilter runs RBJ biquads (high-pass, then low-pass) at q
+// (default 0.7071). dspGate with a threshold zeroes samples below it;
+// without one it is the capture's adaptive gate at the live processing
+// parameters. dspNormalize scales to a peak (default 0.9), the gain capped at
+// maxGainDb when given. lufs is BS.1770 integrated loudness.
+
+#include <napi.h>
+
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "addon_instance.h"
+#include "capture_options.h"
+#include "dsp_blocks.h"
+#include "loudness.h"
+#include "pcm_quantize.h"
+#include "processing_params.h"
+#include "resampler.h"
+
+// Per environment: the last rate pair's tables, rebuilt when it changes.
+struct DspKernelState {
+	uint32_t inRate = 0, outRate = 0;
+	int quality = -1;
+	PolyphaseResampler resampler;
+	std::vector<float> scratch;
+};
+
+inline bool ReadFloat32Array(const Napi::Value& v, Napi::Float32Array* out) {
+	if (!v.IsTypedArray() || v.As<Napi::TypedArray>().TypedArrayType() != napi_float32_array) return false;
+	*out = v.As<Napi::Float32Array>();
+	return true;
+}
+
+// A required sampleRate (8000..384000) in obj.
+inline bool ReadDspSampleRate(const Napi::Object& obj, const char* key, uint32_t* out, std::string* error) {
+	if (!obj.Get(key).IsNumber()) {
+		*error = std::string("Option '") + key + "' required";
+		return false;
+	}
+	return ReadUint32Option(obj, key, 8000, 384000, out, error);
+}
+
+// dspResample(input: Float32Array, output: Float32Array, { inRate, outRate, quality? })
+inline Napi::Value DspResample(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	Napi::Float32Array input, output;
+	if (info.Length() < 3 || !ReadFloat32Array(info[0], &input) || !ReadFloat32Array(info[1], &output) || !info[2].IsObject()) {
+		Napi::TypeError::New(env, "Input and output Float32Arrays and options required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Object obj = info[2].As<Napi::Object>();
+	uint32_t inRate = 0, outRate = 0;
+	int quality = (int)ResamplerQuality::Medium;
+	std::string error;
+	if (!ReadDspSampleRate(obj, "inRate", &inRate, &error) || !ReadDspSampleRate(obj, "outRate", &outRate, &error) ||
+	    !ReadEnumOption(obj, "quality", { "low", "medium", "high" }, &quality, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const size_t n = input.ElementLength();
+	const size_t want = (size_t)((uint64_t)n * outRate / inRate);
+	if (output.ElementLength() < want) {
+		Napi::TypeError::New(env, "Output array holds fewer than " + std::to_string(want) + " samples").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (inRate == outRate) {
+		memmove(output.Data(), input.Data(), n * sizeof(float));
+		return Napi::Number::New(env, (double)n);
+	}
+	DspKernelState& state = PerEnv<DspKernelState>(env);
+	if (state.inRate != inRate || state.outRate != outRate || state.quality != quality) {
+		state.resampler.Configure(inRate, outRate, (ResamplerQuality)quality, 4096);
+		state.inRate = inRate;
+		state.outRate = outRate;
+		state.quality = quality;
+	} else {
+		state.resampler.Reset();
+	}
+	// Zeros ahead of the input round the filter delay up to a whole number of
+	// outputs, which are dropped; zeros after it flush the filter
+	const size_t delay = state.resampler.DelaySamples();
+	const size_t period = inRate / std::gcd(inRate, outRate);
+	const size_t lead = (period - delay % period) % period;
+	const size_t skip = (size_t)((uint64_t)(lead + delay) * outRate / inRate);
+	state.scratch.resize(state.resampler.MaxOutput(lead) + state.resampler.MaxOutput(n) + state.resampler.MaxOutput(delay));
+	const float zeros[256] = {};
+	size_t got = 0;
+	auto feedZeros = [&](size_t count) {
+		for (size_t left = count; left > 0;) {
+			const size_t block = std::min<size_t>(left, 256);
+			got += state.resampler.Process(zeros, block, state.scratch.data() + got);
+			left -= block;
+		}
+	};
+	feedZeros(lead);
+	got += state.resampler.Process(input.Data(), n, state.scratch.data() + got);
+	feedZeros(delay);
+	const size_t take = got > skip ? std::min(want, got - skip) : 0;
+	memcpy(output.Data(), state.scratch.data() + skip, take * sizeof(float));
+	std::fill(output.Data() + take, output.Data() + want, 0.0f);
+	return Napi::Number::New(env, (double)want);
+}
+
+// dspFilter(samples: Float32Array, { sampleRate, highPassHz?, lowPassHz?, q? })
+inline Napi::Value DspFilter(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	Napi::Float32Array samples;
+	if (info.Length() < 2 || !ReadFloat32Array(info[0], &samples) || !info[1].IsObject()) {
+		Napi::TypeError::New(env, "Float32Array and options required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Object obj = info[1].As<Napi::Object>();
+	uint32_t rate = 0;
+	float highPassHz = 0.0f, lowPassHz = 0.0f, q = 0.7071f;
+	std::string error;
+	if (!ReadDspSampleRate(obj, "sampleRate", &rate, &error) ||
+	    !ReadFloatOption(obj, "highPassHz", 0.0f, 20000.0f, &highPassHz, &error) ||
+	    !ReadFloatOption(obj, "lowPassHz", 0.0f, 192000.0f, &lowPassHz, &error) || !ReadFloatOption(obj, "q", 0.1f, 10.0f, &q, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (highPassHz >= rate * 0.5f || lowPassHz >= rate * 0.5f) {
+		Napi::TypeError::New(env, "Filter corners must be below half the sample rate").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (highPassHz > 0.0f) {
+		BlockBiquad filter;
+		filter.Setup(HighPassCoefficients((float)rate, highPassHz, q));
+		filter.Process(samples.Data(), samples.ElementLength());
+	}
+	if (lowPassHz > 0.0f) {
+		BlockBiquad filter;
+		filter.Setup(LowPassCoefficients((float)rate, lowPassHz, q));
+		filter.Process(samples.Data(), samples.ElementLength());
+	}
+	return env.Undefined();
+}
+
+// dspGate(samples: Float32Array, { sampleRate, threshold? }) -> peak
+inline Napi::Value DspGate(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	Napi::Float32Array samples;
+	if (info.Length() < 2 || !ReadFloat32Array(info[0], &samples) || !info[1].IsObject()) {
+		Napi::TypeError::New(env, "Float32Array and options required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Object obj = info[1].As<Napi::Object>();
+	uint32_t rate = 0;
+	float threshold = -1.0f;
+	std::string error;
+	if (!ReadDspSampleRate(obj, "sampleRate", &rate, &error) || !ReadFloatOption(obj, "threshold", 0.0f, 1.0f, &threshold, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	float* x = samples.Data();
+	const size_t n = samples.ElementLength();
+	if (threshold < 0.0f) {
+		NoiseGate gate;
+		gate.Configure((float)rate, LiveProcessingParams().Current());
+		return Napi::Number::New(env, gate.Process(x, n));
+	}
+	for (size_t i = 0; i < n; ++i) {
+		if (std::fabs(x[i]) <= threshold) x[i] = 0.0f;
+	}
+	return Napi::Number::New(env, PeakMagnitude(x, n));
+}
+
+// dspNormalize(samples: Float32Array, { peak?, maxGainDb? }) -> gain
+inline Napi::Value DspNormalize(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	Napi::Float32Array samples;
+	if (info.Length() < 1 || !ReadFloat32Array(info[0], &samples)) {
+		Napi::TypeError::New(env, "Float32Array required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	float target = 0.9f, maxGainDb = 1000.0f;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object obj = info[1].As<Napi::Object>();
+		std::string error;
+		if (!ReadFloatOption(obj, "peak", 0.0f, 1.0f, &target, &error) || !ReadFloatOption(obj, "maxGainDb", -120.0f, 120.0f, &maxGainDb, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+	float* x = samples.Data();
+	const size_t n = samples.ElementLength();
+	const float peak = PeakMagnitude(x, n);
+	if (peak <= 0.0f) return Napi::Number::New(env, 1.0);
+	const float gain = std::min(target / peak, std::pow(10.0f, maxGainDb / 20.0f));
+	for (size_t i = 0; i < n; ++i) x[i] *= gain;
+	return Napi::Number::New(env, gain);
+}
+
+// dspMeasure(samples: Float32Array, { sampleRate? }) -> { peak, rms, lufs? }
+inline Napi::Value DspMeasure(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	Napi::Float32Array samples;
+	if (info.Length() < 1 || !ReadFloat32Array(info[0], &samples)) {
+		Napi::TypeError::New(env, "Float32Array required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	uint32_t rate = 0;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		std::string error;
+		if (!ReadUint32Option(info[1].As<Napi::Object>(), "sampleRate", 8000, 384000, &rate, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+	const float* x = samples.Data();
+	const size_t n = samples.ElementLength();
+	double energy = 0.0;
+	for (size_t i = 0; i < n; ++i) energy += (double)x[i] * x[i];
+	Napi::Object out = Napi::Object::New(env);
+	out.Set("peak", Napi::Number::New(env, PeakMagnitude(x, n)));
+	out.Set("rms", Napi::Number::New(env, n > 0 ? std::sqrt(energy / n) : 0.0));
+	if (rate > 0) {
+		LoudnessMeter meter;
+		meter.Configure((float)rate, n / (rate / 10) + 1);
+		meter.Push(x, n, 1.0f);
+		out.Set("lufs", Napi::Number::New(env, meter.IntegratedLufs()));
+	}
+	return out;
+}
+
+// dspInt16ToFloat(input: Int16Array, output: Float32Array)
+inline Napi::Value DspInt16ToFloat(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	Napi::Float32Array output;
+	if (info.Length() < 2 || !info[0].IsTypedArray() || info[0].As<Napi::TypedArray>().TypedArrayType() != napi_int16_array ||
+	    !ReadFloat32Array(info[1], &output)) {
+		Napi::TypeError::New(env, "Int16Array input and Float32Array output required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Int16Array input = info[0].As<Napi::Int16Array>();
+	if (output.ElementLength() < input.ElementLength()) {
+		Napi::TypeError::New(env, "Output array is shorter than the input").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Int16ToFloat32(input.Data(), input.ElementLength(), output.Data());
+	return env.Undefined();
+}
+
+// dspFloatToInt16(input: Float32Array, output: Int16Array, gain?) - clipped and rounded
+inline Napi::Value DspFloatToInt16(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	Napi::Float32Array input;
+	if (info.Length() < 2 || !ReadFloat32Array(info[0], &input) || !info[1].IsTypedArray() ||
+	    info[1].As<Napi::TypedArray>().TypedArrayType() != napi_int16_array) {
+		Napi::TypeError::New(env, "Float32Array input and Int16Array output required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Int16Array output = info[1].As<Napi::Int16Array>();
+	if (output.ElementLength() < input.ElementLength()) {
+		Napi::TypeError::New(env, "Output array is shorter than the input").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const float gain = info.Length() > 2 && info[2].IsNumber() ? info[2].As<Napi::Number>().FloatValue() : 1.0f;
+	QuantizeToInt16(input.Data(), input.ElementLength(), gain, output.Data());
+	return env.Undefined();
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+// Warm start for the voice chain (capture option "warmStart": { path, key }).
+// The adaptive state a capture converged to is saved under its key (the
+// endpoint it opened) when it stops, and restored when the next capture with
+// that key starts. That state is the gate's noise floor, the spectral
+// denoiser's noise profile and the loudness normalizer's gain. A session then
+// starts gating against the room it is in, not the 0.003 default floor, and
+// its first seconds stop passing noise to the VAD.
+//
+// All keys share one small file. It is rewritten beside itself and moved
+// over, so a crash leaves the old table or the new one. It holds at most
+// kWarmStateEntries keys; the one saved longest ago goes first, and entries
+// older than kWarmStateMaxAgeDays are ignored; a capture stopped within
+// kWarmStateMinSamples saves nothing. Loads and saves run on the
+// capture thread before and after it streams, never in the audio path. Both
+// adaptive trackers fall at once and rise slowly, so a stale floor corrects
+// itself within the first second either way.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "addon_log.h"
+#include "dsp_blocks.h"
+#include "mapped_file.h"
+
+constexpr uint32_t kWarmStateVersion = 1;
+constexpr size_t kWarmStateEntries = 32;
+constexpr int64_t kWarmStateMaxAgeDays = 30;
+constexpr uint64_t kWarmStateMinSamples = 3 * 16000; // three seconds of the 16 kHz stream
+
+struct WarmStartConfig {
+	bool enabled = false;
+	std::string path;
+	std::string key; // the endpoint, as JS names it
+};
+
+namespace warm_state_detail {
+
+struct Entry {
+	std::string key;
+	int64_t savedAt = 0; // seconds since the epoch
+	VoiceChainState state;
+};
+
+inline std::mutex& FileMutex() {
+	static std::mutex mutex; // captures stopping together rewrite the same file
+	return mutex;
+}
+
+inline int64_t Now() {
+	return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// The whole table; an unreadable or foreign file reads as empty.
+inline std::vector<Entry> ReadTable(const std::string& path) {
+	std::vector<Entry> entries;
+	FILE* f = OpenFileUtf8(path, "rb");
+	if (!f) return entries;
+	char magic[4];
+	uint32_t header[2];
+	if (fread(magic, 1, 4, f) != 4 || memcmp(magic, "WDSP", 4) != 0 || fread(header, sizeof(uint32_t), 2, f) != 2 ||
+	    header[0] != kWarmStateVersion || header[1] > kWarmStateEntries) {
+		fclose(f);
+		return entries;
+	}
+	for (uint32_t i = 0; i < header[1]; ++i) {
+		Entry e;
+		uint32_t keyBytes = 0, bins = 0;
+		if (fread(&keyBytes, sizeof(keyBytes), 1, f) != 1 || keyBytes > 1024) break;
+		e.key.resize(keyBytes);
+		if ((keyBytes > 0 && fread(&e.key[0], 1, keyBytes, f) != keyBytes) || fread(&e.savedAt, sizeof(e.savedAt), 1, f) != 1 ||
+		    fread(&e.state.gateFloor, sizeof(float), 1, f) != 1 || fread(&e.state.loudnessGain, sizeof(float), 1, f) != 1 ||
+		    fread(&bins, sizeof(bins), 1, f) != 1 || bins > 4096) {
+			break;
+		}
+		e.state.denoiseNoise.resize(bins);
+		if (bins > 0 && fread(e.state.denoiseNoise.data(), sizeof(float), bins, f) != bins) break;
+		entries.push_back(std::move(e));
+	}
+	fclose(f);
+	return entries;
+}
+
+inline bool WriteTable(const std::string& path, const std::vector<Entry>& entries) {
+	const std::string temp = path + ".tmp";
+	FILE* f = OpenFileUtf8(temp, "wb");
+	if (!f) return false;
+	const uint32_t header[2] = { kWarmStateVersion, (uint32_t)entries.size() };
+	bool ok = fwrite("WDSP", 1, 4, f) == 4 && fwrite(header, sizeof(uint32_t), 2, f) == 2;
+	for (const Entry& e : entries) {
+		if (!ok) break;
+		const uint32_t keyBytes = (uint32_t)e.key.size(), bins = (uint32_t)e.state.denoiseNoise.size();
+		ok = fwrite(&keyBytes, sizeof(keyBytes), 1, f) == 1 && fwrite(e.key.data(), 1, keyBytes, f) == keyBytes &&
+		     fwrite(&e.savedAt, sizeof(e.savedAt), 1, f) == 1 && fwrite(&e.state.gateFloor, sizeof(float), 1, f) == 1 &&
+		     fwrite(&e.state.loudnessGain, sizeof(float), 1, f) == 1 && fwrite(&bins, sizeof(bins), 1, f) == 1 &&
+		     fwrite(e.state.denoiseNoise.data(), sizeof(float), bins, f) == bins;
+	}
+	if (fclose(f) != 0 || !ok) {
+		RemoveFile(temp);
+		return false;
+	}
+	return MoveFileReplacing(temp, path);
+}
+
+} // namespace warm_state_detail
+
+// The state saved under key, false when there is none (or it is too old).
+inline bool LoadVoiceChainState(const WarmStartConfig& config, VoiceChainState* out) {
+	using namespace warm_state_detail;
+	std::lock_guard<std::mutex> lock(FileMutex());
+	for (Entry& e : ReadTable(config.path)) {
+		if (e.key != config.key) continue;
+		if (Now() - e.savedAt > kWarmStateMaxAgeDays * 86400) return false;
+		*out = std::move(e.state);
+		return true;
+	}
+	return false;
+}
+
+inline bool SaveVoiceChainState(const WarmStartConfig& config, const VoiceChainState& state) {
+	using namespace warm_state_detail;
+	std::lock_guard<std::mutex> lock(FileMutex());
+	std::vector<Entry> entries = ReadTable(config.path);
+	entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry& e) { return e.key == config.key; }), entries.end());
+	// Oldest first, so the front is the one to give up
+	if (entries.size() >= kWarmStateEntries) entries.erase(entries.begin(), entries.begin() + (entries.size() - kWarmStateEntries + 1));
+	Entry e;
+	e.key = config.key;
+	e.savedAt = Now();
+	e.state = state;
+	entries.push_back(std::move(e));
+	return WriteTable(config.path, entries);
+}
+
+// Capture thread, after VoiceChain::Configure().
+inline void RestoreWarmState(VoiceChain* voice, const WarmStartConfig& config) {
+	VoiceChainState state;
+	if (!LoadVoiceChainState(config, &state)) return;
+	voice->RestoreState(state);
+	AddonLog(LogLevel::Info, "Voice chain warm start for %s: gate floor %.1f dBFS", config.key.c_str(), 20.0f * std::log10(state.gateFloor + 1e-9f));
+}
+
+// Capture thread, once it stopped streaming; samples is the 16 kHz stream
+// processed, too short a run to have converged saving nothing.
+inline void SaveWarmState(const VoiceChain& voice, const WarmStartConfig& config, uint64_t samples) {
+	if (samples < kWarmStateMinSamples) return;
+	if (!SaveVoiceChainState(config, voice.SaveState())) AddonLog(LogLevel::Warn, "Could not save the voice chain state to %s", config.path.c_str());
+}
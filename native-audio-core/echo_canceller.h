@@ -0,0 +1,371 @@
+#pragma once
+
+// Acoustic echo cancellation for microphone captures (capture option
+// "echoCancel"), with the loopback capture as the far-end reference.
+//
+// EchoReference is a two-second ring of the 16 kHz loopback stream, stamped
+// with the device clock (QPC on Windows, mach host time on macOS, both in
+// nanoseconds) so a microphone block can fetch the far-end samples that were
+// playing at the same instant. The first loopback capture to start publishes
+// to SharedEchoReference(); later ones leave it alone.
+//
+// EchoCanceller is a partitioned-block frequency-domain adaptive filter
+// (overlap-save, 128-sample blocks, 256-point FFT): the far-end spectra of the
+// last tailMs sit in a frequency-domain delay line, the echo estimate is their
+// sum weighted by the filter, and the filter adapts by NLMS normalized per bin
+// by the far-end power across the tail. One partition is gradient-constrained
+// per block, round robin. A Geigel detector freezes adaptation while the near
+// end talks, and a filter whose output grows louder than its input is reset.
+// Output lags the input by one block (8 ms).
+//
+// The filter looks kBulkDelayMs behind the microphone: loopback stamps are
+// taken when the engine mixes, which is at least a device period before the
+// speaker plays, and the last few milliseconds of reference are often still
+// in flight on the loopback thread when a microphone block completes.
+//
+// The render and capture endpoints run on separate crystals. Rather than
+// fetch each block at whatever index the latest loopback stamp maps its time
+// to, which steps by a sample whenever drift and stamp jitter add up and
+// throws the adaptive filter off, the canceller reads the reference as a
+// stream through an asynchronous resampler (drift_resampler.h): a PI loop on
+// the distance to the stamped position trims the read rate, so the alignment
+// holds for hours without jumps.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "drift_resampler.h"
+#include "spectral_features.h"
+
+struct EchoCancelConfig {
+	bool enabled = false;
+	uint32_t tailMs = 256; // echo path the filter covers, after clock alignment
+};
+
+// Far-end reference: one writer (the publishing loopback capture's thread),
+// any number of readers. Each write re-anchors the index-to-time mapping
+// under a seqlock, so clock drift between writes never accumulates.
+class EchoReference {
+public:
+	static constexpr size_t kCapacity = 32768; // ~2 s at 16 kHz
+	static constexpr size_t kWriteMargin = 8192; // > the largest packet (powersave: 200 ms)
+
+	EchoReference() : ring_(kCapacity, 0.0f) {}
+
+	// Returns true when owner becomes the publisher.
+	bool Claim(const void* owner) {
+		const void* none = nullptr;
+		return owner_.compare_exchange_strong(none, owner, std::memory_order_acq_rel);
+	}
+	void Release(const void* owner) {
+		const void* expected = owner;
+		owner_.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+	}
+
+	// Publisher only. timeNs is the capture time of samples[0].
+	void Write(const float* samples, size_t n, uint64_t timeNs) {
+		const uint64_t start = written_.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < n; ++i) ring_[(start + i) & (kCapacity - 1)] = samples[i];
+		const uint32_t seq = seq_.load(std::memory_order_relaxed);
+		seq_.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		baseIndex_.store(start, std::memory_order_relaxed);
+		baseTimeNs_.store(timeNs, std::memory_order_relaxed);
+		written_.store(start + n, std::memory_order_relaxed);
+		seq_.store(seq + 2, std::memory_order_release);
+	}
+
+	// Stream index of the reference sample playing at timeNs, from the latest
+	// write's anchor. False before the first write.
+	bool Locate(uint64_t timeNs, double* index) const {
+		uint64_t base, baseTime, written;
+		Anchor(&base, &baseTime, &written);
+		if (written == 0) return false;
+		*index = (double)base + ((double)timeNs - (double)baseTime) * 16000.0 / 1e9;
+		return true;
+	}
+
+	// Copies n reference samples into out, the first at fractional stream
+	// index `index` and each next one `step` further on, interpolated (see
+	// DriftController); zero where the ring has nothing. False when none were
+	// available.
+	bool Read(double index, double step, float* out, size_t n) const {
+		uint64_t base, baseTime, written;
+		Anchor(&base, &baseTime, &written);
+		// Keep clear of the slots the writer may be filling next
+		const int64_t oldest = (int64_t)written - (int64_t)(kCapacity - kWriteMargin) + 1;
+		const int64_t newest = (int64_t)written - 3; // the last point the 4-tap interpolator can centre on
+		bool any = false;
+		for (size_t i = 0; i < n; ++i) {
+			const double at = index + step * (double)i;
+			const double whole = std::floor(at);
+			const int64_t k = (int64_t)whole;
+			if (written == 0 || k < oldest || k < 1 || k > newest) {
+				out[i] = 0.0f;
+				continue;
+			}
+			const float t = (float)(at - whole);
+			out[i] = HermiteAt(ring_[(uint64_t)(k - 1) & (kCapacity - 1)], ring_[(uint64_t)k & (kCapacity - 1)],
+			                   ring_[(uint64_t)(k + 1) & (kCapacity - 1)], ring_[(uint64_t)(k + 2) & (kCapacity - 1)], t);
+			any = true;
+		}
+		return any;
+	}
+
+private:
+	void Anchor(uint64_t* base, uint64_t* baseTime, uint64_t* written) const {
+		for (;;) {
+			const uint32_t seq = seq_.load(std::memory_order_acquire);
+			if (seq & 1) continue;
+			*base = baseIndex_.load(std::memory_order_relaxed);
+			*baseTime = baseTimeNs_.load(std::memory_order_relaxed);
+			*written = written_.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (seq_.load(std::memory_order_relaxed) == seq) return;
+		}
+	}
+
+	std::vector<float> ring_;
+	std::atomic<const void*> owner_{nullptr};
+	std::atomic<uint32_t> seq_{0};
+	std::atomic<uint64_t> baseIndex_{0};
+	std::atomic<uint64_t> baseTimeNs_{0};
+	std::atomic<uint64_t> written_{0};
+};
+
+// The loopback stream microphone captures cancel against.
+inline EchoReference& SharedEchoReference() {
+	static EchoReference reference;
+	return reference;
+}
+
+class EchoCanceller {
+public:
+	static constexpr size_t kBlock = 128;
+	static constexpr size_t kFft = 2 * kBlock;
+	static constexpr size_t kBins = kBlock + 1;
+	static constexpr uint64_t kBulkDelayMs = 16;
+	static constexpr double kSettleBlocks = 250.0;  // ~2 s to absorb stamp jitter
+	static constexpr double kResyncSamples = 320.0; // 20 ms off: a device change or gap, jump
+
+	void Configure(float fs, const EchoCancelConfig& config) {
+		config_ = config;
+		if (!config.enabled) return;
+		nsPerSample_ = 1e9 / (double)fs;
+		partitions_ = std::max<size_t>(1, ((size_t)config.tailMs * (size_t)fs / 1000 + kBlock - 1) / kBlock);
+		fft_.Configure(kFft);
+		xre_.assign(partitions_ * kBins, 0.0f);
+		xim_.assign(partitions_ * kBins, 0.0f);
+		wre_.assign(partitions_ * kBins, 0.0f);
+		wim_.assign(partitions_ * kBins, 0.0f);
+		farPower_.assign(partitions_ * kBins, 0.0f);
+		powerSum_.assign(kBins, 0.0f);
+		farPeaks_.assign(partitions_, 0.0f);
+		re_.assign(kFft, 0.0f);
+		im_.assign(kFft, 0.0f);
+		near_.assign(kBlock, 0.0f);
+		far_.assign(kBlock, 0.0f);
+		farPrev_.assign(kBlock, 0.0f);
+		out_.assign(kBlock, 0.0f);
+		error_.assign(kBlock, 0.0f);
+		Reset();
+	}
+
+	bool Enabled() const { return config_.enabled; }
+
+	void Reset() {
+		std::fill(xre_.begin(), xre_.end(), 0.0f);
+		std::fill(xim_.begin(), xim_.end(), 0.0f);
+		std::fill(wre_.begin(), wre_.end(), 0.0f);
+		std::fill(wim_.begin(), wim_.end(), 0.0f);
+		std::fill(farPower_.begin(), farPower_.end(), 0.0f);
+		std::fill(powerSum_.begin(), powerSum_.end(), 0.0f);
+		std::fill(farPeaks_.begin(), farPeaks_.end(), 0.0f);
+		std::fill(farPrev_.begin(), farPrev_.end(), 0.0f);
+		std::fill(out_.begin(), out_.end(), 0.0f);
+		filled_ = 0;
+		head_ = 0;
+		constrain_ = 0;
+		holdBlocks_ = 0;
+		nearEnergy_ = errorEnergy_ = 0.0;
+		drift_.Configure(kBlock, kSettleBlocks, kResyncSamples);
+		readIndex_ = 0.0;
+	}
+
+	// Removes the echo of `reference` from x in place; timeNs is the capture
+	// time of x[0] on the reference's clock.
+	void Process(float* x, size_t n, uint64_t timeNs, const EchoReference& reference) {
+		for (size_t i = 0; i < n; ++i) {
+			if (filled_ == 0) blockTimeNs_ = timeNs + (uint64_t)((double)i * nsPerSample_);
+			near_[filled_] = x[i];
+			x[i] = out_[filled_];
+			if (++filled_ == kBlock) {
+				Block(ReadFar(reference));
+				filled_ = 0;
+			}
+		}
+	}
+
+	// Echo return loss enhancement over recent far-end-only blocks, dB.
+	float ErleDb() const {
+		return errorEnergy_ > 0.0 ? (float)(10.0 * std::log10((nearEnergy_ + 1e-12) / errorEnergy_)) : 0.0f;
+	}
+
+	// Rate offset of the render clock against the capture clock, as learnt by
+	// the reference's resampler, and how often it had to jump.
+	float DriftPpm() const { return (float)drift_.DriftPpm(); }
+	uint64_t DriftResyncs() const { return drift_.Resyncs(); }
+
+private:
+	// The next kBlock far-end samples into far_, or zeros and false.
+	bool ReadFar(const EchoReference& reference) {
+		const uint64_t lag = kBulkDelayMs * 1000000;
+		double target;
+		if (blockTimeNs_ <= lag || !reference.Locate(blockTimeNs_ - lag, &target)) {
+			drift_.Unlock();
+			std::fill(far_.begin(), far_.end(), 0.0f);
+			return false;
+		}
+		if (!drift_.Update(target - readIndex_)) readIndex_ = target;
+		const bool any = reference.Read(readIndex_, drift_.Step(), far_.data(), kBlock);
+		readIndex_ += drift_.Step() * (double)kBlock;
+		return any;
+	}
+
+	void Block(bool haveFar) {
+		// Far-end spectrum of [previous block, this block] into the delay line
+		head_ = (head_ + partitions_ - 1) % partitions_;
+		float* xr = &xre_[head_ * kBins];
+		float* xi = &xim_[head_ * kBins];
+		float* xp = &farPower_[head_ * kBins];
+		for (size_t i = 0; i < kBlock; ++i) {
+			re_[i] = farPrev_[i];
+			re_[kBlock + i] = far_[i];
+		}
+		std::fill(im_.begin(), im_.end(), 0.0f);
+		fft_.Forward(re_.data(), im_.data());
+		for (size_t k = 0; k < kBins; ++k) {
+			xr[k] = re_[k];
+			xi[k] = im_[k];
+			const float p = re_[k] * re_[k] + im_[k] * im_[k];
+			powerSum_[k] += p - xp[k];
+			xp[k] = p;
+		}
+		float farPeak = 0.0f;
+		for (size_t i = 0; i < kBlock; ++i) farPeak = std::max(farPeak, std::fabs(far_[i]));
+		farPeaks_[head_] = farPeak;
+		std::copy(far_.begin(), far_.end(), farPrev_.begin());
+
+		// Echo estimate: sum over partitions of W_p * X_p, last half of the inverse
+		for (size_t k = 0; k < kBins; ++k) {
+			float yr = 0.0f, yi = 0.0f;
+			for (size_t p = 0; p < partitions_; ++p) {
+				const size_t at = Slot(p) * kBins + k, w = p * kBins + k;
+				yr += wre_[w] * xre_[at] - wim_[w] * xim_[at];
+				yi += wre_[w] * xim_[at] + wim_[w] * xre_[at];
+			}
+			re_[k] = yr;
+			im_[k] = yi;
+		}
+		Inverse();
+		float nearPeak = 0.0f;
+		double nearE = 0.0, errorE = 0.0;
+		for (size_t i = 0; i < kBlock; ++i) {
+			error_[i] = near_[i] - re_[kBlock + i];
+			nearPeak = std::max(nearPeak, std::fabs(near_[i]));
+			nearE += (double)near_[i] * near_[i];
+			errorE += (double)error_[i] * error_[i];
+		}
+
+		// A filter making things louder has diverged (or the echo path jumped)
+		if (errorE > 4.0 * nearE && nearE > 1e-6) {
+			std::fill(wre_.begin(), wre_.end(), 0.0f);
+			std::fill(wim_.begin(), wim_.end(), 0.0f);
+			std::copy(near_.begin(), near_.end(), out_.begin());
+			return;
+		}
+		std::copy(error_.begin(), error_.end(), out_.begin());
+
+		// Geigel double-talk: near end louder than half the far-end peak over the tail
+		const float tailPeak = *std::max_element(farPeaks_.begin(), farPeaks_.end());
+		if (nearPeak > 0.5f * tailPeak) holdBlocks_ = 4;
+		else if (holdBlocks_ > 0) --holdBlocks_;
+		if (!haveFar || tailPeak < 1e-3f || holdBlocks_ > 0) return;
+
+		nearEnergy_ = 0.95 * nearEnergy_ + 0.05 * nearE;
+		errorEnergy_ = 0.95 * errorEnergy_ + 0.05 * errorE;
+		Adapt();
+	}
+
+	// NLMS step on every partition; one of them is also projected back onto
+	// kBlock taps so the circular-convolution wrap can't build up.
+	void Adapt() {
+		std::fill(re_.begin(), re_.begin() + kBlock, 0.0f);
+		for (size_t i = 0; i < kBlock; ++i) re_[kBlock + i] = error_[i];
+		std::fill(im_.begin(), im_.end(), 0.0f);
+		fft_.Forward(re_.data(), im_.data());
+		const float mu = 1.0f;
+		for (size_t k = 0; k < kBins; ++k) {
+			const float step = mu / (powerSum_[k] + 1e-6f * (float)(kFft * partitions_));
+			const float er = re_[k] * step, ei = im_[k] * step;
+			for (size_t p = 0; p < partitions_; ++p) {
+				const size_t at = Slot(p) * kBins + k, w = p * kBins + k;
+				// conj(X_p) * E
+				wre_[w] += xre_[at] * er + xim_[at] * ei;
+				wim_[w] += xre_[at] * ei - xim_[at] * er;
+			}
+		}
+
+		float* wr = &wre_[constrain_ * kBins];
+		float* wi = &wim_[constrain_ * kBins];
+		for (size_t k = 0; k < kBins; ++k) {
+			re_[k] = wr[k];
+			im_[k] = wi[k];
+		}
+		Inverse();
+		std::fill(re_.begin() + kBlock, re_.end(), 0.0f);
+		std::fill(im_.begin(), im_.end(), 0.0f);
+		fft_.Forward(re_.data(), im_.data());
+		for (size_t k = 0; k < kBins; ++k) {
+			wr[k] = re_[k];
+			wi[k] = im_[k];
+		}
+		constrain_ = (constrain_ + 1) % partitions_;
+	}
+
+	// Real inverse of the kBins half spectrum in re_/im_, result in re_.
+	void Inverse() {
+		for (size_t k = kBins; k < kFft; ++k) {
+			re_[k] = re_[kFft - k];
+			im_[k] = -im_[kFft - k];
+		}
+		for (size_t k = 0; k < kFft; ++k) im_[k] = -im_[k];
+		fft_.Forward(re_.data(), im_.data());
+		const float scale = 1.0f / (float)kFft;
+		for (size_t i = 0; i < kFft; ++i) re_[i] *= scale;
+	}
+
+	// Delay-line slot holding the far-end spectrum p blocks back.
+	size_t Slot(size_t p) const { return (head_ + p) % partitions_; }
+
+	EchoCancelConfig config_;
+	RadixTwoFft fft_;
+	double nsPerSample_ = 62500.0;
+	size_t partitions_ = 1;
+	std::vector<float> xre_, xim_, wre_, wim_; // partitions_ x kBins
+	std::vector<float> farPower_;              // |X_p|^2, likewise
+	std::vector<float> powerSum_;              // per bin, over the tail
+	std::vector<float> farPeaks_;              // per partition
+	std::vector<float> re_, im_;
+	std::vector<float> near_, far_, farPrev_, out_, error_;
+	size_t filled_ = 0, head_ = 0, constrain_ = 0;
+	uint64_t blockTimeNs_ = 0;
+	DriftController drift_;
+	double readIndex_ = 0.0; // reference stream position of the next far_ sample
+	int holdBlocks_ = 0;
+	double nearEnergy_ = 0.0, errorEnergy_ = 0.0;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+// Sample-aligned mix of several capture streams already at one rate (the 16 kHz
+// front end's output, one stream per render endpoint; option "outputDevice"
+// with more than one entry). Each stream's blocks are placed on a shared
+// timeline by their capture timestamps and summed into a ring; the mix is read
+// a fixed delay behind now, so a stream whose packets arrive a period late
+// still lands in time. Within a stream, blocks follow on from the previous one
+// and the timestamps only matter after a gap: an endpoint that went idle
+// (loopback delivers nothing while nothing plays) or drifted more than
+// kResyncSamples from its timestamps. Samples older than what was already read
+// are dropped and counted.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+class EndpointMixer {
+public:
+	static constexpr int64_t kResyncSamples = 16; // 1 ms at 16 kHz
+
+	// delay: samples the mix lags behind now; capacity: ring length, at least
+	// the delay plus the longest gap between two Read() calls.
+	void Configure(size_t inputs, uint32_t delay, size_t capacity) {
+		size_t size = 1;
+		while (size < capacity) size <<= 1;
+		ring_.assign(size, 0.0f);
+		written_.assign(size, 0);
+		next_.assign(inputs, kUnplaced);
+		delay_ = delay;
+		read_ = 0;
+		late_ = 0;
+	}
+
+	// Samples of `input` whose first one is at index `at` on the shared
+	// timeline (samples since the mix started).
+	void Add(size_t input, int64_t at, const float* x, size_t n) {
+		int64_t& next = next_[input];
+		if (next == kUnplaced || std::abs(at - next) > kResyncSamples) next = at;
+		int64_t start = next;
+		next += (int64_t)n;
+		if (start < read_) {
+			const int64_t skip = std::min<int64_t>(read_ - start, (int64_t)n);
+			late_ += (uint64_t)skip;
+			x += skip;
+			n -= (size_t)skip;
+			start += skip;
+		}
+		const size_t mask = ring_.size() - 1;
+		n = std::min(n, (size_t)std::max<int64_t>(0, read_ + (int64_t)ring_.size() - start));
+		for (size_t i = 0; i < n; ++i) {
+			const size_t slot = (size_t)(start + (int64_t)i) & mask;
+			ring_[slot] += x[i];
+			written_[slot] = 1;
+		}
+	}
+
+	// The input stopped (a silent or idle stretch): its next block is placed by
+	// its timestamp.
+	void Gap(size_t input) { next_[input] = kUnplaced; }
+
+	// Mixed samples up to `now` minus the delay, at most maxOut of them.
+	// *silent is true when no input added anything to them.
+	size_t Read(int64_t now, float* out, size_t maxOut, bool* silent) {
+		const int64_t end = std::min(now - (int64_t)delay_, read_ + (int64_t)maxOut);
+		if (end <= read_) return 0;
+		const size_t mask = ring_.size() - 1;
+		const size_t n = (size_t)(end - read_);
+		bool any = false;
+		for (size_t i = 0; i < n; ++i) {
+			const size_t slot = (size_t)(read_ + (int64_t)i) & mask;
+			out[i] = ring_[slot];
+			any = any || written_[slot];
+			ring_[slot] = 0.0f;
+			written_[slot] = 0;
+		}
+		read_ = end;
+		*silent = !any;
+		return n;
+	}
+
+	int64_t Position() const { return read_; }
+	uint64_t LateSamples() const { return late_; }
+
+private:
+	static constexpr int64_t kUnplaced = INT64_MIN;
+
+	std::vector<float> ring_;
+	std::vector<uint8_t> written_;
+	std::vector<int64_t> next_; // per input: where its next block goes
+	uint32_t delay_ = 0;
+	int64_t read_ = 0;
+	uint64_t late_ = 0;
+};
@@ -0,0 +1,331 @@
+#pragma once
+
+// One channel for the process-wide events native code raises outside any
+// capture: overlay band levels, audio-session deltas and log messages.
+// Producers on any thread push fixed-size BusEvents into a bounded lock-free
+// MPSC ring (the log ring's sequenced cells), levels go to a latest-value
+// slot and log messages stay in the log ring; a single ThreadSafeFunction
+// with at most one call queued drains all three per JS tick into one call,
+// so a new event type adds no main-thread wakeups.
+//
+//   subscribeEvents(callback, { levels?: rateHz, sessions?: boolean, logs?: boolean })
+//   callback({ length, types, dropped, at(i) })
+//
+// types[i] is 'levels', 'session' or 'log', and at(i) builds event i only
+// when asked: { type: 'levels', bands: Float32Array(8), rms },
+// { type: 'session', change, pid, processName, hasActiveAudio } or
+// { type: 'log', level, time, message }. dropped counts events and log
+// messages lost to a full ring since the previous call. While the bus carries
+// levels or sessions, watchLevels() and watchAudioSessions() callbacks get
+// nothing (watchAudioSessions() still runs the registry); logs it carries
+// no longer reach getLogs() or the echo. Per-capture events have their own
+// drain; option 'batch' makes each of those one call as well (pcm_channel.h).
+
+#include <napi.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "addon_instance.h"
+#include "addon_log.h"
+#include "level_meter.h"
+#include "session_table.h"
+
+enum class BusEventType : uint8_t { Levels, Session, Log };
+
+inline const char* BusEventTypeName(BusEventType t) {
+	switch (t) {
+	case BusEventType::Levels: return "levels";
+	case BusEventType::Session: return "session";
+	default: return "log";
+	}
+}
+
+// What producers push: plain data, so a push is one copy into a ring cell.
+struct BusEvent {
+	BusEventType type = BusEventType::Session;
+	SessionChange change = SessionChange::Changed;
+	bool active = false;
+	uint32_t pid = 0;
+	char name[128] = {}; // processName, truncated
+};
+
+// One drain's events, shared with the at() closure that materializes them.
+struct BusBatch {
+	bool hasLevels = false;
+	LevelFrame levels;
+	std::vector<BusEvent> events;
+	std::vector<LogRecord> logs;
+	uint64_t dropped = 0;
+
+	size_t Size() const { return (hasLevels ? 1 : 0) + events.size() + logs.size(); }
+
+	BusEventType Type(size_t i) const {
+		if (hasLevels && i-- == 0) return BusEventType::Levels;
+		return i < events.size() ? events[i].type : BusEventType::Log;
+	}
+};
+
+class EventBus;
+// JS thread; env is null when the function is torn down.
+inline void DeliverBusEvents(Napi::Env env, Napi::Function cb, EventBus* bus, void*);
+
+using BusTsfn = Napi::TypedThreadSafeFunction<EventBus, void, DeliverBusEvents>;
+
+class EventBus {
+public:
+	static constexpr size_t kCapacity = 256;
+
+	EventBus() {
+		for (size_t i = 0; i < kCapacity; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	// JS thread of env. Replaces (and releases) any previous subscriber.
+	void Subscribe(BusTsfn tsfn, napi_env env, bool logs) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (hasTsfn_) tsfn_.Release();
+		tsfn_ = tsfn;
+		hasTsfn_ = true;
+		env_ = env;
+		logs_.store(logs, std::memory_order_relaxed);
+		wake_.store(false, std::memory_order_relaxed);
+	}
+
+	void Unsubscribe() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (hasTsfn_) tsfn_.Release();
+		hasTsfn_ = false;
+		logs_.store(false, std::memory_order_relaxed);
+	}
+
+	// At env teardown: true when the subscriber lived in env and is gone now.
+	bool UnsubscribeEnv(napi_env env) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!hasTsfn_ || env_ != env) return false;
+		tsfn_.Release();
+		hasTsfn_ = false;
+		logs_.store(false, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Any thread. Drops the event (and counts it) when the ring is full.
+	void Post(const BusEvent& event) {
+		uint64_t pos = enqueue_.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;) {
+			cell = &cells_[pos & (kCapacity - 1)];
+			const uint64_t seq = cell->seq.load(std::memory_order_acquire);
+			const int64_t dif = (int64_t)seq - (int64_t)pos;
+			if (dif == 0) {
+				if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			} else if (dif < 0) {
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			} else {
+				pos = enqueue_.load(std::memory_order_relaxed);
+			}
+		}
+		cell->event = event;
+		cell->seq.store(pos + 1, std::memory_order_release);
+		Wake();
+	}
+
+	// Capture thread: replaces any frame not delivered yet.
+	void PostLevels(const LevelFrame& frame) {
+		{
+			std::lock_guard<std::mutex> lock(levelMutex_);
+			levels_ = frame;
+			hasLevels_ = true;
+		}
+		Wake();
+	}
+
+	// Any thread: schedules a drain unless one is already queued.
+	void Wake() {
+		if (wake_.exchange(true, std::memory_order_acq_rel)) return;
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!hasTsfn_ || tsfn_.NonBlockingCall() != napi_ok) wake_.store(false, std::memory_order_release);
+	}
+
+	// JS thread: everything pending, in the order levels, events, logs.
+	// Anything posted from here on schedules the next drain.
+	std::shared_ptr<BusBatch> Take() {
+		wake_.store(false, std::memory_order_release);
+		auto batch = std::make_shared<BusBatch>();
+		{
+			std::lock_guard<std::mutex> lock(levelMutex_);
+			batch->hasLevels = hasLevels_;
+			batch->levels = levels_;
+			hasLevels_ = false;
+		}
+		for (;;) {
+			Cell* cell = &cells_[dequeue_ & (kCapacity - 1)];
+			if (cell->seq.load(std::memory_order_acquire) != dequeue_ + 1) break;
+			batch->events.push_back(cell->event);
+			cell->seq.store(dequeue_ + kCapacity, std::memory_order_release);
+			++dequeue_;
+		}
+		batch->dropped = dropped_.exchange(0, std::memory_order_relaxed);
+		if (logs_.load(std::memory_order_relaxed)) {
+			batch->dropped += AddonLogRing().Drain([&](const LogRecord& r) { batch->logs.push_back(r); });
+		}
+		return batch;
+	}
+
+private:
+	struct Cell {
+		std::atomic<uint64_t> seq;
+		BusEvent event;
+	};
+
+	Cell cells_[kCapacity];
+	alignas(64) std::atomic<uint64_t> enqueue_{0};
+	alignas(64) uint64_t dequeue_ = 0; // JS thread
+	std::atomic<uint64_t> dropped_{0};
+	std::atomic<bool> wake_{false}; // a drain is queued
+	std::atomic<bool> logs_{false};
+	std::mutex levelMutex_;
+	LevelFrame levels_;
+	bool hasLevels_ = false;
+	std::mutex mutex_;
+	BusTsfn tsfn_;
+	bool hasTsfn_ = false;
+	napi_env env_ = nullptr; // tsfn_'s environment
+};
+
+inline EventBus& AddonEventBus() {
+	static EventBus* bus = new EventBus(); // never destroyed: producers may outlive static teardown
+	return *bus;
+}
+
+inline void BusLevels(const LevelFrame& frame) {
+	AddonEventBus().PostLevels(frame);
+}
+
+inline void BusSession(SessionChange change, const AudioSessionRow& row) {
+	BusEvent event;
+	event.type = BusEventType::Session;
+	event.change = change;
+	event.active = row.active;
+	event.pid = row.pid;
+	std::strncpy(event.name, row.processName.c_str(), sizeof(event.name) - 1);
+	AddonEventBus().Post(event);
+}
+
+inline void BusLogWritten() {
+	AddonEventBus().Wake();
+}
+
+// Hands levels, sessions and logs back to their own exports.
+inline void DetachEventBusSources() {
+	AudioLevelSink().Forward(nullptr, 0);
+	AudioSessionTable().Forward(nullptr);
+	AddonLogRing().SetNotify(nullptr);
+}
+
+inline void UnsubscribeEnvEvents(napi_env env) {
+	if (AddonEventBus().UnsubscribeEnv(env)) DetachEventBusSources();
+}
+
+inline Napi::Value BusEventToJs(Napi::Env env, const BusBatch& batch, size_t i) {
+	Napi::Object o = Napi::Object::New(env);
+	if (batch.hasLevels && i-- == 0) {
+		o.Set("type", Napi::String::New(env, "levels"));
+		Napi::Float32Array bands = Napi::Float32Array::New(env, kLevelBands);
+		for (size_t b = 0; b < kLevelBands; ++b) bands[b] = batch.levels.bands[b];
+		o.Set("bands", bands);
+		o.Set("rms", Napi::Number::New(env, batch.levels.rms));
+		return o;
+	}
+	if (i < batch.events.size()) {
+		const BusEvent& e = batch.events[i];
+		o.Set("type", Napi::String::New(env, "session"));
+		o.Set("change", Napi::String::New(env, SessionChangeName(e.change)));
+		o.Set("pid", Napi::Number::New(env, e.pid));
+		o.Set("processName", Napi::String::New(env, e.name));
+		o.Set("hasActiveAudio", Napi::Boolean::New(env, e.active));
+		return o;
+	}
+	const LogRecord& r = batch.logs[i - batch.events.size()];
+	o.Set("type", Napi::String::New(env, "log"));
+	o.Set("level", Napi::String::New(env, LogLevelName(r.level)));
+	o.Set("time", Napi::Number::New(env, r.timeMs));
+	o.Set("message", Napi::String::New(env, r.text));
+	return o;
+}
+
+inline void DeliverBusEvents(Napi::Env env, Napi::Function cb, EventBus* bus, void*) {
+	std::shared_ptr<BusBatch> batch = bus->Take();
+	if (env == nullptr || cb == nullptr) return;
+	const size_t n = batch->Size();
+	if (n == 0 && batch->dropped == 0) return;
+	Napi::Array types = Napi::Array::New(env, n);
+	for (size_t i = 0; i < n; ++i) types.Set((uint32_t)i, Napi::String::New(env, BusEventTypeName(batch->Type(i))));
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("length", Napi::Number::New(env, (double)n));
+	o.Set("types", types);
+	o.Set("dropped", Napi::Number::New(env, (double)batch->dropped));
+	o.Set("at", Napi::Function::New(env, [batch](const Napi::CallbackInfo& info) -> Napi::Value {
+		Napi::Env env = info.Env();
+		if (info.Length() < 1 || !info[0].IsNumber()) return env.Undefined();
+		const double i = info[0].As<Napi::Number>().DoubleValue();
+		if (!(i >= 0 && i < (double)batch->Size())) return env.Undefined();
+		return BusEventToJs(env, *batch, (size_t)i);
+	}, "at"));
+	cb.Call({ o });
+}
+
+// subscribeEvents(callback, { levels?, sessions?, logs? }) - levels is the
+// band-level rate in Hz (1..120), off when omitted. Replaces any previous
+// subscription.
+inline Napi::Value SubscribeEvents(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsFunction()) {
+		Napi::TypeError::New(env, "Callback required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	uint32_t levelsHz = 0;
+	bool sessions = false, logs = false;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object options = info[1].As<Napi::Object>();
+		if (options.Has("levels") && !options.Get("levels").IsUndefined()) {
+			Napi::Value v = options.Get("levels");
+			const double rate = v.IsNumber() ? v.As<Napi::Number>().DoubleValue() : 0;
+			if (!(rate >= 1 && rate <= 120)) {
+				Napi::TypeError::New(env, "Option 'levels' must be a rate between 1 and 120 Hz").ThrowAsJavaScriptException();
+				return env.Null();
+			}
+			levelsHz = (uint32_t)rate;
+		}
+		for (const char* key : { "sessions", "logs" }) {
+			if (!options.Has(key) || options.Get(key).IsUndefined()) continue;
+			Napi::Value v = options.Get(key);
+			if (!v.IsBoolean()) {
+				Napi::TypeError::New(env, std::string("Option '") + key + "' must be a boolean").ThrowAsJavaScriptException();
+				return env.Null();
+			}
+			(key[0] == 's' ? sessions : logs) = v.As<Napi::Boolean>().Value();
+		}
+	}
+	EventBus& bus = AddonEventBus();
+	BusTsfn tsfn = BusTsfn::New(env, info[0].As<Napi::Function>(), "EventBusCallback", 1, 1, &bus);
+	tsfn.Unref(env); // never keeps the process alive
+	bus.Subscribe(tsfn, env, logs);
+	DetachEventBusSources();
+	if (levelsHz > 0) AudioLevelSink().Forward(BusLevels, levelsHz);
+	if (sessions) AudioSessionTable().Forward(BusSession);
+	if (logs) AddonLogRing().SetNotify(BusLogWritten);
+	DetachAtTeardown<UnsubscribeEnvEvents>(env);
+	return Napi::Boolean::New(env, true);
+}
+
+inline Napi::Value UnsubscribeEvents(const Napi::CallbackInfo& info) {
+	AddonEventBus().Unsubscribe();
+	DetachEventBusSources();
+	return info.Env().Undefined();
+}
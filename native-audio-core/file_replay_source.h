@@ -0,0 +1,218 @@
+#pragma once
+
+// Capture source 'file': decodes a WAV, FLAC or anything else libavformat
+// reads into 10 ms blocks of interleaved float at the file's own rate and
+// channel count. The addons downmix and resample them and hand the result to
+// the same back ends a device feeds, so latency, CPU and chunking can be
+// regression-tested on a corpus without audio hardware. ReplayPacer paces
+// the blocks at the file's rate (pace 'realtime') or lets them run as fast as
+// the chain keeps up ('fast'). Needs gyp variable use_avformat=1
+// (AUDIO_CORE_AVFORMAT); otherwise Open() fails and the capture ends at once.
+//
+//   startCapture(0, callback, { source: 'file', file: 'corpus/a.flac', pace: 'fast' })
+//
+// The stream ends with a { type: 'end' } event once the file and the silence
+// that flushes the chain (kReplayTailMs) are delivered.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "downmix.h"
+
+#if defined(AUDIO_CORE_AVFORMAT)
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libswresample/swresample.h>
+}
+#endif
+
+// Silence appended after the file, like a device going quiet, so pauses,
+// holds and lookahead tails close the last utterance.
+constexpr uint32_t kReplayTailMs = 2000;
+
+// Whether a file replays at its own rate or as fast as possible (option "pace").
+enum class ReplayPace { Realtime, Fast };
+
+class FileReplaySource {
+public:
+	FileReplaySource() = default;
+	FileReplaySource(const FileReplaySource&) = delete;
+	FileReplaySource& operator=(const FileReplaySource&) = delete;
+	~FileReplaySource() { Close(); }
+
+	bool Open(const std::string& path, std::string* error) {
+		Close();
+#if defined(AUDIO_CORE_AVFORMAT)
+		if (avformat_open_input(&fmt_, path.c_str(), nullptr, nullptr) < 0) return Fail("could not open ", path, error);
+		if (avformat_find_stream_info(fmt_, nullptr) < 0) return Fail("no stream info in ", path, error);
+		const AVCodec* codec = nullptr;
+		stream_ = av_find_best_stream(fmt_, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+		if (stream_ < 0 || !codec) return Fail("no decodable audio stream in ", path, error);
+		dec_ = avcodec_alloc_context3(codec);
+		if (!dec_ || avcodec_parameters_to_context(dec_, fmt_->streams[stream_]->codecpar) < 0 ||
+		    avcodec_open2(dec_, codec, nullptr) < 0) {
+			return Fail("could not open the decoder for ", path, error);
+		}
+		// Packed float at the file's rate; layouts wider than the downmix
+		// kernels take are folded to stereo by swresample
+		AVChannelLayout in;
+		if (dec_->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC) av_channel_layout_default(&in, dec_->ch_layout.nb_channels);
+		else av_channel_layout_copy(&in, &dec_->ch_layout);
+		AVChannelLayout out;
+		if (in.nb_channels > (int)kMaxDownmixChannels) out = AV_CHANNEL_LAYOUT_STEREO;
+		else av_channel_layout_copy(&out, &in);
+		rate_ = (uint32_t)dec_->sample_rate;
+		channels_ = (uint16_t)out.nb_channels;
+		channelMask_ = out.order == AV_CHANNEL_ORDER_NATIVE ? (uint32_t)out.u.mask : 0;
+		const int r = swr_alloc_set_opts2(&swr_, &out, AV_SAMPLE_FMT_FLT, (int)rate_, &in, dec_->sample_fmt, (int)rate_, 0, nullptr);
+		av_channel_layout_uninit(&in);
+		av_channel_layout_uninit(&out);
+		if (r < 0 || swr_init(swr_) < 0) return Fail("could not set up the sample converter for ", path, error);
+		if (rate_ == 0 || channels_ == 0) return Fail("no sample rate or channels in ", path, error);
+		packet_ = av_packet_alloc();
+		frame_ = av_frame_alloc();
+		if (!packet_ || !frame_) return Fail("out of memory opening ", path, error);
+		pending_.reserve((size_t)BlockFrames() * channels_ * 4);
+		return true;
+#else
+		*error = "replaying " + path + " needs an addon built with use_avformat=1";
+		return false;
+#endif
+	}
+
+	uint32_t SampleRate() const { return rate_; }
+	uint16_t Channels() const { return channels_; }
+	uint32_t ChannelMask() const { return channelMask_; } // WAVE speaker bits, 0 when unknown
+	size_t BlockFrames() const { return rate_ / 100; }
+
+	// Decodes the next block into out (room for BlockFrames() * Channels());
+	// returns its frames, fewer than a block only at the end and 0 after it.
+	size_t Read(float* out) {
+		const size_t want = BlockFrames() * channels_;
+#if defined(AUDIO_CORE_AVFORMAT)
+		while (pending_.size() - consumed_ < want && !drained_) Decode();
+#endif
+		const size_t n = std::min(want, pending_.size() - consumed_);
+		std::copy(pending_.begin() + consumed_, pending_.begin() + consumed_ + n, out);
+		consumed_ += n;
+		if (consumed_ == pending_.size()) {
+			pending_.clear();
+			consumed_ = 0;
+		}
+		return channels_ ? n / channels_ : 0;
+	}
+
+private:
+	void Close() {
+#if defined(AUDIO_CORE_AVFORMAT)
+		av_frame_free(&frame_);
+		av_packet_free(&packet_);
+		swr_free(&swr_);
+		avcodec_free_context(&dec_);
+		avformat_close_input(&fmt_);
+		stream_ = -1;
+#endif
+		pending_.clear();
+		consumed_ = 0;
+		drained_ = false;
+		rate_ = 0;
+		channels_ = 0;
+		channelMask_ = 0;
+	}
+
+#if defined(AUDIO_CORE_AVFORMAT)
+	// Feeds the decoder one packet, or the flush at the end, and converts
+	// whatever it returns onto pending_.
+	void Decode() {
+		int r;
+		while ((r = av_read_frame(fmt_, packet_)) >= 0 && packet_->stream_index != stream_) av_packet_unref(packet_);
+		if (r >= 0) {
+			avcodec_send_packet(dec_, packet_);
+			av_packet_unref(packet_);
+		} else {
+			avcodec_send_packet(dec_, nullptr);
+		}
+		while (avcodec_receive_frame(dec_, frame_) == 0) {
+			Convert(const_cast<const uint8_t**>(frame_->extended_data), frame_->nb_samples);
+			av_frame_unref(frame_);
+		}
+		if (r < 0) {
+			Convert(nullptr, 0); // swresample's delay line
+			drained_ = true;
+		}
+	}
+
+	void Convert(const uint8_t** in, int n) {
+		const int cap = swr_get_out_samples(swr_, n);
+		if (cap <= 0) return;
+		if (consumed_ > 0) { // keep pending_ from growing while a long file plays
+			pending_.erase(pending_.begin(), pending_.begin() + consumed_);
+			consumed_ = 0;
+		}
+		const size_t at = pending_.size();
+		pending_.resize(at + (size_t)cap * channels_);
+		uint8_t* dst = reinterpret_cast<uint8_t*>(pending_.data() + at);
+		const int got = swr_convert(swr_, &dst, cap, in, n);
+		pending_.resize(at + (size_t)std::max(got, 0) * channels_);
+	}
+
+	bool Fail(const char* what, const std::string& path, std::string* error) {
+		*error = what + path;
+		Close();
+		return false;
+	}
+
+	AVFormatContext* fmt_ = nullptr;
+	AVCodecContext* dec_ = nullptr;
+	SwrContext* swr_ = nullptr;
+	AVPacket* packet_ = nullptr;
+	AVFrame* frame_ = nullptr;
+	int stream_ = -1;
+#endif
+	uint32_t rate_ = 0;
+	uint16_t channels_ = 0;
+	uint32_t channelMask_ = 0;
+	std::vector<float> pending_; // decoded, packed float
+	size_t consumed_ = 0;        // of pending_
+	bool drained_ = false;       // the decoder is flushed
+};
+
+// Release times for replayed blocks: frame f of the file is due f / rate
+// seconds after Start(), or at once with pace 'fast'. Capture times follow
+// the same media clock from the addon's own clock at Start(), so they are
+// identical from run to run relative to the first packet.
+class ReplayPacer {
+public:
+	void Start(uint32_t rate, ReplayPace pace, uint64_t clockNs) {
+		rate_ = rate;
+		pace_ = pace;
+		clockNs_ = clockNs;
+		start_ = std::chrono::steady_clock::now();
+	}
+
+	// Milliseconds until `frames` into the stream is due; 0 once it is.
+	uint32_t WaitMs(uint64_t frames) const {
+		if (pace_ == ReplayPace::Fast) return 0;
+		const auto due = start_ + std::chrono::nanoseconds(FrameNs(frames));
+		const auto now = std::chrono::steady_clock::now();
+		if (due <= now) return 0;
+		return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count() + 1;
+	}
+
+	// Capture time (addon clock, ns) of frame `frames`.
+	uint64_t TimeNs(uint64_t frames) const { return clockNs_ + FrameNs(frames); }
+
+private:
+	uint64_t FrameNs(uint64_t frames) const { return rate_ ? frames * 1000000000ull / rate_ : 0; }
+
+	uint32_t rate_ = 0;
+	ReplayPace pace_ = ReplayPace::Realtime;
+	uint64_t clockNs_ = 0;
+	std::chrono::steady_clock::time_point start_;
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+// Experimental libavfilter stage (capture option "filterGraph", e.g.
+// "highpass=f=90,afftdn,dynaudnorm"). The string becomes a persistent
+// AVFilterGraph between an abuffer source and an abuffersink forced back to
+// 16 kHz mono float, and replaces the hand-written voice chain so the two can
+// be compared. The graph may buffer (afftdn, loudnorm), so output is held
+// back until it has a full block and padded with silence when it runs dry;
+// the padding is the stage latency reported in getStats().filterGraphLatencyMs.
+// Built with gyp variable use_avfilter=1 (AUDIO_CORE_AVFILTER, links the
+// vendored libavfilter); otherwise the option is accepted, logged and ignored.
+// The graph allocates frames per block, so this is for experiments, not the
+// allocation-free default path.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "addon_log.h"
+
+#if defined(AUDIO_CORE_AVFILTER)
+extern "C" {
+#include <libavfilter/avfilter.h>
+#include <libavfilter/buffersink.h>
+#include <libavfilter/buffersrc.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+}
+#endif
+
+class FilterGraphStage {
+public:
+	FilterGraphStage() = default;
+	FilterGraphStage(const FilterGraphStage&) = delete;
+	FilterGraphStage& operator=(const FilterGraphStage&) = delete;
+	~FilterGraphStage() { Close(); }
+
+#if defined(AUDIO_CORE_AVFILTER)
+	// Builds the graph; false (stage off) on an empty or invalid spec.
+	bool Configure(float fs, const std::string& spec) {
+		Close();
+		if (spec.empty()) return false;
+		fs_ = fs;
+		graph_ = avfilter_graph_alloc();
+		in_ = av_frame_alloc();
+		out_ = av_frame_alloc();
+		if (!graph_ || !in_ || !out_) return Fail("out of memory");
+		char args[160];
+		snprintf(args, sizeof(args), "sample_rate=%u:sample_fmt=flt:channel_layout=mono:time_base=1/%u", (unsigned)fs, (unsigned)fs);
+		if (avfilter_graph_create_filter(&src_, avfilter_get_by_name("abuffer"), "in", args, nullptr, graph_) < 0) return Fail("abuffer");
+		if (avfilter_graph_create_filter(&sink_, avfilter_get_by_name("abuffersink"), "out", nullptr, nullptr, graph_) < 0) return Fail("abuffersink");
+
+		AVFilterInOut* outputs = avfilter_inout_alloc();
+		AVFilterInOut* inputs = avfilter_inout_alloc();
+		outputs->name = av_strdup("in");
+		outputs->filter_ctx = src_;
+		inputs->name = av_strdup("out");
+		inputs->filter_ctx = sink_;
+		char format[96];
+		snprintf(format, sizeof(format), ",aformat=sample_fmts=flt:sample_rates=%u:channel_layouts=mono", (unsigned)fs);
+		const std::string full = spec + format;
+		const int parsed = avfilter_graph_parse_ptr(graph_, full.c_str(), &inputs, &outputs, nullptr);
+		avfilter_inout_free(&inputs);
+		avfilter_inout_free(&outputs);
+		if (parsed < 0) return Fail("could not parse the filter string");
+		if (avfilter_graph_config(graph_, nullptr) < 0) return Fail("could not configure the graph");
+		AddonLog(LogLevel::Info, "Filter graph stage: %s", spec.c_str());
+		return true;
+	}
+
+	bool Enabled() const { return graph_ != nullptr; }
+
+	// Runs x through the graph in place (block size preserved).
+	void Process(float* x, size_t n) {
+		in_->nb_samples = (int)n;
+		in_->format = AV_SAMPLE_FMT_FLT;
+		in_->sample_rate = (int)fs_;
+		av_channel_layout_default(&in_->ch_layout, 1);
+		in_->pts = (int64_t)pushed_;
+		if (av_frame_get_buffer(in_, 0) == 0) {
+			memcpy(in_->data[0], x, n * sizeof(float));
+			if (av_buffersrc_add_frame(src_, in_) < 0) av_frame_unref(in_);
+		}
+		pushed_ += n;
+		while (av_buffersink_get_frame(sink_, out_) == 0) {
+			const float* y = reinterpret_cast<const float*>(out_->data[0]);
+			fifo_.insert(fifo_.end(), y, y + out_->nb_samples);
+			av_frame_unref(out_);
+		}
+		// Hold back until a full block is ready, then pad whatever runs short
+		const size_t avail = fifo_.size() - fifoAt_;
+		const size_t take = primed_ || avail >= n ? (avail < n ? avail : n) : 0;
+		if (take == n) primed_ = true;
+		const size_t pad = n - take;
+		memset(x, 0, pad * sizeof(float));
+		memcpy(x + pad, fifo_.data() + fifoAt_, take * sizeof(float));
+		fifoAt_ += take;
+		padded_ += pad;
+		if (fifoAt_ > 4096 && fifoAt_ * 2 > fifo_.size()) {
+			fifo_.erase(fifo_.begin(), fifo_.begin() + fifoAt_);
+			fifoAt_ = 0;
+		}
+	}
+
+	float LatencyMs() const { return graph_ ? (float)padded_ * 1000.0f / fs_ : 0.0f; }
+
+	void Close() {
+		avfilter_graph_free(&graph_);
+		av_frame_free(&in_);
+		av_frame_free(&out_);
+		src_ = sink_ = nullptr;
+		fifo_.clear();
+		fifoAt_ = 0;
+		pushed_ = padded_ = 0;
+		primed_ = false;
+	}
+
+private:
+	bool Fail(const char* what) {
+		AddonLog(LogLevel::Error, "Filter graph stage disabled: %s", what);
+		Close();
+		return false;
+	}
+
+	float fs_ = 16000.0f;
+	AVFilterGraph* graph_ = nullptr;
+	AVFilterContext* src_ = nullptr;
+	AVFilterContext* sink_ = nullptr;
+	AVFrame* in_ = nullptr;
+	AVFrame* out_ = nullptr;
+	std::vector<float> fifo_; // graph output not yet handed back
+	size_t fifoAt_ = 0;
+	uint64_t pushed_ = 0, padded_ = 0;
+	bool primed_ = false;
+#else
+	bool Configure(float, const std::string& spec) {
+		if (!spec.empty()) AddonLog(LogLevel::Warn, "Option 'filterGraph' ignored: built without use_avfilter");
+		return false;
+	}
+	bool Enabled() const { return false; }
+	void Process(float*, size_t) {}
+	float LatencyMs() const { return 0.0f; }
+	void Close() {}
+#endif
+};
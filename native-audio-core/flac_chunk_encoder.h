@@ -0,0 +1,340 @@
+#pragma once
+
+// Lossless FLAC encoding of utterance chunks for STT providers that take FLAC
+// but not Opus. encodeFlac(wav, { level }) resolves with a FLAC file encoded
+// on the task pool; 16 kHz speech usually comes out at about half the
+// WAV's size. The encoder covers the fast end of the format - 4096-sample
+// blocks, fixed predictors of order 0..4 picked by residual magnitude,
+// partitioned Rice coding - with constant and verbatim subframes where they
+// are smaller:
+//   0 - predictor order <= 2, one Rice partition
+//   1 - order <= 4, up to 8 partitions (default)
+//   2 - order <= 4, up to 64 partitions
+
+#include <napi.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "async_query.h"
+#include "capture_options.h"
+#include "wav_reader.h"
+
+struct FlacChunkConfig {
+	uint32_t level = 1;
+};
+
+class FlacBitWriter {
+public:
+	explicit FlacBitWriter(std::vector<uint8_t>* out) : out_(out) {}
+
+	void Put(uint32_t value, unsigned bits) {
+		for (unsigned i = bits; i-- > 0;) {
+			acc_ = (uint8_t)(acc_ << 1 | ((value >> i) & 1));
+			if (++fill_ == 8) Flush();
+		}
+	}
+
+	void PutSigned(int32_t value, unsigned bits) { Put((uint32_t)value & (bits >= 32 ? 0xffffffffu : (1u << bits) - 1), bits); }
+
+	void PutRice(uint32_t zigzag, unsigned k) {
+		for (uint32_t q = zigzag >> k; q > 0; --q) Put(0, 1);
+		Put(1, 1);
+		if (k > 0) Put(zigzag & ((1u << k) - 1), k);
+	}
+
+	void Align() { while (fill_ != 0) Put(0, 1); }
+
+	size_t Size() const { return out_->size(); }
+
+private:
+	void Flush() {
+		out_->push_back(acc_);
+		acc_ = 0;
+		fill_ = 0;
+	}
+
+	std::vector<uint8_t>* out_;
+	uint8_t acc_ = 0;
+	unsigned fill_ = 0;
+};
+
+namespace flac_detail {
+
+constexpr size_t kBlock = 4096;
+constexpr unsigned kMaxRiceParam = 14; // 15 is the escape code
+
+inline uint8_t Crc8(const uint8_t* p, size_t n) {
+	uint8_t crc = 0;
+	for (size_t i = 0; i < n; ++i) {
+		crc ^= p[i];
+		for (int k = 0; k < 8; ++k) crc = (uint8_t)(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+	}
+	return crc;
+}
+
+inline uint16_t Crc16(const uint8_t* p, size_t n) {
+	uint16_t crc = 0;
+	for (size_t i = 0; i < n; ++i) {
+		crc ^= (uint16_t)(p[i] << 8);
+		for (int k = 0; k < 8; ++k) crc = (uint16_t)(crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1);
+	}
+	return crc;
+}
+
+inline uint32_t ZigZag(int32_t r) { return r >= 0 ? (uint32_t)r << 1 : ((uint32_t)(-(r + 1)) << 1) | 1; }
+
+// Residual of the fixed predictor of `order` for samples [order, n).
+inline void FixedResidual(const int32_t* x, size_t n, unsigned order, int32_t* out) {
+	for (size_t i = order; i < n; ++i) {
+		switch (order) {
+		case 0: out[i] = x[i]; break;
+		case 1: out[i] = x[i] - x[i - 1]; break;
+		case 2: out[i] = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+		case 3: out[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+		default: out[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+		}
+	}
+}
+
+// Bits of one Rice partition at its best parameter.
+inline uint64_t PartitionBits(const uint32_t* u, size_t n, unsigned* param) {
+	uint64_t sum = 0;
+	for (size_t i = 0; i < n; ++i) sum += u[i];
+	// Start from the mean's magnitude and settle on the cheaper neighbour
+	unsigned k = 0;
+	while (k < kMaxRiceParam && ((uint64_t)n << (k + 1)) < sum) ++k;
+	uint64_t best = ~0ull;
+	for (unsigned c = k > 0 ? k - 1 : 0; c <= k + 1 && c <= kMaxRiceParam; ++c) {
+		uint64_t bits = (uint64_t)n * (c + 1);
+		for (size_t i = 0; i < n; ++i) bits += u[i] >> c;
+		if (bits < best) { best = bits; *param = c; }
+	}
+	return best + 4;
+}
+
+struct RicePlan {
+	unsigned partitionOrder = 0;
+	unsigned params[64] = {};
+	uint64_t bits = ~0ull;
+};
+
+// Picks the partition order (up to maxOrder) with the fewest residual bits.
+inline RicePlan PlanRice(const uint32_t* u, size_t blockSize, unsigned predictorOrder, unsigned maxOrder) {
+	RicePlan best;
+	for (unsigned p = 0; p <= maxOrder; ++p) {
+		const size_t parts = (size_t)1 << p;
+		if (blockSize % parts != 0 || (blockSize >> p) <= predictorOrder) break;
+		RicePlan plan;
+		plan.partitionOrder = p;
+		plan.bits = 2 + 4;
+		size_t at = predictorOrder;
+		for (size_t i = 0; i < parts; ++i) {
+			const size_t end = (i + 1) * (blockSize >> p);
+			plan.bits += PartitionBits(u + at, end - at, &plan.params[i]);
+			at = end;
+		}
+		if (plan.bits < best.bits) best = plan;
+	}
+	return best;
+}
+
+inline void WriteUtf8(FlacBitWriter& w, uint32_t v) {
+	if (v < 0x80) { w.Put(v, 8); return; }
+	int extra = v < 0x800 ? 1 : v < 0x10000 ? 2 : v < 0x200000 ? 3 : v < 0x4000000 ? 4 : 5;
+	static const uint8_t kLead[] = { 0, 0xc0, 0xe0, 0xf0, 0xf8, 0xfc };
+	w.Put(kLead[extra] | (v >> (6 * extra)), 8);
+	for (int i = extra - 1; i >= 0; --i) w.Put(0x80 | ((v >> (6 * i)) & 0x3f), 8);
+}
+
+inline uint32_t SampleRateCode(uint32_t rate) {
+	switch (rate) {
+	case 8000: return 4;
+	case 16000: return 5;
+	case 22050: return 6;
+	case 24000: return 7;
+	case 32000: return 8;
+	case 44100: return 9;
+	case 48000: return 10;
+	default: return 0; // from STREAMINFO
+	}
+}
+
+} // namespace flac_detail
+
+// Streaming pcm16 mono FLAC: a header, then frames of up to 4096 samples
+// appended as they come. EncodeFlacFile() runs one over a whole buffer; the
+// session recorder (session_recorder.h) feeds one from its I/O thread.
+class FlacStreamEncoder {
+public:
+	static constexpr size_t kBlock = flac_detail::kBlock;
+	// STREAMINFO's offset of the 36-bit total sample count, for a writer
+	// that patches it once the stream ends.
+	static constexpr size_t kTotalSamplesOffset = 21;
+
+	FlacStreamEncoder(uint32_t rate, const FlacChunkConfig& config)
+		: rate_(rate), rateCode_(flac_detail::SampleRateCode(rate)),
+		  maxPredictor_(config.level == 0 ? 2 : 4), maxPartition_(config.level == 0 ? 0 : (config.level == 1 ? 3 : 6)),
+		  x_(kBlock), residual_(kBlock), u_(kBlock) {}
+
+	// fLaC and STREAMINFO; samples 0 is "unknown", maxBlock the largest frame to come.
+	void Header(uint64_t samples, uint32_t maxBlock, std::vector<uint8_t>* out) const {
+		FlacBitWriter w(out);
+		w.Put('f', 8); w.Put('L', 8); w.Put('a', 8); w.Put('C', 8);
+		w.Put(1, 1);  // last metadata block
+		w.Put(0, 7);  // STREAMINFO
+		w.Put(34, 24);
+		w.Put(maxBlock, 16);
+		w.Put(maxBlock, 16);
+		w.Put(0, 24); // min/max frame size unknown
+		w.Put(0, 24);
+		w.Put(rate_, 20);
+		w.Put(0, 3);  // mono
+		w.Put(15, 5); // 16 bits
+		PutTotalSamples(w, samples);
+		for (int i = 0; i < 4; ++i) w.Put(0, 32); // MD5 not computed
+	}
+
+	// The 5 bytes at kTotalSamplesOffset for a stream of `samples` (the
+	// bits-per-sample nibble they share included).
+	static void TotalSamplesBytes(uint64_t samples, uint8_t out[5]) {
+		out[0] = (uint8_t)(0xf0 | ((samples >> 32) & 0xf));
+		for (int i = 0; i < 4; ++i) out[1 + i] = (uint8_t)(samples >> (24 - 8 * i));
+	}
+
+	// One frame of n <= kBlock samples.
+	void Frame(const int16_t* pcm, size_t n, std::vector<uint8_t>* out) {
+		using namespace flac_detail;
+		std::vector<int32_t>& x = x_;
+		for (size_t i = 0; i < n; ++i) x[i] = pcm[i];
+
+		FlacBitWriter w(out);
+		const size_t frameStart = w.Size();
+		w.Put(0xfff8, 16); // sync, fixed blocking
+		w.Put(n == kBlock ? 12 : 7, 4); // 4096, or a 16-bit size below
+		w.Put(rateCode_, 4);
+		w.Put(0, 4);  // mono
+		w.Put(4, 3);  // 16 bits
+		w.Put(0, 1);
+		WriteUtf8(w, frameNumber_++);
+		if (n != kBlock) w.Put((uint32_t)(n - 1), 16);
+		w.Put(Crc8(out->data() + frameStart, w.Size() - frameStart), 8);
+
+		bool constant = true;
+		for (size_t i = 1; i < n && constant; ++i) constant = x[i] == x[0];
+		w.Put(0, 1);
+		if (constant) {
+			w.Put(0, 6);
+			w.Put(0, 1);
+			w.PutSigned(x[0], 16);
+		} else {
+			// Fixed predictor with the smallest residual magnitude
+			unsigned order = 0;
+			uint64_t bestSum = ~0ull;
+			for (unsigned o = 0; o <= maxPredictor_ && o < n; ++o) {
+				FixedResidual(x.data(), n, o, residual_.data());
+				uint64_t sum = 0;
+				for (size_t i = o; i < n; ++i) sum += (uint64_t)std::abs(residual_[i]);
+				if (sum < bestSum) { bestSum = sum; order = o; }
+			}
+			FixedResidual(x.data(), n, order, residual_.data());
+			for (size_t i = order; i < n; ++i) u_[i] = ZigZag(residual_[i]);
+			const RicePlan plan = PlanRice(u_.data(), n, order, maxPartition_);
+			if (plan.bits + 16ull * order >= 16ull * n) {
+				w.Put(1, 6); // verbatim
+				w.Put(0, 1);
+				for (size_t i = 0; i < n; ++i) w.PutSigned(x[i], 16);
+			} else {
+				w.Put(8 | order, 6);
+				w.Put(0, 1);
+				for (unsigned i = 0; i < order; ++i) w.PutSigned(x[i], 16);
+				w.Put(0, 2); // Rice, 4-bit parameters
+				w.Put(plan.partitionOrder, 4);
+				const size_t parts = (size_t)1 << plan.partitionOrder;
+				size_t pos = order;
+				for (size_t p = 0; p < parts; ++p) {
+					const size_t end = (p + 1) * (n >> plan.partitionOrder);
+					w.Put(plan.params[p], 4);
+					for (; pos < end; ++pos) w.PutRice(u_[pos], plan.params[p]);
+				}
+			}
+		}
+		w.Align();
+		w.Put(Crc16(out->data() + frameStart, w.Size() - frameStart), 16);
+	}
+
+private:
+	static void PutTotalSamples(FlacBitWriter& w, uint64_t samples) {
+		w.Put((uint32_t)(samples >> 32) & 0xf, 4);
+		w.Put((uint32_t)samples, 32);
+	}
+
+	uint32_t rate_;
+	uint32_t rateCode_;
+	unsigned maxPredictor_;
+	unsigned maxPartition_;
+	uint32_t frameNumber_ = 0;
+	std::vector<int32_t> x_, residual_;
+	std::vector<uint32_t> u_;
+};
+
+// Encodes pcm16 mono into a FLAC file.
+inline void EncodeFlacFile(const int16_t* pcm, size_t samples, uint32_t rate, const FlacChunkConfig& config, std::vector<uint8_t>* out) {
+	constexpr size_t kBlock = FlacStreamEncoder::kBlock;
+	out->clear();
+	out->reserve(samples + 64);
+	FlacStreamEncoder encoder(rate, config);
+	encoder.Header(samples, (uint32_t)(samples < kBlock ? (samples > 16 ? samples : 16) : kBlock), out);
+	for (size_t at = 0; at < samples; at += kBlock) encoder.Frame(pcm + at, samples - at < kBlock ? samples - at : kBlock, out);
+}
+
+// encodeFlac(wav: Buffer, options?: { level? }) -> Promise<Buffer>
+inline Napi::Value EncodeFlac(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsBuffer()) {
+		Napi::TypeError::New(env, "WAV buffer required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	FlacChunkConfig config;
+	if (info.Length() > 1 && !info[1].IsUndefined()) {
+		if (!info[1].IsObject()) {
+			Napi::TypeError::New(env, "FLAC options must be an object").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		std::string error;
+		if (!ReadUint32Option(info[1].As<Napi::Object>(), "level", 0, 2, &config.level, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+	// Copied so JS may reuse or release the buffer (pooled chunk slots) right away
+	Napi::Buffer<uint8_t> wav = info[0].As<Napi::Buffer<uint8_t>>();
+	std::vector<uint8_t> input(wav.Data(), wav.Data() + wav.Length());
+
+	struct Encoded {
+		std::vector<uint8_t> bytes;
+		std::string error;
+	};
+	return QueueQuery(env, "EncodeFlac",
+		[input = std::move(input), config]() {
+			Encoded result;
+			std::vector<int16_t> pcm;
+			uint32_t rate = 0;
+			if (!ReadWavPcm16(input, &pcm, &rate, &result.error)) return result;
+			if (rate == 0 || rate > 655350) {
+				result.error = "WAV sample rate is out of range for FLAC";
+				return result;
+			}
+			EncodeFlacFile(pcm.data(), pcm.size(), rate, config, &result.bytes);
+			return result;
+		},
+		[](Napi::Env env, Encoded& result) -> Napi::Value {
+			if (!result.error.empty()) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			return Napi::Buffer<uint8_t>::Copy(env, result.bytes.data(), result.bytes.size());
+		}, TaskPriority::Background);
+}
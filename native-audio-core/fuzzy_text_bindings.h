@@ -0,0 +1,89 @@
+#pragma once
+
+// JS side of the translation cache's fuzzy index (fuzzy_text_index.h), one
+// per environment:
+//
+//   addFuzzyText(id, normalizedText, group?)      - replaces the id's text
+//   removeFuzzyText(id) -> whether it was there
+//   findFuzzyText(normalizedText, { threshold?, group?, limit? })
+//     -> [{ id, similarity }], most similar first; threshold defaults to 0.8
+//        and limit to 16
+//   clearFuzzyText()
+
+#include <napi.h>
+
+#include <string>
+
+#include "addon_instance.h"
+#include "capture_options.h"
+#include "fuzzy_text_index.h"
+
+inline FuzzyTextIndex& FuzzyTexts(Napi::Env env) {
+	return PerEnv<FuzzyTextIndex>(env);
+}
+
+inline std::u16string FuzzyTextArg(const Napi::Value& v) {
+	return v.As<Napi::String>().Utf16Value();
+}
+
+inline Napi::Value AddFuzzyText(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString()) {
+		Napi::TypeError::New(env, "Id and text required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const std::string group = info.Length() > 2 && info[2].IsString() ? info[2].As<Napi::String>().Utf8Value() : std::string();
+	FuzzyTexts(env).Add(info[0].As<Napi::Number>().Uint32Value(), FuzzyTextArg(info[1]), group);
+	return env.Undefined();
+}
+
+inline Napi::Value RemoveFuzzyText(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsNumber()) {
+		Napi::TypeError::New(env, "Id required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	return Napi::Boolean::New(env, FuzzyTexts(env).Remove(info[0].As<Napi::Number>().Uint32Value()));
+}
+
+inline Napi::Value FindFuzzyText(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Text required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	double threshold = 0.8; // read as a double: 0.8 as a float would miss 1 - 1/5
+	uint32_t limit = 16;
+	std::string group;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object options = info[1].As<Napi::Object>();
+		std::string error;
+		if (!ReadUint32Option(options, "limit", 1, 1024, &limit, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		if (options.Has("threshold") && !options.Get("threshold").IsUndefined()) {
+			Napi::Value t = options.Get("threshold");
+			threshold = t.IsNumber() ? t.As<Napi::Number>().DoubleValue() : -1.0;
+			if (!(threshold >= 0.0 && threshold <= 1.0)) {
+				Napi::TypeError::New(env, "Option 'threshold' must be a number from 0 to 1").ThrowAsJavaScriptException();
+				return env.Null();
+			}
+		}
+		if (options.Has("group") && options.Get("group").IsString()) group = options.Get("group").As<Napi::String>().Utf8Value();
+	}
+	const std::vector<FuzzyMatch> matches = FuzzyTexts(env).Find(FuzzyTextArg(info[0]), threshold, group, limit);
+	Napi::Array out = Napi::Array::New(env, matches.size());
+	for (size_t i = 0; i < matches.size(); ++i) {
+		Napi::Object m = Napi::Object::New(env);
+		m.Set("id", Napi::Number::New(env, matches[i].id));
+		m.Set("similarity", Napi::Number::New(env, matches[i].similarity));
+		out.Set((uint32_t)i, m);
+	}
+	return out;
+}
+
+inline Napi::Value ClearFuzzyText(const Napi::CallbackInfo& info) {
+	FuzzyTexts(info.Env()).Clear();
+	return info.Env().Undefined();
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+// Fuzzy lookup for the translation cache (src/services/TTSCache.ts): the
+// entries whose text is within a similarity threshold of a query, where
+// similarity is FuzzyMatcher's 1 - levenshtein / longer length over UTF-16
+// code units. Texts arrive already normalized by FuzzyMatcher.normalize().
+//
+// Candidates come from an inverted index of character trigrams. An edit
+// destroys at most three trigrams, so a text within d edits of the query
+// shares at least max(length) - 2 - 3d of them (the q-gram lemma). Entries
+// that share fewer are never looked at, and neither are lengths the
+// threshold alone rules out. Lengths so short that the lemma proves nothing
+// (about five characters at 0.8) are scanned from a per-length list. The
+// survivors are verified with the bit-parallel Levenshtein of Myers/Hyyrö
+// (64 columns per word, for texts up to 64 units) or a banded DP, and both
+// give up once the distance is past the threshold's.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct FuzzyMatch {
+	uint32_t id;
+	float similarity;
+};
+
+// Edit distance of a and b, or limit + 1 once it is known to exceed limit.
+inline size_t BoundedLevenshtein(const std::u16string& a, const std::u16string& b, size_t limit) {
+	const std::u16string& p = a.size() <= b.size() ? a : b; // the pattern is the shorter
+	const std::u16string& t = a.size() <= b.size() ? b : a;
+	const size_t m = p.size(), n = t.size();
+	if (n - m > limit) return limit + 1;
+	if (m == 0) return n;
+	if (m <= 64) {
+		uint64_t ascii[128] = {};
+		std::vector<std::pair<char16_t, uint64_t>> other;
+		for (size_t i = 0; i < m; ++i) {
+			const char16_t c = p[i];
+			if (c < 128) {
+				ascii[c] |= uint64_t(1) << i;
+				continue;
+			}
+			auto it = std::find_if(other.begin(), other.end(), [c](const std::pair<char16_t, uint64_t>& e) { return e.first == c; });
+			if (it == other.end()) other.push_back({ c, uint64_t(1) << i });
+			else it->second |= uint64_t(1) << i;
+		}
+		const uint64_t last = uint64_t(1) << (m - 1);
+		uint64_t pv = ~uint64_t(0), mv = 0;
+		size_t score = m;
+		for (size_t j = 0; j < n; ++j) {
+			const char16_t c = t[j];
+			uint64_t eq = 0;
+			if (c < 128) {
+				eq = ascii[c];
+			} else {
+				for (const auto& e : other) if (e.first == c) eq = e.second;
+			}
+			const uint64_t xv = eq | mv;
+			const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+			uint64_t ph = mv | ~(xh | pv);
+			uint64_t mh = pv & xh;
+			if (ph & last) ++score;
+			else if (mh & last) --score;
+			// Row 0 is the distance from the empty pattern, rising by one per column
+			ph = (ph << 1) | 1;
+			mh <<= 1;
+			pv = mh | ~(xv | ph);
+			mv = ph & xv;
+			// The last row falls by at most one per remaining column
+			if (score > limit + (n - j - 1)) return limit + 1;
+		}
+		return score;
+	}
+	// Banded DP: only cells within limit of the diagonal can stay under it.
+	// Each row sets the cell past its band to kFar, which is all the next row
+	// reads outside it.
+	const size_t kFar = limit + 1;
+	std::vector<size_t> prev(n + 2, kFar), cur(n + 2, kFar);
+	for (size_t j = 0; j <= std::min(n, limit); ++j) prev[j] = j;
+	for (size_t i = 1; i <= m; ++i) {
+		const size_t lo = i > limit ? i - limit : 1;
+		const size_t hi = std::min(n, i + limit);
+		cur[lo - 1] = lo == 1 ? std::min(i, kFar) : kFar;
+		size_t best = kFar;
+		for (size_t j = lo; j <= hi; ++j) {
+			const size_t diagonal = prev[j - 1] + (p[i - 1] == t[j - 1] ? 0 : 1);
+			cur[j] = std::min({ diagonal, prev[j] + 1, cur[j - 1] + 1, kFar });
+			best = std::min(best, cur[j]);
+		}
+		cur[hi + 1] = kFar;
+		if (best > limit) return limit + 1;
+		std::swap(prev, cur);
+	}
+	return prev[n];
+}
+
+// The most edits a pair of these lengths may differ by and still reach
+// threshold; the slack keeps 1 - 1/5 at 0.8 as it is in JS.
+inline size_t FuzzyEditBudget(size_t longer, double threshold) {
+	return (size_t)std::floor((1.0 - threshold) * (double)longer + 1e-6);
+}
+
+// JS thread only. Ids are the caller's; adding an id again replaces its text.
+class FuzzyTextIndex {
+public:
+	void Add(uint32_t id, const std::u16string& text, const std::string& group) {
+		Remove(id);
+		uint32_t slot;
+		if (!free_.empty()) {
+			slot = free_.back();
+			free_.pop_back();
+		} else {
+			slot = (uint32_t)entries_.size();
+			entries_.emplace_back();
+			counts_.push_back(0);
+		}
+		Entry& e = entries_[slot];
+		e.id = id;
+		e.text = text;
+		e.group = GroupId(group);
+		e.live = true;
+		for (const auto& gram : Grams(text)) postings_[gram.first].push_back({ slot, gram.second });
+		ByLength(text.size()).push_back(slot);
+		slots_[id] = slot;
+	}
+
+	bool Remove(uint32_t id) {
+		auto it = slots_.find(id);
+		if (it == slots_.end()) return false;
+		const uint32_t slot = it->second;
+		Entry& e = entries_[slot];
+		for (const auto& gram : Grams(e.text)) {
+			auto list = postings_.find(gram.first);
+			if (list == postings_.end()) continue;
+			auto& v = list->second;
+			v.erase(std::remove_if(v.begin(), v.end(), [slot](const Posting& p) { return p.slot == slot; }), v.end());
+			if (v.empty()) postings_.erase(list);
+		}
+		auto& same = ByLength(e.text.size());
+		same.erase(std::remove(same.begin(), same.end(), slot), same.end());
+		e = Entry();
+		free_.push_back(slot);
+		slots_.erase(it);
+		return true;
+	}
+
+	void Clear() {
+		entries_.clear();
+		counts_.clear();
+		free_.clear();
+		slots_.clear();
+		postings_.clear();
+		byLength_.clear();
+	}
+
+	size_t Size() const { return slots_.size(); }
+
+	// Entries in group (any group when empty) at threshold or above, most
+	// similar first, at most limit of them.
+	std::vector<FuzzyMatch> Find(const std::u16string& query, double threshold, const std::string& group, size_t limit) {
+		std::vector<FuzzyMatch> matches;
+		int32_t wanted = -1;
+		if (!group.empty()) {
+			auto g = groups_.find(group);
+			if (g == groups_.end()) return matches;
+			wanted = (int32_t)g->second;
+		}
+		threshold = std::clamp(threshold, 0.0, 1.0);
+		const size_t lq = query.size();
+		// Lengths the threshold allows at all: t * lq <= length <= lq / t
+		const size_t minLength = (size_t)std::max(0.0, std::ceil(threshold * (double)lq - 1e-6));
+		const size_t maxLength = threshold > 0.0 ? (size_t)std::floor((double)lq / threshold + 1e-6) : SIZE_MAX;
+
+		auto verify = [&](uint32_t slot) {
+			const Entry& e = entries_[slot];
+			if (!e.live || (wanted >= 0 && e.group != (uint32_t)wanted)) return;
+			const size_t longer = std::max(lq, e.text.size());
+			if (e.text == query) {
+				matches.push_back({ e.id, 1.0f });
+				return;
+			}
+			if (lq == 0 || e.text.empty()) return; // similarity 0, as FuzzyMatcher's
+			const size_t budget = FuzzyEditBudget(longer, threshold);
+			const size_t d = BoundedLevenshtein(query, e.text, budget);
+			if (d <= budget) matches.push_back({ e.id, 1.0f - (float)d / (float)longer });
+		};
+
+		// Count shared trigrams (as multisets) per entry
+		std::vector<uint32_t> touched;
+		for (const auto& gram : Grams(query)) {
+			auto list = postings_.find(gram.first);
+			if (list == postings_.end()) continue;
+			for (const Posting& p : list->second) {
+				if (counts_[p.slot] == 0) touched.push_back(p.slot);
+				counts_[p.slot] += std::min(gram.second, p.count);
+			}
+		}
+		for (uint32_t slot : touched) {
+			const size_t le = entries_[slot].text.size();
+			const uint32_t shared = counts_[slot];
+			counts_[slot] = 0;
+			if (le < minLength || le > maxLength || LemmaBound(lq, le, threshold) <= 0) continue; // out, or scanned below
+			if ((int64_t)shared >= LemmaBound(lq, le, threshold)) verify(slot);
+		}
+		// Lengths where sharing nothing proves nothing
+		for (auto& bucket : byLength_) {
+			const size_t le = bucket.first;
+			if (le < minLength || le > maxLength || LemmaBound(lq, le, threshold) > 0) continue;
+			for (uint32_t slot : bucket.second) verify(slot);
+		}
+
+		std::sort(matches.begin(), matches.end(), [](const FuzzyMatch& a, const FuzzyMatch& b) { return a.similarity > b.similarity; });
+		if (matches.size() > limit) matches.resize(limit);
+		return matches;
+	}
+
+private:
+	struct Entry {
+		uint32_t id = 0;
+		std::u16string text;
+		uint32_t group = 0;
+		bool live = false;
+	};
+
+	struct Posting {
+		uint32_t slot;
+		uint32_t count; // occurrences of the trigram in the entry
+	};
+
+	// Trigrams shared at the least by texts of these lengths within budget edits
+	static int64_t LemmaBound(size_t lq, size_t le, double threshold) {
+		const size_t longer = std::max(lq, le);
+		return (int64_t)longer - 2 - 3 * (int64_t)FuzzyEditBudget(longer, threshold);
+	}
+
+	// Distinct trigrams with their counts
+	static std::vector<std::pair<uint64_t, uint32_t>> Grams(const std::u16string& text) {
+		std::vector<std::pair<uint64_t, uint32_t>> grams;
+		if (text.size() < 3) return grams;
+		std::vector<uint64_t> all;
+		all.reserve(text.size() - 2);
+		for (size_t i = 0; i + 2 < text.size(); ++i) {
+			all.push_back((uint64_t)text[i] << 32 | (uint64_t)text[i + 1] << 16 | (uint64_t)text[i + 2]);
+		}
+		std::sort(all.begin(), all.end());
+		for (uint64_t g : all) {
+			if (!grams.empty() && grams.back().first == g) ++grams.back().second;
+			else grams.push_back({ g, 1 });
+		}
+		return grams;
+	}
+
+	uint32_t GroupId(const std::string& group) {
+		auto it = groups_.find(group);
+		if (it != groups_.end()) return it->second;
+		const uint32_t id = (uint32_t)groups_.size();
+		groups_[group] = id;
+		return id;
+	}
+
+	std::vector<uint32_t>& ByLength(size_t length) {
+		for (auto& bucket : byLength_) if (bucket.first == length) return bucket.second;
+		byLength_.push_back({ length, {} });
+		return byLength_.back().second;
+	}
+
+	std::vector<Entry> entries_;
+	std::vector<uint32_t> counts_; // per slot, zero between queries
+	std::vector<uint32_t> free_;
+	std::unordered_map<uint32_t, uint32_t> slots_; // id to slot
+	std::unordered_map<uint64_t, std::vector<Posting>> postings_;
+	std::vector<std::pair<size_t, std::vector<uint32_t>>> byLength_;
+	std::unordered_map<std::string, uint32_t> groups_;
+};
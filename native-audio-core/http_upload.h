@@ -0,0 +1,209 @@
+#pragma once
+
+// Native uploads for the pipeline graph's 'upload' node (pipeline_graph.h):
+// the encoded chunk goes to an OpenAI-compatible /audio/transcriptions
+// endpoint from the graph's worker thread, and only the transcript JSON comes
+// back to JS. Without it every chunk crossed to the JS thread as a Buffer,
+// waited for the event loop, was copied into a FormData and then into the
+// network stack by fetch.
+//
+// Each addon sends the request on the OS stack (http_client.cc: WinHTTP on
+// Windows, http_client.mm: NSURLSession on macOS) through one process-wide
+// session, so connections to a provider are kept alive and reused across
+// chunks and pipelines, and HTTP/2 multiplexes them where the server offers
+// it. The body is the chunk's whole file: the graph encodes a chunk once it
+// is cut, so there are no earlier pages to stream ahead; utterances that
+// upload while spoken (chunker.stream) stay on the managed WebSocket in JS.
+//
+// The STT clients send their own files the same way:
+//
+//   uploadTranscription(file: Buffer, upload, { fileName?, mimeType? }?)
+//     -> Promise<{ status, body, bytes, uploadMs }>
+//
+// posted from a thread of its own, since a request can take timeoutMs and
+// the task pool's workers are for compute. Any HTTP status resolves (body
+// as the provider sent it); only a request that got no response rejects.
+// A 2xx response's throughput goes to the Opus bitrate controller
+// (upload_rate.h) as reportUploadThroughput() would.
+//
+// upload: {
+//   provider?: 'openai' | 'deepinfra'   the base URL's default (WhisperApiClient,
+//                                       DeepInfraWhisperClient)
+//   baseUrl?, apiKey, model, language?, prompt?,
+//   responseFormat? ('verbose_json'), temperature? (0),
+//   fields?: { name: string }           more form fields, as sent
+//   timeoutMs? (30000)
+// }
+
+#include <napi.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "async_query.h"
+#include "capture_options.h"
+#include "upload_rate.h"
+
+struct HttpRequest {
+	std::string url;
+	std::vector<std::pair<std::string, std::string>> headers;
+	std::vector<uint8_t> body;
+	uint32_t timeoutMs = 30000;
+};
+
+struct HttpResponse {
+	int status = 0;    // 0 when no response arrived
+	std::string body;
+	std::string error; // transport failure, empty when a response arrived
+};
+
+// Implemented by each addon (http_client.cc / http_client.mm). Blocking, any
+// thread but the JS one; false with response->error when no response came.
+bool HttpPost(const HttpRequest& request, HttpResponse* response);
+
+struct UploadTemplate {
+	std::string url; // the transcriptions endpoint
+	std::string apiKey, model, language, prompt;
+	std::string responseFormat = "verbose_json";
+	float temperature = 0.0f;
+	std::vector<std::pair<std::string, std::string>> fields;
+	uint32_t timeoutMs = 30000;
+};
+
+// The chunk's file as the provider's multipart form, with the template's fields.
+inline void BuildTranscriptionRequest(const UploadTemplate& upload, const std::vector<uint8_t>& file, const char* fileName,
+                                      const char* mimeType, HttpRequest* request) {
+	static thread_local std::mt19937_64 random{ std::random_device{}() };
+	char boundary[48];
+	snprintf(boundary, sizeof(boundary), "----AudioCoreUpload%016llx", (unsigned long long)random());
+	std::string head;
+	auto field = [&](const std::string& name, const std::string& value) {
+		head += std::string("--") + boundary + "\r\nContent-Disposition: form-data; name=\"" + name + "\"\r\n\r\n" + value + "\r\n";
+	};
+	field("model", upload.model);
+	if (!upload.language.empty()) field("language", upload.language);
+	if (!upload.prompt.empty()) field("prompt", upload.prompt);
+	field("response_format", upload.responseFormat);
+	char temperature[32];
+	snprintf(temperature, sizeof(temperature), "%g", upload.temperature);
+	field("temperature", temperature);
+	for (const auto& f : upload.fields) field(f.first, f.second);
+	head += std::string("--") + boundary + "\r\nContent-Disposition: form-data; name=\"file\"; filename=\"" + fileName +
+	        "\"\r\nContent-Type: " + mimeType + "\r\n\r\n";
+	const std::string tail = std::string("\r\n--") + boundary + "--\r\n";
+
+	request->url = upload.url;
+	request->timeoutMs = upload.timeoutMs;
+	request->headers = {
+		{ "Authorization", "Bearer " + upload.apiKey },
+		{ "Content-Type", std::string("multipart/form-data; boundary=") + boundary },
+	};
+	request->body.clear();
+	request->body.reserve(head.size() + file.size() + tail.size());
+	request->body.insert(request->body.end(), head.begin(), head.end());
+	request->body.insert(request->body.end(), file.begin(), file.end());
+	request->body.insert(request->body.end(), tail.begin(), tail.end());
+}
+
+inline bool ReadUploadTemplate(const Napi::Object& obj, UploadTemplate* upload, std::string* error) {
+	int provider = 0;
+	if (!ReadEnumOption(obj, "provider", { "openai", "deepinfra" }, &provider, error)) return false;
+	std::string base = provider == 1 ? "https://api.deepinfra.com/v1/openai" : "https://api.openai.com/v1";
+	if (obj.Get("baseUrl").IsString()) base = obj.Get("baseUrl").As<Napi::String>().Utf8Value();
+	while (!base.empty() && base.back() == '/') base.pop_back();
+	if (base.compare(0, 8, "https://") != 0 && base.compare(0, 7, "http://") != 0) {
+		*error = "Pipeline node 'upload' needs an http(s) baseUrl";
+		return false;
+	}
+	upload->url = base + "/audio/transcriptions";
+	if (!obj.Get("apiKey").IsString() || !obj.Get("model").IsString()) {
+		*error = "Pipeline node 'upload' needs an 'apiKey' and a 'model'";
+		return false;
+	}
+	upload->apiKey = obj.Get("apiKey").As<Napi::String>().Utf8Value();
+	upload->model = obj.Get("model").As<Napi::String>().Utf8Value();
+	if (obj.Get("language").IsString()) upload->language = obj.Get("language").As<Napi::String>().Utf8Value();
+	if (obj.Get("prompt").IsString()) upload->prompt = obj.Get("prompt").As<Napi::String>().Utf8Value();
+	if (obj.Get("responseFormat").IsString()) upload->responseFormat = obj.Get("responseFormat").As<Napi::String>().Utf8Value();
+	if (!ReadFloatOption(obj, "temperature", 0.0f, 1.0f, &upload->temperature, error)) return false;
+	if (!ReadUint32Option(obj, "timeoutMs", 1000, 300000, &upload->timeoutMs, error)) return false;
+	const Napi::Value fields = obj.Get("fields");
+	if (fields.IsObject()) {
+		Napi::Object f = fields.As<Napi::Object>();
+		Napi::Array names = f.GetPropertyNames();
+		for (uint32_t i = 0; i < names.Length(); ++i) {
+			const Napi::Value value = f.Get(names.Get(i));
+			if (!value.IsString()) {
+				*error = "Pipeline node 'upload' fields must be strings";
+				return false;
+			}
+			upload->fields.emplace_back(names.Get(i).As<Napi::String>().Utf8Value(), value.As<Napi::String>().Utf8Value());
+		}
+	} else if (!fields.IsUndefined()) {
+		*error = "Pipeline node 'upload' fields must be an object";
+		return false;
+	}
+	return true;
+}
+
+// uploadTranscription(file, upload, { fileName?, mimeType? }?) -> Promise<{ status, body, bytes, uploadMs }>
+inline Napi::Value UploadTranscription(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsBuffer() || !info[1].IsObject()) {
+		Napi::TypeError::New(env, "File Buffer and upload options required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	UploadTemplate upload;
+	std::string error;
+	if (!ReadUploadTemplate(info[1].As<Napi::Object>(), &upload, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	std::string fileName = "audio.wav", mimeType = "audio/wav";
+	if (info.Length() > 2 && info[2].IsObject()) {
+		Napi::Object obj = info[2].As<Napi::Object>();
+		if (obj.Get("fileName").IsString()) fileName = obj.Get("fileName").As<Napi::String>().Utf8Value();
+		if (obj.Get("mimeType").IsString()) mimeType = obj.Get("mimeType").As<Napi::String>().Utf8Value();
+	}
+	// Copied so JS may go on using the Buffer
+	Napi::Buffer<uint8_t> file = info[0].As<Napi::Buffer<uint8_t>>();
+	auto request = std::make_shared<HttpRequest>();
+	BuildTranscriptionRequest(upload, std::vector<uint8_t>(file.Data(), file.Data() + file.Length()), fileName.c_str(), mimeType.c_str(),
+	                          request.get());
+
+	struct Uploaded {
+		HttpResponse response;
+		uint64_t bytes = 0;
+		double uploadMs = 0;
+	};
+	return QueueQueryVia(env, "UploadTranscription",
+		[](std::function<void()> task) { std::thread(std::move(task)).detach(); },
+		[request]() {
+			Uploaded result;
+			const auto start = std::chrono::steady_clock::now();
+			if (!HttpPost(*request, &result.response) && result.response.error.empty()) result.response.error = "No response";
+			result.uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			result.bytes = request->body.size();
+			return result;
+		},
+		[](Napi::Env env, Uploaded& result) -> Napi::Value {
+			if (result.response.status == 0) {
+				Napi::Error::New(env, result.response.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			if (result.response.status >= 200 && result.response.status < 300) UploadRate(env).Report(result.bytes, result.uploadMs);
+			Napi::Object out = Napi::Object::New(env);
+			out.Set("status", Napi::Number::New(env, result.response.status));
+			out.Set("body", Napi::String::New(env, result.response.body));
+			out.Set("bytes", Napi::Number::New(env, (double)result.bytes));
+			out.Set("uploadMs", Napi::Number::New(env, result.uploadMs));
+			return out;
+		});
+}
@@ -0,0 +1,329 @@
+#pragma once
+
+// Keyword spotting (capture option "keyword"): a small depthwise-separable CNN
+// (DS-CNN, as in Zhang et al., "Hello Edge") over MFCCs of the delivered 16 kHz
+// stream. Once a keyword is heard the packet writer opens a transcription
+// window and only utterance chunks inside it reach JS; everything else is cut
+// as usual and dropped, so STT never sees the hours in between.
+//
+// Front end: the capture's shared log-mel frames (log_mel.h: 25 ms windows
+// every 10 ms, 80 bands, log10) and the first `coeffs` orthonormal DCT-II
+// coefficients of each, at the delivered level (after the voice chain's gain).
+//
+// The network reads the newest `frames` rows of coefficients as a
+// frames x coeffs image: one kernelT x kernelF convolution with stride
+// strideT x strideF, then `blocks` of 3x3 depthwise + 1x1 pointwise
+// convolutions, all `channels` wide with 'same' padding, batch norm folded
+// in and ReLU after every convolution; global average pooling and a fully
+// connected layer give one logit per label. Label 0 is the filler class
+// (silence, other words); a keyword fires when its softmax, averaged over the
+// inferences of the last 200 ms, reaches the threshold.
+//
+// Model file, little-endian: "KWS2", nine uint32 (frames, coeffs, kernelT,
+// kernelF, strideT, strideF, channels, blocks, labels), each label's name as
+// one length byte and its UTF-8 bytes, then float32 weights in this order:
+// conv [channels][kernelT][kernelF] and bias [channels]; per block depthwise
+// [channels][3][3], its bias, pointwise [out][in], its bias; fully connected
+// [labels][channels] and bias [labels]. A 98 x 10 input through a 10 x 4
+// convolution with stride 2 x 2, 64 channels and four blocks (the paper's
+// DS-CNN S over a 10 ms hop) is about 2.7 M multiply-adds an inference, and
+// inferences only run while the VAD has heard speech within the last window,
+// every strideMs (40 ms by default): a few percent of one core while people
+// talk, and only the DCT otherwise.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log_mel.h"
+#include "mapped_file.h"
+
+struct KeywordModel {
+	uint32_t frames = 0, coeffs = 0;
+	uint32_t kernelT = 0, kernelF = 0, strideT = 1, strideF = 1;
+	uint32_t channels = 0, blocks = 0, labels = 0;
+	std::vector<std::string> names;
+	// Convolution and depthwise weights are kept tap-major ([tap][channels])
+	// and pointwise ones input-major ([in][out]), so every inner loop runs over
+	// contiguous output channels
+	std::vector<float> convWeights, convBias;
+	struct Block {
+		std::vector<float> depthwise, depthwiseBias, pointwise, pointwiseBias;
+	};
+	std::vector<Block> block;
+	std::vector<float> fcWeights, fcBias;
+
+	uint32_t OutFrames() const { return (frames + strideT - 1) / strideT; }
+	uint32_t OutCoeffs() const { return (coeffs + strideF - 1) / strideF; }
+
+	// JS thread (option parsing). Null with *error set when the file is not a
+	// model this spotter can run.
+	static std::shared_ptr<const KeywordModel> Load(const std::string& path, std::string* error) {
+		MappedFile file;
+		if (!file.Open(path, error)) {
+			*error = "Keyword model: " + *error;
+			return nullptr;
+		}
+		const uint8_t* p = file.Data();
+		const uint8_t* end = p + file.Size();
+		auto fail = [&](const char* what) {
+			*error = std::string("Keyword model ") + path + ": " + what;
+			return nullptr;
+		};
+		if (end - p < 4 + 9 * 4 || memcmp(p, "KWS2", 4) != 0) return fail("not a KWS2 file");
+		p += 4;
+		auto model = std::make_shared<KeywordModel>();
+		uint32_t* dims[] = { &model->frames, &model->coeffs, &model->kernelT, &model->kernelF, &model->strideT,
+		                     &model->strideF, &model->channels, &model->blocks, &model->labels };
+		for (uint32_t* d : dims) {
+			*d = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+			p += 4;
+		}
+		const KeywordModel& m = *model;
+		if (m.frames < 1 || m.frames > 400 || m.coeffs < 1 || m.coeffs > kMelBands || m.kernelT < 1 || m.kernelT > m.frames ||
+		    m.kernelF < 1 || m.kernelF > m.coeffs || m.strideT < 1 || m.strideT > m.kernelT || m.strideF < 1 ||
+		    m.strideF > m.kernelF || m.channels < 1 || m.channels > 256 || m.blocks > 16 || m.labels < 2 || m.labels > 64) {
+			return fail("unsupported dimensions");
+		}
+		for (uint32_t i = 0; i < m.labels; ++i) {
+			if (p >= end || end - p - 1 < *p) return fail("truncated label names");
+			model->names.emplace_back(reinterpret_cast<const char*>(p + 1), *p);
+			p += 1 + *p;
+		}
+		auto take = [&](std::vector<float>* out, size_t count) {
+			if ((size_t)(end - p) < count * sizeof(float)) return false;
+			out->resize(count);
+			memcpy(out->data(), p, count * sizeof(float)); // little-endian hosts only (x64, arm64)
+			p += count * sizeof(float);
+			return true;
+		};
+		const size_t c = m.channels;
+		bool ok = take(&model->convWeights, c * m.kernelT * m.kernelF) && take(&model->convBias, c);
+		model->block.resize(m.blocks);
+		for (Block& b : model->block) {
+			ok = ok && take(&b.depthwise, c * 9) && take(&b.depthwiseBias, c) && take(&b.pointwise, c * c) &&
+			     take(&b.pointwiseBias, c);
+		}
+		ok = ok && take(&model->fcWeights, (size_t)m.labels * c) && take(&model->fcBias, m.labels);
+		if (!ok) return fail("truncated weights");
+		TapMajor(&model->convWeights, c, (size_t)m.kernelT * m.kernelF);
+		for (Block& b : model->block) {
+			TapMajor(&b.depthwise, c, 9);
+			TapMajor(&b.pointwise, c, c);
+		}
+		if (p != end) return fail("trailing bytes after the weights");
+		return model;
+	}
+
+	static constexpr uint32_t kMelBands = LogMelFrontEnd::kBands;
+
+private:
+	static void TapMajor(std::vector<float>* w, size_t channels, size_t taps) {
+		std::vector<float> t(w->size());
+		for (size_t c = 0; c < channels; ++c) {
+			for (size_t k = 0; k < taps; ++k) t[k * channels + c] = (*w)[c * taps + k];
+		}
+		w->swap(t);
+	}
+};
+
+struct KeywordSpotterConfig {
+	bool enabled = false;
+	std::shared_ptr<const KeywordModel> model; // option "model": path, loaded while parsing
+	float threshold = 0.8f;    // smoothed keyword probability that fires
+	uint32_t windowMs = 8000;  // chunks delivered after a keyword
+	uint32_t strideMs = 40;    // between inferences, a multiple of the 10 ms hop
+};
+
+// A keyword heard: its label (1..labels-1) and smoothed probability.
+struct KeywordHit {
+	uint32_t label = 0;
+	float score = 0.0f;
+};
+
+class KeywordSpotter {
+public:
+	void Configure(uint32_t sampleRate, const KeywordSpotterConfig& config) {
+		model_ = config.enabled && sampleRate == 16000 ? config.model : nullptr;
+		if (!model_) return;
+		const KeywordModel& m = *model_;
+		threshold_ = config.threshold;
+		strideHops_ = std::max<uint32_t>(1, config.strideMs / kHopMs);
+		smoothing_ = std::max<uint32_t>(1, kSmoothingMs / (strideHops_ * kHopMs));
+		dct_.resize((size_t)m.coeffs * KeywordModel::kMelBands);
+		for (uint32_t k = 0; k < m.coeffs; ++k) {
+			const double scale = std::sqrt((k == 0 ? 1.0 : 2.0) / KeywordModel::kMelBands);
+			for (uint32_t n = 0; n < KeywordModel::kMelBands; ++n) {
+				dct_[(size_t)k * KeywordModel::kMelBands + n] =
+				    (float)(scale * std::cos(3.141592653589793 * k * (n + 0.5) / KeywordModel::kMelBands));
+			}
+		}
+		history_.assign((size_t)m.frames * m.coeffs, 0.0f);
+		const size_t cells = (size_t)m.OutFrames() * m.OutCoeffs() * m.channels;
+		act_.assign(cells, 0.0f);
+		tmp_.assign(cells, 0.0f);
+		input_.assign((size_t)m.frames * m.coeffs, 0.0f);
+		posteriors_.assign((size_t)smoothing_ * m.labels, 0.0f);
+		Reset();
+	}
+
+	void Reset() {
+		rows_ = 0;
+		row_ = 0;
+		hops_ = 0;
+		speechHops_ = 0;
+		refractoryHops_ = 0;
+		inferences_ = 0;
+		std::fill(posteriors_.begin(), posteriors_.end(), 0.0f);
+	}
+
+	bool Enabled() const { return model_ != nullptr; }
+	const KeywordModel* Model() const { return model_.get(); }
+
+	// Inference runs until a model window after the last VAD frame with speech.
+	void NoteSpeech() { speechHops_ = model_ ? model_->frames : 0; }
+
+	// Capture thread: the next log-mel frame (kMelBands values), one row of
+	// coefficients, and an inference every strideHops_. Returns true with *hit
+	// set when a keyword fired (at most once per model window).
+	bool PushFrame(const float* logMel, KeywordHit* hit) {
+		const KeywordModel& m = *model_;
+		float* row = &history_[(size_t)row_ * m.coeffs];
+		for (uint32_t k = 0; k < m.coeffs; ++k) {
+			const float* d = &dct_[(size_t)k * KeywordModel::kMelBands];
+			float sum = 0.0f;
+			for (uint32_t n = 0; n < KeywordModel::kMelBands; ++n) sum += d[n] * logMel[n];
+			row[k] = sum;
+		}
+		row_ = (row_ + 1) % m.frames;
+		if (rows_ < m.frames) ++rows_;
+		if (refractoryHops_ > 0) --refractoryHops_;
+		const bool listening = speechHops_ > 0;
+		if (speechHops_ > 0) --speechHops_;
+		if (++hops_ % strideHops_ != 0 || rows_ < m.frames) return false;
+		if (!listening) {
+			if (inferences_ > 0) { // forget the last utterance's posteriors
+				std::fill(posteriors_.begin(), posteriors_.end(), 0.0f);
+				inferences_ = 0;
+			}
+			return false;
+		}
+		Infer();
+		std::copy(probabilities_, probabilities_ + m.labels, &posteriors_[(size_t)(inferences_++ % smoothing_) * m.labels]);
+		if (refractoryHops_ > 0) return false;
+		const uint32_t averaged = std::min(inferences_, smoothing_);
+		for (uint32_t k = 1; k < m.labels; ++k) {
+			float sum = 0.0f;
+			for (uint32_t i = 0; i < averaged; ++i) sum += posteriors_[(size_t)i * m.labels + k];
+			if (sum / averaged >= threshold_) {
+				hit->label = k;
+				hit->score = sum / averaged;
+				refractoryHops_ = m.frames;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Samples the model looks at: a keyword that fires at stream index i
+	// started no earlier than i - WindowSamples().
+	size_t WindowSamples() const { return model_ ? (size_t)model_->frames * LogMelFrontEnd::kHop + LogMelFrontEnd::kWindow : 0; }
+
+	// Last inference's probabilities (labels), for the bench.
+	const float* Posteriors() const { return probabilities_; }
+
+	// One forward pass over the newest rows; public for the bench.
+	void Infer() {
+		const KeywordModel& m = *model_;
+		for (uint32_t t = 0; t < m.frames; ++t) {
+			const size_t from = (size_t)((row_ + t) % m.frames) * m.coeffs; // oldest row first
+			std::copy(&history_[from], &history_[from] + m.coeffs, &input_[(size_t)t * m.coeffs]);
+		}
+		const int T = (int)m.OutFrames(), F = (int)m.OutCoeffs(), C = (int)m.channels;
+		const int padT = (int)std::max<int64_t>(0, ((int64_t)T - 1) * m.strideT + m.kernelT - m.frames) / 2;
+		const int padF = (int)std::max<int64_t>(0, ((int64_t)F - 1) * m.strideF + m.kernelF - m.coeffs) / 2;
+		for (int t = 0; t < T; ++t) {
+			for (int f = 0; f < F; ++f) {
+				float* out = &act_[((size_t)t * F + f) * C];
+				std::copy(m.convBias.begin(), m.convBias.end(), out);
+				for (uint32_t i = 0; i < m.kernelT; ++i) {
+					const int y = t * (int)m.strideT + (int)i - padT;
+					if (y < 0 || y >= (int)m.frames) continue;
+					for (uint32_t j = 0; j < m.kernelF; ++j) {
+						const int x = f * (int)m.strideF + (int)j - padF;
+						if (x < 0 || x >= (int)m.coeffs) continue;
+						const float v = input_[(size_t)y * m.coeffs + x];
+						const float* w = &m.convWeights[((size_t)i * m.kernelF + j) * C];
+						for (int c = 0; c < C; ++c) out[c] += w[c] * v;
+					}
+				}
+				for (int c = 0; c < C; ++c) out[c] = std::max(0.0f, out[c]);
+			}
+		}
+		for (const KeywordModel::Block& b : m.block) {
+			for (int t = 0; t < T; ++t) {
+				for (int f = 0; f < F; ++f) {
+					float* out = &tmp_[((size_t)t * F + f) * C];
+					for (int c = 0; c < C; ++c) out[c] = b.depthwiseBias[c];
+					for (int i = -1; i <= 1; ++i) {
+						if (t + i < 0 || t + i >= T) continue;
+						for (int j = -1; j <= 1; ++j) {
+							if (f + j < 0 || f + j >= F) continue;
+							const float* in = &act_[((size_t)(t + i) * F + (f + j)) * C];
+							const float* w = &b.depthwise[((size_t)(i + 1) * 3 + (j + 1)) * C];
+							for (int c = 0; c < C; ++c) out[c] += w[c] * in[c];
+						}
+					}
+					for (int c = 0; c < C; ++c) out[c] = std::max(0.0f, out[c]);
+				}
+			}
+			for (size_t cell = 0; cell < (size_t)T * F; ++cell) {
+				const float* in = &tmp_[cell * C];
+				float* out = &act_[cell * C];
+				std::copy(b.pointwiseBias.begin(), b.pointwiseBias.end(), out);
+				for (int c = 0; c < C; ++c) {
+					const float* w = &b.pointwise[(size_t)c * C];
+					const float v = in[c];
+					if (v == 0.0f) continue; // ReLU leaves many
+					for (int o = 0; o < C; ++o) out[o] += w[o] * v;
+				}
+				for (int o = 0; o < C; ++o) out[o] = std::max(0.0f, out[o]);
+			}
+		}
+		float pooled[256] = {};
+		for (size_t cell = 0; cell < (size_t)T * F; ++cell) {
+			for (int c = 0; c < C; ++c) pooled[c] += act_[cell * C + c];
+		}
+		float best = -INFINITY;
+		for (uint32_t k = 0; k < m.labels; ++k) {
+			float sum = m.fcBias[k];
+			for (int c = 0; c < C; ++c) sum += m.fcWeights[(size_t)k * C + c] * pooled[c] / (float)(T * F);
+			probabilities_[k] = sum;
+			best = std::max(best, sum);
+		}
+		float total = 0.0f;
+		for (uint32_t k = 0; k < m.labels; ++k) total += probabilities_[k] = std::exp(probabilities_[k] - best);
+		for (uint32_t k = 0; k < m.labels; ++k) probabilities_[k] /= total;
+	}
+
+private:
+	static constexpr uint32_t kHopMs = 10;
+	static constexpr uint32_t kSmoothingMs = 200;
+
+	std::shared_ptr<const KeywordModel> model_;
+	float threshold_ = 0.8f;
+	uint32_t strideHops_ = 4, smoothing_ = 5;
+	std::vector<float> dct_;
+	std::vector<float> history_;   // frames rows of coefficients, ring
+	uint32_t rows_ = 0, row_ = 0;  // rows filled, and the oldest (next written)
+	uint64_t hops_ = 0;
+	uint32_t speechHops_ = 0, refractoryHops_ = 0;
+	std::vector<float> input_, act_, tmp_;
+	float probabilities_[64] = {};
+	std::vector<float> posteriors_; // last smoothing_ inferences, ring
+	uint32_t inferences_ = 0;
+};
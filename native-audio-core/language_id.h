@@ -0,0 +1,182 @@
+#pragma once
+
+// Spoken-language identification (capture option "languageId") over the first
+// second of each utterance, on the capture's shared log-mel frames
+// (log_mel.h), so the chunker's minimum length and the STT request's language
+// are settled before the utterance is uploaded instead of Whisper spending
+// its first decoding pass on language detection.
+//
+// From the utterance's first speech frame on, its 10 ms log-mel frames are
+// pooled (pooled_mel.h). After kFrames frames, or at a cut once kMinFrames
+// are in, the model's network and a softmax give the utterance's language; it
+// holds for the utterance's later chunks until the chunker goes idle. There
+// is no built-in model: language identity cannot be hand-tuned the way
+// content_classifier.h's stumps are.
+//
+// Model file, little-endian: "LID1", three uint32 (inputs, which must be
+// kPooledMelFeatures; hidden units, 0 for none; languages), then per language
+// a uint8 length and its code as Whisper names it ("en", "ru"; at most 7
+// bytes), then the network's weights with one output per language
+// (PooledMelNet).
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "pooled_mel.h"
+
+struct LanguageIdModel {
+	std::vector<std::string> languages;
+	PooledMelNet net;
+
+	// Softmax over languages into probabilities (languages.size()); scratch
+	// holds the net's hidden units.
+	void Classify(const float* features, float* probabilities, float* scratch) const {
+		net.Forward(features, probabilities, scratch);
+		const float top = *std::max_element(probabilities, probabilities + languages.size());
+		float total = 0.0f;
+		for (size_t l = 0; l < languages.size(); ++l) total += probabilities[l] = std::exp(probabilities[l] - top);
+		for (size_t l = 0; l < languages.size(); ++l) probabilities[l] /= total;
+	}
+
+	// Index of a language code, or -1.
+	int Find(const std::string& code) const {
+		for (size_t l = 0; l < languages.size(); ++l) {
+			if (languages[l] == code) return (int)l;
+		}
+		return -1;
+	}
+
+	// JS thread (option parsing). Null with *error set when the file is not a
+	// model this stage can run.
+	static std::shared_ptr<const LanguageIdModel> Load(const std::string& path, std::string* error) {
+		MappedFile file;
+		if (!file.Open(path, error)) {
+			*error = "Language model: " + *error;
+			return nullptr;
+		}
+		const uint8_t* p = file.Data();
+		const uint8_t* end = p + file.Size();
+		auto fail = [&](const char* what) {
+			*error = std::string("Language model ") + path + ": " + what;
+			return nullptr;
+		};
+		auto u32 = [&]() {
+			const uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+			p += 4;
+			return v;
+		};
+		if (end - p < 4 + 3 * 4 || memcmp(p, "LID1", 4) != 0) return fail("not a LID1 file");
+		p += 4;
+		const uint32_t inputs = u32(), hidden = u32(), languages = u32();
+		if (inputs != kPooledMelFeatures || hidden > 1024 || languages < 2 || languages > 128) return fail("unsupported dimensions");
+		auto model = std::make_shared<LanguageIdModel>();
+		for (uint32_t l = 0; l < languages; ++l) {
+			if (end - p < 1 || end - p < 1 + p[0]) return fail("truncated language codes");
+			const uint8_t length = *p++;
+			if (length == 0 || length > 7) return fail("language codes must be 1 to 7 bytes");
+			model->languages.emplace_back(reinterpret_cast<const char*>(p), length);
+			p += length;
+		}
+		if (!model->net.Read(&p, end, hidden, languages)) return fail("truncated weights");
+		if (p != end) return fail("trailing bytes after the weights");
+		return model;
+	}
+};
+
+struct LanguageIdConfig {
+	bool enabled = false;
+	std::shared_ptr<const LanguageIdModel> model; // option "model": path, loaded while parsing
+	float minConfidence = 0.6f; // below it the utterance's language stays unknown
+	// Option "minChunkMs": { code: ms }; by the model's language index, 0 for
+	// the channel's own minimum
+	std::vector<uint32_t> minChunkMs;
+};
+
+class LanguageIdentifier {
+public:
+	static constexpr uint32_t kFrames = 100;   // the utterance's first second
+	static constexpr uint32_t kMinFrames = 30; // a shorter first chunk decides on what it has
+
+	void Configure(uint32_t sampleRate, const LanguageIdConfig& config) {
+		config_ = config;
+		if (sampleRate != 16000) config_.model = nullptr;
+		if (!Enabled()) return;
+		probabilities_.assign(config_.model->languages.size(), 0.0f);
+		scratch_.assign(config_.model->net.hidden, 0.0f);
+		End();
+	}
+
+	bool Enabled() const { return config_.enabled && config_.model != nullptr; }
+
+	// The chunker found an utterance's first speech; frames from stream frame
+	// `frame` on are its own.
+	void Begin(uint64_t frame) {
+		End();
+		started_ = true;
+		from_ = frame;
+	}
+
+	// The utterance is over (the chunker is idle): its language is forgotten.
+	void End() {
+		started_ = false;
+		decided_ = false;
+		language_ = -1;
+		confidence_ = 0.0f;
+		stats_.Reset();
+	}
+
+	bool Started() const { return started_; }
+
+	// Capture thread: stream frame k's kBands log-mel values, in order.
+	void PushFrame(uint64_t k, const float* logMel) {
+		if (!started_ || decided_ || k < from_) return;
+		stats_.Push(logMel);
+		if (stats_.Frames() == kFrames) Decide();
+	}
+
+	// At a cut: a chunk ending before the second is up still gets a language
+	// when it held enough frames.
+	void Finish() {
+		if (started_ && !decided_ && stats_.Frames() >= kMinFrames) Decide();
+	}
+
+	// The utterance's language as a model index, -1 while unknown.
+	int Language() const { return language_; }
+	float Confidence() const { return confidence_; }
+
+	// The chunker's minimum for the open utterance.
+	uint32_t MinChunkMs(uint32_t channelMs) const {
+		if (language_ < 0 || (size_t)language_ >= config_.minChunkMs.size() || config_.minChunkMs[language_] == 0) return channelMs;
+		return config_.minChunkMs[language_];
+	}
+
+	// Statistics behind the latest decision, for the bench.
+	const float* Features() const { return features_; }
+
+private:
+	void Decide() {
+		decided_ = true;
+		stats_.Features(features_);
+		config_.model->Classify(features_, probabilities_.data(), scratch_.data());
+		const size_t best = std::max_element(probabilities_.begin(), probabilities_.end()) - probabilities_.begin();
+		confidence_ = probabilities_[best];
+		language_ = confidence_ >= config_.minConfidence ? (int)best : -1;
+	}
+
+	LanguageIdConfig config_;
+	bool started_ = false;
+	bool decided_ = false;
+	uint64_t from_ = 0;
+	PooledMelStats stats_;
+	float features_[kPooledMelFeatures] = {};
+	std::vector<float> probabilities_;
+	std::vector<float> scratch_;
+	int language_ = -1;
+	float confidence_ = 0.0f;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+// Per-stage processing times for getStats(). HDR-style log-linear buckets:
+// every power of two is split into 8 sub-buckets, so a percentile is within
+// 12.5% of the true value from nanoseconds to seconds in a fixed 4 KB of
+// counters. The capture thread records with relaxed atomics and never
+// blocks; the JS thread reads a summary at any time. Counts run from the
+// start of the capture; telemetry that wants intervals diffs them.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+struct LatencySummary {
+	uint64_t count = 0;
+	double meanUs = 0.0;
+	double p50Us = 0.0;
+	double p99Us = 0.0;
+	double maxUs = 0.0;
+};
+
+class LatencyHistogram {
+public:
+	static constexpr int kSubBits = 3;
+	static constexpr size_t kSub = (size_t)1 << kSubBits;
+	static constexpr size_t kBuckets = (64 - kSubBits + 1) * kSub;
+
+	void Reset() {
+		for (auto& b : buckets_) b.store(0, std::memory_order_relaxed);
+		count_.store(0, std::memory_order_relaxed);
+		sumNs_.store(0, std::memory_order_relaxed);
+		maxNs_.store(0, std::memory_order_relaxed);
+	}
+
+	// Capture thread (the only writer).
+	void Record(uint64_t ns) {
+		buckets_[Index(ns)].fetch_add(1, std::memory_order_relaxed);
+		sumNs_.fetch_add(ns, std::memory_order_relaxed);
+		if (ns > maxNs_.load(std::memory_order_relaxed)) maxNs_.store(ns, std::memory_order_relaxed);
+		count_.fetch_add(1, std::memory_order_release);
+	}
+
+	// Any thread. Percentiles are the midpoints of their buckets; a record in
+	// flight may be missing from either the buckets or the count.
+	LatencySummary Summary() const {
+		LatencySummary s;
+		s.count = count_.load(std::memory_order_acquire);
+		if (s.count == 0) return s;
+		s.meanUs = (double)sumNs_.load(std::memory_order_relaxed) / (double)s.count / 1000.0;
+		s.maxUs = (double)maxNs_.load(std::memory_order_relaxed) / 1000.0;
+		const uint64_t p50 = (s.count + 1) / 2, p99 = s.count - s.count / 100;
+		uint64_t seen = 0;
+		bool have50 = false;
+		for (size_t i = 0; i < kBuckets; ++i) {
+			seen += buckets_[i].load(std::memory_order_relaxed);
+			if (!have50 && seen >= p50) {
+				s.p50Us = Midpoint(i) / 1000.0;
+				have50 = true;
+			}
+			if (seen >= p99) {
+				s.p99Us = Midpoint(i) / 1000.0;
+				break;
+			}
+		}
+		s.p50Us = std::min(s.p50Us, s.maxUs);
+		s.p99Us = std::min(s.p99Us, s.maxUs);
+		return s;
+	}
+
+private:
+	static int HighBit(uint64_t v) {
+#if defined(_MSC_VER)
+		unsigned long bit;
+		_BitScanReverse64(&bit, v);
+		return (int)bit;
+#else
+		return 63 - __builtin_clzll(v);
+#endif
+	}
+
+	// Values below kSub get a bucket each; above, the leading bit picks the
+	// group and the kSubBits after it the sub-bucket.
+	static size_t Index(uint64_t v) {
+		if (v < kSub) return (size_t)v;
+		const int high = HighBit(v);
+		const int shift = high - kSubBits;
+		return (size_t)(high - kSubBits + 1) * kSub + (size_t)((v >> shift) & (kSub - 1));
+	}
+
+	static double Midpoint(size_t index) {
+		if (index < kSub) return (double)index;
+		const int shift = (int)(index / kSub) - 1;
+		const uint64_t lower = (uint64_t)(kSub + index % kSub) << shift;
+		return (double)lower + (double)((uint64_t)1 << shift) / 2.0;
+	}
+
+	std::atomic<uint64_t> buckets_[kBuckets] = {};
+	std::atomic<uint64_t> count_{0};
+	std::atomic<uint64_t> sumNs_{0};
+	std::atomic<uint64_t> maxNs_{0};
+};
+
+// Times one stage into a histogram: ns since the previous Lap (or
+// construction), then restarts. Returns the ns recorded.
+class StageClock {
+public:
+	StageClock() : last_(std::chrono::steady_clock::now()) {}
+	uint64_t Lap(LatencyHistogram* histogram) {
+		const auto now = std::chrono::steady_clock::now();
+		const uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_).count();
+		histogram->Record(ns);
+		last_ = now;
+		return ns;
+	}
+
+private:
+	std::chrono::steady_clock::time_point last_;
+};
@@ -0,0 +1,315 @@
+#pragma once
+
+// Round-trip latency self-test (RenderSession.measureLatency()). A render
+// session plays a short chirp on its output and the first running capture to
+// hear it times the chirp at each stage, so support can see where a
+// machine's delay goes (BlackHole, VB-Cable and vendor APOs differ wildly)
+// and tune latencyMode for it:
+//
+//   outputMs   - from the render callback that wrote the chirp to the capture
+//                timestamp of its first sample: the output's buffering and
+//                the driver (through speakers into a microphone, the air too)
+//   captureMs  - from the capture timestamp of its last sample to the capture
+//                thread handing that sample to the packet writer: the capture
+//                buffering, the front end and the voice chain
+//   pipelineMs - from there to the JS-thread drain that delivers the packet
+//                holding it
+//
+// One measurement runs at a time, process-wide. Arm() (JS thread) makes the
+// chirp pending; the session's LatencyProbeTap mixes it into the next render
+// callbacks and stamps the first (render thread); the first capture stream at
+// kRate whose writer sees it playing claims the probe and copies kListenMs of
+// its pre-gate input, logging the time of every Write() (capture thread); the
+// drain logs when that stream's packets reach JS (JS thread). Measure() then
+// finds the chirp in the copy on the threadpool by matched filtering - one
+// complex FFT carries both the copy and the chirp, the product of their
+// spectra goes back through it, and the peak is normalised by the chirp's
+// energy and the copy's under it - and reads the stamps off the logs. A
+// process loopback that leaves this app out (excludeSelf) cannot hear it.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "latency_trace.h"
+#include "render_source.h"
+#include "spectral_features.h"
+
+struct LatencyMeasurement {
+	double outputMs = 0.0;
+	double captureMs = 0.0;
+	double pipelineMs = -1.0; // -1: the packet never reached JS in time
+	float match = 0.0f;       // normalised correlation of the chirp as heard, 0..1
+	std::string error;
+};
+
+class LatencyProbe {
+public:
+	static constexpr uint32_t kRate = 16000;       // the capture streams it listens to
+	static constexpr uint32_t kRenderRate = 48000; // kSoundboardRate
+	static constexpr uint32_t kChirpMs = 100;
+	static constexpr float kStartHz = 500.0f;
+	static constexpr float kEndHz = 6000.0f;
+	static constexpr float kLevel = 0.25f;         // -12 dBFS
+	static constexpr uint32_t kTaperMs = 5;        // raised-cosine edges, so it doesn't click
+	static constexpr uint32_t kListenMs = 1000;    // the longest output latency it finds is this less the chirp
+	static constexpr float kMinMatch = 0.25f;
+	static constexpr size_t kMaxLog = 1024;        // writes and deliveries each
+
+	LatencyProbe() {
+		chirp_.resize((size_t)kRenderRate * kChirpMs / 1000);
+		for (size_t i = 0; i < chirp_.size(); ++i) chirp_[i] = Chirp((double)i / kRenderRate);
+		listen_.resize((size_t)kRate * kListenMs / 1000);
+	}
+
+	// JS thread: the chirp plays in owner's next render callback. False while
+	// another measurement runs.
+	bool Arm(const RenderSource* owner) {
+		State idle = State::Idle;
+		if (!state_.compare_exchange_strong(idle, State::Arming, std::memory_order_acq_rel)) return false;
+		deliveries_.store(0, std::memory_order_relaxed);
+		listener_.store(nullptr, std::memory_order_relaxed);
+		owner_.store(owner, std::memory_order_relaxed);
+		state_.store(State::Armed, std::memory_order_release);
+		return true;
+	}
+
+	// JS thread: owner is going away.
+	void Release(const RenderSource* owner) {
+		const RenderSource* expected = owner;
+		owner_.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+	}
+
+	// Render thread: adds the chirp to owner's interleaved 48 kHz block.
+	void Play(const RenderSource* owner, float* out, size_t frames, uint32_t channels) {
+		State state = state_.load(std::memory_order_acquire);
+		if ((state != State::Armed && state != State::Playing) || owner_.load(std::memory_order_acquire) != owner) return;
+		if (state == State::Armed) {
+			playedNs_ = DeviceClockNs();
+			played_ = 0;
+			state_.store(State::Playing, std::memory_order_release);
+		}
+		const size_t n = std::min(frames, chirp_.size() - played_);
+		const uint32_t width = std::min<uint32_t>(channels, 2);
+		for (size_t f = 0; f < n; ++f) {
+			for (uint32_t c = 0; c < width; ++c) out[f * channels + c] += chirp_[played_ + f];
+		}
+		played_ += n;
+	}
+
+	// Capture thread, from a stream's packet writer: count samples at stream
+	// index `index`, the first captured at timeNs. The first stream to call
+	// while the chirp plays is the one listened to.
+	void Listen(const void* stream, const float* samples, size_t count, uint64_t index, uint64_t timeNs) {
+		if (state_.load(std::memory_order_acquire) != State::Playing || timeNs == 0) return;
+		const void* none = nullptr;
+		if (listener_.load(std::memory_order_acquire) != stream) {
+			if (!listener_.compare_exchange_strong(none, stream, std::memory_order_acq_rel)) return;
+			heard_ = 0;
+			writes_ = 0;
+			startIndex_ = index;
+			startNs_ = timeNs;
+		}
+		// A gap (skipped silence) is silence in the copy
+		const size_t gap = (size_t)std::min<uint64_t>(index - std::min(index, startIndex_ + heard_), listen_.size() - heard_);
+		std::fill(listen_.begin() + heard_, listen_.begin() + heard_ + gap, 0.0f);
+		heard_ += gap;
+		const size_t take = std::min(count, listen_.size() - heard_);
+		memcpy(listen_.data() + heard_, samples, take * sizeof(float));
+		heard_ += take;
+		if (writes_ < kMaxLog) writeLog_[writes_++] = { index + count, DeviceClockNs() };
+		if (heard_ == listen_.size()) state_.store(State::Captured, std::memory_order_release);
+	}
+
+	// JS thread, as the drain delivers a packet starting at stream index `index`.
+	void Delivered(const void* stream, uint64_t index) {
+		if (listener_.load(std::memory_order_acquire) != stream) return;
+		const State state = state_.load(std::memory_order_acquire);
+		if (state != State::Playing && state != State::Captured) return;
+		const size_t n = deliveries_.load(std::memory_order_relaxed);
+		if (n == kMaxLog) return;
+		deliveryLog_[n] = { index, DeviceClockNs() };
+		deliveries_.store(n + 1, std::memory_order_release);
+	}
+
+	// Threadpool, after Arm(): waits for the copy, finds the chirp in it and
+	// frees the probe for the next measurement.
+	LatencyMeasurement Measure(uint32_t timeoutMs) {
+		LatencyMeasurement m;
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+		while (state_.load(std::memory_order_acquire) != State::Captured) {
+			if (std::chrono::steady_clock::now() >= deadline) {
+				m.error = state_.load(std::memory_order_acquire) == State::Armed ? "The render session played nothing"
+					: !listener_.load(std::memory_order_acquire) ? "No running 16 kHz capture to hear the chirp"
+					: "Timed out listening for the chirp";
+				Finish();
+				return m;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		size_t at = 0;
+		m.match = Find(&at);
+		if (m.match < kMinMatch) {
+			char text[128];
+			snprintf(text, sizeof(text), "The chirp was not heard (best match %.2f): does the capture hear this output?", m.match);
+			m.error = text;
+			Finish();
+			return m;
+		}
+		const size_t length = (size_t)kRate * kChirpMs / 1000;
+		const double msPerSample = 1000.0 / kRate;
+		m.outputMs = ((double)startNs_ - (double)playedNs_) / 1e6 + (double)at * msPerSample;
+		// The chirp's last sample: when it was captured, written and delivered
+		const uint64_t last = startIndex_ + at + length - 1;
+		const double lastMs = (double)startNs_ / 1e6 + (double)(at + length - 1) * msPerSample;
+		double writtenMs = lastMs;
+		for (size_t i = 0; i < writes_; ++i) {
+			if (writeLog_[i].index > last) {
+				writtenMs = (double)writeLog_[i].ns / 1e6;
+				break;
+			}
+		}
+		m.captureMs = writtenMs - lastMs;
+		// The packet holding it starts at or before it, once a later one has gone out
+		const auto wait = std::chrono::steady_clock::now() + std::chrono::milliseconds(kListenMs / 2);
+		for (;;) {
+			const size_t n = deliveries_.load(std::memory_order_acquire);
+			const LogEntry* holding = nullptr;
+			bool after = false;
+			for (size_t i = 0; i < n; ++i) {
+				if (deliveryLog_[i].index <= last) holding = &deliveryLog_[i];
+				else after = true;
+			}
+			if (holding && (after || std::chrono::steady_clock::now() >= wait)) {
+				m.pipelineMs = (double)holding->ns / 1e6 - writtenMs;
+				break;
+			}
+			if (std::chrono::steady_clock::now() >= wait) break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		Finish();
+		return m;
+	}
+
+private:
+	enum class State { Idle, Arming, Armed, Playing, Captured };
+
+	struct LogEntry {
+		uint64_t index; // writes: stream index just past the write; deliveries: the packet's first
+		uint64_t ns;
+	};
+
+	static float Chirp(double t) {
+		const double length = kChirpMs / 1000.0, taper = kTaperMs / 1000.0;
+		const double sweep = (kEndHz - kStartHz) / length;
+		const double edge = std::min(t, length - t);
+		const double gain = edge < taper ? 0.5 - 0.5 * std::cos(3.141592653589793 * edge / taper) : 1.0;
+		return (float)(kLevel * gain * std::sin(6.283185307179586 * (kStartHz * t + 0.5 * sweep * t * t)));
+	}
+
+	// The offset in listen_ where the chirp matches best, and how well.
+	float Find(size_t* at) {
+		const size_t length = (size_t)kRate * kChirpMs / 1000;
+		size_t size = 2;
+		while (size < listen_.size() + length) size *= 2;
+		fft_.Configure(size);
+		re_.assign(size, 0.0f);
+		im_.assign(size, 0.0f);
+		std::copy(listen_.begin(), listen_.end(), re_.begin());
+		float chirpEnergy = 0.0f;
+		for (size_t i = 0; i < length; ++i) {
+			im_[i] = Chirp((double)i / kRate);
+			chirpEnergy += im_[i] * im_[i];
+		}
+		fft_.Forward(re_.data(), im_.data());
+		// z = x + i c: X[k] = (Z[k] + Z*[N-k]) / 2, C[k] = (Z[k] - Z*[N-k]) / 2i. The
+		// correlation's spectrum X C* is Hermitian; conjugated through the forward
+		// FFT, its real part is N times the correlation.
+		for (size_t k = 0; k <= size / 2; ++k) {
+			const size_t m = (size - k) % size;
+			const float zr = re_[k], zi = im_[k], wr = re_[m], wi = im_[m];
+			const float xr = 0.5f * (zr + wr), xi = 0.5f * (zi - wi);
+			const float cr = 0.5f * (zi + wi), ci = 0.5f * (wr - zr);
+			const float pr = xr * cr + xi * ci, pi = xi * cr - xr * ci;
+			re_[k] = pr;
+			im_[k] = -pi;
+			re_[m] = pr;
+			im_[m] = pi;
+		}
+		fft_.Forward(re_.data(), im_.data());
+		// Energy of the copy under the chirp at each offset, as a running sum
+		double window = 0.0;
+		for (size_t i = 0; i < length; ++i) window += (double)listen_[i] * listen_[i];
+		float best = 0.0f;
+		*at = 0;
+		for (size_t k = 0; k + length <= listen_.size(); ++k) {
+			if (k > 0) window += (double)listen_[k + length - 1] * listen_[k + length - 1] - (double)listen_[k - 1] * listen_[k - 1];
+			const double norm = std::sqrt(std::max(window, 1e-12) * chirpEnergy);
+			const float match = (float)(std::fabs(re_[k]) / (double)size / norm);
+			if (match > best) {
+				best = match;
+				*at = k;
+			}
+		}
+		return std::min(best, 1.0f);
+	}
+
+	void Finish() {
+		owner_.store(nullptr, std::memory_order_relaxed);
+		listener_.store(nullptr, std::memory_order_relaxed);
+		state_.store(State::Idle, std::memory_order_release);
+	}
+
+	std::atomic<State> state_{State::Idle};
+	std::atomic<const RenderSource*> owner_{nullptr};
+	std::atomic<const void*> listener_{nullptr};
+	std::vector<float> chirp_; // at kRenderRate
+	// Render thread
+	uint64_t playedNs_ = 0;
+	size_t played_ = 0;
+	// Capture thread, read once Captured
+	std::vector<float> listen_;
+	size_t heard_ = 0;
+	uint64_t startIndex_ = 0;
+	uint64_t startNs_ = 0;
+	LogEntry writeLog_[kMaxLog] = {};
+	size_t writes_ = 0;
+	// JS thread, published through deliveries_
+	LogEntry deliveryLog_[kMaxLog] = {};
+	std::atomic<size_t> deliveries_{0};
+	// Threadpool
+	RadixTwoFft fft_;
+	std::vector<float> re_, im_;
+};
+
+inline LatencyProbe& SharedLatencyProbe() {
+	static LatencyProbe probe;
+	return probe;
+}
+
+// Render thread: passes the wrapped source through, with the chirp on top
+// while a measurement this tap armed plays it.
+class LatencyProbeTap : public RenderSource {
+public:
+	explicit LatencyProbeTap(RenderSource* inner) : inner_(inner) {}
+	~LatencyProbeTap() override { SharedLatencyProbe().Release(this); }
+
+	void Attach() override { inner_->Attach(); }
+	void Detach() override { inner_->Detach(); }
+
+	void Render(float* out, size_t frames, uint32_t channels) override {
+		inner_->Render(out, frames, channels);
+		SharedLatencyProbe().Play(this, out, frames, channels);
+	}
+
+private:
+	RenderSource* inner_;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+// The native end of an utterance's latency trace. With option 'timestamps',
+// every chunk the utterance chunker cuts gets a process-wide trace ID and
+// three device-clock stamps next to its captureTimeMs: when the DSP chain
+// finished the packet that completed it (processed), when it entered the
+// channel's ring (queued) and when the drain handed it to the JS callback
+// (delivered). JS continues the same ID through STT, translation, captions
+// and TTS. All times are on the clock deviceClockMs() reads: QPC on Windows,
+// mach host time on macOS.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <CoreAudio/HostTime.h>
+#endif
+
+// Now, in ns, on the clock capture timestamps are on.
+inline uint64_t DeviceClockNs() {
+#if defined(_WIN32)
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	const uint64_t c = (uint64_t)counter.QuadPart, f = (uint64_t)frequency.QuadPart;
+	return c / f * 1000000000ull + c % f * 1000000000ull / f;
+#elif defined(__APPLE__)
+	return AudioConvertHostTimeToNanos(AudioGetCurrentHostTime());
+#else
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Unique across every capture of the process, so IDs from the loopback and
+// the microphone captures never collide in one trace. Starts at 1; 0 means
+// untraced.
+inline uint64_t NextTraceId() {
+	static std::atomic<uint64_t> next{1};
+	return next.fetch_add(1, std::memory_order_relaxed);
+}
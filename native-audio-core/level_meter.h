@@ -0,0 +1,250 @@
+#pragma once
+
+// Band levels for the audio-level overlay, computed on the capture thread from
+// the processed stream and delivered to JS at a fixed, low rate instead of per
+// packet. Eight log-spaced band-pass filters (125 Hz - 6 kHz, two cascaded
+// biquads each) feed per-band RMS over each publish period, mapped to 0..1 on a
+// -60..0 dBFS scale with a falling release so bars decay smoothly between
+// bursts. Exposed to JS as watchLevels() / unwatchLevels(), or carried by the
+// event bus (event_bus.h).
+
+#include <napi.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "addon_instance.h"
+
+constexpr size_t kLevelBands = 8;
+
+struct LevelFrame {
+	float bands[kLevelBands] = {}; // 0..1
+	float rms = 0.0f;              // broadband, linear
+};
+
+class BandLevelMeter {
+public:
+	void Configure(float sampleRate) {
+		const float twoPi = 6.28318530718f;
+		const float ratio = std::pow(6000.0f / 125.0f, 1.0f / (kLevelBands - 1));
+		const float q = std::sqrt(ratio) / (ratio - 1.0f); // neighbouring bands cross at -6 dB once cascaded
+		float centre = 125.0f;
+		for (size_t b = 0; b < kLevelBands; ++b, centre *= ratio) {
+			// RBJ band-pass with 0 dB peak gain; centres above 0.45 fs are folded down
+			const float f = centre < 0.45f * sampleRate ? centre : 0.45f * sampleRate;
+			const float w = twoPi * f / sampleRate;
+			const float alpha = std::sin(w) / (2.0f * q);
+			const float a0 = 1.0f + alpha;
+			Biquad& bq = bands_[b];
+			bq.b0 = alpha / a0;
+			bq.b2 = -alpha / a0;
+			bq.a1 = -2.0f * std::cos(w) / a0;
+			bq.a2 = (1.0f - alpha) / a0;
+		}
+		sampleRate_ = sampleRate;
+		Reset();
+	}
+
+	void Reset() {
+		for (Biquad& bq : bands_) { bq.z1 = bq.z2 = bq.z3 = bq.z4 = 0.0f; }
+		for (float& e : energy_) e = 0.0f;
+		for (float& f : frame_.bands) f = 0.0f;
+		total_ = 0.0f;
+		count_ = 0;
+	}
+
+	// Streams samples (scaled by gain). Returns true once at least `period`
+	// samples have accumulated; Frame() then holds the levels over them.
+	bool Process(const float* x, size_t n, float gain, size_t period) {
+		for (size_t b = 0; b < kLevelBands; ++b) {
+			Biquad bq = bands_[b];
+			float e = energy_[b];
+			for (size_t i = 0; i < n; ++i) {
+				// Transposed direct form II, twice for 12 dB/octave skirts; b1 is zero for a band-pass
+				const float s = x[i] * gain;
+				const float u = bq.b0 * s + bq.z1;
+				bq.z1 = -bq.a1 * u + bq.z2;
+				bq.z2 = bq.b2 * s - bq.a2 * u;
+				const float y = bq.b0 * u + bq.z3;
+				bq.z3 = -bq.a1 * y + bq.z4;
+				bq.z4 = bq.b2 * u - bq.a2 * y;
+				e += y * y;
+			}
+			bands_[b] = bq;
+			energy_[b] = e;
+		}
+		float total = total_;
+		for (size_t i = 0; i < n; ++i) total += x[i] * gain * x[i] * gain;
+		total_ = total;
+		count_ += n;
+		if (count_ < period || count_ == 0) return false;
+
+		const float inv = 1.0f / (float)count_;
+		// 24 dB/s release, expressed per period on the 60 dB scale
+		const float release = 24.0f / 60.0f * (float)count_ / sampleRate_;
+		for (size_t b = 0; b < kLevelBands; ++b) {
+			const float db = 10.0f * std::log10(energy_[b] * inv + 1e-10f);
+			float level = (db + 60.0f) / 60.0f;
+			level = level < 0.0f ? 0.0f : (level > 1.0f ? 1.0f : level);
+			const float held = frame_.bands[b] - release;
+			frame_.bands[b] = level > held ? level : held;
+			energy_[b] = 0.0f;
+		}
+		frame_.rms = std::sqrt(total_ * inv);
+		total_ = 0.0f;
+		count_ = 0;
+		return true;
+	}
+
+	const LevelFrame& Frame() const { return frame_; }
+
+private:
+	struct Biquad {
+		float b0 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+		float z1 = 0.0f, z2 = 0.0f, z3 = 0.0f, z4 = 0.0f; // first and second section
+	};
+
+	Biquad bands_[kLevelBands];
+	float energy_[kLevelBands] = {};
+	float total_ = 0.0f;
+	size_t count_ = 0;
+	float sampleRate_ = 16000.0f;
+	LevelFrame frame_;
+};
+
+class LevelSink;
+// JS thread; env is null when the function is torn down.
+inline void DeliverLevels(Napi::Env env, Napi::Function cb, LevelSink* sink, void*);
+
+using LevelTsfn = Napi::TypedThreadSafeFunction<LevelSink, void, DeliverLevels>;
+
+// Latest-value hand-off: the capture thread overwrites the pending frame and
+// wakes JS only if no delivery is queued, so a busy main thread sees fewer,
+// fresher frames and never a backlog.
+class LevelSink {
+public:
+	// Publish rate while watching, 0 otherwise. Read by the capture thread.
+	uint32_t RateHz() const { return rateHz_.load(std::memory_order_relaxed); }
+
+	// JS thread of env. Replaces (and releases) any previous callback, whichever
+	// environment it came from.
+	void Watch(LevelTsfn tsfn, uint32_t rateHz, napi_env env) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (hasTsfn_) tsfn_.Release();
+		tsfn_ = tsfn;
+		hasTsfn_ = true;
+		env_ = env;
+		wake_ = false;
+		watchHz_ = rateHz;
+		if (forward_ == nullptr) rateHz_.store(rateHz, std::memory_order_relaxed);
+	}
+
+	void Unwatch() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (hasTsfn_) tsfn_.Release();
+		hasTsfn_ = false;
+		watchHz_ = 0;
+		if (forward_ == nullptr) rateHz_.store(0, std::memory_order_relaxed);
+	}
+
+	// At env teardown: unwatches if the callback lives in env.
+	void UnwatchEnv(napi_env env) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!hasTsfn_ || env_ != env) return;
+		tsfn_.Release();
+		hasTsfn_ = false;
+		watchHz_ = 0;
+		if (forward_ == nullptr) rateHz_.store(0, std::memory_order_relaxed);
+	}
+
+	// Frames go to forward at rateHz instead of the callback while it's set
+	// (the event bus); null hands them back.
+	void Forward(void (*forward)(const LevelFrame&), uint32_t rateHz) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		forward_ = forward;
+		rateHz_.store(forward != nullptr ? rateHz : watchHz_, std::memory_order_relaxed);
+	}
+
+	// Capture thread.
+	void Publish(const LevelFrame& frame) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (forward_ != nullptr) {
+			forward_(frame);
+			return;
+		}
+		if (!hasTsfn_) return;
+		latest_ = frame;
+		if (!wake_ && tsfn_.NonBlockingCall() == napi_ok) wake_ = true;
+	}
+
+	// JS thread: the frame to deliver now.
+	LevelFrame Take() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		wake_ = false;
+		return latest_;
+	}
+
+private:
+	std::mutex mutex_;
+	LevelTsfn tsfn_;
+	bool hasTsfn_ = false;
+	napi_env env_ = nullptr; // tsfn_'s environment
+	bool wake_ = false; // a delivery is queued
+	LevelFrame latest_;
+	uint32_t watchHz_ = 0; // the callback's rate
+	void (*forward_)(const LevelFrame&) = nullptr;
+	std::atomic<uint32_t> rateHz_{0};
+};
+
+inline LevelSink& AudioLevelSink() {
+	static LevelSink sink;
+	return sink;
+}
+
+inline void UnwatchEnvLevels(napi_env env) {
+	AudioLevelSink().UnwatchEnv(env);
+}
+
+inline void DeliverLevels(Napi::Env env, Napi::Function cb, LevelSink* sink, void*) {
+	const LevelFrame frame = sink->Take();
+	if (env == nullptr || cb == nullptr) return;
+	Napi::Float32Array bands = Napi::Float32Array::New(env, kLevelBands);
+	for (size_t b = 0; b < kLevelBands; ++b) bands[b] = frame.bands[b];
+	cb.Call({ bands, Napi::Number::New(env, frame.rms) });
+}
+
+// watchLevels(callback, { rateHz }?) - callback(bands: Float32Array(8), rms)
+// at rateHz (default 30, 1..120) while a capture is running.
+inline Napi::Value WatchLevels(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsFunction()) {
+		Napi::TypeError::New(env, "Callback required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	uint32_t rateHz = 30;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object options = info[1].As<Napi::Object>();
+		if (options.Has("rateHz") && options.Get("rateHz").IsNumber()) {
+			const double rate = options.Get("rateHz").As<Napi::Number>().DoubleValue();
+			if (!(rate >= 1 && rate <= 120)) {
+				Napi::TypeError::New(env, "Option 'rateHz' is out of range").ThrowAsJavaScriptException();
+				return env.Null();
+			}
+			rateHz = (uint32_t)rate;
+		}
+	}
+	LevelSink& sink = AudioLevelSink();
+	LevelTsfn tsfn = LevelTsfn::New(env, info[0].As<Napi::Function>(), "LevelCallback", 1, 1, &sink);
+	tsfn.Unref(env); // never keeps the process alive
+	sink.Watch(tsfn, rateHz, env);
+	DetachAtTeardown<UnwatchEnvLevels>(env);
+	return Napi::Boolean::New(env, true);
+}
+
+inline Napi::Value UnwatchLevels(const Napi::CallbackInfo& info) {
+	AudioLevelSink().Unwatch();
+	return info.Env().Undefined();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// getLogs() / setLogLevel() exports shared by the capture addons.
+
+#include <napi.h>
+
+#include <string>
+
+#include "addon_log.h"
+
+// getLogs() -> [{ level, time, message }], draining the native log ring. A
+// trailing { level: 'warn', message } entry reports messages lost to overflow.
+inline Napi::Value GetLogs(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	Napi::Array result = Napi::Array::New(env);
+	uint32_t n = 0;
+	uint64_t dropped = AddonLogRing().Drain([&](const LogRecord& r) {
+		Napi::Object entry = Napi::Object::New(env);
+		entry.Set("level", Napi::String::New(env, LogLevelName(r.level)));
+		entry.Set("time", Napi::Number::New(env, r.timeMs));
+		entry.Set("message", Napi::String::New(env, r.text));
+		result.Set(n++, entry);
+	});
+	if (dropped) {
+		Napi::Object entry = Napi::Object::New(env);
+		entry.Set("level", Napi::String::New(env, "warn"));
+		entry.Set("time", Napi::Number::New(env, (double)std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count()));
+		entry.Set("message", Napi::String::New(env, std::to_string(dropped) + " log messages dropped"));
+		result.Set(n++, entry);
+	}
+	return result;
+}
+
+// setLogLevel(level, echo?) - level is 'silent' | 'error' | 'warn' | 'info' | 'debug';
+// echo prints queued messages to stdout from a low-priority thread instead of
+// keeping them for getLogs().
+inline Napi::Value SetLogLevel(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	static const char* const kNames[] = { "silent", "error", "warn", "info", "debug" };
+	int level = -1;
+	if (info.Length() > 0 && info[0].IsString()) {
+		std::string s = info[0].As<Napi::String>().Utf8Value();
+		for (int i = 0; i < 5; ++i) if (s == kNames[i]) level = i;
+	}
+	if (level < 0) {
+		Napi::TypeError::New(env, "Log level must be 'silent', 'error', 'warn', 'info' or 'debug'").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	AddonLogRing().SetLevel((LogLevel)level);
+	if (info.Length() > 1 && info[1].IsBoolean()) AddonLogRing().SetEcho(info[1].As<Napi::Boolean>().Value());
+	return env.Undefined();
+}
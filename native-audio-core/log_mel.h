@@ -0,0 +1,337 @@
+#pragma once
+
+// Streaming 80-band log-mel front end with Whisper's parameters: a 400-sample
+// (25 ms) periodic Hann window every 160 samples (10 ms), the power spectrum
+// of its 201 bins, 80 Slaney-normalised mel bands over 0-8 kHz (librosa's,
+// which whisper.cpp ships in its models) and log10(max(energy, 1e-10)).
+// Frame k is centred on stream sample k * 160, so it is complete once sample
+// k * 160 + 199 has arrived. The packet writer runs one per capture over the
+// int16 samples the chunker stores and its consumers read the frames in place:
+// the keyword spotter takes its MFCCs from them, and ChunkMelStore hands the
+// frames of each chunk to the in-process Whisper engine, which then only
+// computes the few at the chunk's edges itself. With gyp variable use_avtx=1
+// (AUDIO_CORE_AVTX, the vendored libavutil) the spectrum is av_tx's 400-point
+// real FFT; without it a table DFT over the 201 bins, about 4 ms of one core
+// per second of audio (BM_LogMel).
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "memory_budget.h"
+
+#if defined(AUDIO_CORE_AVTX)
+extern "C" {
+#include <libavutil/mem.h>
+#include <libavutil/tx.h>
+}
+#endif
+
+// Window, filter bank (and DFT table) shared by every front end.
+struct LogMelTables {
+	static constexpr size_t kWindow = 400, kSpectrum = kWindow / 2 + 1;
+	static constexpr uint32_t kBands = 80;
+
+	std::vector<float> hann;
+	std::vector<uint32_t> first, count; // each band's nonzero bins
+	std::vector<float> weights;         // kBands x kSpectrum
+	std::vector<float> cosTable, sinTable;
+
+	LogMelTables() {
+		hann.resize(kWindow);
+		for (size_t i = 0; i < kWindow; ++i) hann[i] = (float)(0.5 * (1.0 - std::cos(2.0 * 3.141592653589793 * i / kWindow)));
+		// Slaney mel scale: linear to 1 kHz, logarithmic above
+		auto mel = [](double hz) { return hz < 1000.0 ? hz * 3.0 / 200.0 : 15.0 + std::log(hz / 1000.0) * 27.0 / std::log(6.4); };
+		auto hz = [](double m) { return m < 15.0 ? m * 200.0 / 3.0 : 1000.0 * std::exp((m - 15.0) * std::log(6.4) / 27.0); };
+		double edges[kBands + 2];
+		for (uint32_t b = 0; b < kBands + 2; ++b) edges[b] = hz(mel(8000.0) * b / (kBands + 1));
+		weights.assign(kBands * kSpectrum, 0.0f);
+		first.assign(kBands, 0);
+		count.assign(kBands, 0);
+		for (uint32_t b = 0; b < kBands; ++b) {
+			const double norm = 2.0 / (edges[b + 2] - edges[b]);
+			for (size_t k = 0; k < kSpectrum; ++k) {
+				const double f = k * 16000.0 / kWindow;
+				const double w = std::min((f - edges[b]) / (edges[b + 1] - edges[b]), (edges[b + 2] - f) / (edges[b + 2] - edges[b + 1]));
+				if (w <= 0.0) continue;
+				if (count[b] == 0) first[b] = (uint32_t)k;
+				count[b] = (uint32_t)k - first[b] + 1;
+				weights[b * kSpectrum + k] = (float)(w * norm);
+			}
+		}
+#if !defined(AUDIO_CORE_AVTX)
+		cosTable.resize(kSpectrum * kWindow);
+		sinTable.resize(kSpectrum * kWindow);
+		for (size_t k = 0; k < kSpectrum; ++k) {
+			for (size_t i = 0; i < kWindow; ++i) {
+				const double phase = 2.0 * 3.141592653589793 * (double)((k * i) % kWindow) / kWindow;
+				cosTable[k * kWindow + i] = (float)std::cos(phase);
+				sinTable[k * kWindow + i] = (float)std::sin(phase);
+			}
+		}
+#endif
+	}
+};
+
+inline const LogMelTables& MelTables() {
+	static const LogMelTables tables;
+	return tables;
+}
+
+class LogMelFrontEnd {
+public:
+	static constexpr uint32_t kBands = LogMelTables::kBands;
+	static constexpr size_t kWindow = LogMelTables::kWindow;
+	static constexpr size_t kHop = 160;
+
+	LogMelFrontEnd() = default;
+	LogMelFrontEnd(const LogMelFrontEnd&) = delete;
+	LogMelFrontEnd& operator=(const LogMelFrontEnd&) = delete;
+	~LogMelFrontEnd() {
+#if defined(AUDIO_CORE_AVTX)
+		av_tx_uninit(&tx_);
+		av_free(in_);
+		av_free(out_);
+#endif
+	}
+
+	// Keeps the newest ringFrames frames readable; 0 switches the front end off.
+	void Configure(size_t ringFrames) {
+		tables_ = ringFrames > 0 ? &MelTables() : nullptr;
+		frames_.assign(ringFrames * kBands, 0.0f);
+		ring_ = ringFrames;
+		samples_.assign(kWindow + kHop, 0.0f);
+		spectrum_.assign(LogMelTables::kSpectrum, 0.0f);
+#if defined(AUDIO_CORE_AVTX)
+		if (ringFrames > 0 && !tx_) {
+			const float scale = 1.0f;
+			in_ = static_cast<float*>(av_malloc(kWindow * sizeof(float)));
+			out_ = static_cast<AVComplexFloat*>(av_malloc(LogMelTables::kSpectrum * sizeof(AVComplexFloat)));
+			if (!in_ || !out_ || av_tx_init(&tx_, &fft_, AV_TX_FLOAT_RDFT, 0, (int)kWindow, &scale, 0) < 0) tx_ = nullptr;
+		}
+		if (!tx_) { // off rather than silently wrong
+			tables_ = nullptr;
+			frames_.clear();
+			ring_ = 0;
+		}
+#endif
+		Reset(0);
+	}
+
+	bool Enabled() const { return ring_ > 0; }
+
+	// The next sample pushed is stream index `at`; frames whose window starts
+	// before it are never computed.
+	void Reset(uint64_t at) {
+		base_ = at;
+		filled_ = 0;
+		next_ = (at + kWindow / 2 + kHop - 1) / kHop;
+		first_ = next_;
+	}
+
+	// Capture thread: the samples following the last ones pushed.
+	void Push(const int16_t* x, size_t n) {
+		while (n > 0) {
+			const size_t take = std::min(n, samples_.size() - filled_);
+			for (size_t i = 0; i < take; ++i) samples_[filled_ + i] = x[i] * (1.0f / 32768.0f);
+			filled_ += take;
+			x += take;
+			n -= take;
+			for (;;) {
+				const uint64_t begin = next_ * kHop - kWindow / 2;
+				if (begin + kWindow > base_ + filled_) break;
+				Compute(&samples_[(size_t)(begin - base_)], Slot(next_));
+				++next_;
+			}
+			const uint64_t keep = next_ * kHop - kWindow / 2;
+			if (keep > base_) {
+				const size_t drop = (size_t)std::min<uint64_t>(keep - base_, filled_);
+				memmove(samples_.data(), samples_.data() + drop, (filled_ - drop) * sizeof(float));
+				filled_ -= drop;
+				base_ += drop;
+			}
+		}
+	}
+
+	// Frames [FirstFrame(), NextFrame()) are readable, kBands floats each.
+	uint64_t NextFrame() const { return next_; }
+	uint64_t FirstFrame() const { return std::max(first_, next_ > ring_ ? next_ - ring_ : 0); }
+	const float* Frame(uint64_t k) const { return &frames_[(size_t)(k % ring_) * kBands]; }
+
+	// x holds stream samples [from, from + available), of which those from
+	// `at` on replaced what was pushed (the chunker's pre-roll): frames reading
+	// them whose whole window x holds are recomputed, and the partial window
+	// waiting for more samples takes the new ones.
+	void Replace(const int16_t* x, uint64_t from, size_t available, uint64_t at) {
+		const uint64_t end = from + available;
+		for (uint64_t i = std::max(at, base_); i < std::min(end, base_ + filled_); ++i) {
+			samples_[(size_t)(i - base_)] = x[i - from] * (1.0f / 32768.0f);
+		}
+		float window[kWindow];
+		// Frames reading a replaced sample whose whole window x holds
+		const uint64_t reading = at >= kWindow / 2 ? (at - kWindow / 2) / kHop + 1 : 0;
+		const uint64_t lo = std::max({ FirstFrame(), reading, (from + kWindow / 2 + kHop - 1) / kHop });
+		for (uint64_t k = lo; k < next_ && k * kHop + kWindow / 2 <= end; ++k) {
+			const int16_t* w = x + (k * kHop - kWindow / 2 - from);
+			for (size_t i = 0; i < kWindow; ++i) window[i] = w[i] * (1.0f / 32768.0f);
+			Compute(window, Slot(k));
+		}
+	}
+
+	// One frame from kWindow samples in -1..1; Enabled() only.
+	void Compute(const float* x, float* out) {
+		const LogMelTables& t = *tables_;
+		float* power = spectrum_.data();
+#if defined(AUDIO_CORE_AVTX)
+		for (size_t i = 0; i < kWindow; ++i) in_[i] = x[i] * t.hann[i];
+		fft_(tx_, out_, in_, sizeof(float));
+		for (size_t k = 0; k < LogMelTables::kSpectrum; ++k) power[k] = out_[k].re * out_[k].re + out_[k].im * out_[k].im;
+#else
+		float windowed[kWindow];
+		for (size_t i = 0; i < kWindow; ++i) windowed[i] = x[i] * t.hann[i];
+		for (size_t k = 0; k < LogMelTables::kSpectrum; ++k) {
+			const float* c = &t.cosTable[k * kWindow];
+			const float* s = &t.sinTable[k * kWindow];
+			float re = 0.0f, im = 0.0f;
+			for (size_t i = 0; i < kWindow; ++i) {
+				re += windowed[i] * c[i];
+				im += windowed[i] * s[i];
+			}
+			power[k] = re * re + im * im;
+		}
+#endif
+		for (uint32_t b = 0; b < kBands; ++b) {
+			const float* w = &t.weights[(size_t)b * LogMelTables::kSpectrum];
+			float e = 0.0f;
+			for (uint32_t k = t.first[b]; k < t.first[b] + t.count[b]; ++k) e += w[k] * power[k];
+			out[b] = std::log10(std::max(e, 1e-10f));
+		}
+	}
+
+private:
+	float* Slot(uint64_t k) { return &frames_[(size_t)(k % ring_) * kBands]; }
+
+	const LogMelTables* tables_ = nullptr;
+	std::vector<float> frames_; // ring_ frames, frame k at k % ring_
+	size_t ring_ = 0;
+	std::vector<float> samples_; // stream samples from base_ not yet behind a window
+	uint64_t base_ = 0;
+	size_t filled_ = 0;
+	uint64_t next_ = 0;  // next frame to compute
+	uint64_t first_ = 0; // first frame since Reset()
+	std::vector<float> spectrum_;
+#if defined(AUDIO_CORE_AVTX)
+	AVTXContext* tx_ = nullptr;
+	av_tx_fn fft_ = nullptr;
+	float* in_ = nullptr;
+	AVComplexFloat* out_ = nullptr;
+#endif
+};
+
+// FNV-1a over a chunk's int16 samples: how the Whisper engine recognises a
+// chunk the capture cut. Float input is matched through the same int16 values.
+inline uint64_t ChunkMelKey(const int16_t* x, size_t n) {
+	uint64_t h = 14695981039346656037ull ^ n;
+	for (size_t i = 0; i < n; ++i) h = (h ^ (uint16_t)x[i]) * 1099511628211ull;
+	return h;
+}
+
+inline uint64_t ChunkMelKey(const float* x, size_t n) {
+	uint64_t h = 14695981039346656037ull ^ n;
+	for (size_t i = 0; i < n; ++i) {
+		const long v = std::lround(x[i] * 32768.0f);
+		h = (h ^ (uint16_t)(int16_t)std::max(-32768L, std::min(32767L, v))) * 1099511628211ull;
+	}
+	return h;
+}
+
+// Log-mel frames of a chunk relative to its first sample: frame j (centred on
+// sample j * 160) for j in [first, first + count), kBands floats each.
+struct ChunkMel {
+	uint32_t first = 0, count = 0;
+	std::vector<float> frames;
+};
+
+// Frames of the latest chunks the captures cut, kept until the Whisper engine
+// asks for them by ChunkMelKey. The capture thread never waits on the lock:
+// when the JS thread holds it, that chunk is simply not stored. Memory
+// pressure frees the store; it stays off until the next capture reserves it.
+class ChunkMelStore {
+public:
+	// Capture start: room for chunks of up to maxFrames frames, so Put() never
+	// allocates.
+	void Reserve(size_t maxFrames) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (Entry& e : entries_) {
+			if (e.mel.frames.capacity() < maxFrames * LogMelFrontEnd::kBands) e.mel.frames.reserve(maxFrames * LogMelFrontEnd::kBands);
+		}
+		maxFrames_ = std::max(maxFrames_, maxFrames);
+		charge_.Set(kEntries * maxFrames_ * LogMelFrontEnd::kBands * sizeof(float));
+	}
+
+	// Pressure watch.
+	void Release() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (Entry& e : entries_) {
+			e.mel.count = 0;
+			std::vector<float>().swap(e.mel.frames);
+		}
+		maxFrames_ = 0; // Put() stores nothing, so never allocates
+		charge_.Set(0);
+	}
+
+	// Capture thread: frames [first, first + count) of mel, stream frame
+	// `origin` being the chunk's frame 0.
+	void Put(uint64_t key, size_t samples, const LogMelFrontEnd& mel, uint64_t origin, uint32_t first, uint32_t count) {
+		std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+		if (!lock.owns_lock()) return;
+		count = (uint32_t)std::min<size_t>(count, maxFrames_);
+		Entry& e = entries_[next_];
+		next_ = (next_ + 1) % kEntries;
+		e.key = key;
+		e.samples = samples;
+		e.mel.first = first;
+		e.mel.count = count;
+		e.mel.frames.resize((size_t)count * LogMelFrontEnd::kBands);
+		for (uint32_t j = 0; j < count; ++j) {
+			const float* f = mel.Frame(origin + first + j);
+			std::copy(f, f + LogMelFrontEnd::kBands, &e.mel.frames[(size_t)j * LogMelFrontEnd::kBands]);
+		}
+	}
+
+	// JS thread: a copy of the frames stored for the chunk, false if none.
+	bool Find(uint64_t key, size_t samples, ChunkMel* out) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const Entry& e : entries_) {
+			if (e.samples != samples || e.key != key || e.mel.count == 0) continue;
+			*out = e.mel;
+			return true;
+		}
+		return false;
+	}
+
+private:
+	static constexpr size_t kEntries = 8;
+
+	struct Entry {
+		uint64_t key = 0;
+		size_t samples = 0;
+		ChunkMel mel;
+	};
+
+	std::mutex mutex_;
+	Entry entries_[kEntries];
+	size_t next_ = 0;
+	size_t maxFrames_ = 0;
+	MemoryCharge charge_{ MemoryKind::MelCache };
+	MemoryTrimHook trim_{ [this] { Release(); } }; // last: gone first
+};
+
+inline ChunkMelStore& ChunkMels() {
+	static ChunkMelStore store;
+	return store;
+}
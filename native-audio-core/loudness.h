@@ -0,0 +1,264 @@
+#pragma once
+
+// ITU-R BS.1770 loudness for the capture chain: K-weighting, gated momentary
+// (400 ms), short-term (3 s) and integrated loudness over 100 ms sub-blocks,
+// and a streaming normalizer that steers the processed stream to a target
+// loudness with a lookahead peak limiter in front of the quantizer. The
+// normalizer replaces the fixed voice boost when the capture option "loudness"
+// is set; the meter also reports the loudness of every utterance chunk.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct LoudnessConfig {
+	bool enabled = false;
+	float targetLufs = -14.0f;
+	float gateLufs = -50.0f;  // quieter sub-blocks neither count nor move the gain
+	float maxGainDb = 12.0f;  // most the normalizer will boost
+	float ceilingDb = -1.0f;  // limiter ceiling, dBFS
+	uint32_t lookaheadMs = 5;
+};
+
+constexpr float kLoudnessSilenceLufs = -70.0f; // BS.1770 absolute gate
+
+// Energy (mean square of the K-weighted signal) to LUFS and back.
+inline float EnergyToLufs(double energy) { return -0.691f + 10.0f * (float)std::log10(energy + 1e-12); }
+inline double LufsToEnergy(float lufs) { return std::pow(10.0, (lufs + 0.691) / 10.0); }
+
+// The two BS.1770 pre-filter stages (high shelf, RLB high-pass), derived for
+// any sample rate as libebur128 does.
+class KWeighting {
+public:
+	void Configure(float fs) {
+		const double pi = 3.14159265358979323846;
+		double k = std::tan(pi * 1681.974450955533 / fs);
+		const double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+		const double vb = std::pow(vh, 0.4996667741545416);
+		double q = 0.7071752369554196;
+		double a0 = 1.0 + k / q + k * k;
+		shelf_ = { (float)((vh + vb * k / q + k * k) / a0), (float)(2.0 * (k * k - vh) / a0),
+		           (float)((vh - vb * k / q + k * k) / a0), (float)(2.0 * (k * k - 1.0) / a0),
+		           (float)((1.0 - k / q + k * k) / a0) };
+		k = std::tan(pi * 38.13547087602444 / fs);
+		q = 0.5003270373238773;
+		a0 = 1.0 + k / q + k * k;
+		highPass_ = { 1.0f, -2.0f, 1.0f, (float)(2.0 * (k * k - 1.0) / a0), (float)((1.0 - k / q + k * k) / a0) };
+		Reset();
+	}
+
+	void Reset() { shelf_.z1 = shelf_.z2 = highPass_.z1 = highPass_.z2 = 0.0f; }
+
+	float Process(float x) { return highPass_.Run(shelf_.Run(x)); }
+
+private:
+	struct Section {
+		float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+		float z1 = 0.0f, z2 = 0.0f;
+		float Run(float x) {
+			const float y = b0 * x + z1;
+			z1 = b1 * x - a1 * y + z2;
+			z2 = b2 * x - a2 * y;
+			return y;
+		}
+	};
+
+	Section shelf_, highPass_;
+};
+
+class LoudnessMeter {
+public:
+	// maxBlocks bounds the 400 ms gating blocks kept for IntegratedLufs().
+	void Configure(float fs, size_t maxBlocks) {
+		kw_.Configure(fs);
+		subBlockSamples_ = std::max<size_t>(1, (size_t)(fs / 10.0f));
+		blocks_.reserve(maxBlocks);
+		Reset();
+	}
+
+	void Reset() {
+		kw_.Reset();
+		for (double& e : ring_) e = 0.0;
+		ringCount_ = 0;
+		ringAt_ = 0;
+		energy_ = 0.0;
+		filled_ = 0;
+		totalEnergy_ = 0.0;
+		totalSamples_ = 0;
+		peak_ = 0.0f;
+		blocks_.clear();
+	}
+
+	// Streams samples (scaled by gain). Returns the number of 100 ms sub-blocks
+	// completed.
+	size_t Push(const float* x, size_t n, float gain) {
+		size_t completed = 0;
+		for (size_t i = 0; i < n; ++i) {
+			const float s = x[i] * gain;
+			const float a = s < 0 ? -s : s;
+			if (a > peak_) peak_ = a;
+			const float y = kw_.Process(s);
+			energy_ += (double)y * y;
+			if (++filled_ == subBlockSamples_) {
+				EndSubBlock();
+				++completed;
+			}
+		}
+		return completed;
+	}
+
+	// Loudness over the last 400 ms / 3 s of sub-blocks; silence when empty.
+	float MomentaryLufs() const { return EnergyToLufs(MeanEnergy(4, kLoudnessSilenceLufs)); }
+	float ShortTermLufs() const { return EnergyToLufs(MeanEnergy(kRing, kLoudnessSilenceLufs)); }
+
+	// Short-term loudness of the sub-blocks above gateLufs only.
+	float GatedShortTermLufs(float gateLufs) const { return EnergyToLufs(MeanEnergy(kRing, gateLufs)); }
+
+	// BS.1770 integrated loudness since Reset(): 400 ms blocks at 75% overlap,
+	// absolute gate at -70 LUFS, relative gate 10 LU below the absolute-gated
+	// mean. Anything shorter than one block is measured ungated.
+	float IntegratedLufs() const {
+		if (blocks_.empty()) {
+			const double partial = totalEnergy_ + energy_;
+			const size_t samples = totalSamples_ + filled_;
+			return samples > 0 ? EnergyToLufs(partial / samples) : kLoudnessSilenceLufs;
+		}
+		const double absolute = LufsToEnergy(kLoudnessSilenceLufs);
+		double sum = 0.0;
+		size_t count = 0;
+		for (double e : blocks_) if (e > absolute) { sum += e; ++count; }
+		if (count == 0) return kLoudnessSilenceLufs;
+		const double relative = sum / count * 0.1; // -10 LU
+		sum = 0.0;
+		count = 0;
+		for (double e : blocks_) if (e > absolute && e > relative) { sum += e; ++count; }
+		return count > 0 ? EnergyToLufs(sum / count) : kLoudnessSilenceLufs;
+	}
+
+	float PeakDb() const { return 20.0f * std::log10(peak_ + 1e-10f); }
+
+private:
+	static constexpr size_t kRing = 30; // 3 s of sub-blocks
+
+	void EndSubBlock() {
+		const double e = energy_ / (double)subBlockSamples_;
+		ring_[ringAt_] = e;
+		ringAt_ = (ringAt_ + 1) % kRing;
+		if (ringCount_ < kRing) ++ringCount_;
+		totalEnergy_ += energy_;
+		totalSamples_ += subBlockSamples_;
+		energy_ = 0.0;
+		filled_ = 0;
+		if (ringCount_ >= 4 && blocks_.size() < blocks_.capacity()) blocks_.push_back(MeanEnergy(4, -1000.0f));
+	}
+
+	// Mean over the newest `count` sub-blocks louder than gateLufs.
+	double MeanEnergy(size_t count, float gateLufs) const {
+		const double gate = LufsToEnergy(gateLufs);
+		double sum = 0.0;
+		size_t used = 0;
+		const size_t n = std::min(count, ringCount_);
+		for (size_t i = 0; i < n; ++i) {
+			const double e = ring_[(ringAt_ + kRing - 1 - i) % kRing];
+			if (e > gate) { sum += e; ++used; }
+		}
+		// Ungated windows average over their full length, as BS.1770 does
+		if (gateLufs <= kLoudnessSilenceLufs) return n > 0 ? sum / n : 0.0;
+		return used > 0 ? sum / used : 0.0;
+	}
+
+	KWeighting kw_;
+	size_t subBlockSamples_ = 1600;
+	double ring_[kRing] = {};
+	size_t ringCount_ = 0, ringAt_ = 0;
+	double energy_ = 0.0; // open sub-block
+	size_t filled_ = 0;
+	double totalEnergy_ = 0.0;
+	size_t totalSamples_ = 0;
+	float peak_ = 0.0f;
+	std::vector<double> blocks_; // gating block energies
+};
+
+// Streaming loudness normalizer: a makeup gain that follows the gated
+// short-term loudness toward the target (held through silence) and a lookahead
+// limiter that keeps peaks under the ceiling. Output is delayed by the
+// lookahead.
+class LoudnessNormalizer {
+public:
+	void Configure(float fs, const LoudnessConfig& config) {
+		config_ = config;
+		if (!config.enabled) return;
+		meter_.Configure(fs, 0);
+		lookahead_ = std::max<size_t>(1, (size_t)(fs * config.lookaheadMs / 1000.0f));
+		delay_.assign(lookahead_, 0.0f);
+		minGain_.assign(lookahead_ + 2, 1.0f); // a window of lookahead_ + 1 entries, plus one so full != empty
+		minPos_.assign(lookahead_ + 2, 0);
+		ceiling_ = std::pow(10.0f, config.ceilingDb / 20.0f);
+		maxGain_ = std::pow(10.0f, config.maxGainDb / 20.0f);
+		smooth_ = 1.0f - std::exp(-1.0f / (0.5f * fs));      // makeup gain, 500 ms
+		attack_ = 1.0f - std::exp(-4.0f / (float)lookahead_); // limiter settles within the lookahead
+		release_ = 1.0f - std::exp(-1.0f / (0.05f * fs));    // limiter release, 50 ms
+		Reset();
+	}
+
+	bool Enabled() const { return config_.enabled; }
+
+	void Reset() {
+		meter_.Reset();
+		std::fill(delay_.begin(), delay_.end(), 0.0f);
+		head_ = tail_ = 0;
+		at_ = 0;
+		gain_ = target_ = 1.0f;
+		envelope_ = 1.0f;
+	}
+
+	// Warm start (dsp_warm_state.h): the makeup gain it settled on, held as
+	// the target until the meter has 400 ms of its own.
+	float Gain() const { return config_.enabled ? target_ : 0.0f; }
+	void RestoreGain(float gain) {
+		if (config_.enabled) gain_ = target_ = std::min(std::max(gain, 0.01f), maxGain_);
+	}
+
+	// Normalizes x in place (delayed by the lookahead).
+	void Process(float* x, size_t n) {
+		if (meter_.Push(x, n, 1.0f) > 0 && meter_.MomentaryLufs() > config_.gateLufs) {
+			const float db = config_.targetLufs - meter_.GatedShortTermLufs(config_.gateLufs);
+			target_ = std::min(maxGain_, std::pow(10.0f, db / 20.0f));
+		}
+		const size_t window = lookahead_ + 1, cap = minGain_.size();
+		for (size_t i = 0; i < n; ++i, ++at_) {
+			gain_ += (target_ - gain_) * smooth_;
+			const float in = x[i] * gain_;
+			const float a = in < 0 ? -in : in;
+			const float need = a > ceiling_ ? ceiling_ / a : 1.0f;
+			// Sliding minimum of the needed gain over the samples still in the delay line
+			while (tail_ != head_ && minGain_[(tail_ + cap - 1) % cap] >= need) tail_ = (tail_ + cap - 1) % cap;
+			minGain_[tail_] = need;
+			minPos_[tail_] = at_;
+			tail_ = (tail_ + 1) % cap;
+			if (at_ - minPos_[head_] >= window) head_ = (head_ + 1) % cap;
+			const float hold = minGain_[head_];
+			envelope_ += (hold - envelope_) * (hold < envelope_ ? attack_ : release_);
+			const size_t slot = at_ % lookahead_;
+			float out = delay_[slot] * envelope_;
+			delay_[slot] = in;
+			if (out > ceiling_) out = ceiling_; else if (out < -ceiling_) out = -ceiling_; // whatever the envelope missed
+			x[i] = out;
+		}
+	}
+
+private:
+	LoudnessConfig config_;
+	LoudnessMeter meter_;
+	size_t lookahead_ = 1;
+	std::vector<float> delay_;
+	std::vector<float> minGain_; // ring deque, increasing from head_
+	std::vector<uint64_t> minPos_;
+	size_t head_ = 0, tail_ = 0;
+	uint64_t at_ = 0;
+	float ceiling_ = 1.0f, maxGain_ = 1.0f;
+	float smooth_ = 0.0f, attack_ = 0.0f, release_ = 0.0f;
+	float gain_ = 1.0f, target_ = 1.0f, envelope_ = 1.0f;
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+// Read-only memory map of a whole file, plus the few file-system helpers the
+// on-disk caches need (size/mtime stamp, atomic replace). Paths are UTF-8 on
+// every platform; Windows widens them for the W APIs. The file may still be
+// open for appending elsewhere; the map covers the size it had when opened.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+inline std::wstring WidenUtf8(const std::string& s) {
+	const int n = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), nullptr, 0);
+	std::wstring w(n > 0 ? (size_t)n : 0, L'\0');
+	if (n > 0) MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), &w[0], n);
+	return w;
+}
+
+inline std::string NarrowUtf8(const std::wstring& w) {
+	const int n = WideCharToMultiByte(CP_UTF8, 0, w.c_str(), (int)w.size(), nullptr, 0, nullptr, nullptr);
+	std::string s(n > 0 ? (size_t)n : 0, '\0');
+	if (n > 0) WideCharToMultiByte(CP_UTF8, 0, w.c_str(), (int)w.size(), &s[0], n, nullptr, nullptr);
+	return s;
+}
+#endif
+
+// Identifies a source file's contents well enough to invalidate caches.
+struct FileStamp {
+	uint64_t size = 0;
+	int64_t mtime = 0; // seconds since the epoch
+};
+
+inline bool StatFile(const std::string& path, FileStamp* stamp) {
+#if defined(_WIN32)
+	struct _stat64 st;
+	if (_wstat64(WidenUtf8(path).c_str(), &st) != 0) return false;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) return false;
+#endif
+	stamp->size = (uint64_t)st.st_size;
+	stamp->mtime = (int64_t)st.st_mtime;
+	return true;
+}
+
+inline FILE* OpenFileUtf8(const std::string& path, const char* mode) {
+#if defined(_WIN32)
+	return _wfopen(WidenUtf8(path).c_str(), WidenUtf8(mode).c_str());
+#else
+	return fopen(path.c_str(), mode);
+#endif
+}
+
+// Moves from over to, replacing to; readers see the old file or the new one.
+inline bool MoveFileReplacing(const std::string& from, const std::string& to) {
+#if defined(_WIN32)
+	return MoveFileExW(WidenUtf8(from).c_str(), WidenUtf8(to).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+inline void RemoveFile(const std::string& path) {
+#if defined(_WIN32)
+	_wremove(WidenUtf8(path).c_str());
+#else
+	remove(path.c_str());
+#endif
+}
+
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { Close(); }
+
+	// copyOnWrite maps the pages private and writable, for memory handed to
+	// JS as a Buffer: a write lands in a private copy, never in the file.
+	bool Open(const std::string& path, std::string* error, bool copyOnWrite = false) {
+		Close();
+#if defined(_WIN32)
+		file_ = CreateFileW(WidenUtf8(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file_ == INVALID_HANDLE_VALUE) return Fail("could not open ", path, error);
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) return Fail("empty or unreadable file ", path, error);
+		mapping_ = CreateFileMappingW(file_, nullptr, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping_) return Fail("CreateFileMapping failed for ", path, error);
+		data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+		if (!data_) return Fail("MapViewOfFile failed for ", path, error);
+		size_ = (size_t)size.QuadPart;
+#else
+		const int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) return Fail("could not open ", path, error);
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close(fd);
+			return Fail("empty or unreadable file ", path, error);
+		}
+		void* p = mmap(nullptr, (size_t)st.st_size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ,
+		               copyOnWrite ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+		close(fd); // the mapping keeps the file referenced
+		if (p == MAP_FAILED) return Fail("mmap failed for ", path, error);
+		data_ = static_cast<const uint8_t*>(p);
+		size_ = (size_t)st.st_size;
+#endif
+		return true;
+	}
+
+	const uint8_t* Data() const { return data_; }
+	size_t Size() const { return size_; }
+
+	void Close() {
+#if defined(_WIN32)
+		if (data_) UnmapViewOfFile(data_);
+		if (mapping_) CloseHandle(mapping_);
+		if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+		mapping_ = nullptr;
+		file_ = INVALID_HANDLE_VALUE;
+#else
+		if (data_) munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+		data_ = nullptr;
+		size_ = 0;
+	}
+
+private:
+	bool Fail(const char* what, const std::string& path, std::string* error) {
+		*error = what + path;
+		Close();
+		return false;
+	}
+
+#if defined(_WIN32)
+	HANDLE file_ = INVALID_HANDLE_VALUE;
+	HANDLE mapping_ = nullptr;
+#endif
+	const uint8_t* data_ = nullptr;
+	size_t size_ = 0;
+};
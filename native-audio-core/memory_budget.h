@@ -0,0 +1,235 @@
+#pragma once
+
+// What the addon's own buffers take, per subsystem, and what it gives back
+// when the OS runs low on memory. None of it shows in the JS heap.
+//
+// A MemoryCharge is owned by a buffer's holder and set to the bytes it holds
+// (capture history rings, pre-roll, packet slot pools, the chunk mel store);
+// the totals are atomics, so the capture thread may set one. Model weights
+// are counted where they are loaded (memory_budget_bindings.h).
+//
+// Holders that can shrink register a MemoryTrimHook. The first one starts
+// the pressure watch: CreateMemoryResourceNotification's low-memory event on
+// Windows, a DISPATCH_SOURCE_TYPE_MEMORYPRESSURE source on macOS, and
+// elsewhere a poll for less than a tenth of RAM available. On each signal
+// every hook runs once, from the watch's thread; while the OS stays low it
+// signals again every kRepeatMs, so shrinking continues step by step.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "addon_log.h"
+#include "system_memory.h"
+#include "thread_cpu.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+enum class MemoryKind { History, Preroll, PcmPools, MelCache, kCount };
+
+inline const char* MemoryKindName(MemoryKind kind) {
+	switch (kind) {
+	case MemoryKind::History: return "history";
+	case MemoryKind::Preroll: return "preroll";
+	case MemoryKind::PcmPools: return "pcmPools";
+	default: return "melCache";
+	}
+}
+
+struct MemoryPressureStats {
+	const char* signal = "none"; // 'low-memory-notification', 'dispatch-source' or 'poll'
+	bool low = false;            // the OS reports pressure now
+	uint64_t events = 0;         // signals acted on
+	double lastMs = 0;           // when the last one was, ms since the Unix epoch
+};
+
+class MemoryBudget {
+public:
+	static constexpr uint32_t kRepeatMs = 30000;
+	static constexpr uint32_t kPollMs = 5000;
+
+	void Charge(MemoryKind kind, int64_t delta) {
+		bytes_[(size_t)kind].fetch_add(delta, std::memory_order_relaxed);
+	}
+
+	uint64_t Bytes(MemoryKind kind) const {
+		const int64_t bytes = bytes_[(size_t)kind].load(std::memory_order_relaxed);
+		return bytes > 0 ? (uint64_t)bytes : 0;
+	}
+
+	uint64_t AddHook(std::function<void()> trim) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		StartWatch();
+		hooks_.emplace_back(++nextHook_, std::move(trim));
+		return nextHook_;
+	}
+
+	// Waits for a trim in progress, so the hook's owner can go right after.
+	void RemoveHook(uint64_t id) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto it = hooks_.begin(); it != hooks_.end(); ++it) {
+			if (it->first != id) continue;
+			hooks_.erase(it);
+			return;
+		}
+	}
+
+	// Runs every hook; the watch calls it on each signal.
+	void Trim(const char* why) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		++events_;
+		lastMs_ = (double)std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+		AddonLog(LogLevel::Warn, "Memory pressure (%s): trimming %zu holder(s), %.0f MB available", why, hooks_.size(),
+		         ReadSystemMemory().availableMb);
+		for (auto& hook : hooks_) hook.second();
+	}
+
+	MemoryPressureStats Pressure() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		MemoryPressureStats stats;
+		stats.signal = signal_;
+		stats.low = low_.load(std::memory_order_relaxed);
+		stats.events = events_;
+		stats.lastMs = lastMs_;
+		return stats;
+	}
+
+private:
+	// mutex_ held. The watch lives as long as the process.
+	void StartWatch() {
+		if (watching_) return;
+		watching_ = true;
+#if defined(_WIN32)
+		HANDLE low = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+		if (!low) return;
+		signal_ = "low-memory-notification";
+		std::thread([this, low] {
+			ThreadCpuScope cpu("memory-pressure");
+			for (;;) {
+				if (WaitForSingleObject(low, INFINITE) != WAIT_OBJECT_0) return;
+				low_.store(true, std::memory_order_relaxed);
+				Trim("low-memory-notification");
+				Sleep(kRepeatMs);
+				BOOL state = FALSE;
+				if (QueryMemoryResourceNotification(low, &state) && !state) low_.store(false, std::memory_order_relaxed);
+			}
+		}).detach();
+#elif defined(__APPLE__)
+		dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+			DISPATCH_MEMORYPRESSURE_NORMAL | DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+			dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+		if (!source) return;
+		signal_ = "dispatch-source";
+		source_ = source;
+		dispatch_set_context(source, this);
+		dispatch_source_set_event_handler_f(source, [](void* context) {
+			MemoryBudget* self = static_cast<MemoryBudget*>(context);
+			const unsigned long level = dispatch_source_get_data(self->source_);
+			const bool low = (level & (DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL)) != 0;
+			self->low_.store(low, std::memory_order_relaxed);
+			if (low) self->Trim((level & DISPATCH_MEMORYPRESSURE_CRITICAL) ? "critical" : "warn");
+		});
+		dispatch_resume(source);
+#else
+		signal_ = "poll";
+		std::thread([this] {
+			ThreadCpuScope cpu("memory-pressure");
+			for (;;) {
+				const SystemMemory memory = ReadSystemMemory();
+				const bool low = memory.totalMb > 0 && memory.availableMb < memory.totalMb / 10;
+				low_.store(low, std::memory_order_relaxed);
+				if (low) Trim("poll");
+				std::this_thread::sleep_for(std::chrono::milliseconds(low ? kRepeatMs : kPollMs));
+			}
+		}).detach();
+#endif
+	}
+
+	std::atomic<int64_t> bytes_[(size_t)MemoryKind::kCount] = {};
+	std::mutex mutex_; // everything below; held while hooks run
+	std::vector<std::pair<uint64_t, std::function<void()>>> hooks_;
+	uint64_t nextHook_ = 0;
+	bool watching_ = false;
+	const char* signal_ = "none";
+	std::atomic<bool> low_{false};
+	uint64_t events_ = 0;
+	double lastMs_ = 0;
+#if defined(__APPLE__)
+	dispatch_source_t source_ = nullptr;
+#endif
+};
+
+inline MemoryBudget& AddonMemory() {
+	static MemoryBudget* budget = new MemoryBudget(); // never destroyed: the watch outlives static teardown
+	return *budget;
+}
+
+// The bytes one holder has of a kind; zero again when it goes.
+class MemoryCharge {
+public:
+	explicit MemoryCharge(MemoryKind kind) : kind_(kind) {}
+	MemoryCharge(const MemoryCharge&) = delete;
+	MemoryCharge& operator=(const MemoryCharge&) = delete;
+	~MemoryCharge() { Set(0); }
+
+	// Any one thread at a time.
+	void Set(uint64_t bytes) {
+		AddonMemory().Charge(kind_, (int64_t)bytes - (int64_t)bytes_);
+		bytes_ = bytes;
+	}
+
+	uint64_t Bytes() const { return bytes_; }
+
+private:
+	const MemoryKind kind_;
+	uint64_t bytes_ = 0;
+};
+
+// Registers trim for its lifetime; trim runs on the pressure watch's thread.
+class MemoryTrimHook {
+public:
+	explicit MemoryTrimHook(std::function<void()> trim) : id_(AddonMemory().AddHook(std::move(trim))) {}
+	MemoryTrimHook(const MemoryTrimHook&) = delete;
+	MemoryTrimHook& operator=(const MemoryTrimHook&) = delete;
+	~MemoryTrimHook() { AddonMemory().RemoveHook(id_); }
+
+private:
+	const uint64_t id_;
+};
+
+// Returns the whole pages inside [data, data + bytes) to the OS; their
+// contents are undefined afterwards, and writing them maps fresh pages.
+inline void DiscardPages(void* data, size_t bytes) {
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	const uintptr_t page = info.dwPageSize;
+#else
+	const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+#endif
+	const uintptr_t begin = ((uintptr_t)data + page - 1) & ~(page - 1);
+	const uintptr_t end = ((uintptr_t)data + bytes) & ~(page - 1);
+	if (end <= begin) return;
+#if defined(_WIN32)
+	DiscardVirtualMemory((void*)begin, end - begin);
+#elif defined(__APPLE__)
+	madvise((void*)begin, end - begin, MADV_FREE);
+#else
+	madvise((void*)begin, end - begin, MADV_DONTNEED);
+#endif
+}
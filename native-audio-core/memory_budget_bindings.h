@@ -0,0 +1,61 @@
+#pragma once
+
+// getStats().memory: the bytes the addon holds outside the JS heap, per
+// subsystem, and the pressure watch that trims them (memory_budget.h).
+//
+//   { totalBytes, history, preroll, pcmPools, melCache, whisperModels,
+//     translationModels, ttsCache, pressure: { signal, low, events, lastMs },
+//     realtime: { lockedBytes, unlockedBytes, capBytes, blocks, denied } }
+//
+// Buffers are counted as allocated; models by the resident growth their load
+// measured (weights on a GPU are not in it); ttsCache is the mapped segment
+// files of this environment's cache, file pages the OS can drop on its own.
+// realtime is the page-locked memory of the capture threads' buffers
+// (realtime_memory.h); those bytes are already in the subsystems above.
+
+#include <napi.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "memory_budget.h"
+#include "realtime_memory.h"
+#include "translation_engine.h"
+#include "tts_audio_cache.h"
+#include "whisper_engine.h"
+
+inline Napi::Object MemoryStatsToJs(Napi::Env env) {
+	const double kMb = 1024.0 * 1024.0;
+	MemoryBudget& budget = AddonMemory();
+	Napi::Object o = Napi::Object::New(env);
+	double total = 0;
+	for (size_t k = 0; k < (size_t)MemoryKind::kCount; ++k) {
+		const double bytes = (double)budget.Bytes((MemoryKind)k);
+		o.Set(MemoryKindName((MemoryKind)k), Napi::Number::New(env, bytes));
+		total += bytes;
+	}
+	double whisper = 0, translation = 0;
+	for (const WhisperResidentModel& m : WhisperModels().Resident()) whisper += m.info.memoryMb * kMb;
+	for (const TranslationPairInfo& p : Translation().Loaded()) translation += p.info.memoryMb * kMb;
+	const double tts = TtsCacheInstance(env) ? (double)TtsCacheInstance(env)->Bytes() : 0;
+	o.Set("whisperModels", Napi::Number::New(env, whisper));
+	o.Set("translationModels", Napi::Number::New(env, translation));
+	o.Set("ttsCache", Napi::Number::New(env, tts));
+	o.Set("totalBytes", Napi::Number::New(env, total + whisper + translation + tts));
+	const MemoryPressureStats pressure = budget.Pressure();
+	Napi::Object p = Napi::Object::New(env);
+	p.Set("signal", Napi::String::New(env, pressure.signal));
+	p.Set("low", Napi::Boolean::New(env, pressure.low));
+	p.Set("events", Napi::Number::New(env, (double)pressure.events));
+	p.Set("lastMs", Napi::Number::New(env, pressure.lastMs));
+	o.Set("pressure", p);
+	const RealtimeMemoryStats locked = AddonRealtimeMemory().Stats();
+	Napi::Object r = Napi::Object::New(env);
+	r.Set("lockedBytes", Napi::Number::New(env, (double)locked.lockedBytes));
+	r.Set("unlockedBytes", Napi::Number::New(env, (double)locked.unlockedBytes));
+	r.Set("capBytes", Napi::Number::New(env, (double)locked.capBytes));
+	r.Set("blocks", Napi::Number::New(env, (double)locked.blocks));
+	r.Set("denied", Napi::Number::New(env, (double)locked.denied));
+	o.Set("realtime", r);
+	return o;
+}
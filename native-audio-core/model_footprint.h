@@ -0,0 +1,42 @@
+#pragma once
+
+// getStats().models: the machine's memory and what the resident speech and
+// translation models take of it, with the weight type each one runs at, so
+// a stall on a small laptop can be matched against a model that didn't fit.
+//
+//   { totalMb, availableMb, processMb,
+//     whisper: [{ path, device, quantization, weightsMb, memoryMb }],
+//     translation: [{ from, to, computeType, weightsMb, memoryMb }] }
+//
+// memoryMb is the process's resident growth over the load; a model on a GPU
+// keeps its weights in VRAM, so its weightsMb is not in processMb.
+
+#include <napi.h>
+
+#include <vector>
+
+#include "system_memory.h"
+#include "translation_engine.h"
+#include "whisper_engine.h"
+
+inline Napi::Object ModelFootprintToJs(Napi::Env env) {
+	const SystemMemory memory = ReadSystemMemory();
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("totalMb", Napi::Number::New(env, memory.totalMb));
+	o.Set("availableMb", Napi::Number::New(env, memory.availableMb));
+	o.Set("processMb", Napi::Number::New(env, ProcessResidentMb()));
+	const std::vector<WhisperResidentModel> models = WhisperModels().Resident();
+	Napi::Array whisper = Napi::Array::New(env, models.size());
+	for (size_t i = 0; i < models.size(); ++i) {
+		Napi::Object m = Napi::Object::New(env);
+		m.Set("path", Napi::String::New(env, models[i].path));
+		m.Set("device", Napi::String::New(env, WhisperDeviceName(models[i].device)));
+		m.Set("quantization", Napi::String::New(env, models[i].info.quantization));
+		m.Set("weightsMb", Napi::Number::New(env, models[i].info.weightsMb));
+		m.Set("memoryMb", Napi::Number::New(env, models[i].info.memoryMb));
+		whisper.Set((uint32_t)i, m);
+	}
+	o.Set("whisper", whisper);
+	o.Set("translation", TranslationModelsToJs(env));
+	return o;
+}
@@ -0,0 +1,382 @@
+#pragma once
+
+// Neural voice activity detection (capture option "neuralVad"): a Silero VAD
+// v5 class ONNX model run on ONNX Runtime beside the DSP detector (vad.h),
+// which keeps framing the stream and timing every decision. A frame is speech
+// only when both call it so, which takes out the music and keyboard noise
+// that passes the band-energy test even in 'very-aggressive' mode. Built with
+// use_onnxruntime=1 (AUDIO_CORE_ONNXRUNTIME); otherwise the option is
+// rejected and captures keep the DSP detector alone.
+//
+//   neuralVad: { model, threshold?: 0.5, hangoverMs?: 200 }
+//
+// The model reads windows of 512 samples at 16 kHz (256 at 8 kHz), 32 ms,
+// each with the last 64 (32) samples of the one before as context, and
+// carries a [2, batch, 128] recurrent state from window to window; it has
+// its own learned STFT, so it takes samples rather than the capture's
+// log-mel frames (log_mel.h). Captures at other rates leave it out.
+//
+// No capture thread runs the model. Each capture queues its windows
+// (NeuralVadStream::Push) and one shared inference thread, every kTickMs,
+// runs whatever every open stream (loopback, microphone, subscribers) has
+// queued as one batch per model and rate: the loopback and the microphone
+// cost one Run a tick, not two a window. The verdict the capture thread reads
+// is the latest the batcher has written, a tick or so behind the audio; the
+// chunker's pre-roll covers the onset that lag delays. A probability of
+// `threshold` starts speech, one under threshold - 0.15 for hangoverMs ends
+// it, as in Silero's own iterator.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "addon_log.h"
+#include "mapped_file.h"
+#include "onnx_runtime.h"
+#include "thread_cpu.h"
+#include "thread_schedule.h"
+
+struct NeuralVadModel {
+	std::string path;
+#if defined(AUDIO_CORE_ONNXRUNTIME)
+	std::unique_ptr<Ort::Session> session;
+#endif
+
+	// JS thread (option parsing). Captures naming the same file share one
+	// session, and so one batch. Null with *error set when it won't load.
+	static std::shared_ptr<NeuralVadModel> Load(const std::string& path, std::string* error) {
+#if defined(AUDIO_CORE_ONNXRUNTIME)
+		static std::mutex mutex;
+		static std::map<std::string, std::weak_ptr<NeuralVadModel>> loaded;
+		std::lock_guard<std::mutex> lock(mutex);
+		if (std::shared_ptr<NeuralVadModel> model = loaded[path].lock()) return model;
+		auto model = std::make_shared<NeuralVadModel>();
+		model->path = path;
+		try {
+			Ort::SessionOptions options;
+			// A batch is a few windows: more threads would only wait on each other
+			options.SetIntraOpNumThreads(1);
+			options.SetInterOpNumThreads(1);
+			options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+#if defined(_WIN32)
+			model->session = std::make_unique<Ort::Session>(OnnxRuntimeEnv(), WidenUtf8(path).c_str(), options);
+#else
+			model->session = std::make_unique<Ort::Session>(OnnxRuntimeEnv(), path.c_str(), options);
+#endif
+			Ort::AllocatorWithDefaultOptions allocator;
+			bool state = false;
+			for (size_t i = 0; i < model->session->GetInputCount(); ++i) {
+				state = state || std::string(model->session->GetInputNameAllocated(i, allocator).get()) == "state";
+			}
+			if (model->session->GetInputCount() != 3 || !state) {
+				*error = "Neural VAD model " + path + ": not a Silero v5 model (inputs input, state, sr)";
+				return nullptr;
+			}
+		} catch (const Ort::Exception& e) {
+			*error = "Neural VAD model " + path + ": " + e.what();
+			return nullptr;
+		}
+		loaded[path] = model;
+		AddonLog(LogLevel::Info, "Neural VAD model %s loaded", path.c_str());
+		return model;
+#else
+		(void)path;
+		*error = "Neural VAD is not built in (use_onnxruntime=0)";
+		return nullptr;
+#endif
+	}
+};
+
+struct NeuralVadConfig {
+	std::shared_ptr<NeuralVadModel> model; // null: off
+	float threshold = 0.5f;
+	uint32_t hangoverMs = 200;
+};
+
+struct NeuralVadStats {
+	uint64_t streams = 0;   // open now
+	uint64_t batches = 0;   // Runs
+	uint64_t windows = 0;   // windows they covered
+	uint64_t dropped = 0;   // windows a capture queued faster than the batcher ran
+	double busyMs = 0.0;    // inference time
+};
+
+class NeuralVadStream {
+public:
+	static constexpr size_t kSlots = 16; // queued windows, half a second at 16 kHz
+
+	NeuralVadStream(std::shared_ptr<NeuralVadModel> model, uint32_t sampleRate, const NeuralVadConfig& config)
+	    : model_(std::move(model)),
+	      sampleRate_(sampleRate),
+	      window_(sampleRate == 8000 ? 256 : 512),
+	      context_(sampleRate == 8000 ? 32 : 64),
+	      threshold_(config.threshold),
+	      hangoverWindows_((uint32_t)((uint64_t)config.hangoverMs * sampleRate / 1000 / window_)) {
+		for (std::vector<float>& slot : slots_) slot.assign(window_, 0.0f);
+		input_.assign(context_ + window_, 0.0f);
+		state_.fill(0.0f);
+	}
+
+	// Capture thread: delivered samples, scaled by gain as the DSP detector sees them.
+	void Push(const float* x, size_t n, float gain) {
+		while (n > 0) {
+			const uint64_t tail = tail_.load(std::memory_order_relaxed);
+			std::vector<float>& slot = slots_[tail % kSlots];
+			const size_t take = std::min(n, window_ - filled_);
+			for (size_t i = 0; i < take; ++i) slot[filled_ + i] = x[i] * gain;
+			filled_ += take;
+			x += take;
+			n -= take;
+			if (filled_ < window_) break;
+			filled_ = 0;
+			// The batcher stalled: drop the window rather than overwrite one it reads
+			if (tail - head_.load(std::memory_order_acquire) >= kSlots - 1) {
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			tail_.store(tail + 1, std::memory_order_release);
+		}
+	}
+
+	// Capture thread, after a gap: the next window starts over, and so does
+	// the model's state.
+	void Reset() {
+		filled_ = 0;
+		reset_.store(true, std::memory_order_release);
+	}
+
+	// Any thread: the latest verdict, with its hangover.
+	bool Speech() const { return speech_.load(std::memory_order_relaxed); }
+	float Probability() const { return probability_.load(std::memory_order_relaxed); }
+
+private:
+	friend class NeuralVadBatcher;
+
+	// Batcher: the oldest queued window, with the previous one's tail ahead of it
+	const float* Input() {
+		if (reset_.exchange(false, std::memory_order_acq_rel)) {
+			std::fill(input_.begin(), input_.end(), 0.0f);
+			state_.fill(0.0f);
+			speaking_ = false;
+			hangover_ = 0;
+		}
+		const std::vector<float>& slot = slots_[head_.load(std::memory_order_relaxed) % kSlots];
+		std::copy(input_.end() - context_, input_.end(), input_.begin());
+		std::copy(slot.begin(), slot.end(), input_.begin() + context_);
+		return input_.data();
+	}
+
+	// Batcher: the model's verdict on the window Input() gave
+	void Decide(float p) {
+		if (p >= threshold_) {
+			speaking_ = true;
+			hangover_ = hangoverWindows_;
+		} else if (speaking_ && p < threshold_ - 0.15f) {
+			if (hangover_ > 0) --hangover_;
+			else speaking_ = false;
+		}
+		probability_.store(p, std::memory_order_relaxed);
+		speech_.store(speaking_, std::memory_order_relaxed);
+		head_.fetch_add(1, std::memory_order_release);
+	}
+
+	bool Queued() const { return head_.load(std::memory_order_relaxed) != tail_.load(std::memory_order_acquire); }
+
+	const std::shared_ptr<NeuralVadModel> model_;
+	const uint32_t sampleRate_;
+	const size_t window_, context_;
+	const float threshold_;
+	const uint32_t hangoverWindows_;
+
+	// Capture thread
+	std::array<std::vector<float>, kSlots> slots_;
+	size_t filled_ = 0;
+	alignas(64) std::atomic<uint64_t> tail_{0};
+	// Batcher
+	alignas(64) std::atomic<uint64_t> head_{0};
+	std::vector<float> input_;        // context, then the window
+	std::array<float, 2 * 128> state_; // [2][128]: this stream's slice of the batch state
+	bool speaking_ = false;
+	uint32_t hangover_ = 0;
+	// Shared
+	std::atomic<bool> reset_{false};
+	std::atomic<bool> speech_{false};
+	std::atomic<float> probability_{0.0f};
+	std::atomic<uint64_t> dropped_{0};
+};
+
+class NeuralVadBatcher {
+public:
+	static constexpr uint32_t kTickMs = 10;
+
+	// Capture thread (PcmPacketWriter::Configure). The stream lives as long as
+	// the caller holds it; the batcher forgets it after that.
+	std::shared_ptr<NeuralVadStream> Open(const NeuralVadConfig& config, uint32_t sampleRate) {
+		auto stream = std::make_shared<NeuralVadStream>(config.model, sampleRate, config);
+		std::lock_guard<std::mutex> lock(mutex_);
+		streams_.push_back(stream);
+		if (!thread_.joinable()) thread_ = std::thread([this] { Loop(); });
+		wake_.notify_all();
+		return stream;
+	}
+
+	NeuralVadStats Stats() {
+		NeuralVadStats s;
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const std::weak_ptr<NeuralVadStream>& weak : streams_) {
+			if (std::shared_ptr<NeuralVadStream> stream = weak.lock()) {
+				++s.streams;
+				s.dropped += stream->dropped_.load(std::memory_order_relaxed);
+			}
+		}
+		s.dropped += dropped_;
+		s.batches = batches_;
+		s.windows = windows_;
+		s.busyMs = busyNs_ / 1e6;
+		return s;
+	}
+
+private:
+	void Loop() {
+		ThreadCpuScope cpu("neural-vad");
+		ApplyThreadQos(ThreadQos::Interactive); // capture chains wait on its verdicts
+		std::vector<std::shared_ptr<NeuralVadStream>> open;
+		std::unique_lock<std::mutex> lock(mutex_);
+		for (;;) {
+			// Streams whose capture let go are forgotten; with none left, sleep until one opens
+			open.clear();
+			for (auto it = streams_.begin(); it != streams_.end();) {
+				if (std::shared_ptr<NeuralVadStream> stream = it->lock()) {
+					open.push_back(std::move(stream));
+					++it;
+				} else {
+					it = streams_.erase(it);
+				}
+			}
+			if (open.empty()) {
+				wake_.wait(lock);
+				continue;
+			}
+			lock.unlock();
+			Tick(open);
+			open.clear(); // a closed capture's stream goes with its last reference
+			lock.lock();
+			wake_.wait_for(lock, std::chrono::milliseconds(kTickMs));
+		}
+	}
+
+	// One batch per model and rate for as long as any stream has a window queued
+	void Tick(const std::vector<std::shared_ptr<NeuralVadStream>>& open) {
+		std::vector<NeuralVadStream*> batch;
+		for (size_t first = 0; first < open.size(); ++first) {
+			const NeuralVadStream& lead = *open[first];
+			bool seen = false;
+			for (size_t i = 0; i < first && !seen; ++i) {
+				seen = open[i]->model_ == lead.model_ && open[i]->sampleRate_ == lead.sampleRate_;
+			}
+			if (seen) continue; // its group ran with the earlier stream's
+			for (;;) {
+				batch.clear();
+				for (size_t i = first; i < open.size(); ++i) {
+					NeuralVadStream* s = open[i].get();
+					if (s->model_ == lead.model_ && s->sampleRate_ == lead.sampleRate_ && s->Queued()) batch.push_back(s);
+				}
+				if (batch.empty()) break;
+				Run(batch);
+			}
+		}
+	}
+
+	void Run(const std::vector<NeuralVadStream*>& batch) {
+		const auto start = std::chrono::steady_clock::now();
+		const size_t n = batch.size();
+		const size_t width = batch[0]->context_ + batch[0]->window_;
+		input_.resize(n * width);
+		state_.resize(2 * n * 128);
+		for (size_t b = 0; b < n; ++b) {
+			memcpy(input_.data() + b * width, batch[b]->Input(), width * sizeof(float));
+			for (size_t layer = 0; layer < 2; ++layer) {
+				memcpy(state_.data() + (layer * n + b) * 128, batch[b]->state_.data() + layer * 128, 128 * sizeof(float));
+			}
+		}
+#if defined(AUDIO_CORE_ONNXRUNTIME)
+		try {
+			Ort::MemoryInfo memory = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+			const int64_t inputShape[] = { (int64_t)n, (int64_t)width };
+			const int64_t stateShape[] = { 2, (int64_t)n, 128 };
+			int64_t rate = batch[0]->sampleRate_;
+			Ort::Value inputs[] = {
+				Ort::Value::CreateTensor<float>(memory, input_.data(), input_.size(), inputShape, 2),
+				Ort::Value::CreateTensor<float>(memory, state_.data(), state_.size(), stateShape, 3),
+				Ort::Value::CreateTensor<int64_t>(memory, &rate, 1, nullptr, 0),
+			};
+			const char* inputNames[] = { "input", "state", "sr" };
+			const char* outputNames[] = { "output", "stateN" };
+			std::vector<Ort::Value> out = batch[0]->model_->session->Run(Ort::RunOptions{ nullptr }, inputNames, inputs, 3,
+			                                                             outputNames, 2);
+			const float* p = out[0].GetTensorData<float>();
+			const float* next = out[1].GetTensorData<float>();
+			for (size_t b = 0; b < n; ++b) {
+				for (size_t layer = 0; layer < 2; ++layer) {
+					memcpy(batch[b]->state_.data() + layer * 128, next + (layer * n + b) * 128, 128 * sizeof(float));
+				}
+				batch[b]->Decide(p[b]);
+			}
+		} catch (const Ort::Exception& e) {
+			// The windows go unjudged; the captures keep the last verdict
+			if (!failed_) AddonLog(LogLevel::Error, "Neural VAD inference failed: %s", e.what());
+			failed_ = true;
+			for (NeuralVadStream* s : batch) s->head_.fetch_add(1, std::memory_order_release);
+			std::lock_guard<std::mutex> lock(mutex_);
+			dropped_ += n;
+			return;
+		}
+#else
+		for (NeuralVadStream* s : batch) s->head_.fetch_add(1, std::memory_order_release); // no model loads without it
+#endif
+		const uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		std::lock_guard<std::mutex> lock(mutex_);
+		++batches_;
+		windows_ += n;
+		busyNs_ += ns;
+	}
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::thread thread_;
+	std::vector<std::weak_ptr<NeuralVadStream>> streams_;
+	std::vector<float> input_, state_; // the batch, [n][context + window] and [2][n][128]
+	bool failed_ = false;
+	uint64_t batches_ = 0, windows_ = 0, dropped_ = 0, busyNs_ = 0;
+};
+
+// Never destroyed: its thread runs for the life of the process.
+inline NeuralVadBatcher& NeuralVad() {
+	static NeuralVadBatcher* batcher = new NeuralVadBatcher();
+	return *batcher;
+}
+
+// getStats().neuralVad
+inline Napi::Object NeuralVadStatsToJs(Napi::Env env) {
+	const NeuralVadStats s = NeuralVad().Stats();
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("streams", Napi::Number::New(env, (double)s.streams));
+	o.Set("batches", Napi::Number::New(env, (double)s.batches));
+	o.Set("windows", Napi::Number::New(env, (double)s.windows));
+	o.Set("meanBatch", Napi::Number::New(env, s.batches ? (double)s.windows / s.batches : 0.0));
+	o.Set("dropped", Napi::Number::New(env, (double)s.dropped));
+	o.Set("busyMs", Napi::Number::New(env, s.busyMs));
+	return o;
+}
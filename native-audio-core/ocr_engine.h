@@ -0,0 +1,325 @@
+#pragma once
+
+// Native Tesseract OCR on gray8 images from the region grabber and
+// preprocessForOcr (region_capture.h, ocr_preprocess.h), instead of
+// tesseract.js in WASM: a pool of initialised TessBaseAPI instances, so the
+// traineddata loads once per instance and several watch boxes recognise at
+// the same time. Built with gyp variable use_tesseract=1
+// (AUDIO_CORE_TESSERACT, links libtesseract and Leptonica); otherwise every
+// call rejects and callers keep tesseract.js.
+//
+//   loadOcrEngine(dataPath, { language?, instances? }) -> Promise<{ instances, loadMs }>
+//   recognizeOcr(image, { psm?, words? }) -> Promise<{ text, confidence, words, processingMs }>
+//   unloadOcrEngine() -> Promise<void>
+//
+// dataPath is the directory holding <language>.traineddata (language 'eng' by
+// default, or 'eng+deu' for several). image is { data, width, height,
+// stride? } of gray8 rows; data is read in place, not copied. Each
+// recognition runs on the task pool and checks an instance out of the
+// instance pool for its duration, so up to `instances` (default: one per
+// core, at most 8) run in parallel, as far as the task pool's workers allow;
+// more wait for one to come back. Tesseract should be built without OpenMP:
+// instances are the parallelism. words: [{ text,
+// confidence, x, y, width, height }] in image pixels; confidences are 0-100.
+
+#include <napi.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "addon_log.h"
+#include "async_query.h"
+#include "capture_options.h"
+
+#if defined(AUDIO_CORE_TESSERACT)
+#include <tesseract/baseapi.h>
+#include <tesseract/resultiterator.h>
+#endif
+
+struct OcrJobConfig {
+	uint32_t psm = 6; // PSM_SINGLE_BLOCK: a watch box is one block of text
+	bool words = true;
+};
+
+struct OcrWord {
+	std::string text;
+	float confidence = 0.0f;
+	int32_t x = 0, y = 0, width = 0, height = 0;
+};
+
+struct OcrResult {
+	std::string text;
+	float confidence = 0.0f;
+	std::vector<OcrWord> words;
+	double processingMs = 0;
+	std::string error;
+};
+
+inline uint32_t DefaultOcrInstances() {
+	const unsigned hw = std::thread::hardware_concurrency();
+	return hw == 0 ? 2 : (hw > 8 ? 8 : hw);
+}
+
+class OcrEngine {
+public:
+#if defined(AUDIO_CORE_TESSERACT)
+	~OcrEngine() { Unload(); }
+
+	bool Load(const std::string& dataPath, const std::string& language, uint32_t instances, double* loadMs, std::string* error) {
+		Unload();
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<std::unique_ptr<tesseract::TessBaseAPI>> apis;
+		for (uint32_t i = 0; i < instances; ++i) {
+			auto api = std::make_unique<tesseract::TessBaseAPI>();
+			if (api->Init(dataPath.c_str(), language.c_str(), tesseract::OEM_LSTM_ONLY) != 0) {
+				*error = "could not load " + language + ".traineddata from " + dataPath;
+				return false;
+			}
+			apis.push_back(std::move(api));
+		}
+		*loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			idle_ = std::move(apis);
+			instances_ = instances;
+			++generation_;
+		}
+		AddonLog(LogLevel::Info, "Tesseract %s loaded in %.0f ms, %u instance(s)", language.c_str(), *loadMs, instances);
+		return true;
+	}
+
+	// Threadpool thread; waits for an idle instance.
+	bool Recognize(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t stride, const OcrJobConfig& config,
+	               OcrResult* result) {
+		const auto start = std::chrono::steady_clock::now();
+		std::unique_ptr<tesseract::TessBaseAPI> api;
+		uint64_t generation = 0;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			returned_.wait(lock, [&] { return instances_ == 0 || !idle_.empty(); });
+			if (instances_ == 0) {
+				result->error = "no OCR engine loaded";
+				return false;
+			}
+			api = std::move(idle_.back());
+			idle_.pop_back();
+			generation = generation_;
+		}
+		const bool ok = Run(api.get(), pixels, width, height, stride, config, result);
+		api->Clear();
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			// An Unload() or Load() while this ran gave up on the instance; it ends here
+			if (generation == generation_) idle_.push_back(std::move(api));
+			else api->End();
+		}
+		returned_.notify_one();
+		result->processingMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return ok;
+	}
+
+	// Recognitions in flight finish on their instances first.
+	void Unload() {
+		std::vector<std::unique_ptr<tesseract::TessBaseAPI>> idle;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			idle.swap(idle_);
+			instances_ = 0;
+			++generation_;
+		}
+		returned_.notify_all();
+		for (auto& api : idle) api->End();
+	}
+
+private:
+	bool Run(tesseract::TessBaseAPI* api, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t stride,
+	         const OcrJobConfig& config, OcrResult* result) {
+		api->SetPageSegMode((tesseract::PageSegMode)config.psm);
+		api->SetImage(pixels, (int)width, (int)height, 1, (int)stride);
+		api->SetSourceResolution(300); // screen text upscaled for OCR; keeps Tesseract from guessing
+		if (api->Recognize(nullptr) != 0) {
+			result->error = "Tesseract recognition failed";
+			return false;
+		}
+		std::unique_ptr<char[]> text(api->GetUTF8Text());
+		if (text) result->text = text.get();
+		result->confidence = (float)api->MeanTextConf();
+		if (!config.words) return true;
+		std::unique_ptr<tesseract::ResultIterator> it(api->GetIterator());
+		if (!it) return true;
+		const tesseract::PageIteratorLevel level = tesseract::RIL_WORD;
+		do {
+			std::unique_ptr<char[]> word(it->GetUTF8Text(level));
+			if (!word || !word[0]) continue;
+			int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+			it->BoundingBox(level, &x1, &y1, &x2, &y2);
+			OcrWord w;
+			w.text = word.get();
+			w.confidence = it->Confidence(level);
+			w.x = x1;
+			w.y = y1;
+			w.width = x2 - x1;
+			w.height = y2 - y1;
+			result->words.push_back(std::move(w));
+		} while (it->Next(level));
+		return true;
+	}
+
+	std::mutex mutex_; // everything below
+	std::condition_variable returned_;
+	std::vector<std::unique_ptr<tesseract::TessBaseAPI>> idle_;
+	uint32_t instances_ = 0; // loaded, idle or checked out; 0 when unloaded
+	uint64_t generation_ = 0; // bumped by every Load() and Unload()
+#else
+	bool Load(const std::string&, const std::string&, uint32_t, double*, std::string* error) {
+		*error = "Tesseract is not built in (use_tesseract=0)";
+		return false;
+	}
+	bool Recognize(const uint8_t*, uint32_t, uint32_t, uint32_t, const OcrJobConfig&, OcrResult* result) {
+		result->error = "Tesseract is not built in (use_tesseract=0)";
+		return false;
+	}
+	void Unload() {}
+#endif
+};
+
+inline OcrEngine& Ocr() {
+	static OcrEngine engine;
+	return engine;
+}
+
+// loadOcrEngine(dataPath, { language?, instances? }) -> Promise<{ instances, loadMs }>
+inline Napi::Value LoadOcrEngine(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Traineddata directory required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	std::string language = "eng";
+	uint32_t instances = DefaultOcrInstances();
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object obj = info[1].As<Napi::Object>();
+		if (obj.Get("language").IsString()) language = obj.Get("language").As<Napi::String>().Utf8Value();
+		std::string error;
+		if (!ReadUint32Option(obj, "instances", 1, 16, &instances, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+	struct Loaded {
+		bool ok = false;
+		double loadMs = 0;
+		std::string error;
+	};
+	return QueueQuery(env, "LoadOcrEngine",
+		[dataPath = info[0].As<Napi::String>().Utf8Value(), language, instances]() {
+			Loaded result;
+			result.ok = Ocr().Load(dataPath, language, instances, &result.loadMs, &result.error);
+			return result;
+		},
+		[instances](Napi::Env env, Loaded& result) -> Napi::Value {
+			if (!result.ok) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("instances", Napi::Number::New(env, instances));
+			o.Set("loadMs", Napi::Number::New(env, result.loadMs));
+			return o;
+		});
+}
+
+// recognizeOcr({ data, width, height, stride? }, { psm?, words? })
+//   -> Promise<{ text, confidence, words, processingMs }>
+inline Napi::Value RecognizeOcr(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsObject()) {
+		Napi::TypeError::New(env, "Image { data, width, height, stride? } required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Object image = info[0].As<Napi::Object>();
+	if (!image.Get("data").IsBuffer()) {
+		Napi::TypeError::New(env, "Image needs a gray8 data Buffer").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Buffer<uint8_t> data = image.Get("data").As<Napi::Buffer<uint8_t>>();
+	uint32_t width = 0, height = 0, stride = 0;
+	OcrJobConfig config;
+	std::string error;
+	if (!ReadUint32Option(image, "width", 1, 16384, &width, &error) ||
+	    !ReadUint32Option(image, "height", 1, 16384, &height, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	stride = width;
+	if (!ReadUint32Option(image, "stride", width, 65536, &stride, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (width == 0 || height == 0) {
+		Napi::TypeError::New(env, "Image needs width and height").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (data.Length() < (size_t)stride * (height - 1) + width) {
+		Napi::RangeError::New(env, "Image data is shorter than height rows of stride bytes").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object obj = info[1].As<Napi::Object>();
+		if (!ReadUint32Option(obj, "psm", 0, 13, &config.psm, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		if (obj.Get("words").IsBoolean()) config.words = obj.Get("words").As<Napi::Boolean>().Value();
+	}
+
+	// The reference keeps the image's Buffer alive (and unmoved) while an instance reads it
+	auto keep = std::make_shared<Napi::ObjectReference>(Napi::Persistent(data.As<Napi::Object>()));
+	const uint8_t* pixels = data.Data();
+	return QueueQuery(env, "RecognizeOcr",
+		[keep, pixels, width, height, stride, config]() {
+			OcrResult result;
+			Ocr().Recognize(pixels, width, height, stride, config, &result);
+			return result;
+		},
+		[](Napi::Env env, OcrResult& result) -> Napi::Value {
+			if (!result.error.empty()) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("text", Napi::String::New(env, result.text));
+			o.Set("confidence", Napi::Number::New(env, result.confidence));
+			Napi::Array words = Napi::Array::New(env, result.words.size());
+			for (size_t i = 0; i < result.words.size(); ++i) {
+				const OcrWord& w = result.words[i];
+				Napi::Object word = Napi::Object::New(env);
+				word.Set("text", Napi::String::New(env, w.text));
+				word.Set("confidence", Napi::Number::New(env, w.confidence));
+				word.Set("x", Napi::Number::New(env, w.x));
+				word.Set("y", Napi::Number::New(env, w.y));
+				word.Set("width", Napi::Number::New(env, w.width));
+				word.Set("height", Napi::Number::New(env, w.height));
+				words.Set((uint32_t)i, word);
+			}
+			o.Set("words", words);
+			o.Set("processingMs", Napi::Number::New(env, result.processingMs));
+			return o;
+		});
+}
+
+// Ends the idle instances on the threadpool; busy ones end as they finish.
+inline Napi::Value UnloadOcrEngine(const Napi::CallbackInfo& info) {
+	return QueueQuery(info.Env(), "UnloadOcrEngine",
+		[]() {
+			Ocr().Unload();
+			return true;
+		},
+		[](Napi::Env env, bool&) -> Napi::Value { return env.Undefined(); });
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+// OCR preprocessing for raw frames from RegionCapture (region_capture.h):
+// crop, scale to the height the OCR engine reads best, convert to 8-bit gray
+// and optionally stretch the contrast or binarize, into one tightly packed
+// buffer with no image encoding on the way. With the gyp variable
+// use_swscale=1 (AUDIO_CORE_SWSCALE, the vendored libswscale) crop, scale and
+// gray conversion are one sws_scale call on a context that is kept and only
+// rebuilt when the geometry changes; without it a separable area/bilinear
+// resampler does the same in plain C++. Contrast: 'stretch' maps the 1st-99th
+// percentile of the histogram onto 0-255; 'binarize' applies Otsu's threshold
+// and makes the text dark on a light background.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(AUDIO_CORE_SWSCALE)
+extern "C" {
+#include <libswscale/swscale.h>
+}
+#endif
+
+enum class OcrContrast : uint8_t { None, Stretch, Binarize };
+
+struct OcrPreprocessConfig {
+	uint32_t cropX = 0, cropY = 0, cropWidth = 0, cropHeight = 0; // 0 width/height: the whole frame
+	uint32_t height = 0;  // output height; 0 scales by `scale`
+	float scale = 1.0f;
+	OcrContrast contrast = OcrContrast::None;
+};
+
+// Tightly packed gray8 result.
+struct OcrImage {
+	std::vector<uint8_t> pixels;
+	uint32_t width = 0, height = 0;
+	float scaleX = 1.0f, scaleY = 1.0f; // output pixels per input pixel
+};
+
+class OcrPreprocessor {
+public:
+	OcrPreprocessor() = default;
+	OcrPreprocessor(const OcrPreprocessor&) = delete;
+	OcrPreprocessor& operator=(const OcrPreprocessor&) = delete;
+	~OcrPreprocessor() {
+#if defined(AUDIO_CORE_SWSCALE)
+		sws_freeContext(sws_);
+#endif
+	}
+
+	// src holds srcHeight rows of srcStride bytes, BGRA when bgra else gray8.
+	bool Process(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, size_t srcStride, bool bgra,
+	             const OcrPreprocessConfig& config, OcrImage* out, std::string* error) {
+		uint32_t cx = config.cropX, cy = config.cropY;
+		uint32_t cw = config.cropWidth ? config.cropWidth : srcWidth, ch = config.cropHeight ? config.cropHeight : srcHeight;
+		if (cx >= srcWidth || cy >= srcHeight) { *error = "Crop starts outside the frame"; return false; }
+		cw = std::min(cw, srcWidth - cx);
+		ch = std::min(ch, srcHeight - cy);
+		const double scale = config.height ? (double)config.height / (double)ch : (double)config.scale;
+		if (!(scale > 0.0 && scale <= 8.0)) { *error = "Scale must be above 0 and at most 8"; return false; }
+		out->width = std::max<uint32_t>(1, (uint32_t)std::lround(cw * scale));
+		out->height = config.height ? config.height : std::max<uint32_t>(1, (uint32_t)std::lround(ch * scale));
+		out->scaleX = (float)out->width / (float)cw;
+		out->scaleY = (float)out->height / (float)ch;
+		out->pixels.resize((size_t)out->width * out->height);
+		const size_t bpp = bgra ? 4 : 1;
+		const uint8_t* origin = src + (size_t)cy * srcStride + (size_t)cx * bpp;
+		if (!Scale(origin, cw, ch, srcStride, bgra, out, error)) return false;
+		if (config.contrast == OcrContrast::Stretch) Stretch(out);
+		else if (config.contrast == OcrContrast::Binarize) Binarize(out);
+		return true;
+	}
+
+private:
+#if defined(AUDIO_CORE_SWSCALE)
+	bool Scale(const uint8_t* src, uint32_t w, uint32_t h, size_t stride, bool bgra, OcrImage* out, std::string* error) {
+		// Area averaging shrinks text without aliasing; bicubic keeps strokes sharp when enlarging
+		const int flags = out->width < w ? SWS_AREA : SWS_BICUBIC;
+		sws_ = sws_getCachedContext(sws_, (int)w, (int)h, bgra ? AV_PIX_FMT_BGRA : AV_PIX_FMT_GRAY8,
+		                            (int)out->width, (int)out->height, AV_PIX_FMT_GRAY8, flags, nullptr, nullptr, nullptr);
+		if (!sws_) { *error = "swscale context failed"; return false; }
+		const uint8_t* srcPlanes[4] = { src, nullptr, nullptr, nullptr };
+		const int srcStrides[4] = { (int)stride, 0, 0, 0 };
+		uint8_t* dstPlanes[4] = { out->pixels.data(), nullptr, nullptr, nullptr };
+		const int dstStrides[4] = { (int)out->width, 0, 0, 0 };
+		if (sws_scale(sws_, srcPlanes, srcStrides, 0, (int)h, dstPlanes, dstStrides) != (int)out->height) {
+			*error = "sws_scale failed";
+			return false;
+		}
+		return true;
+	}
+
+	SwsContext* sws_ = nullptr;
+#else
+	// Taps of one output sample along an axis: area coverage when shrinking,
+	// linear interpolation when enlarging. Weights are 16.16 fixed point.
+	struct Axis {
+		std::vector<uint32_t> first, count;
+		std::vector<uint32_t> weights; // count[i] weights from offsets[i]
+		std::vector<size_t> offsets;
+	};
+
+	static void BuildAxis(uint32_t in, uint32_t out, Axis* axis) {
+		axis->first.resize(out);
+		axis->count.resize(out);
+		axis->offsets.resize(out);
+		axis->weights.clear();
+		const double step = (double)in / (double)out;
+		for (uint32_t i = 0; i < out; ++i) {
+			axis->offsets[i] = axis->weights.size();
+			if (step > 1.0) {
+				const double a = i * step, b = a + step;
+				const uint32_t lo = (uint32_t)a, hi = std::min(in, (uint32_t)std::ceil(b));
+				axis->first[i] = lo;
+				axis->count[i] = hi - lo;
+				for (uint32_t k = lo; k < hi; ++k) {
+					const double cover = std::min(b, (double)k + 1) - std::max(a, (double)k);
+					axis->weights.push_back((uint32_t)std::lround(cover / step * 65536.0));
+				}
+			} else {
+				const double x = std::max(0.0, (i + 0.5) * step - 0.5);
+				const uint32_t lo = std::min(in - 1, (uint32_t)x);
+				const double f = lo + 1 < in ? x - lo : 0.0;
+				axis->first[i] = lo;
+				axis->count[i] = lo + 1 < in ? 2 : 1;
+				axis->weights.push_back((uint32_t)std::lround((1.0 - f) * 65536.0));
+				if (lo + 1 < in) axis->weights.push_back((uint32_t)std::lround(f * 65536.0));
+			}
+		}
+	}
+
+	bool Scale(const uint8_t* src, uint32_t w, uint32_t h, size_t stride, bool bgra, OcrImage* out, std::string*) {
+		// Gray first (BT.601, as RegionCapture's 'gray'), then the two passes
+		gray_.resize((size_t)w * h);
+		for (uint32_t y = 0; y < h; ++y) {
+			const uint8_t* s = src + (size_t)y * stride;
+			uint8_t* d = &gray_[(size_t)y * w];
+			if (!bgra) { std::copy(s, s + w, d); continue; }
+			for (uint32_t x = 0; x < w; ++x, s += 4) d[x] = (uint8_t)((29 * s[0] + 150 * s[1] + 77 * s[2]) >> 8);
+		}
+		if (out->width == w && out->height == h) {
+			out->pixels.assign(gray_.begin(), gray_.end());
+			return true;
+		}
+		BuildAxis(w, out->width, &xAxis_);
+		BuildAxis(h, out->height, &yAxis_);
+		rows_.resize((size_t)out->width * h);
+		for (uint32_t y = 0; y < h; ++y) {
+			const uint8_t* s = &gray_[(size_t)y * w];
+			uint8_t* d = &rows_[(size_t)y * out->width];
+			for (uint32_t x = 0; x < out->width; ++x) d[x] = Tap(xAxis_, x, [&](uint32_t k) { return s[k]; });
+		}
+		for (uint32_t y = 0; y < out->height; ++y) {
+			uint8_t* d = &out->pixels[(size_t)y * out->width];
+			for (uint32_t x = 0; x < out->width; ++x) d[x] = Tap(yAxis_, y, [&](uint32_t k) { return rows_[(size_t)k * out->width + x]; });
+		}
+		return true;
+	}
+
+	template <class At>
+	static uint8_t Tap(const Axis& axis, uint32_t i, At at) {
+		const uint32_t* weight = &axis.weights[axis.offsets[i]];
+		uint64_t sum = 0, total = 0;
+		for (uint32_t k = 0; k < axis.count[i]; ++k) {
+			sum += (uint64_t)at(axis.first[i] + k) * weight[k];
+			total += weight[k];
+		}
+		return (uint8_t)(total ? (sum + total / 2) / total : 0);
+	}
+
+	std::vector<uint8_t> gray_, rows_;
+	Axis xAxis_, yAxis_;
+#endif
+
+	static void Histogram(const OcrImage& image, uint32_t hist[256]) {
+		std::fill(hist, hist + 256, 0u);
+		for (uint8_t v : image.pixels) ++hist[v];
+	}
+
+	static void Stretch(OcrImage* image) {
+		uint32_t hist[256];
+		Histogram(*image, hist);
+		const size_t n = image->pixels.size(), clip = n / 100;
+		size_t seen = 0;
+		int lo = 0, hi = 255;
+		while (lo < 255 && (seen += hist[lo]) <= clip) ++lo;
+		seen = 0;
+		while (hi > 0 && (seen += hist[hi]) <= clip) --hi;
+		// A flat image (blank region) would only have its noise amplified
+		if (hi - lo < 16) return;
+		uint8_t lut[256];
+		for (int v = 0; v < 256; ++v) lut[v] = (uint8_t)std::clamp((v - lo) * 255 / (hi - lo), 0, 255);
+		for (uint8_t& v : image->pixels) v = lut[v];
+	}
+
+	static void Binarize(OcrImage* image) {
+		uint32_t hist[256];
+		Histogram(*image, hist);
+		// Otsu: the threshold maximising the between-class variance
+		const double n = (double)image->pixels.size();
+		double sumAll = 0.0;
+		for (int v = 0; v < 256; ++v) sumAll += (double)v * hist[v];
+		double sumBelow = 0.0, below = 0.0, best = -1.0;
+		int threshold = 128;
+		for (int t = 0; t < 256; ++t) {
+			below += hist[t];
+			if (below == 0.0) continue;
+			const double above = n - below;
+			if (above == 0.0) break;
+			sumBelow += (double)t * hist[t];
+			const double m0 = sumBelow / below, m1 = (sumAll - sumBelow) / above;
+			const double between = below * above * (m0 - m1) * (m0 - m1);
+			if (between > best) { best = between; threshold = t; }
+		}
+		// The larger class is the background; keep it white
+		double dark = 0.0;
+		for (int v = 0; v <= threshold; ++v) dark += hist[v];
+		const uint8_t low = dark > n / 2.0 ? 255 : 0;
+		for (uint8_t& v : image->pixels) v = v <= threshold ? low : (uint8_t)(255 - low);
+	}
+};
@@ -0,0 +1,210 @@
+#pragma once
+
+// Multi-frame voting over a watched region's OCR lines, so a live subtitle
+// that is half drawn, fading or misread for a frame doesn't reach the
+// translator as a string of its own. Each call hands in one recognition of
+// the region's lines; a line is followed from call to call by where it sits,
+// and its last few readings are clustered by edit distance (the similarity of
+// fuzzy_text_index.h: 1 - levenshtein / longer length). A line is stable once
+// one cluster holds enough of the readings, and it is reported only when that
+// cluster is not the one it was last reported from, so readings that wobble
+// within a cluster never come out twice.
+//
+// Calls may cover only part of the region (the bands whose pixels changed).
+// A line outside them is taken to read as it did last time; a line inside
+// them that no reading lands on counts a vote for "gone", and enough of those
+// in a row forget it.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "fuzzy_text_index.h"
+
+struct TextStabilizerConfig {
+	uint32_t window = 4;      // readings remembered per line
+	uint32_t minVotes = 2;    // of them that must agree before the line is stable
+	float similarity = 0.8f;  // for two readings to be one cluster
+	uint32_t maxMissed = 2;   // calls in a row without the line before it is forgotten
+};
+
+struct OcrLineBox {
+	std::u16string text;
+	float x = 0, y = 0, width = 0, height = 0;
+};
+
+// A horizontal band of the region a call has read, in the lines' units
+struct ObservedSpan {
+	float y = 0, height = 0;
+};
+
+struct StableLine {
+	uint32_t line; // stays with the line while it is followed
+	std::u16string text;
+	float x, y, width, height; // its latest reading's box
+};
+
+// Whether two readings are within the similarity threshold of each other
+inline bool SimilarReadings(const std::u16string& a, const std::u16string& b, double threshold) {
+	if (a == b) return true;
+	if (a.empty() || b.empty()) return false;
+	const size_t longer = std::max(a.size(), b.size());
+	const size_t budget = FuzzyEditBudget(longer, threshold);
+	return BoundedLevenshtein(a, b, budget) <= budget;
+}
+
+// JS thread only, one per watched region.
+class OcrTextStabilizer {
+public:
+	explicit OcrTextStabilizer(const TextStabilizerConfig& config = TextStabilizerConfig()) : config_(config) {
+		config_.window = std::max<uint32_t>(1, config_.window);
+		config_.minVotes = std::clamp<uint32_t>(config_.minVotes, 1, config_.window);
+	}
+
+	const TextStabilizerConfig& Config() const { return config_; }
+	size_t Lines() const { return tracks_.size(); }
+	void Reset() { tracks_.clear(); }
+
+	// One recognition; spans are the bands it covered, or null for all of the
+	// region. Returns the lines that became stable with new text.
+	std::vector<StableLine> Observe(const std::vector<OcrLineBox>& lines, const std::vector<ObservedSpan>* spans) {
+		for (Track& t : tracks_) t.matched = false;
+
+		// Pair readings with lines by overlap, best first, each at most once
+		struct Pair {
+			float overlap;
+			size_t reading, track;
+		};
+		std::vector<Pair> pairs;
+		for (size_t r = 0; r < lines.size(); ++r) {
+			if (lines[r].text.empty()) continue;
+			for (size_t t = 0; t < tracks_.size(); ++t) {
+				const float overlap = Overlap(lines[r], tracks_[t].last);
+				if (overlap >= 0.5f) pairs.push_back({ overlap, r, t });
+			}
+		}
+		std::stable_sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.overlap > b.overlap; });
+		std::vector<bool> placed(lines.size(), false);
+		for (const Pair& p : pairs) {
+			Track& t = tracks_[p.track];
+			if (placed[p.reading] || t.matched) continue;
+			placed[p.reading] = true;
+			t.matched = true;
+			t.missed = 0;
+			t.last = lines[p.reading];
+			Push(t, lines[p.reading].text);
+		}
+
+		// Unmatched lines read as before outside the spans and as gone inside
+		for (Track& t : tracks_) {
+			if (t.matched) continue;
+			if (spans && !Inside(t.last, *spans)) {
+				Push(t, t.last.text);
+				continue;
+			}
+			++t.missed;
+			Push(t, std::u16string());
+		}
+		tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(),
+			[this](const Track& t) { return !t.matched && t.missed > config_.maxMissed; }), tracks_.end());
+
+		for (size_t r = 0; r < lines.size(); ++r) {
+			if (placed[r] || lines[r].text.empty()) continue;
+			Track t;
+			t.id = nextId_++;
+			t.last = lines[r];
+			t.matched = true;
+			Push(t, lines[r].text);
+			tracks_.push_back(std::move(t));
+		}
+
+		std::vector<StableLine> out;
+		for (Track& t : tracks_) {
+			std::u16string text;
+			if (!Vote(t, &text)) continue;
+			if (text.empty()) {
+				t.emitted.clear(); // gone for good: the same text coming back is news
+				continue;
+			}
+			if (!t.emitted.empty() && SimilarReadings(text, t.emitted, config_.similarity)) continue;
+			t.emitted = text;
+			out.push_back({ t.id, text, t.last.x, t.last.y, t.last.width, t.last.height });
+		}
+		std::sort(out.begin(), out.end(), [](const StableLine& a, const StableLine& b) { return a.y != b.y ? a.y < b.y : a.x < b.x; });
+		return out;
+	}
+
+private:
+	struct Track {
+		uint32_t id = 0;
+		std::deque<std::u16string> history; // newest last; empty for "not there"
+		OcrLineBox last;
+		std::u16string emitted;
+		uint32_t missed = 0;
+		bool matched = false;
+	};
+
+	// Vertical overlap over the shorter box, when the boxes also share columns
+	static float Overlap(const OcrLineBox& a, const OcrLineBox& b) {
+		const float w = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+		const float h = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+		const float shorter = std::min(a.height, b.height);
+		if (w <= 0 || h <= 0 || shorter <= 0) return 0;
+		return h / shorter;
+	}
+
+	static bool Inside(const OcrLineBox& box, const std::vector<ObservedSpan>& spans) {
+		const float mid = box.y + box.height * 0.5f;
+		for (const ObservedSpan& s : spans) {
+			if (mid >= s.y && mid < s.y + s.height) return true;
+		}
+		return false;
+	}
+
+	void Push(Track& t, const std::u16string& text) {
+		t.history.push_back(text);
+		while (t.history.size() > config_.window) t.history.pop_front();
+	}
+
+	// The cluster with the most readings (the newest on a tie), when it has
+	// enough; *text is its most frequent exact reading, newest on a tie.
+	bool Vote(const Track& t, std::u16string* text) const {
+		const size_t n = t.history.size();
+		size_t bestVotes = 0, best = 0;
+		std::vector<uint8_t> agree(n * n, 0);
+		for (size_t i = 0; i < n; ++i) {
+			agree[i * n + i] = 1;
+			for (size_t j = i + 1; j < n; ++j) {
+				agree[i * n + j] = agree[j * n + i] = SimilarReadings(t.history[i], t.history[j], config_.similarity) ? 1 : 0;
+			}
+		}
+		for (size_t i = 0; i < n; ++i) {
+			size_t votes = 0;
+			for (size_t j = 0; j < n; ++j) votes += agree[i * n + j];
+			if (votes >= bestVotes) {
+				bestVotes = votes;
+				best = i;
+			}
+		}
+		if (bestVotes < config_.minVotes) return false;
+		size_t modeCount = 0, mode = best;
+		for (size_t i = 0; i < n; ++i) {
+			if (!agree[best * n + i]) continue;
+			size_t count = 0;
+			for (size_t j = 0; j < n; ++j) count += agree[best * n + j] && t.history[j] == t.history[i];
+			if (count >= modeCount) {
+				modeCount = count;
+				mode = i;
+			}
+		}
+		*text = t.history[mode];
+		return true;
+	}
+
+	TextStabilizerConfig config_;
+	std::vector<Track> tracks_;
+	uint32_t nextId_ = 1;
+};
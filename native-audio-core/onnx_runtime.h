@@ -0,0 +1,14 @@
+#pragma once
+
+// The process's one ONNX Runtime environment, shared by the engines built on
+// it (paddle_ocr_engine.h, piper_tts_engine.h) when the addon is built with
+// use_onnxruntime=1 (AUDIO_CORE_ONNXRUNTIME).
+
+#if defined(AUDIO_CORE_ONNXRUNTIME)
+#include <onnxruntime_cxx_api.h>
+
+inline Ort::Env& OnnxRuntimeEnv() {
+	static Ort::Env env(ORT_LOGGING_LEVEL_WARNING, "audio-core");
+	return env;
+}
+#endif
@@ -0,0 +1,275 @@
+#pragma once
+
+// Ogg-Opus encoding of utterance chunks for upload (RFC 7845). encodeOpus(wav,
+// { bitrate, complexity }) takes the 16 kHz pcm16 WAV of a chunk event and
+// resolves with an Ogg-Opus file, encoded on the task pool: speech-
+// tuned (VOIP application, voice signal hint), VBR, 20 ms frames, about a
+// tenth of the WAV's bytes at 24 kbps. With { uploadBudgetMs } instead of a
+// bitrate, the chunk's bitrate and complexity follow the measured upload
+// throughput (upload_rate.h). Built with gyp variable use_opus=1
+// (AUDIO_CORE_OPUS, links libopus); otherwise encodeOpus() rejects and
+// callers keep uploading WAV.
+
+#include <napi.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "async_query.h"
+#include "capture_options.h"
+#include "upload_rate.h"
+#include "wav_reader.h"
+
+#if defined(AUDIO_CORE_OPUS)
+#include <opus.h>
+#endif
+
+struct OpusChunkConfig {
+	uint32_t bitrate = 24000;
+	uint32_t complexity = 5; // 0..10
+};
+
+// Ogg page writer for a single logical stream.
+class OggStreamWriter {
+public:
+	explicit OggStreamWriter(std::vector<uint8_t>* out, uint32_t serial) : out_(out), serial_(serial) {}
+
+	// Starts a new logical stream into the same output, keeping the buffers.
+	void Reset(uint32_t serial) {
+		serial_ = serial;
+		sequence_ = 0;
+		segments_ = 0;
+		body_.clear();
+		granule_ = 0;
+	}
+
+	// Packets are buffered into the open page; granule is the stream position
+	// (48 kHz samples) after the packet.
+	void Packet(const uint8_t* data, size_t size, int64_t granule) {
+		if (segments_ + size / 255 + 1 > 255) Flush(false);
+		for (size_t left = size;; left -= 255) {
+			lacing_[segments_++] = (uint8_t)(left < 255 ? left : 255);
+			if (left < 255) break;
+		}
+		body_.insert(body_.end(), data, data + size);
+		granule_ = granule;
+	}
+
+	// Ends the open page; each header packet gets a page of its own.
+	void Flush(bool last) {
+		if (segments_ == 0 && !last) return;
+		const size_t start = out_->size();
+		uint8_t header[27] = { 'O', 'g', 'g', 'S', 0 };
+		header[5] = (uint8_t)((sequence_ == 0 ? 0x02 : 0) | (last ? 0x04 : 0));
+		Put64(header + 6, (uint64_t)granule_);
+		Put32(header + 14, serial_);
+		Put32(header + 18, sequence_++);
+		header[26] = (uint8_t)segments_;
+		out_->insert(out_->end(), header, header + sizeof(header));
+		out_->insert(out_->end(), lacing_, lacing_ + segments_);
+		out_->insert(out_->end(), body_.begin(), body_.end());
+		Put32(out_->data() + start + 22, Crc(out_->data() + start, out_->size() - start));
+		segments_ = 0;
+		body_.clear();
+	}
+
+	static void Put16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+	static void Put32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; ++i) p[i] = (uint8_t)(v >> (8 * i)); }
+	static void Put64(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; ++i) p[i] = (uint8_t)(v >> (8 * i)); }
+
+private:
+	// CRC-32, polynomial 0x04c11db7, unreflected, as the Ogg spec has it.
+	static uint32_t Crc(const uint8_t* p, size_t n) {
+		static const std::vector<uint32_t> table = [] {
+			std::vector<uint32_t> t(256);
+			for (uint32_t i = 0; i < 256; ++i) {
+				uint32_t r = i << 24;
+				for (int k = 0; k < 8; ++k) r = (r & 0x80000000u) ? (r << 1) ^ 0x04c11db7u : r << 1;
+				t[i] = r;
+			}
+			return t;
+		}();
+		uint32_t crc = 0;
+		for (size_t i = 0; i < n; ++i) crc = (crc << 8) ^ table[((crc >> 24) ^ p[i]) & 0xff];
+		return crc;
+	}
+
+	std::vector<uint8_t>* out_;
+	uint32_t serial_;
+	uint32_t sequence_ = 0;
+	uint8_t lacing_[255] = {};
+	size_t segments_ = 0;
+	std::vector<uint8_t> body_;
+	int64_t granule_ = 0;
+};
+
+// OpusHead and OpusTags, a page each, for a mono stream at rate.
+inline void WriteOpusHeaders(OggStreamWriter* ogg, uint32_t rate, uint16_t preSkip) {
+	uint8_t head[19] = { 'O', 'p', 'u', 's', 'H', 'e', 'a', 'd', 1, 1 };
+	OggStreamWriter::Put16(head + 10, preSkip);
+	OggStreamWriter::Put32(head + 12, rate);
+	ogg->Packet(head, sizeof(head), 0); // output gain 0, mapping family 0
+	ogg->Flush(false);
+	static const char kVendor[] = "whispra";
+	uint8_t tags[8 + 4 + sizeof(kVendor) - 1 + 4] = { 'O', 'p', 'u', 's', 'T', 'a', 'g', 's' };
+	OggStreamWriter::Put32(tags + 8, (uint32_t)(sizeof(kVendor) - 1));
+	memcpy(tags + 12, kVendor, sizeof(kVendor) - 1);
+	ogg->Packet(tags, sizeof(tags), 0); // no user comments
+	ogg->Flush(false);
+}
+
+#if defined(AUDIO_CORE_OPUS)
+
+// Encodes pcm16 mono at rate (8/12/16/24/48 kHz) into an Ogg-Opus file.
+inline bool EncodeOggOpus(const int16_t* pcm, size_t samples, uint32_t rate, const OpusChunkConfig& config,
+                          std::vector<uint8_t>* out, std::string* error) {
+	int err = OPUS_OK;
+	OpusEncoder* enc = opus_encoder_create((opus_int32)rate, 1, OPUS_APPLICATION_VOIP, &err);
+	if (err != OPUS_OK || !enc) {
+		*error = std::string("opus_encoder_create failed: ") + opus_strerror(err);
+		return false;
+	}
+	opus_encoder_ctl(enc, OPUS_SET_BITRATE((opus_int32)config.bitrate));
+	opus_encoder_ctl(enc, OPUS_SET_VBR(1));
+	opus_encoder_ctl(enc, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+	opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY((opus_int32)config.complexity));
+	opus_int32 lookahead = 0;
+	opus_encoder_ctl(enc, OPUS_GET_LOOKAHEAD(&lookahead));
+
+	// Granule positions count 48 kHz samples whatever the input rate
+	const uint32_t scale = 48000 / rate;
+	const uint16_t preSkip = (uint16_t)(lookahead * scale);
+	const size_t frame = rate / 50;
+	const int64_t end = (int64_t)preSkip + (int64_t)samples * scale;
+
+	out->clear();
+	out->reserve(samples / 8 + 1024);
+	OggStreamWriter ogg(out, 0x57487370u);
+	WriteOpusHeaders(&ogg, rate, preSkip);
+
+	// Zero-pad past the end so the encoder's lookahead drains
+	std::vector<int16_t> block(frame);
+	uint8_t packet[1275];
+	const size_t total = samples + (size_t)lookahead;
+	int64_t granule = 0;
+	size_t pagePackets = 0;
+	for (size_t at = 0; at < total; at += frame) {
+		const size_t have = at < samples ? (samples - at < frame ? samples - at : frame) : 0;
+		if (have > 0) memcpy(block.data(), pcm + at, have * sizeof(int16_t));
+		if (have < frame) memset(block.data() + have, 0, (frame - have) * sizeof(int16_t));
+		const opus_int32 bytes = opus_encode(enc, block.data(), (int)frame, packet, (opus_int32)sizeof(packet));
+		if (bytes < 0) {
+			opus_encoder_destroy(enc);
+			*error = std::string("opus_encode failed: ") + opus_strerror(bytes);
+			return false;
+		}
+		granule += (int64_t)frame * scale;
+		const bool last = at + frame >= total;
+		ogg.Packet(packet, (size_t)bytes, last && granule > end ? end : granule); // the final granule trims the padding
+		if (++pagePackets == 50 && !last) { // one page per second
+			ogg.Flush(false);
+			pagePackets = 0;
+		}
+	}
+	ogg.Flush(true);
+	opus_encoder_destroy(enc);
+	return true;
+}
+
+#endif
+
+// Option uploadBudgetMs of an Opus encode (0 = not given); it stands in for
+// option 'bitrate', and complexity, when given, still wins over the pick.
+inline bool ReadUploadBudget(const Napi::Object& obj, uint32_t* budgetMs, std::string* error) {
+	if (!ReadUint32Option(obj, "uploadBudgetMs", 100, 60000, budgetMs, error)) return false;
+	if (*budgetMs && obj.Has("bitrate") && !obj.Get("bitrate").IsUndefined()) {
+		*error = "Options 'bitrate' and 'uploadBudgetMs' exclude each other";
+		return false;
+	}
+	return true;
+}
+
+// Applies the pick for a chunk of audioMs to config.
+inline void PickUploadRate(Napi::Env env, const Napi::Object& obj, double audioMs, uint32_t budgetMs, OpusChunkConfig* config) {
+	const UploadRateController::Choice choice = UploadRate(env).Pick(audioMs, budgetMs);
+	config->bitrate = choice.bitrate;
+	if (!obj.Has("complexity") || obj.Get("complexity").IsUndefined()) config->complexity = choice.complexity;
+}
+
+// The encoded file, with the picked bitrate and complexity when there was a budget.
+inline Napi::Value OpusUploadToJs(Napi::Env env, const std::vector<uint8_t>& bytes, bool picked, const OpusChunkConfig& config) {
+	Napi::Buffer<uint8_t> out = Napi::Buffer<uint8_t>::Copy(env, bytes.data(), bytes.size());
+	if (picked) {
+		out.Set("bitrate", Napi::Number::New(env, config.bitrate));
+		out.Set("complexity", Napi::Number::New(env, config.complexity));
+	}
+	return out;
+}
+
+// encodeOpus(wav: Buffer, options?: { bitrate?, complexity?, uploadBudgetMs? }) -> Promise<Buffer>
+inline Napi::Value EncodeOpus(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsBuffer()) {
+		Napi::TypeError::New(env, "WAV buffer required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	OpusChunkConfig config;
+	Napi::Buffer<uint8_t> wav = info[0].As<Napi::Buffer<uint8_t>>();
+	bool picked = false;
+	if (info.Length() > 1 && !info[1].IsUndefined()) {
+		if (!info[1].IsObject()) {
+			Napi::TypeError::New(env, "Opus options must be an object").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		Napi::Object obj = info[1].As<Napi::Object>();
+		std::string error;
+		uint32_t budgetMs = 0;
+		if (!ReadUint32Option(obj, "bitrate", 6000, 128000, &config.bitrate, &error) ||
+		    !ReadUint32Option(obj, "complexity", 0, 10, &config.complexity, &error) ||
+		    !ReadUploadBudget(obj, &budgetMs, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		// Not a WAV: no pick, and the encode rejects
+		const uint8_t* samples = nullptr;
+		size_t count = 0;
+		uint32_t rate = 0;
+		if (budgetMs && FindWavPcm16(wav.Data(), wav.Length(), &samples, &count, &rate, &error) && rate > 0) {
+			PickUploadRate(env, obj, (double)count * 1000.0 / rate, budgetMs, &config);
+			picked = true;
+		}
+	}
+	// Copied so JS may reuse or release the buffer (pooled chunk slots) right away
+	std::vector<uint8_t> input(wav.Data(), wav.Data() + wav.Length());
+
+	struct Encoded {
+		std::vector<uint8_t> bytes;
+		std::string error;
+	};
+	return QueueQuery(env, "EncodeOpus",
+		[input = std::move(input), config]() {
+			Encoded result;
+			std::vector<int16_t> pcm;
+			uint32_t rate = 0;
+			if (!ReadWavPcm16(input, &pcm, &rate, &result.error)) return result;
+#if defined(AUDIO_CORE_OPUS)
+			if (rate != 8000 && rate != 12000 && rate != 16000 && rate != 24000 && rate != 48000) {
+				result.error = "Opus needs 8, 12, 16, 24 or 48 kHz input";
+				return result;
+			}
+			EncodeOggOpus(pcm.data(), pcm.size(), rate, config, &result.bytes, &result.error);
+#else
+			result.error = "Opus encoding is not built in (use_opus=0)";
+#endif
+			return result;
+		},
+		[picked, config](Napi::Env env, Encoded& result) -> Napi::Value {
+			if (!result.error.empty()) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			return OpusUploadToJs(env, result.bytes, picked, config);
+		}, TaskPriority::Background);
+}
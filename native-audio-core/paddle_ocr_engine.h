@@ -0,0 +1,668 @@
+#pragma once
+
+// In-process PaddleOCR: the PP-OCR detection, angle-classification and
+// recognition models exported to ONNX (paddle2onnx) run through ONNX Runtime
+// on the GPU where there is one, instead of PaddleOCR in a Python process
+// with a pip-installed CUDA stack and an IPC round trip per frame. Built with
+// gyp variable use_onnxruntime=1 (AUDIO_CORE_ONNXRUNTIME, links
+// onnxruntime; onnxruntime.dll and DirectML.dll, or libonnxruntime.dylib,
+// ship next to the addon); otherwise every call rejects and callers keep the
+// Python service.
+//
+//   loadPaddleOcr({ det, rec, dict, cls?, device?, threads?, space? })
+//     -> Promise<{ provider, loadMs }>
+//   recognizePaddleOcr(images[], { limitSideLen?, boxThreshold?, unclipRatio?, dropScore?, cls? })
+//     -> Promise<{ results: [{ text, boxes: [{ text, confidence, x, y, width, height }] }], processingMs }>
+//   unloadPaddleOcr() -> Promise<void>
+//
+// device 'auto' (default) takes DirectML on Windows and Core ML on macOS and
+// falls back to the CPU when the provider is missing or refuses the model;
+// 'cpu' skips it; provider names the one in use. images are frames as the
+// region grabber returns them ({ data, width, height, stride?, format? },
+// 'bgra' or 'gray'), read in place. One call's images are one detection
+// batch (padded to the largest) and all their text lines are classified and
+// recognised together in batches of kBatch, so several watch boxes cost one
+// pass of each model. Sessions run one batch at a time: DirectML does not
+// take concurrent Run() calls on a session, and the GPU serialises them
+// anyway.
+//
+// Pre- and post-processing follow PaddleOCR's defaults: detection input
+// resized so the longer side is at most limitSideLen (960) and both sides
+// multiples of 32, ImageNet-normalised BGR; the DB probability map binarised
+// at 0.3, each region kept when its mean probability reaches boxThreshold
+// (0.6) and grown by unclipRatio (1.5); recognition input 48 pixels high,
+// (x / 255 - 0.5) / 0.5, CTC-decoded against the dictionary file (one
+// character per line, a space appended unless space is false), lines under
+// dropScore (0.5) dropped. Boxes are axis-aligned, which fits screen text;
+// the classifier (when cls is loaded) turns upside-down lines around.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "addon_log.h"
+#include "async_query.h"
+#include "capture_options.h"
+#include "mapped_file.h"
+#include "onnx_runtime.h"
+
+#if defined(AUDIO_CORE_ONNXRUNTIME)
+#if defined(_WIN32)
+#include <dml_provider_factory.h>
+#elif defined(__APPLE__)
+#include <coreml_provider_factory.h>
+#endif
+#endif
+
+// A frame read in place: height rows of stride bytes, BGRA or gray8.
+struct PaddleImage {
+	const uint8_t* pixels = nullptr;
+	uint32_t width = 0, height = 0, stride = 0;
+	bool bgra = true;
+};
+
+// A detected text box in source pixels.
+struct PaddleBox {
+	uint32_t image = 0;
+	float x = 0, y = 0, width = 0, height = 0;
+	bool flip = false; // the classifier found it upside down
+};
+
+struct PaddleLine {
+	std::string text;
+	float confidence = 0.0f;
+	float x = 0, y = 0, width = 0, height = 0;
+};
+
+struct PaddleOcrConfig {
+	uint32_t limitSideLen = 960;
+	float binaryThreshold = 0.3f;
+	float boxThreshold = 0.6f;
+	float unclipRatio = 1.5f;
+	float dropScore = 0.5f;
+	bool cls = true; // when a classifier is loaded
+};
+
+constexpr uint32_t kPaddleRecHeight = 48;
+constexpr uint32_t kPaddleRecMinWidth = 320; // PP-OCRv3/v4 rec_image_shape 3,48,320
+constexpr uint32_t kPaddleRecMaxWidth = 3200;
+constexpr uint32_t kPaddleClsWidth = 192;    // cls_image_shape 3,48,192
+
+// Bilinear BGR sample at (fx, fy), clamped to the image.
+inline void SamplePaddleBgr(const PaddleImage& img, float fx, float fy, float out[3]) {
+	fx = std::min(std::max(fx, 0.0f), (float)(img.width - 1));
+	fy = std::min(std::max(fy, 0.0f), (float)(img.height - 1));
+	const uint32_t x0 = (uint32_t)fx, y0 = (uint32_t)fy;
+	const uint32_t x1 = std::min(x0 + 1, img.width - 1), y1 = std::min(y0 + 1, img.height - 1);
+	const float ax = fx - (float)x0, ay = fy - (float)y0;
+	const uint32_t bpp = img.bgra ? 4 : 1;
+	const uint8_t* r0 = img.pixels + (size_t)y0 * img.stride;
+	const uint8_t* r1 = img.pixels + (size_t)y1 * img.stride;
+	for (uint32_t c = 0; c < 3; ++c) {
+		const uint32_t o = img.bgra ? c : 0;
+		const float top = r0[x0 * bpp + o] + (r0[x1 * bpp + o] - r0[x0 * bpp + o]) * ax;
+		const float bottom = r1[x0 * bpp + o] + (r1[x1 * bpp + o] - r1[x0 * bpp + o]) * ax;
+		out[c] = top + (bottom - top) * ay;
+	}
+}
+
+// PaddleOCR's DetResizeForTest (limit_type 'max'): at most limit on the
+// longer side, both sides rounded to multiples of 32.
+inline void PaddleDetSize(uint32_t width, uint32_t height, uint32_t limit, uint32_t* outWidth, uint32_t* outHeight) {
+	const float ratio = std::max(width, height) > limit ? (float)limit / (float)std::max(width, height) : 1.0f;
+	*outWidth = std::max(32u, (uint32_t)std::lround(width * ratio / 32.0f) * 32);
+	*outHeight = std::max(32u, (uint32_t)std::lround(height * ratio / 32.0f) * 32);
+}
+
+// Writes img resized to width x height into a 3 x batchHeight x batchWidth
+// plane set, ImageNet-normalised; the padding is left as it is (zeros).
+inline void PaddleDetInput(const PaddleImage& img, uint32_t width, uint32_t height, uint32_t batchWidth, uint32_t batchHeight,
+                           float* chw) {
+	static const float kMean[3] = { 0.485f, 0.456f, 0.406f };
+	static const float kStd[3] = { 0.229f, 0.224f, 0.225f };
+	const size_t plane = (size_t)batchWidth * batchHeight;
+	const float sx = (float)img.width / (float)width, sy = (float)img.height / (float)height;
+	float bgr[3];
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			SamplePaddleBgr(img, (x + 0.5f) * sx - 0.5f, (y + 0.5f) * sy - 0.5f, bgr);
+			for (uint32_t c = 0; c < 3; ++c) chw[c * plane + (size_t)y * batchWidth + x] = (bgr[c] / 255.0f - kMean[c]) / kStd[c];
+		}
+	}
+}
+
+// DB post-processing of one image's probability map (rows of mapStride
+// floats, the image's own width x height of them): connected regions above
+// the binary threshold whose bounding box averages boxThreshold, grown by
+// area * unclipRatio / perimeter on every side and scaled to source pixels.
+inline void PaddleDetBoxes(const float* prob, uint32_t mapStride, uint32_t width, uint32_t height, const PaddleImage& img,
+                           uint32_t image, const PaddleOcrConfig& config, std::vector<PaddleBox>* boxes) {
+	std::vector<uint8_t> seen((size_t)width * height, 0);
+	std::vector<uint32_t> stack;
+	const float sx = (float)img.width / (float)width, sy = (float)img.height / (float)height;
+	for (uint32_t y0 = 0; y0 < height; ++y0) {
+		for (uint32_t x0 = 0; x0 < width; ++x0) {
+			if (seen[(size_t)y0 * width + x0] || prob[(size_t)y0 * mapStride + x0] <= config.binaryThreshold) continue;
+			uint32_t minX = x0, maxX = x0, minY = y0, maxY = y0;
+			seen[(size_t)y0 * width + x0] = 1;
+			stack.assign(1, y0 * width + x0);
+			while (!stack.empty()) {
+				const uint32_t p = stack.back();
+				stack.pop_back();
+				const uint32_t x = p % width, y = p / width;
+				minX = std::min(minX, x), maxX = std::max(maxX, x);
+				minY = std::min(minY, y), maxY = std::max(maxY, y);
+				for (int dy = -1; dy <= 1; ++dy) {
+					for (int dx = -1; dx <= 1; ++dx) {
+						const int nx = (int)x + dx, ny = (int)y + dy;
+						if (nx < 0 || ny < 0 || nx >= (int)width || ny >= (int)height) continue;
+						const size_t q = (size_t)ny * width + nx;
+						if (seen[q] || prob[(size_t)ny * mapStride + nx] <= config.binaryThreshold) continue;
+						seen[q] = 1;
+						stack.push_back((uint32_t)q);
+					}
+				}
+			}
+			const float w = (float)(maxX - minX + 1), h = (float)(maxY - minY + 1);
+			if (std::min(w, h) < 3.0f) continue;
+			double sum = 0.0;
+			for (uint32_t y = minY; y <= maxY; ++y) {
+				for (uint32_t x = minX; x <= maxX; ++x) sum += prob[(size_t)y * mapStride + x];
+			}
+			if (sum / (w * h) < config.boxThreshold) continue;
+			const float grow = w * h * config.unclipRatio / (2.0f * (w + h));
+			if (std::min(w, h) + 2.0f * grow < 5.0f) continue;
+			const float left = std::max(0.0f, ((float)minX - grow) * sx);
+			const float top = std::max(0.0f, ((float)minY - grow) * sy);
+			const float right = std::min((float)img.width, ((float)maxX + 1.0f + grow) * sx);
+			const float bottom = std::min((float)img.height, ((float)maxY + 1.0f + grow) * sy);
+			if (right - left < 1.0f || bottom - top < 1.0f) continue;
+			PaddleBox box;
+			box.image = image;
+			box.x = left;
+			box.y = top;
+			box.width = right - left;
+			box.height = bottom - top;
+			boxes->push_back(box);
+		}
+	}
+}
+
+// Width a box is resized to at kPaddleRecHeight rows.
+inline uint32_t PaddleLineWidth(const PaddleBox& box) {
+	const float w = std::ceil(kPaddleRecHeight * box.width / std::max(box.height, 1.0f));
+	return std::min(std::max(1u, (uint32_t)w), kPaddleRecMaxWidth);
+}
+
+// Writes box resized to kPaddleRecHeight x min(its width, batchWidth) into a
+// 3 x kPaddleRecHeight x batchWidth plane set, (x / 255 - 0.5) / 0.5; the
+// right padding stays zero. flip samples it turned 180 degrees.
+inline void PaddleLineInput(const PaddleImage& img, const PaddleBox& box, uint32_t batchWidth, bool flip, float* chw) {
+	const uint32_t width = std::min(PaddleLineWidth(box), batchWidth);
+	const size_t plane = (size_t)batchWidth * kPaddleRecHeight;
+	const float sx = box.width / (float)width, sy = box.height / (float)kPaddleRecHeight;
+	float bgr[3];
+	for (uint32_t y = 0; y < kPaddleRecHeight; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			const uint32_t ox = flip ? width - 1 - x : x, oy = flip ? kPaddleRecHeight - 1 - y : y;
+			SamplePaddleBgr(img, box.x + (ox + 0.5f) * sx - 0.5f, box.y + (oy + 0.5f) * sy - 0.5f, bgr);
+			for (uint32_t c = 0; c < 3; ++c) chw[c * plane + (size_t)y * batchWidth + x] = (bgr[c] / 255.0f - 0.5f) / 0.5f;
+		}
+	}
+}
+
+// CTC greedy decode of steps x classes probabilities: the best class per
+// step, repeats collapsed, blank (0) dropped; class i is dict[i - 1].
+// score: the mean probability of the characters kept.
+inline void PaddleCtcDecode(const float* probs, uint32_t steps, uint32_t classes, const std::vector<std::string>& dict,
+                            std::string* text, float* score) {
+	text->clear();
+	double sum = 0.0;
+	uint32_t kept = 0, previous = 0;
+	for (uint32_t t = 0; t < steps; ++t) {
+		const float* row = probs + (size_t)t * classes;
+		const uint32_t best = (uint32_t)(std::max_element(row, row + classes) - row);
+		if (best != 0 && best != previous && best - 1 < dict.size()) {
+			*text += dict[best - 1];
+			sum += row[best];
+			++kept;
+		}
+		previous = best;
+	}
+	*score = kept ? (float)(sum / kept) : 0.0f;
+}
+
+// Reading order, as PaddleOCR's sorted_boxes: top to bottom, left to right
+// within 10 pixels of the same line.
+inline void SortPaddleLines(std::vector<PaddleLine>* lines) {
+	std::stable_sort(lines->begin(), lines->end(), [](const PaddleLine& a, const PaddleLine& b) {
+		if (std::fabs(a.y - b.y) < 10.0f) return a.x < b.x;
+		return a.y < b.y;
+	});
+}
+
+// The dictionary file's lines; empty with *error set when it cannot be read.
+inline std::vector<std::string> ReadPaddleDict(const std::string& path, bool space, std::string* error) {
+	std::vector<std::string> dict;
+	MappedFile file;
+	if (!file.Open(path, error)) return dict;
+	const char* p = reinterpret_cast<const char*>(file.Data());
+	const char* end = p + file.Size();
+	while (p < end) {
+		const char* eol = std::find(p, end, '\n');
+		const char* stop = eol > p && eol[-1] == '\r' ? eol - 1 : eol;
+		dict.emplace_back(p, stop);
+		p = eol < end ? eol + 1 : end;
+	}
+	if (space) dict.push_back(" ");
+	if (dict.empty()) *error = "empty dictionary " + path;
+	return dict;
+}
+
+struct PaddleOcrModels {
+	std::string det, rec, cls, dict;
+	bool space = true;
+	bool gpu = true; // device 'auto'
+	uint32_t threads = 0; // CPU intra-op threads; 0 = half the cores
+};
+
+class PaddleOcrEngine {
+public:
+	static constexpr uint32_t kBatch = 16; // lines per classifier/recogniser run
+
+#if defined(AUDIO_CORE_ONNXRUNTIME)
+	bool Load(const PaddleOcrModels& models, std::string* provider, double* loadMs, std::string* error) {
+		const auto start = std::chrono::steady_clock::now();
+		auto set = std::make_shared<Loaded>();
+		set->dict = ReadPaddleDict(models.dict, models.space, error);
+		if (set->dict.empty()) return false;
+		try {
+			Ort::Env& env = OnnxRuntimeEnv();
+			const uint32_t hw = std::thread::hardware_concurrency();
+			const uint32_t threads = models.threads ? models.threads : std::max(1u, hw / 2);
+			set->provider = "CPU";
+			bool gpu = models.gpu;
+			for (int attempt = 0; attempt < 2; ++attempt) {
+				try {
+					set->det = Open(env, models.det, threads, gpu);
+					set->rec = Open(env, models.rec, threads, gpu);
+					if (!models.cls.empty()) set->cls = Open(env, models.cls, threads, gpu);
+					break;
+				} catch (const Ort::Exception& e) {
+					// The provider refused the model (or isn't there): the CPU takes it
+					if (!gpu) throw;
+					AddonLog(LogLevel::Warn, "PaddleOCR GPU provider failed (%s), using the CPU", e.what());
+					gpu = false;
+				}
+			}
+			if (gpu) set->provider = kGpuProvider;
+		} catch (const Ort::Exception& e) {
+			*error = std::string("could not load PaddleOCR models: ") + e.what();
+			return false;
+		}
+		*provider = set->provider;
+		*loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			loaded_ = std::move(set);
+		}
+		AddonLog(LogLevel::Info, "PaddleOCR loaded in %.0f ms on %s", *loadMs, provider->c_str());
+		return true;
+	}
+
+	// Threadpool thread; one batch at a time per loaded set.
+	bool Recognize(const std::vector<PaddleImage>& images, const PaddleOcrConfig& config,
+	               std::vector<std::vector<PaddleLine>>* lines, std::string* error) {
+		std::shared_ptr<Loaded> set;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			set = loaded_;
+		}
+		if (!set) {
+			*error = "no PaddleOCR models loaded";
+			return false;
+		}
+		lines->assign(images.size(), {});
+		std::lock_guard<std::mutex> run(set->run);
+		try {
+			std::vector<PaddleBox> boxes;
+			Detect(*set, images, config, &boxes);
+			if (set->cls.session && config.cls) Classify(*set, images, &boxes);
+			Read(*set, images, boxes, config, lines);
+		} catch (const Ort::Exception& e) {
+			*error = std::string("PaddleOCR failed: ") + e.what();
+			return false;
+		}
+		for (auto& l : *lines) SortPaddleLines(&l);
+		return true;
+	}
+
+	// Recognitions in flight finish on the set they started with.
+	void Unload() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		loaded_ = nullptr;
+	}
+
+private:
+#if defined(_WIN32)
+	static constexpr const char* kGpuProvider = "DirectML";
+#elif defined(__APPLE__)
+	static constexpr const char* kGpuProvider = "CoreML";
+#else
+	static constexpr const char* kGpuProvider = "CPU";
+#endif
+
+	struct Session {
+		std::unique_ptr<Ort::Session> session;
+		std::string input, output;
+	};
+
+	struct Loaded {
+		Session det, rec, cls;
+		std::vector<std::string> dict;
+		std::string provider;
+		std::mutex run;
+	};
+
+	static Session Open(Ort::Env& env, const std::string& path, uint32_t threads, bool gpu) {
+		Ort::SessionOptions options;
+		options.SetIntraOpNumThreads((int)threads);
+		options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+#if defined(_WIN32)
+		if (gpu) {
+			options.DisableMemPattern(); // DirectML's requirements
+			options.SetExecutionMode(ExecutionMode::ORT_SEQUENTIAL);
+			Ort::ThrowOnError(OrtSessionOptionsAppendExecutionProvider_DML(options, 0));
+		}
+		Session s{ std::make_unique<Ort::Session>(env, WidenUtf8(path).c_str(), options), {}, {} };
+#else
+#if defined(__APPLE__)
+		if (gpu) Ort::ThrowOnError(OrtSessionOptionsAppendExecutionProvider_CoreML(options, 0));
+#else
+		(void)gpu;
+#endif
+		Session s{ std::make_unique<Ort::Session>(env, path.c_str(), options), {}, {} };
+#endif
+		Ort::AllocatorWithDefaultOptions allocator;
+		s.input = s.session->GetInputNameAllocated(0, allocator).get();
+		s.output = s.session->GetOutputNameAllocated(0, allocator).get();
+		return s;
+	}
+
+	static std::vector<Ort::Value> Run(Session& s, std::vector<float>& input, const std::vector<int64_t>& shape) {
+		const Ort::MemoryInfo memory = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+		Ort::Value tensor = Ort::Value::CreateTensor<float>(memory, input.data(), input.size(), shape.data(), shape.size());
+		const char* in = s.input.c_str();
+		const char* out = s.output.c_str();
+		return s.session->Run(Ort::RunOptions{ nullptr }, &in, &tensor, 1, &out, 1);
+	}
+
+	// Every image in one batch, padded to the largest resized one.
+	void Detect(Loaded& set, const std::vector<PaddleImage>& images, const PaddleOcrConfig& config, std::vector<PaddleBox>* boxes) {
+		std::vector<uint32_t> widths(images.size()), heights(images.size());
+		uint32_t batchWidth = 0, batchHeight = 0;
+		for (size_t i = 0; i < images.size(); ++i) {
+			PaddleDetSize(images[i].width, images[i].height, config.limitSideLen, &widths[i], &heights[i]);
+			batchWidth = std::max(batchWidth, widths[i]);
+			batchHeight = std::max(batchHeight, heights[i]);
+		}
+		const size_t plane = (size_t)batchWidth * batchHeight;
+		std::vector<float> input(images.size() * 3 * plane, 0.0f);
+		for (size_t i = 0; i < images.size(); ++i) {
+			PaddleDetInput(images[i], widths[i], heights[i], batchWidth, batchHeight, input.data() + i * 3 * plane);
+		}
+		std::vector<Ort::Value> out = Run(set.det, input, { (int64_t)images.size(), 3, (int64_t)batchHeight, (int64_t)batchWidth });
+		const float* maps = out[0].GetTensorData<float>(); // N x 1 x H x W
+		for (size_t i = 0; i < images.size(); ++i) {
+			PaddleDetBoxes(maps + i * plane, batchWidth, widths[i], heights[i], images[i], (uint32_t)i, config, boxes);
+		}
+	}
+
+	void Classify(Loaded& set, const std::vector<PaddleImage>& images, std::vector<PaddleBox>* boxes) {
+		const size_t plane = (size_t)kPaddleClsWidth * kPaddleRecHeight;
+		for (size_t first = 0; first < boxes->size(); first += kBatch) {
+			const size_t n = std::min<size_t>(kBatch, boxes->size() - first);
+			std::vector<float> input(n * 3 * plane, 0.0f);
+			for (size_t i = 0; i < n; ++i) {
+				const PaddleBox& box = (*boxes)[first + i];
+				PaddleLineInput(images[box.image], box, kPaddleClsWidth, false, input.data() + i * 3 * plane);
+			}
+			std::vector<Ort::Value> out = Run(set.cls, input, { (int64_t)n, 3, kPaddleRecHeight, kPaddleClsWidth });
+			const float* probs = out[0].GetTensorData<float>(); // N x 2: 0, 180 degrees
+			for (size_t i = 0; i < n; ++i) (*boxes)[first + i].flip = probs[i * 2 + 1] > probs[i * 2] && probs[i * 2 + 1] > 0.9f;
+		}
+	}
+
+	// Lines in order of aspect ratio, so each batch pads little.
+	void Read(Loaded& set, const std::vector<PaddleImage>& images, const std::vector<PaddleBox>& boxes, const PaddleOcrConfig& config,
+	          std::vector<std::vector<PaddleLine>>* lines) {
+		std::vector<size_t> order(boxes.size());
+		for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return PaddleLineWidth(boxes[a]) < PaddleLineWidth(boxes[b]); });
+		std::string text;
+		for (size_t first = 0; first < order.size(); first += kBatch) {
+			const size_t n = std::min<size_t>(kBatch, order.size() - first);
+			uint32_t batchWidth = kPaddleRecMinWidth;
+			for (size_t i = 0; i < n; ++i) batchWidth = std::max(batchWidth, PaddleLineWidth(boxes[order[first + i]]));
+			const size_t plane = (size_t)batchWidth * kPaddleRecHeight;
+			std::vector<float> input(n * 3 * plane, 0.0f);
+			for (size_t i = 0; i < n; ++i) {
+				const PaddleBox& box = boxes[order[first + i]];
+				PaddleLineInput(images[box.image], box, batchWidth, box.flip, input.data() + i * 3 * plane);
+			}
+			std::vector<Ort::Value> out = Run(set.rec, input, { (int64_t)n, 3, kPaddleRecHeight, (int64_t)batchWidth });
+			const std::vector<int64_t> shape = out[0].GetTensorTypeAndShapeInfo().GetShape(); // N x steps x classes
+			const uint32_t steps = (uint32_t)shape[1], classes = (uint32_t)shape[2];
+			const float* probs = out[0].GetTensorData<float>();
+			for (size_t i = 0; i < n; ++i) {
+				float score = 0.0f;
+				PaddleCtcDecode(probs + i * steps * classes, steps, classes, set.dict, &text, &score);
+				if (text.empty() || score < config.dropScore) continue;
+				const PaddleBox& box = boxes[order[first + i]];
+				PaddleLine line;
+				line.text = text;
+				line.confidence = score;
+				line.x = box.x;
+				line.y = box.y;
+				line.width = box.width;
+				line.height = box.height;
+				(*lines)[box.image].push_back(std::move(line));
+			}
+		}
+	}
+
+	std::mutex mutex_; // loaded_
+	std::shared_ptr<Loaded> loaded_;
+#else
+	bool Load(const PaddleOcrModels&, std::string*, double*, std::string* error) {
+		*error = "ONNX Runtime is not built in (use_onnxruntime=0)";
+		return false;
+	}
+	bool Recognize(const std::vector<PaddleImage>&, const PaddleOcrConfig&, std::vector<std::vector<PaddleLine>>*, std::string* error) {
+		*error = "ONNX Runtime is not built in (use_onnxruntime=0)";
+		return false;
+	}
+	void Unload() {}
+#endif
+};
+
+inline PaddleOcrEngine& PaddleOcr() {
+	static PaddleOcrEngine engine;
+	return engine;
+}
+
+// loadPaddleOcr({ det, rec, dict, cls?, device?, threads?, space? }) -> Promise<{ provider, loadMs }>
+inline Napi::Value LoadPaddleOcr(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsObject()) {
+		Napi::TypeError::New(env, "Models { det, rec, dict } required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Object obj = info[0].As<Napi::Object>();
+	PaddleOcrModels models;
+	for (auto& key : { std::make_pair("det", &models.det), std::make_pair("rec", &models.rec), std::make_pair("dict", &models.dict) }) {
+		if (!obj.Get(key.first).IsString()) {
+			Napi::TypeError::New(env, std::string(key.first) + " model path required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		*key.second = obj.Get(key.first).As<Napi::String>().Utf8Value();
+	}
+	if (obj.Get("cls").IsString()) models.cls = obj.Get("cls").As<Napi::String>().Utf8Value();
+	if (obj.Get("space").IsBoolean()) models.space = obj.Get("space").As<Napi::Boolean>().Value();
+	int device = 0;
+	std::string error;
+	if (!ReadEnumOption(obj, "device", { "auto", "cpu" }, &device, &error) ||
+	    !ReadUint32Option(obj, "threads", 1, 64, &models.threads, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	models.gpu = device == 0;
+	struct Loaded {
+		bool ok = false;
+		std::string provider;
+		double loadMs = 0;
+		std::string error;
+	};
+	return QueueQuery(env, "LoadPaddleOcr",
+		[models]() {
+			Loaded result;
+			result.ok = PaddleOcr().Load(models, &result.provider, &result.loadMs, &result.error);
+			return result;
+		},
+		[](Napi::Env env, Loaded& result) -> Napi::Value {
+			if (!result.ok) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("provider", Napi::String::New(env, result.provider));
+			o.Set("loadMs", Napi::Number::New(env, result.loadMs));
+			return o;
+		});
+}
+
+// Reads one { data, width, height, stride?, format? } frame; false with an
+// exception pending.
+inline bool ReadPaddleImage(Napi::Env env, const Napi::Value& value, PaddleImage* img) {
+	if (!value.IsObject() || !value.As<Napi::Object>().Get("data").IsBuffer()) {
+		Napi::TypeError::New(env, "Images must be { data, width, height, stride?, format? }").ThrowAsJavaScriptException();
+		return false;
+	}
+	Napi::Object frame = value.As<Napi::Object>();
+	Napi::Buffer<uint8_t> data = frame.Get("data").As<Napi::Buffer<uint8_t>>();
+	int format = 0;
+	std::string error;
+	if (!ReadUint32Option(frame, "width", 1, 16384, &img->width, &error) ||
+	    !ReadUint32Option(frame, "height", 1, 16384, &img->height, &error) ||
+	    !ReadEnumOption(frame, "format", { "bgra", "gray" }, &format, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return false;
+	}
+	img->bgra = format == 0;
+	const uint32_t row = img->bgra ? img->width * 4 : img->width;
+	img->stride = row;
+	if (img->width == 0 || img->height == 0 || !ReadUint32Option(frame, "stride", row, 65536 * 4, &img->stride, &error)) {
+		Napi::TypeError::New(env, error.empty() ? "Images need width and height" : error).ThrowAsJavaScriptException();
+		return false;
+	}
+	if (data.Length() < (size_t)img->stride * (img->height - 1) + row) {
+		Napi::RangeError::New(env, "Image data is shorter than height rows of stride bytes").ThrowAsJavaScriptException();
+		return false;
+	}
+	img->pixels = data.Data();
+	return true;
+}
+
+// recognizePaddleOcr(images[], options?) -> Promise<{ results: [{ text, boxes }], processingMs }>
+inline Napi::Value RecognizePaddleOcr(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsArray() || info[0].As<Napi::Array>().Length() == 0) {
+		Napi::TypeError::New(env, "Images array required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Array array = info[0].As<Napi::Array>();
+	std::vector<PaddleImage> images(array.Length());
+	// The references keep the frames' Buffers alive (and unmoved) while the models read them
+	auto keep = std::make_shared<std::vector<Napi::ObjectReference>>();
+	for (uint32_t i = 0; i < array.Length(); ++i) {
+		if (!ReadPaddleImage(env, array.Get(i), &images[i])) return env.Null();
+		keep->push_back(Napi::Persistent(array.Get(i).As<Napi::Object>().Get("data").As<Napi::Object>()));
+	}
+	PaddleOcrConfig config;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object obj = info[1].As<Napi::Object>();
+		std::string error;
+		if (!ReadUint32Option(obj, "limitSideLen", 32, 4096, &config.limitSideLen, &error) ||
+		    !ReadFloatOption(obj, "boxThreshold", 0.0f, 1.0f, &config.boxThreshold, &error) ||
+		    !ReadFloatOption(obj, "unclipRatio", 1.0f, 4.0f, &config.unclipRatio, &error) ||
+		    !ReadFloatOption(obj, "dropScore", 0.0f, 1.0f, &config.dropScore, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		if (obj.Get("cls").IsBoolean()) config.cls = obj.Get("cls").As<Napi::Boolean>().Value();
+	}
+	struct Recognized {
+		std::vector<std::vector<PaddleLine>> lines;
+		double processingMs = 0;
+		std::string error;
+	};
+	return QueueQuery(env, "RecognizePaddleOcr",
+		[keep, images = std::move(images), config]() {
+			Recognized result;
+			const auto start = std::chrono::steady_clock::now();
+			PaddleOcr().Recognize(images, config, &result.lines, &result.error);
+			result.processingMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			return result;
+		},
+		[](Napi::Env env, Recognized& result) -> Napi::Value {
+			if (!result.error.empty()) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Array results = Napi::Array::New(env, result.lines.size());
+			for (size_t i = 0; i < result.lines.size(); ++i) {
+				std::string text;
+				Napi::Array boxes = Napi::Array::New(env, result.lines[i].size());
+				for (size_t j = 0; j < result.lines[i].size(); ++j) {
+					const PaddleLine& line = result.lines[i][j];
+					Napi::Object box = Napi::Object::New(env);
+					box.Set("text", Napi::String::New(env, line.text));
+					box.Set("confidence", Napi::Number::New(env, line.confidence));
+					box.Set("x", Napi::Number::New(env, std::round(line.x)));
+					box.Set("y", Napi::Number::New(env, std::round(line.y)));
+					box.Set("width", Napi::Number::New(env, std::round(line.width)));
+					box.Set("height", Napi::Number::New(env, std::round(line.height)));
+					boxes.Set((uint32_t)j, box);
+					if (!text.empty()) text += ' ';
+					text += line.text;
+				}
+				Napi::Object o = Napi::Object::New(env);
+				o.Set("text", Napi::String::New(env, text));
+				o.Set("boxes", boxes);
+				results.Set((uint32_t)i, o);
+			}
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("results", results);
+			o.Set("processingMs", Napi::Number::New(env, result.processingMs));
+			return o;
+		});
+}
+
+// Drops the sessions on the threadpool; recognitions in flight finish first.
+inline Napi::Value UnloadPaddleOcr(const Napi::CallbackInfo& info) {
+	return QueueQuery(info.Env(), "UnloadPaddleOcr",
+		[]() {
+			PaddleOcr().Unload();
+			return true;
+		},
+		[](Napi::Env env, bool&) -> Napi::Value { return env.Undefined(); });
+}
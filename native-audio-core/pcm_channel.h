@@ -0,0 +1,991 @@
+#pragma once
+
+// Bounded hand-off of PCM packets from a capture thread to JavaScript.
+// The capture thread fills pooled slots and pushes them into a lock-free ring;
+// a single NonBlockingCall wakes the JS thread, which drains everything queued.
+// The capture thread never blocks on JS, and a stalled main thread costs at most
+// the ring's capacity before the overflow policy kicks in.
+
+#include <napi.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "content_classifier.h"
+#include "language_id.h"
+#include "speaker_change.h"
+#include "keyword_spotter.h"
+#include "latency_probe.h"
+#include "latency_trace.h"
+#include "neural_vad.h"
+#include "pcm_slot_pool.h"
+#include "platform_trace.h"
+#include "self_echo.h"
+#include "spsc_ring.h"
+#include "transient_mask.h"
+#include "utterance_chunker.h"
+#include "vad.h"
+
+// How a filled slot reaches JS.
+//   Copy   - Napi::Buffer::Copy, slot returns to the pool right away.
+//   Pooled - external Napi::Buffer over the slot; its finalizer returns the slot
+//            once JS drops the buffer. Runtimes that forbid external buffers
+//            (Electron's V8 sandbox) fall back to a single copy.
+enum class DeliveryMode { Copy, Pooled };
+
+// What the capture thread does when JS has fallen a full ring behind.
+//   DropOldest - discard the oldest queued packet (keeps latency bounded)
+//   DropNewest - discard the packet being pushed
+//   Coalesce   - merge overflowing packets into one held-back packet that is
+//                queued as soon as there is room (no audio lost up to a cap)
+enum class OverflowPolicy { DropOldest, DropNewest, Coalesce };
+
+// Packet payload handed to the JS callback.
+//   Wav     - Buffer holding a 44-byte RIFF header and int16 samples
+//   Int16   - headerless Int16Array
+//   Float32 - headerless Float32Array
+//   Base64  - 'pcm16-base64': Buffer of the int16 samples as base64 text
+//   RealtimeAppend - 'realtime-append': Buffer holding the realtime API's
+//            { "type": "input_audio_buffer.append", "audio": "<base64>" }
+//            message for the packet, for JS to send as a text frame as is
+// The text formats are encoded on the capture thread (base64.h).
+// All but WAV are preceded by one { type: 'format', ... } descriptor call.
+// A capture that reconfigures for a new device format mid-stream reports it
+// with one { type: 'format-changed', ... } call; the packet format stays the same.
+// Input the device lost (a glitch) is reported by one { type: 'discontinuity',
+// count, total, sampleIndex } call per drain: count since the last report,
+// total since the start and the stream index of the latest one.
+// With VAD on, every packet call carries a second argument: a number whose bit
+// i is set when the packet's i-th VAD frame holds speech. With the utterance
+// chunker on as well, each finished utterance arrives between the packets as one
+// { type: 'chunk', wav, reason, durationMs, overlapMs, pauseMs, lufs, peakDb,
+// features } call; its wav is always a 16-bit WAV, whatever the packet format,
+// lufs is its BS.1770 integrated loudness and features holds the pre-filter
+// measurements of its frames (SpectralFeatures); fingerprint, when the chunk
+// had at least two analysed frames, is a Uint32Array of its perceptual
+// fingerprint words (spectral_features.h), for spotting repeated audio.
+// difficulty is { snrDb, speechRatio, lufs, clippingRatio, musicProbability,
+// score, level }, how hard the chunk should be to transcribe, level 'easy',
+// 'moderate' or 'hard' (chunk_difficulty.h).
+// With option 'content', content is { speech, music, noise }, the chunk's mean
+// class probabilities, and timeline, a Float32Array of the three for each
+// 100 ms of it (content_classifier.h). With option 'languageId', language is
+// { code, confidence } once the utterance's first second named one
+// (language_id.h). With option 'speaker', speaker is the chunk's speaker
+// cluster (0, 1, ...) once a second and a half of speech named one, and
+// reason 'speaker' marks a cut at a turn change (speaker_change.h). With
+// chunker.adaptive, syllableRate is the speaker's syllables a second that the
+// chunk's pause and length thresholds were scaled by, 0 until two seconds of
+// their speech (speech_rate.h). With chunker.trimMs, trimmedMs is the
+// non-speech the chunk left out at its ends. With chunker.compact,
+// compactedMs is what the chunk's long pauses lost and, when it is not 0,
+// timeMap a Float64Array of (chunk ms, capture ms since the chunk's first
+// sample) pairs, one per shortened pause: chunk time t maps back to
+// t + b - a for the last pair whose a is at most t.
+// With timestamps on, every packet call carries a third argument (the second
+// is undefined without VAD): { sampleIndex, captureTimeMs } for the packet's
+// first sample, and chunks carry the same two fields. sampleIndex counts the
+// stream's samples since the capture started, dropped packets included;
+// captureTimeMs is when the device captured that sample, on the clock the
+// addon's deviceClockMs() reads (QPC on Windows, mach host time on macOS),
+// or 0 when the device gave no timestamp. Chunks also carry a trace object,
+// { id, processedMs, queuedMs, deliveredMs }, on the same clock
+// (latency_trace.h).
+// With DTX on, packets stop after hangoverMs without activity: one
+// { type: 'silence-start', sampleIndex } call marks the first packet held
+// back, and the next active packet is preceded by one { type: 'silence-end',
+// sampleIndex, silentMs } call and up to prerollMs of the packets before it.
+// sampleIndex is that of the first packet delivered again; silentMs is what
+// was never delivered.
+// With option 'keyword', utterance chunks only arrive inside the window that
+// follows a spotted keyword (keyword_spotter.h), and each detection is one
+// { type: 'keyword', keyword, score, sampleIndex, windowMs } call ahead of
+// them: the label's name, its smoothed probability, the stream index it was
+// heard at and how long chunks will flow.
+// With chunker.stream, each utterance also goes out while it is still open
+// (utterance_stream.h): from the frame that finds its speech, one
+// { type: 'chunk-stream', id, seq, format, sampleRate, data, end, aborted,
+// sampleIndex } call every intervalMs, data a Buffer of the audio since the
+// previous one ('ogg' pages or raw 'pcm16'). The call with end set is the
+// last, and the utterance's { type: 'chunk' } call follows it carrying the
+// same id as streamId; aborted (no data) means silence reset the utterance
+// before it became a chunk. seq counts an utterance's calls, so a gap shows
+// one was dropped on overflow; an utterance still open at stop() just ends.
+// Not with option 'keyword', which may hold a chunk back.
+// With option 'mel', the log-mel frames of every chunk (log_mel.h) are kept
+// for a while, so transcribeWhisper() on that chunk's WAV skips its own
+// feature pass.
+// With option 'governor', every quality step is one { type: 'quality', level,
+// reason, load, sampleIndex } call: the new level (quality_governor.h),
+// 'load-high' or 'load-low', the processing load that triggered it and the
+// stream index it applies from; 'power' when option 'power' moved the floor.
+// With option 'power', the profile in force is one { type: 'power', source,
+// quality, throttleMs, latencyMode, sampleIndex } call at the start and on
+// every change of power source ('ac', 'battery' or 'unknown').
+// A stream the capture watchdog finds stalled (capture_watchdog.h) reports
+// each recovery step as one { type: 'stall', step, stalledMs, sampleIndex }
+// call: 'restart', 'reinitialize' or 'reactivate', then 'recovered' once
+// frames flow again; stalledMs is the time since the stall was detected.
+// With option 'idle', releasing the device stream after the idle time is one
+// { type: 'idle', idle: true, idleMs: 0, sampleIndex } call, and reopening it
+// when something plays one with idle false and idleMs the time it was
+// released, alongside a 'format' event with reason 'idle' and a discontinuity.
+// With option 'batch', each wakeup is a single call with an array of what
+// would have been its calls, in order: the event objects as they are, and
+// packets as { type: 'packet', data, speech?, time? } holding what the
+// packet call's arguments would.
+enum class SampleFormat { Wav, Int16, Float32, Base64, RealtimeAppend };
+
+// Discontinuous transmission (option "dtx"). A packet is active when VAD
+// marks any of its frames as speech, or without VAD when its output peak
+// reaches thresholdDb.
+struct DtxConfig {
+	bool enabled = false;
+	uint32_t hangoverMs = 1000; // silence still delivered before packets stop
+	uint32_t prerollMs = 300;   // held-back packets delivered ahead of an onset
+	float thresholdDb = -50.0f; // dBFS
+};
+
+struct PcmChannelConfig {
+	DeliveryMode delivery = DeliveryMode::Copy;
+	OverflowPolicy overflow = OverflowPolicy::DropOldest;
+	size_t queueDepth = 64;
+	SampleFormat format = SampleFormat::Wav;
+	uint32_t sampleRate = 16000;
+	uint32_t packetSamples = 0; // fixed packet size, 0 when packets vary
+	VadMode vad = VadMode::Off;
+	uint32_t vadFrameSamples = 0; // packetSamples is a whole number (<= 32) of these
+	NeuralVadConfig neuralVad;    // vetoes the detector's speech frames; needs vad
+	SelfEchoConfig selfEcho;      // vetoes frames that are our own TTS played back; needs vad
+	TransientMaskConfig declick;  // clicks masked from the detector's input; needs vad
+	UtteranceChunkerConfig chunker; // needs vad
+	KeywordSpotterConfig keyword;   // needs the chunker
+	bool mel = false;               // chunk log-mel frames to ChunkMels(); needs the chunker
+	ContentClassifierConfig content; // speech / music / noise per chunk; needs the chunker
+	LanguageIdConfig languageId;     // spoken language per utterance; needs the chunker
+	SpeakerChangeConfig speaker;     // cuts at turn changes, speaker clusters per chunk; needs the chunker
+	uint32_t throttleMs = 0; // wake JS at most this often; 0 = per packet
+	bool timestamps = false;
+	bool batch = false; // one callback call per drain, with an array of its calls
+	DtxConfig dtx;
+};
+
+struct PcmDeliveryStats {
+	uint64_t copied = 0;    // delivered with Buffer::Copy or NewOrCopy fallback
+	uint64_t zeroCopy = 0;  // delivered as an external buffer over the slot
+	uint64_t bytes = 0;     // payload handed to JS, headers included
+	uint64_t slotsInUse = 0;
+	uint64_t slotsTotal = 0;
+	uint64_t queued = 0;    // packets waiting in the ring
+	uint64_t capacity = 0;
+	uint64_t highWater = 0; // deepest the ring has been
+	uint64_t overflows = 0; // pushes that found the ring full
+	uint64_t dropped = 0;   // packets discarded by the overflow policy
+	uint64_t coalesced = 0; // packets merged into a held-back packet
+	uint64_t underruns = 0; // JS wakeups that found nothing to deliver
+	uint64_t contentDropped = 0; // chunks dropped as music or noise (option 'content')
+	uint64_t selfEchoMs = 0;     // capture vetoed as our own TTS (option 'selfEcho')
+	uint64_t clicksMasked = 0;   // clicks hidden from the VAD (option 'declick')
+};
+
+// Held-back coalesced packets are capped at this size; beyond it new packets
+// are dropped.
+constexpr size_t kMaxCoalescedBytes = 64 * 1024;
+constexpr size_t kWavHeaderBytes = 44;
+
+// The text formats' envelope: their packets are prefix, base64, suffix.
+constexpr char kRealtimeAppendPrefix[] = "{\"type\":\"input_audio_buffer.append\",\"audio\":\"";
+constexpr char kRealtimeAppendSuffix[] = "\"}";
+
+inline bool IsTextFormat(SampleFormat format) { return format == SampleFormat::Base64 || format == SampleFormat::RealtimeAppend; }
+inline size_t HeaderBytes(SampleFormat format) {
+	if (format == SampleFormat::Wav) return kWavHeaderBytes;
+	return format == SampleFormat::RealtimeAppend ? sizeof(kRealtimeAppendPrefix) - 1 : 0;
+}
+inline size_t TrailerBytes(SampleFormat format) { return format == SampleFormat::RealtimeAppend ? sizeof(kRealtimeAppendSuffix) - 1 : 0; }
+// Of the int16 or float32 samples; text packets hold 4 characters per 3 bytes of them.
+inline size_t BytesPerSample(SampleFormat format) { return format == SampleFormat::Float32 ? sizeof(float) : sizeof(int16_t); }
+
+class PcmChannel;
+
+// A native consumer of a channel's utterance chunks (pipeline_graph.h). With
+// one set, SubmitPcmSlot hands it each chunk instead of queueing it for JS
+// and releases packets and markers unseen; JS still gets the channel's
+// other events.
+class PcmChunkSink {
+public:
+	virtual ~PcmChunkSink() = default;
+	// Capture thread. The sink owns slot until it hands it back with
+	// channel->Release() (from any thread), holding a channel reference meanwhile.
+	virtual void Chunk(PcmChannel* channel, PcmSlot* slot) = 0;
+	// Chunks it may hold at once, reserved on top of the channel's own
+	virtual size_t MaxHeld() const = 0;
+};
+
+// TSFN context. Reference counted: the ThreadSafeFunction, the capture object
+// and every live external buffer each hold a reference, so slots stay valid
+// until the last packet has been delivered and collected.
+class PcmChannel {
+public:
+	explicit PcmChannel(const PcmChannelConfig& config)
+		: config_(config), ring_(config.queueDepth), chunkPool_(true), minChunkMs_(config.chunker.minChunkMs),
+		  throttleMs_(config.throttleMs) {}
+
+	const PcmChannelConfig& Config() const { return config_; }
+	DeliveryMode Mode() const { return config_.delivery; }
+	SampleFormat Format() const { return config_.format; }
+
+	void AddRef() { refs_.fetch_add(1, std::memory_order_relaxed); }
+	void Unref() {
+		if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+	}
+
+	// Enough slots for a full ring plus a few in flight, and `held` more the
+	// writer keeps back (DTX pre-roll).
+	void Reserve(size_t slotBytes, size_t held = 0) { pool_.Reserve(ring_.Capacity() + 4 + held, slotBytes); }
+	PcmSlot* Acquire(size_t slotBytes, bool* grew) { return pool_.Acquire(slotBytes, grew); }
+	void Release(PcmSlot* slot) { (slot->chunk ? chunkPool_ : pool_).Release(slot); }
+
+	// Utterance chunks come from their own few large slots so stream packets
+	// never inherit (or regrow to) chunk-sized buffers.
+	void ReserveChunks(size_t slotBytes, size_t count = 2) { chunkPool_.Reserve(count, slotBytes); }
+	PcmSlot* AcquireChunk(size_t slotBytes, bool* grew) { return chunkPool_.Acquire(slotBytes, grew); }
+
+	// JS thread sets, capture thread reads per frame (language-dependent minimum).
+	// JS thread, before any capture writes to the channel.
+	void SetChunkSink(std::shared_ptr<PcmChunkSink> sink) { sink_ = std::move(sink); }
+	PcmChunkSink* ChunkSink() const { return sink_.get(); }
+
+	void SetMinChunkMs(uint32_t ms) { minChunkMs_.store(ms, std::memory_order_relaxed); }
+	uint32_t MinChunkMs() const { return minChunkMs_.load(std::memory_order_relaxed); }
+
+	// Capture thread. Queues a filled slot, applying the overflow policy when the
+	// ring is full. Returns true if the caller must wake the JS thread.
+	bool Push(PcmSlot* slot) {
+		if (pending_ && ring_.TryPush(pending_)) pending_ = nullptr;
+		if (!pending_ && ring_.TryPush(slot)) {
+			NoteDepth();
+			return RequestWake();
+		}
+		overflows_.fetch_add(1, std::memory_order_relaxed);
+		switch (config_.overflow) {
+		case OverflowPolicy::DropNewest:
+			Drop(slot);
+			break;
+		case OverflowPolicy::DropOldest:
+			if (PcmSlot* oldest = ring_.StealOldest()) Drop(oldest);
+			if (!ring_.TryPush(slot)) Drop(slot);
+			break;
+		case OverflowPolicy::Coalesce:
+			if (slot->chunk || slot->marker != PcmMarker::None) {
+				// Utterances and markers are never merged; make room for them instead
+				if (PcmSlot* oldest = ring_.StealOldest()) Drop(oldest);
+				if (!ring_.TryPush(slot)) Drop(slot);
+			} else if (!pending_) {
+				pending_ = slot;
+			} else {
+				if (AppendPayload(pending_, slot)) coalesced_.fetch_add(1, std::memory_order_relaxed);
+				else dropped_.fetch_add(1, std::memory_order_relaxed);
+				pool_.Release(slot);
+			}
+			break;
+		}
+		return RequestWake();
+	}
+
+	// Capture thread, once it stops producing: queue or drop the held-back packet,
+	// and wake JS for anything the throttle is still holding back. `ended`: the
+	// source ran out (a replayed file), which JS hears after the last packet.
+	bool Close(bool ended = false) {
+		if (pending_ && !ring_.TryPush(pending_)) Drop(pending_);
+		pending_ = nullptr;
+		if (ended) ended_.store(true, std::memory_order_release);
+		return (ended || ring_.Size() > 0) && ForceWake();
+	}
+	// JS thread. True once, after Close(true); every packet queued before it
+	// is visible to the Pop() calls that follow.
+	bool TakeEnd() { return ended_.exchange(false, std::memory_order_acq_rel); }
+
+	// Capture thread: half the ring is waiting for JS. Producers that can
+	// wait (a file replayed at pace 'fast') hold off instead of overflowing.
+	bool Backlogged() const { return ring_.Size() * 2 >= config_.queueDepth; }
+	// Any thread: packets waiting for JS.
+	size_t Queued() const { return ring_.Size(); }
+
+	// JS thread. Clearing the wake flag before draining means a push that races
+	// with the drain always schedules another wakeup.
+	void BeginDrain() { wake_.exchange(false, std::memory_order_acq_rel); }
+	void CancelWake() { wake_.store(false, std::memory_order_release); }
+	PcmSlot* Pop() { return ring_.TryPop(); }
+	void CountUnderrun() { underruns_.fetch_add(1, std::memory_order_relaxed); }
+	// True exactly once, on the first drain of a raw-format channel.
+	bool TakeFormatAnnouncement() {
+		if (formatSent_ || config_.format == SampleFormat::Wav) return false;
+		formatSent_ = true;
+		return true;
+	}
+
+	// Capture thread: record the device's new input format for the next drain.
+	// reason must be a string literal.
+	bool PostInputFormatChange(uint32_t sampleRate, uint32_t channels, const char* reason) {
+		inputRate_.store(sampleRate, std::memory_order_relaxed);
+		inputChannels_.store(channels, std::memory_order_relaxed);
+		changeReason_.store(reason, std::memory_order_relaxed);
+		inputChanged_.store(true, std::memory_order_release);
+		return ForceWake();
+	}
+	// JS thread. True once per posted change (the latest one wins).
+	bool TakeInputFormatChange(uint32_t* sampleRate, uint32_t* channels, const char** reason) {
+		if (!inputChanged_.exchange(false, std::memory_order_acq_rel)) return false;
+		*sampleRate = inputRate_.load(std::memory_order_relaxed);
+		*channels = inputChannels_.load(std::memory_order_relaxed);
+		*reason = changeReason_.load(std::memory_order_relaxed);
+		return true;
+	}
+
+	// Capture thread: the quality governor stepped to `level` from stream
+	// sample sampleIndex. level and reason must be string literals.
+	bool PostQualityChange(const char* level, const char* reason, float load, uint64_t sampleIndex) {
+		qualityLevel_.store(level, std::memory_order_relaxed);
+		qualityReason_.store(reason, std::memory_order_relaxed);
+		qualityLoad_.store(load, std::memory_order_relaxed);
+		qualityIndex_.store(sampleIndex, std::memory_order_relaxed);
+		qualityChanged_.store(true, std::memory_order_release);
+		return ForceWake();
+	}
+	// JS thread. True once per posted step (the latest one wins; the governor
+	// holds each level far longer than a drain takes).
+	bool TakeQualityChange(const char** level, const char** reason, float* load, uint64_t* sampleIndex) {
+		if (!qualityChanged_.exchange(false, std::memory_order_acq_rel)) return false;
+		*level = qualityLevel_.load(std::memory_order_relaxed);
+		*reason = qualityReason_.load(std::memory_order_relaxed);
+		*load = qualityLoad_.load(std::memory_order_relaxed);
+		*sampleIndex = qualityIndex_.load(std::memory_order_relaxed);
+		return true;
+	}
+
+	// Capture thread: option 'power' switched to the profile for `source`;
+	// the strings must be literals. Also sets the wakeup throttle it names.
+	bool PostPowerChange(const char* source, const char* quality, uint32_t throttleMs, const char* latency, uint64_t sampleIndex) {
+		throttleMs_ = throttleMs;
+		powerSource_.store(source, std::memory_order_relaxed);
+		powerQuality_.store(quality, std::memory_order_relaxed);
+		powerThrottleMs_.store(throttleMs, std::memory_order_relaxed);
+		powerLatency_.store(latency, std::memory_order_relaxed);
+		powerIndex_.store(sampleIndex, std::memory_order_relaxed);
+		powerChanged_.store(true, std::memory_order_release);
+		return ForceWake();
+	}
+	// JS thread. True once per posted change (the latest one wins).
+	bool TakePowerChange(const char** source, const char** quality, uint32_t* throttleMs, const char** latency, uint64_t* sampleIndex) {
+		if (!powerChanged_.exchange(false, std::memory_order_acq_rel)) return false;
+		*source = powerSource_.load(std::memory_order_relaxed);
+		*quality = powerQuality_.load(std::memory_order_relaxed);
+		*throttleMs = powerThrottleMs_.load(std::memory_order_relaxed);
+		*latency = powerLatency_.load(std::memory_order_relaxed);
+		*sampleIndex = powerIndex_.load(std::memory_order_relaxed);
+		return true;
+	}
+
+	// Capture thread: the watchdog took recovery step `step` (a string literal)
+	// stalledMs into a stall, or the stream recovered.
+	bool PostStall(const char* step, uint64_t stalledMs, uint64_t sampleIndex) {
+		stallStep_.store(step, std::memory_order_relaxed);
+		stalledMs_.store(stalledMs, std::memory_order_relaxed);
+		stallIndex_.store(sampleIndex, std::memory_order_relaxed);
+		stalled_.store(true, std::memory_order_release);
+		return ForceWake();
+	}
+	// JS thread. True once per posted step (the latest one wins).
+	bool TakeStall(const char** step, uint64_t* stalledMs, uint64_t* sampleIndex) {
+		if (!stalled_.exchange(false, std::memory_order_acq_rel)) return false;
+		*step = stallStep_.load(std::memory_order_relaxed);
+		*stalledMs = stalledMs_.load(std::memory_order_relaxed);
+		*sampleIndex = stallIndex_.load(std::memory_order_relaxed);
+		return true;
+	}
+
+	// Capture thread: option 'idle' released the device stream, or reopened it
+	// after idleMs.
+	bool PostIdle(bool idle, uint64_t idleMs, uint64_t sampleIndex) {
+		idle_.store(idle, std::memory_order_relaxed);
+		idleMs_.store(idleMs, std::memory_order_relaxed);
+		idleIndex_.store(sampleIndex, std::memory_order_relaxed);
+		idleChanged_.store(true, std::memory_order_release);
+		return ForceWake();
+	}
+	// JS thread. True once per posted change (the latest one wins).
+	bool TakeIdle(bool* idle, uint64_t* idleMs, uint64_t* sampleIndex) {
+		if (!idleChanged_.exchange(false, std::memory_order_acq_rel)) return false;
+		*idle = idle_.load(std::memory_order_relaxed);
+		*idleMs = idleMs_.load(std::memory_order_relaxed);
+		*sampleIndex = idleIndex_.load(std::memory_order_relaxed);
+		return true;
+	}
+
+	// Capture thread: the device lost input just before stream sample sampleIndex.
+	bool PostDiscontinuity(uint64_t sampleIndex) {
+		discontinuityIndex_.store(sampleIndex, std::memory_order_relaxed);
+		discontinuities_.fetch_add(1, std::memory_order_release);
+		return ForceWake();
+	}
+	// JS thread. True when discontinuities were posted since the last call.
+	bool TakeDiscontinuities(uint64_t* count, uint64_t* total, uint64_t* sampleIndex) {
+		*total = discontinuities_.load(std::memory_order_acquire);
+		if (*total == discontinuitiesTaken_) return false;
+		*count = *total - discontinuitiesTaken_;
+		discontinuitiesTaken_ = *total;
+		*sampleIndex = discontinuityIndex_.load(std::memory_order_relaxed);
+		return true;
+	}
+
+	// Finalizer path for external buffers.
+	void ReleaseExternal(PcmSlot* slot) {
+		slot->external.store(false, std::memory_order_release);
+		Release(slot);
+		Unref();
+	}
+
+	// Capture thread: a chunk the content classifier dropped.
+	void CountContentDrop() { contentDropped_.fetch_add(1, std::memory_order_relaxed); }
+
+	// Capture thread: samples the self-echo guard vetoed.
+	void CountSelfEcho(size_t samples) { selfEchoSamples_.fetch_add(samples, std::memory_order_relaxed); }
+
+	// Capture thread: clicks the transient masker hid from the VAD.
+	void CountClicks(uint32_t clicks) { clicksMasked_.fetch_add(clicks, std::memory_order_relaxed); }
+
+	void CountDelivery(bool zeroCopy, size_t bytes) {
+		if (zeroCopy) zeroCopy_.fetch_add(1, std::memory_order_relaxed);
+		else copied_.fetch_add(1, std::memory_order_relaxed);
+		bytes_.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	PcmDeliveryStats Stats() {
+		PcmDeliveryStats s;
+		s.copied = copied_.load(std::memory_order_relaxed);
+		s.zeroCopy = zeroCopy_.load(std::memory_order_relaxed);
+		s.bytes = bytes_.load(std::memory_order_relaxed);
+		pool_.Counts(&s.slotsTotal, &s.slotsInUse);
+		s.queued = ring_.Size();
+		s.capacity = ring_.Capacity();
+		s.highWater = highWater_.load(std::memory_order_relaxed);
+		s.overflows = overflows_.load(std::memory_order_relaxed);
+		s.dropped = dropped_.load(std::memory_order_relaxed);
+		s.coalesced = coalesced_.load(std::memory_order_relaxed);
+		s.underruns = underruns_.load(std::memory_order_relaxed);
+		s.contentDropped = contentDropped_.load(std::memory_order_relaxed);
+		s.selfEchoMs = selfEchoSamples_.load(std::memory_order_relaxed) * 1000 / config_.sampleRate;
+		s.clicksMasked = clicksMasked_.load(std::memory_order_relaxed);
+		return s;
+	}
+
+private:
+	~PcmChannel() = default;
+
+	// With throttleMs set, packets pushed inside the window stay queued and go out
+	// with the first push after it (or at Close).
+	bool RequestWake() {
+		if (throttleMs_ > 0) {
+			const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+			if (now - lastWakeMs_ < throttleMs_) return false;
+			lastWakeMs_ = now;
+		}
+		return ForceWake();
+	}
+	bool ForceWake() { return !wake_.exchange(true, std::memory_order_acq_rel); }
+
+	void NoteDepth() {
+		uint64_t depth = ring_.Size();
+		if (depth > highWater_.load(std::memory_order_relaxed)) highWater_.store(depth, std::memory_order_relaxed);
+	}
+
+	void Drop(PcmSlot* slot) {
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		Release(slot);
+	}
+
+	// Appends src's samples to dst and patches dst's RIFF sizes. Only touches dst,
+	// which the capture thread still owns (it is not in the ring).
+	bool AppendPayload(PcmSlot* dst, const PcmSlot* src) const {
+		const size_t headerBytes = HeaderBytes(config_.format);
+		if (src->size <= headerBytes) return true;
+		const size_t extra = src->size - headerBytes;
+		const size_t newSize = dst->size + extra;
+		if (newSize > kMaxCoalescedBytes) return false;
+		if (dst->bytes.size() < newSize) dst->bytes.resize(newSize);
+		memcpy(dst->bytes.data() + dst->size, src->bytes.data() + headerBytes, extra);
+		// Speech bits of the merged packet follow the ones already held
+		if (config_.vadFrameSamples > 0) {
+			const size_t frames = (dst->size - extra - headerBytes) / BytesPerSample(config_.format) / config_.vadFrameSamples;
+			if (frames < 32) dst->speech |= src->speech << frames;
+		}
+		dst->size = newSize;
+		if (headerBytes == 0) return true;
+		uint8_t* header = dst->bytes.data();
+		*reinterpret_cast<uint32_t*>(header + 4) = (uint32_t)(newSize - 8);
+		*reinterpret_cast<uint32_t*>(header + 40) = (uint32_t)(newSize - kWavHeaderBytes);
+		return true;
+	}
+
+	const PcmChannelConfig config_;
+	std::shared_ptr<PcmChunkSink> sink_;
+	std::atomic<int> refs_{1};
+	PcmSlotPool pool_;
+	SpscRing<PcmSlot> ring_;
+	PcmSlotPool chunkPool_;
+	std::atomic<uint32_t> minChunkMs_;
+	PcmSlot* pending_ = nullptr; // capture thread only
+	int64_t lastWakeMs_ = 0;     // capture thread only
+	uint32_t throttleMs_;        // capture thread only; option 'power' changes it
+	std::atomic<bool> wake_{false};
+	bool formatSent_ = false; // JS thread only
+	std::atomic<bool> inputChanged_{false};
+	std::atomic<uint32_t> inputRate_{0};
+	std::atomic<uint32_t> inputChannels_{0};
+	std::atomic<const char*> changeReason_{""};
+	std::atomic<bool> qualityChanged_{false};
+	std::atomic<const char*> qualityLevel_{""};
+	std::atomic<const char*> qualityReason_{""};
+	std::atomic<float> qualityLoad_{0.0f};
+	std::atomic<uint64_t> qualityIndex_{0};
+	std::atomic<bool> powerChanged_{false};
+	std::atomic<const char*> powerSource_{""};
+	std::atomic<const char*> powerQuality_{""};
+	std::atomic<uint32_t> powerThrottleMs_{0};
+	std::atomic<const char*> powerLatency_{""};
+	std::atomic<uint64_t> powerIndex_{0};
+	std::atomic<bool> stalled_{false};
+	std::atomic<const char*> stallStep_{""};
+	std::atomic<uint64_t> stalledMs_{0};
+	std::atomic<uint64_t> stallIndex_{0};
+	std::atomic<bool> idleChanged_{false};
+	std::atomic<bool> idle_{false};
+	std::atomic<uint64_t> idleMs_{0};
+	std::atomic<uint64_t> idleIndex_{0};
+	std::atomic<uint64_t> discontinuities_{0};
+	std::atomic<uint64_t> discontinuityIndex_{0};
+	std::atomic<bool> ended_{false};
+	uint64_t discontinuitiesTaken_ = 0; // JS thread only
+	std::atomic<uint64_t> copied_{0};
+	std::atomic<uint64_t> zeroCopy_{0};
+	std::atomic<uint64_t> bytes_{0};
+	std::atomic<uint64_t> highWater_{0};
+	std::atomic<uint64_t> overflows_{0};
+	std::atomic<uint64_t> dropped_{0};
+	std::atomic<uint64_t> coalesced_{0};
+	std::atomic<uint64_t> underruns_{0};
+	std::atomic<uint64_t> contentDropped_{0};
+	std::atomic<uint64_t> selfEchoSamples_{0};
+	std::atomic<uint64_t> clicksMasked_{0};
+};
+
+// Wraps bytes [0, size) of a delivered buffer as the channel's JS value: the
+// Buffer itself for WAV and the text formats, otherwise a typed array view over it.
+inline Napi::Value PcmPacketValue(Napi::Env env, SampleFormat format, Napi::Buffer<uint8_t> buffer, size_t size) {
+	if (format == SampleFormat::Wav || IsTextFormat(format)) return buffer;
+	const size_t elem = BytesPerSample(format);
+	if (buffer.ByteOffset() % elem != 0) {
+		// Misaligned copy fallback; never expected from Node's own allocators
+		Napi::ArrayBuffer ab = Napi::ArrayBuffer::New(env, size);
+		memcpy(ab.Data(), buffer.Data(), size);
+		if (format == SampleFormat::Float32) return Napi::Float32Array::New(env, size / elem, ab, 0);
+		return Napi::Int16Array::New(env, size / elem, ab, 0);
+	}
+	if (format == SampleFormat::Float32) return Napi::Float32Array::New(env, size / elem, buffer.ArrayBuffer(), buffer.ByteOffset());
+	return Napi::Int16Array::New(env, size / elem, buffer.ArrayBuffer(), buffer.ByteOffset());
+}
+
+inline Napi::Object PacketTimeToJs(Napi::Env env, uint64_t sampleIndex, uint64_t timeNs) {
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("sampleIndex", Napi::Number::New(env, (double)sampleIndex));
+	o.Set("captureTimeMs", Napi::Number::New(env, timeNs / 1e6));
+	return o;
+}
+
+// Where one drain's calls go: straight to the callback, or with option 'batch'
+// into one array that is handed over in a single call once the drain is done.
+class PcmCalls {
+public:
+	PcmCalls(Napi::Env env, Napi::Function cb, bool batch) : cb_(cb) {
+		if (batch) batch_ = Napi::Array::New(env);
+	}
+
+	bool Batched() const { return !batch_.IsEmpty(); }
+
+	void Event(Napi::Value o) {
+		if (Batched()) batch_.Set(n_++, o);
+		else cb_.Call({ o });
+	}
+
+	void Call(const std::initializer_list<napi_value>& args) { cb_.Call(args); }
+
+	void Flush() {
+		if (Batched() && n_ > 0) cb_.Call({ batch_ });
+	}
+
+private:
+	Napi::Function cb_;
+	Napi::Array batch_;
+	uint32_t n_ = 0;
+};
+
+inline void CallWithPacket(Napi::Env env, PcmCalls& calls, PcmChannel* channel, Napi::Value packet, uint32_t speech,
+                           uint64_t sampleIndex, uint64_t timeNs) {
+	const bool vad = channel->Config().vad != VadMode::Off;
+	if (calls.Batched()) {
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("type", Napi::String::New(env, "packet"));
+		o.Set("data", packet);
+		if (vad) o.Set("speech", Napi::Number::New(env, speech));
+		if (channel->Config().timestamps) o.Set("time", PacketTimeToJs(env, sampleIndex, timeNs));
+		calls.Event(o);
+	} else if (channel->Config().timestamps) {
+		calls.Call({ packet, vad ? Napi::Number::New(env, speech) : env.Undefined(), PacketTimeToJs(env, sampleIndex, timeNs) });
+	} else if (vad) {
+		calls.Call({ packet, Napi::Number::New(env, speech) });
+	} else {
+		calls.Call({ packet });
+	}
+}
+
+// Hands bytes [0, size) of the slot to JS as a Buffer, per the channel's delivery mode.
+inline Napi::Buffer<uint8_t> WrapPcmSlot(Napi::Env env, PcmChannel* channel, PcmSlot* slot, size_t size) {
+	if (channel->Mode() == DeliveryMode::Pooled) {
+		channel->AddRef();
+		slot->external.store(true, std::memory_order_release);
+		auto buffer = Napi::Buffer<uint8_t>::NewOrCopy(env, slot->bytes.data(), size,
+			[channel, slot](Napi::Env, uint8_t*) { channel->ReleaseExternal(slot); });
+		// NewOrCopy runs the finalizer synchronously when it had to copy
+		channel->CountDelivery(slot->external.load(std::memory_order_acquire), size);
+		return buffer;
+	}
+	auto buffer = Napi::Buffer<uint8_t>::Copy(env, slot->bytes.data(), size);
+	channel->CountDelivery(false, size);
+	channel->Release(slot);
+	return buffer;
+}
+
+inline Napi::Object UtteranceChunkToJs(Napi::Env env, PcmChannel* channel, PcmSlot* slot) {
+	const size_t samples = (slot->size - kWavHeaderBytes) / sizeof(int16_t);
+	const double msPerSample = 1000.0 / channel->Config().sampleRate;
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("type", Napi::String::New(env, "chunk"));
+	o.Set("reason", Napi::String::New(env, UtteranceCutName((UtteranceCut)slot->cut)));
+	o.Set("durationMs", Napi::Number::New(env, std::round(samples * msPerSample)));
+	o.Set("overlapMs", Napi::Number::New(env, std::round(slot->overlapSamples * msPerSample)));
+	o.Set("pauseMs", Napi::Number::New(env, slot->pauseMs));
+	if (channel->Config().chunker.trimMs > 0) o.Set("trimmedMs", Napi::Number::New(env, std::round(slot->trimmedSamples * msPerSample)));
+	if (channel->Config().chunker.compact.enabled) {
+		o.Set("compactedMs", Napi::Number::New(env, std::round(slot->compactedSamples * msPerSample)));
+		if (!slot->timeMap.empty()) {
+			Napi::Float64Array timeMap = Napi::Float64Array::New(env, slot->timeMap.size());
+			for (size_t i = 0; i < slot->timeMap.size(); ++i) timeMap[i] = slot->timeMap[i] * msPerSample;
+			o.Set("timeMap", timeMap);
+		}
+	}
+	if (channel->Config().chunker.adaptive) o.Set("syllableRate", Napi::Number::New(env, slot->syllableRate));
+	o.Set("lufs", Napi::Number::New(env, slot->lufs));
+	o.Set("peakDb", Napi::Number::New(env, slot->peakDb));
+	if (slot->streamId != 0) o.Set("streamId", Napi::Number::New(env, slot->streamId));
+	const SpectralFeatures& f = slot->features;
+	Napi::Object features = Napi::Object::New(env);
+	features.Set("dominantFrequency", Napi::Number::New(env, f.dominantFrequency));
+	features.Set("harmonicContent", Napi::Number::New(env, f.harmonicContent));
+	features.Set("modulationDepth", Napi::Number::New(env, f.modulationDepth));
+	features.Set("zeroCrossingRate", Napi::Number::New(env, f.zeroCrossingRate));
+	features.Set("spectralFlatness", Napi::Number::New(env, f.spectralFlatness));
+	features.Set("noiseRatio", Napi::Number::New(env, f.noiseRatio));
+	o.Set("features", features);
+	const ChunkDifficulty& d = slot->difficulty;
+	Napi::Object difficulty = Napi::Object::New(env);
+	difficulty.Set("snrDb", Napi::Number::New(env, d.snrDb));
+	difficulty.Set("speechRatio", Napi::Number::New(env, d.speechRatio));
+	difficulty.Set("lufs", Napi::Number::New(env, slot->lufs));
+	difficulty.Set("clippingRatio", Napi::Number::New(env, d.clippingRatio));
+	difficulty.Set("musicProbability", Napi::Number::New(env, d.musicProbability));
+	difficulty.Set("score", Napi::Number::New(env, d.score));
+	difficulty.Set("level", Napi::String::New(env, DifficultyLevelName(d.score)));
+	o.Set("difficulty", difficulty);
+	if (!slot->fingerprint.empty()) {
+		Napi::Uint32Array fingerprint = Napi::Uint32Array::New(env, slot->fingerprint.size());
+		std::memcpy(fingerprint.Data(), slot->fingerprint.data(), slot->fingerprint.size() * sizeof(uint32_t));
+		o.Set("fingerprint", fingerprint);
+	}
+	if (slot->classified) {
+		Napi::Object content = Napi::Object::New(env);
+		for (uint32_t c = 0; c < kContentClasses; ++c) {
+			content.Set(ContentClassName((ContentClass)c), Napi::Number::New(env, slot->content.p[c]));
+		}
+		Napi::Float32Array timeline = Napi::Float32Array::New(env, slot->contentTimeline.size());
+		if (!slot->contentTimeline.empty()) {
+			std::memcpy(timeline.Data(), slot->contentTimeline.data(), slot->contentTimeline.size() * sizeof(float));
+		}
+		content.Set("timeline", timeline);
+		o.Set("content", content);
+	}
+	if (slot->speaker >= 0) o.Set("speaker", Napi::Number::New(env, slot->speaker));
+	const LanguageIdConfig& lid = channel->Config().languageId;
+	if (slot->language >= 0 && lid.model && (size_t)slot->language < lid.model->languages.size()) {
+		Napi::Object language = Napi::Object::New(env);
+		language.Set("code", Napi::String::New(env, lid.model->languages[slot->language]));
+		language.Set("confidence", Napi::Number::New(env, slot->languageConfidence));
+		o.Set("language", language);
+	}
+	if (channel->Config().timestamps) {
+		o.Set("sampleIndex", Napi::Number::New(env, (double)slot->sampleIndex));
+		o.Set("captureTimeMs", Napi::Number::New(env, slot->timeNs / 1e6));
+		Napi::Object trace = Napi::Object::New(env);
+		trace.Set("id", Napi::Number::New(env, (double)slot->traceId));
+		trace.Set("processedMs", Napi::Number::New(env, slot->processedNs / 1e6));
+		trace.Set("queuedMs", Napi::Number::New(env, slot->queuedNs / 1e6));
+		trace.Set("deliveredMs", Napi::Number::New(env, DeviceClockNs() / 1e6));
+		o.Set("trace", trace);
+	}
+	o.Set("wav", WrapPcmSlot(env, channel, slot, slot->size)); // last: the slot may be back in the pool
+	return o;
+}
+
+// Copied: a stream's data is small, and its chunk slot is back in the pool
+// for the chunk that ends the utterance.
+inline Napi::Object UtteranceStreamToJs(Napi::Env env, PcmChannel* channel, PcmSlot* slot) {
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("type", Napi::String::New(env, "chunk-stream"));
+	o.Set("id", Napi::Number::New(env, slot->streamId));
+	o.Set("seq", Napi::Number::New(env, slot->streamSeq));
+	o.Set("format", Napi::String::New(env, channel->Config().chunker.stream.opus ? "ogg" : "pcm16"));
+	o.Set("sampleRate", Napi::Number::New(env, channel->Config().sampleRate));
+	o.Set("data", Napi::Buffer<uint8_t>::Copy(env, slot->bytes.data(), slot->size));
+	o.Set("end", Napi::Boolean::New(env, slot->streamEnd));
+	o.Set("aborted", Napi::Boolean::New(env, slot->streamAborted));
+	o.Set("sampleIndex", Napi::Number::New(env, (double)slot->sampleIndex));
+	channel->Release(slot);
+	return o;
+}
+
+inline void DeliverPcmSlot(Napi::Env env, PcmCalls& calls, PcmChannel* channel, PcmSlot* slot) {
+	if (slot->marker == PcmMarker::Stream) {
+		calls.Event(UtteranceStreamToJs(env, channel, slot));
+		return;
+	}
+	if (slot->chunk) {
+		calls.Event(UtteranceChunkToJs(env, channel, slot));
+		return;
+	}
+	if (slot->marker != PcmMarker::None) {
+		Napi::Object o = Napi::Object::New(env);
+		if (slot->marker == PcmMarker::Keyword) {
+			const KeywordSpotterConfig& keyword = channel->Config().keyword;
+			o.Set("type", Napi::String::New(env, "keyword"));
+			o.Set("keyword", Napi::String::New(env, keyword.model->names[slot->keyword]));
+			o.Set("score", Napi::Number::New(env, slot->keywordScore));
+			o.Set("windowMs", Napi::Number::New(env, keyword.windowMs));
+		} else {
+			o.Set("type", Napi::String::New(env, slot->marker == PcmMarker::SilenceStart ? "silence-start" : "silence-end"));
+		}
+		o.Set("sampleIndex", Napi::Number::New(env, (double)slot->sampleIndex));
+		if (slot->marker == PcmMarker::SilenceEnd) o.Set("silentMs", Napi::Number::New(env, slot->silentMs));
+		channel->Release(slot);
+		calls.Event(o);
+		return;
+	}
+	const size_t size = slot->size;
+	// The slot may be back in the pool once wrapped
+	const uint32_t speech = slot->speech;
+	const uint64_t sampleIndex = slot->sampleIndex, timeNs = slot->timeNs;
+	PlatformTraceMark(TraceMark::Dequeue, sampleIndex);
+	SharedLatencyProbe().Delivered(channel, sampleIndex);
+	Napi::Buffer<uint8_t> buffer = WrapPcmSlot(env, channel, slot, size);
+	CallWithPacket(env, calls, channel, PcmPacketValue(env, channel->Format(), buffer, size), speech, sampleIndex, timeNs);
+}
+
+inline Napi::Object PcmFormatToJs(Napi::Env env, const PcmChannelConfig& c) {
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("type", Napi::String::New(env, "format"));
+	o.Set("sampleFormat", Napi::String::New(env, c.format == SampleFormat::Float32 ? "float32" : "pcm16"));
+	if (IsTextFormat(c.format)) o.Set("encoding", Napi::String::New(env, c.format == SampleFormat::Base64 ? "base64" : "realtime-append"));
+	o.Set("sampleRate", Napi::Number::New(env, c.sampleRate));
+	o.Set("channels", Napi::Number::New(env, 1));
+	o.Set("packetSamples", Napi::Number::New(env, c.packetSamples));
+	if (c.vad != VadMode::Off) o.Set("vadFrameSamples", Napi::Number::New(env, c.vadFrameSamples));
+	if (c.chunker.enabled) o.Set("chunker", Napi::Boolean::New(env, true));
+	if (c.dtx.enabled) o.Set("dtx", Napi::Boolean::New(env, true));
+	return o;
+}
+
+// Runs on the JS thread once per wakeup and delivers everything queued; env is
+// null when the function is being torn down with packets still queued.
+inline void DrainPcmChannel(Napi::Env env, Napi::Function cb, PcmChannel* channel, void*) {
+	channel->BeginDrain();
+	if (env == nullptr || cb == nullptr) {
+		while (PcmSlot* slot = channel->Pop()) channel->Release(slot);
+		return;
+	}
+	PcmCalls calls(env, cb, channel->Config().batch);
+	if (channel->TakeFormatAnnouncement()) calls.Event(PcmFormatToJs(env, channel->Config()));
+	uint32_t inputRate = 0, inputChannels = 0;
+	const char* reason = nullptr;
+	if (channel->TakeInputFormatChange(&inputRate, &inputChannels, &reason)) {
+		Napi::Object o = PcmFormatToJs(env, channel->Config());
+		o.Set("type", Napi::String::New(env, "format-changed"));
+		o.Set("reason", Napi::String::New(env, reason));
+		o.Set("inputSampleRate", Napi::Number::New(env, inputRate));
+		o.Set("inputChannels", Napi::Number::New(env, inputChannels));
+		calls.Event(o);
+	}
+	const char* level = nullptr;
+	float load = 0.0f;
+	uint64_t qualityIndex = 0;
+	if (channel->TakeQualityChange(&level, &reason, &load, &qualityIndex)) {
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("type", Napi::String::New(env, "quality"));
+		o.Set("level", Napi::String::New(env, level));
+		o.Set("reason", Napi::String::New(env, reason));
+		o.Set("load", Napi::Number::New(env, load));
+		o.Set("sampleIndex", Napi::Number::New(env, (double)qualityIndex));
+		calls.Event(o);
+	}
+	const char* source = nullptr;
+	const char* latency = nullptr;
+	uint32_t throttleMs = 0;
+	uint64_t powerIndex = 0;
+	if (channel->TakePowerChange(&source, &level, &throttleMs, &latency, &powerIndex)) {
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("type", Napi::String::New(env, "power"));
+		o.Set("source", Napi::String::New(env, source));
+		o.Set("quality", Napi::String::New(env, level));
+		o.Set("throttleMs", Napi::Number::New(env, throttleMs));
+		o.Set("latencyMode", Napi::String::New(env, latency));
+		o.Set("sampleIndex", Napi::Number::New(env, (double)powerIndex));
+		calls.Event(o);
+	}
+	const char* step = nullptr;
+	uint64_t stalledMs = 0, stallIndex = 0;
+	if (channel->TakeStall(&step, &stalledMs, &stallIndex)) {
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("type", Napi::String::New(env, "stall"));
+		o.Set("step", Napi::String::New(env, step));
+		o.Set("stalledMs", Napi::Number::New(env, (double)stalledMs));
+		o.Set("sampleIndex", Napi::Number::New(env, (double)stallIndex));
+		calls.Event(o);
+	}
+	bool idle = false;
+	uint64_t idleMs = 0, idleIndex = 0;
+	if (channel->TakeIdle(&idle, &idleMs, &idleIndex)) {
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("type", Napi::String::New(env, "idle"));
+		o.Set("idle", Napi::Boolean::New(env, idle));
+		o.Set("idleMs", Napi::Number::New(env, (double)idleMs));
+		o.Set("sampleIndex", Napi::Number::New(env, (double)idleIndex));
+		calls.Event(o);
+	}
+	uint64_t count = 0, total = 0, sampleIndex = 0;
+	if (channel->TakeDiscontinuities(&count, &total, &sampleIndex)) {
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("type", Napi::String::New(env, "discontinuity"));
+		o.Set("count", Napi::Number::New(env, (double)count));
+		o.Set("total", Napi::Number::New(env, (double)total));
+		o.Set("sampleIndex", Napi::Number::New(env, (double)sampleIndex));
+		calls.Event(o);
+	}
+	const bool ended = channel->TakeEnd(); // before the pops, so none is left behind
+	size_t delivered = 0;
+	TraceInterval trace(TraceStage::Drain);
+	while (PcmSlot* slot = channel->Pop()) {
+		DeliverPcmSlot(env, calls, channel, slot);
+		++delivered;
+	}
+	trace.SetValue(delivered);
+	trace.End();
+	if (ended) {
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("type", Napi::String::New(env, "end"));
+		calls.Event(o);
+	} else if (delivered == 0) {
+		channel->CountUnderrun();
+	}
+	calls.Flush();
+}
+
+inline Napi::Object DeliveryStatsToJs(Napi::Env env, const PcmDeliveryStats& d) {
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("copied", Napi::Number::New(env, (double)d.copied));
+	o.Set("zeroCopy", Napi::Number::New(env, (double)d.zeroCopy));
+	o.Set("bytes", Napi::Number::New(env, (double)d.bytes));
+	o.Set("slotsInUse", Napi::Number::New(env, (double)d.slotsInUse));
+	o.Set("slotsTotal", Napi::Number::New(env, (double)d.slotsTotal));
+	o.Set("queued", Napi::Number::New(env, (double)d.queued));
+	o.Set("capacity", Napi::Number::New(env, (double)d.capacity));
+	o.Set("highWater", Napi::Number::New(env, (double)d.highWater));
+	o.Set("overflows", Napi::Number::New(env, (double)d.overflows));
+	o.Set("dropped", Napi::Number::New(env, (double)d.dropped));
+	o.Set("coalesced", Napi::Number::New(env, (double)d.coalesced));
+	o.Set("underruns", Napi::Number::New(env, (double)d.underruns));
+	o.Set("contentDropped", Napi::Number::New(env, (double)d.contentDropped));
+	o.Set("selfEchoMs", Napi::Number::New(env, (double)d.selfEchoMs));
+	o.Set("clicksMasked", Napi::Number::New(env, (double)d.clicksMasked));
+	return o;
+}
+
+using PcmTsfn = Napi::TypedThreadSafeFunction<PcmChannel, void, DrainPcmChannel>;
+
+// The channel's initial reference belongs to the ThreadSafeFunction and is
+// dropped by its finalizer. At most one wakeup is ever queued.
+inline PcmTsfn CreatePcmTsfn(Napi::Env env, Napi::Function cb, const PcmChannelConfig& config) {
+	return PcmTsfn::New(env, cb, "PCMCallback", 2, 1, new PcmChannel(config),
+		[](Napi::Env, PcmChannel* channel) { channel->Unref(); });
+}
+
+// Capture thread: queue a filled slot and wake JS if nothing is scheduled yet.
+inline void SubmitPcmSlot(const PcmTsfn& tsfn, PcmChannel* channel, PcmSlot* slot) {
+	if (PcmChunkSink* sink = channel->ChunkSink()) {
+		if (slot->chunk && slot->marker == PcmMarker::None) sink->Chunk(channel, slot);
+		else channel->Release(slot);
+		return;
+	}
+	if (slot->traceId != 0) slot->queuedNs = DeviceClockNs();
+	const bool wake = channel->Push(slot);
+	PlatformTraceMark(TraceMark::Enqueue, channel->Queued());
+	if (wake && tsfn.NonBlockingCall() != napi_ok) channel->CancelWake();
+}
+
+// Capture thread: report a mid-stream device format change to JS.
+inline void NotifyInputFormatChange(const PcmTsfn& tsfn, PcmChannel* channel, uint32_t sampleRate, uint32_t channels, const char* reason) {
+	if (channel->PostInputFormatChange(sampleRate, channels, reason) && tsfn.NonBlockingCall() != napi_ok) channel->CancelWake();
+}
+
+// Capture thread: report a quality governor step to JS.
+inline void NotifyQualityChange(const PcmTsfn& tsfn, PcmChannel* channel, const char* level, const char* reason, float load, uint64_t sampleIndex) {
+	if (channel->PostQualityChange(level, reason, load, sampleIndex) && tsfn.NonBlockingCall() != napi_ok) channel->CancelWake();
+}
+
+// Capture thread: report the power profile now in force to JS.
+inline void NotifyPowerChange(const PcmTsfn& tsfn, PcmChannel* channel, const char* source, const char* quality, uint32_t throttleMs, const char* latency, uint64_t sampleIndex) {
+	if (channel->PostPowerChange(source, quality, throttleMs, latency, sampleIndex) && tsfn.NonBlockingCall() != napi_ok) channel->CancelWake();
+}
+
+// Capture thread: report a stall watchdog step to JS.
+inline void NotifyStall(const PcmTsfn& tsfn, PcmChannel* channel, const char* step, uint64_t stalledMs, uint64_t sampleIndex) {
+	if (channel->PostStall(step, stalledMs, sampleIndex) && tsfn.NonBlockingCall() != napi_ok) channel->CancelWake();
+}
+
+// Capture thread: report option 'idle' releasing or reopening the stream to JS.
+inline void NotifyIdle(const PcmTsfn& tsfn, PcmChannel* channel, bool idle, uint64_t idleMs, uint64_t sampleIndex) {
+	if (channel->PostIdle(idle, idleMs, sampleIndex) && tsfn.NonBlockingCall() != napi_ok) channel->CancelWake();
+}
+
+// Capture thread: report input the device lost to JS.
+inline void NotifyDiscontinuity(const PcmTsfn& tsfn, PcmChannel* channel, uint64_t sampleIndex) {
+	if (channel->PostDiscontinuity(sampleIndex) && tsfn.NonBlockingCall() != napi_ok) channel->CancelWake();
+}
+
+// Capture thread, just before it releases the ThreadSafeFunction; `ended`
+// when the source ran out rather than the capture being stopped.
+inline void ClosePcmChannel(const PcmTsfn& tsfn, PcmChannel* channel, bool ended = false) {
+	if (channel->Close(ended) && tsfn.NonBlockingCall() != napi_ok) channel->CancelWake();
+}
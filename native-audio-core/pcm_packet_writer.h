@@ -0,0 +1,782 @@
+#pragma once
+
+// Turns processed 16 kHz mono float samples into packets (WAV, raw int16, raw
+// float32 or int16 as base64 text, per the channel's format) in pooled slots
+// and queues them on a PcmChannel. With frameSamples set, packets are
+// re-framed to exactly that many samples: the remainder of each capture packet
+// stays in the open slot and is completed by the next one. When the channel
+// has VAD on, the delivered samples also run through the detector and each
+// packet carries the speech bits of its frames (with option 'neuralVad', only
+// those the batched neural detector agrees are speech, neural_vad.h; with
+// 'selfEcho', none that match the TTS our render sessions played,
+// self_echo.h; with 'declick', the detectors hear isolated clicks scaled
+// down to the noise floor, transient_mask.h), and the utterance chunker (if configured) queues a WAV slot
+// for every utterance it cuts from those frames, together with the
+// pre-filter features, the loudness of its frames and how hard they should
+// be to transcribe (chunk_difficulty.h). Given the chain's pre-gate samples, the writer keeps
+// the chunker's pre-roll of them in a small ring and, at each speech onset,
+// refills the open chunk from it so the noise gate's attack never clips the
+// first syllable. With a keyword model or option 'mel' the chunker's samples
+// also feed the shared log-mel front end (log_mel.h): the keyword spotter
+// reads its frames, chunks only go out in the window a detection opens (the
+// latest one cut before it is held back in case the keyword was in it), and
+// with 'mel' each chunk's frames are left in ChunkMels() for the Whisper
+// engine. With option 'content' the same frames feed the speech / music /
+// noise classifier (content_classifier.h): each chunk carries its 100 ms
+// decisions, and chunks mostly music or noise can be dropped right here,
+// before anything downstream encodes them. With option 'languageId' they also
+// name each utterance's language from its first second (language_id.h), which
+// can raise the chunker's minimum for that utterance and rides on its chunks.
+// With option 'speaker', the speaker-change detector (speaker_change.h) cuts
+// the open chunk back at a turn boundary it finds in the frames, and chunks
+// name their speaker cluster. With chunker.stream, each utterance is also
+// encoded as it grows (utterance_stream.h) and sent ahead of its chunk in
+// chunk-stream slots, so an upload can overlap the speech. While JS watches
+// levels, the same samples also drive the overlay's band meter. Every slot is
+// stamped with its first sample's index in the stream and the capture time
+// extrapolated from the Write() that carried it. Digital silence can bypass
+// all of it once the writer is Idle(): Skip() only advances the stream index.
+// With DTX on, finished packets stop going out after the hangover and wait in
+// a short pre-roll instead, bracketed by silence markers (pcm_channel.h); the
+// VAD, chunker and meter keep running on every sample. While a latency
+// self-test plays its chirp, the capture's own stream lends its pre-gate
+// input to the probe (latency_probe.h).
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "base64.h"
+#include "chunk_difficulty.h"
+#include "content_classifier.h"
+#include "keyword_spotter.h"
+#include "language_id.h"
+#include "latency_probe.h"
+#include "latency_trace.h"
+#include "level_meter.h"
+#include "log_mel.h"
+#include "loudness.h"
+#include "neural_vad.h"
+#include "pcm_channel.h"
+#include "pcm_quantize.h"
+#include "realtime_memory.h"
+#include "self_echo.h"
+#include "simd.h"
+#include "speaker_change.h"
+#include "spectral_features.h"
+#include "transient_mask.h"
+#include "utterance_chunker.h"
+#include "utterance_stream.h"
+#include "vad.h"
+
+class PcmPacketWriter {
+public:
+	// frameSamples == 0 emits one packet per Write(). maxWriteSamples sizes the
+	// pool so steady-state writes never allocate. Only the capture's own stream
+	// meters levels. Call Discard() before the previous channel is released.
+	void Configure(PcmChannel* channel, size_t frameSamples, size_t maxWriteSamples, bool meterLevels = true) {
+		channel_ = channel;
+		open_ = nullptr;
+		filled_ = 0;
+		format_ = channel->Format();
+		sampleRate_ = channel->Config().sampleRate;
+		headerBytes_ = HeaderBytes(format_);
+		sampleBytes_ = BytesPerSample(format_);
+		text_ = IsTextFormat(format_);
+		trailerBytes_ = TrailerBytes(format_);
+		frameSamples_ = frameSamples;
+		meterLevels_ = meterLevels;
+		levels_.Configure((float)sampleRate_);
+		vad_.Configure((float)sampleRate_, channel->Config().vadFrameSamples, channel->Config().vad);
+		// The neural model runs at 16 or 8 kHz; a subscriber at another rate keeps the DSP detector alone
+		const NeuralVadConfig& neural = channel->Config().neuralVad;
+		neural_ = vad_.Enabled() && neural.model && (sampleRate_ == 16000 || sampleRate_ == 8000)
+		          ? NeuralVad().Open(neural, sampleRate_) : nullptr;
+		selfEcho_.Configure(vad_.Enabled() ? channel->Config().selfEcho : SelfEchoConfig(), sampleRate_);
+		declick_.Configure(vad_.Enabled() ? channel->Config().declick : TransientMaskConfig(), sampleRate_, frameSamples);
+		speech_ = 0;
+		vadFrame_ = 0;
+		openPeak_ = 0.0f;
+		dtx_ = channel->Config().dtx;
+		hangoverSamples_ = (uint64_t)sampleRate_ * dtx_.hangoverMs / 1000;
+		prerollSamples_ = (size_t)sampleRate_ * dtx_.prerollMs / 1000;
+		activePeak_ = std::pow(10.0f, dtx_.thresholdDb / 20.0f);
+		silentSamples_ = 0;
+		suppressed_ = false;
+		suppressedFrom_ = 0;
+		heldHead_ = 0;
+		heldCount_ = 0;
+		heldSamples_ = 0;
+		written_ = 0;
+		anchorIndex_ = 0;
+		anchorNs_ = 0;
+		skipping_ = false;
+		const uint32_t vadFrameSamples = channel->Config().vadFrameSamples;
+		chunker_.Configure(vad_.Enabled() ? channel->Config().chunker : UtteranceChunkerConfig(),
+		                   vadFrameSamples, vadFrameSamples * 1000 / sampleRate_);
+		// Pre-roll packets are the re-framed size, or about one 10 ms capture buffer
+		const size_t held = dtx_.enabled ? std::min(kMaxHeld, prerollSamples_ / (frameSamples ? frameSamples : sampleRate_ / 100) + 2) : 0;
+		channel_->Reserve(SlotBytes(std::max(frameSamples, maxWriteSamples)), held);
+		features_.Configure(sampleRate_, chunker_.Enabled() ? vadFrameSamples : 0,
+		                    chunker_.Enabled() ? chunker_.MaxChunkSamples() / vadFrameSamples : 0);
+		// One 400 ms gating block per 100 ms sub-block of the longest chunk
+		chunkLoudness_.Configure((float)sampleRate_, chunker_.Enabled() ? chunker_.MaxChunkSamples() * 10 / sampleRate_ + 1 : 0);
+		// The open chunk after an onset: the chunker's pre-roll and the onset frame
+		const uint32_t prerollMs = chunker_.Enabled() ? channel->Config().chunker.prerollMs : 0;
+		const size_t rollFrames = prerollMs > 0 ? (prerollMs * sampleRate_ / 1000 + vadFrameSamples - 1) / vadFrameSamples + 1 : 0;
+		roll_.assign(rollFrames * vadFrameSamples, 0);
+		rollFrom_ = 0;
+		if (chunker_.Enabled()) {
+			channel_->ReserveChunks(kWavHeaderBytes + chunker_.MaxChunkSamples() * sizeof(int16_t),
+			                        2 + (channel_->ChunkSink() ? channel_->ChunkSink()->MaxHeld() : 0));
+		}
+		keyword_.Configure(sampleRate_, chunker_.Enabled() ? channel->Config().keyword : KeywordSpotterConfig());
+		keywordWindow_ = (uint64_t)sampleRate_ * channel->Config().keyword.windowMs / 1000;
+		listenFrom_ = listenUntil_ = 0;
+		// A chunk held back for a keyword window would leave its stream dangling
+		const bool stream = chunker_.Enabled() && !keyword_.Enabled() && channel->Config().chunker.stream.enabled;
+		stream_.Configure(stream ? channel->Config().chunker : UtteranceChunkerConfig(), sampleRate_);
+		streamInterval_ = (uint64_t)sampleRate_ * channel->Config().chunker.stream.intervalMs / 1000;
+		streamed_ = 0;
+		// The chunk and the stream slots ahead of it, which JS hands back on delivery
+		if (stream_.Enabled()) channel_->ReserveChunks(kWavHeaderBytes + chunker_.MaxChunkSamples() * sizeof(int16_t), 4);
+		// Whisper's frames are 16 kHz ones; with 'mel' the ring covers the longest chunk
+		keepMel_ = chunker_.Enabled() && channel->Config().mel && sampleRate_ == 16000;
+		// A decision per 100 ms of the longest chunk, and its overlap's
+		content_.Configure(sampleRate_, chunker_.Enabled() ? channel->Config().content : ContentClassifierConfig(),
+		                   chunker_.MaxChunkSamples() / (LogMelFrontEnd::kHop * ContentClassifier::kSegmentFrames) + 2);
+		language_.Configure(sampleRate_, chunker_.Enabled() ? channel->Config().languageId : LanguageIdConfig());
+		speaker_.Configure(sampleRate_, chunker_.Enabled() ? channel->Config().speaker : SpeakerChangeConfig());
+		heardSpeech_ = false;
+		keepSamples_ = 0;
+		const bool frames = keyword_.Enabled() || content_.Enabled() || language_.Enabled() || speaker_.Enabled();
+		mel_.Configure(keepMel_ ? chunker_.MaxChunkSamples() / LogMelFrontEnd::kHop + 4 : frames ? 4 : 0);
+		if (keepMel_) ChunkMels().Reserve(chunker_.MaxChunkSamples() / LogMelFrontEnd::kHop + 1);
+		spotted_ = mel_.NextFrame();
+		classified_ = mel_.NextFrame();
+		identified_ = mel_.NextFrame();
+		tracked_ = mel_.NextFrame();
+		melClean_ = 0;
+	}
+
+	// Capture thread. samples[0] was captured at timeNs on the device clock (0
+	// when unknown). preGate, when given, holds the same samples before the
+	// noise gate at the same level (VoiceChain::PreGateTapped()). Returns the
+	// number of packets queued; *grew is set if a slot had to be allocated or
+	// enlarged.
+	size_t Write(const PcmTsfn& tsfn, const float* samples, size_t count, uint64_t timeNs, float gain, bool* grew,
+	             const float* preGate = nullptr) {
+		if (!preGate) rollFrom_ = written_ + count;
+		const uint32_t levelRate = meterLevels_ ? AudioLevelSink().RateHz() : 0;
+		if (levelRate > 0 && levels_.Process(samples, count, gain, sampleRate_ / levelRate)) AudioLevelSink().Publish(levels_.Frame());
+		anchorIndex_ = written_;
+		anchorNs_ = timeNs;
+		skipping_ = false;
+		if (meterLevels_ && sampleRate_ == LatencyProbe::kRate) {
+			SharedLatencyProbe().Listen(channel_, preGate ? preGate : samples, count, written_, timeNs);
+		}
+		if (frameSamples_ == 0) {
+			PcmSlot* slot = AcquirePacket(count, grew);
+			Stamp(slot, written_);
+			Store(slot, 0, samples, count, gain);
+			written_ += count;
+			Finish(tsfn, slot, count);
+			return 1;
+		}
+		size_t queued = 0;
+		while (count > 0) {
+			if (!open_) {
+				open_ = AcquirePacket(frameSamples_, grew);
+				filled_ = 0;
+				Stamp(open_, written_);
+			}
+			const size_t n = std::min(count, frameSamples_ - filled_);
+			Store(open_, filled_, samples, n, gain);
+			if (vad_.Enabled()) Detect(tsfn, samples, preGate, n, gain, grew);
+			samples += n;
+			if (preGate) preGate += n;
+			count -= n;
+			filled_ += n;
+			written_ += n;
+			if (filled_ == frameSamples_) {
+				Finish(tsfn, open_, frameSamples_);
+				open_ = nullptr;
+				++queued;
+			}
+		}
+		return queued;
+	}
+
+	// No partial packet and no utterance in the making: skipping samples now
+	// loses nothing but the gap itself.
+	bool Idle() const { return !open_ && (!chunker_.Enabled() || chunker_.Idle()); }
+
+	// Capture thread, while Idle(): count samples of silence starting at timeNs
+	// that are never delivered. The level meter drops to silence once.
+	void Skip(size_t count, uint64_t timeNs) {
+		if (!skipping_ && meterLevels_) {
+			levels_.Reset();
+			if (AudioLevelSink().RateHz() > 0) AudioLevelSink().Publish(LevelFrame());
+		}
+		skipping_ = true;
+		ReleaseHeld(); // stale once the stream has moved past a gap
+		anchorIndex_ = written_;
+		anchorNs_ = timeNs;
+		written_ += count;
+		rollFrom_ = written_;
+		ResetFrames();
+	}
+
+	// Stream index of the next sample written or skipped.
+	uint64_t NextIndex() const { return written_; }
+
+	// Capture thread: analyse the spectrum of every stride-th VAD frame for
+	// chunk features (the quality governor's SparseFeatures level).
+	void SetFeatureStride(uint32_t stride) { features_.SetStride(stride); }
+
+	// Drops a partially filled frame (end of capture).
+	void Discard() {
+		if (open_) channel_->Release(open_);
+		open_ = nullptr;
+		ReleaseHeld();
+		suppressed_ = false;
+		silentSamples_ = 0;
+		filled_ = 0;
+		vad_.Reset();
+		if (neural_) neural_->Reset();
+		selfEcho_.Reset();
+		declick_.Reset();
+		chunker_.Reset();
+		stream_.Abort(); // its parts just end; JS drops them at stop
+		streamChunk_ = 0;
+		features_.Reset();
+		chunkLoudness_.Reset();
+		difficulty_.ResetStream();
+		levels_.Reset();
+		speech_ = 0;
+		vadFrame_ = 0;
+		rollFrom_ = written_;
+		ResetFrames();
+		ReleaseUnheard();
+	}
+
+private:
+	static constexpr size_t kMaxHeld = 64; // pre-roll slots
+	static constexpr uint32_t kMinTurnChunkMs = 500; // less of a turn before a speaker change rides with the next one
+
+	// A slot for a packet of up to `samples`, which Store() writes at rawAt_.
+	PcmSlot* AcquirePacket(size_t samples, bool* grew) {
+		PcmSlot* slot = channel_->Acquire(SlotBytes(samples), grew);
+		slot->marker = PcmMarker::None; // the pool recycles marker slots too
+		rawAt_ = RawOffset(samples);
+		return slot;
+	}
+
+	// A text packet's int16 samples wait past room for their encoding and
+	// envelope until Finish() encodes them to the front of the slot.
+	size_t RawOffset(size_t samples) const {
+		return text_ ? headerBytes_ + Base64Length(samples * sizeof(int16_t)) + trailerBytes_ : headerBytes_;
+	}
+	size_t SlotBytes(size_t samples) const { return RawOffset(samples) + samples * sampleBytes_; }
+
+	// Capture time of stream sample `index`, from the latest Write()
+	uint64_t TimeOf(uint64_t index) const {
+		if (anchorNs_ == 0) return 0;
+		const double ns = (double)anchorNs_ + ((double)index - (double)anchorIndex_) * 1e9 / sampleRate_;
+		return ns > 0.0 ? (uint64_t)ns : 0;
+	}
+
+	void Stamp(PcmSlot* slot, uint64_t index) const {
+		slot->sampleIndex = index;
+		slot->timeNs = TimeOf(index);
+	}
+
+	void Store(PcmSlot* slot, size_t at, const float* samples, size_t count, float gain) {
+		if (dtx_.enabled && !vad_.Enabled()) {
+			float peak = 0.0f;
+			for (size_t i = 0; i < count; ++i) peak = std::max(peak, std::fabs(samples[i]));
+			openPeak_ = std::max(openPeak_, peak * gain);
+		}
+		uint8_t* payload = slot->bytes.data() + rawAt_;
+		if (format_ == SampleFormat::Float32) ScaleToFloat32(samples, count, gain, reinterpret_cast<float*>(payload) + at);
+		else QuantizeToInt16(samples, count, gain, reinterpret_cast<int16_t*>(payload) + at);
+	}
+
+	void Finish(const PcmTsfn& tsfn, PcmSlot* slot, size_t samples) {
+		uint32_t payloadBytes = (uint32_t)(samples * sampleBytes_);
+		if (format_ == SampleFormat::Wav) WriteWavHeader(slot->bytes.data(), sampleRate_, 1, payloadBytes);
+		if (text_) {
+			char* text = reinterpret_cast<char*>(slot->bytes.data());
+			memcpy(text, kRealtimeAppendPrefix, headerBytes_);
+			payloadBytes = (uint32_t)Base64Encode(slot->bytes.data() + rawAt_, samples * sizeof(int16_t), text + headerBytes_);
+			memcpy(text + headerBytes_ + payloadBytes, kRealtimeAppendSuffix, trailerBytes_);
+			slot->samples = (uint32_t)samples;
+		}
+		slot->size = headerBytes_ + payloadBytes + trailerBytes_;
+		slot->speech = speech_;
+		const bool active = vad_.Enabled() ? speech_ != 0 : openPeak_ >= activePeak_;
+		speech_ = 0;
+		vadFrame_ = 0;
+		openPeak_ = 0.0f;
+		if (dtx_.enabled && !Transmit(tsfn, slot, samples, active)) return;
+		SubmitPcmSlot(tsfn, channel_, slot);
+	}
+
+	// DTX. Returns true when the finished packet goes out now; otherwise it has
+	// joined the pre-roll.
+	bool Transmit(const PcmTsfn& tsfn, PcmSlot* slot, size_t samples, bool active) {
+		if (active) {
+			silentSamples_ = 0;
+			if (suppressed_) {
+				suppressed_ = false;
+				const uint64_t resumeAt = heldCount_ > 0 ? held_[heldHead_]->sampleIndex : slot->sampleIndex;
+				SubmitMarker(tsfn, PcmMarker::SilenceEnd, resumeAt,
+				             (uint32_t)((resumeAt - suppressedFrom_) * 1000 / sampleRate_));
+				for (; heldCount_ > 0; --heldCount_) {
+					SubmitPcmSlot(tsfn, channel_, held_[heldHead_]);
+					heldHead_ = (heldHead_ + 1) % kMaxHeld;
+				}
+				heldSamples_ = 0;
+			}
+			return true;
+		}
+		if (!suppressed_) {
+			silentSamples_ += samples;
+			if (silentSamples_ <= hangoverSamples_) return true;
+			suppressed_ = true;
+			suppressedFrom_ = slot->sampleIndex;
+			SubmitMarker(tsfn, PcmMarker::SilenceStart, suppressedFrom_, 0);
+		}
+		// Keep the newest prerollMs (at least this packet); older ones go back
+		if (heldCount_ == kMaxHeld) DropOldestHeld();
+		held_[(heldHead_ + heldCount_++) % kMaxHeld] = slot;
+		heldSamples_ += samples;
+		while (heldCount_ > 1 && heldSamples_ - PayloadSamples(held_[heldHead_]) >= prerollSamples_) DropOldestHeld();
+		return false;
+	}
+
+	void SubmitMarker(const PcmTsfn& tsfn, PcmMarker marker, uint64_t sampleIndex, uint32_t silentMs) {
+		bool grew = false; // the pool's spare slots cover markers
+		PcmSlot* slot = channel_->Acquire(0, &grew);
+		slot->size = 0;
+		slot->speech = 0;
+		slot->marker = marker;
+		slot->silentMs = silentMs;
+		Stamp(slot, sampleIndex);
+		SubmitPcmSlot(tsfn, channel_, slot);
+	}
+
+	size_t PayloadSamples(const PcmSlot* slot) const { return text_ ? slot->samples : (slot->size - headerBytes_) / sampleBytes_; }
+
+	void DropOldestHeld() {
+		heldSamples_ -= PayloadSamples(held_[heldHead_]);
+		channel_->Release(held_[heldHead_]);
+		heldHead_ = (heldHead_ + 1) % kMaxHeld;
+		--heldCount_;
+	}
+
+	void ReleaseHeld() {
+		while (heldCount_ > 0) DropOldestHeld();
+		heldSamples_ = 0;
+	}
+
+	// VAD over samples just stored in the open packet; with the chunker on, frame
+	// by frame so each decision closes the chunker's copy of the same frame.
+	void Detect(const PcmTsfn& tsfn, const float* samples, const float* preGate, size_t count, float gain, bool* grew) {
+		if (!chunker_.Enabled()) {
+			const uint32_t frame = vadFrame_;
+			const float* heard = Declick(samples, count, gain);
+			vad_.Process(heard, count, gain, &speech_, &vadFrame_);
+			if (neural_) {
+				neural_->Push(heard, count, gain);
+				if (!neural_->Speech()) Veto(frame, vadFrame_);
+			}
+			if (selfEcho_.Enabled()) GuardSelfEcho(samples, count, written_, frame);
+			return;
+		}
+		uint64_t at = written_; // stream index of samples[0]
+		while (count > 0) {
+			const size_t n = std::min(count, chunker_.FrameRoom());
+			const uint32_t frame = vadFrame_;
+			const float* heard = Declick(samples, n, gain);
+			vad_.Process(heard, n, gain, &speech_, &vadFrame_);
+			if (neural_) {
+				neural_->Push(heard, n, gain);
+				if (!neural_->Speech()) Veto(frame, vadFrame_);
+			}
+			if (selfEcho_.Enabled()) GuardSelfEcho(samples, n, at, frame);
+			int16_t* quantized = chunker_.Extend(n);
+			QuantizeToInt16(samples, n, gain, quantized);
+			features_.Push(quantized, n);
+			chunkLoudness_.Push(samples, n, gain);
+			difficulty_.Push(preGate ? preGate : samples, n, gain, quantized);
+			if (mel_.Enabled()) mel_.Push(quantized, n);
+			if (preGate && !roll_.empty()) Roll(preGate, n, at, gain);
+			at += n;
+			if (keyword_.Enabled() && mel_.Enabled()) Spot(tsfn, at);
+			if (content_.Enabled() && mel_.Enabled()) Classify();
+			if (language_.Enabled() && mel_.Enabled()) Identify();
+			if (speaker_.Enabled() && mel_.Enabled()) Track();
+			if (vadFrame_ != frame) {
+				const bool speech = ((speech_ >> frame) & 1) != 0;
+				if (speech) keyword_.NoteSpeech();
+				heardSpeech_ = speech;
+				difficulty_.EndFrame(speech);
+				if (speaker_.Enabled()) chunker_.SelectSpeaker(speaker_.Speaker());
+				bool cut = chunker_.EndFrame(speech, language_.MinChunkMs(channel_->MinChunkMs()), speech && vad_.Voiced());
+				// A max-length cut (adaptive or valleyMs) may land a few frames back, in a dip
+				if (cut) keepSamples_ = (size_t)chunker_.KeepFrames() * channel_->Config().vadFrameSamples;
+				uint64_t turnFrame = 0;
+				const bool turn = speaker_.Enabled() && speaker_.TakeChange(&turnFrame);
+				if (turn && !cut) cut = CutAtTurn(at, turnFrame);
+				// An utterance runs from its first speech until the chunker has nothing left of it
+				if (language_.Enabled() && chunker_.Speaking() && !language_.Started()) language_.Begin(mel_.NextFrame());
+				if (chunker_.TakeOnset()) Preroll(at);
+				if (stream_.Enabled()) Stream(tsfn, at, cut, grew);
+				if (cut) EmitChunk(tsfn, at - keepSamples_, grew);
+				else if (chunker_.OpenFrames() == 0) { // chunker dropped the open chunk
+					features_.Reset();
+					chunkLoudness_.Reset();
+					difficulty_.Reset();
+				}
+				// A new speaker may speak another language
+				if (language_.Started() && (chunker_.Idle() || turn)) language_.End();
+			}
+			samples += n;
+			if (preGate) preGate += n;
+			count -= n;
+		}
+	}
+
+	// What the detectors hear of samples: with option 'declick', a copy with
+	// isolated clicks scaled down to the noise floor.
+	const float* Declick(const float* samples, size_t n, float gain) {
+		if (!declick_.Enabled()) return samples;
+		const float* heard = declick_.Process(samples, n, gain);
+		if (const uint32_t clicks = declick_.TakeClicks()) channel_->CountClicks(clicks);
+		return heard;
+	}
+
+	// The neural detector's latest verdict is no speech: frames [from, to) of
+	// the open packet are not speech whatever the DSP detector said.
+	void Veto(uint32_t from, uint32_t to) {
+		for (uint32_t f = from; f < to && f < 32; ++f) speech_ &= ~(1u << f);
+	}
+
+	// Samples [at, at + n) just ran through the DSP detector from VAD frame
+	// `from`; while they are our own speech played back, its frames are vetoed.
+	void GuardSelfEcho(const float* samples, size_t n, uint64_t at, uint32_t from) {
+		selfEcho_.Push(samples, n, TimeOf(at));
+		if (!selfEcho_.Self()) return;
+		Veto(from, vadFrame_);
+		channel_->CountSelfEcho(n);
+	}
+
+	// Pre-gate samples [at, at + n) into the ring, by stream index.
+	void Roll(const float* preGate, size_t n, uint64_t at, float gain) {
+		const size_t size = roll_.size();
+		for (size_t done = 0; done < n;) {
+			const size_t i = (size_t)((at + done) % size);
+			const size_t len = std::min(n - done, size - i);
+			QuantizeToInt16(preGate + done, len, gain, roll_.data() + i);
+			done += len;
+		}
+	}
+
+	// Speech onset at stream index end: the open chunk (trimmed to its pre-roll)
+	// takes the ungated samples wherever the ring still has them, and its
+	// features restart from what it now holds.
+	void Preroll(uint64_t end) {
+		int16_t* open = chunker_.OpenData();
+		const size_t samples = chunker_.OpenSamples();
+		const uint64_t start = end - samples;
+		const uint64_t from = std::max({ start, rollFrom_, end > roll_.size() ? end - roll_.size() : 0 });
+		const size_t size = roll_.size();
+		for (uint64_t i = from; i < end; ++i) open[i - start] = roll_[(size_t)(i % size)];
+		features_.Reset();
+		features_.Push(open, samples);
+		if (mel_.Enabled() && from < end) {
+			mel_.Replace(open, start, samples, from);
+			// Frames reaching back before the open chunk mix gated and ungated samples
+			melClean_ = (start + LogMelFrontEnd::kWindow / 2 + LogMelFrontEnd::kHop - 1) / LogMelFrontEnd::kHop;
+		}
+	}
+
+	// Option chunker.stream, after each frame up to stream index at: an
+	// utterance opens with the frame that finds its speech (after Preroll(), so
+	// the stream starts with the refilled samples), goes out every intervalMs
+	// and ends with the frame that cuts it; a reset in between aborts it.
+	void Stream(const PcmTsfn& tsfn, uint64_t at, bool cut, bool* grew) {
+		if (!stream_.Open()) {
+			if (!chunker_.Speaking()) return;
+			stream_.Begin(++streamIds_);
+			streamSeq_ = 0;
+			streamFrom_ = at - chunker_.OverlapSamples() - chunker_.OpenSamples();
+			stream_.Push(chunker_.OverlapData(), chunker_.OverlapSamples());
+			streamed_ = 0;
+		} else if (!cut && chunker_.OpenFrames() == 0) {
+			stream_.Abort();
+			SubmitStream(tsfn, at, false, true, grew);
+			return;
+		}
+		// The open chunk only grows once it has speech
+		stream_.Push(chunker_.OpenData() + streamed_, chunker_.OpenSamples() - streamed_);
+		streamed_ = chunker_.OpenSamples();
+		if (cut) {
+			SubmitStream(tsfn, at, true, false, grew);
+			stream_.Finish();
+			streamChunk_ = stream_.Id();
+		} else if (streamSeq_ == 0 || at - streamSent_ >= streamInterval_) {
+			SubmitStream(tsfn, at, false, false, grew);
+		}
+	}
+
+	void SubmitStream(const PcmTsfn& tsfn, uint64_t at, bool end, bool aborted, bool* grew) {
+		const size_t bytes = aborted ? 0 : stream_.Pending(end);
+		PcmSlot* slot = channel_->AcquireChunk(bytes, grew);
+		stream_.TakeTo(slot->bytes.data());
+		slot->size = bytes;
+		slot->speech = 0;
+		slot->marker = PcmMarker::Stream;
+		slot->streamId = stream_.Id();
+		slot->streamSeq = streamSeq_++;
+		slot->streamEnd = end;
+		slot->streamAborted = aborted;
+		Stamp(slot, streamFrom_);
+		streamSent_ = at;
+		SubmitPcmSlot(tsfn, channel_, slot);
+	}
+
+	// Keyword spotter over the log-mel frames completed up to stream index at.
+	void Spot(const PcmTsfn& tsfn, uint64_t at) {
+		for (; spotted_ < mel_.NextFrame(); ++spotted_) {
+			KeywordHit hit;
+			if (spotted_ >= mel_.FirstFrame() && keyword_.PushFrame(mel_.Frame(spotted_), &hit)) Listen(tsfn, hit, at);
+		}
+	}
+
+	// Content classifier over the log-mel frames completed so far.
+	void Classify() {
+		for (classified_ = std::max(classified_, mel_.FirstFrame()); classified_ < mel_.NextFrame(); ++classified_) {
+			content_.PushFrame(classified_, mel_.Frame(classified_));
+		}
+	}
+
+	// Language identifier over the log-mel frames completed so far.
+	void Identify() {
+		for (identified_ = std::max(identified_, mel_.FirstFrame()); identified_ < mel_.NextFrame(); ++identified_) {
+			language_.PushFrame(identified_, mel_.Frame(identified_));
+		}
+	}
+
+	// Speaker-change detector over the log-mel frames completed so far; a
+	// frame counts as speech when the latest VAD decision did.
+	void Track() {
+		for (tracked_ = std::max(tracked_, mel_.FirstFrame()); tracked_ < mel_.NextFrame(); ++tracked_) {
+			speaker_.PushFrame(tracked_, mel_.Frame(tracked_), heardSpeech_);
+		}
+	}
+
+	// The detector found a turn starting at stream frame turnFrame, up to
+	// stream index at: cut the open chunk there when it holds enough of the
+	// previous speaker. With chunker.stream the utterance went out past the
+	// boundary already, so it is cut where it stands.
+	bool CutAtTurn(uint64_t at, uint64_t turnFrame) {
+		if (!speaker_.Cuts() || !chunker_.Speaking()) return false;
+		const uint64_t boundary = turnFrame * LogMelFrontEnd::kHop;
+		const size_t frameSamples = channel_->Config().vadFrameSamples;
+		const uint32_t keep = stream_.Enabled() || boundary >= at ? 0 : (uint32_t)((at - boundary) / frameSamples);
+		// All of the open chunk is the new speaker's, or too little is the old one's
+		if (keep >= chunker_.OpenFrames() ||
+		    (uint64_t)(chunker_.OpenFrames() - keep) * frameSamples < (uint64_t)sampleRate_ * kMinTurnChunkMs / 1000) {
+			return false;
+		}
+		chunker_.CutBack(keep);
+		keepSamples_ = keep * frameSamples;
+		return true;
+	}
+
+	// After a gap: frames restart at the next sample written.
+	void ResetFrames() {
+		mel_.Reset(written_);
+		spotted_ = mel_.NextFrame();
+		classified_ = mel_.NextFrame();
+		identified_ = mel_.NextFrame();
+		tracked_ = mel_.NextFrame();
+		if (keyword_.Enabled()) keyword_.Reset();
+	}
+
+	// Option 'mel': the chunk's frames whose window lies inside it go to
+	// ChunkMels(); Whisper pads the chunk's edges, so it computes those itself.
+	// Chunks off its 10 ms frame grid are left to it entirely.
+	void KeepMel(const PcmSlot* slot, uint64_t end) {
+		const uint64_t start = slot->sampleIndex;
+		const size_t n = (size_t)(end - start);
+		if (start % LogMelFrontEnd::kHop != 0 || n < LogMelFrontEnd::kWindow) return;
+		const uint64_t origin = start / LogMelFrontEnd::kHop;
+		const uint64_t first = std::max({ mel_.FirstFrame(), melClean_,
+		                                  (start + LogMelFrontEnd::kWindow / 2 + LogMelFrontEnd::kHop - 1) / LogMelFrontEnd::kHop });
+		const uint64_t last = std::min(mel_.NextFrame(), (end - LogMelFrontEnd::kWindow / 2) / LogMelFrontEnd::kHop + 1);
+		if (last <= first) return;
+		const int16_t* pcm = reinterpret_cast<const int16_t*>(slot->bytes.data() + kWavHeaderBytes);
+		ChunkMels().Put(ChunkMelKey(pcm, n), n, mel_, origin, (uint32_t)(first - origin), (uint32_t)(last - first));
+	}
+
+	// Keyword heard at stream index `at`: announce it and open the window,
+	// which starts where the model's view of the keyword did.
+	void Listen(const PcmTsfn& tsfn, const KeywordHit& hit, uint64_t at) {
+		bool grew = false; // the pool's spare slots cover markers
+		PcmSlot* slot = channel_->Acquire(0, &grew);
+		slot->size = 0;
+		slot->speech = 0;
+		slot->marker = PcmMarker::Keyword;
+		slot->keyword = hit.label;
+		slot->keywordScore = hit.score;
+		Stamp(slot, at);
+		SubmitPcmSlot(tsfn, channel_, slot);
+		listenFrom_ = at > keyword_.WindowSamples() ? at - keyword_.WindowSamples() : 0;
+		listenUntil_ = at + keywordWindow_;
+		if (unheard_ && unheard_->sampleIndex + (unheard_->size - kWavHeaderBytes) / sizeof(int16_t) > listenFrom_) {
+			SubmitPcmSlot(tsfn, channel_, unheard_);
+			unheard_ = nullptr;
+		}
+		ReleaseUnheard();
+	}
+
+	void ReleaseUnheard() {
+		if (unheard_) channel_->Release(unheard_);
+		unheard_ = nullptr;
+	}
+
+	// end: stream index just past the chunk's last sample
+	void EmitChunk(const PcmTsfn& tsfn, uint64_t end, bool* grew) {
+		end -= chunker_.TrimTailSamples();
+		const uint32_t payloadBytes = (uint32_t)(chunker_.ChunkSamples() * sizeof(int16_t));
+		PcmSlot* slot = channel_->AcquireChunk(kWavHeaderBytes + payloadBytes, grew);
+		Stamp(slot, end - chunker_.ChunkSamples() - chunker_.CompactedSamples());
+		const UtteranceChunkInfo info =
+			chunker_.TakeChunk(reinterpret_cast<int16_t*>(slot->bytes.data() + kWavHeaderBytes), &slot->timeMap);
+		const bool turn = info.cut == UtteranceCut::Speaker;
+		keepSamples_ = 0;
+		WriteWavHeader(slot->bytes.data(), sampleRate_, 1, payloadBytes);
+		slot->size = kWavHeaderBytes + payloadBytes;
+		slot->cut = (uint8_t)info.cut;
+		slot->overlapSamples = info.overlapSamples;
+		slot->pauseMs = info.pauseMs;
+		slot->trimmedSamples = info.trimmedSamples;
+		slot->compactedSamples = info.compactedSamples;
+		slot->syllableRate = info.syllableRate;
+		slot->marker = PcmMarker::None; // the pool recycles stream slots too
+		slot->streamId = streamChunk_;
+		streamChunk_ = 0;
+		slot->features = features_.Take(&slot->fingerprint); // the chunk's own frames; the overlap is the previous chunk's
+		// The frames a speaker cut kept open start the next chunk's features; the
+		// loudness meter cannot give them back, so they count towards this one's
+		if (chunker_.OpenSamples() > 0) features_.Push(chunker_.OpenData(), chunker_.OpenSamples());
+		slot->lufs = chunkLoudness_.IntegratedLufs();
+		slot->peakDb = chunkLoudness_.PeakDb();
+		chunkLoudness_.Reset();
+		if (keepMel_ && info.compactedSamples == 0) KeepMel(slot, end); // its frames no longer line up with a shortened chunk's
+		slot->classified = content_.Enabled();
+		if (slot->classified) {
+			// Segments starting in the chunk; the overlap's were the previous chunk's
+			const uint64_t from = (slot->sampleIndex + info.overlapSamples) / LogMelFrontEnd::kHop;
+			content_.Take(from, end / LogMelFrontEnd::kHop, &slot->contentTimeline, &slot->content);
+			const ContentClassifierConfig& c = channel_->Config().content;
+			if ((c.dropMusic > 0.0f && slot->content.p[(int)ContentClass::Music] >= c.dropMusic) ||
+			    (c.dropNoise > 0.0f && slot->content.p[(int)ContentClass::Noise] >= c.dropNoise)) {
+				difficulty_.Reset();
+				channel_->CountContentDrop();
+				channel_->Release(slot);
+				return;
+			}
+		}
+		slot->difficulty = difficulty_.Take(slot->lufs, slot->features, slot->classified ? slot->content.p[(int)ContentClass::Music] : -1.0f);
+		slot->speaker = (int16_t)(!speaker_.Enabled() ? -1 : turn ? speaker_.Previous() : speaker_.Speaker());
+		slot->language = -1;
+		if (language_.Enabled()) {
+			language_.Finish();
+			slot->language = (int16_t)language_.Language();
+			slot->languageConfidence = language_.Confidence();
+		}
+		if (channel_->Config().timestamps) {
+			slot->traceId = NextTraceId();
+			slot->processedNs = DeviceClockNs();
+		}
+		if (keyword_.Enabled() && (end <= listenFrom_ || slot->sampleIndex >= listenUntil_)) {
+			ReleaseUnheard(); // outside any keyword window: keep only the latest
+			unheard_ = slot;
+			return;
+		}
+		SubmitPcmSlot(tsfn, channel_, slot);
+	}
+
+	PcmChannel* channel_ = nullptr;
+	SampleFormat format_ = SampleFormat::Wav;
+	uint32_t sampleRate_ = 16000;
+	size_t headerBytes_ = kWavHeaderBytes;
+	size_t sampleBytes_ = sizeof(int16_t);
+	bool text_ = false;
+	size_t trailerBytes_ = 0;
+	size_t rawAt_ = kWavHeaderBytes; // of the packet being filled
+	size_t frameSamples_ = 0;
+	PcmSlot* open_ = nullptr;
+	size_t filled_ = 0;
+	VoiceActivityDetector vad_;
+	std::shared_ptr<NeuralVadStream> neural_; // option neuralVad, batched on the shared inference thread
+	SelfEchoGuard selfEcho_;                  // option selfEcho
+	TransientMasker declick_;                 // option declick
+	uint32_t speech_ = 0;   // open packet's speech bits
+	uint32_t vadFrame_ = 0; // VAD frames completed in the open packet
+	UtteranceChunker chunker_;
+	SpectralFeatureExtractor features_; // frames of the open chunk
+	LoudnessMeter chunkLoudness_;       // same frames
+	ChunkDifficultyMeter difficulty_;   // same frames, pre-gate where known
+	BandLevelMeter levels_;
+	bool meterLevels_ = true;
+	uint64_t written_ = 0;     // samples written since Configure(): the next one's index
+	uint64_t anchorIndex_ = 0; // first sample of the latest Write()
+	uint64_t anchorNs_ = 0;    // and its capture time
+	bool skipping_ = false;    // the latest samples were skipped
+	float openPeak_ = 0.0f;    // DTX without VAD: open packet's output peak
+	DtxConfig dtx_;
+	uint64_t hangoverSamples_ = 0;
+	size_t prerollSamples_ = 0;
+	float activePeak_ = 0.0f;       // thresholdDb as a linear peak
+	uint64_t silentSamples_ = 0;    // inactive samples since the last active packet
+	bool suppressed_ = false;       // packets are being held back
+	uint64_t suppressedFrom_ = 0;   // first sample held back
+	PcmSlot* held_[kMaxHeld] = {};  // pre-roll ring, oldest at heldHead_
+	size_t heldHead_ = 0;
+	size_t heldCount_ = 0;
+	size_t heldSamples_ = 0;
+	RealtimeVector<int16_t> roll_; // pre-gate samples of the chunker's pre-roll, by stream index
+	uint64_t rollFrom_ = 0;     // first stream index the ring holds
+	LogMelFrontEnd mel_;        // over the chunker's samples, by stream frame
+	bool keepMel_ = false;      // option 'mel'
+	uint64_t melClean_ = 0;     // first frame not straddling a pre-roll refill
+	uint64_t spotted_ = 0;      // next frame for the keyword spotter
+	uint64_t classified_ = 0;   // and for the content classifier
+	ContentClassifier content_;
+	uint64_t identified_ = 0;   // and for the language identifier
+	LanguageIdentifier language_;
+	uint64_t tracked_ = 0;      // and for the speaker-change detector
+	SpeakerChangeDetector speaker_;
+	bool heardSpeech_ = false;  // the latest VAD decision, for the detector's frames
+	size_t keepSamples_ = 0;    // a speaker cut's samples that stay open
+	KeywordSpotter keyword_;
+	uint64_t keywordWindow_ = 0;
+	uint64_t listenFrom_ = 0, listenUntil_ = 0; // chunks overlapping this go out
+	PcmSlot* unheard_ = nullptr; // latest chunk cut outside it
+	UtteranceStream stream_;     // chunker.stream
+	uint64_t streamInterval_ = 0;
+	uint32_t streamIds_ = 0;     // last utterance id handed out
+	uint32_t streamSeq_ = 0;     // next slot of the open utterance
+	uint32_t streamChunk_ = 0;   // the utterance EmitChunk() is about to send
+	size_t streamed_ = 0;        // samples of the open chunk already pushed
+	uint64_t streamFrom_ = 0;    // stream index of the utterance's first sample (its overlap's)
+	uint64_t streamSent_ = 0;    // and where the latest slot went out
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+// Last step of the capture chain: processed float samples scaled by the chain's
+// output gain, clipped and stored as int16 (rounded) or float32, and the RIFF
+// header of a 16-bit WAV packet. Used by PcmPacketWriter; free of N-API.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "simd.h"
+
+inline void WriteWavHeader(uint8_t* header, uint32_t sampleRate, uint16_t channels, uint32_t pcmDataSize) {
+	memcpy(header + 0, "RIFF", 4);
+	*reinterpret_cast<uint32_t*>(header + 4) = 36 + pcmDataSize;
+	memcpy(header + 8, "WAVE", 4);
+	memcpy(header + 12, "fmt ", 4);
+	*reinterpret_cast<uint32_t*>(header + 16) = 16; // fmt chunk size
+	*reinterpret_cast<uint16_t*>(header + 20) = 1;  // PCM format
+	*reinterpret_cast<uint16_t*>(header + 22) = channels;
+	*reinterpret_cast<uint32_t*>(header + 24) = sampleRate;
+	*reinterpret_cast<uint32_t*>(header + 28) = sampleRate * channels * 2; // byte rate
+	*reinterpret_cast<uint16_t*>(header + 32) = channels * 2; // block align
+	*reinterpret_cast<uint16_t*>(header + 34) = 16; // bits per sample
+	memcpy(header + 36, "data", 4);
+	*reinterpret_cast<uint32_t*>(header + 40) = pcmDataSize;
+}
+
+inline void ScaleToFloat32(const float* in, size_t count, float gain, float* out) {
+	for (size_t i = 0; i < count; ++i) {
+		float x = in[i] * gain;
+		if (x > 1.0f) x = 1.0f; else if (x < -1.0f) x = -1.0f;
+		out[i] = x;
+	}
+}
+
+// int16 PCM coming in, to float at full scale 32768.
+inline void Int16ToFloat32(const int16_t* in, size_t count, float* out) {
+	for (size_t i = 0; i < count; ++i) out[i] = in[i] * (1.0f / 32768.0f);
+}
+
+inline void QuantizeToInt16Scalar(const float* in, size_t count, float gain, int16_t* out) {
+	for (size_t i = 0; i < count; ++i) {
+		float x = in[i] * gain;
+		if (x > 1.0f) x = 1.0f; else if (x < -1.0f) x = -1.0f;
+		int s = (int)(x * 32767.0f + (x >= 0 ? 0.5f : -0.5f));
+		if (s > 32767) s = 32767; else if (s < -32768) s = -32768;
+		out[i] = (int16_t)s;
+	}
+}
+
+inline void QuantizeToInt16(const float* in, size_t count, float gain, int16_t* out) {
+#if defined(AUDIO_CORE_ACCELERATE)
+	// Scale, clip and round-convert in stack-sized chunks
+	const float scale = gain * 32767.0f, lo = -32767.0f, hi = 32767.0f;
+	float scaled[256];
+	for (size_t at = 0; at < count; at += 256) {
+		const vDSP_Length n = (vDSP_Length)std::min<size_t>(256, count - at);
+		vDSP_vsmul(in + at, 1, &scale, scaled, 1, n);
+		vDSP_vclip(scaled, 1, &lo, &hi, scaled, 1, n);
+		vDSP_vfixr16(scaled, 1, out + at, 1, n);
+	}
+#elif defined(AUDIO_CORE_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+	// Windows on ARM and Linux arm64: clip, then round half away from zero like the scalar path
+	const float32x4_t lo = vdupq_n_f32(-1.0f), hi = vdupq_n_f32(1.0f);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const float32x4_t a = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(in + i), gain), lo), hi);
+		const float32x4_t b = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(in + i + 4), gain), lo), hi);
+		const int32x4_t qa = vcvtaq_s32_f32(vmulq_n_f32(a, 32767.0f));
+		const int32x4_t qb = vcvtaq_s32_f32(vmulq_n_f32(b, 32767.0f));
+		vst1q_s16(out + i, vcombine_s16(vqmovn_s32(qa), vqmovn_s32(qb)));
+	}
+	QuantizeToInt16Scalar(in + i, count - i, gain, out + i);
+#elif defined(AUDIO_CORE_WASM_SIMD)
+	// Renderer build (wasm/): clip, add +-0.5 by sign and truncate, as the scalar path rounds
+	const v128_t g = wasm_f32x4_splat(gain), lo = wasm_f32x4_splat(-1.0f), hi = wasm_f32x4_splat(1.0f);
+	const v128_t full = wasm_f32x4_splat(32767.0f), half = wasm_f32x4_splat(0.5f);
+	const v128_t sign = wasm_i32x4_splat((int32_t)0x80000000);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		const v128_t a = wasm_f32x4_mul(wasm_f32x4_min(wasm_f32x4_max(wasm_f32x4_mul(wasm_v128_load(in + i), g), lo), hi), full);
+		const v128_t b = wasm_f32x4_mul(wasm_f32x4_min(wasm_f32x4_max(wasm_f32x4_mul(wasm_v128_load(in + i + 4), g), lo), hi), full);
+		const v128_t qa = wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_add(a, wasm_v128_or(half, wasm_v128_and(a, sign))));
+		const v128_t qb = wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_add(b, wasm_v128_or(half, wasm_v128_and(b, sign))));
+		wasm_v128_store(out + i, wasm_i16x8_narrow_i32x4(qa, qb));
+	}
+	QuantizeToInt16Scalar(in + i, count - i, gain, out + i);
+#else
+	QuantizeToInt16Scalar(in, count, gain, out);
+#endif
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+// Reusable packet buffers handed from a capture thread to JavaScript.
+// Shared by the WASAPI and CoreAudio addons. A pool that grew while JS fell
+// behind gives its spare slots back under memory pressure (memory_budget.h).
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "chunk_difficulty.h"
+#include "content_classifier.h"
+#include "language_id.h"
+#include "memory_budget.h"
+#include "realtime_memory.h"
+#include "speaker_change.h"
+#include "spectral_features.h"
+
+// In-band events that travel through the channel's ring with the packets
+// they separate (PcmPacketWriter's DTX, keyword spotter and utterance stream).
+enum class PcmMarker : uint8_t { None, SilenceStart, SilenceEnd, Keyword, Stream };
+
+// One packet on its way to JS.
+struct PcmSlot {
+	RealtimeVector<uint8_t> bytes;
+	size_t size = 0;
+	uint32_t speech = 0; // VAD bitmap: bit i set when frame i holds speech
+	uint64_t sampleIndex = 0; // first sample's position in the stream (PcmPacketWriter)
+	uint64_t timeNs = 0;      // its capture time on the device clock, 0 when unknown
+	uint32_t samples = 0;     // text-format packets: the samples their base64 holds
+	// Utterance chunks only (see utterance_chunker.h); fixed by the pool the slot came from
+	bool chunk = false;
+	uint8_t cut = 0; // UtteranceCut
+	uint32_t overlapSamples = 0;
+	uint32_t pauseMs = 0;
+	uint32_t trimmedSamples = 0; // chunker.trimMs: non-speech left out at either end
+	uint32_t compactedSamples = 0;  // chunker.compact: left out of pauses inside it
+	std::vector<uint32_t> timeMap;  // and (chunk sample, capture sample) where it jumps
+	float syllableRate = 0.0f; // chunker.adaptive: the speaker's syllables a second, 0 while unknown
+	uint32_t streamId = 0; // the chunk-stream events that carried it ahead, 0 for none
+	SpectralFeatures features;
+	std::vector<uint32_t> fingerprint; // Haitsma-Kalker words of the chunk's frames
+	float lufs = 0.0f;   // integrated loudness
+	float peakDb = 0.0f; // sample peak, dBFS
+	ChunkDifficulty difficulty; // for cost-aware routing (chunk_difficulty.h)
+	bool classified = false;            // option 'content': the two below are set
+	ContentProbabilities content;       // mean speech / music / noise probabilities
+	std::vector<float> contentTimeline; // three per 100 ms segment
+	int16_t language = -1;              // option 'languageId': the utterance's, by model index; -1 unknown
+	float languageConfidence = 0.0f;
+	int16_t speaker = -1;               // option 'speaker': the chunk's speaker cluster; -1 unknown
+	uint64_t traceId = 0;     // latency trace (latency_trace.h), 0 when untraced
+	uint64_t processedNs = 0; // device clock: the DSP chain finished its last packet
+	uint64_t queuedNs = 0;    // and it entered the channel's ring
+	std::atomic<bool> external{false}; // currently owned by a JS external buffer
+	// DTX and keyword markers (pcm_channel.h): a zero-length stream slot carrying an event
+	PcmMarker marker = PcmMarker::None;
+	uint32_t silentMs = 0; // SilenceEnd: silence that was not delivered
+	uint32_t keyword = 0;  // Keyword: the model's label
+	float keywordScore = 0.0f;
+	uint32_t streamSeq = 0;     // Stream (a chunk slot, bytes = the encoded data): its place in streamId
+	bool streamEnd = false;     // the last of the utterance; its chunk follows
+	bool streamAborted = false; // the utterance was reset before it became a chunk
+};
+
+// Free list of slots shared by the capture thread (Acquire) and the JS thread
+// (Release). Slots are owned by the pool and never freed before it is.
+class PcmSlotPool {
+public:
+	explicit PcmSlotPool(bool chunks = false) : chunks_(chunks) {}
+
+	void Reserve(size_t count, size_t slotBytes) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		slots_.reserve(count * 2);
+		free_.reserve(count * 2);
+		while (slots_.size() < count) {
+			slots_.push_back(NewSlot());
+			free_.push_back(slots_.back().get());
+		}
+		for (auto& slot : slots_) {
+			if (slot->bytes.size() < slotBytes) slot->bytes.resize(slotBytes);
+		}
+		reserved_ = std::max(reserved_, count);
+		ChargeLocked();
+	}
+
+	// Returns a slot with at least slotBytes of storage. *grew is set when the pool
+	// had to allocate (empty free list or undersized slot).
+	PcmSlot* Acquire(size_t slotBytes, bool* grew) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		PcmSlot* slot = nullptr;
+		if (!free_.empty()) {
+			slot = free_.back();
+			free_.pop_back();
+		} else {
+			slots_.push_back(NewSlot());
+			slot = slots_.back().get();
+			if (free_.capacity() < slots_.size()) free_.reserve(slots_.capacity());
+			*grew = true;
+		}
+		if (slot->bytes.size() < slotBytes) {
+			slot->bytes.resize(slotBytes);
+			*grew = true;
+		}
+		if (*grew) ChargeLocked();
+		slot->size = slotBytes;
+		return slot;
+	}
+
+	// Pressure watch: frees free slots past the reserved count.
+	void Trim() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (slots_.size() <= reserved_) return;
+		size_t excess = slots_.size() - reserved_;
+		for (auto it = free_.begin(); it != free_.end() && excess > 0;) {
+			PcmSlot* slot = *it;
+			slots_.erase(std::find_if(slots_.begin(), slots_.end(), [slot](const std::unique_ptr<PcmSlot>& s) { return s.get() == slot; }));
+			it = free_.erase(it);
+			--excess;
+		}
+		ChargeLocked();
+	}
+
+	void Release(PcmSlot* slot) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		free_.push_back(slot);
+	}
+
+	// slotsTotal / slotsInUse
+	void Counts(uint64_t* total, uint64_t* inUse) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		*total = slots_.size();
+		*inUse = slots_.size() - free_.size();
+	}
+
+private:
+	void ChargeLocked() {
+		uint64_t bytes = 0;
+		for (const auto& slot : slots_) bytes += slot->bytes.size();
+		charge_.Set(bytes);
+	}
+
+	std::unique_ptr<PcmSlot> NewSlot() const {
+		auto slot = std::make_unique<PcmSlot>();
+		slot->chunk = chunks_;
+		return slot;
+	}
+
+	const bool chunks_;
+	std::mutex mutex_;
+	std::vector<std::unique_ptr<PcmSlot>> slots_;
+	std::vector<PcmSlot*> free_;
+	size_t reserved_ = 0;
+	MemoryCharge charge_{ MemoryKind::PcmPools };
+	MemoryTrimHook trim_{ [this] { Trim(); } }; // last: gone first
+};
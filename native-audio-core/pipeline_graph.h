@@ -0,0 +1,771 @@
+#pragma once
+
+// Native pipeline graphs, so a capture's utterances reach the local engines
+// without JS receiving every chunk only to hand it back to another addon
+// call. A pipeline is a capture subscriber (capture_subscribers.h) whose
+// channel gives its chunks to the graph instead of JS (PcmChunkSink,
+// pcm_channel.h): capture -> DSP -> VAD -> chunker run as for any subscriber,
+// and from there
+//
+//   chunk -> encode                              (the file goes to JS to upload)
+//         -> encode -> upload                    (the provider's transcript goes to JS)
+//         -> transcribe -> translate -> speak    (nothing but text reaches JS)
+//
+//   createPipeline(name, spec, callback) -> true
+//   destroyPipeline(name) -> whether it existed
+//
+// spec: {
+//   capture: the subscriber options (vad and chunker required; 16 kHz),
+//   encode?: { format: 'wav' | 'flac' | 'opus', level?, complexity?, bitrate? },
+//   upload?: { provider?, baseUrl?, apiKey, model, ... }   needs encode (http_upload.h)
+//   transcribe?: { model?, language?, translate?, prompt?, threads?, draft?, maxStaleMs? },
+//   translate?: { to, from?, beamSize? },   needs transcribe; from defaults to
+//                                           the language Whisper reports
+//   speak?: { session, voice, speakerId?, lengthScale?, sentenceSilenceMs? },
+//           needs transcribe; session is a RenderSession (render_session.h)
+//   maxPending?: chunks waiting for the graph (1..16, default 4)
+// }
+//
+// The graph reads each chunk in the capture's own pooled slot: the encoder
+// takes its 16-bit samples as they are and the transcriber converts them
+// once, finding the chunk's log-mel frames the capture kept (option 'mel' is
+// turned on). Transcription goes through the Whisper scheduler like
+// transcribeWhisper() (stream 'pipeline:<name>', maxStaleMs from the chunk's
+// capture time), translation through the CTranslate2 engine and speech
+// through the session's speak(), whose Piper voice synthesises on the
+// threadpool straight into its queue. One worker thread per pipeline takes
+// the chunks in order; past maxPending the oldest waiting one is dropped.
+// The upload node posts the encoded files from a second thread of its own
+// (http_upload.h), so a slow provider never holds up transcription; its
+// queue also keeps maxPending files, dropping the oldest. Each measured
+// throughput goes to the Opus bitrate controller (upload_rate.h) as
+// reportUploadThroughput() would.
+//
+// The callback gets the capture channel's own events (format, discontinuity,
+// idle... as subscribe() delivers them; no packets or chunks) and the graph's:
+//
+//   { type: 'encoded', format, data: Buffer, encodeMs }
+//   { type: 'uploaded', format, bytes, encodeMs, uploadMs, response }
+//       response: the provider's parsed JSON, or its text when not JSON
+//   { type: 'transcript', text, language, segments, processingMs, shed?, draft? }
+//   { type: 'translation', text, from, to, pivot, processingMs }
+//   { type: 'spoken', sentences, firstAudioMs, synthMs, audioMs, cancelled }
+//   { type: 'error', stage, message }
+//   { type: 'dropped', count }   chunks, or files waiting for the upload
+//
+// every one but 'dropped' with its chunk's sampleIndex, captureTimeMs (0 when
+// the device gave no timestamp) and durationMs.
+
+#include <napi.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "addon_instance.h"
+#include "addon_log.h"
+#include "capture_options.h"
+#include "capture_subscribers.h"
+#include "flac_chunk_encoder.h"
+#include "http_upload.h"
+#include "log_mel.h"
+#include "opus_chunk_encoder.h"
+#include "pcm_channel.h"
+#include "piper_tts_engine.h"
+#include "thread_schedule.h"
+#include "translation_engine.h"
+#include "upload_rate.h"
+#include "whisper_engine.h"
+
+constexpr uint32_t kPipelineRate = 16000;
+
+enum class PipelineEncode { None, Wav, Flac, Opus };
+
+struct PipelineConfig {
+	uint32_t maxPending = 4;
+	PipelineEncode encode = PipelineEncode::None;
+	FlacChunkConfig flac;
+	OpusChunkConfig opus;
+	bool upload = false;
+	UploadTemplate uploadTemplate;
+	bool transcribe = false;
+	WhisperJobConfig whisper;
+	std::string model;
+	WhisperDraftConfig draft;
+	uint32_t maxStaleMs = 0;
+	bool translate = false;
+	std::string from, to; // from empty: the transcript's language
+	TranslationJobConfig translation;
+	bool speak = false;
+};
+
+struct PipelineEvent {
+	enum class Type { Encoded, Uploaded, Transcript, Translation, Speak, Error, Dropped } type;
+	uint64_t sampleIndex = 0;
+	double captureTimeMs = 0;
+	double durationMs = 0;
+	std::vector<uint8_t> data; // Encoded
+	WhisperResult transcript;  // Transcript
+	std::string text;          // Uploaded (the response body), Translation, Speak
+	std::string from, to;
+	bool pivot = false;
+	double processingMs = 0;   // Encoded, Uploaded (the encode), Translation
+	uint64_t bytes = 0;        // Uploaded: the request body
+	double uploadMs = 0;
+	std::string stage, message; // Error
+	uint64_t count = 0;        // Dropped
+};
+
+class PipelineOutbox;
+inline void DrainPipelineOutbox(Napi::Env env, Napi::Function callback, PipelineOutbox* outbox, void*);
+using PipelineTsfn = Napi::TypedThreadSafeFunction<PipelineOutbox, void, DrainPipelineOutbox>;
+
+// The graph's events on their way to JS. Reference counted like PcmChannel:
+// the ThreadSafeFunction holds one reference (dropped by its finalizer) and
+// the graph another, so a late event never reaches freed memory.
+class PipelineOutbox {
+public:
+	PipelineOutbox(Napi::Env env, Napi::Function callback, const PipelineConfig& config) : encode_(config.encode) {
+		tsfn_ = PipelineTsfn::New(env, callback, "PipelineEvents", 0, 1, this, [](Napi::Env, PipelineOutbox* outbox) { outbox->Unref(); });
+		tsfn_.Unref(env); // like a subscription, never keeps the process alive
+		callback_ = Napi::Persistent(callback);
+	}
+
+	void AddRef() { refs_.fetch_add(1, std::memory_order_relaxed); }
+	void Unref() {
+		if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+	}
+
+	// JS thread, at creation: the session speak() is called on and its options.
+	void SetSpeaker(Napi::Object session, Napi::Object options) {
+		session_ = Napi::Persistent(session);
+		speakOptions_ = Napi::Persistent(options);
+	}
+
+	// Worker thread.
+	void Post(PipelineEvent event) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (closed_) return;
+		events_.push_back(std::move(event));
+		if (events_.size() == 1) tsfn_.NonBlockingCall();
+	}
+
+	// JS thread.
+	void Drain(Napi::Env env) {
+		std::vector<PipelineEvent> events;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (closed_) return;
+			events.swap(events_);
+		}
+		for (PipelineEvent& event : events) {
+			Napi::HandleScope scope(env);
+			if (event.type == PipelineEvent::Type::Speak) {
+				Speak(env, event);
+				continue;
+			}
+			if (event.type == PipelineEvent::Type::Uploaded) UploadRate(env).Report(event.bytes, event.uploadMs);
+			Emit(env, ToJs(env, event));
+		}
+	}
+
+	// JS thread: destroyPipeline() or environment teardown.
+	void Close() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (closed_) return;
+			closed_ = true;
+			events_.clear();
+		}
+		tsfn_.Release();
+		callback_.Reset();
+		session_.Reset();
+		speakOptions_.Reset();
+	}
+
+private:
+	~PipelineOutbox() = default;
+
+	Napi::Object ToJs(Napi::Env env, const PipelineEvent& event) const {
+		Napi::Object o = event.type == PipelineEvent::Type::Transcript ? WhisperResultToJs(env, event.transcript) : Napi::Object::New(env);
+		switch (event.type) {
+		case PipelineEvent::Type::Encoded:
+			o.Set("type", Napi::String::New(env, "encoded"));
+			o.Set("format", Napi::String::New(env, encode_ == PipelineEncode::Opus ? "opus" : encode_ == PipelineEncode::Flac ? "flac" : "wav"));
+			o.Set("data", Napi::Buffer<uint8_t>::Copy(env, event.data.data(), event.data.size()));
+			o.Set("encodeMs", Napi::Number::New(env, event.processingMs));
+			break;
+		case PipelineEvent::Type::Uploaded: {
+			o.Set("type", Napi::String::New(env, "uploaded"));
+			o.Set("format", Napi::String::New(env, encode_ == PipelineEncode::Opus ? "opus" : encode_ == PipelineEncode::Flac ? "flac" : "wav"));
+			o.Set("bytes", Napi::Number::New(env, (double)event.bytes));
+			o.Set("encodeMs", Napi::Number::New(env, event.processingMs));
+			o.Set("uploadMs", Napi::Number::New(env, event.uploadMs));
+			Napi::String body = Napi::String::New(env, event.text);
+			Napi::Object json = env.Global().Get("JSON").As<Napi::Object>();
+			Napi::Value parsed = json.Get("parse").As<Napi::Function>().Call(json, { body });
+			if (env.IsExceptionPending()) {
+				env.GetAndClearPendingException(); // response_format 'text', 'srt' or 'vtt'
+				parsed = body;
+			}
+			o.Set("response", parsed);
+			break;
+		}
+		case PipelineEvent::Type::Transcript:
+			o.Set("type", Napi::String::New(env, "transcript"));
+			break;
+		case PipelineEvent::Type::Translation:
+			o.Set("type", Napi::String::New(env, "translation"));
+			o.Set("text", Napi::String::New(env, event.text));
+			o.Set("from", Napi::String::New(env, event.from));
+			o.Set("to", Napi::String::New(env, event.to));
+			o.Set("pivot", Napi::Boolean::New(env, event.pivot));
+			o.Set("processingMs", Napi::Number::New(env, event.processingMs));
+			break;
+		case PipelineEvent::Type::Error:
+			o.Set("type", Napi::String::New(env, "error"));
+			o.Set("stage", Napi::String::New(env, event.stage));
+			o.Set("message", Napi::String::New(env, event.message));
+			break;
+		case PipelineEvent::Type::Dropped:
+			o.Set("type", Napi::String::New(env, "dropped"));
+			o.Set("count", Napi::Number::New(env, (double)event.count));
+			return o;
+		case PipelineEvent::Type::Speak:
+			break;
+		}
+		SetChunk(env, o, event);
+		return o;
+	}
+
+	static void SetChunk(Napi::Env env, Napi::Object o, const PipelineEvent& event) {
+		o.Set("sampleIndex", Napi::Number::New(env, (double)event.sampleIndex));
+		o.Set("captureTimeMs", Napi::Number::New(env, event.captureTimeMs));
+		o.Set("durationMs", Napi::Number::New(env, event.durationMs));
+	}
+
+	void Emit(Napi::Env env, Napi::Object event) {
+		if (callback_.IsEmpty()) return;
+		callback_.Value().Call({ event });
+		if (env.IsExceptionPending()) {
+			// Nobody awaits an event; a throwing callback is logged rather than left pending
+			env.GetAndClearPendingException();
+			AddonLog(LogLevel::Warn, "Pipeline callback threw");
+		}
+	}
+
+	// session.speak(voice, text, options); its settling becomes 'spoken' or an error.
+	void Speak(Napi::Env env, const PipelineEvent& event) {
+		Napi::Object session = session_.Value();
+		Napi::Object options = speakOptions_.Value();
+		Napi::Value speak = session.Get("speak");
+		Napi::Value result = speak.IsFunction()
+			? speak.As<Napi::Function>().Call(session, { options.Get("voice"), Napi::String::New(env, event.text), options })
+			: env.Undefined();
+		if (env.IsExceptionPending() || !result.IsObject() || !result.As<Napi::Object>().Get("then").IsFunction()) {
+			const std::string message = env.IsExceptionPending() ? env.GetAndClearPendingException().Message() : "session has no speak()";
+			PipelineEvent error;
+			error.type = PipelineEvent::Type::Error;
+			error.sampleIndex = event.sampleIndex;
+			error.captureTimeMs = event.captureTimeMs;
+			error.durationMs = event.durationMs;
+			error.stage = "speak";
+			error.message = message;
+			Emit(env, ToJs(env, error));
+			return;
+		}
+		// The handlers hold the outbox until the promise settles and they are collected
+		AddRef();
+		std::shared_ptr<PipelineOutbox> self(this, [](PipelineOutbox* outbox) { outbox->Unref(); });
+		PipelineEvent chunk;
+		chunk.sampleIndex = event.sampleIndex;
+		chunk.captureTimeMs = event.captureTimeMs;
+		chunk.durationMs = event.durationMs;
+		Napi::Function spoken = Napi::Function::New(env, [self, chunk](const Napi::CallbackInfo& info) {
+			Napi::Env env = info.Env();
+			Napi::Object o = Napi::Object::New(env);
+			if (info.Length() > 0 && info[0].IsObject()) {
+				Napi::Object r = info[0].As<Napi::Object>();
+				for (const char* key : { "sentences", "firstAudioMs", "synthMs", "audioMs", "cancelled" }) o.Set(key, r.Get(key));
+			}
+			o.Set("type", Napi::String::New(env, "spoken"));
+			SetChunk(env, o, chunk);
+			self->Emit(env, o);
+		});
+		Napi::Function failed = Napi::Function::New(env, [self, chunk](const Napi::CallbackInfo& info) {
+			Napi::Env env = info.Env();
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("type", Napi::String::New(env, "error"));
+			o.Set("stage", Napi::String::New(env, "speak"));
+			o.Set("message", info.Length() > 0 && info[0].IsObject() ? info[0].As<Napi::Object>().Get("message") : Napi::String::New(env, "speak failed"));
+			SetChunk(env, o, chunk);
+			self->Emit(env, o);
+		});
+		Napi::Object promise = result.As<Napi::Object>();
+		promise.Get("then").As<Napi::Function>().Call(promise, { spoken, failed });
+		if (env.IsExceptionPending()) env.GetAndClearPendingException();
+	}
+
+	std::atomic<int> refs_{2}; // the ThreadSafeFunction's and the graph's
+	const PipelineEncode encode_;
+	PipelineTsfn tsfn_;
+	Napi::FunctionReference callback_; // JS thread, until Close()
+	Napi::ObjectReference session_, speakOptions_;
+	std::mutex mutex_; // the two below
+	bool closed_ = false;
+	std::vector<PipelineEvent> events_;
+};
+
+inline void DrainPipelineOutbox(Napi::Env env, Napi::Function, PipelineOutbox* outbox, void*) {
+	if (env) outbox->Drain(env);
+}
+
+// The graph behind one pipeline: the channel's chunk sink and the worker
+// thread that runs each chunk through the configured nodes.
+class PipelineGraph : public PcmChunkSink, public std::enable_shared_from_this<PipelineGraph> {
+public:
+	PipelineGraph(const std::string& name, const PipelineConfig& config, PipelineOutbox* outbox)
+		: name_(name), config_(config), outbox_(outbox), pending_(config.maxPending) {}
+	~PipelineGraph() override { outbox_->Unref(); }
+
+	// JS thread, once. The workers hold the graph until Close().
+	void Start() {
+		std::thread([self = shared_from_this()] { self->Work(); }).detach();
+		if (config_.upload) std::thread([self = shared_from_this()] { self->UploadWork(); }).detach();
+	}
+
+	// JS thread: no more chunks or events; the chunk and the upload in progress finish unheard.
+	void Close() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			closed_ = true;
+			while (count_ > 0) PopLocked().Release();
+			uploads_.clear();
+		}
+		wake_.notify_one();
+		uploadWake_.notify_one();
+		outbox_->Close();
+	}
+
+	void Chunk(PcmChannel* channel, PcmSlot* slot) override {
+		channel->AddRef();
+		Held held{ channel, slot };
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (closed_) {
+				held.Release();
+				return;
+			}
+			if (count_ == pending_.size()) {
+				PopLocked().Release();
+				dropped_++;
+			}
+			pending_[(head_ + count_++) % pending_.size()] = held;
+		}
+		wake_.notify_one();
+	}
+
+	// The waiting chunks and the one being worked on
+	size_t MaxHeld() const override { return pending_.size() + 1; }
+
+private:
+	struct Held {
+		PcmChannel* channel = nullptr;
+		PcmSlot* slot = nullptr;
+
+		// Any thread; the capture's own reference keeps the channel alive on its thread.
+		void Release() {
+			if (!slot) return;
+			channel->Release(slot);
+			channel->Unref();
+			slot = nullptr;
+		}
+	};
+
+	Held PopLocked() {
+		Held held = pending_[head_];
+		head_ = (head_ + 1) % pending_.size();
+		--count_;
+		return held;
+	}
+
+	void Work() {
+		ApplyBackgroundComputeSchedule();
+		for (;;) {
+			Held held;
+			uint64_t dropped = 0;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				wake_.wait(lock, [&] { return closed_ || count_ > 0; });
+				if (closed_) return;
+				held = PopLocked();
+				dropped = dropped_;
+				dropped_ = 0;
+			}
+			if (dropped > 0) {
+				PipelineEvent event;
+				event.type = PipelineEvent::Type::Dropped;
+				event.count = dropped;
+				outbox_->Post(std::move(event));
+			}
+			Process(&held);
+		}
+	}
+
+	// The upload thread: encoded files to the provider, oldest first.
+	void UploadWork() {
+		ApplyBackgroundComputeSchedule();
+		for (;;) {
+			PipelineEvent event;
+			uint64_t dropped = 0;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				uploadWake_.wait(lock, [&] { return closed_ || !uploads_.empty(); });
+				if (closed_) return;
+				event = std::move(uploads_.front());
+				uploads_.pop_front();
+				dropped = uploadsDropped_;
+				uploadsDropped_ = 0;
+			}
+			if (dropped > 0) {
+				PipelineEvent report;
+				report.type = PipelineEvent::Type::Dropped;
+				report.count = dropped;
+				outbox_->Post(std::move(report));
+			}
+			Upload(&event);
+			outbox_->Post(std::move(event));
+		}
+	}
+
+	// Worker thread: an encoded file for the upload thread.
+	void QueueUpload(PipelineEvent&& event) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (closed_) return;
+			if (uploads_.size() == pending_.size()) {
+				uploads_.pop_front();
+				uploadsDropped_++;
+			}
+			uploads_.push_back(std::move(event));
+		}
+		uploadWake_.notify_one();
+	}
+
+	void Process(Held* held) {
+		const PcmSlot& slot = *held->slot;
+		const int16_t* samples = reinterpret_cast<const int16_t*>(slot.bytes.data() + kWavHeaderBytes);
+		const size_t n = (slot.size - kWavHeaderBytes) / sizeof(int16_t);
+		PipelineEvent chunk;
+		chunk.sampleIndex = slot.sampleIndex;
+		chunk.captureTimeMs = slot.timeNs / 1e6;
+		chunk.durationMs = n * 1000.0 / kPipelineRate;
+
+		if (config_.encode != PipelineEncode::None) {
+			PipelineEvent event = chunk;
+			if (Encode(slot, samples, n, &event)) {
+				event.type = PipelineEvent::Type::Encoded;
+				// The file has its own copy of the samples, and the transcription doesn't wait for it
+				if (config_.upload) QueueUpload(std::move(event));
+				else outbox_->Post(std::move(event));
+			} else {
+				outbox_->Post(std::move(event));
+			}
+		}
+		if (!config_.transcribe) {
+			held->Release();
+			return;
+		}
+		std::vector<float> pcm(n);
+		for (size_t i = 0; i < n; ++i) pcm[i] = samples[i] * (1.0f / 32768.0f);
+		ChunkMel mel;
+		const bool cut = ChunkMels().Find(ChunkMelKey(samples, n), n, &mel);
+		held->Release(); // back to the capture before the long part
+
+		WhisperResult result = RunWhisperJob(pcm, cut ? &mel : nullptr, config_.whisper, "pipeline:" + name_, config_.model, config_.draft,
+		                                     WhisperDeadline(chunk.captureTimeMs, config_.maxStaleMs));
+		if (!result.error.empty()) {
+			Fail(chunk, "transcribe", result.error);
+			return;
+		}
+		std::string text = TrimmedText(result.text);
+		const std::string language = result.language;
+		PipelineEvent transcript = chunk;
+		transcript.type = PipelineEvent::Type::Transcript;
+		transcript.transcript = std::move(result);
+		outbox_->Post(std::move(transcript));
+		if (text.empty()) return;
+
+		const std::string from = config_.from.empty() ? language : config_.from;
+		if (config_.translate && from != config_.to) {
+			TranslationResult translated;
+			if (!Translation().Translate({ text }, from, config_.to, config_.translation, &translated) || translated.texts.empty()) {
+				Fail(chunk, "translate", translated.error.empty() ? "translation failed" : translated.error);
+				return;
+			}
+			text = translated.texts[0];
+			PipelineEvent event = chunk;
+			event.type = PipelineEvent::Type::Translation;
+			event.text = text;
+			event.from = from;
+			event.to = config_.to;
+			event.pivot = translated.pivot;
+			event.processingMs = translated.processingMs;
+			outbox_->Post(std::move(event));
+		}
+		if (config_.speak && !text.empty()) {
+			PipelineEvent event = chunk;
+			event.type = PipelineEvent::Type::Speak;
+			event.text = std::move(text);
+			outbox_->Post(std::move(event));
+		}
+	}
+
+	// The chunk's 16-bit samples as a file; on failure *event becomes an error.
+	bool Encode(const PcmSlot& slot, const int16_t* samples, size_t n, PipelineEvent* event) {
+		const auto start = std::chrono::steady_clock::now();
+		std::string error;
+		switch (config_.encode) {
+		case PipelineEncode::Flac:
+			EncodeFlacFile(samples, n, kPipelineRate, config_.flac, &event->data);
+			break;
+		case PipelineEncode::Opus:
+#if defined(AUDIO_CORE_OPUS)
+			EncodeOggOpus(samples, n, kPipelineRate, config_.opus, &event->data, &error);
+#else
+			error = "Opus encoding is not built in (use_opus=0)";
+#endif
+			break;
+		default:
+			event->data.assign(slot.bytes.data(), slot.bytes.data() + slot.size); // already a WAV
+			break;
+		}
+		if (!error.empty()) {
+			event->type = PipelineEvent::Type::Error;
+			event->stage = "encode";
+			event->message = error;
+			event->data.clear();
+			return false;
+		}
+		event->processingMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return true;
+	}
+
+	// The encoded file to the provider; *event becomes 'uploaded' with its
+	// response, or an error.
+	void Upload(PipelineEvent* event) {
+		static const char* const kFileNames[] = { "audio.wav", "audio.wav", "audio.flac", "audio.ogg" };
+		static const char* const kMimeTypes[] = { "audio/wav", "audio/wav", "audio/flac", "audio/ogg" };
+		HttpRequest request;
+		BuildTranscriptionRequest(config_.uploadTemplate, event->data, kFileNames[(int)config_.encode], kMimeTypes[(int)config_.encode], &request);
+		event->data.clear(); // only the transcript goes back
+		event->data.shrink_to_fit();
+		const auto start = std::chrono::steady_clock::now();
+		HttpResponse response;
+		const bool answered = HttpPost(request, &response);
+		event->bytes = request.body.size();
+		event->uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (!answered || response.status < 200 || response.status >= 300) {
+			event->type = PipelineEvent::Type::Error;
+			event->stage = "upload";
+			event->message = answered ? "HTTP " + std::to_string(response.status) + ": " + response.body.substr(0, 200) : response.error;
+			return;
+		}
+		event->type = PipelineEvent::Type::Uploaded;
+		event->text = std::move(response.body);
+	}
+
+	void Fail(const PipelineEvent& chunk, const char* stage, const std::string& message) {
+		PipelineEvent event = chunk;
+		event.type = PipelineEvent::Type::Error;
+		event.stage = stage;
+		event.message = message;
+		outbox_->Post(std::move(event));
+	}
+
+	static std::string TrimmedText(const std::string& text) {
+		const size_t first = text.find_first_not_of(" \t\n");
+		if (first == std::string::npos) return std::string();
+		return text.substr(first, text.find_last_not_of(" \t\n") - first + 1);
+	}
+
+	const std::string name_;
+	const PipelineConfig config_;
+	PipelineOutbox* const outbox_; // one reference
+	std::mutex mutex_; // everything below
+	std::condition_variable wake_, uploadWake_;
+	bool closed_ = false;
+	std::vector<Held> pending_; // ring of maxPending
+	size_t head_ = 0, count_ = 0;
+	uint64_t dropped_ = 0; // since the worker last reported
+	std::deque<PipelineEvent> uploads_; // encoded, at most maxPending
+	uint64_t uploadsDropped_ = 0; // since the upload thread last reported
+};
+
+// One set of pipelines per environment; their callbacks live in it.
+struct PipelineSlot {
+	std::map<std::string, std::shared_ptr<PipelineGraph>> pipelines;
+	~PipelineSlot() {
+		for (auto& p : pipelines) {
+			CaptureSubscribers().Remove(p.first);
+			p.second->Close();
+		}
+	}
+};
+
+// spec's nodes into *config; the speak node's session and options into *session / *speak.
+inline bool ReadPipelineSpec(const Napi::Object& spec, PipelineConfig* config, Napi::Object* session, Napi::Object* speak,
+                             std::string* error) {
+	if (!ReadUint32Option(spec, "maxPending", 1, 16, &config->maxPending, error)) return false;
+	const Napi::Value encode = spec.Get("encode");
+	if (encode.IsObject()) {
+		Napi::Object obj = encode.As<Napi::Object>();
+		int format = -1;
+		if (!ReadEnumOption(obj, "format", { "wav", "flac", "opus" }, &format, error) ||
+		    !ReadUint32Option(obj, "level", 0, 2, &config->flac.level, error) ||
+		    !ReadUint32Option(obj, "complexity", 0, 10, &config->opus.complexity, error) ||
+		    !ReadUint32Option(obj, "bitrate", 6000, 320000, &config->opus.bitrate, error)) {
+			return false;
+		}
+		config->encode = format == 1 ? PipelineEncode::Flac : format == 2 ? PipelineEncode::Opus : PipelineEncode::Wav;
+	} else if (!encode.IsUndefined()) {
+		*error = "Pipeline node 'encode' must be an object";
+		return false;
+	}
+	const Napi::Value upload = spec.Get("upload");
+	if (upload.IsObject()) {
+		config->upload = true;
+		if (!ReadUploadTemplate(upload.As<Napi::Object>(), &config->uploadTemplate, error)) return false;
+	} else if (!upload.IsUndefined()) {
+		*error = "Pipeline node 'upload' must be an object";
+		return false;
+	}
+	const Napi::Value transcribe = spec.Get("transcribe");
+	if (transcribe.IsObject()) {
+		config->transcribe = true;
+		if (!ReadWhisperJobOptions(transcribe.As<Napi::Object>(), &config->whisper, &config->model, &config->draft, &config->maxStaleMs, error)) {
+			return false;
+		}
+	} else if (!transcribe.IsUndefined()) {
+		*error = "Pipeline node 'transcribe' must be an object";
+		return false;
+	}
+	const Napi::Value translate = spec.Get("translate");
+	if (translate.IsObject()) {
+		Napi::Object obj = translate.As<Napi::Object>();
+		if (!obj.Get("to").IsString()) {
+			*error = "Pipeline node 'translate' needs a target language 'to'";
+			return false;
+		}
+		config->translate = true;
+		config->to = obj.Get("to").As<Napi::String>().Utf8Value();
+		if (obj.Get("from").IsString()) config->from = obj.Get("from").As<Napi::String>().Utf8Value();
+		if (!ReadUint32Option(obj, "beamSize", 1, 16, &config->translation.beamSize, error)) return false;
+	} else if (!translate.IsUndefined()) {
+		*error = "Pipeline node 'translate' must be an object";
+		return false;
+	}
+	const Napi::Value speakNode = spec.Get("speak");
+	if (speakNode.IsObject()) {
+		Napi::Object obj = speakNode.As<Napi::Object>();
+		if (!obj.Get("session").IsObject() || !obj.Get("voice").IsString()) {
+			*error = "Pipeline node 'speak' needs a RenderSession 'session' and a 'voice'";
+			return false;
+		}
+		config->speak = true;
+		*session = obj.Get("session").As<Napi::Object>();
+		*speak = obj;
+	} else if (!speakNode.IsUndefined()) {
+		*error = "Pipeline node 'speak' must be an object";
+		return false;
+	}
+	if (config->encode == PipelineEncode::None && !config->transcribe) {
+		*error = "Pipeline needs an 'encode' or 'transcribe' node";
+		return false;
+	}
+	if (config->upload && config->encode == PipelineEncode::None) {
+		*error = "Pipeline node 'upload' needs 'encode'";
+		return false;
+	}
+	if ((config->translate || config->speak) && !config->transcribe) {
+		*error = "Pipeline nodes 'translate' and 'speak' need 'transcribe'";
+		return false;
+	}
+	return true;
+}
+
+// createPipeline(name, spec, callback) - replaces a pipeline (or subscriber)
+// of the same name.
+inline Napi::Value CreatePipeline(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 3 || !info[0].IsString() || !info[1].IsObject() || !info[2].IsFunction()) {
+		Napi::TypeError::New(env, "Pipeline name, spec and callback required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const std::string name = info[0].As<Napi::String>().Utf8Value();
+	Napi::Object spec = info[1].As<Napi::Object>();
+	CaptureOptions options;
+	std::string error;
+	if (!ParseCaptureOptions(spec.Get("capture"), &options, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (options.vad == VadMode::Off || !options.chunker.enabled) {
+		Napi::TypeError::New(env, "Pipeline option 'capture' needs vad and chunker").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	PipelineConfig config;
+	Napi::Object session, speak;
+	SpeechOptions speech;
+	if (!ReadPipelineSpec(spec, &config, &session, &speak, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (config.speak && !ReadSpeechOptions(env, speak, &speech)) return env.Null();
+	// Nothing leaves the graph as packets, and Whisper reuses the chunks' frames
+	options.format = SampleFormat::Wav;
+	options.chunker.stream.enabled = false;
+	options.mel = options.mel || config.transcribe;
+
+	PipelineOutbox* outbox = new PipelineOutbox(env, info[2].As<Napi::Function>(), config);
+	if (config.speak) outbox->SetSpeaker(session, speak);
+	auto graph = std::make_shared<PipelineGraph>(name, config, outbox);
+	PcmTsfn tsfn = CreatePcmTsfn(env, info[2].As<Napi::Function>(), options.ChannelConfig(kPipelineRate));
+	tsfn.Unref(env);
+	tsfn.GetContext()->SetChunkSink(graph);
+	graph->Start();
+
+	auto& pipelines = PerEnv<PipelineSlot>(env).pipelines;
+	auto it = pipelines.find(name);
+	if (it != pipelines.end()) it->second->Close();
+	pipelines[name] = graph;
+	CaptureSubscribers().Add(std::make_shared<CaptureSubscriber>(name, kPipelineRate, options, tsfn, env));
+	DetachAtTeardown<RemoveEnvSubscribers>(env);
+	ArmTeardown(env);
+	return Napi::Boolean::New(env, true);
+}
+
+// destroyPipeline(name) -> whether it existed. Events still queued are dropped.
+inline Napi::Value DestroyPipeline(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Pipeline name required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const std::string name = info[0].As<Napi::String>().Utf8Value();
+	auto& pipelines = PerEnv<PipelineSlot>(env).pipelines;
+	auto it = pipelines.find(name);
+	if (it == pipelines.end()) return Napi::Boolean::New(env, false);
+	CaptureSubscribers().Remove(name);
+	it->second->Close();
+	pipelines.erase(it);
+	return Napi::Boolean::New(env, true);
+}
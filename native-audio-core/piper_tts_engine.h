@@ -0,0 +1,460 @@
+#pragma once
+
+// In-process neural speech synthesis with Piper (VITS) voices on ONNX
+// Runtime, so a translated sentence is voiced on this machine in tens of
+// milliseconds instead of a round trip to a cloud TTS service. Built with gyp
+// variable use_onnxruntime=1 (AUDIO_CORE_ONNXRUNTIME); voices whose phoneme
+// type is 'espeak' (most of them) also need use_espeak=1 (AUDIO_CORE_ESPEAK,
+// links espeak-ng) to turn text into IPA. Otherwise loading rejects and
+// callers keep the cloud voices.
+//
+//   loadTtsVoice(name, { model, sampleRate, phonemeIdMap, phonemeType?, espeakVoice?, espeakData?,
+//                        noiseScale?, lengthScale?, noiseW?, speakers?, threads? })
+//     -> Promise<{ sampleRate, loadMs }>
+//   synthesizeSpeech(name, text, { speakerId?, lengthScale?, sentenceSilenceMs? })
+//     -> Promise<{ pcm: Float32Array, sampleRate, synthMs }>
+//   unloadTtsVoices() -> Promise<void>
+//   getTtsVoices() -> [name]
+//
+// The options are the fields of the voice's .onnx.json (parsed in JS):
+// audio.sample_rate, phoneme_id_map, phoneme_type, espeak.voice, inference
+// noise_scale / length_scale / noise_w and num_speakers. RenderSession's
+// speak() (render_session.h) voices text sentence by sentence straight into
+// its queue; synthesizeSpeech() returns the whole text for other players.
+//
+// As in Piper, each sentence's phonemes become ids with BOS '^' first, PAD
+// '_' after every phoneme and EOS '$' last; phonemes missing from the map
+// are skipped, and the audio is normalised to full scale. 'text' voices map
+// the characters themselves. espeak-ng is not reentrant, so phonemisation
+// is serialised; the model runs on the CPU (one Run per sentence, calls from
+// several threads side by side), which for a VITS model of this size beats
+// the upload and launch costs of a GPU provider.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "addon_log.h"
+#include "async_query.h"
+#include "capture_options.h"
+#include "mapped_file.h"
+#include "onnx_runtime.h"
+#include "sentence_split.h"
+
+#if defined(AUDIO_CORE_ESPEAK)
+#include <espeak-ng/speak_lib.h>
+#endif
+
+struct PiperVoiceConfig {
+	std::string model;
+	uint32_t sampleRate = 22050;
+	std::unordered_map<uint32_t, std::vector<int64_t>> phonemeIds; // by code point
+	bool espeak = true; // phoneme type 'espeak'; 'text' maps characters
+	std::string espeakVoice = "en-us";
+	std::string espeakData; // espeak-ng-data directory; empty for the library's default
+	float noiseScale = 0.667f, lengthScale = 1.0f, noiseW = 0.8f;
+	uint32_t speakers = 1;
+	uint32_t threads = 0; // 0: half the cores
+};
+
+struct SpeechOptions {
+	int64_t speakerId = 0;
+	float lengthScale = 0.0f;        // 0: the voice's; above 1 speaks slower
+	uint32_t sentenceSilenceMs = 200; // appended after each sentence but the last
+};
+
+// Code points of UTF-8 text; malformed bytes are skipped.
+inline void DecodeUtf8(const std::string& text, std::vector<uint32_t>* out) {
+	out->clear();
+	for (size_t i = 0; i < text.size();) {
+		const uint8_t c = (uint8_t)text[i];
+		const int extra = c < 0x80 ? 0 : (c >> 5) == 6 ? 1 : (c >> 4) == 14 ? 2 : (c >> 3) == 30 ? 3 : -1;
+		if (extra < 0 || i + extra + 1 > text.size()) {
+			++i;
+			continue;
+		}
+		uint32_t cp = extra == 0 ? c : extra == 1 ? (c & 0x1f) : extra == 2 ? (c & 0x0f) : (c & 0x07);
+		bool ok = true;
+		for (int k = 1; k <= extra; ++k) {
+			const uint8_t b = (uint8_t)text[i + k];
+			if ((b & 0xc0) != 0x80) ok = false;
+			cp = (cp << 6) | (b & 0x3f);
+		}
+		i += ok ? extra + 1 : 1;
+		if (ok) out->push_back(cp);
+	}
+}
+
+// Piper's id sequence for one sentence: ^ _ (phoneme _)* $.
+inline void PiperPhonemeIds(const std::vector<uint32_t>& phonemes,
+                            const std::unordered_map<uint32_t, std::vector<int64_t>>& map, std::vector<int64_t>* ids) {
+	ids->clear();
+	auto add = [&](uint32_t cp) {
+		auto it = map.find(cp);
+		if (it == map.end()) return false;
+		ids->insert(ids->end(), it->second.begin(), it->second.end());
+		return true;
+	};
+	add('^');
+	add('_');
+	for (uint32_t cp : phonemes) {
+		if (add(cp)) add('_');
+	}
+	add('$');
+}
+
+// Scales samples so the loudest is at full scale, as Piper does (quiet
+// output stays quiet: the gain is capped where the peak is under 0.01).
+inline void NormalizePiperAudio(std::vector<float>* pcm, size_t from) {
+	float peak = 0.01f;
+	for (size_t i = from; i < pcm->size(); ++i) peak = std::max(peak, std::fabs((*pcm)[i]));
+	const float gain = 0.98f / peak;
+	for (size_t i = from; i < pcm->size(); ++i) (*pcm)[i] *= gain;
+}
+
+class PiperTtsEngine {
+public:
+#if defined(AUDIO_CORE_ONNXRUNTIME)
+	bool Load(const std::string& name, const PiperVoiceConfig& config, double* loadMs, std::string* error) {
+		const auto start = std::chrono::steady_clock::now();
+#if !defined(AUDIO_CORE_ESPEAK)
+		if (config.espeak) {
+			*error = "espeak-ng phonemisation is not built in (use_espeak=0); only 'text' voices load";
+			return false;
+		}
+#endif
+		if (config.phonemeIds.empty()) {
+			*error = "the voice has no phoneme id map";
+			return false;
+		}
+		auto voice = std::make_shared<Voice>();
+		voice->config = config;
+		try {
+			Ort::SessionOptions options;
+			const uint32_t hw = std::thread::hardware_concurrency();
+			options.SetIntraOpNumThreads((int)(config.threads ? config.threads : std::max(1u, hw / 2)));
+			options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+#if defined(_WIN32)
+			voice->session = std::make_unique<Ort::Session>(OnnxRuntimeEnv(), WidenUtf8(config.model).c_str(), options);
+#else
+			voice->session = std::make_unique<Ort::Session>(OnnxRuntimeEnv(), config.model.c_str(), options);
+#endif
+		} catch (const Ort::Exception& e) {
+			*error = std::string("could not load the voice: ") + e.what();
+			return false;
+		}
+		*loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			voices_[name] = std::move(voice);
+		}
+		AddonLog(LogLevel::Info, "Piper voice %s loaded in %.0f ms (%u Hz)", name.c_str(), *loadMs, config.sampleRate);
+		return true;
+	}
+
+	// Threadpool thread. Appends the text's audio to pcm: every sentence,
+	// sentenceSilenceMs of silence between them.
+	bool Synthesize(const std::string& name, const std::string& text, const SpeechOptions& options,
+	                std::vector<float>* pcm, uint32_t* sampleRate, std::string* error) {
+		std::shared_ptr<Voice> voice = Find(name);
+		if (!voice) {
+			*error = "no such voice: " + name;
+			return false;
+		}
+		*sampleRate = voice->config.sampleRate;
+		const auto spans = SplitSentences(text);
+		std::vector<uint32_t> phonemes;
+		std::vector<int64_t> ids;
+		for (size_t s = 0; s < spans.size(); ++s) {
+			if (!Phonemize(voice->config, text.substr(spans[s].first, spans[s].second), &phonemes, error)) return false;
+			PiperPhonemeIds(phonemes, voice->config.phonemeIds, &ids);
+			if (ids.size() < 3) continue;
+			const size_t from = pcm->size();
+			try {
+				Run(*voice, ids, options, pcm);
+			} catch (const Ort::Exception& e) {
+				*error = std::string("synthesis failed: ") + e.what();
+				return false;
+			}
+			NormalizePiperAudio(pcm, from);
+			if (s + 1 < spans.size()) pcm->resize(pcm->size() + (size_t)voice->config.sampleRate * options.sentenceSilenceMs / 1000, 0.0f);
+		}
+		return true;
+	}
+
+	uint32_t SampleRate(const std::string& name) {
+		std::shared_ptr<Voice> voice = Find(name);
+		return voice ? voice->config.sampleRate : 0;
+	}
+
+	// Syntheses in flight finish with the voice they started with.
+	void Unload() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		voices_.clear();
+	}
+
+	std::vector<std::string> Voices() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::vector<std::string> names;
+		for (const auto& v : voices_) names.push_back(v.first);
+		return names;
+	}
+
+private:
+	struct Voice {
+		PiperVoiceConfig config;
+		std::unique_ptr<Ort::Session> session;
+	};
+
+	std::shared_ptr<Voice> Find(const std::string& name) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = voices_.find(name);
+		return it == voices_.end() ? nullptr : it->second;
+	}
+
+	static bool Phonemize(const PiperVoiceConfig& config, const std::string& sentence, std::vector<uint32_t>* phonemes,
+	                      std::string* error) {
+		if (!config.espeak) {
+			DecodeUtf8(sentence, phonemes);
+			return true;
+		}
+#if defined(AUDIO_CORE_ESPEAK)
+		static std::mutex espeakMutex;
+		static bool initialized = false;
+		static std::string currentVoice;
+		std::lock_guard<std::mutex> lock(espeakMutex);
+		if (!initialized) {
+			if (espeak_Initialize(AUDIO_OUTPUT_SYNCHRONOUS, 0, config.espeakData.empty() ? nullptr : config.espeakData.c_str(), 0) < 0) {
+				*error = "espeak-ng failed to initialise";
+				return false;
+			}
+			initialized = true;
+		}
+		if (currentVoice != config.espeakVoice) {
+			if (espeak_SetVoiceByName(config.espeakVoice.c_str()) != EE_OK) {
+				*error = "espeak-ng has no voice " + config.espeakVoice;
+				return false;
+			}
+			currentVoice = config.espeakVoice;
+		}
+		// One call per clause; clauses are joined with a space
+		std::string ipa;
+		const void* cursor = sentence.c_str();
+		while (cursor) {
+			const char* clause = espeak_TextToPhonemes(&cursor, espeakCHARS_UTF8, espeakPHONEMES_IPA);
+			if (!clause) break;
+			if (!ipa.empty()) ipa += ' ';
+			ipa += clause;
+		}
+		// The sentence's closing punctuation shapes its intonation
+		const char last = sentence.empty() ? 0 : sentence.back();
+		if (last == '.' || last == '!' || last == '?' || last == ',') ipa += last;
+		DecodeUtf8(ipa, phonemes);
+		return true;
+#else
+		*error = "espeak-ng phonemisation is not built in (use_espeak=0)";
+		return false;
+#endif
+	}
+
+	static void Run(Voice& voice, std::vector<int64_t>& ids, const SpeechOptions& options, std::vector<float>* pcm) {
+		const Ort::MemoryInfo memory = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+		const int64_t inputShape[2] = { 1, (int64_t)ids.size() };
+		int64_t length = (int64_t)ids.size();
+		const int64_t lengthShape[1] = { 1 };
+		float scales[3] = { voice.config.noiseScale, options.lengthScale > 0.0f ? options.lengthScale : voice.config.lengthScale,
+		                    voice.config.noiseW };
+		const int64_t scalesShape[1] = { 3 };
+		int64_t speaker = std::min<int64_t>(options.speakerId, (int64_t)voice.config.speakers - 1);
+		std::vector<Ort::Value> inputs;
+		inputs.push_back(Ort::Value::CreateTensor<int64_t>(memory, ids.data(), ids.size(), inputShape, 2));
+		inputs.push_back(Ort::Value::CreateTensor<int64_t>(memory, &length, 1, lengthShape, 1));
+		inputs.push_back(Ort::Value::CreateTensor<float>(memory, scales, 3, scalesShape, 1));
+		std::vector<const char*> names = { "input", "input_lengths", "scales" };
+		if (voice.config.speakers > 1) {
+			inputs.push_back(Ort::Value::CreateTensor<int64_t>(memory, &speaker, 1, lengthShape, 1));
+			names.push_back("sid");
+		}
+		const char* output = "output";
+		std::vector<Ort::Value> out = voice.session->Run(Ort::RunOptions{ nullptr }, names.data(), inputs.data(), inputs.size(), &output, 1);
+		const float* audio = out[0].GetTensorData<float>();
+		const size_t n = out[0].GetTensorTypeAndShapeInfo().GetElementCount();
+		pcm->insert(pcm->end(), audio, audio + n);
+	}
+
+	std::mutex mutex_;
+	std::map<std::string, std::shared_ptr<Voice>> voices_;
+#else
+	bool Load(const std::string&, const PiperVoiceConfig&, double*, std::string* error) {
+		*error = "Piper TTS is not built in (use_onnxruntime=0)";
+		return false;
+	}
+	bool Synthesize(const std::string&, const std::string&, const SpeechOptions&, std::vector<float>*, uint32_t*,
+	                std::string* error) {
+		*error = "Piper TTS is not built in (use_onnxruntime=0)";
+		return false;
+	}
+	uint32_t SampleRate(const std::string&) { return 0; }
+	void Unload() {}
+	std::vector<std::string> Voices() { return {}; }
+#endif
+};
+
+inline PiperTtsEngine& PiperTts() {
+	static PiperTtsEngine engine;
+	return engine;
+}
+
+// Reads speak()/synthesizeSpeech() options; false with a TypeError pending.
+inline bool ReadSpeechOptions(Napi::Env env, const Napi::Value& value, SpeechOptions* options) {
+	if (!value.IsObject()) return true;
+	Napi::Object obj = value.As<Napi::Object>();
+	uint32_t speaker = 0;
+	std::string error;
+	if (!ReadUint32Option(obj, "speakerId", 0, 10000, &speaker, &error) ||
+	    !ReadFloatOption(obj, "lengthScale", 0.25f, 4.0f, &options->lengthScale, &error) ||
+	    !ReadUint32Option(obj, "sentenceSilenceMs", 0, 2000, &options->sentenceSilenceMs, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return false;
+	}
+	options->speakerId = speaker;
+	return true;
+}
+
+// loadTtsVoice(name, { model, sampleRate, phonemeIdMap, ... }) -> Promise<{ sampleRate, loadMs }>
+inline Napi::Value LoadTtsVoice(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsString() || !info[1].IsObject()) {
+		Napi::TypeError::New(env, "Voice name and { model, sampleRate, phonemeIdMap } required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const std::string name = info[0].As<Napi::String>().Utf8Value();
+	Napi::Object obj = info[1].As<Napi::Object>();
+	if (!obj.Get("model").IsString() || !obj.Get("phonemeIdMap").IsObject()) {
+		Napi::TypeError::New(env, "Voice model path and phonemeIdMap required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	PiperVoiceConfig config;
+	config.model = obj.Get("model").As<Napi::String>().Utf8Value();
+	if (obj.Get("espeakVoice").IsString()) config.espeakVoice = obj.Get("espeakVoice").As<Napi::String>().Utf8Value();
+	if (obj.Get("espeakData").IsString()) config.espeakData = obj.Get("espeakData").As<Napi::String>().Utf8Value();
+	int phonemeType = 0;
+	std::string error;
+	if (!ReadUint32Option(obj, "sampleRate", 8000, 48000, &config.sampleRate, &error) ||
+	    !ReadEnumOption(obj, "phonemeType", { "espeak", "text" }, &phonemeType, &error) ||
+	    !ReadFloatOption(obj, "noiseScale", 0.0f, 2.0f, &config.noiseScale, &error) ||
+	    !ReadFloatOption(obj, "lengthScale", 0.25f, 4.0f, &config.lengthScale, &error) ||
+	    !ReadFloatOption(obj, "noiseW", 0.0f, 2.0f, &config.noiseW, &error) ||
+	    !ReadUint32Option(obj, "speakers", 1, 10000, &config.speakers, &error) ||
+	    !ReadUint32Option(obj, "threads", 1, 64, &config.threads, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	config.espeak = phonemeType == 0;
+	// phoneme_id_map: { "<one code point>": [ids] }
+	std::vector<uint32_t> key;
+	Napi::Object map = obj.Get("phonemeIdMap").As<Napi::Object>();
+	Napi::Array phonemes = map.GetPropertyNames();
+	for (uint32_t i = 0; i < phonemes.Length(); ++i) {
+		Napi::Value ph = phonemes.Get(i);
+		Napi::Value ids = map.Get(ph);
+		DecodeUtf8(ph.As<Napi::String>().Utf8Value(), &key);
+		if (key.size() != 1 || !ids.IsArray()) continue;
+		Napi::Array array = ids.As<Napi::Array>();
+		std::vector<int64_t>& out = config.phonemeIds[key[0]];
+		for (uint32_t k = 0; k < array.Length(); ++k) {
+			if (array.Get(k).IsNumber()) out.push_back(array.Get(k).As<Napi::Number>().Int64Value());
+		}
+	}
+	struct Loaded {
+		bool ok = false;
+		uint32_t sampleRate = 0;
+		double loadMs = 0;
+		std::string error;
+	};
+	return QueueQuery(env, "LoadTtsVoice",
+		[name, config]() {
+			Loaded result;
+			result.ok = PiperTts().Load(name, config, &result.loadMs, &result.error);
+			result.sampleRate = config.sampleRate;
+			return result;
+		},
+		[](Napi::Env env, Loaded& result) -> Napi::Value {
+			if (!result.ok) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("sampleRate", Napi::Number::New(env, result.sampleRate));
+			o.Set("loadMs", Napi::Number::New(env, result.loadMs));
+			return o;
+		});
+}
+
+// synthesizeSpeech(name, text, options?) -> Promise<{ pcm: Float32Array, sampleRate, synthMs }>
+inline Napi::Value SynthesizeSpeech(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
+		Napi::TypeError::New(env, "Voice name and text required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	SpeechOptions options;
+	if (info.Length() > 2 && !ReadSpeechOptions(env, info[2], &options)) return env.Null();
+	struct Synthesized {
+		bool ok = false;
+		std::vector<float> pcm;
+		uint32_t sampleRate = 0;
+		double synthMs = 0;
+		std::string error;
+	};
+	return QueueQuery(env, "SynthesizeSpeech",
+		[name = info[0].As<Napi::String>().Utf8Value(), text = info[1].As<Napi::String>().Utf8Value(), options]() {
+			const auto start = std::chrono::steady_clock::now();
+			Synthesized result;
+			result.ok = PiperTts().Synthesize(name, text, options, &result.pcm, &result.sampleRate, &result.error);
+			result.synthMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			return result;
+		},
+		[](Napi::Env env, Synthesized& result) -> Napi::Value {
+			if (!result.ok) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Float32Array pcm = Napi::Float32Array::New(env, result.pcm.size());
+			std::copy(result.pcm.begin(), result.pcm.end(), pcm.Data());
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("pcm", pcm);
+			o.Set("sampleRate", Napi::Number::New(env, result.sampleRate));
+			o.Set("synthMs", Napi::Number::New(env, result.synthMs));
+			return o;
+		});
+}
+
+// unloadTtsVoices() -> Promise<void>
+inline Napi::Value UnloadTtsVoices(const Napi::CallbackInfo& info) {
+	return QueueQuery(info.Env(), "UnloadTtsVoices",
+		[]() {
+			PiperTts().Unload();
+			return true;
+		},
+		[](Napi::Env env, bool&) -> Napi::Value { return env.Undefined(); });
+}
+
+// getTtsVoices() -> [name]
+inline Napi::Value GetTtsVoices(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	const std::vector<std::string> names = PiperTts().Voices();
+	Napi::Array array = Napi::Array::New(env, names.size());
+	for (size_t i = 0; i < names.size(); ++i) array.Set((uint32_t)i, Napi::String::New(env, names[i]));
+	return array;
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+// Planar float frames: the device's interleaved packet split once, at ingest,
+// into one contiguous plane per channel, so a stage that works per channel
+// (the stereo dialogue extractor, anything spectral) reads unit-stride floats
+// instead of running its own strided pass over the packet. Every plane starts
+// on a 64-byte boundary and spans a whole number of cache lines, so SIMD
+// loads over a plane never split a line and two planes never share one.
+//
+// The mono path keeps the fused downmix (downmix.h): for a single output a
+// deinterleave pass first would only add a pass over the data.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "downmix.h"
+#include "simd.h"
+
+constexpr size_t kPlanarAlignFloats = 16; // 64 bytes
+
+class PlanarFrame {
+public:
+	// Outside the audio path: room for maxFrames on each of channels planes.
+	void Configure(uint16_t channels, uint32_t rate, size_t maxFrames) {
+		channels_ = channels ? channels : 1;
+		rate_ = rate;
+		stride_ = (maxFrames + kPlanarAlignFloats - 1) / kPlanarAlignFloats * kPlanarAlignFloats;
+		storage_.assign(stride_ * channels_ + kPlanarAlignFloats, 0.0f);
+		const uintptr_t at = reinterpret_cast<uintptr_t>(storage_.data());
+		const uintptr_t aligned = (at + 63) & ~(uintptr_t)63;
+		base_ = storage_.data() + (aligned - at) / sizeof(float);
+		frames_ = 0;
+		firstFrame_ = 0;
+	}
+
+	uint16_t Channels() const { return channels_; }
+	uint32_t Rate() const { return rate_; }
+	size_t Capacity() const { return stride_; }
+	size_t Frames() const { return frames_; }
+	// Stream position of the frame's first sample
+	uint64_t FirstFrame() const { return firstFrame_; }
+
+	float* Channel(size_t c) { return base_ + c * stride_; }
+	const float* Channel(size_t c) const { return base_ + c * stride_; }
+
+	void SetSpan(size_t frames, uint64_t firstFrame) {
+		frames_ = frames;
+		firstFrame_ = firstFrame;
+	}
+
+private:
+	uint16_t channels_ = 0;
+	uint32_t rate_ = 0;
+	size_t stride_ = 0; // floats between planes
+	size_t frames_ = 0;
+	uint64_t firstFrame_ = 0;
+	std::vector<float> storage_;
+	float* base_ = nullptr;
+};
+
+namespace planar_detail {
+
+using downmix_detail::Load1;
+
+template <PcmSampleType T>
+void DeinterleaveScalar(const uint8_t* src, size_t ch, size_t frames, float* const* planes) {
+	for (size_t i = 0; i < frames; ++i)
+		for (size_t c = 0; c < ch; ++c) planes[c][i] = Load1<T>(src, i * ch + c);
+}
+
+// The vector kernels take at most kMaxDownmixChannels planes.
+#if defined(AUDIO_CORE_SSE)
+template <PcmSampleType T>
+void DeinterleaveSse2(const uint8_t* src, size_t ch, size_t frames, float* const* planes) {
+	using downmix_detail::Load4;
+	size_t i = 0;
+	if (ch == 1) {
+		for (; i + 4 <= frames; i += 4) _mm_storeu_ps(planes[0] + i, Load4<T>(src, i));
+	} else if (ch == 2) {
+		for (; i + 4 <= frames; i += 4) {
+			__m128 a = Load4<T>(src, i * 2);
+			__m128 b = Load4<T>(src, i * 2 + 4);
+			_mm_storeu_ps(planes[0] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(planes[1] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	if (i < frames) {
+		float* tails[kMaxDownmixChannels];
+		for (size_t c = 0; c < ch; ++c) tails[c] = planes[c] + i;
+		DeinterleaveScalar<T>(src + i * ch * SampleBytes(T), ch, frames - i, tails);
+	}
+}
+#endif
+
+#if defined(AUDIO_CORE_NEON)
+template <PcmSampleType T>
+void DeinterleaveNeon(const uint8_t* src, size_t ch, size_t frames, float* const* planes) {
+	using downmix_detail::Load4;
+	size_t i = 0;
+	if (ch == 1) {
+		for (; i + 4 <= frames; i += 4) vst1q_f32(planes[0] + i, Load4<T>(src, i));
+	} else if (ch == 2) {
+		for (; i + 4 <= frames; i += 4) {
+			float32x4x2_t lr = vuzpq_f32(Load4<T>(src, i * 2), Load4<T>(src, i * 2 + 4));
+			vst1q_f32(planes[0] + i, lr.val[0]);
+			vst1q_f32(planes[1] + i, lr.val[1]);
+		}
+	}
+	if (i < frames) {
+		float* tails[kMaxDownmixChannels];
+		for (size_t c = 0; c < ch; ++c) tails[c] = planes[c] + i;
+		DeinterleaveScalar<T>(src + i * ch * SampleBytes(T), ch, frames - i, tails);
+	}
+}
+#endif
+
+} // namespace planar_detail
+
+// Interleaved device samples -> a PlanarFrame, with the kernel picked once
+// per stream like the downmix's. Samples are converted to float but not
+// clamped; whatever mixes the planes down clamps.
+class PlanarIngest {
+public:
+	using Kernel = void (*)(const uint8_t* src, size_t ch, size_t frames, float* const* planes);
+
+	void Configure(PcmSampleType type, uint16_t channels) {
+		type_ = type;
+		channels_ = channels ? channels : 1;
+		switch (type) {
+		case PcmSampleType::Float32: Select<PcmSampleType::Float32>(); break;
+		case PcmSampleType::Int16: Select<PcmSampleType::Int16>(); break;
+		case PcmSampleType::Int24Packed: Select<PcmSampleType::Int24Packed>(); break;
+		case PcmSampleType::Int24In32: Select<PcmSampleType::Int24In32>(); break;
+		case PcmSampleType::Int32: Select<PcmSampleType::Int32>(); break;
+		}
+	}
+
+	const char* KernelName() const { return kernelName_; }
+
+	// Up to out's capacity of frames; the frame must have the stream's channels.
+	size_t Run(const void* src, size_t frames, uint64_t firstFrame, PlanarFrame* out) const {
+		if (frames > out->Capacity()) frames = out->Capacity();
+		float* planes[kMaxDownmixChannels];
+		const size_t used = channels_ < kMaxDownmixChannels ? channels_ : kMaxDownmixChannels;
+		if (used == channels_) {
+			for (size_t c = 0; c < used; ++c) planes[c] = out->Channel(c);
+			kernel_(static_cast<const uint8_t*>(src), channels_, frames, planes);
+		} else {
+			// Past the table only by the scalar path, one plane pointer per channel
+			std::vector<float*> all(channels_);
+			for (size_t c = 0; c < channels_; ++c) all[c] = out->Channel(c);
+			Scalar(static_cast<const uint8_t*>(src), frames, all.data());
+		}
+		out->SetSpan(frames, firstFrame);
+		return frames;
+	}
+
+private:
+	template <PcmSampleType T>
+	void Select() {
+		IsaKernels<Kernel> kernels;
+		kernels.With(CpuIsa::Scalar, planar_detail::DeinterleaveScalar<T>);
+#if defined(AUDIO_CORE_SSE)
+		kernels.With(CpuIsa::Sse2, planar_detail::DeinterleaveSse2<T>);
+#endif
+#if defined(AUDIO_CORE_NEON)
+		kernels.With(CpuIsa::Neon, planar_detail::DeinterleaveNeon<T>);
+#endif
+		CpuIsa isa = CpuIsa::Scalar;
+		kernel_ = kernels.Pick(&isa);
+		kernelName_ = CpuIsaName(isa);
+	}
+
+	void Scalar(const uint8_t* src, size_t frames, float* const* planes) const {
+		switch (type_) {
+		case PcmSampleType::Float32: planar_detail::DeinterleaveScalar<PcmSampleType::Float32>(src, channels_, frames, planes); break;
+		case PcmSampleType::Int16: planar_detail::DeinterleaveScalar<PcmSampleType::Int16>(src, channels_, frames, planes); break;
+		case PcmSampleType::Int24Packed: planar_detail::DeinterleaveScalar<PcmSampleType::Int24Packed>(src, channels_, frames, planes); break;
+		case PcmSampleType::Int24In32: planar_detail::DeinterleaveScalar<PcmSampleType::Int24In32>(src, channels_, frames, planes); break;
+		case PcmSampleType::Int32: planar_detail::DeinterleaveScalar<PcmSampleType::Int32>(src, channels_, frames, planes); break;
+		}
+	}
+
+	PcmSampleType type_ = PcmSampleType::Float32;
+	uint16_t channels_ = 1;
+	Kernel kernel_ = planar_detail::DeinterleaveScalar<PcmSampleType::Float32>;
+	const char* kernelName_ = "scalar";
+};
+
+// The planes weighted into mono and clamped, as a DownmixPlan would have
+// mixed the same samples interleaved.
+inline void MixPlanar(const PlanarFrame& frame, const float* weights, float* out) {
+	const size_t frames = frame.Frames();
+	const size_t used = frame.Channels() < kMaxDownmixChannels ? frame.Channels() : kMaxDownmixChannels;
+	const float* first = frame.Channel(0);
+	for (size_t i = 0; i < frames; ++i) out[i] = weights[0] * first[i];
+	for (size_t c = 1; c < used; ++c) {
+		const float* plane = frame.Channel(c);
+		const float w = weights[c];
+		for (size_t i = 0; i < frames; ++i) out[i] += w * plane[i];
+	}
+	for (size_t i = 0; i < frames; ++i) out[i] = downmix_detail::Clamp1(out[i]);
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+// Platform trace events from the native pipeline, to profile it next to the
+// OS audio engine and scheduler: ETW TraceLogging on Windows (provider
+// "Whispra.AudioCore", {a72545a2-7d82-595a-42a3-5a3fbb189f97}, for WPA / wpr
+// -start with that name) and os_signpost on macOS (subsystem
+// com.whispra.audio-core, category Pipeline, for Instruments). Intervals cover
+// the capture front end, the voice chain, delivery, the JS drain and
+// threadpool work such as encoding; instants mark packets and ring traffic.
+// Every call first asks whether a session is listening (one load and branch),
+// so nothing is formatted or written otherwise; on other platforms the calls
+// compile away. Unlike latency_trace.h, which follows one utterance through
+// JS, these cover every packet.
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <TraceLoggingProvider.h>
+#include <winmeta.h>
+#elif defined(__APPLE__)
+#include <os/signpost.h>
+#endif
+
+// Intervals.
+enum class TraceStage {
+	Convert, // capture front end: downmix and resample one packet (value: input frames)
+	Chain,   // echo cancel and voice chain on a block (value: 16 kHz samples)
+	Deliver, // quantize, chunker, ring and subscribers (value: samples)
+	Drain,   // JS thread: one TSFN wakeup's deliveries (value: packets delivered)
+	Work,    // threadpool query or encoder (name: the query's)
+};
+
+// Instants.
+enum class TraceMark {
+	Packet,  // device packet received (value: frames)
+	Enqueue, // slot queued for JS (value: ring depth after)
+	Dequeue, // slot handed to the JS callback (value: its sample index)
+};
+
+#if defined(_WIN32)
+
+TRACELOGGING_DECLARE_PROVIDER(g_audioCoreTraceProvider);
+
+// In exactly one translation unit of an addon: the provider, registered while
+// the module is loaded.
+#define AUDIO_CORE_DEFINE_TRACE_PROVIDER()                                                                  \
+	TRACELOGGING_DEFINE_PROVIDER(g_audioCoreTraceProvider, "Whispra.AudioCore",                             \
+		(0xa72545a2, 0x7d82, 0x595a, 0x42, 0xa3, 0x5a, 0x3f, 0xbb, 0x18, 0x9f, 0x97));                      \
+	static struct AudioCoreTraceRegistration {                                                              \
+		AudioCoreTraceRegistration() { TraceLoggingRegister(g_audioCoreTraceProvider); }                    \
+		~AudioCoreTraceRegistration() { TraceLoggingUnregister(g_audioCoreTraceProvider); }                 \
+	} audioCoreTraceRegistration
+
+inline bool PlatformTraceEnabled() { return TraceLoggingProviderEnabled(g_audioCoreTraceProvider, 0, 0); }
+
+// Event names and opcodes go into the events' static metadata, so they must
+// be constants: one write per stage and opcode.
+#define AUDIO_CORE_TRACE_WRITE(name, opcode, value, label)                                                  \
+	TraceLoggingWrite(g_audioCoreTraceProvider, name, TraceLoggingOpcode(opcode),                           \
+	                  TraceLoggingUInt64(value, "Value"), TraceLoggingString(label, "Name"))
+#define AUDIO_CORE_TRACE_STAGES(opcode, value, label)                                                       \
+	switch (stage) {                                                                                        \
+	case TraceStage::Convert: AUDIO_CORE_TRACE_WRITE("Convert", opcode, value, label); break;               \
+	case TraceStage::Chain: AUDIO_CORE_TRACE_WRITE("Chain", opcode, value, label); break;                   \
+	case TraceStage::Deliver: AUDIO_CORE_TRACE_WRITE("Deliver", opcode, value, label); break;               \
+	case TraceStage::Drain: AUDIO_CORE_TRACE_WRITE("Drain", opcode, value, label); break;                   \
+	case TraceStage::Work: AUDIO_CORE_TRACE_WRITE("Work", opcode, value, label); break;                     \
+	}
+
+inline void PlatformTraceBegin(TraceStage stage, uint64_t value, const char* label) {
+	AUDIO_CORE_TRACE_STAGES(WINEVENT_OPCODE_START, value, label)
+}
+
+inline void PlatformTraceEnd(TraceStage stage, uint64_t value) {
+	AUDIO_CORE_TRACE_STAGES(WINEVENT_OPCODE_STOP, value, "")
+}
+
+inline void PlatformTraceMark(TraceMark mark, uint64_t value) {
+	if (!PlatformTraceEnabled()) return;
+	switch (mark) {
+	case TraceMark::Packet: AUDIO_CORE_TRACE_WRITE("Packet", WINEVENT_OPCODE_INFO, value, ""); break;
+	case TraceMark::Enqueue: AUDIO_CORE_TRACE_WRITE("Enqueue", WINEVENT_OPCODE_INFO, value, ""); break;
+	case TraceMark::Dequeue: AUDIO_CORE_TRACE_WRITE("Dequeue", WINEVENT_OPCODE_INFO, value, ""); break;
+	}
+}
+
+#undef AUDIO_CORE_TRACE_STAGES
+#undef AUDIO_CORE_TRACE_WRITE
+
+#elif defined(__APPLE__)
+
+inline os_log_t PlatformTraceLog() API_AVAILABLE(macos(10.14)) {
+	static os_log_t log = os_log_create("com.whispra.audio-core", "Pipeline");
+	return log;
+}
+
+inline bool PlatformTraceEnabled() {
+	if (__builtin_available(macOS 10.14, *)) return os_signpost_enabled(PlatformTraceLog());
+	return false;
+}
+
+#define AUDIO_CORE_TRACE_BEGIN(name) os_signpost_interval_begin(log, id, name, "%llu %{public}s", (unsigned long long)value, label)
+#define AUDIO_CORE_TRACE_END(name) os_signpost_interval_end(log, id, name, "%llu", (unsigned long long)value)
+
+// Signpost names must be literals, hence one call per stage.
+inline void PlatformTraceBegin(TraceStage stage, os_signpost_id_t id, uint64_t value, const char* label) API_AVAILABLE(macos(10.14)) {
+	os_log_t log = PlatformTraceLog();
+	switch (stage) {
+	case TraceStage::Convert: AUDIO_CORE_TRACE_BEGIN("Convert"); break;
+	case TraceStage::Chain: AUDIO_CORE_TRACE_BEGIN("Chain"); break;
+	case TraceStage::Deliver: AUDIO_CORE_TRACE_BEGIN("Deliver"); break;
+	case TraceStage::Drain: AUDIO_CORE_TRACE_BEGIN("Drain"); break;
+	case TraceStage::Work: AUDIO_CORE_TRACE_BEGIN("Work"); break;
+	}
+}
+
+inline void PlatformTraceEnd(TraceStage stage, os_signpost_id_t id, uint64_t value) API_AVAILABLE(macos(10.14)) {
+	os_log_t log = PlatformTraceLog();
+	switch (stage) {
+	case TraceStage::Convert: AUDIO_CORE_TRACE_END("Convert"); break;
+	case TraceStage::Chain: AUDIO_CORE_TRACE_END("Chain"); break;
+	case TraceStage::Deliver: AUDIO_CORE_TRACE_END("Deliver"); break;
+	case TraceStage::Drain: AUDIO_CORE_TRACE_END("Drain"); break;
+	case TraceStage::Work: AUDIO_CORE_TRACE_END("Work"); break;
+	}
+}
+
+#undef AUDIO_CORE_TRACE_BEGIN
+#undef AUDIO_CORE_TRACE_END
+
+inline void PlatformTraceMark(TraceMark mark, uint64_t value) {
+	if (!PlatformTraceEnabled()) return;
+	if (__builtin_available(macOS 10.14, *)) {
+		os_log_t log = PlatformTraceLog();
+		const unsigned long long v = (unsigned long long)value;
+		switch (mark) {
+		case TraceMark::Packet: os_signpost_event_emit(log, OS_SIGNPOST_ID_EXCLUSIVE, "Packet", "%llu", v); break;
+		case TraceMark::Enqueue: os_signpost_event_emit(log, OS_SIGNPOST_ID_EXCLUSIVE, "Enqueue", "%llu", v); break;
+		case TraceMark::Dequeue: os_signpost_event_emit(log, OS_SIGNPOST_ID_EXCLUSIVE, "Dequeue", "%llu", v); break;
+		}
+	}
+}
+
+#else
+
+inline bool PlatformTraceEnabled() { return false; }
+inline void PlatformTraceMark(TraceMark, uint64_t) {}
+
+#endif
+
+// One interval, begun on construction and ended by End() or destruction.
+// value can be set before the end (e.g. the count a stage produced).
+class TraceInterval {
+public:
+	explicit TraceInterval(TraceStage stage, uint64_t value = 0, const char* label = "")
+		: stage_(stage), value_(value), active_(PlatformTraceEnabled()) {
+		if (!active_) return;
+#if defined(_WIN32)
+		PlatformTraceBegin(stage_, value_, label);
+#elif defined(__APPLE__)
+		if (__builtin_available(macOS 10.14, *)) {
+			id_ = os_signpost_id_generate(PlatformTraceLog());
+			PlatformTraceBegin(stage_, id_, value_, label);
+		}
+#else
+		(void)label;
+#endif
+	}
+	~TraceInterval() { End(); }
+	TraceInterval(const TraceInterval&) = delete;
+	TraceInterval& operator=(const TraceInterval&) = delete;
+
+	void SetValue(uint64_t value) { value_ = value; }
+
+	void End() {
+		if (!active_) return;
+		active_ = false;
+#if defined(_WIN32)
+		PlatformTraceEnd(stage_, value_);
+#elif defined(__APPLE__)
+		if (__builtin_available(macOS 10.14, *)) PlatformTraceEnd(stage_, id_, value_);
+#endif
+	}
+
+private:
+	TraceStage stage_;
+	uint64_t value_;
+	bool active_;
+#if defined(__APPLE__)
+	uint64_t id_ = 0; // os_signpost_id_t
+#endif
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+// Utterance-level statistics of log-mel frames (log_mel.h) and the small
+// network that reads them, shared by the language identifier
+// (language_id.h) and the speaker-change detector (speaker_change.h).
+//
+// PooledMelStats pools frames into kPooledMelFeatures values: every band's
+// mean relative to the frames' mean level (so capture gain does not matter),
+// its standard deviation and its mean absolute frame-to-frame delta.
+// PooledMelNet standardises them, applies an optional ReLU hidden layer and a
+// linear output layer. Its weights follow a model file's header, little-
+// endian float32 arrays: input mean[inputs], input scale[inputs] (1 /
+// standard deviation), hidden weights[hidden][inputs] and bias[hidden] when
+// hidden > 0, output weights[outputs][hidden or inputs] and bias[outputs].
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "log_mel.h"
+
+constexpr uint32_t kPooledMelFeatures = 3 * LogMelTables::kBands;
+
+class PooledMelStats {
+public:
+	void Reset() {
+		frames_ = 0;
+		memset(sum_, 0, sizeof(sum_));
+		memset(sum2_, 0, sizeof(sum2_));
+		memset(delta_, 0, sizeof(delta_));
+	}
+
+	void Push(const float* logMel) {
+		for (uint32_t b = 0; b < LogMelTables::kBands; ++b) {
+			sum_[b] += logMel[b];
+			sum2_[b] += (double)logMel[b] * logMel[b];
+			if (frames_ > 0) delta_[b] += std::fabs(logMel[b] - prev_[b]);
+		}
+		memcpy(prev_, logMel, sizeof(prev_));
+		++frames_;
+	}
+
+	uint32_t Frames() const { return frames_; }
+
+	// kPooledMelFeatures values into out; needs a frame.
+	void Features(float* out) const {
+		const double n = (double)frames_;
+		double level = 0.0;
+		for (uint32_t b = 0; b < LogMelTables::kBands; ++b) level += sum_[b] / n;
+		level /= LogMelTables::kBands;
+		for (uint32_t b = 0; b < LogMelTables::kBands; ++b) {
+			const double m = sum_[b] / n;
+			out[b] = (float)(m - level);
+			out[LogMelTables::kBands + b] = (float)std::sqrt(std::max(0.0, sum2_[b] / n - m * m));
+			out[2 * LogMelTables::kBands + b] = frames_ > 1 ? (float)(delta_[b] / (n - 1)) : 0.0f;
+		}
+	}
+
+private:
+	uint32_t frames_ = 0;
+	double sum_[LogMelTables::kBands] = {};
+	double sum2_[LogMelTables::kBands] = {};
+	double delta_[LogMelTables::kBands] = {};
+	float prev_[LogMelTables::kBands] = {};
+};
+
+struct PooledMelNet {
+	uint32_t hidden = 0;
+	uint32_t outputs = 0;
+	std::vector<float> mean, scale; // kPooledMelFeatures each
+	std::vector<float> hiddenWeights, hiddenBias;
+	std::vector<float> outputWeights, outputBias;
+
+	// outputs values from kPooledMelFeatures statistics; scratch holds hidden floats.
+	void Forward(const float* features, float* out, float* scratch) const {
+		float x[kPooledMelFeatures];
+		for (uint32_t i = 0; i < kPooledMelFeatures; ++i) x[i] = (features[i] - mean[i]) * scale[i];
+		const float* in = x;
+		uint32_t width = kPooledMelFeatures;
+		if (hidden > 0) {
+			for (uint32_t h = 0; h < hidden; ++h) {
+				const float* w = hiddenWeights.data() + (size_t)h * kPooledMelFeatures;
+				float sum = hiddenBias[h];
+				for (uint32_t i = 0; i < kPooledMelFeatures; ++i) sum += w[i] * x[i];
+				scratch[h] = std::max(sum, 0.0f);
+			}
+			in = scratch;
+			width = hidden;
+		}
+		for (uint32_t o = 0; o < outputs; ++o) {
+			const float* w = outputWeights.data() + (size_t)o * width;
+			float sum = outputBias[o];
+			for (uint32_t i = 0; i < width; ++i) sum += w[i] * in[i];
+			out[o] = sum;
+		}
+	}
+
+	// The weight arrays at *p, for a net of the given shape; advances *p.
+	// False when the file ends first.
+	bool Read(const uint8_t** p, const uint8_t* end, uint32_t hiddenUnits, uint32_t outputCount) {
+		hidden = hiddenUnits;
+		outputs = outputCount;
+		auto floats = [&](std::vector<float>* out, size_t count) {
+			if ((size_t)(end - *p) / sizeof(float) < count) return false;
+			out->resize(count);
+			memcpy(out->data(), *p, count * sizeof(float)); // little-endian hosts only (x64, arm64)
+			*p += count * sizeof(float);
+			return true;
+		};
+		const uint32_t width = hidden > 0 ? hidden : kPooledMelFeatures;
+		return floats(&mean, kPooledMelFeatures) && floats(&scale, kPooledMelFeatures) &&
+		       floats(&hiddenWeights, (size_t)hidden * kPooledMelFeatures) && floats(&hiddenBias, hidden) &&
+		       floats(&outputWeights, (size_t)outputs * width) && floats(&outputBias, outputs);
+	}
+};
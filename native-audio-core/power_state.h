@@ -0,0 +1,66 @@
+#pragma once
+
+// Whether the machine runs on mains or battery, for captures with option
+// "power" (capture_options.h). Each addon's power watcher (power_watch.cc:
+// PowerSettingRegisterNotification on Windows, an IOPS run loop source on
+// macOS) keeps the state current while any such capture runs; capture
+// threads poll Changes() once per block and switch profiles when it moves.
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+enum class PowerSource : uint8_t { Unknown, Ac, Battery };
+
+inline const char* PowerSourceName(PowerSource source) {
+	switch (source) {
+	case PowerSource::Ac: return "ac";
+	case PowerSource::Battery: return "battery";
+	default: return "unknown";
+	}
+}
+
+class PowerState;
+
+// Implemented by each addon. Start sets the current source before returning
+// and follows the OS notifications until Stop.
+bool StartPowerWatch(PowerState* state);
+void StopPowerWatch();
+
+class PowerState {
+public:
+	// Any thread.
+	PowerSource Source() const { return source_.load(std::memory_order_acquire); }
+	// Bumped on every change of Source()
+	uint64_t Changes() const { return changes_.load(std::memory_order_acquire); }
+
+	// Watcher side. Only real changes count.
+	void Set(PowerSource source) {
+		if (source_.exchange(source, std::memory_order_acq_rel) != source) changes_.fetch_add(1, std::memory_order_acq_rel);
+	}
+
+	// JS thread of any environment, from capture Start/Stop: the watcher runs
+	// from the first capture that asks for it until the last one stops.
+	void Retain() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (users_++ == 0) watching_ = StartPowerWatch(this);
+	}
+	void Release() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (users_ == 0 || --users_ > 0) return;
+		if (watching_) StopPowerWatch();
+		watching_ = false;
+	}
+
+private:
+	std::atomic<PowerSource> source_{PowerSource::Unknown};
+	std::atomic<uint64_t> changes_{0};
+	std::mutex mutex_;
+	uint32_t users_ = 0;
+	bool watching_ = false;
+};
+
+inline PowerState& SystemPowerState() {
+	static PowerState state;
+	return state;
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+// Live-tunable parameters of the voice chain (dsp_blocks.h): high-pass corner,
+// noise gate threshold and time constants, fixed boost. setProcessingParams()
+// (dsp_bindings.h) derives the filter and gate coefficients on the JS thread and publishes the
+// result as one block into the inactive half of a double buffer, then flips
+// the active index; running chains check the version once per processed block
+// and copy the new block in without re-initialising the device. Each half
+// carries a sequence count so a reader that raced two publishes skips the
+// torn copy and tries again on its next block.
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+struct ProcessingParams {
+	float highPassHz = 90.0f;
+	float highPassQ = 0.7071f;
+	float gateRatio = 2.5f;          // gate opens this far above the tracked noise floor
+	float gateEnvelopeMs = 10.0f;
+	float gateFloorRiseMs = 500.0f;
+	float gateAttackMs = 5.0f;       // attenuation
+	float gateReleaseMs = 50.0f;     // recovery
+	float boost = 1.5f;              // fixed gain when neither loudness nor voice boost runs
+};
+
+struct BiquadCoefficients {
+	float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+};
+
+// RBJ high-pass, a0 normalised to 1.
+inline BiquadCoefficients HighPassCoefficients(float fs, float fc, float q) {
+	const float w0 = 2.0f * 3.14159265358979323846f * (fc / fs);
+	const float c = cosf(w0);
+	const float alpha = sinf(w0) / (2.0f * q);
+	const float a0 = 1.0f + alpha;
+	BiquadCoefficients k;
+	k.b0 = (1.0f + c) * 0.5f / a0;
+	k.b1 = -(1.0f + c) / a0;
+	k.b2 = (1.0f + c) * 0.5f / a0;
+	k.a1 = (-2.0f * c) / a0;
+	k.a2 = (1.0f - alpha) / a0;
+	return k;
+}
+
+// RBJ low-pass, a0 normalised to 1.
+inline BiquadCoefficients LowPassCoefficients(float fs, float fc, float q) {
+	const float w0 = 2.0f * 3.14159265358979323846f * (fc / fs);
+	const float c = cosf(w0);
+	const float alpha = sinf(w0) / (2.0f * q);
+	const float a0 = 1.0f + alpha;
+	BiquadCoefficients k;
+	k.b0 = (1.0f - c) * 0.5f / a0;
+	k.b1 = (1.0f - c) / a0;
+	k.b2 = (1.0f - c) * 0.5f / a0;
+	k.a1 = (-2.0f * c) / a0;
+	k.a2 = (1.0f - alpha) / a0;
+	return k;
+}
+
+// Per-sample one-pole coefficients of the noise gate.
+struct GateTimings {
+	float env = 0.0f, rise = 0.0f, atk = 0.0f, rel = 0.0f;
+};
+
+inline GateTimings GateTimingsFor(float fs, const ProcessingParams& p) {
+	GateTimings t;
+	t.env = expf(-1000.0f / (p.gateEnvelopeMs * fs));
+	t.rise = expf(-1000.0f / (p.gateFloorRiseMs * fs));
+	t.atk = expf(-1000.0f / (p.gateAttackMs * fs));
+	t.rel = expf(-1000.0f / (p.gateReleaseMs * fs));
+	return t;
+}
+
+// Parameters plus everything the chain derives from them at one sample rate.
+struct ProcessingBlock {
+	ProcessingParams params;
+	float sampleRate = 0.0f;
+	BiquadCoefficients highPass;
+	GateTimings gate;
+};
+
+inline ProcessingBlock MakeProcessingBlock(const ProcessingParams& params, float fs) {
+	ProcessingBlock b;
+	b.params = params;
+	b.sampleRate = fs;
+	b.highPass = HighPassCoefficients(fs, params.highPassHz, params.highPassQ);
+	b.gate = GateTimingsFor(fs, params);
+	return b;
+}
+
+// Both addons run the voice chain on the 16 kHz stream; blocks are derived for it.
+constexpr float kProcessingRate = 16000.0f;
+
+class ProcessingParamsStore {
+public:
+	ProcessingParamsStore() { Publish(ProcessingParams()); }
+
+	// JS thread.
+	void Publish(const ProcessingParams& params) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		const ProcessingBlock block = MakeProcessingBlock(params, kProcessingRate);
+		const int next = 1 - active_.load(std::memory_order_relaxed);
+		Half& half = halves_[next];
+		half.seq.fetch_add(1, std::memory_order_relaxed); // odd while writing
+		std::atomic_thread_fence(std::memory_order_release);
+		memcpy(&half.block, &block, sizeof(block));
+		half.seq.fetch_add(1, std::memory_order_release);
+		active_.store(next, std::memory_order_release);
+		version_.fetch_add(1, std::memory_order_release);
+		current_ = params;
+	}
+
+	ProcessingParams Current() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return current_;
+	}
+
+	// Audio thread, once per block. Copies the active block into *out if it
+	// changed since *seen; false when unchanged or caught mid-publish.
+	bool Read(uint64_t* seen, ProcessingBlock* out) const {
+		const uint64_t version = version_.load(std::memory_order_acquire);
+		if (version == *seen) return false;
+		const Half& half = halves_[active_.load(std::memory_order_acquire)];
+		const uint32_t seq = half.seq.load(std::memory_order_acquire);
+		if (seq & 1) return false;
+		memcpy(out, &half.block, sizeof(*out));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (half.seq.load(std::memory_order_relaxed) != seq) return false;
+		*seen = version;
+		return true;
+	}
+
+private:
+	struct Half {
+		std::atomic<uint32_t> seq{0};
+		ProcessingBlock block;
+	};
+
+	mutable std::mutex mutex_; // publishers only
+	Half halves_[2];
+	std::atomic<int> active_{0};
+	std::atomic<uint64_t> version_{0};
+	ProcessingParams current_;
+};
+
+inline ProcessingParamsStore& LiveProcessingParams() {
+	static ProcessingParamsStore store;
+	return store;
+}
+
+struct ProcessingParamField {
+	const char* key;
+	float ProcessingParams::*member;
+	float lo, hi;
+};
+
+inline const ProcessingParamField* ProcessingParamFields(size_t* count) {
+	static const ProcessingParamField fields[] = {
+		{ "highPassHz", &ProcessingParams::highPassHz, 20.0f, 500.0f },
+		{ "highPassQ", &ProcessingParams::highPassQ, 0.3f, 2.0f },
+		{ "gateRatio", &ProcessingParams::gateRatio, 1.0f, 10.0f },
+		{ "gateEnvelopeMs", &ProcessingParams::gateEnvelopeMs, 1.0f, 100.0f },
+		{ "gateFloorRiseMs", &ProcessingParams::gateFloorRiseMs, 50.0f, 5000.0f },
+		{ "gateAttackMs", &ProcessingParams::gateAttackMs, 0.5f, 100.0f },
+		{ "gateReleaseMs", &ProcessingParams::gateReleaseMs, 5.0f, 1000.0f },
+		{ "boost", &ProcessingParams::boost, 1.0f, 4.0f },
+	};
+	*count = sizeof(fields) / sizeof(fields[0]);
+	return fields;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+// Load-adaptive quality for the capture DSP (option "governor"). On a busy
+// machine - local Whisper inference on a low-end laptop - the capture thread
+// competes for the same cores, and a block that takes longer than the audio it
+// holds ends in dropped IO buffers. The governor keeps a running average of
+// the processing time per block against the audio time the block covers (one
+// device period for a device-paced block) and trades quality for headroom one
+// level at a time:
+//   Full           - everything as configured
+//   LightResampler - the 'low' resampler (8 zero crossings) instead of the
+//                    configured one; nothing to drop when libswresample or
+//                    'low' already runs
+//   NoDenoise      - also suspends option 'denoise' (the STFT passes through)
+//   SparseFeatures - also analyses the spectrum of every other VAD frame for
+//                    chunk features (twice the hop)
+// It steps down once the load stays above highLoad for a short while and back
+// up after the load has stayed below lowLoad for holdMs; every step is posted
+// to JS as a 'quality' event. Times are counted in audio, so a file replayed
+// at pace 'fast' settles the same way a device does. A floor (option 'power'
+// on battery) holds the level at or below a given one whether or not the
+// governor itself is enabled.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+enum class QualityLevel : uint8_t { Full, LightResampler, NoDenoise, SparseFeatures };
+
+inline const char* QualityLevelName(QualityLevel level) {
+	switch (level) {
+	case QualityLevel::LightResampler: return "light-resampler";
+	case QualityLevel::NoDenoise: return "no-denoise";
+	case QualityLevel::SparseFeatures: return "sparse-features";
+	default: return "full";
+	}
+}
+
+// For getStats(); load is the running average at the last block.
+struct QualityStats {
+	QualityLevel level = QualityLevel::Full;
+	float load = 0.0f;
+	uint64_t steps = 0;
+};
+
+struct GovernorConfig {
+	bool enabled = false;
+	float highLoad = 0.5f;  // share of the block's audio time spent processing it
+	float lowLoad = 0.25f;
+	uint32_t holdMs = 3000; // below lowLoad this long before stepping up
+};
+
+class QualityGovernor {
+public:
+	void Configure(const GovernorConfig& config, uint32_t sampleRate) {
+		config_ = config;
+		sampleRate_ = sampleRate;
+		Reset();
+	}
+
+	// Before the capture thread starts.
+	void Reset() {
+		level_ = QualityLevel::Full;
+		floor_ = QualityLevel::Full;
+		load_ = 0.0f;
+		blocks_ = 0;
+		sinceChange_ = 0;
+		calm_ = 0;
+		publishedLevel_.store(QualityLevel::Full, std::memory_order_relaxed);
+		publishedLoad_.store(0.0f, std::memory_order_relaxed);
+		steps_.store(0, std::memory_order_relaxed);
+	}
+
+	bool Enabled() const { return config_.enabled; }
+	// Capture thread.
+	QualityLevel Level() const { return level_; }
+	float Load() const { return load_; }
+
+	// Any thread.
+	QualityStats Stats() const {
+		QualityStats s;
+		s.level = publishedLevel_.load(std::memory_order_relaxed);
+		s.load = publishedLoad_.load(std::memory_order_relaxed);
+		s.steps = steps_.load(std::memory_order_relaxed);
+		return s;
+	}
+
+	// Capture thread, after each processed block of `samples` at the chain
+	// rate that took `ns`. True when the level changed; *raised tells which way.
+	bool Update(uint64_t ns, size_t samples, bool* raised) {
+		if (!config_.enabled || samples == 0) return false;
+		const float load = (float)((double)ns * sampleRate_ / ((double)samples * 1e9));
+		// The first blocks set the average; then about 16 blocks of memory
+		load_ = blocks_ < 4 ? load : load_ + (load - load_) * 0.0625f;
+		++blocks_;
+		publishedLoad_.store(load_, std::memory_order_relaxed);
+		sinceChange_ += samples;
+		calm_ = load_ > config_.lowLoad ? 0 : calm_ + samples;
+
+		// Down: the new level needs a quarter second to show in the average
+		if (load_ > config_.highLoad && level_ != QualityLevel::SparseFeatures && sinceChange_ >= sampleRate_ / 4) {
+			level_ = (QualityLevel)((uint8_t)level_ + 1);
+			*raised = false;
+		} else if (level_ > floor_ && calm_ >= (uint64_t)sampleRate_ * config_.holdMs / 1000) {
+			level_ = (QualityLevel)((uint8_t)level_ - 1);
+			*raised = true;
+			calm_ = 0;
+		} else {
+			return false;
+		}
+		Publish();
+		return true;
+	}
+
+	// Capture thread. Moves the level to the floor when it is above it (or,
+	// without load steps to bring it back, below it); true when the level
+	// changed, *raised telling which way.
+	bool SetFloor(QualityLevel floor, bool* raised) {
+		floor_ = floor;
+		if (level_ < floor_) {
+			*raised = false;
+		} else if (level_ > floor_ && !config_.enabled) {
+			*raised = true;
+		} else {
+			return false;
+		}
+		level_ = floor_;
+		calm_ = 0;
+		Publish();
+		return true;
+	}
+
+private:
+	void Publish() {
+		sinceChange_ = 0;
+		publishedLevel_.store(level_, std::memory_order_relaxed);
+		steps_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	GovernorConfig config_;
+	uint32_t sampleRate_ = 16000;
+	QualityLevel level_ = QualityLevel::Full;
+	QualityLevel floor_ = QualityLevel::Full;
+	float load_ = 0.0f;      // running average of processing time / audio time
+	uint64_t blocks_ = 0;
+	uint64_t sinceChange_ = 0; // samples since the last step
+	uint64_t calm_ = 0;        // samples the average has stayed below lowLoad
+	std::atomic<QualityLevel> publishedLevel_{QualityLevel::Full};
+	std::atomic<float> publishedLoad_{0.0f};
+	std::atomic<uint64_t> steps_{0};
+};
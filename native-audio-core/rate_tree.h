@@ -0,0 +1,351 @@
+#pragma once
+
+// Every sample rate the capture's subscribers asked for, derived from one
+// pass over the processed stream by a tree of shared stages instead of a
+// resampler per rate. A rate that is the root's halved (or doubled) some
+// number of times hangs off a chain of half-band stages; any other rate
+// hangs off the nearest rate already in the tree that a half-band step does
+// not overshoot, through a PolyphaseResampler. A rate whose double or half is
+// already in the tree is one half-band step from it, so 24 and 48 kHz share
+// the 16 -> 24 kHz stage and 8 kHz is a single half-band from 16 kHz.
+//
+// The half-band filters are Kaiser-windowed sincs cut at a quarter of the
+// higher rate. Every other tap is zero, so a 2:1 step is one contiguous dot
+// product over the inputs of one parity plus the centre tap, and a 1:2 step
+// one dot product per two outputs (the other output is an input, delayed);
+// both run on the resampler's DotProduct4. Like the half-band designs they are,
+// they are 6 dB down at the lower rate's Nyquist and alias only inside the
+// transition band just below it.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "resampler.h"
+
+namespace rate_tree_detail {
+
+// The nonzero side taps of a half-band lowpass in input order: taps[K - 1 - i]
+// and taps[K + i] are the ones at offsets -(2i + 1) and 2i + 1 from the
+// centre tap (0.5), all scaled for unity DC gain. 2K is a multiple of 4.
+inline std::vector<float> HalfBandTaps(ResamplerQuality quality) {
+	size_t pairs = 16;
+	double beta = 8.6;
+	if (quality == ResamplerQuality::Low) { pairs = 8; beta = 6.0; }
+	else if (quality == ResamplerQuality::High) { pairs = 32; beta = 10.0; }
+	auto i0 = [](double x) {
+		double sum = 1.0, term = 1.0;
+		const double q = x * x / 4.0;
+		for (int k = 1; k < 50; ++k) {
+			term *= q / ((double)k * (double)k);
+			sum += term;
+			if (term < sum * 1e-12) break;
+		}
+		return sum;
+	};
+	const double half = (double)(2 * pairs); // centre to one past the last tap
+	std::vector<double> c(pairs);
+	double sum = 0.0;
+	for (size_t i = 0; i < pairs; ++i) {
+		const double t = (double)(2 * i + 1);
+		const double sinc = std::sin(3.14159265358979323846 * t / 2.0) / (3.14159265358979323846 * t);
+		const double r = t / half;
+		c[i] = sinc * i0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / i0(beta);
+		sum += c[i];
+	}
+	std::vector<float> taps(2 * pairs);
+	for (size_t i = 0; i < pairs; ++i) taps[pairs - 1 - i] = taps[pairs + i] = (float)(c[i] * 0.25 / sum);
+	return taps;
+}
+
+} // namespace rate_tree_detail
+
+// 2:1, keeping every other input's filtered value across calls.
+class HalfBandDecimator {
+public:
+	void Configure(ResamplerQuality quality, size_t maxBlock) {
+		taps_ = rate_tree_detail::HalfBandTaps(quality);
+		hist_ = 2 * taps_.size() - 2;
+		maxBlock_ = std::max<size_t>(maxBlock, 64);
+		work_.assign(hist_ + maxBlock_, 0.0f);
+		side_.assign(maxBlock_ / 2 + taps_.size() + 1, 0.0f);
+		Reset();
+	}
+
+	void Reset() {
+		std::fill(work_.begin(), work_.end(), 0.0f);
+		next_ = 0;
+	}
+
+	size_t MaxOutput(size_t n) const { return n / 2 + 1; }
+
+	size_t Process(const float* in, size_t n, float* out) {
+		size_t produced = 0;
+		while (n > 0) {
+			const size_t block = std::min(n, maxBlock_);
+			produced += Block(in, block, out + produced);
+			in += block;
+			n -= block;
+		}
+		return produced;
+	}
+
+private:
+	size_t Block(const float* in, size_t n, float* out) {
+		float* w = work_.data();
+		std::copy(in, in + n, w + hist_);
+		const size_t taps = taps_.size();
+		// Input i's output reads w[i .. i + hist_]: its side taps are the
+		// inputs of i's parity, its centre w[i + taps - 1] is of the other
+		const size_t produced = next_ < n ? (n - next_ + 1) / 2 : 0;
+		float* side = side_.data();
+		for (size_t j = 0; j < produced + taps - 1; ++j) side[j] = w[next_ + 2 * j];
+		for (size_t k = 0; k < produced; ++k) {
+			out[k] = DotProduct4(taps_.data(), side + k, taps) + 0.5f * w[next_ + 2 * k + taps - 1];
+		}
+		next_ = next_ + 2 * produced - n;
+		std::copy(w + n, w + n + hist_, w);
+		return produced;
+	}
+
+	std::vector<float> taps_;
+	std::vector<float> work_; // hist_ inputs of history + one block
+	std::vector<float> side_; // a block's inputs of the outputs' parity
+	size_t hist_ = 0;
+	size_t maxBlock_ = 0;
+	size_t next_ = 0; // the next block's first input with an output, 0 or 1
+};
+
+// 1:2: each input yields the filtered value between it and the one before,
+// then the (delayed) input itself.
+class HalfBandInterpolator {
+public:
+	void Configure(ResamplerQuality quality, size_t maxBlock) {
+		taps_ = rate_tree_detail::HalfBandTaps(quality);
+		for (float& t : taps_) t *= 2.0f; // the zeros stuffed between inputs
+		hist_ = taps_.size() - 1;
+		maxBlock_ = std::max<size_t>(maxBlock, 64);
+		work_.assign(hist_ + maxBlock_, 0.0f);
+		Reset();
+	}
+
+	void Reset() { std::fill(work_.begin(), work_.end(), 0.0f); }
+
+	size_t MaxOutput(size_t n) const { return 2 * n; }
+
+	size_t Process(const float* in, size_t n, float* out) {
+		size_t produced = 0;
+		while (n > 0) {
+			const size_t block = std::min(n, maxBlock_);
+			produced += Block(in, block, out + produced);
+			in += block;
+			n -= block;
+		}
+		return produced;
+	}
+
+private:
+	size_t Block(const float* in, size_t n, float* out) {
+		float* w = work_.data();
+		std::copy(in, in + n, w + hist_);
+		const size_t taps = taps_.size();
+		// Input m is w[m + hist_]: the point halfway between w[m + taps/2 - 1]
+		// and w[m + taps/2] is filtered from w[m .. m + hist_], and the
+		// point after it is w[m + taps/2]
+		for (size_t m = 0; m < n; ++m) {
+			out[2 * m] = DotProduct4(taps_.data(), w + m, taps);
+			out[2 * m + 1] = w[m + taps / 2];
+		}
+		std::copy(w + n, w + n + hist_, w);
+		return 2 * n;
+	}
+
+	std::vector<float> taps_;
+	std::vector<float> work_; // hist_ inputs of history + one block
+	size_t hist_ = 0;
+	size_t maxBlock_ = 0;
+};
+
+// One thread (the capture's). Plan() between blocks when the set of rates
+// changes; stages still in use keep their history.
+class RateTree {
+public:
+	static constexpr int kRoot = -1;
+
+	void Configure(uint32_t rootRate, ResamplerQuality quality, size_t maxBlock) {
+		root_ = rootRate;
+		quality_ = quality;
+		maxBlock_ = maxBlock;
+		nodes_.clear();
+	}
+
+	uint32_t RootRate() const { return root_; }
+	ResamplerQuality Quality() const { return quality_; }
+	size_t Stages() const { return nodes_.size(); }
+
+	// Builds the tree for these rates; *taps gets each rate's tap (kRoot for
+	// the root rate itself). Returns whether any stage was created.
+	bool Plan(const std::vector<uint32_t>& rates, std::vector<int>* taps) {
+		previous_.swap(nodes_);
+		nodes_.clear();
+		created_ = false;
+		// Higher rates first, going up, then lower ones going down, so each
+		// finds the neighbours it can share a half-band step with
+		std::vector<uint32_t> order(rates);
+		std::sort(order.begin(), order.end());
+		order.erase(std::unique(order.begin(), order.end()), order.end());
+		std::stable_partition(order.begin(), order.end(), [this](uint32_t r) { return r >= root_; });
+		std::reverse(std::find_if(order.begin(), order.end(), [this](uint32_t r) { return r < root_; }), order.end());
+		for (uint32_t r : order) NodeFor(r);
+		taps->resize(rates.size());
+		for (size_t i = 0; i < rates.size(); ++i) (*taps)[i] = Find(rates[i]);
+		previous_.clear();
+		return created_;
+	}
+
+	// Room in every stage for a root block of n; whether anything grew.
+	bool Reserve(size_t n) {
+		bool grew = false;
+		for (auto& node : nodes_) {
+			const size_t in = node->parent == kRoot ? n : nodes_[node->parent]->out.size();
+			const size_t need = node->MaxOutput(in);
+			if (node->out.size() < need) {
+				node->out.resize(need);
+				grew = true;
+			}
+		}
+		return grew;
+	}
+
+	// Runs every stage once over the block, parents first.
+	void Process(const float* in, size_t n) {
+		for (auto& node : nodes_) {
+			const float* src = node->parent == kRoot ? in : nodes_[node->parent]->out.data();
+			const size_t count = node->parent == kRoot ? n : nodes_[node->parent]->produced;
+			node->produced = node->Run(src, count);
+		}
+	}
+
+	// Silence in place of n root samples: stages restart from it, and each
+	// tap's count follows its rate.
+	void Skip(size_t n, bool first) {
+		for (auto& node : nodes_) {
+			if (first) node->Reset();
+			node->skipCarry += (uint64_t)n * node->rate;
+			node->produced = (size_t)(node->skipCarry / root_);
+			node->skipCarry %= root_;
+		}
+	}
+
+	const float* Output(int tap) const { return nodes_[tap]->out.data(); }
+	size_t Produced(int tap) const { return nodes_[tap]->produced; }
+
+private:
+	enum class Kind { Down, Up, Polyphase };
+
+	struct Node {
+		Kind kind = Kind::Polyphase;
+		uint32_t rate = 0;
+		uint32_t parentRate = 0;
+		int parent = kRoot;
+		HalfBandDecimator down;
+		HalfBandInterpolator up;
+		PolyphaseResampler polyphase;
+		std::vector<float> out;
+		size_t produced = 0;
+		uint64_t skipCarry = 0; // Skip() remainder, in root samples times rate
+
+		size_t Run(const float* in, size_t n) {
+			switch (kind) {
+			case Kind::Down: return down.Process(in, n, out.data());
+			case Kind::Up: return up.Process(in, n, out.data());
+			case Kind::Polyphase: return polyphase.Process(in, n, out.data());
+			}
+			return 0;
+		}
+
+		size_t MaxOutput(size_t n) const {
+			switch (kind) {
+			case Kind::Down: return down.MaxOutput(n);
+			case Kind::Up: return up.MaxOutput(n);
+			case Kind::Polyphase: return polyphase.MaxOutput(n);
+			}
+			return n;
+		}
+
+		void Reset() {
+			down.Reset();
+			up.Reset();
+			polyphase.Reset();
+		}
+	};
+
+	int Find(uint32_t rate) const {
+		if (rate == root_) return kRoot;
+		for (size_t i = 0; i < nodes_.size(); ++i) if (nodes_[i]->rate == rate) return (int)i;
+		return -2;
+	}
+
+	static bool PowerOfTwo(uint32_t v) { return v && !(v & (v - 1)); }
+
+	int NodeFor(uint32_t rate) {
+		const int found = Find(rate);
+		if (found != -2) return found;
+		if (rate < root_) {
+			if (Find(rate * 2) != -2 || (root_ % rate == 0 && PowerOfTwo(root_ / rate))) return Add(Kind::Down, rate, NodeFor(rate * 2));
+			// From the lowest rate the root halves to without passing this one
+			uint32_t from = root_;
+			while (from % 2 == 0 && from / 2 >= rate) from /= 2;
+			return Add(Kind::Polyphase, rate, NodeFor(from));
+		}
+		if (rate % 2 == 0 && rate / 2 > root_ && (Find(rate / 2) != -2 || (rate % root_ == 0 && PowerOfTwo(rate / root_)))) {
+			return Add(Kind::Up, rate, NodeFor(rate / 2));
+		}
+		if (rate % root_ == 0 && rate / root_ == 2) return Add(Kind::Up, rate, kRoot);
+		return Add(Kind::Polyphase, rate, kRoot);
+	}
+
+	int Add(Kind kind, uint32_t rate, int parent) {
+		const uint32_t parentRate = parent == kRoot ? root_ : nodes_[parent]->rate;
+		std::unique_ptr<Node> node;
+		for (auto& old : previous_) {
+			if (old && old->kind == kind && old->rate == rate && old->parentRate == parentRate) node = std::move(old);
+		}
+		// The parent's largest block bounds this stage's input
+		const size_t maxIn = parent == kRoot ? maxBlock_ : nodes_[parent]->out.size();
+		if (!node) {
+			node = std::make_unique<Node>();
+			node->kind = kind;
+			node->rate = rate;
+			node->parentRate = parentRate;
+			switch (kind) {
+			case Kind::Down:
+				node->down.Configure(quality_, maxIn);
+				node->out.resize(node->down.MaxOutput(maxIn));
+				break;
+			case Kind::Up:
+				node->up.Configure(quality_, maxIn);
+				node->out.resize(node->up.MaxOutput(maxIn));
+				break;
+			case Kind::Polyphase:
+				node->polyphase.Configure(parentRate, rate, quality_, maxIn);
+				node->out.resize(node->polyphase.MaxOutput(maxIn));
+				break;
+			}
+			created_ = true;
+		}
+		node->parent = parent;
+		nodes_.push_back(std::move(node));
+		return (int)nodes_.size() - 1;
+	}
+
+	uint32_t root_ = 16000;
+	ResamplerQuality quality_ = ResamplerQuality::Medium;
+	size_t maxBlock_ = 0;
+	std::vector<std::unique_ptr<Node>> nodes_;    // parents before children
+	std::vector<std::unique_ptr<Node>> previous_; // Plan()'s stages to reuse
+	bool created_ = false;
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+// Memory for buffers the capture threads touch on every block: the scratch
+// arenas, the IO FIFO, the pre-roll rings and the packet slots. Allocating
+// them up front keeps the heap off those threads (rt_alloc_check.h), but a
+// fresh page still faults on its first touch, and an idle one can be paged out
+// on a machine short of memory; either shows up as a glitch.
+//
+// Every block here is its own run of pages, touched once when it is allocated
+// and then locked in RAM - VirtualLock on Windows, after growing the process's
+// minimum working set by as much, and mlock elsewhere. Locked bytes are capped
+// process-wide at kRealtimeLockCapBytes; past the cap, or when the OS refuses
+// (a working-set quota, RLIMIT_MEMLOCK), the block is still prefaulted but
+// left pageable, and the refusal is counted and logged once. Blocks are
+// allocated while a capture is configured and freed with it, never on the
+// audio path, so the system calls cost nothing there.
+//
+// RealtimeVector<T> is a std::vector on this memory. Locked pages are not
+// given back under memory pressure (memory_budget.h); the buffers that may
+// grow with a session, like the capture history, stay on the heap.
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "addon_log.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+constexpr uint64_t kRealtimeLockCapBytes = 32ull << 20;
+
+struct RealtimeMemoryStats {
+	uint64_t lockedBytes = 0;   // pages held in RAM
+	uint64_t unlockedBytes = 0; // prefaulted but pageable: over the cap, or the lock was refused
+	uint64_t capBytes = kRealtimeLockCapBytes;
+	uint64_t blocks = 0;
+	uint64_t denied = 0;        // locks the OS refused
+};
+
+class RealtimeMemory {
+public:
+	// Room for the header in front of every block; keeps blocks cache-line aligned.
+	static constexpr size_t kHeaderBytes = 64;
+
+	// Null when the OS has no pages to give.
+	void* Allocate(size_t bytes) {
+		const size_t page = PageBytes();
+		const size_t total = (bytes + kHeaderBytes + page - 1) / page * page;
+		uint8_t* base = Map(total);
+		if (!base) return nullptr;
+		for (size_t at = 0; at < total; at += page) reinterpret_cast<volatile uint8_t*>(base)[at] = 0;
+		Header* header = reinterpret_cast<Header*>(base);
+		header->total = total;
+		header->locked = ReserveLock(total) && Lock(base, total);
+		if (!header->locked) unlocked_.fetch_add(total, std::memory_order_relaxed);
+		blocks_.fetch_add(1, std::memory_order_relaxed);
+		return base + kHeaderBytes;
+	}
+
+	void Free(void* data) {
+		if (!data) return;
+		uint8_t* base = static_cast<uint8_t*>(data) - kHeaderBytes;
+		const Header header = *reinterpret_cast<Header*>(base);
+		if (header.locked) {
+			Unlock(base, header.total);
+			locked_.fetch_sub(header.total, std::memory_order_relaxed);
+		} else {
+			unlocked_.fetch_sub(header.total, std::memory_order_relaxed);
+		}
+		blocks_.fetch_sub(1, std::memory_order_relaxed);
+		Unmap(base, header.total);
+	}
+
+	RealtimeMemoryStats Stats() const {
+		RealtimeMemoryStats s;
+		s.lockedBytes = locked_.load(std::memory_order_relaxed);
+		s.unlockedBytes = unlocked_.load(std::memory_order_relaxed);
+		s.blocks = blocks_.load(std::memory_order_relaxed);
+		s.denied = denied_.load(std::memory_order_relaxed);
+		return s;
+	}
+
+private:
+	struct Header {
+		size_t total; // bytes mapped, header included
+		bool locked;
+	};
+
+	static size_t PageBytes() {
+#if defined(_WIN32)
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwPageSize;
+#else
+		return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+	}
+
+	static uint8_t* Map(size_t bytes) {
+#if defined(_WIN32)
+		return static_cast<uint8_t*>(VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+		void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return p == MAP_FAILED ? nullptr : static_cast<uint8_t*>(p);
+#endif
+	}
+
+	static void Unmap(uint8_t* base, size_t bytes) {
+#if defined(_WIN32)
+		(void)bytes;
+		VirtualFree(base, 0, MEM_RELEASE);
+#else
+		munmap(base, bytes);
+#endif
+	}
+
+	// Takes bytes out of the cap; false (taking nothing) when they don't fit.
+	bool ReserveLock(size_t bytes) {
+		uint64_t held = locked_.load(std::memory_order_relaxed);
+		do {
+			if (held + bytes > kRealtimeLockCapBytes) return false;
+		} while (!locked_.compare_exchange_weak(held, held + bytes, std::memory_order_relaxed));
+		return true;
+	}
+
+	// Gives the reservation back when the OS says no.
+	bool Lock(uint8_t* base, size_t bytes) {
+#if defined(_WIN32)
+		// VirtualLock counts against the minimum working set; grow both bounds
+		// by the block so the lock fits and the process keeps its headroom;
+		// Unlock gives it back.
+		SIZE_T minimum = 0, maximum = 0;
+		HANDLE process = GetCurrentProcess();
+		if (GetProcessWorkingSetSize(process, &minimum, &maximum))
+			SetProcessWorkingSetSize(process, minimum + bytes, maximum + bytes);
+		const bool ok = VirtualLock(base, bytes) != 0;
+		const unsigned long error = ok ? 0 : GetLastError();
+#else
+		const bool ok = mlock(base, bytes) == 0;
+		const int error = ok ? 0 : errno;
+#endif
+		if (ok) return true;
+		locked_.fetch_sub(bytes, std::memory_order_relaxed);
+		if (denied_.fetch_add(1, std::memory_order_relaxed) == 0)
+			AddonLog(LogLevel::Warn, "Real-time buffers: locking %zu bytes was refused (error %lu); they stay pageable",
+			         bytes, (unsigned long)error);
+		return false;
+	}
+
+	static void Unlock(uint8_t* base, size_t bytes) {
+#if defined(_WIN32)
+		VirtualUnlock(base, bytes);
+		SIZE_T minimum = 0, maximum = 0;
+		HANDLE process = GetCurrentProcess();
+		if (GetProcessWorkingSetSize(process, &minimum, &maximum) && minimum > bytes && maximum > bytes)
+			SetProcessWorkingSetSize(process, minimum - bytes, maximum - bytes);
+#else
+		munlock(base, bytes);
+#endif
+	}
+
+	std::atomic<uint64_t> locked_{0};
+	std::atomic<uint64_t> unlocked_{0};
+	std::atomic<uint64_t> blocks_{0};
+	std::atomic<uint64_t> denied_{0};
+};
+
+inline RealtimeMemory& AddonRealtimeMemory() {
+	static RealtimeMemory* memory = new RealtimeMemory(); // never destroyed: blocks may be freed during static teardown
+	return *memory;
+}
+
+template <typename T>
+struct RealtimeAllocator {
+	using value_type = T;
+
+	RealtimeAllocator() = default;
+	template <typename U>
+	RealtimeAllocator(const RealtimeAllocator<U>&) {}
+
+	T* allocate(size_t n) {
+		if (n > (size_t)-1 / sizeof(T)) throw std::bad_alloc();
+		void* p = AddonRealtimeMemory().Allocate(n * sizeof(T));
+		if (!p) throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t) { AddonRealtimeMemory().Free(p); }
+
+	template <typename U>
+	bool operator==(const RealtimeAllocator<U>&) const { return true; }
+	template <typename U>
+	bool operator!=(const RealtimeAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using RealtimeVector = std::vector<T, RealtimeAllocator<T>>;
@@ -0,0 +1,535 @@
+#pragma once
+
+// RegionCapture: grabs one rectangle of the screen at native resolution for
+// screen translation, as raw pixels instead of a PNG of the whole display.
+//
+//   const capture = new addon.RegionCapture({ x, y, width, height, format?, scale?, maxFps?, tileSize? });
+//   capture.grab(timeoutMs?) -> Promise<{ data, width, height, stride, format, changed,
+//                                         changedRatio, changedRect, tiles, tileSize,
+//                                         rowHashes, timestampMs }>
+//   capture.grabRect({ x, y, width, height }, timeoutMs?) -> Promise<frame>
+//   capture.setRegion({ x, y, width, height });
+//   capture.close();
+//
+// The rectangle is in global desktop coordinates in the platform's own unit:
+// physical pixels on Windows (screen.dipToScreenRect), points on macOS (the
+// Electron DIP rectangle as is); it must lie on one display and is clipped to
+// it. data holds height rows of stride bytes: 'bgra' (default) is 4 bytes per
+// pixel, 'gray' one byte of BT.601 luma, ready for OCR; scale (0.05-1,
+// default 1) shrinks the frame. Crop, scale and the luma conversion all
+// happen on the GPU, so a gray frame reads back one byte per output pixel
+// rather than four per screen pixel. The platform grabber keeps its
+// duplication/stream and GPU surfaces open between grabs, so a watched region
+// costs one small copy per grab: Desktop Duplication on Windows
+// (desktop_duplication.cc, a compute pass), ScreenCaptureKit on macOS (macOS
+// 12.3+, screen_region_capture.mm, the stream's own scaler and 4:2:0 luma). grab() waits up to timeoutMs (default 100) for
+// a new frame; when the screen has not changed inside the region it resolves
+// with the previous pixels and changed: false, so a watcher can skip OCR.
+// Change is judged per tile (tile_hash.h, tileSize pixels, default 32):
+// changedRatio is the share of tiles that differ from the previous grab and
+// changedRect ({ x, y, width, height } in frame pixels, or null) bounds them,
+// so OCR can be limited to the rows that changed. rowHashes is a Buffer of one
+// little-endian 64-bit checksum per row of tiles (tileSize pixel rows, top
+// down); equal runs of it mean equal bands of pixels, so OCR results can be
+// cached under them.
+// grabRect() crops the newest frame to a rectangle inside the region (same
+// units as the region, clipped to it) without hashing tiles: it returns at
+// once with the frame already held (timeoutMs 0, the default) or waits up to
+// timeoutMs for a newer one. Armed over a whole display, a
+// capture answers a box selection with no desktopCapturer enumeration and no
+// thumbnail render; such frames have changed: true and no tiles.
+// Grabs run on the task pool and are serialised per capture; close()
+// (or garbage collection) releases the device resources.
+//
+//   addon.preprocessForOcr(frame, { crop?, height?, scale?, contrast? })
+//     -> Promise<{ data, width, height, scaleX, scaleY }>
+//
+// turns a grabbed frame ({ data, width, height, stride?, format? }) into the
+// gray8 image the OCR engine reads (ocr_preprocess.h): crop ({ x, y, width,
+// height } in frame pixels), scale to `height` rows or by `scale`, then
+// contrast 'none' (default), 'stretch' or 'binarize'. data is tightly packed
+// (stride == width); scaleX/scaleY are output pixels per frame pixel, to map
+// recognised boxes back. Runs on the threadpool; frame.data is not copied.
+//
+//   addon.findTextRegions(frame, { crop?, threshold?, padding? })
+//     -> Promise<{ regions: [{ x, y, width, height }], coverage }>
+//
+// proposes the rectangles of a frame (or of its crop) that probably hold
+// text (text_regions.h), in frame pixels and reading order, so OCR can skip
+// video, photos and empty UI; coverage is their share of the searched area.
+// BGRA frames are converted to gray first; 'gray' frames are read in place.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "async_query.h"
+#include "capture_options.h"
+#include "ocr_preprocess.h"
+#include "text_regions.h"
+#include "tile_hash.h"
+
+enum class RegionFormat : uint8_t { Bgra, Gray };
+
+struct RegionRect {
+	int32_t x = 0, y = 0;
+	uint32_t width = 0, height = 0;
+};
+
+struct RegionFrame {
+	std::vector<uint8_t> pixels;
+	uint32_t width = 0, height = 0, stride = 0;
+	RegionFormat format = RegionFormat::Bgra;
+	bool changed = false; // some tile differs from the previous grab
+	TileChange tiles;
+	uint32_t tileSize = 0;
+	std::vector<uint64_t> rowHashes; // per row of tiles, TileHasher::RowHashes
+	double timestampMs = 0.0; // when the frame was presented, on the deviceClockMs() clock
+};
+
+// Copies height rows of BGRA (or, srcGray, of luma already converted on the
+// GPU) from src into frame->pixels in frame->format, tightly packed;
+// frame->width and height must be set.
+inline void CopyRegionPixels(const uint8_t* src, size_t srcStride, RegionFrame* frame, bool srcGray = false) {
+	const uint32_t w = frame->width, h = frame->height;
+	frame->stride = frame->format == RegionFormat::Gray ? w : w * 4;
+	frame->pixels.resize((size_t)frame->stride * h);
+	for (uint32_t row = 0; row < h; ++row) {
+		const uint8_t* s = src + (size_t)row * srcStride;
+		uint8_t* d = frame->pixels.data() + (size_t)row * frame->stride;
+		if (frame->format == RegionFormat::Bgra || srcGray) {
+			std::copy(s, s + (size_t)frame->stride, d);
+			continue;
+		}
+		// BT.601 luma in 8.8 fixed point
+		for (uint32_t i = 0; i < w; ++i, s += 4) d[i] = (uint8_t)((29 * s[0] + 150 * s[1] + 77 * s[2]) >> 8);
+	}
+}
+
+struct RegionCaptureOptions {
+	RegionRect rect;
+	RegionFormat format = RegionFormat::Bgra;
+	float scale = 1.0f;  // output pixels per screen pixel
+	uint32_t maxFps = 10; // macOS stream rate; Windows grabs on demand
+	uint32_t tileSize = 32;
+};
+
+// Reads { x, y, width, height } from value; false with a TypeError pending.
+inline bool ReadRegionRect(Napi::Env env, const Napi::Value& value, RegionRect* rect) {
+	if (!value.IsObject()) {
+		Napi::TypeError::New(env, "Region { x, y, width, height } required").ThrowAsJavaScriptException();
+		return false;
+	}
+	Napi::Object obj = value.As<Napi::Object>();
+	for (const char* key : { "x", "y", "width", "height" }) {
+		if (!obj.Get(key).IsNumber()) {
+			Napi::TypeError::New(env, std::string("Region ") + key + " must be a number").ThrowAsJavaScriptException();
+			return false;
+		}
+	}
+	const double width = obj.Get("width").As<Napi::Number>().DoubleValue();
+	const double height = obj.Get("height").As<Napi::Number>().DoubleValue();
+	if (!(width >= 1 && height >= 1 && width <= 16384 && height <= 16384)) {
+		Napi::RangeError::New(env, "Region width and height must be 1-16384").ThrowAsJavaScriptException();
+		return false;
+	}
+	rect->x = (int32_t)std::floor(obj.Get("x").As<Napi::Number>().DoubleValue());
+	rect->y = (int32_t)std::floor(obj.Get("y").As<Napi::Number>().DoubleValue());
+	rect->width = (uint32_t)std::ceil(width);
+	rect->height = (uint32_t)std::ceil(height);
+	return true;
+}
+
+// The pixels of a width x height frame showing the global rectangle shown
+// that lie under the global rectangle rect, as *crop in frame pixels; false
+// when the two do not overlap. On macOS the frame is in the display's pixels
+// and the rectangles in points, hence the scale.
+inline bool MapRegionCrop(const RegionRect& shown, uint32_t width, uint32_t height, const RegionRect& rect, TileRect* crop) {
+	if (shown.width == 0 || shown.height == 0 || width == 0 || height == 0) return false;
+	const double sx = (double)width / (double)shown.width, sy = (double)height / (double)shown.height;
+	const double x0 = (double)std::max(rect.x, shown.x) - shown.x;
+	const double y0 = (double)std::max(rect.y, shown.y) - shown.y;
+	const double x1 = std::min((double)rect.x + rect.width, (double)shown.x + shown.width) - shown.x;
+	const double y1 = std::min((double)rect.y + rect.height, (double)shown.y + shown.height) - shown.y;
+	if (x1 <= x0 || y1 <= y0) return false;
+	const uint32_t left = std::min<uint32_t>((uint32_t)std::floor(x0 * sx), width - 1);
+	const uint32_t top = std::min<uint32_t>((uint32_t)std::floor(y0 * sy), height - 1);
+	crop->x = left;
+	crop->y = top;
+	crop->width = std::max<uint32_t>(1, std::min<uint32_t>((uint32_t)std::ceil(x1 * sx), width) - left);
+	crop->height = std::max<uint32_t>(1, std::min<uint32_t>((uint32_t)std::ceil(y1 * sy), height) - top);
+	return true;
+}
+
+// Copies crop out of a BGRA (or gray) image into frame, for grabRect: marked
+// changed, with no tiles.
+inline void CopyRegionCrop(const uint8_t* src, size_t srcStride, const TileRect& crop, RegionFrame* frame, bool srcGray = false) {
+	frame->width = crop.width;
+	frame->height = crop.height;
+	CopyRegionPixels(src + (size_t)crop.y * srcStride + (size_t)crop.x * (srcGray ? 1 : 4), srcStride, frame, srcGray);
+	frame->tiles = TileChange();
+	frame->changed = true;
+	frame->tileSize = 0;
+	frame->rowHashes.clear();
+}
+
+// CPU stand-in for the GPU pass: nearest-pixel scaling of a srcWidth x
+// srcHeight BGRA image to frame->width x height, converted as
+// CopyRegionPixels does.
+inline void ScaleRegionPixels(const uint8_t* src, size_t srcStride, uint32_t srcWidth, uint32_t srcHeight, RegionFrame* frame) {
+	const uint32_t w = frame->width, h = frame->height;
+	frame->stride = frame->format == RegionFormat::Gray ? w : w * 4;
+	frame->pixels.resize((size_t)frame->stride * h);
+	std::vector<uint32_t> columns(w);
+	for (uint32_t x = 0; x < w; ++x) columns[x] = std::min(srcWidth - 1, (uint32_t)(((uint64_t)x * 2 + 1) * srcWidth / (2 * (uint64_t)w)));
+	for (uint32_t row = 0; row < h; ++row) {
+		const uint8_t* s = src + (size_t)std::min(srcHeight - 1, (uint32_t)(((uint64_t)row * 2 + 1) * srcHeight / (2 * (uint64_t)h))) * srcStride;
+		uint8_t* d = frame->pixels.data() + (size_t)row * frame->stride;
+		for (uint32_t x = 0; x < w; ++x) {
+			const uint8_t* p = s + (size_t)columns[x] * 4;
+			if (frame->format == RegionFormat::Bgra) std::copy(p, p + 4, d + (size_t)x * 4);
+			else d[x] = (uint8_t)((29 * p[0] + 150 * p[1] + 77 * p[2]) >> 8);
+		}
+	}
+}
+
+// Hashes a freshly copied frame's tiles into frame->tiles and sets
+// frame->changed from them; hints as for TileHasher::Update.
+inline void DetectRegionChange(TileHasher* hasher, RegionFrame* frame, const std::vector<TileRect>* hints) {
+	frame->tiles = hasher->Update(frame->pixels.data(), frame->width, frame->height, frame->stride,
+	                              frame->format == RegionFormat::Gray ? 1 : 4, hints);
+	frame->changed = frame->tiles.changed > 0;
+	frame->tileSize = hasher->TileSize();
+	hasher->RowHashes(&frame->rowHashes);
+}
+
+// For a grab that copied the previous pixels again: no tile changed.
+inline void KeepRegionTiles(const TileHasher& hasher, RegionFrame* frame) {
+	frame->tiles = TileChange();
+	frame->tiles.tiles = hasher.Tiles();
+	frame->changed = false;
+	frame->tileSize = hasher.TileSize();
+	hasher.RowHashes(&frame->rowHashes);
+}
+
+struct OcrPreprocessResult {
+	OcrImage image;
+	std::string error;
+	bool ok = false;
+};
+
+// A frame argument of preprocessForOcr/findTextRegions: { data, width,
+// height, stride?, format? }, its Buffer referenced for the threadpool.
+struct OcrFrameArg {
+	std::shared_ptr<Napi::ObjectReference> keep;
+	const uint8_t* pixels = nullptr;
+	uint32_t width = 0, height = 0, stride = 0;
+	bool bgra = true;
+};
+
+// False with a TypeError/RangeError pending.
+inline bool ReadOcrFrame(Napi::Env env, const Napi::Value& value, OcrFrameArg* frame) {
+	if (!value.IsObject()) {
+		Napi::TypeError::New(env, "Frame { data, width, height, stride?, format? } required").ThrowAsJavaScriptException();
+		return false;
+	}
+	Napi::Object obj = value.As<Napi::Object>();
+	if (!obj.Get("data").IsBuffer() || !obj.Get("width").IsNumber() || !obj.Get("height").IsNumber()) {
+		Napi::TypeError::New(env, "Frame needs a data Buffer, width and height").ThrowAsJavaScriptException();
+		return false;
+	}
+	Napi::Buffer<uint8_t> data = obj.Get("data").As<Napi::Buffer<uint8_t>>();
+	int format = 0;
+	std::string error;
+	if (!ReadUint32Option(obj, "width", 1, 16384, &frame->width, &error) ||
+	    !ReadUint32Option(obj, "height", 1, 16384, &frame->height, &error) ||
+	    !ReadEnumOption(obj, "format", { "bgra", "gray" }, &format, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return false;
+	}
+	frame->bgra = format == 0;
+	frame->stride = frame->bgra ? frame->width * 4 : frame->width;
+	if (!ReadUint32Option(obj, "stride", frame->stride, 65536 * 4, &frame->stride, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return false;
+	}
+	if (data.Length() < (size_t)frame->stride * (frame->height - 1) + (frame->bgra ? frame->width * 4 : frame->width)) {
+		Napi::RangeError::New(env, "Frame data is shorter than height rows of stride bytes").ThrowAsJavaScriptException();
+		return false;
+	}
+	// The reference keeps the frame's Buffer alive (and unmoved) while the pool reads it
+	frame->keep = std::make_shared<Napi::ObjectReference>(Napi::Persistent(data.As<Napi::Object>()));
+	frame->pixels = data.Data();
+	return true;
+}
+
+// Reads crop { x, y, width, height } when present; false with a TypeError pending.
+inline bool ReadOcrCrop(Napi::Env env, const Napi::Object& options, uint32_t* x, uint32_t* y, uint32_t* width, uint32_t* height) {
+	if (!options.Get("crop").IsObject()) return true;
+	Napi::Object crop = options.Get("crop").As<Napi::Object>();
+	std::string error;
+	if (!ReadUint32Option(crop, "x", 0, 16383, x, &error) ||
+	    !ReadUint32Option(crop, "y", 0, 16383, y, &error) ||
+	    !ReadUint32Option(crop, "width", 1, 16384, width, &error) ||
+	    !ReadUint32Option(crop, "height", 1, 16384, height, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return false;
+	}
+	return true;
+}
+
+// preprocessForOcr(frame, options?) -> Promise<{ data, width, height, scaleX, scaleY }>
+inline Napi::Value PreprocessForOcr(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	OcrFrameArg frame;
+	if (!ReadOcrFrame(env, info.Length() > 0 ? info[0] : env.Undefined(), &frame)) return env.Null();
+	OcrPreprocessConfig config;
+	int contrast = 0;
+	std::string error;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object obj = info[1].As<Napi::Object>();
+		if (!ReadOcrCrop(env, obj, &config.cropX, &config.cropY, &config.cropWidth, &config.cropHeight)) return env.Null();
+		if (!ReadUint32Option(obj, "height", 8, 4096, &config.height, &error) ||
+		    !ReadFloatOption(obj, "scale", 0.05f, 8.0f, &config.scale, &error) ||
+		    !ReadEnumOption(obj, "contrast", { "none", "stretch", "binarize" }, &contrast, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		config.contrast = (OcrContrast)contrast;
+	}
+
+	return QueueQuery(env, "preprocessForOcr",
+		[frame, config]() {
+			// One preprocessor (and its swscale context or scratch rows) per pool thread
+			static thread_local OcrPreprocessor preprocessor;
+			OcrPreprocessResult r;
+			r.ok = preprocessor.Process(frame.pixels, frame.width, frame.height, frame.stride, frame.bgra, config, &r.image, &r.error);
+			return r;
+		},
+		[](Napi::Env env, OcrPreprocessResult& r) -> Napi::Value {
+			if (!r.ok) {
+				Napi::RangeError::New(env, r.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object o = Napi::Object::New(env);
+			auto* pixels = new std::vector<uint8_t>(std::move(r.image.pixels));
+			o.Set("data", Napi::Buffer<uint8_t>::New(env, pixels->data(), pixels->size(),
+				[](Napi::Env, uint8_t*, std::vector<uint8_t>* p) { delete p; }, pixels));
+			o.Set("width", Napi::Number::New(env, r.image.width));
+			o.Set("height", Napi::Number::New(env, r.image.height));
+			o.Set("scaleX", Napi::Number::New(env, r.image.scaleX));
+			o.Set("scaleY", Napi::Number::New(env, r.image.scaleY));
+			return o;
+		}, TaskPriority::Background);
+}
+
+struct TextRegionResult {
+	std::vector<TileRect> regions;
+	double coverage = 0.0;
+};
+
+// findTextRegions(frame, options?) -> Promise<{ regions: [{ x, y, width, height }], coverage }>
+inline Napi::Value FindTextRegions(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	OcrFrameArg frame;
+	if (!ReadOcrFrame(env, info.Length() > 0 ? info[0] : env.Undefined(), &frame)) return env.Null();
+	TextRegionConfig config;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object obj = info[1].As<Napi::Object>();
+		uint32_t threshold = config.edgeThreshold;
+		std::string error;
+		if (!ReadOcrCrop(env, obj, &config.cropX, &config.cropY, &config.cropWidth, &config.cropHeight)) return env.Null();
+		if (!ReadUint32Option(obj, "threshold", 4, 250, &threshold, &error) ||
+		    !ReadUint32Option(obj, "padding", 0, 64, &config.padding, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		config.edgeThreshold = (uint8_t)threshold;
+	}
+	return QueueQuery(env, "findTextRegions",
+		[frame, config]() {
+			static thread_local TextRegionFinder finder;
+			static thread_local std::vector<uint8_t> gray;
+			TextRegionResult r;
+			const uint8_t* pixels = frame.pixels;
+			size_t stride = frame.stride;
+			if (frame.bgra) {
+				// Only the searched rows are converted
+				const uint32_t top = std::min(config.cropY, frame.height - 1);
+				const uint32_t rows = std::min(config.cropHeight ? config.cropHeight : frame.height, frame.height - top);
+				gray.resize((size_t)frame.width * frame.height);
+				for (uint32_t y = top; y < top + rows; ++y) {
+					const uint8_t* s = frame.pixels + (size_t)y * frame.stride;
+					uint8_t* d = &gray[(size_t)y * frame.width];
+					for (uint32_t x = 0; x < frame.width; ++x, s += 4) d[x] = (uint8_t)((29 * s[0] + 150 * s[1] + 77 * s[2]) >> 8);
+				}
+				pixels = gray.data();
+				stride = frame.width;
+			}
+			finder.Find(pixels, frame.width, frame.height, stride, config, &r.regions);
+			const uint32_t x0 = std::min(config.cropX, frame.width), y0 = std::min(config.cropY, frame.height);
+			const double searched = (double)std::min(config.cropWidth ? config.cropWidth : frame.width, frame.width - x0) *
+			                        (double)std::min(config.cropHeight ? config.cropHeight : frame.height, frame.height - y0);
+			double covered = 0.0;
+			for (const TileRect& rect : r.regions) covered += (double)rect.width * rect.height;
+			r.coverage = searched > 0.0 ? std::min(1.0, covered / searched) : 0.0;
+			return r;
+		},
+		[](Napi::Env env, TextRegionResult& r) -> Napi::Value {
+			Napi::Object o = Napi::Object::New(env);
+			Napi::Array regions = Napi::Array::New(env, r.regions.size());
+			for (size_t i = 0; i < r.regions.size(); ++i) {
+				Napi::Object rect = Napi::Object::New(env);
+				rect.Set("x", Napi::Number::New(env, r.regions[i].x));
+				rect.Set("y", Napi::Number::New(env, r.regions[i].y));
+				rect.Set("width", Napi::Number::New(env, r.regions[i].width));
+				rect.Set("height", Napi::Number::New(env, r.regions[i].height));
+				regions.Set((uint32_t)i, rect);
+			}
+			o.Set("regions", regions);
+			o.Set("coverage", Napi::Number::New(env, r.coverage));
+			return o;
+		}, TaskPriority::Background);
+}
+
+// Grabber is the platform back end:
+//   void Configure(const RegionCaptureOptions&);   // JS thread; reopens lazily
+//   bool Grab(uint32_t timeoutMs, RegionFrame* frame, std::string* error); // threadpool
+//   bool GrabRect(const RegionRect& rect, uint32_t timeoutMs, RegionFrame* frame, std::string* error);
+//   void Close();
+// and serialises those calls itself.
+template <class Grabber>
+class RegionCaptureWrap : public Napi::ObjectWrap<RegionCaptureWrap<Grabber>> {
+public:
+	static void Init(Napi::Env env, Napi::Object exports) {
+		Napi::Function ctor = RegionCaptureWrap::DefineClass(env, "RegionCapture", {
+			RegionCaptureWrap::InstanceMethod("grab", &RegionCaptureWrap::Grab),
+			RegionCaptureWrap::InstanceMethod("grabRect", &RegionCaptureWrap::GrabRect),
+			RegionCaptureWrap::InstanceMethod("setRegion", &RegionCaptureWrap::SetRegion),
+			RegionCaptureWrap::InstanceMethod("close", &RegionCaptureWrap::Close),
+		});
+		exports.Set("RegionCapture", ctor);
+		exports.Set("preprocessForOcr", Napi::Function::New(env, PreprocessForOcr));
+		exports.Set("findTextRegions", Napi::Function::New(env, FindTextRegions));
+	}
+
+	explicit RegionCaptureWrap(const Napi::CallbackInfo& info)
+		: Napi::ObjectWrap<RegionCaptureWrap>(info), grabber_(std::make_shared<Grabber>()) {
+		Napi::Env env = info.Env();
+		if (!ReadRegionRect(env, info[0], &options_.rect)) return;
+		Napi::Object obj = info[0].As<Napi::Object>();
+		std::string error;
+		int format = 0;
+		if (!ReadEnumOption(obj, "format", { "bgra", "gray" }, &format, &error) ||
+		    !ReadFloatOption(obj, "scale", 0.05f, 1.0f, &options_.scale, &error) ||
+		    !ReadUint32Option(obj, "maxFps", 1, 60, &options_.maxFps, &error) ||
+		    !ReadUint32Option(obj, "tileSize", 16, 256, &options_.tileSize, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return;
+		}
+		options_.format = (RegionFormat)format;
+		grabber_->Configure(options_);
+	}
+
+	~RegionCaptureWrap() { grabber_->Close(); }
+
+private:
+	struct GrabResult {
+		RegionFrame frame;
+		std::string error;
+		bool ok = false;
+	};
+
+	// grab(timeoutMs?) -> Promise<frame>
+	Napi::Value Grab(const Napi::CallbackInfo& info) {
+		uint32_t timeoutMs = 100;
+		if (info.Length() > 0 && info[0].IsNumber()) timeoutMs = std::min<uint32_t>(info[0].As<Napi::Number>().Uint32Value(), 5000);
+		// The worker holds its own reference, so a collected wrapper cannot pull the grabber from under it
+		std::shared_ptr<Grabber> grabber = grabber_;
+		return QueueQuery(info.Env(), "RegionCapture.grab",
+			[grabber, timeoutMs]() {
+				GrabResult r;
+				r.ok = grabber->Grab(timeoutMs, &r.frame, &r.error);
+				return r;
+			},
+			FrameToJs, TaskPriority::Interactive);
+	}
+
+	// grabRect(rect, timeoutMs?) -> Promise<frame>
+	Napi::Value GrabRect(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		RegionRect rect;
+		if (!ReadRegionRect(env, info.Length() > 0 ? info[0] : env.Undefined(), &rect)) return env.Null();
+		uint32_t timeoutMs = 0;
+		if (info.Length() > 1 && info[1].IsNumber()) timeoutMs = std::min<uint32_t>(info[1].As<Napi::Number>().Uint32Value(), 5000);
+		std::shared_ptr<Grabber> grabber = grabber_;
+		return QueueQuery(env, "RegionCapture.grabRect",
+			[grabber, rect, timeoutMs]() {
+				GrabResult r;
+				r.ok = grabber->GrabRect(rect, timeoutMs, &r.frame, &r.error);
+				return r;
+			},
+			FrameToJs, TaskPriority::Interactive);
+	}
+
+	static Napi::Value FrameToJs(Napi::Env env, GrabResult& r) {
+		if (!r.ok) {
+			Napi::Error::New(env, r.error).ThrowAsJavaScriptException();
+			return env.Undefined();
+		}
+		Napi::Object o = Napi::Object::New(env);
+		// Hand the pixels to the Buffer instead of copying them again
+		auto* pixels = new std::vector<uint8_t>(std::move(r.frame.pixels));
+		o.Set("data", Napi::Buffer<uint8_t>::New(env, pixels->data(), pixels->size(),
+			[](Napi::Env, uint8_t*, std::vector<uint8_t>* p) { delete p; }, pixels));
+		o.Set("width", Napi::Number::New(env, r.frame.width));
+		o.Set("height", Napi::Number::New(env, r.frame.height));
+		o.Set("stride", Napi::Number::New(env, r.frame.stride));
+		o.Set("format", Napi::String::New(env, r.frame.format == RegionFormat::Gray ? "gray" : "bgra"));
+		o.Set("changed", Napi::Boolean::New(env, r.frame.changed));
+		o.Set("changedRatio", Napi::Number::New(env, r.frame.tiles.Ratio()));
+		if (r.frame.tiles.changed) {
+			const TileRect& b = r.frame.tiles.bounds;
+			Napi::Object rect = Napi::Object::New(env);
+			rect.Set("x", Napi::Number::New(env, b.x));
+			rect.Set("y", Napi::Number::New(env, b.y));
+			rect.Set("width", Napi::Number::New(env, b.width));
+			rect.Set("height", Napi::Number::New(env, b.height));
+			o.Set("changedRect", rect);
+		} else {
+			o.Set("changedRect", env.Null());
+		}
+		o.Set("tiles", Napi::Number::New(env, r.frame.tiles.tiles));
+		o.Set("tileSize", Napi::Number::New(env, r.frame.tileSize));
+		const std::vector<uint64_t>& rows = r.frame.rowHashes;
+		Napi::Buffer<uint8_t> rowHashes = Napi::Buffer<uint8_t>::New(env, rows.size() * 8);
+		for (size_t i = 0; i < rows.size(); ++i) {
+			for (int b = 0; b < 8; ++b) rowHashes.Data()[i * 8 + b] = (uint8_t)(rows[i] >> (8 * b));
+		}
+		o.Set("rowHashes", rowHashes);
+		o.Set("timestampMs", Napi::Number::New(env, r.frame.timestampMs));
+		return o;
+	}
+
+	Napi::Value SetRegion(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		RegionRect rect;
+		if (info.Length() < 1 || !ReadRegionRect(env, info[0], &rect)) return env.Null();
+		options_.rect = rect;
+		grabber_->Configure(options_);
+		return env.Undefined();
+	}
+
+	Napi::Value Close(const Napi::CallbackInfo& info) {
+		grabber_->Close();
+		return info.Env().Undefined();
+	}
+
+	std::shared_ptr<Grabber> grabber_;
+	RegionCaptureOptions options_;
+};
@@ -0,0 +1,189 @@
+#pragma once
+
+// Mixes several RenderSources into one output stream, so everything bound
+// for the virtual microphone - a render session's TTS queue, the soundboard's
+// mic bus, the capture's own audio (capture_return.h) - reaches the cable as
+// one stream at one latency. Each input has a gain and can be ducked: while
+// any of the inputs in its duckBy mask is active (its envelope above
+// -45 dBFS), its gain drops by duckDb, falling over about kAttackMs and
+// recovering over kReleaseMs. Gain steps ramp across a block, so nothing
+// clicks. The sum is clamped to full scale.
+//
+// Inputs register without a lock, like the soundboard's voices: a slot moves
+// Free -> Armed (JS) -> Playing (render) -> Done (render, once JS asked for
+// its removal) -> Free (JS). An input is attached while the mixer is (see
+// render_source.h) and must outlive its slot.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "render_source.h"
+
+class RenderMixer : public RenderSource {
+public:
+	static constexpr size_t kMaxInputs = 8;
+	static constexpr size_t kBlock = 256;
+	static constexpr uint32_t kRate = 48000; // kSoundboardRate
+	static constexpr float kActiveLevel = 0.005623413f; // -45 dBFS
+	static constexpr float kAttackMs = 15.0f;
+	static constexpr float kReleaseMs = 300.0f;
+	static constexpr float kLevelReleaseMs = 150.0f; // envelope hold after an input goes quiet
+
+	struct InputConfig {
+		float gain = 1.0f;   // linear
+		float duckDb = 0.0f; // <= 0; applied while an input of duckBy is active
+		uint32_t duckBy = 0; // slot mask
+	};
+
+	// JS thread: adds source in a free slot; -1 when all are taken.
+	int Add(RenderSource* source, const InputConfig& config) {
+		Reap();
+		for (size_t i = 0; i < kMaxInputs; ++i) {
+			Input& in = inputs_[i];
+			if (in.state.load(std::memory_order_acquire) != Input::Free) continue;
+			in.source = source;
+			in.remove.store(false, std::memory_order_relaxed);
+			in.level = 0.0f;
+			in.applied = -1.0f; // starts at its target
+			Configure(i, config);
+			if (Attached()) source->Attach();
+			in.state.store(Input::Armed, std::memory_order_release);
+			return (int)i;
+		}
+		return -1;
+	}
+
+	// JS thread: the slot's source is rendered no more once Reap() frees it.
+	void Remove(int slot) {
+		if (slot < 0 || (size_t)slot >= kMaxInputs) return;
+		Input& in = inputs_[slot];
+		const int s = in.state.load(std::memory_order_acquire);
+		if (s == Input::Free) return;
+		if (!Attached()) {
+			in.state.store(Input::Free, std::memory_order_relaxed);
+			return;
+		}
+		in.remove.store(true, std::memory_order_release);
+		Reap();
+	}
+
+	// JS thread, any time.
+	void Configure(int slot, const InputConfig& config) {
+		Input& in = inputs_[slot];
+		in.gain.store(config.gain, std::memory_order_relaxed);
+		in.duckGain.store(std::pow(10.0f, std::min(config.duckDb, 0.0f) / 20.0f), std::memory_order_relaxed);
+		in.duckBy.store(config.duckBy & ~(1u << slot), std::memory_order_relaxed);
+	}
+
+	// JS thread: frees the slots the render thread has let go of.
+	void Reap() {
+		for (Input& in : inputs_) {
+			if (in.state.load(std::memory_order_acquire) != Input::Done) continue;
+			in.source->Detach();
+			in.state.store(Input::Free, std::memory_order_relaxed);
+		}
+	}
+
+	// Envelope of the slot's input, dBFS (render thread's latest).
+	float LevelDb(int slot) const {
+		const float level = inputs_[slot].levelOut.load(std::memory_order_relaxed);
+		return level > 1e-6f ? 20.0f * std::log10(level) : -120.0f;
+	}
+	bool Ducked(int slot) const { return inputs_[slot].ducked.load(std::memory_order_relaxed); }
+
+	void Attach() override {
+		for (Input& in : inputs_) {
+			if (in.state.load(std::memory_order_acquire) == Input::Armed) in.source->Attach();
+		}
+		active_ = 0;
+		attached_.store(true, std::memory_order_release);
+	}
+	// The render thread has stopped: inputs detach and re-arm for the next start.
+	void Detach() override {
+		attached_.store(false, std::memory_order_release);
+		for (Input& in : inputs_) {
+			const int s = in.state.load(std::memory_order_acquire);
+			if (s == Input::Free) continue;
+			in.source->Detach();
+			const bool removed = s == Input::Done || in.remove.load(std::memory_order_relaxed);
+			in.state.store(removed ? Input::Free : Input::Armed, std::memory_order_relaxed);
+			in.level = 0.0f;
+			in.applied = -1.0f;
+		}
+	}
+	bool Attached() const { return attached_.load(std::memory_order_acquire); }
+
+	void Render(float* out, size_t frames, uint32_t channels) override {
+		memset(out, 0, frames * channels * sizeof(float));
+		for (Input& in : inputs_) {
+			const int s = in.state.load(std::memory_order_acquire);
+			if (s == Input::Armed) in.state.store(Input::Playing, std::memory_order_relaxed);
+			if (s == Input::Armed || s == Input::Playing) {
+				if (in.remove.load(std::memory_order_acquire)) in.state.store(Input::Done, std::memory_order_release);
+			}
+		}
+		// Sources only fill the first two channels: render them as stereo (or mono)
+		const uint32_t width = std::min<uint32_t>(channels, 2);
+		for (size_t done = 0; done < frames;) {
+			const size_t n = std::min(frames - done, kBlock);
+			const float levelFall = std::exp(-(float)n / (kLevelReleaseMs * kRate / 1000.0f));
+			const float attack = 1.0f - std::exp(-(float)n / (kAttackMs * kRate / 1000.0f));
+			const float release = 1.0f - std::exp(-(float)n / (kReleaseMs * kRate / 1000.0f));
+			uint32_t active = 0;
+			for (size_t i = 0; i < kMaxInputs; ++i) {
+				Input& in = inputs_[i];
+				if (in.state.load(std::memory_order_relaxed) != Input::Playing) continue;
+				in.source->Render(scratch_, n, width);
+				float peak = 0.0f;
+				for (size_t k = 0; k < n * width; ++k) peak = std::max(peak, std::fabs(scratch_[k]));
+				in.level = std::max(peak, in.level * levelFall);
+				if (in.level > kActiveLevel) active |= 1u << i;
+				// Ducking follows the previous block's activity
+				const bool ducked = (in.duckBy.load(std::memory_order_relaxed) & active_) != 0;
+				const float target = in.gain.load(std::memory_order_relaxed) *
+				                     (ducked ? in.duckGain.load(std::memory_order_relaxed) : 1.0f);
+				const float from = in.applied < 0.0f ? target : in.applied;
+				const float to = from + (target - from) * (target < from ? attack : release);
+				in.applied = to;
+				const float slope = (to - from) / (float)n;
+				float* o = out + done * channels;
+				for (size_t f = 0; f < n; ++f) {
+					const float g = from + slope * (float)(f + 1);
+					for (uint32_t c = 0; c < width; ++c) o[f * channels + c] += scratch_[f * width + c] * g;
+				}
+				in.levelOut.store(in.level, std::memory_order_relaxed);
+				in.ducked.store(ducked, std::memory_order_relaxed);
+			}
+			active_ = active;
+			done += n;
+		}
+		for (size_t f = 0; f < frames; ++f) {
+			for (uint32_t c = 0; c < width; ++c) out[f * channels + c] = std::min(std::max(out[f * channels + c], -1.0f), 1.0f);
+		}
+	}
+
+private:
+	struct Input {
+		enum State { Free, Armed, Playing, Done };
+		std::atomic<int> state{Free};
+		std::atomic<bool> remove{false};
+		RenderSource* source = nullptr;
+		std::atomic<float> gain{1.0f};
+		std::atomic<float> duckGain{1.0f};
+		std::atomic<uint32_t> duckBy{0};
+		std::atomic<float> levelOut{0.0f};
+		std::atomic<bool> ducked{false};
+		// Render thread
+		float level = 0.0f;    // peak envelope
+		float applied = -1.0f; // gain reached at the end of the last block; < 0 before the first
+	};
+
+	Input inputs_[kMaxInputs];
+	std::atomic<bool> attached_{false};
+	uint32_t active_ = 0; // render thread: inputs active in the last block
+	float scratch_[kBlock * 2] = {};
+};
@@ -0,0 +1,1025 @@
+#pragma once
+
+// RenderSession: a JS-owned native output stream for PCM pushed from JS or
+// straight from a native stream decoder (stream_decoder.h), so translated
+// speech reaches the virtual microphone without the renderer's AudioContext
+// and setSinkId buffering on top of the device's own.
+//
+//   const session = new addon.RenderSession();
+//   session.start({ device?, sampleRate?, prebufferMs?, jitterBuffer?, catchUp?, lowLatency? }) -> device name
+//   session.push(pcm: Int16Array | Float32Array) -> queued ms
+//   session.pushDecoded(decoderId, bytes: Buffer) -> queued ms
+//   session.end()        // the utterance is complete: play out what is queued
+//   session.clear()      // drop everything queued (barge-in)
+//   session.stop()
+//   session.setInput(name, { enabled?, gain?, duckDb?, duckBy? }) -> enabled
+//   session.speak(voice, text, { speakerId?, lengthScale?, sentenceSilenceMs? })
+//     -> Promise<{ sentences, firstAudioMs, synthMs, audioMs, cancelled }>
+//   session.measureLatency({ timeoutMs? })
+//     -> Promise<{ outputMs, captureMs, pipelineMs?, totalMs?, match }>
+//   session.getStats()   // { queuedMs, pushedMs, playedMs, droppedMs, concealedMs,
+//                        //   underruns, targetMs, jitterMs, startDelayMs,
+//                        //   speed, catchUpMs, inputs }
+//   session.running      // read-only
+//
+// PCM is mono at sampleRate (default 24000, the TTS providers' rate) and is
+// resampled to the output's 48 kHz on the JS thread; the render thread only
+// copies out of a lock-free FIFO. Each utterance starts playing a playout
+// delay after its first push, or once it has ended. With jitterBuffer (the
+// default; true or { minMs, maxMs }) the delay adapts to how late chunks
+// arrive, starting from prebufferMs; with jitterBuffer: false it stays at
+// prebufferMs. Running dry before end() counts an underrun, which is bridged
+// by stretching the last pitch period (see PcmRenderQueue). With catchUp
+// (true or { maxSpeed, startMs, fullMs }) a queue that has fallen behind -
+// TTS of long sentences piling up during live interpretation - plays faster
+// at the same pitch (time_stretch.h): from 1x at startMs queued (default
+// 400) up to maxSpeed (default 1.3, at most 1.5) at fullMs (default 2000),
+// so the delay behind the speaker stays bounded; catchUpMs in the stats is
+// the time it has saved. device is a
+// lowercased-name substring, as for startSoundboardOutput (the virtual cable
+// when omitted); lowLatency asks the output for its smallest period
+// (IAudioClient3 on Windows, the smallest HAL IO buffer on macOS). pushDecoded needs a decoder opened at the
+// session's sampleRate. Sessions stop when stopped or garbage collected.
+//
+// The output plays a RenderMixer (render_mixer.h) whose inputs are 'tts' (the
+// queue above, always on), 'soundboard' (the soundboard's mic bus, instead
+// of its own output on the cable) and 'capture' (a running capture's
+// processed audio, capture_return.h; one session at a time), so everything
+// bound for the virtual microphone shares one stream. setInput turns the
+// other two on or off and sets an input's gain (linear, default 1) and
+// ducking: duckDb (-60..0) off while any input named in duckBy is sounding,
+// e.g. setInput('capture', { enabled: true, duckDb: -18, duckBy: ['tts',
+// 'soundboard'] }) keeps the user's own voice under the translation. Stats
+// carry each enabled input's { levelDb, ducked }.
+//
+// What the TTS input plays is also kept, at 16 kHz on the device clock, as
+// the reference captures with selfEcho compare against (self_echo.h), so our
+// own translation picked up by a loopback capture never makes a chunk.
+//
+// speak() voices text with a loaded Piper voice (piper_tts_engine.h) one
+// sentence at a time on the threadpool; each sentence is resampled from the
+// voice's rate and queued on the TTS input as soon as it is synthesised, so
+// the first one plays while the rest are voiced, and the utterance ends after
+// the last. firstAudioMs is the time from the call to the first queued
+// sample. Calls queue behind each other; clear() or stop() cancels the
+// pending ones, which resolve with cancelled: true.
+//
+// measureLatency() plays a 100 ms chirp over whatever the session plays and
+// times it through the first running capture that hears it - the loopback of
+// this output, or a microphone in front of its speakers (latency_probe.h).
+// It rejects when nothing hears it within timeoutMs (default 3000) or while
+// another measurement runs.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "addon_log.h"
+#include "async_query.h"
+#include "capture_options.h"
+#include "capture_return.h"
+#include "latency_probe.h"
+#include "piper_tts_engine.h"
+#include "render_mixer.h"
+#include "render_source.h"
+#include "resampler.h"
+#include "self_echo.h"
+#include "sentence_split.h"
+#include "soundboard_engine.h"
+#include "spsc_byte_fifo.h"
+#include "stream_decoder.h"
+#include "time_stretch.h"
+
+struct RenderQueueStats {
+	uint64_t queuedFrames = 0;
+	uint64_t pushedFrames = 0;
+	uint64_t playedFrames = 0;
+	uint64_t droppedFrames = 0;   // pushed while the FIFO was full
+	uint64_t concealedFrames = 0; // stretched over underruns
+	uint64_t underruns = 0;
+	double targetMs = 0;          // current playout delay
+	double jitterMs = 0;          // deviation of chunk lateness
+	double startDelayMs = 0;      // last utterance: first push to first sample played
+	double speed = 1.0;           // catch-up playback speed
+	uint64_t savedFrames = 0;     // skipped by catching up
+};
+
+struct JitterBufferConfig {
+	uint32_t prebufferMs = 60; // initial playout delay; the fixed one when not adaptive
+	bool adaptive = true;
+	uint32_t minMs = 20;
+	uint32_t maxMs = 500;
+};
+
+// Option "catchUp": playback speed rises linearly with the queue between
+// startMs and fullMs.
+struct CatchUpConfig {
+	bool enabled = false;
+	float maxSpeed = 1.3f;
+	uint32_t startMs = 400;
+	uint32_t fullMs = 2000;
+};
+
+inline int64_t RenderClockNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Playout delay from chunk arrivals, on the JS thread. A chunk's lateness is
+// how far its arrival trails real-time playback of everything pushed since
+// the utterance's first chunk, i.e. how much delay it needed not to underrun.
+// The delay covers the running mean plus four deviations of it, or a recent
+// peak when that is larger; the peak decays per utterance, so a late burst
+// raises the delay at once and calm utterances bring it back down.
+class JitterEstimator {
+public:
+	void Configure(const JitterBufferConfig& config) {
+		config_ = config;
+		meanMs_ = 0;
+		varMs2_ = 0;
+		peakMs_ = config.prebufferMs;
+		Update();
+	}
+
+	void Observe(double lateMs) {
+		if (!config_.adaptive) return;
+		const double x = std::max(lateMs, 0.0);
+		const double d = x - meanMs_;
+		meanMs_ += kAlpha * d;
+		varMs2_ = (1.0 - kAlpha) * (varMs2_ + kAlpha * d * d);
+		peakMs_ = std::max(peakMs_, x);
+		Update();
+	}
+
+	// End of an utterance
+	void Decay() {
+		if (!config_.adaptive) return;
+		peakMs_ *= kPeakDecay;
+		Update();
+	}
+
+	double TargetMs() const { return targetMs_; }
+	double JitterMs() const { return std::sqrt(varMs2_); }
+
+private:
+	static constexpr double kAlpha = 1.0 / 16;
+	static constexpr double kPeakDecay = 0.8;
+
+	void Update() {
+		if (!config_.adaptive) {
+			targetMs_ = config_.prebufferMs;
+			return;
+		}
+		const double want = std::max(meanMs_ + 4.0 * std::sqrt(varMs2_), peakMs_);
+		targetMs_ = std::min(std::max(want, (double)config_.minMs), (double)config_.maxMs);
+	}
+
+	JitterBufferConfig config_;
+	double meanMs_ = 0, varMs2_ = 0, peakMs_ = 0, targetMs_ = 0;
+};
+
+// Mono 48 kHz float FIFO rendered to every output channel pair. One producer
+// (the JS thread) and one consumer (the output's render thread).
+//
+// An utterance starts playing its target delay after its first push (or at
+// once when it has ended). Running dry mid-utterance stretches what was last
+// played: its pitch period repeats while fading out over kConcealFrames and
+// crossfades back into the queue once a callback's worth has arrived, so a
+// short gap costs a little latency instead of a click and silence. A gap the
+// concealment can't bridge rebuffers to the target delay. With catch-up on,
+// playing goes through a WsolaStretcher at the speed the queue depth asks for.
+class PcmRenderQueue : public RenderSource {
+public:
+	static constexpr size_t kCapacityFrames = (size_t)1 << 20; // ~22 s
+	static constexpr size_t kHistoryFrames = 2048;             // played output searched for a pitch period
+	static constexpr size_t kMinPeriod = kSoundboardRate / 400;
+	static constexpr size_t kMaxPeriod = kSoundboardRate / 60;
+	static constexpr size_t kPitchWindow = 480;
+	static constexpr size_t kConcealFrames = kSoundboardRate * 60 / 1000;
+	static constexpr size_t kFadeFrames = 96;
+	static_assert(WsolaStretcher::kRate == kSoundboardRate, "the stretcher runs at the output rate");
+
+	PcmRenderQueue() { fifo_.Reset(kCapacityFrames * sizeof(float)); }
+
+	// JS thread, while detached.
+	void Configure(const JitterBufferConfig& config, const CatchUpConfig& catchUp) {
+		jitter_.Configure(config);
+		catchUp_ = catchUp;
+		PublishTarget();
+	}
+
+	void Attach() override {
+		inUtterance_ = false;
+		attached_.store(true, std::memory_order_release);
+	}
+	// The render thread has stopped: drop whatever it didn't play.
+	void Detach() override {
+		attached_.store(false, std::memory_order_release);
+		fifo_.SkipTo(fifo_.WritePosition());
+		clearTo_.store(0, std::memory_order_relaxed);
+		endAt_.store(kNoEnd, std::memory_order_relaxed);
+		cleared_ = 0;
+		state_ = State::Idle;
+		concealLeft_ = 0;
+		fadeLeft_ = 0;
+		stretch_.Reset();
+	}
+	bool Attached() const { return attached_.load(std::memory_order_acquire); }
+
+	// JS thread. Queues what fits; the rest counts as dropped.
+	size_t Push(const float* samples, size_t n) {
+		if (!Attached()) return 0;
+		const int64_t now = RenderClockNs();
+		if (!inUtterance_) {
+			inUtterance_ = true;
+			utteranceStartNs_ = now;
+			utteranceFrames_ = 0;
+			firstPushNs_.store(now, std::memory_order_relaxed);
+			playAtNs_.store(now + (int64_t)(jitter_.TargetMs() * 1e6), std::memory_order_release);
+		} else {
+			jitter_.Observe((now - utteranceStartNs_) / 1e6 - utteranceFrames_ * 1000.0 / kSoundboardRate);
+			PublishTarget();
+		}
+		utteranceFrames_ += n;
+		const size_t room = (fifo_.Capacity() - (size_t)(fifo_.WritePosition() - fifo_.ReadPosition())) / sizeof(float);
+		const size_t queued = std::min(n, room);
+		if (queued > 0) fifo_.Write(samples, queued * sizeof(float));
+		endAt_.store(kNoEnd, std::memory_order_relaxed);
+		pushed_.fetch_add(queued, std::memory_order_relaxed);
+		if (queued < n) dropped_.fetch_add(n - queued, std::memory_order_relaxed);
+		return queued;
+	}
+
+	// JS thread: nothing more follows what is queued.
+	void End() {
+		endAt_.store(fifo_.WritePosition(), std::memory_order_release);
+		if (inUtterance_) jitter_.Decay();
+		inUtterance_ = false;
+		PublishTarget();
+	}
+	// JS thread: the render thread skips everything queued so far.
+	void Clear() {
+		clearTo_.store(fifo_.WritePosition(), std::memory_order_release);
+		inUtterance_ = false;
+	}
+
+	void Render(float* out, size_t frames, uint32_t channels) override {
+		memset(out, 0, frames * channels * sizeof(float));
+		const uint64_t clearTo = clearTo_.load(std::memory_order_acquire);
+		if (clearTo > cleared_) {
+			fifo_.SkipTo(clearTo);
+			cleared_ = clearTo;
+			state_ = State::Idle;
+			concealLeft_ = 0;
+			fadeLeft_ = 0;
+			stretch_.Reset();
+		}
+		const bool ended = endAt_.load(std::memory_order_acquire) == fifo_.WritePosition();
+		const int64_t now = RenderClockNs();
+		speed_ = CatchUpSpeed(fifo_.Available() / sizeof(float) + stretch_.Buffered());
+		float block[256];
+		size_t done = 0;
+		while (done < frames) {
+			const size_t n = std::min(frames - done, (size_t)256);
+			Fill(block, n, frames - done, ended, now);
+			float* o = out + done * channels;
+			for (size_t i = 0; i < n; ++i, o += channels) {
+				o[0] = block[i];
+				if (channels > 1) o[1] = block[i];
+				history_[historyPos_] = block[i];
+				historyPos_ = (historyPos_ + 1) & (kHistoryFrames - 1);
+			}
+			done += n;
+		}
+		speedOut_.store(speed_, std::memory_order_relaxed);
+		saved_.store(stretch_.Saved(), std::memory_order_relaxed);
+	}
+
+	RenderQueueStats Stats() const {
+		RenderQueueStats s;
+		s.queuedFrames = fifo_.Available() / sizeof(float);
+		s.pushedFrames = pushed_.load(std::memory_order_relaxed);
+		s.playedFrames = played_.load(std::memory_order_relaxed);
+		s.droppedFrames = dropped_.load(std::memory_order_relaxed);
+		s.concealedFrames = concealed_.load(std::memory_order_relaxed);
+		s.underruns = underruns_.load(std::memory_order_relaxed);
+		s.targetMs = jitter_.TargetMs();
+		s.jitterMs = jitter_.JitterMs();
+		s.startDelayMs = startDelayNs_.load(std::memory_order_relaxed) / 1e6;
+		s.speed = speedOut_.load(std::memory_order_relaxed);
+		s.savedFrames = saved_.load(std::memory_order_relaxed);
+		return s;
+	}
+
+private:
+	static constexpr uint64_t kNoEnd = ~0ull;
+	static constexpr double kCatchUpOnset = 1.02;
+
+	enum class State { Idle, Playing, Concealing, Rebuffering };
+
+	void PublishTarget() {
+		targetFrames_.store((size_t)(jitter_.TargetMs() * kSoundboardRate / 1000), std::memory_order_relaxed);
+	}
+
+	// Render thread. Stretching starts a little past startMs, so a queue
+	// hovering there doesn't toggle it, and runs until the queue is back down.
+	double CatchUpSpeed(size_t queuedFrames) const {
+		if (!catchUp_.enabled) return 1.0;
+		const double ms = queuedFrames * 1000.0 / kSoundboardRate;
+		const double t = std::min(std::max((ms - catchUp_.startMs) / (catchUp_.fullMs - catchUp_.startMs), 0.0), 1.0);
+		const double speed = 1.0 + (catchUp_.maxSpeed - 1.0) * t;
+		return stretch_.Active() || speed >= kCatchUpOnset ? speed : 1.0;
+	}
+
+	// Render thread: n frames of queued audio, concealment or silence into
+	// block; left is what this callback still needs, block included.
+	void Fill(float* block, size_t n, size_t left, bool ended, int64_t now) {
+		size_t done = 0;
+		while (done < n) {
+			const size_t queued = fifo_.Available() / sizeof(float);
+			switch (state_) {
+			case State::Idle:
+				if (queued == 0 || (!ended && now < playAtNs_.load(std::memory_order_acquire))) {
+					std::fill(block + done, block + n, 0.0f);
+					return;
+				}
+				startDelayNs_.store(now - firstPushNs_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				state_ = State::Playing;
+				break;
+			case State::Rebuffering:
+				if (queued == 0 || (!ended && queued < targetFrames_.load(std::memory_order_relaxed))) {
+					std::fill(block + done, block + n, 0.0f);
+					return;
+				}
+				state_ = State::Playing;
+				break;
+			case State::Concealing:
+				if (queued > 0 && (ended || queued >= left - done)) {
+					fadeLeft_ = kFadeFrames;
+					state_ = State::Playing;
+					break;
+				}
+				if (concealLeft_ == 0) {
+					state_ = State::Rebuffering;
+					break;
+				}
+				block[done++] = ConcealSample();
+				concealed_.fetch_add(1, std::memory_order_relaxed);
+				break;
+			case State::Playing: {
+				const size_t got = stretch_.Render(block + done, n - done, speed_, [this](float* dst, size_t max) {
+					return fifo_.Read(dst, max * sizeof(float)) / sizeof(float);
+				});
+				for (size_t i = 0; i < got && fadeLeft_ > 0; ++i, --fadeLeft_) {
+					const float w = (float)fadeLeft_ / kFadeFrames;
+					block[done + i] = block[done + i] * (1.0f - w) + ConcealSample() * w;
+				}
+				played_.fetch_add(got, std::memory_order_relaxed);
+				done += got;
+				if (done < n) {
+					if (endAt_.load(std::memory_order_acquire) == fifo_.ReadPosition()) {
+						state_ = State::Idle;
+					} else {
+						underruns_.fetch_add(1, std::memory_order_relaxed);
+						StartConcealment(block, done);
+						state_ = State::Concealing;
+					}
+				}
+				break;
+			}
+			}
+		}
+	}
+
+	// Picks the pitch period of the last kPitchWindow frames played (this
+	// block's first count frames included) by normalized autocorrelation.
+	void StartConcealment(const float* block, size_t count) {
+		for (size_t i = 0; i < kHistoryFrames; ++i) {
+			const size_t from = i + count;
+			linear_[i] = from < kHistoryFrames ? history_[(historyPos_ + from) & (kHistoryFrames - 1)]
+			                                  : block[from - kHistoryFrames];
+		}
+		const float* tail = linear_ + kHistoryFrames - kPitchWindow;
+		float best = 0.0f;
+		concealPeriod_ = kMaxPeriod;
+		for (size_t lag = kMinPeriod; lag <= kMaxPeriod; ++lag) {
+			const float* past = tail - lag;
+			float xy = 0.0f, yy = 0.0f;
+			for (size_t i = 0; i < kPitchWindow; i += 2) {
+				xy += tail[i] * past[i];
+				yy += past[i] * past[i];
+			}
+			const float score = yy > 1e-9f ? xy / std::sqrt(yy) : 0.0f;
+			if (score > best) {
+				best = score;
+				concealPeriod_ = lag;
+			}
+		}
+		concealPhase_ = 0;
+		concealLeft_ = kConcealFrames;
+		fadeLeft_ = 0;
+	}
+
+	// The last pitch period on repeat, fading out linearly
+	float ConcealSample() {
+		if (concealLeft_ == 0) return 0.0f;
+		const float gain = (float)concealLeft_-- / kConcealFrames;
+		const float s = linear_[kHistoryFrames - concealPeriod_ + concealPhase_];
+		if (++concealPhase_ == concealPeriod_) concealPhase_ = 0;
+		return s * gain;
+	}
+
+	SpscByteFifo fifo_;
+	std::atomic<bool> attached_{false};
+	std::atomic<uint64_t> clearTo_{0};     // FIFO byte position Clear() asked to skip to
+	std::atomic<uint64_t> endAt_{kNoEnd};  // FIFO byte position of the utterance end
+
+	// JS thread
+	JitterEstimator jitter_;
+	CatchUpConfig catchUp_; // read by the render thread while attached
+	bool inUtterance_ = false;
+	int64_t utteranceStartNs_ = 0;
+	uint64_t utteranceFrames_ = 0;
+	std::atomic<int64_t> firstPushNs_{0};
+	std::atomic<int64_t> playAtNs_{0};
+	std::atomic<size_t> targetFrames_{0};
+
+	// Render thread
+	uint64_t cleared_ = 0;
+	State state_ = State::Idle;
+	float history_[kHistoryFrames] = {};
+	size_t historyPos_ = 0;
+	float linear_[kHistoryFrames] = {};
+	size_t concealPeriod_ = kMaxPeriod;
+	size_t concealPhase_ = 0;
+	size_t concealLeft_ = 0;
+	size_t fadeLeft_ = 0;
+	WsolaStretcher stretch_;
+	double speed_ = 1.0;
+
+	std::atomic<uint64_t> pushed_{0};
+	std::atomic<uint64_t> played_{0};
+	std::atomic<uint64_t> dropped_{0};
+	std::atomic<uint64_t> concealed_{0};
+	std::atomic<uint64_t> underruns_{0};
+	std::atomic<int64_t> startDelayNs_{0};
+	std::atomic<double> speedOut_{1.0};
+	std::atomic<uint64_t> saved_{0};
+};
+
+// Output is the addon's SoundboardOutput: Start(lowerNeedle, RenderSource*,
+// &name, &error, lowLatency) and Stop() on the JS thread.
+template <typename Output>
+class RenderSessionWrap : public Napi::ObjectWrap<RenderSessionWrap<Output>> {
+public:
+	// defaultDevice: the virtual cable's lowercased name substring.
+	static void Init(Napi::Env env, Napi::Object exports, const char* defaultDevice) {
+		DefaultDevice() = defaultDevice;
+		Napi::Function ctor = RenderSessionWrap::DefineClass(env, "RenderSession", {
+			RenderSessionWrap::InstanceMethod("start", &RenderSessionWrap::Start),
+			RenderSessionWrap::InstanceMethod("push", &RenderSessionWrap::Push),
+			RenderSessionWrap::InstanceMethod("pushDecoded", &RenderSessionWrap::PushDecoded),
+			RenderSessionWrap::InstanceMethod("end", &RenderSessionWrap::End),
+			RenderSessionWrap::InstanceMethod("clear", &RenderSessionWrap::Clear),
+			RenderSessionWrap::InstanceMethod("stop", &RenderSessionWrap::Stop),
+			RenderSessionWrap::InstanceMethod("setInput", &RenderSessionWrap::SetInput),
+			RenderSessionWrap::InstanceMethod("getStats", &RenderSessionWrap::GetStats),
+			RenderSessionWrap::InstanceMethod("speak", &RenderSessionWrap::Speak),
+			RenderSessionWrap::InstanceMethod("measureLatency", &RenderSessionWrap::MeasureLatency),
+			RenderSessionWrap::InstanceAccessor("running", &RenderSessionWrap::Running, nullptr),
+		});
+		exports.Set("RenderSession", ctor);
+	}
+
+	explicit RenderSessionWrap(const Napi::CallbackInfo& info)
+		: Napi::ObjectWrap<RenderSessionWrap>(info), queue_(std::make_unique<PcmRenderQueue>()),
+		  tap_(std::make_unique<PlayedSpeechTap>(queue_.get())), mixer_(std::make_unique<RenderMixer>()),
+		  probe_(std::make_unique<LatencyProbeTap>(mixer_.get())), output_(std::make_unique<Output>()) {
+		inputs_[kTtsInput].slot = mixer_->Add(tap_.get(), inputs_[kTtsInput].config);
+	}
+
+	~RenderSessionWrap() {
+		output_->Stop();
+		SharedCaptureReturn().Release(this);
+	}
+
+private:
+	enum { kTtsInput, kSoundboardInput, kCaptureInput, kInputCount };
+
+	struct MixInput {
+		int slot = -1; // mixer slot while enabled
+		RenderMixer::InputConfig config; // duckBy by input index
+	};
+
+	static const char* InputName(int input) {
+		static const char* const names[kInputCount] = { "tts", "soundboard", "capture" };
+		return names[input];
+	}
+	static int InputIndex(const std::string& name) {
+		for (int i = 0; i < kInputCount; ++i) {
+			if (name == InputName(i)) return i;
+		}
+		return -1;
+	}
+
+	// Set by every environment's Init to the same literal.
+	static std::atomic<const char*>& DefaultDevice() {
+		static std::atomic<const char*> device{""};
+		return device;
+	}
+
+	// start({ device?, sampleRate?, prebufferMs?, jitterBuffer?, lowLatency? })
+	Napi::Value Start(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		std::string device = DefaultDevice().load();
+		uint32_t rate = 24000;
+		JitterBufferConfig jitter;
+		CatchUpConfig catchUp;
+		bool lowLatency = false;
+		std::string error;
+		if (info.Length() > 0 && info[0].IsObject()) {
+			Napi::Object obj = info[0].As<Napi::Object>();
+			if (obj.Get("device").IsString()) device = obj.Get("device").As<Napi::String>().Utf8Value();
+			if (obj.Get("lowLatency").IsBoolean()) lowLatency = obj.Get("lowLatency").As<Napi::Boolean>().Value();
+			if (!ReadUint32Option(obj, "sampleRate", 8000, 48000, &rate, &error) ||
+			    !ReadUint32Option(obj, "prebufferMs", 0, 2000, &jitter.prebufferMs, &error) ||
+			    !ReadJitterBufferOption(obj, &jitter, &error) || !ReadCatchUpOption(obj, &catchUp, &error)) {
+				Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+				return env.Null();
+			}
+		}
+		for (char& c : device) {
+			if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+		}
+		output_->Stop();
+		rate_ = rate;
+		resampler_.Configure(rate, kSoundboardRate, ResamplerQuality::High, 4096);
+		queue_->Configure(jitter, catchUp);
+		if (inputs_[kSoundboardInput].slot >= 0 && Soundboard(env).buses[kMicBus].Attached()) {
+			// Its own output took the bus while the session was stopped
+			AddonLog(LogLevel::Warn, "Render session: the soundboard plays on its own output; not mixing it");
+			DisableInput(kSoundboardInput);
+		}
+		std::string name;
+		if (!output_->Start(device, probe_.get(), &name, &error, lowLatency)) {
+			Napi::Error::New(env, "Render output unavailable: " + error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		return Napi::String::New(env, name);
+	}
+
+	// jitterBuffer: boolean | { minMs?, maxMs? }
+	static bool ReadJitterBufferOption(const Napi::Object& obj, JitterBufferConfig* out, std::string* error) {
+		if (!obj.Has("jitterBuffer") || obj.Get("jitterBuffer").IsUndefined()) return true;
+		Napi::Value v = obj.Get("jitterBuffer");
+		if (v.IsBoolean()) {
+			out->adaptive = v.As<Napi::Boolean>().Value();
+			return true;
+		}
+		if (!v.IsObject()) {
+			*error = "Option 'jitterBuffer' must be a boolean or an object";
+			return false;
+		}
+		Napi::Object jitter = v.As<Napi::Object>();
+		if (!ReadUint32Option(jitter, "minMs", 0, 2000, &out->minMs, error)) return false;
+		if (!ReadUint32Option(jitter, "maxMs", 0, 2000, &out->maxMs, error)) return false;
+		if (out->minMs > out->maxMs) {
+			*error = "Option 'jitterBuffer.minMs' must not exceed maxMs";
+			return false;
+		}
+		out->adaptive = true;
+		return true;
+	}
+
+	// catchUp: boolean | { maxSpeed?, startMs?, fullMs? }
+	static bool ReadCatchUpOption(const Napi::Object& obj, CatchUpConfig* out, std::string* error) {
+		if (!obj.Has("catchUp") || obj.Get("catchUp").IsUndefined()) return true;
+		Napi::Value v = obj.Get("catchUp");
+		if (v.IsBoolean()) {
+			out->enabled = v.As<Napi::Boolean>().Value();
+			return true;
+		}
+		if (!v.IsObject()) {
+			*error = "Option 'catchUp' must be a boolean or an object";
+			return false;
+		}
+		Napi::Object catchUp = v.As<Napi::Object>();
+		if (!ReadFloatOption(catchUp, "maxSpeed", 1.05f, (float)WsolaStretcher::kMaxSpeed, &out->maxSpeed, error)) return false;
+		// Never below what a stretch step looks ahead
+		if (!ReadUint32Option(catchUp, "startMs", 100, 10000, &out->startMs, error)) return false;
+		if (!ReadUint32Option(catchUp, "fullMs", 200, 30000, &out->fullMs, error)) return false;
+		if (out->startMs >= out->fullMs) {
+			*error = "Option 'catchUp.startMs' must be below fullMs";
+			return false;
+		}
+		out->enabled = true;
+		return true;
+	}
+
+	// setInput(name, { enabled?, gain?, duckDb?, duckBy?: string[] }) -> enabled
+	Napi::Value SetInput(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		if (info.Length() < 2 || !info[0].IsString() || !info[1].IsObject()) {
+			Napi::TypeError::New(env, "Input name and options required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		const std::string inputName = info[0].As<Napi::String>().Utf8Value();
+		const int input = InputIndex(inputName);
+		if (input < 0) {
+			Napi::TypeError::New(env, "Unknown input '" + inputName + "' (tts, soundboard or capture)").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		mixer_->Reap(); // detaches inputs removed earlier
+		Napi::Object obj = info[1].As<Napi::Object>();
+		RenderMixer::InputConfig config = inputs_[input].config;
+		bool enabled = inputs_[input].slot >= 0;
+		std::string error;
+		if (obj.Get("enabled").IsBoolean()) enabled = obj.Get("enabled").As<Napi::Boolean>().Value();
+		if (!ReadFloatOption(obj, "gain", 0.0f, 4.0f, &config.gain, &error) ||
+		    !ReadFloatOption(obj, "duckDb", -60.0f, 0.0f, &config.duckDb, &error) || !ReadDuckByOption(obj, &config.duckBy, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		if (input == kTtsInput && !enabled) {
+			Napi::TypeError::New(env, "The tts input cannot be disabled").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		if (!enabled) {
+			DisableInput(input);
+		} else if (inputs_[input].slot < 0) {
+			RenderSource* source = nullptr;
+			if (input == kSoundboardInput) {
+				if (Soundboard(env).buses[kMicBus].Attached()) {
+					Napi::Error::New(env, "The soundboard is playing on its own output; stop it first").ThrowAsJavaScriptException();
+					return env.Null();
+				}
+				source = &Soundboard(env).buses[kMicBus];
+			} else {
+				if (!SharedCaptureReturn().Claim(this)) {
+					Napi::Error::New(env, "Another render session is mixing the capture").ThrowAsJavaScriptException();
+					return env.Null();
+				}
+				source = &SharedCaptureReturn();
+			}
+			inputs_[input].slot = mixer_->Add(source, RenderMixer::InputConfig());
+			if (inputs_[input].slot < 0) {
+				DisableInput(input);
+				Napi::Error::New(env, "No free mixer input").ThrowAsJavaScriptException();
+				return env.Null();
+			}
+		}
+		inputs_[input].config = config;
+		ApplyInputs();
+		return Napi::Boolean::New(env, enabled);
+	}
+
+	// duckBy: input names, as a mask of input indexes
+	static bool ReadDuckByOption(const Napi::Object& obj, uint32_t* out, std::string* error) {
+		if (!obj.Has("duckBy") || obj.Get("duckBy").IsUndefined()) return true;
+		if (!obj.Get("duckBy").IsArray()) {
+			*error = "Option 'duckBy' must be an array of input names";
+			return false;
+		}
+		Napi::Array names = obj.Get("duckBy").As<Napi::Array>();
+		uint32_t mask = 0;
+		for (uint32_t i = 0; i < names.Length(); ++i) {
+			Napi::Value v = names.Get(i);
+			const int input = v.IsString() ? InputIndex(v.As<Napi::String>().Utf8Value()) : -1;
+			if (input < 0) {
+				*error = "Option 'duckBy' must be an array of input names (tts, soundboard or capture)";
+				return false;
+			}
+			mask |= 1u << input;
+		}
+		*out = mask;
+		return true;
+	}
+
+	void DisableInput(int input) {
+		mixer_->Remove(inputs_[input].slot);
+		inputs_[input].slot = -1;
+		if (input == kCaptureInput) SharedCaptureReturn().Release(this);
+		ApplyInputs();
+	}
+
+	// The inputs' configs with duckBy mapped to mixer slots
+	void ApplyInputs() {
+		for (const MixInput& in : inputs_) {
+			if (in.slot < 0) continue;
+			RenderMixer::InputConfig config = in.config;
+			config.duckBy = 0;
+			for (int k = 0; k < kInputCount; ++k) {
+				if ((in.config.duckBy & (1u << k)) && inputs_[k].slot >= 0) config.duckBy |= 1u << inputs_[k].slot;
+			}
+			mixer_->Configure(in.slot, config);
+		}
+	}
+
+	// push(pcm: Int16Array | Float32Array)
+	Napi::Value Push(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		if (info.Length() < 1 || !info[0].IsTypedArray()) {
+			Napi::TypeError::New(env, "Int16Array or Float32Array required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		Napi::TypedArray array = info[0].As<Napi::TypedArray>();
+		if (array.TypedArrayType() == napi_float32_array) {
+			Napi::Float32Array pcm = array.As<Napi::Float32Array>();
+			Queue(pcm.Data(), pcm.ElementLength());
+		} else if (array.TypedArrayType() == napi_int16_array) {
+			Napi::Int16Array pcm = array.As<Napi::Int16Array>();
+			QueuePcm16(pcm.Data(), pcm.ElementLength());
+		} else {
+			Napi::TypeError::New(env, "Int16Array or Float32Array required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		return QueuedMs(env);
+	}
+
+	// pushDecoded(decoderId, bytes: Buffer): feeds the stream decoder and queues its output
+	Napi::Value PushDecoded(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		if (info.Length() < 2 || !info[0].IsString() || !info[1].IsBuffer()) {
+			Napi::TypeError::New(env, "Decoder id and bytes required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+#if defined(AUDIO_CORE_AVCODEC)
+		auto it = StreamDecoders(env).find(info[0].As<Napi::String>().Utf8Value());
+		if (it == StreamDecoders(env).end()) {
+			Napi::Error::New(env, "No such decoder").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		if (it->second->OutRate() != rate_) {
+			Napi::Error::New(env, "Decoder sample rate differs from the session's").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		Napi::Buffer<uint8_t> bytes = info[1].As<Napi::Buffer<uint8_t>>();
+		decoded_.clear();
+		std::string error;
+		if (!it->second->Feed(bytes.Data(), bytes.Length(), &decoded_, &error)) {
+			Napi::Error::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		QueuePcm16(decoded_.data(), decoded_.size());
+		return QueuedMs(env);
+#else
+		Napi::Error::New(env, "Stream decoding is not built in (use_avcodec=0)").ThrowAsJavaScriptException();
+		return env.Null();
+#endif
+	}
+
+	Napi::Value End(const Napi::CallbackInfo& info) {
+		// Flush the resampler's filter delay so the last syllable isn't cut
+		input_.assign(resampler_.DelaySamples(), 0.0f);
+		Queue(input_.data(), input_.size());
+		queue_->End();
+		return info.Env().Undefined();
+	}
+
+	Napi::Value Clear(const Napi::CallbackInfo& info) {
+		queue_->Clear();
+		resampler_.Reset();
+		speechResampler_.Reset();
+		++speechGeneration_;
+		return info.Env().Undefined();
+	}
+
+	Napi::Value Stop(const Napi::CallbackInfo& info) {
+		output_->Stop();
+		++speechGeneration_;
+		return info.Env().Undefined();
+	}
+
+	// One speak() call: its sentences, voiced in order.
+	struct Speech {
+		std::string voice, text;
+		SpeechOptions options;
+		std::vector<std::pair<size_t, size_t>> sentences;
+		size_t next = 0;
+		uint64_t generation = 0;
+		std::chrono::steady_clock::time_point start;
+		double firstAudioMs = -1.0, synthMs = 0.0, audioMs = 0.0;
+		Napi::Promise::Deferred deferred;
+		Napi::ObjectReference self; // keeps the session alive until it settles
+
+		explicit Speech(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env)) {}
+	};
+
+	struct SpeechPiece {
+		bool ok = false;
+		std::vector<float> pcm;
+		uint32_t sampleRate = 0;
+		double synthMs = 0.0;
+		std::string error;
+	};
+
+	// speak(voice, text, options?) -> Promise<{ sentences, firstAudioMs, synthMs, audioMs, cancelled }>
+	Napi::Value Speak(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
+			Napi::TypeError::New(env, "Voice name and text required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		auto speech = std::make_shared<Speech>(env);
+		if (info.Length() > 2 && !ReadSpeechOptions(env, info[2], &speech->options)) return env.Null();
+		speech->voice = info[0].As<Napi::String>().Utf8Value();
+		speech->text = info[1].As<Napi::String>().Utf8Value();
+		speech->sentences = SplitSentences(speech->text);
+		speech->generation = speechGeneration_;
+		speech->start = std::chrono::steady_clock::now();
+		speech->self = Napi::Persistent(this->Value());
+		Napi::Promise promise = speech->deferred.Promise();
+		speeches_.push_back(speech);
+		if (speeches_.size() == 1) SpeakNext(env);
+		return promise;
+	}
+
+	// Voices the next sentence of the first queued speech, settling the ones
+	// that are done or cancelled.
+	void SpeakNext(Napi::Env env) {
+		while (!speeches_.empty()) {
+			std::shared_ptr<Speech> speech = speeches_.front();
+			const bool cancelled = speech->generation != speechGeneration_;
+			if (!cancelled && speech->next < speech->sentences.size()) {
+				const auto& span = speech->sentences[speech->next];
+				QueueQuery(env, "speak",
+					[speech, sentence = speech->text.substr(span.first, span.second)]() {
+						const auto start = std::chrono::steady_clock::now();
+						SpeechPiece piece;
+						piece.ok = PiperTts().Synthesize(speech->voice, sentence, speech->options, &piece.pcm, &piece.sampleRate, &piece.error);
+						piece.synthMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+						return piece;
+					},
+					[this, speech](Napi::Env env, SpeechPiece& piece) -> Napi::Value {
+						OnSpeechPiece(env, speech, piece);
+						return env.Undefined();
+					});
+				return;
+			}
+			speeches_.pop_front();
+			if (!cancelled && !speech->sentences.empty()) EndSpeech();
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("sentences", Napi::Number::New(env, (double)speech->next));
+			o.Set("firstAudioMs", speech->firstAudioMs < 0 ? env.Null() : Napi::Number::New(env, speech->firstAudioMs));
+			o.Set("synthMs", Napi::Number::New(env, speech->synthMs));
+			o.Set("audioMs", Napi::Number::New(env, speech->audioMs));
+			o.Set("cancelled", Napi::Boolean::New(env, cancelled));
+			speech->deferred.Resolve(o);
+			speech->self.Reset();
+		}
+	}
+
+	void OnSpeechPiece(Napi::Env env, const std::shared_ptr<Speech>& speech, SpeechPiece& piece) {
+		if (!piece.ok) {
+			speeches_.pop_front();
+			if (speech->next > 0) EndSpeech();
+			speech->deferred.Reject(Napi::Error::New(env, piece.error).Value());
+			speech->self.Reset();
+			SpeakNext(env);
+			return;
+		}
+		if (speech->generation == speechGeneration_) {
+			const bool last = speech->next + 1 == speech->sentences.size();
+			if (!last) piece.pcm.resize(piece.pcm.size() + (size_t)piece.sampleRate * speech->options.sentenceSilenceMs / 1000, 0.0f);
+			QueueSpeech(piece.pcm.data(), piece.pcm.size(), piece.sampleRate);
+			if (speech->firstAudioMs < 0 && !piece.pcm.empty()) {
+				speech->firstAudioMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - speech->start).count();
+			}
+			speech->synthMs += piece.synthMs;
+			speech->audioMs += piece.sampleRate ? piece.pcm.size() * 1000.0 / piece.sampleRate : 0.0;
+			++speech->next;
+		}
+		SpeakNext(env);
+	}
+
+	// Voice-rate PCM onto the TTS input, through a resampler of its own so a
+	// speech can share an utterance with pushed PCM at the session's rate.
+	void QueueSpeech(const float* samples, size_t n, uint32_t rate) {
+		if (n == 0 || !queue_->Attached()) return;
+		if (rate != speechRate_) {
+			speechResampler_.Configure(rate, kSoundboardRate, ResamplerQuality::High, 4096);
+			speechRate_ = rate;
+		}
+		resampled_.resize(speechResampler_.MaxOutput(n));
+		queue_->Push(resampled_.data(), speechResampler_.Process(samples, n, resampled_.data()));
+	}
+
+	// Plays out the speech resampler's filter delay and ends the utterance.
+	void EndSpeech() {
+		if (speechRate_) {
+			input_.assign(speechResampler_.DelaySamples(), 0.0f);
+			QueueSpeech(input_.data(), input_.size(), speechRate_);
+		}
+		queue_->End();
+	}
+
+	Napi::Value GetStats(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		const RenderQueueStats s = queue_->Stats();
+		const double msPerFrame = 1000.0 / kSoundboardRate;
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("queuedMs", Napi::Number::New(env, s.queuedFrames * msPerFrame));
+		o.Set("pushedMs", Napi::Number::New(env, s.pushedFrames * msPerFrame));
+		o.Set("playedMs", Napi::Number::New(env, s.playedFrames * msPerFrame));
+		o.Set("droppedMs", Napi::Number::New(env, s.droppedFrames * msPerFrame));
+		o.Set("concealedMs", Napi::Number::New(env, s.concealedFrames * msPerFrame));
+		o.Set("underruns", Napi::Number::New(env, (double)s.underruns));
+		o.Set("targetMs", Napi::Number::New(env, s.targetMs));
+		o.Set("jitterMs", Napi::Number::New(env, s.jitterMs));
+		o.Set("startDelayMs", Napi::Number::New(env, s.startDelayMs));
+		o.Set("speed", Napi::Number::New(env, s.speed));
+		o.Set("catchUpMs", Napi::Number::New(env, s.savedFrames * msPerFrame));
+		Napi::Object inputs = Napi::Object::New(env);
+		for (int i = 0; i < kInputCount; ++i) {
+			if (inputs_[i].slot < 0) continue;
+			Napi::Object in = Napi::Object::New(env);
+			in.Set("levelDb", Napi::Number::New(env, mixer_->LevelDb(inputs_[i].slot)));
+			in.Set("ducked", Napi::Boolean::New(env, mixer_->Ducked(inputs_[i].slot)));
+			inputs.Set(InputName(i), in);
+		}
+		o.Set("inputs", inputs);
+		return o;
+	}
+
+	Napi::Value Running(const Napi::CallbackInfo& info) {
+		return Napi::Boolean::New(info.Env(), output_->Running());
+	}
+
+	// measureLatency(options?: { timeoutMs? }) -> Promise<{ outputMs, captureMs, pipelineMs?, totalMs?, match }>
+	Napi::Value MeasureLatency(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		uint32_t timeoutMs = 3000;
+		std::string error;
+		if (info.Length() > 0 && info[0].IsObject() &&
+		    !ReadUint32Option(info[0].As<Napi::Object>(), "timeoutMs", 1500, 30000, &timeoutMs, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		if (!output_->Running()) {
+			Napi::Error::New(env, "Render session not started").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		if (!SharedLatencyProbe().Arm(probe_.get())) {
+			Napi::Error::New(env, "A latency measurement is already running").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		return QueueQuery(env, "MeasureLatency",
+			[timeoutMs]() { return SharedLatencyProbe().Measure(timeoutMs); },
+			[](Napi::Env env, LatencyMeasurement& m) -> Napi::Value {
+				if (!m.error.empty()) {
+					Napi::Error::New(env, m.error).ThrowAsJavaScriptException();
+					return env.Undefined();
+				}
+				Napi::Object o = Napi::Object::New(env);
+				o.Set("outputMs", Napi::Number::New(env, m.outputMs));
+				o.Set("captureMs", Napi::Number::New(env, m.captureMs));
+				if (m.pipelineMs >= 0.0) {
+					o.Set("pipelineMs", Napi::Number::New(env, m.pipelineMs));
+					o.Set("totalMs", Napi::Number::New(env, m.outputMs + m.captureMs + m.pipelineMs));
+				}
+				o.Set("match", Napi::Number::New(env, m.match));
+				return o;
+			}, TaskPriority::Background);
+	}
+
+	void QueuePcm16(const int16_t* pcm, size_t n) {
+		input_.resize(n);
+		for (size_t i = 0; i < n; ++i) input_[i] = pcm[i] * (1.0f / 32768.0f);
+		Queue(input_.data(), n);
+	}
+
+	void Queue(const float* samples, size_t n) {
+		if (n == 0 || !queue_->Attached()) return;
+		resampled_.resize(resampler_.MaxOutput(n));
+		const size_t out = resampler_.Process(samples, n, resampled_.data());
+		queue_->Push(resampled_.data(), out);
+	}
+
+	Napi::Value QueuedMs(Napi::Env env) {
+		return Napi::Number::New(env, queue_->Stats().queuedFrames * 1000.0 / kSoundboardRate);
+	}
+
+	// The queue and mixer outlive the output, which renders them until Stop() returns
+	std::unique_ptr<PcmRenderQueue> queue_;
+	std::unique_ptr<PlayedSpeechTap> tap_; // the queue as mixed, publishing what it plays (self_echo.h)
+	std::unique_ptr<RenderMixer> mixer_;
+	std::unique_ptr<LatencyProbeTap> probe_; // the mixer as played, with measureLatency()'s chirp on top
+	std::unique_ptr<Output> output_;
+	MixInput inputs_[kInputCount];
+	uint32_t rate_ = 24000;
+	PolyphaseResampler resampler_;
+	std::vector<float> input_, resampled_;
+	std::vector<int16_t> decoded_;
+	std::deque<std::shared_ptr<Speech>> speeches_; // speak() calls, the first one being voiced
+	uint64_t speechGeneration_ = 0; // bumped by clear() and stop() to cancel them
+	uint32_t speechRate_ = 0;
+	PolyphaseResampler speechResampler_;
+};
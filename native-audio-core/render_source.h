@@ -0,0 +1,20 @@
+#pragma once
+
+// What an addon output stream (each addon's SoundboardOutput) renders: a
+// soundboard bus (soundboard_engine.h) or a render session's PCM queue
+// (render_session.h). The output calls Attach() once its stream is running and
+// Detach() after its last Render(), both on the JS thread; Render() runs on
+// the output's real-time thread and must not block or allocate.
+
+#include <cstddef>
+#include <cstdint>
+
+class RenderSource {
+public:
+	virtual ~RenderSource() = default;
+	virtual void Attach() = 0;
+	virtual void Detach() = 0;
+	// Fills frames of interleaved 48 kHz (kSoundboardRate) float: the first
+	// two channels, or their mix on a mono device; any others stay silent.
+	virtual void Render(float* out, size_t frames, uint32_t channels) = 0;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+// Debug check for heap use on real-time threads. Builds with
+// AUDIO_CORE_RT_ALLOC_CHECK defined (the Debug configuration) replace global
+// operator new/delete via AUDIO_CORE_RT_ALLOC_HOOKS(), which an addon expands
+// once at namespace scope; any allocation made while a RealtimeScope is alive on
+// the calling thread is counted and logged. Otherwise everything compiles away.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "addon_log.h"
+
+#if defined(AUDIO_CORE_RT_ALLOC_CHECK)
+
+inline thread_local int g_realtimeDepth = 0;
+inline std::atomic<uint64_t> g_realtimeAllocations{0};
+
+inline void NoteRealtimeAllocation(std::size_t bytes) {
+	if (g_realtimeDepth <= 0) return;
+	g_realtimeAllocations.fetch_add(1, std::memory_order_relaxed);
+	// Leave the scope while logging so a formatter allocation can't recurse
+	const int depth = g_realtimeDepth;
+	g_realtimeDepth = 0;
+	AddonLog(LogLevel::Error, "Heap allocation of %zu bytes on a real-time thread", bytes);
+	g_realtimeDepth = depth;
+}
+
+#define AUDIO_CORE_RT_ALLOC_HOOKS()                                                     \
+	void* operator new(std::size_t n) {                                                    \
+		NoteRealtimeAllocation(n);                                                         \
+		void* p = std::malloc(n ? n : 1);                                                  \
+		if (!p) std::abort();                                                              \
+		return p;                                                                          \
+	}                                                                                      \
+	void* operator new[](std::size_t n) { return operator new(n); }                       \
+	void operator delete(void* p) noexcept { std::free(p); }                               \
+	void operator delete[](void* p) noexcept { std::free(p); }                             \
+	void operator delete(void* p, std::size_t) noexcept { std::free(p); }                  \
+	void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+struct RealtimeScope {
+	RealtimeScope() { ++g_realtimeDepth; }
+	~RealtimeScope() { --g_realtimeDepth; }
+};
+
+inline uint64_t RealtimeAllocationCount() { return g_realtimeAllocations.load(std::memory_order_relaxed); }
+
+#else
+
+#define AUDIO_CORE_RT_ALLOC_HOOKS()
+
+struct RealtimeScope {
+	RealtimeScope() {}
+};
+
+inline uint64_t RealtimeAllocationCount() { return 0; }
+
+#endif
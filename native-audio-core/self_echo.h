@@ -0,0 +1,242 @@
+#pragma once
+
+// Our own TTS, heard back (capture option "selfEcho"). When a render session
+// plays through the speakers rather than the virtual cable, a loopback
+// capture records the translation and sends it round again: STT, then
+// translation, of speech we produced.
+//
+// PlayedSpeechTap wraps a render session's TTS queue and publishes what it
+// plays, downmixed and decimated to 16 kHz and stamped with the device clock,
+// to PlayedSpeechReference() - the same kind of ring the echo canceller's far
+// end uses (echo_canceller.h); the first session playing claims it. A
+// capture's SelfEchoGuard keeps the last kWindow samples of its 16 kHz stream
+// and, every kHop, cross-correlates them with the reference around the same
+// instant: one complex FFT carries both signals, the product of their spectra
+// goes back through the same FFT, and the peak of the correlation normalised
+// by both energies over lags from kLeadMs ahead to maxLagMs behind is the
+// match. At or above threshold the capture's VAD frames are vetoed until
+// kHoldHops analyses in a row find none, so the chunker never cuts an
+// utterance from them. Nothing is analysed while the reference is silent.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "echo_canceller.h"
+#include "latency_trace.h"
+#include "render_source.h"
+#include "spectral_features.h"
+
+// The TTS render sessions play, as heard on the device clock.
+inline EchoReference& PlayedSpeechReference() {
+	static EchoReference reference;
+	return reference;
+}
+
+// Render thread: passes the wrapped source through and publishes its sound
+// while this tap holds the reference.
+class PlayedSpeechTap : public RenderSource {
+public:
+	static constexpr size_t kBlock = 480; // 16 kHz samples per write: 30 ms
+
+	explicit PlayedSpeechTap(RenderSource* inner) : inner_(inner) {}
+	~PlayedSpeechTap() override { PlayedSpeechReference().Release(this); }
+
+	void Attach() override {
+		inner_->Attach();
+		sum_ = 0.0f;
+		phase_ = 0;
+		publishing_.store(PlayedSpeechReference().Claim(this), std::memory_order_release);
+	}
+
+	void Detach() override {
+		inner_->Detach();
+		publishing_.store(false, std::memory_order_release);
+		PlayedSpeechReference().Release(this);
+	}
+
+	void Render(float* out, size_t frames, uint32_t channels) override {
+		inner_->Render(out, frames, channels);
+		if (!publishing_.load(std::memory_order_acquire)) return;
+		const uint64_t nowNs = DeviceClockNs();
+		const uint32_t width = std::min<uint32_t>(channels, 2);
+		const float scale = 1.0f / (3.0f * (float)width);
+		size_t n = 0;
+		uint64_t firstNs = nowNs;
+		for (size_t f = 0; f < frames; ++f) {
+			for (uint32_t c = 0; c < width; ++c) sum_ += out[f * channels + c];
+			if (++phase_ < 3) continue;
+			// A box over three 48 kHz frames; its aliasing barely moves a correlation of speech
+			if (n == 0) firstNs = nowNs + (uint64_t)f * 1000000000ull / 48000;
+			block_[n++] = sum_ * scale;
+			sum_ = 0.0f;
+			phase_ = 0;
+			if (n == kBlock) {
+				PlayedSpeechReference().Write(block_, n, firstNs);
+				n = 0;
+			}
+		}
+		if (n > 0) PlayedSpeechReference().Write(block_, n, firstNs);
+	}
+
+private:
+	RenderSource* const inner_;
+	std::atomic<bool> publishing_{false};
+	// Render thread
+	float sum_ = 0.0f;
+	uint32_t phase_ = 0;
+	float block_[kBlock] = {};
+};
+
+struct SelfEchoConfig {
+	bool enabled = false;
+	float threshold = 0.6f;  // normalised correlation that counts as our own speech
+	uint32_t maxLagMs = 250; // how far the capture may trail what was played
+};
+
+class SelfEchoGuard {
+public:
+	static constexpr uint32_t kRate = 16000;
+	static constexpr size_t kWindow = 4096;     // 256 ms correlated at a time
+	static constexpr size_t kHop = 1024;        // one analysis per 64 ms
+	static constexpr uint32_t kLeadMs = 50;     // the capture's stamp may also run ahead of the render's
+	static constexpr uint32_t kHoldHops = 4;    // the window's length: still flagged while any of it matched
+	static constexpr float kSilentRms = 0.001f; // -60 dBFS: a reference this quiet is not analysed
+
+	// Capture thread, before the stream; only 16 kHz streams are guarded.
+	void Configure(const SelfEchoConfig& config, uint32_t sampleRate) {
+		config_ = config;
+		enabled_ = config.enabled && sampleRate == kRate;
+		if (!enabled_) return;
+		lag_ = (size_t)config.maxLagMs * kRate / 1000;
+		lead_ = (size_t)kLeadMs * kRate / 1000;
+		const size_t reference = kWindow + lag_ + lead_;
+		size_t size = 2;
+		while (size < kWindow + reference) size *= 2;
+		fft_.Configure(size);
+		re_.assign(size, 0.0f);
+		im_.assign(size, 0.0f);
+		window_.assign(kWindow, 0.0f);
+		reference_.assign(reference, 0.0f);
+		energy_.assign(reference + 1, 0.0);
+		Reset();
+	}
+
+	bool Enabled() const { return enabled_; }
+
+	void Reset() {
+		std::fill(window_.begin(), window_.end(), 0.0f);
+		head_ = 0;
+		filled_ = 0;
+		sinceHop_ = 0;
+		hold_ = 0;
+	}
+
+	// Capture thread: n samples, the first captured at timeNs on the device
+	// clock (0 when unknown: nothing is analysed).
+	void Push(const float* samples, size_t n, uint64_t timeNs) {
+		while (n > 0) {
+			const size_t take = std::min(n, kHop - sinceHop_);
+			for (size_t i = 0; i < take; ++i) {
+				window_[head_] = samples[i];
+				head_ = (head_ + 1) % kWindow;
+			}
+			filled_ = std::min(kWindow, filled_ + take);
+			sinceHop_ += take;
+			samples += take;
+			n -= take;
+			timeNs = timeNs ? timeNs + (uint64_t)take * 1000000000ull / kRate : 0;
+			if (sinceHop_ == kHop) {
+				sinceHop_ = 0;
+				if (hold_ > 0) --hold_;
+				if (filled_ == kWindow && timeNs) Analyse(timeNs);
+			}
+		}
+	}
+
+	// The latest analyses found the stream to be our own speech.
+	bool Self() const { return hold_ > 0; }
+
+	uint64_t Analysed() const { return analysed_; }
+	uint64_t Matched() const { return matched_; }
+	float LastCorrelation() const { return lastCorrelation_; }
+	float LastLagMs() const { return lastLagMs_; }
+
+private:
+	// endNs: the capture time just past the window's last sample.
+	void Analyse(uint64_t endNs) {
+		double index = 0.0;
+		if (!PlayedSpeechReference().Locate(endNs - (uint64_t)kWindow * 1000000000ull / kRate, &index)) return;
+		const size_t length = reference_.size();
+		// reference_[k + n] lines up with window sample n at a lag of lag_ - k samples
+		if (!PlayedSpeechReference().Read(std::floor(index) - (double)lag_, 1.0, reference_.data(), length)) return;
+		energy_[0] = 0.0;
+		for (size_t i = 0; i < length; ++i) energy_[i + 1] = energy_[i] + (double)reference_[i] * reference_[i];
+		if (energy_[length] < (double)kSilentRms * kSilentRms * (double)length) return;
+		double windowEnergy = 0.0;
+		const size_t size = fft_.Size();
+		for (size_t n = 0; n < kWindow; ++n) {
+			const float x = window_[(head_ + n) % kWindow];
+			re_[n] = x;
+			windowEnergy += (double)x * x;
+		}
+		if (windowEnergy < (double)kSilentRms * kSilentRms * (double)kWindow) return;
+		std::fill(re_.begin() + kWindow, re_.end(), 0.0f);
+		std::copy(reference_.begin(), reference_.end(), im_.begin());
+		std::fill(im_.begin() + length, im_.end(), 0.0f);
+		++analysed_;
+		// z = x + i r; X[k] = (Z[k] + Z*[N-k]) / 2, R[k] = (Z[k] - Z*[N-k]) / 2i.
+		// The cross-spectrum conj(X) R, conjugated, goes through the forward
+		// FFT again: its real part is N times the correlation sum_n x[n] r[n + k].
+		fft_.Forward(re_.data(), im_.data());
+		for (size_t k = 0; k <= size / 2; ++k) {
+			const size_t m = (size - k) % size;
+			const float zr = re_[k], zi = im_[k], wr = re_[m], wi = im_[m];
+			const float xr = 0.5f * (zr + wr), xi = 0.5f * (zi - wi);
+			const float rr = 0.5f * (zi + wi), ri = 0.5f * (wr - zr);
+			const float pr = xr * rr + xi * ri, pi = xr * ri - xi * rr; // conj(X) R
+			re_[k] = pr;
+			im_[k] = -pi;
+			re_[m] = pr; // a real correlation: the spectrum is Hermitian
+			im_[m] = pi;
+		}
+		fft_.Forward(re_.data(), im_.data());
+		float best = 0.0f;
+		size_t bestAt = 0;
+		for (size_t k = 0; k + kWindow <= length; ++k) {
+			const double referenceEnergy = energy_[k + kWindow] - energy_[k];
+			if (referenceEnergy <= 0.0) continue;
+			const float c = (float)((double)re_[k] / (double)size / std::sqrt(windowEnergy * referenceEnergy));
+			if (c > best) {
+				best = c;
+				bestAt = k;
+			}
+		}
+		lastCorrelation_ = best;
+		lastLagMs_ = ((float)lag_ - (float)bestAt) * 1000.0f / kRate;
+		if (best >= config_.threshold) {
+			hold_ = kHoldHops;
+			++matched_;
+		}
+	}
+
+	SelfEchoConfig config_;
+	bool enabled_ = false;
+	size_t lag_ = 0, lead_ = 0;
+	RadixTwoFft fft_;
+	std::vector<float> re_, im_;
+	std::vector<float> window_;    // ring of the latest kWindow samples
+	std::vector<float> reference_; // what was played around them
+	std::vector<double> energy_;   // prefix sums of reference_ squared
+	size_t head_ = 0;
+	size_t filled_ = 0;
+	size_t sinceHop_ = 0;
+	uint32_t hold_ = 0;
+	uint64_t analysed_ = 0;
+	uint64_t matched_ = 0;
+	float lastCorrelation_ = 0.0f;
+	float lastLagMs_ = 0.0f;
+};
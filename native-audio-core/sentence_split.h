@@ -0,0 +1,49 @@
+#pragma once
+
+// Sentence boundaries for the engines that work a sentence at a time: the
+// translator batches them (translation_engine.h) and speech synthesis
+// queues each one as soon as it is voiced (piper_tts_engine.h).
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Splits text into sentences after . ! ? 。 ！ ？ followed by whitespace (or
+// the end); spans as (offset, length), surrounding whitespace trimmed.
+inline std::vector<std::pair<size_t, size_t>> SplitSentences(const std::string& text) {
+	std::vector<std::pair<size_t, size_t>> spans;
+	auto space = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+	size_t start = 0;
+	auto flush = [&](size_t end) {
+		while (start < end && space(text[start])) ++start;
+		size_t stop = end;
+		while (stop > start && space(text[stop - 1])) --stop;
+		if (stop > start) spans.emplace_back(start, stop - start);
+		start = end;
+	};
+	for (size_t i = 0; i < text.size(); ++i) {
+		size_t after = 0;
+		const char c = text[i];
+		if (c == '.' || c == '!' || c == '?') {
+			after = i + 1;
+		} else if ((unsigned char)c == 0xE3 && i + 2 < text.size() && (unsigned char)text[i + 1] == 0x80 &&
+		           (unsigned char)text[i + 2] == 0x82) {
+			after = i + 3; // 。 (ends a sentence even without a space)
+		} else if ((unsigned char)c == 0xEF && i + 2 < text.size() && (unsigned char)text[i + 1] == 0xBC &&
+		           ((unsigned char)text[i + 2] == 0x81 || (unsigned char)text[i + 2] == 0x9F)) {
+			after = i + 3; // ！ ？
+		}
+		if (after == 0) continue;
+		while (after < text.size() && (text[after] == '.' || text[after] == '!' || text[after] == '?' || text[after] == '"' ||
+		                               text[after] == '\'' || text[after] == ')')) {
+			++after;
+		}
+		if (after == text.size() || space(text[after]) || (c != '.' && c != '!' && c != '?')) {
+			flush(after);
+			i = after - 1;
+		}
+	}
+	flush(text.size());
+	return spans;
+}
@@ -0,0 +1,441 @@
+#pragma once
+
+// Full-session recording to disk for QA and support (capture option "record",
+// capture_options.h). The capture thread only quantizes each block to pcm16
+// and copies it into a lock-free byte FIFO - no syscalls, no allocation, and
+// a full FIFO drops (and counts) audio rather than waiting. A dedicated I/O
+// thread wakes every 100 ms, encodes what is queued (WAV, FLAC or Ogg-Opus)
+// and writes it in 64 KiB multiples at 64 KiB-aligned offsets, so the disk
+// sees a few large sequential writes a second at most; only the close of a
+// segment writes a short tail and patches the header's sizes. Segments rotate
+// every segmentSeconds of stream: <path>-0001.wav, <path>-0002.wav, ...
+//
+// Stats (getStats().record): { segments, recordedMs, droppedMs, bytes, writeErrors }.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "addon_log.h"
+#include "capture_options.h"
+#include "flac_chunk_encoder.h"
+#include "mapped_file.h"
+#include "opus_chunk_encoder.h"
+#include "pcm_channel.h"
+#include "pcm_quantize.h"
+#include "platform_trace.h"
+#include "spsc_byte_fifo.h"
+#include "thread_cpu.h"
+#include "thread_schedule.h"
+
+// A file written front to back, plus positional writes for header patches.
+class SegmentFile {
+public:
+	SegmentFile() = default;
+	SegmentFile(const SegmentFile&) = delete;
+	SegmentFile& operator=(const SegmentFile&) = delete;
+	~SegmentFile() { Close(); }
+
+	bool Open(const std::string& path) {
+		Close();
+#if defined(_WIN32)
+		file_ = CreateFileW(WidenUtf8(path).c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+		                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		return file_ != INVALID_HANDLE_VALUE;
+#else
+		fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		return fd_ >= 0;
+#endif
+	}
+
+	bool IsOpen() const {
+#if defined(_WIN32)
+		return file_ != INVALID_HANDLE_VALUE;
+#else
+		return fd_ >= 0;
+#endif
+	}
+
+	bool Append(const uint8_t* data, size_t size) {
+		if (!IsOpen()) return false;
+		while (size > 0) {
+#if defined(_WIN32)
+			DWORD written = 0;
+			if (!WriteFile(file_, data, (DWORD)std::min<size_t>(size, 1u << 30), &written, nullptr) || written == 0) return false;
+#else
+			const ssize_t written = write(fd_, data, size);
+			if (written < 0 && errno == EINTR) continue;
+			if (written <= 0) return false;
+#endif
+			data += written;
+			size -= (size_t)written;
+		}
+		return true;
+	}
+
+	// Only once appending is done: on Windows it moves the file pointer.
+	bool WriteAt(uint64_t offset, const uint8_t* data, size_t size) {
+		if (!IsOpen()) return false;
+#if defined(_WIN32)
+		OVERLAPPED at = {};
+		at.Offset = (DWORD)offset;
+		at.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD written = 0;
+		return WriteFile(file_, data, (DWORD)size, &written, &at) && written == size;
+#else
+		return pwrite(fd_, data, size, (off_t)offset) == (ssize_t)size;
+#endif
+	}
+
+	void Close() {
+#if defined(_WIN32)
+		if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+		file_ = INVALID_HANDLE_VALUE;
+#else
+		if (fd_ >= 0) close(fd_);
+		fd_ = -1;
+#endif
+	}
+
+private:
+#if defined(_WIN32)
+	HANDLE file_ = INVALID_HANDLE_VALUE;
+#else
+	int fd_ = -1;
+#endif
+};
+
+struct RecorderStats {
+	uint64_t segments = 0;
+	uint64_t recordedSamples = 0; // 16 kHz samples written to segments
+	uint64_t droppedSamples = 0;  // lost to a full FIFO (the disk fell behind)
+	uint64_t bytes = 0;
+	uint64_t writeErrors = 0;     // failed writes and segments that would not open
+};
+
+inline Napi::Object RecorderStatsToJs(Napi::Env env, const RecorderStats& s) {
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("segments", Napi::Number::New(env, (double)s.segments));
+	o.Set("recordedMs", Napi::Number::New(env, (double)s.recordedSamples / 16.0));
+	o.Set("droppedMs", Napi::Number::New(env, (double)s.droppedSamples / 16.0));
+	o.Set("bytes", Napi::Number::New(env, (double)s.bytes));
+	o.Set("writeErrors", Napi::Number::New(env, (double)s.writeErrors));
+	return o;
+}
+
+class SessionRecorder {
+public:
+	static constexpr uint32_t kRate = 16000;
+	static constexpr size_t kWriteBytes = 64 * 1024;
+	static constexpr size_t kFifoSeconds = 8; // how long the disk may stall before audio is dropped
+
+	SessionRecorder() = default;
+	SessionRecorder(const SessionRecorder&) = delete;
+	SessionRecorder& operator=(const SessionRecorder&) = delete;
+	~SessionRecorder() {
+		Close();
+		if (thread_.joinable()) thread_.join();
+#if defined(AUDIO_CORE_OPUS)
+		if (opus_) opus_encoder_destroy(opus_);
+#endif
+	}
+
+	// JS thread, before the capture thread starts: opens the first segment, so
+	// a bad path fails here, and starts the I/O thread.
+	bool Start(const RecordConfig& config, std::string* error) {
+		config_ = config;
+		segmentSamples_ = (uint64_t)config.segmentSeconds * kRate;
+		fifo_.Reset(kFifoSeconds * kRate * sizeof(int16_t));
+		pcm_.resize(kRate / 10);
+		pending_.reserve(2 * kWriteBytes);
+#if defined(AUDIO_CORE_OPUS)
+		if (config.codec == RecordCodec::Opus) {
+			int err = OPUS_OK;
+			opus_ = opus_encoder_create((opus_int32)kRate, 1, OPUS_APPLICATION_VOIP, &err);
+			if (err != OPUS_OK || !opus_) {
+				*error = std::string("opus_encoder_create failed: ") + opus_strerror(err);
+				opus_ = nullptr;
+				return false;
+			}
+			opus_encoder_ctl(opus_, OPUS_SET_BITRATE((opus_int32)config.bitrate));
+			opus_encoder_ctl(opus_, OPUS_SET_VBR(1));
+			opus_encoder_ctl(opus_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+			opus_int32 lookahead = 0;
+			opus_encoder_ctl(opus_, OPUS_GET_LOOKAHEAD(&lookahead));
+			lookahead_ = (size_t)lookahead;
+		}
+#else
+		if (config.codec == RecordCodec::Opus) {
+			*error = "Opus encoding is not built in (use_opus=0)";
+			return false;
+		}
+#endif
+		if (!OpenSegment()) {
+			*error = "could not create " + SegmentPath(1);
+			return false;
+		}
+		thread_ = std::thread([this] { Loop(); });
+		return true;
+	}
+
+	// Which stream the capture feeds: the chain's input or its output.
+	bool Raw() const { return config_.raw; }
+
+	// Capture thread: a block of the recorded stream; gain applies as in the writer.
+	void Write(const float* samples, size_t count, float gain) {
+		int16_t quantized[256];
+		for (size_t at = 0; at < count;) {
+			const size_t n = std::min(count - at, sizeof(quantized) / sizeof(quantized[0]));
+			if (samples) QuantizeToInt16(samples + at, n, gain, quantized);
+			else memset(quantized, 0, n * sizeof(int16_t));
+			if (!fifo_.Write(quantized, n * sizeof(int16_t))) droppedSamples_.fetch_add(n, std::memory_order_relaxed);
+			at += n;
+		}
+	}
+
+	// Capture thread: count samples of silence that bypassed the chain.
+	void Skip(size_t count) { Write(nullptr, count, 1.0f); }
+
+	// Any thread, once the capture thread no longer writes: the I/O thread
+	// writes out what is queued, finishes the segment and exits. Does not wait.
+	void Close() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		closing_ = true;
+		wake_.notify_all();
+	}
+
+	RecorderStats Stats() const {
+		RecorderStats s;
+		s.segments = segments_.load(std::memory_order_relaxed);
+		s.recordedSamples = recordedSamples_.load(std::memory_order_relaxed);
+		s.droppedSamples = droppedSamples_.load(std::memory_order_relaxed);
+		s.bytes = bytes_.load(std::memory_order_relaxed);
+		s.writeErrors = writeErrors_.load(std::memory_order_relaxed);
+		return s;
+	}
+
+private:
+	void Loop() {
+		ThreadCpuScope cpu("recorder");
+		ApplyThreadQos(ThreadQos::Utility);
+		std::unique_lock<std::mutex> lock(mutex_);
+		for (;;) {
+			const bool closing = closing_;
+			lock.unlock();
+			Drain();
+			if (closing) break;
+			lock.lock();
+			if (!closing_) wake_.wait_for(lock, std::chrono::milliseconds(100));
+		}
+		FinishSegment();
+	}
+
+	void Drain() {
+		for (;;) {
+			const size_t got = fifo_.Read(pcm_.data(), pcm_.size() * sizeof(int16_t)) / sizeof(int16_t);
+			if (got == 0) break;
+			for (size_t at = 0; at < got;) {
+				// A segment that would not open is encoded to nowhere, so the
+				// next one still starts where it should
+				if (!segmentOpen_) OpenSegment();
+				const size_t n = (size_t)std::min<uint64_t>(got - at, segmentSamples_ - segmentFill_);
+				{
+					TraceInterval trace(TraceStage::Work, n, "Record");
+					Encode(pcm_.data() + at, n);
+				}
+				segmentFill_ += n;
+				at += n;
+				recordedSamples_.fetch_add(n, std::memory_order_relaxed);
+				if (segmentFill_ == segmentSamples_) FinishSegment();
+			}
+			WritePending(false);
+		}
+	}
+
+	std::string SegmentPath(uint32_t index) const {
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), "-%04u.%s", index, RecordCodecExtension(config_.codec));
+		return config_.path + suffix;
+	}
+
+	bool OpenSegment() {
+		++segmentIndex_;
+		segmentOpen_ = true;
+		segmentFill_ = 0;
+		fileBytes_ = 0;
+		pending_.clear();
+		const std::string path = SegmentPath(segmentIndex_);
+		if (!file_.Open(path)) {
+			AddonLog(LogLevel::Warn, "Session recorder could not create %s", path.c_str());
+			writeErrors_.fetch_add(1, std::memory_order_relaxed);
+		} else {
+			segments_.fetch_add(1, std::memory_order_relaxed);
+		}
+		switch (config_.codec) {
+		case RecordCodec::Wav:
+			pending_.resize(kWavHeaderBytes);
+			WriteWavHeader(pending_.data(), kRate, 1, 0); // sizes patched at close
+			break;
+		case RecordCodec::Flac:
+			flac_ = std::make_unique<FlacStreamEncoder>(kRate, FlacChunkConfig());
+			flac_->Header(0, (uint32_t)FlacStreamEncoder::kBlock, &pending_); // total patched at close
+			block_.resize(FlacStreamEncoder::kBlock);
+			blockFill_ = 0;
+			break;
+		case RecordCodec::Opus:
+#if defined(AUDIO_CORE_OPUS)
+			opus_encoder_ctl(opus_, OPUS_RESET_STATE);
+			ogg_ = std::make_unique<OggStreamWriter>(&pending_, 0x57485200u + segmentIndex_);
+			WriteOpusHeaders(ogg_.get(), kRate, (uint16_t)(lookahead_ * 3));
+			block_.resize(kRate / 50);
+			blockFill_ = 0;
+			granule_ = 0;
+			pagePackets_ = 0;
+#endif
+			break;
+		}
+		return file_.IsOpen();
+	}
+
+	void Encode(const int16_t* pcm, size_t count) {
+		if (config_.codec == RecordCodec::Wav) {
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(pcm);
+			pending_.insert(pending_.end(), bytes, bytes + count * sizeof(int16_t));
+			return;
+		}
+		for (size_t at = 0; at < count;) {
+			const size_t n = std::min(count - at, block_.size() - blockFill_);
+			memcpy(block_.data() + blockFill_, pcm + at, n * sizeof(int16_t));
+			blockFill_ += n;
+			at += n;
+			if (blockFill_ == block_.size()) EncodeBlock(false);
+		}
+	}
+
+	// A full codec block, or at the end of a segment the partial one.
+	void EncodeBlock(bool last) {
+		if (config_.codec == RecordCodec::Flac) {
+			if (blockFill_ > 0) flac_->Frame(block_.data(), blockFill_, &pending_);
+			blockFill_ = 0;
+			return;
+		}
+#if defined(AUDIO_CORE_OPUS)
+		if (!last) {
+			EncodeOpusFrame(false);
+			return;
+		}
+		// Zeros through the encoder's lookahead; the final granule trims them
+		for (size_t left = blockFill_ + lookahead_; left > 0;) {
+			const bool final = left <= block_.size();
+			EncodeOpusFrame(final);
+			left = final ? 0 : left - block_.size();
+		}
+#else
+		(void)last; // Start() refuses Opus without it
+#endif
+	}
+
+#if defined(AUDIO_CORE_OPUS)
+	void EncodeOpusFrame(bool final) {
+		memset(block_.data() + blockFill_, 0, (block_.size() - blockFill_) * sizeof(int16_t));
+		blockFill_ = 0;
+		uint8_t packet[1275];
+		const opus_int32 bytes = opus_encode(opus_, block_.data(), (int)block_.size(), packet, (opus_int32)sizeof(packet));
+		if (bytes < 0) {
+			writeErrors_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		granule_ += (int64_t)block_.size() * 3; // 48 kHz samples
+		const int64_t end = (int64_t)(lookahead_ + segmentFill_) * 3;
+		ogg_->Packet(packet, (size_t)bytes, final ? std::min(granule_, end) : granule_);
+		if (++pagePackets_ == 50 && !final) { // one page per second
+			ogg_->Flush(false);
+			pagePackets_ = 0;
+		}
+	}
+#endif
+
+	// Appends pending_ to the file in whole kWriteBytes, or all of it.
+	void WritePending(bool all) {
+		const size_t n = all ? pending_.size() : pending_.size() / kWriteBytes * kWriteBytes;
+		if (n == 0) return;
+		if (file_.IsOpen()) {
+			if (file_.Append(pending_.data(), n)) bytes_.fetch_add(n, std::memory_order_relaxed);
+			else writeErrors_.fetch_add(1, std::memory_order_relaxed);
+		}
+		fileBytes_ += n;
+		pending_.erase(pending_.begin(), pending_.begin() + n);
+	}
+
+	void FinishSegment() {
+		if (!segmentOpen_) return;
+		segmentOpen_ = false;
+		if (config_.codec == RecordCodec::Flac) {
+			EncodeBlock(true);
+		} else if (config_.codec == RecordCodec::Opus) {
+#if defined(AUDIO_CORE_OPUS)
+			EncodeBlock(true);
+			ogg_->Flush(true);
+			ogg_.reset();
+#endif
+		}
+		WritePending(true);
+		bool patched = true;
+		if (config_.codec == RecordCodec::Wav) {
+			uint8_t header[kWavHeaderBytes];
+			WriteWavHeader(header, kRate, 1, (uint32_t)std::min<uint64_t>(fileBytes_ - kWavHeaderBytes, 0xffffffffu - kWavHeaderBytes));
+			patched = file_.WriteAt(0, header, sizeof(header));
+		} else if (config_.codec == RecordCodec::Flac) {
+			uint8_t total[5];
+			FlacStreamEncoder::TotalSamplesBytes(segmentFill_, total);
+			patched = file_.WriteAt(FlacStreamEncoder::kTotalSamplesOffset, total, sizeof(total));
+		}
+		if (file_.IsOpen() && !patched) writeErrors_.fetch_add(1, std::memory_order_relaxed);
+		file_.Close();
+	}
+
+	RecordConfig config_;
+	uint64_t segmentSamples_ = 0;
+	SpscByteFifo fifo_; // capture thread -> I/O thread, pcm16
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	bool closing_ = false; // mutex_
+
+	// I/O thread
+	SegmentFile file_;
+	uint32_t segmentIndex_ = 0;
+	bool segmentOpen_ = false;
+	uint64_t segmentFill_ = 0; // samples in the open segment
+	uint64_t fileBytes_ = 0;   // written to it so far
+	std::vector<int16_t> pcm_;
+	std::vector<uint8_t> pending_; // encoded, not yet written
+	std::unique_ptr<FlacStreamEncoder> flac_;
+	std::vector<int16_t> block_;   // FLAC block or Opus frame being filled
+	size_t blockFill_ = 0;
+#if defined(AUDIO_CORE_OPUS)
+	OpusEncoder* opus_ = nullptr;
+	size_t lookahead_ = 0;
+	std::unique_ptr<OggStreamWriter> ogg_;
+	int64_t granule_ = 0;
+	size_t pagePackets_ = 0;
+#endif
+
+	std::atomic<uint64_t> segments_{0};
+	std::atomic<uint64_t> recordedSamples_{0};
+	std::atomic<uint64_t> droppedSamples_{0};
+	std::atomic<uint64_t> bytes_{0};
+	std::atomic<uint64_t> writeErrors_{0};
+};
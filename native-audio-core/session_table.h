@@ -0,0 +1,312 @@
+#pragma once
+
+// Live table of processes with audio sessions, kept up to date by each addon's
+// event-driven session registry (IAudioSessionNotification on Windows, process
+// object listeners on macOS), plus the watchAudioSessions() /
+// unwatchAudioSessions() / getAudioSessions() / getSessionLevels() exports.
+// Rows are per PID; a PID is active while any of its sessions is playing.
+// The event bus (event_bus.h) can carry the deltas instead of the callback.
+// Captures with option 'idle' also keep the registry running, and are woken
+// through it when anything starts playing.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "addon_instance.h"
+
+struct AudioSessionRow {
+	uint32_t pid = 0;
+	std::string processName;
+	bool active = false;
+};
+
+enum class SessionChange { Added, Removed, Changed };
+
+struct AudioSessionDelta {
+	SessionChange change;
+	AudioSessionRow row;
+};
+
+inline const char* SessionChangeName(SessionChange c) {
+	switch (c) {
+	case SessionChange::Added: return "added";
+	case SessionChange::Removed: return "removed";
+	default: return "changed";
+	}
+}
+
+inline Napi::Object AudioSessionRowToJs(Napi::Env env, const AudioSessionRow& row) {
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("pid", Napi::Number::New(env, row.pid));
+	o.Set("processName", Napi::String::New(env, row.processName));
+	o.Set("hasActiveAudio", Napi::Boolean::New(env, row.active));
+	return o;
+}
+
+inline Napi::Array AudioSessionRowsToJs(Napi::Env env, const std::vector<AudioSessionRow>& rows) {
+	Napi::Array result = Napi::Array::New(env, rows.size());
+	for (size_t i = 0; i < rows.size(); ++i) result.Set((uint32_t)i, AudioSessionRowToJs(env, rows[i]));
+	return result;
+}
+
+// JS thread; env is null when the function is torn down with deltas queued.
+inline void DeliverSessionDelta(Napi::Env env, Napi::Function cb, void*, AudioSessionDelta* delta) {
+	if (env != nullptr && cb != nullptr) {
+		Napi::Object o = AudioSessionRowToJs(env, delta->row);
+		o.Set("type", Napi::String::New(env, SessionChangeName(delta->change)));
+		cb.Call({ o });
+	}
+	delete delta;
+}
+
+using SessionTsfn = Napi::TypedThreadSafeFunction<void, AudioSessionDelta, DeliverSessionDelta>;
+
+class SessionTable {
+public:
+	// Registry side. Only real changes reach the sink.
+	void Set(uint32_t pid, const std::string& processName, bool active) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = rows_.find(pid);
+		if (it == rows_.end()) {
+			AudioSessionRow& row = rows_[pid];
+			row.pid = pid;
+			row.processName = processName;
+			row.active = active;
+			EmitLocked(SessionChange::Added, row);
+			if (active) WakeLocked();
+			return;
+		}
+		if (it->second.active == active && (processName.empty() || it->second.processName == processName)) return;
+		if (active && !it->second.active) WakeLocked();
+		it->second.active = active;
+		if (!processName.empty()) it->second.processName = processName;
+		EmitLocked(SessionChange::Changed, it->second);
+	}
+
+	void Remove(uint32_t pid) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = rows_.find(pid);
+		if (it == rows_.end()) return;
+		EmitLocked(SessionChange::Removed, it->second);
+		rows_.erase(it);
+	}
+
+	std::vector<AudioSessionRow> Rows() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::vector<AudioSessionRow> rows;
+		rows.reserve(rows_.size());
+		for (const auto& kv : rows_) rows.push_back(kv.second);
+		return rows;
+	}
+
+	bool Active(uint32_t pid) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = rows_.find(pid);
+		return it != rows_.end() && it->second.active;
+	}
+
+	// Any process is playing.
+	bool AnyActive() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return std::any_of(rows_.begin(), rows_.end(), [](const auto& kv) { return kv.second.active; });
+	}
+
+	// Capture threads waiting for playback: wake(context) runs, with the
+	// table locked, whenever a row turns active.
+	void AddWaker(void (*wake)(void*), void* context) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		wakers_.push_back({ wake, context });
+	}
+	void RemoveWaker(void* context) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		wakers_.erase(std::remove_if(wakers_.begin(), wakers_.end(), [context](const Waker& w) { return w.context == context; }),
+		              wakers_.end());
+	}
+
+	// JS thread of env. Replaces (and releases) any previous sink.
+	void SetSink(SessionTsfn sink, napi_env env) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (hasSink_) sink_.Release();
+		sink_ = sink;
+		hasSink_ = true;
+		sinkEnv_ = env;
+	}
+
+	// At env teardown: drops the sink if it lives in env; the rows stay.
+	void DropSink(napi_env env) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!hasSink_ || sinkEnv_ != env) return;
+		sink_.Release();
+		hasSink_ = false;
+	}
+
+	// Deltas go to forward instead of the sink while it's set (the event
+	// bus); null hands them back. Called with the table locked.
+	void Forward(void (*forward)(SessionChange, const AudioSessionRow&)) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		forward_ = forward;
+	}
+
+	// JS thread: drop the sink, and every row unless the registry keeps running.
+	void Reset(bool rows = true) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (hasSink_) sink_.Release();
+		hasSink_ = false;
+		if (rows) rows_.clear();
+	}
+
+	// Set on the JS thread; read from enumeration workers too.
+	bool Running() const { return running_.load(std::memory_order_acquire); }
+	void SetRunning(bool running) { running_.store(running, std::memory_order_release); }
+
+	// Held by the JS thread of whichever environment starts or stops the registry.
+	std::mutex& Lifecycle() { return lifecycle_; }
+	// Under Lifecycle(): the registry runs while JS watches or captures retain it.
+	bool Watched() const { return watched_; }
+	void SetWatched(bool watched) { watched_ = watched; }
+	uint32_t& Retained() { return retained_; }
+
+private:
+	struct Waker {
+		void (*wake)(void*);
+		void* context;
+	};
+
+	void WakeLocked() {
+		for (const Waker& w : wakers_) w.wake(w.context);
+	}
+
+	void EmitLocked(SessionChange change, const AudioSessionRow& row) {
+		if (forward_ != nullptr) {
+			forward_(change, row);
+			return;
+		}
+		if (!hasSink_) return;
+		AudioSessionDelta* delta = new AudioSessionDelta{ change, row };
+		if (sink_.NonBlockingCall(delta) != napi_ok) delete delta;
+	}
+
+	mutable std::mutex mutex_;
+	std::mutex lifecycle_;
+	std::unordered_map<uint32_t, AudioSessionRow> rows_;
+	SessionTsfn sink_;
+	bool hasSink_ = false;
+	napi_env sinkEnv_ = nullptr;
+	void (*forward_)(SessionChange, const AudioSessionRow&) = nullptr;
+	std::vector<Waker> wakers_;
+	std::atomic<bool> running_{false};
+	bool watched_ = false; // Lifecycle()
+	uint32_t retained_ = 0; // likewise
+};
+
+inline SessionTable& AudioSessionTable() {
+	static SessionTable table;
+	return table;
+}
+
+inline void DropEnvSessionSink(napi_env env) {
+	AudioSessionTable().DropSink(env);
+}
+
+// One row per PID for getSessionLevels(). peak is the session meter's current
+// peak (0..1) when metered; platforms without per-process meters report 1 for
+// processes that are playing and 0 otherwise, with metered = false.
+struct AudioSessionLevel {
+	uint32_t pid = 0;
+	std::string processName;
+	float peak = 0.0f;
+	bool metered = false;
+};
+
+// Implemented by each addon. Start fills the table before returning and keeps
+// it current from OS notifications until Stop.
+bool StartAudioSessionRegistry(SessionTable* table);
+void StopAudioSessionRegistry();
+// Samples every session once; uses the running registry when there is one.
+std::vector<AudioSessionLevel> SampleAudioSessionLevels();
+
+// watchAudioSessions(callback?) -> boolean. Starts the registry; callback, if
+// given, receives { type: 'added' | 'removed' | 'changed', pid, processName,
+// hasActiveAudio } for every change, starting with one 'added' per existing row.
+inline Napi::Value WatchAudioSessions(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	SessionTable& table = AudioSessionTable();
+	if (info.Length() > 0 && !info[0].IsUndefined()) {
+		if (!info[0].IsFunction()) {
+			Napi::TypeError::New(env, "Callback must be a function").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		SessionTsfn sink = SessionTsfn::New(env, info[0].As<Napi::Function>(), "AudioSessionCallback", 0, 1);
+		sink.Unref(env); // never keeps the process alive
+		table.SetSink(sink, env);
+		DetachAtTeardown<DropEnvSessionSink>(env);
+	}
+	std::lock_guard<std::mutex> lock(table.Lifecycle());
+	table.SetWatched(true);
+	if (!table.Running()) table.SetRunning(StartAudioSessionRegistry(&table));
+	return Napi::Boolean::New(env, table.Running());
+}
+
+// A capture retaining the registry keeps it, and its rows, past this.
+inline Napi::Value UnwatchAudioSessions(const Napi::CallbackInfo& info) {
+	SessionTable& table = AudioSessionTable();
+	std::lock_guard<std::mutex> lock(table.Lifecycle());
+	table.SetWatched(false);
+	if (table.Retained() > 0) {
+		table.Reset(false);
+		return info.Env().Undefined();
+	}
+	if (table.Running()) StopAudioSessionRegistry();
+	table.SetRunning(false);
+	table.Reset();
+	return info.Env().Undefined();
+}
+
+// Capture threads with option 'idle'. Retain starts the registry if nothing
+// has and returns whether it runs; the last Release stops it unless JS still
+// watches.
+inline bool RetainAudioSessionRegistry() {
+	SessionTable& table = AudioSessionTable();
+	std::lock_guard<std::mutex> lock(table.Lifecycle());
+	++table.Retained();
+	if (!table.Running()) table.SetRunning(StartAudioSessionRegistry(&table));
+	return table.Running();
+}
+
+inline void ReleaseAudioSessionRegistry() {
+	SessionTable& table = AudioSessionTable();
+	std::lock_guard<std::mutex> lock(table.Lifecycle());
+	if (table.Retained() == 0 || --table.Retained() > 0 || table.Watched()) return;
+	if (table.Running()) StopAudioSessionRegistry();
+	table.SetRunning(false);
+	table.Reset();
+}
+
+// getAudioSessions() -> [{ pid, processName, hasActiveAudio }]; empty unless watching.
+inline Napi::Value GetAudioSessions(const Napi::CallbackInfo& info) {
+	return AudioSessionRowsToJs(info.Env(), AudioSessionTable().Rows());
+}
+
+// getSessionLevels() -> [{ pid, processName, peak, metered }], loudest first.
+inline Napi::Value GetSessionLevels(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::vector<AudioSessionLevel> levels = SampleAudioSessionLevels();
+	std::stable_sort(levels.begin(), levels.end(), [](const AudioSessionLevel& a, const AudioSessionLevel& b) { return a.peak > b.peak; });
+	Napi::Array result = Napi::Array::New(env, levels.size());
+	for (size_t i = 0; i < levels.size(); ++i) {
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("pid", Napi::Number::New(env, levels[i].pid));
+		o.Set("processName", Napi::String::New(env, levels[i].processName));
+		o.Set("peak", Napi::Number::New(env, levels[i].peak));
+		o.Set("metered", Napi::Boolean::New(env, levels[i].metered));
+		result.Set((uint32_t)i, o);
+	}
+	return result;
+}
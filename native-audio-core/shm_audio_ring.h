@@ -0,0 +1,908 @@
+#pragma once
+
+// Single-producer shared-memory ring carrying pcm16 chunks to a long-lived
+// out-of-process consumer (the Python workers, through
+// src/whisper/whispra_ring.py), so handing over a chunk costs one copy and a
+// doorbell instead of a temp file and a process spawn. A ring is fed either by
+// the capture thread (the processed 16 kHz stream, one record per capture
+// period) or by JS with writeAudioRing, never both. Layout, little-endian and
+// mirrored in whispra_ring.py:
+//
+//   0    char magic[4] "WSAR", u32 version, u32 capacity, u32 sampleRate, u32 channels
+//   64   u64 writePos  bytes ever written (producer, release store)
+//   128  u64 readPos   bytes ever consumed (consumer)
+//   192  u32 dropped, u32 closed
+//   256  data[capacity]
+//
+// Records are 16-byte aligned and never straddle the end of the data area:
+// { u32 bytes, u16 kind, u16 reserved, u32 seq, u32 timeMs } then the payload;
+// kind 1 pads out the tail so the next record starts at offset 0. Kinds 2
+// (gray8) and 3 (BGRA) carry an image instead of pcm16, for the OCR worker
+// (src/paddle/ocr_service.py): { u32 width, u32 height, u32 stride,
+// u32 channels } then height rows of stride bytes, stride a multiple of 16, so
+// the reader wraps the slab as a numpy array without copying. Kind 4 is an
+// opaque message written by JS (writeMessageRing), for a ring between two of
+// our own processes: a capture host publishes its packets and events that
+// way, and the main process attaches a reader (attachAudioRing) that wakes JS
+// when records arrive. A full ring drops the chunk (counted in dropped)
+// rather than blocking the producer. The doorbell is a named auto-reset event
+// on Windows and a named POSIX semaphore on macOS (there is no public futex
+// there); it is rung once per record and on close.
+//
+//   openAudioRing(name, { capacityKb?, sampleRate?, source?: 'manual' | 'capture' })
+//     -> { mapping, doorbell, capacity, sampleRate }
+//   writeAudioRing(name, Int16Array | WAV Buffer) -> seq, or -1 when dropped
+//   writeImageRing(name, { data, width, height, stride?, format? }) -> seq, or -1 when dropped
+//   writeMessageRing(name, Buffer) -> seq, or -1 when dropped
+//   closeAudioRing(name) -> whether the ring existed
+//
+// Reader side, for a ring another process created:
+//
+//   attachAudioRing(mapping, doorbell, onReady) -> id; onReady() is called on
+//     the JS thread once records are waiting (again only after a read)
+//   readAudioRing(id, maxRecords?) -> { records: [{ kind, seq, timeMs, data }], dropped, closed }
+//     where data is an Int16Array for pcm records and a Buffer otherwise
+//   detachAudioRing(id) -> whether it was attached
+
+#include <napi.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "addon_instance.h"
+#include "capture_options.h"
+#include "wav_reader.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr uint32_t kAudioRingVersion = 1;
+constexpr size_t kAudioRingDataOffset = 256;
+constexpr size_t kAudioRingRecordHeader = 16;
+constexpr uint16_t kAudioRingPcm = 0;
+constexpr uint16_t kAudioRingPad = 1;
+constexpr uint16_t kAudioRingGray8 = 2;
+constexpr uint16_t kAudioRingBgra = 3;
+constexpr uint16_t kAudioRingMessage = 4;
+constexpr size_t kAudioRingImageHeader = 16;
+
+struct AudioRingHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t capacity;
+	uint32_t sampleRate;
+	uint32_t channels;
+	uint8_t reserved0[44];
+	alignas(64) std::atomic<uint64_t> writePos;
+	alignas(64) std::atomic<uint64_t> readPos;
+	alignas(64) std::atomic<uint32_t> dropped;
+	std::atomic<uint32_t> closed;
+};
+static_assert(sizeof(AudioRingHeader) <= kAudioRingDataOffset, "ring header overlaps the data area");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring positions must be lock-free to be shared");
+
+struct AudioRingRecord {
+	uint32_t bytes;
+	uint16_t kind;
+	uint16_t reserved;
+	uint32_t seq;
+	uint32_t timeMs;
+};
+static_assert(sizeof(AudioRingRecord) == kAudioRingRecordHeader, "record header size");
+
+class SharedAudioRing {
+public:
+	SharedAudioRing() = default;
+	SharedAudioRing(const SharedAudioRing&) = delete;
+	SharedAudioRing& operator=(const SharedAudioRing&) = delete;
+	~SharedAudioRing() { Close(); }
+
+	// capacity must be a power of two. The system names carry the pid and a
+	// per-process serial, so neither two app instances nor a reopened ring
+	// (whose predecessor may still be draining on the capture thread) collide.
+	bool Create(const std::string& name, uint32_t capacity, uint32_t sampleRate, bool captureFed, std::string* error) {
+		static std::atomic<uint32_t> serial{0};
+		const std::string unique = std::to_string(serial.fetch_add(1, std::memory_order_relaxed) % 1000) + "." + name;
+		captureFed_ = captureFed;
+		const size_t size = kAudioRingDataOffset + capacity;
+#if defined(_WIN32)
+		mappingName_ = "Local\\whispra-ring-" + std::to_string(GetCurrentProcessId()) + "-" + unique;
+		doorbellName_ = mappingName_ + "-bell";
+		mapping_ = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)size, Widen(mappingName_).c_str());
+		if (!mapping_) return Fail("CreateFileMapping", error);
+		base_ = static_cast<uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size));
+		if (!base_) return Fail("MapViewOfFile", error);
+		doorbell_ = CreateEventW(nullptr, FALSE, FALSE, Widen(doorbellName_).c_str());
+		if (!doorbell_) return Fail("CreateEvent", error);
+#else
+		// PSHMNAMLEN is 31 on macOS, hence the terse names
+		mappingName_ = "/wr" + std::to_string(getpid()) + "." + unique;
+		doorbellName_ = mappingName_ + ".b";
+		shm_unlink(mappingName_.c_str()); // a crashed predecessor that had our pid
+		sem_unlink(doorbellName_.c_str());
+		const int fd = shm_open(mappingName_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd < 0) return Fail("shm_open", error);
+		unlinkOnClose_ = true;
+		if (ftruncate(fd, (off_t)size) != 0) {
+			close(fd);
+			return Fail("ftruncate", error);
+		}
+		void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED) return Fail("mmap", error);
+		base_ = static_cast<uint8_t*>(p);
+		doorbell_ = sem_open(doorbellName_.c_str(), O_CREAT | O_EXCL, 0600, 0);
+		if (doorbell_ == SEM_FAILED) {
+			doorbell_ = nullptr;
+			return Fail("sem_open", error);
+		}
+#endif
+		size_ = size;
+		capacity_ = capacity;
+		header_ = new (base_) AudioRingHeader();
+		std::memcpy(header_->magic, "WSAR", 4);
+		header_->version = kAudioRingVersion;
+		header_->capacity = capacity;
+		header_->sampleRate = sampleRate;
+		header_->channels = 1;
+		header_->writePos.store(0, std::memory_order_relaxed);
+		header_->readPos.store(0, std::memory_order_relaxed);
+		header_->dropped.store(0, std::memory_order_relaxed);
+		header_->closed.store(0, std::memory_order_release);
+		start_ = std::chrono::steady_clock::now();
+		return true;
+	}
+
+	const std::string& MappingName() const { return mappingName_; }
+	const std::string& DoorbellName() const { return doorbellName_; }
+	uint32_t Capacity() const { return capacity_; }
+	uint32_t SampleRate() const { return header_ ? header_->sampleRate : 0; }
+	bool CaptureFed() const { return captureFed_; }
+
+	// Room for samples pcm16 samples, written in place and published by
+	// Commit; null (and counted as dropped) when the reader is too far behind.
+	int16_t* Reserve(size_t samples) {
+		return reinterpret_cast<int16_t*>(ReserveRecord(samples * sizeof(int16_t)));
+	}
+
+	// Publishes the record Reserve handed out, with its sample count, and
+	// rings the doorbell; returns its seq.
+	uint32_t Commit(size_t samples) { return CommitRecord(kAudioRingPcm, samples * sizeof(int16_t)); }
+
+	// -1 when the chunk was dropped.
+	int64_t Write(const void* pcm16, size_t samples) {
+		int16_t* out = Reserve(samples);
+		if (!out) return -1;
+		std::memcpy(out, pcm16, samples * sizeof(int16_t));
+		return Commit(samples);
+	}
+
+	// One image record (kind gray8 or BGRA), rows repacked to a 16-byte
+	// stride; -1 when it was dropped.
+	int64_t WriteImage(const uint8_t* pixels, uint32_t width, uint32_t height, size_t stride, uint32_t channels) {
+		const uint32_t packed = (width * channels + 15) & ~15u;
+		const size_t bytes = kAudioRingImageHeader + (size_t)packed * height;
+		uint8_t* out = ReserveRecord(bytes);
+		if (!out) return -1;
+		const uint32_t info[4] = { width, height, packed, channels };
+		std::memcpy(out, info, sizeof(info));
+		for (uint32_t row = 0; row < height; ++row) {
+			uint8_t* d = out + kAudioRingImageHeader + (size_t)row * packed;
+			std::memcpy(d, pixels + (size_t)row * stride, (size_t)width * channels);
+			std::memset(d + (size_t)width * channels, 0, packed - width * channels);
+		}
+		return CommitRecord(channels == 1 ? kAudioRingGray8 : kAudioRingBgra, bytes);
+	}
+
+	// One opaque message record; -1 when it was dropped.
+	int64_t WriteMessage(const uint8_t* data, size_t bytes) {
+		uint8_t* out = ReserveRecord(bytes);
+		if (!out) return -1;
+		std::memcpy(out, data, bytes);
+		return CommitRecord(kAudioRingMessage, bytes);
+	}
+
+	void Close() {
+		if (header_) {
+			header_->closed.store(1, std::memory_order_release);
+			Ring();
+		}
+		header_ = nullptr;
+#if defined(_WIN32)
+		if (base_) UnmapViewOfFile(base_);
+		if (mapping_) CloseHandle(mapping_);
+		if (doorbell_) CloseHandle(doorbell_);
+		mapping_ = nullptr;
+#else
+		// The reader keeps its own mapping and semaphore reference; unlinking
+		// only retires the names
+		if (base_) munmap(base_, size_);
+		if (doorbell_) sem_close(doorbell_);
+		if (unlinkOnClose_) {
+			shm_unlink(mappingName_.c_str());
+			sem_unlink(doorbellName_.c_str());
+		}
+		unlinkOnClose_ = false;
+#endif
+		base_ = nullptr;
+		doorbell_ = nullptr;
+		size_ = 0;
+	}
+
+private:
+	// Payload room for one record, at the 16-byte aligned offset after its header.
+	uint8_t* ReserveRecord(size_t payload) {
+		if (!header_) return nullptr;
+		const uint64_t bytes = AlignRecord(kAudioRingRecordHeader + payload);
+		const uint64_t w = header_->writePos.load(std::memory_order_relaxed);
+		const uint64_t r = header_->readPos.load(std::memory_order_acquire);
+		const uint64_t offset = w & (capacity_ - 1);
+		const uint64_t pad = capacity_ - offset < bytes ? capacity_ - offset : 0;
+		if (bytes > capacity_ / 2 || w + pad + bytes - r > capacity_) {
+			header_->dropped.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		if (pad) {
+			AudioRingRecord* filler = RecordAt(offset);
+			filler->bytes = (uint32_t)(pad - kAudioRingRecordHeader);
+			filler->kind = kAudioRingPad;
+			filler->reserved = 0;
+			filler->seq = 0;
+			filler->timeMs = 0;
+		}
+		pending_ = w + pad;
+		pendingBytes_ = bytes;
+		return reinterpret_cast<uint8_t*>(RecordAt(pending_ & (capacity_ - 1)) + 1);
+	}
+
+	// Publishes the reserved record and rings the doorbell; returns its seq.
+	uint32_t CommitRecord(uint16_t kind, size_t payload) {
+		AudioRingRecord* record = RecordAt(pending_ & (capacity_ - 1));
+		record->bytes = (uint32_t)payload;
+		record->kind = kind;
+		record->reserved = 0;
+		record->seq = seq_;
+		record->timeMs = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_).count();
+		header_->writePos.store(pending_ + pendingBytes_, std::memory_order_release);
+		Ring();
+		return seq_++;
+	}
+
+	static uint64_t AlignRecord(uint64_t n) { return (n + 15) & ~uint64_t(15); }
+
+	AudioRingRecord* RecordAt(uint64_t offset) {
+		return reinterpret_cast<AudioRingRecord*>(base_ + kAudioRingDataOffset + offset);
+	}
+
+	void Ring() {
+#if defined(_WIN32)
+		if (doorbell_) SetEvent(doorbell_);
+#else
+		if (doorbell_) sem_post(doorbell_);
+#endif
+	}
+
+	bool Fail(const char* what, std::string* error) {
+		*error = std::string(what) + " failed for audio ring " + mappingName_;
+		Close();
+		return false;
+	}
+
+#if defined(_WIN32)
+	static std::wstring Widen(const std::string& s) { return std::wstring(s.begin(), s.end()); } // names are ASCII
+
+	HANDLE mapping_ = nullptr;
+	HANDLE doorbell_ = nullptr;
+#else
+	sem_t* doorbell_ = nullptr;
+	bool unlinkOnClose_ = false;
+#endif
+	uint8_t* base_ = nullptr;
+	size_t size_ = 0;
+	uint32_t capacity_ = 0;
+	AudioRingHeader* header_ = nullptr;
+	std::string mappingName_;
+	std::string doorbellName_;
+	bool captureFed_ = false;
+	uint32_t seq_ = 0;
+	uint64_t pending_ = 0;
+	uint64_t pendingBytes_ = 0;
+	std::chrono::steady_clock::time_point start_;
+};
+
+// JS thread opens and closes; the capture thread copies the capture-fed list
+// whenever the generation moves, like SubscriberRegistry.
+class AudioRingRegistry {
+public:
+	void Add(const std::string& name, std::shared_ptr<SharedAudioRing> ring) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		RemoveLocked(name);
+		rings_.push_back({ name, std::move(ring) });
+		generation_.fetch_add(1, std::memory_order_release);
+	}
+
+	bool Remove(const std::string& name) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!RemoveLocked(name)) return false;
+		generation_.fetch_add(1, std::memory_order_release);
+		return true;
+	}
+
+	std::shared_ptr<SharedAudioRing> Find(const std::string& name) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto& entry : rings_) if (entry.name == name) return entry.ring;
+		return nullptr;
+	}
+
+	uint64_t Generation() const { return generation_.load(std::memory_order_acquire); }
+
+	void SnapshotCaptureFed(std::vector<std::shared_ptr<SharedAudioRing>>* out, uint64_t* generation) const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		*generation = generation_.load(std::memory_order_relaxed);
+		out->clear();
+		for (auto& entry : rings_) if (entry.ring->CaptureFed()) out->push_back(entry.ring);
+	}
+
+private:
+	struct Entry {
+		std::string name;
+		std::shared_ptr<SharedAudioRing> ring;
+	};
+
+	bool RemoveLocked(const std::string& name) {
+		for (size_t i = 0; i < rings_.size(); ++i) {
+			if (rings_[i].name != name) continue;
+			rings_.erase(rings_.begin() + i);
+			return true;
+		}
+		return false;
+	}
+
+	mutable std::mutex mutex_;
+	std::vector<Entry> rings_;
+	std::atomic<uint64_t> generation_{0};
+};
+
+inline AudioRingRegistry& AudioRings() {
+	static AudioRingRegistry registry;
+	return registry;
+}
+
+// Capture-thread side: converts each processed block straight into the
+// capture-fed rings' shared memory.
+class AudioRingFanout {
+public:
+	void Write(const float* samples, size_t count, float gain) {
+		if (AudioRings().Generation() != generation_) AudioRings().SnapshotCaptureFed(&rings_, &generation_);
+		for (auto& ring : rings_) {
+			int16_t* out = ring->Reserve(count);
+			if (!out) continue;
+			for (size_t i = 0; i < count; ++i) {
+				float v = samples[i] * gain * 32768.0f;
+				v = v > 32767.0f ? 32767.0f : (v < -32768.0f ? -32768.0f : v);
+				out[i] = (int16_t)v;
+			}
+			ring->Commit(count);
+		}
+	}
+
+	// At capture end; a ring closed meanwhile is released here.
+	void Clear() {
+		rings_.clear();
+		generation_ = ~0ull;
+	}
+
+private:
+	uint64_t generation_ = ~0ull;
+	std::vector<std::shared_ptr<SharedAudioRing>> rings_;
+};
+
+inline bool ValidAudioRingName(const std::string& name) {
+	if (name.empty() || name.size() > 12) return false;
+	for (char c : name) {
+		const bool ok = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '_';
+		if (!ok) return false;
+	}
+	return true;
+}
+
+// openAudioRing(name, { capacityKb?, sampleRate?, source? }) - replaces any
+// ring of the same name. capacityKb is rounded up to a power of two (64-16384,
+// default 1024, about 30 s of 16 kHz audio).
+inline Napi::Value OpenAudioRing(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Ring name required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const std::string name = info[0].As<Napi::String>().Utf8Value();
+	if (!ValidAudioRingName(name)) {
+		Napi::TypeError::New(env, "Ring names are 1-12 characters of a-z, 0-9, '-' or '_'").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	uint32_t capacityKb = 1024;
+	uint32_t sampleRate = 16000;
+	int source = 0;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object obj = info[1].As<Napi::Object>();
+		std::string error;
+		if (!ReadUint32Option(obj, "capacityKb", 64, 16384, &capacityKb, &error) ||
+		    !ReadUint32Option(obj, "sampleRate", 8000, 48000, &sampleRate, &error) ||
+		    !ReadEnumOption(obj, "source", { "manual", "capture" }, &source, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+	if (source == 1 && sampleRate != 16000) {
+		Napi::TypeError::New(env, "Capture-fed rings carry the 16 kHz processed stream").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	uint32_t capacity = 64 * 1024;
+	while (capacity < capacityKb * 1024) capacity <<= 1;
+
+	auto ring = std::make_shared<SharedAudioRing>();
+	std::string error;
+	if (!ring->Create(name, capacity, sampleRate, source == 1, &error)) {
+		Napi::Error::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Object result = Napi::Object::New(env);
+	result.Set("mapping", Napi::String::New(env, ring->MappingName()));
+	result.Set("doorbell", Napi::String::New(env, ring->DoorbellName()));
+	result.Set("capacity", Napi::Number::New(env, capacity));
+	result.Set("sampleRate", Napi::Number::New(env, sampleRate));
+	AudioRings().Add(name, std::move(ring));
+	return result;
+}
+
+// writeAudioRing(name, Int16Array | WAV Buffer) -> seq, or -1 when the ring is full.
+inline Napi::Value WriteAudioRing(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Ring name and audio required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	std::shared_ptr<SharedAudioRing> ring = AudioRings().Find(info[0].As<Napi::String>().Utf8Value());
+	if (!ring) {
+		Napi::Error::New(env, "No such audio ring").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (ring->CaptureFed()) {
+		Napi::Error::New(env, "Audio ring is fed by the capture").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const void* samples = nullptr;
+	size_t count = 0;
+	if (info[1].IsBuffer()) {
+		Napi::Buffer<uint8_t> wav = info[1].As<Napi::Buffer<uint8_t>>();
+		const uint8_t* data = nullptr;
+		uint32_t rate = 0;
+		std::string error;
+		if (!FindWavPcm16(wav.Data(), wav.Length(), &data, &count, &rate, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		if (rate != ring->SampleRate()) {
+			Napi::TypeError::New(env, "WAV rate differs from the ring's").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		samples = data;
+	} else if (info[1].IsTypedArray() && info[1].As<Napi::TypedArray>().TypedArrayType() == napi_int16_array) {
+		Napi::Int16Array pcm = info[1].As<Napi::Int16Array>();
+		samples = pcm.Data();
+		count = pcm.ElementLength();
+	} else {
+		Napi::TypeError::New(env, "Audio must be an Int16Array or a WAV Buffer").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	return Napi::Number::New(env, (double)ring->Write(samples, count));
+}
+
+inline Napi::Value CloseAudioRing(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Ring name required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	return Napi::Boolean::New(env, AudioRings().Remove(info[0].As<Napi::String>().Utf8Value()));
+}
+
+// writeImageRing(name, { data, width, height, stride?, format? }) -> seq, or
+// -1 when the ring is full. Takes RegionCapture / preprocessForOcr output.
+inline Napi::Value WriteImageRing(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsString() || !info[1].IsObject()) {
+		Napi::TypeError::New(env, "Ring name and image { data, width, height } required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	std::shared_ptr<SharedAudioRing> ring = AudioRings().Find(info[0].As<Napi::String>().Utf8Value());
+	if (!ring) {
+		Napi::Error::New(env, "No such audio ring").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (ring->CaptureFed()) {
+		Napi::Error::New(env, "Audio ring is fed by the capture").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Object image = info[1].As<Napi::Object>();
+	if (!image.Get("data").IsBuffer() || !image.Get("width").IsNumber() || !image.Get("height").IsNumber()) {
+		Napi::TypeError::New(env, "Image needs a data Buffer, width and height").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Buffer<uint8_t> data = image.Get("data").As<Napi::Buffer<uint8_t>>();
+	uint32_t width = 0, height = 0, stride = 0;
+	int format = 1; // gray unless told otherwise
+	std::string error;
+	if (!ReadUint32Option(image, "width", 1, 16384, &width, &error) ||
+	    !ReadUint32Option(image, "height", 1, 16384, &height, &error) ||
+	    !ReadEnumOption(image, "format", { "bgra", "gray" }, &format, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const uint32_t channels = format == 0 ? 4 : 1;
+	stride = width * channels;
+	if (!ReadUint32Option(image, "stride", stride, 65536 * 4, &stride, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (data.Length() < (size_t)stride * (height - 1) + (size_t)width * channels) {
+		Napi::RangeError::New(env, "Image data is shorter than height rows of stride bytes").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	return Napi::Number::New(env, (double)ring->WriteImage(data.Data(), width, height, stride, channels));
+}
+
+// writeMessageRing(name, Buffer) -> seq, or -1 when the ring is full.
+inline Napi::Value WriteMessageRing(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsString() || !info[1].IsBuffer()) {
+		Napi::TypeError::New(env, "Ring name and message Buffer required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	std::shared_ptr<SharedAudioRing> ring = AudioRings().Find(info[0].As<Napi::String>().Utf8Value());
+	if (!ring) {
+		Napi::Error::New(env, "No such audio ring").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (ring->CaptureFed()) {
+		Napi::Error::New(env, "Audio ring is fed by the capture").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Buffer<uint8_t> message = info[1].As<Napi::Buffer<uint8_t>>();
+	return Napi::Number::New(env, (double)ring->WriteMessage(message.Data(), message.Length()));
+}
+
+class AudioRingAttachment;
+// JS thread; env is null when the function is torn down.
+inline void DeliverRingReady(Napi::Env env, Napi::Function cb, AudioRingAttachment*, void*);
+
+using RingReadyTsfn = Napi::TypedThreadSafeFunction<AudioRingAttachment, void, DeliverRingReady>;
+
+// The consumer end of a ring another process created (the names openAudioRing
+// returned there). A waiter thread sleeps on the doorbell and wakes JS once
+// records are waiting; it does not wake it again until JS has read, so a busy
+// main thread gets one call however many records pile up. The waiter also
+// polls every kAudioRingPollMs, which covers a doorbell rung before attach.
+class AudioRingAttachment {
+public:
+	static constexpr int kAudioRingPollMs = 50;
+
+	AudioRingAttachment() = default;
+	AudioRingAttachment(const AudioRingAttachment&) = delete;
+	AudioRingAttachment& operator=(const AudioRingAttachment&) = delete;
+	~AudioRingAttachment() { Detach(); }
+
+	bool Open(const std::string& mapping, const std::string& doorbell, std::string* error) {
+		name_ = mapping;
+		size_t size = 0;
+#if defined(_WIN32)
+		if (mapping.rfind("Local\\whispra-ring-", 0) != 0) return Fail("Not an audio ring name:", error);
+		mapping_ = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, Widen(mapping).c_str());
+		if (!mapping_) return Fail("OpenFileMapping failed for audio ring", error);
+		base_ = static_cast<uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+		if (!base_) return Fail("MapViewOfFile failed for audio ring", error);
+		MEMORY_BASIC_INFORMATION region;
+		if (VirtualQuery(base_, &region, sizeof(region)) == 0) return Fail("VirtualQuery failed for audio ring", error);
+		size = region.RegionSize;
+		doorbell_ = OpenEventW(SYNCHRONIZE, FALSE, Widen(doorbell).c_str());
+		if (!doorbell_) return Fail("OpenEvent failed for audio ring", error);
+#else
+		if (mapping.rfind("/wr", 0) != 0) return Fail("Not an audio ring name:", error);
+		const int fd = shm_open(mapping.c_str(), O_RDWR, 0);
+		if (fd < 0) return Fail("shm_open failed for audio ring", error);
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			close(fd);
+			return Fail("fstat failed for audio ring", error);
+		}
+		size = (size_t)st.st_size;
+		void* p = size >= kAudioRingDataOffset ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+		close(fd);
+		if (p == MAP_FAILED) return Fail("mmap failed for audio ring", error);
+		base_ = static_cast<uint8_t*>(p);
+		size_ = size;
+		doorbell_ = sem_open(doorbell.c_str(), 0);
+		if (doorbell_ == SEM_FAILED) {
+			doorbell_ = nullptr;
+			return Fail("sem_open failed for audio ring", error);
+		}
+#endif
+		header_ = reinterpret_cast<AudioRingHeader*>(base_);
+		capacity_ = header_->capacity;
+		if (std::memcmp(header_->magic, "WSAR", 4) != 0 || header_->version != kAudioRingVersion || capacity_ == 0 ||
+		    (capacity_ & (capacity_ - 1)) != 0 || kAudioRingDataOffset + (size_t)capacity_ > size) {
+			return Fail("Not a version 1 audio ring:", error);
+		}
+		return true;
+	}
+
+	// JS thread, once after Open.
+	void Start(RingReadyTsfn tsfn, napi_env env) {
+		tsfn_ = tsfn;
+		env_ = env;
+		waiter_ = std::thread([this] { Wait(); });
+	}
+
+	napi_env Env() const { return env_; }
+	uint32_t Dropped() const { return header_->dropped.load(std::memory_order_relaxed); }
+	bool Closed() const { return header_->closed.load(std::memory_order_acquire) != 0; }
+
+	// JS thread: rearms the wake-up, then hands out the next record (pads
+	// skipped); false when the ring is drained.
+	bool Next(AudioRingRecord* record, std::vector<uint8_t>* payload) {
+		notified_.store(false, std::memory_order_release);
+		uint64_t r = header_->readPos.load(std::memory_order_relaxed);
+		const uint64_t w = header_->writePos.load(std::memory_order_acquire);
+		while (r < w) {
+			std::memcpy(record, base_ + kAudioRingDataOffset + (r & (capacity_ - 1)), sizeof(*record));
+			if (record->bytes > capacity_ / 2) { // a torn or foreign ring; give up on it
+				header_->readPos.store(w, std::memory_order_release);
+				return false;
+			}
+			const uint64_t next = r + ((kAudioRingRecordHeader + record->bytes + 15) & ~uint64_t(15));
+			if (record->kind == kAudioRingPad) {
+				r = next;
+				continue;
+			}
+			const uint8_t* data = base_ + kAudioRingDataOffset + (r & (capacity_ - 1)) + kAudioRingRecordHeader;
+			payload->assign(data, data + record->bytes);
+			header_->readPos.store(next, std::memory_order_release);
+			return true;
+		}
+		header_->readPos.store(r, std::memory_order_release);
+		return false;
+	}
+
+	void Detach() {
+		stop_.store(true, std::memory_order_release);
+		if (waiter_.joinable()) waiter_.join();
+		if (env_) tsfn_.Release();
+		env_ = nullptr;
+#if defined(_WIN32)
+		if (base_) UnmapViewOfFile(base_);
+		if (mapping_) CloseHandle(mapping_);
+		if (doorbell_) CloseHandle(doorbell_);
+		mapping_ = nullptr;
+#else
+		if (base_) munmap(base_, size_);
+		if (doorbell_) sem_close(doorbell_);
+#endif
+		base_ = nullptr;
+		header_ = nullptr;
+		doorbell_ = nullptr;
+	}
+
+private:
+	void Wait() {
+		bool closeNoted = false;
+		while (!stop_.load(std::memory_order_acquire)) {
+			WaitDoorbell();
+			const bool waiting = header_->readPos.load(std::memory_order_relaxed) != header_->writePos.load(std::memory_order_acquire);
+			const bool closed = Closed();
+			if (!waiting && (!closed || closeNoted)) continue;
+			closeNoted = closed;
+			if (!notified_.exchange(true, std::memory_order_acq_rel) && tsfn_.NonBlockingCall() != napi_ok) {
+				notified_.store(false, std::memory_order_release);
+			}
+		}
+	}
+
+	void WaitDoorbell() {
+#if defined(_WIN32)
+		WaitForSingleObject(doorbell_, kAudioRingPollMs);
+#elif defined(__APPLE__)
+		// No sem_timedwait on macOS
+		for (int ms = 0; ms < kAudioRingPollMs && !stop_.load(std::memory_order_relaxed); ms += 2) {
+			if (sem_trywait(doorbell_) == 0) return;
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+#else
+		timespec until;
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_nsec += kAudioRingPollMs * 1000000L;
+		if (until.tv_nsec >= 1000000000L) {
+			until.tv_sec += 1;
+			until.tv_nsec -= 1000000000L;
+		}
+		sem_timedwait(doorbell_, &until);
+#endif
+	}
+
+	bool Fail(const char* what, std::string* error) {
+		*error = std::string(what) + " " + name_;
+		Detach();
+		return false;
+	}
+
+#if defined(_WIN32)
+	static std::wstring Widen(const std::string& s) { return std::wstring(s.begin(), s.end()); } // names are ASCII
+
+	HANDLE mapping_ = nullptr;
+	HANDLE doorbell_ = nullptr;
+#else
+	sem_t* doorbell_ = nullptr;
+	size_t size_ = 0;
+#endif
+	std::string name_;
+	uint8_t* base_ = nullptr;
+	AudioRingHeader* header_ = nullptr;
+	uint32_t capacity_ = 0;
+	std::thread waiter_;
+	std::atomic<bool> stop_{false};
+	std::atomic<bool> notified_{false}; // a wake-up is queued or JS has not read since
+	RingReadyTsfn tsfn_;
+	napi_env env_ = nullptr; // set while tsfn_ is held
+};
+
+inline void DeliverRingReady(Napi::Env env, Napi::Function cb, AudioRingAttachment*, void*) {
+	if (env == nullptr || cb == nullptr) return;
+	cb.Call({});
+}
+
+class AudioRingAttachments {
+public:
+	uint32_t Add(std::unique_ptr<AudioRingAttachment> attachment) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		const uint32_t id = ++lastId_;
+		attachments_[id] = std::move(attachment);
+		return id;
+	}
+
+	AudioRingAttachment* Find(uint32_t id) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = attachments_.find(id);
+		return it != attachments_.end() ? it->second.get() : nullptr;
+	}
+
+	// Attachments are read and detached on the JS thread, so the pointer Find
+	// returned stays good for the call that asked.
+	bool Remove(uint32_t id) {
+		std::unique_ptr<AudioRingAttachment> gone;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = attachments_.find(id);
+			if (it == attachments_.end()) return false;
+			gone = std::move(it->second);
+			attachments_.erase(it);
+		}
+		return true; // joins the waiter outside the lock
+	}
+
+	void RemoveEnv(napi_env env) {
+		std::vector<std::unique_ptr<AudioRingAttachment>> gone;
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (auto it = attachments_.begin(); it != attachments_.end();) {
+			if (it->second->Env() != env) {
+				++it;
+				continue;
+			}
+			gone.push_back(std::move(it->second));
+			it = attachments_.erase(it);
+		}
+	}
+
+private:
+	std::mutex mutex_;
+	uint32_t lastId_ = 0;
+	std::unordered_map<uint32_t, std::unique_ptr<AudioRingAttachment>> attachments_;
+};
+
+inline AudioRingAttachments& AttachedAudioRings() {
+	static AudioRingAttachments attachments;
+	return attachments;
+}
+
+inline void DetachEnvAudioRings(napi_env env) {
+	AttachedAudioRings().RemoveEnv(env);
+}
+
+// attachAudioRing(mapping, doorbell, onReady) -> id
+inline Napi::Value AttachAudioRing(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 3 || !info[0].IsString() || !info[1].IsString() || !info[2].IsFunction()) {
+		Napi::TypeError::New(env, "Ring mapping, doorbell and callback required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	auto attachment = std::make_unique<AudioRingAttachment>();
+	std::string error;
+	if (!attachment->Open(info[0].As<Napi::String>().Utf8Value(), info[1].As<Napi::String>().Utf8Value(), &error)) {
+		Napi::Error::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	RingReadyTsfn tsfn = RingReadyTsfn::New(env, info[2].As<Napi::Function>(), "AudioRingReady", 1, 1, attachment.get());
+	tsfn.Unref(env); // never keeps the process alive
+	attachment->Start(tsfn, env);
+	DetachAtTeardown<DetachEnvAudioRings>(env);
+	return Napi::Number::New(env, AttachedAudioRings().Add(std::move(attachment)));
+}
+
+// readAudioRing(id, maxRecords?) - up to maxRecords (default 256) waiting
+// records, copied out; pcm records as Int16Array, the rest as Buffer.
+inline Napi::Value ReadAudioRing(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsNumber()) {
+		Napi::TypeError::New(env, "Attachment id required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	AudioRingAttachment* attachment = AttachedAudioRings().Find(info[0].As<Napi::Number>().Uint32Value());
+	if (!attachment) {
+		Napi::Error::New(env, "No such audio ring attachment").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	uint32_t maxRecords = 256;
+	if (info.Length() > 1 && info[1].IsNumber()) {
+		const double n = info[1].As<Napi::Number>().DoubleValue();
+		if (!(n >= 1 && n <= 65536)) {
+			Napi::RangeError::New(env, "maxRecords is out of range").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		maxRecords = (uint32_t)n;
+	}
+	Napi::Array records = Napi::Array::New(env);
+	AudioRingRecord record;
+	std::vector<uint8_t> payload;
+	for (uint32_t i = 0; i < maxRecords && attachment->Next(&record, &payload); ++i) {
+		Napi::Object out = Napi::Object::New(env);
+		out.Set("kind", Napi::Number::New(env, record.kind));
+		out.Set("seq", Napi::Number::New(env, record.seq));
+		out.Set("timeMs", Napi::Number::New(env, record.timeMs));
+		if (record.kind == kAudioRingPcm) {
+			Napi::Int16Array pcm = Napi::Int16Array::New(env, payload.size() / sizeof(int16_t));
+			std::memcpy(pcm.Data(), payload.data(), pcm.ElementLength() * sizeof(int16_t));
+			out.Set("data", pcm);
+		} else {
+			out.Set("data", Napi::Buffer<uint8_t>::Copy(env, payload.data(), payload.size()));
+		}
+		records.Set(i, out);
+	}
+	Napi::Object result = Napi::Object::New(env);
+	result.Set("records", records);
+	result.Set("dropped", Napi::Number::New(env, attachment->Dropped()));
+	result.Set("closed", Napi::Boolean::New(env, attachment->Closed()));
+	return result;
+}
+
+inline Napi::Value DetachAudioRing(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsNumber()) {
+		Napi::TypeError::New(env, "Attachment id required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	return Napi::Boolean::New(env, AttachedAudioRings().Remove(info[0].As<Napi::Number>().Uint32Value()));
+}
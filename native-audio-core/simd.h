@@ -0,0 +1,155 @@
+#pragma once
+
+// Compile-time SIMD baseline and runtime CPU feature dispatch shared by the
+// audio kernels. x64 always has SSE2; AVX2 kernels are compiled per function
+// and only selected when the CPU and OS support them. The WebAssembly build
+// (wasm/) has SIMD128 as its baseline when compiled with -msimd128.
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AUDIO_CORE_SSE 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#define AUDIO_CORE_AVX2 1
+#define AUDIO_CORE_TARGET_AVX2
+#elif defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define AUDIO_CORE_AVX2 1
+#define AUDIO_CORE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+// MSVC on ARM64 (Windows on ARM) has NEON without defining __ARM_NEON
+#include <arm_neon.h>
+#define AUDIO_CORE_NEON 1
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define AUDIO_CORE_WASM_SIMD 1
+#endif
+
+// Accelerate (vDSP) kernels on macOS; binding.gyp defines AUDIO_CORE_ACCELERATE
+// unless built with use_accelerate=0.
+#if defined(__APPLE__) && defined(AUDIO_CORE_ACCELERATE)
+#include <Accelerate/Accelerate.h>
+#else
+#undef AUDIO_CORE_ACCELERATE
+#endif
+
+#if defined(AUDIO_CORE_NEON) && defined(__APPLE__)
+#include <sys/sysctl.h>
+#elif defined(AUDIO_CORE_NEON) && defined(__linux__) && defined(__aarch64__)
+#include <sys/auxv.h>
+#endif
+
+// Instruction sets the kernels dispatch on. Each kernel lists its variants in
+// an IsaKernels table and takes the best one the CPU has, detected once at
+// module load. AUDIO_CORE_ISA=<name> caps the choice (scalar, sse2, avx2,
+// avx512, neon, sve) to compare kernels in benchmarks; it can only lower it.
+enum class CpuIsa { Scalar, Sse2, Avx2, Avx512, Neon, Sve };
+constexpr int kCpuIsaCount = 6;
+
+inline const char* CpuIsaName(CpuIsa isa) {
+	static const char* const names[kCpuIsaCount] = { "scalar", "sse2", "avx2", "avx512", "neon", "sve" };
+	return names[(int)isa];
+}
+
+// Rank used by the override: the x64 and arm64 sets share one scale.
+inline int CpuIsaTier(CpuIsa isa) {
+	switch (isa) {
+	case CpuIsa::Scalar: return 0;
+	case CpuIsa::Sse2: case CpuIsa::Neon: return 1;
+	case CpuIsa::Avx2: case CpuIsa::Sve: return 2;
+	default: return 3;
+	}
+}
+
+struct CpuDispatch {
+	bool detected[kCpuIsaCount] = {}; // the CPU (and OS) support it
+	bool usable[kCpuIsaCount] = {};   // detected and within AUDIO_CORE_ISA
+	CpuIsa best = CpuIsa::Scalar;     // highest usable
+	const char* override = nullptr;   // AUDIO_CORE_ISA, when it names a set
+};
+
+inline CpuDispatch DetectCpu() {
+	CpuDispatch cpu;
+	bool* has = cpu.detected;
+	has[(int)CpuIsa::Scalar] = true;
+#if defined(AUDIO_CORE_SSE)
+	has[(int)CpuIsa::Sse2] = true;
+#endif
+#if defined(AUDIO_CORE_AVX2) && defined(_MSC_VER)
+	int r[4];
+	__cpuid(r, 0);
+	const int maxLeaf = r[0];
+	__cpuid(r, 1);
+	const bool osxsave = (r[2] & (1 << 27)) != 0;
+	const bool avx = (r[2] & (1 << 28)) != 0;
+	const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+	if (maxLeaf >= 7 && avx && (xcr0 & 6) == 6) {
+		__cpuidex(r, 7, 0);
+		has[(int)CpuIsa::Avx2] = (r[1] & (1 << 5)) != 0;
+		// AVX-512F, with the OS saving the opmask and upper ZMM state
+		has[(int)CpuIsa::Avx512] = (r[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+	}
+#elif defined(AUDIO_CORE_AVX2)
+	__builtin_cpu_init();
+	has[(int)CpuIsa::Avx2] = __builtin_cpu_supports("avx2");
+	has[(int)CpuIsa::Avx512] = __builtin_cpu_supports("avx512f");
+#endif
+#if defined(AUDIO_CORE_NEON)
+	has[(int)CpuIsa::Neon] = true;
+#if defined(__APPLE__)
+	int sve = 0;
+	size_t size = sizeof(sve);
+	has[(int)CpuIsa::Sve] = sysctlbyname("hw.optional.arm.FEAT_SVE", &sve, &size, nullptr, 0) == 0 && sve != 0;
+#elif defined(__linux__) && defined(__aarch64__)
+	has[(int)CpuIsa::Sve] = (getauxval(AT_HWCAP) & (1ul << 22)) != 0; // HWCAP_SVE
+#endif
+#endif
+
+	int cap = CpuIsaTier(CpuIsa::Avx512);
+	if (const char* env = std::getenv("AUDIO_CORE_ISA")) {
+		for (int i = 0; i < kCpuIsaCount; ++i) {
+			if (std::strcmp(env, CpuIsaName((CpuIsa)i)) != 0) continue;
+			cap = CpuIsaTier((CpuIsa)i);
+			cpu.override = CpuIsaName((CpuIsa)i);
+		}
+	}
+	for (int i = 0; i < kCpuIsaCount; ++i) {
+		cpu.usable[i] = has[i] && CpuIsaTier((CpuIsa)i) <= cap;
+		if (cpu.usable[i] && CpuIsaTier((CpuIsa)i) >= CpuIsaTier(cpu.best)) cpu.best = (CpuIsa)i;
+	}
+	return cpu;
+}
+
+// Detected on first use; the addons call it from Init.
+inline const CpuDispatch& Cpu() {
+	static const CpuDispatch cpu = DetectCpu();
+	return cpu;
+}
+
+inline bool CpuUses(CpuIsa isa) { return Cpu().usable[(int)isa]; }
+
+// One kernel's variants; unset entries are skipped.
+template <typename Fn>
+struct IsaKernels {
+	Fn variants[kCpuIsaCount] = {};
+
+	IsaKernels& With(CpuIsa isa, Fn fn) {
+		variants[(int)isa] = fn;
+		return *this;
+	}
+
+	// The highest-tier usable variant; *isa names it. The scalar one must be set.
+	Fn Pick(CpuIsa* isa = nullptr) const {
+		int chosen = (int)CpuIsa::Scalar;
+		for (int i = 0; i < kCpuIsaCount; ++i) {
+			if (variants[i] && CpuUses((CpuIsa)i) && CpuIsaTier((CpuIsa)i) > CpuIsaTier((CpuIsa)chosen)) chosen = i;
+		}
+		if (isa) *isa = (CpuIsa)chosen;
+		return variants[chosen];
+	}
+};
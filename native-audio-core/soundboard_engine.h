@@ -0,0 +1,635 @@
+#pragma once
+
+// Native soundboard: clips are decoded once (libavformat/libavcodec, on the
+// task pool) to 48 kHz stereo float and written to a cache file, which
+// is then memory-mapped; triggering a clip only arms a voice on the output
+// buses, so nothing is decoded or allocated on the playback path. A cache
+// file is reused while its source keeps the same size and mtime, so startup
+// only maps files. Decoding and probing need gyp variable use_avformat=1
+// (AUDIO_CORE_AVFORMAT); without it loadSoundClip() still maps clips cached by
+// an earlier build and rejects the rest.
+//
+//   probeSoundClip(path) -> Promise<{ durationMs, format, codec, sampleRate, channels }>
+//   loadSoundClip(id, path, { cacheDir }) -> Promise<{ frames, durationMs, cached }>
+//   unloadSoundClip(id) -> boolean
+//   playSoundClip(id, { gain? }) -> boolean (false with no output running)
+//   stopSoundClip(id?) / isSoundClipPlaying(id) -> boolean
+//   setSoundboardVolumes({ mic?, monitor? })
+//
+// The buses are rendered by the addon's output threads (startSoundboardOutput
+// in each addon, StartSoundboardOutputs below): kMicBus feeds the virtual-cable device, kMonitorBus the
+// default output so the user hears it too. Clips and voices are armed on the
+// JS thread only; the render thread hands finished voices back by state.
+
+#include <napi.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "addon_instance.h"
+#include "addon_log.h"
+#include "async_query.h"
+#include "capture_options.h"
+#include "mapped_file.h"
+#include "render_source.h"
+
+#if defined(AUDIO_CORE_AVFORMAT)
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libswresample/swresample.h>
+}
+#endif
+
+constexpr uint32_t kSoundboardRate = 48000;
+constexpr uint32_t kSoundboardChannels = 2;
+constexpr size_t kSoundboardVoices = 32;       // per bus
+constexpr uint32_t kSoundboardMaxSeconds = 600; // longest clip we decode (~230 MB cached)
+
+// Header of a cache file; interleaved float PCM follows at byte 64.
+struct ClipCacheHeader {
+	char magic[4];      // "WSBC"
+	uint32_t version;
+	uint32_t sampleRate;
+	uint32_t channels;
+	uint64_t frames;
+	uint64_t sourceSize; // FileStamp of the decoded source
+	int64_t sourceMtime;
+	uint8_t reserved[24];
+};
+static_assert(sizeof(ClipCacheHeader) == 64, "cache header must keep the PCM 64-byte aligned");
+
+constexpr uint32_t kClipCacheVersion = 1;
+
+// cacheDir/<FNV-1a of the source path>-<rate>.f32
+inline std::string ClipCachePath(const std::string& cacheDir, const std::string& source, uint32_t rate) {
+	uint64_t h = 1469598103934665603ull;
+	for (unsigned char c : source) h = (h ^ c) * 1099511628211ull;
+	char name[48];
+	snprintf(name, sizeof(name), "%016llx-%u.f32", (unsigned long long)h, rate);
+	std::string path = cacheDir;
+	if (!path.empty() && path.back() != '/' && path.back() != '\\') path += '/';
+	return path + name;
+}
+
+// A mapped cache file.
+class SoundClip {
+public:
+	// False (and no error) when the file is missing or stale, so the caller decodes.
+	bool Open(const std::string& cachePath, const FileStamp& source, std::string* error) {
+		std::string ignored;
+		if (!file_.Open(cachePath, &ignored)) return false;
+		ClipCacheHeader h;
+		if (file_.Size() < sizeof(h)) return Stale();
+		memcpy(&h, file_.Data(), sizeof(h));
+		if (memcmp(h.magic, "WSBC", 4) != 0 || h.version != kClipCacheVersion || h.sampleRate != kSoundboardRate ||
+		    h.channels != kSoundboardChannels || h.sourceSize != source.size || h.sourceMtime != source.mtime) {
+			return Stale();
+		}
+		if (file_.Size() < sizeof(h) + h.frames * kSoundboardChannels * sizeof(float)) {
+			*error = "truncated sound cache " + cachePath;
+			return Stale();
+		}
+		pcm_ = reinterpret_cast<const float*>(file_.Data() + sizeof(h));
+		frames_ = h.frames;
+		return true;
+	}
+
+	const float* Pcm() const { return pcm_; }
+	uint64_t Frames() const { return frames_; }
+	double DurationMs() const { return (double)frames_ * 1000.0 / kSoundboardRate; }
+
+private:
+	bool Stale() {
+		file_.Close();
+		return false;
+	}
+
+	MappedFile file_;
+	const float* pcm_ = nullptr;
+	uint64_t frames_ = 0;
+};
+
+struct SoundClipInfo {
+	double durationMs = 0;
+	std::string format; // container, e.g. "mp3", "ogg", "mov,mp4,m4a,3gp,3g2,mj2"
+	std::string codec;
+	uint32_t sampleRate = 0;
+	uint32_t channels = 0;
+};
+
+#if defined(AUDIO_CORE_AVFORMAT)
+
+// Demuxer and decoder for the best audio stream of a file.
+class ClipSource {
+public:
+	ClipSource() = default;
+	ClipSource(const ClipSource&) = delete;
+	ClipSource& operator=(const ClipSource&) = delete;
+	~ClipSource() {
+		swr_free(&swr_);
+		avcodec_free_context(&dec_);
+		avformat_close_input(&fmt_);
+	}
+
+	bool Open(const std::string& path, std::string* error) {
+		if (avformat_open_input(&fmt_, path.c_str(), nullptr, nullptr) < 0) return Fail("could not open ", path, error);
+		if (avformat_find_stream_info(fmt_, nullptr) < 0) return Fail("no stream info in ", path, error);
+		const AVCodec* codec = nullptr;
+		stream_ = av_find_best_stream(fmt_, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+		if (stream_ < 0 || !codec) return Fail("no decodable audio stream in ", path, error);
+		const AVStream* st = fmt_->streams[stream_];
+		info_.format = fmt_->iformat->name;
+		info_.codec = codec->name;
+		info_.sampleRate = (uint32_t)st->codecpar->sample_rate;
+		info_.channels = (uint32_t)st->codecpar->ch_layout.nb_channels;
+		if (fmt_->duration > 0) info_.durationMs = (double)fmt_->duration * 1000.0 / AV_TIME_BASE;
+		else if (st->duration > 0) info_.durationMs = (double)st->duration * av_q2d(st->time_base) * 1000.0;
+		dec_ = avcodec_alloc_context3(codec);
+		if (!dec_ || avcodec_parameters_to_context(dec_, st->codecpar) < 0 || avcodec_open2(dec_, codec, nullptr) < 0) {
+			return Fail("could not open the decoder for ", path, error);
+		}
+		return true;
+	}
+
+	const SoundClipInfo& Info() const { return info_; }
+
+	// Decodes the whole stream to kSoundboardRate stereo float, one fwrite per
+	// decoded frame; *frames counts what was written.
+	bool DecodeTo(FILE* out, uint64_t* frames, std::string* error) {
+		AVPacket* pkt = av_packet_alloc();
+		AVFrame* frame = av_frame_alloc();
+		bool ok = pkt && frame;
+		while (ok && av_read_frame(fmt_, pkt) >= 0) {
+			if (pkt->stream_index == stream_ && avcodec_send_packet(dec_, pkt) == 0) ok = Drain(frame, out, frames, error);
+			av_packet_unref(pkt);
+		}
+		if (ok) {
+			avcodec_send_packet(dec_, nullptr);
+			ok = Drain(frame, out, frames, error) && (!swr_ || Convert(nullptr, 0, out, frames, error));
+		}
+		av_packet_free(&pkt);
+		av_frame_free(&frame);
+		return ok;
+	}
+
+private:
+	bool Drain(AVFrame* frame, FILE* out, uint64_t* frames, std::string* error) {
+		while (avcodec_receive_frame(dec_, frame) == 0) {
+			const bool ok = (swr_ || InitResampler(frame, error)) &&
+			                Convert(const_cast<const uint8_t**>(frame->extended_data), frame->nb_samples, out, frames, error);
+			av_frame_unref(frame);
+			if (!ok) return false;
+		}
+		return true;
+	}
+
+	bool InitResampler(const AVFrame* frame, std::string* error) {
+		AVChannelLayout in;
+		if (frame->ch_layout.order == AV_CHANNEL_ORDER_UNSPEC) av_channel_layout_default(&in, frame->ch_layout.nb_channels);
+		else av_channel_layout_copy(&in, &frame->ch_layout);
+		AVChannelLayout stereo = AV_CHANNEL_LAYOUT_STEREO;
+		const int r = swr_alloc_set_opts2(&swr_, &stereo, AV_SAMPLE_FMT_FLT, (int)kSoundboardRate, &in,
+		                                  (AVSampleFormat)frame->format, frame->sample_rate, 0, nullptr);
+		av_channel_layout_uninit(&in);
+		if (r < 0 || swr_init(swr_) < 0) {
+			*error = "could not set up the resampler";
+			return false;
+		}
+		return true;
+	}
+
+	bool Convert(const uint8_t** in, int n, FILE* out, uint64_t* frames, std::string* error) {
+		const int cap = swr_get_out_samples(swr_, n);
+		if (cap <= 0) return true;
+		buffer_.resize((size_t)cap * kSoundboardChannels);
+		uint8_t* dst = reinterpret_cast<uint8_t*>(buffer_.data());
+		const int got = swr_convert(swr_, &dst, cap, in, n);
+		if (got < 0) {
+			*error = "resampling failed";
+			return false;
+		}
+		if (fwrite(buffer_.data(), sizeof(float) * kSoundboardChannels, (size_t)got, out) != (size_t)got) {
+			*error = "could not write the sound cache";
+			return false;
+		}
+		*frames += (uint64_t)got;
+		if (*frames > (uint64_t)kSoundboardMaxSeconds * kSoundboardRate) {
+			*error = "clip is longer than the soundboard limit";
+			return false;
+		}
+		return true;
+	}
+
+	bool Fail(const char* what, const std::string& path, std::string* error) {
+		*error = what + path;
+		return false;
+	}
+
+	AVFormatContext* fmt_ = nullptr;
+	AVCodecContext* dec_ = nullptr;
+	SwrContext* swr_ = nullptr;
+	int stream_ = -1;
+	SoundClipInfo info_;
+	std::vector<float> buffer_;
+};
+
+// Decodes source into cachePath via a temp file, so an interrupted decode
+// never leaves a cache that validates.
+inline bool DecodeClipToCache(const std::string& source, const FileStamp& stamp, const std::string& cachePath,
+                              std::string* error) {
+	ClipSource clip;
+	if (!clip.Open(source, error)) return false;
+	const std::string temp = cachePath + ".tmp";
+	FILE* out = OpenFileUtf8(temp, "wb");
+	if (!out) {
+		*error = "could not create " + temp;
+		return false;
+	}
+	ClipCacheHeader h = {};
+	memcpy(h.magic, "WSBC", 4);
+	h.version = kClipCacheVersion;
+	h.sampleRate = kSoundboardRate;
+	h.channels = kSoundboardChannels;
+	h.sourceSize = stamp.size;
+	h.sourceMtime = stamp.mtime;
+	bool ok = fwrite(&h, sizeof(h), 1, out) == 1 && clip.DecodeTo(out, &h.frames, error);
+	if (ok && h.frames == 0) {
+		*error = "no audio decoded from " + source;
+		ok = false;
+	}
+	// Header last: frames is only known now
+	if (ok) ok = fseek(out, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, out) == 1;
+	ok = fclose(out) == 0 && ok;
+	if (ok && !MoveFileReplacing(temp, cachePath)) {
+		*error = "could not move the sound cache into place";
+		ok = false;
+	}
+	if (!ok) RemoveFile(temp);
+	return ok;
+}
+
+#endif
+
+// One mixer input. state moves Free -> Armed (JS) -> Playing (render) ->
+// Done (render) -> Free (JS, dropping its clip reference).
+struct SoundVoice {
+	enum State { Free, Armed, Playing, Done };
+	std::atomic<int> state{Free};
+	std::atomic<bool> stop{false};
+	const float* pcm = nullptr;
+	uint64_t frames = 0;
+	uint64_t at = 0;            // render thread
+	uint32_t fade = 0;          // frames of fade-out left once stopping (render thread)
+	float gain = 1.0f;
+	std::shared_ptr<const SoundClip> clip; // JS thread: keeps the mapping alive while the voice plays
+};
+
+// A set of voices rendered by one output device.
+class SoundboardBus : public RenderSource {
+public:
+	static constexpr uint32_t kFadeFrames = kSoundboardRate / 200; // 5 ms, no click on stop
+
+	// JS thread. The output thread attaches itself before rendering and
+	// detaches after its last Render(); voices only arm while attached.
+	void Attach() override { attached_.store(true, std::memory_order_release); }
+	void Detach() override {
+		attached_.store(false, std::memory_order_release);
+		for (SoundVoice& v : voices_) {
+			v.clip.reset();
+			v.stop.store(false, std::memory_order_relaxed);
+			v.state.store(SoundVoice::Free, std::memory_order_relaxed);
+		}
+	}
+	bool Attached() const { return attached_.load(std::memory_order_acquire); }
+	void SetGain(float gain) { gain_.store(gain, std::memory_order_relaxed); }
+
+	bool Trigger(const std::shared_ptr<const SoundClip>& clip, float gain) {
+		if (!Attached()) return false;
+		Reap();
+		for (SoundVoice& v : voices_) {
+			if (v.state.load(std::memory_order_relaxed) != SoundVoice::Free) continue;
+			v.clip = clip;
+			v.pcm = clip->Pcm();
+			v.frames = clip->Frames();
+			v.at = 0;
+			v.fade = 0;
+			v.gain = gain;
+			v.stop.store(false, std::memory_order_relaxed);
+			v.state.store(SoundVoice::Armed, std::memory_order_release);
+			return true;
+		}
+		return false; // all voices busy
+	}
+
+	// Stops every voice of clip, or all voices when clip is null.
+	void Stop(const SoundClip* clip) {
+		for (SoundVoice& v : voices_) {
+			const int s = v.state.load(std::memory_order_acquire);
+			if ((s == SoundVoice::Armed || s == SoundVoice::Playing) && (!clip || v.clip.get() == clip)) {
+				v.stop.store(true, std::memory_order_release);
+			}
+		}
+	}
+
+	bool Playing(const SoundClip* clip) {
+		Reap();
+		for (SoundVoice& v : voices_) {
+			if (v.state.load(std::memory_order_acquire) != SoundVoice::Free && v.clip.get() == clip) return true;
+		}
+		return false;
+	}
+
+	// Render thread: mixes all voices into out (interleaved); clip L/R go to
+	// the first two channels, a mono device gets their average.
+	void Render(float* out, size_t frames, uint32_t channels) override {
+		memset(out, 0, frames * channels * sizeof(float));
+		const float busGain = gain_.load(std::memory_order_relaxed);
+		for (SoundVoice& v : voices_) {
+			int s = v.state.load(std::memory_order_acquire);
+			if (s == SoundVoice::Armed) {
+				v.state.store(SoundVoice::Playing, std::memory_order_relaxed);
+				s = SoundVoice::Playing;
+			}
+			if (s != SoundVoice::Playing) continue;
+			if (v.fade == 0 && v.stop.load(std::memory_order_acquire)) v.fade = kFadeFrames;
+			const float g = v.gain * busGain;
+			size_t n = (size_t)(v.frames - v.at < frames ? v.frames - v.at : frames);
+			if (v.fade > 0 && n > v.fade) n = v.fade;
+			const float* src = v.pcm + v.at * kSoundboardChannels;
+			for (size_t i = 0; i < n; ++i) {
+				const float gi = v.fade > 0 ? g * (float)(v.fade - i) / kFadeFrames : g;
+				const float l = src[2 * i] * gi, r = src[2 * i + 1] * gi;
+				float* o = out + i * channels;
+				if (channels == 1) {
+					o[0] += 0.5f * (l + r);
+				} else {
+					o[0] += l;
+					o[1] += r;
+				}
+			}
+			v.at += n;
+			if (v.fade > 0) v.fade = v.fade > n ? v.fade - (uint32_t)n : 0;
+			if (v.at >= v.frames || (v.fade == 0 && v.stop.load(std::memory_order_relaxed))) {
+				v.state.store(SoundVoice::Done, std::memory_order_release);
+			}
+		}
+	}
+
+private:
+	// JS thread: returns finished voices to the pool.
+	void Reap() {
+		for (SoundVoice& v : voices_) {
+			if (v.state.load(std::memory_order_acquire) != SoundVoice::Done) continue;
+			v.clip.reset();
+			v.state.store(SoundVoice::Free, std::memory_order_relaxed);
+		}
+	}
+
+	SoundVoice voices_[kSoundboardVoices];
+	std::atomic<bool> attached_{false};
+	std::atomic<float> gain_{1.0f};
+};
+
+enum SoundboardBusId { kMicBus = 0, kMonitorBus = 1, kSoundboardBuses = 2 };
+
+struct SoundboardState {
+	std::map<std::string, std::shared_ptr<const SoundClip>> clips; // JS thread
+	SoundboardBus buses[kSoundboardBuses];
+};
+
+// One soundboard per environment (addon_instance.h): clips are armed from its
+// JS thread and its buses feed that environment's outputs.
+inline SoundboardState& Soundboard(Napi::Env env) {
+	return PerEnv<SoundboardState>(env);
+}
+
+inline bool ReadClipIdArg(const Napi::CallbackInfo& info, std::string* id) {
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(info.Env(), "Clip id string required").ThrowAsJavaScriptException();
+		return false;
+	}
+	*id = info[0].As<Napi::String>().Utf8Value();
+	return true;
+}
+
+// probeSoundClip(path) -> Promise<{ durationMs, format, codec, sampleRate, channels }>
+inline Napi::Value ProbeSoundClip(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "File path required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	struct Probed {
+		SoundClipInfo info;
+		std::string error;
+	};
+	return QueueQuery(env, "ProbeSoundClip",
+		[path = info[0].As<Napi::String>().Utf8Value()]() {
+			Probed result;
+#if defined(AUDIO_CORE_AVFORMAT)
+			ClipSource source;
+			if (source.Open(path, &result.error)) result.info = source.Info();
+#else
+			(void)path;
+			result.error = "Clip probing is not built in (use_avformat=0)";
+#endif
+			return result;
+		},
+		[](Napi::Env env, Probed& result) -> Napi::Value {
+			if (!result.error.empty()) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("durationMs", Napi::Number::New(env, result.info.durationMs));
+			o.Set("format", Napi::String::New(env, result.info.format));
+			o.Set("codec", Napi::String::New(env, result.info.codec));
+			o.Set("sampleRate", Napi::Number::New(env, result.info.sampleRate));
+			o.Set("channels", Napi::Number::New(env, result.info.channels));
+			return o;
+		});
+}
+
+// loadSoundClip(id, path, { cacheDir }) -> Promise<{ frames, durationMs, cached }>
+inline Napi::Value LoadSoundClip(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::string id;
+	if (!ReadClipIdArg(info, &id)) return env.Null();
+	if (info.Length() < 3 || !info[1].IsString() || !info[2].IsObject() ||
+	    !info[2].As<Napi::Object>().Get("cacheDir").IsString()) {
+		Napi::TypeError::New(env, "Expected (id, path, { cacheDir })").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const std::string path = info[1].As<Napi::String>().Utf8Value();
+	const std::string cacheDir = info[2].As<Napi::Object>().Get("cacheDir").As<Napi::String>().Utf8Value();
+
+	struct Loaded {
+		std::shared_ptr<SoundClip> clip;
+		bool cached = false;
+		std::string error;
+	};
+	return QueueQuery(env, "LoadSoundClip",
+		[path, cacheDir]() {
+			Loaded result;
+			FileStamp stamp;
+			if (!StatFile(path, &stamp)) {
+				result.error = "Sound file not found: " + path;
+				return result;
+			}
+			const std::string cachePath = ClipCachePath(cacheDir, path, kSoundboardRate);
+			auto clip = std::make_shared<SoundClip>();
+			result.cached = clip->Open(cachePath, stamp, &result.error);
+			if (!result.cached) {
+#if defined(AUDIO_CORE_AVFORMAT)
+				result.error.clear();
+				if (!DecodeClipToCache(path, stamp, cachePath, &result.error)) return result;
+				if (!clip->Open(cachePath, stamp, &result.error)) {
+					if (result.error.empty()) result.error = "could not map " + cachePath;
+					return result;
+				}
+#else
+				result.error = "Clip decoding is not built in (use_avformat=0)";
+				return result;
+#endif
+			}
+			result.clip = std::move(clip);
+			return result;
+		},
+		[id](Napi::Env env, Loaded& result) -> Napi::Value {
+			if (!result.clip) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Soundboard(env).clips[id] = result.clip; // voices still playing a replaced clip keep their own reference
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("frames", Napi::Number::New(env, (double)result.clip->Frames()));
+			o.Set("durationMs", Napi::Number::New(env, result.clip->DurationMs()));
+			o.Set("cached", Napi::Boolean::New(env, result.cached));
+			return o;
+		});
+}
+
+// unloadSoundClip(id) -> boolean; a clip that is still playing finishes first.
+inline Napi::Value UnloadSoundClip(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::string id;
+	if (!ReadClipIdArg(info, &id)) return env.Null();
+	return Napi::Boolean::New(env, Soundboard(env).clips.erase(id) > 0);
+}
+
+// playSoundClip(id, { gain? }) -> boolean
+inline Napi::Value PlaySoundClip(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::string id;
+	if (!ReadClipIdArg(info, &id)) return env.Null();
+	float gain = 1.0f;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		std::string error;
+		if (!ReadFloatOption(info[1].As<Napi::Object>(), "gain", 0.0f, 4.0f, &gain, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+	SoundboardState& board = Soundboard(env);
+	auto it = board.clips.find(id);
+	if (it == board.clips.end()) return Napi::Boolean::New(env, false);
+	bool played = false;
+	for (SoundboardBus& bus : board.buses) played = bus.Trigger(it->second, gain) || played;
+	return Napi::Boolean::New(env, played);
+}
+
+// stopSoundClip(id?) stops one clip, or everything without an id.
+inline Napi::Value StopSoundClip(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	SoundboardState& board = Soundboard(env);
+	const SoundClip* clip = nullptr;
+	if (info.Length() > 0 && info[0].IsString()) {
+		auto it = board.clips.find(info[0].As<Napi::String>().Utf8Value());
+		if (it == board.clips.end()) return env.Undefined();
+		clip = it->second.get();
+	}
+	for (SoundboardBus& bus : board.buses) bus.Stop(clip);
+	return env.Undefined();
+}
+
+inline Napi::Value IsSoundClipPlaying(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::string id;
+	if (!ReadClipIdArg(info, &id)) return env.Null();
+	SoundboardState& board = Soundboard(env);
+	auto it = board.clips.find(id);
+	bool playing = false;
+	if (it != board.clips.end()) {
+		for (SoundboardBus& bus : board.buses) playing = bus.Playing(it->second.get()) || playing;
+	}
+	return Napi::Boolean::New(env, playing);
+}
+
+// setSoundboardVolumes({ mic?, monitor? }), linear gains 0..2
+inline Napi::Value SetSoundboardVolumes(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsObject()) {
+		Napi::TypeError::New(env, "Volumes object required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Object obj = info[0].As<Napi::Object>();
+	float mic = -1.0f, monitor = -1.0f;
+	std::string error;
+	if (!ReadFloatOption(obj, "mic", 0.0f, 2.0f, &mic, &error) ||
+	    !ReadFloatOption(obj, "monitor", 0.0f, 2.0f, &monitor, &error)) {
+		Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	if (mic >= 0.0f) Soundboard(env).buses[kMicBus].SetGain(mic);
+	if (monitor >= 0.0f) Soundboard(env).buses[kMonitorBus].SetGain(monitor);
+	return env.Undefined();
+}
+
+// Body of each addon's startSoundboardOutput({ micDevice?, monitor? }) ->
+// { mic, monitor } (device names, null when not open). Renders the mic bus on
+// the first output device whose name contains micDevice and, unless monitor
+// is false, the monitor bus on the default output; running outputs restart.
+// Output is the addon's SoundboardOutput (Start/Stop on the JS thread).
+template <class Output>
+Napi::Value StartSoundboardOutputs(const Napi::CallbackInfo& info, Output (&outputs)[kSoundboardBuses],
+                                   const char* defaultMicDevice) {
+	Napi::Env env = info.Env();
+	std::string micDevice = defaultMicDevice;
+	bool monitor = true;
+	if (info.Length() > 0 && info[0].IsObject()) {
+		Napi::Object obj = info[0].As<Napi::Object>();
+		if (obj.Get("micDevice").IsString()) micDevice = obj.Get("micDevice").As<Napi::String>().Utf8Value();
+		if (obj.Get("monitor").IsBoolean()) monitor = obj.Get("monitor").As<Napi::Boolean>().Value();
+	}
+	for (char& c : micDevice) {
+		if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+	}
+	Napi::Object result = Napi::Object::New(env);
+	const char* keys[kSoundboardBuses] = { "mic", "monitor" };
+	const std::string needles[kSoundboardBuses] = { micDevice, std::string() };
+	for (int bus = 0; bus < kSoundboardBuses; ++bus) {
+		outputs[bus].Stop();
+		std::string name, error;
+		// A render session mixing the mic bus (render_session.h) already plays it
+		if (Soundboard(env).buses[bus].Attached()) {
+			AddonLog(LogLevel::Info, "Soundboard %s bus plays through a render session", keys[bus]);
+			result.Set(keys[bus], env.Null());
+			continue;
+		}
+		if ((bus == kMicBus || monitor) && outputs[bus].Start(needles[bus], &Soundboard(env).buses[bus], &name, &error)) {
+			result.Set(keys[bus], Napi::String::New(env, name));
+		} else {
+			if (!error.empty()) AddonLog(LogLevel::Warn, "Soundboard %s output unavailable: %s", keys[bus], error.c_str());
+			result.Set(keys[bus], env.Null());
+		}
+	}
+	return result;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+// Hot-swapping a capture's source (CaptureSession.switchSource) without
+// touching its back end. The new source's stream comes up beside the old one
+// and queues its 16 kHz blocks here; the old stream's thread, block by block,
+// fades from its own samples to the queued ones over kFadeMs and then lets
+// go. From there the new stream's thread runs the capture, starting with what
+// queued in the meantime, so the gate, noise floor, VAD, chunker and any
+// utterance in progress carry on with no gap and nothing to re-converge.
+//
+//   Idle -> Pending  (Begin: the new stream queues)
+//        -> Fading   (the old thread has a block's worth queued and mixes)
+//        -> Done     (the old thread let go; the queue is the new thread's)
+//        -> Idle     (Settle, once the new thread has drained the queue)
+//
+// A loopback whose source plays nothing sends no packets, and a fade from
+// nothing is a cut: when kTakeoverMs queue with the old stream still Pending,
+// Push moves to Done itself (TakeOver; the owner also does when a new stream
+// that is open stays silent). Failed (the new stream could not open) leaves
+// the old stream as it was.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class SourceSwitch {
+public:
+	enum class State { Idle, Pending, Fading, Done, Failed };
+
+	static constexpr uint32_t kRate = 16000;
+	static constexpr uint32_t kFadeMs = 20;
+	static constexpr uint32_t kTakeoverMs = 120; // queued with the old stream silent
+	static constexpr uint32_t kQueueMs = 1000;   // the most the new stream may run ahead
+
+	// JS thread, with the state Idle (or Failed) and no stream on the queue.
+	void Begin() {
+		queue_.resize((size_t)kQueueMs * kRate / 1000);
+		written_.store(0, std::memory_order_relaxed);
+		read_.store(0, std::memory_order_relaxed);
+		endNs_.store(0, std::memory_order_relaxed);
+		faded_ = 0;
+		state_.store(State::Pending, std::memory_order_release);
+	}
+
+	// New stream's thread: it failed before the handoff.
+	void Fail() {
+		State expected = State::Pending;
+		if (!state_.compare_exchange_strong(expected, State::Failed, std::memory_order_acq_rel) && expected == State::Fading) {
+			state_.compare_exchange_strong(expected, State::Failed, std::memory_order_acq_rel);
+		}
+	}
+
+	// JS thread: an abandoned switch, once neither stream touches the queue.
+	void Abandon() { state_.store(State::Idle, std::memory_order_release); }
+
+	State Current() const { return state_.load(std::memory_order_acquire); }
+
+	// New stream's thread: n samples, the first captured at timeNs. What the
+	// queue has no room for is dropped and counted.
+	void Push(const float* samples, size_t n, uint64_t timeNs) {
+		const State state = Current();
+		if (state != State::Pending && state != State::Fading && state != State::Done) return;
+		const uint64_t written = written_.load(std::memory_order_relaxed);
+		const size_t room = queue_.size() - (size_t)(written - read_.load(std::memory_order_acquire));
+		const size_t take = std::min(n, room);
+		for (size_t i = 0; i < take; ++i) queue_[(size_t)((written + i) % queue_.size())] = samples[i];
+		if (take < n) dropped_.fetch_add(n - take, std::memory_order_relaxed);
+		endNs_.store(timeNs + (uint64_t)take * 1000000000ull / kRate, std::memory_order_relaxed);
+		written_.store(written + take, std::memory_order_release);
+		if (state == State::Pending && Queued() >= (size_t)kTakeoverMs * kRate / 1000) TakeOver();
+	}
+
+	// Any thread: the old stream has sent nothing to fade from, so the new one
+	// takes over as it is. False when the old thread started fading first.
+	bool TakeOver() {
+		State pending = State::Pending;
+		if (!state_.compare_exchange_strong(pending, State::Done, std::memory_order_acq_rel)) return false;
+		takeovers_.fetch_add(1, std::memory_order_relaxed);
+		switches_.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Old stream's thread, on a block it may write (its own copy). Returns
+	// false once the block is no longer the old stream's to deliver.
+	bool Mix(float* samples, size_t n) {
+		State state = Current();
+		if (state == State::Done) return false;
+		if (state != State::Pending && state != State::Fading) return true;
+		if (state == State::Pending) {
+			if (Queued() < n) return true; // the new stream is not there yet
+			if (!state_.compare_exchange_strong(state, State::Fading, std::memory_order_acq_rel)) return state != State::Done;
+		}
+		const size_t fade = (size_t)kFadeMs * kRate / 1000;
+		const size_t take = std::min(n, Queued());
+		const uint64_t read = read_.load(std::memory_order_relaxed);
+		for (size_t i = 0; i < take; ++i) {
+			const float next = queue_[(size_t)((read + i) % queue_.size())];
+			const float g = faded_ + i < fade ? (float)(faded_ + i + 1) / (float)fade : 1.0f;
+			samples[i] += g * (next - samples[i]);
+		}
+		read_.store(read + take, std::memory_order_release);
+		faded_ = std::min(fade, faded_ + take);
+		// A block the queue could not cover keeps the old stream's tail, and one more block
+		if (faded_ == fade && take == n) {
+			state_.store(State::Done, std::memory_order_release);
+			switches_.fetch_add(1, std::memory_order_relaxed);
+		}
+		return true;
+	}
+
+	// New stream's thread, once it runs the capture: up to max queued samples,
+	// the first captured at *timeNs. Returns how many.
+	size_t Drain(float* out, size_t max, uint64_t* timeNs) {
+		const size_t n = std::min(max, Queued());
+		const uint64_t read = read_.load(std::memory_order_relaxed);
+		const uint64_t endNs = endNs_.load(std::memory_order_relaxed);
+		*timeNs = endNs - std::min<uint64_t>(endNs, (uint64_t)Queued() * 1000000000ull / kRate);
+		for (size_t i = 0; i < n; ++i) out[i] = queue_[(size_t)((read + i) % queue_.size())];
+		read_.store(read + n, std::memory_order_release);
+		return n;
+	}
+
+	// New stream's thread: the queue is drained and the capture is its own.
+	void Settle() { state_.store(State::Idle, std::memory_order_release); }
+
+	size_t Queued() const {
+		return (size_t)(written_.load(std::memory_order_acquire) - read_.load(std::memory_order_acquire));
+	}
+
+	uint64_t Switches() const { return switches_.load(std::memory_order_relaxed); }
+	// Of those, the ones taken over from a silent old stream, with no fade
+	uint64_t Takeovers() const { return takeovers_.load(std::memory_order_relaxed); }
+	uint64_t DroppedSamples() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+	std::vector<float> queue_;
+	std::atomic<uint64_t> written_{0}; // new stream's thread
+	std::atomic<uint64_t> read_{0};    // old stream's thread while fading, then the new one's
+	std::atomic<uint64_t> endNs_{0};   // capture time just past the last queued sample
+	std::atomic<State> state_{State::Idle};
+	size_t faded_ = 0; // old stream's thread
+	std::atomic<uint64_t> switches_{0};
+	std::atomic<uint64_t> takeovers_{0};
+	std::atomic<uint64_t> dropped_{0};
+};
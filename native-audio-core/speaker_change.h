@@ -0,0 +1,270 @@
+#pragma once
+
+// Speaker-change detection (capture option "speaker") on the capture's
+// shared log-mel frames (log_mel.h), so a meeting's chunks end at turn
+// boundaries instead of mixing two voices, and each chunk names the speaker
+// cluster it belongs to for per-speaker translation and TTS voices.
+//
+// Speech frames (the VAD's) fill a window of kWindowFrames; every kHopFrames
+// the window is pooled (pooled_mel.h) into an embedding and compared by
+// cosine distance with the current turn's centroid. Two windows in a row
+// farther than the threshold end the turn about halfway into the first of
+// them, a second or two back: the writer then cuts the open chunk
+// there (UtteranceChunker::CutBack()). Turns join the nearest of up to
+// kMaxSpeakers clusters, or start a new one. A trained d-vector model (option
+// speaker.model) maps the statistics to its embedding; without one the
+// embedding is the window's long-term spectrum shape (every band's mean
+// level relative to the window's), which tells voices of different pitch
+// and timbre apart but not two similar ones.
+//
+// Model file, little-endian: "SPK1", three uint32 (inputs, which must be
+// kPooledMelFeatures; hidden units, 0 for none; embedding dimensions), a
+// float32 change threshold (cosine distance), then the network's weights
+// with one output per dimension (PooledMelNet).
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "pooled_mel.h"
+
+struct SpeakerModel {
+	PooledMelNet net;
+	float threshold = 0.3f;
+
+	// JS thread (option parsing). Null with *error set when the file is not a
+	// model this detector can run.
+	static std::shared_ptr<const SpeakerModel> Load(const std::string& path, std::string* error) {
+		MappedFile file;
+		if (!file.Open(path, error)) {
+			*error = "Speaker model: " + *error;
+			return nullptr;
+		}
+		const uint8_t* p = file.Data();
+		const uint8_t* end = p + file.Size();
+		auto fail = [&](const char* what) {
+			*error = std::string("Speaker model ") + path + ": " + what;
+			return nullptr;
+		};
+		auto u32 = [&]() {
+			const uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+			p += 4;
+			return v;
+		};
+		if (end - p < 4 + 4 * 4 || memcmp(p, "SPK1", 4) != 0) return fail("not a SPK1 file");
+		p += 4;
+		const uint32_t inputs = u32(), hidden = u32(), dims = u32();
+		if (inputs != kPooledMelFeatures || hidden > 1024 || dims < 2 || dims > 1024) return fail("unsupported dimensions");
+		auto model = std::make_shared<SpeakerModel>();
+		memcpy(&model->threshold, p, 4);
+		p += 4;
+		if (!(model->threshold > 0.0f && model->threshold < 2.0f)) return fail("threshold out of range");
+		if (!model->net.Read(&p, end, hidden, dims)) return fail("truncated weights");
+		if (p != end) return fail("trailing bytes after the weights");
+		return model;
+	}
+};
+
+struct SpeakerChangeConfig {
+	bool enabled = false;
+	std::shared_ptr<const SpeakerModel> model; // option "model": path, loaded while parsing; the spectrum shape otherwise
+	float threshold = 0.0f; // cosine distance that changes turns; 0: the model's own (kBuiltInThreshold without one)
+	bool cut = true;        // option "cut": false only tags chunks
+};
+
+class SpeakerChangeDetector {
+public:
+	static constexpr uint32_t kWindowFrames = 150; // 1.5 s of speech per embedding
+	static constexpr uint32_t kHopFrames = 50;
+	static constexpr uint32_t kMaxSpeakers = 8;
+	static constexpr float kBuiltInThreshold = 0.1f;
+
+	void Configure(uint32_t sampleRate, const SpeakerChangeConfig& config) {
+		enabled_ = config.enabled && sampleRate == 16000;
+		if (!enabled_) return;
+		model_ = config.model;
+		cut_ = config.cut;
+		threshold_ = config.threshold > 0.0f ? config.threshold : model_ ? model_->threshold : kBuiltInThreshold;
+		dims_ = model_ ? model_->net.outputs : LogMelTables::kBands;
+		scratch_.assign(model_ ? model_->net.hidden : 0, 0.0f);
+		window_.assign((size_t)kWindowFrames * LogMelTables::kBands, 0.0f);
+		windowFrame_.assign(kWindowFrames, 0);
+		embedding_.assign(dims_, 0.0f);
+		turn_.assign(dims_, 0.0f);
+		candidate_.assign(dims_, 0.0f);
+		clusters_.assign((size_t)kMaxSpeakers * dims_, 0.0f);
+		speakers_ = 0;
+		Reset();
+	}
+
+	bool Enabled() const { return enabled_; }
+
+	// Starts over without a turn (the clusters stay).
+	void Reset() {
+		frames_ = 0;
+		turnFrames_ = 0;
+		turnWindows_ = 0;
+		flagged_ = 0;
+		speaker_ = -1;
+		previous_ = -1;
+		changed_ = false;
+	}
+
+	// Capture thread: stream frame k's kBands log-mel values, in order;
+	// speech: whether the VAD heard speech in it. Only speech frames count.
+	void PushFrame(uint64_t k, const float* logMel, bool speech) {
+		if (!speech) return;
+		const size_t slot = (size_t)(frames_ % kWindowFrames);
+		memcpy(window_.data() + slot * LogMelTables::kBands, logMel, LogMelTables::kBands * sizeof(float));
+		windowFrame_[slot] = k;
+		++frames_;
+		++turnFrames_;
+		if (turnFrames_ >= kWindowFrames && frames_ % kHopFrames == 0) Compare();
+	}
+
+	// A turn ended since the last call: *frame receives the stream frame the
+	// new one began at.
+	bool TakeChange(uint64_t* frame) {
+		if (!changed_) return false;
+		changed_ = false;
+		*frame = changeFrame_;
+		return true;
+	}
+
+	// The current turn's cluster, -1 before its first window; Previous() is
+	// the one before the latest change.
+	int Speaker() const { return speaker_; }
+	int Previous() const { return previous_; }
+
+	// Option speaker.cut: turn changes cut the open chunk.
+	bool Cuts() const { return cut_; }
+
+	// Cosine distance of the latest window from its turn, for the bench.
+	float Distance() const { return distance_; }
+
+private:
+	// The window's embedding into embedding_, unit length.
+	void Embed() {
+		PooledMelStats stats;
+		stats.Reset();
+		for (uint32_t i = 0; i < kWindowFrames; ++i) {
+			stats.Push(window_.data() + (size_t)((frames_ + i) % kWindowFrames) * LogMelTables::kBands);
+		}
+		float features[kPooledMelFeatures];
+		stats.Features(features);
+		if (model_) {
+			model_->net.Forward(features, embedding_.data(), scratch_.data());
+		} else {
+			// Spectrum shape: the relative band means, centred
+			float mean = 0.0f;
+			for (uint32_t b = 0; b < dims_; ++b) mean += features[b];
+			mean /= (float)dims_;
+			for (uint32_t b = 0; b < dims_; ++b) embedding_[b] = features[b] - mean;
+		}
+		Normalize(embedding_.data());
+	}
+
+	void Normalize(float* v) const {
+		float norm = 0.0f;
+		for (uint32_t i = 0; i < dims_; ++i) norm += v[i] * v[i];
+		norm = norm > 0.0f ? 1.0f / std::sqrt(norm) : 0.0f;
+		for (uint32_t i = 0; i < dims_; ++i) v[i] *= norm;
+	}
+
+	// Cosine distance of unit vector a from the direction of b.
+	float Distance(const float* a, const float* b) const {
+		float dot = 0.0f, norm = 0.0f;
+		for (uint32_t i = 0; i < dims_; ++i) {
+			dot += a[i] * b[i];
+			norm += b[i] * b[i];
+		}
+		return norm > 0.0f ? 1.0f - dot / std::sqrt(norm) : 1.0f;
+	}
+
+	void Compare() {
+		Embed();
+		// A window about half the new voice's is the first to stand out
+		const uint64_t middle = windowFrame_[(size_t)((frames_ + kWindowFrames / 2) % kWindowFrames)];
+		if (turnWindows_ == 0) {
+			std::copy(embedding_.begin(), embedding_.end(), turn_.begin());
+			turnWindows_ = 1;
+			speaker_ = Assign(turn_.data());
+			return;
+		}
+		distance_ = Distance(embedding_.data(), turn_.data());
+		if (distance_ <= threshold_) {
+			flagged_ = 0;
+			for (uint32_t i = 0; i < dims_; ++i) turn_[i] += embedding_[i];
+			++turnWindows_;
+			Join(speaker_, embedding_.data());
+			return;
+		}
+		if (flagged_++ == 0) {
+			// Maybe a stray window (a laugh, a cough): the next one decides
+			std::copy(embedding_.begin(), embedding_.end(), candidate_.begin());
+			candidateFrame_ = middle;
+			return;
+		}
+		// A new turn from the first flagged window on
+		previous_ = speaker_;
+		for (uint32_t i = 0; i < dims_; ++i) turn_[i] = candidate_[i] + embedding_[i];
+		turnWindows_ = 2;
+		turnFrames_ = kWindowFrames + kHopFrames;
+		flagged_ = 0;
+		speaker_ = Assign(turn_.data());
+		changeFrame_ = candidateFrame_;
+		changed_ = true;
+	}
+
+	// The nearest cluster within the threshold, a new one while there is
+	// room, else the nearest.
+	int Assign(const float* v) {
+		int best = -1;
+		float bestDistance = 2.0f;
+		float unit[1024];
+		std::copy(v, v + dims_, unit);
+		Normalize(unit);
+		for (uint32_t s = 0; s < speakers_; ++s) {
+			const float d = Distance(unit, clusters_.data() + (size_t)s * dims_);
+			if (d < bestDistance) {
+				bestDistance = d;
+				best = (int)s;
+			}
+		}
+		if (best < 0 || (bestDistance > threshold_ && speakers_ < kMaxSpeakers)) best = (int)speakers_++;
+		Join(best, unit);
+		return best;
+	}
+
+	void Join(int speaker, const float* unit) {
+		float* c = clusters_.data() + (size_t)speaker * dims_;
+		for (uint32_t i = 0; i < dims_; ++i) c[i] += unit[i];
+	}
+
+	bool enabled_ = false;
+	bool cut_ = true;
+	std::shared_ptr<const SpeakerModel> model_;
+	float threshold_ = kBuiltInThreshold;
+	uint32_t dims_ = 0;
+	std::vector<float> scratch_;
+	std::vector<float> window_;          // ring of the latest kWindowFrames speech frames
+	std::vector<uint64_t> windowFrame_;  // and their stream frames
+	uint64_t frames_ = 0;                // speech frames pushed
+	uint64_t turnFrames_ = 0;            // of them in the current turn
+	uint32_t turnWindows_ = 0;
+	uint32_t flagged_ = 0;               // windows in a row beyond the threshold
+	std::vector<float> embedding_, turn_, candidate_;
+	uint64_t candidateFrame_ = 0;
+	std::vector<float> clusters_;        // kMaxSpeakers sums of unit embeddings
+	uint32_t speakers_ = 0;
+	int speaker_ = -1;
+	int previous_ = -1;
+	bool changed_ = false;
+	uint64_t changeFrame_ = 0;
+	float distance_ = 0.0f;
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+// Optional spectral noise suppression for the voice chain (capture option
+// "denoise"). A 512-point STFT with sqrt-Hann windows at 50% overlap (16 ms
+// hops at 16 kHz, 32 ms latency) tracks each bin's noise floor from its
+// smoothed power (fast to fall, ~3 dB/s to rise) and applies a decision-
+// directed Wiener gain with a floor, which removes steady fan and hum noise
+// without the broadband gate's onset clipping. Every hop is timed against a
+// per-hop CPU budget; when the running average blows it (or one hop takes four
+// times the budget) the stage bypasses, still overlap-adding the windowed
+// input so the stream and its latency stay seamless, and probes again after
+// two seconds. The quality governor suspends it the same way under load.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "addon_log.h"
+#include "spectral_features.h"
+
+struct DenoiseConfig {
+	bool enabled = false;
+	uint32_t budgetUs = 500; // per 16 ms hop
+	float floorDb = -15.0f;  // most a bin is attenuated
+};
+
+class SpectralDenoiser {
+public:
+	static constexpr size_t kFrame = 512;
+	static constexpr size_t kHop = kFrame / 2;
+	static constexpr size_t kBins = kFrame / 2 + 1;
+
+	void Configure(float fs, const DenoiseConfig& config) {
+		config_ = config;
+		if (!config.enabled) return;
+		fft_.Configure(kFrame);
+		window_.resize(kFrame);
+		for (size_t i = 0; i < kFrame; ++i) window_[i] = std::sqrt(0.5f - 0.5f * std::cos(6.28318530718f * (float)i / (float)kFrame));
+		history_.assign(kFrame, 0.0f);
+		overlap_.assign(kFrame, 0.0f);
+		out_.assign(kHop, 0.0f);
+		re_.assign(kFrame, 0.0f);
+		im_.assign(kFrame, 0.0f);
+		smoothed_.assign(kBins, 0.0f);
+		noise_.assign(kBins, 0.0f);
+		gain_.assign(kBins, 1.0f);
+		snr_.assign(kBins, 1.0f);
+		floor_ = std::pow(10.0f, config.floorDb / 20.0f);
+		rise_ = std::pow(10.0f, 0.3f * (float)kHop / fs); // +3 dB/s
+		probeHops_ = (uint32_t)(2.0f * fs / (float)kHop);
+		Reset();
+	}
+
+	bool Enabled() const { return config_.enabled; }
+
+	// Passes the input through like the budget bypass, without probing, until
+	// resumed; the quality governor's NoDenoise level.
+	void Suspend(bool suspended) { suspended_ = suspended; }
+
+	void Reset() {
+		std::fill(history_.begin(), history_.end(), 0.0f);
+		std::fill(overlap_.begin(), overlap_.end(), 0.0f);
+		std::fill(out_.begin(), out_.end(), 0.0f);
+		std::fill(gain_.begin(), gain_.end(), 1.0f);
+		std::fill(snr_.begin(), snr_.end(), 1.0f);
+		filled_ = 0;
+		frames_ = 0;
+		costUs_ = 0.0f;
+		bypass_ = false;
+		suspended_ = false;
+		bypassHops_ = 0;
+	}
+
+	// Warm start (dsp_warm_state.h): the per-bin noise floor, which otherwise
+	// takes the first hop's power and climbs 3 dB/s from there.
+	void SaveNoise(std::vector<float>* noise) const {
+		if (config_.enabled && frames_ > 0) *noise = noise_;
+	}
+	void RestoreNoise(const std::vector<float>& noise) {
+		if (!config_.enabled || noise.size() != kBins) return;
+		noise_ = noise;
+		smoothed_ = noise;
+		frames_ = 1;
+	}
+
+	// Suppresses noise in x in place; the output lags the input by kFrame samples.
+	void Process(float* x, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			history_[kFrame - kHop + filled_] = x[i];
+			x[i] = out_[filled_];
+			if (++filled_ == kHop) {
+				Hop();
+				filled_ = 0;
+			}
+		}
+	}
+
+private:
+	void Hop() {
+		if (bypass_ && !suspended_) {
+			if (++bypassHops_ >= probeHops_) {
+				bypass_ = false;
+				costUs_ = 0.5f * (float)config_.budgetUs;
+				AddonLog(LogLevel::Info, "Spectral denoise probing again");
+			}
+		}
+		const auto start = std::chrono::steady_clock::now();
+		if (bypass_ || suspended_) {
+			// w^2 of two overlapping sqrt-Hann frames sums to one: the input, delayed
+			for (size_t i = 0; i < kFrame; ++i) overlap_[i] += history_[i] * window_[i] * window_[i];
+		} else {
+			Suppress();
+		}
+		for (size_t i = 0; i < kHop; ++i) out_[i] = overlap_[i];
+		std::copy(overlap_.begin() + kHop, overlap_.end(), overlap_.begin());
+		std::fill(overlap_.begin() + kHop, overlap_.end(), 0.0f);
+		std::copy(history_.begin() + kHop, history_.end(), history_.begin());
+		if (bypass_ || suspended_) return;
+
+		const float us = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+		costUs_ += (us - costUs_) * 0.125f;
+		const float budget = (float)config_.budgetUs;
+		if (costUs_ > budget || us > 4.0f * budget) {
+			bypass_ = true;
+			bypassHops_ = 0;
+			AddonLog(LogLevel::Warn, "Spectral denoise over budget (%.0f us per hop, budget %u us); bypassing", costUs_, config_.budgetUs);
+		}
+	}
+
+	void Suppress() {
+		for (size_t i = 0; i < kFrame; ++i) {
+			re_[i] = history_[i] * window_[i];
+			im_[i] = 0.0f;
+		}
+		fft_.Forward(re_.data(), im_.data());
+
+		const bool first = frames_ == 0;
+		++frames_;
+		for (size_t k = 0; k < kBins; ++k) {
+			const float power = re_[k] * re_[k] + im_[k] * im_[k];
+			smoothed_[k] = first ? power : 0.7f * smoothed_[k] + 0.3f * power;
+			// Minimum tracking: follow drops at once, creep up on rises
+			if (first || smoothed_[k] < noise_[k]) noise_[k] = smoothed_[k];
+			else noise_[k] *= rise_;
+			const float post = power / (noise_[k] + 1e-12f);
+			// Decision-directed a priori SNR (Ephraim-Malah), then the Wiener gain
+			const float prior = 0.98f * gain_[k] * gain_[k] * snr_[k] + 0.02f * std::fmax(post - 1.0f, 0.0f);
+			float g = prior / (1.0f + prior);
+			if (g < floor_) g = floor_;
+			gain_[k] = g;
+			snr_[k] = post;
+		}
+		// Real input: the upper half mirrors the lower
+		for (size_t k = 0; k < kBins; ++k) {
+			re_[k] *= gain_[k];
+			im_[k] *= gain_[k];
+		}
+		for (size_t k = kBins; k < kFrame; ++k) {
+			re_[k] = re_[kFrame - k];
+			im_[k] = -im_[kFrame - k];
+		}
+		// Inverse through the forward transform of the conjugate
+		for (size_t k = 0; k < kFrame; ++k) im_[k] = -im_[k];
+		fft_.Forward(re_.data(), im_.data());
+		const float scale = 1.0f / (float)kFrame;
+		for (size_t i = 0; i < kFrame; ++i) overlap_[i] += re_[i] * scale * window_[i];
+	}
+
+	DenoiseConfig config_;
+	RadixTwoFft fft_;
+	std::vector<float> window_;
+	std::vector<float> history_; // last kFrame input samples; the newest hop fills as it arrives
+	std::vector<float> overlap_; // overlap-add accumulator
+	std::vector<float> out_;     // finished hop being played out
+	std::vector<float> re_, im_;
+	std::vector<float> smoothed_, noise_, gain_, snr_;
+	float floor_ = 0.18f, rise_ = 1.0f;
+	size_t filled_ = 0;
+	uint64_t frames_ = 0;
+	float costUs_ = 0.0f; // running average per hop
+	bool bypass_ = false;
+	bool suspended_ = false;
+	uint32_t bypassHops_ = 0, probeHops_ = 0;
+};
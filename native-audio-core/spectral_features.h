@@ -0,0 +1,340 @@
+#pragma once
+
+// Per-utterance signal features for the JS Whisper pre-filter, accumulated frame
+// by frame on the capture thread while the chunker fills a chunk, so the
+// pre-filter's decision on a chunk is O(1) in JS. Each VAD frame is zero-padded
+// to twice its length and transformed once; the summed power spectrum gives the
+// spectral flatness directly and, transformed back, the summed in-frame
+// autocorrelation behind the dominant frequency and harmonic content. Frame
+// amplitudes, zero crossings and a log-spaced amplitude histogram cover the
+// rest. Definitions follow WhisperPreFilter.ts where they can be computed
+// incrementally; the autocorrelation only spans lags inside one frame.
+//
+// The same per-frame spectrum also yields a perceptual fingerprint of the
+// chunk, Haitsma-Kalker style: the frame's power in 33 log-spaced bands from
+// 300 to 2000 Hz, and one 32-bit word per frame whose bit m is set when the
+// energy difference between bands m and m+1 grew since the previous analysed
+// frame. Words survive gain changes, light noise and re-encoding, so a
+// repeated jingle or a looping video gives nearly the same words (a low bit
+// error rate) even when it is cut at slightly different points.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+struct SpectralFeatures {
+	float dominantFrequency = 0.0f; // Hz, autocorrelation peak in 50-800 Hz; 0 if none
+	float harmonicContent = 0.0f;   // mean |autocorrelation| at 2x, 3x, 4x the dominant frequency
+	float modulationDepth = 0.0f;   // std/mean of the amplitude over ten windows
+	float zeroCrossingRate = 0.0f;  // crossings per sample
+	float spectralFlatness = 1.0f;  // geometric / arithmetic mean power; 1 = white noise or silence
+	float noiseRatio = 0.0f;        // share of samples within 3x the 25th-percentile amplitude
+};
+
+// In-place iterative radix-2 FFT over split real/imaginary arrays.
+class RadixTwoFft {
+public:
+	void Configure(size_t size) {
+		size_ = size;
+		bits_ = 0;
+		while (((size_t)1 << bits_) < size) ++bits_;
+		cos_.resize(size / 2);
+		sin_.resize(size / 2);
+		for (size_t k = 0; k < size / 2; ++k) {
+			const double w = -6.283185307179586 * (double)k / (double)size;
+			cos_[k] = (float)std::cos(w);
+			sin_[k] = (float)std::sin(w);
+		}
+		reverse_.resize(size);
+		for (size_t i = 0; i < size; ++i) {
+			size_t r = 0;
+			for (unsigned b = 0; b < bits_; ++b) r |= ((i >> b) & 1) << (bits_ - 1 - b);
+			reverse_[i] = (uint32_t)r;
+		}
+	}
+
+	size_t Size() const { return size_; }
+
+	void Forward(float* re, float* im) const {
+		for (size_t i = 0; i < size_; ++i) {
+			const size_t j = reverse_[i];
+			if (j > i) {
+				std::swap(re[i], re[j]);
+				std::swap(im[i], im[j]);
+			}
+		}
+		for (size_t half = 1, step = size_ / 2; half < size_; half *= 2, step /= 2) {
+			for (size_t start = 0; start < size_; start += 2 * half) {
+				for (size_t k = 0; k < half; ++k) {
+					const float wr = cos_[k * step], wi = sin_[k * step];
+					const size_t a = start + k, b = a + half;
+					const float tr = re[b] * wr - im[b] * wi;
+					const float ti = re[b] * wi + im[b] * wr;
+					re[b] = re[a] - tr;
+					im[b] = im[a] - ti;
+					re[a] += tr;
+					im[a] += ti;
+				}
+			}
+		}
+	}
+
+private:
+	size_t size_ = 0;
+	unsigned bits_ = 0;
+	std::vector<float> cos_, sin_;
+	std::vector<uint32_t> reverse_;
+};
+
+// Bands (and so bits + 1) of the Haitsma-Kalker fingerprint.
+constexpr size_t kFingerprintBands = 33;
+
+class SpectralFeatureExtractor {
+public:
+	// frameSamples is the VAD frame; maxFrames bounds one chunk (sizes the
+	// amplitude history so accumulation never allocates).
+	void Configure(uint32_t sampleRate, size_t frameSamples, size_t maxFrames) {
+		sampleRate_ = sampleRate;
+		frameSamples_ = frameSamples;
+		stride_ = 1;
+		if (frameSamples == 0) return;
+		size_t size = 2;
+		while (size < 2 * frameSamples) size *= 2;
+		fft_.Configure(size);
+		re_.assign(size, 0.0f);
+		im_.assign(size, 0.0f);
+		power_.assign(size / 2 + 1, 0.0f);
+		frame_.assign(frameSamples, 0.0f);
+		amplitudes_.reserve(maxFrames);
+		maxFrames_ = maxFrames;
+		fingerprint_.reserve(maxFrames);
+		// Band edges in bins, log-spaced over 300-2000 Hz (or up to Nyquist)
+		const double binHz = (double)sampleRate / (double)size;
+		const double lo = 300.0, hi = std::min(2000.0, sampleRate / 2.0);
+		for (size_t b = 0; b <= kFingerprintBands; ++b) {
+			const double hz = lo * std::pow(hi / lo, (double)b / kFingerprintBands);
+			const uint32_t edge = std::max<uint32_t>((uint32_t)std::lround(hz / binHz), b ? bandEdges_[b - 1] + 1 : 1);
+			bandEdges_[b] = std::min<uint32_t>(edge, (uint32_t)(size / 2));
+		}
+		Reset();
+	}
+
+	bool Enabled() const { return frameSamples_ > 0; }
+
+	// Spectrum of every stride-th frame only (the quality governor's
+	// SparseFeatures level); amplitudes and crossings still cover every sample.
+	void SetStride(uint32_t stride) { stride_ = stride > 0 ? stride : 1; }
+
+	void Reset() {
+		for (float& p : power_) p = 0.0f;
+		for (uint32_t& h : histogram_) h = 0;
+		amplitudes_.clear();
+		fingerprint_.clear();
+		hasBands_ = false;
+		frames_ = 0;
+		spectra_ = 0;
+		filled_ = 0;
+		samples_ = 0;
+		crossings_ = 0;
+		last_ = 0;
+	}
+
+	// Frames accumulated since the last Reset() or Take().
+	size_t Frames() const { return frames_; }
+
+	// Appends samples of the current frame; a frame is analysed once full.
+	void Push(const int16_t* x, size_t n) {
+		for (size_t i = 0; i < n; ++i) {
+			const int s = x[i];
+			if (samples_ > 0 && (s >= 0) != (last_ >= 0)) ++crossings_;
+			last_ = s;
+			++samples_;
+			++histogram_[AmplitudeBin((uint32_t)std::abs(s))];
+			frame_[filled_++] = (float)s * (1.0f / 32768.0f);
+			if (filled_ == frameSamples_) EndFrame();
+		}
+	}
+
+	// Features of everything pushed since the last Reset(), which it implies.
+	// fingerprint, when given, receives the fingerprint words (one per
+	// analysed frame after the first) by swap, so the capture thread only
+	// allocates until every chunk slot has held a vector once.
+	SpectralFeatures Take(std::vector<uint32_t>* fingerprint = nullptr) {
+		if (fingerprint) {
+			fingerprint->swap(fingerprint_);
+			fingerprint_.clear();
+			if (fingerprint_.capacity() < maxFrames_) fingerprint_.reserve(maxFrames_);
+		}
+		SpectralFeatures f;
+		if (spectra_ == 0) {
+			Reset();
+			return f;
+		}
+		const size_t size = fft_.Size(), bins = size / 2;
+		f.zeroCrossingRate = (float)crossings_ / (float)samples_;
+
+		// Flatness over the non-DC bins, in the log domain
+		double logSum = 0.0, sum = 0.0;
+		for (size_t k = 1; k <= bins; ++k) {
+			logSum += std::log((double)power_[k] + 1e-20);
+			sum += power_[k];
+		}
+		const double arithmetic = sum / bins;
+		f.spectralFlatness = arithmetic > 1e-18 ? (float)(std::exp(logSum / bins) / arithmetic) : 1.0f;
+
+		// Summed power spectrum back to the summed autocorrelation (it is real and even)
+		for (size_t k = 0; k < size; ++k) {
+			re_[k] = power_[k <= bins ? k : size - k];
+			im_[k] = 0.0f;
+		}
+		fft_.Forward(re_.data(), im_.data());
+		auto correlation = [&](size_t lag) {
+			return re_[lag] / ((float)size * (float)spectra_ * (float)(frameSamples_ - lag));
+		};
+		const size_t minLag = sampleRate_ / 800;
+		const size_t maxLag = std::min<size_t>(sampleRate_ / 50, frameSamples_ - 1);
+		float best = 0.0f;
+		size_t bestLag = 0;
+		for (size_t lag = minLag; lag < maxLag; ++lag) {
+			const float c = correlation(lag);
+			if (c > best) { best = c; bestLag = lag; }
+		}
+		// Within one frame the unbiased estimate gets noisy at long lags; take the
+		// shortest peak near the maximum so multiples of the period don't win
+		for (size_t lag = minLag + 1; bestLag > 0 && lag < bestLag; ++lag) {
+			const float c = correlation(lag);
+			if (c >= 0.9f * best && c >= correlation(lag - 1) && c >= correlation(lag + 1)) {
+				bestLag = lag;
+				break;
+			}
+		}
+		if (bestLag > 0) {
+			f.dominantFrequency = (float)sampleRate_ / (float)bestLag;
+			float harmonics = 0.0f;
+			for (int mult = 2; mult <= 4; ++mult) {
+				const float target = f.dominantFrequency * mult;
+				if (target > sampleRate_ / 2.0f) continue;
+				const size_t period = (size_t)(sampleRate_ / target);
+				if (period > 0 && period < frameSamples_) harmonics += std::fabs(correlation(period));
+			}
+			f.harmonicContent = harmonics / 3.0f;
+		}
+
+		// Ten amplitude windows over the chunk, as the JS version
+		const size_t frames = amplitudes_.size();
+		const size_t window = frames >= 10 ? frames / 10 : 1;
+		double wSum = 0.0, wSquares = 0.0;
+		size_t windows = 0;
+		for (size_t at = 0; at + window <= frames; at += window, ++windows) {
+			float a = 0.0f;
+			for (size_t i = 0; i < window; ++i) a += amplitudes_[at + i];
+			a /= (float)window;
+			wSum += a;
+			wSquares += (double)a * a;
+		}
+		if (windows >= 2 && wSum > 0.0) {
+			const double mean = wSum / windows;
+			const double variance = std::max(0.0, wSquares / windows - mean * mean);
+			f.modulationDepth = (float)(std::sqrt(variance) / mean);
+		}
+
+		// 25th-percentile amplitude from the histogram, then the share within 3x of it
+		const uint64_t quarter = (uint64_t)samples_ / 4;
+		uint64_t seen = 0;
+		uint32_t floorBin = 0;
+		for (uint32_t b = 0; b < kAmplitudeBins; ++b) {
+			seen += histogram_[b];
+			if (seen > quarter) { floorBin = b; break; }
+		}
+		const uint32_t limit = AmplitudeBin(std::min<uint32_t>(32768, 3 * BinFloor(floorBin)));
+		uint64_t noise = 0;
+		for (uint32_t b = 0; b <= limit; ++b) noise += histogram_[b];
+		f.noiseRatio = (float)noise / (float)samples_;
+
+		Reset();
+		return f;
+	}
+
+private:
+	// Exact below 16, then eight bins per octave (~0.75 dB) up to 32768.
+	static constexpr uint32_t kAmplitudeBins = 16 + 12 * 8;
+
+	static uint32_t AmplitudeBin(uint32_t m) {
+		if (m < 16) return m;
+		uint32_t e = 4;
+		while ((m >> (e + 1)) != 0) ++e;
+		return 16 + (e - 4) * 8 + ((m >> (e - 3)) & 7);
+	}
+
+	static uint32_t BinFloor(uint32_t bin) {
+		if (bin < 16) return bin;
+		const uint32_t e = 4 + (bin - 16) / 8;
+		return (8 + (bin - 16) % 8) << (e - 3);
+	}
+
+	void EndFrame() {
+		float amplitude = 0.0f;
+		for (size_t i = 0; i < frameSamples_; ++i) amplitude += std::fabs(frame_[i]);
+		if (frames_ % stride_ == 0) {
+			const size_t size = fft_.Size();
+			for (size_t i = 0; i < frameSamples_; ++i) {
+				re_[i] = frame_[i];
+				im_[i] = 0.0f;
+			}
+			for (size_t i = frameSamples_; i < size; ++i) re_[i] = im_[i] = 0.0f;
+			fft_.Forward(re_.data(), im_.data());
+			for (size_t k = 0; k <= size / 2; ++k) power_[k] += re_[k] * re_[k] + im_[k] * im_[k];
+			++spectra_;
+			AddFingerprintWord();
+		}
+		if (amplitudes_.size() < amplitudes_.capacity()) amplitudes_.push_back(amplitude / (float)frameSamples_);
+		++frames_;
+		filled_ = 0;
+	}
+
+	// Band energies of the frame just transformed (in re_/im_) and, from the
+	// second analysed frame on, its fingerprint word.
+	void AddFingerprintWord() {
+		float bands[kFingerprintBands];
+		for (size_t b = 0; b < kFingerprintBands; ++b) {
+			float e = 0.0f;
+			for (uint32_t k = bandEdges_[b]; k < bandEdges_[b + 1]; ++k) e += re_[k] * re_[k] + im_[k] * im_[k];
+			bands[b] = e;
+		}
+		if (hasBands_ && fingerprint_.size() < fingerprint_.capacity()) {
+			uint32_t word = 0;
+			for (size_t m = 0; m + 1 < kFingerprintBands; ++m) {
+				const float delta = (bands[m] - bands[m + 1]) - (bands_[m] - bands_[m + 1]);
+				if (delta > 0.0f) word |= 1u << m;
+			}
+			fingerprint_.push_back(word);
+		}
+		std::copy(bands, bands + kFingerprintBands, bands_);
+		hasBands_ = true;
+	}
+
+	uint32_t sampleRate_ = 16000;
+	size_t frameSamples_ = 0;
+	size_t maxFrames_ = 0;
+	RadixTwoFft fft_;
+	std::vector<float> re_, im_;
+	std::vector<float> power_;      // summed |X(k)|^2, k = 0..size/2
+	std::vector<float> frame_;      // current frame, -1..1
+	std::vector<float> amplitudes_; // mean |x| per frame
+	std::vector<uint32_t> fingerprint_; // one word per analysed frame after the first
+	uint32_t bandEdges_[kFingerprintBands + 1] = {};
+	float bands_[kFingerprintBands] = {}; // previous analysed frame's band energies
+	bool hasBands_ = false;
+	size_t frames_ = 0;
+	size_t spectra_ = 0;  // frames summed into power_
+	uint32_t stride_ = 1;
+	uint32_t histogram_[kAmplitudeBins] = {};
+	size_t filled_ = 0;
+	uint64_t samples_ = 0;
+	uint64_t crossings_ = 0;
+	int last_ = 0;
+};
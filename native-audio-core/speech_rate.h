@@ -0,0 +1,109 @@
+#pragma once
+
+// Syllable rate of the speech the chunker sees, from the modulation peaks of
+// its frame energy envelope: every syllable nucleus is a loudness peak some
+// 3 dB over the dips on either side of it, at most about eight a second. A
+// peak counts when the envelope has risen kRiseDb over the last valley and
+// fallen kRiseDb back from it, at least kMinPeakMs after the previous one.
+// Only VAD speech frames count, and the rate is peaks over speech time with
+// both decayed over about kWindowMs of speech, so it follows a speaker who
+// speeds up without jumping at every phrase. One rate per speaker cluster
+// (speaker_change.h); Select() switches between them.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+class SpeechRateEstimator {
+public:
+	static constexpr float kRiseDb = 3.0f;
+	static constexpr uint32_t kMinPeakMs = 100;
+	static constexpr float kWindowMs = 6000.0f;
+	static constexpr float kMinSpeechMs = 2000.0f; // before this the rate is unknown
+	static constexpr int kMaxSpeakers = 8;         // speaker_change.h's clusters
+
+	void Configure(uint32_t frameMs) {
+		frameMs_ = frameMs;
+		decay_ = std::exp(-(float)frameMs / kWindowMs);
+		Reset();
+	}
+
+	void Reset() {
+		states_.fill(State());
+		current_ = 0;
+	}
+
+	// speaker: the cluster the frames now belong to, -1 for unknown (its own rate)
+	void Select(int speaker) {
+		current_ = speaker >= 0 && speaker < kMaxSpeakers ? speaker + 1 : 0;
+	}
+
+	// One frame's mean square of int16 samples and its VAD decision.
+	void Push(double meanSquare, bool speech) {
+		State& s = states_[current_];
+		if (!speech) {
+			// A pause ends the syllable (it counts if it rose far enough) and
+			// is the next valley
+			if (s.rising && s.sincePeakMs >= kMinPeakMs) {
+				s.peaks += 1.0f;
+				s.sincePeakMs = 0;
+			}
+			s.rising = false;
+			s.lastDb = kFloorDb;
+			s.valleyDb = kFloorDb;
+			s.peakDb = kFloorDb;
+			s.sincePeakMs += frameMs_;
+			return;
+		}
+		const float db = meanSquare > 0.0 ? (float)(10.0 * std::log10(meanSquare)) : kFloorDb;
+		// A two-frame average keeps one loud frame from reading as a syllable
+		const float env = s.lastDb <= kFloorDb ? db : 0.5f * (db + s.lastDb);
+		s.lastDb = db;
+		s.speechMs = s.speechMs * decay_ + (float)frameMs_;
+		s.peaks *= decay_;
+		s.sincePeakMs += frameMs_;
+		if (!s.rising) {
+			s.valleyDb = std::min(s.valleyDb, env);
+			if (env >= s.valleyDb + kRiseDb) {
+				s.rising = true;
+				s.peakDb = env;
+			}
+			return;
+		}
+		s.peakDb = std::max(s.peakDb, env);
+		if (env <= s.peakDb - kRiseDb) {
+			if (s.sincePeakMs >= kMinPeakMs) {
+				s.peaks += 1.0f;
+				s.sincePeakMs = 0;
+			}
+			s.rising = false;
+			s.valleyDb = env;
+		}
+	}
+
+	// Syllables a second of the selected speaker, 0 until kMinSpeechMs of speech.
+	float Rate() const {
+		const State& s = states_[current_];
+		return s.speechMs < kMinSpeechMs ? 0.0f : s.peaks * 1000.0f / s.speechMs;
+	}
+
+private:
+	static constexpr float kFloorDb = -200.0f;
+
+	struct State {
+		float peaks = 0.0f;    // decayed peak count
+		float speechMs = 0.0f; // decayed speech time
+		float lastDb = kFloorDb;
+		float valleyDb = kFloorDb;
+		float peakDb = kFloorDb;
+		bool rising = false;
+		uint32_t sincePeakMs = kMinPeakMs;
+	};
+
+	uint32_t frameMs_ = 0;
+	float decay_ = 1.0f;
+	std::array<State, kMaxSpeakers + 1> states_; // [0]: no speaker named yet
+	int current_ = 0;
+};
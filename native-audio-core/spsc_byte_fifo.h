@@ -0,0 +1,79 @@
+#pragma once
+
+// Lock-free byte FIFO between one producer (an audio IO callback) and one
+// consumer (the DSP worker). Writes are all-or-nothing so interleaved frames are
+// never split by an overrun; both sides only memcpy.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "realtime_memory.h"
+
+class SpscByteFifo {
+public:
+	// Not thread-safe; call before either side runs. Capacity is rounded up
+	// to a power of two.
+	void Reset(size_t minCapacity) {
+		size_t c = 1;
+		while (c < minCapacity) c <<= 1;
+		buffer_.assign(c, 0);
+		mask_ = c - 1;
+		write_.store(0, std::memory_order_relaxed);
+		read_.store(0, std::memory_order_relaxed);
+	}
+
+	size_t Capacity() const { return buffer_.size(); }
+
+	// Bytes ready for the consumer.
+	size_t Available() const {
+		return (size_t)(write_.load(std::memory_order_acquire) - read_.load(std::memory_order_acquire));
+	}
+
+	// Producer. Returns false (and writes nothing) if n bytes don't fit.
+	bool Write(const void* src, size_t n) {
+		const uint64_t w = write_.load(std::memory_order_relaxed);
+		const uint64_t r = read_.load(std::memory_order_acquire);
+		if (buffer_.size() - (size_t)(w - r) < n) return false;
+		const size_t at = (size_t)(w & mask_);
+		const size_t first = std::min(n, buffer_.size() - at);
+		memcpy(&buffer_[at], src, first);
+		memcpy(&buffer_[0], static_cast<const uint8_t*>(src) + first, n - first);
+		write_.store(w + n, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer. Copies up to n bytes; returns the number copied.
+	size_t Read(void* dst, size_t n) {
+		const uint64_t r = read_.load(std::memory_order_relaxed);
+		const uint64_t w = write_.load(std::memory_order_acquire);
+		n = std::min(n, (size_t)(w - r));
+		const size_t at = (size_t)(r & mask_);
+		const size_t first = std::min(n, buffer_.size() - at);
+		memcpy(dst, &buffer_[at], first);
+		memcpy(static_cast<uint8_t*>(dst) + first, &buffer_[0], n - first);
+		read_.store(r + n, std::memory_order_release);
+		return n;
+	}
+
+	// Running byte counts since Reset(), for marking a point in the stream.
+	uint64_t WritePosition() const { return write_.load(std::memory_order_acquire); }
+	uint64_t ReadPosition() const { return read_.load(std::memory_order_acquire); }
+
+	// Consumer. Drops everything before position (clamped to what was written).
+	void SkipTo(uint64_t position) {
+		const uint64_t r = read_.load(std::memory_order_relaxed);
+		const uint64_t w = write_.load(std::memory_order_acquire);
+		position = std::min(position, w);
+		if (position > r) read_.store(position, std::memory_order_release);
+	}
+
+private:
+	RealtimeVector<uint8_t> buffer_;
+	size_t mask_ = 0;
+	alignas(64) std::atomic<uint64_t> write_{0};
+	alignas(64) std::atomic<uint64_t> read_{0};
+};
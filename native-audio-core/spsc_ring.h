@@ -0,0 +1,71 @@
+#pragma once
+
+// Fixed-capacity lock-free ring of pointers between one producer thread and one
+// consumer thread. The producer may also reclaim the oldest entry when the ring
+// is full (drop-oldest overflow), so the read index is advanced with a CAS
+// rather than a plain store.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+template <typename T>
+class SpscRing {
+public:
+	// Capacity is rounded up to a power of two.
+	explicit SpscRing(size_t capacity) {
+		size_t c = 1;
+		while (c < capacity) c <<= 1;
+		mask_ = c - 1;
+		cells_.reset(new std::atomic<T*>[c]);
+		for (size_t i = 0; i < c; ++i) cells_[i].store(nullptr, std::memory_order_relaxed);
+	}
+
+	size_t Capacity() const { return mask_ + 1; }
+
+	size_t Size() const {
+		uint64_t tail = tail_.load(std::memory_order_acquire);
+		uint64_t head = head_.load(std::memory_order_acquire);
+		return tail > head ? (size_t)(tail - head) : 0;
+	}
+
+	// Producer only. Returns false when the ring is full.
+	bool TryPush(T* item) {
+		uint64_t tail = tail_.load(std::memory_order_relaxed);
+		uint64_t head = head_.load(std::memory_order_acquire);
+		if (tail - head > mask_) return false;
+		cells_[tail & mask_].store(item, std::memory_order_relaxed);
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Producer only. Takes back the oldest queued entry, or nullptr if the
+	// consumer emptied the ring in the meantime.
+	T* StealOldest() {
+		uint64_t head = head_.load(std::memory_order_acquire);
+		const uint64_t tail = tail_.load(std::memory_order_relaxed);
+		while (head != tail) {
+			T* item = cells_[head & mask_].load(std::memory_order_relaxed);
+			if (head_.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel, std::memory_order_acquire)) return item;
+		}
+		return nullptr;
+	}
+
+	// Consumer only. Returns nullptr when the ring is empty.
+	T* TryPop() {
+		uint64_t head = head_.load(std::memory_order_acquire);
+		for (;;) {
+			uint64_t tail = tail_.load(std::memory_order_acquire);
+			if (head == tail) return nullptr;
+			T* item = cells_[head & mask_].load(std::memory_order_relaxed);
+			if (head_.compare_exchange_weak(head, head + 1, std::memory_order_acq_rel, std::memory_order_acquire)) return item;
+		}
+	}
+
+private:
+	std::unique_ptr<std::atomic<T*>[]> cells_;
+	size_t mask_ = 0;
+	alignas(64) std::atomic<uint64_t> head_{0};
+	alignas(64) std::atomic<uint64_t> tail_{0};
+};
@@ -0,0 +1,350 @@
+#pragma once
+
+// Streaming decoder for TTS responses (MP3, ADTS AAC, Ogg-Opus). Bytes are fed
+// as they arrive off the network, in any split; every complete frame decodes
+// at once and comes back as mono pcm16 at the requested rate, so playback can
+// start on the first frame instead of waiting for a segment
+// decodeAudioData() accepts. MP3 and AAC go through the libavcodec parsers;
+// Ogg pages are split into packets here and the OpusHead becomes the
+// decoder's extradata. Built with gyp variable use_avcodec=1
+// (AUDIO_CORE_AVCODEC, links libavcodec/libswresample/libavutil); otherwise
+// openStreamDecoder() throws and callers keep decoding in the renderer.
+//
+//   openStreamDecoder(id, codec: 'mp3' | 'aac' | 'opus', { sampleRate? })
+//   feedStreamDecoder(id, bytes: Buffer) -> Int16Array
+//   closeStreamDecoder(id) -> Int16Array (the decoder's tail)
+//
+// Decoders are keyed by id and only touched on the JS thread.
+
+#include <napi.h>
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "addon_instance.h"
+#include "capture_options.h"
+
+#if defined(AUDIO_CORE_AVCODEC)
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+#include <libswresample/swresample.h>
+}
+#endif
+
+enum class StreamCodec { Mp3, Aac, Opus };
+
+// Splits an Ogg byte stream into packets, whatever the chunking (single
+// logical stream; pages are not CRC-checked, the transport already is).
+class OggPacketReader {
+public:
+	void Push(const uint8_t* data, size_t n) { buffer_.insert(buffer_.end(), data, data + n); }
+
+	// Next complete packet, false when more bytes are needed.
+	bool Next(std::vector<uint8_t>* packet) {
+		for (;;) {
+			while (lacingAt_ < lacing_.size()) {
+				const uint8_t len = lacing_[lacingAt_++];
+				partial_.insert(partial_.end(), body_.begin() + bodyAt_, body_.begin() + bodyAt_ + len);
+				bodyAt_ += len;
+				if (len < 255) {
+					packet->swap(partial_);
+					partial_.clear();
+					return true;
+				}
+			}
+			if (!NextPage()) return false;
+		}
+	}
+
+private:
+	bool NextPage() {
+		// Resync on the capture pattern
+		size_t at = 0;
+		while (at + 4 <= buffer_.size() && memcmp(buffer_.data() + at, "OggS", 4) != 0) ++at;
+		if (at > 0) buffer_.erase(buffer_.begin(), buffer_.begin() + at);
+		if (buffer_.size() < 27) return false;
+		const size_t segments = buffer_[26];
+		if (buffer_.size() < 27 + segments) return false;
+		size_t bodyBytes = 0;
+		for (size_t i = 0; i < segments; ++i) bodyBytes += buffer_[27 + i];
+		const size_t pageBytes = 27 + segments + bodyBytes;
+		if (buffer_.size() < pageBytes) return false;
+		if (!(buffer_[5] & 0x01)) partial_.clear(); // not a continuation: drop any torn packet
+		lacing_.assign(buffer_.begin() + 27, buffer_.begin() + 27 + segments);
+		body_.assign(buffer_.begin() + 27 + segments, buffer_.begin() + pageBytes);
+		lacingAt_ = bodyAt_ = 0;
+		buffer_.erase(buffer_.begin(), buffer_.begin() + pageBytes);
+		return true;
+	}
+
+	std::vector<uint8_t> buffer_;  // unparsed bytes
+	std::vector<uint8_t> lacing_, body_;
+	size_t lacingAt_ = 0, bodyAt_ = 0;
+	std::vector<uint8_t> partial_; // packet continuing across segments/pages
+};
+
+#if defined(AUDIO_CORE_AVCODEC)
+
+class StreamDecoder {
+public:
+	StreamDecoder() = default;
+	StreamDecoder(const StreamDecoder&) = delete;
+	StreamDecoder& operator=(const StreamDecoder&) = delete;
+
+	~StreamDecoder() {
+		if (parser_) av_parser_close(parser_);
+		avcodec_free_context(&ctx_);
+		av_packet_free(&packet_);
+		av_frame_free(&frame_);
+		swr_free(&swr_);
+	}
+
+	bool Open(StreamCodec codec, uint32_t outRate, std::string* error) {
+		codec_ = codec;
+		outRate_ = outRate;
+		const AVCodecID id = codec == StreamCodec::Mp3 ? AV_CODEC_ID_MP3 : codec == StreamCodec::Aac ? AV_CODEC_ID_AAC : AV_CODEC_ID_OPUS;
+		decoder_ = avcodec_find_decoder(id);
+		packet_ = av_packet_alloc();
+		frame_ = av_frame_alloc();
+		if (!decoder_ || !packet_ || !frame_) {
+			*error = "Decoder unavailable in this libavcodec build";
+			return false;
+		}
+		if (codec == StreamCodec::Opus) return true; // opened once the OpusHead arrives
+		parser_ = av_parser_init(id);
+		if (!parser_) {
+			*error = "Parser unavailable in this libavcodec build";
+			return false;
+		}
+		return OpenContext(nullptr, 0, error);
+	}
+
+	uint32_t OutRate() const { return outRate_; }
+
+	// Decodes what it can of n more bytes, appending pcm16 to out.
+	bool Feed(const uint8_t* data, size_t n, std::vector<int16_t>* out, std::string* error) {
+		if (codec_ == StreamCodec::Opus) {
+			ogg_.Push(data, n);
+			std::vector<uint8_t> packet;
+			while (ogg_.Next(&packet)) {
+				if (!ctx_) {
+					if (packet.size() < 19 || memcmp(packet.data(), "OpusHead", 8) != 0) continue;
+					if (!OpenContext(packet.data(), packet.size(), error)) return false;
+					continue;
+				}
+				if (packet.size() >= 8 && memcmp(packet.data(), "OpusTags", 8) == 0) continue;
+				packet_->data = packet.data();
+				packet_->size = (int)packet.size();
+				if (!Decode(packet_, out, error)) return false;
+			}
+			return true;
+		}
+		while (n > 0) {
+			const int used = av_parser_parse2(parser_, ctx_, &packet_->data, &packet_->size, data, (int)n, AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
+			if (used < 0) {
+				*error = "Stream parse error";
+				return false;
+			}
+			data += used;
+			n -= (size_t)used;
+			if (packet_->size > 0 && !Decode(packet_, out, error)) return false;
+		}
+		return true;
+	}
+
+	// End of stream: flushes the parser, the decoder and the resampler.
+	bool Finish(std::vector<int16_t>* out, std::string* error) {
+		if (!ctx_) return true;
+		if (parser_) {
+			av_parser_parse2(parser_, ctx_, &packet_->data, &packet_->size, nullptr, 0, AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
+			if (packet_->size > 0 && !Decode(packet_, out, error)) return false;
+		}
+		if (!Decode(nullptr, out, error)) return false;
+		if (swr_) {
+			const int tail = swr_get_out_samples(swr_, 0);
+			if (tail > 0) {
+				const size_t at = out->size();
+				out->resize(at + (size_t)tail);
+				uint8_t* dst[1] = { reinterpret_cast<uint8_t*>(out->data() + at) };
+				const int got = swr_convert(swr_, dst, tail, nullptr, 0);
+				out->resize(at + (size_t)(got > 0 ? got : 0));
+			}
+		}
+		return true;
+	}
+
+private:
+	bool OpenContext(const uint8_t* extradata, size_t size, std::string* error) {
+		ctx_ = avcodec_alloc_context3(decoder_);
+		if (!ctx_) {
+			*error = "Out of memory";
+			return false;
+		}
+		if (extradata) {
+			ctx_->extradata = static_cast<uint8_t*>(av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE));
+			if (!ctx_->extradata) {
+				*error = "Out of memory";
+				return false;
+			}
+			memcpy(ctx_->extradata, extradata, size);
+			ctx_->extradata_size = (int)size;
+		}
+		if (avcodec_open2(ctx_, decoder_, nullptr) < 0) {
+			*error = "Failed to open the decoder";
+			return false;
+		}
+		return true;
+	}
+
+	// Sends one packet (null drains) and converts every frame it yields.
+	bool Decode(AVPacket* packet, std::vector<int16_t>* out, std::string* error) {
+		int ret = avcodec_send_packet(ctx_, packet);
+		if (ret < 0 && ret != AVERROR_EOF) {
+			if (ret == AVERROR_INVALIDDATA) return true; // skip a corrupt frame, as players do
+			*error = "Decoder rejected a packet";
+			return false;
+		}
+		while ((ret = avcodec_receive_frame(ctx_, frame_)) == 0) {
+			const bool ok = Convert(frame_, out, error);
+			av_frame_unref(frame_);
+			if (!ok) return false;
+		}
+		return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF;
+	}
+
+	bool Convert(const AVFrame* frame, std::vector<int16_t>* out, std::string* error) {
+		if (!swr_) {
+			AVChannelLayout mono = AV_CHANNEL_LAYOUT_MONO;
+			if (swr_alloc_set_opts2(&swr_, &mono, AV_SAMPLE_FMT_S16, (int)outRate_,
+			                        &frame->ch_layout, (AVSampleFormat)frame->format, frame->sample_rate, 0, nullptr) < 0 ||
+			    swr_init(swr_) < 0) {
+				*error = "Unsupported decoded format";
+				return false;
+			}
+		}
+		const int room = swr_get_out_samples(swr_, frame->nb_samples);
+		const size_t at = out->size();
+		out->resize(at + (size_t)(room > 0 ? room : 0));
+		uint8_t* dst[1] = { reinterpret_cast<uint8_t*>(out->data() + at) };
+		const int got = swr_convert(swr_, dst, room, const_cast<const uint8_t**>(frame->extended_data), frame->nb_samples);
+		out->resize(at + (size_t)(got > 0 ? got : 0));
+		return true;
+	}
+
+	StreamCodec codec_ = StreamCodec::Mp3;
+	uint32_t outRate_ = 24000;
+	const AVCodec* decoder_ = nullptr;
+	AVCodecContext* ctx_ = nullptr;
+	AVCodecParserContext* parser_ = nullptr;
+	AVPacket* packet_ = nullptr;
+	AVFrame* frame_ = nullptr;
+	SwrContext* swr_ = nullptr;
+	OggPacketReader ogg_;
+};
+
+// One set of decoders per environment (addon_instance.h); JS thread.
+inline std::map<std::string, std::unique_ptr<StreamDecoder>>& StreamDecoders(Napi::Env env) {
+	return PerEnv<std::map<std::string, std::unique_ptr<StreamDecoder>>>(env);
+}
+
+inline Napi::Value Int16ArrayFrom(Napi::Env env, const std::vector<int16_t>& pcm) {
+	Napi::ArrayBuffer ab = Napi::ArrayBuffer::New(env, pcm.size() * sizeof(int16_t));
+	if (!pcm.empty()) memcpy(ab.Data(), pcm.data(), pcm.size() * sizeof(int16_t));
+	return Napi::Int16Array::New(env, pcm.size(), ab, 0);
+}
+
+#endif
+
+inline Napi::Value OpenStreamDecoder(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
+		Napi::TypeError::New(env, "Decoder id and codec required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	StreamCodec codec;
+	const std::string name = info[1].As<Napi::String>().Utf8Value();
+	if (name == "mp3") codec = StreamCodec::Mp3;
+	else if (name == "aac") codec = StreamCodec::Aac;
+	else if (name == "opus") codec = StreamCodec::Opus;
+	else {
+		Napi::TypeError::New(env, "Codec must be 'mp3', 'aac' or 'opus'").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	uint32_t sampleRate = 24000;
+	if (info.Length() > 2 && info[2].IsObject()) {
+		std::string error;
+		if (!ReadUint32Option(info[2].As<Napi::Object>(), "sampleRate", 8000, 48000, &sampleRate, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+#if defined(AUDIO_CORE_AVCODEC)
+	auto decoder = std::make_unique<StreamDecoder>();
+	std::string error;
+	if (!decoder->Open(codec, sampleRate, &error)) {
+		Napi::Error::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	StreamDecoders(env)[info[0].As<Napi::String>().Utf8Value()] = std::move(decoder);
+	return env.Undefined();
+#else
+	(void)codec;
+	Napi::Error::New(env, "Stream decoding is not built in (use_avcodec=0)").ThrowAsJavaScriptException();
+	return env.Null();
+#endif
+}
+
+inline Napi::Value FeedStreamDecoder(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsString() || !info[1].IsBuffer()) {
+		Napi::TypeError::New(env, "Decoder id and bytes required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+#if defined(AUDIO_CORE_AVCODEC)
+	auto it = StreamDecoders(env).find(info[0].As<Napi::String>().Utf8Value());
+	if (it == StreamDecoders(env).end()) {
+		Napi::Error::New(env, "No such decoder").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Buffer<uint8_t> bytes = info[1].As<Napi::Buffer<uint8_t>>();
+	std::vector<int16_t> pcm;
+	std::string error;
+	if (!it->second->Feed(bytes.Data(), bytes.Length(), &pcm, &error)) {
+		Napi::Error::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	return Int16ArrayFrom(env, pcm);
+#else
+	Napi::Error::New(env, "Stream decoding is not built in (use_avcodec=0)").ThrowAsJavaScriptException();
+	return env.Null();
+#endif
+}
+
+inline Napi::Value CloseStreamDecoder(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Decoder id required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+#if defined(AUDIO_CORE_AVCODEC)
+	auto it = StreamDecoders(env).find(info[0].As<Napi::String>().Utf8Value());
+	if (it == StreamDecoders(env).end()) return env.Undefined();
+	std::unique_ptr<StreamDecoder> decoder = std::move(it->second);
+	StreamDecoders(env).erase(it);
+	std::vector<int16_t> pcm;
+	std::string error;
+	if (!decoder->Finish(&pcm, &error)) {
+		Napi::Error::New(env, error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	return Int16ArrayFrom(env, pcm);
+#else
+	return env.Undefined();
+#endif
+}
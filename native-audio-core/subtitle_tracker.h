@@ -0,0 +1,151 @@
+#pragma once
+
+// Where the text of a watched region actually is, learned over time, so the
+// watch box can OCR a band of it instead of the generous box a user draws
+// around video subtitles. Every check that finds text adds the rows it found
+// it on to a decaying histogram; once a few have, the band is the shortest
+// run of rows holding most of that text, plus a margin. Only rows that
+// changed are ever read, so static UI text in the box does not pull the band
+// toward it the way the captions do.
+//
+// A band that is too narrow shows itself two ways: text found touching its
+// edge (a taller caption, or one that moved a little), or nothing found in
+// it while text-like regions (text_regions.h) turned up in changes outside.
+// Either forgets the band and reads the whole height until it is learned
+// again, which is also how a caption that moved for good is found; and
+// every so often a check reads the whole height regardless.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct SubtitleTrackerConfig {
+	uint32_t binHeight = 8;    // pixels per histogram row
+	float decay = 0.9f;        // weight kept per check that found text
+	float coverage = 0.95f;    // of the weight the band must hold
+	uint32_t margin = 16;      // pixels added above and below
+	uint32_t minHeight = 48;   // pixels
+	uint32_t warmup = 3;       // checks with text before the band narrows
+	uint32_t probeEvery = 30;  // narrowed checks between whole-height ones, 0 never
+};
+
+struct RowSpan {
+	uint32_t y = 0, height = 0;
+};
+
+struct SubtitleTrackerStats {
+	uint64_t checks = 0;
+	uint64_t narrowed = 0; // checks that read less than the whole height
+	uint64_t misses = 0;
+	uint64_t rowsRead = 0, rowsTotal = 0; // over the checks so far
+};
+
+// JS thread only, one per watched region.
+class SubtitleTracker {
+public:
+	explicit SubtitleTracker(const SubtitleTrackerConfig& config = SubtitleTrackerConfig()) : config_(config) {
+		config_.binHeight = std::max<uint32_t>(1, config_.binHeight);
+	}
+
+	const SubtitleTrackerConfig& Config() const { return config_; }
+	const SubtitleTrackerStats& Stats() const { return stats_; }
+
+	void Reset() {
+		bins_.clear();
+		height_ = 0;
+		hits_ = 0;
+		sinceFull_ = 0;
+	}
+
+	// The rows to read this check; the whole height until the band is known
+	RowSpan Band(uint32_t frameHeight) {
+		Resize(frameHeight);
+		const RowSpan full{ 0, frameHeight };
+		if (hits_ < config_.warmup) return full;
+		if (config_.probeEvery && sinceFull_ >= config_.probeEvery) return full;
+
+		double total = 0;
+		for (float w : bins_) total += w;
+		if (total <= 0) return full;
+		// Shortest run of bins holding coverage of the weight
+		const double want = total * config_.coverage;
+		size_t bestLo = 0, bestHi = bins_.size();
+		double sum = 0;
+		for (size_t lo = 0, hi = 0; hi < bins_.size(); ++hi) {
+			sum += bins_[hi];
+			while (lo < hi && sum - bins_[lo] >= want) sum -= bins_[lo++];
+			if (sum >= want && hi + 1 - lo < bestHi - bestLo) {
+				bestLo = lo;
+				bestHi = hi + 1;
+			}
+		}
+		int64_t top = (int64_t)(bestLo * config_.binHeight) - config_.margin;
+		int64_t bottom = (int64_t)(bestHi * config_.binHeight) + config_.margin;
+		if (bottom - top < (int64_t)config_.minHeight) {
+			const int64_t grow = ((int64_t)config_.minHeight - (bottom - top) + 1) / 2;
+			top -= grow;
+			bottom += grow;
+		}
+		top = std::max<int64_t>(0, top);
+		bottom = std::min<int64_t>(frameHeight, bottom);
+		if (top == 0 && bottom == frameHeight) return full;
+		return { (uint32_t)top, (uint32_t)(bottom - top) };
+	}
+
+	// What a check found: the rows it read (as Band() returned them), the
+	// rows it found text on, and whether text-like regions turned up in
+	// changes outside the rows it read.
+	void Observe(uint32_t frameHeight, const RowSpan& read, const std::vector<RowSpan>& text, bool textOutside) {
+		Resize(frameHeight);
+		const bool full = read.y == 0 && read.height >= frameHeight;
+		++stats_.checks;
+		stats_.rowsRead += std::min(read.height, frameHeight);
+		stats_.rowsTotal += frameHeight;
+		if (full) {
+			sinceFull_ = 0;
+		} else {
+			++stats_.narrowed;
+			++sinceFull_;
+		}
+
+		if (!text.empty()) {
+			for (float& w : bins_) w *= config_.decay;
+			for (const RowSpan& s : text) {
+				const size_t first = std::min<size_t>(s.y / config_.binHeight, bins_.size());
+				const size_t end = std::min<size_t>((s.y + s.height + config_.binHeight - 1) / config_.binHeight, bins_.size());
+				for (size_t b = first; b < end; ++b) bins_[b] += 1.0f;
+			}
+			++hits_;
+		}
+		if (full) return;
+
+		bool miss = text.empty() && textOutside;
+		const uint32_t slack = config_.margin / 2;
+		const uint32_t readEnd = read.y + read.height;
+		for (const RowSpan& s : text) {
+			if (read.y > 0 && s.y <= read.y + slack) miss = true;
+			if (readEnd < frameHeight && s.y + s.height + slack >= readEnd) miss = true;
+		}
+		if (miss) {
+			++stats_.misses;
+			std::fill(bins_.begin(), bins_.end(), 0.0f);
+			hits_ = 0;
+		}
+	}
+
+private:
+	void Resize(uint32_t frameHeight) {
+		if (frameHeight == height_) return;
+		Reset();
+		height_ = frameHeight;
+		bins_.assign((frameHeight + config_.binHeight - 1) / config_.binHeight, 0.0f);
+	}
+
+	SubtitleTrackerConfig config_;
+	SubtitleTrackerStats stats_;
+	std::vector<float> bins_;
+	uint32_t height_ = 0;
+	uint32_t hits_ = 0;      // checks that found text
+	uint32_t sinceFull_ = 0; // narrowed checks since the last whole-height one
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+// JS side of the subtitle band tracker (subtitle_tracker.h):
+//
+//   new SubtitleTracker({ margin?, minHeight?, warmup?, probeEvery?, coverage?, decay? })
+//   band(frameHeight) -> { y, height, full }   rows to OCR this check
+//   observe(frameHeight, read, text, textOutside)
+//     read is the { y, height } band() returned, text the [{ y, height }]
+//     rows text was found on, textOutside whether text-like regions turned
+//     up in changes outside read
+//   reset()
+//   getStats() -> { checks, narrowed, misses, readRatio }
+
+#include <napi.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "capture_options.h"
+#include "subtitle_tracker.h"
+
+class SubtitleTrackerWrap : public Napi::ObjectWrap<SubtitleTrackerWrap> {
+public:
+	static void Init(Napi::Env env, Napi::Object exports) {
+		Napi::Function ctor = DefineClass(env, "SubtitleTracker", {
+			InstanceMethod("band", &SubtitleTrackerWrap::Band),
+			InstanceMethod("observe", &SubtitleTrackerWrap::Observe),
+			InstanceMethod("reset", &SubtitleTrackerWrap::Reset),
+			InstanceMethod("getStats", &SubtitleTrackerWrap::GetStats),
+		});
+		exports.Set("SubtitleTracker", ctor);
+	}
+
+	explicit SubtitleTrackerWrap(const Napi::CallbackInfo& info) : Napi::ObjectWrap<SubtitleTrackerWrap>(info) {
+		Napi::Env env = info.Env();
+		SubtitleTrackerConfig config;
+		if (info.Length() > 0 && info[0].IsObject()) {
+			Napi::Object obj = info[0].As<Napi::Object>();
+			std::string error;
+			if (!ReadUint32Option(obj, "margin", 0, 512, &config.margin, &error) ||
+			    !ReadUint32Option(obj, "minHeight", 8, 4096, &config.minHeight, &error) ||
+			    !ReadUint32Option(obj, "warmup", 1, 100, &config.warmup, &error) ||
+			    !ReadUint32Option(obj, "probeEvery", 0, 10000, &config.probeEvery, &error) ||
+			    !ReadFloatOption(obj, "coverage", 0.5f, 1.0f, &config.coverage, &error) ||
+			    !ReadFloatOption(obj, "decay", 0.5f, 1.0f, &config.decay, &error)) {
+				Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+				return;
+			}
+		}
+		tracker_ = SubtitleTracker(config);
+	}
+
+private:
+	static bool ReadSpan(const Napi::Value& v, RowSpan* out) {
+		if (!v.IsObject()) return false;
+		Napi::Object o = v.As<Napi::Object>();
+		Napi::Value y = o.Get("y"), h = o.Get("height");
+		if (!y.IsNumber() || !h.IsNumber()) return false;
+		out->y = (uint32_t)std::max(0.0, y.As<Napi::Number>().DoubleValue());
+		out->height = (uint32_t)std::max(0.0, h.As<Napi::Number>().DoubleValue());
+		return true;
+	}
+
+	Napi::Value Band(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		if (info.Length() < 1 || !info[0].IsNumber()) {
+			Napi::TypeError::New(env, "Frame height required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		const uint32_t height = info[0].As<Napi::Number>().Uint32Value();
+		const RowSpan band = tracker_.Band(height);
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("y", Napi::Number::New(env, band.y));
+		o.Set("height", Napi::Number::New(env, band.height));
+		o.Set("full", Napi::Boolean::New(env, band.y == 0 && band.height >= height));
+		return o;
+	}
+
+	Napi::Value Observe(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		RowSpan read;
+		if (info.Length() < 3 || !info[0].IsNumber() || !ReadSpan(info[1], &read) || !info[2].IsArray()) {
+			Napi::TypeError::New(env, "Frame height, read band and text rows required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		Napi::Array rows = info[2].As<Napi::Array>();
+		std::vector<RowSpan> text;
+		text.reserve(rows.Length());
+		for (uint32_t i = 0; i < rows.Length(); ++i) {
+			RowSpan s;
+			if (ReadSpan(rows.Get(i), &s) && s.height > 0) text.push_back(s);
+		}
+		const bool textOutside = info.Length() > 3 && info[3].IsBoolean() && info[3].As<Napi::Boolean>().Value();
+		tracker_.Observe(info[0].As<Napi::Number>().Uint32Value(), read, text, textOutside);
+		return env.Undefined();
+	}
+
+	Napi::Value Reset(const Napi::CallbackInfo& info) {
+		tracker_.Reset();
+		return info.Env().Undefined();
+	}
+
+	Napi::Value GetStats(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		const SubtitleTrackerStats& s = tracker_.Stats();
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("checks", Napi::Number::New(env, (double)s.checks));
+		o.Set("narrowed", Napi::Number::New(env, (double)s.narrowed));
+		o.Set("misses", Napi::Number::New(env, (double)s.misses));
+		o.Set("readRatio", Napi::Number::New(env, s.rowsTotal ? (double)s.rowsRead / (double)s.rowsTotal : 1.0));
+		return o;
+	}
+
+	SubtitleTracker tracker_;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+// Optional libswresample path for the capture addons (gyp variable
+// use_swresample=1, which defines AUDIO_CORE_SWRESAMPLE and links the vendored
+// ffmpeg/<platform> static libs). One persistent SwrContext per capture does
+// sample-format conversion, the downmix (with the DownmixPlan weights as its
+// matrix) and the 16 kHz SRC in a single call. Without the define Configure()
+// always fails and the addons keep DownmixPlan + PolyphaseResampler, which is
+// also the fallback for formats swresample has no sample format for (packed
+// 24-bit).
+
+#include <cstddef>
+#include <cstdint>
+
+#include "downmix.h"
+#include "resampler.h"
+
+#if defined(AUDIO_CORE_SWRESAMPLE)
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+#include <libavutil/samplefmt.h>
+#include <libswresample/swresample.h>
+}
+#endif
+
+class SwrConverter {
+public:
+	SwrConverter() = default;
+	SwrConverter(const SwrConverter&) = delete;
+	SwrConverter& operator=(const SwrConverter&) = delete;
+	~SwrConverter() { Close(); }
+
+#if defined(AUDIO_CORE_SWRESAMPLE)
+	// Builds the context for plan's sample type and channel weights. False (and
+	// inactive) when the format is unsupported or swresample refuses it.
+	bool Configure(const DownmixPlan& plan, uint32_t inRate, uint32_t outRate, ResamplerQuality quality) {
+		Close();
+		AVSampleFormat format;
+		switch (plan.type) {
+		case PcmSampleType::Float32: format = AV_SAMPLE_FMT_FLT; break;
+		case PcmSampleType::Int16: format = AV_SAMPLE_FMT_S16; break;
+		case PcmSampleType::Int24In32: // left-justified, reads as int32
+		case PcmSampleType::Int32: format = AV_SAMPLE_FMT_S32; break;
+		default: return false;
+		}
+		AVChannelLayout inLayout, outLayout = AV_CHANNEL_LAYOUT_MONO;
+		av_channel_layout_default(&inLayout, plan.channels);
+		SwrContext* ctx = nullptr;
+		if (swr_alloc_set_opts2(&ctx, &outLayout, AV_SAMPLE_FMT_FLT, (int)outRate, &inLayout, format, (int)inRate, 0, nullptr) < 0) return false;
+		ctx_ = ctx;
+
+		// Same trade-off as the polyphase filter (resampler.h)
+		static const int kFilterSize[] = { 8, 16, 32 };
+		static const double kCutoff[] = { 0.85, 0.90, 0.94 };
+		static const double kBeta[] = { 6.0, 8.6, 10.0 };
+		const int q = (int)quality;
+		av_opt_set_int(ctx_, "filter_type", SWR_FILTER_TYPE_KAISER, 0);
+		av_opt_set_int(ctx_, "filter_size", kFilterSize[q], 0);
+		av_opt_set_double(ctx_, "cutoff", kCutoff[q], 0);
+		av_opt_set_int(ctx_, "kaiser_beta", (int64_t)kBeta[q], 0);
+
+		double matrix[kMaxDownmixChannels] = {};
+		for (size_t c = 0; c < plan.channels && c < kMaxDownmixChannels; ++c) matrix[c] = plan.weights[c];
+		if (plan.channels > kMaxDownmixChannels || swr_set_matrix(ctx_, matrix, plan.channels) < 0 || swr_init(ctx_) < 0) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	bool Active() const { return ctx_ != nullptr; }
+
+	// Converts frames of interleaved src into up to capacity mono float samples
+	// at the output rate; whatever doesn't fit stays buffered for the next call.
+	size_t Process(const void* src, size_t frames, float* out, size_t capacity) {
+		const uint8_t* in[1] = { static_cast<const uint8_t*>(src) };
+		uint8_t* dst[1] = { reinterpret_cast<uint8_t*>(out) };
+		const int produced = swr_convert(ctx_, dst, (int)capacity, in, (int)frames);
+		return produced > 0 ? (size_t)produced : 0;
+	}
+
+	void Close() {
+		if (ctx_) swr_free(&ctx_);
+	}
+
+private:
+	SwrContext* ctx_ = nullptr;
+#else
+	bool Configure(const DownmixPlan&, uint32_t, uint32_t, ResamplerQuality) { return false; }
+	bool Active() const { return false; }
+	size_t Process(const void*, size_t, float*, size_t) { return 0; }
+	void Close() {}
+#endif
+};
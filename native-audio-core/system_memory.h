@@ -0,0 +1,83 @@
+#pragma once
+
+// Physical memory of the machine and of this process, for choosing model
+// variants that fit (a quantized Whisper file, an int8 translation model) and
+// for reporting what each resident model costs. GlobalMemoryStatusEx and the
+// working set on Windows; hw.memsize, the VM page counts and the task's
+// resident size on macOS; /proc elsewhere.
+
+#include <cstdint>
+#include <cstdio>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/sysctl.h>
+#else
+#include <unistd.h>
+#endif
+
+struct SystemMemory {
+	double totalMb = 0;
+	double availableMb = 0; // free now without paging anything out
+};
+
+inline SystemMemory ReadSystemMemory() {
+	SystemMemory m;
+#if defined(_WIN32)
+	const double kMb = 1024.0 * 1024.0;
+	MEMORYSTATUSEX status = {};
+	status.dwLength = sizeof(status);
+	if (GlobalMemoryStatusEx(&status)) {
+		m.totalMb = status.ullTotalPhys / kMb;
+		m.availableMb = status.ullAvailPhys / kMb;
+	}
+#elif defined(__APPLE__)
+	const double kMb = 1024.0 * 1024.0;
+	uint64_t total = 0;
+	size_t size = sizeof(total);
+	if (sysctlbyname("hw.memsize", &total, &size, nullptr, 0) == 0) m.totalMb = total / kMb;
+	vm_statistics64_data_t vm;
+	mach_msg_type_number_t count = HOST_VM_INFO64_COUNT;
+	if (host_statistics64(mach_host_self(), HOST_VM_INFO64, reinterpret_cast<host_info64_t>(&vm), &count) == KERN_SUCCESS) {
+		// Inactive and purgeable pages are handed out before anything swaps
+		m.availableMb = (double)(vm.free_count + vm.inactive_count + vm.purgeable_count) * vm_page_size / kMb;
+	}
+#else
+	if (FILE* f = fopen("/proc/meminfo", "r")) {
+		char line[128];
+		unsigned long long kb = 0;
+		while (fgets(line, sizeof(line), f)) {
+			if (sscanf(line, "MemTotal: %llu kB", &kb) == 1) m.totalMb = kb / 1024.0;
+			else if (sscanf(line, "MemAvailable: %llu kB", &kb) == 1) m.availableMb = kb / 1024.0;
+		}
+		fclose(f);
+	}
+#endif
+	return m;
+}
+
+// This process's resident memory (the working set on Windows), in MB.
+inline double ProcessResidentMb() {
+	const double kMb = 1024.0 * 1024.0;
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return counters.WorkingSetSize / kMb;
+	return 0;
+#elif defined(__APPLE__)
+	mach_task_basic_info_data_t info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) return 0;
+	return info.resident_size / kMb;
+#else
+	long pages = 0;
+	if (FILE* f = fopen("/proc/self/statm", "r")) {
+		long size = 0;
+		if (fscanf(f, "%ld %ld", &size, &pages) != 2) pages = 0;
+		fclose(f);
+	}
+	return (double)pages * sysconf(_SC_PAGESIZE) / kMb;
+#endif
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+// The addon's one pool of threads for work off the real-time path: encodes,
+// OCR preprocessing, fingerprinting, model loads, enumerations - everything
+// QueueQuery (async_query.h) runs, instead of each feature starting threads
+// of its own next to Chromium and the Python workers.
+//
+// Half the cores, two to eight workers, each with a deque per priority. A
+// worker takes its own newest task first and, with none left, steals the
+// oldest from another worker, highest priority first. Tasks submitted from
+// outside the pool are dealt to the workers in turn. Per priority:
+//
+//   interactive - what a user is waiting on (enumerations, start / stop,
+//                 history reads); may use every worker
+//   normal      - model loads and inference; all workers but one, so a run
+//                 of long loads never holds up an interactive query
+//   background  - encodes and image preprocessing; half the workers, at
+//                 utility QoS (thread_schedule.h)
+//
+// getStats().pool reports each queue's backlog, completions and the time its
+// tasks waited before a worker picked them up.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "latency_histogram.h"
+#include "thread_cpu.h"
+#include "thread_schedule.h"
+
+enum class TaskPriority { Interactive, Normal, Background, kCount };
+
+inline const char* TaskPriorityName(TaskPriority priority) {
+	switch (priority) {
+	case TaskPriority::Interactive: return "interactive";
+	case TaskPriority::Normal: return "normal";
+	default: return "background";
+	}
+}
+
+struct TaskQueueStats {
+	uint64_t queued = 0;    // waiting now
+	uint64_t running = 0;
+	uint64_t completed = 0;
+	uint32_t limit = 0;     // workers it may use at once
+	LatencySummary wait;    // submission to start
+};
+
+struct TaskPoolStats {
+	uint32_t workers = 0;
+	uint64_t steals = 0;
+	TaskQueueStats queues[(size_t)TaskPriority::kCount];
+};
+
+class TaskPool {
+public:
+	using Task = std::function<void()>;
+	static constexpr size_t kPriorities = (size_t)TaskPriority::kCount;
+
+	// Any thread; starts the workers on first use.
+	void Submit(TaskPriority priority, Task task) {
+		std::call_once(started_, [this] { Start(); });
+		const size_t p = (size_t)priority;
+		Worker* target = CurrentWorker();
+		if (!target || target->pool != this) target = workers_[next_.fetch_add(1, std::memory_order_relaxed) % workers_.size()].get();
+		{
+			std::lock_guard<std::mutex> lock(target->mutex);
+			target->queues[p].push_back(Item{ std::move(task), NowNs() });
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex_);
+			++pending_[p];
+		}
+		wake_.notify_one();
+	}
+
+	TaskPoolStats Stats() {
+		std::call_once(started_, [this] { Start(); });
+		TaskPoolStats s;
+		s.workers = (uint32_t)workers_.size();
+		s.steals = steals_.load(std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(sleepMutex_);
+		for (size_t p = 0; p < kPriorities; ++p) {
+			TaskQueueStats& q = s.queues[p];
+			q.queued = pending_[p];
+			q.running = running_[p];
+			q.completed = completed_[p];
+			q.limit = limit_[p];
+			q.wait = wait_[p].Summary();
+		}
+		return s;
+	}
+
+private:
+	struct Item {
+		Task task;
+		uint64_t queuedNs = 0;
+	};
+
+	struct Worker {
+		TaskPool* pool = nullptr;
+		std::mutex mutex; // queues
+		std::deque<Item> queues[kPriorities];
+	};
+
+	static Worker*& CurrentWorker() {
+		static thread_local Worker* worker = nullptr;
+		return worker;
+	}
+
+	static uint64_t NowNs() {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// The workers live as long as the process, like the pool.
+	void Start() {
+		const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+		const uint32_t count = std::min(8u, std::max(2u, cores / 2));
+		limit_[(size_t)TaskPriority::Interactive] = count;
+		limit_[(size_t)TaskPriority::Normal] = count - 1;
+		limit_[(size_t)TaskPriority::Background] = std::max(1u, count / 2);
+		for (uint32_t i = 0; i < count; ++i) {
+			workers_.push_back(std::make_unique<Worker>());
+			workers_.back()->pool = this;
+		}
+		for (uint32_t i = 0; i < count; ++i) std::thread([this, i] { Run(i); }).detach();
+	}
+
+	void Run(size_t self) {
+		ThreadCpuScope cpu("pool");
+		CurrentWorker() = workers_[self].get();
+		for (;;) {
+			Item item;
+			size_t p = 0;
+			{
+				std::unique_lock<std::mutex> lock(sleepMutex_);
+				wake_.wait(lock, [this, &p] { return Claim(&p); });
+			}
+			if (!Pop(self, p, &item)) {
+				// Another worker took it between the claim and here
+				std::lock_guard<std::mutex> lock(sleepMutex_);
+				++pending_[p];
+				--running_[p];
+				continue;
+			}
+			const uint64_t waited = NowNs() - item.queuedNs;
+			if (p == (size_t)TaskPriority::Background) {
+				ThreadQosScope qos(ThreadQos::Utility);
+				item.task();
+			} else {
+				item.task();
+			}
+			item.task = nullptr; // whatever it captured goes before the next wait
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex_);
+				wait_[p].Record(waited);
+				--running_[p];
+				++completed_[p];
+			}
+			wake_.notify_one();
+		}
+	}
+
+	// sleepMutex_ held: takes the highest priority with a task waiting and a
+	// worker to spare.
+	bool Claim(size_t* priority) {
+		for (size_t p = 0; p < kPriorities; ++p) {
+			if (pending_[p] == 0 || running_[p] >= limit_[p]) continue;
+			--pending_[p];
+			++running_[p];
+			*priority = p;
+			return true;
+		}
+		return false;
+	}
+
+	// A claimed task: this worker's newest, or another's oldest.
+	bool Pop(size_t self, size_t p, Item* out) {
+		{
+			Worker& own = *workers_[self];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.queues[p].empty()) {
+				*out = std::move(own.queues[p].back());
+				own.queues[p].pop_back();
+				return true;
+			}
+		}
+		for (size_t i = 1; i < workers_.size(); ++i) {
+			Worker& other = *workers_[(self + i) % workers_.size()];
+			std::lock_guard<std::mutex> lock(other.mutex);
+			if (other.queues[p].empty()) continue;
+			*out = std::move(other.queues[p].front());
+			other.queues[p].pop_front();
+			steals_.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+	std::once_flag started_;
+	std::vector<std::unique_ptr<Worker>> workers_; // fixed once started
+	std::atomic<uint64_t> next_{0};
+	std::atomic<uint64_t> steals_{0};
+	std::mutex sleepMutex_; // everything below
+	std::condition_variable wake_;
+	uint64_t pending_[kPriorities] = {};
+	uint64_t running_[kPriorities] = {};
+	uint64_t completed_[kPriorities] = {};
+	uint32_t limit_[kPriorities] = {};
+	LatencyHistogram wait_[kPriorities];
+};
+
+inline TaskPool& AddonTaskPool() {
+	static TaskPool* pool = new TaskPool(); // never destroyed: its workers are detached
+	return *pool;
+}
+
+// getStats().pool: { workers, steals, interactive, normal, background }, each
+// queue { queued, running, completed, limit, wait: { count, meanUs, p50Us, p99Us, maxUs } }.
+inline Napi::Object TaskPoolStatsToJs(Napi::Env env) {
+	const TaskPoolStats s = AddonTaskPool().Stats();
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("workers", Napi::Number::New(env, s.workers));
+	o.Set("steals", Napi::Number::New(env, (double)s.steals));
+	for (size_t p = 0; p < TaskPool::kPriorities; ++p) {
+		const TaskQueueStats& q = s.queues[p];
+		Napi::Object queue = Napi::Object::New(env);
+		queue.Set("queued", Napi::Number::New(env, (double)q.queued));
+		queue.Set("running", Napi::Number::New(env, (double)q.running));
+		queue.Set("completed", Napi::Number::New(env, (double)q.completed));
+		queue.Set("limit", Napi::Number::New(env, q.limit));
+		Napi::Object wait = Napi::Object::New(env);
+		wait.Set("count", Napi::Number::New(env, (double)q.wait.count));
+		wait.Set("meanUs", Napi::Number::New(env, q.wait.meanUs));
+		wait.Set("p50Us", Napi::Number::New(env, q.wait.p50Us));
+		wait.Set("p99Us", Napi::Number::New(env, q.wait.p99Us));
+		wait.Set("maxUs", Napi::Number::New(env, q.wait.maxUs));
+		queue.Set("wait", wait);
+		o.Set(TaskPriorityName((TaskPriority)p), queue);
+	}
+	return o;
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+// Text-region proposals for OCR (region_capture.h's findTextRegions): finds
+// the rectangles of a gray8 frame that probably hold text, so the OCR engine
+// reads those instead of the whole watched box when most of it is video,
+// photos or flat UI. The frame is cut into 8x8 cells and each cell counts
+// its strong horizontal and vertical intensity steps (|dx|, |dy| above a
+// threshold), sixteen pixels at a time with SSE2/NEON. Glyph strokes give a
+// cell a moderate density of both; flat areas have almost none, and photo
+// texture or noise either lacks one direction or has far too many. Text
+// cells are joined along rows across small gaps (letter and word spacing),
+// grouped into 4-connected components, filtered by size and fill, and
+// returned as padded, merged pixel rectangles.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "simd.h"
+#include "tile_hash.h"
+
+struct TextRegionConfig {
+	uint32_t cropX = 0, cropY = 0, cropWidth = 0, cropHeight = 0; // 0 width/height: the whole frame
+	uint8_t edgeThreshold = 40;  // |step| counted as an edge
+	float minDensity = 0.04f;    // per direction, share of a cell's pixels
+	float maxDensity = 0.45f;    // both directions together
+	uint32_t joinCells = 2;      // row gaps of at most this many cells are bridged
+	uint32_t padding = 4;        // pixels added around each rectangle
+	uint32_t minWidth = 16, minHeight = 8; // pixels, before padding
+};
+
+constexpr uint32_t kTextCell = 8;
+
+// Edges in the 16 pixels from x, split into the two 8-pixel cells they span;
+// dx compares with the next pixel, dy with the row below.
+inline void CountTextEdges16(const uint8_t* row, const uint8_t* below, uint8_t threshold,
+                             uint32_t* dx0, uint32_t* dx1, uint32_t* dy0, uint32_t* dy1) {
+#if defined(AUDIO_CORE_SSE)
+	const __m128i t = _mm_set1_epi8((char)threshold);
+	const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row));
+	const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 1));
+	const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below));
+	const __m128i zero = _mm_setzero_si128();
+	// |a - c| > t as (|a - c| -sat t) != 0
+	const __m128i ex = _mm_subs_epu8(_mm_or_si128(_mm_subs_epu8(a, r), _mm_subs_epu8(r, a)), t);
+	const __m128i ey = _mm_subs_epu8(_mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)), t);
+	const uint32_t mx = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ex, zero)) & 0xffff;
+	const uint32_t my = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ey, zero)) & 0xffff;
+	auto bits = [](uint32_t v) {
+		v = v - ((v >> 1) & 0x55);
+		v = (v & 0x33) + ((v >> 2) & 0x33);
+		return (v + (v >> 4)) & 0x0f;
+	};
+	*dx0 += bits(mx & 0xff);
+	*dx1 += bits(mx >> 8);
+	*dy0 += bits(my & 0xff);
+	*dy1 += bits(my >> 8);
+#elif defined(AUDIO_CORE_NEON)
+	const uint8x16_t t = vdupq_n_u8(threshold);
+	const uint8x16_t a = vld1q_u8(row);
+	const uint8x16_t ex = vshrq_n_u8(vcgtq_u8(vabdq_u8(a, vld1q_u8(row + 1)), t), 7);
+	const uint8x16_t ey = vshrq_n_u8(vcgtq_u8(vabdq_u8(a, vld1q_u8(below)), t), 7);
+	const uint64x2_t cx = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(ex)));
+	const uint64x2_t cy = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(ey)));
+	*dx0 += (uint32_t)vgetq_lane_u64(cx, 0);
+	*dx1 += (uint32_t)vgetq_lane_u64(cx, 1);
+	*dy0 += (uint32_t)vgetq_lane_u64(cy, 0);
+	*dy1 += (uint32_t)vgetq_lane_u64(cy, 1);
+#else
+	for (int i = 0; i < 16; ++i) {
+		const bool ex = std::abs((int)row[i] - (int)row[i + 1]) > threshold;
+		const bool ey = std::abs((int)row[i] - (int)below[i]) > threshold;
+		*(i < 8 ? dx0 : dx1) += ex;
+		*(i < 8 ? dy0 : dy1) += ey;
+	}
+#endif
+}
+
+class TextRegionFinder {
+public:
+	// gray holds height rows of stride bytes. Rectangles are in frame pixels.
+	void Find(const uint8_t* gray, uint32_t width, uint32_t height, size_t stride, const TextRegionConfig& config,
+	          std::vector<TileRect>* out) {
+		out->clear();
+		const uint32_t x0 = std::min(config.cropX, width), y0 = std::min(config.cropY, height);
+		const uint32_t w = std::min(config.cropWidth ? config.cropWidth : width, width - x0);
+		const uint32_t h = std::min(config.cropHeight ? config.cropHeight : height, height - y0);
+		if (w < 2 || h < 2) return;
+		cols_ = (w + kTextCell - 1) / kTextCell;
+		rows_ = (h + kTextCell - 1) / kTextCell;
+		CountEdges(gray + (size_t)y0 * stride + x0, w, h, stride, config.edgeThreshold);
+		Classify(w, h, config);
+		Join(config.joinCells);
+		Components(x0, y0, w, h, config, out);
+		Merge(out);
+	}
+
+private:
+	void CountEdges(const uint8_t* origin, uint32_t w, uint32_t h, size_t stride, uint8_t threshold) {
+		dx_.assign((size_t)cols_ * rows_, 0);
+		dy_.assign((size_t)cols_ * rows_, 0);
+		// The last column has no right neighbour and the last row none below
+		for (uint32_t y = 0; y + 1 < h; ++y) {
+			const uint8_t* row = origin + (size_t)y * stride;
+			const uint8_t* below = row + stride;
+			uint32_t* dx = &dx_[(size_t)(y / kTextCell) * cols_];
+			uint32_t* dy = &dy_[(size_t)(y / kTextCell) * cols_];
+			uint32_t x = 0;
+			for (; x + 16 < w; x += 16) {
+				const uint32_t cell = x / kTextCell;
+				CountTextEdges16(row + x, below + x, threshold, &dx[cell], &dx[cell + 1], &dy[cell], &dy[cell + 1]);
+			}
+			for (; x + 1 < w; ++x) {
+				dx[x / kTextCell] += std::abs((int)row[x] - (int)row[x + 1]) > threshold;
+				dy[x / kTextCell] += std::abs((int)row[x] - (int)below[x]) > threshold;
+			}
+		}
+	}
+
+	void Classify(uint32_t w, uint32_t h, const TextRegionConfig& config) {
+		text_.assign((size_t)cols_ * rows_, 0);
+		for (uint32_t r = 0; r < rows_; ++r) {
+			const uint32_t ch = std::min(kTextCell, h - r * kTextCell);
+			for (uint32_t c = 0; c < cols_; ++c) {
+				const uint32_t cw = std::min(kTextCell, w - c * kTextCell);
+				const float n = (float)(cw * ch);
+				const size_t i = (size_t)r * cols_ + c;
+				const float dx = dx_[i] / n, dy = dy_[i] / n;
+				text_[i] = dx >= config.minDensity && dy >= config.minDensity && dx + dy <= 2.0f * config.maxDensity;
+			}
+		}
+	}
+
+	// Bridges gaps of up to `cells` non-text cells between text cells of a row.
+	void Join(uint32_t cells) {
+		for (uint32_t r = 0; r < rows_; ++r) {
+			uint8_t* row = &text_[(size_t)r * cols_];
+			uint32_t last = cols_;
+			for (uint32_t c = 0; c < cols_; ++c) {
+				if (!row[c]) continue;
+				if (last != cols_ && c - last - 1 <= cells) std::fill(row + last + 1, row + c, (uint8_t)2);
+				last = c;
+			}
+		}
+	}
+
+	void Components(uint32_t x0, uint32_t y0, uint32_t w, uint32_t h, const TextRegionConfig& config, std::vector<TileRect>* out) {
+		label_.assign(text_.size(), 0);
+		stack_.clear();
+		uint32_t next = 0;
+		for (size_t seed = 0; seed < text_.size(); ++seed) {
+			if (!text_[seed] || label_[seed]) continue;
+			label_[seed] = ++next;
+			stack_.push_back((uint32_t)seed);
+			uint32_t minC = cols_, minR = rows_, maxC = 0, maxR = 0, cells = 0, strong = 0;
+			while (!stack_.empty()) {
+				const uint32_t i = stack_.back();
+				stack_.pop_back();
+				const uint32_t r = i / cols_, c = i % cols_;
+				++cells;
+				strong += text_[i] == 1;
+				minC = std::min(minC, c);
+				maxC = std::max(maxC, c);
+				minR = std::min(minR, r);
+				maxR = std::max(maxR, r);
+				auto visit = [&](uint32_t j) {
+					if (text_[j] && !label_[j]) {
+						label_[j] = next;
+						stack_.push_back(j);
+					}
+				};
+				if (c > 0) visit(i - 1);
+				if (c + 1 < cols_) visit(i + 1);
+				if (r > 0) visit(i - cols_);
+				if (r + 1 < rows_) visit(i + cols_);
+			}
+			// Lone cells and sparse scatter (texture that passed the density test) are dropped
+			const uint32_t area = (maxC - minC + 1) * (maxR - minR + 1);
+			if (strong < 2 || cells * 3 < area) continue;
+			const uint32_t left = minC * kTextCell, top = minR * kTextCell;
+			const uint32_t right = std::min(w, (maxC + 1) * kTextCell), bottom = std::min(h, (maxR + 1) * kTextCell);
+			if (right - left < config.minWidth || bottom - top < config.minHeight) continue;
+			TileRect rect;
+			rect.x = x0 + (left > config.padding ? left - config.padding : 0);
+			rect.y = y0 + (top > config.padding ? top - config.padding : 0);
+			rect.width = std::min(x0 + w, x0 + right + config.padding) - rect.x;
+			rect.height = std::min(y0 + h, y0 + bottom + config.padding) - rect.y;
+			out->push_back(rect);
+		}
+	}
+
+	// Unions rectangles that overlap (padding can make neighbours touch) until none do.
+	static void Merge(std::vector<TileRect>* rects) {
+		for (bool merged = true; merged;) {
+			merged = false;
+			for (size_t i = 0; i < rects->size() && !merged; ++i) {
+				for (size_t j = i + 1; j < rects->size(); ++j) {
+					TileRect& a = (*rects)[i];
+					const TileRect& b = (*rects)[j];
+					if (a.x >= b.x + b.width || b.x >= a.x + a.width || a.y >= b.y + b.height || b.y >= a.y + a.height) continue;
+					const uint32_t right = std::max(a.x + a.width, b.x + b.width), bottom = std::max(a.y + a.height, b.y + b.height);
+					a.x = std::min(a.x, b.x);
+					a.y = std::min(a.y, b.y);
+					a.width = right - a.x;
+					a.height = bottom - a.y;
+					rects->erase(rects->begin() + (ptrdiff_t)j);
+					merged = true;
+					break;
+				}
+			}
+		}
+		// Reading order: top to bottom, then left to right
+		std::sort(rects->begin(), rects->end(), [](const TileRect& a, const TileRect& b) {
+			return a.y != b.y ? a.y < b.y : a.x < b.x;
+		});
+	}
+
+	uint32_t cols_ = 0, rows_ = 0;
+	std::vector<uint32_t> dx_, dy_, label_, stack_;
+	std::vector<uint8_t> text_; // 1 text cell, 2 bridged gap
+};
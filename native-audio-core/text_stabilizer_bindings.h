@@ -0,0 +1,119 @@
+#pragma once
+
+// JS side of the OCR line stabilizer (ocr_text_stabilizer.h):
+//
+//   new TextStabilizer({ window?, minVotes?, similarity?, maxMissed? })
+//   observe(lines, observed?) -> [{ line, text, x, y, width, height }]
+//     lines are one recognition's [{ text, x, y, width, height }]; observed
+//     lists the { y, height } bands it covered, all of the region when absent.
+//     Returns the lines that settled on new text, top to bottom.
+//   reset()
+//   lines - how many lines are being followed
+
+#include <napi.h>
+
+#include <string>
+#include <vector>
+
+#include "capture_options.h"
+#include "ocr_text_stabilizer.h"
+
+class TextStabilizerWrap : public Napi::ObjectWrap<TextStabilizerWrap> {
+public:
+	static void Init(Napi::Env env, Napi::Object exports) {
+		Napi::Function ctor = DefineClass(env, "TextStabilizer", {
+			InstanceMethod("observe", &TextStabilizerWrap::Observe),
+			InstanceMethod("reset", &TextStabilizerWrap::Reset),
+			InstanceAccessor("lines", &TextStabilizerWrap::LineCount, nullptr),
+		});
+		exports.Set("TextStabilizer", ctor);
+	}
+
+	explicit TextStabilizerWrap(const Napi::CallbackInfo& info) : Napi::ObjectWrap<TextStabilizerWrap>(info) {
+		Napi::Env env = info.Env();
+		TextStabilizerConfig config;
+		if (info.Length() > 0 && info[0].IsObject()) {
+			Napi::Object obj = info[0].As<Napi::Object>();
+			std::string error;
+			if (!ReadUint32Option(obj, "window", 1, 16, &config.window, &error) ||
+			    !ReadUint32Option(obj, "minVotes", 1, 16, &config.minVotes, &error) ||
+			    !ReadFloatOption(obj, "similarity", 0.0f, 1.0f, &config.similarity, &error) ||
+			    !ReadUint32Option(obj, "maxMissed", 0, 64, &config.maxMissed, &error)) {
+				Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+				return;
+			}
+			if (config.minVotes > config.window) {
+				Napi::TypeError::New(env, "Option 'minVotes' must not exceed 'window'").ThrowAsJavaScriptException();
+				return;
+			}
+		}
+		stabilizer_ = OcrTextStabilizer(config);
+	}
+
+private:
+	static float NumberField(const Napi::Object& o, const char* key) {
+		Napi::Value v = o.Get(key);
+		return v.IsNumber() ? v.As<Napi::Number>().FloatValue() : 0.0f;
+	}
+
+	Napi::Value Observe(const Napi::CallbackInfo& info) {
+		Napi::Env env = info.Env();
+		if (info.Length() < 1 || !info[0].IsArray()) {
+			Napi::TypeError::New(env, "Lines array required").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		Napi::Array in = info[0].As<Napi::Array>();
+		std::vector<OcrLineBox> lines;
+		lines.reserve(in.Length());
+		for (uint32_t i = 0; i < in.Length(); ++i) {
+			Napi::Value v = in.Get(i);
+			if (!v.IsObject() || !v.As<Napi::Object>().Get("text").IsString()) {
+				Napi::TypeError::New(env, "Each line needs text and a box").ThrowAsJavaScriptException();
+				return env.Null();
+			}
+			Napi::Object o = v.As<Napi::Object>();
+			OcrLineBox line;
+			line.text = o.Get("text").As<Napi::String>().Utf16Value();
+			line.x = NumberField(o, "x");
+			line.y = NumberField(o, "y");
+			line.width = NumberField(o, "width");
+			line.height = NumberField(o, "height");
+			lines.push_back(std::move(line));
+		}
+		std::vector<ObservedSpan> spans;
+		const bool partial = info.Length() > 1 && info[1].IsArray();
+		if (partial) {
+			Napi::Array observed = info[1].As<Napi::Array>();
+			for (uint32_t i = 0; i < observed.Length(); ++i) {
+				Napi::Value v = observed.Get(i);
+				if (!v.IsObject()) continue;
+				spans.push_back({ NumberField(v.As<Napi::Object>(), "y"), NumberField(v.As<Napi::Object>(), "height") });
+			}
+		}
+
+		const std::vector<StableLine> stable = stabilizer_.Observe(lines, partial ? &spans : nullptr);
+		Napi::Array out = Napi::Array::New(env, stable.size());
+		for (size_t i = 0; i < stable.size(); ++i) {
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("line", Napi::Number::New(env, stable[i].line));
+			o.Set("text", Napi::String::New(env, stable[i].text));
+			o.Set("x", Napi::Number::New(env, stable[i].x));
+			o.Set("y", Napi::Number::New(env, stable[i].y));
+			o.Set("width", Napi::Number::New(env, stable[i].width));
+			o.Set("height", Napi::Number::New(env, stable[i].height));
+			out.Set((uint32_t)i, o);
+		}
+		return out;
+	}
+
+	Napi::Value Reset(const Napi::CallbackInfo& info) {
+		stabilizer_.Reset();
+		return info.Env().Undefined();
+	}
+
+	Napi::Value LineCount(const Napi::CallbackInfo& info) {
+		return Napi::Number::New(info.Env(), (double)stabilizer_.Lines());
+	}
+
+	OcrTextStabilizer stabilizer_;
+};
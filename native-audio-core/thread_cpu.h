@@ -0,0 +1,191 @@
+#pragma once
+
+// CPU time of the addon's own threads, for telling our native load apart from
+// Chromium's and the Python workers' when users report high CPU. A thread
+// registers itself for its lifetime with a ThreadCpuScope naming its role
+// (capture, worker, recorder, ...); getThreadStats() and getStats().threads
+// read each registered thread's accumulated user and kernel time -
+// GetThreadTimes (plus QueryThreadCycleTime's cycle count) on Windows,
+// thread_info(THREAD_BASIC_INFO) on macOS, the thread CPU clock elsewhere -
+// and its share of one core over the last few seconds. The task pool's
+// workers are listed as 'pool'; threads on the libuv threadpool and those
+// libraries start for themselves (the HAL's IO threads, whisper.cpp's compute
+// threads) are not ours and are not listed.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+struct ThreadCpuSample {
+	std::string name;
+	uint64_t userNs = 0;
+	uint64_t kernelNs = 0;     // 0 where the platform does not separate them
+	uint64_t cpuNs = 0;        // user + kernel
+	uint64_t cycles = 0;       // Windows only
+	double percent = 0.0;      // of one core, over the window (or since the thread started)
+	double windowMs = 0.0;     // what percent covers
+};
+
+class ThreadCpuRegistry {
+public:
+	static constexpr uint64_t kWindowNs = 5000000000ull;
+
+	// The calling thread, until Remove(); returns its id.
+	uint64_t Add(const char* name) {
+		auto entry = std::make_unique<Entry>();
+		entry->name = name;
+#if defined(_WIN32)
+		DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &entry->thread,
+		                THREAD_QUERY_LIMITED_INFORMATION, FALSE, 0);
+#elif defined(__APPLE__)
+		entry->thread = mach_thread_self();
+#else
+		if (pthread_getcpuclockid(pthread_self(), &entry->clock) != 0) entry->clock = CLOCK_THREAD_CPUTIME_ID;
+#endif
+		Times times;
+		Read(*entry, &times);
+		entry->history.push_back({ NowNs(), times.userNs + times.kernelNs });
+		std::lock_guard<std::mutex> lock(mutex_);
+		entry->id = ++nextId_;
+		const uint64_t id = entry->id;
+		entries_.push_back(std::move(entry));
+		return id;
+	}
+
+	void Remove(uint64_t id) {
+		std::unique_ptr<Entry> removed;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = std::find_if(entries_.begin(), entries_.end(), [id](const std::unique_ptr<Entry>& e) { return e->id == id; });
+			if (it == entries_.end()) return;
+			removed = std::move(*it);
+			entries_.erase(it);
+		}
+#if defined(_WIN32)
+		if (removed->thread) CloseHandle(removed->thread);
+#elif defined(__APPLE__)
+		mach_port_deallocate(mach_task_self(), removed->thread);
+#endif
+	}
+
+	// Any thread (the JS thread, in practice). Each call also advances the
+	// sliding window the percentages are taken over.
+	std::vector<ThreadCpuSample> Sample() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		const uint64_t now = NowNs();
+		std::vector<ThreadCpuSample> out;
+		out.reserve(entries_.size());
+		for (const std::unique_ptr<Entry>& entry : entries_) {
+			Times times;
+			Read(*entry, &times);
+			ThreadCpuSample s;
+			s.name = entry->name;
+			s.userNs = times.userNs;
+			s.kernelNs = times.kernelNs;
+			s.cpuNs = times.userNs + times.kernelNs;
+			s.cycles = times.cycles;
+			// The oldest point still inside the window, or the newest before it
+			std::deque<Point>& history = entry->history;
+			while (history.size() > 1 && history[1].wallNs + kWindowNs <= now) history.pop_front();
+			const Point& from = history.front();
+			if (now > from.wallNs) {
+				s.windowMs = (double)(now - from.wallNs) / 1e6;
+				s.percent = 100.0 * (double)(s.cpuNs - std::min(s.cpuNs, from.cpuNs)) / (double)(now - from.wallNs);
+			}
+			if (history.back().wallNs < now) history.push_back({ now, s.cpuNs });
+			out.push_back(std::move(s));
+		}
+		return out;
+	}
+
+private:
+	struct Point {
+		uint64_t wallNs;
+		uint64_t cpuNs;
+	};
+
+	struct Entry {
+		uint64_t id = 0;
+		std::string name;
+#if defined(_WIN32)
+		HANDLE thread = nullptr;
+#elif defined(__APPLE__)
+		mach_port_t thread = MACH_PORT_NULL;
+#else
+		clockid_t clock = CLOCK_THREAD_CPUTIME_ID;
+#endif
+		std::deque<Point> history; // registry mutex
+	};
+
+	struct Times {
+		uint64_t userNs = 0;
+		uint64_t kernelNs = 0;
+		uint64_t cycles = 0;
+	};
+
+	static uint64_t NowNs() {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static void Read(const Entry& entry, Times* times) {
+#if defined(_WIN32)
+		FILETIME created, exited, kernel, user;
+		if (entry.thread && GetThreadTimes(entry.thread, &created, &exited, &kernel, &user)) {
+			// FILETIME counts 100 ns
+			times->userNs = (((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime) * 100;
+			times->kernelNs = (((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) * 100;
+		}
+		ULONG64 cycles = 0;
+		if (entry.thread && QueryThreadCycleTime(entry.thread, &cycles)) times->cycles = cycles;
+#elif defined(__APPLE__)
+		thread_basic_info_data_t info;
+		mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+		if (thread_info(entry.thread, THREAD_BASIC_INFO, (thread_info_t)&info, &count) == KERN_SUCCESS) {
+			times->userNs = (uint64_t)info.user_time.seconds * 1000000000ull + (uint64_t)info.user_time.microseconds * 1000ull;
+			times->kernelNs = (uint64_t)info.system_time.seconds * 1000000000ull + (uint64_t)info.system_time.microseconds * 1000ull;
+		}
+#else
+		timespec ts;
+		if (clock_gettime(entry.clock, &ts) == 0) times->userNs = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+	}
+
+	std::mutex mutex_;
+	std::vector<std::unique_ptr<Entry>> entries_;
+	uint64_t nextId_ = 0;
+};
+
+// Process-wide: threads of every Node environment share it. Never destroyed,
+// since registered threads (the log echo thread, detached hook threads) may
+// still be winding down during static destruction.
+inline ThreadCpuRegistry& AddonThreads() {
+	static ThreadCpuRegistry* registry = new ThreadCpuRegistry();
+	return *registry;
+}
+
+// Registers the calling thread under name for the scope's lifetime.
+class ThreadCpuScope {
+public:
+	explicit ThreadCpuScope(const char* name) : id_(AddonThreads().Add(name)) {}
+	~ThreadCpuScope() { AddonThreads().Remove(id_); }
+	ThreadCpuScope(const ThreadCpuScope&) = delete;
+	ThreadCpuScope& operator=(const ThreadCpuScope&) = delete;
+
+private:
+	uint64_t id_;
+};
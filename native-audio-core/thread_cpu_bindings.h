@@ -0,0 +1,35 @@
+#pragma once
+
+// getThreadStats() export shared by the capture addons, and the list it
+// returns, which getStats() also carries as `threads` (thread_cpu.h).
+
+#include <napi.h>
+
+#include <vector>
+
+#include "thread_cpu.h"
+
+// [{ name, cpuMs, userMs, kernelMs, cycles, percent, windowMs }] for every
+// addon-owned thread alive now; percent is of one core over windowMs.
+inline Napi::Array ThreadCpuToJs(Napi::Env env) {
+	const std::vector<ThreadCpuSample> samples = AddonThreads().Sample();
+	Napi::Array result = Napi::Array::New(env, samples.size());
+	for (uint32_t i = 0; i < samples.size(); ++i) {
+		const ThreadCpuSample& s = samples[i];
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("name", Napi::String::New(env, s.name));
+		o.Set("cpuMs", Napi::Number::New(env, (double)s.cpuNs / 1e6));
+		o.Set("userMs", Napi::Number::New(env, (double)s.userNs / 1e6));
+		o.Set("kernelMs", Napi::Number::New(env, (double)s.kernelNs / 1e6));
+		o.Set("cycles", Napi::Number::New(env, (double)s.cycles));
+		o.Set("percent", Napi::Number::New(env, s.percent));
+		o.Set("windowMs", Napi::Number::New(env, s.windowMs));
+		result.Set(i, o);
+	}
+	return result;
+}
+
+// getThreadStats() -> the list above.
+inline Napi::Value GetThreadStats(const Napi::CallbackInfo& info) {
+	return ThreadCpuToJs(info.Env());
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+// Real-time scheduling for capture threads: an MMCSS task on Windows, a Mach
+// time-constraint policy sized from the device buffer period on macOS. Apply
+// from the thread itself; Revert before it exits.
+//
+// Separately, every thread of ours has a QoS for its role, which is what
+// hybrid CPUs (Intel P/E cores, Apple Silicon) place threads by: capture and
+// DSP threads ask for interactive QoS so they stay on performance cores, and
+// batch work (encoders, the recorder, OCR preprocessing, model warm-up) for
+// utility QoS, which runs it on efficiency cores at less power, out of the
+// way of Chromium.
+
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <avrt.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#include <pthread.h>
+#include <pthread/qos.h>
+#endif
+
+#include "addon_log.h"
+
+//   Normal   - leave the thread alone
+//   Audio    - MMCSS "Audio" / time-constraint with a relaxed computation budget
+//   ProAudio - MMCSS "Pro Audio" / time-constraint with a tight budget
+enum class ThreadSchedule { Normal, Audio, ProAudio };
+
+// MMCSS priority inside the task (AVRT_PRIORITY_*); ignored on macOS.
+enum class ThreadPriority { Low, Normal, High, Critical };
+
+struct ThreadScheduleState {
+	bool applied = false;
+#if defined(_WIN32)
+	HANDLE task = nullptr;
+	DWORD taskIndex = 0;
+#endif
+};
+
+inline const char* ThreadScheduleName(ThreadSchedule s) {
+	switch (s) {
+	case ThreadSchedule::Audio: return "audio";
+	case ThreadSchedule::ProAudio: return "pro-audio";
+	default: return "normal";
+	}
+}
+
+// periodMs is the device period the thread wakes at (macOS uses it for the
+// time-constraint budget).
+inline bool ApplyThreadSchedule(ThreadSchedule schedule, ThreadPriority priority, double periodMs,
+                                ThreadScheduleState* state) {
+	if (schedule == ThreadSchedule::Normal) return false;
+#if defined(_WIN32)
+	(void)periodMs;
+	state->task = AvSetMmThreadCharacteristicsW(schedule == ThreadSchedule::ProAudio ? L"Pro Audio" : L"Audio",
+	                                            &state->taskIndex);
+	if (!state->task) {
+		AddonLog(LogLevel::Error, "AvSetMmThreadCharacteristics failed: %lu", GetLastError());
+		return false;
+	}
+	AVRT_PRIORITY avrt = AVRT_PRIORITY_NORMAL;
+	switch (priority) {
+	case ThreadPriority::Low: avrt = AVRT_PRIORITY_LOW; break;
+	case ThreadPriority::High: avrt = AVRT_PRIORITY_HIGH; break;
+	case ThreadPriority::Critical: avrt = AVRT_PRIORITY_CRITICAL; break;
+	default: break;
+	}
+	AvSetMmThreadPriority(state->task, avrt);
+	state->applied = true;
+	return true;
+#elif defined(__APPLE__)
+	(void)priority;
+	if (periodMs <= 0.0) periodMs = 10.0;
+	mach_timebase_info_data_t tb;
+	mach_timebase_info(&tb);
+	const double ticksPerMs = 1e6 * (double)tb.denom / (double)tb.numer;
+	const double budget = schedule == ThreadSchedule::ProAudio ? 0.5 : 0.25;
+	thread_time_constraint_policy_data_t policy;
+	policy.period = (uint32_t)(periodMs * ticksPerMs);
+	policy.computation = (uint32_t)(periodMs * budget * ticksPerMs);
+	policy.constraint = policy.period;
+	policy.preemptible = TRUE;
+	kern_return_t kr = thread_policy_set(mach_thread_self(), THREAD_TIME_CONSTRAINT_POLICY,
+	                                     (thread_policy_t)&policy, THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+	if (kr != KERN_SUCCESS) {
+		AddonLog(LogLevel::Error, "thread_policy_set(TIME_CONSTRAINT) failed: %d", (int)kr);
+		return false;
+	}
+	state->applied = true;
+	return true;
+#else
+	(void)priority; (void)periodMs; (void)state;
+	return false;
+#endif
+}
+
+inline void RevertThreadSchedule(ThreadScheduleState* state) {
+#if defined(_WIN32)
+	if (state->task) AvRevertMmThreadCharacteristics(state->task);
+	state->task = nullptr;
+#endif
+	state->applied = false;
+}
+
+//   Interactive - capture, DSP and render threads: never power-throttled
+//                 (HighQoS) on Windows, QOS_CLASS_USER_INTERACTIVE on macOS
+//   Utility     - batch work: EcoQoS on Windows, QOS_CLASS_UTILITY on macOS
+enum class ThreadQos { Interactive, Utility };
+
+// For the calling thread, before any ApplyThreadSchedule (a macOS
+// time-constraint policy takes over from the QoS class). On Windows, through
+// SetThreadInformation(ThreadPowerThrottling); Windows 10 before 1709 ignores it.
+inline void ApplyThreadQos(ThreadQos qos) {
+#if defined(_WIN32)
+	THREAD_POWER_THROTTLING_STATE state = {};
+	state.Version = THREAD_POWER_THROTTLING_CURRENT_VERSION;
+	state.ControlMask = THREAD_POWER_THROTTLING_EXECUTION_SPEED;
+	state.StateMask = qos == ThreadQos::Utility ? THREAD_POWER_THROTTLING_EXECUTION_SPEED : 0;
+	SetThreadInformation(GetCurrentThread(), ThreadPowerThrottling, &state, sizeof(state));
+#elif defined(__APPLE__)
+	pthread_set_qos_class_self_np(qos == ThreadQos::Utility ? QOS_CLASS_UTILITY : QOS_CLASS_USER_INTERACTIVE, 0);
+#else
+	(void)qos;
+#endif
+}
+
+// ApplyThreadQos for one stretch of work on a borrowed thread (a threadpool
+// worker running an encode or an OCR preprocess); the thread's own QoS comes
+// back after it.
+class ThreadQosScope {
+public:
+	explicit ThreadQosScope(ThreadQos qos) {
+#if defined(_WIN32)
+		saved_.Version = THREAD_POWER_THROTTLING_CURRENT_VERSION;
+		restore_ = GetThreadInformation(GetCurrentThread(), ThreadPowerThrottling, &saved_, sizeof(saved_)) != 0;
+#elif defined(__APPLE__)
+		if (pthread_get_qos_class_np(pthread_self(), &qos_, &relative_) != 0 || qos_ == QOS_CLASS_UNSPECIFIED) {
+			qos_ = QOS_CLASS_DEFAULT;
+			relative_ = 0;
+		}
+#endif
+		ApplyThreadQos(qos);
+	}
+	~ThreadQosScope() {
+#if defined(_WIN32)
+		if (!restore_) {
+			saved_ = {};
+			saved_.Version = THREAD_POWER_THROTTLING_CURRENT_VERSION;
+		}
+		SetThreadInformation(GetCurrentThread(), ThreadPowerThrottling, &saved_, sizeof(saved_));
+#elif defined(__APPLE__)
+		pthread_set_qos_class_self_np(qos_, relative_);
+#endif
+	}
+	ThreadQosScope(const ThreadQosScope&) = delete;
+	ThreadQosScope& operator=(const ThreadQosScope&) = delete;
+
+private:
+#if defined(_WIN32)
+	THREAD_POWER_THROTTLING_STATE saved_ = {};
+	bool restore_ = false;
+#elif defined(__APPLE__)
+	qos_class_t qos_ = QOS_CLASS_DEFAULT;
+	int relative_ = 0;
+#endif
+};
+
+// The opposite end for long compute threads (local inference): below-normal
+// priority on Windows, utility QoS on macOS, so they soak up idle cores
+// without competing with capture or the UI. Threads a macOS compute thread
+// spawns (ggml's workers) inherit its QoS; on Windows they start at normal
+// priority, still under the capture's MMCSS class.
+inline void ApplyBackgroundComputeSchedule() {
+#if defined(_WIN32)
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__APPLE__)
+	pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#endif
+}
+
+// ApplyBackgroundComputeSchedule for one stretch of work on a borrowed thread
+// (a threadpool worker: a background model load and its warm-up), at utility
+// QoS, which on Windows is EcoQoS; the thread's own priority comes back after it.
+class BackgroundComputeScope {
+public:
+	// qos_ sets (and gives back) the macOS QoS class; the Windows priority is kept here
+	BackgroundComputeScope() : qos_(ThreadQos::Utility) {
+#if defined(_WIN32)
+		priority_ = GetThreadPriority(GetCurrentThread());
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+	}
+	~BackgroundComputeScope() {
+#if defined(_WIN32)
+		if (priority_ != THREAD_PRIORITY_ERROR_RETURN) SetThreadPriority(GetCurrentThread(), priority_);
+#endif
+	}
+	BackgroundComputeScope(const BackgroundComputeScope&) = delete;
+	BackgroundComputeScope& operator=(const BackgroundComputeScope&) = delete;
+
+private:
+	ThreadQosScope qos_;
+#if defined(_WIN32)
+	int priority_ = THREAD_PRIORITY_ERROR_RETURN;
+#endif
+};
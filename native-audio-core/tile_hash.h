@@ -0,0 +1,172 @@
+#pragma once
+
+// Tile change detection for RegionCapture (region_capture.h): the frame is cut
+// into square tiles, each tile gets a 64-bit checksum, and the checksums are
+// compared with the previous frame's, so a watcher can skip OCR when nothing
+// (or too little) changed and re-read only the rows that did. The checksum is
+// a Fletcher-style pair of running sums over 32-bit words, four lanes wide
+// with SSE2/NEON (the scalar path gives identical values), folded into 64 bits
+// at the end of the tile: about one add per byte, well under the cost of the
+// copy that produced the frame. When the capture API reports which rectangles
+// it redrew (DXGI dirty and move rects), only tiles touching them are hashed.
+// RowHashes folds each row of tiles into one checksum, a content key for a
+// full-width band (the watch box caches OCR results under it).
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "simd.h"
+
+struct TileRect {
+	uint32_t x = 0, y = 0, width = 0, height = 0;
+};
+
+struct TileChange {
+	uint32_t tiles = 0;   // tiles in the frame
+	uint32_t changed = 0; // tiles whose checksum differs from the previous frame
+	TileRect bounds;      // bounding box of the changed tiles, in pixels
+
+	float Ratio() const { return tiles ? (float)changed / (float)tiles : 0.0f; }
+};
+
+// Running sums of one tile: s1 += word, s2 += s1, lane-wise.
+struct TileSums {
+	uint32_t s1[4] = {};
+	uint32_t s2[4] = {};
+
+	uint64_t Fold() const {
+		uint64_t h = 0xcbf29ce484222325ull;
+		for (int i = 0; i < 4; ++i) {
+			h = (h ^ s1[i]) * 0x100000001b3ull;
+			h = (h ^ s2[i]) * 0x100000001b3ull;
+		}
+		return h;
+	}
+};
+
+// Adds n bytes to sums; a partial last 16-byte block is zero-padded.
+inline void TileSumBytes(const uint8_t* p, size_t n, TileSums* sums) {
+	size_t i = 0;
+#if defined(AUDIO_CORE_SSE)
+	__m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums->s1));
+	__m128i s2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums->s2));
+	for (; i + 16 <= n; i += 16) {
+		s1 = _mm_add_epi32(s1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+		s2 = _mm_add_epi32(s2, s1);
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(sums->s1), s1);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(sums->s2), s2);
+#elif defined(AUDIO_CORE_NEON)
+	uint32x4_t s1 = vld1q_u32(sums->s1), s2 = vld1q_u32(sums->s2);
+	for (; i + 16 <= n; i += 16) {
+		s1 = vaddq_u32(s1, vreinterpretq_u32_u8(vld1q_u8(p + i)));
+		s2 = vaddq_u32(s2, s1);
+	}
+	vst1q_u32(sums->s1, s1);
+	vst1q_u32(sums->s2, s2);
+#endif
+	for (; i < n; i += 16) {
+		uint32_t words[4] = {};
+		std::memcpy(words, p + i, std::min<size_t>(16, n - i));
+		for (int k = 0; k < 4; ++k) {
+			sums->s1[k] += words[k];
+			sums->s2[k] += sums->s1[k];
+		}
+	}
+}
+
+class TileHasher {
+public:
+	// tileSize in pixels; rounded up to a multiple of 16.
+	void Configure(uint32_t tileSize) {
+		tileSize_ = std::max<uint32_t>(16, (tileSize + 15) & ~15u);
+		Reset();
+	}
+
+	// The next frame counts as entirely changed.
+	void Reset() {
+		hashes_.clear();
+		width_ = height_ = 0;
+	}
+
+	// Hashes the frame's tiles and compares them with the previous frame's.
+	// hints, when given, holds every rectangle that may have changed since
+	// the previous call; tiles outside all of them keep their checksum.
+	TileChange Update(const uint8_t* pixels, uint32_t width, uint32_t height, size_t stride, uint32_t bytesPerPixel,
+	                  const std::vector<TileRect>* hints) {
+		const uint32_t cols = (width + tileSize_ - 1) / tileSize_;
+		const uint32_t rows = (height + tileSize_ - 1) / tileSize_;
+		const bool fresh = width != width_ || height != height_ || hashes_.size() != (size_t)cols * rows;
+		if (fresh) {
+			hashes_.assign((size_t)cols * rows, 0);
+			width_ = width;
+			height_ = height;
+			hints = nullptr;
+		}
+		TileChange change;
+		change.tiles = cols * rows;
+		uint32_t minCol = cols, minRow = rows, maxCol = 0, maxRow = 0;
+		for (uint32_t row = 0; row < rows; ++row) {
+			const uint32_t y = row * tileSize_, h = std::min(tileSize_, height - y);
+			for (uint32_t col = 0; col < cols; ++col) {
+				const uint32_t x = col * tileSize_, w = std::min(tileSize_, width - x);
+				if (hints && !Touches(*hints, x, y, w, h)) continue;
+				TileSums sums;
+				for (uint32_t line = 0; line < h; ++line) {
+					TileSumBytes(pixels + (size_t)(y + line) * stride + (size_t)x * bytesPerPixel, (size_t)w * bytesPerPixel, &sums);
+				}
+				const uint64_t hash = sums.Fold();
+				uint64_t& previous = hashes_[(size_t)row * cols + col];
+				if (!fresh && hash == previous) continue;
+				previous = hash;
+				++change.changed;
+				minCol = std::min(minCol, col);
+				maxCol = std::max(maxCol, col);
+				minRow = std::min(minRow, row);
+				maxRow = std::max(maxRow, row);
+			}
+		}
+		if (change.changed) {
+			change.bounds.x = minCol * tileSize_;
+			change.bounds.y = minRow * tileSize_;
+			change.bounds.width = std::min(width, (maxCol + 1) * tileSize_) - change.bounds.x;
+			change.bounds.height = std::min(height, (maxRow + 1) * tileSize_) - change.bounds.y;
+		}
+		return change;
+	}
+
+	// Tiles in a frame of the last size, for a grab that saw no change.
+	uint32_t Tiles() const {
+		return ((width_ + tileSize_ - 1) / tileSize_) * ((height_ + tileSize_ - 1) / tileSize_);
+	}
+
+	uint32_t TileSize() const { return tileSize_; }
+
+	// One checksum per row of tiles (tileSize pixel rows, the last one
+	// partial), folded from the row's tile checksums as of the last Update.
+	void RowHashes(std::vector<uint64_t>* out) const {
+		const size_t cols = (width_ + tileSize_ - 1) / tileSize_;
+		out->clear();
+		if (!cols) return;
+		for (size_t start = 0; start + cols <= hashes_.size(); start += cols) {
+			uint64_t h = 0xcbf29ce484222325ull ^ cols;
+			for (size_t col = 0; col < cols; ++col) h = (h ^ hashes_[start + col]) * 0x100000001b3ull;
+			out->push_back(h);
+		}
+	}
+
+private:
+	static bool Touches(const std::vector<TileRect>& rects, uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+		for (const TileRect& r : rects) {
+			if (r.x < x + w && x < r.x + r.width && r.y < y + h && y < r.y + r.height) return true;
+		}
+		return false;
+	}
+
+	uint32_t tileSize_ = 32;
+	uint32_t width_ = 0, height_ = 0;
+	std::vector<uint64_t> hashes_; // row-major, one per tile
+};
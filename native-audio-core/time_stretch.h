@@ -0,0 +1,188 @@
+#pragma once
+
+// Pitch-preserving speed-up of queued speech by WSOLA (waveform-similarity
+// overlap-add), for a render queue that has fallen behind (render_session.h).
+// Each step plays one 40 ms sequence of the input, then moves on by speed
+// times what it played. The next sequence starts within 15 ms of that point,
+// wherever the waveform best matches the natural continuation of the last
+// one, and the two crossfade over 8 ms - SoundTouch's settings for speech -
+// so whole pitch periods drop out rather than the pitch rising. At speed 1
+// input passes through untouched; starting to stretch is seamless and
+// stopping costs one more crossfade. Mono 48 kHz with fixed buffers, so it
+// runs on the render thread.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+class WsolaStretcher {
+public:
+	static constexpr size_t kRate = 48000;
+	static constexpr size_t kSequence = kRate * 40 / 1000;
+	static constexpr size_t kOverlap = kRate * 8 / 1000;
+	static constexpr size_t kSeek = kRate * 15 / 1000;
+	static constexpr size_t kStepOut = kSequence - kOverlap; // output per step
+	static constexpr size_t kWindow = kSeek + kSequence;     // input a step looks at
+	static constexpr double kMaxSpeed = 1.5;                 // a step's skip stays inside kWindow
+
+	void Reset() {
+		active_ = false;
+		inPos_ = inLen_ = 0;
+		outPos_ = outLen_ = 0;
+		skipFrac_ = 0.0;
+	}
+
+	bool Active() const { return active_; }
+	// Input frames taken from the source but not played yet.
+	size_t Buffered() const { return inLen_ - inPos_ + outLen_ - outPos_ + (active_ ? kOverlap : 0); }
+	// Input frames skipped since construction: what stretching saved.
+	uint64_t Saved() const { return saved_; }
+
+	// Writes n frames to dst at `speed` (1 passes through), reading input
+	// with pull(float* dst, size_t max) -> frames read. Returns fewer than n
+	// only once the source has run dry and nothing is held back.
+	template <typename Pull>
+	size_t Render(float* dst, size_t n, double speed, Pull&& pull) {
+		speed = std::min(speed, kMaxSpeed);
+		size_t done = 0;
+		while (done < n) {
+			if (outPos_ < outLen_) {
+				const size_t take = std::min(n - done, outLen_ - outPos_);
+				memcpy(dst + done, out_ + outPos_, take * sizeof(float));
+				outPos_ += take;
+				done += take;
+				continue;
+			}
+			if (active_) {
+				if (speed > 1.0 && Fill(pull)) Step(speed);
+				else Leave(pull);
+				continue;
+			}
+			if (speed > 1.0 && Fill(pull)) {
+				// The continuation of what just played is the input itself
+				memcpy(mid_, in_ + inPos_, kOverlap * sizeof(float));
+				active_ = true;
+				continue;
+			}
+			if (inPos_ < inLen_) {
+				const size_t take = std::min(n - done, inLen_ - inPos_);
+				memcpy(dst + done, in_ + inPos_, take * sizeof(float));
+				inPos_ += take;
+				done += take;
+				continue;
+			}
+			const size_t got = pull(dst + done, n - done);
+			done += got;
+			if (got == 0) break;
+		}
+		return done;
+	}
+
+private:
+	static constexpr size_t kInputCapacity = 2 * kWindow;
+
+	// Tops the input up to kWindow frames; false when the source has fewer.
+	template <typename Pull>
+	bool Fill(Pull&& pull) {
+		if (inPos_ > 0) {
+			memmove(in_, in_ + inPos_, (inLen_ - inPos_) * sizeof(float));
+			inLen_ -= inPos_;
+			inPos_ = 0;
+		}
+		while (inLen_ < kWindow) {
+			const size_t got = pull(in_ + inLen_, kWindow - inLen_);
+			if (got == 0) break;
+			inLen_ += got;
+		}
+		return inLen_ >= kWindow;
+	}
+
+	// One sequence: the crossfade from mid_ into the best match, the rest of
+	// the sequence, and its last kOverlap frames kept as the next mid_.
+	void Step(double speed) {
+		const float* x = in_ + inPos_;
+		const size_t off = BestOffset(x, kSeek);
+		Crossfade(x + off);
+		memcpy(out_ + kOverlap, x + off + kOverlap, (kSequence - 2 * kOverlap) * sizeof(float));
+		memcpy(mid_, x + off + kSequence - kOverlap, kOverlap * sizeof(float));
+		outPos_ = 0;
+		outLen_ = kStepOut;
+		const double skip = speed * kStepOut + skipFrac_;
+		const size_t whole = (size_t)skip;
+		skipFrac_ = skip - whole;
+		inPos_ += whole;
+		saved_ += whole - kStepOut;
+	}
+
+	// Back to passing through: crossfade mid_ into the input once more and
+	// carry on from the end of the fade. A source too short to search (it ran
+	// dry mid-stretch) just gets mid_ ahead of what is left.
+	template <typename Pull>
+	void Leave(Pull&& pull) {
+		Fill(pull);
+		active_ = false;
+		skipFrac_ = 0.0;
+		const size_t avail = inLen_ - inPos_;
+		outPos_ = 0;
+		outLen_ = kOverlap;
+		if (avail < kOverlap) {
+			memcpy(out_, mid_, kOverlap * sizeof(float));
+			return;
+		}
+		const float* x = in_ + inPos_;
+		const size_t off = BestOffset(x, std::min(kSeek, avail - kOverlap));
+		Crossfade(x + off);
+		inPos_ += off + kOverlap;
+		saved_ += off;
+	}
+
+	void Crossfade(const float* x) {
+		for (size_t i = 0; i < kOverlap; ++i) {
+			const float w = (float)i / kOverlap;
+			out_[i] = mid_[i] * (1.0f - w) + x[i] * w;
+		}
+	}
+
+	// Offset in [0, range] whose kOverlap frames correlate best, normalized,
+	// with mid_: every 4th offset first, then the neighbours of the best.
+	size_t BestOffset(const float* x, size_t range) const {
+		size_t best = 0;
+		float bestScore = Score(x);
+		for (size_t off = 4; off <= range; off += 4) {
+			const float s = Score(x + off);
+			if (s > bestScore) {
+				bestScore = s;
+				best = off;
+			}
+		}
+		const size_t from = best > 3 ? best - 3 : 0, to = std::min(best + 3, range);
+		for (size_t off = from; off <= to; ++off) {
+			const float s = Score(x + off);
+			if (s > bestScore) {
+				bestScore = s;
+				best = off;
+			}
+		}
+		return best;
+	}
+
+	float Score(const float* x) const {
+		float xy = 0.0f, yy = 0.0f;
+		for (size_t i = 0; i < kOverlap; i += 2) {
+			xy += mid_[i] * x[i];
+			yy += x[i] * x[i];
+		}
+		return yy > 1e-9f ? xy / std::sqrt(yy) : 0.0f;
+	}
+
+	bool active_ = false;
+	float in_[kInputCapacity] = {};
+	size_t inPos_ = 0, inLen_ = 0;
+	float mid_[kOverlap] = {}; // what would have followed the last sequence
+	float out_[kStepOut] = {};
+	size_t outPos_ = 0, outLen_ = 0;
+	double skipFrac_ = 0.0;
+	uint64_t saved_ = 0;
+};
@@ -0,0 +1,185 @@
+#pragma once
+
+// Keyboard and mouse clicks hidden from the VAD (capture option "declick").
+// A click on a desk microphone clears the noise gate and the detector alike,
+// and each one would otherwise become a junk chunk and an STT call.
+//
+// The masker splits the delivered samples into three bands (below 700 Hz,
+// 700-2500 Hz, above) with the same one-pole filters the VAD uses and, every
+// kBlockMs, compares each band's energy with its own floor (the minimum of
+// its smoothed level, rising 3 dB/s under steady noise). The spectral
+// flux of a block is its bands' mean rise over their floors; an onset is a
+// block whose flux and top-band rise both reach onsetDb after kIsolationMs
+// of quiet, which is how an impulse starts and how speech in progress
+// never does. From the onset block on, the VAD's copy of the samples is
+// scaled down to the floors' level. The mask ends one of two ways: the
+// bands fall back near their floors within maxClickMs, which makes it a
+// click, or they are still up after it, which makes it a plosive or a word
+// and lifts the mask; the VAD then misses at most maxClickMs of its onset,
+// which the chunker's pre-roll covers. Delivered audio is never changed:
+// only the detector's input is.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+struct TransientMaskConfig {
+	bool enabled = false;
+	float onsetDb = 15.0f;    // rise over the floors within one block that starts a mask
+	uint32_t maxClickMs = 40; // still loud after this long: not a click
+};
+
+class TransientMasker {
+public:
+	static constexpr float kBlockMs = 2.0f;
+	static constexpr float kIsolationMs = 40.0f; // quiet needed before an onset
+	static constexpr float kActiveDb = 6.0f;     // a band this far over its floor is not quiet
+	static constexpr float kFloorRiseDbPerSec = 3.0f;
+
+	// maxSamples: the most any Process() call passes.
+	void Configure(const TransientMaskConfig& config, uint32_t sampleRate, size_t maxSamples) {
+		config_ = config;
+		if (!config_.enabled || sampleRate == 0) {
+			config_.enabled = false;
+			scratch_.clear();
+			return;
+		}
+		const float twoPi = 6.28318530718f;
+		lowAlpha_ = 1.0f - std::exp(-twoPi * 700.0f / (float)sampleRate);
+		midAlpha_ = 1.0f - std::exp(-twoPi * 2500.0f / (float)sampleRate);
+		block_ = std::max<size_t>(1, (size_t)(sampleRate * kBlockMs / 1000.0f));
+		isolation_ = (uint64_t)(sampleRate * kIsolationMs / 1000.0f);
+		maxClick_ = (uint64_t)sampleRate * config_.maxClickMs / 1000;
+		onsetRatio_ = std::pow(10.0f, config_.onsetDb / 10.0f);
+		activeRatio_ = std::pow(10.0f, kActiveDb / 10.0f);
+		riseDbPerSample_ = kFloorRiseDbPerSec / (float)sampleRate;
+		scratch_.assign(maxSamples, 0.0f);
+		Reset();
+	}
+
+	bool Enabled() const { return config_.enabled; }
+
+	void Reset() {
+		low_ = mid_ = 0.0f;
+		filled_ = 0;
+		primed_ = false;
+		for (float& f : floor_) f = 0.0f;
+		for (float& l : level_) l = 0.0f;
+		quiet_ = 0;
+		masking_ = false;
+		masked_ = 0;
+		clicks_ = 0;
+	}
+
+	// Capture thread. Returns x when nothing in it is masked, otherwise a
+	// copy with the masked blocks scaled down, valid until the next call.
+	const float* Process(const float* x, size_t n, float gain) {
+		if (!config_.enabled || n > scratch_.size()) return x;
+		bool copied = false;
+		for (size_t at = 0; at < n;) {
+			const size_t take = std::min(n - at, block_ - filled_);
+			const float scale = Analyse(x + at, take, gain);
+			if (scale < 1.0f && !copied) {
+				memcpy(scratch_.data(), x, at * sizeof(float));
+				copied = true;
+			}
+			if (copied) {
+				for (size_t i = 0; i < take; ++i) scratch_[at + i] = x[at + i] * scale;
+			}
+			filled_ = (filled_ + take) % block_;
+			at += take;
+		}
+		return copied ? scratch_.data() : x;
+	}
+
+	// Clicks confirmed since the last call.
+	uint32_t TakeClicks() {
+		const uint32_t clicks = clicks_;
+		clicks_ = 0;
+		return clicks;
+	}
+
+private:
+	static constexpr float kTiny = 1e-12f;
+	static constexpr float kLevelSmoothing = 0.25f; // per block: about 8 ms
+
+	// One block, or the part of one a call holds. Returns the scale for its
+	// samples: 1 unless masked.
+	float Analyse(const float* x, size_t n, float gain) {
+		float low = low_, mid = mid_;
+		float energy[3] = { 0.0f, 0.0f, 0.0f };
+		for (size_t i = 0; i < n; ++i) {
+			const float s = x[i] * gain;
+			low += lowAlpha_ * (s - low);
+			mid += midAlpha_ * (s - mid);
+			const float bands[3] = { low, mid - low, s - mid };
+			for (int b = 0; b < 3; ++b) energy[b] += bands[b] * bands[b];
+		}
+		low_ = low;
+		mid_ = mid;
+		const float inv = 1.0f / (float)n;
+		for (float& e : energy) e = e * inv + kTiny;
+		if (!primed_) {
+			for (int b = 0; b < 3; ++b) floor_[b] = level_[b] = energy[b];
+			primed_ = true;
+		}
+
+		float flux = 0.0f, floorSum = 0.0f, energySum = 0.0f;
+		bool settled = true;
+		for (int b = 0; b < 3; ++b) {
+			const float ratio = energy[b] / floor_[b];
+			flux += 10.0f * std::log10(std::max(ratio, 1.0f));
+			settled = settled && ratio <= activeRatio_;
+			floorSum += floor_[b];
+			energySum += energy[b];
+		}
+		flux /= 3.0f;
+
+		if (!masking_ && quiet_ >= isolation_ && flux >= config_.onsetDb && energy[2] >= floor_[2] * onsetRatio_) {
+			masking_ = true;
+			masked_ = 0;
+		}
+		if (masking_) {
+			if (settled) {
+				masking_ = false;
+				++clicks_;
+			} else if ((masked_ += n) > maxClick_) {
+				masking_ = false; // a word or a plosive: the VAD hears the rest
+			} else {
+				quiet_ = 0;
+				return std::min(1.0f, std::sqrt(floorSum / energySum));
+			}
+		}
+
+		// Levels and floors skip masked blocks, so a click leaves no trace in them
+		const float rise = std::pow(10.0f, riseDbPerSample_ * (float)n / 10.0f);
+		bool active = false;
+		for (int b = 0; b < 3; ++b) {
+			level_[b] += kLevelSmoothing * (energy[b] - level_[b]);
+			floor_[b] = level_[b] < floor_[b] ? level_[b] : floor_[b] * rise;
+			active = active || level_[b] > floor_[b] * activeRatio_;
+		}
+		quiet_ = active ? 0 : quiet_ + n;
+		return 1.0f;
+	}
+
+	TransientMaskConfig config_;
+	float lowAlpha_ = 0.0f, midAlpha_ = 0.0f;
+	size_t block_ = 1;
+	uint64_t isolation_ = 0, maxClick_ = 0;
+	float onsetRatio_ = 1.0f, activeRatio_ = 1.0f, riseDbPerSample_ = 0.0f;
+	std::vector<float> scratch_;
+
+	float low_ = 0.0f, mid_ = 0.0f;
+	size_t filled_ = 0; // samples of the current block seen
+	bool primed_ = false;
+	float level_[3] = { 0.0f, 0.0f, 0.0f }; // per band, smoothed mean energy per sample
+	float floor_[3] = { 0.0f, 0.0f, 0.0f }; // and its minimum
+	uint64_t quiet_ = 0;                     // samples since a band was active
+	bool masking_ = false;
+	uint64_t masked_ = 0;                    // samples since the onset
+	uint32_t clicks_ = 0;
+};
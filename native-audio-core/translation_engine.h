@@ -0,0 +1,693 @@
+#pragma once
+
+// In-process CTranslate2 translation of Argos Translate packages, so an
+// offline caption line no longer pays for a Python interpreter and a model
+// load per request. A package's model (its model/ directory) and its
+// SentencePiece tokenizer load once and stay resident until unloaded. Built
+// with gyp variable use_ctranslate2=1 (AUDIO_CORE_CTRANSLATE2, links
+// CTranslate2 and SentencePiece); otherwise every call rejects and callers
+// keep the Python backend.
+//
+//   loadTranslationModel(dir, from, to, { lanes?, threads?, computeType? })
+//     -> Promise<{ from, to, loadMs, computeType, weightsMb, memoryMb }>
+//   translateTexts(texts[], from, to, { beamSize? }) -> Promise<{ texts[], pivot, processingMs }>
+//   translatePartial(stream, text, from, to, { final?, beamSize? })
+//     -> Promise<{ text, committed, tentative, reusedSentences, prefixTokens, decodedTokens, pivot, processingMs }>
+//   unloadTranslationModels() -> Promise<void>
+//   getTranslationModels() -> [{ from, to, computeType, weightsMb, memoryMb }]
+//
+// Each pair's translator keeps `lanes` model replicas, each decoding on its
+// own `threads` CPU threads: CTranslate2's replica pool is the engine's
+// thread pool, so batches from the mic and loopback translate side by side.
+// All sentences of one call go to the model as one batch. The threadpool
+// job that submitted them waits for the pool; the JS thread never blocks.
+//
+// Option computeType is the type the weights are converted to at load:
+// 'default' keeps what the package was saved with, 'int8' quantizes (a
+// float32 model shrinks to a quarter, and int8 is CTranslate2's fastest CPU
+// path), 'int8_float32', 'int16' and 'float32' as CTranslate2 names them,
+// and 'auto' lets it pick the fastest type this CPU supports.
+//
+// Argos splits sentences with Stanza; here a sentence ends at . ! ? (and
+// their CJK forms) followed by a space or the end, which is what caption
+// lines need. Without a direct package, from -> en -> to is used when both
+// halves are loaded, as Argos does.
+//
+// translatePartial is for a streaming caption's growing text: each call
+// passes the whole caption so far under a stream name. Sentences already
+// closed come from the stream's cache unchanged; the open sentence decodes
+// with its committed translation prefix forced (CTranslate2 target_prefix,
+// one decoder pass for the whole prefix), so beam search only runs over the
+// tail. The committed prefix is what two consecutive updates' translations
+// agreed on, and only grows while the source only grows; a revised source
+// word drops it. The encoder still reads the open sentence whole, as there
+// is no public way to keep CTranslate2's decoder state between calls.
+// final: true translates the last sentence as closed and forgets the stream.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "addon_log.h"
+#include "async_query.h"
+#include "capture_options.h"
+#include "mapped_file.h"
+#include "memory_budget.h"
+#include "sentence_split.h"
+#include "system_memory.h"
+
+#if defined(AUDIO_CORE_CTRANSLATE2)
+#include <ctranslate2/translator.h>
+#include <ctranslate2/types.h>
+#include <sentencepiece_processor.h>
+#endif
+
+struct TranslationJobConfig {
+	uint32_t beamSize = 4; // Argos's own
+};
+
+struct TranslationResult {
+	std::vector<std::string> texts;
+	bool pivot = false; // went through English
+	double processingMs = 0;
+	std::string error;
+};
+
+struct PartialTranslationResult {
+	std::string text;      // committed + tentative
+	std::string committed; // closed sentences and the open one's agreed prefix: later updates keep it
+	std::string tentative; // the rest, which the next update may still change
+	uint32_t reusedSentences = 0; // closed sentences taken from the stream's cache
+	uint32_t prefixTokens = 0;    // target tokens forced rather than searched
+	uint32_t decodedTokens = 0;   // target tokens beam search produced
+	bool pivot = false;
+	double processingMs = 0;
+	std::string error;
+};
+
+struct TranslationLoadInfo {
+	double loadMs = 0;
+	std::string computeType; // as requested
+	double weightsMb = 0;    // model.bin as saved
+	double memoryMb = 0;     // resident memory the load added (approximate: other threads allocate too)
+};
+
+struct TranslationPairInfo {
+	std::string from, to;
+	TranslationLoadInfo info;
+};
+
+inline bool IsTranslationComputeType(const std::string& type) {
+	return type == "default" || type == "auto" || type == "int8" || type == "int8_float32" || type == "int16" || type == "float32";
+}
+
+inline uint32_t DefaultTranslationThreads(uint32_t lanes) {
+	const unsigned hw = std::thread::hardware_concurrency();
+	const uint32_t spare = hw > 2 ? hw - 2 : 1; // capture and Whisper come first
+	const uint32_t perLane = spare / (lanes ? lanes : 1);
+	return perLane == 0 ? 1 : (perLane > 4 ? 4 : perLane);
+}
+
+constexpr uint32_t kTranslationIdleTrimMs = 60000;
+constexpr size_t kPartialTranslationStreams = 16; // least recently used beyond this are forgotten
+
+class TranslationEngine {
+public:
+#if defined(AUDIO_CORE_CTRANSLATE2)
+	// Threadpool thread. Replaces a pair loaded before; jobs holding the old
+	// one finish on it.
+	bool Load(const std::string& dir, const std::string& from, const std::string& to, uint32_t lanes, uint32_t threads,
+	          const std::string& computeType, TranslationLoadInfo* info, std::string* error) {
+		const auto start = std::chrono::steady_clock::now();
+		const double before = ProcessResidentMb();
+		auto pair = std::make_shared<Pair>();
+		const auto status = pair->tokenizer.Load(dir + "/sentencepiece.model");
+		if (!status.ok()) {
+			*error = "could not load " + dir + "/sentencepiece.model: " + status.ToString();
+			return false;
+		}
+		try {
+			ctranslate2::ReplicaPoolConfig pool;
+			pool.num_threads_per_replica = threads ? threads : DefaultTranslationThreads(lanes);
+			pair->translator = std::make_unique<ctranslate2::Translator>(dir + "/model", ctranslate2::Device::CPU,
+			                                                             ctranslate2::str_to_compute_type(computeType),
+			                                                             std::vector<int>(lanes, 0), false, pool);
+		} catch (const std::exception& e) {
+			*error = "could not load translation model " + dir + ": " + e.what();
+			return false;
+		}
+		info->loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		info->computeType = computeType;
+		FileStamp weights;
+		info->weightsMb = StatFile(dir + "/model/model.bin", &weights) ? weights.size / (1024.0 * 1024.0) : 0;
+		info->memoryMb = std::max(0.0, ProcessResidentMb() - before);
+		pair->info = *info;
+		pair->used = std::chrono::steady_clock::now();
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			pairs_[Key(from, to)] = std::move(pair);
+		}
+		AddonLog(LogLevel::Info, "Translation model %s->%s (%s, %.0f MB) loaded in %.0f ms, %u lane(s)", from.c_str(), to.c_str(),
+		         computeType.c_str(), info->memoryMb, info->loadMs, lanes);
+		return true;
+	}
+
+	// Threadpool thread; blocks until the replicas have translated every
+	// sentence of texts.
+	bool Translate(const std::vector<std::string>& texts, const std::string& from, const std::string& to,
+	               const TranslationJobConfig& config, TranslationResult* result) {
+		const auto start = std::chrono::steady_clock::now();
+		std::shared_ptr<Pair> direct, first, second;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			direct = Find(from, to);
+			if (!direct && from != "en" && to != "en") {
+				first = Find(from, "en");
+				second = Find("en", to);
+			}
+			for (Pair* used : { direct.get(), first.get(), second.get() }) {
+				if (used) used->used = start;
+			}
+		}
+		if (!direct && !(first && second)) {
+			result->error = "no translation model loaded for " + from + "->" + to;
+			return false;
+		}
+		try {
+			if (direct) {
+				result->texts = Run(*direct, texts, config);
+			} else {
+				result->texts = Run(*second, Run(*first, texts, config), config);
+				result->pivot = true;
+			}
+		} catch (const std::exception& e) {
+			result->error = std::string("translation failed: ") + e.what();
+			return false;
+		}
+		result->processingMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return true;
+	}
+
+	// Threadpool thread. Updates of one stream run one after another.
+	bool TranslatePartial(const std::string& name, const std::string& text, const std::string& from, const std::string& to,
+	                      bool final, const TranslationJobConfig& config, PartialTranslationResult* result) {
+		const auto start = std::chrono::steady_clock::now();
+		std::shared_ptr<Pair> direct, first, second;
+		std::shared_ptr<PartialStream> stream;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			direct = Find(from, to);
+			if (!direct && from != "en" && to != "en") {
+				first = Find(from, "en");
+				second = Find("en", to);
+			}
+			for (Pair* used : { direct.get(), first.get(), second.get() }) {
+				if (used) used->used = start;
+			}
+			stream = Stream(name);
+		}
+		if (!direct && !(first && second)) {
+			result->error = "no translation model loaded for " + from + "->" + to;
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(stream->mutex);
+		if (stream->from != from || stream->to != to) {
+			*stream = PartialStream{};
+			stream->from = from;
+			stream->to = to;
+		}
+		try {
+			if (direct) {
+				UpdatePartial(*direct, *stream, text, final, config, result);
+			} else {
+				// Prefixes are in the target language, which only the second
+				// half sees; its English input changes with every update.
+				// Closed sentences still come from the cache.
+				UpdatePivotPartial(*first, *second, *stream, text, final, config, result);
+				result->pivot = true;
+			}
+		} catch (const std::exception& e) {
+			*stream = PartialStream{};
+			result->error = std::string("translation failed: ") + e.what();
+			return false;
+		}
+		if (final) {
+			std::lock_guard<std::mutex> streamsLock(mutex_);
+			streams_.erase(name);
+		}
+		result->processingMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return true;
+	}
+
+	std::vector<TranslationPairInfo> Loaded() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::vector<TranslationPairInfo> pairs;
+		for (auto& p : pairs_) {
+			const size_t dash = p.first.find('>');
+			pairs.push_back(TranslationPairInfo{ p.first.substr(0, dash), p.first.substr(dash + 1), p.second->info });
+		}
+		return pairs;
+	}
+
+	// Jobs in flight keep their pairs until they finish.
+	void Unload() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		pairs_.clear();
+		streams_.clear();
+	}
+
+	// Pressure watch: unloads the pairs no translation used in kTranslationIdleTrimMs.
+	void TrimIdle() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		const auto idleSince = std::chrono::steady_clock::now() - std::chrono::milliseconds(kTranslationIdleTrimMs);
+		for (auto it = pairs_.begin(); it != pairs_.end();) {
+			if (it->second->used > idleSince) { ++it; continue; }
+			AddonLog(LogLevel::Info, "Translation model %s unloaded under memory pressure", it->first.c_str());
+			it = pairs_.erase(it);
+		}
+	}
+
+private:
+	struct Pair {
+		sentencepiece::SentencePieceProcessor tokenizer;
+		std::unique_ptr<ctranslate2::Translator> translator;
+		TranslationLoadInfo info;
+		std::chrono::steady_clock::time_point used; // mutex_
+	};
+
+	// One translatePartial stream. Closed sentences keep their translation;
+	// the open one keeps what its last update decoded.
+	struct PartialStream {
+		std::mutex mutex;
+		std::string from, to;
+		std::vector<std::pair<std::string, std::string>> closed; // source sentence, translation
+		std::vector<std::string> source;    // open sentence's pieces at the last update
+		std::vector<std::string> output;    // its translation's pieces
+		std::vector<std::string> committed; // the prefix of output two updates agreed on
+		uint64_t touched = 0;               // mutex_
+
+		PartialStream() = default;
+		PartialStream& operator=(PartialStream&& o) {
+			from = std::move(o.from);
+			to = std::move(o.to);
+			closed = std::move(o.closed);
+			source = std::move(o.source);
+			output = std::move(o.output);
+			committed = std::move(o.committed);
+			return *this;
+		}
+	};
+
+	static std::string Key(const std::string& from, const std::string& to) { return from + ">" + to; }
+
+	// mutex_ held. Creates the stream, forgetting the least recently used one
+	// past kPartialTranslationStreams.
+	std::shared_ptr<PartialStream> Stream(const std::string& name) {
+		auto& stream = streams_[name];
+		if (!stream) {
+			stream = std::make_shared<PartialStream>();
+			if (streams_.size() > kPartialTranslationStreams) {
+				auto oldest = streams_.end();
+				for (auto it = streams_.begin(); it != streams_.end(); ++it) {
+					if (it->first != name && (oldest == streams_.end() || it->second->touched < oldest->second->touched)) oldest = it;
+				}
+				streams_.erase(oldest);
+			}
+		}
+		stream->touched = ++streamClock_;
+		return stream;
+	}
+
+	static ctranslate2::TranslationOptions Options(const TranslationJobConfig& config) {
+		ctranslate2::TranslationOptions options;
+		options.beam_size = config.beamSize;
+		options.num_hypotheses = 1;
+		options.replace_unknowns = true;
+		return options;
+	}
+
+	static bool StartsWith(const std::vector<std::string>& tokens, const std::vector<std::string>& prefix) {
+		return prefix.size() <= tokens.size() && std::equal(prefix.begin(), prefix.end(), tokens.begin());
+	}
+
+	static void Append(std::string* text, const std::string& sentence) {
+		if (!text->empty() && !sentence.empty()) *text += ' ';
+		*text += sentence;
+	}
+
+	// stream->mutex held. Closed sentences the cache has are reused, the rest
+	// translate in one batch with the open sentence, which alone gets a prefix.
+	void UpdatePartial(Pair& pair, PartialStream& stream, const std::string& text, bool final, const TranslationJobConfig& config,
+	                   PartialTranslationResult* result) {
+		const std::vector<std::pair<size_t, size_t>> spans = SplitSentences(text);
+		const size_t closedCount = final || spans.empty() ? spans.size() : spans.size() - 1;
+		size_t reused = 0;
+		while (reused < closedCount && reused < stream.closed.size() &&
+		       stream.closed[reused].first == text.substr(spans[reused].first, spans[reused].second)) {
+			++reused;
+		}
+		// The first sentence to decode continues the one open last time if no
+		// sentence before it changed and its source only grew.
+		const bool keepOpen = reused == stream.closed.size();
+		stream.closed.resize(reused);
+		std::vector<std::vector<std::string>> batch, prefixes;
+		for (size_t i = reused; i < spans.size(); ++i) {
+			batch.emplace_back();
+			pair.tokenizer.Encode(text.substr(spans[i].first, spans[i].second), &batch.back());
+			prefixes.emplace_back();
+		}
+		const bool continues = keepOpen && !batch.empty() && !stream.source.empty() && StartsWith(batch.front(), stream.source);
+		if (continues) prefixes.front() = stream.committed;
+		std::vector<ctranslate2::TranslationResult> translated;
+		if (!batch.empty()) translated = pair.translator->translate_batch(batch, prefixes, Options(config));
+
+		result->reusedSentences = (uint32_t)reused;
+		for (size_t i = 0; i < reused; ++i) Append(&result->committed, stream.closed[i].second);
+		std::vector<std::string> previous = std::move(stream.output);
+		stream.source.clear();
+		stream.output.clear();
+		stream.committed.clear();
+		for (size_t b = 0; b < batch.size(); ++b) {
+			const std::vector<std::string>& output = translated[b].output();
+			// CTranslate2 returns the forced prefix as part of the output.
+			result->prefixTokens += (uint32_t)prefixes[b].size();
+			result->decodedTokens += (uint32_t)(output.size() - std::min(output.size(), prefixes[b].size()));
+			std::string sentence;
+			pair.tokenizer.Decode(output, &sentence);
+			const size_t i = reused + b;
+			if (i < closedCount) {
+				stream.closed.emplace_back(text.substr(spans[i].first, spans[i].second), sentence);
+				Append(&result->committed, sentence);
+				continue;
+			}
+			// Local agreement: this translation and the last one of the same
+			// growing sentence share a prefix, which becomes the committed one.
+			stream.source = batch[b];
+			stream.output = output;
+			if (b == 0 && continues) {
+				size_t agreed = 0;
+				while (agreed < previous.size() && agreed < output.size() && previous[agreed] == output[agreed]) ++agreed;
+				stream.committed.assign(output.begin(), output.begin() + agreed);
+			}
+			std::string committed;
+			pair.tokenizer.Decode(stream.committed, &committed);
+			if (committed.empty() || sentence.compare(0, committed.size(), committed) != 0) {
+				result->tentative = sentence;
+			} else {
+				Append(&result->committed, committed);
+				result->tentative = sentence.substr(committed.size());
+				while (!result->tentative.empty() && result->tentative.front() == ' ') result->tentative.erase(0, 1);
+			}
+		}
+		result->text = result->committed;
+		Append(&result->text, result->tentative);
+	}
+
+	// stream->mutex held. No prefix: each update translates the changed
+	// sentences through English afresh.
+	void UpdatePivotPartial(Pair& first, Pair& second, PartialStream& stream, const std::string& text, bool final,
+	                        const TranslationJobConfig& config, PartialTranslationResult* result) {
+		const std::vector<std::pair<size_t, size_t>> spans = SplitSentences(text);
+		const size_t closedCount = final || spans.empty() ? spans.size() : spans.size() - 1;
+		size_t reused = 0;
+		while (reused < closedCount && reused < stream.closed.size() &&
+		       stream.closed[reused].first == text.substr(spans[reused].first, spans[reused].second)) {
+			++reused;
+		}
+		stream.closed.resize(reused);
+		std::vector<std::string> sentences;
+		for (size_t i = reused; i < spans.size(); ++i) sentences.push_back(text.substr(spans[i].first, spans[i].second));
+		const std::vector<std::string> translated =
+			sentences.empty() ? sentences : Run(second, Run(first, sentences, config), config);
+		result->reusedSentences = (uint32_t)reused;
+		for (size_t i = 0; i < reused; ++i) Append(&result->committed, stream.closed[i].second);
+		for (size_t b = 0; b < sentences.size(); ++b) {
+			if (reused + b < closedCount) {
+				stream.closed.emplace_back(sentences[b], translated[b]);
+				Append(&result->committed, translated[b]);
+			} else {
+				result->tentative = translated[b];
+			}
+		}
+		result->text = result->committed;
+		Append(&result->text, result->tentative);
+	}
+
+	// mutex_ held.
+	std::shared_ptr<Pair> Find(const std::string& from, const std::string& to) {
+		auto it = pairs_.find(Key(from, to));
+		return it == pairs_.end() ? nullptr : it->second;
+	}
+
+	// Every text's sentences in one batch; translated sentences rejoin with a space.
+	std::vector<std::string> Run(Pair& pair, const std::vector<std::string>& texts, const TranslationJobConfig& config) {
+		std::vector<std::vector<std::string>> batch;
+		std::vector<size_t> sentences(texts.size(), 0);
+		for (size_t t = 0; t < texts.size(); ++t) {
+			for (const auto& span : SplitSentences(texts[t])) {
+				batch.emplace_back();
+				pair.tokenizer.Encode(texts[t].substr(span.first, span.second), &batch.back());
+				++sentences[t];
+			}
+		}
+		std::vector<std::string> out(texts.size());
+		if (batch.empty()) return out;
+		const std::vector<ctranslate2::TranslationResult> translated = pair.translator->translate_batch(batch, Options(config));
+		size_t next = 0;
+		for (size_t t = 0; t < texts.size(); ++t) {
+			for (size_t s = 0; s < sentences[t]; ++s, ++next) {
+				std::string sentence;
+				pair.tokenizer.Decode(translated[next].output(), &sentence);
+				if (!out[t].empty() && !sentence.empty()) out[t] += ' ';
+				out[t] += sentence;
+			}
+		}
+		return out;
+	}
+
+	std::mutex mutex_; // pairs_, streams_
+	std::map<std::string, std::shared_ptr<Pair>> pairs_; // "from>to"
+	std::map<std::string, std::shared_ptr<PartialStream>> streams_;
+	uint64_t streamClock_ = 0;
+#else
+	bool Load(const std::string&, const std::string&, const std::string&, uint32_t, uint32_t, const std::string&,
+	          TranslationLoadInfo*, std::string* error) {
+		*error = "CTranslate2 is not built in (use_ctranslate2=0)";
+		return false;
+	}
+	bool Translate(const std::vector<std::string>&, const std::string&, const std::string&, const TranslationJobConfig&,
+	               TranslationResult* result) {
+		result->error = "CTranslate2 is not built in (use_ctranslate2=0)";
+		return false;
+	}
+	bool TranslatePartial(const std::string&, const std::string&, const std::string&, const std::string&, bool,
+	                      const TranslationJobConfig&, PartialTranslationResult* result) {
+		result->error = "CTranslate2 is not built in (use_ctranslate2=0)";
+		return false;
+	}
+	std::vector<TranslationPairInfo> Loaded() { return {}; }
+	void Unload() {}
+	void TrimIdle() {}
+#endif
+
+private:
+	MemoryTrimHook trim_{ [this] { TrimIdle(); } };
+};
+
+inline TranslationEngine& Translation() {
+	static TranslationEngine engine;
+	return engine;
+}
+
+// loadTranslationModel(dir, from, to, { lanes?, threads?, computeType? })
+//   -> Promise<{ from, to, loadMs, computeType, weightsMb, memoryMb }>
+// dir: an installed Argos package (model/, sentencepiece.model).
+inline Napi::Value LoadTranslationModel(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 3 || !info[0].IsString() || !info[1].IsString() || !info[2].IsString()) {
+		Napi::TypeError::New(env, "Package directory, source and target language required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	uint32_t lanes = 1, threads = 0;
+	std::string computeType = "default";
+	if (info.Length() > 3 && info[3].IsObject()) {
+		std::string error;
+		if (!ReadUint32Option(info[3].As<Napi::Object>(), "lanes", 1, 4, &lanes, &error) ||
+		    !ReadUint32Option(info[3].As<Napi::Object>(), "threads", 1, 16, &threads, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		Napi::Value v = info[3].As<Napi::Object>().Get("computeType");
+		if (!v.IsUndefined()) {
+			if (!v.IsString() || !IsTranslationComputeType(v.As<Napi::String>().Utf8Value())) {
+				Napi::TypeError::New(env, "Option 'computeType' must be 'default', 'auto', 'int8', 'int8_float32', 'int16' or 'float32'")
+					.ThrowAsJavaScriptException();
+				return env.Null();
+			}
+			computeType = v.As<Napi::String>().Utf8Value();
+		}
+	}
+	struct Loaded {
+		bool ok = false;
+		TranslationLoadInfo info;
+		std::string error;
+	};
+	const std::string from = info[1].As<Napi::String>().Utf8Value(), to = info[2].As<Napi::String>().Utf8Value();
+	return QueueQuery(env, "LoadTranslationModel",
+		[dir = info[0].As<Napi::String>().Utf8Value(), from, to, lanes, threads, computeType]() {
+			Loaded result;
+			result.ok = Translation().Load(dir, from, to, lanes, threads, computeType, &result.info, &result.error);
+			return result;
+		},
+		[from, to](Napi::Env env, Loaded& result) -> Napi::Value {
+			if (!result.ok) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("from", Napi::String::New(env, from));
+			o.Set("to", Napi::String::New(env, to));
+			o.Set("loadMs", Napi::Number::New(env, result.info.loadMs));
+			o.Set("computeType", Napi::String::New(env, result.info.computeType));
+			o.Set("weightsMb", Napi::Number::New(env, result.info.weightsMb));
+			o.Set("memoryMb", Napi::Number::New(env, result.info.memoryMb));
+			return o;
+		});
+}
+
+// translateTexts(texts[], from, to, { beamSize? }) -> Promise<{ texts[], pivot, processingMs }>
+inline Napi::Value TranslateTexts(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 3 || !info[0].IsArray() || !info[1].IsString() || !info[2].IsString()) {
+		Napi::TypeError::New(env, "Texts array, source and target language required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Array array = info[0].As<Napi::Array>();
+	std::vector<std::string> texts(array.Length());
+	for (uint32_t i = 0; i < array.Length(); ++i) {
+		Napi::Value v = array.Get(i);
+		if (!v.IsString()) {
+			Napi::TypeError::New(env, "Texts must be strings").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		texts[i] = v.As<Napi::String>().Utf8Value();
+	}
+	TranslationJobConfig config;
+	if (info.Length() > 3 && info[3].IsObject()) {
+		std::string error;
+		if (!ReadUint32Option(info[3].As<Napi::Object>(), "beamSize", 1, 8, &config.beamSize, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+	return QueueQuery(env, "TranslateTexts",
+		[texts = std::move(texts), from = info[1].As<Napi::String>().Utf8Value(), to = info[2].As<Napi::String>().Utf8Value(), config]() {
+			TranslationResult result;
+			Translation().Translate(texts, from, to, config, &result);
+			return result;
+		},
+		[](Napi::Env env, TranslationResult& result) -> Napi::Value {
+			if (!result.error.empty()) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object o = Napi::Object::New(env);
+			Napi::Array texts = Napi::Array::New(env, result.texts.size());
+			for (size_t i = 0; i < result.texts.size(); ++i) texts.Set((uint32_t)i, Napi::String::New(env, result.texts[i]));
+			o.Set("texts", texts);
+			o.Set("pivot", Napi::Boolean::New(env, result.pivot));
+			o.Set("processingMs", Napi::Number::New(env, result.processingMs));
+			return o;
+		});
+}
+
+// translatePartial(stream, text, from, to, { final?, beamSize? })
+//   -> Promise<{ text, committed, tentative, reusedSentences, prefixTokens, decodedTokens, pivot, processingMs }>
+// text: the stream's whole caption so far.
+inline Napi::Value TranslatePartial(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 4 || !info[0].IsString() || !info[1].IsString() || !info[2].IsString() || !info[3].IsString()) {
+		Napi::TypeError::New(env, "Stream name, text, source and target language required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	TranslationJobConfig config;
+	bool final = false;
+	if (info.Length() > 4 && info[4].IsObject()) {
+		Napi::Object obj = info[4].As<Napi::Object>();
+		std::string error;
+		if (!ReadUint32Option(obj, "beamSize", 1, 8, &config.beamSize, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		Napi::Value v = obj.Get("final");
+		if (!v.IsUndefined()) {
+			if (!v.IsBoolean()) {
+				Napi::TypeError::New(env, "Option 'final' must be a boolean").ThrowAsJavaScriptException();
+				return env.Null();
+			}
+			final = v.As<Napi::Boolean>().Value();
+		}
+	}
+	return QueueQuery(env, "TranslatePartial",
+		[name = info[0].As<Napi::String>().Utf8Value(), text = info[1].As<Napi::String>().Utf8Value(),
+		 from = info[2].As<Napi::String>().Utf8Value(), to = info[3].As<Napi::String>().Utf8Value(), final, config]() {
+			PartialTranslationResult result;
+			Translation().TranslatePartial(name, text, from, to, final, config, &result);
+			return result;
+		},
+		[](Napi::Env env, PartialTranslationResult& result) -> Napi::Value {
+			if (!result.error.empty()) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("text", Napi::String::New(env, result.text));
+			o.Set("committed", Napi::String::New(env, result.committed));
+			o.Set("tentative", Napi::String::New(env, result.tentative));
+			o.Set("reusedSentences", Napi::Number::New(env, result.reusedSentences));
+			o.Set("prefixTokens", Napi::Number::New(env, result.prefixTokens));
+			o.Set("decodedTokens", Napi::Number::New(env, result.decodedTokens));
+			o.Set("pivot", Napi::Boolean::New(env, result.pivot));
+			o.Set("processingMs", Napi::Number::New(env, result.processingMs));
+			return o;
+		});
+}
+
+// Frees every pair on the threadpool; translations in flight finish first.
+inline Napi::Value UnloadTranslationModels(const Napi::CallbackInfo& info) {
+	return QueueQuery(info.Env(), "UnloadTranslationModels",
+		[]() {
+			Translation().Unload();
+			return true;
+		},
+		[](Napi::Env env, bool&) -> Napi::Value { return env.Undefined(); });
+}
+
+inline Napi::Array TranslationModelsToJs(Napi::Env env) {
+	const std::vector<TranslationPairInfo> pairs = Translation().Loaded();
+	Napi::Array out = Napi::Array::New(env, pairs.size());
+	for (size_t i = 0; i < pairs.size(); ++i) {
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("from", Napi::String::New(env, pairs[i].from));
+		o.Set("to", Napi::String::New(env, pairs[i].to));
+		o.Set("computeType", Napi::String::New(env, pairs[i].info.computeType));
+		o.Set("weightsMb", Napi::Number::New(env, pairs[i].info.weightsMb));
+		o.Set("memoryMb", Napi::Number::New(env, pairs[i].info.memoryMb));
+		out.Set((uint32_t)i, o);
+	}
+	return out;
+}
+
+// getTranslationModels() -> [{ from, to, computeType, weightsMb, memoryMb }]
+inline Napi::Value GetTranslationModels(const Napi::CallbackInfo& info) {
+	return TranslationModelsToJs(info.Env());
+}
@@ -0,0 +1,454 @@
+#pragma once
+
+// Disk-backed cache of synthesized TTS audio, so hot phrases survive restarts
+// without their audio living on the V8 heap. Records are appended to segment
+// files in the cache directory (tts-00000001.seg, ...; a new one every
+// kTtsSegmentBytes) and read back through memory maps: a hit reaches JS as an
+// external Buffer over the mapping (one copy where the runtime forbids
+// external buffers) that keeps its segment mapped until it is collected; the
+// pages are mapped copy-on-write, so a write from JS never reaches the file.
+// The index is a hash map from the 64-bit FNV-1a of (text, voiceId, modelId)
+// to the newest record, rebuilt on open by walking the record headers; a hit
+// also compares the stored key. When the segments pass maxMb the oldest one
+// is deleted, after a hit in it has been appended again, so phrases still in
+// use move forward. The audio is stored as synthesized (the provider's mp3,
+// opus or pcm bytes) with its format string.
+//
+//   openTtsCache(cacheDir, { maxMb? }) -> Promise<{ entries, bytes, segments }>
+//   getTtsCache(text, voiceId, modelId?) -> { audio: Buffer, format } | null
+//   putTtsCache(text, voiceId, modelId, audio, format?) -> boolean
+//   closeTtsCache()
+//
+// The cache is used from the JS thread only; open scans on the threadpool
+// and installs the result when it settles. Layout, little-endian:
+//
+//   tts-cache.head  char magic[4] "WTCH", u32 version, u32 first, u32 last segment
+//   segment         char magic[4] "WTCS", u32 version, 56 reserved bytes, then records
+//   record          { char magic[4] "WTCR", u32 keyBytes, u32 audioBytes, u32 reserved,
+//                     u64 keyHash, char format[16], u64 reserved } then the key
+//                   and the audio, each padded to 16 bytes
+
+#include <napi.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "addon_instance.h"
+#include "addon_log.h"
+#include "async_query.h"
+#include "capture_options.h"
+#include "mapped_file.h"
+
+constexpr uint32_t kTtsCacheVersion = 1;
+constexpr uint64_t kTtsSegmentBytes = 32ull << 20;
+constexpr size_t kTtsSegmentHeader = 64;
+constexpr uint32_t kTtsMaxKeyBytes = 64u << 10;
+constexpr uint32_t kTtsMaxAudioBytes = 16u << 20;
+
+struct TtsCacheRecordHeader {
+	char magic[4]; // "WTCR"
+	uint32_t keyBytes;
+	uint32_t audioBytes;
+	uint32_t reserved0;
+	uint64_t keyHash;
+	char format[16]; // NUL-padded
+	uint64_t reserved1;
+};
+static_assert(sizeof(TtsCacheRecordHeader) == 48, "record header must keep the payload 16-byte aligned");
+
+inline uint64_t TtsCacheHash(const std::string& key) {
+	uint64_t h = 1469598103934665603ull;
+	for (unsigned char c : key) h = (h ^ c) * 1099511628211ull;
+	return h;
+}
+
+inline std::string TtsCacheKey(const std::string& text, const std::string& voiceId, const std::string& modelId) {
+	std::string key = text;
+	key += '\0';
+	key += voiceId;
+	key += '\0';
+	key += modelId;
+	return key;
+}
+
+inline uint64_t TtsCachePad(uint64_t bytes) { return (bytes + 15) & ~uint64_t(15); }
+
+// A hit: audio points into map, which must outlive any use of it.
+struct TtsCacheHit {
+	std::shared_ptr<MappedFile> map;
+	const uint8_t* audio = nullptr;
+	size_t bytes = 0;
+	std::string format;
+};
+
+class TtsAudioCache {
+public:
+	TtsAudioCache() = default;
+	TtsAudioCache(const TtsAudioCache&) = delete;
+	TtsAudioCache& operator=(const TtsAudioCache&) = delete;
+	~TtsAudioCache() {
+		if (active_) fclose(active_);
+	}
+
+	// Indexes the segments listed by the head file; a missing or unreadable
+	// head starts an empty cache. Runs on the threadpool.
+	bool Open(const std::string& dir, uint64_t maxBytes, std::string* error) {
+		dir_ = dir;
+		if (!dir_.empty() && dir_.back() != '/' && dir_.back() != '\\') dir_ += '/';
+		maxBytes_ = std::max<uint64_t>(maxBytes, kTtsSegmentBytes);
+		uint32_t first = 1, last = 0;
+		ReadHead(&first, &last);
+		bool torn = false;
+		for (uint32_t number = first; number <= last && last - first < 100000; ++number) {
+			Segment segment;
+			segment.number = number;
+			if (!ScanSegment(&segment, &torn)) continue;
+			segments_.push_back(std::move(segment));
+		}
+		nextNumber_ = last + 1;
+		// Appending resumes in the newest segment unless its tail was torn by a crash
+		if (!segments_.empty() && !torn && segments_.back().bytes < kTtsSegmentBytes) {
+			Segment& tail = segments_.back();
+			active_ = OpenFileUtf8(SegmentPath(tail.number), "ab");
+		}
+		if (!active_ && !StartSegment(error)) return false;
+		Evict();
+		return true;
+	}
+
+	bool Get(const std::string& text, const std::string& voiceId, const std::string& modelId, TtsCacheHit* hit) {
+		const std::string key = TtsCacheKey(text, voiceId, modelId);
+		auto it = index_.find(TtsCacheHash(key));
+		if (it == index_.end()) return false;
+		const Record record = it->second;
+		Segment* segment = FindSegment(record.segment);
+		if (!segment) {
+			index_.erase(it);
+			return false;
+		}
+		const uint64_t end = record.offset + sizeof(TtsCacheRecordHeader) + TtsCachePad(record.keyBytes) + record.audioBytes;
+		if (!segment->map || segment->map->Size() < end) {
+			// The active segment grew since it was mapped; buffers over the old map keep it alive
+			auto map = std::make_shared<MappedFile>();
+			std::string ignored;
+			if (!map->Open(SegmentPath(segment->number), &ignored, true) || map->Size() < end) return false;
+			segment->map = std::move(map);
+		}
+		const uint8_t* base = segment->map->Data() + record.offset;
+		TtsCacheRecordHeader header;
+		memcpy(&header, base, sizeof(header));
+		const uint8_t* storedKey = base + sizeof(header);
+		if (header.keyBytes != key.size() || memcmp(storedKey, key.data(), key.size()) != 0) return false; // hash collision
+		hit->map = segment->map;
+		hit->audio = storedKey + TtsCachePad(header.keyBytes);
+		hit->bytes = header.audioBytes;
+		hit->format.assign(header.format, strnlen(header.format, sizeof(header.format)));
+		++hits_;
+		// A phrase still in use moves out of the segment that goes next
+		if (segments_.size() > 1 && record.segment == segments_.front().number) {
+			Append(key, hit->audio, hit->bytes, hit->format, nullptr);
+		}
+		return true;
+	}
+
+	bool Put(const std::string& text, const std::string& voiceId, const std::string& modelId,
+	         const uint8_t* audio, size_t bytes, const std::string& format, std::string* error) {
+		return Append(TtsCacheKey(text, voiceId, modelId), audio, bytes, format, error);
+	}
+
+	size_t Entries() const { return index_.size(); }
+	uint64_t Hits() const { return hits_; }
+	size_t Segments() const { return segments_.size(); }
+	uint64_t Bytes() const {
+		uint64_t total = 0;
+		for (const Segment& s : segments_) total += s.bytes;
+		return total;
+	}
+
+private:
+	struct Segment {
+		uint32_t number = 0;
+		uint64_t bytes = 0;               // written so far
+		std::shared_ptr<MappedFile> map;  // may trail bytes while the segment is active
+	};
+
+	struct Record {
+		uint32_t segment;
+		uint64_t offset;
+		uint32_t keyBytes, audioBytes;
+	};
+
+	std::string SegmentPath(uint32_t number) const {
+		char name[32];
+		snprintf(name, sizeof(name), "tts-%08u.seg", number);
+		return dir_ + name;
+	}
+
+	Segment* FindSegment(uint32_t number) {
+		for (Segment& s : segments_) {
+			if (s.number == number) return &s;
+		}
+		return nullptr;
+	}
+
+	void ReadHead(uint32_t* first, uint32_t* last) {
+		FILE* f = OpenFileUtf8(dir_ + "tts-cache.head", "rb");
+		if (!f) return;
+		char magic[4];
+		uint32_t fields[3];
+		if (fread(magic, 1, 4, f) == 4 && fread(fields, sizeof(uint32_t), 3, f) == 3 &&
+		    memcmp(magic, "WTCH", 4) == 0 && fields[0] == kTtsCacheVersion && fields[1] >= 1 && fields[2] + 1 >= fields[1]) {
+			*first = fields[1];
+			*last = fields[2];
+		}
+		fclose(f);
+	}
+
+	// Written aside and moved over, so a crash leaves the old head or the new one.
+	void WriteHead() {
+		const std::string path = dir_ + "tts-cache.head", temp = path + ".tmp";
+		FILE* f = OpenFileUtf8(temp, "wb");
+		if (!f) return;
+		const uint32_t fields[3] = { kTtsCacheVersion, segments_.empty() ? nextNumber_ : segments_.front().number, nextNumber_ - 1 };
+		const bool ok = fwrite("WTCH", 1, 4, f) == 4 && fwrite(fields, sizeof(uint32_t), 3, f) == 3;
+		if (fclose(f) == 0 && ok) MoveFileReplacing(temp, path);
+	}
+
+	// Maps a segment and indexes its records; a newer record of a key replaces
+	// the older one. torn is set when the last records are incomplete.
+	bool ScanSegment(Segment* segment, bool* torn) {
+		auto map = std::make_shared<MappedFile>();
+		std::string ignored;
+		if (!map->Open(SegmentPath(segment->number), &ignored, true)) return false;
+		const uint8_t* data = map->Data();
+		const size_t size = map->Size();
+		uint32_t version = 0;
+		if (size < kTtsSegmentHeader || memcmp(data, "WTCS", 4) != 0 || (memcpy(&version, data + 4, 4), version) != kTtsCacheVersion) {
+			return false;
+		}
+		uint64_t offset = kTtsSegmentHeader;
+		*torn = false;
+		while (offset < size) {
+			TtsCacheRecordHeader header;
+			if (size - offset < sizeof(header)) break;
+			memcpy(&header, data + offset, sizeof(header));
+			const uint64_t end = offset + sizeof(header) + TtsCachePad(header.keyBytes) + TtsCachePad(header.audioBytes);
+			if (memcmp(header.magic, "WTCR", 4) != 0 || header.keyBytes > kTtsMaxKeyBytes ||
+			    header.audioBytes > kTtsMaxAudioBytes || end > size) {
+				break;
+			}
+			const std::string key(reinterpret_cast<const char*>(data + offset + sizeof(header)), header.keyBytes);
+			if (TtsCacheHash(key) != header.keyHash) break;
+			index_[header.keyHash] = Record{ segment->number, offset, header.keyBytes, header.audioBytes };
+			offset = end;
+		}
+		if (offset < size) {
+			*torn = true;
+			AddonLog(LogLevel::Warn, "TTS cache: segment %u ends in an incomplete record at %llu", segment->number,
+			         (unsigned long long)offset);
+		}
+		segment->bytes = offset;
+		segment->map = std::move(map);
+		return true;
+	}
+
+	bool StartSegment(std::string* error) {
+		if (active_) fclose(active_);
+		const uint32_t number = nextNumber_++;
+		active_ = OpenFileUtf8(SegmentPath(number), "wb");
+		if (!active_) {
+			if (error) *error = "could not create TTS cache segment in " + dir_;
+			return false;
+		}
+		uint8_t header[kTtsSegmentHeader] = {};
+		memcpy(header, "WTCS", 4);
+		memcpy(header + 4, &kTtsCacheVersion, 4);
+		if (fwrite(header, 1, sizeof(header), active_) != sizeof(header) || fflush(active_) != 0) {
+			if (error) *error = "could not write TTS cache segment in " + dir_;
+			fclose(active_);
+			active_ = nullptr;
+			return false;
+		}
+		Segment segment;
+		segment.number = number;
+		segment.bytes = kTtsSegmentHeader;
+		segments_.push_back(std::move(segment));
+		WriteHead();
+		return true;
+	}
+
+	bool Append(const std::string& key, const uint8_t* audio, size_t bytes, const std::string& format, std::string* error) {
+		if (key.size() > kTtsMaxKeyBytes || bytes == 0 || bytes > kTtsMaxAudioBytes) {
+			if (error) *error = "TTS cache entry too large";
+			return false;
+		}
+		if (!active_) {
+			if (error) *error = "TTS cache is not open";
+			return false;
+		}
+		const uint64_t recordBytes = sizeof(TtsCacheRecordHeader) + TtsCachePad(key.size()) + TtsCachePad(bytes);
+		if (segments_.back().bytes + recordBytes > kTtsSegmentBytes && segments_.back().bytes > kTtsSegmentHeader) {
+			if (!StartSegment(error)) return false;
+		}
+		Segment& segment = segments_.back();
+		TtsCacheRecordHeader header = {};
+		memcpy(header.magic, "WTCR", 4);
+		header.keyBytes = (uint32_t)key.size();
+		header.audioBytes = (uint32_t)bytes;
+		header.keyHash = TtsCacheHash(key);
+		memcpy(header.format, format.data(), std::min(format.size(), sizeof(header.format) - 1));
+		static const uint8_t zeros[16] = {};
+		const bool ok = fwrite(&header, sizeof(header), 1, active_) == 1 &&
+			fwrite(key.data(), 1, key.size(), active_) == key.size() &&
+			fwrite(zeros, 1, TtsCachePad(key.size()) - key.size(), active_) == TtsCachePad(key.size()) - key.size() &&
+			fwrite(audio, 1, bytes, active_) == bytes &&
+			fwrite(zeros, 1, TtsCachePad(bytes) - bytes, active_) == TtsCachePad(bytes) - bytes &&
+			fflush(active_) == 0;
+		if (!ok) {
+			// The partial record is found torn on the next open; write on in a fresh segment
+			if (error) *error = "could not append to the TTS cache";
+			fclose(active_);
+			active_ = nullptr;
+			StartSegment(nullptr);
+			return false;
+		}
+		index_[header.keyHash] = Record{ segment.number, segment.bytes, header.keyBytes, header.audioBytes };
+		segment.bytes += recordBytes;
+		Evict();
+		return true;
+	}
+
+	// Deletes the oldest segments until the cache fits; the active one stays.
+	void Evict() {
+		bool evicted = false;
+		while (segments_.size() > 1 && Bytes() > maxBytes_) {
+			const uint32_t number = segments_.front().number;
+			for (auto it = index_.begin(); it != index_.end();) {
+				if (it->second.segment == number) it = index_.erase(it);
+				else ++it;
+			}
+			segments_.pop_front(); // buffers still over its map keep the pages
+			RemoveFile(SegmentPath(number));
+			evicted = true;
+		}
+		if (evicted) WriteHead();
+	}
+
+	std::string dir_;
+	uint64_t maxBytes_ = 256ull << 20;
+	std::deque<Segment> segments_; // oldest first; the last one is appended to
+	std::unordered_map<uint64_t, Record> index_;
+	FILE* active_ = nullptr;
+	uint32_t nextNumber_ = 1;
+	uint64_t hits_ = 0;
+};
+
+// One open cache per environment (addon_instance.h); JS thread.
+inline std::shared_ptr<TtsAudioCache>& TtsCacheInstance(Napi::Env env) {
+	return PerEnv<std::shared_ptr<TtsAudioCache>>(env);
+}
+
+// openTtsCache(cacheDir, { maxMb? }) -> Promise<{ entries, bytes, segments }>
+inline Napi::Value OpenTtsCache(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Cache directory required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	uint32_t maxMb = 256;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		std::string error;
+		if (!ReadUint32Option(info[1].As<Napi::Object>(), "maxMb", 32, 65536, &maxMb, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+	struct Opened {
+		std::shared_ptr<TtsAudioCache> cache;
+		std::string error;
+	};
+	return QueueQuery(env, "OpenTtsCache",
+		[dir = info[0].As<Napi::String>().Utf8Value(), maxMb]() {
+			Opened result;
+			auto cache = std::make_shared<TtsAudioCache>();
+			if (cache->Open(dir, (uint64_t)maxMb << 20, &result.error)) result.cache = std::move(cache);
+			return result;
+		},
+		[](Napi::Env env, Opened& result) -> Napi::Value {
+			if (!result.cache) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("entries", Napi::Number::New(env, (double)result.cache->Entries()));
+			o.Set("bytes", Napi::Number::New(env, (double)result.cache->Bytes()));
+			o.Set("segments", Napi::Number::New(env, (double)result.cache->Segments()));
+			TtsCacheInstance(env) = std::move(result.cache);
+			return o;
+		});
+}
+
+inline bool ReadTtsKeyArgs(const Napi::CallbackInfo& info, std::string* text, std::string* voiceId, std::string* modelId) {
+	if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
+		Napi::TypeError::New(info.Env(), "Expected (text, voiceId, modelId?)").ThrowAsJavaScriptException();
+		return false;
+	}
+	*text = info[0].As<Napi::String>().Utf8Value();
+	*voiceId = info[1].As<Napi::String>().Utf8Value();
+	if (info.Length() > 2 && info[2].IsString()) *modelId = info[2].As<Napi::String>().Utf8Value();
+	return true;
+}
+
+// getTtsCache(text, voiceId, modelId?) -> { audio: Buffer, format } | null
+inline Napi::Value GetTtsCache(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::string text, voiceId, modelId;
+	if (!ReadTtsKeyArgs(info, &text, &voiceId, &modelId)) return env.Null();
+	TtsCacheHit hit;
+	if (!TtsCacheInstance(env) || !TtsCacheInstance(env)->Get(text, voiceId, modelId, &hit)) return env.Null();
+	auto* keep = new std::shared_ptr<MappedFile>(std::move(hit.map));
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("audio", Napi::Buffer<uint8_t>::NewOrCopy(env, const_cast<uint8_t*>(hit.audio), hit.bytes,
+		[keep](Napi::Env, uint8_t*) { delete keep; }));
+	o.Set("format", Napi::String::New(env, hit.format));
+	return o;
+}
+
+// putTtsCache(text, voiceId, modelId, audio, format?) -> boolean
+inline Napi::Value PutTtsCache(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::string text, voiceId, modelId;
+	if (!ReadTtsKeyArgs(info, &text, &voiceId, &modelId)) return env.Null();
+	const uint8_t* audio = nullptr;
+	size_t bytes = 0;
+	if (info.Length() > 3 && info[3].IsArrayBuffer()) {
+		Napi::ArrayBuffer buffer = info[3].As<Napi::ArrayBuffer>();
+		audio = static_cast<const uint8_t*>(buffer.Data());
+		bytes = buffer.ByteLength();
+	} else if (info.Length() > 3 && info[3].IsTypedArray()) {
+		Napi::TypedArray view = info[3].As<Napi::TypedArray>();
+		audio = static_cast<const uint8_t*>(view.ArrayBuffer().Data()) + view.ByteOffset();
+		bytes = view.ByteLength();
+	} else {
+		Napi::TypeError::New(env, "Audio must be an ArrayBuffer or a typed array").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const std::string format = info.Length() > 4 && info[4].IsString() ? info[4].As<Napi::String>().Utf8Value() : "";
+	if (!TtsCacheInstance(env)) return Napi::Boolean::New(env, false);
+	std::string error;
+	const bool stored = TtsCacheInstance(env)->Put(text, voiceId, modelId, audio, bytes, format, &error);
+	if (!stored) AddonLog(LogLevel::Warn, "TTS cache: %s", error.c_str());
+	return Napi::Boolean::New(env, stored);
+}
+
+// closeTtsCache(); buffers already handed out stay valid.
+inline Napi::Value CloseTtsCache(const Napi::CallbackInfo& info) {
+	TtsCacheInstance(info.Env()).reset();
+	return info.Env().Undefined();
+}
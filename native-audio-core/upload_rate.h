@@ -0,0 +1,115 @@
+#pragma once
+
+// Network-aware Opus bitrate for chunk uploads. The STT clients report each
+// upload's size and network time with reportUploadThroughput(bytes, ms); an
+// Opus encode given option uploadBudgetMs (encodeOpus, encodeAudio) then picks
+// the chunk's bitrate so the file should upload within that budget at the
+// measured throughput, between kMinBitrate and kMaxBitrate, and a complexity
+// to go with it: the fewer the bits, the more the encoder's effort is worth.
+// The encoded Buffer carries the pick as .bitrate and .complexity, and
+// getUploadRate() reports the estimate and the last pick.
+//
+// Throughput is the decayed sum of bytes over the decayed sum of
+// milliseconds, so large uploads weigh more than small ones and the estimate
+// follows the network within a few chunks. Uploads under kMinReportBytes are
+// mostly round trip and are left out; with no estimate yet, kDefaultBitrate.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <cstdint>
+
+#include "addon_instance.h"
+
+class UploadRateController {
+public:
+	static constexpr uint32_t kMinBitrate = 12000;
+	static constexpr uint32_t kMaxBitrate = 32000;
+	static constexpr uint32_t kDefaultBitrate = 24000;
+	static constexpr uint32_t kMinComplexity = 5;  // at kMaxBitrate
+	static constexpr uint32_t kMaxComplexity = 10; // at kMinBitrate
+	static constexpr double kHeadroom = 0.6;        // of the budget: the rest is request, response and jitter
+	static constexpr double kOverheadBytes = 1024;  // Ogg headers and the multipart form
+	static constexpr double kDecay = 0.7;           // per report
+	static constexpr uint64_t kMinReportBytes = 4096;
+
+	struct Choice {
+		uint32_t bitrate = kDefaultBitrate;
+		uint32_t complexity = kMinComplexity;
+		double uploadMs = 0.0; // expected at the measured throughput; 0 without one
+	};
+
+	// JS thread, after an upload: its bytes and the time they took on the
+	// network (server processing left out where the response says).
+	void Report(uint64_t bytes, double ms) {
+		if (bytes < kMinReportBytes || !(ms > 0.0)) return;
+		bytes_ = kDecay * bytes_ + (double)bytes;
+		ms_ = kDecay * ms_ + ms;
+		++reports_;
+	}
+
+	// Bytes per second, 0 before the first report.
+	double Throughput() const { return ms_ > 0.0 ? bytes_ * 1000.0 / ms_ : 0.0; }
+
+	// JS thread: for a chunk of audioMs to upload within budgetMs.
+	Choice Pick(double audioMs, double budgetMs) {
+		Choice choice;
+		const double rate = Throughput();
+		if (rate > 0.0 && audioMs > 0.0) {
+			const double bytes = rate * budgetMs / 1000.0 * kHeadroom - kOverheadBytes;
+			const double bitrate = std::max(0.0, bytes) * 8.0 * 1000.0 / audioMs;
+			choice.bitrate = (uint32_t)std::min<double>(kMaxBitrate, std::max<double>(kMinBitrate, bitrate));
+			choice.uploadMs = ((double)choice.bitrate * audioMs / 8000.0 + kOverheadBytes) * 1000.0 / rate;
+			if (choice.uploadMs > budgetMs) ++overBudget_;
+		}
+		choice.complexity = kMaxComplexity -
+			(choice.bitrate - kMinBitrate) * (kMaxComplexity - kMinComplexity) / (kMaxBitrate - kMinBitrate);
+		last_ = choice;
+		++picks_;
+		return choice;
+	}
+
+	Napi::Object ToJs(Napi::Env env) const {
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("throughputKbps", Napi::Number::New(env, Throughput() * 8.0 / 1000.0));
+		o.Set("reports", Napi::Number::New(env, (double)reports_));
+		o.Set("picks", Napi::Number::New(env, (double)picks_));
+		o.Set("overBudget", Napi::Number::New(env, (double)overBudget_)); // even kMinBitrate was expected late
+		if (picks_ > 0) {
+			o.Set("bitrate", Napi::Number::New(env, last_.bitrate));
+			o.Set("complexity", Napi::Number::New(env, last_.complexity));
+			o.Set("expectedUploadMs", Napi::Number::New(env, last_.uploadMs));
+		}
+		return o;
+	}
+
+private:
+	double bytes_ = 0.0; // decayed
+	double ms_ = 0.0;
+	uint64_t reports_ = 0;
+	uint64_t picks_ = 0;
+	uint64_t overBudget_ = 0;
+	Choice last_;
+};
+
+inline UploadRateController& UploadRate(Napi::Env env) {
+	return PerEnv<UploadRateController>(env);
+}
+
+// reportUploadThroughput(bytes: number, ms: number)
+inline Napi::Value ReportUploadThroughput(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber()) {
+		Napi::TypeError::New(env, "Byte count and milliseconds required").ThrowAsJavaScriptException();
+		return env.Undefined();
+	}
+	const double bytes = info[0].As<Napi::Number>().DoubleValue();
+	const double ms = info[1].As<Napi::Number>().DoubleValue();
+	if (bytes >= 0.0) UploadRate(env).Report((uint64_t)bytes, ms);
+	return env.Undefined();
+}
+
+// getUploadRate() -> { throughputKbps, reports, picks, overBudget, bitrate?, complexity?, expectedUploadMs? }
+inline Napi::Value GetUploadRate(const Napi::CallbackInfo& info) {
+	return UploadRate(info.Env()).ToJs(info.Env());
+}
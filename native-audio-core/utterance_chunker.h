@@ -0,0 +1,454 @@
+#pragma once
+
+// Silence-based utterance segmentation on top of the per-frame VAD decisions.
+// Frames accumulate into the open chunk, which is cut at the first pause of
+// pauseMs after speech once it is at least minChunkMs long, or forced at
+// maxChunkMs. Every chunk is prefixed with the last overlapMs of the previous
+// one so a word split by the cut survives. flushSilenceMs of silence flushes a
+// chunk and forgets the overlap; resetSilenceMs discards whatever is open.
+// At a speech onset the open chunk keeps only prerollMs of the frames before
+// it (the overlap goes too if any were dropped), and TakeOnset() tells the
+// writer it may refill them from its pre-gate ring. With `stream` set the
+// writer also sends each utterance out while it is still open
+// (utterance_stream.h); Speaking() and the overlap accessors are for that.
+// CutBack() cuts the open chunk some frames in the past, at a speaker change
+// (speaker_change.h): the frames after it open the next chunk.
+// With `adaptive` the chunker measures the speaker's syllable rate
+// (speech_rate.h) and scales pauseMs and minChunkMs by kReferenceRate over it,
+// within kMinRateScale..kMaxRateScale: a slow speaker's longer gaps inside a
+// phrase no longer end a chunk early, a fast one's chunks reach minChunkMs of
+// content sooner, and fewer, fuller chunks go out for transcription.
+// maxChunkMs stays the latency bound, but the forced cut lands after the
+// quietest frame of the last kDipSearchMs, a dip between syllables, instead
+// of mid-word; the frames after it open the next chunk (no overlap, as with
+// CutBack()). Not with `stream`, whose utterance already went out past it.
+// With valleyMs the same search runs whatever `adaptive` says, over the last
+// valleyMs, and the overlap goes wherever a cut lands in a real valley: a
+// frame kValleyDepthDb under the loudest of the window. A pause cut ends in
+// one when its silence is that much quieter than the chunk's loudest frame,
+// and a max-length cut when its quietest frame is under the window's. No word straddles such a cut,
+// so nothing is uploaded and transcribed twice. A cut with no valley, such
+// as a forced cut in steady music or a pause the VAD heard over noise,
+// keeps the overlap as before.
+// With trimMs the chunk leaves out the non-speech around its voiced frames
+// (those the VAD called speech before its hangover) beyond trimMs on either
+// side: the pre-roll and a leading overlap ahead of a longer lead-in, the
+// pause and the hangover after the last voiced frame. Cuts that keep frames
+// open (CutBack(), a dip) are only trimmed at the start.
+// With `compact`, a run of unvoiced frames inside the chunk longer than
+// minPauseMs shrinks to gapMs: half of the gap stays after the words before
+// it, half ahead of the words after it. TakeChunk() then lists where the
+// chunk's time jumps, so timestamps a transcription returns map back to the
+// capture.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "speech_rate.h"
+
+enum class UtteranceCut : uint8_t { Pause, MaxLength, Silence, Speaker };
+
+inline const char* UtteranceCutName(UtteranceCut cut) {
+	switch (cut) {
+	case UtteranceCut::MaxLength: return "max-length";
+	case UtteranceCut::Silence: return "silence";
+	case UtteranceCut::Speaker: return "speaker";
+	default: return "pause";
+	}
+}
+
+// Option chunker.stream: true or { intervalMs, codec, bitrate }.
+struct UtteranceStreamConfig {
+	bool enabled = false;
+	uint32_t intervalMs = 200; // how often the open utterance's new audio goes out
+#if defined(AUDIO_CORE_OPUS)
+	bool opus = true;          // codec 'opus' (the default where built in): Ogg-Opus pages; 'pcm16': raw samples
+#else
+	bool opus = false;
+#endif
+	uint32_t bitrate = 24000;  // codec 'opus'
+};
+
+// Option chunker.compact: true or { minPauseMs, gapMs }.
+struct PauseCompactConfig {
+	bool enabled = false;
+	uint32_t minPauseMs = 600; // longer unvoiced runs inside a chunk shrink
+	uint32_t gapMs = 200;      // to this
+};
+
+struct UtteranceChunkerConfig {
+	bool enabled = false;
+	uint32_t minChunkMs = 1000; // adjustable while capturing (PcmChannel::SetMinChunkMs)
+	uint32_t maxChunkMs = 3000;
+	uint32_t pauseMs = 50;
+	uint32_t overlapMs = 100;
+	uint32_t prerollMs = 300; // 0 keeps every frame before the onset
+	uint32_t flushSilenceMs = 1000;
+	uint32_t resetSilenceMs = 2000;
+	bool adaptive = false;      // scale pauseMs and minChunkMs by the syllable rate, cut max-length chunks in a dip
+	uint32_t valleyMs = 0;      // cut max-length chunks at the energy valley of this window, no overlap after valley cuts; 0 = off
+	uint32_t trimMs = 0;        // non-speech kept around the voiced frames; 0 = no trimming
+	PauseCompactConfig compact; // shrink long pauses inside a chunk
+	UtteranceStreamConfig stream;
+};
+
+struct UtteranceChunkInfo {
+	UtteranceCut cut = UtteranceCut::Pause;
+	uint32_t overlapSamples = 0; // leading samples repeated from the previous chunk
+	uint32_t pauseMs = 0;        // silence at the end of the chunk
+	uint32_t trimmedSamples = 0; // non-speech left out at either end (trimMs)
+	uint32_t compactedSamples = 0; // left out of pauses inside it (compact)
+	float syllableRate = 0.0f;   // `adaptive`: the speaker's syllables a second, 0 while unknown
+};
+
+class UtteranceChunker {
+public:
+	static constexpr float kReferenceRate = 4.5f; // syllables a second the configured lengths are for
+	static constexpr float kMinRateScale = 0.6f;
+	static constexpr float kMaxRateScale = 1.6f;
+	static constexpr uint32_t kDipSearchMs = 300;
+	static constexpr float kValleyDepthDb = 9.0f;
+
+	void Configure(const UtteranceChunkerConfig& config, size_t frameSamples, uint32_t frameMs) {
+		frameSamples_ = config.enabled && frameMs > 0 ? frameSamples : 0;
+		if (frameSamples_ == 0) return;
+		frameMs_ = frameMs;
+		maxFrames_ = std::max<uint32_t>(1, config.maxChunkMs / frameMs);
+		pauseFrames_ = std::max<uint32_t>(1, config.pauseMs / frameMs);
+		overlapFrames_ = config.overlapMs / frameMs;
+		prerollFrames_ = (config.prerollMs + frameMs - 1) / frameMs;
+		flushFrames_ = std::max<uint32_t>(1, config.flushSilenceMs / frameMs);
+		resetFrames_ = std::max<uint32_t>(1, config.resetSilenceMs / frameMs);
+		adaptive_ = config.adaptive;
+		if (adaptive_) rate_.Configure(frameMs);
+		valley_ = config.valleyMs > 0 && !config.stream.enabled;
+		dipFrames_ = config.stream.enabled ? 0 : valley_ ? std::max<uint32_t>(1, config.valleyMs / frameMs) : adaptive_ ? kDipSearchMs / frameMs : 0;
+		frameDb_.assign(dipFrames_ + 1, 0.0f);
+		closed_ = 0;
+		trimFrames_ = config.trimMs > 0 ? (config.trimMs + frameMs - 1) / frameMs : kNoTrim;
+		compactFrames_ = config.compact.enabled ? config.compact.minPauseMs / frameMs : kNone;
+		gapFrames_ = std::min(config.compact.gapMs / frameMs, compactFrames_);
+		// The open chunk is cut by maxFrames_ once it has speech and reset by
+		// resetFrames_ before it does, so neither buffer grows past this
+		open_.reserve((std::max(maxFrames_, resetFrames_) + 1) * frameSamples_);
+		overlap_.reserve(overlapFrames_ * frameSamples_);
+		voiced_.reserve(std::max(maxFrames_, resetFrames_) + 1);
+		Reset();
+	}
+
+	void Reset() {
+		open_.clear();
+		overlap_.clear();
+		openFrames_ = 0;
+		silence_ = 0;
+		hasSpeech_ = false;
+		onset_ = false;
+		keepFrames_ = 0;
+		valleyCut_ = false;
+		chunkPeakDb_ = 0.0f;
+		voiced_.clear();
+	}
+
+	bool Enabled() const { return frameSamples_ > 0; }
+	// Nothing open and no overlap held: the next frame starts from scratch.
+	bool Idle() const { return open_.empty() && overlap_.empty(); }
+
+	// Largest chunk TakeChunk() can produce, for sizing slots up front.
+	size_t MaxChunkSamples() const { return open_.capacity() + overlap_.capacity(); }
+
+	// Samples still missing from the current frame.
+	size_t FrameRoom() const { return frameSamples_ - (open_.size() - (size_t)openFrames_ * frameSamples_); }
+
+	// Room for n more samples of the current frame (n <= FrameRoom()).
+	int16_t* Extend(size_t n) {
+		const size_t at = open_.size();
+		open_.resize(at + n);
+		return open_.data() + at;
+	}
+
+	// Closes the current frame with its VAD decision; voiced is that decision
+	// without the detector's hangover. Returns true when a chunk is ready;
+	// TakeChunk() must then be called before the next frame.
+	bool EndFrame(bool speech, uint32_t minChunkMs, bool voiced) {
+		++openFrames_;
+		voiced_.push_back(speech && voiced);
+		if (dipFrames_ > 0 || adaptive_) Measure(speech);
+		if (speech) {
+			if (!hasSpeech_ && prerollFrames_ > 0) Onset();
+			hasSpeech_ = true;
+			silence_ = 0;
+		} else {
+			++silence_;
+		}
+		if (!hasSpeech_) {
+			if (silence_ >= resetFrames_) Reset();
+			return false;
+		}
+		uint32_t minFrames = minChunkMs / frameMs_;
+		uint32_t pauseFrames = pauseFrames_;
+		const float rate = adaptive_ ? rate_.Rate() : 0.0f;
+		if (rate > 0.0f) {
+			const float scale = std::min(std::max(rate / kReferenceRate, kMinRateScale), kMaxRateScale);
+			minFrames = (uint32_t)std::lround(minFrames / scale);
+			pauseFrames = std::max<uint32_t>(1, (uint32_t)std::lround(pauseFrames / scale));
+		}
+		if (openFrames_ >= maxFrames_) return CutAtDip() || Cut(UtteranceCut::MaxLength);
+		if (openFrames_ >= minFrames && silence_ >= pauseFrames) {
+			valleyCut_ = valley_ && FrameDb(0) <= chunkPeakDb_ - kValleyDepthDb;
+			return Cut(UtteranceCut::Pause);
+		}
+		if (openFrames_ >= minFrames && silence_ >= flushFrames_) return Cut(UtteranceCut::Silence);
+		if (silence_ >= resetFrames_) Reset(); // never reached minChunkMs
+		return false;
+	}
+
+	// Whole frames in the open chunk; drops to 0 when it is reset.
+	uint32_t OpenFrames() const { return openFrames_; }
+
+	// Frames past the cut that stay open, after a cut at a dip or CutBack().
+	uint32_t KeepFrames() const { return keepFrames_; }
+
+	// `adaptive`: whose syllable rate the next frames count towards (-1 unknown).
+	void SelectSpeaker(int speaker) {
+		if (adaptive_) rate_.Select(speaker);
+	}
+
+	// Samples TakeChunk() copies out, once EndFrame() or CutBack() has cut.
+	size_t ChunkSamples() const {
+		return overlap_.size() + open_.size() - (size_t)keepFrames_ * frameSamples_ - TrimHeadSamples() - TrimTailSamples() -
+		       CompactedSamples();
+	}
+
+	// Of the ready chunk's samples, those trimMs leaves out at its start
+	// (overlap included) and its end.
+	size_t TrimHeadSamples() const {
+		uint32_t first, last;
+		if (trimFrames_ == kNoTrim || !VoicedSpan(&first, &last) || first <= trimFrames_) return 0;
+		return overlap_.size() + (size_t)(first - trimFrames_) * frameSamples_;
+	}
+	size_t TrimTailSamples() const {
+		uint32_t first, last;
+		if (trimFrames_ == kNoTrim || keepFrames_ > 0 || !VoicedSpan(&first, &last)) return 0;
+		const uint32_t after = openFrames_ - 1 - last;
+		return after > trimFrames_ ? (size_t)(after - trimFrames_) * frameSamples_ : 0;
+	}
+
+	// Of the ready chunk's samples, those `compact` leaves out of its pauses.
+	size_t CompactedSamples() const {
+		size_t dropped = 0;
+		ForEachCompacted([&](uint32_t, uint32_t frames) { dropped += (size_t)frames * frameSamples_; });
+		return dropped;
+	}
+
+	// After an EndFrame() that did not cut: cuts the open chunk before its last
+	// keepFrames whole frames (fewer than OpenFrames()), which stay open as the
+	// next chunk's start with no overlap ahead of them. TakeChunk() must follow.
+	void CutBack(uint32_t keepFrames) {
+		keepFrames_ = keepFrames;
+		pending_.cut = UtteranceCut::Speaker;
+		pending_.pauseMs = 0;
+	}
+
+	// Whole frames of the open chunk, ending with the frame just closed.
+	int16_t* OpenData() { return open_.data(); }
+	size_t OpenSamples() const { return open_.size(); }
+
+	// The open chunk has speech: it will be cut unless silence resets it.
+	bool Speaking() const { return hasSpeech_; }
+
+	// Tail of the previous chunk that TakeChunk() puts ahead of the open one.
+	const int16_t* OverlapData() const { return overlap_.data(); }
+	size_t OverlapSamples() const { return overlap_.size(); }
+
+	// True once after the EndFrame() that found the open chunk's first speech.
+	bool TakeOnset() {
+		const bool onset = onset_;
+		onset_ = false;
+		return onset;
+	}
+
+	// Copies the ready chunk (overlap first) to out, which holds ChunkSamples(),
+	// and opens the next one. With `compact`, timeMap (when given) gets a pair
+	// (sample in out, samples since the chunk's first in the capture) for
+	// each pause it shortened; it is left empty when none was.
+	UtteranceChunkInfo TakeChunk(int16_t* out, std::vector<uint32_t>* timeMap = nullptr) {
+		UtteranceChunkInfo info = pending_;
+		const size_t head = TrimHeadSamples(), tail = TrimTailSamples();
+		info.overlapSamples = head > 0 ? 0 : (uint32_t)overlap_.size();
+		info.trimmedSamples = (uint32_t)(head + tail);
+		info.syllableRate = adaptive_ ? rate_.Rate() : 0.0f;
+		if (timeMap) timeMap->clear();
+		if (info.overlapSamples > 0) memcpy(out, overlap_.data(), overlap_.size() * sizeof(int16_t));
+		const size_t keep = (size_t)keepFrames_ * frameSamples_;
+		size_t from = head > 0 ? head - overlap_.size() : 0; // in open_
+		const size_t end = open_.size() > keep + tail ? open_.size() - keep - tail : from;
+		size_t at = info.overlapSamples; // in out
+		ForEachCompacted([&](uint32_t frame, uint32_t frames) {
+			const size_t cut = (size_t)frame * frameSamples_;
+			memcpy(out + at, open_.data() + from, (cut - from) * sizeof(int16_t));
+			at += cut - from;
+			from = cut + (size_t)frames * frameSamples_;
+			info.compactedSamples += (uint32_t)((size_t)frames * frameSamples_);
+			if (timeMap) {
+				timeMap->push_back((uint32_t)at);
+				timeMap->push_back((uint32_t)(at + info.compactedSamples));
+			}
+		});
+		if (end > from) memcpy(out + at, open_.data() + from, (end - from) * sizeof(int16_t));
+		overlap_.clear();
+		if (keepFrames_ > 0) {
+			// The next speaker's frames so far: speech, and whatever silence ends them
+			open_.erase(open_.begin(), open_.end() - keep);
+			voiced_.erase(voiced_.begin(), voiced_.end() - keepFrames_);
+			openFrames_ = keepFrames_;
+			silence_ = std::min(silence_, keepFrames_);
+			chunkPeakDb_ = 0.0f;
+			if (valley_) {
+				for (uint32_t k = 0; k < std::min<uint32_t>(keepFrames_, dipFrames_ + 1); ++k) chunkPeakDb_ = std::max(chunkPeakDb_, FrameDb(k));
+			}
+			keepFrames_ = 0;
+			return info;
+		}
+		if (pending_.cut != UtteranceCut::Silence && !valleyCut_) {
+			const size_t keep = std::min(open_.size(), (size_t)overlapFrames_ * frameSamples_);
+			overlap_.insert(overlap_.end(), open_.end() - keep, open_.end());
+		}
+		open_.clear();
+		openFrames_ = 0;
+		silence_ = 0;
+		hasSpeech_ = false;
+		valleyCut_ = false;
+		chunkPeakDb_ = 0.0f;
+		voiced_.clear();
+		return info;
+	}
+
+private:
+	static constexpr uint32_t kNone = UINT32_MAX;
+	static constexpr uint32_t kNoTrim = UINT32_MAX;
+
+	// Frame boundary: the onset frame and prerollFrames_ before it stay
+	void Onset() {
+		onset_ = true;
+		if (openFrames_ <= prerollFrames_ + 1) return;
+		open_.erase(open_.begin(), open_.end() - (size_t)(prerollFrames_ + 1) * frameSamples_);
+		voiced_.erase(voiced_.begin(), voiced_.end() - (prerollFrames_ + 1));
+		openFrames_ = prerollFrames_ + 1;
+		overlap_.clear(); // no longer leads into the open chunk
+	}
+
+	// First and last voiced frames of the chunk being cut (the open chunk
+	// before keepFrames_), by index in open_; false when it has none.
+	bool VoicedSpan(uint32_t* first, uint32_t* last) const {
+		const uint32_t frames = openFrames_ - keepFrames_;
+		uint32_t f = 0;
+		while (f < frames && !voiced_[f]) ++f;
+		if (f == frames) return false;
+		uint32_t l = frames - 1;
+		while (!voiced_[l]) --l;
+		*first = f;
+		*last = l;
+		return true;
+	}
+
+	// fn(frame, frames) for each stretch of open_ `compact` leaves out, in
+	// order: the middle of every unvoiced run between two voiced frames that
+	// is longer than compactFrames_, all but gapFrames_ of it.
+	template <class Fn>
+	void ForEachCompacted(Fn&& fn) const {
+		uint32_t first, last;
+		if (compactFrames_ == kNone || !VoicedSpan(&first, &last)) return;
+		for (uint32_t f = first + 1; f < last;) {
+			if (voiced_[f]) {
+				++f;
+				continue;
+			}
+			uint32_t run = f;
+			while (run < last && !voiced_[run]) ++run;
+			if (run - f > compactFrames_) fn(f + gapFrames_ / 2, run - f - gapFrames_);
+			f = run;
+		}
+	}
+
+	// Syllable rate from the frame just closed; its energy for CutAtDip()
+	void Measure(bool speech) {
+		const int16_t* frame = open_.data() + (size_t)(openFrames_ - 1) * frameSamples_;
+		double sum = 0.0;
+		for (size_t i = 0; i < frameSamples_; ++i) sum += (double)frame[i] * frame[i];
+		const double meanSquare = sum / (double)frameSamples_;
+		if (adaptive_) rate_.Push(meanSquare, speech);
+		const float db = (float)(10.0 * std::log10(meanSquare + 1.0));
+		frameDb_[closed_++ % frameDb_.size()] = db;
+		chunkPeakDb_ = std::max(chunkPeakDb_, db);
+	}
+
+	// Energy of the frame closed `back` frames before the latest.
+	float FrameDb(uint32_t back) const { return frameDb_[(closed_ - 1 - back) % frameDb_.size()]; }
+
+	// The latest frame is kValleyDepthDb under the loudest of the open chunk's
+	// frames in the window.
+	bool InValley() const {
+		const uint32_t span = std::min(dipFrames_, openFrames_ - 1);
+		float loudest = FrameDb(0);
+		for (uint32_t k = 1; k <= span; ++k) loudest = std::max(loudest, FrameDb(k));
+		return FrameDb(0) <= loudest - kValleyDepthDb;
+	}
+
+	// At maxFrames_: a max-length cut after the quietest of the last dipFrames_
+	// frames, keeping the ones after it open. False to cut at the end instead,
+	// with the overlap unless valleyMs finds the last frame in a valley.
+	bool CutAtDip() {
+		const uint32_t span = std::min(dipFrames_, openFrames_ - 1);
+		uint32_t keep = 0;
+		float quietest = FrameDb(0);
+		for (uint32_t k = 1; k <= span; ++k) {
+			const float db = FrameDb(k);
+			if (db < quietest) {
+				quietest = db;
+				keep = k;
+			}
+		}
+		if (keep == 0) {
+			valleyCut_ = valley_ && InValley();
+			return false;
+		}
+		keepFrames_ = keep;
+		pending_.cut = UtteranceCut::MaxLength;
+		pending_.pauseMs = 0;
+		return true;
+	}
+
+	bool Cut(UtteranceCut cut) {
+		pending_.cut = cut;
+		pending_.pauseMs = silence_ * frameMs_;
+		return true;
+	}
+
+	size_t frameSamples_ = 0;
+	uint32_t frameMs_ = 0;
+	uint32_t maxFrames_ = 0, pauseFrames_ = 0, overlapFrames_ = 0, prerollFrames_ = 0, flushFrames_ = 0, resetFrames_ = 0;
+	bool adaptive_ = false;
+	SpeechRateEstimator rate_;
+	uint32_t dipFrames_ = 0;
+	bool valley_ = false;         // valleyMs
+	bool valleyCut_ = false;      // the pending cut is in a valley: no overlap after it
+	float chunkPeakDb_ = 0.0f;    // loudest measured frame of the open chunk
+	std::vector<float> frameDb_; // energy of the last dipFrames_ + 1 frames, by closed_
+	uint32_t closed_ = 0;        // frames closed since Configure()
+
+	std::vector<int16_t> open_;    // whole frames of the open chunk, then the partial one
+	std::vector<int16_t> overlap_; // tail of the previous chunk
+	uint32_t openFrames_ = 0;
+	uint32_t silence_ = 0;         // trailing non-speech frames
+	bool hasSpeech_ = false;
+	bool onset_ = false;
+	uint32_t keepFrames_ = 0;      // CutBack() pending
+	uint32_t trimFrames_ = kNoTrim; // trimMs in frames
+	uint32_t compactFrames_ = kNone, gapFrames_ = 0; // compact, in frames
+	std::vector<uint8_t> voiced_;  // per whole frame of the open chunk: speech without the hangover
+	UtteranceChunkInfo pending_;
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+// Progressive encoding of the open utterance (option chunker.stream), so an
+// upload can start at speech onset instead of after the chunker's pause: the
+// writer pushes the chunk's samples here as its frames close and, every
+// intervalMs, sends what is ready as one { type: 'chunk-stream' } event
+// (pcm_channel.h). With codec 'opus' that is whole Ogg pages of one Ogg-Opus
+// file per utterance - the first event carries the headers and the last one
+// the end-of-stream page, so the events' data joined is a file like the one
+// encodeOpus() makes of the chunk's WAV (at complexity 3: this runs on the
+// capture thread). With 'pcm16' it is the raw samples. Nothing here
+// allocates once Configure() has run.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "opus_chunk_encoder.h"
+#include "utterance_chunker.h"
+
+class UtteranceStream {
+public:
+	UtteranceStream() = default;
+	UtteranceStream(const UtteranceStream&) = delete;
+	UtteranceStream& operator=(const UtteranceStream&) = delete;
+	~UtteranceStream() { DestroyEncoder(); }
+
+	// rate is the chunker's; Opus takes 8, 12, 16, 24 or 48 kHz
+	// (CaptureOptions::ChannelConfig() falls back to pcm16 at the others).
+	void Configure(const UtteranceChunkerConfig& chunker, uint32_t rate) {
+		const UtteranceStreamConfig& config = chunker.stream;
+		DestroyEncoder();
+		enabled_ = config.enabled;
+		opus_ = config.opus;
+		rate_ = rate;
+		frame_ = rate / 50;
+		open_ = false;
+		if (!enabled_) return;
+#if defined(AUDIO_CORE_OPUS)
+		if (opus_) {
+			int err = OPUS_OK;
+			encoder_ = opus_encoder_create((opus_int32)rate, 1, OPUS_APPLICATION_VOIP, &err);
+			if (err != OPUS_OK || !encoder_) {
+				encoder_ = nullptr;
+				enabled_ = false; // chunks still arrive whole
+				return;
+			}
+			opus_encoder_ctl(encoder_, OPUS_SET_BITRATE((opus_int32)config.bitrate));
+			opus_encoder_ctl(encoder_, OPUS_SET_VBR(1));
+			opus_encoder_ctl(encoder_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+			opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(3)); // capture thread: cheap over perfect
+			opus_int32 lookahead = 0;
+			opus_encoder_ctl(encoder_, OPUS_GET_LOOKAHEAD(&lookahead));
+			lookahead_ = (size_t)lookahead;
+		}
+#else
+		opus_ = false;
+#endif
+		pcm_.assign(opus_ ? frame_ : 0, 0);
+		// The first event's overlap and lead-in (all of the silence before the
+		// onset without a pre-roll), an interval's samples (or at most a
+		// 1275-byte packet per 20 ms frame) and the headers
+		const uint32_t lead = chunker.prerollMs > 0 ? chunker.prerollMs : chunker.resetSilenceMs;
+		const uint32_t ms = chunker.overlapMs + lead + std::max<uint32_t>(config.intervalMs, 20) + 40;
+		const size_t samples = (size_t)rate * ms / 1000;
+		out_.reserve(opus_ ? (samples / frame_ + 2) * (1275 + 32) + 256 : samples * sizeof(int16_t));
+	}
+
+	bool Enabled() const { return enabled_; }
+	bool Ogg() const { return opus_; }
+	// An utterance is being streamed: between Begin() and Finish()/Abort().
+	bool Open() const { return open_; }
+	uint32_t Id() const { return id_; }
+
+	void Begin(uint32_t id) {
+		open_ = true;
+		id_ = id;
+		out_.clear();
+		fill_ = 0;
+		pushed_ = 0;
+		encoded_ = 0;
+		granule_ = 0;
+#if defined(AUDIO_CORE_OPUS)
+		if (opus_) {
+			opus_encoder_ctl(encoder_, OPUS_RESET_STATE);
+			ogg_.Reset(0x57487300u ^ id);
+			WriteOpusHeaders(&ogg_, rate_, (uint16_t)(lookahead_ * (48000 / rate_)));
+		}
+#endif
+	}
+
+	void Push(const int16_t* pcm, size_t n) {
+		pushed_ += n;
+		if (!opus_) {
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(pcm);
+			out_.insert(out_.end(), bytes, bytes + n * sizeof(int16_t));
+			return;
+		}
+		while (n > 0) {
+			const size_t take = std::min(n, frame_ - fill_);
+			memcpy(pcm_.data() + fill_, pcm, take * sizeof(int16_t));
+			fill_ += take;
+			pcm += take;
+			n -= take;
+			if (fill_ == frame_) Encode(false);
+		}
+	}
+
+	// Bytes ready to go out, ending the open Ogg page; with last the stream
+	// itself ends (the partial frame and the encoder's lookahead are flushed).
+	size_t Pending(bool last) {
+		if (opus_) {
+			if (last) {
+				// Zero-pad past the end so the encoder's lookahead drains
+				const size_t end = pushed_ + lookahead_;
+				while (encoded_ < end) {
+					memset(pcm_.data() + fill_, 0, (frame_ - fill_) * sizeof(int16_t));
+					fill_ = frame_;
+					Encode(encoded_ + frame_ >= end);
+				}
+			}
+			ogg_.Flush(last);
+		}
+		return out_.size();
+	}
+
+	// Copies the Pending() bytes to dst and forgets them.
+	void TakeTo(uint8_t* dst) {
+		if (!out_.empty()) memcpy(dst, out_.data(), out_.size());
+		out_.clear();
+	}
+
+	void Finish() { open_ = false; }
+	void Abort() {
+		open_ = false;
+		out_.clear();
+	}
+
+private:
+	// Encodes the full frame in pcm_; last trims the final granule to the
+	// samples pushed (the rest is padding).
+	void Encode(bool last) {
+		fill_ = 0;
+		encoded_ += frame_;
+#if defined(AUDIO_CORE_OPUS)
+		uint8_t packet[1275];
+		const opus_int32 bytes = opus_encode(encoder_, pcm_.data(), (int)frame_, packet, (opus_int32)sizeof(packet));
+		const int64_t scale = 48000 / rate_;
+		granule_ += (int64_t)frame_ * scale;
+		const int64_t end = (int64_t)(lookahead_ + pushed_) * scale;
+		if (bytes > 0) ogg_.Packet(packet, (size_t)bytes, last && granule_ > end ? end : granule_);
+#else
+		(void)last;
+#endif
+	}
+
+	void DestroyEncoder() {
+#if defined(AUDIO_CORE_OPUS)
+		if (encoder_) opus_encoder_destroy(encoder_);
+		encoder_ = nullptr;
+#endif
+	}
+
+	bool enabled_ = false;
+	bool opus_ = false;
+	bool open_ = false;
+	uint32_t id_ = 0;
+	uint32_t rate_ = 16000;
+	size_t frame_ = 320;        // 20 ms
+	size_t lookahead_ = 0;      // encoder delay, samples
+	std::vector<int16_t> pcm_;  // the frame being filled
+	size_t fill_ = 0;
+	uint64_t pushed_ = 0;       // samples of the open utterance
+	uint64_t encoded_ = 0;      // and those encoded, padding included
+	int64_t granule_ = 0;
+	std::vector<uint8_t> out_;  // not yet sent
+	OggStreamWriter ogg_{ &out_, 0 };
+#if defined(AUDIO_CORE_OPUS)
+	OpusEncoder* encoder_ = nullptr;
+#endif
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+// Frame-level voice activity detection at the end of the capture DSP chain.
+// Each frame's speech-band (300-3400 Hz) energy is compared with a
+// minimum-tracking noise floor, and its share of the total energy and its
+// zero-crossing rate veto broadband noise. The modes follow WebRTC's
+// aggressiveness levels (higher = fewer false positives) through the SNR,
+// band-share and hangover settings; they are not its GMM.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+enum class VadMode { Off, Quality, LowBitrate, Aggressive, VeryAggressive };
+
+class VoiceActivityDetector {
+public:
+	// frameSamples == 0 or mode Off disables the detector.
+	void Configure(float sampleRate, size_t frameSamples, VadMode mode) {
+		frameSamples_ = mode == VadMode::Off ? 0 : frameSamples;
+		if (frameSamples_ == 0) return;
+		const float twoPi = 6.28318530718f;
+		lowAlpha_ = 1.0f - std::exp(-twoPi * 300.0f / sampleRate);
+		highAlpha_ = 1.0f - std::exp(-twoPi * 3400.0f / sampleRate);
+		const float frameSec = (float)frameSamples_ / sampleRate;
+		noiseRiseDb_ = 3.0f * frameSec; // 3 dB/s, so a louder steady background is absorbed in seconds
+
+		static const struct { float snrDb, bandShare, hangoverMs; } kModes[] = {
+			{ 3.0f, 0.25f, 300.0f }, // Quality
+			{ 5.0f, 0.30f, 240.0f }, // LowBitrate
+			{ 7.0f, 0.35f, 180.0f }, // Aggressive
+			{ 9.0f, 0.40f, 120.0f }, // VeryAggressive
+		};
+		const auto& m = kModes[(int)mode - 1];
+		snrDb_ = m.snrDb;
+		bandShare_ = m.bandShare;
+		hangoverFrames_ = (int)(m.hangoverMs / 1000.0f / frameSec + 0.5f);
+		Reset();
+	}
+
+	void Reset() {
+		low_ = high_ = prev_ = 0.0f;
+		total_ = band_ = 0.0f;
+		crossings_ = 0;
+		filled_ = 0;
+		noiseDb_ = kFloorDb;
+		primed_ = false;
+		hangover_ = 0;
+		voiced_ = false;
+	}
+
+	bool Enabled() const { return frameSamples_ > 0; }
+
+	// The last completed frame was speech before the hangover.
+	bool Voiced() const { return voiced_; }
+
+	// Streams samples (as delivered, i.e. scaled by gain). Each completed frame
+	// advances *frame and, when it is speech, sets bit *frame of *bits first.
+	void Process(const float* x, size_t n, float gain, uint32_t* bits, uint32_t* frame) {
+		while (n > 0) {
+			const size_t take = n < frameSamples_ - filled_ ? n : frameSamples_ - filled_;
+			float low = low_, high = high_, prev = prev_, total = total_, band = band_;
+			uint32_t crossings = crossings_;
+			for (size_t i = 0; i < take; ++i) {
+				const float s = x[i] * gain;
+				low += lowAlpha_ * (s - low);
+				const float hp = s - low;
+				high += highAlpha_ * (hp - high);
+				total += s * s;
+				band += high * high;
+				crossings += (s >= 0.0f) != (prev >= 0.0f);
+				prev = s;
+			}
+			low_ = low; high_ = high; prev_ = prev; total_ = total; band_ = band;
+			crossings_ = crossings;
+			x += take;
+			n -= take;
+			filled_ += take;
+			if (filled_ == frameSamples_) {
+				if (Decide() && *frame < 32) *bits |= 1u << *frame;
+				++*frame;
+				total_ = band_ = 0.0f;
+				crossings_ = 0;
+				filled_ = 0;
+			}
+		}
+	}
+
+private:
+	static constexpr float kFloorDb = -60.0f; // band energy below this is never speech
+
+	bool Decide() {
+		const float inv = 1.0f / (float)frameSamples_;
+		const float bandDb = 10.0f * std::log10(band_ * inv + 1e-10f);
+		const float share = total_ > 0.0f ? band_ / total_ : 0.0f;
+		const float zcr = (float)crossings_ * inv;
+
+		// Minimum tracking seeded by the first frame: fall to quiet frames at once, creep up otherwise
+		const float quietDb = bandDb < kFloorDb - 20.0f ? kFloorDb - 20.0f : bandDb;
+		if (!primed_ || quietDb < noiseDb_) noiseDb_ = quietDb;
+		else noiseDb_ += noiseRiseDb_;
+		primed_ = true;
+
+		const bool speech = bandDb > kFloorDb && bandDb - noiseDb_ > snrDb_ && share > bandShare_ && zcr < 0.45f;
+		voiced_ = speech;
+		if (speech) {
+			hangover_ = hangoverFrames_;
+			return true;
+		}
+		if (hangover_ > 0) {
+			--hangover_;
+			return true;
+		}
+		return false;
+	}
+
+	size_t frameSamples_ = 0;
+	float lowAlpha_ = 0.0f, highAlpha_ = 0.0f;
+	float snrDb_ = 0.0f, bandShare_ = 0.0f, noiseRiseDb_ = 0.0f;
+	int hangoverFrames_ = 0;
+
+	float low_ = 0.0f, high_ = 0.0f, prev_ = 0.0f;
+	float total_ = 0.0f, band_ = 0.0f;
+	uint32_t crossings_ = 0;
+	size_t filled_ = 0;
+	float noiseDb_ = kFloorDb;
+	bool primed_ = false;
+	int hangover_ = 0;
+	bool voiced_ = false;
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+// Voice boost for whisper-level speech: an RMS-adaptive compressor and soft
+// limiter at the end of the voice chain. Quiet passages are raised toward a
+// target RMS (at most up to the compression threshold), louder ones are
+// compressed 4:1 above -30 dBFS, the user's boost level is applied as makeup
+// gain and a soft knee from 0.7 keeps the result under 0.99. Gain is computed
+// per 16-sample block from the signal envelope and ramped across it, so the
+// waveform itself is only shaped near full scale. Enabled state and level are
+// set from JS with setVoiceBoostEnabled() / setVoiceBoostLevel()
+// (dsp_bindings.h) and picked up by running captures on their next block.
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+
+class VoiceBoostSettings {
+public:
+	void SetEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+	void SetLevel(float level) { level_.store(level, std::memory_order_relaxed); }
+	bool Enabled() const { return enabled_.load(std::memory_order_relaxed); }
+	float Level() const { return level_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<bool> enabled_{false}; // JS turns it on once it stops boosting itself
+	std::atomic<float> level_{10.0f};
+};
+
+inline VoiceBoostSettings& VoiceBoost() {
+	static VoiceBoostSettings settings;
+	return settings;
+}
+
+class VoiceBoostCompressor {
+public:
+	static constexpr size_t kBlock = 16;
+
+	void Configure(float fs) {
+		const float blockSeconds = (float)kBlock / fs;
+		attack_ = 1.0f - std::exp(-blockSeconds / 0.010f);  // 10 ms envelope attack
+		release_ = 1.0f - std::exp(-blockSeconds / 0.200f); // 200 ms envelope release
+		slow_ = 1.0f - std::exp(-blockSeconds / 1.000f);    // 1 s RMS behind the adaptive gain
+		Reset();
+	}
+
+	void Reset() {
+		fast_ = slowEnergy_ = 0.0f;
+		gain_ = 1.0f;
+		running_ = false;
+	}
+
+	// Boosts x in place; returns false (leaving x alone) while the boost is off.
+	bool Process(float* x, size_t n) {
+		const VoiceBoostSettings& settings = VoiceBoost();
+		const float level = settings.Level();
+		if (!settings.Enabled() || level <= 1.0f) {
+			running_ = false;
+			return false;
+		}
+		const bool primed = running_;
+		running_ = true;
+		const float makeupDb = 20.0f * std::log10(level);
+		for (size_t at = 0; at < n; at += kBlock) {
+			const size_t len = n - at < kBlock ? n - at : kBlock;
+			float* block = x + at;
+			float energy = 0.0f;
+			for (size_t i = 0; i < len; ++i) energy += block[i] * block[i];
+			energy /= (float)len;
+			if (!primed && at == 0) fast_ = slowEnergy_ = energy; // (re)started: seed the envelopes
+			fast_ += (energy - fast_) * (energy > fast_ ? attack_ : release_);
+			slowEnergy_ += (energy - slowEnergy_) * slow_;
+
+			const float slowRms = std::sqrt(slowEnergy_);
+			float adaptiveDb = 0.0f; // nothing to normalize below the noise floor
+			if (slowRms >= 1e-5f) adaptiveDb = Clamp(20.0f * std::log10(kTargetRms / slowRms), 0.0f, kMaxAdaptiveDb);
+			const float levelDb = 10.0f * std::log10(fast_ + 1e-18f);
+			const float gainDb = levelDb > kThresholdDb
+				? (kThresholdDb + (levelDb - kThresholdDb) / kRatio) - levelDb
+				: std::fmin(adaptiveDb, kThresholdDb - levelDb);
+			const float target = std::pow(10.0f, (gainDb + makeupDb) / 20.0f);
+			if (!primed && at == 0) gain_ = target;
+
+			const float step = (target - gain_) / (float)len;
+			float g = gain_;
+			for (size_t i = 0; i < len; ++i) {
+				g += step;
+				block[i] = SoftLimit(block[i] * g);
+			}
+			gain_ = target;
+		}
+		return true;
+	}
+
+private:
+	static constexpr float kTargetRms = 0.20f;
+	static constexpr float kMaxAdaptiveDb = 46.0f; // 200x
+	static constexpr float kThresholdDb = -30.0f;
+	static constexpr float kRatio = 4.0f;
+	static constexpr float kKnee = 0.7f;
+	static constexpr float kCeiling = 0.99f;
+
+	static float Clamp(float v, float lo, float hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+	// Linear up to the knee, then a tanh curve toward full scale.
+	static float SoftLimit(float s) {
+		const float a = s < 0 ? -s : s;
+		if (a <= kKnee) return s;
+		float y = kKnee + (1.0f - kKnee) * std::tanh((a - kKnee) / (1.0f - kKnee));
+		if (y > kCeiling) y = kCeiling;
+		return s < 0 ? -y : y;
+	}
+
+	float attack_ = 0.0f, release_ = 0.0f, slow_ = 0.0f;
+	float fast_ = 0.0f, slowEnergy_ = 0.0f; // mean-square envelopes
+	float gain_ = 1.0f;
+	bool running_ = false;
+};
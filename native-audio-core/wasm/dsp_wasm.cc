@@ -0,0 +1,83 @@
+// The capture chain's DSP kernels built for WebAssembly SIMD, for renderer
+// code that cannot reach the addon: AudioWorklets, the ScriptProcessor taps
+// and the soundboard. Loaded by src/renderer/audio/DspWasm.ts, which wraps
+// these in classes over the module's memory.
+//
+// Unlike dspResample() and friends (dsp_kernel_bindings.h), which condition
+// whole clips from rest, the filters here are objects that carry their state
+// from one render quantum to the next. Samples go through buffers the caller
+// allocates in the module's memory with dsp_alloc(), so a 128-frame block
+// costs two copies and no allocation.
+
+#include <emscripten/emscripten.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "dsp_blocks.h"
+#include "pcm_quantize.h"
+#include "processing_params.h"
+#include "resampler.h"
+
+#define DSP_WASM_EXPORT extern "C" EMSCRIPTEN_KEEPALIVE
+
+DSP_WASM_EXPORT void* dsp_alloc(size_t bytes) { return std::malloc(bytes); }
+DSP_WASM_EXPORT void dsp_free(void* p) { std::free(p); }
+
+// quality: 0 low, 1 medium, 2 high. maxBlock: the usual input block.
+DSP_WASM_EXPORT PolyphaseResampler* dsp_resampler_create(uint32_t inRate, uint32_t outRate, int quality, uint32_t maxBlock) {
+	if (inRate == 0 || outRate == 0 || quality < 0 || quality > 2) return nullptr;
+	PolyphaseResampler* r = new (std::nothrow) PolyphaseResampler();
+	if (r) r->Configure(inRate, outRate, (ResamplerQuality)quality, maxBlock);
+	return r;
+}
+DSP_WASM_EXPORT size_t dsp_resampler_max_output(PolyphaseResampler* r, size_t n) { return r->MaxOutput(n); }
+DSP_WASM_EXPORT size_t dsp_resampler_delay(PolyphaseResampler* r) { return r->DelaySamples(); }
+DSP_WASM_EXPORT size_t dsp_resampler_process(PolyphaseResampler* r, const float* in, size_t n, float* out) { return r->Process(in, n, out); }
+DSP_WASM_EXPORT void dsp_resampler_reset(PolyphaseResampler* r) { r->Reset(); }
+DSP_WASM_EXPORT void dsp_resampler_destroy(PolyphaseResampler* r) { delete r; }
+
+// kind: 0 high-pass, 1 low-pass (RBJ).
+DSP_WASM_EXPORT BlockBiquad* dsp_biquad_create(int kind, float sampleRate, float cornerHz, float q) {
+	if (kind < 0 || kind > 1 || !(cornerHz > 0.0f && cornerHz < sampleRate * 0.5f) || !(q > 0.0f)) return nullptr;
+	BlockBiquad* f = new (std::nothrow) BlockBiquad();
+	if (f) f->Setup(kind == 0 ? HighPassCoefficients(sampleRate, cornerHz, q) : LowPassCoefficients(sampleRate, cornerHz, q));
+	return f;
+}
+DSP_WASM_EXPORT void dsp_biquad_process(BlockBiquad* f, float* x, size_t n) { f->Process(x, n); }
+DSP_WASM_EXPORT void dsp_biquad_destroy(BlockBiquad* f) { delete f; }
+
+// The capture's adaptive gate; times in ms, 0 for the ProcessingParams default.
+DSP_WASM_EXPORT NoiseGate* dsp_gate_create(float sampleRate, float ratio, float envelopeMs, float floorRiseMs, float attackMs,
+                                           float releaseMs) {
+	ProcessingParams p;
+	if (ratio > 0.0f) p.gateRatio = ratio;
+	if (envelopeMs > 0.0f) p.gateEnvelopeMs = envelopeMs;
+	if (floorRiseMs > 0.0f) p.gateFloorRiseMs = floorRiseMs;
+	if (attackMs > 0.0f) p.gateAttackMs = attackMs;
+	if (releaseMs > 0.0f) p.gateReleaseMs = releaseMs;
+	NoiseGate* g = new (std::nothrow) NoiseGate();
+	if (g) g->Configure(sampleRate, p);
+	return g;
+}
+// Gates x in place; returns the peak magnitude after the gate.
+DSP_WASM_EXPORT float dsp_gate_process(NoiseGate* g, float* x, size_t n) { return g->Process(x, n); }
+DSP_WASM_EXPORT float dsp_gate_floor(NoiseGate* g) { return g->NoiseFloor(); }
+DSP_WASM_EXPORT void dsp_gate_destroy(NoiseGate* g) { delete g; }
+
+DSP_WASM_EXPORT float dsp_peak(const float* x, size_t n) { return PeakMagnitude(x, n); }
+
+DSP_WASM_EXPORT float dsp_rms(const float* x, size_t n) {
+	if (n == 0) return 0.0f;
+	const size_t body = n & ~(size_t)3;
+	float energy = DotProduct4(x, x, body);
+	for (size_t i = body; i < n; ++i) energy += x[i] * x[i];
+	return std::sqrt(energy / (float)n);
+}
+
+// Clipped and rounded like the capture's int16 packets.
+DSP_WASM_EXPORT void dsp_float_to_int16(const float* in, size_t n, float gain, int16_t* out) { QuantizeToInt16(in, n, gain, out); }
+DSP_WASM_EXPORT void dsp_int16_to_float(const int16_t* in, size_t n, float* out) { Int16ToFloat32(in, n, out); }
@@ -0,0 +1,52 @@
+#pragma once
+
+// Reads back the WAV buffers the addons emit (mono pcm16 utterance chunks) for
+// the chunk encoders (opus_chunk_encoder.h, flac_chunk_encoder.h).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Locates the pcm16 mono samples of a WAV file. False if it isn't one.
+inline bool FindWavPcm16(const uint8_t* wav, size_t size, const uint8_t** samples, size_t* count, uint32_t* rate, std::string* error) {
+	if (size < 12 || memcmp(wav, "RIFF", 4) != 0 || memcmp(wav + 8, "WAVE", 4) != 0) {
+		*error = "Not a WAV file";
+		return false;
+	}
+	bool haveFormat = false;
+	for (size_t at = 12; at + 8 <= size;) {
+		const uint32_t len = (uint32_t)wav[at + 4] | (uint32_t)wav[at + 5] << 8 | (uint32_t)wav[at + 6] << 16 | (uint32_t)wav[at + 7] << 24;
+		const uint8_t* body = wav + at + 8;
+		const size_t avail = size - at - 8;
+		if (memcmp(wav + at, "fmt ", 4) == 0 && len >= 16 && avail >= 16) {
+			const uint16_t tag = (uint16_t)(body[0] | body[1] << 8);
+			const uint16_t channels = (uint16_t)(body[2] | body[3] << 8);
+			const uint16_t bits = (uint16_t)(body[14] | body[15] << 8);
+			if (tag != 1 || channels != 1 || bits != 16) {
+				*error = "Only mono 16-bit PCM WAV can be encoded";
+				return false;
+			}
+			*rate = (uint32_t)body[4] | (uint32_t)body[5] << 8 | (uint32_t)body[6] << 16 | (uint32_t)body[7] << 24;
+			haveFormat = true;
+		} else if (memcmp(wav + at, "data", 4) == 0 && haveFormat) {
+			*samples = body; // may be unaligned
+			*count = (len < avail ? len : avail) / sizeof(int16_t);
+			return true;
+		}
+		at += 8 + (size_t)len + (len & 1);
+	}
+	*error = "WAV file has no data";
+	return false;
+}
+
+// The samples of a pcm16 WAV, copied out (the data chunk may be unaligned).
+inline bool ReadWavPcm16(const std::vector<uint8_t>& wav, std::vector<int16_t>* samples, uint32_t* rate, std::string* error) {
+	const uint8_t* pcm = nullptr;
+	size_t count = 0;
+	if (!FindWavPcm16(wav.data(), wav.size(), &pcm, &count, rate, error)) return false;
+	samples->resize(count);
+	if (count > 0) memcpy(samples->data(), pcm, count * sizeof(int16_t));
+	return true;
+}
@@ -0,0 +1,235 @@
+#pragma once
+
+// The ggml backend devices the native Whisper engine can run on, and a
+// micro-benchmark that times one model on each, so the app can keep the
+// fastest device (and model size) that keeps up with speech on this machine
+// instead of one fixed backend.
+//
+//   listWhisperBackends() -> Promise<[{ device, backend, description, gpu, memoryMb }]>
+//   benchmarkWhisper(path, { devices?, seconds?, audio?, language? })
+//     -> Promise<[{ device, backend, ok, error?, loadMs, processingMs, audioMs, rtf }]>
+//
+// Which backends exist is a build choice: the CPU always (ggml picks its
+// AVX2/AVX-512/NEON kernels at run time), Metal on macOS, and CUDA or Vulkan
+// on Windows as ggml was built, loaded beside the addon with
+// whisper_backend_dl=1 (whisper_engine.h). `device` is option 'device' of
+// loadWhisperModel. The benchmark loads the model on each device with one
+// lane, decodes `seconds` of audio twice and keeps the faster pass; rtf is
+// processing time over audio time, under 1 keeping up. Without `audio` it
+// decodes a synthetic voiced signal, so the decoder produces tokens rather
+// than stopping on silence. Devices run one after another on a single
+// threadpool worker; a large model on several devices takes a while.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "async_query.h"
+#include "capture_options.h"
+#include "whisper_engine.h"
+
+struct WhisperBackendInfo {
+	std::string device;      // option 'device': "cpu" or "gpu:N"
+	std::string backend;     // ggml registry name: CPU, CUDA, Vulkan, Metal...
+	std::string description; // the device's own name
+	bool gpu = false;
+	double memoryMb = 0;     // 0 when the backend doesn't say (the CPU)
+};
+
+// In whisper.cpp's order: "gpu:N" is the Nth non-CPU device, as
+// whisper_context_params::gpu_device counts them. Accelerators that only
+// assist the CPU backend (BLAS) are left out; so is the list without whisper.
+inline std::vector<WhisperBackendInfo> WhisperBackends() {
+	std::vector<WhisperBackendInfo> devices;
+#if defined(AUDIO_CORE_WHISPER)
+	LoadWhisperBackends();
+	int gpus = 0;
+	bool cpu = false;
+	for (size_t i = 0; i < ggml_backend_dev_count(); ++i) {
+		ggml_backend_dev_t dev = ggml_backend_dev_get(i);
+		const enum ggml_backend_dev_type type = ggml_backend_dev_type(dev);
+		if (type == GGML_BACKEND_DEVICE_TYPE_ACCEL) continue;
+		const bool isCpu = type == GGML_BACKEND_DEVICE_TYPE_CPU;
+		if (isCpu && cpu) continue;
+		WhisperBackendInfo info;
+		info.device = isCpu ? WhisperDeviceName(kWhisperCpu) : WhisperDeviceName(gpus++);
+		info.backend = ggml_backend_reg_name(ggml_backend_dev_backend_reg(dev));
+		info.description = ggml_backend_dev_description(dev);
+		info.gpu = !isCpu;
+		if (!isCpu) {
+			size_t free = 0, total = 0;
+			ggml_backend_dev_memory(dev, &free, &total);
+			info.memoryMb = (double)total / (1024.0 * 1024.0);
+		}
+		cpu = cpu || isCpu;
+		devices.push_back(std::move(info));
+	}
+#endif
+	return devices;
+}
+
+// Voiced "syllables" at about four a second: a harmonic series on a gliding
+// 100-180 Hz pitch, weighted towards two formant regions, with a little
+// breath noise. Not speech, but enough for the decoder to emit tokens.
+inline std::vector<float> WhisperBenchAudio(double seconds) {
+	const size_t n = (size_t)(seconds * kWhisperRate);
+	std::vector<float> out(n);
+	const double kPi = 3.14159265358979323846;
+	double phase = 0.0;
+	uint32_t noise = 0x2545F491u;
+	for (size_t i = 0; i < n; ++i) {
+		const double t = (double)i / kWhisperRate;
+		const double syllable = std::fmod(t * 4.0, 1.0);
+		const double gate = syllable < 0.7 ? std::sin(kPi * syllable / 0.7) : 0.0;
+		const double f0 = 140.0 + 40.0 * std::sin(2.0 * kPi * 0.7 * t);
+		phase += 2.0 * kPi * f0 / kWhisperRate;
+		const double formant1 = 500.0 + 300.0 * std::sin(2.0 * kPi * 1.3 * t);
+		const double formant2 = 1500.0 + 600.0 * std::sin(2.0 * kPi * 0.9 * t);
+		double voiced = 0.0;
+		for (int h = 1; h * f0 < 4000.0; ++h) {
+			const double f = h * f0;
+			const double w = std::exp(-std::pow((f - formant1) / 200.0, 2)) + 0.5 * std::exp(-std::pow((f - formant2) / 300.0, 2)) + 0.05;
+			voiced += w * std::sin(h * phase);
+		}
+		noise = noise * 1664525u + 1013904223u;
+		const double breath = ((double)(noise >> 8) / (double)(1u << 24) - 0.5) * 0.02;
+		out[i] = (float)(0.08 * gate * voiced + breath);
+	}
+	return out;
+}
+
+struct WhisperBenchRow {
+	std::string device;
+	std::string backend;
+	bool ok = false;
+	std::string error;
+	double loadMs = 0;
+	double processingMs = 0; // the faster of two passes
+	double audioMs = 0;
+	double rtf = 0;
+};
+
+inline std::vector<WhisperBenchRow> RunWhisperBenchmark(const std::string& path, const std::vector<std::string>& devices,
+                                                        const std::vector<float>& audio, const std::string& language) {
+	const std::vector<WhisperBackendInfo> known = WhisperBackends();
+	std::vector<WhisperBenchRow> rows;
+	for (const std::string& name : devices) {
+		WhisperBenchRow row;
+		row.device = name;
+		row.audioMs = 1000.0 * audio.size() / kWhisperRate;
+		for (const WhisperBackendInfo& b : known) if (b.device == name) row.backend = b.backend;
+		int device = kWhisperCpu;
+		ParseWhisperDevice(name, &device);
+		WhisperEngine engine;
+		double warmupMs = 0;
+		bool multilingual = false;
+		if (!engine.Load(path, device, 1, &row.loadMs, &warmupMs, &multilingual, &row.error)) {
+			rows.push_back(std::move(row));
+			continue;
+		}
+		WhisperJobConfig config;
+		config.language = language; // no detection pass in the timing
+		row.ok = true;
+		for (int pass = 0; pass < 2 && row.ok; ++pass) {
+			WhisperResult result;
+			row.ok = engine.Transcribe(audio.data(), audio.size(), config, "benchmark", &result);
+			if (!row.ok) row.error = result.error;
+			else if (pass == 0 || result.processingMs < row.processingMs) row.processingMs = result.processingMs;
+		}
+		engine.Unload();
+		if (row.ok) row.rtf = row.processingMs / row.audioMs;
+		AddonLog(LogLevel::Info, "Whisper benchmark %s on %s (%s): %s", path.c_str(), name.c_str(), row.backend.c_str(),
+		         row.ok ? ("rtf " + std::to_string(row.rtf)).c_str() : row.error.c_str());
+		rows.push_back(std::move(row));
+	}
+	return rows;
+}
+
+inline Napi::Object WhisperBackendToJs(Napi::Env env, const WhisperBackendInfo& b) {
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("device", Napi::String::New(env, b.device));
+	o.Set("backend", Napi::String::New(env, b.backend));
+	o.Set("description", Napi::String::New(env, b.description));
+	o.Set("gpu", Napi::Boolean::New(env, b.gpu));
+	o.Set("memoryMb", Napi::Number::New(env, b.memoryMb));
+	return o;
+}
+
+// listWhisperBackends() -> Promise of the devices; registering backend DLLs
+// may take a moment, so it runs on the threadpool.
+inline Napi::Value ListWhisperBackends(const Napi::CallbackInfo& info) {
+	return QueueQuery(info.Env(), "ListWhisperBackends", WhisperBackends,
+		[](Napi::Env env, std::vector<WhisperBackendInfo>& devices) -> Napi::Value {
+			Napi::Array result = Napi::Array::New(env, devices.size());
+			for (size_t i = 0; i < devices.size(); ++i) result.Set((uint32_t)i, WhisperBackendToJs(env, devices[i]));
+			return result;
+		});
+}
+
+// benchmarkWhisper(path, { devices?, seconds?, audio?, language? }): devices
+// defaults to every listed one, seconds to 8 (1-30), language to 'en'.
+inline Napi::Value BenchmarkWhisper(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Model path required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	std::vector<std::string> devices;
+	std::vector<float> audio;
+	std::string language = "en";
+	uint32_t seconds = 8;
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object obj = info[1].As<Napi::Object>();
+		std::string error;
+		if (!ReadUint32Option(obj, "seconds", 1, 30, &seconds, &error) ||
+		    (!obj.Get("audio").IsUndefined() && !ReadWhisperAudio(obj.Get("audio"), &audio, &error))) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		if (obj.Get("language").IsString()) language = obj.Get("language").As<Napi::String>().Utf8Value();
+		Napi::Value list = obj.Get("devices");
+		if (list.IsArray()) {
+			Napi::Array a = list.As<Napi::Array>();
+			for (uint32_t i = 0; i < a.Length(); ++i) {
+				int device = 0;
+				Napi::Value v = a.Get(i);
+				if (!v.IsString() || !ParseWhisperDevice(v.As<Napi::String>().Utf8Value(), &device)) {
+					Napi::TypeError::New(env, "Option 'devices' must list 'cpu', 'gpu' or 'gpu:<index>'").ThrowAsJavaScriptException();
+					return env.Null();
+				}
+				devices.push_back(WhisperDeviceName(device));
+			}
+		} else if (!list.IsUndefined()) {
+			Napi::TypeError::New(env, "Option 'devices' must be an array").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+	if (audio.empty()) audio = WhisperBenchAudio(seconds);
+	return QueueQuery(env, "BenchmarkWhisper",
+		[path = info[0].As<Napi::String>().Utf8Value(), devices, audio = std::move(audio), language]() {
+			std::vector<std::string> names = devices;
+			if (names.empty()) for (const WhisperBackendInfo& b : WhisperBackends()) names.push_back(b.device);
+			return RunWhisperBenchmark(path, names, audio, language);
+		},
+		[](Napi::Env env, std::vector<WhisperBenchRow>& rows) -> Napi::Value {
+			Napi::Array result = Napi::Array::New(env, rows.size());
+			for (size_t i = 0; i < rows.size(); ++i) {
+				const WhisperBenchRow& r = rows[i];
+				Napi::Object o = Napi::Object::New(env);
+				o.Set("device", Napi::String::New(env, r.device));
+				o.Set("backend", Napi::String::New(env, r.backend));
+				o.Set("ok", Napi::Boolean::New(env, r.ok));
+				if (!r.ok) o.Set("error", Napi::String::New(env, r.error));
+				o.Set("loadMs", Napi::Number::New(env, r.loadMs));
+				o.Set("processingMs", Napi::Number::New(env, r.processingMs));
+				o.Set("audioMs", Napi::Number::New(env, r.audioMs));
+				o.Set("rtf", Napi::Number::New(env, r.rtf));
+				result.Set((uint32_t)i, o);
+			}
+			return result;
+		}, TaskPriority::Background);
+}
@@ -0,0 +1,1191 @@
+#pragma once
+
+// In-process whisper.cpp (ggml) speech-to-text with one persistent model
+// context, so local transcription no longer respawns Python and reloads the
+// model per request. Audio goes in as the capture chunker's 16 kHz pcm16 WAV
+// buffers (or raw Int16Array/Float32Array at 16 kHz); nothing touches disk.
+// Loading runs a one-second silent pass so the encoder's compute buffers are
+// allocated at warm-up rather than on the first real chunk. Built with gyp
+// variable use_whisper=1 (AUDIO_CORE_WHISPER, links whisper.cpp and ggml);
+// otherwise every call rejects and callers keep the Python backend.
+//
+//   loadWhisperModel(path, { device?, gpu?, lanes?, background? })
+//     -> Promise<{ multilingual, loadMs, warmupMs, lanes, device, reused, quantization, weightsMb, memoryMb }>
+//   transcribeWhisper(audio, { language?, translate?, prompt?, threads?, stream?, model?, captureTimeMs?, maxStaleMs?, draft? })
+//     -> Promise<{ text, language, segments: [{ startMs, endMs, text }], processingMs, shed?, draft? }>
+//   unloadWhisperModel(model?) -> Promise<void>
+//   getWhisperSchedulerStats() -> { lanes, queued, running, avgQueueMs, ..., models }
+//
+// The model file is memory-mapped read-only and whisper.cpp reads its tensors
+// straight out of the map (no buffered file reads); the map closes once they
+// are in ggml's buffers. Models stay resident per path (WhisperModels): up to
+// kWhisperResidentModels of them, say a small one for live captions next to a
+// larger one for finished utterances, and loading a resident path again
+// returns at once instead of building a second context. Option 'background'
+// loads and warms up at background priority, for a pre-warm at app start that
+// shouldn't compete with the UI. Option 'device' picks the ggml backend
+// device the model runs on ('cpu', 'gpu' or 'gpu:N', as whisper_backends.h
+// lists them); the default is the first GPU, falling back to the CPU.
+// Quantized files (whisper.cpp's quantize tool: q8_0, q5_1, q4_0...) load
+// like any other; the load result names the weight type and the memory the
+// model took, and a capture's getStats().models lists every resident one.
+//
+// The weights load once; each lane owns a whisper_state (KV cache and compute
+// buffers) and a thread at background priority, so mic and loopback chunks
+// decode side by side instead of queueing behind one context. whisper.cpp has
+// no cross-input batched encoder, so concurrent streams are batched at the
+// scheduler: lanes pull jobs round-robin by stream key. The threadpool job
+// that submitted a chunk waits for its lane; the JS thread never blocks.
+//
+// A chunk cut by a capture with option 'mel' arrives with most of its log-mel
+// frames already computed (log_mel.h, found by its samples in ChunkMels()):
+// the lane only computes the frames at its edges, normalises the spectrogram
+// as whisper.cpp does and hands it over with whisper_set_mel_with_state(), so
+// whisper_full skips its own STFT. Models with other than 80 mel bands, and
+// audio no capture cut, take the PCM path. whisper_stream.h hands over its
+// windows' frames the same way.
+//
+// A job's audioCtx shortens the encoder to that many positions (whisper.cpp's
+// audio_ctx) instead of the 1500 that cover 30 s: the encoder's cost follows
+// the audio actually there, at some cost in accuracy, which is what a short
+// streaming window wants.
+//
+// Option maxStaleMs gives a chunk a deadline: that long after captureTimeMs
+// (the chunk's own, on the deviceClockMs() clock; the submission when not
+// given). When inference falls behind, a lane that takes a chunk it expects
+// to finish past its deadline (at the average run time) sheds load, in order:
+//
+//   merged     - the stream's queued chunks behind it (same language, up to
+//                kWhisperMaxMergeSamples) join it in one decode; the text
+//                comes back on the oldest, the others resolve empty
+//   downgraded - no other chunk to merge and at least kWhisperCheapShare of a
+//                run left: a cheap decode (no temperature fallback, encoder
+//                cut to the audio); at submission, a chunk already expected
+//                late goes to a smaller resident model instead, if there is one
+//   dropped    - otherwise; it resolves empty without running
+//
+// A shed chunk's result carries shed: { action, lateMs, merged?, model? }
+// (lateMs: how far past the deadline it was expected), and the scheduler
+// stats count each action, so caption latency stays near maxStaleMs however
+// far behind the engine is.
+//
+// Option 'draft' names a smaller resident model that decodes the chunk first
+// (from the same spectrogram when the capture cut it). When its text is
+// confident - average token log-probability and least token probability
+// over their floors - it is the result and the larger model never runs;
+// otherwise the larger model decodes as if there had been no draft. Most
+// live chunks are short, clear speech the small model gets right, so the
+// larger model's decoder only runs on the hard ones. (A draft whose tokens
+// the larger model verifies in one pass would need its logits at every
+// position, and whisper.cpp hands out only the last one's; nor can two
+// models of different widths share an encoder output.) The result's draft
+// says which model answered, and the scheduler stats count both outcomes.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "addon_log.h"
+#include "async_query.h"
+#include "capture_options.h"
+#include "latency_trace.h"
+#include "log_mel.h"
+#include "mapped_file.h"
+#include "memory_budget.h"
+#include "system_memory.h"
+#include "thread_cpu.h"
+#include "thread_schedule.h"
+#include "wav_reader.h"
+
+#if defined(AUDIO_CORE_WHISPER)
+#include <ggml-backend.h>
+#include <whisper.h>
+#endif
+
+constexpr uint32_t kWhisperRate = 16000;
+constexpr size_t kWhisperMaxMergeSamples = 30 * kWhisperRate; // one encoder window
+constexpr double kWhisperCheapShare = 0.5; // of the average run: a cheap decode takes about this
+
+// Option 'device': -1 for the CPU, else the index among the GPU devices
+// (whisper_context_params::gpu_device); 'gpu' alone is the first.
+constexpr int kWhisperCpu = -1;
+
+inline std::string WhisperDeviceName(int device) {
+	return device < 0 ? "cpu" : "gpu:" + std::to_string(device);
+}
+
+inline bool ParseWhisperDevice(const std::string& name, int* device) {
+	if (name == "cpu" || name == "gpu") {
+		*device = name == "cpu" ? kWhisperCpu : 0;
+		return true;
+	}
+	if (name.size() < 5 || name.size() > 6 || name.compare(0, 4, "gpu:") != 0 ||
+	    name.find_first_not_of("0123456789", 4) != std::string::npos) return false;
+	*device = std::stoi(name.substr(4));
+	return true;
+}
+
+// Options 'device' and the older 'gpu' (false = 'cpu'); missing keeps *device.
+inline bool ReadWhisperDeviceOption(const Napi::Object& obj, int* device, std::string* error) {
+	Napi::Value gpu = obj.Get("gpu");
+	if (gpu.IsBoolean() && !gpu.As<Napi::Boolean>().Value()) *device = kWhisperCpu;
+	Napi::Value v = obj.Get("device");
+	if (v.IsUndefined()) return true;
+	if (!v.IsString() || !ParseWhisperDevice(v.As<Napi::String>().Utf8Value(), device)) {
+		*error = "Option 'device' must be 'cpu', 'gpu' or 'gpu:<index>'";
+		return false;
+	}
+	return true;
+}
+
+struct WhisperJobConfig {
+	std::string language = "auto";
+	std::string prompt;
+	bool translate = false;
+	uint32_t threads = 0; // 0 = pick from the core count
+	bool wordSegments = false; // one segment per word, for whisper_stream.h
+	uint32_t audioCtx = 0;     // encoder positions (20 ms each) to run; 0 = the model's 30 s
+};
+
+struct WhisperSegment {
+	double startMs = 0;
+	double endMs = 0;
+	std::string text;
+};
+
+struct WhisperResult {
+	std::string text;
+	std::string language;
+	std::vector<WhisperSegment> segments;
+	double processingMs = 0;
+	std::string error;
+	std::string shed;      // "merged", "downgraded", "dropped"; empty when it ran as asked
+	double lateMs = 0;     // expected past its deadline when shed
+	uint32_t merged = 0;   // chunks decoded together, on the one that carries the text
+	std::string shedModel; // the smaller model it went to
+	uint32_t tokens = 0;   // text tokens decoded, and how sure of them the model was
+	double avgLogprob = 0;
+	double minTokenP = 1;
+	std::string draftModel; // option 'draft': the model that decoded first, and how sure it was
+	bool draftAccepted = false;
+	double draftAvgLogprob = 0;
+	double draftMinTokenP = 1;
+};
+
+// Option 'draft': the model, and the floors its text must clear to stand.
+struct WhisperDraftConfig {
+	std::string model; // empty: no draft
+	float minAvgLogprob = -0.3f;
+	float minTokenP = 0.2f;
+
+	bool Accepts(const WhisperResult& r) const {
+		return r.error.empty() && r.shed.empty() && r.tokens > 0 && r.avgLogprob >= minAvgLogprob && r.minTokenP >= minTokenP;
+	}
+};
+
+// The weight type of a ggml Whisper file from its header (magic, eleven
+// int32 hyperparameters, the last being ftype): "f16" for the reference
+// files, "q8_0", "q5_1", "q5_0", "q4_0"... for whisper.cpp's quantize tool.
+// whisper.cpp reads every one of them; quantized weights load as they are.
+inline std::string WhisperFileType(const uint8_t* data, size_t size) {
+	uint32_t magic = 0;
+	int32_t ftype = 0;
+	if (size < 48) return "unknown";
+	memcpy(&magic, data, 4);
+	memcpy(&ftype, data + 44, 4);
+	if (magic != 0x67676d6c) return "unknown";
+	switch (ftype % 1000) { // the thousands carry the quantization version
+	case 0: return "f32";
+	case 1: return "f16";
+	case 2: return "q4_0";
+	case 3: return "q4_1";
+	case 7: return "q8_0";
+	case 8: return "q5_0";
+	case 9: return "q5_1";
+	case 10: return "q2_k";
+	case 11: return "q3_k";
+	case 12: return "q4_k";
+	case 13: return "q5_k";
+	case 14: return "q6_k";
+	default: return "ftype " + std::to_string(ftype % 1000);
+	}
+}
+
+// With gyp variable whisper_backend_dl=1 (AUDIO_CORE_WHISPER_BACKEND_DL) ggml's
+// backends are DLLs (ggml-cpu-*, ggml-cuda, ggml-vulkan) beside the addon;
+// they register once, before the first model or device list. A backend whose
+// DLL or runtime is missing stays out of the registry.
+inline void LoadWhisperBackends() {
+#if defined(AUDIO_CORE_WHISPER) && defined(AUDIO_CORE_WHISPER_BACKEND_DL) && defined(_WIN32)
+	static std::once_flag once;
+	std::call_once(once, [] {
+		HMODULE self = nullptr;
+		wchar_t path[MAX_PATH];
+		if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+		                        reinterpret_cast<LPCWSTR>(&LoadWhisperBackends), &self) ||
+		    GetModuleFileNameW(self, path, MAX_PATH) == 0) {
+			AddonLog(LogLevel::Warn, "ggml backends: addon directory unknown");
+			return;
+		}
+		std::wstring dir(path);
+		dir.resize(dir.find_last_of(L"\\/"));
+		ggml_backend_load_all_from_path(NarrowUtf8(dir).c_str());
+		AddonLog(LogLevel::Info, "ggml backends: %zu registered, %zu device(s)", ggml_backend_reg_count(), ggml_backend_dev_count());
+	});
+#endif
+}
+
+// Per-lane ggml threads: the cores left after one for capture and the UI,
+// split across the lanes.
+inline uint32_t DefaultWhisperThreads(uint32_t lanes) {
+	const unsigned hw = std::thread::hardware_concurrency();
+	const uint32_t spare = hw > 1 ? hw - 1 : 4;
+	const uint32_t perLane = spare / (lanes ? lanes : 1);
+	return perLane == 0 ? 1 : (perLane > 8 ? 8 : perLane);
+}
+
+inline uint32_t DefaultWhisperLanes() {
+	const unsigned hw = std::thread::hardware_concurrency();
+	return hw >= 8 ? 2 : 1;
+}
+
+struct WhisperSchedulerStats {
+	uint32_t lanes = 0;
+	uint32_t threadsPerLane = 0;
+	uint32_t queued = 0;
+	uint32_t running = 0;
+	uint64_t completed = 0;
+	double avgQueueMs = 0; // exponential moving averages
+	double avgRunMs = 0;
+	double maxQueueMs = 0; // since the last stats read
+	uint64_t shedMerged = 0; // chunks past their deadline (maxStaleMs), by what became of them
+	uint64_t shedDowngraded = 0;
+	uint64_t shedDropped = 0;
+	uint64_t draftAccepted = 0; // chunks option 'draft' answered, and ones the larger model decoded again
+	uint64_t draftRejected = 0;
+	std::vector<std::pair<std::string, uint32_t>> queuedByStream;
+	std::vector<std::string> models; // resident model paths, the default first
+};
+
+class WhisperEngine {
+public:
+#if defined(AUDIO_CORE_WHISPER)
+	~WhisperEngine() { Unload(); }
+
+	bool Load(const std::string& path, int device, uint32_t lanes, double* loadMs, double* warmupMs, bool* multilingual, std::string* error) {
+		Unload();
+		std::lock_guard<std::mutex> lock(loadMutex_);
+		const auto start = std::chrono::steady_clock::now();
+		whisper_log_set(&WhisperEngine::Log, nullptr);
+		LoadWhisperBackends();
+		whisper_context_params cparams = whisper_context_default_params();
+		cparams.use_gpu = device != kWhisperCpu;
+		cparams.gpu_device = device < 0 ? 0 : device;
+		{
+			MappedFile file;
+			if (!file.Open(path, error)) return false;
+			fileType_ = WhisperFileType(file.Data(), file.Size());
+			weightsMb_ = file.Size() / (1024.0 * 1024.0);
+			ctx_ = whisper_init_from_buffer_with_params_no_state(const_cast<uint8_t*>(file.Data()), file.Size(), cparams);
+		}
+		if (!ctx_) {
+			*error = "could not load whisper model " + path;
+			return false;
+		}
+		threadsPerLane_ = DefaultWhisperThreads(lanes);
+		for (uint32_t i = 0; i < lanes; ++i) {
+			whisper_state* state = whisper_init_state(ctx_);
+			if (!state) {
+				*error = "could not allocate whisper state " + std::to_string(i);
+				FreeLocked();
+				return false;
+			}
+			states_.push_back(state);
+		}
+		const auto loaded = std::chrono::steady_clock::now();
+		*loadMs = std::chrono::duration<double, std::milli>(loaded - start).count();
+		*multilingual = whisper_is_multilingual(ctx_) != 0;
+
+		// Every state gets its compute buffers now rather than on its first job
+		std::vector<float> silence(kWhisperRate, 0.0f);
+		WhisperJobConfig warm;
+		warm.language = "en"; // skips language detection
+		for (whisper_state* state : states_) {
+			WhisperResult ignored;
+			Run(state, silence.data(), silence.size(), nullptr, warm, &ignored);
+		}
+		*warmupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loaded).count();
+
+		stopping_ = false;
+		for (whisper_state* state : states_) lanes_.emplace_back(&WhisperEngine::Lane, this, state);
+		AddonLog(LogLevel::Info, "Whisper model (%s, %.0f MB) loaded on %s in %.0f ms, warm-up %.0f ms, %u lane(s) x %u threads",
+		         fileType_.c_str(), weightsMb_, WhisperDeviceName(device).c_str(), *loadMs, *warmupMs, lanes, threadsPerLane_);
+		return true;
+	}
+
+	// Blocks the calling (threadpool) thread until a lane has run the job.
+	// Lanes take streams round-robin, so a backlog on one stream doesn't hold
+	// up another's next chunk. mel: the chunk's frames from its capture, if any.
+	// deadline: past it the job is shed (see the top); the default never is.
+	bool Transcribe(const float* pcm, size_t n, const WhisperJobConfig& config, const std::string& stream, WhisperResult* result,
+	                const ChunkMel* mel = nullptr,
+	                std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()) {
+		Job job;
+		job.pcm = pcm;
+		job.n = n;
+		job.mel = mel;
+		job.config = &config;
+		job.result = result;
+		job.enqueued = std::chrono::steady_clock::now();
+		job.deadline = deadline;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			if (lanes_.empty()) {
+				result->error = "no whisper model loaded";
+				return false;
+			}
+			queues_[stream].push_back(&job);
+			queued_++;
+			wake_.notify_one();
+			done_.wait(lock, [&] { return job.finished; });
+		}
+		return job.ok;
+	}
+
+	WhisperSchedulerStats Stats() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		WhisperSchedulerStats stats;
+		stats.lanes = (uint32_t)lanes_.size();
+		stats.threadsPerLane = threadsPerLane_;
+		stats.queued = queued_;
+		stats.running = running_;
+		stats.completed = completed_;
+		stats.avgQueueMs = avgQueueMs_;
+		stats.avgRunMs = avgRunMs_;
+		stats.maxQueueMs = maxQueueMs_;
+		stats.shedMerged = shedMerged_;
+		stats.shedDowngraded = shedDowngraded_;
+		stats.shedDropped = shedDropped_;
+		maxQueueMs_ = 0;
+		for (auto& q : queues_) if (!q.second.empty()) stats.queuedByStream.emplace_back(q.first, (uint32_t)q.second.size());
+		return stats;
+	}
+
+	// How long a job submitted now should take to finish: the queue ahead of
+	// it spread over the lanes, then its own run. 0 before the first job.
+	double ExpectedMs() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (completed_ == 0 || lanes_.empty()) return 0;
+		return ((double)queued_ / (double)lanes_.size() + 1.0) * avgRunMs_;
+	}
+
+	// Queued jobs fail; running ones finish first.
+	void Unload() {
+		std::lock_guard<std::mutex> loadLock(loadMutex_);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+			for (auto& q : queues_) {
+				for (Job* job : q.second) {
+					job->result->error = "whisper model unloaded";
+					job->finished = true;
+				}
+				q.second.clear();
+			}
+			queued_ = 0;
+		}
+		wake_.notify_all();
+		done_.notify_all();
+		for (auto& lane : lanes_) lane.join();
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			lanes_.clear();
+		}
+		FreeLocked();
+	}
+
+private:
+	struct Job {
+		const float* pcm = nullptr;
+		size_t n = 0;
+		const ChunkMel* mel = nullptr;
+		const WhisperJobConfig* config = nullptr;
+		WhisperResult* result = nullptr;
+		std::chrono::steady_clock::time_point enqueued;
+		std::chrono::steady_clock::time_point deadline;
+		bool ok = false;
+		bool finished = false;
+	};
+
+	void FreeLocked() {
+		for (whisper_state* state : states_) whisper_free_state(state);
+		states_.clear();
+		if (ctx_) whisper_free(ctx_);
+		ctx_ = nullptr;
+	}
+
+	// Next job, taking streams in turn after the one served last. mutex_ held.
+	Job* NextLocked() {
+		if (queues_.empty()) return nullptr;
+		auto it = queues_.upper_bound(lastStream_);
+		for (size_t i = 0; i < queues_.size(); ++i, ++it) {
+			if (it == queues_.end()) it = queues_.begin();
+			if (it->second.empty()) continue;
+			Job* job = it->second.front();
+			it->second.pop_front();
+			lastStream_ = it->first;
+			return job;
+		}
+		return nullptr;
+	}
+
+	void Lane(whisper_state* state) {
+		ThreadCpuScope cpu("whisper-lane");
+		ApplyBackgroundComputeSchedule();
+		std::unique_lock<std::mutex> lock(mutex_);
+		for (;;) {
+			Job* job = nullptr;
+			wake_.wait(lock, [&] { return stopping_ || (job = NextLocked()) != nullptr; });
+			if (!job) return;
+			queued_--;
+			const auto now = std::chrono::steady_clock::now();
+			const double waitedMs = std::chrono::duration<double, std::milli>(now - job->enqueued).count();
+			if (waitedMs > maxQueueMs_) maxQueueMs_ = waitedMs;
+			std::vector<Job*> merged;
+			bool cheap = false;
+			if (job->deadline != std::chrono::steady_clock::time_point::max()) {
+				const double slackMs = std::chrono::duration<double, std::milli>(job->deadline - now).count();
+				const double runMs = completed_ > 0 ? avgRunMs_ : 0.0;
+				if (slackMs < runMs) {
+					job->result->lateMs = runMs - slackMs;
+					std::deque<Job*>& q = queues_[lastStream_];
+					size_t total = job->n;
+					while (!q.empty() && total + q.front()->n <= kWhisperMaxMergeSamples &&
+					       q.front()->config->language == job->config->language && q.front()->config->translate == job->config->translate) {
+						total += q.front()->n;
+						merged.push_back(q.front());
+						q.pop_front();
+						queued_--;
+					}
+					if (!merged.empty()) {
+						job->result->shed = "merged";
+						job->result->merged = (uint32_t)merged.size() + 1;
+						shedMerged_ += merged.size() + 1;
+						cheap = true;
+					} else if (slackMs >= runMs * kWhisperCheapShare) {
+						job->result->shed = "downgraded";
+						shedDowngraded_++;
+						cheap = true;
+					} else {
+						job->result->shed = "dropped";
+						shedDropped_++;
+						job->ok = true;
+						job->finished = true;
+						done_.notify_all();
+						continue;
+					}
+				}
+			}
+			running_++;
+			lock.unlock();
+			bool ok;
+			if (merged.empty()) {
+				ok = Run(state, job->pcm, job->n, job->mel, *job->config, job->result, cheap);
+			} else {
+				// Back to back in queue order; their callers hold the samples until finished
+				std::vector<float> pcm(job->pcm, job->pcm + job->n);
+				for (Job* next : merged) pcm.insert(pcm.end(), next->pcm, next->pcm + next->n);
+				ok = Run(state, pcm.data(), pcm.size(), nullptr, *job->config, job->result, cheap);
+			}
+			lock.lock();
+			running_--;
+			completed_++;
+			avgQueueMs_ += (waitedMs - avgQueueMs_) * 0.1;
+			if (!cheap) avgRunMs_ += (job->result->processingMs - avgRunMs_) * 0.1;
+			for (Job* next : merged) {
+				next->result->shed = "merged";
+				next->result->lateMs = job->result->lateMs;
+				next->result->language = job->result->language;
+				next->result->processingMs = job->result->processingMs;
+				next->result->error = job->result->error;
+				next->ok = ok;
+				next->finished = true;
+			}
+			job->ok = ok;
+			job->finished = true;
+			done_.notify_all();
+		}
+	}
+
+	// cheap: a late job's decode, without temperature fallback and with the
+	// encoder cut to the audio.
+	bool Run(whisper_state* state, const float* pcm, size_t n, const ChunkMel* mel, const WhisperJobConfig& config, WhisperResult* result,
+	         bool cheap = false) {
+		const auto start = std::chrono::steady_clock::now();
+		const bool shared = mel && n >= LogMelFrontEnd::kWindow && whisper_model_n_mels(ctx_) == (int)LogMelFrontEnd::kBands &&
+		                    SetMel(state, pcm, n, *mel);
+		whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+		params.n_threads = (int)(config.threads ? config.threads : threadsPerLane_);
+		params.language = config.language.c_str();
+		params.detect_language = false;
+		params.translate = config.translate;
+		params.initial_prompt = config.prompt.empty() ? nullptr : config.prompt.c_str();
+		params.no_context = true; // chunks are independent utterances
+		params.print_progress = false;
+		params.print_realtime = false;
+		params.print_special = false;
+		params.print_timestamps = false;
+		if (config.wordSegments) {
+			params.token_timestamps = true;
+			params.max_len = 1;
+			params.split_on_word = true;
+		}
+		// The spectrogram set above runs 30 s past the audio; decode only the audio
+		if (shared) params.duration_ms = (int)(10 * (1 + (n - LogMelFrontEnd::kWindow / 2) / LogMelFrontEnd::kHop));
+		uint32_t audioCtx = config.audioCtx;
+		if (cheap) {
+			params.temperature_inc = 0.0f;
+			const uint32_t positions = (uint32_t)((n + kWhisperRate / 50 - 1) / (kWhisperRate / 50)); // 20 ms each
+			audioCtx = audioCtx ? std::min(audioCtx, positions) : positions;
+		}
+		if (audioCtx) params.audio_ctx = (int)std::min<uint32_t>(audioCtx, (uint32_t)whisper_model_n_audio_ctx(ctx_));
+		if (whisper_full_with_state(ctx_, state, params, shared ? nullptr : pcm, shared ? 0 : (int)n) != 0) {
+			result->error = "whisper_full failed";
+			return false;
+		}
+		const int segments = whisper_full_n_segments_from_state(state);
+		const whisper_token eot = whisper_token_eot(ctx_); // timestamps and other specials follow it
+		double logprobs = 0;
+		for (int i = 0; i < segments; ++i) {
+			const int tokens = whisper_full_n_tokens_from_state(state, i);
+			for (int t = 0; t < tokens; ++t) {
+				const whisper_token_data d = whisper_full_get_token_data_from_state(state, i, t);
+				if (d.id >= eot) continue;
+				logprobs += d.plog;
+				result->minTokenP = std::min<double>(result->minTokenP, d.p);
+				result->tokens++;
+			}
+			WhisperSegment s;
+			s.text = whisper_full_get_segment_text_from_state(state, i);
+			s.startMs = (double)whisper_full_get_segment_t0_from_state(state, i) * 10.0; // centiseconds
+			s.endMs = (double)whisper_full_get_segment_t1_from_state(state, i) * 10.0;
+			result->text += s.text;
+			result->segments.push_back(std::move(s));
+		}
+		result->language = whisper_lang_str(whisper_full_lang_id_from_state(state));
+		result->avgLogprob = result->tokens ? logprobs / result->tokens : 0.0;
+		result->processingMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return true;
+	}
+
+	// whisper.cpp's log_mel_spectrogram of pcm (reflected 200 samples at the
+	// start, 30 s of zeros after, the maximum minus 8 as floor, then (x + 4) / 4)
+	// with mel's frames taken as they are.
+	bool SetMel(whisper_state* state, const float* pcm, size_t n, const ChunkMel& mel) {
+		constexpr size_t kBands = LogMelFrontEnd::kBands, kHop = LogMelFrontEnd::kHop, kWindow = LogMelFrontEnd::kWindow;
+		LogMelFrontEnd front;
+		front.Configure(1);
+		if (!front.Enabled()) return false;
+		const size_t frames = (n + 30 * kWhisperRate) / kHop;
+		const size_t computed = std::min(frames, (n + kWindow / 2) / kHop + 1); // later ones only see zeros
+		std::vector<float> rows(frames * kBands, -10.0f); // log10(1e-10)
+		float window[kWindow];
+		for (size_t i = 0; i < computed; ++i) {
+			float* out = &rows[i * kBands];
+			if (i >= mel.first && i < (size_t)mel.first + mel.count) {
+				std::copy(&mel.frames[(i - mel.first) * kBands], &mel.frames[(i - mel.first) * kBands] + kBands, out);
+				continue;
+			}
+			for (size_t j = 0; j < kWindow; ++j) {
+				const int64_t t = (int64_t)(i * kHop + j) - (int64_t)(kWindow / 2);
+				window[j] = t < 0 ? pcm[-t] : t < (int64_t)n ? pcm[t] : 0.0f;
+			}
+			front.Compute(window, out);
+		}
+		float lowest = -INFINITY;
+		for (float v : rows) lowest = std::max(lowest, v);
+		lowest -= 8.0f;
+		std::vector<float> data(frames * kBands); // band-major, as whisper keeps it
+		for (size_t i = 0; i < frames; ++i) {
+			for (size_t b = 0; b < kBands; ++b) data[b * frames + i] = (std::max(rows[i * kBands + b], lowest) + 4.0f) / 4.0f;
+		}
+		return whisper_set_mel_with_state(ctx_, state, data.data(), (int)frames, (int)kBands) == 0;
+	}
+
+	static void Log(ggml_log_level level, const char* text, void*) {
+		if (level == GGML_LOG_LEVEL_ERROR) AddonLog(LogLevel::Error, "whisper: %s", text);
+		else if (level == GGML_LOG_LEVEL_WARN) AddonLog(LogLevel::Warn, "whisper: %s", text);
+	}
+
+	std::mutex loadMutex_; // Load/Unload against each other
+	whisper_context* ctx_ = nullptr; // weights only; each lane decodes with its own state
+	std::vector<whisper_state*> states_;
+	std::vector<std::thread> lanes_;
+	uint32_t threadsPerLane_ = 0;
+
+	std::mutex mutex_; // everything below
+	std::condition_variable wake_;
+	std::condition_variable done_;
+	bool stopping_ = false;
+	std::map<std::string, std::deque<Job*>> queues_;
+	std::string lastStream_;
+	uint32_t queued_ = 0;
+	uint32_t running_ = 0;
+	uint64_t completed_ = 0;
+	double avgQueueMs_ = 0;
+	double avgRunMs_ = 0; // full decodes only
+	double maxQueueMs_ = 0;
+	uint64_t shedMerged_ = 0;
+	uint64_t shedDowngraded_ = 0;
+	uint64_t shedDropped_ = 0;
+#else
+	bool Load(const std::string&, int, uint32_t, double*, double*, bool*, std::string* error) {
+		*error = "Whisper is not built in (use_whisper=0)";
+		return false;
+	}
+	bool Transcribe(const float*, size_t, const WhisperJobConfig&, const std::string&, WhisperResult* result, const ChunkMel* = nullptr,
+	                std::chrono::steady_clock::time_point = std::chrono::steady_clock::time_point::max()) {
+		result->error = "Whisper is not built in (use_whisper=0)";
+		return false;
+	}
+	WhisperSchedulerStats Stats() { return WhisperSchedulerStats(); }
+	double ExpectedMs() { return 0; }
+	void Unload() {}
+#endif
+
+public:
+	// Of the last Load: the file's weight type and size
+	const std::string& FileType() const { return fileType_; }
+	double WeightsMb() const { return weightsMb_; }
+
+private:
+	std::string fileType_;
+	double weightsMb_ = 0;
+};
+
+constexpr size_t kWhisperResidentModels = 2;
+constexpr uint32_t kWhisperIdleTrimMs = 60000; // unused this long, a model other than the default goes under memory pressure
+
+struct WhisperLoadInfo {
+	bool multilingual = false;
+	double loadMs = 0, warmupMs = 0;
+	bool reused = false; // already resident on the same device with the same lanes
+	std::string quantization; // WhisperFileType
+	double weightsMb = 0;     // the file
+	double memoryMb = 0;      // resident memory the load added (approximate: other threads allocate too)
+};
+
+struct WhisperResidentModel {
+	std::string path;
+	int device = 0;
+	WhisperLoadInfo info;
+};
+
+// The resident models, one engine (one context, its lanes' states) per path.
+// The default model (no name given) is the one loaded last; loading
+// past kWhisperResidentModels unloads the one used least recently, after the
+// jobs it is running, and so does memory pressure for any but the default
+// that has been idle kWhisperIdleTrimMs. Callers hold the engine's
+// shared_ptr for a job, so an unload never pulls it from under them.
+class WhisperModelPool {
+public:
+	std::shared_ptr<WhisperEngine> Load(const std::string& path, int device, uint32_t lanes, bool background,
+	                                    WhisperLoadInfo* info, std::string* error) {
+		std::lock_guard<std::mutex> loading(loadMutex_); // one load at a time, so a path loads once
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (Entry& e : entries_) {
+				if (e.path != path || e.device != device || e.lanes != lanes) continue;
+				e.used = ++clock_;
+				e.usedAt = std::chrono::steady_clock::now();
+				default_ = e.engine;
+				*info = e.info;
+				info->reused = true;
+				return e.engine;
+			}
+		}
+		Unload(path); // resident with other settings
+		auto engine = std::make_shared<WhisperEngine>();
+		{
+			std::unique_ptr<BackgroundComputeScope> scope;
+			if (background) scope = std::make_unique<BackgroundComputeScope>();
+			const double before = ProcessResidentMb();
+			if (!engine->Load(path, device, lanes, &info->loadMs, &info->warmupMs, &info->multilingual, error)) return nullptr;
+			info->memoryMb = std::max(0.0, ProcessResidentMb() - before);
+			info->quantization = engine->FileType();
+			info->weightsMb = engine->WeightsMb();
+		}
+		std::shared_ptr<WhisperEngine> evicted;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			entries_.push_back(Entry{ path, device, lanes, engine, *info, ++clock_, std::chrono::steady_clock::now() });
+			default_ = engine;
+			if (entries_.size() > kWhisperResidentModels) {
+				auto lru = std::min_element(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+				AddonLog(LogLevel::Info, "Whisper model %s unloaded to make room", lru->path.c_str());
+				evicted = std::move(lru->engine);
+				entries_.erase(lru);
+			}
+		}
+		if (evicted) evicted->Unload(); // its last holder frees it
+		return engine;
+	}
+
+	// model: a resident path, or its file name with or without extension and
+	// "ggml-" prefix ("small" finds .../ggml-small.bin); empty for the default.
+	// Never null: with no such model, an engine whose jobs fail.
+	std::shared_ptr<WhisperEngine> Find(const std::string& model) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (model.empty()) return default_ ? default_ : none_;
+		for (Entry& e : entries_) {
+			if (!Matches(e.path, model)) continue;
+			e.used = ++clock_;
+			e.usedAt = std::chrono::steady_clock::now();
+			return e.engine;
+		}
+		return none_;
+	}
+
+	// The resident model with the smallest file below engine's, for a chunk
+	// engine would finish too late; null when engine is the smallest.
+	std::shared_ptr<WhisperEngine> Smaller(const std::shared_ptr<WhisperEngine>& engine) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		double weightsMb = engine->WeightsMb();
+		std::shared_ptr<WhisperEngine> smaller;
+		for (Entry& e : entries_) {
+			if (e.engine == engine || e.info.weightsMb >= weightsMb) continue;
+			weightsMb = e.info.weightsMb;
+			smaller = e.engine;
+		}
+		if (smaller) downgraded_++;
+		return smaller;
+	}
+
+	// Option 'draft': whether the draft's text stood.
+	void CountDraft(bool accepted) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		(accepted ? draftAccepted_ : draftRejected_)++;
+	}
+
+	// The path of a resident engine, empty for none.
+	std::string PathOf(const std::shared_ptr<WhisperEngine>& engine) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const Entry& e : entries_) if (e.engine == engine) return e.path;
+		return std::string();
+	}
+
+	// Pressure watch: unloads the idle models other than the default.
+	void TrimIdle() {
+		std::vector<std::shared_ptr<WhisperEngine>> unloaded;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			const auto idleSince = std::chrono::steady_clock::now() - std::chrono::milliseconds(kWhisperIdleTrimMs);
+			for (auto it = entries_.begin(); it != entries_.end();) {
+				if (it->engine == default_ || it->usedAt > idleSince) { ++it; continue; }
+				AddonLog(LogLevel::Info, "Whisper model %s unloaded under memory pressure", it->path.c_str());
+				unloaded.push_back(std::move(it->engine));
+				it = entries_.erase(it);
+			}
+		}
+		for (auto& engine : unloaded) engine->Unload();
+	}
+
+	// One model (as Find names it), or every one when empty.
+	void Unload(const std::string& model) {
+		std::vector<std::shared_ptr<WhisperEngine>> unloaded;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (auto it = entries_.begin(); it != entries_.end();) {
+				if (!model.empty() && !Matches(it->path, model)) { ++it; continue; }
+				if (default_ == it->engine) default_.reset();
+				unloaded.push_back(std::move(it->engine));
+				it = entries_.erase(it);
+			}
+			if (!default_ && !entries_.empty()) {
+				default_ = std::max_element(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; })->engine;
+			}
+		}
+		for (auto& engine : unloaded) engine->Unload();
+	}
+
+	// The default model's scheduler, and every resident path
+	WhisperSchedulerStats Stats() {
+		std::shared_ptr<WhisperEngine> engine = Find(std::string());
+		WhisperSchedulerStats stats = engine->Stats();
+		std::lock_guard<std::mutex> lock(mutex_);
+		stats.shedDowngraded += downgraded_; // sent to a smaller model, on any
+		stats.draftAccepted = draftAccepted_;
+		stats.draftRejected = draftRejected_;
+		for (const Entry& e : entries_) {
+			if (e.engine == default_) stats.models.insert(stats.models.begin(), e.path);
+			else stats.models.push_back(e.path);
+		}
+		return stats;
+	}
+
+	// Every resident model, the default first
+	std::vector<WhisperResidentModel> Resident() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::vector<WhisperResidentModel> models;
+		for (const Entry& e : entries_) {
+			WhisperResidentModel m{ e.path, e.device, e.info };
+			if (e.engine == default_) models.insert(models.begin(), std::move(m));
+			else models.push_back(std::move(m));
+		}
+		return models;
+	}
+
+private:
+	struct Entry {
+		std::string path;
+		int device;
+		uint32_t lanes;
+		std::shared_ptr<WhisperEngine> engine;
+		WhisperLoadInfo info;
+		uint64_t used; // clock_ when last loaded or found
+		std::chrono::steady_clock::time_point usedAt;
+	};
+
+	static bool Matches(const std::string& path, const std::string& model) {
+		if (path == model) return true;
+		const size_t slash = path.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+		if (name == model) return true;
+		const size_t dot = name.rfind('.');
+		if (dot != std::string::npos) name.resize(dot);
+		return name == model || name == "ggml-" + model;
+	}
+
+	std::mutex loadMutex_;
+	std::mutex mutex_; // everything below
+	std::vector<Entry> entries_;
+	std::shared_ptr<WhisperEngine> default_;
+	std::shared_ptr<WhisperEngine> none_ = std::make_shared<WhisperEngine>();
+	uint64_t clock_ = 0;
+	uint64_t downgraded_ = 0; // Smaller() picks
+	uint64_t draftAccepted_ = 0, draftRejected_ = 0;
+	MemoryTrimHook trim_{ [this] { TrimIdle(); } }; // last: gone first
+};
+
+inline WhisperModelPool& WhisperModels() {
+	static WhisperModelPool pool;
+	return pool;
+}
+
+// The engine for a resident model (WhisperModelPool::Find), the default one
+// when model is empty; hold it for the length of a job.
+inline std::shared_ptr<WhisperEngine> Whisper(const std::string& model = std::string()) {
+	return WhisperModels().Find(model);
+}
+
+// loadWhisperModel(path, { device?, gpu?, lanes?, background? })
+//   -> Promise<{ multilingual, loadMs, warmupMs, lanes, device, reused, quantization, weightsMb, memoryMb }>
+// Each lane is a decoder state sharing the one copy of the weights. The
+// model becomes the default; one already resident resolves with reused.
+inline Napi::Value LoadWhisperModel(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Model path required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	int device = 0;
+	bool background = false;
+	uint32_t lanes = DefaultWhisperLanes();
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Value v = info[1].As<Napi::Object>().Get("background");
+		if (v.IsBoolean()) background = v.As<Napi::Boolean>().Value();
+		std::string error;
+		if (!ReadWhisperDeviceOption(info[1].As<Napi::Object>(), &device, &error) ||
+		    !ReadUint32Option(info[1].As<Napi::Object>(), "lanes", 1, 4, &lanes, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+	struct Loaded {
+		bool ok = false;
+		WhisperLoadInfo info;
+		std::string error;
+	};
+	return QueueQuery(env, "LoadWhisperModel",
+		[path = info[0].As<Napi::String>().Utf8Value(), device, lanes, background]() {
+			Loaded result;
+			result.ok = WhisperModels().Load(path, device, lanes, background, &result.info, &result.error) != nullptr;
+			return result;
+		},
+		[lanes, device](Napi::Env env, Loaded& result) -> Napi::Value {
+			if (!result.ok) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("multilingual", Napi::Boolean::New(env, result.info.multilingual));
+			o.Set("loadMs", Napi::Number::New(env, result.info.loadMs));
+			o.Set("warmupMs", Napi::Number::New(env, result.info.warmupMs));
+			o.Set("lanes", Napi::Number::New(env, lanes));
+			o.Set("device", Napi::String::New(env, WhisperDeviceName(device)));
+			o.Set("reused", Napi::Boolean::New(env, result.info.reused));
+			o.Set("quantization", Napi::String::New(env, result.info.quantization));
+			o.Set("weightsMb", Napi::Number::New(env, result.info.weightsMb));
+			o.Set("memoryMb", Napi::Number::New(env, result.info.memoryMb));
+			return o;
+		});
+}
+
+// Copies audio (WAV Buffer, Int16Array or Float32Array, 16 kHz mono) to float.
+inline bool ReadWhisperAudio(const Napi::Value& v, std::vector<float>* out, std::string* error) {
+	if (v.IsBuffer()) {
+		Napi::Buffer<uint8_t> wav = v.As<Napi::Buffer<uint8_t>>();
+		std::vector<uint8_t> bytes(wav.Data(), wav.Data() + wav.Length());
+		std::vector<int16_t> pcm;
+		uint32_t rate = 0;
+		if (!ReadWavPcm16(bytes, &pcm, &rate, error)) return false;
+		if (rate != kWhisperRate) {
+			*error = "Whisper needs 16 kHz audio";
+			return false;
+		}
+		out->resize(pcm.size());
+		for (size_t i = 0; i < pcm.size(); ++i) (*out)[i] = pcm[i] * (1.0f / 32768.0f);
+		return true;
+	}
+	if (v.IsTypedArray()) {
+		Napi::TypedArray a = v.As<Napi::TypedArray>();
+		if (a.TypedArrayType() == napi_int16_array) {
+			Napi::Int16Array s = v.As<Napi::Int16Array>();
+			out->resize(s.ElementLength());
+			for (size_t i = 0; i < s.ElementLength(); ++i) (*out)[i] = s.Data()[i] * (1.0f / 32768.0f);
+			return true;
+		}
+		if (a.TypedArrayType() == napi_float32_array) {
+			Napi::Float32Array f = v.As<Napi::Float32Array>();
+			out->assign(f.Data(), f.Data() + f.ElementLength());
+			return true;
+		}
+	}
+	*error = "Audio must be a WAV Buffer, Int16Array or Float32Array";
+	return false;
+}
+
+// The job options transcribeWhisper shares with a pipeline's transcribe node
+// (pipeline_graph.h): language, prompt, translate, threads, model, maxStaleMs
+// and draft.
+inline bool ReadWhisperJobOptions(const Napi::Object& obj, WhisperJobConfig* config, std::string* model, WhisperDraftConfig* draft,
+                                  uint32_t* maxStaleMs, std::string* error) {
+	if (obj.Get("model").IsString()) *model = obj.Get("model").As<Napi::String>().Utf8Value();
+	if (obj.Get("language").IsString()) config->language = obj.Get("language").As<Napi::String>().Utf8Value();
+	if (obj.Get("prompt").IsString()) config->prompt = obj.Get("prompt").As<Napi::String>().Utf8Value();
+	if (obj.Get("translate").IsBoolean()) config->translate = obj.Get("translate").As<Napi::Boolean>().Value();
+	if (!ReadUint32Option(obj, "threads", 1, 64, &config->threads, error) ||
+	    !ReadUint32Option(obj, "maxStaleMs", 500, 120000, maxStaleMs, error)) {
+		return false;
+	}
+	const Napi::Value d = obj.Get("draft");
+	if (d.IsString()) {
+		draft->model = d.As<Napi::String>().Utf8Value();
+	} else if (d.IsObject() && d.As<Napi::Object>().Get("model").IsString()) {
+		Napi::Object o = d.As<Napi::Object>();
+		draft->model = o.Get("model").As<Napi::String>().Utf8Value();
+		if (!ReadFloatOption(o, "minAvgLogprob", -5.0f, 0.0f, &draft->minAvgLogprob, error) ||
+		    !ReadFloatOption(o, "minTokenP", 0.0f, 1.0f, &draft->minTokenP, error)) {
+			return false;
+		}
+	} else if (!d.IsUndefined()) {
+		*error = "Option 'draft' must be a model name or { model, minAvgLogprob?, minTokenP? }";
+		return false;
+	}
+	return true;
+}
+
+// maxStaleMs after capturedMs (deviceClockMs(); 0, no device timestamp,
+// counts as now); never with maxStaleMs 0.
+inline std::chrono::steady_clock::time_point WhisperDeadline(double capturedMs, uint32_t maxStaleMs) {
+	if (maxStaleMs == 0) return std::chrono::steady_clock::time_point::max();
+	const double ageMs = capturedMs > 0.0 ? std::max(0.0, DeviceClockNs() / 1e6 - capturedMs) : 0.0;
+	return std::chrono::steady_clock::now() +
+		std::chrono::microseconds((int64_t)((maxStaleMs - std::min<double>(ageMs, maxStaleMs)) * 1000.0));
+}
+
+// Threadpool (or pipeline) side of a transcription: the model, a smaller one
+// when the chunk would finish past its deadline, and the draft ahead of it.
+inline WhisperResult RunWhisperJob(const std::vector<float>& pcm, const ChunkMel* mel, const WhisperJobConfig& config,
+                                   const std::string& stream, const std::string& model, const WhisperDraftConfig& draft,
+                                   std::chrono::steady_clock::time_point deadline) {
+	WhisperResult result;
+	std::shared_ptr<WhisperEngine> engine = Whisper(model);
+	if (deadline != std::chrono::steady_clock::time_point::max()) {
+		const double leftMs = std::chrono::duration<double, std::milli>(deadline - std::chrono::steady_clock::now()).count();
+		const double expectedMs = engine->ExpectedMs();
+		std::shared_ptr<WhisperEngine> smaller = expectedMs > leftMs ? WhisperModels().Smaller(engine) : nullptr;
+		if (smaller) {
+			result.shed = "downgraded";
+			result.lateMs = expectedMs - leftMs;
+			result.shedModel = WhisperModels().PathOf(smaller);
+			engine = std::move(smaller);
+		}
+	}
+	// Already downgraded, the chunk runs on a small model anyway
+	std::shared_ptr<WhisperEngine> drafter = draft.model.empty() || !result.shed.empty() ? nullptr : Whisper(draft.model);
+	if (drafter && drafter != engine && !WhisperModels().PathOf(drafter).empty()) {
+		WhisperResult first;
+		drafter->Transcribe(pcm.data(), pcm.size(), config, stream, &first, mel, deadline);
+		const bool accepted = draft.Accepts(first);
+		WhisperModels().CountDraft(accepted);
+		WhisperResult& out = accepted ? first : result;
+		out.draftModel = WhisperModels().PathOf(drafter);
+		out.draftAccepted = accepted;
+		out.draftAvgLogprob = first.avgLogprob;
+		out.draftMinTokenP = first.minTokenP;
+		if (accepted) return first;
+		engine->Transcribe(pcm.data(), pcm.size(), config, stream, &result, mel, deadline);
+		result.processingMs += first.processingMs;
+		return result;
+	}
+	engine->Transcribe(pcm.data(), pcm.size(), config, stream, &result, mel, deadline);
+	return result;
+}
+
+// { text, language, segments, processingMs, shed?, draft? }
+inline Napi::Object WhisperResultToJs(Napi::Env env, const WhisperResult& result) {
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("text", Napi::String::New(env, result.text));
+	o.Set("language", Napi::String::New(env, result.language));
+	Napi::Array segments = Napi::Array::New(env, result.segments.size());
+	for (size_t i = 0; i < result.segments.size(); ++i) {
+		Napi::Object s = Napi::Object::New(env);
+		s.Set("startMs", Napi::Number::New(env, result.segments[i].startMs));
+		s.Set("endMs", Napi::Number::New(env, result.segments[i].endMs));
+		s.Set("text", Napi::String::New(env, result.segments[i].text));
+		segments.Set((uint32_t)i, s);
+	}
+	o.Set("segments", segments);
+	o.Set("processingMs", Napi::Number::New(env, result.processingMs));
+	if (!result.shed.empty()) {
+		Napi::Object shed = Napi::Object::New(env);
+		shed.Set("action", Napi::String::New(env, result.shed));
+		shed.Set("lateMs", Napi::Number::New(env, result.lateMs));
+		if (result.merged > 0) shed.Set("merged", Napi::Number::New(env, result.merged));
+		if (!result.shedModel.empty()) shed.Set("model", Napi::String::New(env, result.shedModel));
+		o.Set("shed", shed);
+	}
+	if (!result.draftModel.empty()) {
+		Napi::Object draft = Napi::Object::New(env);
+		draft.Set("model", Napi::String::New(env, result.draftModel));
+		draft.Set("accepted", Napi::Boolean::New(env, result.draftAccepted));
+		draft.Set("avgLogprob", Napi::Number::New(env, result.draftAvgLogprob));
+		draft.Set("minTokenP", Napi::Number::New(env, result.draftMinTokenP));
+		o.Set("draft", draft);
+	}
+	return o;
+}
+
+// transcribeWhisper(audio, { language?, translate?, prompt?, threads?, stream?, model?, captureTimeMs?, maxStaleMs?,
+//   draft?: model | { model, minAvgLogprob?, minTokenP? } })
+// Chunks from different streams (mic, loopback...) are served in turn; model
+// picks a resident one other than the default. maxStaleMs (500..120000) is
+// the chunk's deadline after captureTimeMs, as the top describes. draft
+// names a smaller resident model to try first (see the top); one that isn't
+// resident, or is the model itself, is skipped. The result's draft is
+// { model, accepted, avgLogprob, minTokenP } when one ran.
+inline Napi::Value TranscribeWhisper(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::vector<float> pcm;
+	std::string error;
+	if (info.Length() < 1 || !ReadWhisperAudio(info[0], &pcm, &error)) {
+		Napi::TypeError::New(env, error.empty() ? "Audio required" : error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	// A chunk a capture with option 'mel' cut comes with its frames
+	ChunkMel mel;
+	const bool cut = ChunkMels().Find(ChunkMelKey(pcm.data(), pcm.size()), pcm.size(), &mel);
+	WhisperJobConfig config;
+	std::string stream = "default";
+	std::string model;
+	WhisperDraftConfig draft;
+	auto deadline = std::chrono::steady_clock::time_point::max();
+	if (info.Length() > 1 && info[1].IsObject()) {
+		Napi::Object obj = info[1].As<Napi::Object>();
+		if (obj.Get("stream").IsString()) stream = obj.Get("stream").As<Napi::String>().Utf8Value();
+		uint32_t maxStaleMs = 0;
+		if (!ReadWhisperJobOptions(obj, &config, &model, &draft, &maxStaleMs, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		if (!obj.Get("captureTimeMs").IsUndefined() && !obj.Get("captureTimeMs").IsNumber()) {
+			Napi::TypeError::New(env, "Option 'captureTimeMs' must be a number").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		// Already this old when submitted
+		deadline = WhisperDeadline(obj.Get("captureTimeMs").IsNumber() ? obj.Get("captureTimeMs").As<Napi::Number>().DoubleValue() : 0.0,
+		                           maxStaleMs);
+	}
+	return QueueQuery(env, "TranscribeWhisper",
+		[pcm = std::move(pcm), mel = std::move(mel), cut, config, stream, model, draft, deadline]() {
+			return RunWhisperJob(pcm, cut ? &mel : nullptr, config, stream, model, draft, deadline);
+		},
+		[](Napi::Env env, WhisperResult& result) -> Napi::Value {
+			if (!result.error.empty()) {
+				Napi::Error::New(env, result.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			return WhisperResultToJs(env, result);
+		});
+}
+
+// unloadWhisperModel(model?): frees one resident model, or all of them, on
+// the threadpool after any transcription in flight.
+inline Napi::Value UnloadWhisperModel(const Napi::CallbackInfo& info) {
+	std::string model;
+	if (info.Length() > 0 && info[0].IsString()) model = info[0].As<Napi::String>().Utf8Value();
+	return QueueQuery(info.Env(), "UnloadWhisperModel",
+		[model]() {
+			WhisperModels().Unload(model);
+			return true;
+		},
+		[](Napi::Env env, bool&) -> Napi::Value { return env.Undefined(); });
+}
+
+// getWhisperSchedulerStats() -> { lanes, threadsPerLane, queued, running, completed,
+//   avgQueueMs, avgRunMs, maxQueueMs, streams: { [stream]: queued }, models,
+//   shed: { merged, downgraded, dropped }, draft: { accepted, rejected } }
+// for the default model; models lists the resident paths, the default first.
+// maxQueueMs covers the time since the previous call.
+inline Napi::Value GetWhisperSchedulerStats(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	const WhisperSchedulerStats stats = WhisperModels().Stats();
+	Napi::Object o = Napi::Object::New(env);
+	o.Set("lanes", Napi::Number::New(env, stats.lanes));
+	o.Set("threadsPerLane", Napi::Number::New(env, stats.threadsPerLane));
+	o.Set("queued", Napi::Number::New(env, stats.queued));
+	o.Set("running", Napi::Number::New(env, stats.running));
+	o.Set("completed", Napi::Number::New(env, (double)stats.completed));
+	o.Set("avgQueueMs", Napi::Number::New(env, stats.avgQueueMs));
+	o.Set("avgRunMs", Napi::Number::New(env, stats.avgRunMs));
+	o.Set("maxQueueMs", Napi::Number::New(env, stats.maxQueueMs));
+	Napi::Object streams = Napi::Object::New(env);
+	for (auto& s : stats.queuedByStream) streams.Set(s.first, Napi::Number::New(env, s.second));
+	o.Set("streams", streams);
+	Napi::Array models = Napi::Array::New(env, stats.models.size());
+	for (size_t i = 0; i < stats.models.size(); ++i) models.Set((uint32_t)i, Napi::String::New(env, stats.models[i]));
+	o.Set("models", models);
+	Napi::Object shed = Napi::Object::New(env);
+	shed.Set("merged", Napi::Number::New(env, (double)stats.shedMerged));
+	shed.Set("downgraded", Napi::Number::New(env, (double)stats.shedDowngraded));
+	shed.Set("dropped", Napi::Number::New(env, (double)stats.shedDropped));
+	o.Set("shed", shed);
+	Napi::Object draft = Napi::Object::New(env);
+	draft.Set("accepted", Napi::Number::New(env, (double)stats.draftAccepted));
+	draft.Set("rejected", Napi::Number::New(env, (double)stats.draftRejected));
+	o.Set("draft", draft);
+	return o;
+}
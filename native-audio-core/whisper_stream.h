@@ -0,0 +1,386 @@
+#pragma once
+
+// Streaming transcription on the resident whisper.cpp model
+// (whisper_engine.h). Audio fed with feedWhisperStream accumulates in a
+// window; every hopMs of new audio the window is re-decoded with one segment
+// per word, and the local-agreement policy commits the words two consecutive
+// passes agree on. Committed audio is trimmed from the window (its text goes
+// back in as the prompt), so a pass never decodes more than windowMs and
+// caption latency is bounded by the hop plus one pass rather than by the
+// utterance. A window that fills without agreement commits its hypothesis.
+//
+// Most of a window was in the previous one, so a pass doesn't start from the
+// samples: the stream keeps the window's log-mel frames (log_mel.h, with
+// use_avtx) and each pass computes only those the new hop completed, plus the
+// few at the end whose analysis window still runs past the audio; trimming
+// committed audio drops whole frames (cuts land on the 10 ms hop). The
+// encoder is not reusable the same way: every layer attends over the whole
+// window, so one new frame changes every position's activations. What it
+// can do is stop encoding 30 s of padding: with encoder 'window' (the
+// default) it runs over the window plus a margin (audio_ctx, rounded up to
+// 64 positions), so its cost follows the window, not Whisper's 30 s;
+// 'full' keeps the 30 s context for the accuracy it buys.
+//
+//   openWhisperStream(id, callback, { windowMs?, hopMs?, language?, translate?, threads?, encoder? })
+//   feedWhisperStream(id, Int16Array | Float32Array | WAV Buffer)   16 kHz mono
+//   flushWhisperStream(id) -> Promise<{ text }>   final for the utterance so far
+//   closeWhisperStream(id) -> Promise<{ text }>   flush, then forget the stream
+//
+// callback({ type: 'partial', committed, stable, tentative, audioMs, processingMs, encodedMs, melReused })
+// gets the newly committed words, everything committed since the last final,
+// and the unconfirmed tail, with how much audio the encoder ran over and how
+// many mel frames came from earlier passes; callback({ type: 'error', message }) reports a
+// failed pass. Stream state is only touched on the JS thread; passes copy the
+// window out and run on the threadpool, and a flush discards passes still in
+// flight by bumping the stream's epoch.
+
+#include <napi.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "addon_instance.h"
+#include "addon_log.h"
+#include "async_query.h"
+#include "capture_options.h"
+#include "log_mel.h"
+#include "whisper_engine.h"
+
+// Encoder positions past the window's own with encoder 'window', for the
+// hop that arrives while a pass runs (640 ms).
+constexpr uint32_t kWhisperStreamCtxMargin = 32;
+
+struct WhisperWord {
+	std::string text; // as whisper wrote it, leading space included
+	double startMs = 0;
+	double endMs = 0;
+};
+
+// Lowercase letters and digits only, so punctuation and casing churn between
+// passes doesn't block agreement.
+inline std::string NormalizeWhisperWord(const std::string& text) {
+	std::string out;
+	for (unsigned char c : text) {
+		if (std::isalnum(c) || c >= 0x80) out.push_back((char)std::tolower(c));
+	}
+	return out;
+}
+
+struct WhisperStream {
+	std::string id; // scheduler queue key
+	Napi::FunctionReference callback;
+	WhisperJobConfig config;
+	size_t windowSamples = 0;
+	size_t hopSamples = 0;
+
+	std::vector<float> window;    // audio not yet committed
+	double windowStartMs = 0;     // stream time of window[0]
+	ChunkMel mel;                 // the window's complete log-mel frames, frame 0 centred on window[0]
+	bool fullEncoder = false;
+	size_t sinceDecode = 0;       // samples fed since the last pass was queued
+	bool decoding = false;
+	uint64_t epoch = 0;
+
+	std::vector<WhisperWord> tentative; // last pass's uncommitted words
+	std::string stable;                 // committed since the last final
+	bool closed = false;
+};
+
+struct WhisperPass {
+	bool ok = false;
+	std::string error;
+	std::vector<WhisperWord> words;
+	double processingMs = 0;
+	ChunkMel mel;           // the window's frames after this pass
+	uint32_t melReused = 0; // frames earlier passes computed
+	double encodedMs = 0;
+};
+
+// One set of streams per environment (addon_instance.h). The callbacks are
+// references into the env, so the streams go with it.
+inline std::map<std::string, std::shared_ptr<WhisperStream>>& WhisperStreams(Napi::Env env) {
+	return PerEnv<std::map<std::string, std::shared_ptr<WhisperStream>>>(env);
+}
+
+// Last ~200 characters of committed text, cut at a word, as the decoder prompt.
+inline std::string WhisperStreamPrompt(const std::string& stable) {
+	if (stable.size() <= 200) return stable;
+	const size_t space = stable.find(' ', stable.size() - 200);
+	return stable.substr(space == std::string::npos ? stable.size() - 200 : space);
+}
+
+// Appends the frames whose analysis window the audio now covers; the first
+// two reach before the stream and are reflected, as whisper.cpp does. Frames
+// past the end are left to the engine, which pads them with zeros.
+inline void ExtendWhisperMel(const std::vector<float>& audio, ChunkMel* mel) {
+	constexpr size_t kBands = LogMelFrontEnd::kBands, kHop = LogMelFrontEnd::kHop, kWindow = LogMelFrontEnd::kWindow;
+	if (audio.size() < kWindow) return;
+	const size_t complete = (audio.size() - kWindow / 2) / kHop + 1;
+	if (mel->count >= complete) return;
+	LogMelFrontEnd front;
+	front.Configure(1);
+	if (!front.Enabled()) return;
+	mel->first = 0;
+	mel->frames.resize(complete * kBands);
+	float window[kWindow];
+	for (size_t i = mel->count; i < complete; ++i) {
+		for (size_t j = 0; j < kWindow; ++j) {
+			const int64_t t = (int64_t)(i * kHop + j) - (int64_t)(kWindow / 2);
+			window[j] = audio[(size_t)(t < 0 ? -t : t)];
+		}
+		front.Compute(window, &mel->frames[i * kBands]);
+	}
+	mel->count = (uint32_t)complete;
+}
+
+// Encoder positions for a window of n samples: two mel frames each, plus the
+// margin, rounded up to 64 so passes reuse a few graph shapes.
+inline uint32_t WhisperStreamAudioCtx(size_t n) {
+	const size_t positions = (n / LogMelFrontEnd::kHop + 2) / 2 + kWhisperStreamCtxMargin;
+	return (uint32_t)std::min<size_t>(1500, (positions + 63) / 64 * 64);
+}
+
+// Runs on the pool: decodes a copy of the window into words with stream
+// times, starting from (and returning) the window's cached mel frames.
+inline WhisperPass RunWhisperPass(const std::vector<float>& audio, double startMs, WhisperJobConfig config, ChunkMel mel,
+                                  bool fullEncoder, const std::string& id) {
+	WhisperPass pass;
+	WhisperResult result;
+	pass.melReused = mel.count;
+	ExtendWhisperMel(audio, &mel);
+	if (!fullEncoder) config.audioCtx = WhisperStreamAudioCtx(audio.size());
+	pass.encodedMs = config.audioCtx ? config.audioCtx * 20.0 : 30000.0;
+	pass.ok = Whisper()->Transcribe(audio.data(), audio.size(), config, id, &result, mel.count > 0 ? &mel : nullptr);
+	pass.mel = std::move(mel);
+	pass.error = result.error;
+	pass.processingMs = result.processingMs;
+	for (auto& segment : result.segments) {
+		if (NormalizeWhisperWord(segment.text).empty()) continue;
+		WhisperWord word;
+		word.text = segment.text;
+		word.startMs = startMs + segment.startMs;
+		word.endMs = startMs + segment.endMs;
+		pass.words.push_back(std::move(word));
+	}
+	return pass;
+}
+
+// Drops window audio before ms (stream time), down to a whole mel hop so
+// the cached frames stay aligned with the window.
+inline void TrimWhisperWindow(WhisperStream& stream, double ms) {
+	const double samples = (ms - stream.windowStartMs) * (kWhisperRate / 1000.0);
+	size_t n = samples <= 0 ? 0 : (samples >= (double)stream.window.size() ? stream.window.size() : (size_t)samples);
+	n -= n % LogMelFrontEnd::kHop;
+	if (n == 0) return;
+	stream.window.erase(stream.window.begin(), stream.window.begin() + n);
+	stream.windowStartMs += n * (1000.0 / kWhisperRate);
+	const size_t frames = std::min<size_t>(n / LogMelFrontEnd::kHop, stream.mel.count);
+	stream.mel.frames.erase(stream.mel.frames.begin(), stream.mel.frames.begin() + frames * LogMelFrontEnd::kBands);
+	stream.mel.count -= (uint32_t)frames;
+}
+
+inline void QueueWhisperPass(Napi::Env env, const std::shared_ptr<WhisperStream>& stream);
+
+// JS thread: local agreement between this pass and the previous one.
+inline void ApplyWhisperPass(Napi::Env env, const std::shared_ptr<WhisperStream>& stream, WhisperPass& pass) {
+	WhisperStream& s = *stream;
+	// The pass ran on the window as it is now: only this function trims it
+	if (pass.mel.count > s.mel.count) s.mel = std::move(pass.mel);
+	if (!pass.ok) {
+		Napi::Object event = Napi::Object::New(env);
+		event.Set("type", Napi::String::New(env, "error"));
+		event.Set("message", Napi::String::New(env, pass.error));
+		s.callback.Value().Call({ event });
+		return;
+	}
+	size_t agreed = 0;
+	while (agreed < pass.words.size() && agreed < s.tentative.size() &&
+	       NormalizeWhisperWord(pass.words[agreed].text) == NormalizeWhisperWord(s.tentative[agreed].text)) {
+		++agreed;
+	}
+	// A full window with no agreement would otherwise stall; take the pass as is
+	if (agreed == 0 && s.window.size() >= s.windowSamples) agreed = pass.words.size();
+
+	std::string committed;
+	for (size_t i = 0; i < agreed; ++i) committed += pass.words[i].text;
+	if (agreed > 0) {
+		TrimWhisperWindow(s, pass.words[agreed - 1].endMs);
+		s.stable += committed;
+	} else if (s.window.size() > s.windowSamples) {
+		// Nothing recognized at all; keep the window bounded
+		TrimWhisperWindow(s, s.windowStartMs + (s.window.size() - s.windowSamples) * (1000.0 / kWhisperRate));
+	}
+	s.tentative.assign(pass.words.begin() + agreed, pass.words.end());
+	std::string tentative;
+	for (auto& word : s.tentative) tentative += word.text;
+
+	Napi::Object event = Napi::Object::New(env);
+	event.Set("type", Napi::String::New(env, "partial"));
+	event.Set("committed", Napi::String::New(env, committed));
+	event.Set("stable", Napi::String::New(env, s.stable));
+	event.Set("tentative", Napi::String::New(env, tentative));
+	event.Set("audioMs", Napi::Number::New(env, s.window.size() * (1000.0 / kWhisperRate)));
+	event.Set("processingMs", Napi::Number::New(env, pass.processingMs));
+	event.Set("encodedMs", Napi::Number::New(env, pass.encodedMs));
+	event.Set("melReused", Napi::Number::New(env, pass.melReused));
+	s.callback.Value().Call({ event });
+}
+
+inline void QueueWhisperPass(Napi::Env env, const std::shared_ptr<WhisperStream>& stream) {
+	WhisperStream& s = *stream;
+	s.decoding = true;
+	s.sinceDecode = 0;
+	WhisperJobConfig config = s.config;
+	config.prompt = WhisperStreamPrompt(s.stable);
+	const uint64_t epoch = s.epoch;
+	QueueQuery(env, "WhisperStreamPass",
+		[audio = s.window, startMs = s.windowStartMs, config, mel = s.mel, full = s.fullEncoder, id = s.id]() {
+			return RunWhisperPass(audio, startMs, config, mel, full, id);
+		},
+		[stream, epoch](Napi::Env env, WhisperPass& pass) -> Napi::Value {
+			if (stream->epoch != epoch || stream->closed) return env.Undefined();
+			stream->decoding = false;
+			ApplyWhisperPass(env, stream, pass);
+			if (env.IsExceptionPending()) {
+				// Nobody awaits a pass; a throwing callback is logged rather than left as an unhandled rejection
+				env.GetAndClearPendingException();
+				AddonLog(LogLevel::Warn, "Whisper stream callback threw");
+			}
+			if (!stream->decoding && stream->sinceDecode >= stream->hopSamples) QueueWhisperPass(env, stream);
+			return env.Undefined();
+		});
+}
+
+inline std::shared_ptr<WhisperStream> FindWhisperStream(const Napi::CallbackInfo& info) {
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(info.Env(), "Stream id required").ThrowAsJavaScriptException();
+		return nullptr;
+	}
+	auto& streams = WhisperStreams(info.Env());
+	auto it = streams.find(info[0].As<Napi::String>().Utf8Value());
+	if (it == streams.end()) {
+		Napi::Error::New(info.Env(), "No such whisper stream").ThrowAsJavaScriptException();
+		return nullptr;
+	}
+	return it->second;
+}
+
+// openWhisperStream(id, callback, options?) - replaces a stream of the same id.
+inline Napi::Value OpenWhisperStream(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 2 || !info[0].IsString() || !info[1].IsFunction()) {
+		Napi::TypeError::New(env, "Stream id and callback required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	auto stream = std::make_shared<WhisperStream>();
+	uint32_t windowMs = 5000;
+	uint32_t hopMs = 500;
+	stream->config.wordSegments = true;
+	if (info.Length() > 2 && info[2].IsObject()) {
+		Napi::Object obj = info[2].As<Napi::Object>();
+		std::string error;
+		if (!ReadUint32Option(obj, "windowMs", 1000, 30000, &windowMs, &error) ||
+		    !ReadUint32Option(obj, "hopMs", 100, 5000, &hopMs, &error) ||
+		    !ReadUint32Option(obj, "threads", 1, 64, &stream->config.threads, &error)) {
+			Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+			return env.Null();
+		}
+		if (obj.Get("language").IsString()) stream->config.language = obj.Get("language").As<Napi::String>().Utf8Value();
+		if (obj.Get("translate").IsBoolean()) stream->config.translate = obj.Get("translate").As<Napi::Boolean>().Value();
+		Napi::Value encoder = obj.Get("encoder");
+		if (!encoder.IsUndefined()) {
+			const std::string name = encoder.IsString() ? encoder.As<Napi::String>().Utf8Value() : std::string();
+			if (name != "window" && name != "full") {
+				Napi::TypeError::New(env, "Option 'encoder' must be 'window' or 'full'").ThrowAsJavaScriptException();
+				return env.Null();
+			}
+			stream->fullEncoder = name == "full";
+		}
+	}
+	if (hopMs >= windowMs) {
+		Napi::TypeError::New(env, "hopMs must be shorter than windowMs").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	stream->windowSamples = (size_t)windowMs * kWhisperRate / 1000;
+	stream->hopSamples = (size_t)hopMs * kWhisperRate / 1000;
+	stream->window.reserve(stream->windowSamples + stream->hopSamples * 4);
+	stream->id = info[0].As<Napi::String>().Utf8Value();
+	stream->callback = Napi::Persistent(info[1].As<Napi::Function>());
+	auto& slot = WhisperStreams(env)[stream->id];
+	if (slot) slot->closed = true;
+	slot = std::move(stream);
+	return Napi::Boolean::New(env, true);
+}
+
+inline Napi::Value FeedWhisperStream(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::shared_ptr<WhisperStream> stream = FindWhisperStream(info);
+	if (!stream) return env.Null();
+	std::vector<float> pcm;
+	std::string error;
+	if (info.Length() < 2 || !ReadWhisperAudio(info[1], &pcm, &error)) {
+		Napi::TypeError::New(env, error.empty() ? "Audio required" : error).ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	stream->window.insert(stream->window.end(), pcm.begin(), pcm.end());
+	stream->sinceDecode += pcm.size();
+	if (!stream->decoding && stream->sinceDecode >= stream->hopSamples) QueueWhisperPass(env, stream);
+	return env.Undefined();
+}
+
+// Decodes whatever is left and commits all of it; the stream starts over.
+inline Napi::Value FlushWhisperStream(const Napi::CallbackInfo& info, bool close) {
+	Napi::Env env = info.Env();
+	std::shared_ptr<WhisperStream> stream = FindWhisperStream(info);
+	if (!stream) return env.Null();
+	if (close) WhisperStreams(env).erase(info[0].As<Napi::String>().Utf8Value());
+	WhisperStream& s = *stream;
+	s.epoch++;
+	s.decoding = false;
+	s.sinceDecode = 0;
+	WhisperJobConfig config = s.config;
+	config.prompt = WhisperStreamPrompt(s.stable);
+	std::vector<float> audio;
+	audio.swap(s.window);
+	ChunkMel mel;
+	std::swap(mel, s.mel);
+	const double startMs = s.windowStartMs;
+	s.windowStartMs += audio.size() * (1000.0 / kWhisperRate);
+	std::string text = s.stable;
+	s.stable.clear();
+	s.tentative.clear();
+	if (close) {
+		s.closed = true;
+		s.callback.Reset();
+	}
+	struct Final {
+		WhisperPass pass;
+		std::string text;
+	};
+	return QueueQuery(env, "WhisperStreamFlush",
+		[audio = std::move(audio), startMs, config, mel = std::move(mel), full = s.fullEncoder, text, id = s.id]() {
+			Final result;
+			result.text = text;
+			if (audio.size() >= kWhisperRate / 10) result.pass = RunWhisperPass(audio, startMs, config, mel, full, id);
+			else result.pass.ok = true; // under 100 ms: nothing worth decoding
+			for (auto& word : result.pass.words) result.text += word.text;
+			return result;
+		},
+		[](Napi::Env env, Final& result) -> Napi::Value {
+			if (!result.pass.ok) {
+				Napi::Error::New(env, result.pass.error).ThrowAsJavaScriptException();
+				return env.Undefined();
+			}
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("text", Napi::String::New(env, result.text));
+			return o;
+		});
+}
+
+inline Napi::Value FlushWhisperStream(const Napi::CallbackInfo& info) { return FlushWhisperStream(info, false); }
+inline Napi::Value CloseWhisperStream(const Napi::CallbackInfo& info) { return FlushWhisperStream(info, true); }
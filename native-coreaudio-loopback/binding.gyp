@@ -1,10 +1,38 @@
 {
+  "variables": {
+    "use_accelerate%": 1,
+    "use_swresample%": 0,
+    "ffmpeg_dir%": "<(module_root_dir)/../ffmpeg/mac",
+    "ffmpeg_private_libs%": [ "-L/opt/homebrew/lib", "-lsoxr", "-lX11" ],
+    "use_opus%": 0,
+    "opus_dir%": "/opt/homebrew/opt/opus",
+    "use_avcodec%": 0,
+    "avcodec_private_libs%": [ "-L/opt/homebrew/lib", "-lvpx", "-lm", "-lwebpmux", "-liconv", "-llzma", "-laribb24", "-ldav1d", "-lopencore-amrwb", "-lsnappy", "-lstdc++", "-laom", "-lvmaf", "-ljxl", "-ljxl_threads", "-lmp3lame", "-lopencore-amrnb", "-lopenjp2", "-lopus", "-lrav1e", "-lspeex", "-lSvtAv1Enc", "-ltheoraenc", "-ltheoradec", "-logg", "-lvorbis", "-lvorbisenc", "-lwebp", "-lx264", "-lx265", "-lxvidcore", "-lz", "-lsoxr", "-lX11" ],
+    "use_avformat%": 0,
+    "avformat_private_libs%": [ "-L/opt/homebrew/lib", "-lxml2", "-lbz2", "-lbluray", "-lgnutls", "-lrist", "-lsrt", "-lssh", "-lzmq" ],
+    "use_avfilter%": 0,
+    "avfilter_private_libs%": [ "-L/opt/homebrew/lib", "-lrubberband", "-lsamplerate", "-lharfbuzz", "-ltesseract", "-larchive", "-lcurl", "-lass", "-lvidstab", "-lzmq", "-lzimg", "-lfontconfig", "-lfreetype", "-lxml2", "-lbz2", "-lbluray", "-lgnutls", "-lrist", "-lsrt", "-lssh" ],
+    "use_swscale%": 0,
+    "use_avtx%": 0,
+    "use_whisper%": 0,
+    "whisper_dir%": "<(module_root_dir)/../whisper/mac",
+    "use_ctranslate2%": 0,
+    "ctranslate2_dir%": "<(module_root_dir)/../ctranslate2/mac",
+    "use_tesseract%": 0,
+    "tesseract_dir%": "/opt/homebrew/opt/tesseract",
+    "leptonica_dir%": "/opt/homebrew/opt/leptonica",
+    "use_onnxruntime%": 0,
+    "onnxruntime_dir%": "<(module_root_dir)/../onnxruntime/mac",
+    "use_espeak%": 0,
+    "espeak_dir%": "/opt/homebrew/opt/espeak-ng"
+  },
   "targets": [
     {
       "target_name": "coreaudio_loopback",
-      "sources": [ "coreaudio_loopback.cc" ],
+      "sources": [ "coreaudio_loopback.cc", "device_registry.cc", "process_tap.mm", "screen_region_capture.mm", "power_watch.cc", "session_registry.cc", "soundboard_output.cc", "http_client.mm" ],
       "include_dirs": [
-        "<!@(node -p \"require('node-addon-api').include\")"
+        "<!@(node -p \"require('node-addon-api').include\")",
+        "<(module_root_dir)/../native-audio-core"
       ],
       "dependencies": [
         "<!@(node -p \"require('node-addon-api').gyp\")"
@@ -12,18 +40,219 @@
       "defines": [
         "NAPI_DISABLE_CPP_EXCEPTIONS"
       ],
+      "configurations": {
+        "Debug": {
+          "defines": [ "AUDIO_CORE_RT_ALLOC_CHECK" ]
+        }
+      },
       "conditions": [
         ["OS=='mac'", {
           "xcode_settings": {
             "GCC_ENABLE_CPP_EXCEPTIONS": "YES",
             "CLANG_CXX_LIBRARY": "libc++",
+            "CLANG_ENABLE_OBJC_ARC": "YES",
             "MACOSX_DEPLOYMENT_TARGET": "10.13"
           },
           "link_settings": {
             "libraries": [
               "-framework CoreAudio",
+              "-framework Foundation",
               "-framework AudioUnit",
-              "-framework AudioToolbox"
+              "-framework AudioToolbox",
+              "-framework CoreGraphics",
+              "-framework CoreMedia",
+              "-framework CoreVideo",
+              "-framework IOKit",
+              "-weak_framework ScreenCaptureKit"
+            ]
+          }
+        }],
+        ["OS=='mac' and use_accelerate==1", {
+          "defines": [ "AUDIO_CORE_ACCELERATE" ],
+          "link_settings": {
+            "libraries": [ "-framework Accelerate" ]
+          }
+        }],
+        ["OS=='mac' and use_swresample==1", {
+          "defines": [ "AUDIO_CORE_SWRESAMPLE" ],
+          "include_dirs": [ "<(ffmpeg_dir)/include" ],
+          "link_settings": {
+            "libraries": [
+              "<(ffmpeg_dir)/lib/libswresample.a",
+              "<(ffmpeg_dir)/lib/libavutil.a",
+              "<@(ffmpeg_private_libs)",
+              "-framework CoreFoundation",
+              "-framework CoreMedia",
+              "-framework CoreVideo",
+              "-framework VideoToolbox"
+            ]
+          }
+        }],
+        ["OS=='mac' and use_opus==1", {
+          "defines": [ "AUDIO_CORE_OPUS" ],
+          "include_dirs": [ "<(opus_dir)/include/opus" ],
+          "link_settings": {
+            "libraries": [ "<(opus_dir)/lib/libopus.a" ]
+          }
+        }],
+        ["OS=='mac' and use_avcodec==1", {
+          "defines": [ "AUDIO_CORE_AVCODEC" ],
+          "include_dirs": [ "<(ffmpeg_dir)/include" ],
+          "link_settings": {
+            "libraries": [
+              "<(ffmpeg_dir)/lib/libavcodec.a",
+              "<(ffmpeg_dir)/lib/libswresample.a",
+              "<(ffmpeg_dir)/lib/libavutil.a",
+              "<@(avcodec_private_libs)",
+              "-framework AudioToolbox",
+              "-framework CoreFoundation",
+              "-framework CoreMedia",
+              "-framework CoreServices",
+              "-framework CoreVideo",
+              "-framework VideoToolbox"
+            ]
+          }
+        }],
+        ["OS=='mac' and use_avformat==1", {
+          "defines": [ "AUDIO_CORE_AVFORMAT" ],
+          "include_dirs": [ "<(ffmpeg_dir)/include" ],
+          "link_settings": {
+            "libraries": [
+              "<(ffmpeg_dir)/lib/libavformat.a",
+              "<(ffmpeg_dir)/lib/libavcodec.a",
+              "<(ffmpeg_dir)/lib/libswresample.a",
+              "<(ffmpeg_dir)/lib/libavutil.a",
+              "<@(avformat_private_libs)",
+              "<@(avcodec_private_libs)",
+              "-framework AudioToolbox",
+              "-framework CoreFoundation",
+              "-framework CoreMedia",
+              "-framework CoreServices",
+              "-framework CoreVideo",
+              "-framework VideoToolbox"
+            ]
+          }
+        }],
+        ["OS=='mac' and use_avfilter==1", {
+          "defines": [ "AUDIO_CORE_AVFILTER" ],
+          "include_dirs": [ "<(ffmpeg_dir)/include" ],
+          "link_settings": {
+            "libraries": [
+              "<(ffmpeg_dir)/lib/libavfilter.a",
+              "<(ffmpeg_dir)/lib/libswscale.a",
+              "<(ffmpeg_dir)/lib/libavformat.a",
+              "<(ffmpeg_dir)/lib/libavcodec.a",
+              "<(ffmpeg_dir)/lib/libswresample.a",
+              "<(ffmpeg_dir)/lib/libavutil.a",
+              "<@(avfilter_private_libs)",
+              "<@(avcodec_private_libs)",
+              "-framework AppKit",
+              "-framework AudioToolbox",
+              "-framework CoreImage",
+              "-framework CoreMedia",
+              "-framework CoreServices",
+              "-framework CoreVideo",
+              "-framework Metal",
+              "-framework OpenGL",
+              "-framework VideoToolbox"
+            ]
+          }
+        }],
+        ["OS=='mac' and use_swscale==1", {
+          "defines": [ "AUDIO_CORE_SWSCALE" ],
+          "include_dirs": [ "<(ffmpeg_dir)/include" ],
+          "link_settings": {
+            "libraries": [
+              "<(ffmpeg_dir)/lib/libswscale.a",
+              "<(ffmpeg_dir)/lib/libavutil.a",
+              "<@(ffmpeg_private_libs)",
+              "-framework CoreFoundation",
+              "-framework CoreMedia",
+              "-framework CoreVideo",
+              "-framework VideoToolbox"
+            ]
+          }
+        }],
+        ["OS=='mac' and use_avtx==1", {
+          "defines": [ "AUDIO_CORE_AVTX" ],
+          "include_dirs": [ "<(ffmpeg_dir)/include" ],
+          "link_settings": {
+            "libraries": [
+              "<(ffmpeg_dir)/lib/libavutil.a",
+              "<@(ffmpeg_private_libs)",
+              "-framework CoreFoundation",
+              "-framework CoreMedia",
+              "-framework CoreVideo",
+              "-framework VideoToolbox"
+            ]
+          }
+        }],
+        ["OS=='mac' and use_whisper==1", {
+          "defines": [ "AUDIO_CORE_WHISPER" ],
+          "include_dirs": [ "<(whisper_dir)/include" ],
+          "link_settings": {
+            "libraries": [
+              "<(whisper_dir)/lib/libwhisper.a",
+              "<(whisper_dir)/lib/libggml.a",
+              "<(whisper_dir)/lib/libggml-base.a",
+              "<(whisper_dir)/lib/libggml-cpu.a",
+              "<(whisper_dir)/lib/libggml-metal.a",
+              "<(whisper_dir)/lib/libggml-blas.a",
+              "-framework Accelerate",
+              "-framework Foundation",
+              "-framework Metal",
+              "-framework MetalKit"
+            ]
+          }
+        }],
+        ["OS=='mac' and use_ctranslate2==1", {
+          "defines": [ "AUDIO_CORE_CTRANSLATE2" ],
+          "include_dirs": [ "<(ctranslate2_dir)/include" ],
+          "link_settings": {
+            "libraries": [
+              "<(ctranslate2_dir)/lib/libctranslate2.a",
+              "<(ctranslate2_dir)/lib/libsentencepiece.a",
+              "-framework Accelerate"
+            ]
+          }
+        }],
+        ["OS=='mac' and use_tesseract==1", {
+          "defines": [ "AUDIO_CORE_TESSERACT" ],
+          "include_dirs": [ "<(tesseract_dir)/include", "<(leptonica_dir)/include" ],
+          "link_settings": {
+            "libraries": [
+              "<(tesseract_dir)/lib/libtesseract.a",
+              "<(leptonica_dir)/lib/libleptonica.a",
+              "-L/opt/homebrew/lib",
+              "-larchive",
+              "-lcurl",
+              "-lpng",
+              "-ljpeg",
+              "-ltiff",
+              "-lwebp",
+              "-lwebpmux",
+              "-lgif",
+              "-lopenjp2",
+              "-lz"
+            ]
+          }
+        }],
+        ["OS=='mac' and use_onnxruntime==1", {
+          "defines": [ "AUDIO_CORE_ONNXRUNTIME" ],
+          "include_dirs": [ "<(onnxruntime_dir)/include" ],
+          "link_settings": {
+            "libraries": [
+              "<(onnxruntime_dir)/lib/libonnxruntime.dylib",
+              "-Wl,-rpath,@loader_path"
+            ]
+          }
+        }],
+        ["OS=='mac' and use_espeak==1", {
+          "defines": [ "AUDIO_CORE_ESPEAK" ],
+          "include_dirs": [ "<(espeak_dir)/include" ],
+          "link_settings": {
+            "libraries": [
+              "<(espeak_dir)/lib/libespeak-ng.dylib"
             ]
           }
         }]
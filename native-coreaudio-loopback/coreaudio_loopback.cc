@@ -4,6 +4,8 @@
 #include <AudioToolbox/AudioToolbox.h>
 #include <libproc.h>
 #include <CoreFoundation/CoreFoundation.h>
+#include <mach/mach.h>
+#include <mach/semaphore.h>
 
 #include <thread>
 #include <atomic>
@@ -13,55 +15,211 @@
 #include <cmath>
 #include <cstring>
 #include <memory>
+#include <mutex>
 #include <algorithm>
 #include <unistd.h>
 #include <sys/sysctl.h>
 #include <chrono>
 #include <thread>
 
+#include "ocr_engine.h"
+#include "paddle_ocr_engine.h"
+#include "pcm_channel.h"
+#include "pcm_packet_writer.h"
+#include "pipeline_graph.h"
+#include "piper_tts_engine.h"
+#include "platform_trace.h"
+#include "processing_params.h"
+#include "addon_instance.h"
+#include "audio_encoder.h"
+#include "batch_transcribe.h"
+#include "capture_history.h"
+#include "capture_options.h"
+#include "capture_session.h"
+#include "capture_subscribers.h"
+#include "capture_watchdog.h"
+#include "delivery_gate.h"
+#include "delivery_stress.h"
+#include "dialogue_focus.h"
+#include "downmix.h"
+#include "dsp_bindings.h"
+#include "dsp_blocks.h"
+#include "dsp_eval.h"
+#include "dsp_kernel_bindings.h"
+#include "echo_canceller.h"
+#include "event_bus.h"
+#include "file_replay_source.h"
+#include "flac_chunk_encoder.h"
+#include "fuzzy_text_bindings.h"
+#include "async_query.h"
+#include "latency_histogram.h"
+#include "latency_trace.h"
+#include "level_meter.h"
+#include "log_bindings.h"
+#include "memory_budget_bindings.h"
+#include "model_footprint.h"
+#include "opus_chunk_encoder.h"
+#include "power_state.h"
+#include "quality_governor.h"
+#include "realtime_memory.h"
+#include "render_session.h"
+#include "session_recorder.h"
+#include "rt_alloc_check.h"
+#include "spsc_byte_fifo.h"
+#include "stream_decoder.h"
+#include "subtitle_tracker_bindings.h"
+#include "swr_converter.h"
+#include "task_pool.h"
+#include "text_stabilizer_bindings.h"
+#include "thread_cpu_bindings.h"
+#include "thread_schedule.h"
+#include "translation_engine.h"
+#include "tts_audio_cache.h"
+#include "voice_boost.h"
+#include "whisper_backends.h"
+#include "whisper_engine.h"
+#include "whisper_stream.h"
+#include "process_name_cache.h"
+#include "process_tap.h"
+#include "screen_region_capture.h"
+#include "device_registry.h"
+#include "session_table.h"
+#include "shm_audio_ring.h"
+#include "soundboard_engine.h"
+#include "soundboard_output.h"
+
+AUDIO_CORE_RT_ALLOC_HOOKS()
+
 class CoreAudioLoopbackCapture;
 
 namespace {
-	std::unique_ptr<CoreAudioLoopbackCapture> g_capture;
-}
-
-// Signal processing structures (ported from WASAPI)
-struct BiquadHPF {
-	float b0=0, b1=0, b2=0, a1=0, a2=0;
-	float z1=0, z2=0;
-	void setup(float fs, float fc, float Q=0.7071f) {
-		const float PI = 3.14159265358979323846f;
-		float w0 = 2.0f * PI * (fc / fs);
-		float c  = cosf(w0);
-		float s  = sinf(w0);
-		float alpha = s / (2.0f * Q);
-		float a0 = 1.0f + alpha;
-		b0 =  (1.0f + c) * 0.5f / a0;
-		b1 = -(1.0f + c)       / a0;
-		b2 =  (1.0f + c) * 0.5f / a0;
-		a1 =  (-2.0f * c)       / a0;
-		a2 =  (1.0f - alpha)     / a0;
-		z1 = z2 = 0.0f;
-	}
-	inline float process(float x) {
-		float y = b0*x + z1;
-		z1 = b1*x + z2 - a1*y;
-		z2 = b2*x - a2*y;
-		return y;
+	// Per environment (addon_instance.h): the capture behind the module-level
+	// startCapture/stopCapture/getStats, and the soundboard outputs.
+	struct LoopbackAddon {
+		SoundboardOutput soundboardOutputs[kSoundboardBuses];
+		std::unique_ptr<CoreAudioLoopbackCapture> capture;
+	};
+}
+
+// Device changes the worker reconfigures for in place.
+enum : uint32_t {
+	kChangeDefaultOutput = 1 << 0,
+	kChangeSampleRate = 1 << 1,
+	kChangeStreamFormat = 1 << 2,
+};
+
+// Host time of the worker's position in the IO stream. The IO thread anchors
+// the running count of queued frames to each buffer's mHostTime under a
+// seqlock; the worker counts the frames it consumes and extrapolates from the
+// latest anchor. Format changes stop the IO side and Reset it.
+class IoClock {
+public:
+	// Before the IO callback (re)starts.
+	void Reset(double rate) {
+		rate_ = rate;
+		queued_ = 0;
+		consumed_ = 0;
+		anchorFrame_.store(0, std::memory_order_relaxed);
+		anchorNs_.store(0, std::memory_order_relaxed);
 	}
+
+	// IO thread, once the buffer is in the FIFO.
+	void Queued(const AudioTimeStamp* time, UInt32 frames) {
+		if (time && (time->mFlags & kAudioTimeStampHostTimeValid)) {
+			const uint32_t seq = seq_.load(std::memory_order_relaxed);
+			seq_.store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			anchorFrame_.store(queued_, std::memory_order_relaxed);
+			anchorNs_.store(AudioConvertHostTimeToNanos(time->mHostTime), std::memory_order_relaxed);
+			seq_.store(seq + 2, std::memory_order_release);
+		}
+		queued_ += frames;
+	}
+
+	// Worker: host time (ns) of the next `frames` it processes.
+	uint64_t Consume(UInt32 frames) {
+		uint64_t frame, ns;
+		for (;;) {
+			const uint32_t seq = seq_.load(std::memory_order_acquire);
+			if (seq & 1) continue;
+			frame = anchorFrame_.load(std::memory_order_relaxed);
+			ns = anchorNs_.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (seq_.load(std::memory_order_relaxed) == seq) break;
+		}
+		const double offset = ((double)consumed_ - (double)frame) * 1e9 / rate_;
+		consumed_ += frames;
+		return (uint64_t)std::max(0.0, (double)ns + offset);
+	}
+
+private:
+	double rate_ = 48000.0;
+	uint64_t queued_ = 0;   // IO thread
+	uint64_t consumed_ = 0; // worker
+	std::atomic<uint32_t> seq_{0};
+	std::atomic<uint64_t> anchorFrame_{0};
+	std::atomic<uint64_t> anchorNs_{0};
 };
 
 class CoreAudioLoopbackCapture {
 public:
 	CoreAudioLoopbackCapture() : running_(false), targetPid_(0), excludeCurrentPid_(false), 
 	                             audioUnit_(nullptr), aggregateDeviceId_(kAudioObjectUnknown),
-	                             usingTap_(false) {}
-	~CoreAudioLoopbackCapture() { Stop(); }
+	                             usingTap_(false) {
+		semaphore_create(mach_task_self(), &ioReady_, SYNC_POLICY_FIFO, 0);
+	}
+	~CoreAudioLoopbackCapture() {
+		Stop();
+		if (channel_) channel_->Unref();
+		semaphore_destroy(mach_task_self(), ioReady_);
+	}
 
-	bool Start(uint32_t pid, Napi::ThreadSafeFunction tsfn);
+	bool Start(uint32_t pid, PcmTsfn tsfn, const CaptureOptions& options);
 	void Stop();
+	uint64_t PacketCount() const { return packets_.load(std::memory_order_relaxed); }
+	uint64_t GlitchCount() const { return glitches_.load(std::memory_order_relaxed); }
+	uint64_t RealtimeAllocations() const { return RealtimeAllocationCount(); }
+	uint64_t IoOverruns() const { return ioOverruns_.load(std::memory_order_relaxed); }
+	bool Realtime() const { return realtime_.load(std::memory_order_relaxed); }
+	double ProcessingMs() const { return processingNs_.load(std::memory_order_relaxed) / 1e6; }
+	float FilterGraphLatencyMs() const { return filterGraphLatencyMs_.load(std::memory_order_relaxed); }
+	uint64_t FormatChanges() const { return formatChanges_.load(std::memory_order_relaxed); }
+	bool SelfExcluded() const { return selfExcluded_.load(std::memory_order_relaxed); }
+	bool IsEchoReference() const { return echoReference_.load(std::memory_order_relaxed); }
+	float EchoErleDb() const { return echoErleDb_.load(std::memory_order_relaxed); }
+	float EchoDriftPpm() const { return echoDriftPpm_.load(std::memory_order_relaxed); }
+	PcmDeliveryStats DeliveryStats() const { return channel_ ? channel_->Stats() : PcmDeliveryStats(); }
+	uint64_t InputFrames() const { return inputFrames_.load(std::memory_order_relaxed); }
+	uint64_t OutputSamples() const { return outputSamples_.load(std::memory_order_relaxed); }
+	uint32_t InputSampleRate() const { return inputRate_.load(std::memory_order_relaxed); }
+	uint32_t InputChannels() const { return inputChannels_.load(std::memory_order_relaxed); }
+	float DevicePeriodMs() const { return periodMs_.load(std::memory_order_relaxed); }
+	CaptureWatchdogStats Stalls() const { return watchdog_.Stats(); }
+	LatencySummary ConvertTiming() const { return convert_.Summary(); }
+	LatencySummary ChainTiming() const { return chain_.Summary(); }
+	LatencySummary DeliverTiming() const { return deliver_.Summary(); }
+	bool Governed() const { return options_.governor.enabled; }
+	QualityStats Quality() const { return governor_.Stats(); }
+	// Option 'record'; null without it.
+	const SessionRecorder* Recorder() const { return recorder_.get(); }
+	// 'tap', 'ioproc' or 'audio-unit' once the device side runs; '' otherwise.
+	const char* Backend() const { return backend_.load(std::memory_order_relaxed); }
+	void SetMinChunkMs(uint32_t ms) { if (channel_) channel_->SetMinChunkMs(ms); }
+	bool Running() const { return running_; }
+	// Armed captures (delivery_gate.h): beginDelivery() / endDelivery().
+	void SetDelivery(bool open) { gate_.Request(open); }
+	bool Delivering() const { return !gate_.Armed() || gate_.Requested(); }
+	// Option 'history' (capture_history.h); null without it.
+	std::shared_ptr<const CaptureHistory> History() const { return history_; }
+	// JS thread: moves a running capture to another process (loopback) or
+	// input device (microphone, endpointId a name needle) without resetting its
+	// back end. Returns once the worker has reopened the source.
+	bool SwitchSource(uint32_t pid, const std::string& endpointId);
+	uint64_t SourceSwitches() const { return sourceSwitches_.load(std::memory_order_relaxed); }
 
 private:
+	enum class SwitchRequest { None, Pending, Switched, Failed };
+
 	static OSStatus InputCallback(void *inRefCon,
 	                              AudioUnitRenderActionFlags *ioActionFlags,
 	                              const AudioTimeStamp *inTimeStamp,
@@ -69,15 +227,96 @@ private:
 	                              UInt32 inNumberFrames,
 	                              AudioBufferList *ioData);
 
-	void ProcessAudioBuffer(AudioBufferList *ioData, UInt32 inNumberFrames, pid_t sourcePid = 0);
+	void ProcessAudioBuffer(const void* data, UInt32 inNumberFrames, uint64_t timeNs);
+	// Worker thread: echo cancel, voice chain and delivery of 16 kHz samples.
+	void RunChain(float* samples, size_t count, uint64_t timeNs, StageClock* clock);
+	void ApplyQuality(bool raised, const char* reason);
+	void PollPower();
+	void DrainIoFifo();
+	// Worker thread, option 'idle': closes the source, sleeps until something
+	// plays, and opens it again. False when the capture is stopping or the
+	// source could not be reopened.
+	bool IdleUntilPlayback();
+	// HAL notification thread, or the session registry with its table locked:
+	// something started playing while the source is closed for option 'idle'.
+	static OSStatus PlaybackStarted(AudioObjectID object, UInt32 count, const AudioObjectPropertyAddress* addresses, void* context);
+	static void SessionStarted(void* context);
+	
+	static void TapInput(void* context, const AudioBufferList* input, const AudioTimeStamp* inputTime);
+	static OSStatus DeviceIOProc(AudioObjectID device, const AudioTimeStamp* now,
+	                             const AudioBufferList* inputData, const AudioTimeStamp* inputTime,
+	                             AudioBufferList* outputData, const AudioTimeStamp* outputTime, void* clientData);
+	bool PrepareProcessing(UInt32 maxFrames, uint32_t channelMask = 0);
+	bool ConfigureAudioUnitFormat();
+	bool ConfigureIoProcFormat();
+	
+	// HAL notification thread: flags a device change for the worker.
+	static OSStatus PropertyChanged(AudioObjectID object, UInt32 count, const AudioObjectPropertyAddress* addresses, void* context);
+	void SetPropertyListeners(bool add);
+	void Reconfigure(uint32_t changes);
+	bool RebuildStream();
+	void RecoverStall(StallStep step, uint64_t nowMs);
+	
+	bool OpenSource();
+	void CloseSource();
+	void SwitchSourceNow();
 	
 	bool CreateAggregateDeviceWithTap(AudioDeviceID defaultOutputDevice);
-	bool TryProcessTapApproach(AudioDeviceID defaultOutputDevice);
+	bool TryProcessTapApproach();
+	bool StartBlackHoleCapture();
+	bool StartMicrophoneCapture();
+	bool ReplayFile();
 	bool TryAudioUnitHALApproach(AudioDeviceID defaultOutputDevice);
+	bool TryIoProcApproach(AudioDeviceID device);
+	bool StartDeviceCapture(AudioDeviceID device);
+	void StopIoProc();
 	
 	std::thread capture_thread_;
 	std::atomic<bool> running_;
-	Napi::ThreadSafeFunction tsfn_;
+	PcmTsfn tsfn_;
+	PcmChannel* channel_ = nullptr; // tsfn_ context; we hold a ref so stats outlive the session
+	CaptureOptions options_;
+	PcmPacketWriter writer_;   // worker thread only while running
+	SubscriberFanout subscribers_; // likewise
+	DeliveryGate gate_;            // armed sessions: the stream waits in a pre-roll until delivery opens
+	std::shared_ptr<CaptureHistory> history_; // set in Start(); getHistory() queries share it
+	std::unique_ptr<SessionRecorder> recorder_; // option 'record'; set in Start()
+	std::atomic<uint64_t> packets_{0};
+	std::atomic<uint64_t> glitches_{0}; // render failures and sample-time gaps on the IO thread
+	Float64 nextSampleTime_ = -1.0;     // IO thread only
+	uint64_t ioCallbacks_ = 0;          // likewise
+	float debugPeak_ = 0.0f;            // worker thread: debug-level amplitude log
+	uint32_t debugSamples_ = 0;         // likewise
+	uint64_t glitchesReported_ = 0;     // worker thread: glitches_ already posted to JS
+	std::atomic<uint64_t> ioOverruns_{0}; // IO buffers dropped because the worker fell behind
+	std::atomic<bool> realtime_{false};   // time-constraint policy applied to the worker
+	std::atomic<uint64_t> processingNs_{0}; // worker time spent in ProcessAudioBuffer
+	std::atomic<float> filterGraphLatencyMs_{0.0f}; // option 'filterGraph' stage delay
+	std::atomic<uint32_t> pendingChanges_{0}; // kChange* bits set by PropertyChanged
+	std::atomic<uint64_t> formatChanges_{0};  // in-place reconfigurations
+	std::atomic<bool> selfExcluded_{false};   // a tap leaves out this app's process tree (excludeSelf)
+	std::atomic<bool> echoReference_{false};  // loopback publishing to SharedEchoReference()
+	std::atomic<float> echoErleDb_{0.0f};     // microphone with 'echoCancel'
+	std::atomic<float> echoDriftPpm_{0.0f};   // likewise: render clock against capture clock, compensated
+	std::atomic<uint64_t> inputFrames_{0};    // device frames the worker processed
+	std::atomic<uint64_t> outputSamples_{0};  // 16 kHz samples through the voice chain
+	std::atomic<uint32_t> inputRate_{0};      // inputFormat_, for getStats()
+	std::atomic<uint32_t> inputChannels_{0};
+	std::atomic<float> periodMs_{0.0f};       // device IO cycle
+	LatencyHistogram convert_; // worker, per buffer: downmix and resample
+	LatencyHistogram chain_;   // echo cancel and voice chain
+	LatencyHistogram deliver_; // quantize, VAD, chunker, queueing and subscribers
+	QualityGovernor governor_; // option 'governor'; stepped by the worker
+	bool powerWatched_ = false; // option 'power' holds the power watcher
+	uint64_t powerChanges_ = 0; // worker: SystemPowerState().Changes() applied
+	std::atomic<bool> playbackStarted_{false}; // option 'idle', set by PlaybackStarted()/SessionStarted()
+	CaptureWatchdog watchdog_; // worker (capture_watchdog.h)
+	std::mutex switchMutex_;   // switchPid_ and switchDevice_, handed to the worker
+	uint32_t switchPid_ = 0;
+	std::string switchDevice_;
+	std::atomic<SwitchRequest> switch_{SwitchRequest::None};
+	std::atomic<uint64_t> sourceSwitches_{0};
+	AudioDeviceID listenedDevice_ = kAudioObjectUnknown; // worker only
 	uint32_t targetPid_;
 	bool excludeCurrentPid_;  // When true, exclude current process PID from capture
 	pid_t currentPid_;         // Current process PID for filtering
@@ -85,20 +324,36 @@ private:
 	AudioDeviceID deviceId_;
 	AudioDeviceID aggregateDeviceId_;  // Aggregate device with tap (if using tap approach)
 	bool usingTap_;                    // True if using tap-based approach
+	ProcessTapCapture processTap_;
+	AudioDeviceIOProcID ioProc_ = nullptr; // option backend 'ioproc', on deviceId_
+	std::atomic<const char*> backend_{""};  // for getStats()
 	
 	// Signal processing state
-	BiquadHPF hpf_;
-	float env_;
-	float noiseFloor_;
-	float gainSmooth_;
-	float aEnv_, aRise_, aAtk_, aRel_;
+	EchoCanceller echo_;
+	VoiceChain voice_;
 	
 	// Audio format
 	AudioStreamBasicDescription inputFormat_;
 	AudioStreamBasicDescription outputFormat_;
 	
-	// Buffer for resampling
-	std::vector<float> resampleBuffer_;
+	// The IO callback renders into renderBuffer_ and copies it into ioFifo_; the
+	// worker (capture_thread_) reads workBuffer_-sized chunks and runs the DSP.
+	// All sized in TryAudioUnitHALApproach for maxFrames_ per slice.
+	UInt32 maxFrames_ = 0;
+	RealtimeVector<uint8_t> renderBuffer_;
+	SpscByteFifo ioFifo_;
+	IoClock ioClock_; // reset with ioFifo_
+	semaphore_t ioReady_ = 0;
+	RealtimeVector<uint8_t> workBuffer_;
+	RealtimeVector<float> monoBuffer_;
+	RealtimeVector<float> resampleBuffer_;
+	RealtimeVector<float> preGateBuffer_; // chain input at the gate, for the chunker's pre-roll
+	PolyphaseResampler resampler_;
+	PolyphaseResampler lightResampler_; // 'low' quality, while the governor asks for it
+	bool light_ = false;                // lightResampler_ is the one running
+	DownmixPlan downmix_;
+	DialogueFocus dialogue_; // option 'dialogue': runs downmix_, or extracts the stereo centre in its place
+	SwrConverter swr_; // replaces downmix_ + resampler_ when active
 };
 
 OSStatus CoreAudioLoopbackCapture::InputCallback(void *inRefCon,
@@ -111,26 +366,31 @@ OSStatus CoreAudioLoopbackCapture::InputCallback(void *inRefCon,
 	if (!capture || !capture->running_) {
 		return noErr;
 	}
+	RealtimeScope realtime;
+	
+	// A jump in sample time means the HAL dropped input between callbacks
+	if (inTimeStamp && (inTimeStamp->mFlags & kAudioTimeStampSampleTimeValid)) {
+		if (capture->nextSampleTime_ >= 0.0 && inTimeStamp->mSampleTime != capture->nextSampleTime_) {
+			capture->glitches_.fetch_add(1, std::memory_order_relaxed);
+		}
+		capture->nextSampleTime_ = inTimeStamp->mSampleTime + inNumberFrames;
+	}
 	
-	static int callbackCount = 0;
-	callbackCount++;
+	const uint64_t callbackCount = ++capture->ioCallbacks_;
 	if (callbackCount % 100 == 0) { // Log every 100th callback to avoid spam
-		printf("[addon] InputCallback called %d times, frames: %u\n", callbackCount, inNumberFrames);
-		fflush(stdout);
+		AddonLog(LogLevel::Debug, "InputCallback called %llu times, frames: %u", (unsigned long long)callbackCount, inNumberFrames);
 	}
 	
+	// Render into storage sized for kAudioUnitProperty_MaximumFramesPerSlice
+	if (inNumberFrames > capture->maxFrames_) {
+		capture->glitches_.fetch_add(1, std::memory_order_relaxed);
+		return kAudioUnitErr_TooManyFramesToProcess;
+	}
 	AudioBufferList bufferList;
 	bufferList.mNumberBuffers = 1;
 	bufferList.mBuffers[0].mNumberChannels = capture->inputFormat_.mChannelsPerFrame;
 	bufferList.mBuffers[0].mDataByteSize = inNumberFrames * capture->inputFormat_.mBytesPerFrame;
-	bufferList.mBuffers[0].mData = nullptr;
-	bufferList.mBuffers[0].mData = malloc(bufferList.mBuffers[0].mDataByteSize);
-	
-	if (!bufferList.mBuffers[0].mData) {
-		printf("[addon] ERROR: Failed to allocate buffer in InputCallback\n");
-		fflush(stdout);
-		return -1;
-	}
+	bufferList.mBuffers[0].mData = capture->renderBuffer_.data();
 	
 	OSStatus status = AudioUnitRender(capture->audioUnit_,
 	                                  ioActionFlags,
@@ -140,536 +400,753 @@ OSStatus CoreAudioLoopbackCapture::InputCallback(void *inRefCon,
 	                                  &bufferList);
 	
 	if (status == noErr) {
-		// Check if we're actually getting audio data
-		static int debugCount = 0;
-		static float maxSampleValue = 0.0f;
-		
-		if (bufferList.mBuffers[0].mDataByteSize >= 4) {
-			// Calculate RMS to detect actual audio
-			int16_t* samples = (int16_t*)bufferList.mBuffers[0].mData;
-			int numSamples = bufferList.mBuffers[0].mDataByteSize / 2;
-			
-			float sum = 0.0f;
-			for (int i = 0; i < numSamples; i++) {
-				float sample = samples[i] / 32768.0f;
-				sum += sample * sample;
-				float absSample = sample < 0 ? -sample : sample;
-				if (absSample > maxSampleValue) maxSampleValue = absSample;
-			}
-			float rms = sqrtf(sum / numSamples);
-			
-			if (debugCount++ % 50 == 0) {
-				printf("[addon] 🔊 Audio check: size=%u bytes, samples=%d, RMS=%.4f, max=%.4f %s\n", 
-				       bufferList.mBuffers[0].mDataByteSize, numSamples, rms, maxSampleValue,
-				       rms > 0.01f ? "✅ AUDIO DETECTED" : "⚠️ silence");
-				fflush(stdout);
-				maxSampleValue = 0.0f;
-			}
+		// Hand the raw frames to the worker; never block or process here
+		if (capture->ioFifo_.Write(bufferList.mBuffers[0].mData, bufferList.mBuffers[0].mDataByteSize)) {
+			capture->ioClock_.Queued(inTimeStamp, inNumberFrames);
+		} else {
+			capture->ioOverruns_.fetch_add(1, std::memory_order_relaxed);
 		}
-		
-		capture->ProcessAudioBuffer(&bufferList, inNumberFrames, 0);
+		capture->packets_.fetch_add(1, std::memory_order_relaxed);
+		semaphore_signal(capture->ioReady_);
 	} else {
+		capture->glitches_.fetch_add(1, std::memory_order_relaxed);
 		if (callbackCount <= 5) { // Log first few errors
-			printf("[addon] AudioUnitRender failed with status: %d\n", (int)status);
-			fflush(stdout);
+			AddonLog(LogLevel::Error, "AudioUnitRender failed with status: %d", (int)status);
 		}
 	}
 	
-	free(bufferList.mBuffers[0].mData);
 	return status;
 }
 
-void CoreAudioLoopbackCapture::ProcessAudioBuffer(AudioBufferList *ioData, UInt32 inNumberFrames, pid_t sourcePid) {
-	// Note: sourcePid is currently always 0 because AudioUnit HAL doesn't provide PID metadata
-	// In a full tap-based implementation, we would filter here: if (excludeCurrentPid_ && sourcePid == currentPid_) return;
-	(void)sourcePid; // Suppress unused parameter warning
-	
-	if (!ioData || ioData->mNumberBuffers == 0) return;
-	
-	const uint32_t outRate = 16000;
-	const uint32_t inRate = (uint32_t)inputFormat_.mSampleRate;
-	const uint16_t inCh = inputFormat_.mChannelsPerFrame;
-	
-	// 1) Convert to mono float [-1,1]
-	std::vector<float> mono;
-	mono.reserve(inNumberFrames);
+// Worker thread: consumes everything the IO callback has queued.
+void CoreAudioLoopbackCapture::DrainIoFifo() {
+	const size_t frameBytes = inputFormat_.mBytesPerFrame;
+	while (size_t n = ioFifo_.Read(workBuffer_.data(), workBuffer_.size())) {
+		const auto begin = std::chrono::steady_clock::now();
+		const UInt32 frames = (UInt32)(n / frameBytes);
+		ProcessAudioBuffer(workBuffer_.data(), frames, ioClock_.Consume(frames));
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+		processingNs_.fetch_add((uint64_t)ns, std::memory_order_relaxed);
+	}
+}
+
+// Worker thread. Note: AudioUnit HAL doesn't provide PID metadata, so there is no
+// per-buffer filtering here; a tap-based implementation would drop our own PID.
+void CoreAudioLoopbackCapture::ProcessAudioBuffer(const void* data, UInt32 inNumberFrames, uint64_t timeNs) {
+	if (inNumberFrames == 0) return;
+	// Input lost on the IO thread lands just before this buffer
+	const uint64_t glitches = glitches_.load(std::memory_order_relaxed);
+	if (glitches != glitchesReported_) {
+		glitchesReported_ = glitches;
+		NotifyDiscontinuity(tsfn_, channel_, writer_.NextIndex());
+	}
+	inputFrames_.fetch_add(inNumberFrames, std::memory_order_relaxed);
+	PlatformTraceMark(TraceMark::Packet, inNumberFrames);
+	const auto begin = std::chrono::steady_clock::now();
+	StageClock clock;
+	TraceInterval convertTrace(TraceStage::Convert, inNumberFrames);
+	
+	// 1) Convert to mono float [-1,1] (format conversion and channel weights in one pass)
+	// 2) Resample to 16k; the polyphase filter keeps its history across callbacks
+	float* resampled = resampleBuffer_.data();
+	size_t outLen;
+	if (swr_.Active()) {
+		outLen = swr_.Process(data, inNumberFrames, resampled, resampleBuffer_.size()); // both steps in one call
+	} else {
+		float* mono = monoBuffer_.data();
+		dialogue_.Run(downmix_, data, inNumberFrames, mono);
+		outLen = (light_ ? lightResampler_ : resampler_).Process(mono, inNumberFrames, resampled);
+	}
+	if (outLen == 0) return;
+	clock.Lap(&convert_);
+	convertTrace.End();
+	outputSamples_.fetch_add(outLen, std::memory_order_relaxed);
+	
+	// The far end for microphone captures
+	if (echoReference_.load(std::memory_order_relaxed)) SharedEchoReference().Write(resampled, outLen, timeNs);
+	// Armed: the stream only fills the pre-roll until JS opens delivery, which
+	// hands the pre-roll to the chain ahead of this buffer
+	if (gate_.Armed()) {
+		switch (gate_.Admit(resampled, outLen, writer_.Idle() && (!options_.feedSubscribers || subscribers_.Idle()))) {
+		case DeliveryGate::Step::Pass:
+			break;
+		case DeliveryGate::Step::Close:
+			writer_.Discard();
+			subscribers_.Discard();
+			return;
+		case DeliveryGate::Step::Hold:
+			return;
+		case DeliveryGate::Step::Open:
+			if (gate_.Opens() > 1) NotifyDiscontinuity(tsfn_, channel_, writer_.NextIndex());
+			if (gate_.PrerollSamples() > 0) RunChain(gate_.Preroll(), gate_.PrerollSamples(), gate_.PrerollNs(timeNs), &clock);
+			break;
+		}
+	}
+	RunChain(resampled, outLen, timeNs, &clock);
+
+	// 6) Trade quality for headroom when the block took too much of its own time
+	bool raised = false;
+	const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+	if (governor_.Update((uint64_t)ns, outLen, &raised)) ApplyQuality(raised, raised ? "load-low" : "load-high");
+	if (options_.power.enabled) PollPower();
+}
+
+void CoreAudioLoopbackCapture::RunChain(float* samples, size_t count, uint64_t timeNs, StageClock* clock) {
+	if (recorder_ && recorder_->Raw()) recorder_->Write(samples, count, 1.0f);
+	TraceInterval chainTrace(TraceStage::Chain, count);
+
+	// The far end's echo cancelled from a microphone
+	if (echo_.Enabled()) {
+		echo_.Process(samples, count, timeNs, SharedEchoReference());
+		echoErleDb_.store(echo_.ErleDb(), std::memory_order_relaxed);
+		echoDriftPpm_.store(echo_.DriftPpm(), std::memory_order_relaxed);
+	}
 	
 	// Track max amplitude for debugging
-	static float maxAmplitude = 0.0f;
-	static int sampleCount = 0;
-	
-	if (inputFormat_.mFormatFlags & kAudioFormatFlagIsFloat) {
-		const float* f = reinterpret_cast<const float*>(ioData->mBuffers[0].mData);
-		for (UInt32 i = 0; i < inNumberFrames; ++i) {
-			float sum = 0.0f;
-			for (uint16_t c = 0; c < inCh; ++c) {
-				sum += f[i * inCh + c];
-			}
-			float m = sum / (float)inCh;
-			if (m > 1.0f) m = 1.0f;
-			else if (m < -1.0f) m = -1.0f;
-			
-			// Track max amplitude
-			float absM = m < 0 ? -m : m;
-			if (absM > maxAmplitude) maxAmplitude = absM;
-			
-			mono.push_back(m);
+	if (AddonLogRing().Enabled(LogLevel::Debug)) {
+		for (size_t i = 0; i < count; ++i) {
+			float absM = samples[i] < 0 ? -samples[i] : samples[i];
+			if (absM > debugPeak_) debugPeak_ = absM;
 		}
-	} else {
-		// Assume 16-bit PCM
-		const int16_t* s = reinterpret_cast<const int16_t*>(ioData->mBuffers[0].mData);
-		for (UInt32 i = 0; i < inNumberFrames; ++i) {
-			int sum = 0;
-			for (uint16_t c = 0; c < inCh; ++c) {
-				sum += s[i * inCh + c];
-			}
-			float m = (float)sum / (float)inCh / 32768.0f;
-			if (m > 1.0f) m = 1.0f;
-			else if (m < -1.0f) m = -1.0f;
-			
-			// Track max amplitude
-			float absM = m < 0 ? -m : m;
-			if (absM > maxAmplitude) maxAmplitude = absM;
-			
-			mono.push_back(m);
+		
+		// Log amplitude periodically
+		debugSamples_ += (uint32_t)count;
+		if (debugSamples_ >= 16000) { // Every ~1 second at 16kHz
+			AddonLog(LogLevel::Debug, "Audio level check - max amplitude: %.4f %s", 
+			       debugPeak_, debugPeak_ > 0.01f ? "(AUDIO DETECTED)" : "(silence)");
+			debugPeak_ = 0.0f;
+			debugSamples_ = 0;
 		}
 	}
 	
-	// Log amplitude periodically
-	sampleCount += inNumberFrames;
-	if (sampleCount >= 16000) { // Every ~1 second at 16kHz
-		printf("[addon] Audio level check - max amplitude: %.4f %s\n", 
-		       maxAmplitude, maxAmplitude > 0.01f ? "(AUDIO DETECTED)" : "(silence)");
-		fflush(stdout);
-		maxAmplitude = 0.0f;
-		sampleCount = 0;
-	}
-	
-	// 2) Resample to 16k using linear interpolation
-	size_t outLen = (size_t)((double)mono.size() * (double)outRate / (double)inRate);
-	if (outLen == 0) outLen = 1;
-	std::vector<float> resampled(outLen);
-	for (size_t i = 0; i < outLen; ++i) {
-		double pos = (double)i * (double)inRate / (double)outRate;
-		size_t idx = (size_t)pos;
-		double frac = pos - (double)idx;
-		float a = mono[idx < mono.size() ? idx : (mono.size()-1)];
-		float b = mono[(idx+1) < mono.size() ? (idx+1) : (mono.size()-1)];
-		resampled[i] = (float)((1.0 - frac) * a + frac * b);
-	}
-	
-	// 3) Lightweight noise suppression: high-pass + adaptive noise gate
-	for (size_t i = 0; i < resampled.size(); ++i) {
-		float x = resampled[i];
-		// High-pass to remove steady LF rumble (wind/fans)
-		x = hpf_.process(x);
-		// Envelope follower
-		float av = x < 0 ? -x : x;
-		env_ = aEnv_ * env_ + (1.0f - aEnv_) * av;
-		// Update noise floor: fast for drops, slow for rises
-		if (env_ < noiseFloor_) noiseFloor_ = env_;
-		else noiseFloor_ = noiseFloor_ + (env_ - noiseFloor_) * (1.0f - aRise_);
-		if (noiseFloor_ < 1e-6f) noiseFloor_ = 1e-6f;
-		// Dynamic threshold and soft-knee gate
-		float thr = noiseFloor_ * 2.5f + 1e-6f;
-		float tGain = (env_ > thr) ? 1.0f : (env_ / thr);
-		// Soft knee shaping
-		tGain = sqrtf(tGain);
-		// Smooth gain changes (fast attack when attenuating, slower release)
-		float a = (tGain < gainSmooth_) ? aAtk_ : aRel_;
-		gainSmooth_ = tGain + (gainSmooth_ - tGain) * a;
-		// Apply gain
-		resampled[i] = x * gainSmooth_;
-	}
-	
-	// 4) Mild voice boost with limiter
-	float peak = 0.0f;
-	for (float v : resampled) {
-		float av2 = v < 0 ? -v : v;
-		if (av2 > peak) peak = av2;
-	}
-	const float kVoiceBoost = 1.5f;
-	float gain;
-	if (peak < 1e-6f) gain = kVoiceBoost;
-	else gain = (peak * kVoiceBoost > 0.99f) ? (0.99f / peak) : kVoiceBoost;
-	
-	// 5) Quantize to int16
-	std::vector<int16_t> int16Samples;
-	int16Samples.resize(resampled.size());
-	for (size_t i = 0; i < resampled.size(); ++i) {
-		float x = resampled[i] * gain;
-		if (x > 1.0f) x = 1.0f;
-		else if (x < -1.0f) x = -1.0f;
-		int s = (int)(x * 32767.0f + (x >= 0 ? 0.5f : -0.5f));
-		if (s > 32767) s = 32767;
-		if (s < -32768) s = -32768;
-		int16Samples[i] = (int16_t)s;
-	}
-	
-	// 6) Build WAV header for 16kHz, mono, 16-bit PCM
-	const uint16_t channels = 1;
-	const uint32_t sampleRate = outRate;
-	const uint32_t pcmDataSize = (uint32_t)(int16Samples.size() * sizeof(int16_t));
-	const uint32_t totalSize = 36 + pcmDataSize;
-	std::vector<uint8_t> wavBuffer(44 + pcmDataSize);
-	uint8_t* header = wavBuffer.data();
-	memcpy(header + 0, "RIFF", 4);
-	*reinterpret_cast<uint32_t*>(header + 4) = totalSize;
-	memcpy(header + 8, "WAVE", 4);
-	memcpy(header + 12, "fmt ", 4);
-	*reinterpret_cast<uint32_t*>(header + 16) = 16; // fmt chunk size
-	*reinterpret_cast<uint16_t*>(header + 20) = 1;  // PCM format
-	*reinterpret_cast<uint16_t*>(header + 22) = channels;
-	*reinterpret_cast<uint32_t*>(header + 24) = sampleRate;
-	*reinterpret_cast<uint32_t*>(header + 28) = sampleRate * channels * 2; // byte rate
-	*reinterpret_cast<uint16_t*>(header + 32) = channels * 2; // block align
-	*reinterpret_cast<uint16_t*>(header + 34) = 16; // bits per sample
-	memcpy(header + 36, "data", 4);
-	*reinterpret_cast<uint32_t*>(header + 40) = pcmDataSize;
-	memcpy(header + 44, int16Samples.data(), pcmDataSize);
-	
-	// Send WAV buffer to callback
-	tsfn_.BlockingCall([wavBuffer](Napi::Env env, Napi::Function cb) {
-		auto buffer = Napi::Buffer<uint8_t>::Copy(env, wavBuffer.data(), wavBuffer.size());
-		cb.Call({ buffer });
-	});
+	// 3) Lightweight noise suppression and 4) mild voice boost with limiter, or
+	// loudness normalization with a lookahead limiter when option 'loudness' is set
+	float* preGate = preGateBuffer_.empty() ? nullptr : preGateBuffer_.data();
+	const float gain = voice_.Process(samples, count, preGate);
+	filterGraphLatencyMs_.store(voice_.FilterGraphLatencyMs(), std::memory_order_relaxed);
+	clock->Lap(&chain_);
+	chainTrace.End();
+	
+	// 5) Quantize to int16 into pooled WAV slots and queue them for JS without
+	// blocking; with frameMs set the writer carries partial frames across chunks
+	TraceInterval deliverTrace(TraceStage::Deliver, count);
+	bool slotGrew = false;
+	writer_.Write(tsfn_, samples, count, timeNs, gain, &slotGrew, voice_.PreGateTapped() ? preGate : nullptr);
+	if (options_.feedSubscribers) subscribers_.Write(samples, count, timeNs, gain, &slotGrew);
+	if (history_) history_->Write(samples, count, timeNs, gain);
+	if (recorder_ && !recorder_->Raw()) recorder_->Write(samples, count, gain);
+	clock->Lap(&deliver_);
+}
+
+// Worker thread, after a governor step: the stages follow its new level
+// between two buffers.
+void CoreAudioLoopbackCapture::ApplyQuality(bool raised, const char* reason) {
+	const QualityLevel level = governor_.Level();
+	const bool light = level >= QualityLevel::LightResampler && options_.resampler != ResamplerQuality::Low;
+	if (light != light_) {
+		if (light) lightResampler_.Continue(resampler_);
+		else resampler_.Continue(lightResampler_);
+		light_ = light;
+	}
+	voice_.SuspendDenoise(level >= QualityLevel::NoDenoise);
+	writer_.SetFeatureStride(level >= QualityLevel::SparseFeatures ? 2 : 1);
+	AddonLog(LogLevel::Info, "Quality %s: %s (DSP load %.0f%% of real time)", raised ? "raised" : "lowered",
+	         QualityLevelName(level), governor_.Load() * 100.0f);
+	NotifyQualityChange(tsfn_, channel_, QualityLevelName(level), reason, governor_.Load(), writer_.NextIndex());
+}
+
+// Worker thread, option 'power': the quality floor and wakeup throttle of the
+// profile for a new power source (the HAL has no latency mode to follow).
+void CoreAudioLoopbackCapture::PollPower() {
+	const PowerState& power = SystemPowerState();
+	const uint64_t changes = power.Changes();
+	if (changes == powerChanges_) return;
+	powerChanges_ = changes;
+	const PowerSource source = power.Source();
+	const PowerProfile& profile = options_.power.For(source);
+	AddonLog(LogLevel::Info, "Power source %s: quality at most %s, JS wakeups every %u ms", PowerSourceName(source),
+	         QualityLevelName(profile.quality), profile.throttleMs);
+	NotifyPowerChange(tsfn_, channel_, PowerSourceName(source), QualityLevelName(profile.quality), profile.throttleMs,
+	                  LatencyModeName(profile.latency), writer_.NextIndex());
+	bool raised = false;
+	if (governor_.SetFloor(profile.quality, &raised)) ApplyQuality(raised, "power");
+}
+
+// Picks the downmix kernel for an interleaved linear PCM stream format.
+// 24-bit samples in 4-byte containers must be high-aligned to read as int32.
+// channelMask holds WAVE speaker bits when the source knows them (a file).
+bool DownmixPlanForFormat(const AudioStreamBasicDescription& asbd, DownmixPlan* plan, uint32_t channelMask = 0) {
+	if (asbd.mFormatID != kAudioFormatLinearPCM || asbd.mChannelsPerFrame == 0) return false;
+	const UInt32 container = asbd.mBytesPerFrame / asbd.mChannelsPerFrame;
+	PcmSampleType type;
+	if (asbd.mFormatFlags & kAudioFormatFlagIsFloat) {
+		if (asbd.mBitsPerChannel != 32) return false;
+		type = PcmSampleType::Float32;
+	} else if (asbd.mBitsPerChannel == 16 && container == 2) {
+		type = PcmSampleType::Int16;
+	} else if (asbd.mBitsPerChannel == 24 && container == 3) {
+		type = PcmSampleType::Int24Packed;
+	} else if (asbd.mBitsPerChannel == 24 && container == 4 && (asbd.mFormatFlags & kAudioFormatFlagIsAlignedHigh)) {
+		type = PcmSampleType::Int24In32;
+	} else if (asbd.mBitsPerChannel == 32 && container == 4) {
+		type = PcmSampleType::Int32;
+	} else {
+		return false;
+	}
+	*plan = MakeDownmixPlan(type, (uint16_t)asbd.mChannelsPerFrame, channelMask);
+	return true;
 }
 
 // Find BlackHole 2ch INPUT device (for capturing audio routed to BlackHole)
 AudioDeviceID FindBlackHoleInputDevice() {
-	AudioDeviceID deviceId = kAudioDeviceUnknown;
-	
-	// Get all devices
-	UInt32 propertySize = 0;
-	AudioObjectPropertyAddress propertyAddress = {
-		kAudioHardwarePropertyDevices,
-		kAudioObjectPropertyScopeGlobal,
-		kAudioObjectPropertyElementMain
-	};
-	
-	OSStatus status = AudioObjectGetPropertyDataSize(kAudioObjectSystemObject,
-	                                                  &propertyAddress,
-	                                                  0,
-	                                                  nullptr,
-	                                                  &propertySize);
-	if (status != noErr) {
-		printf("[addon] Failed to get device list size\n");
+	AudioDeviceInfo device;
+	if (!DeviceRegistry::Instance().FindByName({ "blackhole", "2ch" }, kAudioObjectPropertyScopeInput, &device)) {
 		return kAudioDeviceUnknown;
 	}
-	
-	UInt32 deviceCount = propertySize / sizeof(AudioDeviceID);
-	std::vector<AudioDeviceID> devices(deviceCount);
-	
-	status = AudioObjectGetPropertyData(kAudioObjectSystemObject,
-	                                    &propertyAddress,
-	                                    0,
-	                                    nullptr,
-	                                    &propertySize,
-	                                    devices.data());
-	if (status != noErr) {
-		printf("[addon] Failed to get device list\n");
+	AddonLog(LogLevel::Info, "Found BlackHole 2ch INPUT device (ID: %u)", device.id);
+	return device.id;
+}
+
+// Find BlackHole 2ch output device (for routing TTS audio to it)
+AudioDeviceID FindBlackHoleOutputDevice() {
+	AudioDeviceInfo device;
+	if (!DeviceRegistry::Instance().FindByName({ "blackhole", "2ch" }, kAudioObjectPropertyScopeOutput, &device)) {
 		return kAudioDeviceUnknown;
 	}
-	
-	// Search for BlackHole 2ch INPUT device
-	for (UInt32 i = 0; i < deviceCount; ++i) {
-		CFStringRef deviceName = nullptr;
-		propertySize = sizeof(CFStringRef);
-		propertyAddress.mSelector = kAudioDevicePropertyDeviceNameCFString;
-		propertyAddress.mScope = kAudioObjectPropertyScopeInput;
-		propertyAddress.mElement = kAudioObjectPropertyElementMain;
-		
-		status = AudioObjectGetPropertyData(devices[i],
-		                                    &propertyAddress,
-		                                    0,
-		                                    nullptr,
-		                                    &propertySize,
-		                                    &deviceName);
-		if (status == noErr && deviceName) {
-			char nameBuffer[256];
-			if (CFStringGetCString(deviceName, nameBuffer, sizeof(nameBuffer), kCFStringEncodingUTF8)) {
-				std::string name(nameBuffer);
-				std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-				// Look for BlackHole 2ch input device
-				if (name.find("blackhole") != std::string::npos && name.find("2ch") != std::string::npos) {
-					// Check if this device has INPUT channels
-					propertySize = 0;
-					propertyAddress.mSelector = kAudioDevicePropertyStreamConfiguration;
-					propertyAddress.mScope = kAudioObjectPropertyScopeInput;
-					status = AudioObjectGetPropertyDataSize(devices[i],
-					                                        &propertyAddress,
-					                                        0,
-					                                        nullptr,
-					                                        &propertySize);
-					if (status == noErr && propertySize > 0) {
-						printf("[addon] Found BlackHole 2ch INPUT device (ID: %u)\n", devices[i]);
-						deviceId = devices[i];
-						CFRelease(deviceName);
-						break;
-					}
-				}
-			}
-			CFRelease(deviceName);
-		}
+	AddonLog(LogLevel::Info, "Found BlackHole 2ch OUTPUT device (ID: %u)", device.id);
+	return device.id;
+}
+
+// Find default output device for loopback capture (like WASAPI on Windows)
+// This captures system audio from the default output device without changing it
+AudioDeviceID FindDefaultOutputDevice() {
+	DeviceRegistry& registry = DeviceRegistry::Instance();
+	AudioDeviceID deviceId = registry.DefaultOutput();
+	AudioDeviceInfo device;
+	if (deviceId == kAudioDeviceUnknown || !registry.FindById(deviceId, &device)) {
+		AddonLog(LogLevel::Error, "Failed to get default output device");
+		return kAudioDeviceUnknown;
 	}
-	
+	// It should have output channels, since it's the default output
+	if (device.outputChannels == 0) {
+		AddonLog(LogLevel::Info, "Default output device has no output channels");
+		return kAudioDeviceUnknown;
+	}
+	AddonLog(LogLevel::Info, "Found default output device: %s", device.name.c_str());
 	return deviceId;
 }
 
-// Find BlackHole 2ch output device (for routing TTS audio to it)
-AudioDeviceID FindBlackHoleOutputDevice() {
-	AudioDeviceID deviceId = kAudioDeviceUnknown;
-	
-	// Get all devices
-	UInt32 propertySize = 0;
-	AudioObjectPropertyAddress propertyAddress = {
-		kAudioHardwarePropertyDevices,
+// Wake-up period of the device's IO cycle, for the worker's time-constraint policy.
+double DeviceBufferPeriodMs(AudioDeviceID deviceId, Float64 sampleRate) {
+	UInt32 frames = 0;
+	UInt32 size = sizeof(frames);
+	AudioObjectPropertyAddress address = {
+		kAudioDevicePropertyBufferFrameSize,
 		kAudioObjectPropertyScopeGlobal,
 		kAudioObjectPropertyElementMain
 	};
-	
-	OSStatus status = AudioObjectGetPropertyDataSize(kAudioObjectSystemObject,
-	                                                  &propertyAddress,
-	                                                  0,
-	                                                  nullptr,
-	                                                  &propertySize);
-	if (status != noErr) {
-		printf("[addon] Failed to get device list size\n");
-		return kAudioDeviceUnknown;
+	if (AudioObjectGetPropertyData(deviceId, &address, 0, nullptr, &size, &frames) != noErr || frames == 0 || sampleRate <= 0) {
+		return 10.0;
+	}
+	return 1000.0 * frames / sampleRate;
+}
+
+namespace {
+	const AudioObjectPropertyAddress kRunningSomewhereAddress = {
+		kAudioDevicePropertyDeviceIsRunningSomewhere, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain
+	};
+	// Option 'idle': how often an open source asks the session table whether anything plays.
+	const uint64_t kIdleCheckMs = 1000;
+}
+
+OSStatus CoreAudioLoopbackCapture::PlaybackStarted(AudioObjectID object, UInt32, const AudioObjectPropertyAddress*, void* context) {
+	UInt32 running = 0;
+	UInt32 size = sizeof(running);
+	if (AudioObjectGetPropertyData(object, &kRunningSomewhereAddress, 0, nullptr, &size, &running) == noErr && running) {
+		SessionStarted(context);
+	}
+	return noErr;
+}
+
+void CoreAudioLoopbackCapture::SessionStarted(void* context) {
+	CoreAudioLoopbackCapture* capture = static_cast<CoreAudioLoopbackCapture*>(context);
+	capture->playbackStarted_.store(true, std::memory_order_release);
+	semaphore_signal(capture->ioReady_);
+}
+
+// With the source closed nothing of ours keeps the output device running, so
+// its IsRunningSomewhere going up is another app starting to play; the
+// session table's wakeup covers processes playing to other devices. What
+// plays before the source is open again is not captured.
+bool CoreAudioLoopbackCapture::IdleUntilPlayback() {
+	const auto now = [] {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	};
+	AddonLog(LogLevel::Info, "Nothing played for %u ms; capture source closed until a session starts", options_.idle.afterMs);
+	SetPropertyListeners(false);
+	CloseSource();
+	DrainIoFifo();
+	nextSampleTime_ = -1.0;
+	const uint64_t closedMs = now();
+	NotifyIdle(tsfn_, channel_, true, 0, writer_.NextIndex());
+
+	playbackStarted_.store(false, std::memory_order_relaxed);
+	const AudioDeviceID output = FindDefaultOutputDevice();
+	const bool listening = output != kAudioDeviceUnknown &&
+		AudioObjectAddPropertyListener(output, &kRunningSomewhereAddress, PlaybackStarted, this) == noErr;
+	// A switchSource() request reopens the source too; the worker loop then switches it
+	while (running_ && !playbackStarted_.exchange(false, std::memory_order_acq_rel) &&
+	       switch_.load(std::memory_order_acquire) != SwitchRequest::Pending && !AudioSessionTable().AnyActive()) {
+		semaphore_wait(ioReady_);
+	}
+	if (listening) AudioObjectRemovePropertyListener(output, &kRunningSomewhereAddress, PlaybackStarted, this);
+	if (!running_) return false;
+
+	const uint64_t idleMs = now() - closedMs;
+	AddonLog(LogLevel::Info, "Session activity after %llu ms idle; reopening the capture source", (unsigned long long)idleMs);
+	NotifyIdle(tsfn_, channel_, false, idleMs, writer_.NextIndex());
+	if (!OpenSource()) {
+		AddonLog(LogLevel::Error, "Failed to reopen the capture source after an idle release; stopping");
+		running_ = false;
+		return false;
+	}
+	SetPropertyListeners(true);
+	glitches_.fetch_add(1, std::memory_order_relaxed);
+	NotifyInputFormatChange(tsfn_, channel_, (uint32_t)inputFormat_.mSampleRate, inputFormat_.mChannelsPerFrame, "idle");
+	NotifyDiscontinuity(tsfn_, channel_, writer_.NextIndex());
+	return true;
+}
+
+// BlackHole path: the user routes system output through a Multi-Output device
+// that includes BlackHole, and we capture BlackHole's input side.
+bool CoreAudioLoopbackCapture::StartBlackHoleCapture() {
+	// Find BlackHole INPUT device (this is what we capture from)
+	AudioDeviceID blackHoleInput = FindBlackHoleInputDevice();
+	if (blackHoleInput == kAudioDeviceUnknown) {
+		AddonLog(LogLevel::Error, "❌ ERROR: BlackHole 2ch INPUT device not found");
+		AddonLog(LogLevel::Error, "   Please install BlackHole from: https://existential.audio/blackhole/");
+		return false;
 	}
 	
-	UInt32 deviceCount = propertySize / sizeof(AudioDeviceID);
-	std::vector<AudioDeviceID> devices(deviceCount);
+	AddonLog(LogLevel::Info, "✅ BlackHole 2ch INPUT device found (ID: %u)", blackHoleInput);
 	
-	status = AudioObjectGetPropertyData(kAudioObjectSystemObject,
-	                                    &propertyAddress,
-	                                    0,
-	                                    nullptr,
-	                                    &propertySize,
-	                                    devices.data());
-	if (status != noErr) {
-		printf("[addon] Failed to get device list\n");
-		return kAudioDeviceUnknown;
+	// Also find BlackHole OUTPUT device (for TTS routing info)
+	AudioDeviceID blackHoleOutput = FindBlackHoleOutputDevice();
+	if (blackHoleOutput != kAudioDeviceUnknown) {
+		AddonLog(LogLevel::Info, "✅ BlackHole 2ch OUTPUT device found (ID: %u) - use this for TTS", blackHoleOutput);
 	}
 	
-	// Search for BlackHole 2ch output device
-	for (UInt32 i = 0; i < deviceCount; ++i) {
-		CFStringRef deviceName = nullptr;
-		propertySize = sizeof(CFStringRef);
-		propertyAddress.mSelector = kAudioDevicePropertyDeviceNameCFString;
-		propertyAddress.mScope = kAudioObjectPropertyScopeOutput;
-		propertyAddress.mElement = kAudioObjectPropertyElementMain;
-		
-		status = AudioObjectGetPropertyData(devices[i],
-		                                    &propertyAddress,
-		                                    0,
-		                                    nullptr,
-		                                    &propertySize,
-		                                    &deviceName);
-		if (status == noErr && deviceName) {
-			char nameBuffer[256];
-			if (CFStringGetCString(deviceName, nameBuffer, sizeof(nameBuffer), kCFStringEncodingUTF8)) {
-				std::string name(nameBuffer);
-				std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-				// Look for BlackHole 2ch output device
-				if (name.find("blackhole") != std::string::npos && name.find("2ch") != std::string::npos) {
-					// Check if this device has output channels
-					propertySize = 0;
-					propertyAddress.mSelector = kAudioDevicePropertyStreamConfiguration;
-					propertyAddress.mScope = kAudioObjectPropertyScopeOutput;
-					status = AudioObjectGetPropertyDataSize(devices[i],
-					                                        &propertyAddress,
-					                                        0,
-					                                        nullptr,
-					                                        &propertySize);
-					if (status == noErr && propertySize > 0) {
-						printf("[addon] Found BlackHole 2ch OUTPUT device (ID: %u)\n", devices[i]);
-						deviceId = devices[i];
-						CFRelease(deviceName);
-						break;
-					}
-				}
-			}
-			CFRelease(deviceName);
+	// Get default output device info
+	AudioDeviceInfo defaultOutput;
+	if (DeviceRegistry::Instance().FindById(FindDefaultOutputDevice(), &defaultOutput)) {
+		AddonLog(LogLevel::Info, "Default output device: %s (ID: %u)", defaultOutput.name.c_str(), defaultOutput.id);
+		if (defaultOutput.NameContains("multi") || defaultOutput.NameContains("aggregate")) {
+			AddonLog(LogLevel::Info, "✅ Multi-Output device detected");
 		}
 	}
 	
-	return deviceId;
+	// CAPTURE FROM BLACKHOLE INPUT DEVICE
+	// Setup: Multi-Output Device (BlackHole + Real Speakers) as system default
+	// System audio → Multi-Output → Goes to BOTH BlackHole OUTPUT and Speakers
+	// BlackHole OUTPUT → BlackHole INPUT (loopback)
+	// We capture from BlackHole INPUT to get system audio
+	// Whispra TTS → Goes directly to Real Speakers (not BlackHole, avoids feedback)
+	deviceId_ = blackHoleInput;
+	AddonLog(LogLevel::Info, "📡 Capturing from BlackHole 2ch INPUT device (ID: %u)", blackHoleInput);
+	AddonLog(LogLevel::Info, "ℹ️  System audio routed through Multi-Output will be captured");
+	AddonLog(LogLevel::Info, "ℹ️  Whispra TTS should output to Real Speakers to avoid feedback");
+	
+	if (!StartDeviceCapture(deviceId_)) {
+		AddonLog(LogLevel::Error, "❌ ERROR: Failed to start capture from BlackHole INPUT");
+		return false;
+	}
+	return true;
 }
 
-// Find default output device for loopback capture (like WASAPI on Windows)
-// This captures system audio from the default output device without changing it
-AudioDeviceID FindDefaultOutputDevice() {
-	AudioDeviceID deviceId = kAudioDeviceUnknown;
-	UInt32 propertySize = sizeof(AudioDeviceID);
-	AudioObjectPropertyAddress propertyAddress = {
-		kAudioHardwarePropertyDefaultOutputDevice,
-		kAudioObjectPropertyScopeGlobal,
-		kAudioObjectPropertyElementMain
-	};
-	
-	OSStatus status = AudioObjectGetPropertyData(kAudioObjectSystemObject,
-	                                            &propertyAddress,
-	                                            0,
-	                                            nullptr,
-	                                            &propertySize,
-	                                            &deviceId);
-	if (status != noErr) {
-		printf("[addon] Failed to get default output device\n");
-		return kAudioDeviceUnknown;
+// Option source 'microphone': the default input device, or the first input
+// whose name contains options_.inputDevice, through the same HAL backend and
+// worker as BlackHole.
+bool CoreAudioLoopbackCapture::StartMicrophoneCapture() {
+	DeviceRegistry& registry = DeviceRegistry::Instance();
+	AudioDeviceInfo device;
+	const bool found = options_.inputDevice.empty()
+		? registry.FindById(registry.DefaultInput(), &device)
+		: registry.FindByName({ options_.inputDevice.c_str() }, kAudioObjectPropertyScopeInput, &device);
+	if (!found || device.inputChannels == 0) {
+		AddonLog(LogLevel::Error, "No input device for '%s'", options_.inputDevice.empty() ? "default" : options_.inputDevice.c_str());
+		return false;
 	}
-	
-	// Verify the device has output channels (it should, since it's the default output)
-	propertySize = 0;
-	propertyAddress.mSelector = kAudioDevicePropertyStreamConfiguration;
-	propertyAddress.mScope = kAudioObjectPropertyScopeOutput;
-	status = AudioObjectGetPropertyDataSize(deviceId,
-	                                        &propertyAddress,
-	                                        0,
-	                                        nullptr,
-	                                        &propertySize);
-	if (status == noErr && propertySize > 0) {
-		// Get device name for logging
-		CFStringRef deviceName = nullptr;
-		propertySize = sizeof(CFStringRef);
-		propertyAddress.mSelector = kAudioDevicePropertyDeviceNameCFString;
-		propertyAddress.mScope = kAudioObjectPropertyScopeOutput;
-		propertyAddress.mElement = kAudioObjectPropertyElementMain;
-		status = AudioObjectGetPropertyData(deviceId,
-		                                    &propertyAddress,
-		                                    0,
-		                                    nullptr,
-		                                    &propertySize,
-		                                    &deviceName);
-		if (status == noErr && deviceName) {
-			char nameBuffer[256];
-			if (CFStringGetCString(deviceName, nameBuffer, sizeof(nameBuffer), kCFStringEncodingUTF8)) {
-				printf("[addon] Found default output device: %s\n", nameBuffer);
+	AddonLog(LogLevel::Info, "Capturing microphone: %s (ID: %u)", device.name.c_str(), device.id);
+	return StartDeviceCapture(device.id);
+}
+
+// Option source 'file': the worker decodes and paces the file itself and hands
+// each 10 ms block to ProcessAudioBuffer as if the IO callback had queued it,
+// timed on the host clock from the start. Pace 'fast' only waits while JS is
+// backlogged, so no packet is lost to overflow. kReplayTailMs of silence
+// follows the file to flush the chain. True when the file ran out rather than
+// the capture being stopped.
+bool CoreAudioLoopbackCapture::ReplayFile() {
+	FileReplaySource source;
+	std::string error;
+	if (!source.Open(options_.file, &error)) {
+		AddonLog(LogLevel::Error, "File replay: %s", error.c_str());
+		return false;
+	}
+	const size_t blockFrames = source.BlockFrames();
+	memset(&inputFormat_, 0, sizeof(inputFormat_));
+	inputFormat_.mSampleRate = source.SampleRate();
+	inputFormat_.mFormatID = kAudioFormatLinearPCM;
+	inputFormat_.mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked;
+	inputFormat_.mBitsPerChannel = 32;
+	inputFormat_.mChannelsPerFrame = source.Channels();
+	inputFormat_.mFramesPerPacket = 1;
+	inputFormat_.mBytesPerFrame = inputFormat_.mBytesPerPacket = 4 * source.Channels();
+	if (!PrepareProcessing((UInt32)blockFrames, source.ChannelMask())) return false;
+	RealtimeVector<float> block(blockFrames * source.Channels());
+	AddonLog(LogLevel::Info, "Replaying %s: %u Hz, %u channels, %s downmix, dialogue %s, %s pace", options_.file.c_str(),
+	         source.SampleRate(), (unsigned)source.Channels(), downmix_.kernelName, DialogueFocus::ModeName(dialogue_.Current()),
+	         options_.pace == ReplayPace::Fast ? "fast" : "realtime");
+	ThreadScheduleState schedule;
+	periodMs_ = 10.0f;
+	if (options_.pace == ReplayPace::Realtime && ApplyThreadSchedule(options_.schedule, options_.priority, 10.0, &schedule)) {
+		realtime_ = true;
+	}
+
+	ReplayPacer pacer;
+	pacer.Start(source.SampleRate(), options_.pace, DeviceClockNs());
+	const uint64_t tailFrames = (uint64_t)source.SampleRate() * kReplayTailMs / 1000;
+	uint64_t frames = 0;  // replayed, tail included
+	uint64_t fileEnd = 0; // frames when the file ran out
+	bool fileDone = false;
+	bool ended = false;
+	while (running_) {
+		if (const uint32_t ms = pacer.WaitMs(frames)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(std::min(ms, 100u)));
+			continue;
+		}
+		if (options_.pace == ReplayPace::Fast && channel_->Backlogged()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		size_t n = fileDone ? 0 : source.Read(block.data());
+		if (n == 0 && !fileDone) {
+			fileDone = true;
+			fileEnd = frames;
+			AddonLog(LogLevel::Info, "File replay reached the end after %.1f s", (double)frames / source.SampleRate());
+		}
+		if (n == 0) {
+			if (frames - fileEnd >= tailFrames) {
+				ended = true;
+				break;
 			}
-			CFRelease(deviceName);
+			n = blockFrames;
+			std::fill(block.begin(), block.end(), 0.0f);
 		}
-		return deviceId;
-	}
-	
-	printf("[addon] Default output device has no output channels\n");
-	return kAudioDeviceUnknown;
+		const auto begin = std::chrono::steady_clock::now();
+		packets_.fetch_add(1, std::memory_order_relaxed);
+		ProcessAudioBuffer(block.data(), (UInt32)n, pacer.TimeNs(frames));
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+		processingNs_.fetch_add((uint64_t)ns, std::memory_order_relaxed);
+		frames += n;
+	}
+	RevertThreadSchedule(&schedule);
+	return ended;
 }
 
-bool CoreAudioLoopbackCapture::Start(uint32_t pid, Napi::ThreadSafeFunction tsfn) {
+bool CoreAudioLoopbackCapture::Start(uint32_t pid, PcmTsfn tsfn, const CaptureOptions& options) {
 	if (running_) {
-		printf("[addon] Capture already running\n");
+		AddonLog(LogLevel::Info, "Capture already running");
 		return false;
 	}
+	if (capture_thread_.joinable()) capture_thread_.join(); // a previous run whose setup failed
 	
 	running_ = true;
+	backend_ = "";
 	tsfn_ = tsfn;
+	if (channel_) channel_->Unref();
+	channel_ = tsfn_.GetContext();
+	channel_->AddRef();
+	// An armed capture opens by running its pre-roll through as one block
+	gate_.Configure(options.arm, 16000);
+	const size_t maxBlock = std::max<size_t>(4096, gate_.Armed() ? (size_t)options.arm.prerollMs * 16 : 0);
+	writer_.Configure(channel_, options.PacketSamples(16000), maxBlock, options.feedSubscribers); // levels follow the default capture
+	subscribers_.Configure(16000, options.resampler, maxBlock);
+	history_.reset();
+	if (options.history.enabled) {
+		history_ = std::make_shared<CaptureHistory>();
+		std::string error;
+		if (!history_->Configure(options.history, &error)) {
+			AddonLog(LogLevel::Warn, "Capture history disabled: %s", error.c_str());
+			history_.reset();
+		}
+	}
+	recorder_.reset(); // a previous recording finishes its last segment
+	if (options.record.enabled) {
+		recorder_ = std::make_unique<SessionRecorder>();
+		std::string error;
+		if (!recorder_->Start(options.record, &error)) {
+			AddonLog(LogLevel::Warn, "Session recording disabled: %s", error.c_str());
+			recorder_.reset();
+		}
+	}
+	options_ = options;
+	packets_ = 0;
+	glitches_ = 0;
+	glitchesReported_ = 0;
+	ioOverruns_ = 0;
+	realtime_ = false;
+	processingNs_ = 0;
+	filterGraphLatencyMs_ = 0.0f;
+	pendingChanges_ = 0;
+	formatChanges_ = 0;
+	watchdog_.Reset();
+	switch_ = SwitchRequest::None;
+	sourceSwitches_ = 0;
+	selfExcluded_ = false;
+	echoErleDb_ = 0.0f;
+	echoDriftPpm_ = 0.0f;
+	inputFrames_ = 0;
+	outputSamples_ = 0;
+	inputRate_ = 0;
+	inputChannels_ = 0;
+	periodMs_ = 0.0f;
+	convert_.Reset();
+	chain_.Reset();
+	deliver_.Reset();
+	governor_.Configure(options.governor, 16000);
+	if (options.power.enabled && !powerWatched_) {
+		SystemPowerState().Retain();
+		powerWatched_ = true;
+	}
+	powerChanges_ = ~0ull; // the first buffer posts the profile in force
+	light_ = false;
+	nextSampleTime_ = -1.0;
+	ioCallbacks_ = 0;
+	debugPeak_ = 0.0f;
+	debugSamples_ = 0;
 	targetPid_ = pid;
 	
 	// Get current process PID for filtering
 	currentPid_ = getpid();
 	// When pid == 0, we're doing system-wide capture and should exclude our own PID
-	excludeCurrentPid_ = (pid == 0);
-	
-	if (excludeCurrentPid_) {
-		printf("[addon] Starting CoreAudio loopback capture (system-wide, excluding PID %d)\n", (int)currentPid_);
-		printf("[addon] NOTE: AudioUnit HAL captures mixed output. For per-buffer PID filtering,\n");
-		printf("[addon]       Process Tap API (macOS 14.4+) would be needed, but it has limitations.\n");
-		printf("[addon]       Current approach: TTS should route to separate device to avoid capture.\n");
+	excludeCurrentPid_ = (pid == 0) && options.source == CaptureSource::Loopback;
+	
+	if (options.source == CaptureSource::Microphone) {
+		AddonLog(LogLevel::Info, "Starting CoreAudio microphone capture (%s)",
+		         options.inputDevice.empty() ? "default input" : options.inputDevice.c_str());
+	} else if (options.source == CaptureSource::File) {
+		AddonLog(LogLevel::Info, "Starting file replay capture of %s (%s pace)", options.file.c_str(),
+		         options.pace == ReplayPace::Fast ? "fast" : "realtime");
+	} else if (excludeCurrentPid_) {
+		AddonLog(LogLevel::Info, "Starting CoreAudio loopback capture (system-wide, excluding PID %d%s)",
+		         (int)currentPid_, options.excludeSelf ? " and its children" : "");
+		AddonLog(LogLevel::Info, "NOTE: On macOS 14.4+ a process tap excludes our own output directly.");
+		AddonLog(LogLevel::Info, "      Older systems capture BlackHole's mixed output; route TTS to a separate device.");
 	} else if (pid > 0) {
-		printf("[addon] Starting CoreAudio loopback capture for PID %u\n", pid);
+		AddonLog(LogLevel::Info, "Starting CoreAudio loopback capture for PID %u", pid);
 	} else {
-		printf("[addon] Starting CoreAudio loopback capture\n");
+		AddonLog(LogLevel::Info, "Starting CoreAudio loopback capture");
 	}
-	fflush(stdout);
 	
 	capture_thread_ = std::thread([this]() {
-		// Find BlackHole INPUT device (this is what we capture from)
-		AudioDeviceID blackHoleInput = FindBlackHoleInputDevice();
-		if (blackHoleInput == kAudioDeviceUnknown) {
-			printf("[addon] ❌ ERROR: BlackHole 2ch INPUT device not found\n");
-			printf("[addon]    Please install BlackHole from: https://existential.audio/blackhole/\n");
-			running_ = false;
+		ThreadCpuScope cpu("capture-worker");
+		ApplyThreadQos(ThreadQos::Interactive);
+		voice_.Configure(16000.0f, options_.loudness, options_.denoise, options_.filterGraph);
+		echo_.Configure(16000.0f, options_.echo);
+		const bool warmStart = options_.warmStart.enabled && options_.source != CaptureSource::File;
+		if (warmStart) RestoreWarmState(&voice_, options_.warmStart);
+		if (options_.source == CaptureSource::File) {
+			const bool ended = ReplayFile();
+			writer_.Discard();
+			subscribers_.Discard();
+			if (recorder_) recorder_->Close();
+			ClosePcmChannel(tsfn_, channel_, ended);
 			tsfn_.Release();
+			running_ = false;
 			return;
 		}
-		
-		printf("[addon] ✅ BlackHole 2ch INPUT device found (ID: %u)\n", blackHoleInput);
-		
-		// Also find BlackHole OUTPUT device (for TTS routing info)
-		AudioDeviceID blackHoleOutput = FindBlackHoleOutputDevice();
-		if (blackHoleOutput != kAudioDeviceUnknown) {
-			printf("[addon] ✅ BlackHole 2ch OUTPUT device found (ID: %u) - use this for TTS\n", blackHoleOutput);
-		}
-		
-		// Get default output device info
-		AudioDeviceID defaultOutput = FindDefaultOutputDevice();
-		if (defaultOutput != kAudioDeviceUnknown) {
-			CFStringRef deviceName = nullptr;
-			UInt32 propertySize = sizeof(CFStringRef);
-			AudioObjectPropertyAddress propertyAddress = {
-				kAudioDevicePropertyDeviceNameCFString,
-				kAudioObjectPropertyScopeOutput,
-				kAudioObjectPropertyElementMain
-			};
-			
-			OSStatus status = AudioObjectGetPropertyData(defaultOutput, &propertyAddress, 0, nullptr, &propertySize, &deviceName);
-			if (status == noErr && deviceName) {
-				char nameBuffer[256];
-				if (CFStringGetCString(deviceName, nameBuffer, sizeof(nameBuffer), kCFStringEncodingUTF8)) {
-					printf("[addon] Default output device: %s (ID: %u)\n", nameBuffer, defaultOutput);
-					
-					std::string name(nameBuffer);
-					std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-					
-					if (name.find("multi") != std::string::npos || name.find("aggregate") != std::string::npos) {
-						printf("[addon] ✅ Multi-Output device detected\n");
-					}
-				}
-				CFRelease(deviceName);
-			}
-		}
-		
-		// CAPTURE FROM BLACKHOLE INPUT DEVICE
-		// Setup: Multi-Output Device (BlackHole + Real Speakers) as system default
-		// System audio → Multi-Output → Goes to BOTH BlackHole OUTPUT and Speakers
-		// BlackHole OUTPUT → BlackHole INPUT (loopback)
-		// We capture from BlackHole INPUT to get system audio
-		// Whispra TTS → Goes directly to Real Speakers (not BlackHole, avoids feedback)
-		deviceId_ = blackHoleInput;
-		printf("[addon] 📡 Capturing from BlackHole 2ch INPUT device (ID: %u)\n", blackHoleInput);
-		printf("[addon] ℹ️  System audio routed through Multi-Output will be captured\n");
-		printf("[addon] ℹ️  Whispra TTS should output to Real Speakers to avoid feedback\n");
-		
-		// Try AudioUnit HAL approach
-		if (!TryAudioUnitHALApproach(deviceId_)) {
-			printf("[addon] ❌ ERROR: Failed to start capture from BlackHole INPUT\n");
+		if (!OpenSource()) {
 			running_ = false;
 			tsfn_.Release();
 			return;
 		}
 		
-		printf("[addon] ✅ CoreAudio loopback capture started successfully\n");
-		fflush(stdout);
+		AddonLog(LogLevel::Info, "✅ CoreAudio %s capture started successfully", CaptureSourceName(options_.source));
+		// The first loopback capture to start is the far end microphones cancel
+		echoReference_ = options_.source == CaptureSource::Loopback && SharedEchoReference().Claim(this);
 		
-		// Keep the thread alive while capturing
+		// This thread now runs the DSP and delivery for everything the IO callback queues
+		ThreadScheduleState schedule;
+		periodMs_ = (float)DeviceBufferPeriodMs(deviceId_, inputFormat_.mSampleRate);
+		if (ApplyThreadSchedule(options_.schedule, options_.priority, periodMs_, &schedule)) {
+			realtime_ = true;
+			AddonLog(LogLevel::Info, "Capture worker running with a '%s' time-constraint policy", ThreadScheduleName(options_.schedule));
+		}
+		SetPropertyListeners(true);
+		auto nowMs = [] {
+			return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		};
+		watchdog_.Configure((uint32_t)inputFormat_.mSampleRate, periodMs_, nowMs());
+		uint64_t framesSeen = inputFrames_.load(std::memory_order_relaxed);
+		// Option 'idle' follows the session registry's process list (macOS 14+)
+		bool idleRelease = false;
+		if (options_.idle.enabled && options_.source == CaptureSource::Loopback) {
+			idleRelease = RetainAudioSessionRegistry();
+			if (idleRelease) AudioSessionTable().AddWaker(&CoreAudioLoopbackCapture::SessionStarted, this);
+			else AddonLog(LogLevel::Warn, "Option 'idle' needs the audio session registry (macOS 14+); the stream stays open");
+		}
+		uint64_t playedMs = nowMs(), idleCheckMs = playedMs; // option 'idle': last check that found something playing
+		const mach_timespec_t timeout = { 0, CaptureWatchdog::kPollMs * 1000 * 1000 };
 		while (running_) {
-			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			semaphore_timedwait(ioReady_, timeout);
+			DrainIoFifo();
+			if (const uint32_t changes = pendingChanges_.exchange(0)) {
+				Reconfigure(changes);
+				watchdog_.Configure((uint32_t)inputFormat_.mSampleRate, periodMs_, nowMs());
+			}
+			if (switch_.load(std::memory_order_acquire) == SwitchRequest::Pending) {
+				SwitchSourceNow();
+				watchdog_.Configure((uint32_t)inputFormat_.mSampleRate, periodMs_, nowMs());
+			}
+			// A HAL device runs its IO cycle whatever it plays, so frames are always due
+			const uint64_t frames = inputFrames_.load(std::memory_order_relaxed);
+			watchdog_.Delivered(frames - framesSeen);
+			framesSeen = frames;
+			const uint64_t now = nowMs();
+			const StallStep step = watchdog_.Poll(now, true);
+			if (step != StallStep::None) RecoverStall(step, now);
+			uint64_t recoveredMs = 0;
+			if (watchdog_.TakeRecovered(&recoveredMs)) {
+				AddonLog(LogLevel::Info, "Capture stream recovered %llu ms after a stall was detected", (unsigned long long)recoveredMs);
+				NotifyStall(tsfn_, channel_, StallStepName(StallStep::None), recoveredMs, writer_.NextIndex());
+			}
+			if (idleRelease && now - idleCheckMs >= kIdleCheckMs) {
+				idleCheckMs = now;
+				if (AudioSessionTable().AnyActive()) {
+					playedMs = now;
+				} else if (now - playedMs >= options_.idle.afterMs && IdleUntilPlayback()) {
+					playedMs = idleCheckMs = nowMs();
+					watchdog_.Configure((uint32_t)inputFormat_.mSampleRate, periodMs_, playedMs);
+					framesSeen = inputFrames_.load(std::memory_order_relaxed);
+				}
+			}
 		}
+		if (idleRelease) AudioSessionTable().RemoveWaker(this);
+		if (options_.idle.enabled && options_.source == CaptureSource::Loopback) ReleaseAudioSessionRegistry();
 		
 		// Cleanup when stopping
-		if (audioUnit_ && !usingTap_) {
-			AudioOutputUnitStop(audioUnit_);
-			AudioUnitUninitialize(audioUnit_);
-			AudioComponentInstanceDispose(audioUnit_);
-			audioUnit_ = nullptr;
-		}
+		SetPropertyListeners(false);
+		CloseSource();
 		
+		// The IO callback has stopped; deliver what it queued, then finish the producer side
+		DrainIoFifo();
+		if (warmStart) SaveWarmState(voice_, options_.warmStart, writer_.NextIndex());
+		if (echoReference_.exchange(false)) SharedEchoReference().Release(this);
+		RevertThreadSchedule(&schedule);
+		writer_.Discard();
+		subscribers_.Discard();
+		if (recorder_) recorder_->Close();
+		ClosePcmChannel(tsfn_, channel_);
 		tsfn_.Release();
 	});
 	
 	return true;
 }
 
+// Sets up the downmix, resampler and the IO/worker buffers for inputFormat_.
+// Also used by Reconfigure, so it leaves the 16 kHz voice chain state alone.
+// maxFrames is the largest chunk the worker hands to ProcessAudioBuffer.
+bool CoreAudioLoopbackCapture::PrepareProcessing(UInt32 maxFrames, uint32_t channelMask) {
+	if (!DownmixPlanForFormat(inputFormat_, &downmix_, channelMask)) {
+		AddonLog(LogLevel::Error, "Unsupported input format: flags 0x%x, %u bits, %u bytes/frame",
+		       (unsigned)inputFormat_.mFormatFlags, (unsigned)inputFormat_.mBitsPerChannel, (unsigned)inputFormat_.mBytesPerFrame);
+		return false;
+	}
+	if (dialogue_.Configure(options_.dialogue, &downmix_, channelMask, (uint32_t)inputFormat_.mSampleRate) != DialogueFocus::Mode::Off) {
+		AddonLog(LogLevel::Info, "Dialogue focus: %s", DialogueFocus::ModeName(dialogue_.Current()));
+	}
+	maxFrames_ = maxFrames;
+	inputRate_ = (uint32_t)inputFormat_.mSampleRate;
+	inputChannels_ = inputFormat_.mChannelsPerFrame;
+	monoBuffer_.assign(maxFrames, 0.0f);
+	resampler_.Configure((uint32_t)inputFormat_.mSampleRate, 16000, options_.resampler, maxFrames);
+	if (options_.governor.enabled && options_.resampler != ResamplerQuality::Low) {
+		lightResampler_.Configure((uint32_t)inputFormat_.mSampleRate, 16000, ResamplerQuality::Low, maxFrames);
+	}
+	resampleBuffer_.assign(resampler_.MaxOutput(maxFrames), 0.0f);
+	const size_t preroll = options_.arm.enabled ? (size_t)options_.arm.prerollMs * 16 : 0;
+	preGateBuffer_.assign(options_.chunker.enabled && options_.chunker.prerollMs > 0 ? std::max(resampleBuffer_.size(), preroll) : 0, 0.0f);
+	// libswresample downmixes with the plan's weights: fine for a centre selection, not for the stereo extractor
+	if (dialogue_.Current() == DialogueFocus::Mode::MidSide) swr_.Close();
+	else if (swr_.Configure(downmix_, (uint32_t)inputFormat_.mSampleRate, 16000, options_.resampler)) AddonLog(LogLevel::Info, "Converting with libswresample");
+	const size_t sliceBytes = (size_t)maxFrames * inputFormat_.mBytesPerFrame;
+	workBuffer_.assign(sliceBytes, 0);
+	// At least 500 ms of input so a stalled Node event loop doesn't drop IO buffers
+	ioFifo_.Reset(std::max(sliceBytes * 8, (size_t)(inputFormat_.mSampleRate / 2) * inputFormat_.mBytesPerFrame));
+	ioClock_.Reset(inputFormat_.mSampleRate);
+	return true;
+}
+
+// Reads the device format off the uninitialized unit, applies the client format
+// for conversion 'hal-converted' and sizes the processing buffers to match.
+bool CoreAudioLoopbackCapture::ConfigureAudioUnitFormat() {
+	// Get the input format from BlackHole
+	UInt32 propertySize = sizeof(AudioStreamBasicDescription);
+	OSStatus status = AudioUnitGetProperty(audioUnit_,
+	                                       kAudioUnitProperty_StreamFormat,
+	                                       kAudioUnitScope_Input,
+	                                       1,
+	                                       &inputFormat_,
+	                                       &propertySize);
+	if (status != noErr) {
+		AddonLog(LogLevel::Error, "Failed to get input format from BlackHole: %d", (int)status);
+		return false;
+	}
+
+	// Client format for conversion 'hal-converted': 16 kHz mono float, so the unit's own
+	// converter does channel reduction and SRC inside AudioUnitRender
+	outputFormat_.mSampleRate = 16000.0;
+	outputFormat_.mFormatID = kAudioFormatLinearPCM;
+	outputFormat_.mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked;
+	outputFormat_.mBytesPerPacket = 4;
+	outputFormat_.mFramesPerPacket = 1;
+	outputFormat_.mBytesPerFrame = 4;
+	outputFormat_.mChannelsPerFrame = 1;
+	outputFormat_.mBitsPerChannel = 32;
+	outputFormat_.mReserved = 0;
+	if (options_.conversion == FormatConversion::Hal) {
+		status = AudioUnitSetProperty(audioUnit_,
+		                              kAudioUnitProperty_StreamFormat,
+		                              kAudioUnitScope_Output,
+		                              1,
+		                              &outputFormat_,
+		                              sizeof(outputFormat_));
+		if (status == noErr) {
+			inputFormat_ = outputFormat_;
+			AddonLog(LogLevel::Info, "HAL AudioUnit converts to 16 kHz mono float");
+		} else {
+			AddonLog(LogLevel::Warn, "Failed to set 16 kHz client format (%d); converting natively", (int)status);
+		}
+	}
+
+	// Preallocate everything the IO callback touches for the largest slice the unit will render
+	UInt32 maxFrames = 0;
+	propertySize = sizeof(maxFrames);
+	status = AudioUnitGetProperty(audioUnit_,
+	                              kAudioUnitProperty_MaximumFramesPerSlice,
+	                              kAudioUnitScope_Global,
+	                              0,
+	                              &maxFrames,
+	                              &propertySize);
+	if (status != noErr || maxFrames == 0) maxFrames = 4096;
+	if (!PrepareProcessing(maxFrames)) return false;
+	renderBuffer_.assign((size_t)maxFrames * inputFormat_.mBytesPerFrame, 0);
+	return true;
+}
+
 bool CoreAudioLoopbackCapture::TryAudioUnitHALApproach(AudioDeviceID blackHoleDevice) {
 	// Capture from BlackHole as an input device
 	// User must have a Multi-Output Device set up that routes to both speakers and BlackHole
@@ -677,7 +1154,7 @@ bool CoreAudioLoopbackCapture::TryAudioUnitHALApproach(AudioDeviceID blackHoleDe
 	deviceId_ = blackHoleDevice;
 	usingTap_ = false;
 
-	printf("[addon] Setting up AudioUnit to capture from BlackHole (device ID: %u)\n", blackHoleDevice);
+	AddonLog(LogLevel::Info, "Setting up AudioUnit to capture from input device %u", blackHoleDevice);
 
 	AudioComponentDescription desc;
 	desc.componentType = kAudioUnitType_Output;
@@ -688,13 +1165,13 @@ bool CoreAudioLoopbackCapture::TryAudioUnitHALApproach(AudioDeviceID blackHoleDe
 
 	AudioComponent comp = AudioComponentFindNext(nullptr, &desc);
 	if (!comp) {
-		printf("[addon] Failed to find HAL Output AudioUnit component\n");
+		AddonLog(LogLevel::Error, "Failed to find HAL Output AudioUnit component");
 		return false;
 	}
 
 	OSStatus status = AudioComponentInstanceNew(comp, &audioUnit_);
 	if (status != noErr) {
-		printf("[addon] Failed to create HAL Output AudioUnit: %d\n", (int)status);
+		AddonLog(LogLevel::Error, "Failed to create HAL Output AudioUnit: %d", (int)status);
 		return false;
 	}
 
@@ -707,7 +1184,7 @@ bool CoreAudioLoopbackCapture::TryAudioUnitHALApproach(AudioDeviceID blackHoleDe
 	                              &enableIO,
 	                              sizeof(enableIO));
 	if (status != noErr) {
-		printf("[addon] Failed to enable input on HAL Output unit: %d\n", (int)status);
+		AddonLog(LogLevel::Error, "Failed to enable input on HAL Output unit: %d", (int)status);
 		AudioComponentInstanceDispose(audioUnit_);
 		audioUnit_ = nullptr;
 		return false;
@@ -722,7 +1199,7 @@ bool CoreAudioLoopbackCapture::TryAudioUnitHALApproach(AudioDeviceID blackHoleDe
 	                              &enableIO,
 	                              sizeof(enableIO));
 	if (status != noErr) {
-		printf("[addon] Failed to disable output on HAL Output unit: %d\n", (int)status);
+		AddonLog(LogLevel::Error, "Failed to disable output on HAL Output unit: %d", (int)status);
 		AudioComponentInstanceDispose(audioUnit_);
 		audioUnit_ = nullptr;
 		return false;
@@ -736,38 +1213,12 @@ bool CoreAudioLoopbackCapture::TryAudioUnitHALApproach(AudioDeviceID blackHoleDe
 	                              &deviceId_,
 	                              sizeof(deviceId_));
 	if (status != noErr) {
-		printf("[addon] Failed to set BlackHole device on HAL Output unit: %d\n", (int)status);
+		AddonLog(LogLevel::Error, "Failed to set BlackHole device on HAL Output unit: %d", (int)status);
 		AudioComponentInstanceDispose(audioUnit_);
 		audioUnit_ = nullptr;
 		return false;
 	}
 
-	// Get the input format from BlackHole
-	UInt32 propertySize = sizeof(AudioStreamBasicDescription);
-	status = AudioUnitGetProperty(audioUnit_,
-	                              kAudioUnitProperty_StreamFormat,
-	                              kAudioUnitScope_Input,
-	                              1,
-	                              &inputFormat_,
-	                              &propertySize);
-	if (status != noErr) {
-		printf("[addon] Failed to get input format from BlackHole: %d\n", (int)status);
-		AudioComponentInstanceDispose(audioUnit_);
-		audioUnit_ = nullptr;
-		return false;
-	}
-
-	// Set output format (we'll process to 16kHz mono)
-	outputFormat_.mSampleRate = 16000.0;
-	outputFormat_.mFormatID = kAudioFormatLinearPCM;
-	outputFormat_.mFormatFlags = kAudioFormatFlagIsSignedInteger | kAudioFormatFlagIsPacked;
-	outputFormat_.mBytesPerPacket = 2;
-	outputFormat_.mFramesPerPacket = 1;
-	outputFormat_.mBytesPerFrame = 2;
-	outputFormat_.mChannelsPerFrame = 1;
-	outputFormat_.mBitsPerChannel = 16;
-	outputFormat_.mReserved = 0;
-
 	// Set render callback on input scope to capture audio
 	AURenderCallbackStruct callback;
 	callback.inputProc = InputCallback;
@@ -780,31 +1231,22 @@ bool CoreAudioLoopbackCapture::TryAudioUnitHALApproach(AudioDeviceID blackHoleDe
 	                              &callback,
 	                              sizeof(callback));
 	if (status != noErr) {
-		printf("[addon] Failed to set input callback on HAL Output unit: %d\n", (int)status);
+		AddonLog(LogLevel::Error, "Failed to set input callback on HAL Output unit: %d", (int)status);
 		AudioComponentInstanceDispose(audioUnit_);
 		audioUnit_ = nullptr;
 		return false;
 	}
 
-	// Initialize signal processing
-	const float outFs = 16000.0f;
-	hpf_.setup(outFs, 90.0f, 0.7071f);
-	env_ = 0.0f;
-	noiseFloor_ = 0.003f;
-	gainSmooth_ = 1.0f;
-	const float tauEnv = 0.010f;
-	const float tauRise = 0.500f;
-	const float tauAtk = 0.005f;
-	const float tauRel = 0.050f;
-	aEnv_ = expf(-1.0f / (tauEnv * outFs));
-	aRise_ = expf(-1.0f / (tauRise * outFs));
-	aAtk_ = expf(-1.0f / (tauAtk * outFs));
-	aRel_ = expf(-1.0f / (tauRel * outFs));
+	if (!ConfigureAudioUnitFormat()) {
+		AudioComponentInstanceDispose(audioUnit_);
+		audioUnit_ = nullptr;
+		return false;
+	}
 
 	// Initialize the AudioUnit
 	status = AudioUnitInitialize(audioUnit_);
 	if (status != noErr) {
-		printf("[addon] Failed to initialize HAL Output AudioUnit: %d\n", (int)status);
+		AddonLog(LogLevel::Error, "Failed to initialize HAL Output AudioUnit: %d", (int)status);
 		AudioComponentInstanceDispose(audioUnit_);
 		audioUnit_ = nullptr;
 		return false;
@@ -813,31 +1255,392 @@ bool CoreAudioLoopbackCapture::TryAudioUnitHALApproach(AudioDeviceID blackHoleDe
 	// Start the AudioUnit
 	status = AudioOutputUnitStart(audioUnit_);
 	if (status != noErr) {
-		printf("[addon] Failed to start HAL Output AudioUnit: %d\n", (int)status);
+		AddonLog(LogLevel::Error, "Failed to start HAL Output AudioUnit: %d", (int)status);
 		AudioUnitUninitialize(audioUnit_);
 		AudioComponentInstanceDispose(audioUnit_);
 		audioUnit_ = nullptr;
 		return false;
 	}
 
-	printf("[addon] HAL Output AudioUnit started successfully, format: %.0f Hz, %u channels\n",
+	AddonLog(LogLevel::Info, "HAL Output AudioUnit started successfully, client format: %.0f Hz, %u channels",
 	       inputFormat_.mSampleRate, inputFormat_.mChannelsPerFrame);
-	fflush(stdout);
+	backend_ = "audio-unit";
 
 	return true;
 }
 
-bool CoreAudioLoopbackCapture::TryProcessTapApproach(AudioDeviceID defaultOutputDevice) {
-	// Process Tap API implementation would go here for macOS 14.4+
-	// For now, return false to fall back to AudioUnit HAL
-	(void)defaultOutputDevice; // Suppress unused parameter warning
-	return false;
+// BlackHole and microphone capture: the device through the backend option
+// 'backend' picks. A device the IOProc can't read falls back to the AudioUnit.
+bool CoreAudioLoopbackCapture::StartDeviceCapture(AudioDeviceID device) {
+	if (options_.backend == HalBackend::IoProc) {
+		if (TryIoProcApproach(device)) return true;
+		AddonLog(LogLevel::Warn, "IOProc backend unavailable for device %u; using the HAL AudioUnit", device);
+	}
+	return TryAudioUnitHALApproach(device);
+}
+
+// Reads the device's input stream format, the one its IOProc is handed, and
+// sizes the processing buffers to match. The hand-off copies one interleaved
+// buffer, so devices with several input streams are left to the AudioUnit.
+bool CoreAudioLoopbackCapture::ConfigureIoProcFormat() {
+	AudioObjectPropertyAddress address = {
+		kAudioDevicePropertyStreamConfiguration, kAudioObjectPropertyScopeInput, kAudioObjectPropertyElementMain
+	};
+	UInt32 size = 0;
+	if (AudioObjectGetPropertyDataSize(deviceId_, &address, 0, nullptr, &size) != noErr || size < sizeof(AudioBufferList)) return false;
+	std::vector<uint8_t> storage(size);
+	AudioBufferList* streams = reinterpret_cast<AudioBufferList*>(storage.data());
+	if (AudioObjectGetPropertyData(deviceId_, &address, 0, nullptr, &size, streams) != noErr) return false;
+	if (streams->mNumberBuffers != 1) {
+		AddonLog(LogLevel::Warn, "Device %u has %u input streams; the IOProc backend reads one", deviceId_, (unsigned)streams->mNumberBuffers);
+		return false;
+	}
+	address.mSelector = kAudioDevicePropertyStreamFormat;
+	size = sizeof(inputFormat_);
+	OSStatus status = AudioObjectGetPropertyData(deviceId_, &address, 0, nullptr, &size, &inputFormat_);
+	if (status != noErr) {
+		AddonLog(LogLevel::Warn, "Failed to get the input stream format of device %u: %d", deviceId_, (int)status);
+		return false;
+	}
+	if ((inputFormat_.mFormatFlags & kAudioFormatFlagIsNonInterleaved) && inputFormat_.mChannelsPerFrame > 1) {
+		AddonLog(LogLevel::Warn, "Device %u delivers non-interleaved input", deviceId_);
+		return false;
+	}
+	if (options_.conversion == FormatConversion::Hal) {
+		AddonLog(LogLevel::Info, "Conversion 'hal-converted' needs the AudioUnit backend; converting natively");
+	}
+	// The IOProc hands over whole IO cycles; the worker processes them in 4096-frame chunks
+	maxFrames_ = 0;
+	return PrepareProcessing(4096);
 }
 
+// Option backend 'ioproc': an IOProc straight on the device, handed the input
+// buffer list in place with no AudioUnitRender call or AUHAL converter in
+// between. It queues for the worker exactly as a process tap does.
+bool CoreAudioLoopbackCapture::TryIoProcApproach(AudioDeviceID device) {
+	deviceId_ = device;
+	usingTap_ = false;
+	if (!ConfigureIoProcFormat()) return false;
+	OSStatus status = AudioDeviceCreateIOProcID(deviceId_, DeviceIOProc, this, &ioProc_);
+	if (status == noErr) status = AudioDeviceStart(deviceId_, ioProc_);
+	if (status != noErr) {
+		AddonLog(LogLevel::Warn, "Failed to start an IOProc on device %u: %d", deviceId_, (int)status);
+		StopIoProc();
+		return false;
+	}
+	AddonLog(LogLevel::Info, "Device IOProc started, %.0f Hz, %u channels", inputFormat_.mSampleRate, inputFormat_.mChannelsPerFrame);
+	backend_ = "ioproc";
+	return true;
+}
+
+void CoreAudioLoopbackCapture::StopIoProc() {
+	if (!ioProc_) return;
+	AudioDeviceStop(deviceId_, ioProc_);
+	AudioDeviceDestroyIOProcID(deviceId_, ioProc_);
+	ioProc_ = nullptr;
+}
+
+// Worker thread. Loopback prefers a process tap (macOS 14.4+), which needs no
+// BlackHole routing.
+bool CoreAudioLoopbackCapture::OpenSource() {
+	if (options_.source == CaptureSource::Microphone) return StartMicrophoneCapture();
+	if (TryProcessTapApproach()) {
+		AddonLog(LogLevel::Info, "✅ Capturing through a CoreAudio process tap");
+		return true;
+	}
+	return StartBlackHoleCapture();
+}
+
+// There is one device stream per capture here, so unlike WASAPI's endpoints
+// the new source cannot run beside the old one to be faded in: the worker
+// closes and reopens the source like a reactivation, a gap of one tap or
+// device setup, and the voice chain, VAD and chunker carry on across it.
+bool CoreAudioLoopbackCapture::SwitchSource(uint32_t pid, const std::string& endpointId) {
+	if (!running_) return false;
+	if (options_.source == CaptureSource::File) {
+		AddonLog(LogLevel::Warn, "switchSource: a file replay has no source to switch");
+		return false;
+	}
+	const bool microphone = options_.source == CaptureSource::Microphone;
+	if (microphone == endpointId.empty()) {
+		AddonLog(LogLevel::Warn, "switchSource: %s", microphone ? "a microphone capture switches to an input device, not a PID"
+		                                                        : "a loopback capture switches by PID; render endpoints are not selectable here");
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(switchMutex_);
+		switchPid_ = pid;
+		switchDevice_ = endpointId;
+	}
+	switch_.store(SwitchRequest::Pending, std::memory_order_release);
+	semaphore_signal(ioReady_);
+	while (switch_.load(std::memory_order_acquire) == SwitchRequest::Pending && running_) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	return switch_.exchange(SwitchRequest::None) == SwitchRequest::Switched;
+}
+
+// Worker thread: SwitchSource()'s reopen. A source that fails to open puts
+// the old one back.
+void CoreAudioLoopbackCapture::SwitchSourceNow() {
+	uint32_t pid;
+	std::string device;
+	{
+		std::lock_guard<std::mutex> lock(switchMutex_);
+		pid = switchPid_;
+		device = switchDevice_;
+	}
+	const uint32_t oldPid = targetPid_;
+	const std::string oldDevice = options_.inputDevice;
+	SetPropertyListeners(false);
+	CloseSource();
+	DrainIoFifo();
+	nextSampleTime_ = -1.0;
+	auto select = [&](uint32_t p, const std::string& d) {
+		targetPid_ = options_.source == CaptureSource::Microphone ? 0 : p;
+		excludeCurrentPid_ = targetPid_ == 0 && options_.source == CaptureSource::Loopback;
+		options_.inputDevice = d;
+	};
+	select(pid, options_.source == CaptureSource::Microphone ? device : oldDevice);
+	bool ok = OpenSource();
+	if (!ok) {
+		AddonLog(LogLevel::Warn, "switchSource: the new source could not be opened; back to the old one");
+		select(oldPid, oldDevice);
+		if (!OpenSource()) {
+			AddonLog(LogLevel::Error, "Failed to reopen the capture source after a failed switch; stopping");
+			running_ = false;
+		}
+	}
+	SetPropertyListeners(running_);
+	if (ok) {
+		sourceSwitches_.fetch_add(1, std::memory_order_relaxed);
+		glitches_.fetch_add(1, std::memory_order_relaxed);
+		AddonLog(LogLevel::Info, "Capture switched to %s%s", device.empty() ? "PID " : "", device.empty() ? std::to_string(pid).c_str() : device.c_str());
+		NotifyInputFormatChange(tsfn_, channel_, (uint32_t)inputFormat_.mSampleRate, inputFormat_.mChannelsPerFrame, "source");
+	}
+	switch_.store(ok ? SwitchRequest::Switched : SwitchRequest::Failed, std::memory_order_release);
+}
+
+// Worker thread
+void CoreAudioLoopbackCapture::CloseSource() {
+	if (usingTap_) processTap_.Stop();
+	StopIoProc();
+	if (audioUnit_ && !usingTap_) {
+		AudioOutputUnitStop(audioUnit_);
+		AudioUnitUninitialize(audioUnit_);
+		AudioComponentInstanceDispose(audioUnit_);
+		audioUnit_ = nullptr;
+	}
+}
+
+// HAL IO thread of the device (option backend 'ioproc').
+OSStatus CoreAudioLoopbackCapture::DeviceIOProc(AudioObjectID device, const AudioTimeStamp* now,
+                                                const AudioBufferList* inputData, const AudioTimeStamp* inputTime,
+                                                AudioBufferList* outputData, const AudioTimeStamp* outputTime, void* clientData) {
+	(void)device;
+	(void)now;
+	(void)outputData;
+	(void)outputTime;
+	if (inputData && inputData->mNumberBuffers > 0) TapInput(clientData, inputData, inputTime);
+	return noErr;
+}
+
+// macOS 14.4+: tap the target (or everything but us) directly, no BlackHole routing.
+bool CoreAudioLoopbackCapture::TryProcessTapApproach() {
+	if (!ProcessTapCapture::IsSupported()) return false;
+	usingTap_ = false;
+	if (!processTap_.Open(excludeCurrentPid_ ? 0 : (pid_t)targetPid_, options_.excludeSelf, &inputFormat_)) return false;
+	if (inputFormat_.mFormatFlags & kAudioFormatFlagIsNonInterleaved) {
+		AddonLog(LogLevel::Warn, "Process tap delivered a non-interleaved format; using BlackHole instead");
+		processTap_.Stop();
+		return false;
+	}
+	// The tap hands over whole IO cycles; the worker processes them in 4096-frame chunks
+	maxFrames_ = 0;
+	if (!PrepareProcessing(4096) || !processTap_.Start(TapInput, this)) {
+		processTap_.Stop();
+		return false;
+	}
+	deviceId_ = processTap_.DeviceId();
+	usingTap_ = true;
+	backend_ = "tap";
+	selfExcluded_ = excludeCurrentPid_ && options_.excludeSelf;
+	return true;
+}
+
+// HAL IO thread of the tap's aggregate device, or of the device itself with
+// backend 'ioproc': same hand-off as InputCallback.
+void CoreAudioLoopbackCapture::TapInput(void* context, const AudioBufferList* input, const AudioTimeStamp* inputTime) {
+	CoreAudioLoopbackCapture* capture = static_cast<CoreAudioLoopbackCapture*>(context);
+	if (!capture->running_) return;
+	RealtimeScope realtime;
+	const UInt32 bytes = input->mBuffers[0].mDataByteSize;
+	const UInt32 frames = capture->inputFormat_.mBytesPerFrame ? bytes / capture->inputFormat_.mBytesPerFrame : 0;
+	if (inputTime && (inputTime->mFlags & kAudioTimeStampSampleTimeValid)) {
+		if (capture->nextSampleTime_ >= 0.0 && inputTime->mSampleTime != capture->nextSampleTime_) {
+			capture->glitches_.fetch_add(1, std::memory_order_relaxed);
+		}
+		capture->nextSampleTime_ = inputTime->mSampleTime + frames;
+	}
+	if (capture->ioFifo_.Write(input->mBuffers[0].mData, bytes)) {
+		capture->ioClock_.Queued(inputTime, frames);
+	} else {
+		capture->ioOverruns_.fetch_add(1, std::memory_order_relaxed);
+	}
+	capture->packets_.fetch_add(1, std::memory_order_relaxed);
+	semaphore_signal(capture->ioReady_);
+}
+
+namespace {
+	const AudioObjectPropertyAddress kDefaultOutputAddress = {
+		kAudioHardwarePropertyDefaultOutputDevice, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain
+	};
+	const AudioObjectPropertyAddress kSampleRateAddress = {
+		kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain
+	};
+	const AudioObjectPropertyAddress kStreamFormatAddress = {
+		kAudioDevicePropertyStreamFormat, kAudioObjectPropertyScopeInput, kAudioObjectPropertyElementMain
+	};
+}
+
+OSStatus CoreAudioLoopbackCapture::PropertyChanged(AudioObjectID object, UInt32 count, const AudioObjectPropertyAddress* addresses, void* context) {
+	(void)object;
+	CoreAudioLoopbackCapture* capture = static_cast<CoreAudioLoopbackCapture*>(context);
+	uint32_t changes = 0;
+	for (UInt32 i = 0; i < count; ++i) {
+		switch (addresses[i].mSelector) {
+		case kAudioHardwarePropertyDefaultOutputDevice: changes |= kChangeDefaultOutput; break;
+		case kAudioDevicePropertyNominalSampleRate: changes |= kChangeSampleRate; break;
+		case kAudioDevicePropertyStreamFormat: changes |= kChangeStreamFormat; break;
+		}
+	}
+	if (changes) {
+		capture->pendingChanges_.fetch_or(changes);
+		semaphore_signal(capture->ioReady_);
+	}
+	return noErr;
+}
+
+// Worker thread. The device listeners follow deviceId_, which a tap rebuild changes.
+void CoreAudioLoopbackCapture::SetPropertyListeners(bool add) {
+	if (listenedDevice_ != kAudioObjectUnknown) {
+		AudioObjectRemovePropertyListener(kAudioObjectSystemObject, &kDefaultOutputAddress, PropertyChanged, this);
+		AudioObjectRemovePropertyListener(listenedDevice_, &kSampleRateAddress, PropertyChanged, this);
+		AudioObjectRemovePropertyListener(listenedDevice_, &kStreamFormatAddress, PropertyChanged, this);
+		listenedDevice_ = kAudioObjectUnknown;
+	}
+	if (!add || deviceId_ == kAudioObjectUnknown) return;
+	OSStatus status = AudioObjectAddPropertyListener(kAudioObjectSystemObject, &kDefaultOutputAddress, PropertyChanged, this);
+	if (status == noErr) status = AudioObjectAddPropertyListener(deviceId_, &kSampleRateAddress, PropertyChanged, this);
+	// Not every device publishes a device-level stream format; the sample rate listener is enough there
+	if (status == noErr) AudioObjectAddPropertyListener(deviceId_, &kStreamFormatAddress, PropertyChanged, this);
+	if (status != noErr) AddonLog(LogLevel::Warn, "Failed to register device change listeners: %d", (int)status);
+	listenedDevice_ = deviceId_;
+}
+
+// Worker thread. Rebuilds only what depends on the input format (downmix,
+// resampler tables, IO buffers) while the stream is briefly stopped, then
+// reports the new format to JS; the session, channel and voice chain carry on.
+void CoreAudioLoopbackCapture::Reconfigure(uint32_t changes) {
+	const char* reason = (changes & kChangeStreamFormat) ? "stream-format"
+		: (changes & kChangeSampleRate) ? "sample-rate" : "default-output";
+	// BlackHole (or the microphone) stays the capture device when the default output moves
+	if (!usingTap_ && changes == kChangeDefaultOutput) {
+		AddonLog(LogLevel::Info, "Default output device changed; still capturing BlackHole (route output through it to keep capturing)");
+		return;
+	}
+	if (!RebuildStream()) {
+		AddonLog(LogLevel::Error, "Failed to reconfigure capture after a device change (%s); stopping", reason);
+		running_ = false;
+		return;
+	}
+	formatChanges_.fetch_add(1, std::memory_order_relaxed);
+	AddonLog(LogLevel::Info, "Capture reconfigured (%s): %.0f Hz, %u channels", reason, inputFormat_.mSampleRate, (unsigned)inputFormat_.mChannelsPerFrame);
+	NotifyInputFormatChange(tsfn_, channel_, (uint32_t)inputFormat_.mSampleRate, inputFormat_.mChannelsPerFrame, reason);
+}
+
+// Worker thread: stops the stream, rebuilds it for the device's current
+// format and starts it again.
+bool CoreAudioLoopbackCapture::RebuildStream() {
+	bool ok;
+	if (usingTap_) {
+		// The tap's aggregate is clocked by the output device it was built on
+		SetPropertyListeners(false);
+		processTap_.Stop();
+		DrainIoFifo();
+		ok = processTap_.Open(excludeCurrentPid_ ? 0 : (pid_t)targetPid_, options_.excludeSelf, &inputFormat_) &&
+		     !(inputFormat_.mFormatFlags & kAudioFormatFlagIsNonInterleaved) &&
+		     PrepareProcessing(4096);
+		nextSampleTime_ = -1.0;
+		ok = ok && processTap_.Start(TapInput, this);
+		if (ok) deviceId_ = processTap_.DeviceId();
+		SetPropertyListeners(ok);
+	} else if (ioProc_) {
+		AudioDeviceStop(deviceId_, ioProc_);
+		DrainIoFifo();
+		nextSampleTime_ = -1.0;
+		ok = ConfigureIoProcFormat() && AudioDeviceStart(deviceId_, ioProc_) == noErr;
+	} else {
+		AudioOutputUnitStop(audioUnit_);
+		DrainIoFifo();
+		AudioUnitUninitialize(audioUnit_);
+		nextSampleTime_ = -1.0;
+		ok = ConfigureAudioUnitFormat() &&
+		     AudioUnitInitialize(audioUnit_) == noErr &&
+		     AudioOutputUnitStart(audioUnit_) == noErr;
+	}
+	return ok;
+}
+
+// Worker thread: one step of the watchdog's escalation (capture_watchdog.h).
+// Restart keeps everything and only cycles the IO; reinitialize rebuilds the
+// stream as a format change would; reactivate closes the source and opens it
+// again, looking the devices up afresh.
+void CoreAudioLoopbackCapture::RecoverStall(StallStep step, uint64_t nowMs) {
+	const uint64_t stalledMs = watchdog_.StalledMs(nowMs);
+	AddonLog(LogLevel::Warn, "Capture stalled for %llu ms; trying %s", (unsigned long long)stalledMs, StallStepName(step));
+	NotifyStall(tsfn_, channel_, StallStepName(step), stalledMs, writer_.NextIndex());
+	bool ok;
+	if (step == StallStep::Restart) {
+		if (usingTap_) {
+			ok = processTap_.Restart();
+		} else if (ioProc_) {
+			AudioDeviceStop(deviceId_, ioProc_);
+			nextSampleTime_ = -1.0;
+			ok = AudioDeviceStart(deviceId_, ioProc_) == noErr;
+		} else {
+			AudioOutputUnitStop(audioUnit_);
+			nextSampleTime_ = -1.0;
+			ok = AudioOutputUnitStart(audioUnit_) == noErr;
+		}
+	} else if (step == StallStep::Reinitialize) {
+		ok = RebuildStream();
+	} else {
+		SetPropertyListeners(false);
+		CloseSource();
+		DrainIoFifo();
+		nextSampleTime_ = -1.0;
+		ok = OpenSource();
+		SetPropertyListeners(ok);
+	}
+	// A failed step is left to the next one; the last keeps retrying
+	if (!ok) {
+		AddonLog(LogLevel::Warn, "Capture %s failed", StallStepName(step));
+		return;
+	}
+	glitches_.fetch_add(1, std::memory_order_relaxed);
+	if (step == StallStep::Restart) return;
+	NotifyInputFormatChange(tsfn_, channel_, (uint32_t)inputFormat_.mSampleRate, inputFormat_.mChannelsPerFrame, "stall");
+	watchdog_.Configure((uint32_t)inputFormat_.mSampleRate, periodMs_, nowMs);
+}
+
+// The multi-output device's UID; it is private, so only this process sees it
+// and it goes away with the process.
+const char kMultiOutputUid[] = "com.whispra.multioutput.v1";
+
 // Create a multi-output aggregate device that routes to both BlackHole and real speakers
 AudioDeviceID CreateMultiOutputDevice(AudioDeviceID realSpeakers, AudioDeviceID blackHole) {
-	printf("[addon] Creating multi-output aggregate device...\n");
-	fflush(stdout);
+	AddonLog(LogLevel::Info, "Creating multi-output aggregate device...");
 	
 	// Get UIDs for both devices first
 	CFStringRef blackHoleUID = nullptr;
@@ -852,13 +1655,13 @@ AudioDeviceID CreateMultiOutputDevice(AudioDeviceID realSpeakers, AudioDeviceID
 	
 	OSStatus status = AudioObjectGetPropertyData(blackHole, &propertyAddress, 0, nullptr, &propertySize, &blackHoleUID);
 	if (status != noErr || !blackHoleUID) {
-		printf("[addon] Failed to get BlackHole UID: %d\n", (int)status);
+		AddonLog(LogLevel::Error, "Failed to get BlackHole UID: %d", (int)status);
 		return kAudioDeviceUnknown;
 	}
 	
 	status = AudioObjectGetPropertyData(realSpeakers, &propertyAddress, 0, nullptr, &propertySize, &realSpeakersUID);
 	if (status != noErr || !realSpeakersUID) {
-		printf("[addon] Failed to get real speakers UID: %d\n", (int)status);
+		AddonLog(LogLevel::Error, "Failed to get real speakers UID: %d", (int)status);
 		CFRelease(blackHoleUID);
 		return kAudioDeviceUnknown;
 	}
@@ -868,8 +1671,8 @@ AudioDeviceID CreateMultiOutputDevice(AudioDeviceID realSpeakers, AudioDeviceID
 	char realSpeakersUIDStr[256];
 	CFStringGetCString(blackHoleUID, blackHoleUIDStr, sizeof(blackHoleUIDStr), kCFStringEncodingUTF8);
 	CFStringGetCString(realSpeakersUID, realSpeakersUIDStr, sizeof(realSpeakersUIDStr), kCFStringEncodingUTF8);
-	printf("[addon] BlackHole UID: %s\n", blackHoleUIDStr);
-	printf("[addon] Real Speakers UID: %s\n", realSpeakersUIDStr);
+	AddonLog(LogLevel::Info, "BlackHole UID: %s", blackHoleUIDStr);
+	AddonLog(LogLevel::Info, "Real Speakers UID: %s", realSpeakersUIDStr);
 	
 	// Create aggregate device description
 	CFMutableDictionaryRef aggregateDeviceDict = CFDictionaryCreateMutable(
@@ -883,8 +1686,9 @@ AudioDeviceID CreateMultiOutputDevice(AudioDeviceID realSpeakers, AudioDeviceID
 	CFDictionarySetValue(aggregateDeviceDict, CFSTR(kAudioAggregateDeviceNameKey), deviceName);
 	
 	// Set device UID (must be unique)
-	CFStringRef deviceUID = CFSTR("com.whispra.multioutput.v1");
+	CFStringRef deviceUID = CFStringCreateWithCString(kCFAllocatorDefault, kMultiOutputUid, kCFStringEncodingUTF8);
 	CFDictionarySetValue(aggregateDeviceDict, CFSTR(kAudioAggregateDeviceUIDKey), deviceUID);
+	CFRelease(deviceUID);
 	
 	// Create sub-device list (Real Speakers first as master, then BlackHole)
 	CFMutableArrayRef subDevicesArray = CFArrayCreateMutable(kCFAllocatorDefault, 2, &kCFTypeArrayCallBacks);
@@ -920,7 +1724,7 @@ AudioDeviceID CreateMultiOutputDevice(AudioDeviceID realSpeakers, AudioDeviceID
 	                                    0, nullptr, &propertySize, &translation);
 	
 	if (status != noErr || pluginID == kAudioObjectUnknown) {
-		printf("[addon] Failed to get CoreAudio plugin: %d\n", (int)status);
+		AddonLog(LogLevel::Error, "Failed to get CoreAudio plugin: %d", (int)status);
 		CFRelease(blackHoleUID);
 		CFRelease(realSpeakersUID);
 		CFRelease(subDevicesArray);
@@ -946,14 +1750,13 @@ AudioDeviceID CreateMultiOutputDevice(AudioDeviceID realSpeakers, AudioDeviceID
 	CFRelease(aggregateDeviceDict);
 	
 	if (status != noErr || aggregateDeviceID == kAudioDeviceUnknown) {
-		printf("[addon] Failed to create aggregate device: %d (0x%X)\n", (int)status, (unsigned int)status);
+		AddonLog(LogLevel::Error, "Failed to create aggregate device: %d (0x%X)", (int)status, (unsigned int)status);
 		return kAudioDeviceUnknown;
 	}
 	
-	printf("[addon] ✅ Created multi-output aggregate device (ID: %u)\n", aggregateDeviceID);
-	printf("[addon]    Audio will play through speakers AND be captured for translation\n");
-	printf("[addon]    Volume keys will work normally\n");
-	fflush(stdout);
+	AddonLog(LogLevel::Info, "✅ Created multi-output aggregate device (ID: %u)", aggregateDeviceID);
+	AddonLog(LogLevel::Info, "   Audio will play through speakers AND be captured for translation");
+	AddonLog(LogLevel::Info, "   Volume keys will work normally");
 	
 	return aggregateDeviceID;
 }
@@ -962,7 +1765,7 @@ bool CoreAudioLoopbackCapture::CreateAggregateDeviceWithTap(AudioDeviceID defaul
 	// This creates a multi-output device programmatically
 	AudioDeviceID blackHole = FindBlackHoleOutputDevice();
 	if (blackHole == kAudioDeviceUnknown) {
-		printf("[addon] Cannot create aggregate device: BlackHole not found\n");
+		AddonLog(LogLevel::Warn, "Cannot create aggregate device: BlackHole not found");
 		return false;
 	}
 	
@@ -972,21 +1775,21 @@ bool CoreAudioLoopbackCapture::CreateAggregateDeviceWithTap(AudioDeviceID defaul
 
 
 void CoreAudioLoopbackCapture::Stop() {
+	if (powerWatched_) SystemPowerState().Release();
+	powerWatched_ = false;
 	if (!running_) return;
 
 	running_ = false;
+	semaphore_signal(ioReady_); // a worker idling for option 'idle' waits without a timeout
 
-	// Stop AudioUnit if using HAL approach
-	if (audioUnit_ && !usingTap_) {
-		AudioOutputUnitStop(audioUnit_);
-		AudioUnitUninitialize(audioUnit_);
-		AudioComponentInstanceDispose(audioUnit_);
-		audioUnit_ = nullptr;
+	// The capture thread stops and disposes the AudioUnit, IOProc or process tap
+	if (capture_thread_.joinable()) {
+		capture_thread_.join();
 	}
 
 	// Destroy aggregate device if we created one
 	if (aggregateDeviceId_ != kAudioObjectUnknown) {
-		printf("[addon] Cleaning up multi-output aggregate device...\n");
+		AddonLog(LogLevel::Info, "Cleaning up multi-output aggregate device...");
 		
 		// Restore original default output device
 		AudioDeviceID originalOutput = FindDefaultOutputDevice();
@@ -1020,86 +1823,43 @@ void CoreAudioLoopbackCapture::Stop() {
 		                          &aggregateDeviceId_);
 		
 		aggregateDeviceId_ = kAudioObjectUnknown;
-		printf("[addon] Multi-output device cleaned up\n");
-	}
-
-	if (capture_thread_.joinable()) {
-		capture_thread_.join();
+		AddonLog(LogLevel::Info, "Multi-output device cleaned up");
 	}
 
-	tsfn_.Release();
-	printf("[addon] CoreAudio loopback capture stopped\n");
-	fflush(stdout);
-}
-
-// Helper functions for process enumeration (macOS equivalent)
-std::string GetProcessName(pid_t pid) {
-	char name[256];
-	size_t size = sizeof(name);
-	if (proc_name(pid, name, size) > 0) {
-		return std::string(name);
-	}
-	return "";
+	// The capture thread releases tsfn_ on its way out; releasing it again here
+	// would drop the slot pool while packets may still be queued.
+	AddonLog(LogLevel::Info, "CoreAudio loopback capture stopped");
 }
 
-std::vector<pid_t> EnumerateAllProcesses() {
-	std::vector<pid_t> pids;
-	int numberOfProcesses = proc_listpids(PROC_ALL_PIDS, 0, nullptr, 0);
-	if (numberOfProcesses <= 0) {
-		return pids;
-	}
-	
-	std::vector<pid_t> buffer(numberOfProcesses);
-	numberOfProcesses = proc_listpids(PROC_ALL_PIDS, 0, buffer.data(), (int)(buffer.size() * sizeof(pid_t)));
-	
-	pid_t currentPid = getpid();
-	for (int i = 0; i < numberOfProcesses; ++i) {
-		if (buffer[i] > 0 && buffer[i] != currentPid) {
-			pids.push_back(buffer[i]);
+// Exact name first, then up to the first '.'. With the session registry
+// running, a match that is playing audio wins over the first one listed.
+pid_t FindPidForProcess(const std::string& processName) {
+	bool exact = false;
+	const std::vector<pid_t> matches = ProcessNameCache::Instance().Matches(processName, &exact);
+	if (matches.empty()) {
+		AddonLog(LogLevel::Warn, "No process found matching '%s'", processName.c_str());
+		return 0;
+	}
+	pid_t pid = matches.front();
+	const SessionTable& sessions = AudioSessionTable();
+	if (sessions.Running()) {
+		for (pid_t match : matches) {
+			if (!sessions.Active((uint32_t)match)) continue;
+			pid = match;
+			break;
 		}
 	}
-	
-	return pids;
+	AddonLog(LogLevel::Info, "Found %s match for '%s': PID %d", exact ? "exact" : "partial", processName.c_str(), pid);
+	return pid;
 }
 
-pid_t FindPidForProcess(const std::string& processName) {
-	std::vector<pid_t> allPids = EnumerateAllProcesses();
-	
-	// Try exact match
-	for (pid_t pid : allPids) {
-		std::string name = GetProcessName(pid);
-		if (name == processName) {
-			printf("[addon] Found exact match for '%s': PID %d\n", processName.c_str(), pid);
-			fflush(stdout);
-			return pid;
-		}
-	}
-	
-	// Try partial match
-	std::string baseName = processName;
-	size_t dotPos = baseName.find('.');
-	if (dotPos != std::string::npos) {
-		baseName = baseName.substr(0, dotPos);
-	}
-	
-	for (pid_t pid : allPids) {
-		std::string name = GetProcessName(pid);
-		std::string nameBase = name;
-		dotPos = nameBase.find('.');
-		if (dotPos != std::string::npos) {
-			nameBase = nameBase.substr(0, dotPos);
-		}
-		
-		if (nameBase == baseName) {
-			printf("[addon] Found partial match for '%s': PID %d (%s)\n", processName.c_str(), pid, name.c_str());
-			fflush(stdout);
-			return pid;
-		}
-	}
-	
-	printf("[addon] No process found matching '%s'\n", processName.c_str());
-	fflush(stdout);
-	return 0;
+// The environment's default capture. Called once the capture's tsfn exists, so
+// the capture stops at teardown before Node closes the tsfn.
+CoreAudioLoopbackCapture& DefaultCapture(Napi::Env env) {
+	std::unique_ptr<CoreAudioLoopbackCapture>& capture = PerEnv<LoopbackAddon>(env).capture;
+	if (!capture) capture = std::make_unique<CoreAudioLoopbackCapture>();
+	ArmTeardown(env);
+	return *capture;
 }
 
 // N-API functions
@@ -1113,18 +1873,106 @@ Napi::Value StartCapture(const Napi::CallbackInfo& info) {
 		Napi::TypeError::New(env, "Callback required").ThrowAsJavaScriptException();
 		return env.Null();
 	}
+	CaptureOptions options;
+	if (!ReadCaptureOptionsArg(info, 2, &options)) return env.Null();
 	Napi::Function cb = info[1].As<Napi::Function>();
-	auto tsfn = Napi::ThreadSafeFunction::New(env, cb, "PCMCallback", 0, 1);
-	if (!g_capture) g_capture = std::make_unique<CoreAudioLoopbackCapture>();
-	bool ok = g_capture->Start(pid, tsfn);
+	auto tsfn = CreatePcmTsfn(env, cb, options.ChannelConfig(16000));
+	bool ok = DefaultCapture(env).Start(pid, tsfn, options);
 	return Napi::Boolean::New(env, ok);
 }
 
 Napi::Value StopCapture(const Napi::CallbackInfo& info) {
-	if (g_capture) g_capture->Stop();
+	const std::unique_ptr<CoreAudioLoopbackCapture>& capture = PerEnv<LoopbackAddon>(info.Env()).capture;
+	if (capture) capture->Stop();
 	return info.Env().Undefined();
 }
 
+// stopCaptureAsync() -> Promise<boolean>: stopCapture with the worker join
+// and AudioUnit teardown on the threadpool rather than the JS thread; resolves
+// whether a capture was running. The capture is handed to the pool, so the next startCapture gets a
+// fresh one and getStats() reads zeros until then.
+Napi::Value StopCaptureAsync(const Napi::CallbackInfo& info) {
+	return QueueQuery(info.Env(), "StopCaptureAsync",
+		[capture = std::move(PerEnv<LoopbackAddon>(info.Env()).capture)]() mutable {
+			const bool running = capture && capture->Running();
+			capture.reset(); // stops it
+			return running;
+		},
+		[](Napi::Env env, bool running) { return Napi::Boolean::New(env, running); }, TaskPriority::Interactive);
+}
+
+// Retunes the utterance chunker's minimum chunk length while capturing.
+Napi::Value SetMinChunkMs(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsNumber()) {
+		Napi::TypeError::New(env, "Minimum chunk length (ms) required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const std::unique_ptr<CoreAudioLoopbackCapture>& capture = PerEnv<LoopbackAddon>(env).capture;
+	if (capture) capture->SetMinChunkMs(info[0].As<Napi::Number>().Uint32Value());
+	return env.Undefined();
+}
+
+// Zeros before the first start.
+Napi::Object CaptureStatsToJs(Napi::Env env, const CoreAudioLoopbackCapture* capture) {
+	Napi::Object result = Napi::Object::New(env);
+	result.Set("packets", Napi::Number::New(env, capture ? (double)capture->PacketCount() : 0.0));
+	result.Set("glitches", Napi::Number::New(env, capture ? (double)capture->GlitchCount() : 0.0));
+	result.Set("ioOverruns", Napi::Number::New(env, capture ? (double)capture->IoOverruns() : 0.0));
+	result.Set("realtime", Napi::Boolean::New(env, capture ? capture->Realtime() : false));
+	result.Set("backend", Napi::String::New(env, capture ? capture->Backend() : ""));
+	// Cumulative DSP time on the worker, for comparing conversion: 'native' and 'hal-converted',
+	// or backend 'audio-unit' and 'ioproc'
+	result.Set("processingMs", Napi::Number::New(env, capture ? capture->ProcessingMs() : 0.0));
+	result.Set("filterGraphLatencyMs", Napi::Number::New(env, capture ? capture->FilterGraphLatencyMs() : 0.0f));
+	result.Set("realtimeAllocations", Napi::Number::New(env, capture ? (double)capture->RealtimeAllocations() : 0.0));
+	result.Set("formatChanges", Napi::Number::New(env, capture ? (double)capture->FormatChanges() : 0.0));
+	result.Set("selfExcluded", Napi::Boolean::New(env, capture ? capture->SelfExcluded() : false));
+	result.Set("echoReference", Napi::Boolean::New(env, capture ? capture->IsEchoReference() : false));
+	result.Set("echoErleDb", Napi::Number::New(env, capture ? capture->EchoErleDb() : 0.0f));
+	result.Set("echoDriftPpm", Napi::Number::New(env, capture ? capture->EchoDriftPpm() : 0.0f));
+	result.Set("inputFrames", Napi::Number::New(env, capture ? (double)capture->InputFrames() : 0.0));
+	result.Set("inputSampleRate", Napi::Number::New(env, capture ? capture->InputSampleRate() : 0));
+	result.Set("inputChannels", Napi::Number::New(env, capture ? capture->InputChannels() : 0));
+	result.Set("devicePeriodMs", Napi::Number::New(env, capture ? capture->DevicePeriodMs() : 0.0f));
+	result.Set("outputSamples", Napi::Number::New(env, capture ? (double)capture->OutputSamples() : 0.0));
+	result.Set("stalls", CaptureWatchdogStatsToJs(env, capture ? capture->Stalls() : CaptureWatchdogStats()));
+	result.Set("sourceSwitches", Napi::Number::New(env, capture ? (double)capture->SourceSwitches() : 0.0));
+	// p50/p99 per stage for telemetry; counts run from the start of the capture
+	Napi::Object timing = Napi::Object::New(env);
+	timing.Set("convert", LatencySummaryToJs(env, capture ? capture->ConvertTiming() : LatencySummary()));
+	timing.Set("chain", LatencySummaryToJs(env, capture ? capture->ChainTiming() : LatencySummary()));
+	timing.Set("deliver", LatencySummaryToJs(env, capture ? capture->DeliverTiming() : LatencySummary()));
+	result.Set("timing", timing);
+	if (capture && capture->Governed()) result.Set("quality", QualityStatsToJs(env, capture->Quality()));
+	if (capture && capture->Recorder()) result.Set("record", RecorderStatsToJs(env, capture->Recorder()->Stats()));
+	result.Set("threads", ThreadCpuToJs(env)); // process-wide, not just this capture's
+	result.Set("models", ModelFootprintToJs(env)); // likewise
+	result.Set("neuralVad", NeuralVadStatsToJs(env)); // the batcher all captures share
+	result.Set("memory", MemoryStatsToJs(env)); // process-wide too
+	result.Set("pool", TaskPoolStatsToJs(env)); // the addon's task pool
+	result.Set("isa", CpuIsaToJs(env)); // process-wide too
+	PcmDeliveryStats d = capture ? capture->DeliveryStats() : PcmDeliveryStats();
+	result.Set("delivery", DeliveryStatsToJs(env, d));
+	return result;
+}
+
+Napi::Value GetStats(const Napi::CallbackInfo& info) {
+	return CaptureStatsToJs(info.Env(), PerEnv<LoopbackAddon>(info.Env()).capture.get());
+}
+
+// getHistory(fromMs, toMs) on the default capture (capture_history.h)
+Napi::Value GetHistory(const Napi::CallbackInfo& info) {
+	const std::unique_ptr<CoreAudioLoopbackCapture>& capture = PerEnv<LoopbackAddon>(info.Env()).capture;
+	return QueueHistoryQuery(info, capture ? capture->History() : nullptr);
+}
+
+// deviceClockMs() -> now on the clock of captureTimeMs (option 'timestamps'):
+// host time, which the IO callbacks' mHostTime is on
+Napi::Value DeviceClockMs(const Napi::CallbackInfo& info) {
+	return Napi::Number::New(info.Env(), DeviceClockNs() / 1e6);
+}
+
 Napi::Value StartCaptureExcludeCurrent(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env();
 	if (info.Length() < 1 || !info[0].IsFunction()) {
@@ -1132,76 +1980,108 @@ Napi::Value StartCaptureExcludeCurrent(const Napi::CallbackInfo& info) {
 		return env.Null();
 	}
 	
+	CaptureOptions options;
+	if (!ReadCaptureOptionsArg(info, 1, &options)) return env.Null();
+	options.excludeSelf = true; // TTS plays from Electron helpers, not this PID
+	
 	Napi::Function cb = info[0].As<Napi::Function>();
-	auto tsfn = Napi::ThreadSafeFunction::New(env, cb, "PCMCallback", 0, 1);
+	auto tsfn = CreatePcmTsfn(env, cb, options.ChannelConfig(16000));
 	
-	if (!g_capture) g_capture = std::make_unique<CoreAudioLoopbackCapture>();
-	bool ok = g_capture->Start(0, tsfn); // PID 0 means exclude current
+	bool ok = DefaultCapture(env).Start(0, tsfn, options); // PID 0 means exclude current
 	return Napi::Boolean::New(env, ok);
 }
 
-Napi::Value StartCaptureByProcessName(const Napi::CallbackInfo& info) {
+// Arguments shared by startCaptureByProcessName and its async variant:
+// (processName, callback, options?). Empty name means system-wide.
+bool ReadStartByNameArgs(const Napi::CallbackInfo& info, std::string* processName, PcmTsfn* tsfn, CaptureOptions* options) {
 	Napi::Env env = info.Env();
 	if (info.Length() < 2) {
 		Napi::TypeError::New(env, "Process name and callback required").ThrowAsJavaScriptException();
-		return env.Null();
+		return false;
 	}
 	
-	std::string processName;
 	if (info[0].IsString()) {
-		processName = info[0].As<Napi::String>().Utf8Value();
+		*processName = info[0].As<Napi::String>().Utf8Value();
 	}
 	
 	if (!info[1].IsFunction()) {
 		Napi::TypeError::New(env, "Callback required").ThrowAsJavaScriptException();
-		return env.Null();
+		return false;
 	}
 	
-	Napi::Function cb = info[1].As<Napi::Function>();
-	auto tsfn = Napi::ThreadSafeFunction::New(env, cb, "PCMCallback", 0, 1);
+	if (!ReadCaptureOptionsArg(info, 2, options)) return false;
 	
-	uint32_t pid = 0;
+	*tsfn = CreatePcmTsfn(env, info[1].As<Napi::Function>(), options->ChannelConfig(16000));
+	return true;
+}
+
+// PID lookup half of startCaptureByProcessName; safe on a worker thread.
+uint32_t ResolveCapturePid(const std::string& processName) {
+	if (processName.empty()) return 0;
+	AddonLog(LogLevel::Info, "StartCaptureByProcessName: Looking for process '%s'", processName.c_str());
+	return (uint32_t)FindPidForProcess(processName);
+}
+
+// JS thread half: starts capture on the resolved PID, or throws when the named process wasn't found.
+Napi::Value StartResolvedCapture(Napi::Env env, const std::string& processName, uint32_t pid, PcmTsfn tsfn, const CaptureOptions& options) {
 	if (!processName.empty()) {
-		printf("[addon] StartCaptureByProcessName: Looking for process '%s'\n", processName.c_str());
-		fflush(stdout);
-		
-		pid_t foundPid = FindPidForProcess(processName);
-		if (foundPid == 0) {
+		if (pid == 0) {
 			tsfn.Release();
-			printf("[addon] StartCaptureByProcessName: Process '%s' not found\n", processName.c_str());
-			fflush(stdout);
+			AddonLog(LogLevel::Warn, "StartCaptureByProcessName: Process '%s' not found", processName.c_str());
 			Napi::Error::New(env, "Process not found: " + processName).ThrowAsJavaScriptException();
 			return env.Null();
 		}
 		
-		pid = (uint32_t)foundPid;
-		printf("[addon] StartCaptureByProcessName: Found process '%s' with PID %u, starting capture...\n", processName.c_str(), pid);
-		fflush(stdout);
+		AddonLog(LogLevel::Info, "StartCaptureByProcessName: Found process '%s' with PID %u, starting capture...", processName.c_str(), pid);
 	}
 	
-	if (!g_capture) g_capture = std::make_unique<CoreAudioLoopbackCapture>();
-	bool ok = g_capture->Start(pid, tsfn);
+	bool ok = DefaultCapture(env).Start(pid, tsfn, options);
 	
 	if (ok) {
-		printf("[addon] StartCaptureByProcessName: Capture started successfully for PID %u\n", pid);
+		AddonLog(LogLevel::Info, "StartCaptureByProcessName: Capture started successfully for PID %u", pid);
 	} else {
-		printf("[addon] StartCaptureByProcessName: Failed to start capture for PID %u\n", pid);
+		AddonLog(LogLevel::Error, "StartCaptureByProcessName: Failed to start capture for PID %u", pid);
 	}
-	fflush(stdout);
 	
 	return Napi::Boolean::New(env, ok);
 }
 
-Napi::Value EnumerateAudioSessions(const Napi::CallbackInfo& info) {
+Napi::Value StartCaptureByProcessName(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env();
-	
-	std::vector<pid_t> allPids = EnumerateAllProcesses();
-	
-	Napi::Array result = Napi::Array::New(env);
-	size_t resultIndex = 0;
-	
-	for (pid_t pid : allPids) {
-		std::string processName = GetProcessName(pid);
+	std::string processName;
+	PcmTsfn tsfn;
+	CaptureOptions options;
+	if (!ReadStartByNameArgs(info, &processName, &tsfn, &options)) return env.Null();
+	return StartResolvedCapture(env, processName, ResolveCapturePid(processName), tsfn, options);
+}
+
+// startCaptureByProcessNameAsync(name, callback, options?) -> Promise<boolean>;
+// the PID lookup runs on the threadpool, capture starts back on the JS thread.
+Napi::Value StartCaptureByProcessNameAsync(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::string processName;
+	PcmTsfn tsfn;
+	CaptureOptions options;
+	if (!ReadStartByNameArgs(info, &processName, &tsfn, &options)) return env.Null();
+	return QueueQuery(env, "StartCaptureByProcessName",
+		[processName] { return ResolveCapturePid(processName); },
+		[processName, tsfn, options](Napi::Env env, uint32_t pid) {
+			return StartResolvedCapture(env, processName, pid, tsfn, options);
+		}, TaskPriority::Interactive);
+}
+
+// Running processes (for app selection). Plain data, so it can run on a worker thread.
+std::vector<AudioSessionRow> CollectAudioSessions() {
+	const std::vector<ProcessNameCache::Entry> processes = ProcessNameCache::Instance().Processes();
+	// With the session registry running, activity comes from the HAL's process objects
+	const SessionTable& sessions = AudioSessionTable();
+	const bool tracked = sessions.Running();
+	
+	std::vector<AudioSessionRow> rows;
+	rows.reserve(processes.size());
+	for (const ProcessNameCache::Entry& process : processes) {
+		const pid_t pid = process.pid;
+		const std::string& processName = process.name;
 		if (processName.empty()) continue;
 		
 		// Filter out system processes
@@ -1211,14 +2091,18 @@ Napi::Value EnumerateAudioSessions(const Napi::CallbackInfo& info) {
 			continue;
 		}
 		
-		Napi::Object session = Napi::Object::New(env);
-		session.Set("pid", Napi::Number::New(env, pid));
-		session.Set("processName", Napi::String::New(env, processName));
-		session.Set("hasActiveAudio", Napi::Boolean::New(env, false)); // macOS doesn't have equivalent
-		result[resultIndex++] = session;
+		rows.push_back(AudioSessionRow{ (uint32_t)pid, processName, tracked && sessions.Active((uint32_t)pid) });
 	}
-	
-	return result;
+	return rows;
+}
+
+Napi::Value EnumerateAudioSessions(const Napi::CallbackInfo& info) {
+	return AudioSessionRowsToJs(info.Env(), CollectAudioSessions());
+}
+
+// enumerateAudioSessionsAsync() -> Promise of the same array, built on the threadpool
+Napi::Value EnumerateAudioSessionsAsync(const Napi::CallbackInfo& info) {
+	return QueueQuery(info.Env(), "EnumerateAudioSessions", CollectAudioSessions, AudioSessionRowsToJs, TaskPriority::Interactive);
 }
 
 Napi::Value FindAudioPidForProcess(const Napi::CallbackInfo& info) {
@@ -1234,18 +2118,45 @@ Napi::Value FindAudioPidForProcess(const Napi::CallbackInfo& info) {
 	return Napi::Number::New(env, pid);
 }
 
+// findAudioPidForProcessAsync(name) -> Promise<number>
+Napi::Value FindAudioPidForProcessAsync(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Process name required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	std::string processName = info[0].As<Napi::String>().Utf8Value();
+	return QueueQuery(env, "FindAudioPidForProcess",
+		[processName] { return FindPidForProcess(processName); },
+		[](Napi::Env env, pid_t pid) { return Napi::Number::New(env, pid); }, TaskPriority::Interactive);
+}
+
 Napi::Value ResolvePidFromWindow(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env();
 	// macOS doesn't have HWND equivalent, return 0
 	return Napi::Number::New(env, 0);
 }
 
-// Store original system output device
-static AudioDeviceID g_originalOutputDevice = kAudioDeviceUnknown;
-
-Napi::Value SetSystemOutputToBlackHole(const Napi::CallbackInfo& info) {
+// Batch form of the above for API parity: one { pid: 0, processName: '' } per handle
+Napi::Value ResolvePidsFromWindows(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env();
-	
+	const uint32_t count = info.Length() > 0 && info[0].IsArray() ? info[0].As<Napi::Array>().Length() : 0;
+	Napi::Array result = Napi::Array::New(env, count);
+	for (uint32_t i = 0; i < count; ++i) {
+		Napi::Object owner = Napi::Object::New(env);
+		owner.Set("pid", Napi::Number::New(env, 0));
+		owner.Set("processName", Napi::String::New(env, ""));
+		result.Set(i, owner);
+	}
+	return result;
+}
+
+// The system output BlackHole replaced. The default output is one per
+// machine, so this stays process-wide; any environment may set or restore it.
+static std::atomic<AudioDeviceID> g_originalOutputDevice{kAudioDeviceUnknown};
+
+// Any thread: makes BlackHole the default output, remembering the one it replaces.
+static bool RouteSystemOutputToBlackHole() {
 	// Get current default output device
 	UInt32 propertySize = sizeof(AudioDeviceID);
 	AudioObjectPropertyAddress propertyAddress = {
@@ -1254,22 +2165,24 @@ Napi::Value SetSystemOutputToBlackHole(const Napi::CallbackInfo& info) {
 		kAudioObjectPropertyElementMain
 	};
 	
+	AudioDeviceID originalDevice = kAudioDeviceUnknown;
 	OSStatus status = AudioObjectGetPropertyData(kAudioObjectSystemObject,
 	                                            &propertyAddress,
 	                                            0,
 	                                            nullptr,
 	                                            &propertySize,
-	                                            &g_originalOutputDevice);
+	                                            &originalDevice);
 	if (status != noErr) {
-		printf("[addon] Failed to get current output device\n");
-		return Napi::Boolean::New(env, false);
+		AddonLog(LogLevel::Error, "Failed to get current output device");
+		return false;
 	}
+	g_originalOutputDevice = originalDevice;
 	
 	// Find BlackHole output device
 	AudioDeviceID blackHoleOutput = FindBlackHoleOutputDevice();
 	if (blackHoleOutput == kAudioDeviceUnknown) {
-		printf("[addon] BlackHole output device not found\n");
-		return Napi::Boolean::New(env, false);
+		AddonLog(LogLevel::Warn, "BlackHole output device not found");
+		return false;
 	}
 	
 	// Set BlackHole as default output device
@@ -1281,20 +2194,20 @@ Napi::Value SetSystemOutputToBlackHole(const Napi::CallbackInfo& info) {
 	                                   propertySize,
 	                                   &blackHoleOutput);
 	if (status != noErr) {
-		printf("[addon] Failed to set BlackHole as output device: %d\n", (int)status);
-		return Napi::Boolean::New(env, false);
+		AddonLog(LogLevel::Error, "Failed to set BlackHole as output device: %d", (int)status);
+		return false;
 	}
 	
-	printf("[addon] System output changed to BlackHole (original saved)\n");
-	return Napi::Boolean::New(env, true);
+	AddonLog(LogLevel::Info, "System output changed to BlackHole (original saved)");
+	return true;
 }
 
-Napi::Value RestoreSystemOutput(const Napi::CallbackInfo& info) {
-	Napi::Env env = info.Env();
-	
-	if (g_originalOutputDevice == kAudioDeviceUnknown) {
-		printf("[addon] No original output device to restore\n");
-		return Napi::Boolean::New(env, false);
+// Any thread: puts back the default output RouteSystemOutputToBlackHole replaced.
+static bool RestoreOriginalOutput() {
+	AudioDeviceID originalDevice = g_originalOutputDevice;
+	if (originalDevice == kAudioDeviceUnknown) {
+		AddonLog(LogLevel::Info, "No original output device to restore");
+		return false;
 	}
 	
 	UInt32 propertySize = sizeof(AudioDeviceID);
@@ -1309,15 +2222,107 @@ Napi::Value RestoreSystemOutput(const Napi::CallbackInfo& info) {
 	                                            0,
 	                                            nullptr,
 	                                            propertySize,
-	                                            &g_originalOutputDevice);
+	                                            &originalDevice);
 	if (status != noErr) {
-		printf("[addon] Failed to restore original output device: %d\n", (int)status);
-		return Napi::Boolean::New(env, false);
+		AddonLog(LogLevel::Error, "Failed to restore original output device: %d", (int)status);
+		return false;
 	}
 	
-	printf("[addon] System output restored to original device\n");
-	g_originalOutputDevice = kAudioDeviceUnknown; // Clear after restore
-	return Napi::Boolean::New(env, true);
+	AddonLog(LogLevel::Info, "System output restored to original device");
+	g_originalOutputDevice.compare_exchange_strong(originalDevice, kAudioDeviceUnknown); // Clear after restore
+	return true;
+}
+
+Napi::Value SetSystemOutputToBlackHole(const Napi::CallbackInfo& info) {
+	return Napi::Boolean::New(info.Env(), RouteSystemOutputToBlackHole());
+}
+
+Napi::Value RestoreSystemOutput(const Napi::CallbackInfo& info) {
+	return Napi::Boolean::New(info.Env(), RestoreOriginalOutput());
+}
+
+struct TimedSwitch {
+	bool success = false;
+	double elapsedMs = 0.0;
+};
+
+// Runs a default-device switch on the threadpool: the HAL can take hundreds of
+// ms to reroute, which froze the setup UI. Resolves { success, elapsedMs }.
+static Napi::Value QueueTimedSwitch(Napi::Env env, const char* name, bool (*change)()) {
+	return QueueQuery(env, name,
+		[change]() {
+			const auto begin = std::chrono::steady_clock::now();
+			TimedSwitch result;
+			result.success = change();
+			result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+			return result;
+		},
+		[](Napi::Env env, TimedSwitch& result) -> Napi::Value {
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("success", Napi::Boolean::New(env, result.success));
+			o.Set("elapsedMs", Napi::Number::New(env, result.elapsedMs));
+			return o;
+		});
+}
+
+// setSystemOutputToBlackHoleAsync() / restoreSystemOutputAsync() -> Promise<{ success, elapsedMs }>
+Napi::Value SetSystemOutputToBlackHoleAsync(const Napi::CallbackInfo& info) {
+	return QueueTimedSwitch(info.Env(), "SetSystemOutputToBlackHole", RouteSystemOutputToBlackHole);
+}
+
+Napi::Value RestoreSystemOutputAsync(const Napi::CallbackInfo& info) {
+	return QueueTimedSwitch(info.Env(), "RestoreSystemOutput", RestoreOriginalOutput);
+}
+
+struct MultiOutputProvision {
+	AudioDeviceID id = kAudioDeviceUnknown;
+	bool created = false;
+	double elapsedMs = 0.0;
+};
+
+// Threadpool: the multi-output device over the real speakers and BlackHole.
+// One already made (by an earlier call in this process) is found through the
+// device registry and reused rather than created again. The speakers are the
+// output BlackHole replaced, if it did, else the default output.
+static MultiOutputProvision ProvisionMultiOutputDevice() {
+	const auto begin = std::chrono::steady_clock::now();
+	MultiOutputProvision result;
+	DeviceRegistry& registry = DeviceRegistry::Instance();
+	AudioDeviceInfo device;
+	if (registry.FindByUid(kMultiOutputUid, &device)) {
+		result.id = device.id;
+	} else {
+		AudioDeviceID speakers = g_originalOutputDevice;
+		if (speakers == kAudioDeviceUnknown) speakers = registry.DefaultOutput();
+		const AudioDeviceID blackHole = FindBlackHoleOutputDevice();
+		if (blackHole == kAudioDeviceUnknown) {
+			AddonLog(LogLevel::Warn, "Cannot create the multi-output device: BlackHole not found");
+		} else if (!registry.FindById(speakers, &device) || device.NameContains("blackhole")) {
+			AddonLog(LogLevel::Warn, "Cannot create the multi-output device: no real output device to pair BlackHole with");
+		} else {
+			result.id = CreateMultiOutputDevice(speakers, blackHole);
+			result.created = result.id != kAudioDeviceUnknown;
+			if (result.created) registry.Invalidate();
+		}
+	}
+	result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+	if (result.id != kAudioDeviceUnknown) {
+		AddonLog(LogLevel::Info, "Multi-output device %u %s in %.1f ms", result.id, result.created ? "created" : "reused", result.elapsedMs);
+	}
+	return result;
+}
+
+// provisionMultiOutputAsync() -> Promise<{ deviceId, created, elapsedMs } | null>
+Napi::Value ProvisionMultiOutputAsync(const Napi::CallbackInfo& info) {
+	return QueueQuery(info.Env(), "ProvisionMultiOutput", ProvisionMultiOutputDevice,
+		[](Napi::Env env, MultiOutputProvision& result) -> Napi::Value {
+			if (result.id == kAudioDeviceUnknown) return env.Null();
+			Napi::Object o = Napi::Object::New(env);
+			o.Set("deviceId", Napi::String::New(env, std::to_string(result.id)));
+			o.Set("created", Napi::Boolean::New(env, result.created));
+			o.Set("elapsedMs", Napi::Number::New(env, result.elapsedMs));
+			return o;
+		}, TaskPriority::Interactive);
 }
 
 Napi::Value GetRealOutputDevice(const Napi::CallbackInfo& info) {
@@ -1326,55 +2331,17 @@ Napi::Value GetRealOutputDevice(const Napi::CallbackInfo& info) {
 	// Return the original output device ID (or current if not changed)
 	AudioDeviceID currentDevice = g_originalOutputDevice;
 	if (currentDevice == kAudioDeviceUnknown) {
-		// Get current default output device
-		UInt32 propertySize = sizeof(AudioDeviceID);
-		AudioObjectPropertyAddress propertyAddress = {
-			kAudioHardwarePropertyDefaultOutputDevice,
-			kAudioObjectPropertyScopeGlobal,
-			kAudioObjectPropertyElementMain
-		};
-		
-		OSStatus status = AudioObjectGetPropertyData(kAudioObjectSystemObject,
-		                                            &propertyAddress,
-		                                            0,
-		                                            nullptr,
-		                                            &propertySize,
-		                                            &currentDevice);
-		if (status != noErr) {
+		currentDevice = DeviceRegistry::Instance().DefaultOutput();
+		if (currentDevice == kAudioDeviceUnknown) {
 			return env.Null();
 		}
 	}
 	
-	// Get device name for identification
-	CFStringRef deviceName = nullptr;
-	UInt32 propertySize = sizeof(CFStringRef);
-	AudioObjectPropertyAddress propertyAddress = {
-		kAudioDevicePropertyDeviceNameCFString,
-		kAudioObjectPropertyScopeOutput,
-		kAudioObjectPropertyElementMain
-	};
-	
-	OSStatus status = AudioObjectGetPropertyData(currentDevice,
-	                                            &propertyAddress,
-	                                            0,
-	                                            nullptr,
-	                                            &propertySize,
-	                                            &deviceName);
-	if (status == noErr && deviceName) {
-		char nameBuffer[256];
-		if (CFStringGetCString(deviceName, nameBuffer, sizeof(nameBuffer), kCFStringEncodingUTF8)) {
-			std::string name(nameBuffer);
-			std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-			// If it's BlackHole, we need to find the real device
-			if (name.find("blackhole") != std::string::npos) {
-				CFRelease(deviceName);
-				// Return null - caller should use default device
-				return env.Null();
-			}
-			CFRelease(deviceName);
-		} else {
-			CFRelease(deviceName);
-		}
+	// If it's BlackHole, we need to find the real device
+	AudioDeviceInfo device;
+	if (DeviceRegistry::Instance().FindById(currentDevice, &device) && device.NameContains("blackhole")) {
+		// Return null - caller should use default device
+		return env.Null();
 	}
 	
 	// Return device ID as string (we'll use it to find the device in JS)
@@ -1403,56 +2370,186 @@ Napi::Value CheckMultiOutputSetup(const Napi::CallbackInfo& info) {
 		return result;
 	}
 	
-	// Get device name
-	CFStringRef deviceName = nullptr;
-	UInt32 propertySize = sizeof(CFStringRef);
-	AudioObjectPropertyAddress propertyAddress = {
-		kAudioDevicePropertyDeviceNameCFString,
-		kAudioObjectPropertyScopeOutput,
-		kAudioObjectPropertyElementMain
-	};
-	
-	OSStatus status = AudioObjectGetPropertyData(defaultOutput, &propertyAddress, 0, nullptr, &propertySize, &deviceName);
-	if (status == noErr && deviceName) {
-		char nameBuffer[256];
-		if (CFStringGetCString(deviceName, nameBuffer, sizeof(nameBuffer), kCFStringEncodingUTF8)) {
-			std::string name(nameBuffer);
-			result.Set("defaultOutputName", Napi::String::New(env, name));
-			
-			std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-			
-			// Check if it's a multi-output device
-			bool isMultiOutput = (name.find("multi") != std::string::npos || 
-			                     name.find("aggregate") != std::string::npos);
-			
-			result.Set("isConfigured", Napi::Boolean::New(env, isMultiOutput));
-			
-			if (isMultiOutput) {
-				result.Set("message", Napi::String::New(env, "Multi-Output device detected - setup is correct!"));
-			} else if (defaultOutput == blackHole) {
-				result.Set("message", Napi::String::New(env, "Default output is BlackHole - you won't hear audio. Please create a Multi-Output Device."));
-			} else {
-				result.Set("message", Napi::String::New(env, "Please create a Multi-Output Device in Audio MIDI Setup with your speakers and BlackHole 2ch, then set it as default output."));
-			}
+	AudioDeviceInfo device;
+	if (DeviceRegistry::Instance().FindById(defaultOutput, &device)) {
+		result.Set("defaultOutputName", Napi::String::New(env, device.name));
+		
+		// Check if it's a multi-output device
+		bool isMultiOutput = device.NameContains("multi") || device.NameContains("aggregate");
+		
+		result.Set("isConfigured", Napi::Boolean::New(env, isMultiOutput));
+		
+		if (isMultiOutput) {
+			result.Set("message", Napi::String::New(env, "Multi-Output device detected - setup is correct!"));
+		} else if (defaultOutput == blackHole) {
+			result.Set("message", Napi::String::New(env, "Default output is BlackHole - you won't hear audio. Please create a Multi-Output Device."));
+		} else {
+			result.Set("message", Napi::String::New(env, "Please create a Multi-Output Device in Audio MIDI Setup with your speakers and BlackHole 2ch, then set it as default output."));
 		}
-		CFRelease(deviceName);
 	}
 	
 	return result;
 }
 
+// Every CoreAudio device from the cached registry.
+Napi::Value ListDevices(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	DeviceRegistry& registry = DeviceRegistry::Instance();
+	std::shared_ptr<const DeviceRegistry::DeviceList> devices = registry.Devices();
+	const AudioDeviceID defaultOutput = registry.DefaultOutput();
+	const AudioDeviceID defaultInput = registry.DefaultInput();
+	Napi::Array result = Napi::Array::New(env, devices->size());
+	for (size_t i = 0; i < devices->size(); ++i) {
+		const AudioDeviceInfo& d = (*devices)[i];
+		Napi::Object o = Napi::Object::New(env);
+		o.Set("id", Napi::Number::New(env, d.id));
+		o.Set("uid", Napi::String::New(env, d.uid));
+		o.Set("name", Napi::String::New(env, d.name));
+		o.Set("inputChannels", Napi::Number::New(env, d.inputChannels));
+		o.Set("outputChannels", Napi::Number::New(env, d.outputChannels));
+		o.Set("sampleRate", Napi::Number::New(env, d.sampleRate));
+		Napi::Array rates = Napi::Array::New(env, d.sampleRates.size());
+		for (size_t r = 0; r < d.sampleRates.size(); ++r) rates.Set((uint32_t)r, Napi::Number::New(env, d.sampleRates[r]));
+		o.Set("sampleRates", rates);
+		o.Set("isDefaultOutput", Napi::Boolean::New(env, d.id == defaultOutput));
+		o.Set("isDefaultInput", Napi::Boolean::New(env, d.id == defaultInput));
+		result.Set((uint32_t)i, o);
+	}
+	return result;
+}
+
+// startSoundboardOutput({ micDevice?, monitor? }) -> { mic, monitor }; micDevice
+// defaults to BlackHole, the virtual mic the setup checks look for
+Napi::Value StartSoundboardOutput(const Napi::CallbackInfo& info) {
+	return StartSoundboardOutputs(info, PerEnv<LoopbackAddon>(info.Env()).soundboardOutputs, "blackhole");
+}
+
+Napi::Value StopSoundboardOutput(const Napi::CallbackInfo& info) {
+	for (SoundboardOutput& output : PerEnv<LoopbackAddon>(info.Env()).soundboardOutputs) output.Stop();
+	return info.Env().Undefined();
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
+	// Slots go last-created first: the outputs render this environment's soundboard buses
+	Soundboard(env);
+	PerEnv<LoopbackAddon>(env);
+	Cpu(); // kernel ISA detected at load, not on the first stream's thread
 	exports.Set("startCapture", Napi::Function::New(env, StartCapture));
 	exports.Set("stopCapture", Napi::Function::New(env, StopCapture));
+	exports.Set("stopCaptureAsync", Napi::Function::New(env, StopCaptureAsync));
+	exports.Set("getStats", Napi::Function::New(env, GetStats));
+	exports.Set("getHistory", Napi::Function::New(env, GetHistory));
+	exports.Set("deviceClockMs", Napi::Function::New(env, DeviceClockMs));
+	exports.Set("setMinChunkMs", Napi::Function::New(env, SetMinChunkMs));
+	CaptureSessionWrap<CoreAudioLoopbackCapture, CaptureStatsToJs>::Init(env, exports);
+	DeliveryStressWrap::Init(env, exports);
+	RegionCaptureWrap<ScreenRegionGrabber>::Init(env, exports);
+	TextStabilizerWrap::Init(env, exports);
+	SubtitleTrackerWrap::Init(env, exports);
+	exports.Set("watchLevels", Napi::Function::New(env, WatchLevels));
+	exports.Set("unwatchLevels", Napi::Function::New(env, UnwatchLevels));
+	exports.Set("subscribeEvents", Napi::Function::New(env, SubscribeEvents));
+	exports.Set("unsubscribeEvents", Napi::Function::New(env, UnsubscribeEvents));
+	exports.Set("setVoiceBoostEnabled", Napi::Function::New(env, SetVoiceBoostEnabled));
+	exports.Set("setVoiceBoostLevel", Napi::Function::New(env, SetVoiceBoostLevel));
+	exports.Set("setProcessingParams", Napi::Function::New(env, SetProcessingParams));
+	exports.Set("dspResample", Napi::Function::New(env, DspResample));
+	exports.Set("dspFilter", Napi::Function::New(env, DspFilter));
+	exports.Set("dspGate", Napi::Function::New(env, DspGate));
+	exports.Set("dspNormalize", Napi::Function::New(env, DspNormalize));
+	exports.Set("dspMeasure", Napi::Function::New(env, DspMeasure));
+	exports.Set("dspInt16ToFloat", Napi::Function::New(env, DspInt16ToFloat));
+	exports.Set("dspFloatToInt16", Napi::Function::New(env, DspFloatToInt16));
+	exports.Set("encodeOpus", Napi::Function::New(env, EncodeOpus));
+	exports.Set("encodeFlac", Napi::Function::New(env, EncodeFlac));
+	exports.Set("encodeAudio", Napi::Function::New(env, EncodeAudio));
+	exports.Set("reportUploadThroughput", Napi::Function::New(env, ReportUploadThroughput));
+	exports.Set("uploadTranscription", Napi::Function::New(env, UploadTranscription));
+	exports.Set("getUploadRate", Napi::Function::New(env, GetUploadRate));
+	exports.Set("evaluateDsp", Napi::Function::New(env, EvaluateDsp));
+	exports.Set("transcribeMedia", Napi::Function::New(env, TranscribeMedia));
+	exports.Set("openStreamDecoder", Napi::Function::New(env, OpenStreamDecoder));
+	exports.Set("feedStreamDecoder", Napi::Function::New(env, FeedStreamDecoder));
+	exports.Set("closeStreamDecoder", Napi::Function::New(env, CloseStreamDecoder));
+	exports.Set("probeSoundClip", Napi::Function::New(env, ProbeSoundClip));
+	exports.Set("loadSoundClip", Napi::Function::New(env, LoadSoundClip));
+	exports.Set("unloadSoundClip", Napi::Function::New(env, UnloadSoundClip));
+	exports.Set("playSoundClip", Napi::Function::New(env, PlaySoundClip));
+	exports.Set("stopSoundClip", Napi::Function::New(env, StopSoundClip));
+	exports.Set("isSoundClipPlaying", Napi::Function::New(env, IsSoundClipPlaying));
+	exports.Set("setSoundboardVolumes", Napi::Function::New(env, SetSoundboardVolumes));
+	exports.Set("startSoundboardOutput", Napi::Function::New(env, StartSoundboardOutput));
+	exports.Set("stopSoundboardOutput", Napi::Function::New(env, StopSoundboardOutput));
+	RenderSessionWrap<SoundboardOutput>::Init(env, exports, "blackhole");
+	exports.Set("loadWhisperModel", Napi::Function::New(env, LoadWhisperModel));
+	exports.Set("transcribeWhisper", Napi::Function::New(env, TranscribeWhisper));
+	exports.Set("unloadWhisperModel", Napi::Function::New(env, UnloadWhisperModel));
+	exports.Set("getWhisperSchedulerStats", Napi::Function::New(env, GetWhisperSchedulerStats));
+	exports.Set("listWhisperBackends", Napi::Function::New(env, ListWhisperBackends));
+	exports.Set("benchmarkWhisper", Napi::Function::New(env, BenchmarkWhisper));
+	exports.Set("openWhisperStream", Napi::Function::New(env, OpenWhisperStream));
+	exports.Set("feedWhisperStream", Napi::Function::New(env, FeedWhisperStream));
+	exports.Set("flushWhisperStream", Napi::Function::New(env, FlushWhisperStream));
+	exports.Set("closeWhisperStream", Napi::Function::New(env, CloseWhisperStream));
+	exports.Set("loadTranslationModel", Napi::Function::New(env, LoadTranslationModel));
+	exports.Set("translateTexts", Napi::Function::New(env, TranslateTexts));
+	exports.Set("translatePartial", Napi::Function::New(env, TranslatePartial));
+	exports.Set("unloadTranslationModels", Napi::Function::New(env, UnloadTranslationModels));
+	exports.Set("getTranslationModels", Napi::Function::New(env, GetTranslationModels));
+	exports.Set("loadOcrEngine", Napi::Function::New(env, LoadOcrEngine));
+	exports.Set("recognizeOcr", Napi::Function::New(env, RecognizeOcr));
+	exports.Set("unloadOcrEngine", Napi::Function::New(env, UnloadOcrEngine));
+	exports.Set("loadPaddleOcr", Napi::Function::New(env, LoadPaddleOcr));
+	exports.Set("recognizePaddleOcr", Napi::Function::New(env, RecognizePaddleOcr));
+	exports.Set("unloadPaddleOcr", Napi::Function::New(env, UnloadPaddleOcr));
+	exports.Set("loadTtsVoice", Napi::Function::New(env, LoadTtsVoice));
+	exports.Set("synthesizeSpeech", Napi::Function::New(env, SynthesizeSpeech));
+	exports.Set("unloadTtsVoices", Napi::Function::New(env, UnloadTtsVoices));
+	exports.Set("getTtsVoices", Napi::Function::New(env, GetTtsVoices));
+	exports.Set("openAudioRing", Napi::Function::New(env, OpenAudioRing));
+	exports.Set("writeAudioRing", Napi::Function::New(env, WriteAudioRing));
+	exports.Set("writeImageRing", Napi::Function::New(env, WriteImageRing));
+	exports.Set("writeMessageRing", Napi::Function::New(env, WriteMessageRing));
+	exports.Set("closeAudioRing", Napi::Function::New(env, CloseAudioRing));
+	exports.Set("attachAudioRing", Napi::Function::New(env, AttachAudioRing));
+	exports.Set("readAudioRing", Napi::Function::New(env, ReadAudioRing));
+	exports.Set("detachAudioRing", Napi::Function::New(env, DetachAudioRing));
+	exports.Set("openTtsCache", Napi::Function::New(env, OpenTtsCache));
+	exports.Set("getTtsCache", Napi::Function::New(env, GetTtsCache));
+	exports.Set("putTtsCache", Napi::Function::New(env, PutTtsCache));
+	exports.Set("closeTtsCache", Napi::Function::New(env, CloseTtsCache));
+	exports.Set("addFuzzyText", Napi::Function::New(env, AddFuzzyText));
+	exports.Set("removeFuzzyText", Napi::Function::New(env, RemoveFuzzyText));
+	exports.Set("findFuzzyText", Napi::Function::New(env, FindFuzzyText));
+	exports.Set("clearFuzzyText", Napi::Function::New(env, ClearFuzzyText));
+	exports.Set("subscribe", Napi::Function::New(env, Subscribe));
+	exports.Set("unsubscribe", Napi::Function::New(env, Unsubscribe));
+	exports.Set("createPipeline", Napi::Function::New(env, CreatePipeline));
+	exports.Set("destroyPipeline", Napi::Function::New(env, DestroyPipeline));
+	exports.Set("getLogs", Napi::Function::New(env, GetLogs));
+	exports.Set("getThreadStats", Napi::Function::New(env, GetThreadStats));
+	exports.Set("setLogLevel", Napi::Function::New(env, SetLogLevel));
 	exports.Set("startCaptureByProcessName", Napi::Function::New(env, StartCaptureByProcessName));
 	exports.Set("startCaptureExcludeCurrent", Napi::Function::New(env, StartCaptureExcludeCurrent));
 	exports.Set("enumerateAudioSessions", Napi::Function::New(env, EnumerateAudioSessions));
 	exports.Set("findAudioPidForProcess", Napi::Function::New(env, FindAudioPidForProcess));
+	exports.Set("enumerateAudioSessionsAsync", Napi::Function::New(env, EnumerateAudioSessionsAsync));
+	exports.Set("findAudioPidForProcessAsync", Napi::Function::New(env, FindAudioPidForProcessAsync));
+	exports.Set("startCaptureByProcessNameAsync", Napi::Function::New(env, StartCaptureByProcessNameAsync));
 	exports.Set("resolvePidFromWindow", Napi::Function::New(env, ResolvePidFromWindow));
+	exports.Set("resolvePidsFromWindows", Napi::Function::New(env, ResolvePidsFromWindows));
 	exports.Set("setSystemOutputToBlackHole", Napi::Function::New(env, SetSystemOutputToBlackHole));
 	exports.Set("restoreSystemOutput", Napi::Function::New(env, RestoreSystemOutput));
+	exports.Set("setSystemOutputToBlackHoleAsync", Napi::Function::New(env, SetSystemOutputToBlackHoleAsync));
+	exports.Set("restoreSystemOutputAsync", Napi::Function::New(env, RestoreSystemOutputAsync));
+	exports.Set("provisionMultiOutputAsync", Napi::Function::New(env, ProvisionMultiOutputAsync));
 	exports.Set("getRealOutputDevice", Napi::Function::New(env, GetRealOutputDevice));
 	exports.Set("checkMultiOutputSetup", Napi::Function::New(env, CheckMultiOutputSetup));
+	exports.Set("listDevices", Napi::Function::New(env, ListDevices));
+	exports.Set("watchAudioSessions", Napi::Function::New(env, WatchAudioSessions));
+	exports.Set("unwatchAudioSessions", Napi::Function::New(env, UnwatchAudioSessions));
+	exports.Set("getAudioSessions", Napi::Function::New(env, GetAudioSessions));
+	exports.Set("getSessionLevels", Napi::Function::New(env, GetSessionLevels));
 	return exports;
 }
 
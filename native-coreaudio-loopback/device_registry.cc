@@ -0,0 +1,185 @@
+#include "device_registry.h"
+
+#include <CoreFoundation/CoreFoundation.h>
+
+#include <algorithm>
+#include <cctype>
+
+#include "addon_log.h"
+
+namespace {
+
+const AudioObjectPropertyAddress kDevicesAddress = {
+	kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain
+};
+const AudioObjectPropertyAddress kDefaultOutputAddress = {
+	kAudioHardwarePropertyDefaultOutputDevice, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain
+};
+const AudioObjectPropertyAddress kDefaultInputAddress = {
+	kAudioHardwarePropertyDefaultInputDevice, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain
+};
+const AudioObjectPropertyAddress kSampleRateAddress = {
+	kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain
+};
+
+std::string StringProperty(AudioObjectID object, AudioObjectPropertySelector selector) {
+	AudioObjectPropertyAddress address = { selector, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain };
+	CFStringRef value = nullptr;
+	UInt32 size = sizeof(value);
+	if (AudioObjectGetPropertyData(object, &address, 0, nullptr, &size, &value) != noErr || !value) return std::string();
+	char buffer[256];
+	std::string result;
+	if (CFStringGetCString(value, buffer, sizeof(buffer), kCFStringEncodingUTF8)) result = buffer;
+	CFRelease(value);
+	return result;
+}
+
+UInt32 ChannelCount(AudioObjectID object, AudioObjectPropertyScope scope) {
+	AudioObjectPropertyAddress address = { kAudioDevicePropertyStreamConfiguration, scope, kAudioObjectPropertyElementMain };
+	UInt32 size = 0;
+	if (AudioObjectGetPropertyDataSize(object, &address, 0, nullptr, &size) != noErr || size == 0) return 0;
+	std::vector<uint8_t> storage(size);
+	AudioBufferList* list = reinterpret_cast<AudioBufferList*>(storage.data());
+	if (AudioObjectGetPropertyData(object, &address, 0, nullptr, &size, list) != noErr) return 0;
+	UInt32 channels = 0;
+	for (UInt32 i = 0; i < list->mNumberBuffers; ++i) channels += list->mBuffers[i].mNumberChannels;
+	return channels;
+}
+
+AudioDeviceID DefaultDevice(const AudioObjectPropertyAddress& address) {
+	AudioDeviceID device = kAudioObjectUnknown;
+	UInt32 size = sizeof(device);
+	if (AudioObjectGetPropertyData(kAudioObjectSystemObject, &address, 0, nullptr, &size, &device) != noErr) return kAudioObjectUnknown;
+	return device;
+}
+
+AudioDeviceInfo ReadDevice(AudioDeviceID id) {
+	AudioDeviceInfo info;
+	info.id = id;
+	info.uid = StringProperty(id, kAudioDevicePropertyDeviceUID);
+	info.name = StringProperty(id, kAudioObjectPropertyName);
+	info.lowerName = info.name;
+	std::transform(info.lowerName.begin(), info.lowerName.end(), info.lowerName.begin(), ::tolower);
+	info.inputChannels = ChannelCount(id, kAudioObjectPropertyScopeInput);
+	info.outputChannels = ChannelCount(id, kAudioObjectPropertyScopeOutput);
+
+	UInt32 size = sizeof(info.sampleRate);
+	AudioObjectGetPropertyData(id, &kSampleRateAddress, 0, nullptr, &size, &info.sampleRate);
+
+	AudioObjectPropertyAddress address = {
+		kAudioDevicePropertyAvailableNominalSampleRates, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain
+	};
+	size = 0;
+	if (AudioObjectGetPropertyDataSize(id, &address, 0, nullptr, &size) == noErr && size > 0) {
+		std::vector<AudioValueRange> ranges(size / sizeof(AudioValueRange));
+		if (AudioObjectGetPropertyData(id, &address, 0, nullptr, &size, ranges.data()) == noErr) {
+			for (const AudioValueRange& r : ranges) {
+				info.sampleRates.push_back(r.mMinimum);
+				if (r.mMaximum != r.mMinimum) info.sampleRates.push_back(r.mMaximum);
+			}
+		}
+	}
+	return info;
+}
+
+} // namespace
+
+DeviceRegistry& DeviceRegistry::Instance() {
+	static DeviceRegistry registry;
+	return registry;
+}
+
+// HAL notification thread: anything we cache may be stale now.
+OSStatus DeviceRegistry::Changed(AudioObjectID, UInt32, const AudioObjectPropertyAddress*, void* context) {
+	static_cast<DeviceRegistry*>(context)->Invalidate();
+	return noErr;
+}
+
+std::shared_ptr<const DeviceRegistry::DeviceList> DeviceRegistry::Devices() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (dirty_.exchange(false, std::memory_order_acq_rel) || !devices_) RebuildLocked();
+	return devices_;
+}
+
+AudioDeviceID DeviceRegistry::DefaultOutput() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (dirty_.exchange(false, std::memory_order_acq_rel) || !devices_) RebuildLocked();
+	return defaultOutput_;
+}
+
+AudioDeviceID DeviceRegistry::DefaultInput() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (dirty_.exchange(false, std::memory_order_acq_rel) || !devices_) RebuildLocked();
+	return defaultInput_;
+}
+
+bool DeviceRegistry::FindById(AudioDeviceID id, AudioDeviceInfo* info) {
+	std::shared_ptr<const DeviceList> devices = Devices();
+	for (const AudioDeviceInfo& d : *devices) {
+		if (d.id != id) continue;
+		*info = d;
+		return true;
+	}
+	return false;
+}
+
+bool DeviceRegistry::FindByUid(const std::string& uid, AudioDeviceInfo* info) {
+	std::shared_ptr<const DeviceList> devices = Devices();
+	for (const AudioDeviceInfo& d : *devices) {
+		if (d.uid != uid) continue;
+		*info = d;
+		return true;
+	}
+	return false;
+}
+
+bool DeviceRegistry::FindByName(std::initializer_list<const char*> lowerNeedles, AudioObjectPropertyScope scope, AudioDeviceInfo* info) {
+	std::shared_ptr<const DeviceList> devices = Devices();
+	for (const AudioDeviceInfo& d : *devices) {
+		const UInt32 channels = scope == kAudioObjectPropertyScopeInput ? d.inputChannels : d.outputChannels;
+		if (channels == 0) continue;
+		bool all = true;
+		for (const char* needle : lowerNeedles) all = all && d.NameContains(needle);
+		if (!all) continue;
+		*info = d;
+		return true;
+	}
+	return false;
+}
+
+void DeviceRegistry::RebuildLocked() {
+	if (!listening_) {
+		// Registered for the life of the process; the registry is never destroyed before exit
+		AudioObjectAddPropertyListener(kAudioObjectSystemObject, &kDevicesAddress, Changed, this);
+		AudioObjectAddPropertyListener(kAudioObjectSystemObject, &kDefaultOutputAddress, Changed, this);
+		AudioObjectAddPropertyListener(kAudioObjectSystemObject, &kDefaultInputAddress, Changed, this);
+		listening_ = true;
+	}
+
+	auto devices = std::make_shared<DeviceList>();
+	UInt32 size = 0;
+	if (AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &kDevicesAddress, 0, nullptr, &size) == noErr && size > 0) {
+		std::vector<AudioDeviceID> ids(size / sizeof(AudioDeviceID));
+		if (AudioObjectGetPropertyData(kAudioObjectSystemObject, &kDevicesAddress, 0, nullptr, &size, ids.data()) == noErr) {
+			ids.resize(size / sizeof(AudioDeviceID));
+			devices->reserve(ids.size());
+			for (AudioDeviceID id : ids) devices->push_back(ReadDevice(id));
+		}
+	} else {
+		AddonLog(LogLevel::Error, "Failed to get device list");
+	}
+	defaultOutput_ = DefaultDevice(kDefaultOutputAddress);
+	defaultInput_ = DefaultDevice(kDefaultInputAddress);
+	WatchDevicesLocked(*devices);
+	AddonLog(LogLevel::Debug, "Device registry rebuilt: %zu devices", devices->size());
+	devices_ = devices;
+}
+
+// Follows nominal rate changes so sampleRate never goes stale between device list changes.
+void DeviceRegistry::WatchDevicesLocked(const DeviceList& devices) {
+	for (AudioDeviceID id : watched_) AudioObjectRemovePropertyListener(id, &kSampleRateAddress, Changed, this);
+	watched_.clear();
+	for (const AudioDeviceInfo& d : devices) {
+		if (AudioObjectAddPropertyListener(d.id, &kSampleRateAddress, Changed, this) == noErr) watched_.push_back(d.id);
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// Cached view of the CoreAudio device list. Built on first use and rebuilt
+// lazily after the HAL reports a change to the device list, the default
+// devices or a device's sample rate, so lookups from the setup checks and the
+// capture path don't walk kAudioHardwarePropertyDevices every call.
+// Implemented in device_registry.cc.
+
+#include <CoreAudio/CoreAudio.h>
+
+#include <atomic>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct AudioDeviceInfo {
+	AudioDeviceID id = kAudioObjectUnknown;
+	std::string uid;
+	std::string name;
+	std::string lowerName; // for the case-insensitive name matching below
+	UInt32 inputChannels = 0;
+	UInt32 outputChannels = 0;
+	Float64 sampleRate = 0;           // nominal
+	std::vector<Float64> sampleRates; // available nominal rates (range endpoints for continuous ranges)
+
+	bool NameContains(const char* lowerNeedle) const { return lowerName.find(lowerNeedle) != std::string::npos; }
+};
+
+class DeviceRegistry {
+public:
+	typedef std::vector<AudioDeviceInfo> DeviceList;
+
+	static DeviceRegistry& Instance();
+
+	// Current snapshot; safe to keep and read on any thread.
+	std::shared_ptr<const DeviceList> Devices();
+	AudioDeviceID DefaultOutput();
+	AudioDeviceID DefaultInput();
+
+	// Convenience lookups over the snapshot; false when nothing matches.
+	bool FindById(AudioDeviceID id, AudioDeviceInfo* info);
+	bool FindByUid(const std::string& uid, AudioDeviceInfo* info);
+	// First device whose lowercased name contains every needle and has
+	// channels in the given scope (kAudioObjectPropertyScopeInput/Output).
+	bool FindByName(std::initializer_list<const char*> lowerNeedles, AudioObjectPropertyScope scope, AudioDeviceInfo* info);
+
+	// Drops the snapshot; the next lookup rebuilds it.
+	void Invalidate() { dirty_.store(true, std::memory_order_release); }
+
+private:
+	DeviceRegistry() = default;
+	void RebuildLocked();
+	void WatchDevicesLocked(const DeviceList& devices);
+
+	static OSStatus Changed(AudioObjectID object, UInt32 count, const AudioObjectPropertyAddress* addresses, void* context);
+
+	std::mutex mutex_;
+	std::atomic<bool> dirty_{true};
+	bool listening_ = false;
+	std::shared_ptr<const DeviceList> devices_;
+	std::vector<AudioDeviceID> watched_; // devices with a sample-rate listener
+	AudioDeviceID defaultOutput_ = kAudioObjectUnknown;
+	AudioDeviceID defaultInput_ = kAudioObjectUnknown;
+};
@@ -0,0 +1,72 @@
+// HttpPost (http_upload.h) on NSURLSession. One session for the process, so
+// requests to a provider share its connection pool: kept alive between
+// chunks and multiplexed over HTTP/2 where the server offers it, which
+// NSURLSession negotiates by itself. Proxies follow the system settings.
+
+#import <Foundation/Foundation.h>
+
+#include <string>
+
+#include "http_upload.h"
+
+namespace {
+
+NSURLSession* Session() {
+	static NSURLSession* session = nil;
+	static dispatch_once_t once;
+	dispatch_once(&once, ^{
+		NSURLSessionConfiguration* config = [NSURLSessionConfiguration ephemeralSessionConfiguration];
+		config.URLCache = nil;
+		session = [NSURLSession sessionWithConfiguration:config];
+	});
+	return session;
+}
+
+NSString* ToNs(const std::string& s) {
+	return [[NSString alloc] initWithBytes:s.data() length:s.size() encoding:NSUTF8StringEncoding];
+}
+
+} // namespace
+
+bool HttpPost(const HttpRequest& request, HttpResponse* response) {
+	@autoreleasepool {
+		NSURL* url = [NSURL URLWithString:ToNs(request.url)];
+		if (!url) {
+			response->error = "Invalid upload URL";
+			return false;
+		}
+		NSMutableURLRequest* req = [NSMutableURLRequest requestWithURL:url];
+		req.HTTPMethod = @"POST";
+		req.timeoutInterval = request.timeoutMs / 1000.0;
+		for (const auto& h : request.headers) [req setValue:ToNs(h.second) forHTTPHeaderField:ToNs(h.first)];
+		NSData* body = [NSData dataWithBytesNoCopy:(void*)request.body.data() length:request.body.size() freeWhenDone:NO];
+
+		__block NSData* data = nil;
+		__block NSInteger status = 0;
+		__block NSString* failure = nil;
+		dispatch_semaphore_t done = dispatch_semaphore_create(0);
+		NSURLSessionUploadTask* task = [Session() uploadTaskWithRequest:req fromData:body
+			completionHandler:^(NSData* d, NSURLResponse* r, NSError* e) {
+				data = d;
+				if ([r isKindOfClass:[NSHTTPURLResponse class]]) status = ((NSHTTPURLResponse*)r).statusCode;
+				if (e) failure = e.localizedDescription;
+				dispatch_semaphore_signal(done);
+			}];
+		[task resume];
+		// The request's own timeout ends the task; this only guards against a handler that never runs
+		const int64_t waitNs = ((int64_t)request.timeoutMs + 5000) * NSEC_PER_MSEC;
+		if (dispatch_semaphore_wait(done, dispatch_time(DISPATCH_TIME_NOW, waitNs)) != 0) {
+			[task cancel];
+			dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER); // body points into request
+			response->error = "Upload timed out";
+			return false;
+		}
+		if (failure || status == 0) {
+			response->error = failure ? std::string(failure.UTF8String) : "Upload got no HTTP response";
+			return false;
+		}
+		response->status = (int)status;
+		response->body.assign(data ? static_cast<const char*>(data.bytes) : "", data ? data.length : 0);
+		return true;
+	}
+}
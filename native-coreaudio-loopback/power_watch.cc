@@ -0,0 +1,85 @@
+// Power watcher for option 'power' (power_state.h): IOKit's power source
+// notification on a run loop thread of its own, since Node's main thread
+// doesn't run a CFRunLoop.
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/ps/IOPSKeys.h>
+#include <IOKit/ps/IOPowerSources.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "addon_log.h"
+#include "power_state.h"
+
+namespace {
+
+std::thread g_thread;
+std::atomic<bool> g_stop{false};
+CFRunLoopRef g_loop = nullptr; // retained; set before StartPowerWatch returns
+
+PowerSource CurrentSource() {
+	CFTypeRef info = IOPSCopyPowerSourcesInfo();
+	if (info == nullptr) return PowerSource::Unknown;
+	PowerSource source = PowerSource::Unknown;
+	CFStringRef type = IOPSGetProvidingPowerSourceType(info);
+	if (type != nullptr && CFStringCompare(type, CFSTR(kIOPSBatteryPowerValue), 0) == kCFCompareEqualTo) source = PowerSource::Battery;
+	// AC or a UPS
+	else if (type != nullptr) source = PowerSource::Ac;
+	CFRelease(info);
+	return source;
+}
+
+// Watcher thread.
+void PowerSourcesChanged(void* context) {
+	static_cast<PowerState*>(context)->Set(CurrentSource());
+}
+
+} // namespace
+
+bool StartPowerWatch(PowerState* state) {
+	state->Set(CurrentSource());
+	g_stop = false;
+	std::mutex mutex;
+	std::condition_variable ready;
+	bool started = false, ok = false;
+	g_thread = std::thread([state, &mutex, &ready, &started, &ok] {
+		CFRunLoopSourceRef source = IOPSNotificationCreateRunLoopSource(PowerSourcesChanged, state);
+		if (source != nullptr) {
+			CFRunLoopAddSource(CFRunLoopGetCurrent(), source, kCFRunLoopDefaultMode);
+			g_loop = (CFRunLoopRef)CFRetain(CFRunLoopGetCurrent());
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			started = true;
+			ok = source != nullptr;
+		}
+		ready.notify_one();
+		if (source == nullptr) return;
+		// A stop that lands before the loop runs is seen within a second
+		while (!g_stop.load()) CFRunLoopRunInMode(kCFRunLoopDefaultMode, 1.0, false);
+		CFRunLoopRemoveSource(CFRunLoopGetCurrent(), source, kCFRunLoopDefaultMode);
+		CFRelease(source);
+	});
+	std::unique_lock<std::mutex> lock(mutex);
+	ready.wait(lock, [&started] { return started; });
+	if (!ok) {
+		lock.unlock();
+		g_thread.join();
+		AddonLog(LogLevel::Warn, "Power source notifications unavailable; the profile stays the one for %s", PowerSourceName(state->Source()));
+		return false;
+	}
+	AddonLog(LogLevel::Info, "Power watcher started (%s)", PowerSourceName(state->Source()));
+	return true;
+}
+
+void StopPowerWatch() {
+	g_stop = true;
+	if (g_loop) CFRunLoopStop(g_loop);
+	if (g_thread.joinable()) g_thread.join();
+	if (g_loop) CFRelease(g_loop);
+	g_loop = nullptr;
+	AddonLog(LogLevel::Info, "Power watcher stopped");
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+// Names of running processes for the by-name lookups in coreaudio_loopback.cc,
+// kept between calls instead of a proc_name() per PID per pass. A refresh is
+// one proc_listpids(); only PIDs it hasn't seen are read, through
+// proc_pidinfo(PROC_PIDTBSDINFO), which gives the name and the start time in
+// one call. Entries are keyed on both: a lookup re-reads its hits and notices
+// a PID recycled between refreshes by the changed start time. Names are
+// indexed whole and up to the first '.', so matching is a hash lookup.
+
+#include <libproc.h>
+#include <sys/proc_info.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ProcessNameCache {
+public:
+	struct Entry {
+		pid_t pid = 0;
+		uint64_t startUs = 0; // process start, us since the epoch
+		std::string name;     // what proc_name() returns
+	};
+
+	// Process-wide; lookups come from the JS thread and the threadpool.
+	static ProcessNameCache& Instance() {
+		static ProcessNameCache* cache = new ProcessNameCache();
+		return *cache;
+	}
+
+	// Every running process but this one, in proc_listpids() order.
+	std::vector<Entry> Processes() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		RefreshLocked();
+		std::vector<Entry> out;
+		out.reserve(order_.size());
+		for (pid_t pid : order_) out.push_back(slots_[pid].entry);
+		return out;
+	}
+
+	// PIDs named processName, or when there are none, those whose name matches
+	// it up to the first '.'; *exact says which. In proc_listpids() order.
+	std::vector<pid_t> Matches(const std::string& processName, bool* exact) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		RefreshLocked();
+		std::vector<pid_t> out;
+		*exact = true;
+		if (!CollectLocked(byName_, processName, false, &out)) {
+			*exact = false;
+			CollectLocked(byBase_, BaseName(processName), true, &out);
+		}
+		return out;
+	}
+
+private:
+	struct Slot {
+		Entry entry;
+		uint64_t seen = 0; // refresh that last listed it
+	};
+
+	ProcessNameCache() : self_(getpid()) {}
+
+	static std::string BaseName(const std::string& name) {
+		const size_t dot = name.find('.');
+		return dot == std::string::npos ? name : name.substr(0, dot);
+	}
+
+	static bool Read(pid_t pid, Entry* entry) {
+		proc_bsdinfo info;
+		if (proc_pidinfo(pid, PROC_PIDTBSDINFO, 0, &info, PROC_PIDTBSDINFO_SIZE) != PROC_PIDTBSDINFO_SIZE) return false;
+		entry->pid = pid;
+		entry->startUs = (uint64_t)info.pbi_start_tvsec * 1000000ull + (uint64_t)info.pbi_start_tvusec;
+		// proc_name()'s choice: the long name when set, else the 16-character command
+		const char* name = info.pbi_name[0] ? info.pbi_name : info.pbi_comm;
+		const size_t capacity = info.pbi_name[0] ? sizeof(info.pbi_name) : sizeof(info.pbi_comm);
+		entry->name.assign(name, strnlen(name, capacity));
+		return true;
+	}
+
+	void RefreshLocked() {
+		int bytes = proc_listpids(PROC_ALL_PIDS, 0, nullptr, 0);
+		if (bytes <= 0) return;
+		listing_.resize((size_t)bytes / sizeof(pid_t) + 64); // room for processes started meanwhile
+		bytes = proc_listpids(PROC_ALL_PIDS, 0, listing_.data(), (int)(listing_.size() * sizeof(pid_t)));
+		if (bytes <= 0) return;
+		listing_.resize((size_t)bytes / sizeof(pid_t));
+		++generation_;
+		bool changed = false;
+		order_.clear();
+		for (pid_t pid : listing_) {
+			if (pid <= 0 || pid == self_) continue;
+			auto it = slots_.find(pid);
+			if (it == slots_.end()) {
+				Entry entry;
+				if (!Read(pid, &entry)) continue; // exited since the listing
+				it = slots_.emplace(pid, Slot{ std::move(entry), 0 }).first;
+				changed = true;
+			}
+			it->second.seen = generation_;
+			order_.push_back(pid);
+		}
+		for (auto it = slots_.begin(); it != slots_.end();) {
+			if (it->second.seen == generation_) {
+				++it;
+			} else {
+				it = slots_.erase(it);
+				changed = true;
+			}
+		}
+		if (changed) ReindexLocked();
+	}
+
+	void ReindexLocked() {
+		byName_.clear();
+		byBase_.clear();
+		for (pid_t pid : order_) {
+			const std::string& name = slots_[pid].entry.name;
+			byName_[name].push_back(pid);
+			byBase_[BaseName(name)].push_back(pid);
+		}
+	}
+
+	// Appends the indexed PIDs under key still running as the same process;
+	// re-reads those that were recycled. False when none match.
+	bool CollectLocked(const std::unordered_map<std::string, std::vector<pid_t>>& index, const std::string& key, bool base, std::vector<pid_t>* out) {
+		auto it = index.find(key);
+		if (it == index.end()) return false;
+		bool recycled = false;
+		for (pid_t pid : it->second) {
+			Entry fresh;
+			if (!Read(pid, &fresh)) continue; // exited
+			Entry& cached = slots_[pid].entry;
+			if (fresh.startUs != cached.startUs) {
+				cached = std::move(fresh);
+				recycled = true;
+				if ((base ? BaseName(cached.name) : cached.name) != key) continue;
+			}
+			out->push_back(pid);
+		}
+		if (recycled) ReindexLocked(); // invalidates `it`; done with it
+		return !out->empty();
+	}
+
+	std::mutex mutex_;
+	const pid_t self_;
+	uint64_t generation_ = 0;
+	std::vector<pid_t> listing_;
+	std::vector<pid_t> order_; // last listing, without this process
+	std::unordered_map<pid_t, Slot> slots_;
+	std::unordered_map<std::string, std::vector<pid_t>> byName_;
+	std::unordered_map<std::string, std::vector<pid_t>> byBase_;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+// Process Tap capture (macOS 14.4+): a private CoreAudio tap on one process, or
+// on everything except this app's processes, read through a private aggregate device.
+// No BlackHole or Multi-Output routing is involved. Implemented in
+// process_tap.mm; this header stays plain C++.
+
+#include <CoreAudio/CoreAudio.h>
+#include <sys/types.h>
+
+class ProcessTapCapture {
+public:
+	// Runs on the HAL IO thread for every cycle of the aggregate device.
+	typedef void (*InputHandler)(void* context, const AudioBufferList* input, const AudioTimeStamp* inputTime);
+
+	~ProcessTapCapture() { Stop(); }
+
+	// True when the running OS has the tap API.
+	static bool IsSupported();
+
+	// Creates the tap and its aggregate device. pid > 0 taps that process;
+	// pid == 0 taps all output except this process, or except its whole
+	// process tree with excludeTree (Electron plays TTS from helper processes).
+	// *format receives the interleaved stream format the handler will be given.
+	bool Open(pid_t pid, bool excludeTree, AudioStreamBasicDescription* format);
+	// Starts IO; handler runs until Stop().
+	bool Start(InputHandler handler, void* context);
+	// Stops and starts IO again on the same aggregate device (a stalled stream).
+	bool Restart();
+	// Stops IO and destroys the aggregate device and tap.
+	void Stop();
+
+	AudioDeviceID DeviceId() const { return aggregate_; }
+
+private:
+	AudioObjectID tap_ = kAudioObjectUnknown;
+	AudioDeviceID aggregate_ = kAudioObjectUnknown;
+	AudioDeviceIOProcID ioProc_ = nullptr;
+	InputHandler handler_ = nullptr;
+	void* context_ = nullptr;
+
+	static OSStatus IOProc(AudioObjectID device, const AudioTimeStamp* now,
+	                       const AudioBufferList* inputData, const AudioTimeStamp* inputTime,
+	                       AudioBufferList* outputData, const AudioTimeStamp* outputTime, void* clientData);
+};
@@ -0,0 +1,229 @@
+#include "process_tap.h"
+
+#import <Foundation/Foundation.h>
+#include <CoreAudio/AudioHardware.h>
+#include <libproc.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "addon_log.h"
+
+#if defined(__MAC_14_2) && __MAC_OS_X_VERSION_MAX_ALLOWED >= __MAC_14_2
+#define HAVE_PROCESS_TAP 1
+#import <CoreAudio/CATapDescription.h>
+#include <CoreAudio/AudioHardwareTapping.h>
+#endif
+
+namespace {
+
+AudioObjectID ProcessObjectForPid(pid_t pid) {
+	AudioObjectPropertyAddress address = {
+		kAudioHardwarePropertyTranslatePIDToProcessObject,
+		kAudioObjectPropertyScopeGlobal,
+		kAudioObjectPropertyElementMain
+	};
+	AudioObjectID object = kAudioObjectUnknown;
+	UInt32 size = sizeof(object);
+	OSStatus status = AudioObjectGetPropertyData(kAudioObjectSystemObject, &address, sizeof(pid), &pid, &size, &object);
+	return status == noErr ? object : kAudioObjectUnknown;
+}
+
+#if defined(HAVE_PROCESS_TAP)
+// True when pid is root or one of its descendants.
+bool InProcessTree(pid_t pid, pid_t root) {
+	for (int depth = 0; pid > 1 && depth < 64; ++depth) {
+		if (pid == root) return true;
+		struct proc_bsdinfo info;
+		if (proc_pidinfo(pid, PROC_PIDTBSDINFO, 0, &info, sizeof(info)) != (int)sizeof(info)) return false;
+		pid = (pid_t)info.pbi_ppid;
+	}
+	return false;
+}
+
+// CoreAudio process objects for root's process tree. Only processes that have
+// touched CoreAudio have one, which covers every helper that can play audio.
+NSArray<NSNumber*>* ProcessObjectsInTree(pid_t root) {
+	AudioObjectPropertyAddress address = {
+		kAudioHardwarePropertyProcessObjectList,
+		kAudioObjectPropertyScopeGlobal,
+		kAudioObjectPropertyElementMain
+	};
+	NSMutableArray<NSNumber*>* tree = [NSMutableArray array];
+	UInt32 size = 0;
+	if (AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &address, 0, nullptr, &size) != noErr) return tree;
+	std::vector<AudioObjectID> objects(size / sizeof(AudioObjectID));
+	if (objects.empty() ||
+	    AudioObjectGetPropertyData(kAudioObjectSystemObject, &address, 0, nullptr, &size, objects.data()) != noErr) return tree;
+	objects.resize(size / sizeof(AudioObjectID));
+	address.mSelector = kAudioProcessPropertyPID;
+	for (AudioObjectID object : objects) {
+		pid_t pid = 0;
+		size = sizeof(pid);
+		if (AudioObjectGetPropertyData(object, &address, 0, nullptr, &size, &pid) == noErr && InProcessTree(pid, root)) {
+			[tree addObject:@(object)];
+		}
+	}
+	return tree;
+}
+#endif
+
+// UID of the device system sounds and most apps play to; the aggregate is
+// clocked from it.
+NSString* DefaultOutputDeviceUid() {
+	AudioObjectPropertyAddress address = {
+		kAudioHardwarePropertyDefaultOutputDevice,
+		kAudioObjectPropertyScopeGlobal,
+		kAudioObjectPropertyElementMain
+	};
+	AudioDeviceID device = kAudioObjectUnknown;
+	UInt32 size = sizeof(device);
+	if (AudioObjectGetPropertyData(kAudioObjectSystemObject, &address, 0, nullptr, &size, &device) != noErr) return nil;
+	address.mSelector = kAudioDevicePropertyDeviceUID;
+	CFStringRef uid = nullptr;
+	size = sizeof(uid);
+	if (AudioObjectGetPropertyData(device, &address, 0, nullptr, &size, &uid) != noErr || !uid) return nil;
+	return (__bridge_transfer NSString*)uid;
+}
+
+} // namespace
+
+bool ProcessTapCapture::IsSupported() {
+#if defined(HAVE_PROCESS_TAP)
+	if (__builtin_available(macOS 14.4, *)) return true;
+#endif
+	return false;
+}
+
+bool ProcessTapCapture::Open(pid_t pid, bool excludeTree, AudioStreamBasicDescription* format) {
+	Stop();
+#if defined(HAVE_PROCESS_TAP)
+	if (__builtin_available(macOS 14.4, *)) {
+		@autoreleasepool {
+			const pid_t processPid = pid > 0 ? pid : getpid();
+			AudioObjectID process = ProcessObjectForPid(processPid);
+			if (process == kAudioObjectUnknown && pid > 0) {
+				AddonLog(LogLevel::Warn, "Process tap: PID %d has no CoreAudio process object", (int)pid);
+				return false;
+			}
+
+			// Mix the target down to stereo, or everything but ourselves
+			NSArray<NSNumber*>* processes = process != kAudioObjectUnknown ? @[ @(process) ] : @[];
+			if (pid <= 0 && excludeTree) processes = ProcessObjectsInTree(processPid);
+			CATapDescription* description = pid > 0
+				? [[CATapDescription alloc] initStereoMixdownOfProcesses:processes]
+				: [[CATapDescription alloc] initStereoGlobalTapButExcludeProcesses:processes];
+			description.name = @"Whispra capture tap";
+			description.privateTap = YES;
+			description.muteBehavior = CATapUnmuted;
+
+			OSStatus status = AudioHardwareCreateProcessTap(description, &tap_);
+			if (status != noErr) {
+				AddonLog(LogLevel::Warn, "AudioHardwareCreateProcessTap failed: %d", (int)status);
+				tap_ = kAudioObjectUnknown;
+				return false;
+			}
+
+			AudioObjectPropertyAddress address = {
+				kAudioTapPropertyFormat,
+				kAudioObjectPropertyScopeGlobal,
+				kAudioObjectPropertyElementMain
+			};
+			UInt32 size = sizeof(*format);
+			status = AudioObjectGetPropertyData(tap_, &address, 0, nullptr, &size, format);
+			if (status != noErr) {
+				AddonLog(LogLevel::Warn, "Process tap: failed to read the tap format: %d", (int)status);
+				Stop();
+				return false;
+			}
+
+			NSString* outputUid = DefaultOutputDeviceUid();
+			if (!outputUid) {
+				AddonLog(LogLevel::Warn, "Process tap: no default output device");
+				Stop();
+				return false;
+			}
+
+			// Private aggregate clocked by the output device with the tap as its only input
+			NSString* aggregateUid = [[NSUUID UUID] UUIDString];
+			NSDictionary* aggregate = @{
+				@kAudioAggregateDeviceNameKey: @"Whispra capture",
+				@kAudioAggregateDeviceUIDKey: aggregateUid,
+				@kAudioAggregateDeviceMainSubDeviceKey: outputUid,
+				@kAudioAggregateDeviceIsPrivateKey: @YES,
+				@kAudioAggregateDeviceIsStackedKey: @NO,
+				@kAudioAggregateDeviceTapAutoStartKey: @YES,
+				@kAudioAggregateDeviceSubDeviceListKey: @[ @{ @kAudioSubDeviceUIDKey: outputUid } ],
+				@kAudioAggregateDeviceTapListKey: @[ @{
+					@kAudioSubTapUIDKey: [description.UUID UUIDString],
+					@kAudioSubTapDriftCompensationKey: @YES
+				} ]
+			};
+			status = AudioHardwareCreateAggregateDevice((__bridge CFDictionaryRef)aggregate, &aggregate_);
+			if (status != noErr) {
+				AddonLog(LogLevel::Warn, "Process tap: AudioHardwareCreateAggregateDevice failed: %d", (int)status);
+				aggregate_ = kAudioObjectUnknown;
+				Stop();
+				return false;
+			}
+
+			AddonLog(LogLevel::Info, "Process tap created (%s PID %d%s): %.0f Hz, %u channels",
+			         pid > 0 ? "target" : "excluding", (int)processPid,
+			         pid <= 0 && excludeTree ? [[NSString stringWithFormat:@" and %lu process objects in its tree", (unsigned long)processes.count] UTF8String] : "",
+			         format->mSampleRate, (unsigned)format->mChannelsPerFrame);
+			return true;
+		}
+	}
+#endif
+	(void)pid; (void)excludeTree; (void)format;
+	return false;
+}
+
+bool ProcessTapCapture::Start(InputHandler handler, void* context) {
+	if (aggregate_ == kAudioObjectUnknown || ioProc_) return false;
+	handler_ = handler;
+	context_ = context;
+	OSStatus status = AudioDeviceCreateIOProcID(aggregate_, IOProc, this, &ioProc_);
+	if (status == noErr) status = AudioDeviceStart(aggregate_, ioProc_);
+	if (status != noErr) {
+		AddonLog(LogLevel::Warn, "Process tap: failed to start the aggregate device: %d", (int)status);
+		Stop();
+		return false;
+	}
+	return true;
+}
+
+bool ProcessTapCapture::Restart() {
+	if (aggregate_ == kAudioObjectUnknown || !ioProc_) return false;
+	AudioDeviceStop(aggregate_, ioProc_);
+	return AudioDeviceStart(aggregate_, ioProc_) == noErr;
+}
+
+void ProcessTapCapture::Stop() {
+	if (aggregate_ != kAudioObjectUnknown) {
+		if (ioProc_) {
+			AudioDeviceStop(aggregate_, ioProc_);
+			AudioDeviceDestroyIOProcID(aggregate_, ioProc_);
+			ioProc_ = nullptr;
+		}
+		AudioHardwareDestroyAggregateDevice(aggregate_);
+		aggregate_ = kAudioObjectUnknown;
+	}
+#if defined(HAVE_PROCESS_TAP)
+	if (tap_ != kAudioObjectUnknown) {
+		if (__builtin_available(macOS 14.4, *)) AudioHardwareDestroyProcessTap(tap_);
+		tap_ = kAudioObjectUnknown;
+	}
+#endif
+	handler_ = nullptr;
+	context_ = nullptr;
+}
+
+OSStatus ProcessTapCapture::IOProc(AudioObjectID device, const AudioTimeStamp* now,
+                                   const AudioBufferList* inputData, const AudioTimeStamp* inputTime,
+                                   AudioBufferList* outputData, const AudioTimeStamp* outputTime, void* clientData) {
+	(void)device; (void)now; (void)outputData; (void)outputTime;
+	ProcessTapCapture* self = static_cast<ProcessTapCapture*>(clientData);
+	if (self->handler_ && inputData && inputData->mNumberBuffers > 0) self->handler_(self->context_, inputData, inputTime);
+	return noErr;
+}
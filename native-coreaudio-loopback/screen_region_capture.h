@@ -0,0 +1,52 @@
+#pragma once
+
+// RegionCapture back end on macOS (region_capture.h): a ScreenCaptureKit
+// stream (macOS 12.3+) of just the region, at the display's pixel scale
+// times options.scale. The stream's scaler does the crop and scale on the
+// GPU; a gray capture asks for full-range BT.601 4:2:0 and reads only its
+// luma plane, a BGRA one for BGRA. The stream keeps running between grabs at up to maxFps and only
+// delivers a frame when something was presented, so a grab copies the
+// newest IOSurface-backed buffer from the stream's own pool; no full-display
+// image is ever made. Every new frame's tiles are hashed to tell whether
+// anything inside the region really changed. GrabRect copies a rectangle
+// of the same newest buffer, so an armed stream of a whole display answers
+// without waiting. Needs the Screen Recording
+// permission. Implemented in screen_region_capture.mm; this header stays
+// plain C++.
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "region_capture.h"
+
+class ScreenRegionGrabber {
+public:
+	ScreenRegionGrabber() = default;
+	ScreenRegionGrabber(const ScreenRegionGrabber&) = delete;
+	ScreenRegionGrabber& operator=(const ScreenRegionGrabber&) = delete;
+	~ScreenRegionGrabber() { Close(); }
+
+	void Configure(const RegionCaptureOptions& options);
+	bool Grab(uint32_t timeoutMs, RegionFrame* frame, std::string* error);
+	bool GrabRect(const RegionRect& rect, uint32_t timeoutMs, RegionFrame* frame, std::string* error);
+	void Close();
+
+private:
+	struct Stream; // the SCStream and its newest frame
+
+	bool Open(std::string* error);
+	void StopStream();
+	// The newest frame as a retained CVPixelBufferRef, or null with *error set
+	void* Take(uint64_t* taken, uint32_t timeoutMs, bool* changed, double* presentedMs, std::string* error);
+
+	std::mutex mutex_;
+	RegionCaptureOptions options_;
+	bool configured_ = false;
+	Stream* stream_ = nullptr;
+	uint64_t taken_ = 0;     // sequence of the frame the last grab returned
+	uint64_t rectTaken_ = 0; // and the last grabRect
+	RegionRect shown_;       // the stream's source rectangle, global points
+	bool luma_ = false;      // the stream delivers 4:2:0; plane 0 is the gray frame
+	TileHasher tiles_;
+};
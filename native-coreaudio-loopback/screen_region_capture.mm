@@ -0,0 +1,291 @@
+#include "screen_region_capture.h"
+
+#import <Foundation/Foundation.h>
+#include <CoreGraphics/CoreGraphics.h>
+#include <CoreMedia/CoreMedia.h>
+#include <CoreVideo/CoreVideo.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+
+#include "addon_log.h"
+
+#if defined(__MAC_12_3) && __MAC_OS_X_VERSION_MAX_ALLOWED >= __MAC_12_3
+#define HAVE_SCREEN_CAPTURE_KIT 1
+#import <ScreenCaptureKit/ScreenCaptureKit.h>
+#endif
+
+namespace {
+
+// The stream's newest complete frame, shared with its sample handler queue.
+struct LatestFrame {
+	std::mutex mutex;
+	std::condition_variable arrived;
+	CVPixelBufferRef buffer = nullptr; // retained
+	uint64_t sequence = 0;
+	double presentedMs = 0.0;
+	bool stopped = false;
+	std::string error;
+
+	~LatestFrame() { if (buffer) CVPixelBufferRelease(buffer); }
+};
+
+// The pixels to read: the luma plane of a 4:2:0 buffer, or the BGRA image.
+const uint8_t* BaseAddress(CVPixelBufferRef buffer, bool luma) {
+	return static_cast<const uint8_t*>(luma ? CVPixelBufferGetBaseAddressOfPlane(buffer, 0) : CVPixelBufferGetBaseAddress(buffer));
+}
+
+size_t BytesPerRow(CVPixelBufferRef buffer, bool luma) {
+	return luma ? CVPixelBufferGetBytesPerRowOfPlane(buffer, 0) : CVPixelBufferGetBytesPerRow(buffer);
+}
+
+} // namespace
+
+#if defined(HAVE_SCREEN_CAPTURE_KIT)
+
+API_AVAILABLE(macos(12.3))
+@interface RegionStreamSink : NSObject <SCStreamOutput, SCStreamDelegate>
+- (instancetype)initWithFrame:(std::shared_ptr<LatestFrame>)frame;
+@end
+
+@implementation RegionStreamSink {
+	std::shared_ptr<LatestFrame> _frame;
+}
+
+- (instancetype)initWithFrame:(std::shared_ptr<LatestFrame>)frame {
+	if ((self = [super init])) _frame = std::move(frame);
+	return self;
+}
+
+- (void)stream:(SCStream*)stream didOutputSampleBuffer:(CMSampleBufferRef)sample ofType:(SCStreamOutputType)type {
+	if (type != SCStreamOutputTypeScreen) return;
+	// Idle frames (nothing presented) carry no image
+	CFArrayRef attachments = CMSampleBufferGetSampleAttachmentsArray(sample, false);
+	if (!attachments || CFArrayGetCount(attachments) == 0) return;
+	NSDictionary* info = (__bridge NSDictionary*)CFArrayGetValueAtIndex(attachments, 0);
+	NSNumber* status = info[SCStreamFrameInfoStatus];
+	if (!status || status.integerValue != SCFrameStatusComplete) return;
+	CVPixelBufferRef buffer = CMSampleBufferGetImageBuffer(sample);
+	if (!buffer) return;
+	CVPixelBufferRetain(buffer);
+	const double presentedMs = CMTimeGetSeconds(CMSampleBufferGetPresentationTimeStamp(sample)) * 1000.0;
+	{
+		std::lock_guard<std::mutex> lock(_frame->mutex);
+		if (_frame->buffer) CVPixelBufferRelease(_frame->buffer);
+		_frame->buffer = buffer;
+		_frame->presentedMs = presentedMs;
+		++_frame->sequence;
+	}
+	_frame->arrived.notify_all();
+}
+
+- (void)stream:(SCStream*)stream didStopWithError:(NSError*)error {
+	{
+		std::lock_guard<std::mutex> lock(_frame->mutex);
+		_frame->stopped = true;
+		_frame->error = std::string("Screen capture stopped: ") + error.localizedDescription.UTF8String;
+	}
+	_frame->arrived.notify_all();
+}
+
+@end
+
+#endif
+
+struct ScreenRegionGrabber::Stream {
+	std::shared_ptr<LatestFrame> frame = std::make_shared<LatestFrame>();
+	id stream = nil; // SCStream
+	id sink = nil;   // RegionStreamSink
+	dispatch_queue_t queue = nil;
+};
+
+void ScreenRegionGrabber::Configure(const RegionCaptureOptions& options) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	options_ = options;
+	configured_ = true;
+	tiles_.Configure(options.tileSize);
+	// Reopened on the next grab: the region may be on another display or another size
+	StopStream();
+}
+
+void ScreenRegionGrabber::Close() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	configured_ = false;
+	StopStream();
+}
+
+void ScreenRegionGrabber::StopStream() {
+	if (!stream_) return;
+#if defined(HAVE_SCREEN_CAPTURE_KIT)
+	if (__builtin_available(macOS 12.3, *)) {
+		if (stream_->stream) {
+			dispatch_semaphore_t done = dispatch_semaphore_create(0);
+			[(SCStream*)stream_->stream stopCaptureWithCompletionHandler:^(NSError*) { dispatch_semaphore_signal(done); }];
+			dispatch_semaphore_wait(done, dispatch_time(DISPATCH_TIME_NOW, 2 * NSEC_PER_SEC));
+		}
+	}
+#endif
+	delete stream_;
+	stream_ = nullptr;
+}
+
+bool ScreenRegionGrabber::Open(std::string* error) {
+#if defined(HAVE_SCREEN_CAPTURE_KIT)
+	if (__builtin_available(macOS 12.3, *)) {
+		@autoreleasepool {
+			const RegionRect& r = options_.rect;
+			CGDirectDisplayID displayId = 0;
+			uint32_t count = 0;
+			if (CGGetDisplaysWithPoint(CGPointMake(r.x, r.y), 1, &displayId, &count) != kCGErrorSuccess || count == 0) {
+				*error = "No display contains the region";
+				return false;
+			}
+
+			// We are on the threadpool, so the asynchronous calls are simply waited for
+			__block SCShareableContent* content = nil;
+			__block NSError* failure = nil;
+			dispatch_semaphore_t done = dispatch_semaphore_create(0);
+			[SCShareableContent getShareableContentExcludingDesktopWindows:NO onScreenWindowsOnly:YES
+				completionHandler:^(SCShareableContent* c, NSError* e) { content = c; failure = e; dispatch_semaphore_signal(done); }];
+			if (dispatch_semaphore_wait(done, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC)) != 0 || !content) {
+				*error = failure ? std::string("Screen capture unavailable (Screen Recording permission?): ") + failure.localizedDescription.UTF8String
+				                 : "Screen capture unavailable: no shareable content";
+				return false;
+			}
+			SCDisplay* display = nil;
+			for (SCDisplay* d in content.displays) {
+				if (d.displayID == displayId) display = d;
+			}
+			if (!display) {
+				*error = "The region's display is not shareable";
+				return false;
+			}
+
+			// sourceRect is in points relative to the display; the output is in its pixels
+			const CGRect bounds = CGDisplayBounds(displayId);
+			CGRect source = CGRectIntersection(CGRectMake(r.x, r.y, r.width, r.height), bounds);
+			shown_.x = (int32_t)std::floor(source.origin.x);
+			shown_.y = (int32_t)std::floor(source.origin.y);
+			shown_.width = (uint32_t)std::ceil(source.size.width);
+			shown_.height = (uint32_t)std::ceil(source.size.height);
+			source.origin.x -= bounds.origin.x;
+			source.origin.y -= bounds.origin.y;
+			double scale = 1.0;
+			if (CGDisplayModeRef mode = CGDisplayCopyDisplayMode(displayId)) {
+				if (CGDisplayModeGetWidth(mode) > 0) scale = (double)CGDisplayModeGetPixelWidth(mode) / (double)CGDisplayModeGetWidth(mode);
+				CGDisplayModeRelease(mode);
+			}
+			SCContentFilter* filter = [[SCContentFilter alloc] initWithDisplay:display excludingWindows:@[]];
+			SCStreamConfiguration* config = [[SCStreamConfiguration alloc] init];
+			config.sourceRect = source;
+			config.width = (size_t)std::max(1.0, std::round(source.size.width * scale * options_.scale));
+			config.height = (size_t)std::max(1.0, std::round(source.size.height * scale * options_.scale));
+			luma_ = options_.format == RegionFormat::Gray;
+			if (luma_) {
+				config.pixelFormat = kCVPixelFormatType_420YpCbCr8BiPlanarFullRange;
+				config.colorMatrix = kCGDisplayStreamYCbCrMatrix_ITU_R_601_4;
+			} else {
+				config.pixelFormat = kCVPixelFormatType_32BGRA;
+			}
+			config.showsCursor = NO;
+			config.queueDepth = 3; // one held by the last grab, two for the stream
+			config.minimumFrameInterval = CMTimeMake(1, (int32_t)options_.maxFps);
+
+			std::unique_ptr<Stream> opened(new Stream());
+			RegionStreamSink* sink = [[RegionStreamSink alloc] initWithFrame:opened->frame];
+			SCStream* stream = [[SCStream alloc] initWithFilter:filter configuration:config delegate:sink];
+			opened->queue = dispatch_queue_create("RegionCapture", DISPATCH_QUEUE_SERIAL);
+			NSError* addError = nil;
+			if (![stream addStreamOutput:sink type:SCStreamOutputTypeScreen sampleHandlerQueue:opened->queue error:&addError]) {
+				*error = std::string("Screen capture output failed: ") + addError.localizedDescription.UTF8String;
+				return false;
+			}
+			__block NSError* startError = nil;
+			[stream startCaptureWithCompletionHandler:^(NSError* e) { startError = e; dispatch_semaphore_signal(done); }];
+			if (dispatch_semaphore_wait(done, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC)) != 0 || startError) {
+				*error = startError ? std::string("Screen capture start failed: ") + startError.localizedDescription.UTF8String
+				                    : "Screen capture start timed out";
+				return false;
+			}
+			opened->stream = stream;
+			opened->sink = sink;
+			stream_ = opened.release();
+			taken_ = 0;
+			rectTaken_ = 0;
+			tiles_.Reset();
+			AddonLog(LogLevel::Info, "Region capture: display %u, region %zux%zu at %.2fx", displayId,
+			         (size_t)config.width, (size_t)config.height, scale);
+			return true;
+		}
+	}
+#endif
+	*error = "Region capture needs macOS 12.3 or later";
+	return false;
+}
+
+void* ScreenRegionGrabber::Take(uint64_t* taken, uint32_t timeoutMs, bool* changed, double* presentedMs, std::string* error) {
+	LatestFrame& latest = *stream_->frame;
+	std::unique_lock<std::mutex> lock(latest.mutex);
+	// Nothing taken yet: wait for the stream's first frame
+	const uint32_t waitMs = *taken ? timeoutMs : std::max<uint32_t>(timeoutMs, 1000);
+	latest.arrived.wait_for(lock, std::chrono::milliseconds(waitMs),
+	                        [&] { return latest.sequence != *taken || latest.stopped; });
+	if (latest.stopped) {
+		*error = latest.error;
+		lock.unlock();
+		StopStream(); // the next grab starts a new stream
+		return nullptr;
+	}
+	if (!latest.buffer) { *error = "No screen frame within the timeout"; return nullptr; }
+	*changed = latest.sequence != *taken;
+	*taken = latest.sequence;
+	*presentedMs = latest.presentedMs;
+	return CVPixelBufferRetain(latest.buffer);
+}
+
+bool ScreenRegionGrabber::Grab(uint32_t timeoutMs, RegionFrame* frame, std::string* error) {
+	std::lock_guard<std::mutex> guard(mutex_);
+	if (!configured_) { *error = "Region capture is closed"; return false; }
+	if (!stream_ && !Open(error)) return false;
+
+	bool changed = false;
+	CVPixelBufferRef buffer = (CVPixelBufferRef)Take(&taken_, timeoutMs, &changed, &frame->timestampMs, error);
+	if (!buffer) return false;
+	CVPixelBufferLockBaseAddress(buffer, kCVPixelBufferLock_ReadOnly);
+	frame->width = (uint32_t)CVPixelBufferGetWidth(buffer);
+	frame->height = (uint32_t)CVPixelBufferGetHeight(buffer);
+	frame->format = options_.format;
+	CopyRegionPixels(BaseAddress(buffer, luma_), BytesPerRow(buffer, luma_), frame, luma_);
+	CVPixelBufferUnlockBaseAddress(buffer, kCVPixelBufferLock_ReadOnly);
+	CVPixelBufferRelease(buffer);
+	if (changed) {
+		DetectRegionChange(&tiles_, frame, nullptr);
+	} else {
+		KeepRegionTiles(tiles_, frame);
+	}
+	return true;
+}
+
+bool ScreenRegionGrabber::GrabRect(const RegionRect& rect, uint32_t timeoutMs, RegionFrame* frame, std::string* error) {
+	std::lock_guard<std::mutex> guard(mutex_);
+	if (!configured_) { *error = "Region capture is closed"; return false; }
+	if (!stream_ && !Open(error)) return false;
+
+	bool changed = false;
+	CVPixelBufferRef buffer = (CVPixelBufferRef)Take(&rectTaken_, timeoutMs, &changed, &frame->timestampMs, error);
+	if (!buffer) return false;
+	TileRect crop;
+	const bool inside = MapRegionCrop(shown_, (uint32_t)CVPixelBufferGetWidth(buffer), (uint32_t)CVPixelBufferGetHeight(buffer), rect, &crop);
+	if (inside) {
+		CVPixelBufferLockBaseAddress(buffer, kCVPixelBufferLock_ReadOnly);
+		frame->format = options_.format;
+		CopyRegionCrop(BaseAddress(buffer, luma_), BytesPerRow(buffer, luma_), crop, frame, luma_);
+		CVPixelBufferUnlockBaseAddress(buffer, kCVPixelBufferLock_ReadOnly);
+	}
+	CVPixelBufferRelease(buffer);
+	if (!inside) { *error = "The rectangle is outside the capture's region"; return false; }
+	return true;
+}
@@ -0,0 +1,195 @@
+// Audio session registry for macOS 14+: follows the HAL's process object list
+// and each process's IsRunningOutput flag, so the session table changes only
+// when CoreAudio reports a change. Older systems have no process objects and
+// the registry doesn't start. The HAL has no per-process meter, so
+// getSessionLevels() reports IsRunningOutput as an unmetered 0/1 level.
+
+#include <CoreAudio/CoreAudio.h>
+#include <libproc.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "addon_log.h"
+#include "session_table.h"
+
+#if defined(__MAC_14_0) && __MAC_OS_X_VERSION_MAX_ALLOWED >= __MAC_14_0
+#define HAVE_PROCESS_OBJECTS 1
+#endif
+
+#if defined(HAVE_PROCESS_OBJECTS)
+
+namespace {
+
+const AudioObjectPropertyAddress kProcessListAddress = {
+	kAudioHardwarePropertyProcessObjectList, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain
+};
+const AudioObjectPropertyAddress kRunningOutputAddress = {
+	kAudioProcessPropertyIsRunningOutput, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain
+};
+
+struct ProcessObject {
+	AudioObjectID object;
+	pid_t pid;
+};
+
+std::mutex g_mutex;
+SessionTable* g_table = nullptr;
+std::vector<ProcessObject> g_processes; // objects with a running-output listener
+
+pid_t ProcessPid(AudioObjectID object) {
+	AudioObjectPropertyAddress address = {
+		kAudioProcessPropertyPID, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain
+	};
+	pid_t pid = -1;
+	UInt32 size = sizeof(pid);
+	if (AudioObjectGetPropertyData(object, &address, 0, nullptr, &size, &pid) != noErr) return -1;
+	return pid;
+}
+
+bool ProcessRunningOutput(AudioObjectID object) {
+	UInt32 running = 0;
+	UInt32 size = sizeof(running);
+	if (AudioObjectGetPropertyData(object, &kRunningOutputAddress, 0, nullptr, &size, &running) != noErr) return false;
+	return running != 0;
+}
+
+std::string ProcessName(pid_t pid) {
+	char name[2 * MAXCOMLEN + 1] = {};
+	if (proc_name(pid, name, sizeof(name)) <= 0) return std::string();
+	return name;
+}
+
+OSStatus ProcessListChanged(AudioObjectID, UInt32, const AudioObjectPropertyAddress*, void*);
+OSStatus RunningOutputChanged(AudioObjectID, UInt32, const AudioObjectPropertyAddress*, void*);
+
+std::vector<AudioObjectID> ProcessObjects() {
+	std::vector<AudioObjectID> objects;
+	UInt32 size = 0;
+	if (AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &kProcessListAddress, 0, nullptr, &size) == noErr && size > 0) {
+		objects.resize(size / sizeof(AudioObjectID));
+		if (AudioObjectGetPropertyData(kAudioObjectSystemObject, &kProcessListAddress, 0, nullptr, &size, objects.data()) != noErr) {
+			size = 0;
+		}
+		objects.resize(size / sizeof(AudioObjectID));
+	}
+	return objects;
+}
+
+AudioSessionLevel LevelFor(AudioObjectID object, pid_t pid) {
+	return AudioSessionLevel{ (uint32_t)pid, ProcessName(pid), ProcessRunningOutput(object) ? 1.0f : 0.0f, false };
+}
+
+// Diffs the HAL's process objects against the ones we already follow.
+void RefreshLocked() {
+	const std::vector<AudioObjectID> objects = ProcessObjects();
+
+	const pid_t self = getpid();
+	std::vector<ProcessObject> kept;
+	kept.reserve(objects.size());
+	for (const ProcessObject& p : g_processes) {
+		if (std::find(objects.begin(), objects.end(), p.object) != objects.end()) {
+			kept.push_back(p);
+			continue;
+		}
+		AudioObjectRemovePropertyListener(p.object, &kRunningOutputAddress, RunningOutputChanged, nullptr);
+		g_table->Remove((uint32_t)p.pid);
+	}
+	for (AudioObjectID object : objects) {
+		auto known = std::find_if(kept.begin(), kept.end(), [object](const ProcessObject& p) { return p.object == object; });
+		if (known != kept.end()) continue;
+		const pid_t pid = ProcessPid(object);
+		if (pid <= 0 || pid == self) continue;
+		AudioObjectAddPropertyListener(object, &kRunningOutputAddress, RunningOutputChanged, nullptr);
+		kept.push_back({ object, pid });
+		g_table->Set((uint32_t)pid, ProcessName(pid), ProcessRunningOutput(object));
+	}
+	g_processes.swap(kept);
+}
+
+// HAL notification thread
+OSStatus ProcessListChanged(AudioObjectID, UInt32, const AudioObjectPropertyAddress*, void*) {
+	std::lock_guard<std::mutex> lock(g_mutex);
+	if (g_table) RefreshLocked();
+	return noErr;
+}
+
+// HAL notification thread
+OSStatus RunningOutputChanged(AudioObjectID object, UInt32, const AudioObjectPropertyAddress*, void*) {
+	std::lock_guard<std::mutex> lock(g_mutex);
+	if (!g_table) return noErr;
+	for (const ProcessObject& p : g_processes) {
+		if (p.object == object) {
+			g_table->Set((uint32_t)p.pid, std::string(), ProcessRunningOutput(object));
+			break;
+		}
+	}
+	return noErr;
+}
+
+} // namespace
+
+bool StartAudioSessionRegistry(SessionTable* table) {
+	if (__builtin_available(macOS 14.0, *)) {
+		std::lock_guard<std::mutex> lock(g_mutex);
+		OSStatus status = AudioObjectAddPropertyListener(kAudioObjectSystemObject, &kProcessListAddress, ProcessListChanged, nullptr);
+		if (status != noErr) {
+			AddonLog(LogLevel::Warn, "Session registry: process list listener failed: %d", (int)status);
+			return false;
+		}
+		g_table = table;
+		RefreshLocked();
+		AddonLog(LogLevel::Info, "Session registry started: %zu processes", g_processes.size());
+		return true;
+	}
+	return false;
+}
+
+void StopAudioSessionRegistry() {
+	// Removing a listener waits for its in-flight callbacks, so don't hold the lock here
+	AudioObjectRemovePropertyListener(kAudioObjectSystemObject, &kProcessListAddress, ProcessListChanged, nullptr);
+	std::vector<ProcessObject> processes;
+	{
+		std::lock_guard<std::mutex> lock(g_mutex);
+		processes.swap(g_processes);
+		g_table = nullptr;
+	}
+	for (const ProcessObject& p : processes) {
+		AudioObjectRemovePropertyListener(p.object, &kRunningOutputAddress, RunningOutputChanged, nullptr);
+	}
+	AddonLog(LogLevel::Info, "Session registry stopped");
+}
+
+std::vector<AudioSessionLevel> SampleAudioSessionLevels() {
+	std::vector<AudioSessionLevel> levels;
+	if (__builtin_available(macOS 14.0, *)) {
+		std::lock_guard<std::mutex> lock(g_mutex);
+		if (g_table) {
+			for (const ProcessObject& p : g_processes) levels.push_back(LevelFor(p.object, p.pid));
+			return levels;
+		}
+		const pid_t self = getpid();
+		for (AudioObjectID object : ProcessObjects()) {
+			const pid_t pid = ProcessPid(object);
+			if (pid > 0 && pid != self) levels.push_back(LevelFor(object, pid));
+		}
+	}
+	return levels;
+}
+
+#else
+
+bool StartAudioSessionRegistry(SessionTable*) {
+	AddonLog(LogLevel::Warn, "Session registry needs the macOS 14 SDK");
+	return false;
+}
+
+void StopAudioSessionRegistry() {}
+
+std::vector<AudioSessionLevel> SampleAudioSessionLevels() {
+	return std::vector<AudioSessionLevel>();
+}
+
+#endif
@@ -0,0 +1,116 @@
+#include "soundboard_output.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "addon_log.h"
+#include "device_registry.h"
+
+bool SoundboardOutput::Start(const std::string& lowerNeedle, RenderSource* source, std::string* name, std::string* error,
+                             bool lowLatency) {
+	if (unit_) {
+		*error = "Soundboard output already running";
+		return false;
+	}
+	AudioDeviceInfo device;
+	DeviceRegistry& registry = DeviceRegistry::Instance();
+	const bool found = lowerNeedle.empty()
+		? registry.FindById(registry.DefaultOutput(), &device)
+		: registry.FindByName({ lowerNeedle.c_str() }, kAudioObjectPropertyScopeOutput, &device);
+	if (!found) {
+		*error = "No output device matching '" + lowerNeedle + "'";
+		return false;
+	}
+
+	AudioComponentDescription desc = {};
+	desc.componentType = kAudioUnitType_Output;
+	desc.componentSubType = kAudioUnitSubType_HALOutput;
+	desc.componentManufacturer = kAudioUnitManufacturer_Apple;
+	AudioComponent comp = AudioComponentFindNext(nullptr, &desc);
+	if (!comp) return Fail("AudioComponentFindNext", -1, error);
+	OSStatus status = AudioComponentInstanceNew(comp, &unit_);
+	if (status != noErr) {
+		unit_ = nullptr;
+		return Fail("AudioComponentInstanceNew", status, error);
+	}
+	status = AudioUnitSetProperty(unit_, kAudioOutputUnitProperty_CurrentDevice, kAudioUnitScope_Global, 0,
+	                              &device.id, sizeof(device.id));
+	if (status != noErr) return Fail("Set CurrentDevice", status, error);
+
+	if (lowLatency) {
+		// The IO buffer size is per process; the HAL clamps it to the device's range
+		AudioObjectPropertyAddress address = {
+			kAudioDevicePropertyBufferFrameSizeRange, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain
+		};
+		AudioValueRange range = {};
+		UInt32 size = sizeof(range);
+		UInt32 frames = kLowLatencyFrames;
+		if (AudioObjectGetPropertyData(device.id, &address, 0, nullptr, &size, &range) == noErr) {
+			frames = (UInt32)std::max<Float64>(range.mMinimum, std::min<Float64>(range.mMaximum, kLowLatencyFrames));
+		}
+		status = AudioUnitSetProperty(unit_, kAudioDevicePropertyBufferFrameSize, kAudioUnitScope_Global, 0,
+		                              &frames, sizeof(frames));
+		if (status != noErr) AddonLog(LogLevel::Warn, "Soundboard output: could not set a %u-frame IO buffer: %d", (unsigned)frames, (int)status);
+		else AddonLog(LogLevel::Info, "Soundboard output: %u-frame IO buffer", (unsigned)frames);
+	}
+
+	AudioStreamBasicDescription format = {};
+	format.mSampleRate = kSoundboardRate;
+	format.mFormatID = kAudioFormatLinearPCM;
+	format.mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked;
+	format.mChannelsPerFrame = kSoundboardChannels;
+	format.mBitsPerChannel = 32;
+	format.mFramesPerPacket = 1;
+	format.mBytesPerFrame = kSoundboardChannels * sizeof(float);
+	format.mBytesPerPacket = format.mBytesPerFrame;
+	status = AudioUnitSetProperty(unit_, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Input, 0, &format, sizeof(format));
+	if (status != noErr) return Fail("Set StreamFormat", status, error);
+
+	AURenderCallbackStruct callback = { &SoundboardOutput::Render, this };
+	status = AudioUnitSetProperty(unit_, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0,
+	                              &callback, sizeof(callback));
+	if (status != noErr) return Fail("Set RenderCallback", status, error);
+
+	source_ = source;
+	status = AudioUnitInitialize(unit_);
+	if (status != noErr) return Fail("AudioUnitInitialize", status, error);
+	source_->Attach();
+	status = AudioOutputUnitStart(unit_);
+	if (status != noErr) {
+		source_->Detach();
+		return Fail("AudioOutputUnitStart", status, error);
+	}
+	*name = device.name;
+	AddonLog(LogLevel::Info, "Soundboard output on '%s'", device.name.c_str());
+	return true;
+}
+
+void SoundboardOutput::Stop() {
+	if (!unit_) return;
+	AudioOutputUnitStop(unit_); // returns once the render callback has finished
+	AudioUnitUninitialize(unit_);
+	AudioComponentInstanceDispose(unit_);
+	unit_ = nullptr;
+	if (source_) source_->Detach();
+}
+
+// Render thread
+OSStatus SoundboardOutput::Render(void* refCon, AudioUnitRenderActionFlags*, const AudioTimeStamp*, UInt32,
+                                  UInt32 frames, AudioBufferList* data) {
+	SoundboardOutput* self = static_cast<SoundboardOutput*>(refCon);
+	AudioBuffer& buffer = data->mBuffers[0];
+	self->source_->Render(static_cast<float*>(buffer.mData), frames, buffer.mNumberChannels);
+	return noErr;
+}
+
+bool SoundboardOutput::Fail(const char* what, OSStatus status, std::string* error) {
+	char text[128];
+	snprintf(text, sizeof(text), "%s failed: %d", what, (int)status);
+	AddonLog(LogLevel::Error, "Soundboard output: %s", text);
+	*error = text;
+	if (unit_) {
+		AudioComponentInstanceDispose(unit_);
+		unit_ = nullptr;
+	}
+	return false;
+}
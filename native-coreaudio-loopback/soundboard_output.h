@@ -0,0 +1,41 @@
+#pragma once
+
+// AUHAL output unit rendering one RenderSource: a soundboard bus
+// (soundboard_engine.h) or a render session (render_session.h). The unit's
+// client format is 48 kHz stereo float, so the unit converts to the device
+// format; the source is mixed straight into the IO buffer on the unit's render
+// thread. With lowLatency the unit asks for the device's smallest IO buffer
+// (kLowLatencyFrames at most). Implemented in soundboard_output.cc.
+
+#include <AudioUnit/AudioUnit.h>
+
+#include <string>
+
+#include "render_source.h"
+#include "soundboard_engine.h"
+
+class SoundboardOutput {
+public:
+	SoundboardOutput() = default;
+	SoundboardOutput(const SoundboardOutput&) = delete;
+	SoundboardOutput& operator=(const SoundboardOutput&) = delete;
+	~SoundboardOutput() { Stop(); }
+
+	static constexpr UInt32 kLowLatencyFrames = 128;
+
+	// Opens the first output device whose lowercased name contains lowerNeedle
+	// (the default output when empty) and starts rendering source; *name gets
+	// the device name.
+	bool Start(const std::string& lowerNeedle, RenderSource* source, std::string* name, std::string* error,
+	           bool lowLatency = false);
+	void Stop();
+	bool Running() const { return unit_ != nullptr; }
+
+private:
+	static OSStatus Render(void* refCon, AudioUnitRenderActionFlags* flags, const AudioTimeStamp* timestamp,
+	                       UInt32 busNumber, UInt32 frames, AudioBufferList* data);
+	bool Fail(const char* what, OSStatus status, std::string* error);
+
+	AudioUnit unit_ = nullptr;
+	RenderSource* source_ = nullptr;
+};
@@ -1,11 +1,40 @@
 {
+  "variables": {
+    "variables": {
+      "conditions": [
+        ["target_arch=='arm64'", { "prebuilt_dir%": "win-arm64" }, { "prebuilt_dir%": "win" }]
+      ]
+    },
+    "prebuilt_dir%": "<(prebuilt_dir)",
+    "use_swresample%": 0,
+    "ffmpeg_dir%": "<(module_root_dir)/../ffmpeg/<(prebuilt_dir)",
+    "use_opus%": 0,
+    "opus_dir%": "<(module_root_dir)/../ffmpeg/<(prebuilt_dir)",
+    "use_avcodec%": 0,
+    "use_avfilter%": 0,
+    "use_avformat%": 0,
+    "use_swscale%": 0,
+    "use_avtx%": 0,
+    "use_whisper%": 0,
+    "whisper_dir%": "<(module_root_dir)/../whisper/<(prebuilt_dir)",
+    "whisper_backend_dl%": 0,
+    "use_ctranslate2%": 0,
+    "ctranslate2_dir%": "<(module_root_dir)/../ctranslate2/<(prebuilt_dir)",
+    "use_tesseract%": 0,
+    "tesseract_dir%": "<(module_root_dir)/../tesseract/<(prebuilt_dir)",
+    "use_onnxruntime%": 0,
+    "onnxruntime_dir%": "<(module_root_dir)/../onnxruntime/<(prebuilt_dir)",
+    "use_espeak%": 0,
+    "espeak_dir%": "<(module_root_dir)/../espeak-ng/<(prebuilt_dir)"
+  },
   "targets": [
     {
       "target_name": "wasapi_loopback",
-      "sources": [ "wasapi_loopback.cc" ],
+      "sources": [ "wasapi_loopback.cc", "com_control.cc", "session_registry.cc", "soundboard_output.cc", "window_pid_cache.cc", "desktop_duplication.cc", "power_watch.cc", "http_client.cc" ],
       "include_dirs": [
         "<!(node -p \"require('node-addon-api').include\")",
-        "<(module_root_dir)/node_modules/node-addon-api"
+        "<(module_root_dir)/node_modules/node-addon-api",
+        "<(module_root_dir)/../native-audio-core"
       ],
       "dependencies": [
         "<!(node -p \"require('node-addon-api').gyp\")"
@@ -21,7 +50,12 @@
         "-luuid",
         "-lwinmm",
         "-lavrt",
-        "-lmmdevapi"
+        "-lmmdevapi",
+        "-ld3d11",
+        "-ld3dcompiler",
+        "-ldxgi",
+        "-lpowrprof",
+        "-lwinhttp"
       ],
       "msvs_settings": {
         "VCCLCompilerTool": {
@@ -29,7 +63,122 @@
           "AdditionalOptions": ["/std:c++17"],
           "AdditionalIncludeDirectories": ["$(UniversalCRT_IncludePath)", "$(WindowsSdkDir)Include\\10.0.19041.0\\um", "$(WindowsSdkDir)Include\\10.0.19041.0\\shared"]
         }
-      }
+      },
+      "conditions": [
+        ["use_swresample==1", {
+          "defines": [ "AUDIO_CORE_SWRESAMPLE" ],
+          "include_dirs": [ "<(ffmpeg_dir)/include" ],
+          "libraries": [
+            "<(ffmpeg_dir)/lib/swresample.lib",
+            "<(ffmpeg_dir)/lib/avutil.lib",
+            "-lbcrypt"
+          ]
+        }],
+        ["use_opus==1", {
+          "defines": [ "AUDIO_CORE_OPUS" ],
+          "include_dirs": [ "<(opus_dir)/include/opus" ],
+          "libraries": [ "<(opus_dir)/lib/opus.lib" ]
+        }],
+        ["use_avcodec==1", {
+          "defines": [ "AUDIO_CORE_AVCODEC" ],
+          "include_dirs": [ "<(ffmpeg_dir)/include" ],
+          "libraries": [
+            "<(ffmpeg_dir)/lib/avcodec.lib",
+            "<(ffmpeg_dir)/lib/swresample.lib",
+            "<(ffmpeg_dir)/lib/avutil.lib",
+            "-lbcrypt"
+          ]
+        }],
+        ["use_avformat==1", {
+          "defines": [ "AUDIO_CORE_AVFORMAT" ],
+          "include_dirs": [ "<(ffmpeg_dir)/include" ],
+          "libraries": [
+            "<(ffmpeg_dir)/lib/avformat.lib",
+            "<(ffmpeg_dir)/lib/avcodec.lib",
+            "<(ffmpeg_dir)/lib/swresample.lib",
+            "<(ffmpeg_dir)/lib/avutil.lib",
+            "-lbcrypt",
+            "-lsecur32",
+            "-lws2_32"
+          ]
+        }],
+        ["use_avfilter==1", {
+          "defines": [ "AUDIO_CORE_AVFILTER" ],
+          "include_dirs": [ "<(ffmpeg_dir)/include" ],
+          "libraries": [
+            "<(ffmpeg_dir)/lib/avfilter.lib",
+            "<(ffmpeg_dir)/lib/swscale.lib",
+            "<(ffmpeg_dir)/lib/avformat.lib",
+            "<(ffmpeg_dir)/lib/avcodec.lib",
+            "<(ffmpeg_dir)/lib/swresample.lib",
+            "<(ffmpeg_dir)/lib/avutil.lib",
+            "-lbcrypt"
+          ]
+        }],
+        ["use_swscale==1", {
+          "defines": [ "AUDIO_CORE_SWSCALE" ],
+          "include_dirs": [ "<(ffmpeg_dir)/include" ],
+          "libraries": [
+            "<(ffmpeg_dir)/lib/swscale.lib",
+            "<(ffmpeg_dir)/lib/avutil.lib",
+            "-lbcrypt"
+          ]
+        }],
+        ["use_avtx==1", {
+          "defines": [ "AUDIO_CORE_AVTX" ],
+          "include_dirs": [ "<(ffmpeg_dir)/include" ],
+          "libraries": [
+            "<(ffmpeg_dir)/lib/avutil.lib",
+            "-lbcrypt"
+          ]
+        }],
+        ["use_whisper==1", {
+          "defines": [ "AUDIO_CORE_WHISPER" ],
+          "include_dirs": [ "<(whisper_dir)/include" ],
+          "libraries": [
+            "<(whisper_dir)/lib/whisper.lib",
+            "<(whisper_dir)/lib/ggml.lib",
+            "<(whisper_dir)/lib/ggml-base.lib"
+          ],
+          "conditions": [
+            ["whisper_backend_dl==1", {
+              "defines": [ "AUDIO_CORE_WHISPER_BACKEND_DL" ]
+            }, {
+              "libraries": [ "<(whisper_dir)/lib/ggml-cpu.lib" ]
+            }]
+          ]
+        }],
+        ["use_ctranslate2==1", {
+          "defines": [ "AUDIO_CORE_CTRANSLATE2" ],
+          "include_dirs": [ "<(ctranslate2_dir)/include" ],
+          "libraries": [
+            "<(ctranslate2_dir)/lib/ctranslate2.lib",
+            "<(ctranslate2_dir)/lib/sentencepiece.lib"
+          ]
+        }],
+        ["use_tesseract==1", {
+          "defines": [ "AUDIO_CORE_TESSERACT" ],
+          "include_dirs": [ "<(tesseract_dir)/include" ],
+          "libraries": [
+            "<(tesseract_dir)/lib/tesseract55.lib",
+            "<(tesseract_dir)/lib/leptonica-1.85.0.lib"
+          ]
+        }],
+        ["use_onnxruntime==1", {
+          "defines": [ "AUDIO_CORE_ONNXRUNTIME" ],
+          "include_dirs": [ "<(onnxruntime_dir)/include" ],
+          "libraries": [
+            "<(onnxruntime_dir)/lib/onnxruntime.lib"
+          ]
+        }],
+        ["use_espeak==1", {
+          "defines": [ "AUDIO_CORE_ESPEAK" ],
+          "include_dirs": [ "<(espeak_dir)/include" ],
+          "libraries": [
+            "<(espeak_dir)/lib/espeak-ng.lib"
+          ]
+        }]
+      ]
     }
   ]
 }
@@ -0,0 +1,98 @@
+#include "com_control.h"
+
+#include <wrl/client.h>
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "addon_log.h"
+#include "thread_cpu.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+
+thread_local bool t_controlThread = false;
+
+// Lives for the process like the task pool's workers: the thread is never
+// joined and the apartment never left, since an unload mid-call would leave
+// COM objects behind whichever way.
+class ComControlThread {
+public:
+	void Post(ComControlTask task) {
+		std::call_once(started_, [this] { std::thread([this] { Run(); }).detach(); });
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			tasks_.push_back(std::move(task));
+		}
+		wake_.notify_one();
+	}
+
+	IMMDeviceEnumerator* Enumerator() {
+		if (!enumerator_ && apartment_) {
+			const HRESULT hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&enumerator_));
+			if (FAILED(hr)) AddonLog(LogLevel::Error, "COM control: create MMDeviceEnumerator failed: 0x%08lx", hr);
+		}
+		return enumerator_.Get();
+	}
+
+private:
+	void Run() {
+		ThreadCpuScope cpu("com-control");
+		t_controlThread = true;
+		const HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+		apartment_ = SUCCEEDED(hr);
+		if (!apartment_) AddonLog(LogLevel::Error, "COM control: CoInitializeEx failed: 0x%08lx", hr);
+		for (;;) {
+			ComControlTask task;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				wake_.wait(lock, [this] { return !tasks_.empty(); });
+				task = std::move(tasks_.front());
+				tasks_.pop_front();
+			}
+			task();
+		}
+	}
+
+	std::once_flag started_;
+	std::mutex mutex_; // tasks_
+	std::condition_variable wake_;
+	std::deque<ComControlTask> tasks_;
+
+	// Control thread only
+	bool apartment_ = false;
+	ComPtr<IMMDeviceEnumerator> enumerator_;
+};
+
+ComControlThread& ControlThread() {
+	static ComControlThread* thread = new ComControlThread(); // outlives static destruction, as its thread does
+	return *thread;
+}
+
+} // namespace
+
+void PostComControl(ComControlTask task) {
+	ControlThread().Post(std::move(task));
+}
+
+void RunComControl(const ComControlTask& task) {
+	if (t_controlThread) {
+		task();
+		return;
+	}
+	std::promise<void> done;
+	std::future<void> finished = done.get_future();
+	ControlThread().Post([&task, &done] {
+		task();
+		done.set_value();
+	});
+	finished.wait();
+}
+
+IMMDeviceEnumerator* ComControlEnumerator() {
+	return ControlThread().Enumerator();
+}
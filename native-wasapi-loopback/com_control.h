@@ -0,0 +1,38 @@
+#pragma once
+
+// The addon's one thread for WASAPI / MMDevice control work: session and
+// endpoint enumeration, the session registry's notifications and the meter
+// reads behind getSessionLevels(). It joins the MTA once and creates the
+// IMMDeviceEnumerator once, keeping both for the life of the process, so a
+// control call neither pays COM setup nor runs on Electron's STA main thread.
+// Capture and render streams keep their own MMCSS threads. Implemented in
+// com_control.cc.
+//
+// Tasks run one at a time, in the order posted. RunComControl blocks its
+// caller until the task has run (inline when called on the control thread);
+// QueueComControl is the promise form for bindings (async_query.h).
+
+#include <windows.h>
+#include <mmdeviceapi.h>
+
+#include <napi.h>
+
+#include <functional>
+#include <utility>
+
+#include "async_query.h"
+
+using ComControlTask = std::function<void()>;
+
+// Any thread.
+void PostComControl(ComControlTask task);
+void RunComControl(const ComControlTask& task);
+
+// Control thread only: the shared enumerator, null when COM or its creation
+// failed (created again on the next call).
+IMMDeviceEnumerator* ComControlEnumerator();
+
+template <class Work, class ToJs>
+Napi::Promise QueueComControl(Napi::Env env, const char* name, Work work, ToJs toJs) {
+	return QueueQueryVia(env, name, [](ComControlTask task) { PostComControl(std::move(task)); }, std::move(work), std::move(toJs));
+}
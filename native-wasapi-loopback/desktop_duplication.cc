@@ -0,0 +1,383 @@
+#include "desktop_duplication.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "addon_log.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+
+bool Intersects(const RECT& a, const RECT& b) {
+	return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
+
+std::string HrError(const char* what, HRESULT hr) {
+	char text[128];
+	snprintf(text, sizeof(text), "%s failed (0x%08lx)", what, (unsigned long)hr);
+	return text;
+}
+
+// Scales the region (a texture of its own) into the output: four bilinear
+// taps a quarter of an output pixel apart, which covers shrinking to about a
+// quarter without aliasing. GRAY writes BT.601 luma to an R8 target; colour
+// goes to RGBA swizzled so the bytes read back as BGRA.
+const char kPassShader[] = R"(
+Texture2D<float4> region : register(t0);
+SamplerState linearClamp : register(s0);
+#if GRAY
+RWTexture2D<float> target : register(u0);
+#else
+RWTexture2D<float4> target : register(u0);
+#endif
+cbuffer Pass : register(b0) { float2 step; uint2 size; };
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID) {
+	if (id.x >= size.x || id.y >= size.y) return;
+	float2 uv = (float2(id.xy) + 0.5) * step;
+	float2 q = 0.25 * step;
+	float4 c = 0.25 * (region.SampleLevel(linearClamp, uv + float2(-q.x, -q.y), 0) +
+	                   region.SampleLevel(linearClamp, uv + float2(q.x, -q.y), 0) +
+	                   region.SampleLevel(linearClamp, uv + float2(-q.x, q.y), 0) +
+	                   region.SampleLevel(linearClamp, uv + float2(q.x, q.y), 0));
+#if GRAY
+	target[id.xy] = dot(c.rgb, float3(0.299, 0.587, 0.114));
+#else
+	target[id.xy] = c.bgra;
+#endif
+}
+)";
+
+} // namespace
+
+void DesktopDuplicationGrabber::Configure(const RegionCaptureOptions& options) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	options_ = options;
+	configured_ = true;
+	tiles_.Configure(options.tileSize);
+	// Reopened on the next grab: the region may be on another output or another size
+	Release();
+}
+
+void DesktopDuplicationGrabber::Close() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	configured_ = false;
+	Release();
+}
+
+void DesktopDuplicationGrabber::Release() {
+	staging_.Reset();
+	regionTexture_.Reset();
+	regionView_.Reset();
+	target_.Reset();
+	targetView_.Reset();
+	shader_.Reset();
+	sampler_.Reset();
+	constants_.Reset();
+	gpuPass_ = false;
+	duplication_.Reset();
+	context_.Reset();
+	device_.Reset();
+	hasFrame_ = false;
+}
+
+bool DesktopDuplicationGrabber::Open(std::string* error) {
+	const RegionRect& r = options_.rect;
+	const POINT origin = { r.x, r.y };
+	ComPtr<IDXGIFactory1> factory;
+	HRESULT hr = CreateDXGIFactory1(IID_PPV_ARGS(&factory));
+	if (FAILED(hr)) { *error = HrError("CreateDXGIFactory1", hr); return false; }
+
+	// The output whose desktop holds the region's top-left corner
+	ComPtr<IDXGIAdapter1> adapter;
+	ComPtr<IDXGIOutput> output;
+	DXGI_OUTPUT_DESC desc = {};
+	for (UINT a = 0; !output && factory->EnumAdapters1(a, &adapter) != DXGI_ERROR_NOT_FOUND; ++a) {
+		ComPtr<IDXGIOutput> candidate;
+		for (UINT o = 0; adapter->EnumOutputs(o, &candidate) != DXGI_ERROR_NOT_FOUND; ++o) {
+			if (SUCCEEDED(candidate->GetDesc(&desc)) && desc.AttachedToDesktop && PtInRect(&desc.DesktopCoordinates, origin)) {
+				output = candidate;
+				break;
+			}
+		}
+		if (!output) adapter.Reset();
+	}
+	if (!output) { *error = "No display contains the region"; return false; }
+	if (desc.Rotation != DXGI_MODE_ROTATION_IDENTITY && desc.Rotation != DXGI_MODE_ROTATION_UNSPECIFIED) {
+		*error = "Rotated displays are not supported";
+		return false;
+	}
+	output_ = desc.DesktopCoordinates;
+	region_.left = r.x - output_.left;
+	region_.top = r.y - output_.top;
+	region_.right = std::min<LONG>(r.x + (LONG)r.width, output_.right) - output_.left;
+	region_.bottom = std::min<LONG>(r.y + (LONG)r.height, output_.bottom) - output_.top;
+	shown_.x = output_.left + region_.left;
+	shown_.y = output_.top + region_.top;
+	shown_.width = (uint32_t)(region_.right - region_.left);
+	shown_.height = (uint32_t)(region_.bottom - region_.top);
+
+	// The device must live on the output's adapter to duplicate it
+	hr = D3D11CreateDevice(adapter.Get(), D3D_DRIVER_TYPE_UNKNOWN, nullptr, 0, nullptr, 0, D3D11_SDK_VERSION,
+	                       &device_, nullptr, &context_);
+	if (FAILED(hr)) { *error = HrError("D3D11CreateDevice", hr); return false; }
+	ComPtr<IDXGIOutput1> output1;
+	hr = output.As(&output1);
+	if (SUCCEEDED(hr)) hr = output1->DuplicateOutput(device_.Get(), &duplication_);
+	if (FAILED(hr)) {
+		*error = hr == DXGI_ERROR_NOT_CURRENTLY_AVAILABLE ? "Too many desktop duplications are open"
+		                                                   : HrError("DuplicateOutput", hr);
+		Release();
+		return false;
+	}
+
+	outWidth_ = std::max<uint32_t>(1, (uint32_t)std::lround(shown_.width * options_.scale));
+	outHeight_ = std::max<uint32_t>(1, (uint32_t)std::lround(shown_.height * options_.scale));
+	if (options_.format == RegionFormat::Gray || outWidth_ != shown_.width || outHeight_ != shown_.height) {
+		std::string passError;
+		gpuPass_ = OpenPass(&passError);
+		if (!gpuPass_) AddonLog(LogLevel::Warn, "Region capture: converting on the CPU (%s)", passError.c_str());
+	}
+
+	D3D11_TEXTURE2D_DESC td = {};
+	td.Width = gpuPass_ ? outWidth_ : shown_.width;
+	td.Height = gpuPass_ ? outHeight_ : shown_.height;
+	td.MipLevels = 1;
+	td.ArraySize = 1;
+	td.Format = !gpuPass_ ? DXGI_FORMAT_B8G8R8A8_UNORM
+	          : options_.format == RegionFormat::Gray ? DXGI_FORMAT_R8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM;
+	td.SampleDesc.Count = 1;
+	td.Usage = D3D11_USAGE_STAGING;
+	td.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	hr = device_->CreateTexture2D(&td, nullptr, &staging_);
+	if (FAILED(hr)) { *error = HrError("CreateTexture2D", hr); Release(); return false; }
+	hasFrame_ = false;
+	unhashed_ = false;
+	tiles_.Reset();
+	AddonLog(LogLevel::Info, "Region capture: duplicating output (%ld,%ld), region %ldx%ld, frames %ux%u%s",
+	         output_.left, output_.top, region_.right - region_.left, region_.bottom - region_.top,
+	         outWidth_, outHeight_, gpuPass_ ? " (GPU pass)" : "");
+	return true;
+}
+
+// The compute pass's shader, textures and state; false (nothing kept) when
+// the device or the shader compiler cannot run it.
+bool DesktopDuplicationGrabber::OpenPass(std::string* error) {
+	if (device_->GetFeatureLevel() < D3D_FEATURE_LEVEL_11_0) { *error = "feature level below 11_0"; return false; }
+	const bool gray = options_.format == RegionFormat::Gray;
+	const D3D_SHADER_MACRO defines[] = { { "GRAY", gray ? "1" : "0" }, { nullptr, nullptr } };
+	ComPtr<ID3DBlob> code, messages;
+	HRESULT hr = D3DCompile(kPassShader, sizeof(kPassShader) - 1, "region_pass", defines, nullptr, "main", "cs_5_0",
+	                        D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, &code, &messages);
+	if (FAILED(hr)) {
+		*error = messages ? std::string(static_cast<const char*>(messages->GetBufferPointer()), messages->GetBufferSize())
+		                  : HrError("D3DCompile", hr);
+		return false;
+	}
+	hr = device_->CreateComputeShader(code->GetBufferPointer(), code->GetBufferSize(), nullptr, &shader_);
+	if (FAILED(hr)) { *error = HrError("CreateComputeShader", hr); return false; }
+
+	D3D11_TEXTURE2D_DESC td = {};
+	td.Width = shown_.width;
+	td.Height = shown_.height;
+	td.MipLevels = 1;
+	td.ArraySize = 1;
+	td.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	td.SampleDesc.Count = 1;
+	td.Usage = D3D11_USAGE_DEFAULT;
+	td.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	hr = device_->CreateTexture2D(&td, nullptr, &regionTexture_);
+	if (SUCCEEDED(hr)) hr = device_->CreateShaderResourceView(regionTexture_.Get(), nullptr, &regionView_);
+	if (FAILED(hr)) { *error = HrError("region texture", hr); return false; }
+	td.Width = outWidth_;
+	td.Height = outHeight_;
+	td.Format = gray ? DXGI_FORMAT_R8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM;
+	td.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	hr = device_->CreateTexture2D(&td, nullptr, &target_);
+	if (SUCCEEDED(hr)) hr = device_->CreateUnorderedAccessView(target_.Get(), nullptr, &targetView_);
+	if (FAILED(hr)) { *error = HrError("target texture", hr); return false; }
+
+	D3D11_SAMPLER_DESC sd = {};
+	sd.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	sd.AddressU = sd.AddressV = sd.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	sd.MaxLOD = D3D11_FLOAT32_MAX;
+	hr = device_->CreateSamplerState(&sd, &sampler_);
+	if (FAILED(hr)) { *error = HrError("CreateSamplerState", hr); return false; }
+
+	struct { float step[2]; uint32_t size[2]; } pass = { { 1.0f / outWidth_, 1.0f / outHeight_ }, { outWidth_, outHeight_ } };
+	D3D11_BUFFER_DESC bd = {};
+	bd.ByteWidth = sizeof(pass);
+	bd.Usage = D3D11_USAGE_IMMUTABLE;
+	bd.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	D3D11_SUBRESOURCE_DATA initial = { &pass, 0, 0 };
+	hr = device_->CreateBuffer(&bd, &initial, &constants_);
+	if (FAILED(hr)) { *error = HrError("CreateBuffer", hr); return false; }
+	return true;
+}
+
+// Region of the desktop image -> regionTexture_ -> pass -> target_ -> staging_
+void DesktopDuplicationGrabber::RunPass(ID3D11Texture2D* desktop) {
+	D3D11_BOX box = { (UINT)region_.left, (UINT)region_.top, 0, (UINT)region_.right, (UINT)region_.bottom, 1 };
+	context_->CopySubresourceRegion(regionTexture_.Get(), 0, 0, 0, 0, desktop, 0, &box);
+	ID3D11ShaderResourceView* views[] = { regionView_.Get() };
+	ID3D11UnorderedAccessView* targets[] = { targetView_.Get() };
+	ID3D11SamplerState* samplers[] = { sampler_.Get() };
+	ID3D11Buffer* buffers[] = { constants_.Get() };
+	context_->CSSetShader(shader_.Get(), nullptr, 0);
+	context_->CSSetShaderResources(0, 1, views);
+	context_->CSSetUnorderedAccessViews(0, 1, targets, nullptr);
+	context_->CSSetSamplers(0, 1, samplers);
+	context_->CSSetConstantBuffers(0, 1, buffers);
+	context_->Dispatch((outWidth_ + 7) / 8, (outHeight_ + 7) / 8, 1);
+	ID3D11ShaderResourceView* noViews[] = { nullptr };
+	ID3D11UnorderedAccessView* noTargets[] = { nullptr };
+	context_->CSSetShaderResources(0, 1, noViews);
+	context_->CSSetUnorderedAccessViews(0, 1, noTargets, nullptr);
+	context_->CSSetShader(nullptr, nullptr, 0);
+	context_->CopyResource(staging_.Get(), target_.Get());
+}
+
+// Whether this frame's dirty or move rectangles touch the region; collects
+// the parts inside it into hints_.
+bool DesktopDuplicationGrabber::RegionChanged(const DXGI_OUTDUPL_FRAME_INFO& info) {
+	hints_.clear();
+	hinted_ = false;
+	if (info.TotalMetadataBufferSize == 0) return true; // no metadata: assume the worst
+	if (metadata_.size() < info.TotalMetadataBufferSize) metadata_.resize(info.TotalMetadataBufferSize);
+	auto hint = [this](const RECT& r) {
+		if (!Intersects(r, region_)) return;
+		TileRect t;
+		t.x = (uint32_t)(std::max(r.left, region_.left) - region_.left);
+		t.y = (uint32_t)(std::max(r.top, region_.top) - region_.top);
+		t.width = (uint32_t)(std::min(r.right, region_.right) - region_.left) - t.x;
+		t.height = (uint32_t)(std::min(r.bottom, region_.bottom) - region_.top) - t.y;
+		if (gpuPass_ && (outWidth_ != shown_.width || outHeight_ != shown_.height)) {
+			// Into output pixels, widened by one for the filter's reach
+			const double sx = (double)outWidth_ / shown_.width, sy = (double)outHeight_ / shown_.height;
+			const uint32_t x0 = (uint32_t)std::max(0.0, std::floor(t.x * sx) - 1);
+			const uint32_t y0 = (uint32_t)std::max(0.0, std::floor(t.y * sy) - 1);
+			const uint32_t x1 = std::min<uint32_t>(outWidth_, (uint32_t)std::ceil((t.x + t.width) * sx) + 1);
+			const uint32_t y1 = std::min<uint32_t>(outHeight_, (uint32_t)std::ceil((t.y + t.height) * sy) + 1);
+			t = { x0, y0, x1 - x0, y1 - y0 };
+		}
+		hints_.push_back(t);
+	};
+	UINT size = 0;
+	auto* moves = reinterpret_cast<DXGI_OUTDUPL_MOVE_RECT*>(metadata_.data());
+	if (FAILED(duplication_->GetFrameMoveRects((UINT)metadata_.size(), moves, &size))) return true;
+	for (UINT i = 0; i < size / sizeof(DXGI_OUTDUPL_MOVE_RECT); ++i) hint(moves[i].DestinationRect);
+	auto* dirty = reinterpret_cast<RECT*>(metadata_.data());
+	if (FAILED(duplication_->GetFrameDirtyRects((UINT)metadata_.size(), dirty, &size))) {
+		hints_.clear();
+		return true;
+	}
+	for (UINT i = 0; i < size / sizeof(RECT); ++i) hint(dirty[i]);
+	hinted_ = true;
+	return !hints_.empty();
+}
+
+// Copies the newest presented frame into staging_ when it touches the
+// region, waiting up to timeoutMs for one; *copied tells whether it did.
+bool DesktopDuplicationGrabber::Acquire(uint32_t timeoutMs, bool* copied, std::string* error) {
+	*copied = false;
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		DXGI_OUTDUPL_FRAME_INFO info = {};
+		ComPtr<IDXGIResource> resource;
+		// The first frame after opening is the whole desktop and arrives at once
+		HRESULT hr = duplication_->AcquireNextFrame(hasFrame_ ? timeoutMs : std::max<uint32_t>(timeoutMs, 500), &info, &resource);
+		if (hr == DXGI_ERROR_ACCESS_LOST) {
+			// Mode change, secure desktop or a full-screen app: start over
+			Release();
+			if (!Open(error)) return false;
+			continue;
+		}
+		if (hr == DXGI_ERROR_WAIT_TIMEOUT) break; // nothing presented; staging_ is current
+		if (FAILED(hr)) { *error = HrError("AcquireNextFrame", hr); return false; }
+		// A pointer-only update presents nothing
+		if (info.LastPresentTime.QuadPart != 0 && (!hasFrame_ || RegionChanged(info))) {
+			ComPtr<ID3D11Texture2D> desktop;
+			if (SUCCEEDED(resource.As(&desktop))) {
+				if (gpuPass_) {
+					RunPass(desktop.Get());
+				} else {
+					D3D11_BOX box = { (UINT)region_.left, (UINT)region_.top, 0, (UINT)region_.right, (UINT)region_.bottom, 1 };
+					context_->CopySubresourceRegion(staging_.Get(), 0, 0, 0, 0, desktop.Get(), 0, &box);
+				}
+				LARGE_INTEGER frequency;
+				QueryPerformanceFrequency(&frequency);
+				presentedMs_ = (double)info.LastPresentTime.QuadPart * 1000.0 / (double)frequency.QuadPart;
+				*copied = true;
+				hasFrame_ = true;
+			}
+		}
+		duplication_->ReleaseFrame();
+		break;
+	}
+	if (!hasFrame_) { *error = "No desktop frame within the timeout"; return false; }
+	return true;
+}
+
+bool DesktopDuplicationGrabber::Grab(uint32_t timeoutMs, RegionFrame* frame, std::string* error) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!configured_) { *error = "Region capture is closed"; return false; }
+	if (!duplication_ && !Open(error)) return false;
+	bool copied = false;
+	if (!Acquire(timeoutMs, &copied, error)) return false;
+	if (unhashed_) {
+		// The hints only cover the changes since the frame GrabRect took
+		copied = true;
+		hinted_ = false;
+		unhashed_ = false;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	HRESULT hr = context_->Map(staging_.Get(), 0, D3D11_MAP_READ, 0, &mapped);
+	if (FAILED(hr)) { *error = HrError("Map", hr); return false; }
+	frame->width = outWidth_;
+	frame->height = outHeight_;
+	frame->format = options_.format;
+	const uint8_t* pixels = static_cast<const uint8_t*>(mapped.pData);
+	if (gpuPass_) {
+		CopyRegionPixels(pixels, mapped.RowPitch, frame, options_.format == RegionFormat::Gray);
+	} else if (outWidth_ != shown_.width || outHeight_ != shown_.height) {
+		ScaleRegionPixels(pixels, mapped.RowPitch, shown_.width, shown_.height, frame);
+	} else {
+		CopyRegionPixels(pixels, mapped.RowPitch, frame);
+	}
+	context_->Unmap(staging_.Get(), 0);
+	if (copied) {
+		DetectRegionChange(&tiles_, frame, hinted_ ? &hints_ : nullptr);
+	} else {
+		KeepRegionTiles(tiles_, frame);
+	}
+	frame->timestampMs = presentedMs_;
+	return true;
+}
+
+bool DesktopDuplicationGrabber::GrabRect(const RegionRect& rect, uint32_t timeoutMs, RegionFrame* frame, std::string* error) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!configured_) { *error = "Region capture is closed"; return false; }
+	if (!duplication_ && !Open(error)) return false;
+	bool copied = false;
+	if (!Acquire(timeoutMs, &copied, error)) return false;
+	if (copied) unhashed_ = true;
+	// Cropped from staging_ as it is: scaled and converted by the pass, or not
+	const uint32_t width = gpuPass_ ? outWidth_ : shown_.width, height = gpuPass_ ? outHeight_ : shown_.height;
+	TileRect crop;
+	if (!MapRegionCrop(shown_, width, height, rect, &crop)) {
+		*error = "The rectangle is outside the capture's region";
+		return false;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	HRESULT hr = context_->Map(staging_.Get(), 0, D3D11_MAP_READ, 0, &mapped);
+	if (FAILED(hr)) { *error = HrError("Map", hr); return false; }
+	frame->format = options_.format;
+	CopyRegionCrop(static_cast<const uint8_t*>(mapped.pData), mapped.RowPitch, crop, frame, gpuPass_ && options_.format == RegionFormat::Gray);
+	context_->Unmap(staging_.Get(), 0);
+	frame->timestampMs = presentedMs_;
+	return true;
+}
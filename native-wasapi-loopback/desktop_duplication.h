@@ -0,0 +1,78 @@
+#pragma once
+
+// RegionCapture back end on Windows (region_capture.h): DXGI Desktop
+// Duplication of the output under the region. The duplication, the D3D11
+// device and a staging texture the size of the region stay open between
+// grabs; a grab copies just the region out of the desktop image on the GPU
+// and maps that. A gray or scaled capture runs a compute pass on the copy
+// first (scale with a 4-tap filter, BT.601 luma), so the staging texture and
+// the readback are at the output size, one byte a pixel for gray; without
+// feature level 11 or the shader compiler the CPU converts instead. The frame's dirty and move rectangles tell whether anything
+// inside the region changed, and an unchanged grab re-reads the staging
+// texture instead of copying again; when something did, only the tiles under
+// those rectangles are re-hashed. GrabRect maps the same staging texture
+// and copies only its rows of the rectangle, so an armed capture of a whole
+// output answers at once: the duplication holds the current desktop image
+// until it is acquired. Rotated outputs are not supported.
+// Implemented in desktop_duplication.cc.
+
+#include <windows.h>
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#include <dxgi1_2.h>
+#include <wrl/client.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "region_capture.h"
+
+class DesktopDuplicationGrabber {
+public:
+	DesktopDuplicationGrabber() = default;
+	DesktopDuplicationGrabber(const DesktopDuplicationGrabber&) = delete;
+	DesktopDuplicationGrabber& operator=(const DesktopDuplicationGrabber&) = delete;
+	~DesktopDuplicationGrabber() { Close(); }
+
+	void Configure(const RegionCaptureOptions& options);
+	bool Grab(uint32_t timeoutMs, RegionFrame* frame, std::string* error);
+	bool GrabRect(const RegionRect& rect, uint32_t timeoutMs, RegionFrame* frame, std::string* error);
+	void Close();
+
+private:
+	bool Open(std::string* error);
+	bool Acquire(uint32_t timeoutMs, bool* copied, std::string* error);
+	bool OpenPass(std::string* error);
+	void RunPass(ID3D11Texture2D* desktop);
+	void Release();
+	bool RegionChanged(const DXGI_OUTDUPL_FRAME_INFO& info);
+
+	std::mutex mutex_;
+	RegionCaptureOptions options_;
+	bool configured_ = false;
+	Microsoft::WRL::ComPtr<ID3D11Device> device_;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context_;
+	Microsoft::WRL::ComPtr<IDXGIOutputDuplication> duplication_;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> staging_; // the region (or the pass's output), reused every grab
+	// The GPU pass: the region copied, then scaled/converted into target_
+	bool gpuPass_ = false;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> regionTexture_;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> regionView_;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> target_;
+	Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> targetView_;
+	Microsoft::WRL::ComPtr<ID3D11ComputeShader> shader_;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler_;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> constants_;
+	uint32_t outWidth_ = 0, outHeight_ = 0;          // frame size after scaling
+	RECT output_ = {};                                // the output's desktop coordinates
+	RECT region_ = {};                                // clipped region, output-relative
+	RegionRect shown_;                                // the same, in desktop coordinates
+	bool hasFrame_ = false;                           // staging_ holds a grabbed region
+	double presentedMs_ = 0.0;
+	std::vector<uint8_t> metadata_;                   // dirty and move rects
+	std::vector<TileRect> hints_;                     // their parts inside the region, region-relative
+	bool hinted_ = false;                             // hints_ covers this frame's changes
+	bool unhashed_ = false;                           // GrabRect copied a frame Grab has not hashed
+	TileHasher tiles_;
+};
@@ -0,0 +1,138 @@
+// HttpPost (http_upload.h) on WinHTTP. One synchronous session for the
+// process, HTTP/2 enabled where the system's WinHTTP has it; its connection
+// handles are kept per host, so requests to a provider reuse the pooled
+// keep-alive (or multiplexed HTTP/2) connections instead of a new TLS
+// handshake per chunk. Proxies follow the system settings.
+
+#include <windows.h>
+#include <winhttp.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "addon_log.h"
+#include "http_upload.h"
+
+namespace {
+
+std::wstring Widen(const std::string& s) {
+	if (s.empty()) return std::wstring();
+	const int n = MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), nullptr, 0);
+	std::wstring w(n, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, s.data(), (int)s.size(), &w[0], n);
+	return w;
+}
+
+std::string WinHttpError(const char* call) {
+	return std::string(call) + " failed (WinHTTP error " + std::to_string(GetLastError()) + ")";
+}
+
+// Closes a request handle on every way out of HttpPost.
+struct RequestHandle {
+	HINTERNET handle = nullptr;
+	~RequestHandle() { if (handle) WinHttpCloseHandle(handle); }
+};
+
+class HttpSession {
+public:
+	// The connection handle for host:port, opened on first use. Handles live
+	// as long as the process: a few per provider.
+	HINTERNET Connect(const std::wstring& host, INTERNET_PORT port, std::string* error) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!session_) {
+			session_ = WinHttpOpen(L"AudioCore/1.0", WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY, WINHTTP_NO_PROXY_NAME,
+			                       WINHTTP_NO_PROXY_BYPASS, 0);
+			if (!session_) {
+				*error = WinHttpError("WinHttpOpen");
+				return nullptr;
+			}
+#if defined(WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL)
+			DWORD protocols = WINHTTP_PROTOCOL_FLAG_HTTP2;
+			if (!WinHttpSetOption(session_, WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL, &protocols, sizeof(protocols))) {
+				AddonLog(LogLevel::Info, "WinHTTP without HTTP/2 (error %lu); uploads use HTTP/1.1 keep-alive", GetLastError());
+			}
+#endif
+		}
+		const std::wstring key = host + L":" + std::to_wstring(port);
+		auto it = connections_.find(key);
+		if (it != connections_.end()) return it->second;
+		HINTERNET connection = WinHttpConnect(session_, host.c_str(), port, 0);
+		if (!connection) {
+			*error = WinHttpError("WinHttpConnect");
+			return nullptr;
+		}
+		connections_[key] = connection;
+		return connection;
+	}
+
+private:
+	std::mutex mutex_;
+	HINTERNET session_ = nullptr;
+	std::map<std::wstring, HINTERNET> connections_;
+};
+
+HttpSession& Session() {
+	static HttpSession* session = new HttpSession(); // never torn down: handles outlive any addon instance
+	return *session;
+}
+
+} // namespace
+
+bool HttpPost(const HttpRequest& request, HttpResponse* response) {
+	const std::wstring url = Widen(request.url);
+	URL_COMPONENTS parts = {};
+	parts.dwStructSize = sizeof(parts);
+	parts.dwHostNameLength = (DWORD)-1;
+	parts.dwUrlPathLength = (DWORD)-1;
+	parts.dwExtraInfoLength = (DWORD)-1;
+	if (!WinHttpCrackUrl(url.c_str(), (DWORD)url.size(), 0, &parts)) {
+		response->error = "Invalid upload URL";
+		return false;
+	}
+	const std::wstring host(parts.lpszHostName, parts.dwHostNameLength);
+	std::wstring path(parts.lpszUrlPath, parts.dwUrlPathLength);
+	if (parts.lpszExtraInfo) path.append(parts.lpszExtraInfo, parts.dwExtraInfoLength);
+	HINTERNET connection = Session().Connect(host, parts.nPort, &response->error);
+	if (!connection) return false;
+
+	RequestHandle req;
+	req.handle = WinHttpOpenRequest(connection, L"POST", path.c_str(), nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+	                                parts.nScheme == INTERNET_SCHEME_HTTPS ? WINHTTP_FLAG_SECURE : 0);
+	if (!req.handle) {
+		response->error = WinHttpError("WinHttpOpenRequest");
+		return false;
+	}
+	const int timeout = (int)request.timeoutMs;
+	WinHttpSetTimeouts(req.handle, timeout, timeout, timeout, timeout);
+	std::wstring headers;
+	for (const auto& h : request.headers) headers += Widen(h.first) + L": " + Widen(h.second) + L"\r\n";
+	if (!WinHttpSendRequest(req.handle, headers.c_str(), (DWORD)headers.size(), (LPVOID)request.body.data(),
+	                        (DWORD)request.body.size(), (DWORD)request.body.size(), 0) ||
+	    !WinHttpReceiveResponse(req.handle, nullptr)) {
+		response->error = WinHttpError("Upload");
+		return false;
+	}
+	DWORD status = 0, size = sizeof(status);
+	WinHttpQueryHeaders(req.handle, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX, &status, &size,
+	                    WINHTTP_NO_HEADER_INDEX);
+	response->status = (int)status;
+	response->body.clear();
+	for (;;) {
+		DWORD available = 0;
+		if (!WinHttpQueryDataAvailable(req.handle, &available)) {
+			response->error = WinHttpError("WinHttpQueryDataAvailable");
+			return false;
+		}
+		if (available == 0) break;
+		const size_t at = response->body.size();
+		response->body.resize(at + available);
+		DWORD read = 0;
+		if (!WinHttpReadData(req.handle, &response->body[at], available, &read)) {
+			response->error = WinHttpError("WinHttpReadData");
+			return false;
+		}
+		response->body.resize(at + read);
+	}
+	return true;
+}
@@ -0,0 +1,60 @@
+// Power watcher for option 'power' (power_state.h): the AC/DC power source
+// setting through PowerSettingRegisterNotification with a callback, so no
+// window or message loop is needed. GetSystemPowerStatus gives the source
+// before the first notification arrives.
+
+#include <windows.h>
+#include <powrprof.h>
+
+#include "addon_log.h"
+#include "power_state.h"
+
+namespace {
+
+// GUID_ACDC_POWER_SOURCE, spelled out so no library has to define it
+const GUID kAcDcPowerSource = { 0x5d3e9a59, 0xe9d5, 0x4b00, { 0xa6, 0xbd, 0xff, 0x34, 0xff, 0x51, 0x65, 0x48 } };
+
+HPOWERNOTIFY g_notify = nullptr;
+DEVICE_NOTIFY_SUBSCRIBE_PARAMETERS g_params = {};
+
+PowerSource CurrentSource() {
+	SYSTEM_POWER_STATUS status;
+	if (!GetSystemPowerStatus(&status)) return PowerSource::Unknown;
+	if (status.ACLineStatus == 1) return PowerSource::Ac;
+	if (status.ACLineStatus == 0) return PowerSource::Battery;
+	return PowerSource::Unknown;
+}
+
+// Power manager thread.
+ULONG CALLBACK PowerSettingChanged(PVOID context, ULONG type, PVOID setting) {
+	if (type != PBT_POWERSETTINGCHANGE || setting == nullptr) return ERROR_SUCCESS;
+	const POWERBROADCAST_SETTING* s = static_cast<const POWERBROADCAST_SETTING*>(setting);
+	if (s->PowerSetting != kAcDcPowerSource || s->DataLength < sizeof(DWORD)) return ERROR_SUCCESS;
+	// PoAc, PoDc or PoHot (a UPS, which has its own reasons to keep going)
+	const DWORD condition = *reinterpret_cast<const DWORD*>(s->Data);
+	static_cast<PowerState*>(context)->Set(condition == PoDc ? PowerSource::Battery : PowerSource::Ac);
+	return ERROR_SUCCESS;
+}
+
+} // namespace
+
+bool StartPowerWatch(PowerState* state) {
+	state->Set(CurrentSource());
+	g_params.Callback = PowerSettingChanged;
+	g_params.Context = state;
+	const DWORD error = PowerSettingRegisterNotification(&kAcDcPowerSource, DEVICE_NOTIFY_CALLBACK, &g_params, &g_notify);
+	if (error != ERROR_SUCCESS) {
+		g_notify = nullptr;
+		AddonLog(LogLevel::Warn, "Power source notifications unavailable (error %lu); the profile stays the one for %s",
+		         error, PowerSourceName(state->Source()));
+		return false;
+	}
+	AddonLog(LogLevel::Info, "Power watcher started (%s)", PowerSourceName(state->Source()));
+	return true;
+}
+
+void StopPowerWatch() {
+	if (g_notify) PowerSettingUnregisterNotification(g_notify);
+	g_notify = nullptr;
+	AddonLog(LogLevel::Info, "Power watcher stopped");
+}
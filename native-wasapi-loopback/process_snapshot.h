@@ -0,0 +1,135 @@
+#pragma once
+
+// Toolhelp process snapshot with case-folded name indexes, shared by the
+// process lookups in wasapi_loopback.cc and the window owner cache.
+
+#include <windows.h>
+#include <tlhelp32.h>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Lowercases ASCII in place, matching _stricmp's folding.
+inline std::string FoldCase(std::string s) {
+	for (char& c : s) if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+	return s;
+}
+
+// Name up to the first '.', so "chrome" matches "chrome.exe".
+inline std::string BaseName(const std::string& name) {
+	const size_t dot = name.find('.');
+	return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+// One Toolhelp pass over ALL running processes (not just those with audio
+// sessions). Names come straight from PROCESSENTRY32W::szExeFile, so no process
+// is opened, and both name forms are indexed case-folded.
+class ProcessSnapshot {
+public:
+	struct Entry {
+		DWORD pid;
+		DWORD parentPid;
+		std::string name; // UTF-8 exe name
+	};
+
+	ProcessSnapshot() {
+		HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+		if (hSnapshot == INVALID_HANDLE_VALUE) return;
+		const DWORD self = GetCurrentProcessId();
+		PROCESSENTRY32W pe32;
+		pe32.dwSize = sizeof(pe32);
+		if (Process32FirstW(hSnapshot, &pe32)) {
+			do {
+				// Filter out system processes and our own process
+				const DWORD pid = pe32.th32ProcessID;
+				if (pid == 0 || pid == 4 || pid == self) continue;
+				char name[MAX_PATH * 3];
+				if (!WideCharToMultiByte(CP_UTF8, 0, pe32.szExeFile, -1, name, (int)sizeof(name), nullptr, nullptr) || !name[0]) continue;
+				const size_t index = entries_.size();
+				entries_.push_back(Entry{ pid, pe32.th32ParentProcessID, name });
+				const std::string folded = FoldCase(name);
+				byName_[folded].push_back(index);
+				byBase_[BaseName(folded)].push_back(index);
+				byPid_[pid] = index;
+			} while (Process32NextW(hSnapshot, &pe32));
+		}
+		CloseHandle(hSnapshot);
+	}
+
+	const std::vector<Entry>& Entries() const { return entries_; }
+
+	// Empty when the PID wasn't running at snapshot time.
+	const std::string& NameOf(DWORD pid) const {
+		static const std::string none;
+		auto it = byPid_.find(pid);
+		return it == byPid_.end() ? none : entries_[it->second].name;
+	}
+
+	// Topmost ancestor of pid with the same exe name: the browser or Electron
+	// main process rather than the renderer or audio utility process the match
+	// happened to hit, so a process-tree loopback covers the whole app. Parent
+	// PIDs can be stale (reused), hence the name check and the step limit.
+	DWORD TreeRoot(DWORD pid) const {
+		auto it = byPid_.find(pid);
+		if (it == byPid_.end()) return pid;
+		const std::string name = FoldCase(entries_[it->second].name);
+		for (int steps = 0; steps < 16; ++steps) {
+			auto parent = byPid_.find(entries_[it->second].parentPid);
+			if (parent == byPid_.end() || parent->second == it->second || FoldCase(entries_[parent->second].name) != name) break;
+			it = parent;
+		}
+		return entries_[it->second].pid;
+	}
+
+	// Where per-app loopback should point for a set of name matches: the tree
+	// root (as TreeRoot) of the match whose tree owns an audio session, and
+	// that session's PID, which for Chrome, Edge, Discord or Teams is a
+	// utility or WebView2 process rather than the match itself. Session owners
+	// are walked up through parent PIDs regardless of name; without any in a
+	// match's tree, the first match's root and an audioPid of 0.
+	struct AudioTree {
+		DWORD root = 0;
+		DWORD audioPid = 0;
+	};
+	AudioTree ResolveAudioTree(const std::vector<size_t>& matches, const std::vector<DWORD>& sessionPids) const {
+		AudioTree tree;
+		if (matches.empty()) return tree;
+		std::unordered_set<DWORD> roots;
+		for (size_t index : matches) roots.insert(TreeRoot(entries_[index].pid));
+		tree.root = TreeRoot(entries_[matches.front()].pid);
+		for (DWORD session : sessionPids) {
+			auto it = byPid_.find(session);
+			for (int steps = 0; it != byPid_.end() && steps < 16; ++steps) {
+				const DWORD pid = entries_[it->second].pid;
+				if (roots.count(pid)) {
+					tree.root = pid;
+					tree.audioPid = session;
+					return tree;
+				}
+				auto parent = byPid_.find(entries_[it->second].parentPid);
+				if (parent != byPid_.end() && parent->second == it->second) break;
+				it = parent;
+			}
+		}
+		return tree;
+	}
+
+	// Snapshot indices of processes named processName (case-insensitive), or,
+	// when there are none, of those whose base name matches.
+	const std::vector<size_t>* Matches(const std::string& processName, bool* exact) const {
+		const std::string folded = FoldCase(processName);
+		auto it = byName_.find(folded);
+		*exact = it != byName_.end();
+		if (*exact) return &it->second;
+		it = byBase_.find(BaseName(folded));
+		return it == byBase_.end() ? nullptr : &it->second;
+	}
+
+private:
+	std::vector<Entry> entries_;
+	std::unordered_map<std::string, std::vector<size_t>> byName_;
+	std::unordered_map<std::string, std::vector<size_t>> byBase_;
+	std::unordered_map<DWORD, size_t> byPid_;
+};
@@ -0,0 +1,402 @@
+// Audio session registry for Windows: the COM control thread (com_control.h)
+// owns the default render endpoint's IAudioSessionManager2 and keeps the
+// session table current from IAudioSessionNotification (new sessions),
+// per-session IAudioSessionEvents (state changes, disconnects) and
+// IMMNotificationClient (default device changes). COM callbacks only post
+// work; every COM call happens on the control thread, including the
+// IAudioMeterInformation reads behind getSessionLevels().
+
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <audiopolicy.h>
+#include <endpointvolume.h>
+#include <wrl/client.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "addon_log.h"
+#include "com_control.h"
+#include "session_table.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+
+// Minimal IUnknown for the callback objects; created with one reference.
+template <class Interface>
+class ComCallback : public Interface {
+public:
+	ULONG STDMETHODCALLTYPE AddRef() override { return ++refs_; }
+	ULONG STDMETHODCALLTYPE Release() override {
+		const ULONG refs = --refs_;
+		if (refs == 0) delete this;
+		return refs;
+	}
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override {
+		if (riid == __uuidof(IUnknown) || riid == __uuidof(Interface)) {
+			*object = static_cast<Interface*>(this);
+			AddRef();
+			return S_OK;
+		}
+		*object = nullptr;
+		return E_NOINTERFACE;
+	}
+
+protected:
+	virtual ~ComCallback() = default;
+
+private:
+	std::atomic<ULONG> refs_{1};
+};
+
+std::string ProcessImageName(DWORD pid) {
+	HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+	if (!process) return std::string();
+	std::string name;
+	wchar_t path[MAX_PATH];
+	DWORD size = MAX_PATH;
+	if (QueryFullProcessImageNameW(process, 0, path, &size)) {
+		const wchar_t* base = wcsrchr(path, L'\\');
+		base = base ? base + 1 : path;
+		char utf8[MAX_PATH * 3];
+		if (WideCharToMultiByte(CP_UTF8, 0, base, -1, utf8, (int)sizeof(utf8), nullptr, nullptr)) name = utf8;
+	}
+	CloseHandle(process);
+	return name;
+}
+
+struct WorkItem;
+void PostRegistryWork(WorkItem item);
+
+class SessionEvents : public ComCallback<IAudioSessionEvents> {
+public:
+
+	HRESULT STDMETHODCALLTYPE OnDisplayNameChanged(LPCWSTR, LPCGUID) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnIconPathChanged(LPCWSTR, LPCGUID) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnSimpleVolumeChanged(float, BOOL, LPCGUID) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnChannelVolumeChanged(DWORD, float[], DWORD, LPCGUID) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnGroupingParamChanged(LPCGUID, LPCGUID) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnStateChanged(AudioSessionState state) override;
+	HRESULT STDMETHODCALLTYPE OnSessionDisconnected(AudioSessionDisconnectReason) override;
+};
+
+class SessionCreatedEvents : public ComCallback<IAudioSessionNotification> {
+public:
+	HRESULT STDMETHODCALLTYPE OnSessionCreated(IAudioSessionControl* control) override;
+};
+
+class DeviceEvents : public ComCallback<IMMNotificationClient> {
+public:
+	HRESULT STDMETHODCALLTYPE OnDeviceStateChanged(LPCWSTR, DWORD) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnDeviceAdded(LPCWSTR) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnDeviceRemoved(LPCWSTR) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnPropertyValueChanged(LPCWSTR, const PROPERTYKEY) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR) override;
+};
+
+struct WorkItem {
+	enum Kind { SessionCreated, StateChanged, Disconnected, DefaultDeviceChanged } kind;
+	ComPtr<IAudioSessionControl> control; // SessionCreated
+	ComPtr<SessionEvents> events;         // StateChanged, Disconnected
+	AudioSessionState state = AudioSessionStateInactive;
+};
+
+HRESULT SessionEvents::OnStateChanged(AudioSessionState state) {
+	WorkItem item{ WorkItem::StateChanged };
+	item.events = this;
+	item.state = state;
+	PostRegistryWork(std::move(item));
+	return S_OK;
+}
+
+HRESULT SessionEvents::OnSessionDisconnected(AudioSessionDisconnectReason) {
+	WorkItem item{ WorkItem::Disconnected };
+	item.events = this;
+	PostRegistryWork(std::move(item));
+	return S_OK;
+}
+
+HRESULT SessionCreatedEvents::OnSessionCreated(IAudioSessionControl* control) {
+	WorkItem item{ WorkItem::SessionCreated };
+	item.control = control;
+	PostRegistryWork(std::move(item));
+	return S_OK;
+}
+
+HRESULT DeviceEvents::OnDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR) {
+	if (flow == eRender && role == eConsole) PostRegistryWork(WorkItem{ WorkItem::DefaultDeviceChanged });
+	return S_OK;
+}
+
+class SessionRegistry;
+SessionRegistry* g_watching = nullptr; // control thread only: the registry callbacks' work goes to
+
+class SessionRegistry {
+public:
+	explicit SessionRegistry(SessionTable* table) : table_(table) {}
+
+	// Blocks until the initial sessions are in the table.
+	bool Start() {
+		bool started = false;
+		RunComControl([this, &started] { started = Open(true); });
+		return started;
+	}
+
+	void Stop() {
+		RunComControl([this] { Close(); });
+	}
+
+	// Waits for the control thread to read every session's meter.
+	std::vector<AudioSessionLevel> SampleLevels() {
+		std::vector<AudioSessionLevel> levels;
+		RunComControl([this, &levels] { levels = ReadLevels(); });
+		return levels;
+	}
+
+	// Not started: attaches just long enough to read every meter once, in
+	// one control task, so no callback of its own is ever handled.
+	std::vector<AudioSessionLevel> SampleOnce() {
+		std::vector<AudioSessionLevel> levels;
+		RunComControl([this, &levels] {
+			if (!Open(false)) return;
+			levels = ReadLevels();
+			Close();
+		});
+		return levels;
+	}
+
+	// Control thread: a callback's work.
+	void Handle(const WorkItem& item);
+
+private:
+	struct Session {
+		ComPtr<IAudioSessionControl> control;
+		ComPtr<SessionEvents> events;
+		ComPtr<IAudioMeterInformation> meter; // null when the session has no meter
+		DWORD pid;
+		AudioSessionState state;
+	};
+
+	bool Open(bool watch);
+	void Close();
+	bool Attach();
+	void Detach();
+	void AddSession(IAudioSessionControl* control);
+	void RemoveSession(SessionEvents* events);
+	void Publish(DWORD pid);
+	std::vector<AudioSessionLevel> ReadLevels();
+
+	SessionTable* table_;
+
+	// Control thread only
+	ComPtr<IMMDeviceEnumerator> enumerator_;
+	ComPtr<IMMNotificationClient> deviceEvents_;
+	ComPtr<IAudioSessionManager2> manager_;
+	ComPtr<IAudioSessionNotification> sessionEvents_;
+	std::vector<Session> sessions_;
+	std::unordered_map<DWORD, std::string> names_;
+};
+
+bool SessionRegistry::Open(bool watch) {
+	enumerator_ = ComControlEnumerator();
+	if (!enumerator_) return false;
+	if (watch) {
+		deviceEvents_.Attach(new DeviceEvents());
+		enumerator_->RegisterEndpointNotificationCallback(deviceEvents_.Get());
+	}
+	sessionEvents_.Attach(new SessionCreatedEvents());
+
+	// No default render device yet is fine; a device change attaches later
+	if (!Attach()) AddonLog(LogLevel::Warn, "Session registry: no default render endpoint");
+	if (watch) {
+		g_watching = this;
+		AddonLog(LogLevel::Info, "Session registry started: %zu sessions", sessions_.size());
+	}
+	return true;
+}
+
+void SessionRegistry::Close() {
+	Detach();
+	if (deviceEvents_) enumerator_->UnregisterEndpointNotificationCallback(deviceEvents_.Get());
+	deviceEvents_.Reset();
+	sessionEvents_.Reset();
+	enumerator_.Reset();
+	if (g_watching != this) return;
+	g_watching = nullptr;
+	AddonLog(LogLevel::Info, "Session registry stopped");
+}
+
+void SessionRegistry::Handle(const WorkItem& item) {
+	switch (item.kind) {
+	case WorkItem::SessionCreated:
+		AddSession(item.control.Get());
+		break;
+	case WorkItem::StateChanged:
+		if (item.state == AudioSessionStateExpired) {
+			RemoveSession(item.events.Get());
+			break;
+		}
+		for (Session& s : sessions_) {
+			if (s.events.Get() != item.events.Get()) continue;
+			s.state = item.state;
+			Publish(s.pid);
+			break;
+		}
+		break;
+	case WorkItem::Disconnected:
+		RemoveSession(item.events.Get());
+		break;
+	case WorkItem::DefaultDeviceChanged:
+		AddonLog(LogLevel::Info, "Session registry: default render device changed");
+		Detach();
+		Attach();
+		break;
+	}
+}
+
+// Any thread. Work that arrives after its registry stopped finds no one, or
+// the next registry, whose sessions it can't match.
+void PostRegistryWork(WorkItem item) {
+	PostComControl([item] {
+		if (g_watching) g_watching->Handle(item);
+	});
+}
+
+bool SessionRegistry::Attach() {
+	ComPtr<IMMDevice> device;
+	HRESULT hr = enumerator_->GetDefaultAudioEndpoint(eRender, eConsole, &device);
+	if (FAILED(hr)) return false;
+	hr = device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL, nullptr, (void**)manager_.ReleaseAndGetAddressOf());
+	if (FAILED(hr)) return false;
+	hr = manager_->RegisterSessionNotification(sessionEvents_.Get());
+	if (FAILED(hr)) {
+		manager_.Reset();
+		return false;
+	}
+
+	// Creation notifications only start flowing once the enumerator has been taken
+	ComPtr<IAudioSessionEnumerator> sessions;
+	hr = manager_->GetSessionEnumerator(&sessions);
+	if (FAILED(hr)) return true;
+	int count = 0;
+	if (FAILED(sessions->GetCount(&count))) return true;
+	for (int i = 0; i < count; i++) {
+		ComPtr<IAudioSessionControl> control;
+		if (SUCCEEDED(sessions->GetSession(i, &control))) AddSession(control.Get());
+	}
+	return true;
+}
+
+void SessionRegistry::Detach() {
+	std::vector<DWORD> pids;
+	for (Session& s : sessions_) {
+		s.control->UnregisterAudioSessionEventsNotification(s.events.Get());
+		pids.push_back(s.pid);
+	}
+	sessions_.clear();
+	if (manager_) manager_->UnregisterSessionNotification(sessionEvents_.Get());
+	manager_.Reset();
+	for (DWORD pid : pids) Publish(pid);
+}
+
+void SessionRegistry::AddSession(IAudioSessionControl* control) {
+	ComPtr<IAudioSessionControl2> control2;
+	if (FAILED(control->QueryInterface(IID_PPV_ARGS(&control2)))) return;
+	DWORD pid = 0;
+	if (FAILED(control2->GetProcessId(&pid)) || pid == 0) return; // system sounds
+	AudioSessionState state = AudioSessionStateInactive;
+	if (FAILED(control->GetState(&state)) || state == AudioSessionStateExpired) return;
+	for (const Session& s : sessions_) {
+		if (s.control.Get() == control) return;
+	}
+
+	Session session{ control, nullptr, nullptr, pid, state };
+	control->QueryInterface(IID_PPV_ARGS(&session.meter));
+	session.events.Attach(new SessionEvents());
+	if (FAILED(control->RegisterAudioSessionEventsNotification(session.events.Get()))) return;
+	sessions_.push_back(std::move(session));
+	Publish(pid);
+}
+
+void SessionRegistry::RemoveSession(SessionEvents* events) {
+	for (auto it = sessions_.begin(); it != sessions_.end(); ++it) {
+		if (it->events.Get() != events) continue;
+		const DWORD pid = it->pid;
+		it->control->UnregisterAudioSessionEventsNotification(events);
+		sessions_.erase(it);
+		Publish(pid);
+		return;
+	}
+}
+
+// One row per PID: present while it has a session, active while any is playing.
+void SessionRegistry::Publish(DWORD pid) {
+	bool any = false;
+	bool active = false;
+	for (const Session& s : sessions_) {
+		if (s.pid != pid) continue;
+		any = true;
+		active = active || s.state == AudioSessionStateActive;
+	}
+	if (!any) {
+		names_.erase(pid);
+		table_->Remove(pid);
+		return;
+	}
+	auto name = names_.find(pid);
+	if (name == names_.end()) name = names_.emplace(pid, ProcessImageName(pid)).first;
+	table_->Set(pid, name->second, active);
+}
+
+// Loudest session per PID; expired sessions are already gone.
+std::vector<AudioSessionLevel> SessionRegistry::ReadLevels() {
+	std::vector<AudioSessionLevel> levels;
+	for (const Session& s : sessions_) {
+		float peak = 0.0f;
+		if (!s.meter || FAILED(s.meter->GetPeakValue(&peak))) continue;
+		auto level = std::find_if(levels.begin(), levels.end(), [&s](const AudioSessionLevel& l) { return l.pid == s.pid; });
+		if (level == levels.end()) {
+			auto name = names_.find(s.pid);
+			levels.push_back(AudioSessionLevel{ s.pid, name != names_.end() ? name->second : std::string(), peak, true });
+		} else if (peak > level->peak) {
+			level->peak = peak;
+		}
+	}
+	return levels;
+}
+
+std::mutex g_registryMutex; // the JS threads of every environment, and enumeration workers
+std::unique_ptr<SessionRegistry> g_registry;
+
+} // namespace
+
+bool StartAudioSessionRegistry(SessionTable* table) {
+	auto registry = std::make_unique<SessionRegistry>(table);
+	if (!registry->Start()) return false;
+	std::lock_guard<std::mutex> lock(g_registryMutex);
+	g_registry = std::move(registry);
+	return true;
+}
+
+void StopAudioSessionRegistry() {
+	std::lock_guard<std::mutex> lock(g_registryMutex);
+	if (!g_registry) return;
+	g_registry->Stop();
+	g_registry.reset();
+}
+
+std::vector<AudioSessionLevel> SampleAudioSessionLevels() {
+	{
+		std::lock_guard<std::mutex> lock(g_registryMutex);
+		if (g_registry) return g_registry->SampleLevels();
+	}
+	// Not watching: attach a short-lived registry just for this sample
+	SessionTable table;
+	SessionRegistry registry(&table);
+	return registry.SampleOnce();
+}
@@ -0,0 +1,306 @@
+#include "soundboard_output.h"
+
+#include <mmdeviceapi.h>
+#include <audioclient.h>
+#include <functiondiscoverykeys_devpkey.h>
+#include <ksmedia.h>
+#include <mmreg.h>
+#include <wrl/client.h>
+
+#include <future>
+
+#include "addon_log.h"
+#include "thread_cpu.h"
+#include "thread_schedule.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+
+const REFERENCE_TIME kBufferHns = 200000; // 20 ms endpoint buffer
+
+std::string LowerUtf8(const wchar_t* s) {
+	char utf8[512];
+	if (!WideCharToMultiByte(CP_UTF8, 0, s, -1, utf8, (int)sizeof(utf8), nullptr, nullptr)) return std::string();
+	std::string out(utf8);
+	for (char& c : out) {
+		if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+	}
+	return out;
+}
+
+std::string FriendlyName(IMMDevice* device, bool lower) {
+	ComPtr<IPropertyStore> props;
+	if (FAILED(device->OpenPropertyStore(STGM_READ, &props))) return std::string();
+	PROPVARIANT pv;
+	PropVariantInit(&pv);
+	std::string name;
+	if (SUCCEEDED(props->GetValue(PKEY_Device_FriendlyName, &pv)) && pv.vt == VT_LPWSTR) {
+		if (lower) {
+			name = LowerUtf8(pv.pwszVal);
+		} else {
+			char utf8[512];
+			if (WideCharToMultiByte(CP_UTF8, 0, pv.pwszVal, -1, utf8, (int)sizeof(utf8), nullptr, nullptr)) name = utf8;
+		}
+	}
+	PropVariantClear(&pv);
+	return name;
+}
+
+std::string EndpointId(IMMDevice* device, bool lower) {
+	LPWSTR id = nullptr;
+	if (FAILED(device->GetId(&id)) || !id) return std::string();
+	std::string out;
+	if (lower) {
+		out = LowerUtf8(id);
+	} else {
+		char utf8[512];
+		if (WideCharToMultiByte(CP_UTF8, 0, id, -1, utf8, (int)sizeof(utf8), nullptr, nullptr)) out = utf8;
+	}
+	CoTaskMemFree(id);
+	return out;
+}
+
+// The engine only offers its minimum period in its own mix format.
+bool IsFloatMix(const WAVEFORMATEX* wfx, DWORD rate) {
+	if (wfx->nSamplesPerSec != rate || wfx->wBitsPerSample != 32) return false;
+	if (wfx->wFormatTag == WAVE_FORMAT_IEEE_FLOAT) return true;
+	return wfx->wFormatTag == WAVE_FORMAT_EXTENSIBLE &&
+	       reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(wfx)->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT;
+}
+
+// Initializes client at the minimum engine period; *channels gets the mix's
+// channel count and *periodMs the period.
+HRESULT InitializeLowLatency(IAudioClient* client, UINT32* channels, double* periodMs) {
+	ComPtr<IAudioClient3> client3;
+	HRESULT hr = client->QueryInterface(IID_PPV_ARGS(&client3));
+	if (FAILED(hr)) return hr;
+	WAVEFORMATEX* mix = nullptr;
+	hr = client->GetMixFormat(&mix);
+	if (FAILED(hr)) return hr;
+	UINT32 defaultFrames = 0, fundamentalFrames = 0, minFrames = 0, maxFrames = 0;
+	if (!IsFloatMix(mix, kSoundboardRate)) {
+		hr = AUDCLNT_E_UNSUPPORTED_FORMAT;
+	} else {
+		hr = client3->GetSharedModeEnginePeriod(mix, &defaultFrames, &fundamentalFrames, &minFrames, &maxFrames);
+		if (SUCCEEDED(hr)) hr = client3->InitializeSharedAudioStream(AUDCLNT_STREAMFLAGS_EVENTCALLBACK, minFrames, mix, nullptr);
+	}
+	if (SUCCEEDED(hr)) {
+		*channels = mix->nChannels;
+		*periodMs = 1000.0 * minFrames / mix->nSamplesPerSec;
+	}
+	CoTaskMemFree(mix);
+	return hr;
+}
+
+} // namespace
+
+HRESULT FindAudioEndpoint(IMMDeviceEnumerator* enumr, EDataFlow flow, ERole role,
+                          const std::string& lowerNeedle, IMMDevice** device) {
+	if (lowerNeedle.empty()) return enumr->GetDefaultAudioEndpoint(flow, role, device);
+	ComPtr<IMMDeviceCollection> devices;
+	HRESULT hr = enumr->EnumAudioEndpoints(flow, DEVICE_STATE_ACTIVE, &devices);
+	if (FAILED(hr)) return hr;
+	UINT count = 0;
+	devices->GetCount(&count);
+	for (UINT i = 0; i < count; ++i) {
+		ComPtr<IMMDevice> candidate;
+		if (FAILED(devices->Item(i, &candidate))) continue;
+		if (EndpointId(candidate.Get(), true) != lowerNeedle &&
+		    FriendlyName(candidate.Get(), true).find(lowerNeedle) == std::string::npos) continue;
+		*device = candidate.Detach();
+		return S_OK;
+	}
+	return E_NOTFOUND;
+}
+
+HRESULT ListAudioEndpoints(IMMDeviceEnumerator* enumr, std::vector<AudioEndpointInfo>* out) {
+	out->clear();
+	for (EDataFlow flow : { eRender, eCapture }) {
+		std::string defaultId, communicationsId;
+		ComPtr<IMMDevice> preferred;
+		if (SUCCEEDED(enumr->GetDefaultAudioEndpoint(flow, eConsole, &preferred))) defaultId = EndpointId(preferred.Get(), false);
+		preferred.Reset();
+		if (SUCCEEDED(enumr->GetDefaultAudioEndpoint(flow, eCommunications, &preferred))) communicationsId = EndpointId(preferred.Get(), false);
+		ComPtr<IMMDeviceCollection> devices;
+		HRESULT hr = enumr->EnumAudioEndpoints(flow, DEVICE_STATE_ACTIVE, &devices);
+		if (FAILED(hr)) return hr;
+		UINT count = 0;
+		devices->GetCount(&count);
+		for (UINT i = 0; i < count; ++i) {
+			ComPtr<IMMDevice> device;
+			if (FAILED(devices->Item(i, &device))) continue;
+			AudioEndpointInfo info;
+			info.id = EndpointId(device.Get(), false);
+			info.name = FriendlyName(device.Get(), false);
+			info.render = flow == eRender;
+			info.isDefault = !info.id.empty() && info.id == defaultId;
+			info.isDefaultCommunications = !info.id.empty() && info.id == communicationsId;
+			out->push_back(std::move(info));
+		}
+	}
+	return S_OK;
+}
+
+struct SoundboardOutput::Opened {
+	std::promise<bool> ready;
+	std::string name;
+	std::string error;
+};
+
+bool SoundboardOutput::Start(const std::string& lowerNeedle, RenderSource* source, std::string* name, std::string* error,
+                             bool lowLatency) {
+	if (running_) {
+		*error = "Soundboard output already running";
+		return false;
+	}
+	source_ = source;
+	stopEvent_ = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	Opened opened;
+	std::future<bool> ready = opened.ready.get_future();
+	running_ = true;
+	thread_ = std::thread(&SoundboardOutput::Run, this, lowerNeedle, lowLatency, &opened);
+	const bool ok = ready.get(); // opened outlives this: Run stops touching it once ready is set
+	if (!ok) {
+		thread_.join();
+		CloseHandle(stopEvent_);
+		stopEvent_ = nullptr;
+		running_ = false;
+		*error = opened.error;
+		return false;
+	}
+	*name = opened.name;
+	source_->Attach();
+	return true;
+}
+
+void SoundboardOutput::Stop() {
+	if (!running_) return;
+	SetEvent(stopEvent_);
+	if (thread_.joinable()) thread_.join();
+	CloseHandle(stopEvent_);
+	stopEvent_ = nullptr;
+	source_->Detach();
+	running_ = false;
+}
+
+void SoundboardOutput::Run(std::string lowerNeedle, bool lowLatency, Opened* opened) {
+	ThreadCpuScope cpu("render-output");
+	ApplyThreadQos(ThreadQos::Interactive);
+	bool reported = false;
+	auto fail = [&](const char* what, HRESULT hr) {
+		char text[160];
+		snprintf(text, sizeof(text), "%s failed: 0x%08lx", what, hr);
+		AddonLog(LogLevel::Error, "Soundboard output: %s", text);
+		opened->error = text;
+		opened->ready.set_value(false);
+		reported = true;
+	};
+
+	HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	if (FAILED(hr)) return fail("CoInitializeEx", hr);
+
+	ComPtr<IMMDeviceEnumerator> enumr;
+	ComPtr<IMMDevice> device;
+	ComPtr<IAudioClient> client;
+	ComPtr<IAudioRenderClient> render;
+	HANDLE bufferEvent = nullptr;
+	ThreadScheduleState schedule;
+
+	do {
+		hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&enumr));
+		if (FAILED(hr)) { fail("Create MMDeviceEnumerator", hr); break; }
+		hr = FindAudioEndpoint(enumr.Get(), eRender, eConsole, lowerNeedle, &device);
+		if (FAILED(hr)) {
+			opened->error = "No render endpoint matching '" + lowerNeedle + "'";
+			opened->ready.set_value(false);
+			reported = true;
+			break;
+		}
+		hr = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, (void**)client.GetAddressOf());
+		if (FAILED(hr)) { fail("Activate IAudioClient", hr); break; }
+
+		UINT32 channels = kSoundboardChannels;
+		double periodMs = 10.0;
+		bool initialized = false;
+		if (lowLatency) {
+			hr = InitializeLowLatency(client.Get(), &channels, &periodMs);
+			initialized = SUCCEEDED(hr);
+			if (!initialized) {
+				AddonLog(LogLevel::Warn, "Soundboard output: minimum engine period unavailable (0x%08lx), using a %d ms buffer",
+				         hr, (int)(kBufferHns / 10000));
+				// A client that failed to initialize can't be initialized again
+				client.Reset();
+				hr = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, (void**)client.GetAddressOf());
+				if (FAILED(hr)) { fail("Activate IAudioClient", hr); break; }
+			}
+		}
+
+		WAVEFORMATEXTENSIBLE wfx = {};
+		wfx.Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+		wfx.Format.nChannels = (WORD)kSoundboardChannels;
+		wfx.Format.nSamplesPerSec = kSoundboardRate;
+		wfx.Format.wBitsPerSample = 32;
+		wfx.Format.nBlockAlign = (WORD)(kSoundboardChannels * sizeof(float));
+		wfx.Format.nAvgBytesPerSec = kSoundboardRate * wfx.Format.nBlockAlign;
+		wfx.Format.cbSize = sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+		wfx.Samples.wValidBitsPerSample = 32;
+		wfx.dwChannelMask = SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT;
+		wfx.SubFormat = KSDATAFORMAT_SUBTYPE_IEEE_FLOAT;
+		if (!initialized) {
+			hr = client->Initialize(AUDCLNT_SHAREMODE_SHARED,
+			                        AUDCLNT_STREAMFLAGS_EVENTCALLBACK | AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM |
+			                            AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY,
+			                        kBufferHns, 0, &wfx.Format, nullptr);
+			if (FAILED(hr)) { fail("IAudioClient Initialize", hr); break; }
+		}
+		UINT32 bufferFrames = 0;
+		client->GetBufferSize(&bufferFrames);
+		bufferEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		if (!bufferEvent) { fail("CreateEvent", E_FAIL); break; }
+		hr = client->SetEventHandle(bufferEvent);
+		if (FAILED(hr)) { fail("SetEventHandle", hr); break; }
+		hr = client->GetService(IID_PPV_ARGS(&render));
+		if (FAILED(hr)) { fail("GetService(IAudioRenderClient)", hr); break; }
+
+		// Silence the first buffer so the stream starts without a stale period
+		BYTE* data = nullptr;
+		if (SUCCEEDED(render->GetBuffer(bufferFrames, &data))) render->ReleaseBuffer(bufferFrames, AUDCLNT_BUFFERFLAGS_SILENT);
+		hr = client->Start();
+		if (FAILED(hr)) { fail("AudioClient Start", hr); break; }
+		ApplyThreadSchedule(ThreadSchedule::ProAudio, ThreadPriority::High, periodMs, &schedule);
+
+		opened->name = FriendlyName(device.Get(), false);
+		AddonLog(LogLevel::Info, "Soundboard output on '%s' (%u frame buffer%s)", opened->name.c_str(), bufferFrames,
+		         initialized ? ", minimum engine period" : "");
+		opened->ready.set_value(true);
+		reported = true;
+
+		HANDLE waits[2] = { stopEvent_, bufferEvent };
+		for (;;) {
+			const DWORD w = WaitForMultipleObjects(2, waits, FALSE, 200);
+			if (w == WAIT_OBJECT_0) break;
+			UINT32 padding = 0;
+			if (FAILED(client->GetCurrentPadding(&padding))) {
+				AddonLog(LogLevel::Warn, "Soundboard output: device lost");
+				break;
+			}
+			const UINT32 frames = bufferFrames - padding;
+			if (frames == 0) continue;
+			if (FAILED(render->GetBuffer(frames, &data))) continue;
+			source_->Render(reinterpret_cast<float*>(data), frames, channels);
+			render->ReleaseBuffer(frames, 0);
+		}
+		client->Stop();
+	} while (false);
+
+	// A lost device ends the stream early; the source stays attached (and silent) until Stop()
+	if (!reported) opened->ready.set_value(false);
+	RevertThreadSchedule(&schedule);
+	if (bufferEvent) CloseHandle(bufferEvent);
+	render.Reset();
+	client.Reset();
+	device.Reset();
+	enumr.Reset();
+	CoUninitialize();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// Shared-mode WASAPI render stream for one RenderSource: a soundboard bus
+// (soundboard_engine.h) or a render session (render_session.h). The stream
+// runs on its own event-driven MMCSS thread and pulls the source straight into
+// the endpoint buffer; AUTOCONVERTPCM lets the audio engine take 48 kHz stereo
+// float whatever the endpoint mixes at. With lowLatency the stream instead
+// asks IAudioClient3 for the engine's minimum period, which needs the
+// endpoint to mix 48 kHz float itself. Implemented in soundboard_output.cc.
+
+#include <windows.h>
+#include <mmdeviceapi.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "render_source.h"
+#include "soundboard_engine.h"
+
+// First active endpoint in `flow` whose lowercased endpoint ID equals
+// lowerNeedle or whose lowercased friendly name contains it, or the default
+// `role` endpoint when empty. Also opens the microphone for source
+// 'microphone' captures and the render endpoints of option 'outputDevice'.
+HRESULT FindAudioEndpoint(IMMDeviceEnumerator* enumr, EDataFlow flow, ERole role,
+                          const std::string& lowerNeedle, IMMDevice** device);
+
+struct AudioEndpointInfo {
+	std::string id;   // IMMDevice::GetId, as UTF-8
+	std::string name; // friendly name
+	bool render = true;
+	bool isDefault = false;               // default eConsole endpoint of its flow
+	bool isDefaultCommunications = false; // default eCommunications endpoint
+};
+
+// Active endpoints of both flows, render first; for listAudioEndpoints().
+HRESULT ListAudioEndpoints(IMMDeviceEnumerator* enumr, std::vector<AudioEndpointInfo>* out);
+
+class SoundboardOutput {
+public:
+	SoundboardOutput() = default;
+	SoundboardOutput(const SoundboardOutput&) = delete;
+	SoundboardOutput& operator=(const SoundboardOutput&) = delete;
+	~SoundboardOutput() { Stop(); }
+
+	// Opens the first active render endpoint whose lowercased friendly name
+	// contains lowerNeedle (the default endpoint when empty) and starts
+	// rendering source. Blocks until the stream is running or has failed;
+	// *name gets the endpoint's friendly name.
+	bool Start(const std::string& lowerNeedle, RenderSource* source, std::string* name, std::string* error,
+	           bool lowLatency = false);
+	void Stop();
+	bool Running() const { return running_.load(std::memory_order_acquire); }
+
+private:
+	struct Opened;
+	void Run(std::string lowerNeedle, bool lowLatency, Opened* opened);
+
+	std::thread thread_;
+	std::atomic<bool> running_{false};
+	HANDLE stopEvent_ = nullptr;
+	RenderSource* source_ = nullptr;
+};
@@ -5,10 +5,11 @@
 #include <initguid.h>
 #include <audioclient.h>
 #include <audiopolicy.h>
+#include <endpointvolume.h>
 #include <functiondiscoverykeys_devpkey.h>
 #include <propvarutil.h>
 #include <wrl/client.h>
-#include <psapi.h>
+#include <wrl/implements.h>
 #include <tlhelp32.h>
 #include <mmreg.h>
 #include <ksmedia.h>
@@ -18,561 +19,2196 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <cmath>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <condition_variable>
+
+#include "ocr_engine.h"
+#include "paddle_ocr_engine.h"
+#include "pcm_channel.h"
+#include "pcm_packet_writer.h"
+#include "pipeline_graph.h"
+#include "piper_tts_engine.h"
+#include "platform_trace.h"
+#include "processing_params.h"
+#include "addon_instance.h"
+#include "audio_encoder.h"
+#include "batch_transcribe.h"
+#include "capture_history.h"
+#include "capture_options.h"
+#include "capture_session.h"
+#include "capture_subscribers.h"
+#include "capture_watchdog.h"
+#include "com_control.h"
+#include "delivery_gate.h"
+#include "delivery_stress.h"
+#include "dialogue_focus.h"
+#include "downmix.h"
+#include "dsp_bindings.h"
+#include "dsp_blocks.h"
+#include "dsp_eval.h"
+#include "dsp_kernel_bindings.h"
+#include "echo_canceller.h"
+#include "event_bus.h"
+#include "endpoint_mixer.h"
+#include "file_replay_source.h"
+#include "flac_chunk_encoder.h"
+#include "fuzzy_text_bindings.h"
+#include "async_query.h"
+#include "latency_histogram.h"
+#include "latency_trace.h"
+#include "level_meter.h"
+#include "log_bindings.h"
+#include "memory_budget_bindings.h"
+#include "model_footprint.h"
+#include "opus_chunk_encoder.h"
+#include "power_state.h"
+#include "quality_governor.h"
+#include "realtime_memory.h"
+#include "render_session.h"
+#include "session_recorder.h"
+#include "session_table.h"
+#include "shm_audio_ring.h"
+#include "soundboard_engine.h"
+#include "soundboard_output.h"
+#include "source_switch.h"
+#include "stream_decoder.h"
+#include "subtitle_tracker_bindings.h"
+#include "swr_converter.h"
+#include "task_pool.h"
+#include "text_stabilizer_bindings.h"
+#include "thread_cpu_bindings.h"
+#include "thread_schedule.h"
+#include "translation_engine.h"
+#include "tts_audio_cache.h"
+#include "voice_boost.h"
+#include "whisper_backends.h"
+#include "whisper_engine.h"
+#include "whisper_stream.h"
+#include "process_snapshot.h"
+#include "window_pid_cache.h"
+#include "desktop_duplication.h"
 
 #pragma comment(lib, "ole32.lib")
 #pragma comment(lib, "uuid.lib")
 #pragma comment(lib, "winmm.lib")
 #pragma comment(lib, "avrt.lib")
-#pragma comment(lib, "psapi.lib")
+#pragma comment(lib, "mmdevapi.lib")
+#pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "dxgi.lib")
+#pragma comment(lib, "advapi32.lib")
+
+// The ETW provider platform_trace.h writes to
+AUDIO_CORE_DEFINE_TRACE_PROVIDER();
+
+// Process loopback activation (Windows 10 2004+). SDKs before 10.0.19041 lack
+// the header; the declarations below match its layout.
+#if __has_include(<audioclientactivationparams.h>)
+#include <audioclientactivationparams.h>
+#else
+typedef enum AUDIOCLIENT_ACTIVATION_TYPE {
+    AUDIOCLIENT_ACTIVATION_TYPE_DEFAULT = 0,
+    AUDIOCLIENT_ACTIVATION_TYPE_PROCESS_LOOPBACK = 1
+} AUDIOCLIENT_ACTIVATION_TYPE;
+
+typedef enum PROCESS_LOOPBACK_MODE {
+    PROCESS_LOOPBACK_MODE_INCLUDE_TARGET_PROCESS_TREE = 0,
+    PROCESS_LOOPBACK_MODE_EXCLUDE_TARGET_PROCESS_TREE = 1
+} PROCESS_LOOPBACK_MODE;
 
-// Add missing Windows SDK definitions for process loopback
-#ifndef AUDIOCLIENT_PROCESS_LOOPBACK_PARAMS
 typedef struct AUDIOCLIENT_PROCESS_LOOPBACK_PARAMS {
     DWORD TargetProcessId;
-    DWORD ProcessLoopbackMode;
+    PROCESS_LOOPBACK_MODE ProcessLoopbackMode;
 } AUDIOCLIENT_PROCESS_LOOPBACK_PARAMS;
-#endif
 
-#ifndef AUDIOCLIENT_PROCESS_LOOPBACK_MODE_INCLUDE_TARGET_PROCESS_TREE
-#define AUDIOCLIENT_PROCESS_LOOPBACK_MODE_INCLUDE_TARGET_PROCESS_TREE 0x00000001
-#endif
+typedef struct AUDIOCLIENT_ACTIVATION_PARAMS {
+    AUDIOCLIENT_ACTIVATION_TYPE ActivationType;
+    union {
+        AUDIOCLIENT_PROCESS_LOOPBACK_PARAMS ProcessLoopbackParams;
+    };
+} AUDIOCLIENT_ACTIVATION_PARAMS;
 
-#ifndef AUDIOCLIENT_PROCESS_LOOPBACK_MODE_EXCLUDE_TARGET_PROCESS_TREE
-#define AUDIOCLIENT_PROCESS_LOOPBACK_MODE_EXCLUDE_TARGET_PROCESS_TREE 0x00000002
+#define VIRTUAL_AUDIO_DEVICE_PROCESS_LOOPBACK L"VAD\\Process_Loopback"
 #endif
 
-// For now, we'll use the standard Initialize method and handle process exclusion differently
-// The InitializeSharedAudioStream with PROPVARIANT is not available in the current Windows SDK version
-
 using Microsoft::WRL::ComPtr;
 
-class WasapiLoopbackCapture;
+// latencyMode 'powersave': buffer length and how often the capture loop drains it
+const REFERENCE_TIME kPowerSaveBufferHns = 2000000; // 200 ms
+const DWORD kPowerSavePollMs = 100;
+
+// Process loopback clients have no mix format or engine period of their own:
+// we pick the format (the engine converts to it) and the buffer length.
+const REFERENCE_TIME kProcessLoopbackBufferHns = 200000; // 20 ms
+const DWORD kProcessLoopbackRate = 48000;
+// Conversion 'engine-converted': the engine hands over 16 kHz mono float
+// instead of the mix format, with its own default-quality SRC.
+const DWORD kEngineConvertFlags = AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM | AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY;
+const DWORD kActivationTimeoutMs = 5000;
+
+// Option 'outputDevice' with several endpoints (RunMixed): the clients are
+// polled, the mix runs kMixDelayMs behind the clock so every endpoint's packet
+// for a stretch is in before it's read, and a missing or lost endpoint is
+// tried again every kMixRetryMs.
+const DWORD kMixPollMs = 10;
+const uint32_t kMixDelayMs = 50;
+const REFERENCE_TIME kMixBufferHns = 1000000; // 100 ms
+const ULONGLONG kMixRetryMs = 1000;
+const size_t kMixBlockSamples = 1600; // most 16 kHz samples per Process() call
+const size_t kSilenceDeliveredSamples = 16000 * 3; // silent packets still delivered before skipping (3 s)
+
+// Reopening the client after the device went away or the default changed:
+// attempts (the new endpoint may not be ready yet) and the wait between them.
+const int kReopenAttempts = 20;
+const DWORD kReopenBackoffMs = 250;
+// Option 'idle': how often an open client asks the session table whether anything plays.
+const ULONGLONG kIdleCheckMs = 1000;
+
+// Per-capture scratch arena for the packet path (mono downmix and 16 kHz resample).
+// Sized at init from the mix format and the endpoint buffer size; Ensure() only
+// grows it if the engine hands us a packet larger than the buffer it reported.
+// Every packet pending at a wakeup fits in `resampled` together, since they
+// all came out of that one buffer.
+struct CaptureScratch {
+	RealtimeVector<float> mono;
+	RealtimeVector<float> resampled;
+	size_t maxFrames = 0;
+	size_t maxOutFrames = 0;
+	uint64_t silenceCarry = 0; // fractional output frames of the current silent run, in input-rate units
+
+	void Prepare(size_t frames, uint32_t inRate, uint32_t outRate) {
+		maxFrames = frames;
+		maxOutFrames = (size_t)((double)frames * (double)outRate / (double)inRate) + 2; // +2: resampler phase carry
+		mono.resize(maxFrames);
+		resampled.resize(maxOutFrames);
+	}
 
-namespace {
-	std::unique_ptr<WasapiLoopbackCapture> g_capture;
-}
+	// Returns true if the arena had to grow to fit the packet.
+	bool Ensure(size_t frames, uint32_t inRate, uint32_t outRate) {
+		if (frames <= maxFrames) return false;
+		Prepare(frames, inRate, outRate);
+		return true;
+	}
+
+	// Zero-filled block at resampled[at] standing in for a silent packet of
+	// `frames` input frames; returns its 16 kHz length, carrying the fraction
+	// to the next one.
+	size_t Silence(size_t frames, uint32_t inRate, uint32_t outRate, size_t at) {
+		silenceCarry += (uint64_t)frames * outRate;
+		const size_t outLen = std::min((size_t)(silenceCarry / inRate), resampled.size() - at);
+		silenceCarry -= (uint64_t)outLen * inRate;
+		std::fill(resampled.begin() + at, resampled.begin() + at + outLen, 0.0f);
+		return outLen;
+	}
+};
+
+// The front end's resampler and the 'low' one a capture's quality governor
+// steps down to (option 'governor'). The one taking over continues the other's
+// history, so a step costs no click. Input already at 16 kHz (conversion
+// 'engine-converted') bypasses both.
+struct FrontResampler {
+	PolyphaseResampler full;
+	PolyphaseResampler light; // configured unless the endpoint already runs 'low'
+	bool bypass = false;
+	bool canStep = false;
+	bool lightActive = false;
+
+	void Configure(uint32_t inRate, uint32_t outRate, ResamplerQuality quality, size_t maxBlock) {
+		bypass = inRate == outRate;
+		canStep = false;
+		lightActive = false;
+		if (bypass) return;
+		full.Configure(inRate, outRate, quality, maxBlock);
+		canStep = quality != ResamplerQuality::Low;
+		if (canStep) light.Configure(inRate, outRate, ResamplerQuality::Low, maxBlock);
+	}
+
+	// Endpoint thread, between blocks.
+	void Follow(bool wantLight) {
+		wantLight = wantLight && canStep;
+		if (wantLight == lightActive) return;
+		if (wantLight) light.Continue(full);
+		else full.Continue(light);
+		lightActive = wantLight;
+	}
+
+	void Reset() {
+		if (!bypass) (lightActive ? light : full).Reset();
+	}
+	size_t Process(const float* in, size_t n, float* out) {
+		if (bypass) {
+			std::copy(in, in + n, out);
+			return n;
+		}
+		return (lightActive ? light : full).Process(in, n, out);
+	}
+};
+
+struct CaptureStats {
+	uint64_t packets = 0;
+	uint64_t blocks = 0;     // Process() calls; a wakeup's pending packets go down the chain as one
+	uint64_t steadyStateAllocations = 0;
+	uint64_t glitches = 0;   // packets flagged AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY
+	uint64_t silentPackets = 0; // packets flagged AUDCLNT_BUFFERFLAGS_SILENT
+	uint64_t skippedSamples = 0; // 16 kHz silence only counted, not processed or delivered
+	bool realtime = false;   // MMCSS task applied to the capture thread
+	float filterGraphLatencyMs = 0.0f; // option 'filterGraph' stage delay
+	bool processLoopback = false; // only the target process tree is captured (pid > 0, Windows 10 2004+)
+	bool selfExcluded = false;    // the full mix minus this app's process tree (excludeSelf)
+	bool engineConverted = false; // conversion 'engine-converted' took: the engine delivers 16 kHz mono
+	uint32_t endpointSessions = 0; // captures sharing this one's endpoint client, itself included
+	bool echoReference = false;   // this loopback capture is the far end microphone captures cancel
+	float echoErleDb = 0.0f;      // microphone with 'echoCancel': echo return loss enhancement
+	float echoDriftPpm = 0.0f;    // likewise: render clock against capture clock, compensated
+	uint64_t inputFrames = 0;     // device frames the endpoint read, for every capture on it
+	uint32_t inputSampleRate = 0; // endpoint mix format; 0 while no client is open
+	uint32_t inputChannels = 0;
+	float devicePeriodMs = 0.0f;  // engine wake-up period
+	float streamLatencyMs = 0.0f; // the client's GetStreamLatency: what the stream mode adds on top of the period
+	bool micRaw = false;          // microphone with micMode 'raw': the endpoint's effects are off
+	uint32_t mixedEndpoints = 0;  // option 'outputDevice' with several endpoints: how many are open
+	uint64_t mixLateSamples = 0;  // likewise: 16 kHz samples that arrived after their stretch was mixed
+	uint64_t outputSamples = 0;   // 16 kHz samples through this capture's back end, skipped ones included
+	uint64_t sourceSwitches = 0;  // switchSource() handoffs, back end kept (source_switch.h)
+	LatencySummary convert;       // per packet: downmix and resample (shared front end)
+	LatencySummary chain;         // per block: echo cancel and voice chain
+	LatencySummary deliver;       // per block: quantize, VAD, chunker, queueing and subscribers
+	bool governed = false;        // option 'governor'
+	QualityStats quality;
+	bool recording = false;       // option 'record'
+	RecorderStats record;
+	CaptureWatchdogStats stalls;  // the endpoint's stall watchdog (capture_watchdog.h)
+	PcmDeliveryStats delivery;
+};
+
+class LoopbackEndpoint;
+
+bool DownmixPlanForFormat(const WAVEFORMATEX* wfx, DownmixPlan* plan, DWORD* channelMaskOut = nullptr);
+HRESULT InitializeLoopbackStream(IAudioClient* client, IAudioClient3* client3, DWORD streamFlags,
+                                 const WAVEFORMATEX* pwfx, LatencyMode mode, double* periodMs);
+HRESULT ActivateProcessLoopback(DWORD pid, PROCESS_LOOPBACK_MODE mode, IAudioClient** client);
+
+// The capture source and the options that shape the shared front end; captures
+// that agree on all of them share one client. Everything else in
+// CaptureOptions is back end.
+struct EndpointKey {
+	CaptureSource source;
+	std::string inputDevice; // microphone only: name needle, empty = default capture endpoint
+	std::string file; // file replay only: its path
+	ReplayPace pace; // likewise
+	DWORD pid; // 0 = the default render endpoint's full mix; always 0 for a microphone or file
+	bool excludeSelf; // pid 0 loopback only: everything but this app's process tree
+	LatencyMode latency;
+	ResamplerQuality resampler;
+	bool engineConvert; // conversion 'engine-converted'; never for a file, nor with dialogue
+	bool dialogue; // option 'dialogue' (dialogue_focus.h)
+	ThreadSchedule schedule;
+	ThreadPriority priority;
+	MicMode micMode; // microphone only
+	MicRole micRole; // likewise
+	std::vector<std::string> outputDevices; // pid 0 loopback only: explicit render endpoints, mixed when several
+	uint32_t idleMs; // option 'idle' (loopback, not a mix of several endpoints): released after this long unplayed; 0 = never
+
+	static EndpointKey Of(DWORD pid, const CaptureOptions& o) {
+		// The engine's conversion is to mono: nothing left for the dialogue stage to work on
+		const bool engine = o.conversion == FormatConversion::Engine && !o.dialogue;
+		if (o.source == CaptureSource::Microphone) {
+			return { o.source, o.inputDevice, std::string(), ReplayPace::Realtime, 0, false, o.latency, o.resampler, engine,
+			         o.dialogue, o.schedule, o.priority, o.micMode, o.micRole };
+		}
+		if (o.source == CaptureSource::File) {
+			return { o.source, std::string(), o.file, o.pace, 0, false, o.latency, o.resampler, false, o.dialogue, o.schedule,
+			         o.priority };
+		}
+		std::vector<std::string> outputs = pid == 0 && !o.excludeSelf ? o.outputDevices : std::vector<std::string>();
+		const uint32_t idleMs = o.idle.enabled && outputs.size() <= 1 ? o.idle.afterMs : 0;
+		return { o.source, std::string(), std::string(), ReplayPace::Realtime, pid, pid == 0 && o.excludeSelf,
+		         o.latency, o.resampler, engine, o.dialogue, o.schedule, o.priority, MicMode::Default, MicRole::Console,
+		         std::move(outputs), idleMs };
+	}
+	bool operator==(const EndpointKey& k) const {
+		return source == k.source && inputDevice == k.inputDevice && file == k.file && pace == k.pace && pid == k.pid &&
+		       excludeSelf == k.excludeSelf && latency == k.latency && resampler == k.resampler &&
+		       engineConvert == k.engineConvert && dialogue == k.dialogue && schedule == k.schedule && priority == k.priority &&
+		       micMode == k.micMode && micRole == k.micRole && outputDevices == k.outputDevices && idleMs == k.idleMs;
+	}
+};
 
+// One capture's back end: voice chain, packet writer, subscribers and
+// counters, run on its endpoint's capture thread for every 16 kHz block the
+// shared front end produces. Start/Stop are JS-thread only.
 class WasapiLoopbackCapture {
 public:
-    WasapiLoopbackCapture() : running_(false), targetPid_(0) {}
-    ~WasapiLoopbackCapture() { Stop(); }
+	WasapiLoopbackCapture() = default;
+	~WasapiLoopbackCapture() { Stop(); if (channel_) channel_->Unref(); }
 
-	bool Start(DWORD pid, Napi::ThreadSafeFunction tsfn);
+	bool Start(DWORD pid, PcmTsfn tsfn, const CaptureOptions& options);
 	void Stop();
+	CaptureStats GetStats() const;
+	void SetMinChunkMs(uint32_t ms) { if (channel_) channel_->SetMinChunkMs(ms); }
+	bool Running() const { return running_; }
+	// Armed captures (delivery_gate.h): beginDelivery() / endDelivery().
+	void SetDelivery(bool open) { gate_.Request(open); }
+	bool Delivering() const { return !gate_.Armed() || gate_.Requested(); }
+	// Option 'history' (capture_history.h); null without it.
+	std::shared_ptr<const CaptureHistory> History() const { return history_; }
+	// JS thread: moves a running capture to another source - a process (pid,
+	// endpointId empty) or a render endpoint (loopback) or input device
+	// (microphone) - without resetting its back end. Returns once the new
+	// stream has taken over, or false with the old one still running.
+	bool SwitchSource(DWORD pid, const std::string& endpointId);
+
+private:
+	friend class LoopbackEndpoint;
+
+	// How long switchSource() waits for the new stream to open, and for an
+	// open one to send anything before it takes over regardless
+	static constexpr uint32_t kSwitchTimeoutMs = 3000;
+	static constexpr uint32_t kSwitchSilentMs = 300;
+
+	// Endpoint thread: sizes the back end before the first block.
+	void Prepare(size_t maxOutFrames, bool realtime, bool processLoopback);
+	// Endpoint thread: Prepare() for a capture switched over from another
+	// endpoint, whose stages carry on as they were; inRate is 0 while the
+	// endpoint has no client open.
+	void Rebind(bool realtime, bool processLoopback, uint32_t inRate, uint32_t inChannels);
+	// Endpoint thread: the shared client was reopened (reason is a string
+	// literal) on a device with this mix format; the gap is a discontinuity.
+	void Reopened(uint32_t inRate, uint32_t inChannels, const char* reason);
+	// Endpoint thread: the stall watchdog took `step`, stalledMs into a stall
+	// (StallStep::None: the stream recovered). A restart loses what the
+	// stream held; a reopen reports that through Reopened().
+	void Stalled(StallStep step, uint64_t stalledMs);
+	// Endpoint thread, option 'idle': the shared client was released, or is
+	// being reopened after idleMs; the reopen itself comes through Reopened().
+	void Idled(bool idle, uint64_t idleMs);
+	// Endpoint thread: a replayed file ran out; the capture ends with an 'end'
+	// event once Finish() runs.
+	void EndOfInput() { ended_ = true; }
+	// Endpoint thread: holding off would spare JS an overflow.
+	bool Backlogged() const { return channel_->Backlogged(); }
+	// Endpoint thread: the governor has stepped down to the light resampler.
+	bool WantsLightResampler() const { return governor_.Level() >= QualityLevel::LightResampler; }
+	// Endpoint thread: processes one block of `packets` engine packets, the
+	// first captured at timeNs (QPC, ns). Without
+	// `exclusive` the block is shared with later captures and is copied before
+	// the in-place stages. A `silent` block is zeros; once the stages have
+	// flushed it only advances the stream index. frontNs is what the shared
+	// front end spent on the block, which the governor counts as this capture's.
+	void Process(float* samples, size_t count, uint32_t packets, uint64_t timeNs, uint64_t frontNs, bool exclusive, bool glitch, bool silent, bool scratchGrew);
+	// Endpoint thread: Process() past a source switch.
+	void Deliver(float* samples, size_t count, uint32_t packets, uint64_t timeNs, uint64_t frontNs, bool exclusive, bool glitch, bool silent, bool scratchGrew);
+	// Endpoint thread: Deliver() past the counters, the echo reference and an
+	// armed capture's gate.
+	void Run(float* samples, size_t count, uint64_t timeNs, uint64_t frontNs, bool exclusive, bool silent, bool scratchGrew);
+	// Endpoint thread, after a governor step; reason is the 'quality' event's.
+	void ApplyQuality(bool raised, const char* reason);
+	// Endpoint thread, option 'power': the profile for a new power source.
+	void PollPower();
+	// Last call from whichever thread ends the capture: hands queued packets to
+	// JS and releases the tsfn.
+	void Finish();
+
+	std::atomic<bool> running_{false};
+	LoopbackEndpoint* endpoint_ = nullptr; // JS thread
+	bool owned_ = false;    // in the endpoint thread's working set; endpoint mutex
+	bool finished_ = true;  // Finish() has run; endpoint mutex
+	bool ended_ = false;    // the replayed file ran out; endpoint thread, then Finish()
+	bool releasing_ = false; // leaving its endpoint for another, unfinished; endpoint mutex
+	bool adopted_ = false;   // joining an endpoint from another, prepared; likewise
+	bool draining_ = false;  // endpoint thread: the switch queue goes down the chain first
+	PcmTsfn tsfn_;
+	PcmChannel* channel_ = nullptr; // tsfn_ context; we hold a ref so stats outlive the session
+	DWORD targetPid_ = 0; // Target process PID (0 = system-wide)
+	CaptureOptions options_;
+	EchoCanceller echo_;
+	VoiceChain voice_;
+	bool warmStarted_ = false; // option warmStart: Prepare() restored it, Finish() saves it
+	PcmPacketWriter writer_;
+	SubscriberFanout subscribers_;
+	RealtimeVector<float> work_; // copy of a shared block
+	RealtimeVector<float> preGate_; // chain input at the gate, for the chunker's pre-roll
+	DeliveryGate gate_; // armed sessions: the stream waits in a pre-roll until delivery opens
+	SourceSwitch switch_; // switchSource(): the new stream's blocks until it takes over
+	std::shared_ptr<CaptureHistory> history_; // set in Start(); getHistory() queries share it
+	std::unique_ptr<SessionRecorder> recorder_; // option 'record'; set in Start()
+	std::atomic<uint64_t> packets_{0};
+	std::atomic<uint64_t> blocks_{0};
+	std::atomic<uint64_t> steadyStateAllocations_{0}; // heap allocations after init (should stay 0)
+	std::atomic<uint64_t> glitches_{0};
+	std::atomic<uint64_t> silentPackets_{0};
+	size_t silentRun_ = 0; // endpoint thread: consecutive silent samples
+	std::atomic<uint64_t> skippedSamples_{0};
+	std::atomic<bool> realtime_{false};
+	std::atomic<bool> processLoopback_{false};
+	std::atomic<bool> selfExcluded_{false};
+	std::atomic<bool> echoReference_{false}; // publishing to SharedEchoReference()
+	std::atomic<float> echoErleDb_{0.0f};
+	std::atomic<float> echoDriftPpm_{0.0f};
+	std::atomic<float> filterGraphLatencyMs_{0.0f};
+	std::atomic<uint64_t> outputSamples_{0};
+	LatencyHistogram chain_;
+	LatencyHistogram deliver_;
+	QualityGovernor governor_; // option 'governor'; stepped on the endpoint thread
+	bool powerWatched_ = false;  // option 'power' holds the power watcher
+	uint64_t powerChanges_ = 0;  // endpoint thread: SystemPowerState().Changes() applied
+};
+
+// The shared front end: one capture client (the default render endpoint's
+// loopback, a process loopback client for a target PID, or a microphone),
+// the engine copy, downmix and resample to 16 kHz, fanned out to every attached
+// capture. Captures attach and detach while it runs; the thread picks up the
+// change at its next wake-up (the event is signalled for it) and finishes
+// removed captures itself, so a capture is never torn down mid-block.
+class LoopbackEndpoint {
+public:
+	explicit LoopbackEndpoint(const EndpointKey& key) : key_(key) {
+		wake_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	}
+	~LoopbackEndpoint() {
+		stop_ = true;
+		if (wake_) SetEvent(wake_);
+		if (thread_.joinable()) thread_.join();
+		if (wake_) CloseHandle(wake_);
+	}
+
+	const EndpointKey& Key() const { return key_; }
+
+	uint32_t Sessions() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return (uint32_t)sinks_.size();
+	}
+
+	// Front-end figures for getStats(); any thread.
+	void ReadStats(CaptureStats* s) const {
+		s->inputFrames = inputFrames_.load(std::memory_order_relaxed);
+		s->inputSampleRate = inputRate_.load(std::memory_order_relaxed);
+		s->inputChannels = inputChannels_.load(std::memory_order_relaxed);
+		s->devicePeriodMs = periodMs_.load(std::memory_order_relaxed);
+		s->engineConverted = engineConverted_.load(std::memory_order_relaxed);
+		s->streamLatencyMs = streamLatencyMs_.load(std::memory_order_relaxed);
+		s->micRaw = micRaw_.load(std::memory_order_relaxed);
+		s->mixedEndpoints = mixedEndpoints_.load(std::memory_order_relaxed);
+		s->mixLateSamples = mixLate_.load(std::memory_order_relaxed);
+		s->convert = convert_.Summary();
+		s->stalls = watchdog_.Stats();
+	}
+
+	// No captures and no thread: safe to destroy.
+	bool Idle() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return sinks_.empty() && feeds_.empty() && !alive_;
+	}
+
+	// A client is open (or was, before a reopen); any thread.
+	bool Streaming() const { return inputRate_.load(std::memory_order_relaxed) != 0; }
+
+	// JS thread. Starts the endpoint thread for the first capture.
+	void Attach(WasapiLoopbackCapture* sink) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		sink->owned_ = false;
+		sink->finished_ = false;
+		sinks_.push_back(sink);
+		Launch(lock);
+	}
+
+	// JS thread. Returns once the capture is finished; the last one stops the
+	// endpoint thread.
+	void Detach(WasapiLoopbackCapture* sink) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		auto it = std::find(sinks_.begin(), sinks_.end(), sink);
+		if (it != sinks_.end()) {
+			sinks_.erase(it);
+			Settle(lock, [&] { return sink->finished_ || !sink->owned_; });
+		}
+		if (!sink->finished_) sink->Finish(); // the thread never picked it up
+	}
+
+	// JS thread: a capture switching its source here queues this endpoint's
+	// blocks in `feed` (source_switch.h) until Adopt(); the endpoint thread
+	// starts for it as for a capture.
+	void AttachFeed(SourceSwitch* feed) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		feeds_.push_back(feed);
+		Launch(lock);
+	}
+
+	// JS thread: an abandoned switch. Returns once the thread has let go of it.
+	void DetachFeed(SourceSwitch* feed) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		auto it = std::find(feeds_.begin(), feeds_.end(), feed);
+		if (it == feeds_.end()) return;
+		feeds_.erase(it);
+		const uint64_t generation = generation_.load(std::memory_order_relaxed) + 1;
+		Settle(lock, [&] { return seen_ >= generation || !alive_; });
+	}
+
+	// JS thread: takes a switched capture out without finishing it. Returns
+	// once the thread has let go of it; false when the endpoint had already
+	// finished it.
+	bool Release(WasapiLoopbackCapture* sink) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		auto it = std::find(sinks_.begin(), sinks_.end(), sink);
+		if (it == sinks_.end()) return false;
+		sinks_.erase(it);
+		sink->releasing_ = true;
+		Settle(lock, [&] { return !sink->owned_; });
+		sink->releasing_ = false;
+		return !sink->finished_;
+	}
+
+	// JS thread: the switched capture joins in place of its feed, stages as
+	// they are (Rebind); a thread that has ended since starts again for it.
+	void Adopt(WasapiLoopbackCapture* sink, SourceSwitch* feed) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		feeds_.erase(std::remove(feeds_.begin(), feeds_.end(), feed), feeds_.end());
+		sink->owned_ = false;
+		sink->finished_ = false;
+		sink->adopted_ = true;
+		sinks_.push_back(sink);
+		Launch(lock);
+	}
 
 private:
-	std::thread capture_thread_;
-	std::atomic<bool> running_;
-	Napi::ThreadSafeFunction tsfn_;
-	DWORD targetPid_; // Target process PID (0 = system-wide)
+	// JS thread, under the mutex, after adding to sinks_ or feeds_: wakes the
+	// endpoint thread, or starts it.
+	void Launch(std::unique_lock<std::mutex>& lock) {
+		generation_.fetch_add(1, std::memory_order_release);
+		if (alive_) {
+			SetEvent(wake_);
+			return;
+		}
+		alive_ = true;
+		lock.unlock();
+		if (thread_.joinable()) thread_.join(); // a previous run that ended on its own
+		stop_ = false;
+		thread_ = std::thread(&LoopbackEndpoint::Run, this);
+	}
+
+	// JS thread, under the mutex, after removing from sinks_ or feeds_: stops
+	// the thread when nothing is left on it, else waits until it let go.
+	template <typename Done>
+	void Settle(std::unique_lock<std::mutex>& lock, Done done) {
+		generation_.fetch_add(1, std::memory_order_release);
+		if (sinks_.empty() && feeds_.empty() && alive_) {
+			stop_ = true;
+			SetEvent(wake_);
+			lock.unlock();
+			thread_.join();
+			lock.lock();
+		} else {
+			SetEvent(wake_);
+			finished_.wait(lock, done);
+		}
+	}
+
+	// Endpoint thread: brings the working set in line with sinks_ and feeds_.
+	void Refresh(std::vector<WasapiLoopbackCapture*>* active, size_t maxOutFrames) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		seen_ = generation_.load(std::memory_order_acquire);
+		for (WasapiLoopbackCapture* sink : *active) {
+			if (std::find(sinks_.begin(), sinks_.end(), sink) == sinks_.end()) {
+				if (!sink->releasing_) sink->Finish();
+				sink->owned_ = false;
+			}
+		}
+		for (WasapiLoopbackCapture* sink : sinks_) {
+			if (!sink->owned_) {
+				if (sink->adopted_) {
+					sink->Rebind(realtime_, processLoopback_, inputRate_.load(std::memory_order_relaxed),
+					             inputChannels_.load(std::memory_order_relaxed));
+				} else {
+					sink->Prepare(maxOutFrames, realtime_, processLoopback_);
+				}
+				sink->adopted_ = false;
+				sink->owned_ = true;
+			}
+		}
+		*active = sinks_;
+		feeding_ = feeds_;
+		finished_.notify_all();
+	}
+
+	// Endpoint thread, on the way out (stopped or failed): finishes everyone.
+	void FinishAll(const std::vector<WasapiLoopbackCapture*>& active) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (WasapiLoopbackCapture* sink : active) if (!sink->finished_ && !sink->releasing_) sink->Finish();
+		for (WasapiLoopbackCapture* sink : sinks_) if (!sink->finished_) sink->Finish();
+		for (WasapiLoopbackCapture* sink : active) sink->owned_ = false;
+		sinks_.clear();
+		// A switch to this endpoint that has not taken over yet stays on the old one
+		for (SourceSwitch* feed : feeds_) feed->Fail();
+		feeds_.clear();
+		feeding_.clear();
+		alive_ = false;
+		finished_.notify_all();
+	}
+
+	// Endpoint thread: any capture's governor wants the light resampler.
+	static bool WantLightResampler(const std::vector<WasapiLoopbackCapture*>& active) {
+		return std::any_of(active.begin(), active.end(), [](WasapiLoopbackCapture* sink) { return sink->WantsLightResampler(); });
+	}
+
+	void Run();
+	// Source 'file': stands in for the client loop.
+	void RunReplay();
+	// Option 'outputDevice' with several endpoints: stands in for the client
+	// loop, mixing one loopback client per endpoint.
+	void RunMixed();
+	// Session registry, with the table locked: something started playing.
+	static void SessionStarted(void* context) {
+		LoopbackEndpoint* self = static_cast<LoopbackEndpoint*>(context);
+		self->sessionStarted_.store(true, std::memory_order_release);
+		SetEvent(self->wake_);
+	}
+	// Endpoint thread: a client (or file) is open with this format.
+	void Opened(uint32_t rate, uint32_t channels, double periodMs) {
+		inputRate_.store(rate, std::memory_order_relaxed);
+		inputChannels_.store(channels, std::memory_order_relaxed);
+		periodMs_.store((float)periodMs, std::memory_order_relaxed);
+	}
+
+	const EndpointKey key_;
+	HANDLE wake_ = nullptr; // the client's event handle, also signalled on attach/detach and default device changes
+	std::atomic<bool> defaultChanged_{false}; // set by DefaultDeviceWatcher
+	std::atomic<bool> sessionStarted_{false}; // set by SessionStarted(), option 'idle'
+	std::thread thread_;
+	std::atomic<bool> stop_{false};
+	bool realtime_ = false; // endpoint thread
+	bool processLoopback_ = false; // likewise
+	std::atomic<uint64_t> inputFrames_{0}; // since the thread started
+	std::atomic<uint32_t> inputRate_{0};
+	std::atomic<uint32_t> inputChannels_{0};
+	std::atomic<float> periodMs_{0.0f};
+	std::atomic<bool> engineConverted_{false};
+	std::atomic<float> streamLatencyMs_{0.0f};
+	std::atomic<bool> micRaw_{false};
+	std::atomic<uint32_t> mixedEndpoints_{0};
+	std::atomic<uint64_t> mixLate_{0};
+	LatencyHistogram convert_;
+	CaptureWatchdog watchdog_; // stepped on the endpoint thread
+
+	std::mutex mutex_; // sinks_, alive_ and the captures' owned_/finished_
+	std::condition_variable finished_;
+	std::vector<WasapiLoopbackCapture*> sinks_;
+	std::vector<SourceSwitch*> feeds_;
+	std::vector<SourceSwitch*> feeding_; // endpoint thread: feeds_ as of the last Refresh()
+	bool alive_ = false;
+	std::atomic<uint64_t> generation_{0};
+	uint64_t seen_ = ~0ull; // endpoint thread
 };
 
-bool WasapiLoopbackCapture::Start(DWORD pid, Napi::ThreadSafeFunction tsfn) {
+namespace {
+	// Kept for reuse and shared by the captures of every environment, so one
+	// endpoint client feeds a worker's capture and the main thread's alike.
+	// Endpoints are found and attached, or reaped, under the mutex: one JS
+	// thread never reaps an endpoint another is attaching to.
+	std::mutex g_endpointsMutex;
+	std::vector<std::unique_ptr<LoopbackEndpoint>> g_endpoints;
+
+	// Per environment (addon_instance.h): the capture behind the module-level
+	// startCapture/stopCapture/getStats, and the soundboard outputs.
+	struct LoopbackAddon {
+		SoundboardOutput soundboardOutputs[kSoundboardBuses];
+		std::unique_ptr<WasapiLoopbackCapture> capture;
+	};
+}
+
+// Under g_endpointsMutex.
+LoopbackEndpoint* EndpointFor(DWORD pid, const CaptureOptions& options) {
+	const EndpointKey key = EndpointKey::Of(pid, options);
+	for (auto& endpoint : g_endpoints) if (endpoint->Key() == key) return endpoint.get();
+	g_endpoints.push_back(std::make_unique<LoopbackEndpoint>(key));
+	return g_endpoints.back().get();
+}
+
+bool WasapiLoopbackCapture::Start(DWORD pid, PcmTsfn tsfn, const CaptureOptions& options) {
 	if (running_) return false;
+	Stop(); // detaches from an endpoint that failed under us
 	running_ = true;
 	tsfn_ = tsfn;
+	options_ = options;
+	if (channel_) channel_->Unref();
+	channel_ = tsfn_.GetContext();
+	channel_->AddRef();
 	targetPid_ = pid;
+	ended_ = false;
+	switch_.Abandon(); // one cut short by the last endpoint ending under it
+	packets_ = 0;
+	blocks_ = 0;
+	steadyStateAllocations_ = 0;
+	glitches_ = 0;
+	silentPackets_ = 0;
+	silentRun_ = 0;
+	skippedSamples_ = 0;
+	realtime_ = false;
+	filterGraphLatencyMs_ = 0.0f;
+	outputSamples_ = 0;
+	chain_.Reset();
+	deliver_.Reset();
+	governor_.Configure(options.governor, 16000);
+	if (options.power.enabled) {
+		SystemPowerState().Retain();
+		powerWatched_ = true;
+		options_.latency = options.power.For(SystemPowerState().Source()).latency;
+	}
+	powerChanges_ = ~0ull; // the first block posts the profile in force
+	gate_.Configure(options.arm, 16000);
+	history_.reset();
+	if (options.history.enabled) {
+		history_ = std::make_shared<CaptureHistory>();
+		std::string error;
+		if (!history_->Configure(options.history, &error)) {
+			AddonLog(LogLevel::Warn, "Capture history disabled: %s", error.c_str());
+			history_.reset();
+		}
+	}
+	recorder_.reset(); // a previous recording finishes its last segment
+	if (options.record.enabled) {
+		recorder_ = std::make_unique<SessionRecorder>();
+		std::string error;
+		if (!recorder_->Start(options.record, &error)) {
+			AddonLog(LogLevel::Warn, "Session recording disabled: %s", error.c_str());
+			recorder_.reset();
+		}
+	}
 
-	printf("[addon] Starting system-wide WASAPI loopback capture for PID %lu\n", pid);
-	printf("[addon] NOTE: To exclude Whispra TTS, route it through a separate virtual audio device\n");
-	fflush(stdout);
+	if (options.source == CaptureSource::Microphone) {
+		AddonLog(LogLevel::Info, "Starting WASAPI microphone capture (%s)",
+		         options.inputDevice.empty() ? "default input" : options.inputDevice.c_str());
+	} else if (options.source == CaptureSource::File) {
+		AddonLog(LogLevel::Info, "Starting file replay capture of %s (%s pace)", options.file.c_str(),
+		         options.pace == ReplayPace::Fast ? "fast" : "realtime");
+	} else if (pid == 0 && options.excludeSelf) {
+		AddonLog(LogLevel::Info, "Starting system-wide WASAPI loopback capture, excluding PID %lu and its children", GetCurrentProcessId());
+	} else if (pid == 0 && !options.outputDevices.empty()) {
+		std::string devices;
+		for (const std::string& needle : options.outputDevices) devices += (devices.empty() ? "'" : ", '") + needle + "'";
+		AddonLog(LogLevel::Info, "Starting WASAPI loopback capture of %s%s", devices.c_str(),
+		         options.outputDevices.size() > 1 ? ", mixed" : "");
+	} else if (pid == 0) {
+		AddonLog(LogLevel::Info, "Starting system-wide WASAPI loopback capture");
+		AddonLog(LogLevel::Info, "NOTE: To exclude Whispra TTS, route it through a separate virtual audio device");
+	} else {
+		AddonLog(LogLevel::Info, "Starting WASAPI loopback capture for PID %lu", pid);
+		if (!options.outputDevices.empty()) AddonLog(LogLevel::Warn, "Option 'outputDevice' ignored: the process loopback follows the default endpoint");
+	}
 
-	capture_thread_ = std::thread([this, pid]() {
-		HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
-		if (FAILED(hr)) { printf("[addon] CoInitializeEx failed: 0x%08lx\n", hr); fflush(stdout); running_ = false; tsfn_.Release(); return; }
+	std::lock_guard<std::mutex> lock(g_endpointsMutex);
+	endpoint_ = EndpointFor(pid, options_);
+	endpoint_->Attach(this);
+	return true;
+}
 
-		ComPtr<IMMDeviceEnumerator> enumr;
-		ComPtr<IMMDevice> device;
-		ComPtr<IAudioClient3> audioClient3; // per-app/system
-		ComPtr<IAudioClient>  audioClient1; // system fallback
-		ComPtr<IAudioCaptureClient> cap;
-		WAVEFORMATEX* pwfx = nullptr;
-		HANDLE hEvent = nullptr;
+// The old endpoint keeps running the capture, fading to the new stream's
+// queue once it has a block of it, until the handoff (source_switch.h); the
+// capture then leaves the old endpoint unfinished and joins the new one.
+bool WasapiLoopbackCapture::SwitchSource(DWORD pid, const std::string& endpointId) {
+	if (!running_ || !endpoint_) return false;
+	if (options_.source == CaptureSource::File) {
+		AddonLog(LogLevel::Warn, "switchSource: a file replay has no source to switch");
+		return false;
+	}
+	if (options_.source == CaptureSource::Microphone && endpointId.empty()) {
+		AddonLog(LogLevel::Warn, "switchSource: a microphone capture switches to an input device id, not a PID");
+		return false;
+	}
+	if (switch_.Current() != SourceSwitch::State::Idle) {
+		AddonLog(LogLevel::Warn, "switchSource: a switch is still settling");
+		return false;
+	}
+	CaptureOptions options = options_;
+	if (options.source == CaptureSource::Microphone) {
+		options.inputDevice = endpointId;
+		pid = 0;
+	} else if (!endpointId.empty()) {
+		options.outputDevices = { endpointId };
+		pid = 0;
+	} else {
+		options.outputDevices.clear();
+	}
+	if (EndpointKey::Of(pid, options) == endpoint_->Key()) return true;
+
+	LoopbackEndpoint* incoming;
+	switch_.Begin();
+	{
+		std::lock_guard<std::mutex> lock(g_endpointsMutex);
+		incoming = EndpointFor(pid, options);
+		incoming->AttachFeed(&switch_);
+	}
+	const ULONGLONG startMs = GetTickCount64();
+	SourceSwitch::State state;
+	while ((state = switch_.Current()) == SourceSwitch::State::Pending || state == SourceSwitch::State::Fading) {
+		const ULONGLONG waitedMs = GetTickCount64() - startMs;
+		// An open stream with nothing to say (a loopback of a quiet app) takes over as it is
+		if (state == SourceSwitch::State::Pending && incoming->Streaming() && waitedMs >= kSwitchSilentMs && switch_.TakeOver()) continue;
+		if (waitedMs >= kSwitchTimeoutMs) break;
+		Sleep(5);
+	}
+	const bool ok = state == SourceSwitch::State::Done && endpoint_->Release(this);
+	if (ok) {
+		// No endpoint runs the capture until Adopt()
+		options_ = options;
+		targetPid_ = pid;
+		incoming->Adopt(this, &switch_);
+		endpoint_ = incoming;
+		AddonLog(LogLevel::Info, "Capture switched to %s%s", endpointId.empty() ? "PID " : "", endpointId.empty() ? std::to_string(pid).c_str() : endpointId.c_str());
+	} else {
+		incoming->DetachFeed(&switch_);
+		switch_.Abandon();
+		AddonLog(LogLevel::Warn, "switchSource: %s; the capture stays on its source",
+		         state == SourceSwitch::State::Failed ? "the new source could not be opened" : "the new source did not start in time");
+	}
+	std::lock_guard<std::mutex> lock(g_endpointsMutex);
+	g_endpoints.erase(std::remove_if(g_endpoints.begin(), g_endpoints.end(),
+		[](const std::unique_ptr<LoopbackEndpoint>& e) { return e->Idle(); }), g_endpoints.end());
+	return ok;
+}
 
+void WasapiLoopbackCapture::Stop() {
+	if (powerWatched_) SystemPowerState().Release();
+	powerWatched_ = false;
+	if (!endpoint_) return;
+	endpoint_->Detach(this);
+	endpoint_ = nullptr;
+	// Per-PID endpoints would otherwise pile up, one per app ever captured
+	std::lock_guard<std::mutex> lock(g_endpointsMutex);
+	g_endpoints.erase(std::remove_if(g_endpoints.begin(), g_endpoints.end(),
+		[](const std::unique_ptr<LoopbackEndpoint>& e) { return e->Idle(); }), g_endpoints.end());
+	AddonLog(LogLevel::Info, "WASAPI %s capture stopped", CaptureSourceName(options_.source));
+}
+
+CaptureStats WasapiLoopbackCapture::GetStats() const {
+	CaptureStats s;
+	s.packets = packets_.load(std::memory_order_relaxed);
+	s.blocks = blocks_.load(std::memory_order_relaxed);
+	s.steadyStateAllocations = steadyStateAllocations_.load(std::memory_order_relaxed);
+	s.glitches = glitches_.load(std::memory_order_relaxed);
+	s.silentPackets = silentPackets_.load(std::memory_order_relaxed);
+	s.skippedSamples = skippedSamples_.load(std::memory_order_relaxed);
+	s.realtime = realtime_.load(std::memory_order_relaxed);
+	s.filterGraphLatencyMs = filterGraphLatencyMs_.load(std::memory_order_relaxed);
+	s.processLoopback = processLoopback_.load(std::memory_order_relaxed);
+	s.selfExcluded = selfExcluded_.load(std::memory_order_relaxed);
+	s.echoReference = echoReference_.load(std::memory_order_relaxed);
+	s.echoErleDb = echoErleDb_.load(std::memory_order_relaxed);
+	s.echoDriftPpm = echoDriftPpm_.load(std::memory_order_relaxed);
+	s.outputSamples = outputSamples_.load(std::memory_order_relaxed);
+	s.sourceSwitches = switch_.Switches();
+	s.chain = chain_.Summary();
+	s.deliver = deliver_.Summary();
+	s.governed = options_.governor.enabled;
+	s.quality = governor_.Stats();
+	if (recorder_) {
+		s.recording = true;
+		s.record = recorder_->Stats();
+	}
+	if (endpoint_) {
+		s.endpointSessions = endpoint_->Sessions();
+		endpoint_->ReadStats(&s);
+	}
+	if (channel_) s.delivery = channel_->Stats();
+	return s;
+}
+
+void WasapiLoopbackCapture::Prepare(size_t maxOutFrames, bool realtime, bool processLoopback) {
+	// HPF + adaptive noise gate + voice boost (or loudness normalization) on the 16 kHz stream
+	voice_.Configure(16000.0f, options_.loudness, options_.denoise, options_.filterGraph);
+	warmStarted_ = options_.warmStart.enabled && options_.source != CaptureSource::File;
+	if (warmStarted_) RestoreWarmState(&voice_, options_.warmStart);
+	// Microphones cancel the far end; the first loopback capture to start provides it
+	echo_.Configure(16000.0f, options_.echo);
+	echoReference_ = options_.source == CaptureSource::Loopback && SharedEchoReference().Claim(this);
+	echoErleDb_ = 0.0f;
+	echoDriftPpm_ = 0.0f;
+	// An armed capture opens by running its pre-roll through as one block
+	const size_t maxBlock = std::max(maxOutFrames, gate_.Armed() ? (size_t)options_.arm.prerollMs * 16 : 0);
+	// Level meters and subscribers follow the module-level capture only
+	writer_.Configure(channel_, options_.PacketSamples(16000), maxBlock, options_.feedSubscribers);
+	subscribers_.Configure(16000, options_.resampler, maxBlock);
+	work_.resize(maxOutFrames);
+	preGate_.assign(options_.chunker.enabled && options_.chunker.prerollMs > 0 ? maxBlock : 0, 0.0f);
+	realtime_ = realtime;
+	draining_ = false;
+	// A pid 0 endpoint only activates process loopback in exclude mode
+	processLoopback_ = processLoopback && targetPid_ != 0;
+	selfExcluded_ = processLoopback && targetPid_ == 0;
+}
+
+void WasapiLoopbackCapture::Rebind(bool realtime, bool processLoopback, uint32_t inRate, uint32_t inChannels) {
+	realtime_ = realtime;
+	processLoopback_ = processLoopback && targetPid_ != 0;
+	selfExcluded_ = processLoopback && targetPid_ == 0;
+	draining_ = true;
+	if (inRate) NotifyInputFormatChange(tsfn_, channel_, inRate, inChannels, "source");
+}
+
+void WasapiLoopbackCapture::Reopened(uint32_t inRate, uint32_t inChannels, const char* reason) {
+	glitches_.fetch_add(1, std::memory_order_relaxed);
+	NotifyInputFormatChange(tsfn_, channel_, inRate, inChannels, reason);
+	NotifyDiscontinuity(tsfn_, channel_, writer_.NextIndex());
+}
+
+void WasapiLoopbackCapture::Stalled(StallStep step, uint64_t stalledMs) {
+	if (step == StallStep::Restart) {
+		glitches_.fetch_add(1, std::memory_order_relaxed);
+		NotifyDiscontinuity(tsfn_, channel_, writer_.NextIndex());
+	}
+	NotifyStall(tsfn_, channel_, StallStepName(step), stalledMs, writer_.NextIndex());
+}
+
+void WasapiLoopbackCapture::Idled(bool idle, uint64_t idleMs) {
+	NotifyIdle(tsfn_, channel_, idle, idleMs, writer_.NextIndex());
+}
+
+void WasapiLoopbackCapture::Process(float* samples, size_t count, uint32_t packets, uint64_t timeNs, uint64_t frontNs, bool exclusive, bool glitch, bool silent, bool scratchGrew) {
+	if (draining_) {
+		// Switched over: what the new stream queued since the fade goes first
+		draining_ = false;
+		uint64_t queuedNs = 0;
+		for (size_t n; (n = switch_.Drain(work_.data(), work_.size(), &queuedNs)) > 0;) {
+			Deliver(work_.data(), n, 0, queuedNs, 0, true, false, false, false);
+		}
+		switch_.Settle();
+	} else if (switch_.Current() != SourceSwitch::State::Idle) {
+		// The old stream's blocks, faded into the new one's, until the handoff
+		if (!exclusive) {
+			if (work_.size() < count) {
+				work_.resize(count);
+				scratchGrew = true;
+			}
+			memcpy(work_.data(), samples, count * sizeof(float));
+			samples = work_.data();
+			exclusive = true;
+		}
+		if (!switch_.Mix(samples, count)) return;
+	}
+	Deliver(samples, count, packets, timeNs, frontNs, exclusive, glitch, silent, scratchGrew);
+}
+
+void WasapiLoopbackCapture::Deliver(float* samples, size_t count, uint32_t packets, uint64_t timeNs, uint64_t frontNs, bool exclusive, bool glitch, bool silent, bool scratchGrew) {
+	packets_.fetch_add(packets, std::memory_order_relaxed);
+	blocks_.fetch_add(1, std::memory_order_relaxed);
+	if (silent) silentPackets_.fetch_add(packets, std::memory_order_relaxed);
+	outputSamples_.fetch_add(count, std::memory_order_relaxed);
+	if (glitch) {
+		glitches_.fetch_add(1, std::memory_order_relaxed);
+		NotifyDiscontinuity(tsfn_, channel_, writer_.NextIndex());
+	}
+	// The far end as it was played, before this capture's own stages touch it
+	if (echoReference_.load(std::memory_order_relaxed)) SharedEchoReference().Write(samples, count, timeNs);
+	// Armed: the stream only fills the pre-roll until JS opens delivery, which
+	// hands the pre-roll to the chain ahead of this block
+	if (gate_.Armed()) {
+		switch (gate_.Admit(samples, count, writer_.Idle() && (!options_.feedSubscribers || subscribers_.Idle()))) {
+		case DeliveryGate::Step::Pass:
+			break;
+		case DeliveryGate::Step::Close:
+			writer_.Discard();
+			subscribers_.Discard();
+			return;
+		case DeliveryGate::Step::Hold:
+			return;
+		case DeliveryGate::Step::Open:
+			if (gate_.Opens() > 1) NotifyDiscontinuity(tsfn_, channel_, writer_.NextIndex());
+			silentRun_ = 0;
+			if (gate_.PrerollSamples() > 0) {
+				Run(gate_.Preroll(), gate_.PrerollSamples(), gate_.PrerollNs(timeNs), 0, true, false, false);
+			}
+			break;
+		}
+	}
+	Run(samples, count, timeNs, frontNs, exclusive, silent, scratchGrew);
+}
+
+void WasapiLoopbackCapture::Run(float* samples, size_t count, uint64_t timeNs, uint64_t frontNs, bool exclusive, bool silent, bool scratchGrew) {
+	const auto begin = std::chrono::steady_clock::now();
+	bool slotGrew = scratchGrew;
+	if (!silent) {
+		silentRun_ = 0;
+	} else {
+		// Zeros run the full chain until pauses, holds and lookahead tails have
+		// flushed, and long enough for JS-side pause detection to close what it
+		// buffered; after that nothing downstream would change, so only the
+		// stream clock moves
+		if (silentRun_ < kSilenceDeliveredSamples) silentRun_ += count;
+		if (silentRun_ >= kSilenceDeliveredSamples && writer_.Idle() &&
+		    (!options_.feedSubscribers || subscribers_.Idle())) {
+			writer_.Skip(count, timeNs);
+			if (options_.feedSubscribers) subscribers_.Skip(count, timeNs, &slotGrew);
+			if (history_) history_->Skip(count, timeNs);
+			if (recorder_) recorder_->Skip(count);
+			skippedSamples_.fetch_add(count, std::memory_order_relaxed);
+			if (slotGrew) steadyStateAllocations_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+	if (!exclusive) {
+		if (work_.size() < count) {
+			work_.resize(count);
+			slotGrew = true;
+		}
+		memcpy(work_.data(), samples, count * sizeof(float));
+		samples = work_.data();
+	}
+	if (recorder_ && recorder_->Raw()) recorder_->Write(samples, count, 1.0f);
+	StageClock clock;
+	TraceInterval chainTrace(TraceStage::Chain, count);
+	if (echo_.Enabled()) {
+		echo_.Process(samples, count, timeNs, SharedEchoReference());
+		echoErleDb_.store(echo_.ErleDb(), std::memory_order_relaxed);
+		echoDriftPpm_.store(echo_.DriftPpm(), std::memory_order_relaxed);
+	}
+	// 3) Lightweight noise suppression and 4) mild voice boost with limiter, or
+	// loudness normalization with a lookahead limiter when option 'loudness' is set
+	float* preGate = nullptr;
+	if (!preGate_.empty()) {
+		if (preGate_.size() < count) {
+			preGate_.resize(count);
+			slotGrew = true;
+		}
+		preGate = preGate_.data();
+	}
+	const float gain = voice_.Process(samples, count, preGate);
+	filterGraphLatencyMs_.store(voice_.FilterGraphLatencyMs(), std::memory_order_relaxed);
+	clock.Lap(&chain_);
+	chainTrace.End();
+	// 5) Quantize to int16 into pooled WAV slots and queue them for JS without
+	// blocking; with frameMs set the writer carries partial frames across packets
+	TraceInterval deliverTrace(TraceStage::Deliver, count);
+	writer_.Write(tsfn_, samples, count, timeNs, gain, &slotGrew, voice_.PreGateTapped() ? preGate : nullptr);
+	if (options_.feedSubscribers) subscribers_.Write(samples, count, timeNs, gain, &slotGrew);
+	if (history_) history_->Write(samples, count, timeNs, gain);
+	if (recorder_ && !recorder_->Raw()) recorder_->Write(samples, count, gain);
+	clock.Lap(&deliver_);
+	deliverTrace.End();
+	if (slotGrew) steadyStateAllocations_.fetch_add(1, std::memory_order_relaxed);
+
+	// 6) Trade quality for headroom when the block took too much of its own time
+	bool raised = false;
+	const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+	if (governor_.Update(frontNs + (uint64_t)ns, count, &raised)) ApplyQuality(raised, raised ? "load-low" : "load-high");
+	if (options_.power.enabled) PollPower();
+}
+
+// The resampler is the endpoint's; it follows WantsLightResampler() from the
+// next packet on.
+void WasapiLoopbackCapture::ApplyQuality(bool raised, const char* reason) {
+	const QualityLevel level = governor_.Level();
+	voice_.SuspendDenoise(level >= QualityLevel::NoDenoise);
+	writer_.SetFeatureStride(level >= QualityLevel::SparseFeatures ? 2 : 1);
+	AddonLog(LogLevel::Info, "Quality %s: %s (DSP load %.0f%% of real time)", raised ? "raised" : "lowered",
+	         QualityLevelName(level), governor_.Load() * 100.0f);
+	NotifyQualityChange(tsfn_, channel_, QualityLevelName(level), reason, governor_.Load(), writer_.NextIndex());
+}
+
+// The latency mode is the endpoint's, set up when the capture started; only
+// the quality floor and the wakeup throttle follow the source mid-stream.
+void WasapiLoopbackCapture::PollPower() {
+	const PowerState& power = SystemPowerState();
+	const uint64_t changes = power.Changes();
+	if (changes == powerChanges_) return;
+	powerChanges_ = changes;
+	const PowerSource source = power.Source();
+	const PowerProfile& profile = options_.power.For(source);
+	AddonLog(LogLevel::Info, "Power source %s: quality at most %s, JS wakeups every %u ms", PowerSourceName(source),
+	         QualityLevelName(profile.quality), profile.throttleMs);
+	NotifyPowerChange(tsfn_, channel_, PowerSourceName(source), QualityLevelName(profile.quality), profile.throttleMs,
+	                  LatencyModeName(profile.latency), writer_.NextIndex());
+	bool raised = false;
+	if (governor_.SetFloor(profile.quality, &raised)) ApplyQuality(raised, "power");
+}
+
+void WasapiLoopbackCapture::Finish() {
+	if (warmStarted_) SaveWarmState(voice_, options_.warmStart, writer_.NextIndex());
+	warmStarted_ = false;
+	if (echoReference_.exchange(false)) SharedEchoReference().Release(this);
+	writer_.Discard();
+	subscribers_.Discard();
+	if (recorder_) recorder_->Close();
+	ClosePcmChannel(tsfn_, channel_, ended_);
+	tsfn_.Release();
+	finished_ = true;
+	running_ = false;
+}
+
+// Default device changes for an endpoint thread: raises its flag and wakes
+// it. Agile, since the enumerator calls back on its own threads.
+class DefaultDeviceWatcher : public Microsoft::WRL::RuntimeClass<
+	Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+	Microsoft::WRL::FtmBase, IMMNotificationClient> {
+public:
+	DefaultDeviceWatcher(EDataFlow flow, ERole role, std::atomic<bool>* changed, HANDLE wake)
+		: flow_(flow), role_(role), changed_(changed), wake_(wake) {}
+	STDMETHOD(OnDefaultDeviceChanged)(EDataFlow flow, ERole role, LPCWSTR) override {
+		if (flow == flow_ && role == role_) {
+			changed_->store(true, std::memory_order_release);
+			SetEvent(wake_);
+		}
+		return S_OK;
+	}
+	STDMETHOD(OnDeviceStateChanged)(LPCWSTR, DWORD) override { return S_OK; }
+	STDMETHOD(OnDeviceAdded)(LPCWSTR) override { return S_OK; }
+	STDMETHOD(OnDeviceRemoved)(LPCWSTR) override { return S_OK; }
+	STDMETHOD(OnPropertyValueChanged)(LPCWSTR, const PROPERTYKEY) override { return S_OK; }
+
+private:
+	const EDataFlow flow_;
+	const ERole role_;
+	std::atomic<bool>* const changed_;
+	const HANDLE wake_;
+};
+
+// PKEY_Devices_AudioDevice_RawProcessingSupported (mmdeviceapi.h declares it
+// before initguid.h is included, so it has no definition here).
+const PROPERTYKEY kRawProcessingSupported = { { 0x8943b373, 0x388c, 0x4395, { 0xb5, 0x57, 0xbc, 0x6d, 0xba, 0xff, 0xaf, 0xdb } }, 2 };
+
+// Microphone streams: the category for `role` and, for micMode 'raw',
+// AUDCLNT_STREAMOPTIONS_RAW where the endpoint supports raw processing. Must
+// run before the client's format is read. True when raw mode took.
+bool SetMicStreamProperties(IMMDevice* device, IAudioClient* client, MicMode mode, MicRole role) {
+	bool raw = mode == MicMode::Raw;
+	if (raw) {
+		ComPtr<IPropertyStore> store;
+		PROPVARIANT value;
+		PropVariantInit(&value);
+		raw = SUCCEEDED(device->OpenPropertyStore(STGM_READ, &store)) && SUCCEEDED(store->GetValue(kRawProcessingSupported, &value)) &&
+		      value.vt == VT_BOOL && value.boolVal == VARIANT_TRUE;
+		PropVariantClear(&value);
+		if (!raw) AddonLog(LogLevel::Warn, "Microphone has no raw processing mode; its effects stay on");
+	}
+	if (!raw && role == MicRole::Console) return false; // the defaults
+	ComPtr<IAudioClient2> client2;
+	HRESULT hr = client->QueryInterface(IID_PPV_ARGS(&client2));
+	if (FAILED(hr)) { AddonLog(LogLevel::Warn, "IAudioClient2 unavailable (0x%08lx); default microphone stream", hr); return false; }
+	AudioClientProperties props = {};
+	props.cbSize = sizeof(props);
+	props.bIsOffload = FALSE;
+	props.eCategory = role == MicRole::Communications ? AudioCategory_Communications : AudioCategory_Other;
+	props.Options = raw ? AUDCLNT_STREAMOPTIONS_RAW : AUDCLNT_STREAMOPTIONS_NONE;
+	hr = client2->SetClientProperties(&props);
+	if (FAILED(hr)) { AddonLog(LogLevel::Warn, "SetClientProperties failed: 0x%08lx; default microphone stream", hr); return false; }
+	return raw;
+}
+
+// Plain IEEE float client format; `format` must hold at least a WAVEFORMATEX.
+void SetFloatFormat(WAVEFORMATEX* format, DWORD rate, WORD channels) {
+	format->wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+	format->nChannels = channels;
+	format->nSamplesPerSec = rate;
+	format->wBitsPerSample = 32;
+	format->nBlockAlign = channels * format->wBitsPerSample / 8;
+	format->nAvgBytesPerSec = rate * format->nBlockAlign;
+	format->cbSize = 0;
+}
+
+// The client is gone for good; a new one on the current endpoint works.
+bool DeviceLost(HRESULT hr) {
+	return hr == AUDCLNT_E_DEVICE_INVALIDATED || hr == AUDCLNT_E_SERVICE_NOT_RUNNING;
+}
+
+// A render endpoint's loopback only has packets while the engine mixes
+// something for it; a peak above zero says it does.
+bool EndpointPlaying(IAudioMeterInformation* meter) {
+	float peak = 0.0f;
+	return meter && SUCCEEDED(meter->GetPeakValue(&peak)) && peak > 0.0f;
+}
+
+void LoopbackEndpoint::Run() {
+	ThreadCpuScope cpu(key_.source == CaptureSource::File ? "replay" : "capture");
+	ApplyThreadQos(ThreadQos::Interactive);
+	if (key_.source == CaptureSource::File) {
+		RunReplay();
+		return;
+	}
+	if (key_.outputDevices.size() > 1) {
+		RunMixed();
+		return;
+	}
+	std::vector<WasapiLoopbackCapture*> active;
+	inputFrames_ = 0;
+	watchdog_.Reset();
+	convert_.Reset();
+	HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	if (FAILED(hr)) { AddonLog(LogLevel::Error, "CoInitializeEx failed: 0x%08lx", hr); FinishAll(active); return; }
+
+	ComPtr<IMMDeviceEnumerator> enumr;
+	ComPtr<IMMDevice> device;
+	ComPtr<IAudioClient3> audioClient3; // per-app/system
+	ComPtr<IAudioClient>  audioClient1; // system fallback
+	ComPtr<IAudioCaptureClient> cap;
+	ComPtr<IAudioMeterInformation> meter; // a full-mix loopback's endpoint, for the stall watchdog
+	WAVEFORMATEX* pwfx = nullptr;
+	ThreadScheduleState schedule;
+	realtime_ = false;
+	processLoopback_ = false;
+	seen_ = ~0ull;
+
+	// Event-driven capture, except in powersave mode where the loop polls a large buffer
+	const bool polling = key_.latency == LatencyMode::PowerSave;
+	const bool microphone = key_.source == CaptureSource::Microphone;
+	const DWORD streamFlags = (microphone ? 0 : AUDCLNT_STREAMFLAGS_LOOPBACK) | (polling ? 0 : AUDCLNT_STREAMFLAGS_EVENTCALLBACK);
+	const ERole inputRole = microphone && key_.micRole == MicRole::Communications ? eCommunications : eConsole;
+
+	// Follow the default endpoint: a loopback of the full mix, or the default
+	// microphone, reopens on the new default (process loopback clients follow
+	// it on their own, and an explicit device stays put)
+	hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&enumr));
+	if (FAILED(hr)) AddonLog(LogLevel::Error, "Create MMDeviceEnumerator failed: 0x%08lx", hr);
+	ComPtr<DefaultDeviceWatcher> watcher;
+	if (enumr && (microphone ? key_.inputDevice.empty() : key_.outputDevices.empty())) {
+		watcher = Microsoft::WRL::Make<DefaultDeviceWatcher>(microphone ? eCapture : eRender, inputRole, &defaultChanged_, wake_);
+		if (watcher && FAILED(enumr->RegisterEndpointNotificationCallback(watcher.Get()))) watcher.Reset();
+	}
+	defaultChanged_ = false;
+
+	// Option 'idle': the session registry says when nothing plays, and wakes
+	// the thread when something starts again
+	bool idleRelease = false;
+	if (key_.idleMs != 0) {
+		idleRelease = RetainAudioSessionRegistry();
+		if (idleRelease) AudioSessionTable().AddWaker(&LoopbackEndpoint::SessionStarted, this);
+		else AddonLog(LogLevel::Warn, "Option 'idle' needs the audio session registry, which did not start; the stream stays open");
+	}
+
+	// One pass per client: the first, and one for every reopen after the device
+	// went away, the default changed or an idle release ended. Only the client,
+	// the scratch arena and the converters are rebuilt; the captures carry on.
+	const char* reopenReason = nullptr; // why the previous client was dropped
+	bool idled = false; // dropped by option 'idle'; waits for a session before the reopen
+	StallStep stallStep = StallStep::None; // the watchdog's step behind a "stall" reopen
+	ULONGLONG droppedAtMs = 0;
+	size_t maxOutFrames = 0;
+	for (int attempt = 0;; ++attempt) {
+		bool retry = reopenReason != nullptr; // a failed reopen tries again
 		do {
-			// Default render endpoint
-			hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&enumr));
-			if (FAILED(hr)) { printf("[addon] Create MMDeviceEnumerator failed: 0x%08lx\n", hr); fflush(stdout); break; }
-			hr = enumr->GetDefaultAudioEndpoint(eRender, eConsole, &device);
-			if (FAILED(hr)) { printf("[addon] GetDefaultAudioEndpoint failed: 0x%08lx\n", hr); fflush(stdout); break; }
-
-			// Prefer IAudioClient3 if available
-			hr = device->Activate(__uuidof(IAudioClient3), CLSCTX_ALL, nullptr, (void**)audioClient3.GetAddressOf());
-			if (FAILED(hr) || !audioClient3) {
-				printf("[addon] Activate IAudioClient3 failed or not available: 0x%08lx\n", hr); fflush(stdout);
-				// Fallback to IAudioClient (system-wide)
-				hr = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, (void**)audioClient1.GetAddressOf());
-				if (FAILED(hr)) { printf("[addon] Activate IAudioClient failed: 0x%08lx\n", hr); fflush(stdout); break; }
+			double periodMs = 10.0;
+			processLoopback_ = false;
+			engineConverted_.store(false, std::memory_order_relaxed);
+			micRaw_.store(false, std::memory_order_relaxed);
+
+			if (key_.pid != 0 || key_.excludeSelf) {
+				// Only the target's process tree, or everything but ours (TTS plays from
+				// the renderer and audio service processes, all children of main), mixed
+				// by the engine into a format we pick
+				const DWORD loopbackPid = key_.pid != 0 ? key_.pid : GetCurrentProcessId();
+				hr = ActivateProcessLoopback(loopbackPid,
+					key_.pid != 0 ? PROCESS_LOOPBACK_MODE_INCLUDE_TARGET_PROCESS_TREE : PROCESS_LOOPBACK_MODE_EXCLUDE_TARGET_PROCESS_TREE,
+					audioClient1.GetAddressOf());
+				if (SUCCEEDED(hr)) {
+					pwfx = (WAVEFORMATEX*)CoTaskMemAlloc(sizeof(WAVEFORMATEX));
+					if (!pwfx) { AddonLog(LogLevel::Error, "Out of memory for the capture format"); break; }
+					SetFloatFormat(pwfx, key_.engineConvert ? 16000 : kProcessLoopbackRate, key_.engineConvert ? 1 : 2);
+					hr = audioClient1->Initialize(AUDCLNT_SHAREMODE_SHARED,
+					                              streamFlags | (key_.engineConvert ? kEngineConvertFlags : AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM),
+					                              polling ? kPowerSaveBufferHns : kProcessLoopbackBufferHns, 0, pwfx, nullptr);
+				}
+				if (SUCCEEDED(hr)) {
+					processLoopback_ = true;
+					engineConverted_.store(key_.engineConvert, std::memory_order_relaxed);
+					if (polling) periodMs = kPowerSavePollMs;
+					AddonLog(LogLevel::Info, "Process loopback client OK %s PID %lu and its child processes",
+					         key_.pid != 0 ? "for" : "excluding", loopbackPid);
+				} else {
+					AddonLog(LogLevel::Warn, "Process loopback unavailable for PID %lu (0x%08lx, needs Windows 10 2004+); capturing the full mix", loopbackPid, hr);
+					audioClient1.Reset();
+					if (pwfx) CoTaskMemFree(pwfx);
+					pwfx = nullptr;
+				}
 			}
 
-			// Get mix format
-			if (audioClient3) hr = audioClient3->GetMixFormat(&pwfx);
-			else              hr = audioClient1->GetMixFormat(&pwfx);
-			if (FAILED(hr) || !pwfx) { printf("[addon] GetMixFormat failed: 0x%08lx\n", hr); fflush(stdout); break; }
+			if (!processLoopback_) {
+				// Default render endpoint, or the input device itself for a microphone;
+				// from here on the two only differ in the loopback stream flag
+				if (!enumr) break;
+				if (device) {
+					// Reinitializing a stalled stream: a new client on the same device
+				} else if (microphone) {
+					hr = FindAudioEndpoint(enumr.Get(), eCapture, inputRole, key_.inputDevice, &device);
+					if (FAILED(hr)) { AddonLog(LogLevel::Error, "No capture endpoint for '%s': 0x%08lx", key_.inputDevice.c_str(), hr); break; }
+				} else if (!key_.outputDevices.empty()) {
+					hr = FindAudioEndpoint(enumr.Get(), eRender, eConsole, key_.outputDevices[0], &device);
+					if (FAILED(hr)) { AddonLog(LogLevel::Error, "No render endpoint for '%s': 0x%08lx", key_.outputDevices[0].c_str(), hr); break; }
+				} else {
+					hr = enumr->GetDefaultAudioEndpoint(eRender, eConsole, &device);
+					if (FAILED(hr)) { AddonLog(LogLevel::Error, "GetDefaultAudioEndpoint failed: 0x%08lx", hr); break; }
+				}
+				if (!microphone) device->Activate(__uuidof(IAudioMeterInformation), CLSCTX_ALL, nullptr, (void**)meter.GetAddressOf());
+
+				// A microphone's category and micMode go on every client before its
+				// format is read: raw mode may change the mix format
+				bool micRaw = false;
+				auto micProperties = [&](IAudioClient* client) {
+					if (microphone) micRaw = SetMicStreamProperties(device.Get(), client, key_.micMode, key_.micRole);
+				};
+
+				// Prefer IAudioClient3 if available
+				hr = device->Activate(__uuidof(IAudioClient3), CLSCTX_ALL, nullptr, (void**)audioClient3.GetAddressOf());
+				if (FAILED(hr) || !audioClient3) {
+					AddonLog(LogLevel::Warn, "Activate IAudioClient3 failed or not available: 0x%08lx", hr);
+					// Fallback to IAudioClient (system-wide)
+					hr = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, (void**)audioClient1.GetAddressOf());
+					if (FAILED(hr)) { AddonLog(LogLevel::Error, "Activate IAudioClient failed: 0x%08lx", hr); break; }
+					micProperties(audioClient1.Get());
+				} else {
+					micProperties(audioClient3.Get());
+				}
 
-			// Event-driven capture
-			DWORD streamFlags = AUDCLNT_STREAMFLAGS_LOOPBACK | AUDCLNT_STREAMFLAGS_EVENTCALLBACK;
+				// Get mix format
+				if (audioClient3) hr = audioClient3->GetMixFormat(&pwfx);
+				else              hr = audioClient1->GetMixFormat(&pwfx);
+				if (FAILED(hr) || !pwfx) { AddonLog(LogLevel::Error, "GetMixFormat failed: 0x%08lx", hr); break; }
+
+				// 'engine-converted' asks for 16 kHz mono float in place of the mix
+				// format (the mix format's allocation is at least as large); an
+				// engine that refuses it gets the mix format on a fresh client
+				DWORD flags = streamFlags;
+				if (key_.engineConvert) {
+					SetFloatFormat(pwfx, 16000, 1);
+					flags |= kEngineConvertFlags;
+				}
 
-			bool initialized3 = false;
-			if (audioClient3) {
-				// Get current process ID to exclude Whispra app
-				DWORD currentPid = GetCurrentProcessId();
-				printf("[addon] Current process PID: %lu\n", currentPid); fflush(stdout);
+				bool initialized3 = false;
+				if (audioClient3) {
+					// Get current process ID to exclude Whispra app
+					DWORD currentPid = GetCurrentProcessId();
+					AddonLog(LogLevel::Info, "Current process PID: %lu", currentPid);
 				
-				// For now, we'll use the standard Initialize method
-				// The process exclusion will be handled at the application level by filtering out our own audio
-				if (pid == 0) {
-					// System-wide capture (we'll filter out our own audio in post-processing)
-					hr = audioClient3->Initialize(AUDCLNT_SHAREMODE_SHARED, streamFlags, 0, 0, pwfx, nullptr);
+					// The full mix, Whispra's own output included (or the microphone)
+					hr = InitializeLoopbackStream(audioClient3.Get(), audioClient3.Get(), flags, pwfx, key_.latency, &periodMs);
 					if (FAILED(hr)) { 
-						printf("[addon] IAudioClient3 Initialize (system) failed: 0x%08lx\n", hr); fflush(stdout); 
+						AddonLog(LogLevel::Error, "IAudioClient3 Initialize (system) failed: 0x%08lx", hr); 
 					} else { 
 						initialized3 = true; 
-						printf("[addon] IAudioClient3 Initialize (system) OK - will filter out current process audio\n"); 
-						fflush(stdout); 
+						AddonLog(LogLevel::Info, "IAudioClient3 Initialize (system) OK");
 					}
-				}
-				// If pid > 0, we want to include a specific target process
-				else if (pid > 0) {
-					// For specific process capture, we'll use the standard Initialize method
-					// The process-specific capture will be handled by the application logic
-					hr = audioClient3->Initialize(AUDCLNT_SHAREMODE_SHARED, streamFlags, 0, 0, pwfx, nullptr);
-					if (FAILED(hr)) { 
-						printf("[addon] IAudioClient3 Initialize (target process) failed: 0x%08lx\n", hr); fflush(stdout); 
-					} else { 
-						initialized3 = true; 
-						printf("[addon] IAudioClient3 Initialize (target process) OK for pid=%lu\n", pid); 
-						fflush(stdout); 
-					}
-				}
 				
-				if (audioClient3 && !initialized3) { audioClient3.Reset(); }
-			}
+					if (audioClient3 && !initialized3) { audioClient3.Reset(); }
+				}
 
-			// If we don't have a working IAudioClient3, use IAudioClient (system-wide)
-			if (!audioClient3) {
-				if (!audioClient1) {
-					// Should not happen, but guard anyway
-					hr = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, (void**)audioClient1.GetAddressOf());
-					if (FAILED(hr)) { printf("[addon] Activate IAudioClient (fallback) failed: 0x%08lx\n", hr); fflush(stdout); break; }
+				// If we don't have a working IAudioClient3, use IAudioClient (system-wide)
+				if (!audioClient3) {
+					if (!audioClient1) {
+						// Should not happen, but guard anyway
+						hr = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, (void**)audioClient1.GetAddressOf());
+						if (FAILED(hr)) { AddonLog(LogLevel::Error, "Activate IAudioClient (fallback) failed: 0x%08lx", hr); break; }
+						micProperties(audioClient1.Get());
+					}
+					hr = InitializeLoopbackStream(audioClient1.Get(), nullptr, flags, pwfx, key_.latency, &periodMs);
+					if (FAILED(hr) && flags != streamFlags) {
+						AddonLog(LogLevel::Warn, "Engine conversion to 16 kHz mono refused (0x%08lx); converting the mix format here", hr);
+						flags = streamFlags;
+						CoTaskMemFree(pwfx);
+						pwfx = nullptr;
+						audioClient1.Reset();
+						hr = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, (void**)audioClient1.GetAddressOf());
+						if (SUCCEEDED(hr)) micProperties(audioClient1.Get());
+						if (SUCCEEDED(hr)) hr = audioClient1->GetMixFormat(&pwfx);
+						if (SUCCEEDED(hr) && pwfx) hr = InitializeLoopbackStream(audioClient1.Get(), nullptr, flags, pwfx, key_.latency, &periodMs);
+					}
+					if (FAILED(hr) || !pwfx) { AddonLog(LogLevel::Error, "IAudioClient Initialize failed: 0x%08lx", hr); break; }
+					else { AddonLog(LogLevel::Info, "IAudioClient Initialize (system) OK"); }
 				}
-				hr = audioClient1->Initialize(AUDCLNT_SHAREMODE_SHARED, streamFlags, 0, 0, pwfx, nullptr);
-				if (FAILED(hr)) { printf("[addon] IAudioClient Initialize failed: 0x%08lx\n", hr); fflush(stdout); break; }
-				else { printf("[addon] IAudioClient Initialize (system) OK\n"); fflush(stdout); }
+				engineConverted_.store(flags != streamFlags, std::memory_order_relaxed);
+				micRaw_.store(micRaw, std::memory_order_relaxed);
 			}
 
 			// Common setup
-			hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-			if (!hEvent) { hr = E_FAIL; printf("[addon] CreateEvent failed\n"); fflush(stdout); break; }
-			if (audioClient3) hr = audioClient3->SetEventHandle(hEvent); else hr = audioClient1->SetEventHandle(hEvent);
-			if (FAILED(hr)) { printf("[addon] SetEventHandle failed: 0x%08lx\n", hr); fflush(stdout); break; }
+			// In polling mode the event is only signalled on attach/detach and otherwise paces the loop
+			if (!wake_) { hr = E_FAIL; AddonLog(LogLevel::Error, "CreateEvent failed"); break; }
+			if (!polling) {
+				if (audioClient3) hr = audioClient3->SetEventHandle(wake_); else hr = audioClient1->SetEventHandle(wake_);
+				if (FAILED(hr)) { AddonLog(LogLevel::Error, "SetEventHandle failed: 0x%08lx", hr); break; }
+			}
 			if (audioClient3) hr = audioClient3->GetService(IID_PPV_ARGS(&cap)); else hr = audioClient1->GetService(IID_PPV_ARGS(&cap));
-			if (FAILED(hr)) { printf("[addon] GetService(IAudioCaptureClient) failed: 0x%08lx\n", hr); fflush(stdout); break; }
+			if (FAILED(hr)) { AddonLog(LogLevel::Error, "GetService(IAudioCaptureClient) failed: 0x%08lx", hr); break; }
 			if (audioClient3) hr = audioClient3->Start(); else hr = audioClient1->Start();
-			if (FAILED(hr)) { printf("[addon] AudioClient Start failed: 0x%08lx\n", hr); fflush(stdout); break; }
-			printf("[addon] Capture started. Entering loop...\n"); fflush(stdout);
-
-			// --- Lightweight pre-processing state (HPF + adaptive noise gate) ---
-			// Design a simple 2nd-order high-pass biquad at ~90 Hz for 16 kHz stream
-			struct BiquadHPF {
-				float b0=0, b1=0, b2=0, a1=0, a2=0;
-				float z1=0, z2=0;
-				void setup(float fs, float fc, float Q=0.7071f) {
-					const float PI = 3.14159265358979323846f;
-					float w0 = 2.0f * PI * (fc / fs);
-					float c  = cosf(w0);
-					float s  = sinf(w0);
-					float alpha = s / (2.0f * Q);
-					float a0 = 1.0f + alpha;
-					b0 =  (1.0f + c) * 0.5f / a0;
-					b1 = -(1.0f + c)       / a0;
-					b2 =  (1.0f + c) * 0.5f / a0;
-					a1 =  (-2.0f * c)       / a0;
-					a2 =  (1.0f - alpha)     / a0;
-					z1 = z2 = 0.0f;
-				}
-				inline float process(float x) {
-					float y = b0*x + z1;
-					z1 = b1*x + z2 - a1*y;
-					z2 = b2*x - a2*y;
-					return y;
-				}
-			} hpf;
-			const float outFs = 16000.0f;
-			hpf.setup(outFs, 90.0f, 0.7071f);
-			// Adaptive noise gate state
-			float env = 0.0f;                 // signal envelope
-			float noiseFloor = 0.003f;        // ~-50 dBFS initial floor
-			float gainSmooth = 1.0f;          // smoothed gate gain
-			// Time constants
-			const float tauEnv = 0.010f;      // 10 ms envelope
-			const float tauRise = 0.500f;     // 500 ms noise floor rise
-			const float tauAtk  = 0.005f;     // 5 ms gain attack (attenuation)
-			const float tauRel  = 0.050f;     // 50 ms gain release (recovery)
-			const float aEnv  = expf(-1.0f / (tauEnv * outFs));
-			const float aRise = expf(-1.0f / (tauRise * outFs));
-			const float aAtk  = expf(-1.0f / (tauAtk  * outFs));
-			const float aRel  = expf(-1.0f / (tauRel  * outFs));
+			if (FAILED(hr)) { AddonLog(LogLevel::Error, "AudioClient Start failed: 0x%08lx", hr); break; }
+			AddonLog(LogLevel::Info, "Capture started. Entering loop...");
+			REFERENCE_TIME streamLatency = 0;
+			const HRESULT latencyHr = audioClient3 ? audioClient3->GetStreamLatency(&streamLatency) : audioClient1->GetStreamLatency(&streamLatency);
+			streamLatencyMs_.store(SUCCEEDED(latencyHr) ? (float)(streamLatency / 10000.0) : 0.0f, std::memory_order_relaxed);
+			if (microphone) {
+				AddonLog(LogLevel::Info, "Microphone stream: %s, %s role, %.2f ms period, %.2f ms stream latency",
+				         micRaw_.load(std::memory_order_relaxed) ? "raw" : "with endpoint effects",
+				         key_.micRole == MicRole::Communications ? "communications" : "console", periodMs, streamLatency / 10000.0);
+			}
+
+			// Run the packet loop as an MMCSS task so it isn't starved by the renderer/GPU processes
+			if (!realtime_ && ApplyThreadSchedule(key_.schedule, key_.priority, periodMs, &schedule)) {
+				realtime_ = true;
+				AddonLog(LogLevel::Info, "Capture thread scheduled as MMCSS '%s' task", ThreadScheduleName(key_.schedule));
+			}
+
+			// Size the scratch arena once; the packet path below only reuses it.
+			// Packets never exceed the endpoint buffer size.
+			const uint32_t inRate = pwfx->nSamplesPerSec;
+			const uint16_t inCh = pwfx->nChannels;
+			const uint32_t outRate = 16000;
+			UINT32 bufferFrames = 0;
+			if (audioClient3) hr = audioClient3->GetBufferSize(&bufferFrames); else hr = audioClient1->GetBufferSize(&bufferFrames);
+			if (FAILED(hr) || bufferFrames == 0) bufferFrames = inRate / 10; // assume 100 ms if the engine won't say
+			CaptureScratch scratch;
+			scratch.Prepare(bufferFrames, inRate, outRate);
+			FrontResampler resampler;
+			resampler.Configure(inRate, outRate, key_.resampler, bufferFrames);
+			DownmixPlan downmix;
+			DWORD channelMask = 0;
+			if (!DownmixPlanForFormat(pwfx, &downmix, &channelMask)) {
+				AddonLog(LogLevel::Error, "Unsupported mix format: tag 0x%04x, %u bits, %u channels", pwfx->wFormatTag, pwfx->wBitsPerSample, pwfx->nChannels);
+				break;
+			}
+			DialogueFocus dialogue;
+			dialogue.Configure(key_.dialogue, &downmix, channelMask, inRate);
+			AddonLog(LogLevel::Info, "%s: %lu Hz, %u channels, %u bits, %s downmix, dialogue %s", engineConverted_.load(std::memory_order_relaxed) ? "Engine-converted format" : "Mix format",
+			         inRate, inCh, pwfx->wBitsPerSample, downmix.kernelName, DialogueFocus::ModeName(dialogue.Current()));
+			Opened(inRate, inCh, periodMs);
+			watchdog_.Configure(inRate, periodMs, GetTickCount64());
+			// libswresample downmixes with the plan's weights: fine for a centre selection, not for the stereo extractor
+			SwrConverter swr;
+			if (!resampler.bypass && dialogue.Current() != DialogueFocus::Mode::MidSide && swr.Configure(downmix, inRate, outRate, key_.resampler)) {
+				AddonLog(LogLevel::Info, "Converting with libswresample");
+			}
+			maxOutFrames = scratch.maxOutFrames;
+
+			// Captures already running see the gap and the new device format
+			if (reopenReason) {
+				AddonLog(LogLevel::Info, "Capture client reopened (%s) after %llu ms", reopenReason, GetTickCount64() - droppedAtMs);
+				for (WasapiLoopbackCapture* sink : active) sink->Reopened(inRate, inCh, reopenReason);
+				reopenReason = nullptr;
+			}
+			attempt = 0;
+			retry = false;
+			ULONGLONG playedMs = GetTickCount64(); // option 'idle': last check that found something playing
+			ULONGLONG idleCheckMs = playedMs;
 
 			// Capture loop
-			while (running_) {
-				DWORD wr = WaitForSingleObject(hEvent, 200);
-				if (wr != WAIT_OBJECT_0) continue;
+			bool wasSilent = false;
+			while (!stop_ && !reopenReason) {
+				DWORD wr = WaitForSingleObject(wake_, polling ? kPowerSavePollMs : CaptureWatchdog::kPollMs);
+				if (generation_.load(std::memory_order_acquire) != seen_) Refresh(&active, scratch.maxOutFrames);
+				if (defaultChanged_.exchange(false, std::memory_order_acq_rel) && watcher && !processLoopback_) {
+					reopenReason = microphone ? "default-input" : "default-output";
+					break;
+				}
 
+				// A client can stop signalling without ever failing: frames are due
+				// from a microphone always, from a loopback after its event or while
+				// its endpoint plays, and whenever a packet waits unannounced
+				bool unsignalled = false;
+				if (wr != WAIT_OBJECT_0 && !polling) {
+					UINT32 waiting = 0;
+					unsignalled = SUCCEEDED(cap->GetNextPacketSize(&waiting)) && waiting > 0;
+				}
+				const ULONGLONG nowMs = GetTickCount64();
+				const StallStep step = watchdog_.Poll(nowMs, microphone || wr == WAIT_OBJECT_0 || unsignalled || EndpointPlaying(meter.Get()));
+				if (step != StallStep::None) {
+					const uint64_t stalledMs = watchdog_.StalledMs(nowMs);
+					AddonLog(LogLevel::Warn, "Capture stream stalled: %s (%llu ms after it was detected)", StallStepName(step), (unsigned long long)stalledMs);
+					for (WasapiLoopbackCapture* sink : active) sink->Stalled(step, stalledMs);
+					if (step != StallStep::Restart) {
+						stallStep = step;
+						reopenReason = "stall";
+						break;
+					}
+					IAudioClient* client = audioClient3 ? audioClient3.Get() : audioClient1.Get();
+					client->Stop();
+					client->Reset();
+					hr = client->Start();
+					if (FAILED(hr)) {
+						reopenReason = DeviceLost(hr) ? "device-lost" : "stall";
+						break;
+					}
+					continue;
+				}
+				uint64_t recoveredMs = 0;
+				if (watchdog_.TakeRecovered(&recoveredMs)) {
+					AddonLog(LogLevel::Info, "Capture stream recovered %llu ms after a stall was detected", (unsigned long long)recoveredMs);
+					for (WasapiLoopbackCapture* sink : active) sink->Stalled(StallStep::None, recoveredMs);
+				}
+				// A switch waiting on this endpoint's blocks counts as playing
+				if (idleRelease && nowMs - idleCheckMs >= kIdleCheckMs) {
+					idleCheckMs = nowMs;
+					if (!feeding_.empty() || AudioSessionTable().AnyActive()) {
+						playedMs = nowMs;
+					} else if (nowMs - playedMs >= key_.idleMs) {
+						reopenReason = "idle";
+						idled = true;
+						break;
+					}
+				}
+				if (wr != WAIT_OBJECT_0 && !polling) continue;
+
+				// Drain every pending packet into one block: each is converted and
+				// released right away, then the back ends run their chains and
+				// deliver once for the lot. A block ends where the silent flag
+				// flips, at a discontinuity, or when the arena would overflow.
+				size_t pending = 0; // 16 kHz samples at the front of scratch.resampled
+				uint32_t pendingPackets = 0;
+				uint64_t pendingNs = 0, pendingFrontNs = 0;
+				bool pendingGlitch = false, pendingSilent = false, pendingGrew = false;
+				auto flush = [&]() {
+					if (pending == 0) return; // flags carry over to the next block
+					for (SourceSwitch* feed : feeding_) feed->Push(scratch.resampled.data(), pending, pendingNs);
+					// Back ends; the last capture may process the block in place
+					for (size_t i = 0; i < active.size(); ++i) {
+						active[i]->Process(scratch.resampled.data(), pending, pendingPackets, pendingNs, pendingFrontNs,
+						                   i + 1 == active.size(), pendingGlitch, pendingSilent, pendingGrew);
+					}
+					pending = 0;
+					pendingPackets = 0;
+					pendingFrontNs = 0;
+					pendingGlitch = pendingGrew = false;
+				};
 				for (;;) {
 					UINT32 packet = 0;
 					hr = cap->GetNextPacketSize(&packet);
+					if (DeviceLost(hr)) reopenReason = "device-lost";
 					if (FAILED(hr) || packet == 0) break;
 
 					BYTE* pData = nullptr;
 					UINT32 frames = 0;
 					DWORD  capFlags = 0;
-					hr = cap->GetBuffer(&pData, &frames, &capFlags, nullptr, nullptr);
-					if (FAILED(hr)) { printf("[addon] GetBuffer failed: 0x%08lx\n", hr); fflush(stdout); break; }
-
-									size_t bytes = frames * pwfx->nBlockAlign;
-								
-								// Single-step: mix to mono, resample to 16kHz, normalize, quantize to int16, wrap WAV
-								const uint32_t inRate = pwfx->nSamplesPerSec;
-								const uint16_t inCh = pwfx->nChannels;
-								const uint32_t outRate = 16000;
-								// 1) Convert to mono float [-1,1]
-								std::vector<float> mono; mono.reserve(frames);
-								if (pwfx->wFormatTag == WAVE_FORMAT_IEEE_FLOAT || 
-									(pwfx->wFormatTag == WAVE_FORMAT_EXTENSIBLE && 
-									 reinterpret_cast<WAVEFORMATEXTENSIBLE*>(pwfx)->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT)) {
-									const float* f = reinterpret_cast<const float*>(pData);
-									for (UINT32 i = 0; i < frames; ++i) {
-										float sum = 0.0f;
-										for (UINT16 c = 0; c < inCh; ++c) sum += f[i * inCh + c];
-										float m = sum / (float)inCh;
-										if (m > 1.0f) m = 1.0f; else if (m < -1.0f) m = -1.0f;
-										mono.push_back(m);
-									}
-								} else {
-									const int16_t* s = reinterpret_cast<const int16_t*>(pData);
-									for (UINT32 i = 0; i < frames; ++i) {
-										int sum = 0;
-										for (UINT16 c = 0; c < inCh; ++c) sum += s[i * inCh + c];
-										float m = (float)sum / (float)inCh / 32768.0f;
-										if (m > 1.0f) m = 1.0f; else if (m < -1.0f) m = -1.0f;
-										mono.push_back(m);
-									}
-								}
-					// 2) Resample to 16k using linear interpolation
-								size_t outLen = (size_t)((double)mono.size() * (double)outRate / (double)inRate);
-								if (outLen == 0) outLen = 1;
-								std::vector<float> resampled(outLen);
-								for (size_t i = 0; i < outLen; ++i) {
-									double pos = (double)i * (double)inRate / (double)outRate;
-									size_t idx = (size_t)pos;
-									double frac = pos - (double)idx;
-									float a = mono[ idx < mono.size() ? idx : (mono.size()-1) ];
-									float b = mono[ (idx+1) < mono.size() ? (idx+1) : (mono.size()-1) ];
-									resampled[i] = (float)((1.0 - frac) * a + frac * b);
-								}
-								// 3) Lightweight noise suppression: high-pass + adaptive noise gate
-								for (size_t i = 0; i < resampled.size(); ++i) {
-									float x = resampled[i];
-									// High-pass to remove steady LF rumble (wind/fans)
-									x = hpf.process(x);
-									// Envelope follower
-									float av = x < 0 ? -x : x;
-									env = aEnv * env + (1.0f - aEnv) * av;
-									// Update noise floor: fast for drops, slow for rises
-									if (env < noiseFloor) noiseFloor = env;
-									else                 noiseFloor = noiseFloor + (env - noiseFloor) * (1.0f - aRise);
-									if (noiseFloor < 1e-6f) noiseFloor = 1e-6f;
-									// Dynamic threshold and soft-knee gate
-									float thr = noiseFloor * 2.5f + 1e-6f;
-									float tGain = (env > thr) ? 1.0f : (env / thr);
-									// Soft knee shaping
-									tGain = sqrtf(tGain);
-									// Smooth gain changes (fast attack when attenuating, slower release)
-									float a = (tGain < gainSmooth) ? aAtk : aRel;
-									gainSmooth = tGain + (gainSmooth - tGain) * a;
-									// Apply gain
-									resampled[i] = x * gainSmooth;
-								}
-								// 4) Mild voice boost with limiter (increase vocal loudness a bit)
-								float peak = 0.0f;
-								for (float v : resampled) { float av2 = v < 0 ? -v : v; if (av2 > peak) peak = av2; }
-								const float kVoiceBoost = 1.5f; // ~+3.5 dB, adjust 1.2–1.8 as needed
-								float gain;
-								if (peak < 1e-6f) gain = kVoiceBoost;
-								else gain = (peak * kVoiceBoost > 0.99f) ? (0.99f / peak) : kVoiceBoost;
-								// 4) Quantize to int16
-								std::vector<int16_t> int16Samples; int16Samples.resize(resampled.size());
-								for (size_t i = 0; i < resampled.size(); ++i) {
-									float x = resampled[i] * gain;
-									if (x > 1.0f) x = 1.0f; else if (x < -1.0f) x = -1.0f;
-									int s = (int)(x * 32767.0f + (x >= 0 ? 0.5f : -0.5f));
-									if (s > 32767) s = 32767; if (s < -32768) s = -32768;
-									int16Samples[i] = (int16_t)s;
-								}
-								// 5) Build WAV header for 16kHz, mono, 16-bit PCM
-								const uint16_t channels = 1;
-								const uint32_t sampleRate = outRate;
-								const uint32_t pcmDataSize = (uint32_t)(int16Samples.size() * sizeof(int16_t));
-								const uint32_t totalSize = 36 + pcmDataSize;
-								std::vector<uint8_t> wavBuffer(44 + pcmDataSize);
-								uint8_t* header = wavBuffer.data();
-								memcpy(header + 0, "RIFF", 4);
-								*reinterpret_cast<uint32_t*>(header + 4) = totalSize;
-								memcpy(header + 8, "WAVE", 4);
-								memcpy(header + 12, "fmt ", 4);
-								*reinterpret_cast<uint32_t*>(header + 16) = 16; // fmt chunk size
-								*reinterpret_cast<uint16_t*>(header + 20) = 1;  // PCM format
-								*reinterpret_cast<uint16_t*>(header + 22) = channels;
-								*reinterpret_cast<uint32_t*>(header + 24) = sampleRate;
-								*reinterpret_cast<uint32_t*>(header + 28) = sampleRate * channels * 2; // byte rate
-								*reinterpret_cast<uint16_t*>(header + 32) = channels * 2; // block align
-								*reinterpret_cast<uint16_t*>(header + 34) = 16; // bits per sample
-								memcpy(header + 36, "data", 4);
-								*reinterpret_cast<uint32_t*>(header + 40) = pcmDataSize;
-								memcpy(header + 44, int16Samples.data(), pcmDataSize);
-
-								// Send WAV buffer to callback
-								tsfn_.BlockingCall([wavBuffer](Napi::Env env, Napi::Function cb) {
-									auto buffer = Napi::Buffer<uint8_t>::Copy(env, wavBuffer.data(), wavBuffer.size());
-									cb.Call({ buffer });
-								});
+					UINT64 qpc = 0; // 100 ns units
+					hr = cap->GetBuffer(&pData, &frames, &capFlags, nullptr, &qpc);
+					if (FAILED(hr)) {
+						if (DeviceLost(hr)) reopenReason = "device-lost";
+						else AddonLog(LogLevel::Error, "GetBuffer failed: 0x%08lx", hr);
+						break;
+					}
+					if (frames == 0) { cap->ReleaseBuffer(frames); continue; }
+					PlatformTraceMark(TraceMark::Packet, frames);
+					const bool glitch = (capFlags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) != 0;
+					const bool silent = (capFlags & AUDCLNT_BUFFERFLAGS_SILENT) != 0;
+					const bool grew = scratch.Ensure(frames, inRate, outRate);
+					const size_t room = (size_t)((double)frames * (double)outRate / (double)inRate) + 2;
+					if (glitch || silent != pendingSilent || pending + room > scratch.resampled.size()) flush();
+					if (pending == 0) {
+						pendingNs = qpc * 100;
+						pendingSilent = silent;
+					}
 
+					// Shared front end, once per packet for every capture on this endpoint:
+					// 1) Convert to mono float [-1,1] (format conversion and channel weights in one pass)
+					// 2) Resample to 16k; the polyphase filter keeps its history across packets
+					// Silent packets skip both: the engine's buffer is not even read
+					StageClock clock;
+					TraceInterval convertTrace(TraceStage::Convert, frames);
+					float* resampled = scratch.resampled.data() + pending;
+					size_t outLen;
+					resampler.Follow(WantLightResampler(active));
+					if (silent) {
+						if (!wasSilent) {
+							resampler.Reset();
+							dialogue.Reset();
+						}
+						outLen = scratch.Silence(frames, inRate, outRate, pending);
+					} else if (swr.Active()) {
+						outLen = swr.Process(pData, frames, resampled, scratch.resampled.size() - pending); // both steps in one call
+					} else if (resampler.bypass) {
+						dialogue.Run(downmix, pData, frames, resampled); // already 16 kHz
+						outLen = frames;
+					} else {
+						float* mono = scratch.mono.data();
+						dialogue.Run(downmix, pData, frames, mono);
+						outLen = resampler.Process(mono, frames, resampled);
+					}
 					cap->ReleaseBuffer(frames);
+					convertTrace.End();
+					inputFrames_.fetch_add(frames, std::memory_order_relaxed);
+					watchdog_.Delivered(frames);
+					if (!silent) {
+						pendingFrontNs += clock.Lap(&convert_);
+						scratch.silenceCarry = 0;
+					}
+					wasSilent = silent;
+					pending += outLen;
+					++pendingPackets;
+					pendingGlitch = pendingGlitch || glitch;
+					pendingGrew = pendingGrew || grew;
 				}
+				flush();
 			}
 
 			if (audioClient3) audioClient3->Stop();
 			if (audioClient1) audioClient1->Stop();
+			if (reopenReason && !stop_) {
+				if (idled) {
+					AddonLog(LogLevel::Info, "Nothing played for %lu ms; capture client released until a session starts", (unsigned long)key_.idleMs);
+				} else {
+					AddonLog(LogLevel::Info, "Capture client dropped (%s); reopening", reopenReason);
+				}
+				droppedAtMs = GetTickCount64();
+				retry = true;
+			}
 
 		} while (false);
 
-		if (hEvent) CloseHandle(hEvent);
+		// One reinitialization keeps the device; if it fails the next pass looks it up again
+		const bool keepDevice = retry && stallStep == StallStep::Reinitialize;
+		stallStep = StallStep::None;
 		if (cap) cap.Reset();
+		if (meter) meter.Reset();
 		if (audioClient3) audioClient3.Reset();
 		if (audioClient1) audioClient1.Reset();
-		if (device) device.Reset();
-		if (enumr) enumr.Reset();
+		if (device && !keepDevice) device.Reset();
 		if (pwfx) CoTaskMemFree(pwfx);
+		pwfx = nullptr;
+
+		// Idle: no client and no wakeups until a session plays (or a switch
+		// wants this endpoint's blocks); what plays before the reopen is lost
+		if (idled && !stop_) {
+			idled = false;
+			for (WasapiLoopbackCapture* sink : active) sink->Idled(true, 0);
+			sessionStarted_.store(false, std::memory_order_relaxed);
+			while (!stop_) {
+				WaitForSingleObject(wake_, INFINITE);
+				if (generation_.load(std::memory_order_acquire) != seen_) Refresh(&active, maxOutFrames);
+				if (sessionStarted_.exchange(false, std::memory_order_acq_rel) || !feeding_.empty() || AudioSessionTable().AnyActive()) break;
+			}
+			if (stop_) break;
+			const ULONGLONG idleMs = GetTickCount64() - droppedAtMs;
+			AddonLog(LogLevel::Info, "Session activity after %llu ms idle; reopening the capture client", idleMs);
+			for (WasapiLoopbackCapture* sink : active) sink->Idled(false, idleMs);
+			droppedAtMs = GetTickCount64();
+		}
 
-		tsfn_.Release();
-		CoUninitialize();
-	});
+		if (stop_ || !retry) break;
+		if (attempt >= kReopenAttempts) {
+			AddonLog(LogLevel::Error, "Capture client could not be reopened after %d attempts", attempt);
+			break;
+		}
+		// The first reopen is immediate; later ones give the new endpoint time
+		if (attempt > 0) {
+			WaitForSingleObject(wake_, kReopenBackoffMs);
+			if (generation_.load(std::memory_order_acquire) != seen_) Refresh(&active, maxOutFrames);
+		}
+	}
 
-	return true;
-}
+	if (watcher) enumr->UnregisterEndpointNotificationCallback(watcher.Get());
+	watcher.Reset();
+	if (enumr) enumr.Reset();
+	if (idleRelease) AudioSessionTable().RemoveWaker(this);
+	if (key_.idleMs != 0) ReleaseAudioSessionRegistry();
 
-void WasapiLoopbackCapture::Stop() {
-	running_ = false;
-	if (capture_thread_.joinable()) capture_thread_.join();
-	printf("[addon] WASAPI loopback capture stopped\n");
-	fflush(stdout);
+	RevertThreadSchedule(&schedule);
+	FinishAll(active);
+	CoUninitialize();
 }
 
-// Helper function to get process name from PID
-std::string GetProcessName(DWORD pid) {
-	HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pid);
-	if (!hProcess) return "";
-	
-	char processName[MAX_PATH];
-	if (GetModuleBaseNameA(hProcess, NULL, processName, sizeof(processName))) {
-		CloseHandle(hProcess);
-		return std::string(processName);
+// The file is decoded in 10 ms blocks and goes through the same conversion
+// and back ends as a device packet, timed on the QPC clock from the start.
+// Pace 'fast' only waits while a capture's queue is backlogged, so no packet
+// is lost to overflow. After the file, kReplayTailMs of silence flushes the
+// chain and every capture ends.
+void LoopbackEndpoint::RunReplay() {
+	std::vector<WasapiLoopbackCapture*> active;
+	inputFrames_ = 0;
+	convert_.Reset();
+	ThreadScheduleState schedule;
+	realtime_ = false;
+	processLoopback_ = false;
+	seen_ = ~0ull;
+
+	FileReplaySource source;
+	std::string error;
+	if (!source.Open(key_.file, &error)) {
+		AddonLog(LogLevel::Error, "File replay: %s", error.c_str());
+		FinishAll(active);
+		return;
+	}
+	const uint32_t inRate = source.SampleRate();
+	const uint16_t inCh = source.Channels();
+	const uint32_t outRate = 16000;
+	const size_t blockFrames = source.BlockFrames();
+	RealtimeVector<float> block(blockFrames * inCh);
+	CaptureScratch scratch;
+	scratch.Prepare(blockFrames, inRate, outRate);
+	FrontResampler resampler;
+	resampler.Configure(inRate, outRate, key_.resampler, blockFrames);
+	DownmixPlan downmix = MakeDownmixPlan(PcmSampleType::Float32, inCh, source.ChannelMask());
+	DialogueFocus dialogue;
+	dialogue.Configure(key_.dialogue, &downmix, source.ChannelMask(), inRate);
+	SwrConverter swr;
+	if (dialogue.Current() != DialogueFocus::Mode::MidSide && swr.Configure(downmix, inRate, outRate, key_.resampler)) {
+		AddonLog(LogLevel::Info, "Converting with libswresample");
+	}
+	AddonLog(LogLevel::Info, "Replaying %s: %lu Hz, %u channels, %s downmix, dialogue %s, %s pace", key_.file.c_str(), inRate, inCh,
+	         downmix.kernelName, DialogueFocus::ModeName(dialogue.Current()), key_.pace == ReplayPace::Fast ? "fast" : "realtime");
+	Opened(inRate, inCh, 10.0);
+	if (key_.pace == ReplayPace::Realtime && ApplyThreadSchedule(key_.schedule, key_.priority, 10.0, &schedule)) {
+		realtime_ = true;
+		AddonLog(LogLevel::Info, "Replay thread scheduled as MMCSS '%s' task", ThreadScheduleName(key_.schedule));
 	}
-	CloseHandle(hProcess);
-	return "";
-}
-
-// Enumerate ALL running processes (not just those with audio sessions)
-std::vector<DWORD> EnumerateAllProcesses() {
-	std::vector<DWORD> allPids;
-
-	HANDLE hSnapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-	if (hSnapshot == INVALID_HANDLE_VALUE) return allPids;
 
-	PROCESSENTRY32 pe32;
-	pe32.dwSize = sizeof(PROCESSENTRY32);
+	ReplayPacer pacer;
+	pacer.Start(inRate, key_.pace, DeviceClockNs());
+	const uint64_t tailFrames = (uint64_t)inRate * kReplayTailMs / 1000;
+	uint64_t frames = 0;  // replayed, tail included
+	uint64_t fileEnd = 0; // frames when the file ran out
+	bool fileDone = false;
+	bool wasSilent = false;
+	while (!stop_) {
+		for (uint32_t ms; !stop_ && (ms = pacer.WaitMs(frames)) > 0;) WaitForSingleObject(wake_, ms);
+		if (generation_.load(std::memory_order_acquire) != seen_) Refresh(&active, scratch.maxOutFrames);
+		while (!stop_ && key_.pace == ReplayPace::Fast &&
+		       std::any_of(active.begin(), active.end(), [](WasapiLoopbackCapture* sink) { return sink->Backlogged(); })) {
+			WaitForSingleObject(wake_, 1);
+			if (generation_.load(std::memory_order_acquire) != seen_) Refresh(&active, scratch.maxOutFrames);
+		}
+		if (stop_) break;
 
-	if (Process32First(hSnapshot, &pe32)) {
-		do {
-			// Filter out system processes and our own process
-			if (pe32.th32ProcessID != 0 && pe32.th32ProcessID != 4 && pe32.th32ProcessID != GetCurrentProcessId()) {
-				// Only include processes we can open (have permission to)
-				HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pe32.th32ProcessID);
-				if (hProcess) {
-					CloseHandle(hProcess);
-					allPids.push_back(pe32.th32ProcessID);
-				}
+		size_t n = fileDone ? 0 : source.Read(block.data());
+		if (n == 0 && !fileDone) {
+			fileDone = true;
+			fileEnd = frames;
+			AddonLog(LogLevel::Info, "File replay reached the end after %.1f s", (double)frames / inRate);
+		}
+		const bool silent = n == 0;
+		StageClock clock;
+		float* resampled = scratch.resampled.data();
+		size_t outLen;
+		resampler.Follow(WantLightResampler(active));
+		if (silent) {
+			if (frames - fileEnd >= tailFrames) break;
+			if (!wasSilent) {
+				resampler.Reset();
+				dialogue.Reset();
 			}
-		} while (Process32Next(hSnapshot, &pe32));
+			n = blockFrames;
+			outLen = scratch.Silence(n, inRate, outRate, 0);
+		} else if (swr.Active()) {
+			outLen = swr.Process(block.data(), n, resampled, scratch.resampled.size());
+		} else {
+			dialogue.Run(downmix, block.data(), n, scratch.mono.data());
+			outLen = resampler.Process(scratch.mono.data(), n, resampled);
+		}
+		const uint64_t frontNs = silent ? 0 : clock.Lap(&convert_);
+		inputFrames_.fetch_add(n, std::memory_order_relaxed);
+		const uint64_t timeNs = pacer.TimeNs(frames);
+		frames += n;
+		wasSilent = silent;
+		if (outLen == 0) continue;
+		for (size_t i = 0; i < active.size(); ++i) {
+			active[i]->Process(resampled, outLen, 1, timeNs, frontNs, i + 1 == active.size(), false, silent, false);
+		}
 	}
 
-	CloseHandle(hSnapshot);
-	return allPids;
+	if (!stop_) {
+		// Captures that attached after the last block still end with the file
+		if (generation_.load(std::memory_order_acquire) != seen_) Refresh(&active, scratch.maxOutFrames);
+		for (WasapiLoopbackCapture* sink : active) sink->EndOfInput();
+	}
+	RevertThreadSchedule(&schedule);
+	FinishAll(active);
 }
 
-// Enumerate active audio sessions and find PIDs with active audio
-std::vector<DWORD> EnumerateActiveAudioSessions() {
-	std::vector<DWORD> activePids;
-
-	HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
-	if (FAILED(hr)) return activePids;
-
-	ComPtr<IMMDeviceEnumerator> deviceEnumerator;
-	hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&deviceEnumerator));
-	if (FAILED(hr)) {
-		CoUninitialize();
-		return activePids;
+// One render endpoint of a mixed loopback (RunMixed): its own polled client
+// and front end, placed on the mix's timeline by its packets' timestamps.
+struct MixInput {
+	std::string needle; // option 'outputDevice' entry
+	ComPtr<IAudioClient> client;
+	ComPtr<IAudioCaptureClient> cap;
+	WAVEFORMATEX* pwfx = nullptr;
+	DownmixPlan downmix;
+	DialogueFocus dialogue;
+	FrontResampler resampler;
+	RealtimeVector<float> mono;
+	RealtimeVector<float> resampled;
+	bool wasSilent = true;
+	ULONGLONG retryAtMs = 0; // while closed: when to look for the endpoint again
+
+	~MixInput() { Close(); }
+
+	bool Open(IMMDeviceEnumerator* enumr, ResamplerQuality quality, bool focus) {
+		ComPtr<IMMDevice> device;
+		HRESULT hr = FindAudioEndpoint(enumr, eRender, eConsole, needle, &device);
+		if (SUCCEEDED(hr)) hr = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr, (void**)client.GetAddressOf());
+		if (SUCCEEDED(hr)) hr = client->GetMixFormat(&pwfx);
+		if (SUCCEEDED(hr)) hr = client->Initialize(AUDCLNT_SHAREMODE_SHARED, AUDCLNT_STREAMFLAGS_LOOPBACK, kMixBufferHns, 0, pwfx, nullptr);
+		if (SUCCEEDED(hr)) hr = client->GetService(IID_PPV_ARGS(&cap));
+		DWORD channelMask = 0;
+		if (SUCCEEDED(hr) && !DownmixPlanForFormat(pwfx, &downmix, &channelMask)) hr = AUDCLNT_E_UNSUPPORTED_FORMAT;
+		UINT32 bufferFrames = 0;
+		if (SUCCEEDED(hr)) hr = client->GetBufferSize(&bufferFrames);
+		if (SUCCEEDED(hr)) hr = client->Start();
+		if (FAILED(hr)) {
+			AddonLog(LogLevel::Warn, "Mixed loopback: render endpoint '%s' unavailable: 0x%08lx", needle.c_str(), hr);
+			Close();
+			return false;
+		}
+		// Packets never exceed the endpoint buffer size
+		const uint32_t inRate = pwfx->nSamplesPerSec;
+		resampler.Configure(inRate, 16000, quality, bufferFrames);
+		dialogue.Configure(focus, &downmix, channelMask, inRate);
+		mono.resize(bufferFrames);
+		resampled.resize((size_t)((double)bufferFrames * 16000.0 / inRate) + 2);
+		wasSilent = true;
+		AddonLog(LogLevel::Info, "Mixed loopback: '%s' open, %lu Hz, %u channels, %s downmix, dialogue %s", needle.c_str(), inRate,
+		         pwfx->nChannels, downmix.kernelName, DialogueFocus::ModeName(dialogue.Current()));
+		return true;
 	}
 
-	ComPtr<IMMDevice> device;
-	hr = deviceEnumerator->GetDefaultAudioEndpoint(eRender, eConsole, &device);
-	if (FAILED(hr)) {
-		CoUninitialize();
-		return activePids;
+	void Close() {
+		if (client) client->Stop();
+		cap.Reset();
+		client.Reset();
+		if (pwfx) CoTaskMemFree(pwfx);
+		pwfx = nullptr;
 	}
+};
 
-	ComPtr<IAudioSessionManager2> sessionManager;
-	hr = device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL, nullptr, (void**)&sessionManager);
+// Every endpoint's client is polled each kMixPollMs; its packets are
+// converted to 16 kHz mono on their own and summed by EndpointMixer at their
+// capture time, and the captures get the mix kMixDelayMs behind the clock,
+// on the same QPC timeline as a single client's blocks. An endpoint that is
+// missing or goes away leaves a hole in the mix (silence if it was the only
+// one playing) and is looked for again every kMixRetryMs; the captures only
+// end with stop().
+void LoopbackEndpoint::RunMixed() {
+	std::vector<WasapiLoopbackCapture*> active;
+	inputFrames_ = 0;
+	convert_.Reset();
+	ThreadScheduleState schedule;
+	realtime_ = false;
+	processLoopback_ = false;
+	seen_ = ~0ull;
+	HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	if (FAILED(hr)) { AddonLog(LogLevel::Error, "CoInitializeEx failed: 0x%08lx", hr); FinishAll(active); return; }
+	ComPtr<IMMDeviceEnumerator> enumr;
+	hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, IID_PPV_ARGS(&enumr));
 	if (FAILED(hr)) {
+		AddonLog(LogLevel::Error, "Create MMDeviceEnumerator failed: 0x%08lx", hr);
+		FinishAll(active);
 		CoUninitialize();
-		return activePids;
+		return;
 	}
 
-	ComPtr<IAudioSessionEnumerator> sessionEnumerator;
-	hr = sessionManager->GetSessionEnumerator(&sessionEnumerator);
-	if (FAILED(hr)) {
-		CoUninitialize();
-		return activePids;
+	std::vector<std::unique_ptr<MixInput>> inputs;
+	uint32_t open = 0;
+	for (const std::string& needle : key_.outputDevices) {
+		inputs.push_back(std::make_unique<MixInput>());
+		inputs.back()->needle = needle;
+		if (inputs.back()->Open(enumr.Get(), key_.resampler)) ++open;
+		else inputs.back()->retryAtMs = GetTickCount64() + kMixRetryMs;
 	}
-
-	int sessionCount;
-	hr = sessionEnumerator->GetCount(&sessionCount);
-	if (FAILED(hr)) {
+	if (open == 0) {
+		AddonLog(LogLevel::Error, "Mixed loopback: none of the %zu render endpoints opened", inputs.size());
+		inputs.clear();
+		FinishAll(active);
 		CoUninitialize();
-		return activePids;
+		return;
+	}
+	mixedEndpoints_.store(open, std::memory_order_relaxed);
+	mixLate_.store(0, std::memory_order_relaxed);
+	Opened(16000, 1, kMixPollMs);
+	if (ApplyThreadSchedule(key_.schedule, key_.priority, kMixPollMs, &schedule)) {
+		realtime_ = true;
+		AddonLog(LogLevel::Info, "Mixing thread scheduled as MMCSS '%s' task", ThreadScheduleName(key_.schedule));
 	}
 
-	for (int i = 0; i < sessionCount; i++) {
-		ComPtr<IAudioSessionControl> sessionControl;
-		hr = sessionEnumerator->GetSession(i, &sessionControl);
-		if (FAILED(hr)) continue;
-
-		ComPtr<IAudioSessionControl2> sessionControl2;
-		hr = sessionControl.As(&sessionControl2);
-		if (FAILED(hr)) continue;
-
-		// Get PID - don't filter by state so we show ALL apps that have audio sessions
-		// This includes inactive apps so user can select them before they start playing
-		DWORD pid;
-		hr = sessionControl2->GetProcessId(&pid);
-		if (FAILED(hr) || pid == 0) continue;
-
-		activePids.push_back(pid);
+	// The timeline counts 16 kHz samples from here; the ring holds a second
+	EndpointMixer mixer;
+	mixer.Configure(inputs.size(), kMixDelayMs * 16, 16000);
+	RealtimeVector<float> block(kMixBlockSamples);
+	const uint64_t startNs = DeviceClockNs();
+	auto sampleAt = [startNs](uint64_t ns) { return ((int64_t)ns - (int64_t)startNs) * 16 / 1000000; };
+
+	while (!stop_) {
+		WaitForSingleObject(wake_, kMixPollMs);
+		if (generation_.load(std::memory_order_acquire) != seen_) Refresh(&active, kMixBlockSamples);
+		const bool light = WantLightResampler(active);
+		const ULONGLONG nowMs = GetTickCount64();
+		for (size_t input = 0; input < inputs.size(); ++input) {
+			MixInput& in = *inputs[input];
+			if (!in.cap) {
+				if (nowMs < in.retryAtMs) continue;
+				if (!in.Open(enumr.Get(), key_.resampler, key_.dialogue)) {
+					in.retryAtMs = nowMs + kMixRetryMs;
+					continue;
+				}
+				mixedEndpoints_.fetch_add(1, std::memory_order_relaxed);
+			}
+			in.resampler.Follow(light);
+			for (;;) {
+				UINT32 packet = 0;
+				hr = in.cap->GetNextPacketSize(&packet);
+				if (FAILED(hr) || packet == 0) break;
+				BYTE* pData = nullptr;
+				UINT32 frames = 0;
+				DWORD capFlags = 0;
+				UINT64 qpc = 0; // 100 ns units
+				hr = in.cap->GetBuffer(&pData, &frames, &capFlags, nullptr, &qpc);
+				if (FAILED(hr)) break;
+				const bool silent = (capFlags & AUDCLNT_BUFFERFLAGS_SILENT) != 0;
+				if (capFlags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) mixer.Gap(input);
+				if (silent) {
+					// Nothing to add: the ring is silent where no endpoint played
+					if (!in.wasSilent) {
+						in.resampler.Reset();
+						in.dialogue.Reset();
+						mixer.Gap(input);
+					}
+				} else if (frames > 0) {
+					StageClock clock;
+					in.dialogue.Run(in.downmix, pData, frames, in.mono.data());
+					const size_t n = in.resampler.Process(in.mono.data(), frames, in.resampled.data());
+					clock.Lap(&convert_);
+					mixer.Add(input, sampleAt(qpc * 100), in.resampled.data(), n);
+				}
+				in.cap->ReleaseBuffer(frames);
+				inputFrames_.fetch_add(frames, std::memory_order_relaxed);
+				in.wasSilent = silent;
+			}
+			if (DeviceLost(hr)) {
+				AddonLog(LogLevel::Warn, "Mixed loopback: render endpoint '%s' went away; looking for it again", in.needle.c_str());
+				in.Close();
+				in.retryAtMs = nowMs + kMixRetryMs;
+				mixer.Gap(input);
+				mixedEndpoints_.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+		mixLate_.store(mixer.LateSamples(), std::memory_order_relaxed);
+
+		// Everything up to the delay is in; the last capture may process it in place
+		const int64_t now = sampleAt(DeviceClockNs());
+		bool silent = false;
+		for (size_t n; !stop_ && (n = mixer.Read(now, block.data(), block.size(), &silent)) > 0;) {
+			const uint64_t timeNs = startNs + (uint64_t)(mixer.Position() - (int64_t)n) * 1000000 / 16;
+			for (size_t i = 0; i < active.size(); ++i) {
+				active[i]->Process(block.data(), n, 1, timeNs, 0, i + 1 == active.size(), false, silent, false);
+			}
+		}
 	}
 
+	inputs.clear();
+	enumr.Reset();
+	mixedEndpoints_.store(0, std::memory_order_relaxed);
+	RevertThreadSchedule(&schedule);
+	FinishAll(active);
 	CoUninitialize();
-	return activePids;
 }
 
-// Find the PID for a given process name from ALL running processes (not just those with active audio)
-DWORD FindPidForProcess(const std::string& processName) {
-	std::vector<DWORD> allPids = EnumerateAllProcesses();
-
-	// First, try to find exact matches
-	for (DWORD pid : allPids) {
-		std::string name = GetProcessName(pid);
-		if (_stricmp(name.c_str(), processName.c_str()) == 0) {
-			printf("[addon] Found exact match for '%s': PID %lu\n", processName.c_str(), pid);
-			fflush(stdout);
-			return pid;
+// Initializes a shared-mode loopback stream for the requested latency mode and
+// reports the wake-up period. Lowest uses the minimum engine period when the
+// endpoint supports it (client3 set), otherwise falls back to the default period.
+HRESULT InitializeLoopbackStream(IAudioClient* client, IAudioClient3* client3, DWORD streamFlags,
+                                 const WAVEFORMATEX* pwfx, LatencyMode mode, double* periodMs) {
+	if (mode == LatencyMode::Lowest && client3) {
+		UINT32 defaultFrames = 0, fundamentalFrames = 0, minFrames = 0, maxFrames = 0;
+		HRESULT hr = client3->GetSharedModeEnginePeriod(pwfx, &defaultFrames, &fundamentalFrames, &minFrames, &maxFrames);
+		if (SUCCEEDED(hr) && minFrames > 0) {
+			hr = client3->InitializeSharedAudioStream(streamFlags, minFrames, pwfx, nullptr);
+			if (SUCCEEDED(hr)) {
+				*periodMs = 1000.0 * minFrames / pwfx->nSamplesPerSec;
+				AddonLog(LogLevel::Info, "Low-latency stream: %u-frame period (%.2f ms, default %u)", minFrames, *periodMs, defaultFrames);
+				return hr;
+			}
 		}
+		AddonLog(LogLevel::Warn, "Minimum engine period unavailable (0x%08lx), using the default period", hr);
 	}
 
-	// If no exact match, try partial matches (e.g., "chrome" matches "chrome.exe")
-	std::string baseName = processName;
-	size_t dotPos = baseName.find('.');
-	if (dotPos != std::string::npos) {
-		baseName = baseName.substr(0, dotPos);
+	REFERENCE_TIME bufferDuration = mode == LatencyMode::PowerSave ? kPowerSaveBufferHns : 0;
+	HRESULT hr = client->Initialize(AUDCLNT_SHAREMODE_SHARED, streamFlags, bufferDuration, 0, pwfx, nullptr);
+	if (FAILED(hr)) return hr;
+	if (mode == LatencyMode::PowerSave) {
+		*periodMs = kPowerSavePollMs;
+	} else {
+		REFERENCE_TIME defaultPeriod = 0, minPeriod = 0;
+		if (SUCCEEDED(client->GetDevicePeriod(&defaultPeriod, &minPeriod)) && defaultPeriod > 0) *periodMs = defaultPeriod / 10000.0;
 	}
+	return hr;
+}
 
-	for (DWORD pid : allPids) {
-		std::string name = GetProcessName(pid);
-		std::string nameBase = name;
-		dotPos = nameBase.find('.');
-		if (dotPos != std::string::npos) {
-			nameBase = nameBase.substr(0, dotPos);
-		}
+// Completion handler for ActivateAudioInterfaceAsync; agile, since the
+// activation completes on an MTA worker thread.
+class ActivationCompletion : public Microsoft::WRL::RuntimeClass<
+	Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+	Microsoft::WRL::FtmBase, IActivateAudioInterfaceCompletionHandler> {
+public:
+	ActivationCompletion() { done_ = CreateEvent(nullptr, TRUE, FALSE, nullptr); }
+	~ActivationCompletion() { if (done_) CloseHandle(done_); }
+	HANDLE Done() const { return done_; }
+	STDMETHOD(ActivateCompleted)(IActivateAudioInterfaceAsyncOperation*) override {
+		SetEvent(done_);
+		return S_OK;
+	}
 
-		if (_stricmp(nameBase.c_str(), baseName.c_str()) == 0) {
-			printf("[addon] Found partial match for '%s': PID %lu (%s)\n", processName.c_str(), pid, name.c_str());
-			fflush(stdout);
-			return pid;
-		}
+private:
+	HANDLE done_ = nullptr;
+};
+
+// Activates a loopback client for pid's process tree, or for everything but
+// that tree with the exclude mode (Windows 10 2004+). Fails
+// on older systems, which callers treat as "use the endpoint's full mix".
+HRESULT ActivateProcessLoopback(DWORD pid, PROCESS_LOOPBACK_MODE mode, IAudioClient** client) {
+	AUDIOCLIENT_ACTIVATION_PARAMS params = {};
+	params.ActivationType = AUDIOCLIENT_ACTIVATION_TYPE_PROCESS_LOOPBACK;
+	params.ProcessLoopbackParams.TargetProcessId = pid;
+	params.ProcessLoopbackParams.ProcessLoopbackMode = mode;
+	PROPVARIANT activation = {};
+	activation.vt = VT_BLOB;
+	activation.blob.cbSize = sizeof(params);
+	activation.blob.pBlobData = reinterpret_cast<BYTE*>(&params);
+
+	ComPtr<ActivationCompletion> completion = Microsoft::WRL::Make<ActivationCompletion>();
+	if (!completion || !completion->Done()) return E_OUTOFMEMORY;
+	ComPtr<IActivateAudioInterfaceAsyncOperation> operation;
+	HRESULT hr = ActivateAudioInterfaceAsync(VIRTUAL_AUDIO_DEVICE_PROCESS_LOOPBACK, __uuidof(IAudioClient),
+	                                         &activation, completion.Get(), &operation);
+	if (FAILED(hr)) return hr;
+	if (WaitForSingleObject(completion->Done(), kActivationTimeoutMs) != WAIT_OBJECT_0) return HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+
+	HRESULT activateHr = E_FAIL;
+	ComPtr<IUnknown> activated;
+	hr = operation->GetActivateResult(&activateHr, &activated);
+	if (FAILED(hr)) return hr;
+	if (FAILED(activateHr)) return activateHr;
+	return activated->QueryInterface(IID_PPV_ARGS(client));
+}
+
+// Picks the downmix kernel for the engine mix format. WAVE_FORMAT_EXTENSIBLE
+// distinguishes 24-bit samples in 32-bit containers from true 32-bit PCM.
+// channelMaskOut, if given, receives the speaker mask (0 = the usual layout).
+bool DownmixPlanForFormat(const WAVEFORMATEX* wfx, DownmixPlan* plan, DWORD* channelMaskOut) {
+	bool isFloat = wfx->wFormatTag == WAVE_FORMAT_IEEE_FLOAT;
+	bool isPcm = wfx->wFormatTag == WAVE_FORMAT_PCM;
+	WORD validBits = wfx->wBitsPerSample;
+	DWORD channelMask = 0;
+	if (wfx->wFormatTag == WAVE_FORMAT_EXTENSIBLE && wfx->cbSize >= 22) {
+		const WAVEFORMATEXTENSIBLE* ext = reinterpret_cast<const WAVEFORMATEXTENSIBLE*>(wfx);
+		isFloat = ext->SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT;
+		isPcm = ext->SubFormat == KSDATAFORMAT_SUBTYPE_PCM;
+		if (ext->Samples.wValidBitsPerSample) validBits = ext->Samples.wValidBitsPerSample;
+		channelMask = ext->dwChannelMask;
 	}
 
-	printf("[addon] No process found matching '%s'\n", processName.c_str());
-	fflush(stdout);
-	return 0;
+	PcmSampleType type;
+	if (isFloat && wfx->wBitsPerSample == 32) type = PcmSampleType::Float32;
+	else if (isPcm && wfx->wBitsPerSample == 16) type = PcmSampleType::Int16;
+	else if (isPcm && wfx->wBitsPerSample == 24) type = PcmSampleType::Int24Packed;
+	else if (isPcm && wfx->wBitsPerSample == 32) type = validBits == 24 ? PcmSampleType::Int24In32 : PcmSampleType::Int32;
+	else return false;
+
+	*plan = MakeDownmixPlan(type, wfx->nChannels, channelMask);
+	if (channelMaskOut) *channelMaskOut = channelMask;
+	return true;
 }
 
-// Find the best PID for a given process name (e.g., "chrome.exe") - ONLY from active audio sessions
-DWORD FindActiveAudioPidForProcess(const std::string& processName) {
-	std::vector<DWORD> activePids = EnumerateActiveAudioSessions();
+// PIDs with a session on the default render device, active or not, so apps
+// can be picked before they start playing. Runs on the COM control thread.
+std::vector<DWORD> EnumerateActiveAudioSessions() {
+	std::vector<DWORD> activePids;
+	RunComControl([&activePids] {
+		IMMDeviceEnumerator* deviceEnumerator = ComControlEnumerator();
+		if (!deviceEnumerator) return;
 
-	// First, try to find exact matches
-	for (DWORD pid : activePids) {
-		std::string name = GetProcessName(pid);
-		if (_stricmp(name.c_str(), processName.c_str()) == 0) {
-			return pid;
-		}
-	}
+		ComPtr<IMMDevice> device;
+		HRESULT hr = deviceEnumerator->GetDefaultAudioEndpoint(eRender, eConsole, &device);
+		if (FAILED(hr)) return;
 
-	// If no exact match, try partial matches (e.g., "chrome" matches "chrome.exe")
-	std::string baseName = processName;
-	size_t dotPos = baseName.find('.');
-	if (dotPos != std::string::npos) {
-		baseName = baseName.substr(0, dotPos);
-	}
+		ComPtr<IAudioSessionManager2> sessionManager;
+		hr = device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_ALL, nullptr, (void**)&sessionManager);
+		if (FAILED(hr)) return;
 
-	for (DWORD pid : activePids) {
-		std::string name = GetProcessName(pid);
-		std::string nameBase = name;
-		dotPos = nameBase.find('.');
-		if (dotPos != std::string::npos) {
-			nameBase = nameBase.substr(0, dotPos);
-		}
+		ComPtr<IAudioSessionEnumerator> sessionEnumerator;
+		hr = sessionManager->GetSessionEnumerator(&sessionEnumerator);
+		if (FAILED(hr)) return;
+
+		int sessionCount;
+		hr = sessionEnumerator->GetCount(&sessionCount);
+		if (FAILED(hr)) return;
+
+		for (int i = 0; i < sessionCount; i++) {
+			ComPtr<IAudioSessionControl> sessionControl;
+			hr = sessionEnumerator->GetSession(i, &sessionControl);
+			if (FAILED(hr)) continue;
+
+			ComPtr<IAudioSessionControl2> sessionControl2;
+			hr = sessionControl.As(&sessionControl2);
+			if (FAILED(hr)) continue;
 
-		if (_stricmp(nameBase.c_str(), baseName.c_str()) == 0) {
-			return pid;
+			DWORD pid;
+			hr = sessionControl2->GetProcessId(&pid);
+			if (FAILED(hr) || pid == 0) continue;
+
+			activePids.push_back(pid);
 		}
+	});
+	return activePids;
+}
+
+// PIDs with an audio session on the default render device: read from the
+// session registry when it's running, otherwise enumerated once.
+std::vector<DWORD> AudioSessionPids() {
+	const SessionTable& sessions = AudioSessionTable();
+	if (!sessions.Running()) return EnumerateActiveAudioSessions();
+	std::vector<DWORD> pids;
+	for (const AudioSessionRow& row : sessions.Rows()) pids.push_back(row.pid);
+	return pids;
+}
+
+// The process tree a name should capture, from ALL running processes (not
+// just those with active audio): the root of the tree whose descendants own
+// an audio session, so process loopback covers the app's helpers too, or the
+// first match's root when none is playing yet.
+ProcessSnapshot::AudioTree FindAudioTreeForProcess(const std::string& processName) {
+	ProcessSnapshot snapshot;
+	bool exact = false;
+	const std::vector<size_t>* matches = snapshot.Matches(processName, &exact);
+	if (!matches) {
+		AddonLog(LogLevel::Warn, "No process found matching '%s'", processName.c_str());
+		return {};
+	}
+	const ProcessSnapshot::AudioTree tree = snapshot.ResolveAudioTree(*matches, AudioSessionPids());
+	const std::string& rootName = snapshot.NameOf(tree.root);
+	if (tree.audioPid) {
+		AddonLog(LogLevel::Info, "Found %s match for '%s': tree root %lu (%s), audio session PID %lu (%s)",
+			exact ? "exact" : "partial", processName.c_str(), tree.root, rootName.c_str(), tree.audioPid, snapshot.NameOf(tree.audioPid).c_str());
+	} else {
+		AddonLog(LogLevel::Info, "Found %s match for '%s': tree root %lu (%s), no audio session yet",
+			exact ? "exact" : "partial", processName.c_str(), tree.root, rootName.c_str());
 	}
+	return tree;
+}
 
-	return 0;
+DWORD FindPidForProcess(const std::string& processName) {
+	return FindAudioTreeForProcess(processName).root;
 }
 
-// N-API function to enumerate all processes (for app selection)
-Napi::Value EnumerateAudioSessions(const Napi::CallbackInfo& info) {
-	Napi::Env env = info.Env();
+// Find the best PID for a given process name (e.g., "chrome.exe") - ONLY from
+// active audio sessions: the session-owning process in the app's tree, which
+// may have another name (msedgewebview2.exe under ms-teams.exe)
+DWORD FindActiveAudioPidForProcess(const std::string& processName) {
+	std::vector<DWORD> activePids = AudioSessionPids();
+	if (activePids.empty()) return 0;
+	ProcessSnapshot snapshot;
+	bool exact = false;
+	const std::vector<size_t>* matches = snapshot.Matches(processName, &exact);
+	if (!matches) return 0;
+	return snapshot.ResolveAudioTree(*matches, activePids).audioPid;
+}
 
+// All processes (for app selection), marked with whether they have an audio
+// session. Plain data, so it can run on a worker thread.
+std::vector<AudioSessionRow> CollectAudioSessions() {
 	// Get all running processes
-	std::vector<DWORD> allPids = EnumerateAllProcesses();
+	ProcessSnapshot snapshot;
 
 	// Get processes with active audio sessions for marking
-	std::vector<DWORD> activePids = EnumerateActiveAudioSessions();
-	std::map<DWORD, bool> hasAudioSession;
+	std::vector<DWORD> activePids = AudioSessionPids();
+	std::unordered_map<DWORD, bool> hasAudioSession;
 	for (DWORD pid : activePids) {
 		hasAudioSession[pid] = true;
 	}
 
-	Napi::Array result = Napi::Array::New(env);
-	size_t resultIndex = 0;
-
-	for (DWORD pid : allPids) {
-		std::string processName = GetProcessName(pid);
-		// Filter out empty process names and system processes
-		if (processName.empty()) continue;
+	std::vector<AudioSessionRow> rows;
+	rows.reserve(snapshot.Entries().size());
+	for (const ProcessSnapshot::Entry& entry : snapshot.Entries()) {
+		const std::string& processName = entry.name;
 
 		// Filter out common system/background processes that users won't want to capture
 		if (processName == "svchost.exe" ||
@@ -587,14 +2223,19 @@ Napi::Value EnumerateAudioSessions(const Napi::CallbackInfo& info) {
 			continue;
 		}
 
-		Napi::Object session = Napi::Object::New(env);
-		session.Set("pid", Napi::Number::New(env, pid));
-		session.Set("processName", Napi::String::New(env, processName));
-		session.Set("hasActiveAudio", Napi::Boolean::New(env, hasAudioSession.count(pid) > 0));
-		result[resultIndex++] = session;
+		rows.push_back(AudioSessionRow{ entry.pid, processName, hasAudioSession.count(entry.pid) > 0 });
 	}
+	return rows;
+}
 
-	return result;
+// N-API function to enumerate all processes (for app selection)
+Napi::Value EnumerateAudioSessions(const Napi::CallbackInfo& info) {
+	return AudioSessionRowsToJs(info.Env(), CollectAudioSessions());
+}
+
+// enumerateAudioSessionsAsync() -> Promise of the same array, built on the threadpool
+Napi::Value EnumerateAudioSessionsAsync(const Napi::CallbackInfo& info) {
+	return QueueQuery(info.Env(), "EnumerateAudioSessions", CollectAudioSessions, AudioSessionRowsToJs, TaskPriority::Interactive);
 }
 
 // N-API function to find active audio PID for a process
@@ -611,59 +2252,109 @@ Napi::Value FindAudioPidForProcess(const Napi::CallbackInfo& info) {
 	return Napi::Number::New(env, pid);
 }
 
-// N-API function to start capture by process name (resolves PID internally)
-Napi::Value StartCaptureByProcessName(const Napi::CallbackInfo& info) {
+// findAudioPidForProcessAsync(name) -> Promise<number>
+Napi::Value FindAudioPidForProcessAsync(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsString()) {
+		Napi::TypeError::New(env, "Process name required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	std::string processName = info[0].As<Napi::String>().Utf8Value();
+	return QueueQuery(env, "FindAudioPidForProcess",
+		[processName] { return FindActiveAudioPidForProcess(processName); },
+		[](Napi::Env env, DWORD pid) { return Napi::Number::New(env, pid); }, TaskPriority::Interactive);
+}
+
+// Arguments shared by startCaptureByProcessName and its async variant:
+// (processName, callback, options?). Empty name means system-wide.
+bool ReadStartByNameArgs(const Napi::CallbackInfo& info, std::string* processName, PcmTsfn* tsfn, CaptureOptions* options) {
 	Napi::Env env = info.Env();
 	if (info.Length() < 2) {
 		Napi::TypeError::New(env, "Process name and callback required").ThrowAsJavaScriptException();
-		return env.Null();
+		return false;
 	}
 
-	std::string processName;
 	if (info[0].IsString()) {
-		processName = info[0].As<Napi::String>().Utf8Value();
+		*processName = info[0].As<Napi::String>().Utf8Value();
 	}
 
 	if (!info[1].IsFunction()) {
 		Napi::TypeError::New(env, "Callback required").ThrowAsJavaScriptException();
-		return env.Null();
+		return false;
 	}
 
-	Napi::Function cb = info[1].As<Napi::Function>();
-	auto tsfn = Napi::ThreadSafeFunction::New(env, cb, "PCMCallback", 0, 1);
+	if (!ReadCaptureOptionsArg(info, 2, options)) return false;
 
-	DWORD pid = 0;
-	if (!processName.empty()) {
-		printf("[addon] StartCaptureByProcessName: Looking for process '%s'\n", processName.c_str());
-		fflush(stdout);
+	*tsfn = CreatePcmTsfn(env, info[1].As<Napi::Function>(), options->ChannelConfig(16000));
+	return true;
+}
+
+// PID lookup half of startCaptureByProcessName; safe on a worker thread.
+DWORD ResolveCapturePid(const std::string& processName) {
+	if (processName.empty()) return 0;
+	AddonLog(LogLevel::Info, "StartCaptureByProcessName: Looking for process '%s'", processName.c_str());
+	// Use FindPidForProcess to search ALL processes, not just those with active audio
+	return FindPidForProcess(processName);
+}
+
+// The environment's default capture. Called once the capture's tsfn exists, so
+// the capture stops at teardown before Node closes the tsfn.
+WasapiLoopbackCapture& DefaultCapture(Napi::Env env) {
+	std::unique_ptr<WasapiLoopbackCapture>& capture = PerEnv<LoopbackAddon>(env).capture;
+	if (!capture) capture = std::make_unique<WasapiLoopbackCapture>();
+	ArmTeardown(env);
+	return *capture;
+}
 
-		// Use FindPidForProcess to search ALL processes, not just those with active audio
-		pid = FindPidForProcess(processName);
+// JS thread half: starts capture on the resolved PID, or throws when the named process wasn't found.
+Napi::Value StartResolvedCapture(Napi::Env env, const std::string& processName, DWORD pid, PcmTsfn tsfn, const CaptureOptions& options) {
+	if (!processName.empty()) {
 		if (pid == 0) {
 			tsfn.Release();
-			printf("[addon] StartCaptureByProcessName: Process '%s' not found\n", processName.c_str());
-			fflush(stdout);
+			AddonLog(LogLevel::Warn, "StartCaptureByProcessName: Process '%s' not found", processName.c_str());
 			Napi::Error::New(env, "Process not found: " + processName).ThrowAsJavaScriptException();
 			return env.Null();
 		}
 
-		printf("[addon] StartCaptureByProcessName: Found process '%s' with PID %lu, starting capture...\n", processName.c_str(), pid);
-		fflush(stdout);
+		AddonLog(LogLevel::Info, "StartCaptureByProcessName: Found process '%s' with PID %lu, starting capture...", processName.c_str(), pid);
 	}
 
-	if (!g_capture) g_capture = std::make_unique<WasapiLoopbackCapture>();
-	bool ok = g_capture->Start(pid, tsfn);
+	bool ok = DefaultCapture(env).Start(pid, tsfn, options);
 
 	if (ok) {
-		printf("[addon] StartCaptureByProcessName: Capture started successfully for PID %lu\n", pid);
+		AddonLog(LogLevel::Info, "StartCaptureByProcessName: Capture started successfully for PID %lu", pid);
 	} else {
-		printf("[addon] StartCaptureByProcessName: Failed to start capture for PID %lu\n", pid);
+		AddonLog(LogLevel::Error, "StartCaptureByProcessName: Failed to start capture for PID %lu", pid);
 	}
-	fflush(stdout);
 
 	return Napi::Boolean::New(env, ok);
 }
 
+// N-API function to start capture by process name (resolves PID internally)
+Napi::Value StartCaptureByProcessName(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::string processName;
+	PcmTsfn tsfn;
+	CaptureOptions options;
+	if (!ReadStartByNameArgs(info, &processName, &tsfn, &options)) return env.Null();
+	return StartResolvedCapture(env, processName, ResolveCapturePid(processName), tsfn, options);
+}
+
+// startCaptureByProcessNameAsync(name, callback, options?) -> Promise<boolean>;
+// the PID lookup runs on the threadpool, capture starts back on the JS thread.
+Napi::Value StartCaptureByProcessNameAsync(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	std::string processName;
+	PcmTsfn tsfn;
+	CaptureOptions options;
+	if (!ReadStartByNameArgs(info, &processName, &tsfn, &options)) return env.Null();
+	return QueueQuery(env, "StartCaptureByProcessName",
+		[processName] { return ResolveCapturePid(processName); },
+		[processName, tsfn, options](Napi::Env env, DWORD pid) {
+			return StartResolvedCapture(env, processName, pid, tsfn, options);
+		}, TaskPriority::Interactive);
+}
+
 // N-API glue
 Napi::Value StartCapture(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env();
@@ -675,61 +2366,350 @@ Napi::Value StartCapture(const Napi::CallbackInfo& info) {
 		Napi::TypeError::New(env, "Callback required").ThrowAsJavaScriptException();
 		return env.Null();
 	}
+	CaptureOptions options;
+	if (!ReadCaptureOptionsArg(info, 2, &options)) return env.Null();
 	Napi::Function cb = info[1].As<Napi::Function>();
-	auto tsfn = Napi::ThreadSafeFunction::New(env, cb, "PCMCallback", 0, 1);
-	if (!g_capture) g_capture = std::make_unique<WasapiLoopbackCapture>();
-	bool ok = g_capture->Start(pid, tsfn);
+	auto tsfn = CreatePcmTsfn(env, cb, options.ChannelConfig(16000));
+	bool ok = DefaultCapture(env).Start(pid, tsfn, options);
 	return Napi::Boolean::New(env, ok);
 }
 
 Napi::Value StopCapture(const Napi::CallbackInfo& info) {
-	if (g_capture) g_capture->Stop();
+	const std::unique_ptr<WasapiLoopbackCapture>& capture = PerEnv<LoopbackAddon>(info.Env()).capture;
+	if (capture) capture->Stop();
 	return info.Env().Undefined();
 }
 
-// N-API function to start capture with current process excluded
+// stopCaptureAsync() -> Promise<boolean>: stopCapture with the endpoint
+// thread join on the threadpool rather than the JS thread; resolves whether a
+// capture was running. The capture is handed to the pool, so the next startCapture gets a
+// fresh one and getStats() reads zeros until then.
+Napi::Value StopCaptureAsync(const Napi::CallbackInfo& info) {
+	return QueueQuery(info.Env(), "StopCaptureAsync",
+		[capture = std::move(PerEnv<LoopbackAddon>(info.Env()).capture)]() mutable {
+			const bool running = capture && capture->Running();
+			capture.reset(); // stops it
+			return running;
+		},
+		[](Napi::Env env, bool running) { return Napi::Boolean::New(env, running); }, TaskPriority::Interactive);
+}
+
+// N-API function retuning the utterance chunker's minimum chunk length while
+// capturing (the handlers lengthen it for languages that need more context)
+Napi::Value SetMinChunkMs(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsNumber()) {
+		Napi::TypeError::New(env, "Minimum chunk length (ms) required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	const std::unique_ptr<WasapiLoopbackCapture>& capture = PerEnv<LoopbackAddon>(env).capture;
+	if (capture) capture->SetMinChunkMs(info[0].As<Napi::Number>().Uint32Value());
+	return env.Undefined();
+}
+
+// Capture counters (packets processed, heap allocations made on the packet
+// path after init, discontinuities, silent packets and the silence skipped,
+// whether MMCSS took effect), the endpoint's format, period and frame count,
+// and p50/p99 stage times (timing.convert, .chain, .deliver) for telemetry to
+// sample; zeros before the first start.
+Napi::Object CaptureStatsToJs(Napi::Env env, const WasapiLoopbackCapture* capture) {
+	CaptureStats stats = capture ? capture->GetStats() : CaptureStats();
+	Napi::Object result = Napi::Object::New(env);
+	result.Set("packets", Napi::Number::New(env, (double)stats.packets));
+	result.Set("blocks", Napi::Number::New(env, (double)stats.blocks));
+	result.Set("steadyStateAllocations", Napi::Number::New(env, (double)stats.steadyStateAllocations));
+	result.Set("glitches", Napi::Number::New(env, (double)stats.glitches));
+	result.Set("silentPackets", Napi::Number::New(env, (double)stats.silentPackets));
+	result.Set("skippedMs", Napi::Number::New(env, (double)stats.skippedSamples / 16.0));
+	result.Set("realtime", Napi::Boolean::New(env, stats.realtime));
+	result.Set("filterGraphLatencyMs", Napi::Number::New(env, stats.filterGraphLatencyMs));
+	result.Set("processLoopback", Napi::Boolean::New(env, stats.processLoopback));
+	result.Set("selfExcluded", Napi::Boolean::New(env, stats.selfExcluded));
+	result.Set("engineConverted", Napi::Boolean::New(env, stats.engineConverted));
+	result.Set("endpointSessions", Napi::Number::New(env, stats.endpointSessions));
+	result.Set("echoReference", Napi::Boolean::New(env, stats.echoReference));
+	result.Set("echoErleDb", Napi::Number::New(env, stats.echoErleDb));
+	result.Set("echoDriftPpm", Napi::Number::New(env, stats.echoDriftPpm));
+	result.Set("inputFrames", Napi::Number::New(env, (double)stats.inputFrames));
+	result.Set("inputSampleRate", Napi::Number::New(env, stats.inputSampleRate));
+	result.Set("inputChannels", Napi::Number::New(env, stats.inputChannels));
+	result.Set("devicePeriodMs", Napi::Number::New(env, stats.devicePeriodMs));
+	result.Set("streamLatencyMs", Napi::Number::New(env, stats.streamLatencyMs));
+	result.Set("micRaw", Napi::Boolean::New(env, stats.micRaw));
+	result.Set("mixedEndpoints", Napi::Number::New(env, stats.mixedEndpoints));
+	result.Set("mixLateMs", Napi::Number::New(env, (double)stats.mixLateSamples / 16.0));
+	result.Set("outputSamples", Napi::Number::New(env, (double)stats.outputSamples));
+	result.Set("sourceSwitches", Napi::Number::New(env, (double)stats.sourceSwitches));
+	result.Set("stalls", CaptureWatchdogStatsToJs(env, stats.stalls));
+	Napi::Object timing = Napi::Object::New(env);
+	timing.Set("convert", LatencySummaryToJs(env, stats.convert));
+	timing.Set("chain", LatencySummaryToJs(env, stats.chain));
+	timing.Set("deliver", LatencySummaryToJs(env, stats.deliver));
+	result.Set("timing", timing);
+	if (stats.governed) result.Set("quality", QualityStatsToJs(env, stats.quality));
+	if (stats.recording) result.Set("record", RecorderStatsToJs(env, stats.record));
+	result.Set("threads", ThreadCpuToJs(env)); // process-wide, not just this capture's
+	result.Set("models", ModelFootprintToJs(env)); // likewise
+	result.Set("neuralVad", NeuralVadStatsToJs(env)); // the batcher all captures share
+	result.Set("memory", MemoryStatsToJs(env)); // process-wide too
+	result.Set("pool", TaskPoolStatsToJs(env)); // the addon's task pool
+	result.Set("isa", CpuIsaToJs(env)); // process-wide too
+	result.Set("delivery", DeliveryStatsToJs(env, stats.delivery));
+	return result;
+}
+
+// N-API function returning the default capture's counters
+Napi::Value GetStats(const Napi::CallbackInfo& info) {
+	return CaptureStatsToJs(info.Env(), PerEnv<LoopbackAddon>(info.Env()).capture.get());
+}
+
+// getHistory(fromMs, toMs) on the default capture (capture_history.h)
+Napi::Value GetHistory(const Napi::CallbackInfo& info) {
+	const std::unique_ptr<WasapiLoopbackCapture>& capture = PerEnv<LoopbackAddon>(info.Env()).capture;
+	return QueueHistoryQuery(info, capture ? capture->History() : nullptr);
+}
+
+// deviceClockMs() -> now on the clock of captureTimeMs (option 'timestamps'):
+// QPC, which IAudioCaptureClient::GetBuffer reports capture positions on
+Napi::Value DeviceClockMs(const Napi::CallbackInfo& info) {
+	return Napi::Number::New(info.Env(), DeviceClockNs() / 1e6);
+}
+
+// Active render and capture endpoints, for option 'outputDevice' /
+// 'inputDevice'; empty when COM or the enumerator fails. Control thread.
+std::vector<AudioEndpointInfo> CollectAudioEndpoints() {
+	std::vector<AudioEndpointInfo> endpoints;
+	IMMDeviceEnumerator* enumr = ComControlEnumerator();
+	if (!enumr) return endpoints;
+	const HRESULT hr = ListAudioEndpoints(enumr, &endpoints);
+	if (FAILED(hr)) AddonLog(LogLevel::Warn, "Listing audio endpoints failed: 0x%08lx", hr);
+	return endpoints;
+}
+
+// listAudioEndpoints() -> Promise of [{ id, name, flow: 'render' | 'capture',
+// isDefault, isDefaultCommunications }]; an id or name goes in option
+// 'outputDevice' (render) or 'inputDevice' (capture)
+Napi::Value ListAudioEndpointsJs(const Napi::CallbackInfo& info) {
+	return QueueComControl(info.Env(), "ListAudioEndpoints", CollectAudioEndpoints,
+		[](Napi::Env env, const std::vector<AudioEndpointInfo>& endpoints) -> Napi::Value {
+			Napi::Array result = Napi::Array::New(env, endpoints.size());
+			for (size_t i = 0; i < endpoints.size(); ++i) {
+				const AudioEndpointInfo& e = endpoints[i];
+				Napi::Object row = Napi::Object::New(env);
+				row.Set("id", Napi::String::New(env, e.id));
+				row.Set("name", Napi::String::New(env, e.name));
+				row.Set("flow", Napi::String::New(env, e.render ? "render" : "capture"));
+				row.Set("isDefault", Napi::Boolean::New(env, e.isDefault));
+				row.Set("isDefaultCommunications", Napi::Boolean::New(env, e.isDefaultCommunications));
+				result.Set((uint32_t)i, row);
+			}
+			return result;
+		});
+}
+
+// N-API function to start capture with this app's process tree excluded
+// startCaptureExcludeCurrent(callback, options?) - a leading placeholder argument
+// before the callback is still accepted for older callers. Implies option
+// 'excludeSelf'; getStats().selfExcluded is false when the OS fell back to the full mix.
 Napi::Value StartCaptureExcludeCurrent(const Napi::CallbackInfo& info) {
 	Napi::Env env = info.Env();
-	if (info.Length() < 1 || !info[1].IsFunction()) {
+	size_t cbIndex = (info.Length() > 0 && info[0].IsFunction()) ? 0 : 1;
+	if (info.Length() <= cbIndex || !info[cbIndex].IsFunction()) {
 		Napi::TypeError::New(env, "Callback required").ThrowAsJavaScriptException();
 		return env.Null();
 	}
+	CaptureOptions options;
+	if (!ReadCaptureOptionsArg(info, cbIndex + 1, &options)) return env.Null();
+	options.excludeSelf = true;
 	
-	Napi::Function cb = info[1].As<Napi::Function>();
-	auto tsfn = Napi::ThreadSafeFunction::New(env, cb, "PCMCallback", 0, 1);
+	Napi::Function cb = info[cbIndex].As<Napi::Function>();
+	auto tsfn = CreatePcmTsfn(env, cb, options.ChannelConfig(16000));
 	
-	// Pass 0 as PID to indicate we want to exclude current process
-	if (!g_capture) g_capture = std::make_unique<WasapiLoopbackCapture>();
-	bool ok = g_capture->Start(0, tsfn);
+	bool ok = DefaultCapture(env).Start(0, tsfn, options);
 	return Napi::Boolean::New(env, ok);
 }
 
+// Window handles arrive as BigInt (Electron's native handle) or number.
+bool ReadWindowHandle(const Napi::Value& value, HWND* hwnd) {
+	uint64_t handle = 0;
+	if (value.IsBigInt()) {
+		bool lossless = false;
+		handle = value.As<Napi::BigInt>().Uint64Value(&lossless);
+	} else if (value.IsNumber()) {
+		handle = static_cast<uint64_t>(value.As<Napi::Number>().Uint32Value());
+	} else {
+		return false;
+	}
+	*hwnd = reinterpret_cast<HWND>(static_cast<uintptr_t>(handle));
+	return true;
+}
+
+// N-API function to resolve HWND -> PID
+Napi::Value ResolvePidFromWindow(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	HWND hwnd = nullptr;
+	if (info.Length() < 1 || !ReadWindowHandle(info[0], &hwnd)) {
+		Napi::TypeError::New(env, "Window handle (HWND) required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	DWORD pid = 0;
+	GetWindowThreadProcessId(hwnd, &pid);
+	return Napi::Number::New(env, static_cast<double>(pid));
+}
+
+// resolvePidsFromWindows([hwnd, ...]) -> [{ pid, processName }] in the same
+// order, served from the window owner cache (pid 0 for windows that are gone).
+Napi::Value ResolvePidsFromWindows(const Napi::CallbackInfo& info) {
+	Napi::Env env = info.Env();
+	if (info.Length() < 1 || !info[0].IsArray()) {
+		Napi::TypeError::New(env, "Array of window handles (HWND) required").ThrowAsJavaScriptException();
+		return env.Null();
+	}
+	Napi::Array handles = info[0].As<Napi::Array>();
+	std::vector<HWND> windows(handles.Length());
+	for (uint32_t i = 0; i < handles.Length(); ++i) {
+		if (!ReadWindowHandle(handles.Get(i), &windows[i])) {
+			Napi::TypeError::New(env, "Window handles must be numbers or BigInts").ThrowAsJavaScriptException();
+			return env.Null();
+		}
+	}
+
+	std::vector<WindowOwner> owners = WindowPidCache::Instance().Resolve(windows);
+	Napi::Array result = Napi::Array::New(env, owners.size());
+	for (size_t i = 0; i < owners.size(); ++i) {
+		Napi::Object owner = Napi::Object::New(env);
+		owner.Set("pid", Napi::Number::New(env, owners[i].pid));
+		owner.Set("processName", Napi::String::New(env, owners[i].processName));
+		result.Set((uint32_t)i, owner);
+	}
+	return result;
+}
+
+// startSoundboardOutput({ micDevice?, monitor? }) -> { mic, monitor }; micDevice
+// defaults to the VB-Audio cable's render endpoint
+Napi::Value StartSoundboardOutput(const Napi::CallbackInfo& info) {
+	return StartSoundboardOutputs(info, PerEnv<LoopbackAddon>(info.Env()).soundboardOutputs, "cable input");
+}
+
+Napi::Value StopSoundboardOutput(const Napi::CallbackInfo& info) {
+	for (SoundboardOutput& output : PerEnv<LoopbackAddon>(info.Env()).soundboardOutputs) output.Stop();
+	return info.Env().Undefined();
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
+	// Slots go last-created first: the outputs render this environment's soundboard buses
+	Soundboard(env);
+	PerEnv<LoopbackAddon>(env);
+	Cpu(); // kernel ISA detected at load, not on the first stream's thread
 	exports.Set("startCapture", Napi::Function::New(env, StartCapture));
 	exports.Set("stopCapture", Napi::Function::New(env, StopCapture));
+	exports.Set("stopCaptureAsync", Napi::Function::New(env, StopCaptureAsync));
+	exports.Set("getStats", Napi::Function::New(env, GetStats));
+	exports.Set("getHistory", Napi::Function::New(env, GetHistory));
+	exports.Set("deviceClockMs", Napi::Function::New(env, DeviceClockMs));
+	exports.Set("listAudioEndpoints", Napi::Function::New(env, ListAudioEndpointsJs));
+	exports.Set("setMinChunkMs", Napi::Function::New(env, SetMinChunkMs));
+	CaptureSessionWrap<WasapiLoopbackCapture, CaptureStatsToJs>::Init(env, exports);
+	DeliveryStressWrap::Init(env, exports);
+	RegionCaptureWrap<DesktopDuplicationGrabber>::Init(env, exports);
+	TextStabilizerWrap::Init(env, exports);
+	SubtitleTrackerWrap::Init(env, exports);
+	exports.Set("watchLevels", Napi::Function::New(env, WatchLevels));
+	exports.Set("unwatchLevels", Napi::Function::New(env, UnwatchLevels));
+	exports.Set("subscribeEvents", Napi::Function::New(env, SubscribeEvents));
+	exports.Set("unsubscribeEvents", Napi::Function::New(env, UnsubscribeEvents));
+	exports.Set("setVoiceBoostEnabled", Napi::Function::New(env, SetVoiceBoostEnabled));
+	exports.Set("setVoiceBoostLevel", Napi::Function::New(env, SetVoiceBoostLevel));
+	exports.Set("setProcessingParams", Napi::Function::New(env, SetProcessingParams));
+	exports.Set("dspResample", Napi::Function::New(env, DspResample));
+	exports.Set("dspFilter", Napi::Function::New(env, DspFilter));
+	exports.Set("dspGate", Napi::Function::New(env, DspGate));
+	exports.Set("dspNormalize", Napi::Function::New(env, DspNormalize));
+	exports.Set("dspMeasure", Napi::Function::New(env, DspMeasure));
+	exports.Set("dspInt16ToFloat", Napi::Function::New(env, DspInt16ToFloat));
+	exports.Set("dspFloatToInt16", Napi::Function::New(env, DspFloatToInt16));
+	exports.Set("encodeOpus", Napi::Function::New(env, EncodeOpus));
+	exports.Set("encodeFlac", Napi::Function::New(env, EncodeFlac));
+	exports.Set("encodeAudio", Napi::Function::New(env, EncodeAudio));
+	exports.Set("reportUploadThroughput", Napi::Function::New(env, ReportUploadThroughput));
+	exports.Set("uploadTranscription", Napi::Function::New(env, UploadTranscription));
+	exports.Set("getUploadRate", Napi::Function::New(env, GetUploadRate));
+	exports.Set("evaluateDsp", Napi::Function::New(env, EvaluateDsp));
+	exports.Set("transcribeMedia", Napi::Function::New(env, TranscribeMedia));
+	exports.Set("openStreamDecoder", Napi::Function::New(env, OpenStreamDecoder));
+	exports.Set("feedStreamDecoder", Napi::Function::New(env, FeedStreamDecoder));
+	exports.Set("closeStreamDecoder", Napi::Function::New(env, CloseStreamDecoder));
+	exports.Set("probeSoundClip", Napi::Function::New(env, ProbeSoundClip));
+	exports.Set("loadSoundClip", Napi::Function::New(env, LoadSoundClip));
+	exports.Set("unloadSoundClip", Napi::Function::New(env, UnloadSoundClip));
+	exports.Set("playSoundClip", Napi::Function::New(env, PlaySoundClip));
+	exports.Set("stopSoundClip", Napi::Function::New(env, StopSoundClip));
+	exports.Set("isSoundClipPlaying", Napi::Function::New(env, IsSoundClipPlaying));
+	exports.Set("setSoundboardVolumes", Napi::Function::New(env, SetSoundboardVolumes));
+	exports.Set("startSoundboardOutput", Napi::Function::New(env, StartSoundboardOutput));
+	exports.Set("stopSoundboardOutput", Napi::Function::New(env, StopSoundboardOutput));
+	RenderSessionWrap<SoundboardOutput>::Init(env, exports, "cable input");
+	exports.Set("loadWhisperModel", Napi::Function::New(env, LoadWhisperModel));
+	exports.Set("transcribeWhisper", Napi::Function::New(env, TranscribeWhisper));
+	exports.Set("unloadWhisperModel", Napi::Function::New(env, UnloadWhisperModel));
+	exports.Set("getWhisperSchedulerStats", Napi::Function::New(env, GetWhisperSchedulerStats));
+	exports.Set("listWhisperBackends", Napi::Function::New(env, ListWhisperBackends));
+	exports.Set("benchmarkWhisper", Napi::Function::New(env, BenchmarkWhisper));
+	exports.Set("openWhisperStream", Napi::Function::New(env, OpenWhisperStream));
+	exports.Set("feedWhisperStream", Napi::Function::New(env, FeedWhisperStream));
+	exports.Set("flushWhisperStream", Napi::Function::New(env, FlushWhisperStream));
+	exports.Set("closeWhisperStream", Napi::Function::New(env, CloseWhisperStream));
+	exports.Set("loadTranslationModel", Napi::Function::New(env, LoadTranslationModel));
+	exports.Set("translateTexts", Napi::Function::New(env, TranslateTexts));
+	exports.Set("translatePartial", Napi::Function::New(env, TranslatePartial));
+	exports.Set("unloadTranslationModels", Napi::Function::New(env, UnloadTranslationModels));
+	exports.Set("getTranslationModels", Napi::Function::New(env, GetTranslationModels));
+	exports.Set("loadOcrEngine", Napi::Function::New(env, LoadOcrEngine));
+	exports.Set("recognizeOcr", Napi::Function::New(env, RecognizeOcr));
+	exports.Set("unloadOcrEngine", Napi::Function::New(env, UnloadOcrEngine));
+	exports.Set("loadPaddleOcr", Napi::Function::New(env, LoadPaddleOcr));
+	exports.Set("recognizePaddleOcr", Napi::Function::New(env, RecognizePaddleOcr));
+	exports.Set("unloadPaddleOcr", Napi::Function::New(env, UnloadPaddleOcr));
+	exports.Set("loadTtsVoice", Napi::Function::New(env, LoadTtsVoice));
+	exports.Set("synthesizeSpeech", Napi::Function::New(env, SynthesizeSpeech));
+	exports.Set("unloadTtsVoices", Napi::Function::New(env, UnloadTtsVoices));
+	exports.Set("getTtsVoices", Napi::Function::New(env, GetTtsVoices));
+	exports.Set("openAudioRing", Napi::Function::New(env, OpenAudioRing));
+	exports.Set("writeAudioRing", Napi::Function::New(env, WriteAudioRing));
+	exports.Set("writeImageRing", Napi::Function::New(env, WriteImageRing));
+	exports.Set("writeMessageRing", Napi::Function::New(env, WriteMessageRing));
+	exports.Set("closeAudioRing", Napi::Function::New(env, CloseAudioRing));
+	exports.Set("attachAudioRing", Napi::Function::New(env, AttachAudioRing));
+	exports.Set("readAudioRing", Napi::Function::New(env, ReadAudioRing));
+	exports.Set("detachAudioRing", Napi::Function::New(env, DetachAudioRing));
+	exports.Set("openTtsCache", Napi::Function::New(env, OpenTtsCache));
+	exports.Set("getTtsCache", Napi::Function::New(env, GetTtsCache));
+	exports.Set("putTtsCache", Napi::Function::New(env, PutTtsCache));
+	exports.Set("closeTtsCache", Napi::Function::New(env, CloseTtsCache));
+	exports.Set("addFuzzyText", Napi::Function::New(env, AddFuzzyText));
+	exports.Set("removeFuzzyText", Napi::Function::New(env, RemoveFuzzyText));
+	exports.Set("findFuzzyText", Napi::Function::New(env, FindFuzzyText));
+	exports.Set("clearFuzzyText", Napi::Function::New(env, ClearFuzzyText));
+	exports.Set("subscribe", Napi::Function::New(env, Subscribe));
+	exports.Set("unsubscribe", Napi::Function::New(env, Unsubscribe));
+	exports.Set("createPipeline", Napi::Function::New(env, CreatePipeline));
+	exports.Set("destroyPipeline", Napi::Function::New(env, DestroyPipeline));
+	exports.Set("getLogs", Napi::Function::New(env, GetLogs));
+	exports.Set("getThreadStats", Napi::Function::New(env, GetThreadStats));
+	exports.Set("setLogLevel", Napi::Function::New(env, SetLogLevel));
 	exports.Set("startCaptureByProcessName", Napi::Function::New(env, StartCaptureByProcessName));
 	exports.Set("startCaptureExcludeCurrent", Napi::Function::New(env, StartCaptureExcludeCurrent));
 	exports.Set("enumerateAudioSessions", Napi::Function::New(env, EnumerateAudioSessions));
 	exports.Set("findAudioPidForProcess", Napi::Function::New(env, FindAudioPidForProcess));
-	// Export helper to resolve HWND -> PID
-	exports.Set("resolvePidFromWindow", Napi::Function::New(env, [](const Napi::CallbackInfo& info) -> Napi::Value {
-		Napi::Env env = info.Env();
-		if (info.Length() < 1 || (!info[0].IsNumber() && !info[0].IsBigInt())) {
-			Napi::TypeError::New(env, "Window handle (HWND) required").ThrowAsJavaScriptException();
-			return env.Null();
-		}
-		uint64_t handle = 0;
-		if (info[0].IsBigInt()) {
-			bool lossless = false;
-			handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-		} else {
-			handle = static_cast<uint64_t>(info[0].As<Napi::Number>().Uint32Value());
-		}
-		HWND hwnd = reinterpret_cast<HWND>(static_cast<uintptr_t>(handle));
-		DWORD pid = 0;
-		GetWindowThreadProcessId(hwnd, &pid);
-		return Napi::Number::New(env, static_cast<double>(pid));
-	}));
+	exports.Set("enumerateAudioSessionsAsync", Napi::Function::New(env, EnumerateAudioSessionsAsync));
+	exports.Set("findAudioPidForProcessAsync", Napi::Function::New(env, FindAudioPidForProcessAsync));
+	exports.Set("startCaptureByProcessNameAsync", Napi::Function::New(env, StartCaptureByProcessNameAsync));
+	exports.Set("watchAudioSessions", Napi::Function::New(env, WatchAudioSessions));
+	exports.Set("unwatchAudioSessions", Napi::Function::New(env, UnwatchAudioSessions));
+	exports.Set("getAudioSessions", Napi::Function::New(env, GetAudioSessions));
+	exports.Set("getSessionLevels", Napi::Function::New(env, GetSessionLevels));
+	exports.Set("resolvePidFromWindow", Napi::Function::New(env, ResolvePidFromWindow));
+	exports.Set("resolvePidsFromWindows", Napi::Function::New(env, ResolvePidsFromWindows));
 	return exports;
 }
 
@@ -0,0 +1,81 @@
+#include "window_pid_cache.h"
+
+#include <thread>
+
+#include "addon_log.h"
+#include "process_snapshot.h"
+#include "thread_cpu.h"
+
+namespace {
+
+const ULONGLONG kEntryTtlMs = 5000;
+
+} // namespace
+
+WindowPidCache& WindowPidCache::Instance() {
+	static WindowPidCache cache;
+	return cache;
+}
+
+// Hook thread: a created or destroyed top-level window may reuse or retire a cached handle.
+void CALLBACK WindowPidCache::WindowEvent(HWINEVENTHOOK, DWORD, HWND window, LONG object, LONG child, DWORD, DWORD) {
+	if (window && object == OBJID_WINDOW && child == CHILDID_SELF) Instance().Forget(window);
+}
+
+void WindowPidCache::Forget(HWND window) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	windows_.erase(window);
+}
+
+// Out-of-context WinEvents are delivered through the hooking thread's message
+// queue, so the hook gets its own thread and message loop. Lives for the
+// process; the cache is never destroyed before exit.
+void WindowPidCache::StartHookLocked() {
+	hooked_ = true;
+	std::thread([] {
+		ThreadCpuScope cpu("window-events");
+		HWINEVENTHOOK hook = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_DESTROY, nullptr, WindowEvent, 0, 0,
+		                                     WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+		if (!hook) {
+			AddonLog(LogLevel::Warn, "Window PID cache: SetWinEventHook failed: %lu", GetLastError());
+			return;
+		}
+		MSG msg;
+		while (GetMessageW(&msg, nullptr, 0, 0) > 0) DispatchMessageW(&msg);
+		UnhookWinEvent(hook);
+	}).detach();
+}
+
+std::vector<WindowOwner> WindowPidCache::Resolve(const std::vector<HWND>& windows) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!hooked_) StartHookLocked();
+
+	const ULONGLONG now = GetTickCount64();
+	std::vector<WindowOwner> owners(windows.size());
+	bool missingName = now >= namesExpire_;
+	for (size_t i = 0; i < windows.size(); ++i) {
+		auto it = windows_.find(windows[i]);
+		if (it == windows_.end() || it->second.expires <= now) {
+			DWORD pid = 0;
+			if (!IsWindow(windows[i]) || !GetWindowThreadProcessId(windows[i], &pid)) pid = 0;
+			it = windows_.insert_or_assign(windows[i], Entry{ pid, now + kEntryTtlMs }).first;
+		}
+		owners[i].pid = it->second.pid;
+		missingName = missingName || (owners[i].pid != 0 && names_.find(owners[i].pid) == names_.end());
+	}
+
+	if (missingName) {
+		// One snapshot names every process at once; PIDs may have been reused since the last one
+		ProcessSnapshot snapshot;
+		names_.clear();
+		for (const ProcessSnapshot::Entry& entry : snapshot.Entries()) names_[entry.pid] = entry.name;
+		namesExpire_ = now + kEntryTtlMs;
+		// Unnamed until the next snapshot (e.g. our own windows) rather than re-snapshotting every call
+		for (const WindowOwner& owner : owners) names_.emplace(owner.pid, std::string());
+	}
+	for (WindowOwner& owner : owners) {
+		auto name = names_.find(owner.pid);
+		if (name != names_.end()) owner.processName = name->second;
+	}
+	return owners;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// HWND -> owning process cache for the window picker. Entries are dropped when
+// a WinEvent hook reports the window created or destroyed, and expire after a
+// few seconds regardless so a missed event can't pin a stale PID. Process
+// names come from one Toolhelp snapshot per refresh, not OpenProcess per
+// window. Implemented in window_pid_cache.cc.
+
+#include <windows.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct WindowOwner {
+	DWORD pid = 0; // 0 when the window no longer exists
+	std::string processName;
+};
+
+class WindowPidCache {
+public:
+	static WindowPidCache& Instance();
+
+	// owners[i] belongs to windows[i].
+	std::vector<WindowOwner> Resolve(const std::vector<HWND>& windows);
+
+private:
+	WindowPidCache() = default;
+	void StartHookLocked();
+	void Forget(HWND window);
+
+	static void CALLBACK WindowEvent(HWINEVENTHOOK hook, DWORD event, HWND window, LONG object, LONG child, DWORD thread, DWORD time);
+
+	struct Entry {
+		DWORD pid;
+		ULONGLONG expires;
+	};
+
+	std::mutex mutex_;
+	bool hooked_ = false;
+	std::unordered_map<HWND, Entry> windows_;
+	std::unordered_map<DWORD, std::string> names_;
+	ULONGLONG namesExpire_ = 0;
+};
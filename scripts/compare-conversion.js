@@ -0,0 +1,213 @@
+/**
+ * Loopback conversion comparison (Windows)
+ * Compares the two ways a WASAPI loopback reaches 16 kHz mono (capture option
+ * `conversion`): 'native' reads the mix format and converts in the addon,
+ * 'engine-converted' has the Windows audio engine deliver 16 kHz mono float.
+ *
+ * Quality: both run side by side on the same mix, the addon's 'high'
+ * resampler as the reference; the engine stream is aligned to it and the
+ * script prints their difference as SNR, plus each stream's share of energy
+ * in the top band (7-8 kHz), where a softer SRC filter rolls off early.
+ * CPU: each mode then runs alone, with this process's CPU time and the
+ * addon's per-packet front-end timing (timing.convert). The engine's SRC runs
+ * in audiodg.exe and is not in these figures; compare it in Task Manager.
+ *
+ * Play something while it runs (speech, music or a sweep); silence compares
+ * nothing.
+ *
+ *   node scripts/compare-conversion.js [--seconds=N] [--json]
+ */
+
+const path = require('path');
+
+const RATE = 16000;
+const MAX_LAG = RATE / 20; // 50 ms either way
+
+function loadAddon() {
+  return require(path.join(__dirname, '..', 'native-wasapi-loopback', 'build', 'Release', 'wasapi_loopback.node'));
+}
+
+function startSession(addon, options, onSamples) {
+  const session = new addon.CaptureSession();
+  const ok = session.start(0, (packet) => {
+    if (packet instanceof Float32Array) onSamples(packet);
+  }, { format: 'float32', frameMs: 20, framesPerPacket: 5, queueDepth: 256, ...options });
+  if (!ok) throw new Error(`CaptureSession.start failed for ${JSON.stringify(options)}`);
+  return session;
+}
+
+function concat(parts) {
+  const out = new Float32Array(parts.reduce((n, p) => n + p.length, 0));
+  let at = 0;
+  for (const p of parts) {
+    out.set(p, at);
+    at += p.length;
+  }
+  return out;
+}
+
+// Lag of b against a with the highest normalised correlation, over a 2 s window.
+function bestLag(a, b) {
+  const start = MAX_LAG;
+  const len = Math.min(2 * RATE, a.length - 2 * MAX_LAG, b.length - 2 * MAX_LAG);
+  if (len <= 0) return 0;
+  let best = 0;
+  let bestScore = -Infinity;
+  for (let lag = -MAX_LAG; lag <= MAX_LAG; lag++) {
+    let dot = 0;
+    let nb = 0;
+    for (let i = start; i < start + len; i++) {
+      const y = b[i + lag];
+      dot += a[i] * y;
+      nb += y * y;
+    }
+    const score = nb > 0 ? dot / Math.sqrt(nb) : -Infinity;
+    if (score > bestScore) {
+      bestScore = score;
+      best = lag;
+    }
+  }
+  return best;
+}
+
+// SNR of b against the reference a once aligned; the gain between them is
+// fitted first so a level offset doesn't count as noise.
+function alignedSnr(a, b, lag) {
+  let ab = 0;
+  let bb = 0;
+  const from = Math.max(0, -lag);
+  const to = Math.min(a.length, b.length - lag);
+  for (let i = from; i < to; i++) {
+    ab += a[i] * b[i + lag];
+    bb += b[i + lag] * b[i + lag];
+  }
+  const gain = bb > 0 ? ab / bb : 1;
+  let signal = 0;
+  let noise = 0;
+  for (let i = from; i < to; i++) {
+    const d = a[i] - gain * b[i + lag];
+    signal += a[i] * a[i];
+    noise += d * d;
+  }
+  return { snrDb: noise > 0 ? 10 * Math.log10(signal / noise) : Infinity, gain };
+}
+
+function fft(re, im) {
+  const n = re.length;
+  for (let i = 1, j = 0; i < n; i++) {
+    let bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      [re[i], re[j]] = [re[j], re[i]];
+      [im[i], im[j]] = [im[j], im[i]];
+    }
+  }
+  for (let size = 2; size <= n; size <<= 1) {
+    const step = (-2 * Math.PI) / size;
+    for (let i = 0; i < n; i += size) {
+      for (let k = 0; k < size / 2; k++) {
+        const c = Math.cos(step * k);
+        const s = Math.sin(step * k);
+        const xr = re[i + k + size / 2] * c - im[i + k + size / 2] * s;
+        const xi = re[i + k + size / 2] * s + im[i + k + size / 2] * c;
+        re[i + k + size / 2] = re[i + k] - xr;
+        im[i + k + size / 2] = im[i + k] - xi;
+        re[i + k] += xr;
+        im[i + k] += xi;
+      }
+    }
+  }
+}
+
+// Share of the energy between 7 and 8 kHz, Hann-windowed 1024-point frames.
+function topBandShare(x) {
+  const n = 1024;
+  const edge = Math.round((7000 / RATE) * n);
+  let top = 0;
+  let total = 0;
+  const re = new Float64Array(n);
+  const im = new Float64Array(n);
+  for (let at = 0; at + n <= x.length; at += n / 2) {
+    for (let i = 0; i < n; i++) {
+      re[i] = x[at + i] * (0.5 - 0.5 * Math.cos((2 * Math.PI * i) / (n - 1)));
+      im[i] = 0;
+    }
+    fft(re, im);
+    for (let k = 1; k <= n / 2; k++) {
+      const e = re[k] * re[k] + im[k] * im[k];
+      total += e;
+      if (k >= edge) top += e;
+    }
+  }
+  return total > 0 ? top / total : 0;
+}
+
+function sleep(ms) {
+  return new Promise((resolve) => setTimeout(resolve, ms));
+}
+
+async function compareQuality(addon, seconds) {
+  const native = [];
+  const engine = [];
+  const a = startSession(addon, { conversion: 'native', resampler: 'high' }, (p) => native.push(Float32Array.from(p)));
+  const b = startSession(addon, { conversion: 'engine-converted' }, (p) => engine.push(Float32Array.from(p)));
+  await sleep(seconds * 1000);
+  const engineConverted = b.getStats().engineConverted;
+  a.stop();
+  b.stop();
+  const ref = concat(native);
+  const test = concat(engine);
+  const lag = bestLag(ref, test);
+  const { snrDb, gain } = alignedSnr(ref, test, lag);
+  return {
+    test: 'quality', engineConverted, seconds, lagMs: (lag * 1000) / RATE,
+    snrDb: Number(snrDb.toFixed(1)), gain: Number(gain.toFixed(3)),
+    topBand: { native: Number(topBandShare(ref).toFixed(5)), engine: Number(topBandShare(test).toFixed(5)) },
+  };
+}
+
+async function measureCpu(addon, conversion, seconds) {
+  let samples = 0;
+  const startCpu = process.cpuUsage();
+  const session = startSession(addon, { conversion }, (p) => { samples += p.length; });
+  await sleep(seconds * 1000);
+  const stats = session.getStats();
+  session.stop();
+  const cpu = process.cpuUsage(startCpu);
+  return {
+    test: 'cpu', conversion, engineConverted: stats.engineConverted, inputSampleRate: stats.inputSampleRate,
+    inputChannels: stats.inputChannels, samples, cpuMs: (cpu.user + cpu.system) / 1000,
+    convertUs: { p50: stats.timing.convert.p50Us, p99: stats.timing.convert.p99Us, mean: stats.timing.convert.meanUs },
+  };
+}
+
+async function main() {
+  const args = process.argv.slice(2);
+  const secondsArg = args.find((a) => a.startsWith('--seconds='));
+  const seconds = secondsArg ? Number(secondsArg.split('=')[1]) : 10;
+  const json = args.includes('--json');
+  if (process.platform !== 'win32') {
+    console.error('compare-conversion: WASAPI only');
+    process.exit(2);
+  }
+  const addon = loadAddon();
+  const results = [
+    await compareQuality(addon, seconds),
+    await measureCpu(addon, 'native', seconds),
+    await measureCpu(addon, 'engine-converted', seconds),
+  ];
+  for (const r of results) {
+    if (json) {
+      console.log(JSON.stringify(r));
+    } else if (r.test === 'quality') {
+      console.log(`quality: engine vs native 'high' SNR ${r.snrDb} dB (lag ${r.lagMs} ms, gain ${r.gain}); ` +
+        `7-8 kHz share native ${r.topBand.native}, engine ${r.topBand.engine}${r.engineConverted ? '' : ' (engine conversion refused)'}`);
+    } else {
+      console.log(`cpu ${r.conversion.padEnd(16)} ${r.inputSampleRate} Hz x${r.inputChannels}: ${r.cpuMs.toFixed(0)} ms CPU, ` +
+        `convert p50 ${r.convertUs.p50.toFixed(1)} us, p99 ${r.convertUs.p99.toFixed(1)} us`);
+    }
+  }
+}
+
+main();
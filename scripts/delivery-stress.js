@@ -0,0 +1,128 @@
+/**
+ * Delivery backpressure stress
+ * Drives the addon's PCM delivery path (ring, overflow policy, TSFN) with the
+ * DeliveryStress synthetic producer against this process as the JS consumer,
+ * for every overflow policy under several main-thread stall patterns, and
+ * prints one row per run: end-to-end latency from the producer's write to the
+ * JS callback, ring occupancy, drops and producer overruns. No audio device
+ * is used.
+ *
+ *   node scripts/delivery-stress.js [--duration-ms=N] [--queue-depth=N] [--wait] [--json]
+ *
+ * --wait makes the producer hold off while the ring is half full, the way a
+ * BlockingCall parks the capture thread; its overruns are device periods a
+ * real capture would have lost.
+ */
+
+const path = require('path');
+
+function loadAddon() {
+  const nativeDir = process.platform === 'darwin' ? 'native-coreaudio-loopback' : 'native-wasapi-loopback';
+  const addonName = process.platform === 'darwin' ? 'coreaudio_loopback.node' : 'wasapi_loopback.node';
+  return require(path.join(__dirname, '..', nativeDir, 'build', 'Release', addonName));
+}
+
+function busyWait(ms) {
+  const end = Date.now() + ms;
+  while (Date.now() < end) { /* the main thread is frozen */ }
+}
+
+// How the JS side misbehaves. `timer` freezes the whole thread on a schedule
+// (GC, a long renderer IPC handler); `perPacketMs` is work done in the
+// callback for every packet (a consumer that is simply too slow).
+const STALL_PATTERNS = {
+  none: {},
+  'gc-minor': { timer: { everyMs: 500, stallMs: 30 } },
+  'gc-major': { timer: { everyMs: 3000, stallMs: 400 } },
+  freeze: { timer: { everyMs: 4000, stallMs: 1500 } },
+  slow: { perPacketMs: 12 },
+};
+
+const POLICIES = ['drop-oldest', 'drop-newest', 'coalesce'];
+
+function percentile(sorted, p) {
+  if (sorted.length === 0) return 0;
+  return sorted[Math.min(sorted.length - 1, Math.ceil(p * sorted.length) - 1)];
+}
+
+function run(addon, policy, patternName, { durationMs, queueDepth, wait }) {
+  const pattern = STALL_PATTERNS[patternName];
+  return new Promise((resolve) => {
+    const stress = new addon.DeliveryStress();
+    const latencies = [];
+    let packets = 0;
+    let timer = null;
+    const started = stress.start((packet, _speech, stamp) => {
+      if (!ArrayBuffer.isView(packet)) {
+        if (packet.type !== 'end') return;
+        clearInterval(timer);
+        setImmediate(() => {
+          const stats = stress.getStats();
+          latencies.sort((a, b) => a - b);
+          resolve({
+            policy, pattern: patternName, packets,
+            latencyMs: {
+              p50: percentile(latencies, 0.5), p99: percentile(latencies, 0.99), max: latencies[latencies.length - 1] || 0,
+            },
+            occupancy: stats.occupancy,
+            overflows: stats.delivery.overflows, dropped: stats.delivery.dropped, coalesced: stats.delivery.coalesced,
+            periods: stats.periods, overruns: stats.overruns,
+          });
+        });
+        return;
+      }
+      ++packets;
+      // The packet's last sample left the producer at captureTimeMs + its length
+      if (stamp && stamp.captureTimeMs) {
+        const lengthMs = packet.length / 16;
+        latencies.push(addon.deviceClockMs() - stamp.captureTimeMs - lengthMs);
+      }
+      if (pattern.perPacketMs) busyWait(pattern.perPacketMs);
+    }, {
+      overflow: policy, queueDepth, format: 'pcm16', frameMs: 20, framesPerPacket: 1, timestamps: true,
+      periodMs: 10, durationMs, wait,
+    });
+    if (!started) {
+      resolve({ policy, pattern: patternName, error: 'start returned false' });
+      return;
+    }
+    if (pattern.timer) timer = setInterval(() => busyWait(pattern.timer.stallMs), pattern.timer.everyMs);
+  });
+}
+
+function formatRow(r) {
+  if (r.error) return `${r.policy.padEnd(12)} ${r.pattern.padEnd(9)} ${r.error}`;
+  const f = (n) => n.toFixed(1).padStart(7);
+  return `${r.policy.padEnd(12)} ${r.pattern.padEnd(9)}` +
+    `${f(r.latencyMs.p50)}${f(r.latencyMs.p99)}${f(r.latencyMs.max)}` +
+    `${f(r.occupancy.mean)}${String(r.occupancy.p99).padStart(6)}${String(r.occupancy.max).padStart(6)}` +
+    `${String(r.dropped).padStart(8)}${String(r.coalesced).padStart(10)}${String(r.overruns).padStart(9)}`;
+}
+
+async function main() {
+  const args = process.argv.slice(2);
+  const numberArg = (name, fallback) => {
+    const arg = args.find((a) => a.startsWith(`--${name}=`));
+    return arg ? Number(arg.split('=')[1]) : fallback;
+  };
+  const options = { durationMs: numberArg('duration-ms', 10000), queueDepth: numberArg('queue-depth', 64), wait: args.includes('--wait') };
+  const json = args.includes('--json');
+  const addon = loadAddon();
+  if (typeof addon.DeliveryStress !== 'function') {
+    console.error('This addon build has no DeliveryStress harness; rebuild it');
+    process.exit(2);
+  }
+  if (!json) {
+    console.log(`queueDepth ${options.queueDepth}, 20 ms packets from a 10 ms producer, ${options.durationMs} ms per run${options.wait ? ', producer waits' : ''}`);
+    console.log('policy       pattern   lat p50 lat p99 lat max occ avg occ99 occmx dropped coalesced overruns');
+  }
+  for (const policy of POLICIES) {
+    for (const pattern of Object.keys(STALL_PATTERNS)) {
+      const result = await run(addon, policy, pattern, options);
+      console.log(json ? JSON.stringify(result) : formatRow(result));
+    }
+  }
+  process.exit(0);
+}
+
+main();
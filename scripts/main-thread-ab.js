@@ -0,0 +1,361 @@
+/**
+ * Main-thread A/B for the capture handler pipeline
+ * Replays one audio file through the native capture chain (source 'file')
+ * twice per run: once with the chunking, voice boost and level bars done in
+ * JS on every packet the way wasapi-handlers.ts does when the addon lacks the
+ * native versions, once with the addon's chunker, compressor and
+ * watchLevels() doing that work. For each pass it prints one JSON line with
+ * the main thread's busy time (event loop utilization), event-loop delay
+ * p50/p99, GC pause time and the chunks cut; the last line compares the
+ * medians of both modes and how closely the chunk boundaries agree.
+ *
+ * The JS side below is a copy of the handler's path (energy VAD fallback
+ * optional) since the handler itself needs Electron; keep it in step.
+ * Runs under plain Node, or headless Electron for its V8 and GC settings:
+ *
+ *   node scripts/main-thread-ab.js [--runs=N] [--fast] [--energy-vad] [--min-chunk-ms=N] [--tolerance-ms=N] file.wav
+ *   ELECTRON_RUN_AS_NODE=1 npx electron scripts/main-thread-ab.js ... file.wav
+ *
+ * Needs an addon built with use_avformat=1 for the ABI of the runtime used.
+ */
+
+const path = require('path');
+const { PerformanceObserver, monitorEventLoopDelay, performance } = require('perf_hooks');
+
+function loadAddon() {
+  const nativeDir = process.platform === 'darwin' ? 'native-coreaudio-loopback' : 'native-wasapi-loopback';
+  const addonName = process.platform === 'darwin' ? 'coreaudio_loopback.node' : 'wasapi_loopback.node';
+  return require(path.join(__dirname, '..', nativeDir, 'build', 'Release', addonName));
+}
+
+const TARGET_RATE = 16000;
+const VAD_FRAME_MS = 20;
+const VAD_FRAME_SAMPLES = (TARGET_RATE * VAD_FRAME_MS) / 1000;
+const VAD_FRAME_BYTES = VAD_FRAME_SAMPLES * 2;
+const MAX_CHUNK_MS = 3000;
+const PAUSE_THRESHOLD_MS = 50;
+const OVERLAP_MS = 100;
+const VOICE_BOOST_LEVEL = 10.0;
+
+// applyVoiceBoost() from wasapi-handlers.ts
+function applyVoiceBoost(pcmData, boostLevel) {
+  const samples = pcmData.length / 2;
+  if (samples === 0) return pcmData;
+  const floatData = new Float32Array(samples);
+  for (let i = 0; i < samples; i++) floatData[i] = pcmData.readInt16LE(i * 2) / 32768.0;
+  let sumSquares = 0;
+  for (let i = 0; i < samples; i++) sumSquares += floatData[i] * floatData[i];
+  const rms = Math.sqrt(sumSquares / samples);
+  if (rms < 0.00001) return pcmData;
+  let adaptiveGain = 0.20 / rms;
+  adaptiveGain = Math.max(1.0, Math.min(adaptiveGain, 200.0));
+  const threshold = 0.0316;
+  const ratio = 4.0;
+  const outputData = new Float32Array(samples);
+  for (let i = 0; i < samples; i++) {
+    let sample = floatData[i];
+    const absSample = Math.abs(sample);
+    if (absSample > threshold) {
+      const compressed = threshold + (absSample - threshold) / ratio;
+      sample = sample > 0 ? compressed : -compressed;
+    } else {
+      sample *= adaptiveGain;
+    }
+    sample *= boostLevel;
+    if (Math.abs(sample) > 0.7) sample = Math.tanh(sample);
+    outputData[i] = Math.max(-0.99, Math.min(0.99, sample));
+  }
+  const boostedBuffer = Buffer.alloc(pcmData.length);
+  for (let i = 0; i < samples; i++) {
+    const intSample = Math.round(outputData[i] * 32767);
+    boostedBuffer.writeInt16LE(Math.max(-32768, Math.min(32767, intSample)), i * 2);
+  }
+  return boostedBuffer;
+}
+
+// convertPcmToWav() from wasapi-handlers.ts
+function convertPcmToWav(pcmData, sampleRate, channels) {
+  const processedPcm = applyVoiceBoost(pcmData, VOICE_BOOST_LEVEL);
+  const length = processedPcm.length;
+  const buffer = Buffer.alloc(44 + length);
+  buffer.write('RIFF', 0);
+  buffer.writeUInt32LE(36 + length, 4);
+  buffer.write('WAVE', 8);
+  buffer.write('fmt ', 12);
+  buffer.writeUInt32LE(16, 16);
+  buffer.writeUInt16LE(1, 20);
+  buffer.writeUInt16LE(channels, 22);
+  buffer.writeUInt32LE(sampleRate, 24);
+  buffer.writeUInt32LE(sampleRate * channels * 2, 28);
+  buffer.writeUInt16LE(channels * 2, 32);
+  buffer.writeUInt16LE(16, 34);
+  buffer.write('data', 36);
+  buffer.writeUInt32LE(length, 40);
+  processedPcm.copy(buffer, 44);
+  return buffer;
+}
+
+// The overlay level bars the handler computes per packet without watchLevels()
+function levelBars(pcmData) {
+  const int16Data = new Int16Array(pcmData.buffer, pcmData.byteOffset, pcmData.byteLength / 2);
+  let sumSq = 0;
+  for (let i = 0; i < int16Data.length; i++) {
+    const normalized = int16Data[i] / 32768;
+    sumSq += normalized * normalized;
+  }
+  const baseLevel = Math.min(1, Math.sqrt(sumSq / int16Data.length) * 8);
+  const audioLevels = [];
+  for (let i = 0; i < 8; i++) {
+    const centerBoost = 1 - (Math.abs(i - 3.5) / 4) * 0.3;
+    audioLevels.push(Math.max(0.15, Math.min(1, baseLevel * centerBoost * (0.9 + Math.random() * 0.2))));
+  }
+  return audioLevels;
+}
+
+// The handler's per-packet chunking; chunks are reported by the frame they end on
+function createJsChunker({ minChunkMs, energyVad, onChunk }) {
+  const MIN_CHUNK_FRAMES = Math.floor(minChunkMs / VAD_FRAME_MS);
+  const MAX_CHUNK_FRAMES = Math.floor(MAX_CHUNK_MS / VAD_FRAME_MS);
+  const PAUSE_FRAMES = Math.floor(PAUSE_THRESHOLD_MS / VAD_FRAME_MS);
+  const OVERLAP_FRAMES = Math.floor(OVERLAP_MS / VAD_FRAME_MS);
+  const LONG_SILENCE_FRAMES = 50;
+  const VERY_LONG_SILENCE_FRAMES = 100;
+  let pendingInt16 = Buffer.alloc(0);
+  let currentChunkFrames = [];
+  let lastChunkOverlapFrames = [];
+  let consecutiveSilenceFrames = 0;
+  let hasAnySpeechInChunk = false;
+  let framesSeen = 0;
+
+  const emit = (reason) => {
+    const allFrames = [...lastChunkOverlapFrames, ...currentChunkFrames];
+    const wav = convertPcmToWav(Buffer.concat(allFrames), TARGET_RATE, 1);
+    onChunk({ endMs: framesSeen * VAD_FRAME_MS, durationMs: allFrames.length * VAD_FRAME_MS, reason, bytes: wav.length });
+  };
+
+  return (pcmData, speech) => {
+    const nativeSpeech = energyVad || pendingInt16.length > 0 ? undefined : speech;
+    let nextFrame = 0;
+    pendingInt16 = pendingInt16.length > 0 ? Buffer.concat([pendingInt16, pcmData]) : pcmData;
+    while (pendingInt16.length >= VAD_FRAME_BYTES) {
+      const frame = pendingInt16.subarray(0, VAD_FRAME_BYTES);
+      pendingInt16 = pendingInt16.subarray(VAD_FRAME_BYTES);
+      const frameIndex = nextFrame++;
+      framesSeen++;
+      let isSpeech;
+      if (nativeSpeech !== undefined) {
+        isSpeech = ((nativeSpeech >>> frameIndex) & 1) === 1;
+      } else {
+        let sum = 0;
+        for (let i = 0; i < VAD_FRAME_BYTES; i += 2) {
+          const sample = frame.readInt16LE(i) / 32768;
+          sum += sample * sample;
+        }
+        isSpeech = Math.sqrt(sum / VAD_FRAME_SAMPLES) > 0.005;
+      }
+
+      currentChunkFrames.push(frame);
+      if (isSpeech) {
+        hasAnySpeechInChunk = true;
+        consecutiveSilenceFrames = 0;
+      } else {
+        consecutiveSilenceFrames++;
+      }
+      const chunkDurationFrames = currentChunkFrames.length;
+      const shouldCutAtPause = consecutiveSilenceFrames >= PAUSE_FRAMES && hasAnySpeechInChunk &&
+        chunkDurationFrames >= MIN_CHUNK_FRAMES;
+      const shouldForceCut = chunkDurationFrames >= MAX_CHUNK_FRAMES && hasAnySpeechInChunk;
+      if (shouldCutAtPause || shouldForceCut) {
+        emit(shouldForceCut ? 'max-length' : 'pause');
+        lastChunkOverlapFrames = currentChunkFrames.slice(-OVERLAP_FRAMES);
+        currentChunkFrames = [];
+        hasAnySpeechInChunk = false;
+        consecutiveSilenceFrames = 0;
+      }
+
+      if (consecutiveSilenceFrames >= LONG_SILENCE_FRAMES && hasAnySpeechInChunk && chunkDurationFrames >= MIN_CHUNK_FRAMES) {
+        emit('silence');
+        lastChunkOverlapFrames = [];
+        currentChunkFrames = [];
+        hasAnySpeechInChunk = false;
+        consecutiveSilenceFrames = 0;
+      } else if (consecutiveSilenceFrames >= VERY_LONG_SILENCE_FRAMES) {
+        lastChunkOverlapFrames = [];
+        currentChunkFrames = [];
+        hasAnySpeechInChunk = false;
+        consecutiveSilenceFrames = 0;
+      }
+    }
+  };
+}
+
+// One replay of the file in the given mode, measured from start to 'end'
+function runPass(addon, file, mode, { pace, minChunkMs, energyVad }) {
+  return new Promise((resolve) => {
+    const chunks = [];
+    let levelUpdates = 0;
+    let packets = 0;
+    let gcMs = 0;
+    let gcCount = 0;
+    let finished = false;
+    let poll = null;
+    const gcObserver = new PerformanceObserver((list) => {
+      for (const entry of list.getEntries()) {
+        gcMs += entry.duration;
+        gcCount++;
+      }
+    });
+    gcObserver.observe({ entryTypes: ['gc'] });
+    const delay = monitorEventLoopDelay({ resolution: 10 });
+    delay.enable();
+    const startElu = performance.eventLoopUtilization();
+    const startCpu = process.cpuUsage();
+    const startMs = performance.now();
+
+    const native = mode === 'native';
+    if (typeof addon.setVoiceBoostLevel === 'function') addon.setVoiceBoostLevel(VOICE_BOOST_LEVEL);
+    if (typeof addon.setVoiceBoostEnabled === 'function') addon.setVoiceBoostEnabled(native);
+    const watching = native && typeof addon.watchLevels === 'function' &&
+      addon.watchLevels(() => { levelUpdates++; }, { rateHz: 30 });
+    const chunker = native ? null : createJsChunker({
+      minChunkMs, energyVad, onChunk: (chunk) => chunks.push(chunk),
+    });
+
+    const finish = (ended) => {
+      if (finished) return;
+      finished = true;
+      clearInterval(poll);
+      addon.stopCapture();
+      if (watching) addon.unwatchLevels();
+      const elu = performance.eventLoopUtilization(startElu);
+      const cpu = process.cpuUsage(startCpu);
+      delay.disable();
+      // Pending GC entries are delivered asynchronously; pick them up first
+      setImmediate(() => {
+        gcObserver.disconnect();
+        resolve({
+          mode, ended, packets, levelUpdates, chunks,
+          wallMs: Math.round(performance.now() - startMs),
+          busyMs: Math.round(elu.active),
+          utilization: Number(elu.utilization.toFixed(4)),
+          lagP50Ms: Number((delay.percentile(50) / 1e6).toFixed(2)),
+          lagP99Ms: Number((delay.percentile(99) / 1e6).toFixed(2)),
+          lagMaxMs: Number((delay.max / 1e6).toFixed(2)),
+          gcMs: Number(gcMs.toFixed(2)),
+          gcCount,
+          cpuMs: Math.round((cpu.user + cpu.system) / 1000),
+        });
+      });
+    };
+
+    const options = {
+      source: 'file', file, pace, format: 'pcm16', frameMs: VAD_FRAME_MS, framesPerPacket: 5,
+      vad: 'very-aggressive', timestamps: true, queueDepth: 256,
+    };
+    if (native) options.chunker = { minChunkMs, maxChunkMs: MAX_CHUNK_MS, pauseMs: PAUSE_THRESHOLD_MS, overlapMs: OVERLAP_MS };
+    let lastPacketMs = performance.now();
+    const started = addon.startCapture(0, (packet, speech) => {
+      lastPacketMs = performance.now();
+      if (!ArrayBuffer.isView(packet)) {
+        if (packet.type === 'chunk') {
+          const startMs = packet.sampleIndex / (TARGET_RATE / 1000);
+          chunks.push({ endMs: Math.round(startMs + packet.durationMs), durationMs: packet.durationMs,
+            reason: packet.reason, bytes: packet.wav.length });
+        } else if (packet.type === 'end') {
+          setImmediate(() => finish(true));
+        }
+        return;
+      }
+      packets++;
+      if (native || packet.length === 0) return;
+      const pcmData = Buffer.from(packet.buffer, packet.byteOffset, packet.byteLength);
+      levelBars(pcmData);
+      levelUpdates++;
+      chunker(pcmData, speech);
+    }, options);
+    if (!started) {
+      finished = true;
+      delay.disable();
+      gcObserver.disconnect();
+      if (watching) addon.unwatchLevels();
+      resolve({ mode, ended: false, error: 'startCapture returned false' });
+      return;
+    }
+    // A file that cannot be opened stops the capture without an 'end' event;
+    // without dtx a running replay delivers a packet every 100 ms
+    poll = setInterval(() => {
+      if (performance.now() - lastPacketMs > 2000) finish(false);
+    }, 250);
+  });
+}
+
+// Share of each side's chunks with one on the other side ending within tolerance
+function compareChunks(a, b, toleranceMs) {
+  const matched = (from, to) => from.filter((c) => to.some((d) => Math.abs(d.endMs - c.endMs) <= toleranceMs)).length;
+  const share = (n, total) => (total ? Number((n / total).toFixed(3)) : 1);
+  const durationMs = (list) => list.reduce((sum, c) => sum + c.durationMs, 0);
+  return {
+    jsChunks: a.length,
+    nativeChunks: b.length,
+    jsMatched: share(matched(a, b), a.length),
+    nativeMatched: share(matched(b, a), b.length),
+    jsDurationMs: durationMs(a),
+    nativeDurationMs: durationMs(b),
+  };
+}
+
+function median(values) {
+  const sorted = [...values].sort((x, y) => x - y);
+  const mid = sorted.length >> 1;
+  return sorted.length % 2 ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2;
+}
+
+async function main() {
+  const args = process.argv.slice(2);
+  const numberArg = (name, fallback) => {
+    const arg = args.find((a) => a.startsWith(`--${name}=`));
+    return arg ? Number(arg.split('=')[1]) : fallback;
+  };
+  const runs = Math.max(1, numberArg('runs', 3));
+  const minChunkMs = numberArg('min-chunk-ms', 1000);
+  const toleranceMs = numberArg('tolerance-ms', 60);
+  const pace = args.includes('--fast') ? 'fast' : 'realtime';
+  const energyVad = args.includes('--energy-vad');
+  const file = args.find((a) => !a.startsWith('--'));
+  if (!file) {
+    console.error('usage: node scripts/main-thread-ab.js [--runs=N] [--fast] [--energy-vad] [--min-chunk-ms=N] [--tolerance-ms=N] file');
+    process.exit(2);
+  }
+  const addon = loadAddon();
+  const results = { js: [], native: [] };
+  for (let run = 0; run < runs; run++) {
+    // Alternate which mode goes first so drift (thermal, caches) hits both
+    const order = run % 2 ? ['native', 'js'] : ['js', 'native'];
+    for (const mode of order) {
+      const result = await runPass(addon, file, mode, { pace, minChunkMs, energyVad });
+      if (!result.ended) {
+        console.error(JSON.stringify(result));
+        process.exit(1);
+      }
+      results[mode].push(result);
+      const { chunks, ...row } = result;
+      console.log(JSON.stringify({ run, ...row, chunks: chunks.length }));
+    }
+  }
+
+  const summary = (list) => {
+    const out = {};
+    for (const key of ['busyMs', 'utilization', 'lagP99Ms', 'gcMs', 'cpuMs']) out[key] = median(list.map((r) => r[key]));
+    return out;
+  };
+  const js = summary(results.js);
+  const native = summary(results.native);
+  console.log(JSON.stringify({
+    file, pace, runs, js, native,
+    busyRatio: native.busyMs ? Number((js.busyMs / native.busyMs).toFixed(2)) : null,
+    chunks: compareChunks(results.js[0].chunks, results.native[0].chunks, toleranceMs),
+  }));
+  process.exit(0);
+}
+
+main();
@@ -0,0 +1,102 @@
+/**
+ * Capture replay runner
+ * Replays audio files through the native capture chain (startCapture with
+ * source 'file') and prints one JSON line per file: the chunks the addon cut,
+ * packet and delivery counters, CPU and wall time. Needs an addon built with
+ * use_avformat=1; no audio device is used.
+ *
+ *   node scripts/replay-capture.js [--realtime] [--min-chunk-ms=N] file.wav dir/ ...
+ */
+
+const fs = require('fs');
+const path = require('path');
+
+const AUDIO_EXTENSIONS = new Set(['.wav', '.flac', '.mp3', '.ogg', '.opus', '.m4a']);
+
+function loadAddon() {
+  const nativeDir = process.platform === 'darwin' ? 'native-coreaudio-loopback' : 'native-wasapi-loopback';
+  const addonName = process.platform === 'darwin' ? 'coreaudio_loopback.node' : 'wasapi_loopback.node';
+  return require(path.join(__dirname, '..', nativeDir, 'build', 'Release', addonName));
+}
+
+function collectFiles(args) {
+  const files = [];
+  for (const arg of args) {
+    if (fs.statSync(arg).isDirectory()) {
+      for (const name of fs.readdirSync(arg).sort()) {
+        if (AUDIO_EXTENSIONS.has(path.extname(name).toLowerCase())) files.push(path.join(arg, name));
+      }
+    } else {
+      files.push(arg);
+    }
+  }
+  return files;
+}
+
+// Same chunking the live capture handlers configure.
+function replay(addon, file, { pace, minChunkMs }) {
+  return new Promise((resolve) => {
+    const session = new addon.CaptureSession();
+    const chunks = [];
+    let discontinuities = 0;
+    let finished = false;
+    let poll = null;
+    const startCpu = process.cpuUsage();
+    const startMs = Date.now();
+    const finish = (ended) => {
+      if (finished) return;
+      finished = true;
+      clearInterval(poll);
+      const stats = session.getStats();
+      session.stop();
+      const cpu = process.cpuUsage(startCpu);
+      resolve({ file, ended, chunks, discontinuities, packets: stats.packets, delivery: stats.delivery,
+        processingMs: stats.processingMs, cpuMs: (cpu.user + cpu.system) / 1000, wallMs: Date.now() - startMs });
+    };
+    const started = session.start(0, (packet) => {
+      if (ArrayBuffer.isView(packet)) return;
+      if (packet.type === 'chunk') {
+        chunks.push({ sampleIndex: packet.sampleIndex, durationMs: packet.durationMs, reason: packet.reason,
+          overlapMs: packet.overlapMs, lufs: Number(packet.lufs.toFixed(1)) });
+      } else if (packet.type === 'discontinuity') {
+        discontinuities += packet.count;
+      } else if (packet.type === 'end') {
+        setImmediate(() => finish(true));
+      }
+    }, {
+      source: 'file', file, pace, format: 'pcm16', frameMs: 20, framesPerPacket: 5, vad: 'very-aggressive',
+      timestamps: true, queueDepth: 256,
+      chunker: { minChunkMs, maxChunkMs: 3000, pauseMs: 50, overlapMs: 100 },
+    });
+    if (!started) {
+      resolve({ file, ended: false, error: 'startCapture returned false' });
+      return;
+    }
+    // A file that cannot be opened stops the capture without an 'end' event
+    poll = setInterval(() => {
+      if (!session.running) setTimeout(() => finish(false), 500);
+    }, 250);
+  });
+}
+
+async function main() {
+  const args = process.argv.slice(2);
+  const pace = args.includes('--realtime') ? 'realtime' : 'fast';
+  const minChunkArg = args.find((a) => a.startsWith('--min-chunk-ms='));
+  const minChunkMs = minChunkArg ? Number(minChunkArg.split('=')[1]) : 1000;
+  const files = collectFiles(args.filter((a) => !a.startsWith('--')));
+  if (files.length === 0) {
+    console.error('usage: node scripts/replay-capture.js [--realtime] [--min-chunk-ms=N] file|dir ...');
+    process.exit(2);
+  }
+  const addon = loadAddon();
+  let failed = 0;
+  for (const file of files) {
+    const result = await replay(addon, file, { pace, minChunkMs });
+    if (!result.ended) failed++;
+    console.log(JSON.stringify(result));
+  }
+  process.exit(failed ? 1 : 0);
+}
+
+main();
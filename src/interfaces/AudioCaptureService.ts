@@ -5,6 +5,24 @@ export interface AudioDevice {
   groupId?: string;
 }
 
+// Pre-filter measurements of a segment, computed by the native capture addon
+// while it cut the utterance (see WhisperPreFilter for their meaning)
+export interface AudioFeatures {
+  dominantFrequency: number;
+  harmonicContent: number;
+  modulationDepth: number;
+  zeroCrossingRate: number;
+  spectralFlatness: number;
+  noiseRatio: number;
+}
+
+// Loudness of a segment the native capture addon has already conditioned
+// (capture option 'loudness': K-weighted normalization and a peak limiter)
+export interface AudioLoudness {
+  lufs: number;                      // BS.1770 integrated loudness
+  peakDb: number;                    // sample peak, dBFS
+}
+
 export interface AudioSegment {
   id: string;
   data: Float32Array;
@@ -12,6 +30,9 @@ export interface AudioSegment {
   channelCount: number;
   duration: number;
   timestamp: number;
+  features?: AudioFeatures;          // precomputed; analysis then skips the sample scans
+  loudness?: AudioLoudness;          // set when the addon already normalized the audio
+  traceId?: string;                  // latency trace of the utterance (services/LatencyTracer)
 }
 
 export interface AudioCaptureService {
@@ -40,6 +40,7 @@ import { CaptionsOverlayManager } from '../services/CaptionsOverlayManager';
 import { PTTOverlayManager } from '../services/PTTOverlayManager';
 import { AudioLevelOverlayManager } from '../services/AudioLevelOverlayManager';
 import { WhatsNewOverlayManager } from '../services/WhatsNewOverlayManager';
+import { registerLatencyTraceHandlers, tracedHandler } from '../services/LatencyTracer';
 
 // Global state for tracking TTS playback to filter out from WASAPI capture
 let isTtsPlaying = false;
@@ -543,6 +544,7 @@ except Exception as e:
     const wasapiModule = await import('./handlers/wasapi-handlers.js');
     const { registerWasapiHandlers } = wasapiModule;
     registerWasapiHandlers();
+    registerLatencyTraceHandlers();
     console.log('🎤 WASAPI IPC handlers initialized');
   } catch (error) {
     console.error('Failed to initialize WASAPI IPC handlers:', error);
@@ -846,8 +848,8 @@ except Exception as e:
   // Speech-to-text handlers - moved to handlers/translationPipelineHandlers.ts
 
   // Translation-only and TTS-only handlers
-  ipcMain.handle(IPC_CHANNELS.TRANSLATE_ONLY, handleTranslateOnly);
-  ipcMain.handle(IPC_CHANNELS.SYNTHESIZE_ONLY, handleSynthesizeOnly);
+  ipcMain.handle(IPC_CHANNELS.TRANSLATE_ONLY, tracedHandler('translate', handleTranslateOnly));
+  ipcMain.handle(IPC_CHANNELS.SYNTHESIZE_ONLY, tracedHandler('tts-synthesize', handleSynthesizeOnly));
   ipcMain.handle('tts:prefetch', handleTtsPrefetch);
 
   // Quick translate handlers - moved to handlers/quickTranslateHandlers.ts
@@ -2692,13 +2694,26 @@ async function handleTranslateOnly(
 ): Promise<IPCResponse<{ translatedText: string }>> {
   try {
     const configManager = ConfigurationManager.getInstance();
+    const { text, targetLanguage } = request.payload;
+    const sourceLanguage = request.payload.sourceLanguage || 'en';
+    // Repeated utterances come back from speech:transcribe's UtteranceCache with the
+    // same text, so their translation is already in the TTS cache's translation layer
+    const provider = getModelConfigFromConfig(configManager.getConfig())?.gptModel || 'default';
+    const cache = await getTTSCache();
+    const cached = cache.getCachedTranslation(text, targetLanguage, sourceLanguage, provider, false);
+    if (cached) {
+      console.log(`♻️ Reusing cached translation: "${text.substring(0, 50)}"`);
+      return {
+        id: request.id,
+        timestamp: Date.now(),
+        success: true,
+        payload: { translatedText: cached.translatedText }
+      };
+    }
     const { TranslationServiceManager } = await import('../services/TranslationServiceManager');
     const translationService = new TranslationServiceManager(configManager);
-    const result = await translationService.translate(
-      request.payload.text,
-      request.payload.targetLanguage,
-      request.payload.sourceLanguage || 'en'
-    );
+    const result = await translationService.translate(text, targetLanguage, sourceLanguage);
+    if (result.translatedText) cache.cacheTranslation(text, targetLanguage, sourceLanguage, provider, result);
     return {
       id: request.id,
       timestamp: Date.now(),
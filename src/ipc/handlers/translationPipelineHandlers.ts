@@ -16,6 +16,10 @@ import { ConfigurationManager } from '../../services/ConfigurationManager';
 import { OverlayStateManager } from '../../services/OverlayStateManager';
 import { getModelConfigFromConfig, getProcessingModeFromConfig } from '../../types/ConfigurationTypes';
 import { WhisperPreFilter } from '../../services/WhisperPreFilter';
+import { UtteranceCache } from '../../services/UtteranceCache';
+import { StreamedTranscription } from '../../services/StreamedTranscription';
+import { ChunkDifficultyRouter } from '../../services/ChunkDifficultyRouter';
+import { tracedHandler } from '../../services/LatencyTracer';
 import { AudioSegment } from '../../interfaces/AudioCaptureService';
 
 // Global WhisperPreFilter instance for anti-hallucination
@@ -423,7 +427,8 @@ async function processRealTimeAudio(audioSegment: any): Promise<void> {
           language: (appCfg.sourceLanguage || '').trim().toLowerCase() === 'auto'
             ? undefined
             : appCfg.sourceLanguage,
-          model: whisperModel
+          model: whisperModel,
+          stream: 'mic'
         });
         console.log(`🎤 Using LOCAL Whisper (${whisperModel}) for real-time transcription`);
       } catch (localError) {
@@ -944,12 +949,15 @@ async function handleGetTranslationStatus(
 
 async function handleSpeechTranscription(
   event: IpcMainInvokeEvent,
-  request: IPCRequest<{ audioData: number[]; language?: string; targetLanguage?: string; contentType?: string }>
-): Promise<IPCResponse<{ text: string; language?: string; duration?: number; skipped?: boolean; reason?: string }>> {
+  request: IPCRequest<{ audioData: number[]; language?: string; targetLanguage?: string; contentType?: string; fingerprint?: Uint32Array; timeMap?: Float64Array }>
+): Promise<IPCResponse<{ text: string; language?: string; duration?: number; segments?: { start: number; end: number; text: string }[]; skipped?: boolean; reason?: string }>> {
   console.log('🎤 Handling speech transcription request');
 
   try {
     const { audioData, language, targetLanguage, contentType } = request.payload;
+    const fingerprint = request.payload.fingerprint instanceof Uint32Array ? request.payload.fingerprint : undefined;
+    // A compacted chunk's (capture option chunker.compact) time map, set only when pauses were shortened
+    const timeMap = request.payload.timeMap instanceof Float64Array && request.payload.timeMap.length > 0 ? request.payload.timeMap : undefined;
     
     // Check if incoming translation optimization is enabled
     const configManager = ConfigurationManager.getInstance();
@@ -1098,7 +1106,30 @@ async function handleSpeechTranscription(
     // END ANTI-HALLUCINATION PRE-FILTER
     // ============================================
 
-    if (preferLocalWhisper) {
+    // A near-duplicate of an utterance transcribed before (same native fingerprint) reuses
+    // its transcript; the filters below still run on it as on a fresh one
+    const utteranceCache = fingerprint ? UtteranceCache.getInstance() : null;
+    const cachedUtterance = utteranceCache ? utteranceCache.lookup(fingerprint!, sourceLanguageSetting) : null;
+    if (cachedUtterance) {
+      languageDetectionResult = { ...cachedUtterance, segments: [] };
+      transcriptionResult = languageDetectionResult;
+      console.log(`♻️ Reusing cached transcript of a repeated utterance: "${cachedUtterance.text.substring(0, 50)}"`);
+    }
+
+    // An utterance uploaded while it was spoken (capture option chunker.stream) has its
+    // transcript on the way already; if that upload failed, the WAV goes the usual way
+    const streamedTranscript = fingerprint && !cachedUtterance ? StreamedTranscription.getInstance().take(fingerprint) : null;
+    if (streamedTranscript) {
+      try {
+        languageDetectionResult = { ...(await streamedTranscript), segments: [] };
+        transcriptionResult = languageDetectionResult;
+        console.log(`📡 Using streamed transcript: "${languageDetectionResult.text.substring(0, 50)}"`);
+      } catch (streamError) {
+        console.warn('⚠️ Streamed transcription failed, uploading the chunk instead:', streamError);
+      }
+    }
+
+    if (preferLocalWhisper && !languageDetectionResult) {
       try {
         const { LocalProcessingManager } = await import('../../services/LocalProcessingManager');
         const localManager = LocalProcessingManager.getInstance();
@@ -1110,7 +1141,8 @@ async function handleSpeechTranscription(
 
         const localTranscription = await localManager.transcribeAudio(Buffer.from(audioUint8Array), {
           language: sourceLanguageSetting === 'auto' ? undefined : sourceLanguageSetting,
-          model: whisperModel
+          model: whisperModel,
+          stream: 'loopback'
         });
 
         languageDetectionResult = {
@@ -1128,6 +1160,16 @@ async function handleSpeechTranscription(
       }
     }
 
+    // An easy chunk (native difficulty estimate) goes to a native Whisper model already
+    // resident rather than the paid cloud model; anything else, or a failure, goes on below
+    if (!languageDetectionResult && !preferLocalWhisper && fingerprint) {
+      const routed = await ChunkDifficultyRouter.getInstance().transcribeIfEasy(fingerprint, Buffer.from(audioUint8Array), sourceLanguageSetting);
+      if (routed) {
+        languageDetectionResult = { ...routed, segments: [] };
+        transcriptionResult = languageDetectionResult;
+      }
+    }
+
     // Only use cloud providers if a cloud model is explicitly selected (not a local fallback)
     if (!languageDetectionResult && !preferLocalWhisper) {
       // Keys are resolved by Whisper client from secure storage
@@ -1214,6 +1256,14 @@ async function handleSpeechTranscription(
       throw new Error('Failed to obtain transcription result');
     }
 
+    // Segment times of a compacted chunk count the shortened pauses; move them
+    // back onto the captured audio so they line up with the capture clock
+    if (timeMap && Array.isArray(transcriptionResult.segments)) {
+      const { chunkSourceMs } = await import('./wasapi-handlers');
+      const toSource = (seconds: number) => chunkSourceMs({ timeMap }, seconds * 1000) / 1000;
+      transcriptionResult.segments = transcriptionResult.segments.map((seg: any) => ({ ...seg, start: toSource(seg.start), end: toSource(seg.end) }));
+    }
+
     // ============================================
     // ANTI-HALLUCINATION POST-FILTER
     // Validate Whisper response to catch hallucinations
@@ -1335,6 +1385,14 @@ async function handleSpeechTranscription(
     // END ANTI-HALLUCINATION POST-FILTER
     // ============================================
 
+    if (utteranceCache && !cachedUtterance && transcribedText) {
+      utteranceCache.remember(fingerprint!, sourceLanguageSetting, {
+        text: transcribedText,
+        language: detectedLanguage,
+        duration: languageDetectionResult.duration
+      });
+    }
+
     console.log(`🌐 Detected language: ${detectedLanguage} | Text: "${transcribedText}"`);
 
     // CRITICAL: Skip English audio to prevent feedback loops
@@ -1690,12 +1748,32 @@ async function handleSpeechTranscription(
             }
           };
         }
-        // Use streaming TTS for lower latency
-        const streamingSupported = await streamingTTS.isStreamingSupported();
-        let audioBuffer: ArrayBuffer;
-
-        if (streamingSupported) {
+        // A local Piper voice speaks straight into the native TTS render when
+        // configured; otherwise use streaming TTS for lower latency
+        const { PiperTTSService } = await import('../../services/PiperTTSService');
+        const spoken = await PiperTTSService.getInstance().speak(ttsInput, finalTargetLanguage);
+        const streamingSupported = !spoken && await streamingTTS.isStreamingSupported();
+        let audioBuffer: ArrayBuffer | null = null;
+
+        if (spoken) {
+          console.log(`🗣️ Local TTS: ${spoken.sentences} sentence(s), first audio in ${spoken.firstAudioMs.toFixed(0)}ms, ${spoken.audioMs.toFixed(0)}ms of speech${spoken.cancelled ? ' (cancelled)' : ''}`);
+          try {
+            const { BrowserWindow } = require('electron');
+            for (const window of BrowserWindow.getAllWindows()) {
+              if (!window.isDestroyed()) {
+                window.webContents.send('realtime-tts-complete', {
+                  originalText: text,
+                  translatedText: translationResult.translatedText
+                });
+              }
+            }
+          } catch (error) {
+            console.warn('Failed to send TTS completion signal:', error);
+          }
+        } else if (streamingSupported) {
           console.log(`🎵 Streaming TTS synthesis with voice: ${voiceId}`);
+          // Played by the addon instead of the renderer when a native TTS render runs
+          const { renderTtsChunk, endTtsRender } = await import('./wasapi-handlers');
           const ttsStartTime = Date.now();
           let firstChunkTime: number | null = null;
           let audioChunks: ArrayBuffer[] = [];
@@ -1714,6 +1792,7 @@ async function handleSpeechTranscription(
 
               // Send each chunk immediately to renderer for real-time playback
               try {
+                const nativeRendered = renderTtsChunk(chunk, chunkIndex === 0, isFinal);
                 const chunkArray = Array.from(new Uint8Array(chunk));
 
                 if (chunkArray.length > 0) {
@@ -1728,6 +1807,7 @@ async function handleSpeechTranscription(
                         isFirstChunk: chunkIndex === 0,
                         isFinal: isFinal,
                         bufferSize: chunk.byteLength,
+                        nativeRendered,
                         originalText: text,
                         translatedText: translationResult.translatedText
                       });
@@ -1746,6 +1826,7 @@ async function handleSpeechTranscription(
             () => {
               // Streaming complete callback - send final signal to renderer
               console.log('✅ TTS streaming completed, sending final signal to renderer');
+              endTtsRender();
               try {
                 const { BrowserWindow } = require('electron');
                 const windows = BrowserWindow.getAllWindows();
@@ -1774,29 +1855,31 @@ async function handleSpeechTranscription(
         }
 
         // Send audio to renderer for playback - but mark it as real-time to prevent re-capture
-        console.log(`🔊 Sending audio to renderer for playback (real-time mode)`);
-        try {
-          const audioArray = Array.from(new Uint8Array(audioBuffer));
-
-          const { BrowserWindow } = await import('electron');
-          const windows = BrowserWindow.getAllWindows();
-
-          for (const window of windows) {
-            if (!window.isDestroyed()) {
-              // Use a different event name to distinguish from test playback
-              window.webContents.send('realtime-translation-audio', {
-                audioData: audioArray,
-                originalText: text,
-                translatedText: translationResult.translatedText,
-                outputToVirtualMic: processingOrchestrator.config.outputToVirtualMic,
-                isRealTime: true // Flag to prevent re-capture
-              });
+        if (audioBuffer) {
+          console.log(`🔊 Sending audio to renderer for playback (real-time mode)`);
+          try {
+            const audioArray = Array.from(new Uint8Array(audioBuffer));
+
+            const { BrowserWindow } = await import('electron');
+            const windows = BrowserWindow.getAllWindows();
+
+            for (const window of windows) {
+              if (!window.isDestroyed()) {
+                // Use a different event name to distinguish from test playback
+                window.webContents.send('realtime-translation-audio', {
+                  audioData: audioArray,
+                  originalText: text,
+                  translatedText: translationResult.translatedText,
+                  outputToVirtualMic: processingOrchestrator.config.outputToVirtualMic,
+                  isRealTime: true // Flag to prevent re-capture
+                });
+              }
             }
-          }
 
-          console.log('✅ Audio sent to renderer for playback');
-        } catch (audioError) {
-          console.warn('⚠️ Audio sending failed:', audioError);
+            console.log('✅ Audio sent to renderer for playback');
+          } catch (audioError) {
+            console.warn('⚠️ Audio sending failed:', audioError);
+          }
         }
 
         // Update feedback prevention tracking
@@ -1850,7 +1933,9 @@ async function handleSpeechTranscription(
       payload: {
         text: transcriptionResult.text,
         language: transcriptionResult.language,
-        duration: transcriptionResult.duration
+        duration: transcriptionResult.duration,
+        // In seconds from the chunk's first captured sample, compacted pauses restored
+        segments: (transcriptionResult.segments || []).map((seg: any) => ({ start: seg.start, end: seg.end, text: seg.text }))
       }
     };
 
@@ -1905,7 +1990,8 @@ async function handlePushToTalkTranscription(
         console.log(`🎤 Using LOCAL Whisper (${whisperModel}) for push-to-talk transcription`);
         transcriptionResult = await localManager.transcribeAudio(nodeAudioBuffer, {
           language: language === 'auto' ? undefined : language,
-          model: whisperModel
+          model: whisperModel,
+          stream: 'mic'
         });
       } catch (localError) {
         // Don't fallback to cloud providers when local model is selected
@@ -2043,7 +2129,7 @@ export function registerTranslationPipelineHandlers(): void {
 
     // Audio/Speech handlers
     try { ipcMain.removeHandler(IPC_CHANNELS.TRANSCRIBE); } catch {}
-    ipcMain.handle(IPC_CHANNELS.TRANSCRIBE, handleSpeechTranscription);
+    ipcMain.handle(IPC_CHANNELS.TRANSCRIBE, tracedHandler('stt', handleSpeechTranscription));
 
     try { ipcMain.removeHandler(IPC_CHANNELS.TRANSCRIBE_PUSH_TO_TALK); } catch {}
     ipcMain.handle(IPC_CHANNELS.TRANSCRIBE_PUSH_TO_TALK, handlePushToTalkTranscription);
@@ -1,15 +1,164 @@
-import { ipcMain, IpcMainInvokeEvent, desktopCapturer, BrowserWindow, app } from 'electron';
+import { ipcMain, IpcMainInvokeEvent, desktopCapturer, BrowserWindow, app, dialog, OpenDialogOptions } from 'electron';
 import * as fs from 'fs';
 import * as path from 'path';
 import { ConfigurationManager } from '../../services/ConfigurationManager';
 import { getTtsPlaybackState } from '../handlers.js';
 import { AudioLevelOverlayManager } from '../../services/AudioLevelOverlayManager';
+import { AudioFeatures } from '../../interfaces/AudioCaptureService';
+import { getProcessingModeFromConfig } from '../../types/ConfigurationTypes';
+import { newTraceId, traceNativeChunk, traceNowMs, traceSpan } from '../../services/LatencyTracer';
+import { RepeatedAudioFilter } from '../../services/AudioFingerprint';
+import { ChunkStreamPart, StreamedTranscription } from '../../services/StreamedTranscription';
+import { ChunkDifficulty, ChunkDifficultyRouter } from '../../services/ChunkDifficultyRouter';
+import { CaptureHost } from '../../services/CaptureHost';
+import type { CaptureHostControl } from '../../services/CaptureHostProtocol';
 
 
 let isTtsPlaying = false;
 let ttsPlaybackStartTime = 0;
 let ttsPlaybackEndTime = 0;
 
+// Capture addons run with format 'pcm16': packets arrive as headerless 16-bit
+// Int16Arrays, preceded by one descriptor call carrying the stream format.
+interface CaptureFormatEvent {
+	type: 'format';
+	sampleFormat: 'pcm16' | 'float32';
+	encoding?: 'base64' | 'realtime-append'; // the text formats: packets are Buffers of base64
+	sampleRate: number;
+	channels: number;
+	packetSamples: number;
+	chunker?: boolean; // utterances arrive as CaptureChunkEvents
+}
+// Sent when the capture device's format changes mid-stream and the addon
+// reconfigures in place, or reopens its client on a new default device,
+// after the device went away, to recover a stall or after switchSource();
+// packets keep the format above.
+interface CaptureFormatChangedEvent extends Omit<CaptureFormatEvent, 'type'> {
+	type: 'format-changed';
+	reason: 'default-output' | 'default-input' | 'device-lost' | 'sample-rate' | 'stream-format' | 'stall' | 'source' | 'idle';
+	inputSampleRate: number;
+	inputChannels: number;
+}
+// One utterance cut by the addon's chunker (capture option `chunker`); wav is
+// 16 kHz mono 16-bit and starts with the previous chunk's overlap. lufs/peakDb
+// and features (the WhisperPreFilter measurements) cover the chunk's own frames.
+interface CaptureChunkEvent {
+	type: 'chunk';
+	wav: Buffer;
+	reason: 'pause' | 'max-length' | 'silence' | 'speaker';
+	durationMs: number;
+	overlapMs: number;
+	pauseMs: number;
+	trimmedMs?: number; // chunker.trimMs: non-speech left out at its ends
+	// Option chunker.compact: what its long pauses lost, and (chunk ms, ms since
+	// its first captured sample) pairs where its time jumps; see chunkSourceMs
+	compactedMs?: number;
+	timeMap?: Float64Array;
+	lufs: number;   // BS.1770 integrated loudness
+	peakDb: number; // sample peak, dBFS
+	features: AudioFeatures;
+	// Perceptual fingerprint of the chunk's frames (one Haitsma-Kalker word per
+	// VAD frame); absent on chunks too short to have one or from older addons
+	fingerprint?: Uint32Array;
+	// Capture option `timestamps`: the first sample's index in the stream and
+	// its capture time on the addon's deviceClockMs() clock (0 when unknown)
+	sampleIndex?: number;
+	captureTimeMs?: number;
+	// Also with `timestamps`: the latency trace ID and when the chunk left the
+	// DSP chain, entered the addon's queue and reached this callback, on the
+	// same clock (services/LatencyTracer)
+	trace?: { id: number; processedMs: number; queuedMs: number; deliveredMs: number };
+	// Option chunker.stream: the CaptureChunkStreamEvents that carried it ahead
+	streamId?: number;
+	// Capture option `content`: mean speech/music/noise probabilities of the
+	// chunk and the three for each 100 ms of it (native content classifier)
+	content?: { speech: number; music: number; noise: number; timeline: Float32Array };
+	// Capture option `languageId`: the utterance's spoken language, once its
+	// first second named one with enough confidence (Whisper's code)
+	language?: { code: string; confidence: number };
+	// Capture option `speaker`: the chunk's speaker cluster (0, 1, ...); reason
+	// 'speaker' when the addon cut it at a turn change
+	speaker?: number;
+	// Option chunker.adaptive: the speaker's syllables a second the chunk's
+	// thresholds were scaled by (0 until two seconds of their speech)
+	syllableRate?: number;
+	// How hard the chunk should be to transcribe, for routing easy ones to a
+	// local model (services/ChunkDifficultyRouter); absent from older addons
+	difficulty?: ChunkDifficulty;
+}
+// Option chunker.stream: the open utterance's audio since the previous part,
+// every intervalMs from its onset; its chunk follows the part with end set
+// (services/StreamedTranscription).
+interface CaptureChunkStreamEvent extends ChunkStreamPart {
+	type: 'chunk-stream';
+	sampleIndex: number; // the utterance's first sample, as on its chunk
+}
+// Input the capture device lost (WASAPI data discontinuity, CoreAudio
+// overrun or sample-time gap) since the last one, before stream sample
+// sampleIndex.
+interface CaptureDiscontinuityEvent {
+	type: 'discontinuity';
+	count: number;
+	total: number;
+	sampleIndex: number;
+}
+// The capture device stopped delivering while it should have; the addon took
+// `step` to bring it back after stalledMs, then sends 'recovered' once frames
+// flow again (native-audio-core/capture_watchdog.h).
+interface CaptureStallEvent {
+	type: 'stall';
+	step: 'restart' | 'reinitialize' | 'reactivate' | 'recovered';
+	stalledMs: number;
+	sampleIndex: number;
+}
+// Capture option `dtx`: packets stop after the hangover and resume with a
+// pre-roll; sampleIndex is the first packet delivered again, silentMs what
+// was never delivered.
+interface CaptureSilenceEvent {
+	type: 'silence-start' | 'silence-end';
+	sampleIndex: number;
+	silentMs?: number;
+}
+// Capture option `governor`: the DSP stepped its quality down (load-high) or
+// back up (load-low) because of how much of real time its blocks took (load,
+// 0..1); level applies from stream sample sampleIndex. Reason 'power' when
+// option `power` moved the level to its profile's floor.
+interface CaptureQualityEvent {
+	type: 'quality';
+	level: 'full' | 'light-resampler' | 'no-denoise' | 'sparse-features';
+	reason: 'load-high' | 'load-low' | 'power';
+	load: number;
+	sampleIndex: number;
+}
+// Capture option `power`: the profile for the power source now in force, at
+// the start and on every switch between mains and battery
+interface CapturePowerEvent {
+	type: 'power';
+	source: 'ac' | 'battery' | 'unknown';
+	quality: CaptureQualityEvent['level'];
+	throttleMs: number;
+	latencyMode: 'default' | 'lowest' | 'powersave';
+	sampleIndex: number;
+}
+// Capture option `idle`: the device stream was released after nothing played
+// for the idle time (idle true), or reopened idleMs later when a session started
+interface CaptureIdleEvent {
+	type: 'idle';
+	idle: boolean;
+	idleMs: number;
+	sampleIndex: number;
+}
+// Capture option `keyword`: the native spotter heard `keyword` (a label of the
+// model) at stream sample sampleIndex; chunks flow for the next windowMs.
+interface CaptureKeywordEvent {
+	type: 'keyword';
+	keyword: string;
+	score: number;
+	sampleIndex: number;
+	windowMs: number;
+}
+type CapturePacket = Int16Array | CaptureFormatEvent | CaptureFormatChangedEvent | CaptureChunkEvent | CaptureChunkStreamEvent | CaptureDiscontinuityEvent | CaptureStallEvent | CaptureSilenceEvent | CaptureQualityEvent | CapturePowerEvent | CaptureIdleEvent | CaptureKeywordEvent;
+
 
 /**
  * WASAPI Handlers
@@ -83,6 +232,49 @@ function resolveWasapiPath(): string | null {
 
 // Audio addon loading and management (platform-aware)
 let wasapiAddon: any = null; // Actually holds either WASAPI or CoreAudio addon
+let nativeLevelMeter = false; // overlay levels arrive from the event bus or watchLevels()
+let nativeVoiceBoost = false; // the addon's compressor boosts captured audio; applyVoiceBoost is a no-op
+
+function updateOverlayLevels(bands: Float32Array): void {
+  AudioLevelOverlayManager.getInstance().updateBidiAudio(Array.from(bands, (level) => Math.max(0.15, level)));
+}
+
+interface NativeEventBatch {
+  length: number;
+  types: Array<'levels' | 'session' | 'log'>;
+  dropped: number;
+  at(i: number): any;
+}
+
+// One call per main-thread tick from the addon's event bus; only the events
+// handled here are materialized
+function onNativeEvents(batch: NativeEventBatch): void {
+  const levels = batch.types.lastIndexOf('levels');
+  if (levels >= 0) updateOverlayLevels(batch.at(levels).bands);
+  batch.types.forEach((type, i) => {
+    if (type !== 'log') return;
+    const entry = batch.at(i);
+    console.log(`[addon] ${entry.message}`);
+  });
+  if (batch.dropped > 0) console.warn(`[addon] ${batch.dropped} native events dropped`);
+}
+
+// Capture callbacks run with option batch: the addon makes one call per
+// wakeup with everything it delivers, and this hands the items to the
+// callback one at a time as before. Calls from addons without the option
+// pass through.
+function unbatched<P>(callback: (packet: P, speech?: number, time?: { sampleIndex: number; captureTimeMs: number }) => void) {
+  return (first: any, speech?: number, time?: { sampleIndex: number; captureTimeMs: number }): void => {
+    if (!Array.isArray(first)) {
+      callback(first, speech, time);
+      return;
+    }
+    for (const item of first) {
+      if (item.type === 'packet') callback(item.data, item.speech, item.time);
+      else callback(item);
+    }
+  };
+}
 
 function loadWasapiAddon(): boolean {
   if (wasapiAddon) {
@@ -104,6 +296,30 @@ function loadWasapiAddon(): boolean {
     wasapiAddon = require(addonPath);
     console.log(`[main] ${platform === 'darwin' ? 'CoreAudio' : 'WASAPI'} addon loaded successfully`);
     console.log(`[main] ${platform === 'darwin' ? 'CoreAudio' : 'WASAPI'} addon exports:`, Object.keys(wasapiAddon));
+    // Levels and logs share the addon's event bus: one main-thread call per
+    // tick for all of them, whatever else the bus carries later
+    const eventBus = typeof wasapiAddon.subscribeEvents === 'function';
+    // Native logging is silent by default; echo it in development builds
+    if (!app.isPackaged && typeof wasapiAddon.setLogLevel === 'function') {
+      wasapiAddon.setLogLevel('info', !eventBus);
+    }
+    // Keep the native session table live so app enumeration doesn't re-walk audio sessions
+    if (typeof wasapiAddon.watchAudioSessions === 'function') {
+      const watching = wasapiAddon.watchAudioSessions();
+      console.log(`[main] Audio session registry ${watching ? 'started' : 'unavailable'}`);
+    }
+    // Overlay bars come from the addon's band meter at the repaint rate instead of per packet
+    if (eventBus) {
+      nativeLevelMeter = wasapiAddon.subscribeEvents(onNativeEvents, { levels: 30, logs: !app.isPackaged });
+    } else if (typeof wasapiAddon.watchLevels === 'function') {
+      nativeLevelMeter = wasapiAddon.watchLevels(updateOverlayLevels, { rateHz: 30 });
+    }
+    // Voice boost runs in the capture chain; the toggles below update it live
+    if (typeof wasapiAddon.setVoiceBoostLevel === 'function') {
+      wasapiAddon.setVoiceBoostLevel(voiceBoostLevel);
+      wasapiAddon.setVoiceBoostEnabled(voiceBoostEnabled);
+      nativeVoiceBoost = true;
+    }
     return true;
   } catch (e) {
     const platform = process.platform;
@@ -120,12 +336,13 @@ let voiceBoostLevel = 10.0; // Default 10x boost for quiet audio (adjust from 1.
 /**
  * Apply voice boost to PCM audio data
  * Uses RMS normalization + compression + soft limiting for whisper-level speech
+ * Skipped when the capture addon applies the same boost natively (nativeVoiceBoost)
  * @param pcmData Raw 16-bit PCM audio buffer
  * @param boostLevel Multiplier (1.0 = no boost, 3.0 = 3x, 6.0 = 6x max)
  * @returns Boosted PCM buffer
  */
 function applyVoiceBoost(pcmData: Buffer, boostLevel: number = voiceBoostLevel): Buffer {
-  if (!voiceBoostEnabled || boostLevel <= 1.0) {
+  if (nativeVoiceBoost || !voiceBoostEnabled || boostLevel <= 1.0) {
     return pcmData;
   }
   
@@ -211,11 +428,15 @@ function applyVoiceBoost(pcmData: Buffer, boostLevel: number = voiceBoostLevel):
 // Expose voice boost controls
 export function setVoiceBoostEnabled(enabled: boolean): void {
   voiceBoostEnabled = enabled;
+  if (nativeVoiceBoost) wasapiAddon.setVoiceBoostEnabled(enabled);
+  if (nativeVoiceBoost && CaptureHost.getInstance().isRunning()) void loopbackControl(true, 'setVoiceBoostEnabled', enabled);
   console.log(`[VoiceBoost] ${enabled ? 'Enabled' : 'Disabled'}`);
 }
 
 export function setVoiceBoostLevel(level: number): void {
   voiceBoostLevel = Math.max(1.0, Math.min(50.0, level)); // Clamp between 1.0 and 50.0
+  if (nativeVoiceBoost) wasapiAddon.setVoiceBoostLevel(voiceBoostLevel);
+  if (nativeVoiceBoost && CaptureHost.getInstance().isRunning()) void loopbackControl(true, 'setVoiceBoostLevel', voiceBoostLevel);
   console.log(`[VoiceBoost] Level set to ${voiceBoostLevel.toFixed(1)}x`);
 }
 
@@ -223,6 +444,1074 @@ export function getVoiceBoostSettings(): { enabled: boolean; level: number } {
   return { enabled: voiceBoostEnabled, level: voiceBoostLevel };
 }
 
+// Incremental decoder for streamed TTS audio: feed() returns the mono pcm16 that
+// the bytes received so far complete, close() the decoder's tail
+export interface TtsStreamDecoder {
+  readonly id: string; // for NativeRenderSession.pushDecoded
+  feed(bytes: Buffer): Int16Array;
+  close(): Int16Array;
+}
+
+let ttsDecoderSeq = 0;
+
+// Null when the addon isn't loaded or was built without use_avcodec
+export function openTtsStreamDecoder(codec: 'mp3' | 'aac' | 'opus', sampleRate: number): TtsStreamDecoder | null {
+  if (!wasapiAddon || typeof wasapiAddon.openStreamDecoder !== 'function') return null;
+  const id = `tts-${++ttsDecoderSeq}`;
+  try {
+    wasapiAddon.openStreamDecoder(id, codec, { sampleRate });
+  } catch (error) {
+    console.warn('[TTS] Native stream decoder unavailable:', error);
+    return null;
+  }
+  return {
+    id,
+    feed: (bytes: Buffer) => wasapiAddon.feedStreamDecoder(id, bytes),
+    close: () => wasapiAddon.closeStreamDecoder(id) ?? new Int16Array(0),
+  };
+}
+
+// Native soundboard engine: clips decoded once into memory-mapped caches and
+// mixed by the addon's own output streams, so a trigger never decodes
+export interface NativeSoundboard {
+  probe(path: string): Promise<{ durationMs: number; format: string; codec: string; sampleRate: number; channels: number }>;
+  load(id: string, path: string, cacheDir: string): Promise<{ frames: number; durationMs: number; cached: boolean }>;
+  unload(id: string): boolean;
+  play(id: string, gain?: number): boolean;
+  stop(id?: string): void;
+  isPlaying(id: string): boolean;
+  setVolumes(volumes: { mic?: number; monitor?: number }): void;
+  startOutput(options?: { micDevice?: string; monitor?: boolean }): { mic: string | null; monitor: string | null };
+  stopOutput(): void;
+}
+
+// Null when the addon can't be loaded or predates the soundboard engine
+export function getNativeSoundboard(): NativeSoundboard | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.loadSoundClip !== 'function') return null;
+  return {
+    probe: (p) => wasapiAddon.probeSoundClip(p),
+    load: (id, p, cacheDir) => wasapiAddon.loadSoundClip(id, p, { cacheDir }),
+    unload: (id) => wasapiAddon.unloadSoundClip(id),
+    play: (id, gain) => wasapiAddon.playSoundClip(id, gain === undefined ? undefined : { gain }),
+    stop: (id) => { id === undefined ? wasapiAddon.stopSoundClip() : wasapiAddon.stopSoundClip(id); },
+    isPlaying: (id) => wasapiAddon.isSoundClipPlaying(id),
+    setVolumes: (volumes) => { wasapiAddon.setSoundboardVolumes(volumes); },
+    startOutput: (options) => wasapiAddon.startSoundboardOutput(options ?? {}),
+    stopOutput: () => { wasapiAddon.stopSoundboardOutput(); },
+  };
+}
+
+// In-process whisper.cpp engine: model contexts kept loaded for the app's
+// lifetime (up to two models, memory-mapped, one context per path), fed the
+// chunker's 16 kHz WAV buffers directly. Chunks tagged with different streams
+// decode on parallel lanes, served round-robin. load() of a resident model
+// resolves at once with reused; background loads at low priority (pre-warm).
+export interface NativeWhisper {
+  // device: 'cpu', 'gpu' (the first) or 'gpu:<n>' as backends() lists them
+  load(modelPath: string, options?: { device?: string; lanes?: number; background?: boolean }): Promise<{
+    multilingual: boolean;
+    loadMs: number;
+    warmupMs: number;
+    lanes: number;
+    reused: boolean;
+    device: string;
+    quantization: string; // the file's weight type: 'f16', 'q8_0', 'q5_1'...
+    weightsMb: number;
+    memoryMb: number; // resident memory the load added
+  }>;
+  // maxStaleMs: the chunk's deadline after captureTimeMs (deviceClockMs()); a
+  // chunk expected past it is merged, decoded cheaply or dropped (shed).
+  // draft: a smaller resident model that decodes first; its text stands when
+  // confident, else the model decodes it again
+  transcribe(audio: Buffer | Int16Array | Float32Array, options?: { language?: string; prompt?: string; translate?: boolean; threads?: number; stream?: string; model?: string; captureTimeMs?: number; maxStaleMs?: number; draft?: string | WhisperDraftOptions }): Promise<{
+    text: string;
+    language: string;
+    segments: Array<{ startMs: number; endMs: number; text: string }>;
+    processingMs: number;
+    shed?: WhisperShed;
+    draft?: WhisperDraft;
+  }>;
+  unload(model?: string): Promise<void>; // one resident model, or all
+  stats(): WhisperSchedulerStats;
+  // Sliding-window streaming on the resident model (whisper_stream.h)
+  openStream(id: string, onEvent: (event: WhisperStreamEvent) => void, options?: { windowMs?: number; hopMs?: number; language?: string; translate?: boolean; threads?: number; encoder?: 'window' | 'full' }): void;
+  feedStream(id: string, audio: Int16Array | Float32Array | Buffer): void;
+  flushStream(id: string): Promise<{ text: string }>;
+  closeStream(id: string): Promise<{ text: string }>;
+  // ggml devices in this build, and rtf (processing / audio time) of one model on each (whisper_backends.h)
+  backends(): Promise<WhisperBackend[]>;
+  benchmark(modelPath: string, options?: { devices?: string[]; seconds?: number; language?: string }): Promise<WhisperBenchmarkResult[]>;
+}
+
+export interface WhisperBackend {
+  device: string; // 'cpu' | 'gpu:<n>'
+  backend: string; // CPU, CUDA, Vulkan, Metal...
+  description: string;
+  gpu: boolean;
+  memoryMb: number;
+}
+
+export interface WhisperBenchmarkResult {
+  device: string;
+  backend: string;
+  ok: boolean;
+  error?: string;
+  loadMs: number;
+  processingMs: number;
+  audioMs: number;
+  rtf: number;
+}
+
+export interface WhisperSchedulerStats {
+  lanes: number;
+  threadsPerLane: number;
+  queued: number;
+  running: number;
+  completed: number;
+  avgQueueMs: number;
+  avgRunMs: number;
+  maxQueueMs: number; // since the previous stats() call
+  streams: Record<string, number>; // queued jobs per stream
+  models: string[]; // resident model paths, the default (whose scheduler this is) first
+  shed: { merged: number; downgraded: number; dropped: number }; // chunks past their maxStaleMs deadline
+  draft: { accepted: number; rejected: number }; // chunks the draft model answered, and ones decoded again
+}
+
+// The floors a draft's text must clear: mean token log-probability
+// (-5..0, default -0.3) and least token probability (0..1, default 0.2)
+export interface WhisperDraftOptions {
+  model: string;
+  minAvgLogprob?: number;
+  minTokenP?: number;
+}
+
+export interface WhisperDraft {
+  model: string;
+  accepted: boolean; // the text is the draft's
+  avgLogprob: number;
+  minTokenP: number;
+}
+
+// merged: decoded with the stream's queued chunks, the text on the oldest
+// (merged = how many); downgraded: a cheap decode or a smaller model;
+// dropped: never decoded, the text empty
+export interface WhisperShed {
+  action: 'merged' | 'downgraded' | 'dropped';
+  lateMs: number; // expected past the deadline
+  merged?: number;
+  model?: string;
+}
+
+export type WhisperStreamEvent =
+  | { type: 'partial'; committed: string; stable: string; tentative: string; audioMs: number; processingMs: number; encodedMs: number; melReused: number }
+  | { type: 'error'; message: string };
+
+// Null when the addon can't be loaded or predates the whisper engine; a build
+// without use_whisper still returns an engine whose load() rejects
+export function getNativeWhisper(): NativeWhisper | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.loadWhisperModel !== 'function') return null;
+  return {
+    load: (modelPath, options) => wasapiAddon.loadWhisperModel(modelPath, options ?? {}),
+    transcribe: (audio, options) => wasapiAddon.transcribeWhisper(audio, options ?? {}),
+    unload: (model) => model === undefined ? wasapiAddon.unloadWhisperModel() : wasapiAddon.unloadWhisperModel(model),
+    stats: () => typeof wasapiAddon.getWhisperSchedulerStats === 'function'
+      ? wasapiAddon.getWhisperSchedulerStats()
+      : { lanes: 0, threadsPerLane: 0, queued: 0, running: 0, completed: 0, avgQueueMs: 0, avgRunMs: 0, maxQueueMs: 0, streams: {}, models: [], shed: { merged: 0, downgraded: 0, dropped: 0 }, draft: { accepted: 0, rejected: 0 } },
+    openStream: (id, onEvent, options) => { wasapiAddon.openWhisperStream(id, onEvent, options ?? {}); },
+    feedStream: (id, audio) => { wasapiAddon.feedWhisperStream(id, audio); },
+    flushStream: (id) => wasapiAddon.flushWhisperStream(id),
+    closeStream: (id) => wasapiAddon.closeWhisperStream(id),
+    backends: async () => typeof wasapiAddon.listWhisperBackends === 'function' ? wasapiAddon.listWhisperBackends() : [],
+    benchmark: async (modelPath, options) => typeof wasapiAddon.benchmarkWhisper === 'function'
+      ? wasapiAddon.benchmarkWhisper(modelPath, options ?? {})
+      : [],
+  };
+}
+
+// In-process CTranslate2 engine for installed Argos packages: each pair's model
+// and tokenizer load once and stay resident; translate() sends every sentence
+// of its texts to the model as one batch (via English when only the two
+// halves are loaded). translatePartial() takes a streaming caption's whole text
+// so far: closed sentences come from the stream's cache and the open one only
+// decodes past the prefix consecutive updates agreed on; final forgets the stream
+export interface NativeTranslator {
+  load(packageDir: string, from: string, to: string, options?: { lanes?: number; threads?: number; computeType?: TranslationComputeType }): Promise<NativeTranslationModel & { loadMs: number }>;
+  translate(texts: string[], from: string, to: string, options?: { beamSize?: number }): Promise<{ texts: string[]; pivot: boolean; processingMs: number }>;
+  translatePartial(stream: string, text: string, from: string, to: string, options?: { final?: boolean; beamSize?: number }): Promise<PartialTranslation>;
+  unload(): Promise<void>;
+  loaded(): NativeTranslationModel[];
+}
+
+export interface PartialTranslation {
+  text: string; // committed + tentative
+  committed: string; // later updates keep it
+  tentative: string; // the next update may still change it
+  reusedSentences: number;
+  prefixTokens: number; // forced, not searched
+  decodedTokens: number;
+  pivot: boolean;
+  processingMs: number;
+}
+
+// 'default' keeps the package's saved weights; the others convert at load
+export type TranslationComputeType = 'default' | 'auto' | 'int8' | 'int8_float32' | 'int16' | 'float32';
+
+export interface NativeTranslationModel {
+  from: string;
+  to: string;
+  computeType: TranslationComputeType;
+  weightsMb: number; // model.bin as saved
+  memoryMb: number; // resident memory the load added
+}
+
+// Null when the addon can't be loaded or predates the translation engine; a
+// build without use_ctranslate2 still returns an engine whose load() rejects
+export function getNativeTranslator(): NativeTranslator | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.loadTranslationModel !== 'function') return null;
+  return {
+    load: (packageDir, from, to, options) => wasapiAddon.loadTranslationModel(packageDir, from, to, options ?? {}),
+    translate: (texts, from, to, options) => wasapiAddon.translateTexts(texts, from, to, options ?? {}),
+    translatePartial: (stream, text, from, to, options) => typeof wasapiAddon.translatePartial === 'function'
+      ? wasapiAddon.translatePartial(stream, text, from, to, options ?? {})
+      : Promise.reject(new Error('translatePartial is not in this addon build')),
+    unload: () => wasapiAddon.unloadTranslationModels(),
+    loaded: () => wasapiAddon.getTranslationModels(),
+  };
+}
+
+// Live captions: with streamingCaptions on in local mode, the capture's 16 kHz
+// stream feeds a native whisper stream and the renderer gets
+// 'wasapi:caption-partial' every hop and 'wasapi:caption-final' at stop,
+// instead of waiting for each utterance chunk to close.
+const CAPTION_STREAM_ID = 'captions';
+let captionStreamOpen = false;
+
+function startCaptionStream(webContentsId: number, language: string): void {
+  const config: any = ConfigurationManager.getInstance().getConfig();
+  if (!config.uiSettings?.streamingCaptions || getProcessingModeFromConfig(config) !== 'local') return;
+  const whisper = getNativeWhisper();
+  if (!whisper || typeof wasapiAddon.openWhisperStream !== 'function' || typeof wasapiAddon.subscribe !== 'function') return;
+  const send = (channel: string, payload: unknown) => {
+    const { webContents } = require('electron');
+    const wc = webContents.fromId(webContentsId);
+    if (wc && !wc.isDestroyed()) wc.send(channel, payload);
+  };
+  try {
+    whisper.openStream(CAPTION_STREAM_ID, (streamEvent) => send('wasapi:caption-partial', streamEvent), {
+      windowMs: 5000,
+      hopMs: 500,
+      language: language || 'auto'
+    });
+    wasapiAddon.subscribe('whisper-stream', (packet: CapturePacket) => {
+      if (!ArrayBuffer.isView(packet) || packet.length === 0) return;
+      whisper.feedStream(CAPTION_STREAM_ID, packet as Int16Array);
+    }, { format: 'pcm16', frameMs: 20, framesPerPacket: 5 });
+    captionStreamOpen = true;
+    console.log('[main] Streaming captions enabled (native Whisper, 5 s window / 500 ms hop)');
+  } catch (error) {
+    console.warn('[main] Streaming captions unavailable:', error);
+  }
+}
+
+async function stopCaptionStream(webContentsId: number): Promise<void> {
+  if (!captionStreamOpen) return;
+  captionStreamOpen = false;
+  wasapiAddon.unsubscribe('whisper-stream');
+  try {
+    const final = await wasapiAddon.closeWhisperStream(CAPTION_STREAM_ID);
+    const { webContents } = require('electron');
+    const wc = webContents.fromId(webContentsId);
+    if (wc && !wc.isDestroyed()) wc.send('wasapi:caption-final', final);
+  } catch (error) {
+    console.warn('[main] Final caption pass failed:', error);
+  }
+}
+
+// The default capture as OpenAI realtime input: 24 kHz pcm16 in 40 ms
+// 'realtime-append' packets (native-audio-core/pcm_channel.h), each one a whole
+// input_audio_buffer.append message to send as is. Returns the unsubscribe;
+// null when the addon can't be loaded or predates the format.
+export function subscribeRealtimeInput(name: string, onFrame: (frame: Buffer) => void): (() => void) | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.subscribe !== 'function') return null;
+  try {
+    wasapiAddon.subscribe(name, (packet: Buffer | CapturePacket) => {
+      if (Buffer.isBuffer(packet) && packet.length > 0) onFrame(packet);
+    }, { format: 'realtime-append', sampleRate: 24000, frameMs: 20, framesPerPacket: 2 });
+  } catch (error) {
+    console.warn('[Realtime] Native append frames unavailable:', error);
+    return null;
+  }
+  return () => { wasapiAddon.unsubscribe(name); };
+}
+
+// A native pipeline graph (native-audio-core/pipeline_graph.h): the capture's
+// utterance chunks go to the native encoder, uploader, Whisper, translation
+// and Piper voice without passing through JS; only these events come back.
+// The upload node posts to the same OpenAI-compatible endpoint as
+// WhisperApiClient / DeepInfraWhisperClient (native-audio-core/http_upload.h).
+export interface NativePipelineSpec {
+  capture: Record<string, unknown>; // subscribe() options; vad and chunker required
+  encode?: { format: 'wav' | 'flac' | 'opus'; level?: number; complexity?: number; bitrate?: number };
+  upload?: NativeUploadTemplate; // needs encode
+  transcribe?: { model?: string; language?: string; translate?: boolean; prompt?: string; threads?: number; draft?: string | WhisperDraftOptions; maxStaleMs?: number };
+  translate?: { to: string; from?: string; beamSize?: number };
+  speak?: { session: unknown; voice: string; speakerId?: number; lengthScale?: number; sentenceSilenceMs?: number };
+  maxPending?: number;
+}
+
+export interface NativeUploadTemplate {
+  provider?: 'openai' | 'deepinfra'; // default base URL
+  baseUrl?: string;
+  apiKey: string;
+  model: string;
+  language?: string;
+  prompt?: string;
+  responseFormat?: 'json' | 'text' | 'srt' | 'verbose_json' | 'vtt';
+  temperature?: number;
+  fields?: Record<string, string>; // more form fields, e.g. { remember: 'false' }
+  timeoutMs?: number;
+}
+
+interface NativePipelineChunk {
+  sampleIndex: number;
+  captureTimeMs: number;
+  durationMs: number;
+}
+
+export type NativePipelineEvent =
+  | (NativePipelineChunk & { type: 'encoded'; format: 'wav' | 'flac' | 'opus'; data: Buffer; encodeMs: number })
+  | (NativePipelineChunk & { type: 'uploaded'; format: 'wav' | 'flac' | 'opus'; bytes: number; encodeMs: number; uploadMs: number; response: unknown })
+  | (NativePipelineChunk & { type: 'transcript'; text: string; language: string; segments: Array<{ startMs: number; endMs: number; text: string }>; processingMs: number; shed?: WhisperShed; draft?: WhisperDraft })
+  | (NativePipelineChunk & { type: 'translation'; text: string; from: string; to: string; pivot: boolean; processingMs: number })
+  | (NativePipelineChunk & { type: 'spoken'; sentences: number; firstAudioMs: number | null; synthMs: number; audioMs: number; cancelled: boolean })
+  | (NativePipelineChunk & { type: 'error'; stage: 'encode' | 'upload' | 'transcribe' | 'translate' | 'speak'; message: string })
+  | { type: 'dropped'; count: number };
+
+// Returns the destroy; null when the addon can't be loaded or predates pipelines.
+export function createNativePipeline(name: string, spec: NativePipelineSpec, onEvent: (event: NativePipelineEvent) => void): (() => void) | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.createPipeline !== 'function') return null;
+  try {
+    wasapiAddon.createPipeline(name, spec, (event: NativePipelineEvent | CapturePacket) => {
+      // The capture channel's own events (format, discontinuity...) arrive here too
+      if (event && typeof event === 'object' && 'type' in event) onEvent(event as NativePipelineEvent);
+    });
+  } catch (error) {
+    console.warn(`[Pipeline] ${name} unavailable:`, error);
+    return null;
+  }
+  return () => { wasapiAddon.destroyPipeline(name); };
+}
+
+// An independent loopback capture (native-audio-core/capture_session.h), for
+// capturing more than one app at a time. Packets follow the startCapture
+// conventions; subscribe() streams stay on the default capture.
+export interface NativeCaptureSession {
+  start(pid: number, onPacket: (packet: Buffer | CapturePacket) => void, options?: Record<string, unknown>): boolean;
+  // Push-to-talk: the device runs from arm() on, but nothing is processed or
+  // delivered until beginDelivery(), which sends the last prerollMs first
+  arm?(pid: number, onPacket: (packet: Buffer | CapturePacket) => void, options?: Record<string, unknown>): boolean;
+  beginDelivery?(): void;
+  endDelivery?(): void;
+  stop(): void;
+  getStats(): Record<string, unknown> & {
+    models?: NativeModelFootprint;
+    memory?: NativeMemoryStats;
+    pool?: NativeTaskPoolStats;
+  };
+  setMinChunkMs(ms: number): void;
+  // Another app (pid), render endpoint or input device id, back end kept;
+  // false leaves the session on its old source
+  switchSource?(source: number | string): boolean;
+  getHistory?(fromMs: number, toMs: number): Promise<NativeCaptureHistory | null>;
+  readonly running: boolean;
+  readonly delivering?: boolean;
+}
+
+// A span of a capture's retroactive history (capture option 'history',
+// native-audio-core/capture_history.h): one WAV or Ogg-Opus file of the
+// processed 16 kHz stream; fromMs/toMs on the deviceClockMs() clock.
+export interface NativeCaptureHistory {
+  data: Buffer;
+  format: 'wav' | 'ogg';
+  fromMs: number;
+  toMs: number;
+  sampleRate: number;
+}
+
+// An active audio endpoint from the addon's listAudioEndpoints(); id or name
+// goes in capture option 'outputDevice' (render) or 'inputDevice' (capture).
+export interface NativeAudioEndpoint {
+  id: string;
+  name: string;
+  flow: 'render' | 'capture';
+  isDefault: boolean;
+  isDefaultCommunications: boolean;
+}
+
+// CPU time of one of the addon's own threads (native-audio-core/thread_cpu.h);
+// percent is of one core over the last windowMs. cycles is 0 off Windows.
+export interface NativeThreadCpu {
+  name: string;
+  cpuMs: number;
+  userMs: number;
+  kernelMs: number;
+  cycles: number;
+  percent: number;
+  windowMs: number;
+}
+
+// A capture's getStats().models (native-audio-core/model_footprint.h):
+// process-wide, like threads
+export interface NativeModelFootprint {
+  totalMb: number;
+  availableMb: number;
+  processMb: number;
+  whisper: Array<{ path: string; device: string; quantization: string; weightsMb: number; memoryMb: number }>;
+  translation: NativeTranslationModel[];
+}
+
+// A capture's getStats().memory (native-audio-core/memory_budget_bindings.h):
+// native bytes per subsystem, process-wide; the addon trims them itself when
+// the OS reports memory pressure
+export interface NativeMemoryStats {
+  totalBytes: number;
+  history: number;
+  preroll: number;
+  pcmPools: number;
+  melCache: number;
+  whisperModels: number;
+  translationModels: number;
+  ttsCache: number;
+  pressure: { signal: string; low: boolean; events: number; lastMs: number };
+  // Page-locked capture-thread buffers (realtime_memory.h), counted above too
+  realtime?: { lockedBytes: number; unlockedBytes: number; capBytes: number; blocks: number; denied: number };
+}
+
+// getStats().pool (native-audio-core/task_pool.h): the addon's shared
+// worker pool, per priority; wait is how long tasks queued before starting
+export interface NativeTaskQueueStats {
+  queued: number;
+  running: number;
+  completed: number;
+  limit: number;
+  wait: { count: number; meanUs: number; p50Us: number; p99Us: number; maxUs: number };
+}
+
+export interface NativeTaskPoolStats {
+  workers: number;
+  steals: number;
+  interactive: NativeTaskQueueStats;
+  normal: NativeTaskQueueStats;
+  background: NativeTaskQueueStats;
+}
+
+// The default capture keeps its last two minutes natively for "what did they
+// just say?"; 3.8 MB as pcm16
+const CAPTURE_HISTORY = { seconds: 120 };
+
+// Loopback captures release the device stream after this long with no app
+// playing, and reopen it when one starts (capture option `idle`)
+const CAPTURE_IDLE_MINUTES = 5;
+
+// Null when the addon can't be loaded or predates CaptureSession
+export function createNativeCaptureSession(): NativeCaptureSession | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.CaptureSession !== 'function') return null;
+  return new wasapiAddon.CaptureSession();
+}
+
+// Native screen-region grabber (native-audio-core/region_capture.h): Desktop
+// Duplication on Windows, ScreenCaptureKit on macOS. The rectangle is global,
+// in physical pixels on Windows and points on macOS; frames come back raw at
+// native resolution. Change is judged per tile against the previous grab:
+// changed is false when no tile differs, changedRect bounds the tiles that do.
+export interface NativeRegionFrame {
+  data: Buffer;
+  width: number;
+  height: number;
+  stride: number;
+  format: 'bgra' | 'gray';
+  changed: boolean;
+  changedRatio: number; // share of tiles that differ, 0-1
+  changedRect: { x: number; y: number; width: number; height: number } | null; // frame pixels
+  tiles: number;
+  tileSize?: number; // pixels per tile side, after rounding to a multiple of 16
+  rowHashes?: Buffer; // one little-endian 64-bit checksum per row of tiles, top down
+  timestampMs: number; // on the deviceClockMs() clock
+}
+
+export interface NativeRegionCapture {
+  grab(timeoutMs?: number): Promise<NativeRegionFrame>;
+  // The newest frame cropped to rect (inside the region), without tile hashing;
+  // waits up to timeoutMs (default 0) for a newer frame. Missing on older addons.
+  grabRect?(rect: { x: number; y: number; width: number; height: number }, timeoutMs?: number): Promise<NativeRegionFrame>;
+  setRegion(region: { x: number; y: number; width: number; height: number }): void;
+  close(): void;
+}
+
+// Null when the addon can't be loaded or predates RegionCapture
+export function createNativeRegionCapture(
+  region: { x: number; y: number; width: number; height: number },
+  options?: { format?: 'bgra' | 'gray'; scale?: number; maxFps?: number; tileSize?: number }
+): NativeRegionCapture | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.RegionCapture !== 'function') return null;
+  return new wasapiAddon.RegionCapture({ ...region, ...options });
+}
+
+// Native OCR preprocessing (native-audio-core/ocr_preprocess.h): crop, scale
+// to `height` rows (or by `scale`), gray8 and optional contrast stretch or
+// binarization of a raw frame, on the threadpool. data is tightly packed;
+// scaleX/scaleY are output pixels per frame pixel.
+export interface NativeOcrImage {
+  data: Buffer;
+  width: number;
+  height: number;
+  scaleX: number;
+  scaleY: number;
+}
+
+export interface NativeOcrPreprocessOptions {
+  crop?: { x: number; y: number; width: number; height: number }; // frame pixels
+  height?: number;
+  scale?: number;
+  contrast?: 'none' | 'stretch' | 'binarize';
+}
+
+// Null when the addon can't be loaded or predates preprocessForOcr
+export function preprocessForOcr(
+  frame: Pick<NativeRegionFrame, 'data' | 'width' | 'height' | 'stride' | 'format'>,
+  options?: NativeOcrPreprocessOptions
+): Promise<NativeOcrImage> | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.preprocessForOcr !== 'function') return null;
+  return wasapiAddon.preprocessForOcr(frame, options);
+}
+
+// Native text-region proposals (native-audio-core/text_regions.h): rectangles
+// of a frame (or of options.crop) that probably hold text, in frame pixels and
+// reading order, so OCR can skip video, photos and empty UI. coverage is their
+// share of the searched area.
+export interface NativeTextRegions {
+  regions: Array<{ x: number; y: number; width: number; height: number }>;
+  coverage: number;
+}
+
+// Null when the addon can't be loaded or predates findTextRegions
+export function findTextRegions(
+  frame: Pick<NativeRegionFrame, 'data' | 'width' | 'height' | 'stride' | 'format'>,
+  options?: { crop?: { x: number; y: number; width: number; height: number }; threshold?: number; padding?: number }
+): Promise<NativeTextRegions> | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.findTextRegions !== 'function') return null;
+  return wasapiAddon.findTextRegions(frame, options);
+}
+
+// Multi-frame voting over a watched region's OCR lines
+// (native-audio-core/ocr_text_stabilizer.h). Each observe() is one
+// recognition; a line is returned once a majority of its last `window`
+// readings agree within `similarity` and only when that differs from what it
+// last settled on. `observed` lists the bands the recognition covered (lines
+// elsewhere are taken to read as before); absent, it covered everything.
+export interface NativeStableLine {
+  line: number; // stays with the line while it is followed
+  text: string;
+  x: number;
+  y: number;
+  width: number;
+  height: number;
+}
+
+export interface NativeTextStabilizer {
+  observe(
+    lines: Array<{ text: string; x: number; y: number; width: number; height: number }>,
+    observed?: Array<{ y: number; height: number }>
+  ): NativeStableLine[];
+  reset(): void;
+  readonly lines: number;
+}
+
+// Null when the addon can't be loaded or predates TextStabilizer
+export function createTextStabilizer(
+  options?: { window?: number; minVotes?: number; similarity?: number; maxMissed?: number }
+): NativeTextStabilizer | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.TextStabilizer !== 'function') return null;
+  return new wasapiAddon.TextStabilizer(options ?? {});
+}
+
+// Where a watched region's text actually sits, learned from the rows OCR
+// finds it on (native-audio-core/subtitle_tracker.h). band() is the rows to
+// read this check, the whole height (full) until learned or after a miss;
+// observe() reports what the check read, the rows it found text on, and
+// whether text-like regions showed up in changes outside the band.
+export interface NativeSubtitleTracker {
+  band(frameHeight: number): { y: number; height: number; full: boolean };
+  observe(
+    frameHeight: number,
+    read: { y: number; height: number },
+    text: Array<{ y: number; height: number }>,
+    textOutside: boolean
+  ): void;
+  reset(): void;
+  getStats(): { checks: number; narrowed: number; misses: number; readRatio: number };
+}
+
+// Null when the addon can't be loaded or predates SubtitleTracker
+export function createSubtitleTracker(
+  options?: { margin?: number; minHeight?: number; warmup?: number; probeEvery?: number; coverage?: number; decay?: number }
+): NativeSubtitleTracker | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.SubtitleTracker !== 'function') return null;
+  return new wasapiAddon.SubtitleTracker(options ?? {});
+}
+
+// Native Tesseract (native-audio-core/ocr_engine.h): a pool of initialised
+// instances reading gray8 images in place, several recognitions at once
+export interface NativeOcrWord {
+  text: string;
+  confidence: number; // 0-100
+  x: number;
+  y: number;
+  width: number;
+  height: number;
+}
+
+export interface NativeOcr {
+  load(dataPath: string, options?: { language?: string; instances?: number }): Promise<{ instances: number; loadMs: number }>;
+  recognize(image: { data: Buffer; width: number; height: number; stride?: number }, options?: { psm?: number; words?: boolean }): Promise<{
+    text: string;
+    confidence: number;
+    words: NativeOcrWord[];
+    processingMs: number;
+  }>;
+  unload(): Promise<void>;
+}
+
+// Null when the addon can't be loaded or predates the OCR engine; a build
+// without use_tesseract still returns an engine whose load() rejects
+export function getNativeOcr(): NativeOcr | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.loadOcrEngine !== 'function') return null;
+  return {
+    load: (dataPath, options) => wasapiAddon.loadOcrEngine(dataPath, options ?? {}),
+    recognize: (image, options) => wasapiAddon.recognizeOcr(image, options ?? {}),
+    unload: () => wasapiAddon.unloadOcrEngine(),
+  };
+}
+
+// In-process PaddleOCR on ONNX Runtime (native-audio-core/paddle_ocr_engine.h):
+// DirectML on Windows, Core ML on macOS, the CPU otherwise. One call's frames
+// share a detection batch and their lines are recognised together.
+export interface NativePaddleOcr {
+  load(models: { det: string; rec: string; dict: string; cls?: string; device?: 'auto' | 'cpu'; threads?: number; space?: boolean }): Promise<{ provider: string; loadMs: number }>;
+  recognize(
+    frames: Array<Pick<NativeRegionFrame, 'data' | 'width' | 'height' | 'stride' | 'format'>>,
+    options?: { limitSideLen?: number; boxThreshold?: number; unclipRatio?: number; dropScore?: number; cls?: boolean }
+  ): Promise<{
+    results: Array<{ text: string; boxes: Array<{ text: string; confidence: number; x: number; y: number; width: number; height: number }> }>;
+    processingMs: number;
+  }>;
+  unload(): Promise<void>;
+}
+
+// Null when the addon can't be loaded or predates the engine; a build without
+// use_onnxruntime still returns an engine whose load() rejects
+export function getNativePaddleOcr(): NativePaddleOcr | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.loadPaddleOcr !== 'function') return null;
+  return {
+    load: (models) => wasapiAddon.loadPaddleOcr(models),
+    recognize: (frames, options) => wasapiAddon.recognizePaddleOcr(frames, options ?? {}),
+    unload: () => wasapiAddon.unloadPaddleOcr(),
+  };
+}
+
+// The capture chain's DSP kernels (native-audio-core/dsp_kernel_bindings.h),
+// synchronous on the arrays' own memory: filter, gate and normalize work in
+// place; resample and the conversions write into the output passed.
+export interface NativeDsp {
+  resample(input: Float32Array, output: Float32Array, options: { inRate: number; outRate: number; quality?: 'low' | 'medium' | 'high' }): number;
+  filter(samples: Float32Array, options: { sampleRate: number; highPassHz?: number; lowPassHz?: number; q?: number }): void;
+  gate(samples: Float32Array, options: { sampleRate: number; threshold?: number }): number; // peak after the gate
+  normalize(samples: Float32Array, options?: { peak?: number; maxGainDb?: number }): number; // gain applied
+  measure(samples: Float32Array, options?: { sampleRate?: number }): { peak: number; rms: number; lufs?: number };
+  int16ToFloat(input: Int16Array, output: Float32Array): void;
+  floatToInt16(input: Float32Array, output: Int16Array, gain?: number): void;
+}
+
+let nativeDsp: NativeDsp | null | undefined;
+
+// Null when the addon can't be loaded or predates the DSP kernels
+export function getNativeDsp(): NativeDsp | null {
+  if (nativeDsp !== undefined) return nativeDsp;
+  if (!loadWasapiAddon() || typeof wasapiAddon.dspResample !== 'function') return (nativeDsp = null);
+  nativeDsp = {
+    resample: (input, output, options) => wasapiAddon.dspResample(input, output, options),
+    filter: (samples, options) => { wasapiAddon.dspFilter(samples, options); },
+    gate: (samples, options) => wasapiAddon.dspGate(samples, options),
+    normalize: (samples, options) => wasapiAddon.dspNormalize(samples, options ?? {}),
+    measure: (samples, options) => wasapiAddon.dspMeasure(samples, options ?? {}),
+    int16ToFloat: (input, output) => { wasapiAddon.dspInt16ToFloat(input, output); },
+    floatToInt16: (input, output, gain) => { wasapiAddon.dspFloatToInt16(input, output, gain ?? 1); },
+  };
+  return nativeDsp;
+}
+
+// Whole-clip encoders (native-audio-core/audio_encoder.h) on the addon's
+// threadpool. flac and opus take mono; opus and mp3 reject when the addon was
+// built without them (use_opus / use_avcodec), as does mp3 at a non-MPEG rate.
+export interface NativeEncodeOptions {
+  sampleRate: number;
+  channels?: 1 | 2; // samples interleaved
+  format: 'wav' | 'flac' | 'opus' | 'mp3';
+  bitrate?: number; // opus and mp3, bits/s
+  level?: 0 | 1 | 2; // flac
+  complexity?: number; // opus, 0..10
+  uploadBudgetMs?: number; // opus, instead of bitrate: picked from the reported upload throughput (upload_rate.h)
+}
+
+// Null when the addon can't be loaded or predates encodeAudio. With
+// uploadBudgetMs the Buffer carries the picked bitrate and complexity.
+export function encodeNativeAudio(
+  samples: Float32Array,
+  options: NativeEncodeOptions
+): Promise<Buffer & { bitrate?: number; complexity?: number }> | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.encodeAudio !== 'function') return null;
+  return wasapiAddon.encodeAudio(samples, options);
+}
+
+// STT clients, after each upload: its size and the time it spent on the
+// network, for the Opus bitrate picks. No-op without the addon.
+export function reportUploadThroughput(bytes: number, ms: number): void {
+  if (!loadWasapiAddon() || typeof wasapiAddon.reportUploadThroughput !== 'function') return;
+  wasapiAddon.reportUploadThroughput(bytes, ms);
+}
+
+// An STT client's file posted by the addon, as the pipeline's upload node
+// does (native-audio-core/http_upload.h): the OS HTTP stack's kept-alive
+// session, off the JS thread, throughput reported natively. Any HTTP status
+// resolves; null when the addon can't be loaded or predates uploadTranscription.
+export function uploadNativeTranscription(file: Buffer, upload: NativeUploadTemplate, fileName?: string, mimeType?: string):
+  Promise<{ status: number; body: string; bytes: number; uploadMs: number }> | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.uploadTranscription !== 'function') return null;
+  return wasapiAddon.uploadTranscription(file, upload, { fileName, mimeType });
+}
+
+// Offline accuracy-vs-cost runs of DSP settings (native-audio-core/dsp_eval.h):
+// a labelled corpus replayed through each config, chunked, encoded and, with a
+// Whisper model loaded, transcribed and scored. Configs take the capture
+// options that shape the stream plus setProcessingParams() fields.
+export interface DspEvalConfig {
+  name?: string;
+  resampler?: 'low' | 'medium' | 'high';
+  vad?: 'quality' | 'low-bitrate' | 'aggressive' | 'very-aggressive';
+  frameMs?: 10 | 20 | 30;
+  chunker?: Record<string, number>;
+  loudness?: Record<string, number>;
+  denoise?: { budgetUs?: number; floorDb?: number };
+  filterGraph?: string;
+  params?: Record<string, number>;
+  upload?: { format?: 'wav' | 'flac' | 'opus'; bitrate?: number };
+}
+
+export interface DspEvalResult {
+  name: string;
+  files: number;
+  audioMs: number;
+  samples: number; // 16 kHz
+  chunks: number;
+  uploadBytes: number;
+  nsPerSample: { front: number; chain: number; encode: number; total: number };
+  words?: number;
+  errors?: number;
+  wer?: number;
+  transcribeMs?: number;
+  decoded?: boolean; // opus chunks transcribed as decoded
+  transcribeError?: string;
+  error?: string;
+}
+
+// Null when the addon can't be loaded or predates evaluateDsp
+export function evaluateNativeDsp(options: {
+  corpus: Array<{ file: string; text: string }>;
+  configs: DspEvalConfig[];
+  language?: string;
+  transcribe?: boolean;
+}): Promise<DspEvalResult[]> | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.evaluateDsp !== 'function') return null;
+  return wasapiAddon.evaluateDsp(options);
+}
+
+// Batch transcription of a media file (native-audio-core/batch_transcribe.h):
+// decoded and cut at pauses in one pass, the pieces transcribed concurrently
+// by the local Whisper model (load it with lanes > 1 to use more cores) and
+// stitched in order, with segment times on the file's clock. Reached from
+// the page through wasapi:transcribe-media.
+export interface MediaTranscription {
+  text: string;
+  language: string;
+  segments: Array<{ startMs: number; endMs: number; text: string }>;
+  pieces: number;
+  failed: number; // pieces whose transcription failed; error is the first one's
+  audioMs: number;
+  decodeMs: number;
+  transcribeMs: number; // summed over the pieces
+  wallMs: number;
+  error?: string;
+}
+
+// Null when the addon can't be loaded or predates transcribeMedia
+export function transcribeNativeMedia(file: string, options?: {
+  capture?: Record<string, unknown>; // vad, frameMs, chunker, loudness... as for evaluateDsp configs
+  language?: string;
+  translate?: boolean;
+  prompt?: string;
+  threads?: number;
+  model?: string;
+  concurrency?: number; // pieces transcribing at once; default the model's lanes plus one
+}): Promise<MediaTranscription> | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.transcribeMedia !== 'function') return null;
+  return wasapiAddon.transcribeMedia(file, options);
+}
+
+// Native output stream (native-audio-core/render_session.h): mono PCM pushed
+// from here, or decoded in the addon from a TtsStreamDecoder, plays on a
+// device (the virtual cable by default) without the renderer's AudioContext
+// and setSinkId buffering. Its output is a mixer: the 'soundboard' (mic bus)
+// and 'capture' (a running capture's own audio) inputs can join the TTS in
+// the one stream, each with a gain and ducking under the others.
+export type NativeRenderInput = 'tts' | 'soundboard' | 'capture';
+
+export interface NativeRenderSession {
+  start(options?: {
+    device?: string;
+    sampleRate?: number;
+    prebufferMs?: number; // initial playout delay; the fixed one with jitterBuffer: false
+    jitterBuffer?: boolean | { minMs?: number; maxMs?: number }; // adaptive playout delay, on by default
+    // Pitch-preserved speed-up while the queue is behind: 1x at startMs queued up to maxSpeed at fullMs
+    catchUp?: boolean | { maxSpeed?: number; startMs?: number; fullMs?: number };
+    lowLatency?: boolean;
+  }): string;
+  push(pcm: Int16Array | Float32Array): number; // queued ms
+  pushDecoded(decoderId: string, bytes: Buffer): number;
+  end(): void;
+  clear(): void;
+  stop(): void;
+  // duckDb (-60..0) applies while any input of duckBy is sounding; returns whether the input is on
+  setInput(name: NativeRenderInput, options: { enabled?: boolean; gain?: number; duckDb?: number; duckBy?: NativeRenderInput[] }): boolean;
+  getStats(): NativeRenderStats;
+  // Voices text with a loaded Piper voice, queueing each sentence as it's synthesised
+  speak(voice: string, text: string, options?: NativeSpeechOptions): Promise<NativeSpeechResult>;
+  // Plays a chirp and times it through the first running capture that hears it (latency_probe.h)
+  measureLatency(options?: { timeoutMs?: number }): Promise<NativeLatencyMeasurement>;
+  readonly running: boolean;
+}
+
+export interface NativeLatencyMeasurement {
+  outputMs: number; // render callback to the capture timestamp of the chirp
+  captureMs: number; // capture timestamp to the packet writer
+  pipelineMs?: number; // packet writer to the JS drain; absent when the packet was not seen
+  totalMs?: number;
+  match: number; // normalised correlation, 0..1
+}
+
+export interface NativeRenderStats {
+  queuedMs: number;
+  pushedMs: number;
+  playedMs: number;
+  droppedMs: number;
+  concealedMs: number; // stretched over underruns
+  underruns: number;
+  targetMs: number; // current playout delay
+  jitterMs: number;
+  startDelayMs: number; // last utterance: first chunk to first sample played
+  speed: number; // catch-up playback speed
+  catchUpMs: number; // skipped by catching up
+  inputs: Partial<Record<NativeRenderInput, { levelDb: number; ducked: boolean }>>; // enabled ones
+}
+
+// Null when the addon can't be loaded or predates RenderSession
+export function createNativeRenderSession(): NativeRenderSession | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.RenderSession !== 'function') return null;
+  return new wasapiAddon.RenderSession();
+}
+
+// Streamed TTS on the virtual cable (wasapi:start-tts-render). While it runs,
+// renderTtsChunk() takes each MP3 chunk off the pipeline and decodes it into
+// the session; the renderer only plays chunks this returned false for.
+const TTS_RENDER_RATE = 48000; // the session's own rate: no second resample
+let ttsRender: NativeRenderSession | null = null;
+let ttsRenderDecoder: TtsStreamDecoder | null = null;
+
+export function renderTtsChunk(chunk: ArrayBuffer, first: boolean, final: boolean): boolean {
+  if (!ttsRender?.running) return false;
+  try {
+    if (first || !ttsRenderDecoder) {
+      ttsRenderDecoder?.close();
+      ttsRenderDecoder = first ? openTtsStreamDecoder('mp3', TTS_RENDER_RATE) : null;
+      if (!ttsRenderDecoder) return false;
+    }
+    ttsRender.pushDecoded(ttsRenderDecoder.id, Buffer.from(chunk));
+    if (final) endTtsRender();
+    return true;
+  } catch (error) {
+    console.warn('[TTS] Native render failed, leaving playback to the renderer:', error);
+    return false;
+  }
+}
+
+// End of an utterance: plays out the decoder's tail and whatever is queued
+export function endTtsRender(): void {
+  if (!ttsRender || !ttsRenderDecoder) return;
+  try {
+    ttsRender.push(ttsRenderDecoder.close());
+    ttsRender.end();
+  } catch (error) {
+    console.warn('[TTS] Failed to finish native render:', error);
+  }
+  ttsRenderDecoder = null;
+}
+
+// Local speech on the running native TTS render; null when none runs (or the
+// addon predates speak()), leaving the text to the cloud voices
+export function speakTtsRender(voice: string, text: string, options?: NativeSpeechOptions): Promise<NativeSpeechResult> | null {
+  if (!ttsRender?.running || typeof ttsRender.speak !== 'function') return null;
+  return ttsRender.speak(voice, text, options);
+}
+
+// Local neural TTS (native-audio-core/piper_tts_engine.h): Piper voices on
+// ONNX Runtime, configured from the fields of the voice's .onnx.json
+export interface NativePiperVoiceConfig {
+  model: string;
+  sampleRate: number;
+  phonemeIdMap: Record<string, number[]>;
+  phonemeType?: 'espeak' | 'text';
+  espeakVoice?: string;
+  espeakData?: string;
+  noiseScale?: number;
+  lengthScale?: number;
+  noiseW?: number;
+  speakers?: number;
+  threads?: number;
+}
+
+export interface NativeSpeechOptions {
+  speakerId?: number;
+  lengthScale?: number; // above 1 speaks slower
+  sentenceSilenceMs?: number;
+}
+
+export interface NativeSpeechResult {
+  sentences: number;
+  firstAudioMs: number | null; // call to first queued sample
+  synthMs: number;
+  audioMs: number;
+  cancelled: boolean; // clear()/stop() came first
+}
+
+export interface NativePiperTts {
+  load(name: string, config: NativePiperVoiceConfig): Promise<{ sampleRate: number; loadMs: number }>;
+  synthesize(name: string, text: string, options?: NativeSpeechOptions): Promise<{ pcm: Float32Array; sampleRate: number; synthMs: number }>;
+  unload(): Promise<void>;
+  voices(): string[];
+}
+
+// Null when the addon can't be loaded or predates the engine; a build
+// without use_onnxruntime still returns one whose load() rejects
+export function getNativePiperTts(): NativePiperTts | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.loadTtsVoice !== 'function') return null;
+  return {
+    load: (name, config) => wasapiAddon.loadTtsVoice(name, config),
+    synthesize: (name, text, options) => wasapiAddon.synthesizeSpeech(name, text, options ?? {}),
+    unload: () => wasapiAddon.unloadTtsVoices(),
+    voices: () => wasapiAddon.getTtsVoices(),
+  };
+}
+
+// Native microphone capture (capture option source: 'microphone'): the addon
+// reads the input device and runs it through the loopback path's resample,
+// voice chain, VAD and chunker, so only finished utterances cross to the
+// renderer. Runs alongside the loopback capture in its own session, which
+// also serves as the echo canceller's far end (option echoCancel): the
+// output it hears is removed from the mic before the VAD runs.
+let micSession: NativeCaptureSession | null = null;
+
+// Shared-memory ring handing pcm16 chunks (or gray/BGRA frames, for the OCR
+// worker) to a long-lived Python worker; the worker opens it by name through
+// dist/whisper/whispra_ring.py
+export interface NativeAudioRing {
+  mapping: string;
+  doorbell: string;
+  capacity: number;
+  sampleRate: number;
+  write(audio: Buffer | Int16Array): number; // seq, or -1 when the worker is too far behind
+  writeImage(image: Pick<NativeRegionFrame, 'data' | 'width' | 'height' | 'stride' | 'format'>): number; // same
+  close(): void;
+}
+
+// Null when the addon can't be loaded, predates the ring, or can't create it
+export function openNativeAudioRing(name: string, options?: { capacityKb?: number; sampleRate?: number; source?: 'manual' | 'capture' }): NativeAudioRing | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.openAudioRing !== 'function') return null;
+  try {
+    const info = wasapiAddon.openAudioRing(name, options ?? {});
+    return {
+      ...info,
+      write: (audio: Buffer | Int16Array) => wasapiAddon.writeAudioRing(name, audio),
+      writeImage: (image) => typeof wasapiAddon.writeImageRing === 'function' ? wasapiAddon.writeImageRing(name, image) : -1,
+      close: () => { wasapiAddon.closeAudioRing(name); },
+    };
+  } catch (error) {
+    console.warn('[AudioRing] Could not open shared-memory ring:', error);
+    return null;
+  }
+}
+
+// Disk-backed TTS audio cache (tts_audio_cache.h): synthesized audio appended to
+// memory-mapped segment files in userData/tts-cache, so it survives restarts and
+// a hit is a Buffer over the mapping rather than audio kept on the JS heap
+export interface NativeTtsCache {
+  get(text: string, voiceId: string, modelId?: string): { audio: Buffer; format: string } | null;
+  put(text: string, voiceId: string, modelId: string | undefined, audio: ArrayBuffer | Uint8Array, format?: string): boolean;
+}
+
+let nativeTtsCache: Promise<NativeTtsCache | null> | null = null;
+
+// Opened once per process; null when the addon can't be loaded, predates the cache or can't open it
+export function openNativeTtsCache(maxMb?: number): Promise<NativeTtsCache | null> {
+  if (nativeTtsCache) return nativeTtsCache;
+  if (!loadWasapiAddon() || typeof wasapiAddon.openTtsCache !== 'function') return Promise.resolve(null);
+  const cacheDir = path.join(app.getPath('userData'), 'tts-cache');
+  nativeTtsCache = fs.promises.mkdir(cacheDir, { recursive: true })
+    .then(() => wasapiAddon.openTtsCache(cacheDir, maxMb === undefined ? {} : { maxMb }))
+    .then((info: { entries: number; bytes: number; segments: number }) => {
+      console.log(`[TTS] Disk cache: ${info.entries} phrases, ${Math.round(info.bytes / 1048576)} MB in ${info.segments} segments`);
+      return {
+        get: (text: string, voiceId: string, modelId?: string) => wasapiAddon.getTtsCache(text, voiceId, modelId ?? ''),
+        put: (text: string, voiceId: string, modelId: string | undefined, audio: ArrayBuffer | Uint8Array, format?: string) =>
+          wasapiAddon.putTtsCache(text, voiceId, modelId ?? '', audio, format ?? ''),
+      };
+    })
+    .catch((error: unknown) => {
+      console.warn('[TTS] Disk cache unavailable:', error);
+      return null;
+    });
+  return nativeTtsCache;
+}
+
+// Trigram index over the translation cache's source texts, for its fuzzy
+// lookups (native-audio-core/fuzzy_text_index.h). Texts go in normalized
+// (FuzzyMatcher.normalize); ids are the caller's
+export interface NativeFuzzyIndex {
+  add(id: number, text: string, group: string): void;
+  remove(id: number): boolean;
+  find(text: string, options: { threshold?: number; group?: string; limit?: number }): { id: number; similarity: number }[];
+  clear(): void;
+}
+
+// Null when the addon can't be loaded or predates the index
+export function getNativeFuzzyIndex(): NativeFuzzyIndex | null {
+  if (!loadWasapiAddon() || typeof wasapiAddon.findFuzzyText !== 'function') return null;
+  return {
+    add: (id, text, group) => wasapiAddon.addFuzzyText(id, text, group),
+    remove: (id) => wasapiAddon.removeFuzzyText(id),
+    find: (text, options) => wasapiAddon.findFuzzyText(text, options),
+    clear: () => wasapiAddon.clearFuzzyText(),
+  };
+}
+
 // Helper function to convert raw PCM to WAV format (with optional voice boost)
 function convertPcmToWav(pcmData: Buffer, sampleRate: number, channels: number, applyBoost: boolean = true): Buffer {
   // Apply voice boost for better whisper detection
@@ -252,6 +1541,258 @@ function convertPcmToWav(pcmData: Buffer, sampleRate: number, channels: number,
   return buffer;
 }
 
+// Upload-ready WAV for an addon-cut utterance, boosted like the chunks cut in JS
+function logQualityStep(addonName: string, event: CaptureQualityEvent): void {
+	if (event.reason === 'power') {
+		console.log(`[main] ${addonName} capture DSP quality set to ${event.level} for the power source at sample ${event.sampleIndex}`);
+		return;
+	}
+	console.log(`[main] ${addonName} capture DSP quality ${event.reason === 'load-high' ? 'lowered' : 'raised'} to ${event.level} at sample ${event.sampleIndex} (load ${Math.round(event.load * 100)}%)`);
+}
+
+function logPowerProfile(addonName: string, event: CapturePowerEvent): void {
+	console.log(`[main] ${addonName} capture on ${event.source} power: quality at most ${event.quality}, JS wakeups every ${event.throttleMs}ms, ${event.latencyMode} latency for new streams`);
+}
+
+function logIdleRelease(addonName: string, event: CaptureIdleEvent): void {
+	if (event.idle) console.log(`[main] ${addonName} capture released its device stream at sample ${event.sampleIndex}: nothing is playing`);
+	else console.log(`[main] ${addonName} capture reopening its device stream after ${Math.round(event.idleMs / 1000)}s idle`);
+}
+
+// Capture option `keyword` from uiSettings.keywordSpotting: only utterances
+// after a spotted keyword are cut for transcription. Undefined when off or
+// when the model file is missing.
+function keywordCaptureOption(): { model: string; threshold?: number; windowMs?: number } | undefined {
+	const spotting = ConfigurationManager.getInstance().getConfig().uiSettings?.keywordSpotting;
+	if (!spotting?.enabled || !spotting.modelPath) return undefined;
+	if (!fs.existsSync(spotting.modelPath)) {
+		console.warn(`[main] Keyword spotting off: model ${spotting.modelPath} not found`);
+		return undefined;
+	}
+	return { model: spotting.modelPath, threshold: spotting.threshold, windowMs: spotting.windowMs };
+}
+
+// Capture option `neuralVad` from uiSettings.neuralVad: a Silero v5 ONNX model
+// vetoes what the DSP detector takes for speech (music, typing). The addon
+// batches every capture's windows on one inference thread, so the loopback and
+// the microphone share its cost. Undefined when off or the file is missing.
+function neuralVadCaptureOption(): { model: string; threshold?: number } | undefined {
+	const neural = ConfigurationManager.getInstance().getConfig().uiSettings?.neuralVad;
+	if (!neural?.enabled || !neural.modelPath) return undefined;
+	if (!fs.existsSync(neural.modelPath)) {
+		console.warn(`[main] Neural VAD off: model ${neural.modelPath} not found`);
+		return undefined;
+	}
+	return { model: neural.modelPath, threshold: neural.threshold };
+}
+
+// Capture option `languageId` from uiSettings.languageId, in auto-detect mode
+// only: each utterance's language is identified natively from its first
+// second, languages that need longer chunks get longMinChunkMs for that
+// utterance, and the chunk's STT request names the language. Undefined when
+// off, when a source language is set or when the model file is missing.
+const LONG_CHUNK_LANGUAGES = ['ru', 'pl', 'cs', 'sk', 'bg', 'sr', 'hr', 'sl', 'uk', 'be', 'mk', 'bs', 'sv'];
+function languageIdCaptureOption(sourceLanguage: string, longMinChunkMs: number):
+	{ model: string; minConfidence?: number; minChunkMs: Record<string, number> } | undefined {
+	const lid = ConfigurationManager.getInstance().getConfig().uiSettings?.languageId;
+	if (!lid?.enabled || !lid.modelPath || sourceLanguage !== 'auto') return undefined;
+	if (!fs.existsSync(lid.modelPath)) {
+		console.warn(`[main] Language identification off: model ${lid.modelPath} not found`);
+		return undefined;
+	}
+	const minChunkMs: Record<string, number> = {};
+	for (const code of LONG_CHUNK_LANGUAGES) minChunkMs[code] = longMinChunkMs;
+	return { model: lid.modelPath, minConfidence: lid.minConfidence, minChunkMs };
+}
+
+// Capture option `mel`: in local mode every chunk's log-mel frames stay in the
+// addon for a while, so the native Whisper engine skips its own feature pass
+// on them.
+function melCaptureOption(): boolean {
+	const config: any = ConfigurationManager.getInstance().getConfig();
+	return getProcessingModeFromConfig(config) === 'local';
+}
+
+// Option chunker.adaptive (uiSettings.adaptiveChunking, default on): pause and
+// minimum length follow the speaker's syllable rate, so slow speech isn't cut
+// into many short STT requests, and max-length cuts land between syllables.
+function adaptiveChunkingOption(): boolean {
+	return ConfigurationManager.getInstance().getConfig().uiSettings?.adaptiveChunking !== false;
+}
+
+// Capture option `speaker` (uiSettings.speakerTurns): chunks end at speaker
+// turn changes and name their speaker; a trained SPK1 embedding tells similar
+// voices apart where the built-in spectrum shape cannot. Undefined when off.
+function speakerCaptureOption(): { model?: string; threshold?: number } | undefined {
+	const turns = ConfigurationManager.getInstance().getConfig().uiSettings?.speakerTurns;
+	if (!turns?.enabled) return undefined;
+	if (turns.modelPath && !fs.existsSync(turns.modelPath)) {
+		console.warn(`[main] Speaker turns use the built-in embedding: model ${turns.modelPath} not found`);
+		return { threshold: turns.threshold };
+	}
+	return { model: turns.modelPath || undefined, threshold: turns.threshold };
+}
+
+// Capture option `conversion` (uiSettings.captureConversion): WASAPI can hand
+// over 16 kHz mono itself instead of the mix format; CoreAudio ignores it.
+function conversionCaptureOption(): 'native' | 'engine-converted' | undefined {
+	return ConfigurationManager.getInstance().getConfig().uiSettings?.captureConversion;
+}
+
+// Capture option `outputDevice` (uiSettings.loopbackDevices): the full-mix
+// loopback records these render endpoints (ids or parts of names, from
+// listAudioEndpoints) instead of the default one, mixed natively when there
+// are several; CoreAudio ignores it.
+function outputDeviceCaptureOption(): string[] | undefined {
+	const devices = ConfigurationManager.getInstance().getConfig().uiSettings?.loopbackDevices?.filter(Boolean);
+	return devices?.length ? devices : undefined;
+}
+
+// Capture options `micMode` and `micRole` (uiSettings.microphoneStream): the
+// native mic opens raw unless turned off, since its voice chain and echo
+// canceller already condition it and Windows' effects only add latency.
+function micStreamOptions(): { micMode: 'default' | 'raw'; micRole: 'console' | 'communications' } {
+	const stream = ConfigurationManager.getInstance().getConfig().uiSettings?.microphoneStream;
+	return { micMode: stream?.raw === false ? 'default' : 'raw', micRole: stream?.role ?? 'console' };
+}
+
+// Capture option `record` (uiSettings.sessionRecording): the native recorder
+// writes the session as rotating segment files from its own I/O thread, e.g.
+// recordings/session-2026-10-15T09-30-00-0001.flac
+function recordCaptureOption(): { path: string; codec?: string; stream?: string; segmentSeconds?: number } | undefined {
+	const recording = ConfigurationManager.getInstance().getConfig().uiSettings?.sessionRecording;
+	if (!recording?.enabled) return undefined;
+	const directory = recording.directory || path.join(app.getPath('userData'), 'recordings');
+	try {
+		fs.mkdirSync(directory, { recursive: true });
+	} catch (error) {
+		console.warn(`[main] Session recording off: cannot create ${directory}:`, error);
+		return undefined;
+	}
+	const stamp = new Date().toISOString().slice(0, 19).replace(/:/g, '-');
+	return {
+		path: path.join(directory, `session-${stamp}`),
+		codec: recording.codec ?? 'flac',
+		stream: recording.stream,
+		segmentSeconds: recording.segmentSeconds,
+	};
+}
+
+// Capture option `warmStart`: the voice chain starts from the gate floor,
+// denoise profile and loudness gain the endpoint's last capture converged to,
+// kept by key in userData/dsp-warm-state.bin (native-audio-core/dsp_warm_state.h)
+function warmStartCaptureOption(key: string): { path: string; key: string } {
+	return { path: path.join(app.getPath('userData'), 'dsp-warm-state.bin'), key };
+}
+
+// uiSettings.captureHost 'utility': the PID loopback capture runs in a
+// utility process (services/CaptureHost) and reaches main through a
+// shared-memory ring, so a crashing capture leaves the app running. Needs an
+// addon with the ring reader; older ones capture in process.
+function captureHostEnabled(): boolean {
+	return ConfigurationManager.getInstance().getConfig().uiSettings?.captureHost === 'utility' &&
+		typeof wasapiAddon?.attachAudioRing === 'function' && resolveAudioAddonPath() !== null;
+}
+
+// A runtime control of the loopback capture, applied where it runs: a hosted
+// capture's is the host's addon (CaptureHost.control), since this process's
+// has no capture to apply it to. Resolves undefined, with a warning, when the
+// control did not reach it.
+function loopbackControl(hosted: boolean, method: CaptureHostControl, ...args: unknown[]): Promise<unknown> {
+	const call = hosted
+		? CaptureHost.getInstance().control(method, ...args)
+		: Promise.resolve().then(() => wasapiAddon[method](...args));
+	return call.catch(error => {
+		console.warn(`[main] Capture control ${method}() not applied:`, error instanceof Error ? error.message : error);
+		return undefined;
+	});
+}
+
+// Loopback endpoints as warm-start keys: the configured render devices or the
+// default one; a single app's stream carries no room noise of its own
+function loopbackWarmStartKey(pid: number): string {
+	if (pid !== 0) return 'loopback:app';
+	return `loopback:${outputDeviceCaptureOption()?.join('+') ?? 'default'}`;
+}
+
+function onKeyword(addonName: string, webContentsId: number, event: CaptureKeywordEvent): void {
+	console.log(`[main] ${addonName} capture heard "${event.keyword}" (${event.score.toFixed(2)}) at sample ${event.sampleIndex}; transcribing for ${event.windowMs}ms`);
+	const { webContents } = require('electron');
+	const wc = webContents.fromId(webContentsId);
+	if (wc && !wc.isDestroyed()) wc.send('wasapi:keyword', { keyword: event.keyword, score: event.score, windowMs: event.windowMs });
+}
+
+// Capture option chunker.valleyMs: a max-length cut lands in the quietest frame
+// of the last 300 ms, and no cut in a real energy valley repeats its tail
+// (OVERLAP_MS) at the start of the next chunk, so less audio goes to STT twice
+const CUT_VALLEY_MS = 300;
+
+// Capture option chunker.trimMs: chunks keep only this much of the pre-roll,
+// pause and VAD hangover around their voiced frames, so per-second STT billing
+// and Whisper's silence hallucinations see less of them
+const CHUNK_TRIM_MS = 150;
+
+// Capture option chunker.compact: hesitations inside a chunk longer than
+// minPauseMs go to STT as gapMs of silence; chunk.timeMap maps its timestamps back
+const CHUNK_COMPACT = { minPauseMs: 600, gapMs: 200 };
+
+// A time in a (possibly compacted) chunk's audio, as ms since the chunk's
+// first captured sample; add captureTimeMs for the capture clock
+export function chunkSourceMs(chunk: { timeMap?: Float64Array }, ms: number): number {
+  const map = chunk.timeMap;
+  let shift = 0;
+  for (let i = 0; map && i < map.length && map[i] <= ms; i += 2) shift = map[i + 1] - map[i];
+  return ms + shift;
+}
+
+// Capture option chunker.stream: utterances upload while they are spoken when
+// the managed WebSocket can take them; otherwise chunks only arrive whole
+function chunkStreamOption(): { intervalMs: number } | undefined {
+  return StreamedTranscription.getInstance().isAvailable() ? { intervalMs: 200 } : undefined;
+}
+
+function nativeChunkWav(chunk: CaptureChunkEvent): Buffer {
+  return voiceBoostEnabled && !nativeVoiceBoost ? convertPcmToWav(chunk.wav.subarray(44), 16000, 1) : chunk.wav;
+}
+
+// Chunks the native content classifier calls mostly music or noise skip STT;
+// the capture keeps them (no dropMusic) so streamed utterances still close.
+const NON_SPEECH_SKIP = 0.8;
+function nonSpeechLabel(chunk: CaptureChunkEvent): string | null {
+	if (!chunk.content) return null;
+	if (chunk.content.music >= NON_SPEECH_SKIP) return 'music';
+	if (chunk.content.noise >= NON_SPEECH_SKIP) return 'noise';
+	return null;
+}
+
+// " (N ms after capture)": from the chunk's last captured sample to its
+// arrival here, event-loop delay included; empty without capture timestamps
+function chunkArrivalLabel(chunk: CaptureChunkEvent): string {
+  if (!chunk.captureTimeMs || typeof wasapiAddon?.deviceClockMs !== 'function') return '';
+  const delayMs = wasapiAddon.deviceClockMs() - chunk.captureTimeMs - chunk.durationMs - (chunk.compactedMs ?? 0);
+  return ` (${delayMs.toFixed(0)}ms after capture)`;
+}
+
+// Now on the addon's capture clock, for LatencyTracer; 0 on older addons
+function deviceClockNowMs(): number {
+  return typeof wasapiAddon?.deviceClockMs === 'function' ? wasapiAddon.deviceClockMs() : 0;
+}
+
+// A WAV chunk on its way to the renderer, with its latency trace (undefined
+// unless tracing) and when it was queued on the trace clock
+interface PendingChunk {
+  wav: Buffer;
+  traceId?: string;
+  arrivedMs: number;
+  fingerprint?: Uint32Array; // lets speech:transcribe reuse a cached transcript (UtteranceCache)
+  language?: string; // identified natively (capture option languageId); the STT request's language in auto mode
+  timeMap?: Float64Array; // compacted chunks: speech:transcribe maps segment times back with chunkSourceMs
+}
+
+function pendingChunk(wav: Buffer, traceId?: string, fingerprint?: Uint32Array, language?: string, timeMap?: Float64Array): PendingChunk {
+  return { wav, traceId, arrivedMs: traceId ? traceNowMs() : 0, fingerprint, language, timeMap };
+}
+
 export function registerWasapiHandlers(): void {
   // Initialize audio addon on startup (only on supported platforms)
   if (process.platform === 'win32' || process.platform === 'darwin') {
@@ -404,7 +1945,7 @@ ipcMain.handle('wasapi:start-capture', async (event, pid: number) => {
 		const OVERLAP_FRAMES = Math.floor(OVERLAP_MS / VAD_FRAME_MS);
 
 		// Backpressure handling
-		let processingQueue: Buffer[] = [];
+		let processingQueue: PendingChunk[] = [];
 		let isProcessingBacklog = false;
 		const MAX_QUEUE_SIZE = 50; // Maximum WAV chunks to queue
 		
@@ -427,14 +1968,15 @@ ipcMain.handle('wasapi:start-capture', async (event, pid: number) => {
 			
 			try {
 				while (processingQueue.length > 0) {
-					const wavChunk = processingQueue.shift()!;
+					const { wav: wavChunk, traceId, arrivedMs, fingerprint, language, timeMap } = processingQueue.shift()!;
 					
 					// Send to renderer for transcription (fixed-size chunk)
 					try {
 						const { webContents } = require('electron');
 						const wc = webContents.fromId(webContentsId);
 						if (wc && !wc.isDestroyed()) {
-							wc.send('wasapi:chunk-wav', wavChunk);
+							traceSpan(traceId, 'chunk-emit', 'main', arrivedMs);
+							wc.send('wasapi:chunk-wav', wavChunk, traceId, fingerprint, language, timeMap);
 						}
 					} catch (error) {
 						console.warn('[main] Failed to send WAV chunk to renderer:', error);
@@ -449,25 +1991,107 @@ ipcMain.handle('wasapi:start-capture', async (event, pid: number) => {
 		};
 
 		// Start audio capture with WAV output and VAD
-		const startedOk: boolean = wasapiAddon.startCapture(pid >>> 0, (wavData: Buffer) => {
-			console.log(`[main] ${addonName} WAV data received:`, wavData.length, 'bytes');
+		// The renderer's analyzer worklet gets its own 60 ms pcm16 stream from the addon
+		// (same processed audio, produced once) instead of a re-send of every capture packet
+		const hosted = captureHostEnabled();
+		const rendererFeedPacket = (packet: CapturePacket) => {
+			if (!ArrayBuffer.isView(packet) || packet.length === 0) return;
+			const { webContents } = require('electron');
+			const wc = webContents.fromId(webContentsId);
+			if (wc && !wc.isDestroyed()) wc.send('wasapi:pcm', Buffer.from(packet.buffer, packet.byteOffset, packet.byteLength));
+		};
+		const rendererFeedOptions = { format: 'pcm16', frameMs: 20, framesPerPacket: 3, dtx: { hangoverMs: 2000 } };
+		const rendererFeed: boolean = typeof wasapiAddon.subscribe === 'function' &&
+			(hosted || wasapiAddon.subscribe('renderer-pcm', rendererFeedPacket, rendererFeedOptions));
+		startCaptionStream(webContentsId, initialCheck.sourceLanguage);
+
+		let captureFormat = { sampleRate: TARGET_RATE, channels: 1 };
+		let nativeChunker = false; // the addon cuts utterances and sends 'chunk' events
+		const repeats = new RepeatedAudioFilter(); // jingles and looping videos skip STT
+		// The host process runs the same capture and replays its callbacks here
+		const startCapture = hosted
+			? (target: number, callback: (...args: any[]) => void, options: Record<string, unknown>) => CaptureHost.getInstance().startCapture({
+				addon: wasapiAddon, addonPath: resolveAudioAddonPath()!, pid: target, callback, options,
+				feeds: [{ name: 'renderer-pcm', callback: rendererFeedPacket, options: rendererFeedOptions }],
+				onLevels: nativeLevelMeter ? updateOverlayLevels : undefined,
+			})
+			: wasapiAddon.startCapture;
+		const startedOk: boolean = await startCapture(pid >>> 0, unbatched((packet: CapturePacket, speech?: number) => {
+			if (!ArrayBuffer.isView(packet)) {
+				if (packet.type === 'chunk-stream') {
+					StreamedTranscription.getInstance().onPart(packet, initialCheck.sourceLanguage);
+					return;
+				}
+				if (packet.type === 'chunk') {
+					StreamedTranscription.getInstance().onChunk(packet.streamId, packet.fingerprint);
+					ChunkDifficultyRouter.getInstance().note(packet.fingerprint, packet.difficulty);
+					if (repeats.isRepeat(packet.fingerprint)) {
+						console.log(`[main] VAD: Skipped ${packet.durationMs}ms chunk, a repeat of recent audio`);
+						return;
+					}
+					const nonSpeech = nonSpeechLabel(packet);
+					if (nonSpeech) {
+						console.log(`[main] VAD: Skipped ${packet.durationMs}ms chunk, mostly ${nonSpeech}`);
+						return;
+					}
+					if (processingQueue.length < MAX_QUEUE_SIZE) {
+						processingQueue.push(pendingChunk(nativeChunkWav(packet), traceNativeChunk(packet, deviceClockNowMs(), 'loopback'), packet.fingerprint, packet.language?.code, packet.timeMap));
+						setImmediate(processBacklog);
+						console.log(`[main] VAD: Sent ${packet.durationMs}ms chunk (cut at ${packet.reason}, pause: ${packet.pauseMs}ms, overlap: ${packet.overlapMs}ms, ${packet.trimmedMs ? `trimmed: ${packet.trimmedMs}ms, ` : ''}${packet.compactedMs ? `compacted: ${packet.compactedMs}ms, ` : ''}${packet.lufs.toFixed(1)} LUFS${packet.speaker !== undefined ? `, speaker ${packet.speaker}` : ''}${packet.syllableRate ? `, ${packet.syllableRate.toFixed(1)} syl/s` : ''})${chunkArrivalLabel(packet)}`);
+					} else {
+						console.warn('[main] VAD: Processing queue full, dropping chunk');
+					}
+					return;
+				}
+				if (packet.type === 'silence-start' || packet.type === 'silence-end') {
+					if (packet.type === 'silence-end') console.log(`[main] ${addonName} capture resumed after ${packet.silentMs}ms of silence`);
+					return;
+				}
+				if (packet.type === 'discontinuity') {
+					console.warn(`[main] ${addonName} capture lost input before sample ${packet.sampleIndex} (${packet.count} gap(s), ${packet.total} total)`);
+					return;
+				}
+				if (packet.type === 'stall') {
+					if (packet.step === 'recovered') console.log(`[main] ${addonName} capture recovered from a stall after ${packet.stalledMs}ms`);
+					else console.warn(`[main] ${addonName} capture stalled for ${packet.stalledMs}ms; trying ${packet.step}`);
+					return;
+				}
+				if (packet.type === 'quality') {
+					logQualityStep(addonName, packet);
+					return;
+				}
+				if (packet.type === 'power') {
+					logPowerProfile(addonName, packet);
+					return;
+				}
+				if (packet.type === 'idle') {
+					logIdleRelease(addonName, packet);
+					return;
+				}
+				if (packet.type === 'keyword') {
+					onKeyword(addonName, webContentsId, packet);
+					return;
+				}
+				if (packet.type === 'format-changed') {
+					console.log(`[main] ${addonName} capture device format changed (${packet.reason}): ${packet.inputSampleRate} Hz, ${packet.inputChannels} ch`);
+				}
+				nativeChunker = packet.chunker === true;
+				captureFormat = packet;
+				return;
+			}
+			console.log(`[main] ${addonName} PCM data received:`, packet.byteLength, 'bytes');
 
 			// NOTE: No need to filter TTS audio - it's routed to VB-Audio Cable (separate device)
 			// WASAPI captures system audio which excludes the VB-Cable device
 
-			// Extract PCM data from WAV for VAD processing
-			// WAV header is 44 bytes, PCM data starts at offset 44
-			if (wavData.length <= 44) {
-				console.warn('[main] WAV chunk too small, skipping VAD');
-				return;
-			}
-			
-			const pcmData = wavData.subarray(44); // Skip WAV header
+			if (packet.length === 0) return;
+			const pcmData = Buffer.from(packet.buffer, packet.byteOffset, packet.byteLength);
 			
 			// Also send PCM data to renderer for real-time VAD analyzer (MediaStream feed)
 			// This allows the bidirectional VAD to detect audio levels in real-time
 			// CoreAudio sends 16kHz mono 16-bit PCM, which matches what the worklet expects
-			try {
+			// (older addons only; newer ones feed the renderer through the 'renderer-pcm' subscriber)
+			if (!rendererFeed) try {
 				const { webContents } = require('electron');
 				const wc = webContents.fromId(webContentsId);
 				if (wc && !wc.isDestroyed()) {
@@ -488,8 +2112,8 @@ ipcMain.handle('wasapi:start-capture', async (event, pid: number) => {
 				console.warn(`[main] Failed to send ${addonName} PCM to renderer:`, error);
 			}
 			
-			// Calculate audio levels for bidirectional overlay
-			try {
+			// Calculate audio levels for bidirectional overlay (older addons without watchLevels)
+			if (!nativeLevelMeter) try {
 				const int16Data = new Int16Array(pcmData.buffer, pcmData.byteOffset, pcmData.byteLength / 2);
 				let sumSq = 0;
 				for (let i = 0; i < int16Data.length; i++) {
@@ -514,13 +2138,27 @@ ipcMain.handle('wasapi:start-capture', async (event, pid: number) => {
 				// Ignore errors
 			}
 			
+			if (nativeChunker) {
+				// Frames are only metered here; keep the addon's minimum chunk length in step with the language
+				const now = Date.now();
+				if (now - lastLanguageCheck >= LANGUAGE_CHECK_INTERVAL_MS) {
+					const langCheck = getMinChunkMs();
+					if (langCheck.minChunkMs !== currentMinChunkMs) {
+						currentMinChunkMs = langCheck.minChunkMs;
+						MIN_CHUNK_FRAMES = Math.floor(currentMinChunkMs / VAD_FRAME_MS);
+						void loopbackControl(hosted, 'setMinChunkMs', currentMinChunkMs);
+						console.log(`[main] 🔄 Language changed - "${langCheck.sourceLanguage}" (Complex: ${langCheck.isComplex}), MIN_CHUNK_MS: ${currentMinChunkMs}`);
+					}
+					lastLanguageCheck = now;
+				}
+				return;
+			}
+
 			// Resample and convert for VAD if needed
 			// WASAPI output should already be 16-bit PCM, but we need 16kHz mono for VAD
 			let vadInput: Buffer;
 			
-			// Read WAV header to get format info
-			const channels = wavData.readUInt16LE(22);
-			const sampleRate = wavData.readUInt32LE(24);
+			const { channels, sampleRate } = captureFormat;
 			
 			if (sampleRate === TARGET_RATE && channels === 1) {
 				// Perfect format for VAD
@@ -557,11 +2195,16 @@ ipcMain.handle('wasapi:start-capture', async (event, pid: number) => {
 			}
 			
 			// Process VAD frames
-			pendingInt16 = Buffer.concat([pendingInt16, vadInput]);
+			// The addon emits whole VAD frames (frameMs), so the carry buffer is normally empty
+			// Native speech bits index this packet's frames, so they only apply while no carry is pending
+			const nativeSpeech = pendingInt16.length === 0 ? speech : undefined;
+			let nextFrame = 0;
+			pendingInt16 = pendingInt16.length > 0 ? Buffer.concat([pendingInt16, vadInput]) : vadInput;
 			
 			while (pendingInt16.length >= VAD_FRAME_BYTES) {
 				const frame = pendingInt16.subarray(0, VAD_FRAME_BYTES);
 				pendingInt16 = pendingInt16.subarray(VAD_FRAME_BYTES);
+				const frameIndex = nextFrame++;
 
         			// Dynamically update chunking parameters if language changed
 			const now = Date.now();
@@ -574,9 +2217,11 @@ ipcMain.handle('wasapi:start-capture', async (event, pid: number) => {
 				}
 				lastLanguageCheck = now;
 			}
-			// Detect speech using WebRTC VAD or fallback
+			// Detect speech using the addon's per-frame bits, WebRTC VAD or fallback
 			let isSpeech = false;
-				if (vad) {
+				if (nativeSpeech !== undefined) {
+					isSpeech = ((nativeSpeech >>> frameIndex) & 1) === 1;
+				} else if (vad) {
 					try { 
 						isSpeech = vad.isSpeech(frame, TARGET_RATE); 
 					} catch (error) { 
@@ -622,7 +2267,7 @@ ipcMain.handle('wasapi:start-capture', async (event, pid: number) => {
 					const chunkWav = convertPcmToWav(chunkPcm, TARGET_RATE, 1);
 
 					if (processingQueue.length < MAX_QUEUE_SIZE) {
-						processingQueue.push(chunkWav);
+						processingQueue.push(pendingChunk(chunkWav, newTraceId('loopback')));
 						setImmediate(processBacklog);
 						const chunkDurationMs = (allFrames.length * VAD_FRAME_MS).toFixed(0);
 						const cutReason = shouldForceCut ? 'max-length' : 'pause';
@@ -651,7 +2296,7 @@ ipcMain.handle('wasapi:start-capture', async (event, pid: number) => {
 				const chunkWav = convertPcmToWav(chunkPcm, TARGET_RATE, 1);
 
 				if (processingQueue.length < MAX_QUEUE_SIZE) {
-					processingQueue.push(chunkWav);
+					processingQueue.push(pendingChunk(chunkWav, newTraceId('loopback')));
 					setImmediate(processBacklog);
 				}
 
@@ -672,13 +2317,35 @@ ipcMain.handle('wasapi:start-capture', async (event, pid: number) => {
 				}
 			}
 		}
-	});
+	}), {
+		frameMs: VAD_FRAME_MS, framesPerPacket: 5, format: 'pcm16', vad: 'very-aggressive', neuralVad: neuralVadCaptureOption(), timestamps: true, batch: true,
+		dtx: { hangoverMs: 2000 }, // no packets while nothing is said; chunks are unaffected
+		governor: true, // local Whisper competes for the same cores
+		power: true, // on battery: no denoise, fewer JS wakeups, powersave streams
+		idle: { minutes: CAPTURE_IDLE_MINUTES },
+		chunker: { minChunkMs: currentMinChunkMs, maxChunkMs: MAX_CHUNK_MS, pauseMs: PAUSE_THRESHOLD_MS, overlapMs: OVERLAP_MS, valleyMs: CUT_VALLEY_MS, trimMs: CHUNK_TRIM_MS, compact: CHUNK_COMPACT, adaptive: adaptiveChunkingOption(), stream: chunkStreamOption() },
+		history: CAPTURE_HISTORY,
+		record: recordCaptureOption(),
+		keyword: keywordCaptureOption(),
+		mel: melCaptureOption(),
+		content: true,
+		languageId: languageIdCaptureOption(initialCheck.sourceLanguage, 2500),
+		speaker: speakerCaptureOption(),
+		conversion: conversionCaptureOption(),
+		outputDevice: pid === 0 ? outputDeviceCaptureOption() : undefined,
+		warmStart: warmStartCaptureOption(loopbackWarmStartKey(pid)),
+	}); // 100 ms packets with native speech bits for metering; utterances arrive as 'chunk' events
 		
 		if (!startedOk) {
 			const addonName = process.platform === 'darwin' ? 'CoreAudio' : 'WASAPI';
 			console.error(`[main] ${addonName} startCapture returned false (capture thread not started)`);
 			return { success: false, error: `Failed to start ${addonName} capture (addon returned false)` };
 		}
+		// The host loaded a fresh addon: bring its voice boost in line with ours
+		if (hosted && nativeVoiceBoost) {
+			void loopbackControl(true, 'setVoiceBoostLevel', voiceBoostLevel);
+			void loopbackControl(true, 'setVoiceBoostEnabled', voiceBoostEnabled);
+		}
 		
 		return { success: true };
 	} catch (error) {
@@ -707,10 +2374,19 @@ ipcMain.handle('wasapi:stop-capture', async (event) => {
         console.warn('[main] Failed to send flush signal:', error);
       }
       
-      // Wait a moment for the flush to be processed
-      await new Promise(resolve => setTimeout(resolve, 100));
-      
-      wasapiAddon.stopCapture();
+      // The renderer flushes while the addon tears the capture down off the main thread
+      if (CaptureHost.getInstance().isRunning()) {
+        await CaptureHost.getInstance().stop();
+      } else if (typeof wasapiAddon.stopCaptureAsync === 'function') {
+        await wasapiAddon.stopCaptureAsync();
+      } else {
+        await new Promise(resolve => setTimeout(resolve, 100));
+        wasapiAddon.stopCapture();
+      }
+      if (typeof wasapiAddon.unsubscribe === 'function') wasapiAddon.unsubscribe('renderer-pcm');
+      StreamedTranscription.getInstance().reset();
+      ChunkDifficultyRouter.getInstance().reset();
+      await stopCaptionStream(webContentsId);
     }
     return { success: true };
   } catch (error) {
@@ -796,7 +2472,7 @@ ipcMain.handle('wasapi:start-capture-exclude-current', async (event) => {
 		const OVERLAP_FRAMES = Math.floor(OVERLAP_MS / VAD_FRAME_MS);
 
 		// Backpressure handling
-		let processingQueue: Buffer[] = [];
+		let processingQueue: PendingChunk[] = [];
 		let isProcessingBacklog = false;
 		const MAX_QUEUE_SIZE = 50; // Maximum WAV chunks to queue
 		
@@ -819,14 +2495,15 @@ ipcMain.handle('wasapi:start-capture-exclude-current', async (event) => {
 			
 			try {
 				while (processingQueue.length > 0) {
-					const wavChunk = processingQueue.shift()!;
+					const { wav: wavChunk, traceId, arrivedMs, fingerprint, language, timeMap } = processingQueue.shift()!;
 					
 					// Send to renderer for transcription (fixed-size chunk)
 					try {
 						const { webContents } = require('electron');
 						const wc = webContents.fromId(webContentsId);
 						if (wc && !wc.isDestroyed()) {
-							wc.send('wasapi:chunk-wav', wavChunk);
+							traceSpan(traceId, 'chunk-emit', 'main', arrivedMs);
+							wc.send('wasapi:chunk-wav', wavChunk, traceId, fingerprint, language, timeMap);
 						}
 					} catch (error) {
 						console.warn('[main] Failed to send WAV chunk to renderer:', error);
@@ -841,32 +2518,114 @@ ipcMain.handle('wasapi:start-capture-exclude-current', async (event) => {
 		};
 
 		// Start audio capture with current process excluded
-		const startedOk: boolean = wasapiAddon.startCaptureExcludeCurrent((wavData: Buffer) => {
-			console.log(`[main] ${addonName} WAV data received (exclude current):`, wavData.length, 'bytes');
+		let captureFormat = { sampleRate: TARGET_RATE, channels: 1 };
+		let nativeChunker = false; // the addon cuts utterances and sends 'chunk' events
+		const repeats = new RepeatedAudioFilter(); // jingles and looping videos skip STT
+		// Process loopback (Windows 10 2004+) or a process tap (macOS 14.4+) leaves our
+		// own process tree out of the capture, so TTS never reaches it; the addon
+		// reports this once the client is up. Otherwise drop audio around playback.
+		let selfExcluded = false;
+		const ttsInCapture = (): boolean => {
+			if (!selfExcluded) selfExcluded = wasapiAddon.getStats?.().selfExcluded === true;
+			return !selfExcluded && (isTtsPlaying || Date.now() <= ttsPlaybackEndTime + 500); // 500ms grace period
+		};
+		const startedOk: boolean = wasapiAddon.startCaptureExcludeCurrent(unbatched((packet: CapturePacket, speech?: number) => {
+			if (!ArrayBuffer.isView(packet)) {
+				if (packet.type === 'chunk-stream') {
+					StreamedTranscription.getInstance().onPart(packet, initialCheck.sourceLanguage);
+					return;
+				}
+				if (packet.type === 'chunk') {
+					StreamedTranscription.getInstance().onChunk(packet.streamId, packet.fingerprint);
+					ChunkDifficultyRouter.getInstance().note(packet.fingerprint, packet.difficulty);
+					// Utterances cut while TTS was playing would feed our own voice back
+					if (ttsInCapture()) return;
+					if (repeats.isRepeat(packet.fingerprint)) {
+						console.log(`[main] VAD: Skipped ${packet.durationMs}ms chunk, a repeat of recent audio`);
+						return;
+					}
+					const nonSpeech = nonSpeechLabel(packet);
+					if (nonSpeech) {
+						console.log(`[main] VAD: Skipped ${packet.durationMs}ms chunk, mostly ${nonSpeech}`);
+						return;
+					}
+					if (processingQueue.length < MAX_QUEUE_SIZE) {
+						processingQueue.push(pendingChunk(nativeChunkWav(packet), traceNativeChunk(packet, deviceClockNowMs(), 'loopback'), packet.fingerprint, packet.language?.code, packet.timeMap));
+						setImmediate(processBacklog);
+						console.log(`[main] VAD: Sent ${packet.durationMs}ms chunk (cut at ${packet.reason}, pause: ${packet.pauseMs}ms, overlap: ${packet.overlapMs}ms, ${packet.trimmedMs ? `trimmed: ${packet.trimmedMs}ms, ` : ''}${packet.compactedMs ? `compacted: ${packet.compactedMs}ms, ` : ''}${packet.lufs.toFixed(1)} LUFS${packet.speaker !== undefined ? `, speaker ${packet.speaker}` : ''}${packet.syllableRate ? `, ${packet.syllableRate.toFixed(1)} syl/s` : ''})${chunkArrivalLabel(packet)}`);
+					} else {
+						console.warn('[main] VAD: Processing queue full, dropping chunk');
+					}
+					return;
+				}
+				if (packet.type === 'silence-start' || packet.type === 'silence-end') {
+					if (packet.type === 'silence-end') console.log(`[main] ${addonName} capture resumed after ${packet.silentMs}ms of silence`);
+					return;
+				}
+				if (packet.type === 'discontinuity') {
+					console.warn(`[main] ${addonName} capture lost input before sample ${packet.sampleIndex} (${packet.count} gap(s), ${packet.total} total)`);
+					return;
+				}
+				if (packet.type === 'stall') {
+					if (packet.step === 'recovered') console.log(`[main] ${addonName} capture recovered from a stall after ${packet.stalledMs}ms`);
+					else console.warn(`[main] ${addonName} capture stalled for ${packet.stalledMs}ms; trying ${packet.step}`);
+					return;
+				}
+				if (packet.type === 'quality') {
+					logQualityStep(addonName, packet);
+					return;
+				}
+				if (packet.type === 'power') {
+					logPowerProfile(addonName, packet);
+					return;
+				}
+				if (packet.type === 'idle') {
+					logIdleRelease(addonName, packet);
+					return;
+				}
+				if (packet.type === 'keyword') {
+					onKeyword(addonName, webContentsId, packet);
+					return;
+				}
+				if (packet.type === 'format-changed') {
+					console.log(`[main] ${addonName} capture device format changed (${packet.reason}): ${packet.inputSampleRate} Hz, ${packet.inputChannels} ch`);
+				}
+				nativeChunker = packet.chunker === true;
+				captureFormat = packet;
+				return;
+			}
+			console.log(`[main] ${addonName} PCM data received (exclude current):`, packet.byteLength, 'bytes');
 			
 			// Filter out audio during TTS playback to prevent feedback
-			const currentTime = Date.now();
-			if (isTtsPlaying || (currentTime <= ttsPlaybackEndTime + 500)) { // 500ms grace period
+			if (ttsInCapture()) {
 				console.log('[main] Filtering out WASAPI audio during TTS playback (exclude current)');
 				return;
 			}
 			
-			// Extract PCM data from WAV for VAD processing
-			// WAV header is 44 bytes, PCM data starts at offset 44
-			if (wavData.length <= 44) {
-				console.warn('[main] WAV chunk too small, skipping VAD');
+			if (packet.length === 0) return;
+			const pcmData = Buffer.from(packet.buffer, packet.byteOffset, packet.byteLength);
+			
+			if (nativeChunker) {
+				// Frames are only metered here; keep the addon's minimum chunk length in step with the language
+				const now = Date.now();
+				if (now - lastLanguageCheck >= LANGUAGE_CHECK_INTERVAL_MS) {
+					const langCheck = getMinChunkMs();
+					if (langCheck.minChunkMs !== currentMinChunkMs) {
+						currentMinChunkMs = langCheck.minChunkMs;
+						MIN_CHUNK_FRAMES = Math.floor(currentMinChunkMs / VAD_FRAME_MS);
+						wasapiAddon.setMinChunkMs(currentMinChunkMs);
+						console.log(`[main] 🔄 Language changed - "${langCheck.sourceLanguage}" (Complex: ${langCheck.isComplex}), MIN_CHUNK_MS: ${currentMinChunkMs}`);
+					}
+					lastLanguageCheck = now;
+				}
 				return;
 			}
-			
-			const pcmData = wavData.subarray(44); // Skip WAV header
-			
+
 			// Resample and convert for VAD if needed
 			// WASAPI output should already be 16-bit PCM, but we need 16kHz mono for VAD
 			let vadInput: Buffer;
 			
-			// Read WAV header to get format info
-			const channels = wavData.readUInt16LE(22);
-			const sampleRate = wavData.readUInt32LE(24);
+			const { channels, sampleRate } = captureFormat;
 			
 			if (sampleRate === TARGET_RATE && channels === 1) {
 				// Perfect format for VAD
@@ -903,11 +2662,16 @@ ipcMain.handle('wasapi:start-capture-exclude-current', async (event) => {
 			}
 			
 			// Process VAD frames
-			pendingInt16 = Buffer.concat([pendingInt16, vadInput]);
+			// The addon emits whole VAD frames (frameMs), so the carry buffer is normally empty
+			// Native speech bits index this packet's frames, so they only apply while no carry is pending
+			const nativeSpeech = pendingInt16.length === 0 ? speech : undefined;
+			let nextFrame = 0;
+			pendingInt16 = pendingInt16.length > 0 ? Buffer.concat([pendingInt16, vadInput]) : vadInput;
 			
 			while (pendingInt16.length >= VAD_FRAME_BYTES) {
 				const frame = pendingInt16.subarray(0, VAD_FRAME_BYTES);
 				pendingInt16 = pendingInt16.subarray(VAD_FRAME_BYTES);
+				const frameIndex = nextFrame++;
 
         	// Dynamically update chunking parameters if language changed
 			const now = Date.now();
@@ -921,9 +2685,11 @@ ipcMain.handle('wasapi:start-capture-exclude-current', async (event) => {
 				lastLanguageCheck = now;
 			}
       
-			// Detect speech using WebRTC VAD or fallback
+			// Detect speech using the addon's per-frame bits, WebRTC VAD or fallback
 			let isSpeech = false;
-				if (vad) {
+				if (nativeSpeech !== undefined) {
+					isSpeech = ((nativeSpeech >>> frameIndex) & 1) === 1;
+				} else if (vad) {
 					try { 
 						isSpeech = vad.isSpeech(frame, TARGET_RATE); 
 					} catch (error) { 
@@ -969,7 +2735,7 @@ ipcMain.handle('wasapi:start-capture-exclude-current', async (event) => {
 					const chunkWav = convertPcmToWav(chunkPcm, TARGET_RATE, 1);
 
 					if (processingQueue.length < MAX_QUEUE_SIZE) {
-						processingQueue.push(chunkWav);
+						processingQueue.push(pendingChunk(chunkWav, newTraceId('loopback')));
 						setImmediate(processBacklog);
 						const chunkDurationMs = (allFrames.length * VAD_FRAME_MS).toFixed(0);
 						const cutReason = shouldForceCut ? 'max-length' : 'pause';
@@ -998,7 +2764,7 @@ ipcMain.handle('wasapi:start-capture-exclude-current', async (event) => {
 				const chunkWav = convertPcmToWav(chunkPcm, TARGET_RATE, 1);
 
 				if (processingQueue.length < MAX_QUEUE_SIZE) {
-					processingQueue.push(chunkWav);
+					processingQueue.push(pendingChunk(chunkWav, newTraceId('loopback')));
 					setImmediate(processBacklog);
 				}
 
@@ -1019,7 +2785,24 @@ ipcMain.handle('wasapi:start-capture-exclude-current', async (event) => {
 				}
 			}
 		}
-	});
+	}), {
+		frameMs: VAD_FRAME_MS, framesPerPacket: 5, format: 'pcm16', vad: 'very-aggressive', neuralVad: neuralVadCaptureOption(), timestamps: true, batch: true,
+		dtx: { hangoverMs: 2000 }, // no packets while nothing is said; chunks are unaffected
+		governor: true, // local Whisper competes for the same cores
+		power: true, // on battery: no denoise, fewer JS wakeups, powersave streams
+		idle: { minutes: CAPTURE_IDLE_MINUTES },
+		selfEcho: true, // our TTS heard back without process exclusion is vetoed before the chunker
+		chunker: { minChunkMs: currentMinChunkMs, maxChunkMs: MAX_CHUNK_MS, pauseMs: PAUSE_THRESHOLD_MS, overlapMs: OVERLAP_MS, valleyMs: CUT_VALLEY_MS, trimMs: CHUNK_TRIM_MS, compact: CHUNK_COMPACT, adaptive: adaptiveChunkingOption(), stream: chunkStreamOption() },
+		history: CAPTURE_HISTORY,
+		record: recordCaptureOption(),
+		keyword: keywordCaptureOption(),
+		mel: melCaptureOption(),
+		content: true,
+		languageId: languageIdCaptureOption(initialCheck.sourceLanguage, 1250),
+		speaker: speakerCaptureOption(),
+		conversion: conversionCaptureOption(),
+		warmStart: warmStartCaptureOption(loopbackWarmStartKey(0)),
+	}); // 100 ms packets with native speech bits for metering; utterances arrive as 'chunk' events
 		
 		if (!startedOk) {
 			const addonName = process.platform === 'darwin' ? 'CoreAudio' : 'WASAPI';
@@ -1035,6 +2818,203 @@ ipcMain.handle('wasapi:start-capture-exclude-current', async (event) => {
 	}
 });
 
+// inputDevice: part of the device name, case-insensitive; omitted for the default input.
+// armed: push-to-talk; the device opens now, chunks flow between
+// 'wasapi:mic-delivery' true and false, starting with the 300 ms before
+ipcMain.handle('wasapi:start-mic-capture', async (event, inputDevice?: string, armed?: boolean) => {
+	try {
+		if (micSession?.running) return { success: true };
+		micSession = createNativeCaptureSession();
+		if (!micSession) throw new Error('Native capture addon not available');
+
+		const webContentsId = event.sender.id;
+		const arm = armed && typeof micSession.arm === 'function';
+		const startedOk = (arm ? micSession.arm! : micSession.start).call(micSession, 0, unbatched((packet: Buffer | CapturePacket) => {
+			if (ArrayBuffer.isView(packet)) return;
+			if (packet.type === 'quality') logQualityStep('Microphone', packet);
+			if (packet.type === 'power') logPowerProfile('Microphone', packet);
+			if (packet.type !== 'chunk') return;
+			const { webContents } = require('electron');
+			const wc = webContents.fromId(webContentsId);
+			const traceId = traceNativeChunk(packet, deviceClockNowMs(), 'mic');
+			if (wc && !wc.isDestroyed()) wc.send('wasapi:mic-chunk-wav', nativeChunkWav(packet), traceId);
+		}), {
+			source: 'microphone', inputDevice, echoCancel: true, ...micStreamOptions(),
+			frameMs: 20, framesPerPacket: 5, format: 'pcm16', vad: 'very-aggressive', neuralVad: neuralVadCaptureOption(), dtx: true, timestamps: true, governor: true, power: true, batch: true,
+			declick: true, // keyboard and mouse clicks never reach the VAD as speech
+			chunker: { minChunkMs: 500, maxChunkMs: 3000, pauseMs: 50, overlapMs: 100, valleyMs: CUT_VALLEY_MS, trimMs: CHUNK_TRIM_MS }, mel: melCaptureOption(),
+			arm: { prerollMs: 300 },
+			warmStart: warmStartCaptureOption(`microphone:${inputDevice || 'default'}`),
+		});
+		if (!startedOk) {
+			micSession = null;
+			return { success: false, error: 'Native microphone capture did not start' };
+		}
+		// The client opens on the capture thread; report the mode it got once it's up
+		const session = micSession;
+		setTimeout(() => {
+			if (!session.running) return;
+			const stats = session.getStats();
+			console.log(`[main] Native mic: ${stats.micRaw ? 'raw' : 'with endpoint effects'}, ` +
+				`${stats.devicePeriodMs} ms period, ${stats.streamLatencyMs} ms stream latency`);
+		}, 1000);
+		return { success: true };
+	} catch (error) {
+		console.error('[main] Failed to start native microphone capture:', error);
+		return { success: false, error: error instanceof Error ? error.message : String(error) };
+	}
+});
+
+// Push-to-talk key down (true) and up (false) for an armed mic capture; a
+// capture that was not armed delivers throughout
+ipcMain.handle('wasapi:mic-delivery', async (_event, open: boolean) => {
+	if (!micSession?.running) return { success: false, error: 'Native microphone capture not running' };
+	if (open) micSession.beginDelivery?.();
+	else micSession.endDelivery?.();
+	return { success: true, delivering: micSession.delivering ?? true };
+});
+
+ipcMain.handle('wasapi:stop-mic-capture', async () => {
+	micSession?.stop();
+	micSession = null;
+	return { success: true };
+});
+
+// The default capture's last lastMs of processed audio (at most the 120 s it
+// keeps), as one WAV file; null when nothing is held
+ipcMain.handle('wasapi:get-history', async (_event, lastMs: number = 30000) => {
+	if (typeof wasapiAddon?.getHistory !== 'function' || typeof wasapiAddon.deviceClockMs !== 'function') {
+		return { success: false, error: 'Capture history not available' };
+	}
+	const nowMs: number = wasapiAddon.deviceClockMs();
+	// A hosted capture keeps its history in the host; the device clock is the same in both processes
+	const history = await loopbackControl(CaptureHost.getInstance().isRunning(), 'getHistory', nowMs - lastMs, nowMs) as
+		NativeCaptureHistory | null | undefined;
+	if (history === undefined) return { success: false, error: 'Capture history not available' };
+	// The parent port delivers the host's Buffer as a plain Uint8Array
+	if (history && !Buffer.isBuffer(history.data)) history.data = Buffer.from(history.data);
+	return { success: true, history };
+});
+
+// Render and capture endpoints for the device pickers (uiSettings.loopbackDevices,
+// the mic's inputDevice); empty where the addon can't list them
+ipcMain.handle('wasapi:list-endpoints', async (): Promise<NativeAudioEndpoint[]> => {
+	if (!loadWasapiAddon() || typeof wasapiAddon?.listAudioEndpoints !== 'function') return [];
+	return wasapiAddon.listAudioEndpoints();
+});
+
+// Stops the session and hands back the capture, which one session at a time
+// mixes, rather than waiting for the session to be collected
+function releaseTtsRender(): void {
+	if (!ttsRender) return;
+	ttsRender.stop();
+	ttsRender.setInput('capture', { enabled: false });
+}
+
+// mixSoundboard plays the soundboard's mic bus through the session instead of
+// its own output; micReturn mixes in the user's own (captured) voice, ducked
+// under the TTS and soundboard by duckDb (default -18).
+ipcMain.handle('wasapi:start-tts-render', async (_event, options?: {
+	device?: string;
+	lowLatency?: boolean;
+	mixSoundboard?: boolean;
+	micReturn?: boolean | { gain?: number; duckDb?: number };
+}) => {
+	try {
+		releaseTtsRender();
+		ttsRender = createNativeRenderSession();
+		if (!ttsRender) return { success: false, error: 'Native render sessions not available' };
+		const { mixSoundboard, micReturn, ...startOptions } = options ?? {};
+		if (mixSoundboard) {
+			try {
+				ttsRender.setInput('soundboard', { enabled: true });
+			} catch (error) {
+				console.warn('[main] Soundboard stays on its own output:', error);
+			}
+		}
+		if (micReturn) {
+			const mic = typeof micReturn === 'object' ? micReturn : {};
+			try {
+				ttsRender.setInput('capture', { enabled: true, gain: mic.gain ?? 1, duckDb: mic.duckDb ?? -18, duckBy: ['tts', 'soundboard'] });
+			} catch (error) {
+				console.warn('[main] Mic return not mixed:', error);
+			}
+		}
+		// Long sentences' TTS would otherwise pile up behind the speaker
+		const device = ttsRender.start({ catchUp: true, ...startOptions, sampleRate: TTS_RENDER_RATE });
+		console.log(`[main] Native TTS render on '${device}'`);
+		return { success: true, device };
+	} catch (error) {
+		ttsRender = null;
+		console.error('[main] Failed to start native TTS render:', error);
+		return { success: false, error: error instanceof Error ? error.message : String(error) };
+	}
+});
+
+ipcMain.handle('wasapi:stop-tts-render', async () => {
+	ttsRenderDecoder?.close();
+	ttsRenderDecoder = null;
+	releaseTtsRender();
+	ttsRender = null;
+	return { success: true };
+});
+
+ipcMain.handle('wasapi:tts-render-stats', async () => ttsRender?.getStats() ?? null);
+
+// The addon's native threads and their share of a core, for high-CPU reports
+ipcMain.handle('wasapi:thread-stats', async (): Promise<NativeThreadCpu[]> => {
+	if (!loadWasapiAddon() || typeof wasapiAddon.getThreadStats !== 'function') return [];
+	return wasapiAddon.getThreadStats();
+});
+
+const MEDIA_PICKER: OpenDialogOptions = {
+	title: 'Select a recording to transcribe',
+	filters: [
+		{ name: 'Audio and Video', extensions: ['wav', 'mp3', 'm4a', 'aac', 'flac', 'ogg', 'opus', 'mp4', 'mkv', 'mov', 'webm'] },
+		{ name: 'All Files', extensions: ['*'] }
+	],
+	properties: ['openFile']
+};
+
+// A recording or video transcribed by the local Whisper model at the cores'
+// speed; without a file, asks for one. Needs an addon built with use_avformat=1
+// and use_whisper=1 and a model loaded (LocalProcessingManager)
+ipcMain.handle('wasapi:transcribe-media', async (event, file?: string, options?: { language?: string; translate?: boolean; concurrency?: number }) => {
+	if (!file) {
+		const window = BrowserWindow.fromWebContents(event.sender);
+		const picked = await (window ? dialog.showOpenDialog(window, MEDIA_PICKER) : dialog.showOpenDialog(MEDIA_PICKER));
+		if (picked.canceled || picked.filePaths.length === 0) return { success: false, canceled: true };
+		file = picked.filePaths[0];
+	}
+	try {
+		const pending = transcribeNativeMedia(file, { ...options, language: options?.language === 'auto' ? undefined : options?.language });
+		if (!pending) return { success: false, error: 'Media transcription not available' };
+		const transcript = await pending;
+		console.log(`[main] Transcribed ${path.basename(file)}: ${(transcript.audioMs / 1000).toFixed(0)}s of audio in ${(transcript.wallMs / 1000).toFixed(1)}s, ${transcript.pieces} pieces${transcript.failed ? `, ${transcript.failed} failed` : ''}`);
+		return { success: true, file, transcript };
+	} catch (error) {
+		console.error('[main] Media transcription failed:', error);
+		return { success: false, file, error: error instanceof Error ? error.message : String(error) };
+	}
+});
+
+// Batch HWND -> { pid, processName } for the window picker; one native call per refresh
+ipcMain.handle('resolve-pids-from-windows', async (event, windowHandles: Array<number | bigint>) => {
+  try {
+    if (process.platform !== 'win32' || !Array.isArray(windowHandles)) {
+      return [];
+    }
+    if (!loadWasapiAddon() || typeof wasapiAddon.resolvePidsFromWindows !== 'function') {
+      console.warn('[main] WASAPI addon unavailable when resolving PIDs from windows');
+      return windowHandles.map(() => ({ pid: 0, processName: '' }));
+    }
+    return wasapiAddon.resolvePidsFromWindows(windowHandles);
+  } catch (error) {
+    console.error('[main] Failed to resolve PIDs from window handles:', error);
+    return [];
+  }
+});
+
 // Helper to resolve PID from window handle on Windows
 ipcMain.handle('resolve-pid-from-window', async (event, windowHandle: number) => {
   try {
@@ -1099,7 +3079,9 @@ ipcMain.handle('find-audio-pid-for-process', async (event, processName: string)
 			return null;
 		}
 		
-		const pid = wasapiAddon.findAudioPidForProcess(processName);
+		const pid = typeof wasapiAddon.findAudioPidForProcessAsync === 'function'
+			? await wasapiAddon.findAudioPidForProcessAsync(processName)
+			: wasapiAddon.findAudioPidForProcess(processName);
 		if (pid && pid > 0) {
 			console.log('[main] Found active audio PID:', pid, 'for process:', processName);
 			return pid;
@@ -1177,7 +3159,7 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
 		console.log(`[main] 🎯 ${addonName} by-process - Language: "${initialCheck.sourceLanguage}", IsComplex: ${initialCheck.isComplex}, CHUNK_MS: ${currentChunkMs}`);
 
 		// Backpressure handling
-		let processingQueue: Buffer[] = [];
+		let processingQueue: PendingChunk[] = [];
 		let isProcessingBacklog = false;
 		const MAX_QUEUE_SIZE = 50;
 		
@@ -1199,13 +3181,14 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
 			
 			try {
 				while (processingQueue.length > 0) {
-					const wavChunk = processingQueue.shift()!;
+					const { wav: wavChunk, traceId, arrivedMs, fingerprint, language, timeMap } = processingQueue.shift()!;
 					
 					try {
 						const { webContents } = require('electron');
 						const wc = webContents.fromId(webContentsId);
 						if (wc && !wc.isDestroyed()) {
-							wc.send('wasapi:chunk-wav', wavChunk);
+							traceSpan(traceId, 'chunk-emit', 'main', arrivedMs);
+							wc.send('wasapi:chunk-wav', wavChunk, traceId, fingerprint, language, timeMap);
 						}
 					} catch (error) {
 						console.warn('[main] Failed to send WAV chunk to renderer:', error);
@@ -1218,23 +3201,53 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
 			}
 		};
 
-		// Start capture by process name (addon will resolve PID internally)
-		const startedOk2: boolean = wasapiAddon.startCaptureByProcessName(processName, (wavData: Buffer) => {
-			console.log(`[main] ${addonName} WAV data received for`, processName, ':', wavData.length, 'bytes');
+		// Start capture by process name (addon will resolve PID internally, off the main thread when it can)
+		let captureFormat = { sampleRate: TARGET_RATE, channels: 1 };
+		const startByProcessName = typeof wasapiAddon.startCaptureByProcessNameAsync === 'function'
+			? wasapiAddon.startCaptureByProcessNameAsync
+			: wasapiAddon.startCaptureByProcessName;
+		const startedOk2: boolean = await startByProcessName(processName, unbatched((packet: CapturePacket, speech?: number) => {
+			if (!ArrayBuffer.isView(packet)) {
+				if (packet.type === 'silence-start' || packet.type === 'silence-end') {
+					if (packet.type === 'silence-end') console.log(`[main] ${addonName} capture resumed after ${packet.silentMs}ms of silence`);
+					return;
+				}
+				if (packet.type === 'discontinuity') {
+					console.warn(`[main] ${addonName} capture lost input before sample ${packet.sampleIndex} (${packet.count} gap(s), ${packet.total} total)`);
+					return;
+				}
+				if (packet.type === 'stall') {
+					if (packet.step === 'recovered') console.log(`[main] ${addonName} capture recovered from a stall after ${packet.stalledMs}ms`);
+					else console.warn(`[main] ${addonName} capture stalled for ${packet.stalledMs}ms; trying ${packet.step}`);
+					return;
+				}
+				if (packet.type === 'quality') {
+					logQualityStep(addonName, packet);
+					return;
+				}
+				if (packet.type === 'power') {
+					logPowerProfile(addonName, packet);
+					return;
+				}
+				if (packet.type === 'idle') {
+					logIdleRelease(addonName, packet);
+					return;
+				}
+				if (packet.type === 'format-changed') {
+					console.log(`[main] ${addonName} capture device format changed (${packet.reason}): ${packet.inputSampleRate} Hz, ${packet.inputChannels} ch`);
+				}
+				captureFormat = packet;
+				return;
+			}
+			console.log(`[main] ${addonName} PCM data received for`, processName, ':', packet.byteLength, 'bytes');
 			
 			// DON'T filter during TTS when capturing specific process
 			// Since we're only capturing the selected app (e.g., Chrome), we won't hear Whispra's TTS
 			// This allows continuous chunk capture without stopping after chunk 3
 			
-			// Extract PCM data from WAV for VAD processing
-			if (wavData.length <= 44) {
-				console.warn('[main] WAV chunk too small, skipping VAD');
-				return;
-			}
-			
-			const pcmData = wavData.subarray(44);
-			const channels = wavData.readUInt16LE(22);
-			const sampleRate = wavData.readUInt32LE(24);
+			if (packet.length === 0) return;
+			const pcmData = Buffer.from(packet.buffer, packet.byteOffset, packet.byteLength);
+			const { channels, sampleRate } = captureFormat;
 			
 			// Prepare VAD input
 			let vadInput: Buffer;
@@ -1270,11 +3283,16 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
 			}
 			
 			// Process VAD frames
-			pendingInt16 = Buffer.concat([pendingInt16, vadInput]);
+			// The addon emits whole VAD frames (frameMs), so the carry buffer is normally empty
+			// Native speech bits index this packet's frames, so they only apply while no carry is pending
+			const nativeSpeech = pendingInt16.length === 0 ? speech : undefined;
+			let nextFrame = 0;
+			pendingInt16 = pendingInt16.length > 0 ? Buffer.concat([pendingInt16, vadInput]) : vadInput;
 			
 			while (pendingInt16.length >= VAD_FRAME_BYTES) {
 				const frame = pendingInt16.subarray(0, VAD_FRAME_BYTES);
 				pendingInt16 = pendingInt16.subarray(VAD_FRAME_BYTES);
+				const frameIndex = nextFrame++;
 
 				// Dynamically update chunking parameters if language changed
 				const now = Date.now();
@@ -1288,7 +3306,9 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
 				}
 
 				let isSpeech = false;
-				if (vad) {
+				if (nativeSpeech !== undefined) {
+					isSpeech = ((nativeSpeech >>> frameIndex) & 1) === 1;
+				} else if (vad) {
 					try { 
 						isSpeech = vad.isSpeech(frame, TARGET_RATE); 
 					} catch (error) { 
@@ -1331,7 +3351,7 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
 					const chunkPcm = Buffer.concat(chunkFrames);
 					const chunkWav = convertPcmToWav(chunkPcm, TARGET_RATE, 1);
 					if (processingQueue.length < MAX_QUEUE_SIZE) {
-						processingQueue.push(chunkWav);
+						processingQueue.push(pendingChunk(chunkWav, newTraceId('loopback')));
 						setImmediate(processBacklog);
 					} else {
 						console.warn('[main] VAD: Processing queue full, dropping chunk');
@@ -1342,7 +3362,7 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
 				chunkHasSpeech = false;
 			}
 		}
-	});
+	}), { frameMs: VAD_FRAME_MS, format: 'pcm16', vad: 'very-aggressive', neuralVad: neuralVadCaptureOption(), governor: true, power: true, idle: { minutes: CAPTURE_IDLE_MINUTES }, batch: true, history: CAPTURE_HISTORY, record: recordCaptureOption(), warmStart: warmStartCaptureOption('loopback:app') }); // whole 20 ms VAD frames with native speech bits, no WAV header
 		
 		if (!startedOk2) {
 			const addonName = process.platform === 'darwin' ? 'CoreAudio' : 'WASAPI';
@@ -1383,7 +3403,9 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
       let sessions;
       
       try {
-        sessions = wasapiAddon.enumerateAudioSessions();
+        sessions = typeof wasapiAddon.enumerateAudioSessionsAsync === 'function'
+          ? await wasapiAddon.enumerateAudioSessionsAsync()
+          : wasapiAddon.enumerateAudioSessions();
         console.log('[main] 🔍 Raw result from enumerateAudioSessions:', sessions);
         console.log('[main] 🔍 Type:', typeof sessions);
         console.log('[main] 🔍 Is array?', Array.isArray(sessions));
@@ -1416,6 +3438,19 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
     }
   });
 
+  // One sample of every session's peak level, loudest first, for picking the app that is playing
+  ipcMain.handle('get-session-levels', async () => {
+    try {
+      if (!loadWasapiAddon() || typeof wasapiAddon.getSessionLevels !== 'function') {
+        return [];
+      }
+      return wasapiAddon.getSessionLevels();
+    } catch (error) {
+      console.error('[main] Failed to sample session levels:', error);
+      return [];
+    }
+  });
+
   // Legacy Chrome process finder (kept for compatibility)
   ipcMain.handle('find-main-chrome-process', async (event, childPid: number) => {
     try {
@@ -1425,7 +3460,9 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
       
       // First try to find Chrome process with active audio session
       if (wasapiAddon && typeof wasapiAddon.findAudioPidForProcess === 'function') {
-        const audioPid = wasapiAddon.findAudioPidForProcess('chrome.exe');
+        const audioPid = typeof wasapiAddon.findAudioPidForProcessAsync === 'function'
+          ? await wasapiAddon.findAudioPidForProcessAsync('chrome.exe')
+          : wasapiAddon.findAudioPidForProcess('chrome.exe');
         if (audioPid && audioPid > 0) {
           console.log('[main] Found Chrome process with active audio:', audioPid, 'instead of', childPid);
           return audioPid;
@@ -1482,6 +3519,12 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
         return { success: false, error: 'setSystemOutputToBlackHole function not available' };
       }
       
+      // The async variant switches on the threadpool so the HAL's reroute doesn't stall the main process
+      if (typeof wasapiAddon.setSystemOutputToBlackHoleAsync === 'function') {
+        const { success, elapsedMs } = await wasapiAddon.setSystemOutputToBlackHoleAsync();
+        console.log(`[main] Set system output to BlackHole: ${success} (${elapsedMs.toFixed(1)} ms)`);
+        return { success, elapsedMs };
+      }
       const result = wasapiAddon.setSystemOutputToBlackHole();
       console.log('[main] Set system output to BlackHole:', result);
       return { success: result };
@@ -1501,6 +3544,11 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
         return { success: false, error: 'restoreSystemOutput function not available' };
       }
       
+      if (typeof wasapiAddon.restoreSystemOutputAsync === 'function') {
+        const { success, elapsedMs } = await wasapiAddon.restoreSystemOutputAsync();
+        console.log(`[main] Restored system output: ${success} (${elapsedMs.toFixed(1)} ms)`);
+        return { success, elapsedMs };
+      }
       const result = wasapiAddon.restoreSystemOutput();
       console.log('[main] Restored system output:', result);
       return { success: result };
@@ -1510,6 +3558,26 @@ ipcMain.handle('wasapi:start-capture-by-process', async (event, processName: str
     }
   });
 
+  // The private multi-output device (real speakers + BlackHole), created on the
+  // addon's threadpool the first time and reused after that
+  ipcMain.handle('coreaudio:provision-multi-output', async () => {
+    try {
+      if (process.platform !== 'darwin') {
+        return { success: false, error: 'macOS only' };
+      }
+      if (!loadWasapiAddon() || typeof wasapiAddon.provisionMultiOutputAsync !== 'function') {
+        return { success: false, error: 'provisionMultiOutputAsync function not available' };
+      }
+      const device: { deviceId: string; created: boolean; elapsedMs: number } | null = await wasapiAddon.provisionMultiOutputAsync();
+      if (!device) return { success: false, error: 'BlackHole or a real output device is missing' };
+      console.log(`[main] Multi-output device ${device.deviceId} ${device.created ? 'created' : 'reused'} in ${device.elapsedMs.toFixed(1)} ms`);
+      return { success: true, ...device };
+    } catch (error) {
+      console.error('[main] Failed to provision the multi-output device:', error);
+      return { success: false, error: error instanceof Error ? error.message : String(error) };
+    }
+  });
+
   ipcMain.handle('coreaudio:get-real-output-device', async () => {
     try {
       if (process.platform !== 'darwin') {
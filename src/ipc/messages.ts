@@ -21,6 +21,8 @@ export interface BaseIPCMessage {
 export interface IPCRequest<T = any> extends BaseIPCMessage {
   /** Request payload */
   payload: T;
+  /** Latency trace of the utterance this request works on (services/LatencyTracer) */
+  traceId?: string;
 }
 
 /**
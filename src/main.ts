@@ -61,7 +61,9 @@ app.setPath('userData', path.join(app.getPath('appData'), 'whispra'));
 // Enable system audio capture for screen sharing in Chromium
 // Must be set BEFORE app.whenReady()
 try {
-  app.commandLine.appendSwitch('enable-features', 'WebRTCScreenAudioCapture');
+  // SharedArrayBuffer without cross-origin isolation: the renderer's capture
+  // analyzer shares a ring with its AudioWorklet (renderer/audio/PcmWorkletRing.ts)
+  app.commandLine.appendSwitch('enable-features', 'WebRTCScreenAudioCapture,SharedArrayBuffer');
   // Allow screen capture from file:// origins
   app.commandLine.appendSwitch('allow-http-screen-capture');
 } catch {}
@@ -693,6 +695,29 @@ app.whenReady().then(async () => {
             console.log('⚠️ Could not preload Argos on startup (non-critical):', error);
           }
         }, 6000); // 6 second delay (slightly after Paddle warmup) to let UI finish loading first
+
+        // Warm the local Whisper model in the native engine (background priority) so the
+        // first caption runs at steady-state speed instead of waiting for the model load
+        setTimeout(async () => {
+          try {
+            const { ConfigurationManager } = await import('./services/ConfigurationManager');
+            const { getProcessingModeFromConfig } = await import('./types/ConfigurationTypes');
+            const configManager = ConfigurationManager.getInstance();
+            if (getProcessingModeFromConfig(configManager.getConfig()) !== 'local') return;
+            if (configManager.getValue('uiSettings.whisperWarmupOnStartup') === false) {
+              console.log('🎙️ Whisper startup warmup is disabled by user, skipping');
+              return;
+            }
+            const { LocalProcessingManager } = await import('./services/LocalProcessingManager');
+            LocalProcessingManager.getInstance().prewarmWhisper().then((warm) => {
+              console.log(warm ? '🎙️ Whisper model warm on startup' : '🎙️ No native Whisper model to warm on startup');
+            }).catch((error) => {
+              console.log('⚠️ Whisper warmup failed on startup (will load when needed):', error?.message || error);
+            });
+          } catch (error) {
+            console.log('⚠️ Could not warm up Whisper on startup (non-critical):', error);
+          }
+        }, 7000); // after the Paddle and Argos preloads
       }
     }
   });
@@ -3,6 +3,11 @@
 """
 Persistent PaddleOCR service - stays alive between OCR requests
 Communicates via JSON stdin/stdout
+
+Images come either as a file path ({"type": "ocr", "image_path": ...}) or,
+without any encoding or file, as a record in the app's shared-memory ring
+({"type": "ocr_frame", "mapping", "doorbell", "seq", ...}): the frame is
+wrapped as a numpy array straight out of the mapping (whispra_ring.py).
 """
 
 import sys
@@ -17,6 +22,9 @@ gpu_paddle_path = os.path.expanduser('~\\AppData\\Roaming\\whispra\\models\\Padd
 # Global OCR instance cache - persists for the lifetime of this process
 _ocr_cache = {}
 
+# Frame rings by mapping name, opened on first use
+_frame_rings = {}
+
 def get_cache_key(language, use_gpu):
     """Generate cache key for OCR instance"""
     return f"{language}_{use_gpu}"
@@ -75,8 +83,45 @@ def initialize_ocr(language, use_gpu):
         print(f"❌ Failed to initialize OCR: {e}", file=sys.stderr)
         raise
 
+def open_frame_ring(mapping, doorbell):
+    """Reader for the app's frame ring; whispra_ring.py ships in dist/whisper"""
+    ring = _frame_rings.get(mapping)
+    if ring is None:
+        whisper_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'whisper')
+        if whisper_dir not in sys.path:
+            sys.path.append(whisper_dir)
+        from whispra_ring import AudioRingReader
+        ring = AudioRingReader(mapping, doorbell)
+        _frame_rings[mapping] = ring
+    return ring
+
+def run_ocr_frame(mapping, doorbell, seq, target_language='en', use_gpu=False):
+    """Run OCR on ring record seq, wrapped in place as a numpy array"""
+    import numpy as np
+    ring = open_frame_ring(mapping, doorbell)
+    # The app writes the record before sending the command, so it is already
+    # published; older records (requests that timed out) are skipped
+    while True:
+        frame = ring.poll()
+        if frame is None:
+            return {'success': False, 'error': f'Frame {seq} not in the ring', 'text_boxes': []}
+        if getattr(frame, 'pixels', None) is not None and frame.seq == seq:
+            break
+        ring.done()
+    image = None
+    try:
+        image = np.ndarray((frame.height, frame.width, frame.channels), dtype=np.uint8,
+                           buffer=frame.pixels, strides=(frame.stride, frame.channels, 1))
+        # PaddleOCR takes 2-D gray or 3-channel BGR arrays
+        image = image[:, :, 0] if frame.channels == 1 else image[:, :, :3]
+        return run_ocr(image, target_language, use_gpu)
+    finally:
+        del image
+        frame.pixels.release()
+        ring.done()
+
 def run_ocr(image_path, target_language='en', use_gpu=False):
-    """Run OCR on the given image"""
+    """Run OCR on the given image (a file path or a numpy array)"""
     try:
         # Map language codes
         lang_map = {
@@ -91,7 +136,7 @@ def run_ocr(image_path, target_language='en', use_gpu=False):
         ocr = initialize_ocr(paddle_lang, use_gpu)
         
         # Check if image exists
-        if not os.path.exists(image_path):
+        if isinstance(image_path, str) and not os.path.exists(image_path):
             return {
                 'success': False,
                 'error': f'Image file not found: {image_path}',
@@ -175,6 +220,17 @@ def main():
                     print(json.dumps(result, ensure_ascii=True))
                     sys.stdout.flush()
                     
+                elif cmd_type == 'ocr_frame':
+                    result = run_ocr_frame(
+                        command.get('mapping'),
+                        command.get('doorbell'),
+                        command.get('seq'),
+                        command.get('language', 'en'),
+                        command.get('use_gpu', False)
+                    )
+                    print(json.dumps(result, ensure_ascii=True))
+                    sys.stdout.flush()
+
                 elif cmd_type == 'ping':
                     # Health check
                     print(json.dumps({'success': True, 'type': 'pong'}))
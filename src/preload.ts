@@ -59,8 +59,30 @@ contextBridge.exposeInMainWorld('electronAPI', {
 		ipcRenderer.on('wasapi:utterance-wav', (_event, data) => callback(data));
 	},
 	// Fixed-size chunked WASAPI capture for streaming transcription
-	setupWasapiChunkWav: (callback: (data: Buffer) => void) => {
-		ipcRenderer.on('wasapi:chunk-wav', (_event, data) => callback(data));
+	// traceId: the utterance's latency trace, undefined unless WHISPRA_TRACE is set;
+	// fingerprint: the native chunker's audio fingerprint, for speech:transcribe;
+	// language: the utterance's language as the addon identified it (auto-detect mode);
+	// timeMap: a compacted chunk's time map, for speech:transcribe's segment times
+	setupWasapiChunkWav: (callback: (data: Buffer, traceId?: string, fingerprint?: Uint32Array, language?: string, timeMap?: Float64Array) => void) => {
+		ipcRenderer.on('wasapi:chunk-wav', (_event, data, traceId, fingerprint, language, timeMap) => callback(data, traceId, fingerprint, language, timeMap));
+	},
+	// Utterances from the native microphone capture (startNativeMicCapture)
+	setupMicChunkWav: (callback: (data: Buffer, traceId?: string) => void) => {
+		ipcRenderer.on('wasapi:mic-chunk-wav', (_event, data, traceId) => callback(data, traceId));
+	},
+	// Adds a renderer span to an utterance's latency trace (services/LatencyTracer);
+	// times are performance.timeOrigin + performance.now()
+	traceSpan: (traceId: string | undefined, name: string, startMs: number, endMs?: number) => {
+		if (traceId) ipcRenderer.send('trace:span', traceId, name, startMs, endMs);
+	},
+	// Live captions from the native streaming Whisper (uiSettings.streamingCaptions, local mode)
+	setupWasapiCaptions: (onPartial: (event: any) => void, onFinal: (final: { text: string }) => void) => {
+		ipcRenderer.on('wasapi:caption-partial', (_event, data) => onPartial(data));
+		ipcRenderer.on('wasapi:caption-final', (_event, data) => onFinal(data));
+	},
+	// Keywords the native spotter heard (uiSettings.keywordSpotting); utterances follow for windowMs
+	setupWasapiKeyword: (callback: (event: { keyword: string; score: number; windowMs: number }) => void) => {
+		ipcRenderer.on('wasapi:keyword', (_event, data) => callback(data));
 	},
 
 	getDesktopSources: async (types: Array<'screen' | 'window'>) => {
@@ -85,12 +107,48 @@ contextBridge.exposeInMainWorld('electronAPI', {
 	stopPerAppCapture: () => {
 		return ipcRenderer.invoke('wasapi:stop-capture');
 	},
+	// The capture's last lastMs of processed audio as a WAV file ("what did they just say?")
+	getCaptureHistory: (lastMs?: number) => {
+		return ipcRenderer.invoke('wasapi:get-history', lastMs);
+	},
+	// Active render/capture endpoints, for uiSettings.loopbackDevices and the mic's inputDevice
+	listAudioEndpoints: () => {
+		return ipcRenderer.invoke('wasapi:list-endpoints');
+	},
+	// Mic straight from the device in the main process; inputDevice matches part of the name.
+	// armed: push-to-talk, delivering only between setNativeMicDelivery(true) and (false)
+	startNativeMicCapture: (inputDevice?: string, armed?: boolean) => {
+		return ipcRenderer.invoke('wasapi:start-mic-capture', inputDevice, armed);
+	},
+	setNativeMicDelivery: (open: boolean) => {
+		return ipcRenderer.invoke('wasapi:mic-delivery', open);
+	},
+	stopNativeMicCapture: () => {
+		return ipcRenderer.invoke('wasapi:stop-mic-capture');
+	},
+	// Streamed TTS played by the addon on the virtual cable instead of this page
+	startNativeTtsRender: (options?: { device?: string; lowLatency?: boolean }) => {
+		return ipcRenderer.invoke('wasapi:start-tts-render', options);
+	},
+	stopNativeTtsRender: () => {
+		return ipcRenderer.invoke('wasapi:stop-tts-render');
+	},
+	getNativeTtsRenderStats: () => {
+		return ipcRenderer.invoke('wasapi:tts-render-stats');
+	},
+	// A media file through the local Whisper model; without file, a picker asks for one
+	transcribeMediaFile: (file?: string, options?: { language?: string; translate?: boolean; concurrency?: number }) => {
+		return ipcRenderer.invoke('wasapi:transcribe-media', file, options);
+	},
 	findAudioPidForProcess: (processName: string) => {
 		return ipcRenderer.invoke('find-audio-pid-for-process', processName);
 	},
 	enumerateAudioSessions: () => {
 		return ipcRenderer.invoke('enumerate-audio-sessions');
 	},
+	getSessionLevels: () => {
+		return ipcRenderer.invoke('get-session-levels');
+	},
 
 	// Voice boost for whisper-level speech detection
 	setVoiceBoostEnabled: (enabled: boolean) => {
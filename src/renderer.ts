@@ -18,6 +18,7 @@ import {
     updateLabelText
 } from './renderer/translationHelpers.js';
 import { getTranslations } from './renderer/i18n.js';
+import { PcmWorkletRing, PCM_RING_WORKLET, pcm16Samples, sharedPcmRingAvailable } from './renderer/audio/PcmWorkletRing.js';
 import {
     showPTTKeybindModal as showWhispraPTTKeybindModal,
     showBidirectionalKeybindModal as showWhispraBidirectionalKeybindModal
@@ -799,6 +800,7 @@ let wasapiPcmQueue: Float32Array[] = [];
 let wasapiWorkletNode: AudioWorkletNode | null = null;
 let wasapiCtx: AudioContext | null = null;
 let wasapiDest: MediaStreamAudioDestinationNode | null = null;
+let wasapiRing: PcmWorkletRing | null = null; // null: chunks are posted to the worklet instead
 
 // Raw PCM capture (ScriptProcessor) for bidirectional mode
 let pcmCaptureCtx: AudioContext | null = null;
@@ -920,54 +922,31 @@ async function stopPcmCapture(): Promise<void> {
 async function ensureWasapiWorklet(): Promise<void> {
     if (wasapiCtx) return;
     wasapiCtx = new AudioContext({ sampleRate: 16000 });
-    const workletCode = `
-    class PcmIn16ToAudio extends AudioWorkletProcessor {
-      constructor() {
-        super();
-        this.buffer = [];
-        this.index = 0;
-        this.port.onmessage = (e) => {
-          const buf = e.data;
-          this.buffer.push(buf);
-        };
-      }
-      process(inputs, outputs) {
-        const output = outputs[0][0];
-        let i = 0;
-        while (i < output.length) {
-          if (this.buffer.length === 0) break;
-          const chunk = this.buffer[0];
-          const take = Math.min(output.length - i, chunk.length - this.index);
-          output.set(chunk.subarray(this.index, this.index + take), i);
-          i += take;
-          this.index += take;
-          if (this.index >= chunk.length) { this.buffer.shift(); this.index = 0; }
-        }
-        if (i < output.length) {
-          output.fill(0, i);
-        }
-        return true;
-      }
-    }
-    registerProcessor('pcm-in16-to-audio', PcmIn16ToAudio);
-    `;
-    const blob = new Blob([workletCode], { type: 'application/javascript' });
+    const blob = new Blob([PCM_RING_WORKLET], { type: 'application/javascript' });
     const url = URL.createObjectURL(blob);
     await wasapiCtx.audioWorklet.addModule(url);
     URL.revokeObjectURL(url);
     wasapiWorkletNode = new AudioWorkletNode(wasapiCtx, 'pcm-in16-to-audio', { numberOfInputs: 0, numberOfOutputs: 1, outputChannelCount: [1] });
     wasapiDest = wasapiCtx.createMediaStreamDestination();
     wasapiWorkletNode.connect(wasapiDest);
+    if (sharedPcmRingAvailable()) {
+        wasapiRing = new PcmWorkletRing();
+        wasapiWorkletNode.port.postMessage({ ring: wasapiRing.buffer });
+    }
 }
 
-function feedWasapiPcmToWorklet(pcm: ArrayBuffer): void {
+function feedWasapiPcmToWorklet(pcm: ArrayBuffer | Uint8Array): void {
     if (!wasapiCtx || !wasapiWorkletNode) {
         console.warn('[renderer] WASAPI worklet not ready, dropping PCM data');
         return;
     }
     // Assume int16 little-endian mono at 16kHz
     // This is for the audio level visualization only - VAD uses the MediaStream path
-    const view = new Int16Array(pcm);
+    const view = pcm16Samples(pcm);
+    if (wasapiRing) {
+        wasapiRing.write(view); // the worklet polls the ring; nothing to post
+        return;
+    }
     const f32 = new Float32Array(view.length);
     for (let i = 0; i < view.length; i++) {
         f32[i] = Math.max(-1, Math.min(1, view[i] / 32768));
@@ -978,8 +957,7 @@ function feedWasapiPcmToWorklet(pcm: ArrayBuffer): void {
 // Subscribe to WASAPI PCM stream
 (function setupWasapiPcmListener() {
     try {
-        (window as any).electronAPI.on && (window as any).electronAPI.on('wasapi:pcm', (_e: any, pcm: ArrayBuffer) => {
-            console.log('[renderer] Received WASAPI PCM data:', pcm.byteLength, 'bytes');
+        (window as any).electronAPI.on && (window as any).electronAPI.on('wasapi:pcm', (_e: any, pcm: ArrayBuffer | Uint8Array) => {
             feedWasapiPcmToWorklet(pcm);
         });
     } catch { }
@@ -1000,7 +978,7 @@ function feedWasapiPcmToWorklet(pcm: ArrayBuffer): void {
 // Subscribe to VAD-segmented WASAPI utterances for direct transcription
 (function setupWasapiUtteranceListener() {
     try {
-        (window as any).electronAPI.setupWasapiChunkWav && (window as any).electronAPI.setupWasapiChunkWav(async (wavData: Buffer) => {
+        (window as any).electronAPI.setupWasapiChunkWav && (window as any).electronAPI.setupWasapiChunkWav(async (wavData: Buffer, traceId?: string, fingerprint?: Uint32Array, language?: string, timeMap?: Float64Array) => {
             if (!isBidirectionalActive) return;
             try {
                 // Process this chunk asynchronously (don't wait for previous chunks to finish TTS)
@@ -1008,7 +986,11 @@ function feedWasapiPcmToWorklet(pcm: ArrayBuffer): void {
                 await processBidirectionalAudioChunkModule(
                     wavData,
                     getBidirectionalSourceLanguageFromUI,
-                    getBidirectionalTargetLanguageFromUI
+                    getBidirectionalTargetLanguageFromUI,
+                    traceId,
+                    fingerprint,
+                    language,
+                    timeMap
                 );
             } catch (err) {
                 console.warn('[renderer] Utterance transcription failed:', err);
@@ -2163,7 +2145,10 @@ function setupRealTimeTTSChunks(): void {
                 return;
             }
 
-            const { audioData, chunkIndex, isFirstChunk, isFinal, bufferSize, originalText, translatedText } = data;
+            const { audioData, chunkIndex, isFirstChunk, isFinal, bufferSize, nativeRendered, originalText, translatedText } = data;
+
+            // Already playing on the virtual cable through the addon's render session
+            if (nativeRendered) return;
 
             // Validate audioData
             if (!audioData || !Array.isArray(audioData) || audioData.length === 0) {
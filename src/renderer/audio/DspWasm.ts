@@ -0,0 +1,263 @@
+/**
+ * The capture chain's DSP kernels (resampler, RBJ filters, adaptive gate,
+ * peak/RMS, int16 conversion) as a WebAssembly SIMD module, for renderer code
+ * that cannot call the addon. Built from native-audio-core/wasm with
+ * `npm run build:dsp-wasm` and copied to dist/assets/wasm by
+ * `npm run copy-dsp-wasm`; build-script.js runs both when Emscripten is
+ * installed, and packages built without it have no module.
+ *
+ * Compile the module once with loadDspWasmModule(), which resolves null when
+ * the module was not built: callers keep their JS DSP then. On the page,
+ * instantiate it with DspWasm.create(); an AudioWorklet is handed the
+ * compiled module in processorOptions and uses DspWasm.createSync() in its
+ * constructor, since worklet scopes may instantiate synchronously and have
+ * no fetch.
+ *
+ * Filters keep their state between calls, so they can run per render
+ * quantum. Each call copies the samples into the module's memory and back:
+ * two copies of a 128-frame block, no allocation once the scratch buffer has
+ * grown to the largest block seen. Call dispose() on filters that are done.
+ */
+
+/** Relative to dist/index.html. */
+export const DSP_WASM_URL = 'assets/wasm/dsp_wasm.wasm';
+
+export type DspResamplerQuality = 'low' | 'medium' | 'high';
+
+interface DspWasmExports {
+  memory: WebAssembly.Memory;
+  _initialize?: () => void;
+  dsp_alloc(bytes: number): number;
+  dsp_free(ptr: number): void;
+  dsp_resampler_create(inRate: number, outRate: number, quality: number, maxBlock: number): number;
+  dsp_resampler_max_output(handle: number, n: number): number;
+  dsp_resampler_delay(handle: number): number;
+  dsp_resampler_process(handle: number, input: number, n: number, output: number): number;
+  dsp_resampler_reset(handle: number): void;
+  dsp_resampler_destroy(handle: number): void;
+  dsp_biquad_create(kind: number, sampleRate: number, cornerHz: number, q: number): number;
+  dsp_biquad_process(handle: number, samples: number, n: number): void;
+  dsp_biquad_destroy(handle: number): void;
+  dsp_gate_create(sampleRate: number, ratio: number, envelopeMs: number, floorRiseMs: number, attackMs: number, releaseMs: number): number;
+  dsp_gate_process(handle: number, samples: number, n: number): number;
+  dsp_gate_floor(handle: number): number;
+  dsp_gate_destroy(handle: number): void;
+  dsp_peak(samples: number, n: number): number;
+  dsp_rms(samples: number, n: number): number;
+  dsp_float_to_int16(input: number, n: number, gain: number, output: number): void;
+  dsp_int16_to_float(input: number, n: number, output: number): void;
+}
+
+/** Null when the module was not built into this package; a module that is there but fails to compile throws. */
+export async function loadDspWasmModule(url: string = DSP_WASM_URL): Promise<WebAssembly.Module | null> {
+  let bytes: ArrayBuffer;
+  try {
+    // A missing file:// URL rejects rather than answering 404
+    const response = await fetch(url);
+    if (!response.ok) return null;
+    bytes = await response.arrayBuffer();
+  } catch {
+    return null;
+  }
+  if (bytes.byteLength === 0) return null;
+  // file:// responses carry no application/wasm type, so no compileStreaming
+  return WebAssembly.compile(bytes);
+}
+
+/** No-op stubs for the WASI calls the standalone C library still imports. */
+function stubImports(module: WebAssembly.Module): WebAssembly.Imports {
+  const imports: Record<string, Record<string, () => number>> = {};
+  for (const entry of WebAssembly.Module.imports(module)) {
+    if (entry.kind !== 'function') continue;
+    const scope = (imports[entry.module] ??= {});
+    scope[entry.name] = entry.name === 'proc_exit'
+      ? () => { throw new Error('DSP module aborted'); }
+      : () => 0;
+  }
+  return imports as WebAssembly.Imports;
+}
+
+/** Two scratch regions in the module's memory, grown to the largest block seen. */
+class Scratch {
+  ptr = 0;
+  bytes = 0;
+
+  constructor(private readonly dsp: DspWasmExports) {}
+
+  reserve(bytes: number): number {
+    if (bytes <= this.bytes) return this.ptr;
+    if (this.ptr) this.dsp.dsp_free(this.ptr);
+    this.bytes = Math.max(bytes, this.bytes * 2, 4096);
+    this.ptr = this.dsp.dsp_alloc(this.bytes);
+    if (!this.ptr) {
+      this.bytes = 0;
+      throw new Error('DSP module out of memory');
+    }
+    return this.ptr;
+  }
+}
+
+export class DspWasm {
+  private readonly dsp: DspWasmExports;
+  private readonly input: Scratch;
+  private readonly output: Scratch;
+
+  private constructor(instance: WebAssembly.Instance) {
+    this.dsp = instance.exports as unknown as DspWasmExports;
+    this.dsp._initialize?.();
+    this.input = new Scratch(this.dsp);
+    this.output = new Scratch(this.dsp);
+  }
+
+  /** Page side: browsers refuse to instantiate large modules synchronously on the main thread. */
+  static async create(module: WebAssembly.Module): Promise<DspWasm> {
+    return new DspWasm(await WebAssembly.instantiate(module, stubImports(module)));
+  }
+
+  /** Worklet (or worker) side, from the module passed in processorOptions. */
+  static createSync(module: WebAssembly.Module): DspWasm {
+    return new DspWasm(new WebAssembly.Instance(module, stubImports(module)));
+  }
+
+  peak(samples: Float32Array): number {
+    return this.dsp.dsp_peak(this.copyIn(samples), samples.length);
+  }
+
+  rms(samples: Float32Array): number {
+    return this.dsp.dsp_rms(this.copyIn(samples), samples.length);
+  }
+
+  /** Clipped and rounded like the capture's int16 packets; output at least as long as input. */
+  floatToInt16(input: Float32Array, output: Int16Array, gain = 1): void {
+    const n = input.length;
+    const out = this.output.reserve(n * 2);
+    this.dsp.dsp_float_to_int16(this.copyIn(input), n, gain, out);
+    output.set(new Int16Array(this.dsp.memory.buffer, out, n));
+  }
+
+  int16ToFloat(input: Int16Array, output: Float32Array): void {
+    const n = input.length;
+    const at = this.input.reserve(n * 2);
+    new Int16Array(this.dsp.memory.buffer, at, n).set(input);
+    const out = this.output.reserve(n * 4);
+    this.dsp.dsp_int16_to_float(at, n, out);
+    output.set(new Float32Array(this.dsp.memory.buffer, out, n));
+  }
+
+  createResampler(inRate: number, outRate: number, quality: DspResamplerQuality = 'medium', maxBlock = 1024): WasmResampler {
+    const handle = this.dsp.dsp_resampler_create(inRate, outRate, ['low', 'medium', 'high'].indexOf(quality), maxBlock);
+    if (!handle) throw new Error(`Invalid resampler rates ${inRate} -> ${outRate}`);
+    return new WasmResampler(this, handle);
+  }
+
+  createHighPass(sampleRate: number, cornerHz: number, q = 0.7071): WasmBiquad {
+    return this.createBiquad(0, sampleRate, cornerHz, q);
+  }
+
+  createLowPass(sampleRate: number, cornerHz: number, q = 0.7071): WasmBiquad {
+    return this.createBiquad(1, sampleRate, cornerHz, q);
+  }
+
+  /** The capture's adaptive gate; unset times keep the capture defaults (10/500/5/50 ms, ratio 2.5). */
+  createGate(sampleRate: number, options: { ratio?: number; envelopeMs?: number; floorRiseMs?: number; attackMs?: number; releaseMs?: number } = {}): WasmNoiseGate {
+    const handle = this.dsp.dsp_gate_create(sampleRate, options.ratio ?? 0, options.envelopeMs ?? 0, options.floorRiseMs ?? 0,
+      options.attackMs ?? 0, options.releaseMs ?? 0);
+    if (!handle) throw new Error('DSP module out of memory');
+    return new WasmNoiseGate(this, handle);
+  }
+
+  /** @internal */
+  get exports(): DspWasmExports {
+    return this.dsp;
+  }
+
+  /** @internal Copies samples into the input scratch and returns its address. */
+  copyIn(samples: Float32Array): number {
+    const at = this.input.reserve(samples.length * 4);
+    new Float32Array(this.dsp.memory.buffer, at, samples.length).set(samples);
+    return at;
+  }
+
+  /** @internal Copies n floats from the input scratch back over samples. */
+  copyBack(samples: Float32Array): void {
+    samples.set(new Float32Array(this.dsp.memory.buffer, this.input.ptr, samples.length));
+  }
+
+  /** @internal */
+  reserveOutput(bytes: number): number {
+    return this.output.reserve(bytes);
+  }
+
+  private createBiquad(kind: number, sampleRate: number, cornerHz: number, q: number): WasmBiquad {
+    const handle = this.dsp.dsp_biquad_create(kind, sampleRate, cornerHz, q);
+    if (!handle) throw new Error('Filter corner must be below half the sample rate');
+    return new WasmBiquad(this, handle);
+  }
+}
+
+export class WasmResampler {
+  constructor(private readonly owner: DspWasm, private handle: number) {}
+
+  /** Input latency of the filter, in input samples. */
+  get delay(): number {
+    return this.owner.exports.dsp_resampler_delay(this.handle);
+  }
+
+  /** Upper bound on the outputs for n inputs. */
+  maxOutput(n: number): number {
+    return this.owner.exports.dsp_resampler_max_output(this.handle, n);
+  }
+
+  /** Resamples input into output (room for maxOutput(input.length)); returns the count written. */
+  process(input: Float32Array, output: Float32Array): number {
+    const dsp = this.owner.exports;
+    const out = this.owner.reserveOutput(this.maxOutput(input.length) * 4);
+    const n = dsp.dsp_resampler_process(this.handle, this.owner.copyIn(input), input.length, out);
+    output.set(new Float32Array(dsp.memory.buffer, out, n));
+    return n;
+  }
+
+  reset(): void {
+    this.owner.exports.dsp_resampler_reset(this.handle);
+  }
+
+  dispose(): void {
+    if (this.handle) this.owner.exports.dsp_resampler_destroy(this.handle);
+    this.handle = 0;
+  }
+}
+
+export class WasmBiquad {
+  constructor(private readonly owner: DspWasm, private handle: number) {}
+
+  /** Filters samples in place. */
+  process(samples: Float32Array): void {
+    this.owner.exports.dsp_biquad_process(this.handle, this.owner.copyIn(samples), samples.length);
+    this.owner.copyBack(samples);
+  }
+
+  dispose(): void {
+    if (this.handle) this.owner.exports.dsp_biquad_destroy(this.handle);
+    this.handle = 0;
+  }
+}
+
+export class WasmNoiseGate {
+  constructor(private readonly owner: DspWasm, private handle: number) {}
+
+  /** Gates samples in place; returns the peak magnitude after the gate. */
+  process(samples: Float32Array): number {
+    const peak = this.owner.exports.dsp_gate_process(this.handle, this.owner.copyIn(samples), samples.length);
+    this.owner.copyBack(samples);
+    return peak;
+  }
+
+  get noiseFloor(): number {
+    return this.owner.exports.dsp_gate_floor(this.handle);
+  }
+
+  dispose(): void {
+    if (this.handle) this.owner.exports.dsp_gate_destroy(this.handle);
+    this.handle = 0;
+  }
+}
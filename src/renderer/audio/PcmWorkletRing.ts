@@ -0,0 +1,115 @@
+/**
+ * Lock-free single-producer ring carrying the capture's pcm16 stream from the
+ * renderer to the analyzer AudioWorklet through a SharedArrayBuffer. The
+ * renderer copies each packet in and publishes its write index with
+ * Atomics.store; the worklet polls both indices from process() and drains
+ * what is there, so a packet costs one copy and no postMessage or Float32
+ * conversion on the renderer thread.
+ *
+ * Layout: Int32Array header [writeIndex, readIndex, dropped, reserved], then
+ * the Int16Array samples. Indices count samples and wrap at 2^32; capacity is
+ * a power of two so the wrap lands on a sample boundary.
+ */
+
+const HEADER_BYTES = 16;
+const WRITE = 0;
+const READ = 1;
+const DROPPED = 2;
+
+/** 16384 samples: about 1 s at 16 kHz, enough to ride out a stalled audio thread. */
+export const PCM_RING_SAMPLES = 1 << 14;
+
+export function sharedPcmRingAvailable(): boolean {
+  return typeof SharedArrayBuffer !== 'undefined' && typeof Atomics !== 'undefined';
+}
+
+export class PcmWorkletRing {
+  readonly buffer: SharedArrayBuffer;
+  private readonly header: Int32Array;
+  private readonly data: Int16Array;
+  private readonly mask: number;
+
+  constructor(capacity: number = PCM_RING_SAMPLES) {
+    this.buffer = new SharedArrayBuffer(HEADER_BYTES + capacity * 2);
+    this.header = new Int32Array(this.buffer, 0, HEADER_BYTES / 4);
+    this.data = new Int16Array(this.buffer, HEADER_BYTES, capacity);
+    this.mask = capacity - 1;
+  }
+
+  /** Copies samples in; whatever does not fit is dropped and counted. Returns the samples written. */
+  write(samples: Int16Array): number {
+    const write = Atomics.load(this.header, WRITE) >>> 0;
+    const read = Atomics.load(this.header, READ) >>> 0;
+    const free = this.data.length - ((write - read) >>> 0);
+    const count = Math.min(samples.length, free);
+    if (count < samples.length) Atomics.add(this.header, DROPPED, samples.length - count);
+    const start = write & this.mask;
+    const first = Math.min(count, this.data.length - start);
+    this.data.set(samples.subarray(0, first), start);
+    if (count > first) this.data.set(samples.subarray(first, count), 0);
+    Atomics.store(this.header, WRITE, (write + count) | 0);
+    return count;
+  }
+
+  get dropped(): number {
+    return Atomics.load(this.header, DROPPED) >>> 0;
+  }
+}
+
+/** pcm16 samples of an IPC payload: Electron delivers a Buffer as a Uint8Array, older paths an ArrayBuffer. */
+export function pcm16Samples(pcm: ArrayBuffer | ArrayBufferView): Int16Array {
+  if (!ArrayBuffer.isView(pcm)) return new Int16Array(pcm, 0, pcm.byteLength >> 1);
+  if (pcm.byteOffset % 2 === 0) return new Int16Array(pcm.buffer, pcm.byteOffset, pcm.byteLength >> 1);
+  return new Int16Array(new Uint8Array(pcm.buffer, pcm.byteOffset, pcm.byteLength & ~1).slice().buffer);
+}
+
+/**
+ * Source of the 'pcm-in16-to-audio' processor. It plays the ring once it is
+ * handed { ring: SharedArrayBuffer }, and otherwise queued Float32Array
+ * chunks posted to its port (renderers without SharedArrayBuffer).
+ */
+export const PCM_RING_WORKLET = `
+class PcmIn16ToAudio extends AudioWorkletProcessor {
+  constructor() {
+    super();
+    this.buffer = [];
+    this.index = 0;
+    this.header = null;
+    this.ring = null;
+    this.port.onmessage = (e) => {
+      if (e.data && e.data.ring) {
+        this.header = new Int32Array(e.data.ring, 0, ${HEADER_BYTES / 4});
+        this.ring = new Int16Array(e.data.ring, ${HEADER_BYTES});
+        return;
+      }
+      this.buffer.push(e.data);
+    };
+  }
+  process(inputs, outputs) {
+    const output = outputs[0][0];
+    let i = 0;
+    if (this.ring) {
+      const write = Atomics.load(this.header, ${WRITE}) >>> 0;
+      const read = Atomics.load(this.header, ${READ}) >>> 0;
+      const mask = this.ring.length - 1;
+      i = Math.min(output.length, (write - read) >>> 0);
+      for (let k = 0; k < i; k++) output[k] = this.ring[(read + k) & mask] / 32768;
+      Atomics.store(this.header, ${READ}, (read + i) | 0);
+    }
+    while (i < output.length) {
+      if (this.buffer.length === 0) break;
+      const chunk = this.buffer[0];
+      const take = Math.min(output.length - i, chunk.length - this.index);
+      output.set(chunk.subarray(this.index, this.index + take), i);
+      i += take;
+      this.index += take;
+      if (this.index >= chunk.length) { this.buffer.shift(); this.index = 0; }
+    }
+    if (i < output.length) {
+      output.fill(0, i);
+    }
+    return true;
+  }
+}
+registerProcessor('pcm-in16-to-audio', PcmIn16ToAudio);
+`;
@@ -6,6 +6,7 @@
 
 import { TranslateTTSProcessor } from '../services/TranslateTTSProcessor.js';
 import type { PushToTalkTranscription } from '../types/PushToTalkTranscription.js';
+import { DspWasm, loadDspWasmModule } from './audio/DspWasm.js';
 
 // ============================================================================
 // TYPES AND INTERFACES
@@ -472,6 +473,28 @@ let audioDetectionHistory: boolean[] = [];
 const AUDIO_HISTORY_SIZE = 5; // Track last 5 checks (500ms of history)
 const SUSTAINED_AUDIO_THRESHOLD = 3; // Need 3 out of 5 checks to be positive
 
+// The level checks' RMS runs in the DSP module (DspWasm.ts) once it has loaded;
+// in JS until then, and for good in packages built without the module
+let levelDsp: DspWasm | null = null;
+let levelDspRequested = false;
+let levelSamples: Float32Array | null = null;
+
+function requestLevelDsp(): void {
+    if (levelDspRequested) return;
+    levelDspRequested = true;
+    loadDspWasmModule()
+        .then(module => module ? DspWasm.create(module) : null)
+        .then(dsp => { levelDsp = dsp; })
+        .catch(error => console.warn('⚠️ DSP module failed to load, audio levels stay in JS:', error));
+}
+
+function levelRms(samples: Float32Array): number {
+    if (levelDsp) return levelDsp.rms(samples);
+    let sumSquares = 0;
+    for (let i = 0; i < samples.length; i++) sumSquares += samples[i] * samples[i];
+    return Math.sqrt(sumSquares / samples.length);
+}
+
 /**
  * Analyze frequency spectrum to detect if audio contains voice frequencies
  * Human voice fundamental: 85-255Hz (male: 85-180Hz, female: 165-255Hz)
@@ -556,16 +579,15 @@ export function checkAudioLevel(): boolean {
         return false; // If no analyser, treat as silence to be safe
     }
 
-    const dataArray = new Uint8Array(c.analyserNode.frequencyBinCount);
-    c.analyserNode.getByteTimeDomainData(dataArray);
+    requestLevelDsp();
+    // Float samples: the byte view's 1/128 steps are coarser than the threshold below
+    if (!levelSamples || levelSamples.length !== c.analyserNode.frequencyBinCount) {
+        levelSamples = new Float32Array(c.analyserNode.frequencyBinCount);
+    }
+    c.analyserNode.getFloatTimeDomainData(levelSamples);
 
     // Calculate RMS (Root Mean Square) from time domain data
-    let sumSquares = 0;
-    for (let i = 0; i < dataArray.length; i++) {
-        const normalized = (dataArray[i] - 128) / 128; // Normalize to -1 to 1
-        sumSquares += normalized * normalized;
-    }
-    const rms = Math.sqrt(sumSquares / dataArray.length);
+    const rms = levelRms(levelSamples);
 
     // Lower threshold to catch quiet speech (voice freq check will filter noise)
     // 0.003 = -50dB (catches very quiet speech)
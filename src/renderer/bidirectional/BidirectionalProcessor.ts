@@ -96,16 +96,36 @@ function applyAccentTag(text: string): string {
     return accentTag + text;
 }
 
+/**
+ * Add a span to the chunk's latency trace (services/LatencyTracer in main)
+ */
+function traceSpan(traceId: string | undefined, name: string, startMs: number, endMs: number = traceNowMs()): void {
+    if (traceId) (window as any).electronAPI.traceSpan?.(traceId, name, startMs, endMs);
+}
+
+function traceNowMs(): number {
+    return performance.timeOrigin + performance.now();
+}
+
 /**
  * Process bidirectional audio chunk:
  * 1. Transcribe audio to text
  * 2. Translate text to target language
  * 3. Queue TTS for playback
+ * traceId (set while latency tracing) rides along on every IPC request; the
+ * chunk's native fingerprint lets STT answer a repeated utterance from its cache.
+ * In auto-detect mode, detectedLanguage (identified natively from the
+ * utterance's first second) goes to STT so it skips its own language pass.
+ * A compacted chunk's timeMap lets STT report segment times on the captured audio.
  */
 export async function processBidirectionalAudioChunk(
     wavData: Buffer,
     getBidirectionalSourceLanguage: () => string,
-    getBidirectionalTargetLanguage: () => string
+    getBidirectionalTargetLanguage: () => string,
+    traceId?: string,
+    fingerprint?: Uint32Array,
+    detectedLanguage?: string,
+    timeMap?: Float64Array
 ): Promise<void> {
     // Process this chunk asynchronously (don't wait for previous chunks to finish TTS)
     // This allows transcription/translation to happen in background while TTS plays
@@ -137,7 +157,8 @@ export async function processBidirectionalAudioChunk(
 
     try {
         const audioArray = Array.from(new Uint8Array(wavData as unknown as ArrayBuffer));
-        const selectedLanguage = getBidirectionalSourceLanguage();
+        const chosenLanguage = getBidirectionalSourceLanguage();
+        const selectedLanguage = (!chosenLanguage || chosenLanguage === 'auto') && detectedLanguage ? detectedLanguage : chosenLanguage;
         const targetLanguage = getBidirectionalTargetLanguage();
         
         // Get whispra translate panel elements once for reuse
@@ -165,7 +186,8 @@ export async function processBidirectionalAudioChunk(
         const response = await (window as any).electronAPI.invoke('speech:transcribe', {
             id: Date.now().toString(),
             timestamp: Date.now(),
-            payload: { audioData: audioArray, language: selectedLanguage, targetLanguage: targetLanguage, contentType: 'audio/wav' }
+            traceId,
+            payload: { audioData: audioArray, language: selectedLanguage, targetLanguage: targetLanguage, contentType: 'audio/wav', fingerprint, timeMap }
         });
 
         if (!isBidirectionalActive) {
@@ -253,7 +275,9 @@ export async function processBidirectionalAudioChunk(
             // Show caption immediately (before TTS synthesis)
             if (transcription && transcription.length > 0) {
                 console.log('🎬 Updating captions immediately (same language):', transcription);
+                const captionStartMs = traceNowMs();
                 await updateCaptions(transcription);
+                traceSpan(traceId, 'caption', captionStartMs);
             }
         } else {
             // Different language - translate
@@ -282,6 +306,7 @@ export async function processBidirectionalAudioChunk(
             const translationResponse = await (window as any).electronAPI.invoke('translation:translate', {
                 id: Date.now().toString(),
                 timestamp: Date.now(),
+                traceId,
                 payload: {
                     text: transcription,
                     targetLanguage: targetLanguage,
@@ -337,7 +362,9 @@ export async function processBidirectionalAudioChunk(
             // Show caption immediately after translation (before TTS synthesis)
             if (translated && translated.length > 0) {
                 console.log('🎬 Updating captions immediately after translation:', translated);
+                const captionStartMs = traceNowMs();
                 await updateCaptions(translated);
+                traceSpan(traceId, 'caption', captionStartMs);
             }
         }
 
@@ -358,7 +385,8 @@ export async function processBidirectionalAudioChunk(
                     modelId,
                     transcription,
                     detectedLang,
-                    bidirectionalOutputDeviceId || undefined
+                    bidirectionalOutputDeviceId || undefined,
+                    traceId
                 );
 
                 console.log(`[Bidi] 🎯 Chunk ${chunkId} queued (max 3 concurrent TTS) - STT: ${transcriptionTime}ms, Trans: ${translationTime}ms`);
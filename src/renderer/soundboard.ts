@@ -47,6 +47,8 @@ export class SoundboardManager {
 
     private sounds: Map<string, SoundEntry> = new Map();
     private playingStates: Map<string, boolean> = new Map();
+    private nativePlaying: Set<string> = new Set(); // pads the main-process engine is playing
+    private nativeEndTimers: Map<string, ReturnType<typeof setTimeout>> = new Map();
     private audioElements: Map<string, HTMLAudioElement> = new Map();
     private headphonesAudioElements: Map<string, HTMLAudioElement> = new Map();
     private overlayVbGainNode: GainNode | null = null;
@@ -823,6 +825,21 @@ export class SoundboardManager {
         }
 
         try {
+            // The main process plays the clip itself when its native engine is running
+            if (sound.slot) {
+                const played = await (window as any).electronAPI.soundboard.playSound(sound.slot).catch(() => null);
+                if (played?.native) {
+                    this.nativePlaying.add(id);
+                    this.playingStates.set(id, true);
+                    this.updateSoundPadPlayingState(id, true);
+                    if (played.duration) {
+                        clearTimeout(this.nativeEndTimers.get(id));
+                        this.nativeEndTimers.set(id, setTimeout(() => this.endNativeSound(id), played.duration * 1000));
+                    }
+                    return;
+                }
+            }
+
             // Create VB Audio stream
             let vbAudio = this.audioElements.get(id);
             if (!vbAudio) {
@@ -878,7 +895,21 @@ export class SoundboardManager {
         }
     }
 
+    private endNativeSound(id: string): void {
+        clearTimeout(this.nativeEndTimers.get(id));
+        this.nativeEndTimers.delete(id);
+        this.nativePlaying.delete(id);
+        this.playingStates.set(id, false);
+        this.updateSoundPadPlayingState(id, false);
+    }
+
     private stopSound(id: string): void {
+        if (this.nativePlaying.has(id)) {
+            const slot = this.sounds.get(id)?.slot;
+            if (slot) (window as any).electronAPI.soundboard.stopSound(slot);
+            this.endNativeSound(id);
+            return;
+        }
         const vbAudio = this.audioElements.get(id);
         const headphonesAudio = this.headphonesAudioElements.get(id);
 
@@ -902,6 +933,11 @@ export class SoundboardManager {
         console.log('Headphones audio elements:', this.headphonesAudioElements.size);
         console.log('Playing states:', Array.from(this.playingStates.entries()));
 
+        if (this.nativePlaying.size > 0) {
+            (window as any).electronAPI.soundboard.stopAllSounds();
+            for (const id of Array.from(this.nativePlaying)) this.endNativeSound(id);
+        }
+
         // Stop all VB Audio elements (regardless of tracked state)
         for (const [id, vbAudio] of this.audioElements.entries()) {
             console.log(`Stopping VB Audio for sound ${id}`);
@@ -5,6 +5,7 @@ import * as fs from 'fs';
 import * as os from 'os';
 import { app } from 'electron';
 import { resolveEmbeddedPythonExecutable } from '../utils/pythonPath';
+import { getNativeTranslator, NativeTranslator, TranslationComputeType } from '../ipc/handlers/wasapi-handlers';
 
 /**
  * Local translation service using Argos Translate
@@ -14,6 +15,9 @@ export class ArgosTranslationService implements TranslationService {
   private packagesPath: string;
   private isInitialized: boolean = false;
   private supportedLanguages: string[] = [];
+  private nativeTranslator: NativeTranslator | null | undefined;
+  // "from>to" -> resolves true once that pair is resident in the native engine
+  private nativePairs: Map<string, Promise<boolean>> = new Map();
 
   constructor() {
     // Use Electron's cross-platform app data path
@@ -126,6 +130,8 @@ export class ArgosTranslationService implements TranslationService {
   async restart(): Promise<void> {
     console.log('🔄 Restarting Argos Translation Service...');
     this.isInitialized = false;
+    this.nativePairs.clear();
+    if (this.nativeTranslator) await this.nativeTranslator.unload();
     try {
       await this.initialize();
       // Verify initialization was successful
@@ -179,7 +185,8 @@ export class ArgosTranslationService implements TranslationService {
 
       console.log(`Translating with Argos: "${text}" from ${fromLang} to ${toLang}`);
 
-      const translatedText = await this.executeArgosTranslation(text, fromLang, toLang);
+      const nativeTexts = await this.translateNative([text], fromLang, toLang);
+      const translatedText = nativeTexts ? nativeTexts[0] : await this.executeArgosTranslation(text, fromLang, toLang);
 
       return {
         translatedText,
@@ -194,6 +201,101 @@ export class ArgosTranslationService implements TranslationService {
     }
   }
 
+  /**
+   * Translate several texts at once (e.g. queued caption lines). The native
+   * engine takes them as one batch; the Python fallback runs them in turn.
+   */
+  async translateBatch(texts: string[], targetLanguage: string, sourceLanguage?: string): Promise<string[]> {
+    if (!this.isInitialized) {
+      await this.initialize();
+    }
+    const fromLang = !sourceLanguage || sourceLanguage === 'auto' ? 'en' : sourceLanguage;
+    if (fromLang === targetLanguage) return texts.slice();
+    const nativeTexts = await this.translateNative(texts, fromLang, targetLanguage);
+    if (nativeTexts) return nativeTexts;
+    const translated: string[] = [];
+    for (const text of texts) translated.push(await this.executeArgosTranslation(text, fromLang, targetLanguage));
+    return translated;
+  }
+
+  /**
+   * Installed package directory for a pair: Argos unpacks each .argosmodel into
+   * a subdirectory of the packages path holding metadata.json, model/ and
+   * sentencepiece.model
+   */
+  private findInstalledPackage(fromLang: string, toLang: string): string | null {
+    try {
+      for (const entry of fs.readdirSync(this.packagesPath, { withFileTypes: true })) {
+        if (!entry.isDirectory()) continue;
+        const dir = path.join(this.packagesPath, entry.name);
+        const metadataPath = path.join(dir, 'metadata.json');
+        if (!fs.existsSync(metadataPath) || !fs.existsSync(path.join(dir, 'sentencepiece.model'))) continue;
+        const metadata = JSON.parse(fs.readFileSync(metadataPath, 'utf8'));
+        if (metadata.from_code === fromLang && metadata.to_code === toLang) return dir;
+      }
+    } catch (error) {
+      console.warn(`[Argos] Could not scan ${this.packagesPath} for installed packages:`, error);
+    }
+    return null;
+  }
+
+  /**
+   * Load a pair into the native engine once; resolves false when the addon,
+   * the build flag or the installed package is missing
+   */
+  private loadNativePair(fromLang: string, toLang: string): Promise<boolean> {
+    const key = `${fromLang}>${toLang}`;
+    const known = this.nativePairs.get(key);
+    if (known) return known;
+    if (this.nativeTranslator === undefined) this.nativeTranslator = getNativeTranslator();
+    const engine = this.nativeTranslator;
+    const packageDir = engine ? this.findInstalledPackage(fromLang, toLang) : null;
+    const computeType = this.nativeComputeType();
+    const load = !engine || !packageDir ? Promise.resolve(false) : engine.load(packageDir, fromLang, toLang, { computeType }).then(
+      (info) => {
+        console.log(`✅ Native Argos model ${key} loaded in ${info.loadMs.toFixed(0)} ms (${info.computeType}, +${info.memoryMb.toFixed(0)} MB)`);
+        return true;
+      },
+      (error) => {
+        console.warn(`Native Argos translation unavailable for ${key}:`, error instanceof Error ? error.message : error);
+        return false;
+      }
+    );
+    this.nativePairs.set(key, load);
+    return load;
+  }
+
+  /**
+   * Weight type for the native models: int8 on machines with 8 GB or less,
+   * or little free, so a float32 package doesn't push the app into swap;
+   * otherwise CTranslate2's fastest type for this CPU
+   */
+  private nativeComputeType(): TranslationComputeType {
+    const gb = 1024 * 1024 * 1024;
+    return os.totalmem() <= 8 * gb || os.freemem() < 2 * gb ? 'int8' : 'auto';
+  }
+
+  /**
+   * Translate with the resident native models, directly or through English;
+   * null when the pair can't run natively so the caller falls back to Python
+   */
+  private async translateNative(texts: string[], fromLang: string, toLang: string): Promise<string[] | null> {
+    const direct = await this.loadNativePair(fromLang, toLang);
+    if (!direct) {
+      if (fromLang === 'en' || toLang === 'en') return null;
+      const halves = await Promise.all([this.loadNativePair(fromLang, 'en'), this.loadNativePair('en', toLang)]);
+      if (!halves[0] || !halves[1]) return null;
+    }
+    try {
+      const result = await this.nativeTranslator!.translate(texts, fromLang, toLang);
+      console.log(`🌐 Native Argos: ${texts.length} text(s) in ${result.processingMs.toFixed(0)} ms${result.pivot ? ' (via en)' : ''}`);
+      return result.texts;
+    } catch (error) {
+      console.warn('Native Argos translation failed, using Python:', error instanceof Error ? error.message : error);
+      return null;
+    }
+  }
+
   /**
    * Get supported languages
    */
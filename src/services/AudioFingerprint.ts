@@ -171,5 +171,65 @@ export class AudioFingerprintService {
     // Weighted average
     return (energySimilarity * 0.4 + zcrSimilarity * 0.3 + centroidSimilarity * 0.3);
   }
+
+  /**
+   * Bit error rate between two native chunk fingerprints (capture addon
+   * `chunk.fingerprint`, one 32-bit Haitsma-Kalker word per frame), at the
+   * best alignment within maxShift frames either way; 0 is identical, about
+   * 0.5 is unrelated audio. 1 when they overlap by too few frames to judge.
+   */
+  static fingerprintBitErrorRate(a: Uint32Array, b: Uint32Array, maxShift: number = 8): number {
+    const minOverlap = Math.max(8, Math.floor(Math.min(a.length, b.length) * 0.8));
+    let best = 1;
+    for (let shift = -maxShift; shift <= maxShift; shift++) {
+      const start = Math.max(0, -shift);
+      const end = Math.min(a.length, b.length - shift);
+      if (end - start < minOverlap) continue;
+      let errors = 0;
+      for (let i = start; i < end; i++) {
+        let x = (a[i] ^ b[i + shift]) >>> 0;
+        x -= (x >>> 1) & 0x55555555;
+        x = (x & 0x33333333) + ((x >>> 2) & 0x33333333);
+        errors += (((x + (x >>> 4)) & 0x0f0f0f0f) * 0x01010101) >>> 24;
+      }
+      best = Math.min(best, errors / ((end - start) * 32));
+    }
+    return best;
+  }
 }
 
+/**
+ * Recently heard utterances by native fingerprint, so a repeated jingle or a
+ * looping video is recognised before it is sent to STT again. Only chunks
+ * long enough to fingerprint reliably are considered; short replies ("yes",
+ * "ok") that a speaker may genuinely repeat never match.
+ */
+export class RepeatedAudioFilter {
+  private recent: Array<{ fingerprint: Uint32Array; atMs: number }> = [];
+
+  constructor(
+    private readonly windowMs: number = 120000,
+    private readonly maxBitErrorRate: number = 0.25,
+    private readonly minFrames: number = 64, // about 1.3 s of 20 ms VAD frames
+    private readonly capacity: number = 32
+  ) {}
+
+  /** True when fingerprint matches one seen within the window; otherwise it is remembered. */
+  isRepeat(fingerprint: Uint32Array | undefined, nowMs: number = Date.now()): boolean {
+    if (!fingerprint || fingerprint.length < this.minFrames) return false;
+    this.recent = this.recent.filter(entry => nowMs - entry.atMs <= this.windowMs);
+    for (const entry of this.recent) {
+      if (AudioFingerprintService.fingerprintBitErrorRate(fingerprint, entry.fingerprint) <= this.maxBitErrorRate) {
+        entry.atMs = nowMs; // a loop keeps its own entry alive
+        return true;
+      }
+    }
+    this.recent.push({ fingerprint, atMs: nowMs });
+    if (this.recent.length > this.capacity) this.recent.shift();
+    return false;
+  }
+
+  clear(): void {
+    this.recent = [];
+  }
+}
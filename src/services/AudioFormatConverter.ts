@@ -1,3 +1,5 @@
+import { encodeNativeAudio, getNativeDsp } from '../ipc/handlers/wasapi-handlers';
+
 export interface AudioConversionOptions {
   targetSampleRate?: number;
   targetChannels?: number;
@@ -67,6 +69,14 @@ export class AudioFormatConverter {
       return inputData;
     }
 
+    // The addon's polyphase resampler, when loaded
+    const dsp = getNativeDsp();
+    if (dsp) {
+      const output = new Float32Array(Math.floor(inputData.length * outputSampleRate / inputSampleRate));
+      dsp.resample(inputData, output, { inRate: inputSampleRate, outRate: outputSampleRate });
+      return output;
+    }
+
     const ratio = inputSampleRate / outputSampleRate;
     const outputLength = Math.floor(inputData.length / ratio);
     const output = new Float32Array(outputLength);
@@ -143,6 +153,11 @@ export class AudioFormatConverter {
     view.setUint32(40, length * 2, true); // Sub-chunk size
 
     // Convert float samples to 16-bit PCM
+    const dsp = getNativeDsp();
+    if (dsp) {
+      dsp.floatToInt16(audioData, new Int16Array(buffer, 44, length));
+      return new Blob([buffer], { type: 'audio/wav' });
+    }
     let offset = 44;
     for (let i = 0; i < length; i++) {
       const sample = Math.max(-1, Math.min(1, audioData[i]));
@@ -159,9 +174,11 @@ export class AudioFormatConverter {
     channels: number,
     quality: number = 0.7
   ): Promise<Blob> {
-    // For MP3 conversion, we would typically use a library like lamejs
-    // For now, we'll convert to WAV as a fallback since MP3 encoding is complex
-    console.warn('MP3 encoding not implemented, falling back to WAV');
+    // The addon's libavcodec encoder, off the main thread; quality 0-1 maps to 32-320 kbps
+    const bitrate = Math.round(32 + Math.max(0, Math.min(1, quality)) * 288) * 1000;
+    const encoded = await this.encodeNative(audioData, { sampleRate, channels: channels as 1 | 2, format: 'mp3', bitrate });
+    if (encoded) return new Blob([encoded], { type: 'audio/mpeg' });
+    console.warn('MP3 encoding not available, falling back to WAV');
     return this.convertToWav(audioData, sampleRate, channels);
   }
 
@@ -170,17 +187,43 @@ export class AudioFormatConverter {
     sampleRate: number,
     channels: number
   ): Promise<Blob> {
-    // FLAC encoding would require a specialized library
-    // For now, we'll convert to WAV as a fallback
-    console.warn('FLAC encoding not implemented, falling back to WAV');
+    // The addon's FLAC encoder takes mono only
+    const encoded = channels === 1 ? await this.encodeNative(audioData, { sampleRate, format: 'flac' }) : null;
+    if (encoded) return new Blob([encoded], { type: 'audio/flac' });
+    console.warn('FLAC encoding not available, falling back to WAV');
     return this.convertToWav(audioData, sampleRate, channels);
   }
 
+  // Null when the addon is missing or can't encode this clip
+  private static async encodeNative(
+    audioData: Float32Array,
+    options: Parameters<typeof encodeNativeAudio>[1]
+  ): Promise<Buffer | null> {
+    const pending = encodeNativeAudio(audioData, options);
+    if (!pending) return null;
+    try {
+      return await pending;
+    } catch (error) {
+      console.warn('Native encoding failed:', error);
+      return null;
+    }
+  }
+
   static async optimizeForWhisper(
     audioData: Float32Array,
     originalSampleRate: number
   ): Promise<ConversionResult> {
     // Apply audio preprocessing optimizations for better Whisper accuracy
+    const dsp = getNativeDsp();
+    if (dsp) {
+      // One copy, then the same stages in place in the addon
+      const processed = audioData.slice();
+      dsp.normalize(processed, { peak: 0.9 });
+      dsp.gate(processed, { sampleRate: originalSampleRate, threshold: 0.01 });
+      dsp.filter(processed, { sampleRate: originalSampleRate, highPassHz: 80 });
+      return this.convertForWhisper(processed, originalSampleRate);
+    }
+
     let processedData = audioData;
 
     // 1. Normalize audio levels
@@ -15,6 +15,7 @@ interface BidiTTSChunk {
     originalText?: string;
     detectedLanguage?: string;
     sinkId?: string;
+    traceId?: string; // latency trace of the utterance (services/LatencyTracer)
 }
 
 interface BidiProcessingChunk extends BidiTTSChunk {
@@ -71,7 +72,7 @@ export class BidirectionalTTSProcessor {
     /**
      * Add a text chunk to be processed
      */
-    addChunk(text: string, voiceId: string, modelId?: string, originalText?: string, detectedLanguage?: string, sinkId?: string): number {
+    addChunk(text: string, voiceId: string, modelId?: string, originalText?: string, detectedLanguage?: string, sinkId?: string, traceId?: string): number {
         const id = this.chunks.size;
         const chunk: BidiProcessingChunk = {
             id,
@@ -81,6 +82,7 @@ export class BidirectionalTTSProcessor {
             originalText,
             detectedLanguage,
             sinkId,
+            traceId,
             status: 'queued'
         };
 
@@ -229,6 +231,7 @@ export class BidirectionalTTSProcessor {
                 const response = await this.electronAPI.invoke('tts:synthesize', {
                     id: Date.now().toString(),
                     timestamp: Date.now(),
+                    traceId: chunk.traceId,
                     payload: {
                         text: chunk.text,
                         voiceId: chunk.voiceId,
@@ -377,9 +380,13 @@ export class BidirectionalTTSProcessor {
 
             const audioArray = Array.from(new Uint8Array(chunk.audioData));
 
+            const playbackStartMs = performance.timeOrigin + performance.now();
             if (this.playbackHandler) {
                 await this.playbackHandler(audioArray, chunk.sinkId, chunk.text);
             }
+            if (chunk.traceId) {
+                this.electronAPI.traceSpan?.(chunk.traceId, 'tts-playback', playbackStartMs, performance.timeOrigin + performance.now());
+            }
 
             chunk.status = 'complete';
             this.currentlyPlaying = null;
@@ -0,0 +1,214 @@
+/**
+ * Runs the loopback capture out of process (uiSettings.captureHost:
+ * 'utility'). The capture addon is loaded again in an Electron utility
+ * process (CaptureHostProcess) that starts the capture and publishes every
+ * callback call, subscriber feed and level frame to a shared-memory ring
+ * (native-audio-core/shm_audio_ring.h). The main process only maps that ring
+ * and reads it when the addon's waiter thread says records are waiting, then
+ * hands the calls to the same callbacks an in-process capture would have
+ * called. A crash in the capture takes the host down, not the app: the
+ * capture just ends, and the next start forks a new host.
+ */
+
+import { utilityProcess, UtilityProcess } from 'electron';
+import * as path from 'path';
+import type { CaptureHostChannel, CaptureHostControl, CaptureHostReply, CaptureHostRequest } from './CaptureHostProtocol';
+import { decodeHostMessage } from './CaptureHostProtocol';
+
+type CaptureCallback = (...args: any[]) => void;
+
+export interface CaptureHostStart {
+  addon: any;                // this process's addon, for the ring reader
+  addonPath: string;         // the same addon, for the host to load
+  pid: number;
+  callback: CaptureCallback;
+  options: Record<string, unknown>;
+  feeds?: { name: string; callback: CaptureCallback; options: Record<string, unknown> }[];
+  onLevels?: (bands: Float32Array, rms: number) => void;
+}
+
+const RING_MESSAGE = 4; // record kind of writeMessageRing
+const READ_BATCH = 256;
+const START_TIMEOUT_MS = 10000;
+const STOP_TIMEOUT_MS = 5000;
+const CONTROL_TIMEOUT_MS = 5000;
+
+type ControlReply = Extract<CaptureHostReply, { type: 'control' }>;
+
+export class CaptureHost {
+  private static instance: CaptureHost | null = null;
+
+  private child: UtilityProcess | null = null;
+  private addon: any = null;
+  private attachment: number | null = null;
+  private channels = new Map<CaptureHostChannel, CaptureCallback>();
+  private waiters: { type: CaptureHostReply['type']; resolve: (reply: CaptureHostReply | null) => void }[] = [];
+  private running = false;
+  private dropped = 0;
+  private controls = new Map<number, (reply: ControlReply | null) => void>();
+  private nextControl = 1;
+
+  public static getInstance(): CaptureHost {
+    if (!CaptureHost.instance) {
+      CaptureHost.instance = new CaptureHost();
+    }
+    return CaptureHost.instance;
+  }
+
+  public isRunning(): boolean {
+    return this.running;
+  }
+
+  /**
+   * Starts the capture in the host; false when it did not start, as the
+   * addon's startCapture would return
+   */
+  public async startCapture(start: CaptureHostStart): Promise<boolean> {
+    if (this.running) await this.stop();
+    if (typeof start.addon.attachAudioRing !== 'function') return false;
+    this.addon = start.addon;
+    this.dropped = 0;
+    this.channels.clear();
+    this.channels.set('capture', start.callback);
+    for (const feed of start.feeds ?? []) this.channels.set(`feed:${feed.name}`, feed.callback);
+    if (start.onLevels) this.channels.set('levels', start.onLevels as CaptureCallback);
+
+    const child = this.fork();
+    const started = this.expect('started', START_TIMEOUT_MS);
+    const request: CaptureHostRequest = {
+      type: 'start',
+      addonPath: start.addonPath,
+      method: 'startCapture',
+      pid: start.pid,
+      options: start.options,
+      feeds: (start.feeds ?? []).map(feed => ({ name: feed.name, options: feed.options })),
+      levelsHz: start.onLevels ? 30 : 0
+    };
+    child.postMessage(request);
+    const reply = await started;
+    if (!reply || reply.type !== 'started' || !reply.ok) {
+      console.error('[CaptureHost] Capture did not start in the host:', reply && reply.type === 'started' ? reply.error ?? 'startCapture returned false' : 'no reply');
+      this.detach();
+      return false;
+    }
+    this.running = true;
+    console.log(`[CaptureHost] Capturing PID ${start.pid} in utility process ${child.pid}`);
+    return true;
+  }
+
+  /**
+   * Stops the capture and delivers what the host wrote before it stopped;
+   * the host stays up for the next start
+   */
+  public async stop(): Promise<void> {
+    if (!this.child) return;
+    const stopped = this.expect('stopped', STOP_TIMEOUT_MS);
+    this.child.postMessage({ type: 'stop' } as CaptureHostRequest);
+    await stopped;
+    this.drain();
+    this.detach();
+    this.running = false;
+  }
+
+  /**
+   * Calls a runtime control (setMinChunkMs, getStats...) on the host's addon,
+   * which runs the capture; the main process's addon has none to apply it
+   * to. Resolves with the addon's return value, rejects when no hosted
+   * capture is running, the host has no such control or does not answer
+   */
+  public control<T = unknown>(method: CaptureHostControl, ...args: unknown[]): Promise<T> {
+    const child = this.child;
+    if (!child || !this.running) return Promise.reject(new Error('No capture is running in the capture host'));
+    const id = this.nextControl++;
+    return new Promise<T>((resolve, reject) => {
+      const timer = setTimeout(() => this.controls.get(id)?.(null), CONTROL_TIMEOUT_MS);
+      this.controls.set(id, reply => {
+        clearTimeout(timer);
+        this.controls.delete(id);
+        if (!reply) reject(new Error(`Capture host did not answer ${method}()`));
+        else if (!reply.ok) reject(new Error(reply.error ?? `${method}() failed in the capture host`));
+        else resolve(reply.result as T);
+      });
+      child.postMessage({ type: 'control', id, method, args } as CaptureHostRequest);
+    });
+  }
+
+  private fork(): UtilityProcess {
+    if (this.child) return this.child;
+    const child = utilityProcess.fork(path.join(__dirname, 'CaptureHostProcess.js'), [], { serviceName: 'Whispra Capture Host' });
+    child.on('message', (reply: CaptureHostReply) => this.onReply(reply));
+    child.on('exit', (code: number) => {
+      if (this.child !== child) return;
+      if (this.running) console.error(`[CaptureHost] Capture host exited (code ${code}); the capture has ended`);
+      this.child = null;
+      this.drain();
+      this.detach();
+      this.running = false;
+      for (const waiter of this.waiters.splice(0)) waiter.resolve(null);
+      for (const settle of [...this.controls.values()]) settle(null);
+    });
+    this.child = child;
+    return child;
+  }
+
+  private onReply(reply: CaptureHostReply): void {
+    if (reply.type === 'control') {
+      this.controls.get(reply.id)?.(reply);
+      return;
+    }
+    if (reply.type === 'ring') {
+      this.detach();
+      try {
+        this.attachment = this.addon.attachAudioRing(reply.mapping, reply.doorbell, () => this.drain());
+      } catch (error) {
+        console.error('[CaptureHost] Could not attach to the capture host ring:', error);
+      }
+    }
+    const index = this.waiters.findIndex(waiter => waiter.type === reply.type);
+    if (index >= 0) this.waiters.splice(index, 1)[0].resolve(reply);
+  }
+
+  // The next reply of this type; null on timeout or when the host exits
+  private expect(type: CaptureHostReply['type'], timeoutMs: number): Promise<CaptureHostReply | null> {
+    return new Promise(resolve => {
+      const waiter = { type, resolve };
+      this.waiters.push(waiter);
+      setTimeout(() => {
+        const index = this.waiters.indexOf(waiter);
+        if (index < 0) return;
+        this.waiters.splice(index, 1);
+        resolve(null);
+      }, timeoutMs);
+    });
+  }
+
+  private drain(): void {
+    if (this.attachment === null) return;
+    for (;;) {
+      const { records, dropped } = this.addon.readAudioRing(this.attachment, READ_BATCH);
+      if (dropped > this.dropped) {
+        console.warn(`[CaptureHost] ${dropped - this.dropped} capture callbacks dropped; the main process fell behind`);
+        this.dropped = dropped;
+      }
+      for (const record of records) {
+        if (record.kind !== RING_MESSAGE) continue;
+        const { channel, args } = decodeHostMessage(record.data);
+        const callback = this.channels.get(channel);
+        if (!callback) continue;
+        try {
+          // JSON turned undefined arguments into null
+          callback(...args.map(arg => arg === null ? undefined : arg));
+        } catch (error) {
+          console.error(`[CaptureHost] ${channel} callback threw:`, error);
+        }
+      }
+      if (records.length < READ_BATCH) return;
+    }
+  }
+
+  private detach(): void {
+    if (this.attachment === null) return;
+    this.addon.detachAudioRing(this.attachment);
+    this.attachment = null;
+  }
+}
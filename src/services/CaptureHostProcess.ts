@@ -0,0 +1,84 @@
+/**
+ * Entry point of the capture host, an Electron utility process (CaptureHost
+ * forks it). It loads the capture addon and runs the capture here, so a crash
+ * in a driver, the audio engine or the addon takes this process down instead
+ * of the app, and the addon's delivery thread wakes this process's event
+ * loop rather than the main one. Everything the capture delivers is written
+ * to a shared-memory ring the main process reads (CaptureHostProtocol).
+ */
+
+import type { CaptureHostChannel, CaptureHostReply, CaptureHostRequest } from './CaptureHostProtocol';
+import { encodeHostMessage } from './CaptureHostProtocol';
+
+const RING_NAME = 'capture-host';
+const RING_CAPACITY_KB = 8192; // chunk WAVs are the largest records, about 100 KB
+
+let addon: any = null;
+let ringOpen = false;
+let dropped = 0;
+let feeds: string[] = [];
+
+function reply(message: CaptureHostReply): void {
+  process.parentPort.postMessage(message);
+}
+
+function publish(channel: CaptureHostChannel, args: unknown[]): void {
+  if (!ringOpen) return;
+  if (addon.writeMessageRing(RING_NAME, encodeHostMessage(channel, args)) < 0 && ++dropped % 100 === 1) {
+    console.warn(`[capture-host] Main process is behind; ${dropped} capture callbacks dropped`);
+  }
+}
+
+function start(request: Extract<CaptureHostRequest, { type: 'start' }>): void {
+  try {
+    addon = addon ?? require(request.addonPath);
+    if (typeof addon.writeMessageRing !== 'function') {
+      reply({ type: 'started', ok: false, error: 'Capture addon predates the capture host' });
+      return;
+    }
+    const ring = addon.openAudioRing(RING_NAME, { capacityKb: RING_CAPACITY_KB });
+    ringOpen = true;
+    reply({ type: 'ring', mapping: ring.mapping, doorbell: ring.doorbell });
+    for (const feed of request.feeds) {
+      if (addon.subscribe(feed.name, (...args: unknown[]) => publish(`feed:${feed.name}`, args), feed.options)) feeds.push(feed.name);
+    }
+    if (request.levelsHz > 0 && typeof addon.watchLevels === 'function') {
+      addon.watchLevels((...args: unknown[]) => publish('levels', args), { rateHz: request.levelsHz });
+    }
+    const ok: boolean = addon[request.method](request.pid >>> 0, (...args: unknown[]) => publish('capture', args), request.options);
+    reply({ type: 'started', ok });
+  } catch (error) {
+    reply({ type: 'started', ok: false, error: error instanceof Error ? error.message : String(error) });
+  }
+}
+
+async function control(request: Extract<CaptureHostRequest, { type: 'control' }>): Promise<void> {
+  try {
+    if (!addon || typeof addon[request.method] !== 'function') throw new Error(`Capture addon has no ${request.method}()`);
+    const result = await addon[request.method](...request.args);
+    reply({ type: 'control', id: request.id, ok: true, result });
+  } catch (error) {
+    reply({ type: 'control', id: request.id, ok: false, error: error instanceof Error ? error.message : String(error) });
+  }
+}
+
+async function stop(): Promise<void> {
+  if (addon) {
+    if (typeof addon.stopCaptureAsync === 'function') await addon.stopCaptureAsync();
+    else addon.stopCapture();
+    for (const name of feeds) addon.unsubscribe(name);
+    feeds = [];
+    if (typeof addon.unwatchLevels === 'function') addon.unwatchLevels();
+    // Closing marks the ring closed, which is the reader's cue that nothing more follows
+    if (ringOpen) addon.closeAudioRing(RING_NAME);
+    ringOpen = false;
+  }
+  reply({ type: 'stopped' });
+}
+
+process.parentPort.on('message', (event: Electron.MessageEvent) => {
+  const request = event.data as CaptureHostRequest;
+  if (request.type === 'start') start(request);
+  else if (request.type === 'control') void control(request);
+  else if (request.type === 'stop') void stop();
+});
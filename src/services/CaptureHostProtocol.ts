@@ -0,0 +1,105 @@
+/**
+ * What the capture host (CaptureHostProcess) and the main process
+ * (CaptureHost) say to each other. Control messages go over the utility
+ * process's parent port; everything the capture delivers goes through the
+ * addon's shared-memory ring as message records, one per callback call:
+ * its arguments as JSON, with every typed array pulled out into a binary
+ * section behind it, so pcm and chunk WAVs are copied once into the ring and
+ * once out, never through JSON or the parent port.
+ */
+
+// Runtime controls of a running capture: the host calls them on its own
+// addon, where the capture is, and answers with the result
+export type CaptureHostControl =
+  | 'setMinChunkMs' | 'setProcessingParams' | 'getStats' | 'switchSource'
+  | 'setVoiceBoostEnabled' | 'setVoiceBoostLevel' | 'getHistory';
+
+export type CaptureHostRequest =
+  | { type: 'start'; addonPath: string; method: 'startCapture'; pid: number; options: Record<string, unknown>;
+      feeds: { name: string; options: Record<string, unknown> }[]; levelsHz: number }
+  | { type: 'control'; id: number; method: CaptureHostControl; args: unknown[] }
+  | { type: 'stop' };
+
+export type CaptureHostReply =
+  | { type: 'ring'; mapping: string; doorbell: string }
+  | { type: 'started'; ok: boolean; error?: string }
+  | { type: 'control'; id: number; ok: boolean; result?: unknown; error?: string }
+  | { type: 'stopped' };
+
+// The record's channel: the capture callback, a subscriber feed by name, or the level meter
+export type CaptureHostChannel = 'capture' | 'levels' | `feed:${string}`;
+
+type TypedArrayName = 'Int16Array' | 'Uint32Array' | 'Float32Array' | 'Float64Array' | 'Uint8Array' | 'Buffer';
+
+const TYPED_ARRAYS: Record<Exclude<TypedArrayName, 'Buffer'>, { new (buffer: ArrayBuffer): ArrayBufferView }> = {
+  Int16Array, Uint32Array, Float32Array, Float64Array, Uint8Array
+};
+
+function typedArrayName(view: ArrayBufferView): TypedArrayName {
+  if (Buffer.isBuffer(view)) return 'Buffer';
+  if (view instanceof Int16Array) return 'Int16Array';
+  if (view instanceof Uint32Array) return 'Uint32Array';
+  if (view instanceof Float32Array) return 'Float32Array';
+  if (view instanceof Float64Array) return 'Float64Array';
+  return 'Uint8Array';
+}
+
+// Section bytes start on this boundary within the message, the widest element (Float64Array)
+const SECTION_ALIGN = 8;
+
+function alignSection(offset: number): number {
+  return (offset + SECTION_ALIGN - 1) & ~(SECTION_ALIGN - 1);
+}
+
+/**
+ * One callback call as a ring message: u32 JSON length, the JSON
+ * { channel, args }, then each binary section as u32 length, zero padding to
+ * an 8-byte boundary, and bytes
+ */
+export function encodeHostMessage(channel: CaptureHostChannel, args: unknown[]): Buffer {
+  const sections: ArrayBufferView[] = [];
+  // The holder's own value, since a Buffer reaches the replacer already through its toJSON()
+  const json = JSON.stringify({ channel, args }, function (this: any, key: string, value: unknown) {
+    const raw = this[key];
+    if (!ArrayBuffer.isView(raw)) return value;
+    sections.push(raw);
+    return { $bin: sections.length - 1, type: typedArrayName(raw) };
+  });
+  const head = Buffer.from(json, 'utf8');
+  let bytes = 4 + head.length;
+  for (const section of sections) bytes = alignSection(bytes + 4) + section.byteLength;
+  const out = Buffer.alloc(bytes);
+  out.writeUInt32LE(head.length, 0);
+  head.copy(out, 4);
+  let offset = 4 + head.length;
+  for (const section of sections) {
+    out.writeUInt32LE(section.byteLength, offset);
+    offset = alignSection(offset + 4);
+    Buffer.from(section.buffer, section.byteOffset, section.byteLength).copy(out, offset);
+    offset += section.byteLength;
+  }
+  return out;
+}
+
+export function decodeHostMessage(message: Buffer): { channel: CaptureHostChannel; args: unknown[] } {
+  const jsonBytes = message.readUInt32LE(0);
+  const sections: ArrayBufferView[] = [];
+  let offset = 4 + jsonBytes;
+  const json = message.toString('utf8', 4, offset);
+  while (offset < message.length) {
+    const length = message.readUInt32LE(offset);
+    offset = alignSection(offset + 4);
+    // A fresh ArrayBuffer per section keeps every typed array aligned wherever the ring put the message
+    const copy = new Uint8Array(length);
+    copy.set(message.subarray(offset, offset + length));
+    sections.push(copy);
+    offset += length;
+  }
+  return JSON.parse(json, (_key, value) => {
+    if (!value || typeof value !== 'object' || typeof value.$bin !== 'number') return value;
+    const bytes = sections[value.$bin] as Uint8Array;
+    if (value.type === 'Buffer') return Buffer.from(bytes.buffer, 0, bytes.byteLength);
+    const Ctor = TYPED_ARRAYS[value.type as Exclude<TypedArrayName, 'Buffer'>] ?? Uint8Array;
+    return new Ctor(bytes.buffer);
+  });
+}
@@ -0,0 +1,120 @@
+/**
+ * Cost-aware routing of loopback utterances. The capture addon estimates how
+ * hard each chunk should be to transcribe (SNR, speech ratio, loudness,
+ * clipping, music; native-audio-core/chunk_difficulty.h) and the estimate is
+ * noted here by the chunk's native fingerprint when the chunk arrives. When
+ * speech:transcribe then gets the chunk's WAV for a cloud model, an 'easy'
+ * chunk goes to a native Whisper model that is already resident instead, and
+ * the cloud only sees the moderate and hard ones. Nothing is loaded for this:
+ * without a resident model every chunk goes the usual way.
+ */
+
+export interface ChunkDifficulty {
+  snrDb: number;
+  speechRatio: number;       // share of the chunk's VAD frames that are speech
+  lufs: number;
+  clippingRatio: number;     // share of samples at full scale
+  musicProbability: number;
+  score: number;             // 0 (clean speech) .. 1
+  level: 'easy' | 'moderate' | 'hard';
+}
+
+export interface RoutedTranscript {
+  text: string;
+  language: string;
+  duration: number;
+}
+
+const ESTIMATE_TTL_MS = 30000; // a chunk the renderer never sent back
+
+export class ChunkDifficultyRouter {
+  private static instance: ChunkDifficultyRouter | null = null;
+
+  private byFingerprint = new Map<string, { difficulty: ChunkDifficulty; expires: number }>();
+  private routed = { local: 0, cloud: 0 };
+
+  public static getInstance(): ChunkDifficultyRouter {
+    if (!ChunkDifficultyRouter.instance) {
+      ChunkDifficultyRouter.instance = new ChunkDifficultyRouter();
+    }
+    return ChunkDifficultyRouter.instance;
+  }
+
+  /**
+   * A native chunk arrived with its estimate (older addons send none)
+   */
+  public note(fingerprint: Uint32Array | undefined, difficulty: ChunkDifficulty | undefined): void {
+    if (!fingerprint || fingerprint.length === 0 || !difficulty) return;
+    const now = Date.now();
+    for (const [key, entry] of this.byFingerprint) {
+      if (entry.expires <= now) this.byFingerprint.delete(key);
+    }
+    this.byFingerprint.set(fingerprintKey(fingerprint), { difficulty, expires: now + ESTIMATE_TTL_MS });
+  }
+
+  /**
+   * The chunk's estimate, once; null when it has none
+   */
+  public take(fingerprint: Uint32Array): ChunkDifficulty | null {
+    const key = fingerprintKey(fingerprint);
+    const entry = this.byFingerprint.get(key);
+    if (!entry) return null;
+    this.byFingerprint.delete(key);
+    return entry.expires > Date.now() ? entry.difficulty : null;
+  }
+
+  /**
+   * Transcribe an easy chunk on a resident native model instead of the
+   * cloud; null when the chunk is not easy, no model is resident or the
+   * engine failed, leaving the chunk to the cloud
+   */
+  public async transcribeIfEasy(fingerprint: Uint32Array, wav: Buffer, language: string): Promise<RoutedTranscript | null> {
+    const difficulty = this.take(fingerprint);
+    if (!difficulty) return null;
+    if (difficulty.level !== 'easy') {
+      this.routed.cloud++;
+      return null;
+    }
+    const { getNativeWhisper } = await import('../ipc/handlers/wasapi-handlers');
+    const engine = getNativeWhisper();
+    const model = engine?.stats().models[0];
+    if (!engine || !model) {
+      this.routed.cloud++;
+      return null;
+    }
+    try {
+      const result = await engine.transcribe(wav, {
+        language: language === 'auto' ? undefined : language,
+        stream: 'loopback',
+        model
+      });
+      this.routed.local++;
+      const lastSegment = result.segments[result.segments.length - 1];
+      console.log(`💸 Easy chunk (score ${difficulty.score.toFixed(2)}, SNR ${difficulty.snrDb.toFixed(0)} dB) transcribed locally ` +
+                  `in ${result.processingMs.toFixed(0)} ms (${this.routed.local} local / ${this.routed.cloud} cloud)`);
+      return { text: result.text.trim(), language: result.language || language, duration: lastSegment ? lastSegment.endMs / 1000 : 0 };
+    } catch (error) {
+      console.warn('⚠️ Local transcription of an easy chunk failed, using the cloud:', error);
+      this.routed.cloud++;
+      return null;
+    }
+  }
+
+  /**
+   * Chunks routed each way since start
+   */
+  public getStats(): { local: number; cloud: number } {
+    return { ...this.routed };
+  }
+
+  /**
+   * Capture stopped
+   */
+  public reset(): void {
+    this.byFingerprint.clear();
+  }
+}
+
+function fingerprintKey(fingerprint: Uint32Array): string {
+  return Buffer.from(fingerprint.buffer, fingerprint.byteOffset, fingerprint.byteLength).toString('base64');
+}
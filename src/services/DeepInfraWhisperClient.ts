@@ -1,6 +1,7 @@
 import { ApiKeyManager } from './ApiKeyManager';
 import { ErrorReportingService } from './ErrorReportingService';
 import { ErrorCategory, ErrorSeverity } from '../types/ErrorTypes';
+import { uploadFileName } from './WhisperApiClient';
 
 export interface DeepInfraWhisperRequest {
   audio: Blob;
@@ -62,7 +63,7 @@ export class DeepInfraWhisperClient {
     }
 
     const formData = new FormData();
-    formData.append('file', request.audio, 'audio.wav');
+    formData.append('file', request.audio, uploadFileName(request.audio));
     formData.append('model', request.model || this.config.model);
 
     if (request.language) {
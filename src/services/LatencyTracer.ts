@@ -0,0 +1,176 @@
+/**
+ * Latency Tracer
+ * Where the milliseconds go between audio leaving the device and a caption
+ * (or TTS) coming out. The capture addon gives every utterance chunk a trace
+ * ID and stamps its native stages - capture, DSP done, ring enqueue, JS
+ * callback entry (native-audio-core/latency_trace.h). The ID then travels
+ * with the chunk to the renderer and on IPC requests (IPCRequest.traceId),
+ * and each stage that handles it adds a span: chunk emission, STT,
+ * translation, captions, TTS synthesis and playback.
+ *
+ * Spans stay in a bounded in-memory buffer and are exported as Chrome
+ * trace_event JSON, which Perfetto (ui.perfetto.dev) and chrome://tracing
+ * load: one track per process, one flow arrow per utterance. Tracing is off
+ * unless WHISPRA_TRACE names the output file; the file is written when the
+ * app quits and on demand with the 'trace:export' IPC call.
+ *
+ * NOTE: Main process only; the renderer reports its spans over 'trace:span'.
+ */
+
+import { app, ipcMain, IpcMainInvokeEvent } from 'electron';
+import * as fs from 'fs';
+import { performance } from 'perf_hooks';
+
+export type TraceTrack = 'native' | 'main' | 'renderer';
+
+interface TraceSpan {
+  traceId: string;
+  name: string;
+  track: TraceTrack;
+  startMs: number;
+  durMs: number;
+  args?: Record<string, unknown>;
+}
+
+// The trace fields of a capture addon 'chunk' event (option `timestamps`);
+// every time is on the addon's deviceClockMs() clock.
+export interface NativeChunkTrace {
+  captureTimeMs?: number;
+  durationMs: number;
+  compactedMs?: number; // pauses the chunk's audio left out (chunker.compact)
+  reason: string;
+  trace?: { id: number; processedMs: number; queuedMs: number; deliveredMs: number };
+}
+
+const MAX_SPANS = 100000; // about 15 MB of JSON; the oldest half goes when full
+const TRACK_TIDS: Record<TraceTrack, number> = { native: 1, main: 2, renderer: 3 };
+
+const traceFile = process.env.WHISPRA_TRACE || '';
+let spans: TraceSpan[] = [];
+let localIds = 0;
+
+export function isTracing(): boolean {
+  return traceFile !== '';
+}
+
+// Trace clock: epoch ms with sub-ms resolution. performance.timeOrigin is
+// per process, so main and renderer times line up to within a millisecond.
+export function traceNowMs(): number {
+  return performance.timeOrigin + performance.now();
+}
+
+// An ID for a chunk the addon did not trace (older addons, the JS chunker).
+export function newTraceId(source: string): string | undefined {
+  return isTracing() ? `${source}-js${++localIds}` : undefined;
+}
+
+export function traceSpan(
+  traceId: string | undefined,
+  name: string,
+  track: TraceTrack,
+  startMs: number,
+  endMs: number = traceNowMs(),
+  args?: Record<string, unknown>
+): void {
+  if (!isTracing() || !traceId) return;
+  if (spans.length >= MAX_SPANS) spans = spans.slice(MAX_SPANS / 2);
+  spans.push({ traceId, name, track, startMs, durMs: Math.max(0, endMs - startMs), args });
+}
+
+// Records a chunk's native stages and returns its trace ID (undefined while
+// tracing is off). deviceNowMs is the addon's deviceClockMs() read now; the
+// difference to traceNowMs() moves the native stamps onto the trace clock.
+export function traceNativeChunk(chunk: NativeChunkTrace, deviceNowMs: number, source: string): string | undefined {
+  if (!isTracing()) return undefined;
+  if (!chunk.trace || !chunk.trace.id || !deviceNowMs) return newTraceId(source);
+  const traceId = `${source}-${chunk.trace.id}`;
+  const offsetMs = traceNowMs() - deviceNowMs;
+  const { processedMs, queuedMs, deliveredMs } = chunk.trace;
+  if (chunk.captureTimeMs) {
+    const lastSampleMs = chunk.captureTimeMs + chunk.durationMs + (chunk.compactedMs ?? 0);
+    traceSpan(traceId, 'capture', 'native', chunk.captureTimeMs + offsetMs, lastSampleMs + offsetMs,
+      { durationMs: chunk.durationMs, reason: chunk.reason });
+    traceSpan(traceId, 'dsp', 'native', lastSampleMs + offsetMs, processedMs + offsetMs);
+  }
+  traceSpan(traceId, 'ring-enqueue', 'native', processedMs + offsetMs, queuedMs + offsetMs);
+  traceSpan(traceId, 'tsfn-wait', 'native', queuedMs + offsetMs, deliveredMs + offsetMs);
+  traceSpan(traceId, 'js-callback', 'main', deliveredMs + offsetMs);
+  return traceId;
+}
+
+// Wraps an ipcMain.handle handler so requests carrying a traceId add a span
+// covering the handler.
+export function tracedHandler<A extends unknown[], R>(
+  name: string,
+  handler: (event: IpcMainInvokeEvent, request: any, ...rest: A) => Promise<R>
+): (event: IpcMainInvokeEvent, request: any, ...rest: A) => Promise<R> {
+  return async (event, request, ...rest) => {
+    const traceId: string | undefined = request?.traceId;
+    if (!isTracing() || !traceId) return handler(event, request, ...rest);
+    const startMs = traceNowMs();
+    try {
+      return await handler(event, request, ...rest);
+    } finally {
+      traceSpan(traceId, name, 'main', startMs);
+    }
+  };
+}
+
+// Chrome trace_event JSON: complete events in µs, process/thread names as
+// metadata, and a flow through each utterance's spans in time order.
+export function exportChromeTrace(file: string = traceFile): string | null {
+  if (!file) return null;
+  const events: any[] = [{ name: 'process_name', ph: 'M', pid: 1, tid: 0, args: { name: 'Whispra' } }];
+  for (const track of Object.keys(TRACK_TIDS) as TraceTrack[]) {
+    events.push({ name: 'thread_name', ph: 'M', pid: 1, tid: TRACK_TIDS[track], args: { name: track } });
+  }
+  const byTrace = new Map<string, TraceSpan[]>();
+  for (const span of spans) {
+    events.push({
+      name: span.name, cat: 'latency', ph: 'X', pid: 1, tid: TRACK_TIDS[span.track],
+      ts: Math.round(span.startMs * 1000), dur: Math.round(span.durMs * 1000),
+      args: { traceId: span.traceId, ...span.args }
+    });
+    const list = byTrace.get(span.traceId);
+    if (list) list.push(span);
+    else byTrace.set(span.traceId, [span]);
+  }
+  let flowId = 0;
+  for (const [traceId, list] of byTrace) {
+    if (list.length < 2) continue;
+    list.sort((a, b) => a.startMs - b.startMs);
+    ++flowId;
+    list.forEach((span, i) => {
+      const ph = i === 0 ? 's' : i === list.length - 1 ? 'f' : 't';
+      events.push({
+        name: traceId, cat: 'utterance', ph, id: flowId, pid: 1, tid: TRACK_TIDS[span.track],
+        ts: Math.round(span.startMs * 1000), ...(ph === 'f' ? { bp: 'e' } : {})
+      });
+    });
+  }
+  fs.writeFileSync(file, JSON.stringify({ traceEvents: events, displayTimeUnit: 'ms' }));
+  console.log(`[trace] Wrote ${spans.length} spans (${byTrace.size} utterances) to ${file}`);
+  return file;
+}
+
+export function registerLatencyTraceHandlers(): void {
+  ipcMain.on('trace:span', (_event, traceId: string, name: string, startMs: number, endMs?: number) => {
+    if (typeof traceId === 'string' && typeof name === 'string' && typeof startMs === 'number') {
+      traceSpan(traceId, name, 'renderer', startMs, typeof endMs === 'number' ? endMs : startMs);
+    }
+  });
+  // Always to WHISPRA_TRACE: the renderer does not pick paths to write
+  ipcMain.handle('trace:export', async () => {
+    try {
+      return { success: true, file: exportChromeTrace() };
+    } catch (error) {
+      return { success: false, error: error instanceof Error ? error.message : String(error) };
+    }
+  });
+  if (isTracing()) {
+    console.log(`[trace] Latency tracing on; writing ${traceFile} at exit`);
+    app.on('will-quit', () => {
+      try { exportChromeTrace(); } catch (error) { console.warn('[trace] Failed to write the trace:', error); }
+    });
+  }
+}
@@ -108,6 +108,9 @@ export class LocalProcessingManager {
   async transcribeAudio(audioBuffer: Buffer, options?: {
     language?: string;
     model?: string;
+    stream?: string;
+    captureTimeMs?: number;
+    maxStaleMs?: number; // live captions: shed chunks that would arrive later than this
   }): Promise<TranscriptionResult> {
     if (!this.isInitialized) {
       await this.initialize();
@@ -124,7 +127,10 @@ export class LocalProcessingManager {
       const transcriptionOptions = {
         language: options?.language,
         model: options?.model || localModelConfig?.whisperModel || 'tiny',
-        temperature: localModelConfig?.modelParameters?.temperature || 0.0
+        temperature: localModelConfig?.modelParameters?.temperature || 0.0,
+        stream: options?.stream,
+        captureTimeMs: options?.captureTimeMs,
+        maxStaleMs: options?.maxStaleMs
       };
 
       return await this.whisperService.transcribe(audioBuffer, transcriptionOptions);
@@ -241,6 +247,17 @@ export class LocalProcessingManager {
     }
   }
 
+  /**
+   * Load the configured Whisper model into the native engine at background
+   * priority (app start), ahead of the first caption; false when it can't run natively
+   */
+  async prewarmWhisper(): Promise<boolean> {
+    const config = this.configManager.getConfig();
+    const modelConfig = (config as any).modelConfig || (config as any).localModelConfig;
+    if (modelConfig?.whisperModel) this.whisperService.setModel(modelConfig.whisperModel);
+    return this.whisperService.prewarm();
+  }
+
   /**
    * Initialize Argos service
    */
@@ -4,9 +4,15 @@ import * as path from 'path';
 import * as fs from 'fs';
 import * as os from 'os';
 import { resolveEmbeddedPythonExecutable } from '../utils/pythonPath';
+import { getNativeWhisper, NativeWhisper } from '../ipc/handlers/wasapi-handlers';
+import { WhisperBackendSelector } from './WhisperBackendSelector';
+import { WhisperRingWorker } from './WhisperRingWorker';
 
 /**
- * Local speech-to-text service using Whisper (faster-whisper)
+ * Local speech-to-text service using Whisper. Prefers the in-process
+ * whisper.cpp engine when a ggml model is installed (warm contexts kept per
+ * model, no temp files, on the device WhisperBackendSelector measured fastest); otherwise hands chunks to a persistent faster-whisper worker
+ * over a shared-memory ring, and only as a last resort spawns Python per chunk.
  */
 export class LocalWhisperService {
   private whisperPath: string;
@@ -14,6 +20,11 @@ export class LocalWhisperService {
   private isInitialized: boolean = false;
   private currentModel: string = 'tiny';
   private supportedLanguages: string[] = [];
+  private nativeWhisper: NativeWhisper | null | undefined;
+  private nativeModels = new Set<string>(); // ggml files resident in the engine
+  private nativeLoads = new Map<string, Promise<boolean>>(); // ggml file -> loaded
+  private ringWorker: WhisperRingWorker | null | undefined;
+  private backendSelector = new WhisperBackendSelector((model) => this.getGgmlModelPath(model));
 
   constructor() {
     // Use the correct path where models are actually installed (platform-specific)
@@ -40,8 +51,12 @@ export class LocalWhisperService {
     if (this.isInitialized) return;
 
     try {
-      // Check if faster-whisper is installed
-      await this.checkWhisperInstallation();
+      // Warm the native engine first; Python is only required without it
+      const nativeReady = await this.ensureNativeModel(this.currentModel);
+      if (!nativeReady) {
+        // Check if faster-whisper is installed
+        await this.checkWhisperInstallation();
+      }
 
       // Load supported languages
       this.loadSupportedLanguages();
@@ -61,6 +76,9 @@ export class LocalWhisperService {
     language?: string;
     model?: string;
     temperature?: number;
+    stream?: string; // scheduler key for the native engine, e.g. 'mic' or 'loopback'
+    captureTimeMs?: number; // the chunk's, on the addon's deviceClockMs()
+    maxStaleMs?: number; // natively, shed the chunk rather than caption it later than this
   }): Promise<TranscriptionResult> {
     if (!this.isInitialized) {
       await this.initialize();
@@ -70,9 +88,36 @@ export class LocalWhisperService {
       const model = options?.model || this.currentModel;
       const language = options?.language || 'auto';
       const temperature = options?.temperature || 0.0;
+      // Natively, a quantized or smaller model when this one is too slow or too big here
+      const nativeModel = this.backendSelector.choose(model).model;
 
       console.log(`Transcribing with local Whisper: model=${model}, language=${language}`);
 
+      if (await this.ensureNativeModel(nativeModel)) {
+        try {
+          return await this.transcribeNative(audioBuffer, nativeModel, language, options);
+        } catch (error) {
+          console.warn('Native Whisper transcription failed, falling back to Python:', error);
+        }
+      }
+
+      const worker = this.getRingWorker();
+      if (worker && await worker.ensure(model, language)) {
+        try {
+          const result = await worker.transcribe(audioBuffer);
+          return {
+            text: result.text,
+            language: result.language || language,
+            confidence: result.text ? 0.9 : 0.0,
+            duration: 0,
+            processingTime: result.processingMs,
+            provider: 'whisper-local'
+          };
+        } catch (error) {
+          console.warn('Persistent Whisper worker failed, falling back to one-shot Python:', error);
+        }
+      }
+
       // Save audio buffer to temporary file
       const tempAudioPath = await this.saveAudioToTemp(audioBuffer);
 
@@ -128,6 +173,8 @@ export class LocalWhisperService {
       return false;
     }
 
+    if (this.nativeModels.size > 0) return true;
+
     console.log(`🔍 Checking Whisper availability at: ${this.whisperPath}`);
     console.log(`🔍 Path exists: ${fs.existsSync(this.whisperPath)}`);
 
@@ -233,6 +280,134 @@ export class LocalWhisperService {
     return ['tiny', 'base', 'small', 'medium', 'large', 'large-v2', 'large-v3'];
   }
 
+  /**
+   * ggml model file for the native engine, e.g. <whisperPath>/ggml/ggml-small.bin
+   */
+  private getGgmlModelPath(model: string): string {
+    return path.join(this.whisperPath, 'ggml', `ggml-${model}.bin`);
+  }
+
+  /**
+   * Load and warm up a model in the native engine at background priority, so
+   * the first caption doesn't wait for it (app start). Resolves false when it
+   * can't be used natively.
+   */
+  async prewarm(model: string = this.currentModel): Promise<boolean> {
+    if (this.nativeWhisper === undefined) this.nativeWhisper = getNativeWhisper();
+    if (this.nativeWhisper) {
+      // First run on this machine: time each device (and the quantized and smaller models) first
+      await this.backendSelector.ensureMeasured(this.nativeWhisper, model);
+    }
+    return this.ensureNativeModel(this.backendSelector.choose(model).model, true);
+  }
+
+  /**
+   * Load (and warm up) a model in the native engine unless it's already resident.
+   * Resolves false when the addon, the build flag or the ggml file is missing.
+   */
+  private async ensureNativeModel(model: string, background = false): Promise<boolean> {
+    const modelFile = this.getGgmlModelPath(model);
+    if (this.nativeModels.has(modelFile)) return true;
+    const pending = this.nativeLoads.get(modelFile);
+    if (pending) return pending;
+    if (this.nativeWhisper === undefined) this.nativeWhisper = getNativeWhisper();
+    const engine = this.nativeWhisper;
+    if (!engine || !fs.existsSync(modelFile)) return false;
+
+    const load = engine.load(modelFile, { background, device: this.backendSelector.device(model) }).then(
+      (info) => {
+        if (!info.reused) {
+          console.log(`✅ Native Whisper loaded ${model} (${info.quantization}, +${info.memoryMb.toFixed(0)} MB) on ${info.device} (${info.loadMs.toFixed(0)} ms, warm-up ${info.warmupMs.toFixed(0)} ms${background ? ', background' : ''})`);
+        }
+        // The engine keeps two models at most; a third replaced the oldest
+        const resident = engine.stats().models;
+        this.nativeModels = new Set(resident.length > 0 ? resident : [modelFile]);
+        return true;
+      },
+      (error) => {
+        console.warn(`Native Whisper unavailable for ${model}:`, error instanceof Error ? error.message : error);
+        this.nativeModels.delete(modelFile);
+        return false;
+      }
+    ).finally(() => {
+      this.nativeLoads.delete(modelFile);
+    });
+    this.nativeLoads.set(modelFile, load);
+    return load;
+  }
+
+  /**
+   * The smallest resident model below model, to decode first and stand in
+   * for it when confident; none when model is already the smallest
+   */
+  private getDraftModel(model: string): string | undefined {
+    const sizes = this.getAvailableModels();
+    const rank = sizes.indexOf(model);
+    return sizes.slice(0, Math.max(rank, 0)).find((m) => this.nativeModels.has(this.getGgmlModelPath(m)));
+  }
+
+  /**
+   * Transcribe a 16 kHz WAV buffer with the model's resident native context
+   */
+  private async transcribeNative(audioBuffer: Buffer, model: string, language: string,
+    options?: { stream?: string; captureTimeMs?: number; maxStaleMs?: number }): Promise<TranscriptionResult> {
+    const draft = this.getDraftModel(model);
+    const result = await this.nativeWhisper!.transcribe(audioBuffer, {
+      language,
+      stream: options?.stream,
+      model: this.getGgmlModelPath(model),
+      captureTimeMs: options?.captureTimeMs,
+      maxStaleMs: options?.maxStaleMs,
+      draft: draft ? this.getGgmlModelPath(draft) : undefined
+    });
+    const lastSegment = result.segments[result.segments.length - 1];
+    const text = result.text.trim();
+    if (result.shed) {
+      console.warn(`⏱️ Native Whisper shed a chunk (${result.shed.action}${result.shed.merged ? ` x${result.shed.merged}` : ''}, ${result.shed.lateMs.toFixed(0)} ms late)`);
+    }
+    const drafted = result.draft ? `, draft ${result.draft.accepted ? 'accepted' : 'rejected'}` : '';
+    console.log(`🔍 Native Whisper: ${result.processingMs.toFixed(0)} ms, ${result.segments.length} segment(s)${drafted}`);
+    return {
+      text,
+      language: result.language || language,
+      confidence: text ? 0.9 : 0.0,
+      duration: lastSegment ? lastSegment.endMs / 1000 : 0,
+      processingTime: result.processingMs,
+      provider: 'whisper-local'
+    };
+  }
+
+  /**
+   * Persistent ring-fed worker, created on first use; null without the addon's
+   * audio ring or the embedded Python
+   */
+  private getRingWorker(): WhisperRingWorker | null {
+    if (this.ringWorker !== undefined) return this.ringWorker;
+    try {
+      this.ringWorker = WhisperRingWorker.findWorkerScript()
+        ? new WhisperRingWorker(this.getEmbeddedPythonPath(), this.whisperPath, this.getPythonEnv())
+        : null;
+    } catch (error) {
+      this.ringWorker = null;
+    }
+    return this.ringWorker;
+  }
+
+  /**
+   * Environment for Whisper Python processes; on Mac, PyAV needs FFmpeg
+   * libraries at runtime via DYLD_LIBRARY_PATH
+   */
+  private getPythonEnv(): Record<string, string> {
+    const env: Record<string, string> = { ...process.env, PYTHONPATH: this.whisperPath } as Record<string, string>;
+    if (process.platform === 'darwin') {
+      const ffmpegMacLibPath = path.join(process.cwd(), 'ffmpeg', 'mac', 'lib');
+      env.DYLD_LIBRARY_PATH = env.DYLD_LIBRARY_PATH
+        ? `${ffmpegMacLibPath}:${env.DYLD_LIBRARY_PATH}`
+        : ffmpegMacLibPath;
+    }
+    return env;
+  }
+
   /**
    * Execute Whisper transcription
    */
@@ -302,14 +477,7 @@ except Exception as e:
         const tempScriptPath = path.join(os.tmpdir(), `temp_whisper_${Date.now()}.py`);
         fs.writeFileSync(tempScriptPath, script);
 
-        // On Mac, PyAV needs FFmpeg libraries at runtime via DYLD_LIBRARY_PATH
-        const env: Record<string, string> = { ...process.env, PYTHONPATH: this.whisperPath };
-        if (process.platform === 'darwin') {
-          const ffmpegMacLibPath = path.join(process.cwd(), 'ffmpeg', 'mac', 'lib');
-          env.DYLD_LIBRARY_PATH = env.DYLD_LIBRARY_PATH 
-            ? `${ffmpegMacLibPath}:${env.DYLD_LIBRARY_PATH}`
-            : ffmpegMacLibPath;
-        }
+        const env = this.getPythonEnv();
 
         const childProcess = spawn(embeddedPythonExe, [tempScriptPath], {
           stdio: ['pipe', 'pipe', 'pipe'],
@@ -565,6 +733,8 @@ except ImportError as e:
     this.whisperPath = customPath;
     this.modelPath = path.join(customPath, 'models');
     this.isInitialized = false;
+    this.ringWorker?.stop();
+    this.ringWorker = undefined;
   }
 
   /**
@@ -1,5 +1,6 @@
 import * as path from 'path';
 import * as fs from 'fs';
+import { getNativeOcr, NativeOcr } from '../ipc/handlers/wasapi-handlers';
 
 export interface OCRResult {
   text: string;
@@ -30,6 +31,9 @@ export class OCRService {
   private tesseract: any = null;
   private isInitialized = false;
   private config: OCRConfig;
+  private nativeOcr: NativeOcr | null | undefined;
+  private nativeLanguage: string | null = null; // traineddata resident in the native pool
+  private nativeLoad: Promise<boolean> | null = null;
 
   private constructor(config: OCRConfig = { language: 'eng' }) {
     this.config = config;
@@ -99,6 +103,85 @@ export class OCRService {
     }
   }
 
+  /**
+   * Recognise a raw gray8 frame (a native region grab, preprocessed) with the
+   * native Tesseract pool; null when the addon, the build flag or the
+   * traineddata is missing, so the caller keeps its own engine. Calls run in
+   * parallel across the pool's instances.
+   */
+  public async extractTextFromFrame(
+    frame: { data: Buffer; width: number; height: number; stride?: number },
+    language: string = this.config.language
+  ): Promise<OCRResult | null> {
+    const tessLanguage = OCRService.toTesseractLanguage(language);
+    if (!(await this.ensureNativeEngine(tessLanguage))) return null;
+    const result = await this.nativeOcr!.recognize(
+      { data: frame.data, width: frame.width, height: frame.height, stride: frame.stride ?? frame.width },
+      this.config.pageSegmentationMode === undefined ? {} : { psm: this.config.pageSegmentationMode }
+    );
+    return {
+      text: result.text,
+      boundingBoxes: result.words.filter(word => word.text.trim().length > 0),
+      confidence: result.confidence
+    };
+  }
+
+  /**
+   * Load the native pool for a language unless it's already resident
+   */
+  private async ensureNativeEngine(language: string): Promise<boolean> {
+    if (this.nativeLanguage === language) return true;
+    if (this.nativeLoad) {
+      await this.nativeLoad;
+      if (this.nativeLanguage === language) return true;
+    }
+    if (this.nativeOcr === undefined) this.nativeOcr = getNativeOcr();
+    const engine = this.nativeOcr;
+    const dataPath = this.findTessDataPath(language);
+    if (!engine || !dataPath) return false;
+
+    this.nativeLoad = engine.load(dataPath, { language }).then(
+      (info) => {
+        console.log(`✅ Native Tesseract loaded ${language} (${info.instances} instance(s), ${info.loadMs.toFixed(0)} ms)`);
+        this.nativeLanguage = language;
+        return true;
+      },
+      (error) => {
+        console.warn(`Native Tesseract unavailable for ${language}:`, error instanceof Error ? error.message : error);
+        this.nativeLanguage = null;
+        return false;
+      }
+    ).finally(() => {
+      this.nativeLoad = null;
+    });
+    return this.nativeLoad;
+  }
+
+  /**
+   * Directory holding <language>.traineddata (each of 'eng+deu'): the
+   * configured tessDataPath, the working directory tesseract.js caches into,
+   * or the packaged resources
+   */
+  private findTessDataPath(language: string): string | null {
+    const candidates = [this.config.tessDataPath, process.cwd(), process.resourcesPath].filter((dir): dir is string => !!dir);
+    return candidates.find(dir =>
+      language.split('+').every(lang => fs.existsSync(path.join(dir, `${lang}.traineddata`)))
+    ) ?? null;
+  }
+
+  /**
+   * Tesseract's language name for an app language code ('en' -> 'eng');
+   * Tesseract names pass through
+   */
+  private static toTesseractLanguage(language: string): string {
+    const names: Record<string, string> = {
+      en: 'eng', ru: 'rus', es: 'spa', fr: 'fra', de: 'deu', it: 'ita', pt: 'por', ja: 'jpn', ko: 'kor',
+      zh: 'chi_sim', 'zh-CN': 'chi_sim', 'zh-TW': 'chi_tra', ar: 'ara', hi: 'hin', tr: 'tur', pl: 'pol',
+      nl: 'nld', cs: 'ces', da: 'dan', fi: 'fin', hu: 'hun', no: 'nor', sv: 'swe'
+    };
+    return names[language] ?? language;
+  }
+
   /**
    * Extract text from image file path
    */
@@ -181,5 +264,9 @@ export class OCRService {
   public cleanup(): void {
     this.isInitialized = false;
     this.tesseract = null;
+    if (this.nativeOcr && this.nativeLanguage) {
+      this.nativeOcr.unload().catch(() => {});
+      this.nativeLanguage = null;
+    }
   }
 }
\ No newline at end of file
@@ -0,0 +1,60 @@
+/**
+ * Recognised text of screen bands read before, keyed on the band's native
+ * tile-row checksums (RegionCapture's rowHashes) plus the OCR engine and
+ * language, so UI chrome, menus and subtitles that come back to the same
+ * pixels are served without running OCR again. Boxes are kept in frame
+ * pixels relative to the band's top row. The cache holds at most `capacity`
+ * bands; the least recently used go first.
+ */
+
+export interface CachedOcrBox {
+  text: string;
+  x: number;
+  y: number;
+  width: number;
+  height: number;
+  confidence: number;
+}
+
+export class OcrResultCache {
+  private entries = new Map<string, CachedOcrBox[]>(); // in use order, oldest first
+  private hits = 0;
+  private misses = 0;
+
+  constructor(private readonly capacity: number = 256) {}
+
+  /** Key of the band covering tile rows [firstRow, endRow) of a frame `width` pixels wide */
+  public static key(engine: string, language: string, width: number, rowHashes: Buffer, firstRow: number, endRow: number): string {
+    return `${engine}|${language}|${width}|${rowHashes.subarray(firstRow * 8, endRow * 8).toString('base64')}`;
+  }
+
+  public get(key: string): CachedOcrBox[] | undefined {
+    const boxes = this.entries.get(key);
+    if (!boxes) {
+      this.misses++;
+      return undefined;
+    }
+    this.hits++;
+    this.entries.delete(key);
+    this.entries.set(key, boxes);
+    return boxes;
+  }
+
+  public set(key: string, boxes: CachedOcrBox[]): void {
+    this.entries.delete(key);
+    this.entries.set(key, boxes);
+    while (this.entries.size > this.capacity) {
+      this.entries.delete(this.entries.keys().next().value as string);
+    }
+  }
+
+  public clear(): void {
+    this.entries.clear();
+    this.hits = 0;
+    this.misses = 0;
+  }
+
+  public stats(): { entries: number; hits: number; misses: number } {
+    return { entries: this.entries.size, hits: this.hits, misses: this.misses };
+  }
+}
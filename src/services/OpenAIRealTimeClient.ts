@@ -8,6 +8,7 @@ import { ApiKeyManager } from './ApiKeyManager';
 import { EventEmitter } from 'events';
 import { ErrorReportingService } from './ErrorReportingService';
 import { ErrorCategory, ErrorSeverity } from '../types/ErrorTypes';
+import { subscribeRealtimeInput } from '../ipc/handlers/wasapi-handlers';
 
 // Use ws package for Node.js WebSocket support
 let WebSocketClass: any;
@@ -58,6 +59,7 @@ export class OpenAIRealTimeClient extends EventEmitter {
   private reconnectAttempts: number = 0;
   private maxReconnectAttempts: number = 3;
   private reconnectDelay: number = 1000;
+  private stopNativeInput: (() => void) | null = null;
 
   constructor(apiKeyManager: ApiKeyManager, config: Partial<RealTimeConfig> = {}) {
     super();
@@ -378,6 +380,40 @@ export class OpenAIRealTimeClient extends EventEmitter {
     });
   }
 
+  /**
+   * Send a ready-made input_audio_buffer.append message as a text frame, as
+   * the capture addon's 'realtime-append' packets come, without re-encoding it
+   */
+  sendAudioAppend(frame: Buffer): void {
+    if (!this.ws || !this.isConnected) {
+      throw new Error('WebSocket not connected');
+    }
+    if (isNodeWebSocket) {
+      this.ws.send(frame, { binary: false });
+    } else {
+      this.ws.send(frame.toString('latin1'));
+    }
+  }
+
+  /**
+   * Stream the default capture straight into the input buffer: the addon
+   * resamples it to 24 kHz and base64-encodes each 40 ms frame into its
+   * append message natively, so nothing is converted here. False when the
+   * addon can't produce the format
+   */
+  streamNativeCapture(): boolean {
+    if (this.stopNativeInput) return true;
+    this.stopNativeInput = subscribeRealtimeInput('openai-realtime', (frame) => {
+      if (this.isConnected) this.sendAudioAppend(frame);
+    });
+    return this.stopNativeInput !== null;
+  }
+
+  stopNativeCapture(): void {
+    this.stopNativeInput?.();
+    this.stopNativeInput = null;
+  }
+
   /**
    * Commit audio buffer (trigger processing)
    */
@@ -413,6 +449,7 @@ export class OpenAIRealTimeClient extends EventEmitter {
    * Disconnect from WebSocket
    */
   disconnect(): void {
+    this.stopNativeCapture();
     if (this.ws) {
       this.ws.close();
       this.ws = null;
@@ -5,6 +5,8 @@ import { app } from 'electron';
 import { resolveEmbeddedPythonExecutable } from '../utils/pythonPath';
 import { ErrorReportingService } from './ErrorReportingService';
 import { ErrorCategory, ErrorSeverity } from '../types/ErrorTypes';
+import { getNativePaddleOcr, openNativeAudioRing, type NativeAudioRing, type NativePaddleOcr, type NativeRegionFrame } from '../ipc/handlers/wasapi-handlers';
+import { ScreenCaptureService } from './ScreenCaptureService';
 
 // Import for additional cleanup
 import type { App } from 'electron';
@@ -55,6 +57,10 @@ export class PaddleOCRService {
     language: string;
     useGpu: boolean;
   }> = [];
+  private frameRing: NativeAudioRing | null | undefined; // Shared-memory handoff to the persistent service; null once unavailable
+  private nativePaddle: NativePaddleOcr | null | undefined; // In-process ONNX engine (uiSettings.paddleOnnx)
+  private nativeModels: string | null = null; // "<det>|<rec>" resident in it
+  private nativeLoad: Promise<boolean> | null = null;
   private activeOCRRequests: Map<string, { process: any; reject: (error: Error) => void }> = new Map(); // Track active OCR requests
   private downloadStatus: ModelDownloadStatus = {
     isDownloading: false, // Always false since we use pre-downloaded models
@@ -460,7 +466,137 @@ export class PaddleOCRService {
     }
   }
 
-  private async performOCR(imagePath: string, config: OCRModelConfig): Promise<OCRResult> {
+  /**
+   * OCR of a raw gray/BGRA frame (RegionCapture or preprocessForOcr output).
+   * The frame goes to the persistent service through the shared-memory ring
+   * and is read there as a numpy array, with no image file or encoding; when
+   * the ring or the service isn't available it is wrapped as a BMP instead.
+   */
+  public async extractTextFromFrame(
+    frame: Pick<NativeRegionFrame, 'data' | 'width' | 'height' | 'stride' | 'format'>,
+    targetLanguage: string
+  ): Promise<OCRResult> {
+    const config = this.modelConfigs.get(targetLanguage);
+    if (!config) {
+      throw new Error(`Unsupported OCR language: ${targetLanguage}`);
+    }
+    const native = await this.recognizeNative([frame], config);
+    if (native) return native[0];
+    await this.initializeForLanguage(targetLanguage);
+
+    const { useGpu, inputLanguage } = this.ocrSettings(config);
+    if (this.frameRing === undefined) {
+      this.frameRing = openNativeAudioRing('ocr', { capacityKb: 16384 });
+    }
+    if (this.frameRing) {
+      try {
+        await this.startPersistentService(inputLanguage, useGpu);
+      } catch (error) {
+        console.log('⚠️ Failed to start persistent service for frame OCR:', error);
+      }
+      if (this.persistentPythonProcess && !this.persistentPythonProcess.killed) {
+        const seq = this.frameRing.writeImage(frame);
+        if (seq >= 0) {
+          return this.sendServiceRequest({
+            type: 'ocr_frame',
+            mapping: this.frameRing.mapping,
+            doorbell: this.frameRing.doorbell,
+            seq,
+            language: inputLanguage,
+            use_gpu: useGpu
+          }, `ring frame ${seq}`, inputLanguage, useGpu);
+        }
+      }
+    }
+    return this.extractText(ScreenCaptureService.encodeBmp(frame), targetLanguage);
+  }
+
+  /**
+   * OCR of several frames (e.g. every watch box) in one pass of the in-process
+   * engine; without it each frame takes extractTextFromFrame's path in turn.
+   */
+  public async extractTextFromFrames(
+    frames: Array<Pick<NativeRegionFrame, 'data' | 'width' | 'height' | 'stride' | 'format'>>,
+    targetLanguage: string
+  ): Promise<OCRResult[]> {
+    const config = this.modelConfigs.get(targetLanguage);
+    if (!config) {
+      throw new Error(`Unsupported OCR language: ${targetLanguage}`);
+    }
+    const native = await this.recognizeNative(frames, config);
+    if (native) return native;
+    const results: OCRResult[] = [];
+    for (const frame of frames) results.push(await this.extractTextFromFrame(frame, targetLanguage));
+    return results;
+  }
+
+  /**
+   * Frames through the in-process ONNX engine when uiSettings.paddleOnnx is on
+   * and the exported models are present; null leaves them to the Python service
+   */
+  private async recognizeNative(
+    frames: Array<Pick<NativeRegionFrame, 'data' | 'width' | 'height' | 'stride' | 'format'>>,
+    config: OCRModelConfig
+  ): Promise<OCRResult[] | null> {
+    if (!(await this.ensureNativeModels(config))) return null;
+    try {
+      const { results, processingMs } = await this.nativePaddle!.recognize(frames);
+      console.log(`📖 Native PaddleOCR: ${frames.length} frame(s) in ${processingMs.toFixed(0)} ms`);
+      return results.map(result => ({
+        text: result.text,
+        boundingBoxes: result.boxes,
+        confidence: result.boxes.length
+          ? result.boxes.reduce((sum, box) => sum + box.confidence, 0) / result.boxes.length
+          : 0
+      }));
+    } catch (error) {
+      console.warn('⚠️ Native PaddleOCR failed, using the Python service:', error);
+      return null;
+    }
+  }
+
+  /**
+   * Load a language's det/rec (and cls) ONNX models unless they're resident.
+   * Resolves false when the setting is off, or the addon, the build flag or
+   * a model file is missing.
+   */
+  private async ensureNativeModels(config: OCRModelConfig): Promise<boolean> {
+    const ConfigurationManager = require('./ConfigurationManager').ConfigurationManager;
+    const settings = ConfigurationManager.getInstance().getValue('uiSettings.paddleOnnx');
+    if (!settings?.enabled) return false;
+    const key = `${config.det}|${config.rec}`;
+    if (this.nativeModels === key) return true;
+    if (this.nativeLoad) {
+      await this.nativeLoad;
+      if (this.nativeModels === key) return true;
+    }
+    if (this.nativePaddle === undefined) this.nativePaddle = getNativePaddleOcr();
+    const engine = this.nativePaddle;
+    const dir: string = settings.modelDir || path.join(this.modelsPath, 'onnx');
+    const det = path.join(dir, `${config.det}.onnx`);
+    const rec = path.join(dir, `${config.rec}.onnx`);
+    const dict = path.join(dir, `${config.rec}.txt`);
+    const cls = path.join(dir, 'cls.onnx');
+    if (!engine || ![det, rec, dict].every(file => fs.existsSync(file))) return false;
+
+    this.nativeLoad = engine.load({ det, rec, dict, cls: fs.existsSync(cls) ? cls : undefined, device: settings.device }).then(
+      (info) => {
+        console.log(`✅ Native PaddleOCR loaded ${config.rec} on ${info.provider} in ${info.loadMs.toFixed(0)} ms`);
+        this.nativeModels = key;
+        return true;
+      },
+      (error) => {
+        console.warn(`Native PaddleOCR unavailable for ${config.rec}:`, error instanceof Error ? error.message : error);
+        this.nativeModels = null;
+        return false;
+      }
+    ).finally(() => {
+      this.nativeLoad = null;
+    });
+    return this.nativeLoad;
+  }
+
+  private ocrSettings(config: OCRModelConfig): { useGpu: boolean; inputLanguage: string } {
     // Get GPU mode setting
     const ConfigurationManager = require('./ConfigurationManager').ConfigurationManager;
     const configManager = ConfigurationManager.getInstance();
@@ -486,6 +622,47 @@ export class PaddleOCRService {
       'hi': 'hi'   // Add direct Hindi mapping
     };
     const inputLanguage = languageMapping[config.language] || 'ja';
+    return { useGpu, inputLanguage };
+  }
+
+  /**
+   * Queue one command on the persistent service; it answers in order.
+   */
+  private sendServiceRequest(command: object, imagePath: string, language: string, useGpu: boolean): Promise<OCRResult> {
+    return new Promise((resolve, reject) => {
+      // Queue request
+      this.persistentProcessRequestQueue.push({
+        resolve,
+        reject,
+        imagePath,
+        language,
+        useGpu
+      });
+
+      // Send OCR command
+      try {
+        this.persistentPythonProcess.stdin.write(JSON.stringify(command) + '\n');
+
+        // Timeout after 30 seconds
+        setTimeout(() => {
+          const index = this.persistentProcessRequestQueue.findIndex(r => r.resolve === resolve);
+          if (index >= 0) {
+            this.persistentProcessRequestQueue.splice(index, 1);
+            reject(new Error('OCR request timeout'));
+          }
+        }, 30000);
+      } catch (error) {
+        const index = this.persistentProcessRequestQueue.findIndex(r => r.resolve === resolve);
+        if (index >= 0) {
+          this.persistentProcessRequestQueue.splice(index, 1);
+        }
+        reject(error);
+      }
+    });
+  }
+
+  private async performOCR(imagePath: string, config: OCRModelConfig): Promise<OCRResult> {
+    const { useGpu, inputLanguage } = this.ocrSettings(config);
 
     // Generate unique request ID
     const requestId = `${Date.now()}_${Math.random().toString(36).substr(2, 9)}`;
@@ -495,43 +672,12 @@ export class PaddleOCRService {
       await this.startPersistentService(inputLanguage, useGpu);
       
       if (this.persistentPythonProcess && !this.persistentPythonProcess.killed) {
-        return new Promise((resolve, reject) => {
-          // Queue request
-          this.persistentProcessRequestQueue.push({
-            resolve,
-            reject,
-            imagePath,
-            language: inputLanguage,
-            useGpu
-          });
-
-          // Send OCR command
-          try {
-            const command = JSON.stringify({
-              type: 'ocr',
-              image_path: imagePath,
-              language: inputLanguage,
-              use_gpu: useGpu
-            }) + '\n';
-            
-            this.persistentPythonProcess.stdin.write(command);
-            
-            // Timeout after 30 seconds
-            setTimeout(() => {
-              const index = this.persistentProcessRequestQueue.findIndex(r => r.resolve === resolve);
-              if (index >= 0) {
-                this.persistentProcessRequestQueue.splice(index, 1);
-                reject(new Error('OCR request timeout'));
-              }
-            }, 30000);
-          } catch (error) {
-            const index = this.persistentProcessRequestQueue.findIndex(r => r.resolve === resolve);
-            if (index >= 0) {
-              this.persistentProcessRequestQueue.splice(index, 1);
-            }
-            reject(error);
-          }
-        });
+        return this.sendServiceRequest({
+          type: 'ocr',
+          image_path: imagePath,
+          language: inputLanguage,
+          use_gpu: useGpu
+        }, imagePath, inputLanguage, useGpu);
       }
     } catch (error) {
       console.log('⚠️ Failed to use persistent service, falling back to one-shot:', error);
@@ -0,0 +1,134 @@
+/**
+ * Local neural TTS: Piper voices run in the addon (ONNX Runtime) and speak
+ * straight into the native TTS render session sentence by sentence, so the
+ * first audio of a translation plays tens of milliseconds after the text is
+ * ready, with no network round trip. Enabled by uiSettings.localTts; the
+ * cloud voices (TextToSpeechManager / StreamingTTSService) remain the path
+ * whenever it's off, no voice fits the language or no native render runs.
+ *
+ * Voices are Piper's <name>.onnx with its <name>.onnx.json, in
+ * uiSettings.localTts.voicesPath (default appData/whispra/models/Piper);
+ * an espeak-ng-data folder there is handed to espeak-ng for phonemisation.
+ */
+
+import { app } from 'electron';
+import * as fs from 'fs';
+import * as path from 'path';
+import { ConfigurationManager } from './ConfigurationManager';
+import {
+  getNativePiperTts,
+  speakTtsRender,
+  type NativePiperTts,
+  type NativeSpeechResult
+} from '../ipc/handlers/wasapi-handlers';
+
+interface LocalTtsSettings {
+  enabled: boolean;
+  voicesPath?: string;
+  voices?: Record<string, string>;
+  lengthScale?: number;
+}
+
+export class PiperTTSService {
+  private static instance: PiperTTSService | null = null;
+
+  private engine: NativePiperTts | null | undefined; // undefined until first asked for
+  private loads = new Map<string, Promise<boolean>>(); // voice name -> loaded
+
+  public static getInstance(): PiperTTSService {
+    if (!PiperTTSService.instance) {
+      PiperTTSService.instance = new PiperTTSService();
+    }
+    return PiperTTSService.instance;
+  }
+
+  /**
+   * Speak text in the target language on the native TTS render. Null when
+   * local TTS is off or can't take it, so the caller uses the cloud voices.
+   */
+  public async speak(text: string, language: string): Promise<NativeSpeechResult | null> {
+    const settings = this.settings();
+    if (!settings?.enabled) return null;
+    const voice = this.findVoice(settings, language);
+    if (!voice || !(await this.ensureVoice(voice))) return null;
+    try {
+      const spoken = speakTtsRender(path.basename(voice, '.onnx'), text, { lengthScale: settings.lengthScale });
+      if (!spoken) return null;
+      const result = await spoken;
+      return result.sentences === 0 && !result.cancelled ? null : result;
+    } catch (error) {
+      console.warn('[PiperTTS] Local speech failed, using the cloud voice:', error);
+      return null;
+    }
+  }
+
+  /** Drop every loaded voice (settings changed, or to free memory) */
+  public async unload(): Promise<void> {
+    this.loads.clear();
+    await this.engine?.unload();
+  }
+
+  private settings(): LocalTtsSettings | undefined {
+    return ConfigurationManager.getInstance().getValue<LocalTtsSettings>('uiSettings.localTts');
+  }
+
+  private voicesPath(settings: LocalTtsSettings): string {
+    return settings.voicesPath || path.join(app.getPath('appData'), 'whispra', 'models', 'Piper');
+  }
+
+  // The configured voice for the language, else the first <language>_*.onnx
+  // (Piper names voices like en_US-lessac-medium); null when there's none
+  private findVoice(settings: LocalTtsSettings, language: string): string | null {
+    const dir = this.voicesPath(settings);
+    const base = language.toLowerCase().split(/[-_]/)[0];
+    const configured = settings.voices?.[language] ?? settings.voices?.[base];
+    if (configured) {
+      const model = path.join(dir, configured.endsWith('.onnx') ? configured : `${configured}.onnx`);
+      return fs.existsSync(model) ? model : null;
+    }
+    try {
+      const file = fs.readdirSync(dir)
+        .filter(name => name.endsWith('.onnx') && name.toLowerCase().startsWith(`${base}_`))
+        .sort()[0];
+      return file ? path.join(dir, file) : null;
+    } catch {
+      return null;
+    }
+  }
+
+  private ensureVoice(model: string): Promise<boolean> {
+    const name = path.basename(model, '.onnx');
+    let load = this.loads.get(name);
+    if (!load) {
+      load = this.loadVoice(name, model);
+      this.loads.set(name, load);
+    }
+    return load;
+  }
+
+  private async loadVoice(name: string, model: string): Promise<boolean> {
+    if (this.engine === undefined) this.engine = getNativePiperTts();
+    if (!this.engine) return false;
+    try {
+      const json = JSON.parse(await fs.promises.readFile(`${model}.json`, 'utf8'));
+      const espeakData = path.join(path.dirname(model), 'espeak-ng-data');
+      const info = await this.engine.load(name, {
+        model,
+        sampleRate: json.audio?.sample_rate ?? 22050,
+        phonemeIdMap: json.phoneme_id_map ?? {},
+        phonemeType: json.phoneme_type === 'text' ? 'text' : 'espeak',
+        espeakVoice: json.espeak?.voice,
+        espeakData: fs.existsSync(espeakData) ? espeakData : undefined,
+        noiseScale: json.inference?.noise_scale,
+        lengthScale: json.inference?.length_scale,
+        noiseW: json.inference?.noise_w,
+        speakers: json.num_speakers ?? 1
+      });
+      console.log(`[PiperTTS] Voice ${name} loaded in ${info.loadMs.toFixed(0)}ms (${info.sampleRate} Hz)`);
+      return true;
+    } catch (error) {
+      console.warn(`[PiperTTS] Voice ${name} unavailable:`, error instanceof Error ? error.message : error);
+      return false;
+    }
+  }
+}
@@ -2,6 +2,7 @@ import { screen, nativeImage, desktopCapturer } from 'electron';
 import * as fs from 'fs';
 import * as path from 'path';
 import * as os from 'os';
+import { createNativeRegionCapture, NativeRegionCapture, NativeRegionFrame } from '../ipc/handlers/wasapi-handlers';
 
 export interface CaptureOptions {
   format: 'png' | 'jpg';
@@ -29,6 +30,7 @@ export interface CaptureResult {
  */
 export class ScreenCaptureService {
   private static instance: ScreenCaptureService;
+  private armed: { displayId: number; capture: NativeRegionCapture } | null = null;
 
   private constructor() {}
 
@@ -91,6 +93,26 @@ export class ScreenCaptureService {
       throw new Error('Region is required for region capture');
     }
 
+    // Grab just the region natively instead of encoding and cropping the whole screen
+    const native = this.openRegionCapture(screen.getPrimaryDisplay().id, region, 'bgra');
+    if (native) {
+      try {
+        const frame = await native.grab(500);
+        const image = nativeImage.createFromBitmap(frame.data, { width: frame.width, height: frame.height });
+        return {
+          buffer: options.format === 'jpg' ? image.toJPEG(options.quality || 80) : image.toPNG(),
+          width: frame.width,
+          height: frame.height,
+          format: options.format,
+          timestamp: Date.now()
+        };
+      } catch (error) {
+        console.warn('Native region capture failed, falling back to a full-screen grab:', error);
+      } finally {
+        native.close();
+      }
+    }
+
     try {
       // First capture the full screen
       const fullCapture = await this.captureFullScreen(options);
@@ -119,6 +141,130 @@ export class ScreenCaptureService {
     }
   }
 
+  /**
+   * Open a native grabber for a rectangle of a display, in DIPs relative to
+   * the display. Frames come back raw at the display's native resolution
+   * (Desktop Duplication / ScreenCaptureKit) with per-tile change detection
+   * (tileSize pixels, 32 by default); null when the addon has no
+   * RegionCapture, so callers keep the desktopCapturer path.
+   */
+  public openRegionCapture(
+    displayId: number,
+    region: { x: number; y: number; width: number; height: number },
+    format: 'bgra' | 'gray' = 'gray',
+    tileSize?: number
+  ): NativeRegionCapture | null {
+    const display = screen.getAllDisplays().find(d => d.id === displayId) || screen.getPrimaryDisplay();
+    const rect = this.toNativeRect(display, region);
+    try {
+      return createNativeRegionCapture(rect, { format, tileSize });
+    } catch (error) {
+      console.warn('Native region capture unavailable:', error);
+      return null;
+    }
+  }
+
+  /**
+   * Keep a native capture of a whole display open, so a box selection on it
+   * can be grabbed with grabArmedRegion() at once instead of enumerating
+   * sources and rendering a thumbnail per display. Desktop Duplication holds
+   * the current image until asked and ScreenCaptureKit only delivers frames
+   * when something was presented, so an idle armed capture costs little. Arming
+   * another display disarms the first; false when the addon can't grab
+   * rectangles (callers keep the desktopCapturer path).
+   */
+  public armDisplayCapture(displayId: number): boolean {
+    if (this.armed?.displayId === displayId) return true;
+    this.disarmDisplayCapture();
+    const display = screen.getAllDisplays().find(d => d.id === displayId);
+    if (!display) return false;
+    const capture = this.openRegionCapture(displayId, { x: 0, y: 0, width: display.bounds.width, height: display.bounds.height }, 'bgra');
+    if (!capture) return false;
+    if (typeof capture.grabRect !== 'function') {
+      capture.close();
+      return false;
+    }
+    this.armed = { displayId, capture };
+    // The first grab opens the duplication or stream; do it now, not on the hotkey
+    capture.grabRect(this.toNativeRect(display, { x: 0, y: 0, width: 1, height: 1 }), 0).catch(error => {
+      console.warn('Armed display capture failed to start:', error);
+    });
+    return true;
+  }
+
+  public disarmDisplayCapture(): void {
+    if (!this.armed) return;
+    this.armed.capture.close();
+    this.armed = null;
+  }
+
+  /**
+   * The newest frame of a rectangle (DIPs relative to the display) from the
+   * armed capture of that display, in native pixels; waits up to timeoutMs
+   * for a frame newer than the last one taken. Null when the display is not
+   * armed or the grab fails.
+   */
+  public async grabArmedRegion(
+    displayId: number,
+    region: { x: number; y: number; width: number; height: number },
+    timeoutMs = 0
+  ): Promise<NativeRegionFrame | null> {
+    if (!this.armed || this.armed.displayId !== displayId || !this.armed.capture.grabRect) return null;
+    const display = screen.getAllDisplays().find(d => d.id === displayId);
+    if (!display) return null;
+    try {
+      return await this.armed.capture.grabRect(this.toNativeRect(display, region), timeoutMs);
+    } catch (error) {
+      console.warn('Armed region grab failed:', error);
+      return null;
+    }
+  }
+
+  // A display-relative DIP rectangle in the addon's units: physical pixels on
+  // Windows, points (DIPs) on macOS, both global
+  private toNativeRect(
+    display: Electron.Display,
+    region: { x: number; y: number; width: number; height: number }
+  ): { x: number; y: number; width: number; height: number } {
+    const global = {
+      x: display.bounds.x + region.x,
+      y: display.bounds.y + region.y,
+      width: region.width,
+      height: region.height
+    };
+    return process.platform === 'win32' ? screen.dipToScreenRect(null, global) : global;
+  }
+
+  /**
+   * Uncompressed BMP of a native frame, for consumers that want an image file
+   * (OCR reads it as is) without paying for PNG encoding.
+   */
+  public static encodeBmp(frame: Pick<NativeRegionFrame, 'data' | 'width' | 'height' | 'stride' | 'format'>): Buffer {
+    const gray = frame.format === 'gray';
+    const bytesPerPixel = gray ? 1 : 4;
+    const rowBytes = (frame.width * bytesPerPixel + 3) & ~3;
+    const paletteBytes = gray ? 256 * 4 : 0;
+    const offset = 14 + 40 + paletteBytes;
+    const bmp = Buffer.alloc(offset + rowBytes * frame.height);
+    bmp.write('BM', 0, 'ascii');
+    bmp.writeUInt32LE(bmp.length, 2);
+    bmp.writeUInt32LE(offset, 10);
+    bmp.writeUInt32LE(40, 14);
+    bmp.writeInt32LE(frame.width, 18);
+    bmp.writeInt32LE(-frame.height, 22); // top-down rows, as grabbed
+    bmp.writeUInt16LE(1, 26);
+    bmp.writeUInt16LE(bytesPerPixel * 8, 28);
+    bmp.writeUInt32LE(rowBytes * frame.height, 34);
+    if (gray) {
+      for (let i = 0; i < 256; i++) bmp.writeUInt32LE(i * 0x010101, 54 + i * 4);
+    }
+    for (let row = 0; row < frame.height; row++) {
+      const start = row * frame.stride;
+      frame.data.copy(bmp, offset + row * rowBytes, start, start + frame.width * bytesPerPixel);
+    }
+    return bmp;
+  }
+
   /**
    * Save capture to file
    */
@@ -88,6 +88,10 @@ export class ScreenTranslationBoxSelectManager {
 
         console.log(`Opening box selector on display ${targetDisplay.id} at cursor position`, cursorPoint);
 
+        // Arm a native capture of the display while the box is drawn, so the
+        // selection is grabbed at once instead of through desktopCapturer
+        this.screenCaptureService.armDisplayCapture(targetDisplay.id);
+
         // Close existing window if any
         this.closeBoxSelectWindow();
 
@@ -130,6 +134,7 @@ export class ScreenTranslationBoxSelectManager {
         // Handle window close
         this.boxSelectWindow.on('closed', () => {
             this.boxSelectWindow = null;
+            if (!this.currentSelection?.width) this.screenCaptureService.disarmDisplayCapture(); // cancelled
         });
     }
 
@@ -147,6 +152,10 @@ export class ScreenTranslationBoxSelectManager {
 
         console.log('Processing box selection:', this.currentSelection);
 
+        // Take the armed capture's frame that still shows the selector, so the
+        // grab after it closes waits for the next one
+        await this.screenCaptureService.grabArmedRegion(this.currentSelection.displayId, this.currentSelection, 0);
+
         // Close the selection window
         this.closeBoxSelectWindow();
 
@@ -190,6 +199,13 @@ export class ScreenTranslationBoxSelectManager {
                 this.translationService = new TranslationServiceManager(ConfigurationManager.getInstance());
             }
 
+            const armed = await this.ocrArmedSelection(this.currentSelection);
+            if (armed) {
+                await this.translateBoxes(armed, this.currentSelection.displayId);
+                sendToMainWindow('screen-translation:box-processing-complete');
+                return;
+            }
+
             // Capture the display
             console.log(`Capturing display ${this.currentSelection.displayId}`);
             const captureResult = await this.screenCaptureService.captureDisplay(this.currentSelection.displayId);
@@ -259,41 +275,7 @@ export class ScreenTranslationBoxSelectManager {
                 return;
             }
 
-            // Translate the text with streaming updates
-            const translatedResults = [];
-            for (const box of boxesInRegion) {
-                console.log(`🌐 Box Selector Translation: "${box.text}" from ${this.sourceLanguage} to ${this.targetLanguage}`);
-                
-                const translationResult = await this.translationService.translate(
-                    box.text,
-                    this.targetLanguage,  // Fixed: target language goes second
-                    this.sourceLanguage === 'auto' ? undefined : this.sourceLanguage  // Fixed: source language goes third
-                );
-
-                // Extract the translated text string from the result object
-                const translatedText = typeof translationResult === 'string' 
-                    ? translationResult 
-                    : (translationResult?.translatedText || box.text);
-
-                console.log(`Translated "${box.text}" -> "${translatedText}"`);
-
-                const translatedBox = {
-                    text: box.text,
-                    translatedText: translatedText,  // Use the extracted string, not the whole object
-                    coordinates: [
-                        { x: box.x, y: box.y },
-                        { x: box.x + box.width, y: box.y },
-                        { x: box.x + box.width, y: box.y + box.height },
-                        { x: box.x, y: box.y + box.height }
-                    ]
-                };
-
-                translatedResults.push(translatedBox);
-
-                // Stream update: Show this translation immediately
-                await this.showTranslationOverlay(translatedResults, this.currentSelection.displayId);
-                console.log(`🔄 Box Selector Streamed update: ${translatedResults.length} boxes now showing`);
-            }
+            await this.translateBoxes(boxesInRegion, this.currentSelection.displayId);
 
             // Final update is no longer needed since we stream updates in the loop
 
@@ -307,6 +289,73 @@ export class ScreenTranslationBoxSelectManager {
         }
     }
 
+    // Translates each box and streams it to the overlay as it lands
+    private async translateBoxes(boxes: Array<{ text: string; x: number; y: number; width: number; height: number }>, displayId: number): Promise<void> {
+        const translatedResults = [];
+        for (const box of boxes) {
+            console.log(`🌐 Box Selector Translation: "${box.text}" from ${this.sourceLanguage} to ${this.targetLanguage}`);
+            
+            const translationResult = await this.translationService!.translate(
+                box.text,
+                this.targetLanguage,  // Fixed: target language goes second
+                this.sourceLanguage === 'auto' ? undefined : this.sourceLanguage  // Fixed: source language goes third
+            );
+
+            // Extract the translated text string from the result object
+            const translatedText = typeof translationResult === 'string' 
+                ? translationResult 
+                : (translationResult?.translatedText || box.text);
+
+            console.log(`Translated "${box.text}" -> "${translatedText}"`);
+
+            const translatedBox = {
+                text: box.text,
+                translatedText: translatedText,  // Use the extracted string, not the whole object
+                coordinates: [
+                    { x: box.x, y: box.y },
+                    { x: box.x + box.width, y: box.y },
+                    { x: box.x + box.width, y: box.y + box.height },
+                    { x: box.x, y: box.y + box.height }
+                ]
+            };
+
+            translatedResults.push(translatedBox);
+
+            // Stream update: Show this translation immediately
+            await this.showTranslationOverlay(translatedResults, displayId);
+            console.log(`🔄 Box Selector Streamed update: ${translatedResults.length} boxes now showing`);
+        }
+    }
+
+    /**
+     * OCR of the selection grabbed from the display's armed native capture,
+     * with boxes in display DIPs; null when the display is not armed, so the
+     * caller takes the full-display path.
+     */
+    private async ocrArmedSelection(selection: BoxSelection): Promise<Array<{ text: string; x: number; y: number; width: number; height: number }> | null> {
+        try {
+            // The selector is gone by now: wait for the frame without it
+            const frame = await this.screenCaptureService.grabArmedRegion(selection.displayId, selection, 250);
+            if (!frame) return null;
+            const ocrLanguage = this.sourceLanguage === 'auto' ? 'en' : this.sourceLanguage;
+            const ocrResult = await this.paddleService!.extractTextFromFrame(frame, ocrLanguage);
+            // Native pixels back to DIPs of the display
+            const scaleX = selection.width / frame.width;
+            const scaleY = selection.height / frame.height;
+            const boxes = (ocrResult?.boundingBoxes ?? []).map(box => ({
+                text: box.text,
+                x: selection.x + box.x * scaleX,
+                y: selection.y + box.y * scaleY,
+                width: box.width * scaleX,
+                height: box.height * scaleY
+            }));
+            console.log(`Found ${boxes.length} text boxes in the armed grab of the selection`);
+            return boxes;
+        } finally {
+            this.screenCaptureService.disarmDisplayCapture();
+        }
+    }
+
     private async showTranslationOverlay(results: any[], displayId: number): Promise<void> {
         // Get overlay manager instance
         if (!this.overlayManager) {
@@ -1,8 +1,11 @@
 import { BrowserWindow, screen, ipcMain } from 'electron';
 import * as path from 'path';
+import { OCRService, type OCRResult } from './OCRService';
+import { OcrResultCache, type CachedOcrBox } from './OcrResultCache';
 import { PaddleOCRService } from './PaddleOCRService';
 import { TranslationServiceManager } from './TranslationServiceManager';
 import { ScreenCaptureService } from './ScreenCaptureService';
+import { createSubtitleTracker, createTextStabilizer, findTextRegions, preprocessForOcr, type NativeOcrImage, type NativeRegionCapture, type NativeRegionFrame, type NativeSubtitleTracker, type NativeTextStabilizer } from '../ipc/handlers/wasapi-handlers';
 import { ScreenTranslationOverlayManager } from './ScreenTranslationOverlayManager';
 import { ConfigurationManager } from './ConfigurationManager';
 
@@ -48,6 +51,17 @@ export class ScreenTranslationWatchBoxManager {
     private watchIntervalMs: number = 3000; // Check every 3 seconds to allow time for overlays to display
     private lastOverlayShowTime: number = 0; // Track when overlays were last shown
     private isShowingOverlays: boolean = false; // Flag to prevent clearing overlays while they're being shown
+    private regionCapture: NativeRegionCapture | null = null; // Native grabber for the watched region, when the addon has one
+    private minChangedRatio: number = 0.005; // Share of the region's tiles that must change before we re-OCR
+    private tileSize: number = 32; // Change-detection tile, in captured pixels
+    private minOcrBandHeight: number = 64; // Bands shorter than this are upscaled 2x before OCR
+    private maxTextRegions: number = 8; // More proposals than this (or most of the band) and the band is read whole
+    private maxTextCoverage: number = 0.6;
+    private ocrCache = new OcrResultCache(); // Band text by tile-row checksums, so recurring pixels skip OCR
+    private previousRowHashes: Buffer | null = null; // Last grab's rowHashes, to find the rows that changed
+    private textStabilizer: NativeTextStabilizer | null = null; // Votes over each line's recent readings, when the addon has it
+    private observedSpans: Array<{ y: number; height: number }> | undefined; // DIP bands the last recognition read; undefined for all of it
+    private subtitleTracker: NativeSubtitleTracker | null = null; // Learns the rows text appears on, so OCR reads just those
 
     private constructor() {
         this.screenCaptureService = ScreenCaptureService.getInstance();
@@ -170,6 +184,17 @@ export class ScreenTranslationWatchBoxManager {
         console.log('👁️ Starting to watch region:', this.currentSelection);
         this.isWatching = true;
         this.previousTexts.clear(); // Reset tracked texts
+        this.ocrCache.clear();
+        this.previousRowHashes = null;
+        // A line is translated once two of its last four readings agree, so
+        // half-drawn or misread subtitles don't each cost a translation
+        this.textStabilizer = createTextStabilizer({ window: 4, minVotes: 2, similarity: 0.8 });
+        this.subtitleTracker = createSubtitleTracker({ margin: this.tileSize / 2 });
+
+        // Grab only the watched rectangle natively; null keeps the full-display capture
+        const { x, y, width, height, displayId } = this.currentSelection;
+        this.regionCapture = this.screenCaptureService.openRegionCapture(displayId, { x, y, width, height }, 'gray', this.tileSize);
+        console.log(`📷 Watch box capture: ${this.regionCapture ? 'native region' : 'full display'}`);
 
         // Initialize services
         if (!this.paddleService) {
@@ -320,8 +345,15 @@ export class ScreenTranslationWatchBoxManager {
             this.watchInterval = null;
         }
 
+        if (this.regionCapture) {
+            this.regionCapture.close();
+            this.regionCapture = null;
+        }
+
         // Clear tracked texts
         this.previousTexts.clear();
+        this.textStabilizer = null;
+        this.subtitleTracker = null;
         this.lastOverlayShowTime = 0;
         this.isShowingOverlays = false;
 
@@ -350,51 +382,23 @@ export class ScreenTranslationWatchBoxManager {
         }
 
         try {
-            // Capture the display
-            const captureResult = await this.screenCaptureService.captureDisplay(this.currentSelection.displayId);
-
-            if (!captureResult || !captureResult.buffer) {
-                console.error('Failed to capture screen for watch box');
-                return false;
-            }
-
-            // Perform OCR on the full screen (we'll filter to the region afterwards)
             const ocrLanguage = this.sourceLanguage === 'auto' ? 'en' : this.sourceLanguage;
-            const ocrResult = await this.paddleService!.extractText(captureResult.buffer, ocrLanguage);
-
-            if (!ocrResult || !ocrResult.boundingBoxes || ocrResult.boundingBoxes.length === 0) {
-                return false; // No text found
+            // The native grabber reads just the region; otherwise OCR the display and filter to it
+            this.observedSpans = undefined;
+            let boxesWithAdjustedCoords = (await this.recognizeRegion(ocrLanguage)) ?? (await this.recognizeDisplay(ocrLanguage));
+
+            // Only lines that settled on new text go on; the stabilizer also
+            // needs the empty recognitions, which count toward held lines
+            if (this.textStabilizer) {
+                boxesWithAdjustedCoords = this.textStabilizer
+                    .observe(boxesWithAdjustedCoords.filter(box => box.text.length > 0), this.observedSpans)
+                    .map(({ text, x, y, width, height }) => ({ text, x, y, width, height }));
             }
 
-            // Filter boxes that overlap with the selected region
-            const boxesInRegion = ocrResult.boundingBoxes.filter(box => {
-                // Check if box overlaps with selection (use intersection test)
-                const boxRight = box.x + box.width;
-                const boxBottom = box.y + box.height;
-                const selectionRight = this.currentSelection!.x + this.currentSelection!.width;
-                const selectionBottom = this.currentSelection!.y + this.currentSelection!.height;
-
-                const overlaps = !(boxRight < this.currentSelection!.x ||
-                                  box.x > selectionRight ||
-                                  boxBottom < this.currentSelection!.y ||
-                                  box.y > selectionBottom);
-
-                return overlaps;
-            });
-
-            if (boxesInRegion.length === 0) {
+            if (boxesWithAdjustedCoords.length === 0) {
                 return false; // No text in region
             }
 
-            // Map to our format
-            const boxesWithAdjustedCoords = boxesInRegion.map(box => ({
-                text: box.text.trim(),
-                x: box.x,
-                y: box.y,
-                width: box.width,
-                height: box.height
-            }));
-
             // Filter to only new text (text we haven't seen before)
             const newBoxes = boxesWithAdjustedCoords.filter(box => {
                 const textKey = `${box.text}`;
@@ -458,6 +462,304 @@ export class ScreenTranslationWatchBoxManager {
         }
     }
 
+    // OCR of the watched region through the native grabber, in display DIPs.
+    // Null without one (or once it fails), so the caller falls back to the
+    // full display; empty when nothing inside the region changed.
+    private async recognizeRegion(ocrLanguage: string): Promise<TextBox[] | null> {
+        if (!this.regionCapture || !this.currentSelection) {
+            return null;
+        }
+        const selection = this.currentSelection;
+        let frame;
+        try {
+            frame = await this.regionCapture.grab(200);
+        } catch (error) {
+            console.warn('⚠️ Native region capture failed, using full-display capture:', error);
+            this.regionCapture.close();
+            this.regionCapture = null;
+            return null;
+        }
+        const previousRowHashes = this.previousRowHashes;
+        this.previousRowHashes = frame.rowHashes ?? null;
+        if (!frame.changed || !frame.changedRect || frame.changedRatio < this.minChangedRatio) {
+            this.observedSpans = [];
+            return []; // Same pixels (or a caret blink) since last time: no new text
+        }
+
+        // Each changed band is served from the cache when its rows were read
+        // before and OCR'd otherwise; without row hashes (an older addon) the
+        // band is the full-width span of changedRect, a tile's worth of margin
+        // either side so text lines crossing its edge stay whole
+        const config = ConfigurationManager.getInstance().getConfig();
+        const engine = config.uiSettings?.ocrEngine ?? 'paddle';
+        const scale = frame.width / selection.width;
+        const boxes: TextBox[] = [];
+        const observed: Array<{ y: number; height: number }> = [];
+        // Changed rows outside the rows the tracker expects text on are left
+        // unread, unless it has yet to learn them
+        const active = this.subtitleTracker?.band(frame.height) ?? { y: 0, height: frame.height, full: true };
+        const textRows: Array<{ y: number; height: number }> = [];
+        const { inside, outside } = this.clipBands(frame, this.changedBands(frame, previousRowHashes), active);
+        for (const band of inside) {
+            observed.push({ y: selection.y + band.top / scale, height: (band.bottom - band.top) / scale });
+            const key = frame.rowHashes
+                ? OcrResultCache.key(engine, ocrLanguage, frame.width, frame.rowHashes, band.firstRow, band.endRow)
+                : null;
+            let found = key ? this.ocrCache.get(key) : undefined;
+            if (!found) {
+                found = await this.recognizeBand(frame, band.top, band.bottom, ocrLanguage);
+                if (key) this.ocrCache.set(key, found);
+            }
+            // Band pixels to frame pixels, then to DIPs on the display
+            for (const box of found) {
+                textRows.push({ y: band.top + box.y, height: box.height });
+                boxes.push({
+                    text: box.text.trim(),
+                    x: selection.x + box.x / scale,
+                    y: selection.y + (band.top + box.y) / scale,
+                    width: box.width / scale,
+                    height: box.height / scale
+                });
+            }
+        }
+        const stats = this.ocrCache.stats();
+        console.log(`🗂️ OCR cache: ${stats.hits} hit(s), ${stats.misses} miss(es), ${stats.entries} band(s)`);
+        if (this.subtitleTracker) {
+            // Nothing in the band while text-like regions changed outside it:
+            // the captions moved, so the tracker forgets the band
+            const textOutside = textRows.length === 0 && !active.full && (await this.hasTextRegions(frame, outside));
+            this.subtitleTracker.observe(frame.height, active, textRows, textOutside);
+            if (!active.full) {
+                const tracked = this.subtitleTracker.getStats();
+                console.log(`🎯 Subtitle band: rows ${active.y}-${active.y + active.height} of ${frame.height}, ${Math.round(tracked.readRatio * 100)}% of rows read, ${tracked.misses} miss(es)`);
+            }
+        }
+        this.observedSpans = observed;
+        return boxes;
+    }
+
+    // Changed bands split at the tracker's active rows, on tile-row bounds so
+    // cache keys still describe what was read: the parts inside are read, the
+    // parts outside are only checked for text-like regions
+    private clipBands(
+        frame: NativeRegionFrame,
+        bands: Array<{ firstRow: number; endRow: number; top: number; bottom: number }>,
+        active: { y: number; height: number; full: boolean }
+    ): {
+        inside: Array<{ firstRow: number; endRow: number; top: number; bottom: number }>;
+        outside: Array<{ top: number; bottom: number }>;
+    } {
+        if (active.full) {
+            return { inside: bands, outside: [] };
+        }
+        const tileSize = frame.tileSize || this.tileSize;
+        const activeFirst = Math.floor(active.y / tileSize);
+        const activeEnd = Math.ceil((active.y + active.height) / tileSize);
+        const inside: Array<{ firstRow: number; endRow: number; top: number; bottom: number }> = [];
+        const outside: Array<{ top: number; bottom: number }> = [];
+        for (const band of bands) {
+            const firstRow = Math.max(band.firstRow, activeFirst);
+            const endRow = Math.min(band.endRow, activeEnd);
+            if (firstRow >= endRow) {
+                outside.push({ top: band.top, bottom: band.bottom });
+                continue;
+            }
+            const top = Math.max(band.top, firstRow * tileSize);
+            const bottom = Math.min(band.bottom, endRow * tileSize);
+            inside.push({ firstRow, endRow, top, bottom });
+            if (band.top < top) outside.push({ top: band.top, bottom: top });
+            if (bottom < band.bottom) outside.push({ top: bottom, bottom: band.bottom });
+        }
+        return { inside, outside };
+    }
+
+    // Whether the native proposals find anything text-like in these rows
+    private async hasTextRegions(frame: NativeRegionFrame, bands: Array<{ top: number; bottom: number }>): Promise<boolean> {
+        for (const band of bands) {
+            try {
+                const proposals = await findTextRegions(frame, { crop: { x: 0, y: band.top, width: frame.width, height: band.bottom - band.top } });
+                if (proposals && proposals.regions.length > 0) {
+                    return true;
+                }
+            } catch (error) {
+                console.warn('⚠️ Native text-region detection failed outside the subtitle band:', error);
+                return true; // Can't tell, so let the tracker widen
+            }
+        }
+        return false;
+    }
+
+    // Full-width bands of the frame to re-read: runs of tile rows whose
+    // checksum differs from the previous grab, each grown by a row either side
+    // so text crossing its edge stays whole, and merged where they touch
+    private changedBands(
+        frame: NativeRegionFrame,
+        previousRowHashes: Buffer | null
+    ): Array<{ firstRow: number; endRow: number; top: number; bottom: number }> {
+        const tileSize = frame.tileSize || this.tileSize;
+        if (!frame.rowHashes) {
+            const rect = frame.changedRect!;
+            const top = Math.max(0, rect.y - tileSize);
+            const bottom = Math.min(frame.height, rect.y + rect.height + tileSize);
+            return [{ firstRow: Math.floor(top / tileSize), endRow: Math.ceil(bottom / tileSize), top, bottom }];
+        }
+        const rows = frame.rowHashes.length / 8;
+        const resized = !previousRowHashes || previousRowHashes.length !== frame.rowHashes.length;
+        const bands: Array<{ firstRow: number; endRow: number; top: number; bottom: number }> = [];
+        for (let row = 0; row < rows; row++) {
+            const changed = resized || frame.rowHashes.compare(previousRowHashes!, row * 8, row * 8 + 8, row * 8, row * 8 + 8) !== 0;
+            if (!changed) continue;
+            const firstRow = Math.max(0, row - 1);
+            const endRow = Math.min(rows, row + 2);
+            const last = bands[bands.length - 1];
+            if (last && firstRow <= last.endRow) {
+                last.endRow = endRow;
+            } else {
+                bands.push({ firstRow, endRow, top: 0, bottom: 0 });
+            }
+        }
+        for (const band of bands) {
+            band.top = band.firstRow * tileSize;
+            band.bottom = Math.min(frame.height, band.endRow * tileSize);
+        }
+        return bands;
+    }
+
+    // OCR of rows [top, bottom) of a frame, boxes in frame pixels relative to
+    // top. Only the band's likely text rectangles are read when the addon
+    // proposes a few of them; none means no text, and many (or most of the
+    // band) means the band is read whole.
+    private async recognizeBand(frame: NativeRegionFrame, top: number, bottom: number, ocrLanguage: string): Promise<CachedOcrBox[]> {
+        const band = { x: 0, y: top, width: frame.width, height: bottom - top };
+        let crops = [band];
+        try {
+            const proposals = await findTextRegions(frame, { crop: band });
+            if (proposals && proposals.regions.length === 0) {
+                return [];
+            }
+            if (proposals && proposals.regions.length <= this.maxTextRegions && proposals.coverage <= this.maxTextCoverage) {
+                crops = proposals.regions;
+            }
+        } catch (error) {
+            console.warn('⚠️ Native text-region detection failed, reading the whole band:', error);
+        }
+
+        const images = await Promise.all(crops.map(crop => this.prepareCrop(frame, crop)));
+        const results = await this.recognizeImages(images.map(prepared => prepared.image), ocrLanguage);
+        const boxes: CachedOcrBox[] = [];
+        results.forEach((ocrResult, i) => {
+            const { crop, scaleX, scaleY } = images[i];
+            for (const box of ocrResult?.boundingBoxes ?? []) {
+                boxes.push({
+                    text: box.text,
+                    x: crop.x + box.x / scaleX,
+                    y: crop.y - top + box.y / scaleY,
+                    width: box.width / scaleX,
+                    height: box.height / scaleY,
+                    confidence: box.confidence
+                });
+            }
+        });
+        return boxes;
+    }
+
+    // Gray, contrast-stretched and, for short crops, upscaled so small glyphs
+    // reach the height OCR reads reliably, in the addon; the raw rows are
+    // wrapped as is when it has no preprocessing stage
+    private async prepareCrop(
+        frame: NativeRegionFrame,
+        crop: { x: number; y: number; width: number; height: number }
+    ): Promise<{ image: NativeRegionFrame; crop: { x: number; y: number; width: number; height: number }; scaleX: number; scaleY: number }> {
+        const scaleUp = crop.height < this.minOcrBandHeight ? 2 : 1;
+        let prepared: NativeOcrImage | null = null;
+        try {
+            prepared = await preprocessForOcr(frame, { crop, scale: scaleUp, contrast: 'stretch' });
+        } catch (error) {
+            console.warn('⚠️ Native OCR preprocessing failed, using the raw band:', error);
+        }
+        if (prepared) {
+            const image = { ...frame, data: prepared.data, width: prepared.width, height: prepared.height, stride: prepared.width, format: 'gray' as const };
+            return { image, crop, scaleX: prepared.scaleX, scaleY: prepared.scaleY };
+        }
+        // Without preprocessing the full-width rows are read, so boxes stay in frame columns
+        const rows = { x: 0, y: crop.y, width: frame.width, height: crop.height };
+        const image = { ...frame, data: frame.data.subarray(crop.y * frame.stride, (crop.y + crop.height) * frame.stride), height: crop.height };
+        return { image, crop: rows, scaleX: 1, scaleY: 1 };
+    }
+
+    // Tesseract for each image when it's selected (several at once from its
+    // pool), Paddle in one batch for the rest
+    private async recognizeImages(images: NativeRegionFrame[], ocrLanguage: string): Promise<Array<OCRResult | null>> {
+        const results = await Promise.all(images.map(image => this.recognizeWithTesseract(image, ocrLanguage)));
+        const pending = results.map((result, i) => (result ? -1 : i)).filter(i => i >= 0);
+        if (pending.length > 0) {
+            const paddle = await this.paddleService!.extractTextFromFrames(pending.map(i => images[i]), ocrLanguage);
+            pending.forEach((index, k) => {
+                results[index] = paddle[k] ?? null;
+            });
+        }
+        return results;
+    }
+
+    // The native Tesseract pool, when uiSettings.ocrEngine picks it; null
+    // leaves the frame to Paddle
+    private async recognizeWithTesseract(
+        image: { data: Buffer; width: number; height: number; stride: number; format: 'bgra' | 'gray' },
+        ocrLanguage: string
+    ): Promise<OCRResult | null> {
+        if (image.format !== 'gray' || ConfigurationManager.getInstance().getConfig().uiSettings?.ocrEngine !== 'tesseract') {
+            return null;
+        }
+        try {
+            return await OCRService.getInstance().extractTextFromFrame(image, ocrLanguage);
+        } catch (error) {
+            console.warn('⚠️ Native Tesseract failed, using Paddle:', error);
+            return null;
+        }
+    }
+
+    private async recognizeDisplay(ocrLanguage: string): Promise<TextBox[]> {
+        // Capture the display
+        const captureResult = await this.screenCaptureService.captureDisplay(this.currentSelection!.displayId);
+
+        if (!captureResult || !captureResult.buffer) {
+            console.error('Failed to capture screen for watch box');
+            return [];
+        }
+
+        // Perform OCR on the full screen (we'll filter to the region afterwards)
+        const ocrResult = await this.paddleService!.extractText(captureResult.buffer, ocrLanguage);
+
+        if (!ocrResult || !ocrResult.boundingBoxes || ocrResult.boundingBoxes.length === 0) {
+            return []; // No text found
+        }
+
+        // Filter boxes that overlap with the selected region
+        const boxesInRegion = ocrResult.boundingBoxes.filter(box => {
+            // Check if box overlaps with selection (use intersection test)
+            const boxRight = box.x + box.width;
+            const boxBottom = box.y + box.height;
+            const selectionRight = this.currentSelection!.x + this.currentSelection!.width;
+            const selectionBottom = this.currentSelection!.y + this.currentSelection!.height;
+
+            const overlaps = !(boxRight < this.currentSelection!.x ||
+                              box.x > selectionRight ||
+                              boxBottom < this.currentSelection!.y ||
+                              box.y > selectionBottom);
+
+            return overlaps;
+        });
+
+        // Map to our format
+        return boxesInRegion.map(box => ({
+            text: box.text.trim(),
+            x: box.x,
+            y: box.y,
+            width: box.width,
+            height: box.height
+        }));
+    }
+
     private async showTranslationOverlay(results: any[], displayId: number): Promise<void> {
         // Get overlay manager instance - EXACTLY like box selector
         if (!this.overlayManager) {
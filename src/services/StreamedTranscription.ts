@@ -0,0 +1,138 @@
+/**
+ * Progressive upload of loopback utterances (capture option chunker.stream).
+ * The addon sends each utterance's audio as 'chunk-stream' parts from the
+ * moment its speech starts, and they go straight onto a 'transcribe-stream'
+ * request of the managed WebSocket (WhispraWebSocketClient), so once the
+ * chunker cuts the utterance only its tail is left to upload. The transcript
+ * is then picked up by speech:transcribe through the chunk's native
+ * fingerprint, which the renderer passes back with the chunk's WAV; chunks
+ * without one, or whose stream failed, are transcribed from the WAV as before.
+ */
+
+import { ManagedApiRouter } from './ManagedApiRouter';
+import { TranscriptionStream, WhispraWebSocketClient } from './WhispraWebSocketClient';
+
+// One 'chunk-stream' event of the capture addon
+export interface ChunkStreamPart {
+  id: number;    // the utterance; its 'chunk' event carries it as streamId
+  seq: number;   // parts of one utterance count up from 0
+  format: 'ogg' | 'pcm16';
+  sampleRate: number;
+  data: Buffer;
+  end: boolean;     // the last part; the chunk follows
+  aborted: boolean; // silence reset the utterance before it became a chunk
+}
+
+export interface StreamedTranscript {
+  text: string;
+  language: string;
+  duration?: number;
+}
+
+const RESULT_TTL_MS = 30000; // a transcript the renderer never asked for
+
+interface OpenStream {
+  upload: TranscriptionStream;
+  nextSeq: number;
+}
+
+export class StreamedTranscription {
+  private static instance: StreamedTranscription | null = null;
+
+  private open = new Map<number, OpenStream>();
+  private finished = new Map<number, Promise<StreamedTranscript>>(); // by stream id, until its chunk arrives
+  private byFingerprint = new Map<string, { result: Promise<StreamedTranscript>; expires: number }>();
+
+  public static getInstance(): StreamedTranscription {
+    if (!StreamedTranscription.instance) {
+      StreamedTranscription.instance = new StreamedTranscription();
+    }
+    return StreamedTranscription.instance;
+  }
+
+  /**
+   * Worth asking the addon for chunk streams: managed mode with the WebSocket up
+   */
+  public isAvailable(): boolean {
+    const router = ManagedApiRouter.getInstance();
+    return router.getMode() === 'managed' && router.isWebSocketConnected();
+  }
+
+  /**
+   * A part of an utterance's stream; a missing part (dropped on overflow)
+   * aborts the upload and leaves the chunk to the WAV path
+   */
+  public onPart(part: ChunkStreamPart, language?: string): void {
+    let stream = this.open.get(part.id);
+    if (!stream) {
+      if (part.seq !== 0 || part.aborted) return;
+      try {
+        const upload = WhispraWebSocketClient.getInstance().openTranscriptionStream({
+          format: part.format,
+          sampleRate: part.sampleRate,
+          language: language === 'auto' ? undefined : language
+        });
+        stream = { upload, nextSeq: 0 };
+        this.open.set(part.id, stream);
+      } catch {
+        return; // not connected: the chunk goes the usual way
+      }
+    }
+    if (part.aborted || part.seq !== stream.nextSeq) {
+      stream.upload.abort();
+      this.open.delete(part.id);
+      return;
+    }
+    stream.nextSeq++;
+    if (part.data.length > 0) stream.upload.push(part.data);
+    if (!part.end) return;
+    this.open.delete(part.id);
+    const result = stream.upload.finish().then((response: any) => {
+      const data = response?.data ?? response;
+      return { text: String(data?.text ?? ''), language: String(data?.language ?? language ?? ''), duration: data?.duration };
+    });
+    result.catch(() => {}); // looked at, if at all, through take()
+    this.finished.set(part.id, result);
+  }
+
+  /**
+   * The utterance's chunk arrived: its transcript becomes findable by the
+   * chunk's fingerprint
+   */
+  public onChunk(streamId: number | undefined, fingerprint: Uint32Array | undefined): void {
+    if (streamId === undefined) return;
+    const result = this.finished.get(streamId);
+    this.finished.delete(streamId);
+    if (!result || !fingerprint || fingerprint.length === 0) return;
+    const now = Date.now();
+    for (const [key, entry] of this.byFingerprint) {
+      if (entry.expires <= now) this.byFingerprint.delete(key);
+    }
+    this.byFingerprint.set(fingerprintKey(fingerprint), { result, expires: now + RESULT_TTL_MS });
+  }
+
+  /**
+   * The streamed transcript of the chunk with this fingerprint, once; null
+   * when it was not streamed
+   */
+  public take(fingerprint: Uint32Array): Promise<StreamedTranscript> | null {
+    const key = fingerprintKey(fingerprint);
+    const entry = this.byFingerprint.get(key);
+    if (!entry) return null;
+    this.byFingerprint.delete(key);
+    return entry.expires > Date.now() ? entry.result : null;
+  }
+
+  /**
+   * Capture stopped: streams still open never end
+   */
+  public reset(): void {
+    for (const stream of this.open.values()) stream.upload.abort();
+    this.open.clear();
+    this.finished.clear();
+  }
+}
+
+function fingerprintKey(fingerprint: Uint32Array): string {
+  return Buffer.from(fingerprint.buffer, fingerprint.byteOffset, fingerprint.byteLength).toString('base64');
+}
@@ -2,17 +2,23 @@
  * TTS Cache with Background Processing
  * Caches TTS results and processes them in the background
  * Enhanced with translation caching and fuzzy matching
+ * Synthesized audio goes to the addon's disk cache when it is available
+ * (openNativeTtsCache), so it survives restarts and stays off the JS heap
+ * Fuzzy translation lookups go through the addon's trigram index
+ * (getNativeFuzzyIndex) instead of comparing against every cached text
  */
 
 import { TextToSpeechManager } from './TextToSpeechManager';
 import { TranslationResult } from '../interfaces/TranslationService';
 import { FuzzyMatcher } from '../utils/FuzzyMatcher';
+import { getNativeFuzzyIndex, openNativeTtsCache, type NativeFuzzyIndex, type NativeTtsCache } from '../ipc/handlers/wasapi-handlers';
 
 interface CacheEntry {
     text: string;
     voiceId: string;
     modelId?: string;
     audioData?: ArrayBuffer;
+    onDisk?: boolean; // audio is in the native disk cache instead of audioData
     status: 'pending' | 'processing' | 'ready' | 'error';
     error?: string;
     timestamp: number;
@@ -40,8 +46,44 @@ export class TTSCache {
     private maxTranslationCacheSize: number = 1000;
     private fuzzyMatchThreshold: number = 0.8;
 
+    private disk: NativeTtsCache | null = null;
+
+    // Native index over translationCache by id, when the addon has one
+    private fuzzyIndex: NativeFuzzyIndex | null;
+    private translationIds: Map<string, number> = new Map();
+    private translationKeys: Map<number, string> = new Map();
+    private nextTranslationId: number = 1;
+
     constructor(ttsManager: TextToSpeechManager) {
         this.ttsManager = ttsManager;
+        openNativeTtsCache().then(disk => { this.disk = disk; });
+        this.fuzzyIndex = getNativeFuzzyIndex();
+        this.fuzzyIndex?.clear();
+    }
+
+    /**
+     * Audio from the disk cache, or null
+     */
+    private readDisk(text: string, voiceId: string, modelId?: string): ArrayBuffer | null {
+        const hit = this.disk?.get(text, voiceId, modelId);
+        if (!hit) return null;
+        const { audio } = hit;
+        // A Buffer over the mapping spans its whole ArrayBuffer; a copied one may not
+        if (audio.byteOffset === 0 && audio.byteLength === audio.buffer.byteLength) return audio.buffer as ArrayBuffer;
+        return audio.buffer.slice(audio.byteOffset, audio.byteOffset + audio.byteLength) as ArrayBuffer;
+    }
+
+    /**
+     * Stores synthesized audio on disk; false when it has to stay in memory
+     */
+    private writeDisk(text: string, voiceId: string, modelId: string | undefined, audioData: ArrayBuffer): boolean {
+        if (!this.disk || audioData.byteLength === 0) return false;
+        try {
+            return this.disk.put(text, voiceId, modelId, audioData);
+        } catch (error) {
+            console.warn('TTS disk cache write failed:', error);
+            return false;
+        }
     }
 
     /**
@@ -62,6 +104,10 @@ export class TTSCache {
         if (this.cache.has(key)) {
             return;
         }
+        if (this.readDisk(text, voiceId, modelId)) {
+            this.cache.set(key, { text, voiceId, modelId, onDisk: true, status: 'ready', timestamp: Date.now() });
+            return;
+        }
 
         // Add to cache as pending
         const entry: CacheEntry = {
@@ -97,9 +143,16 @@ export class TTSCache {
         const entry = this.cache.get(key);
 
         if (!entry) {
+            const stored = this.readDisk(text, voiceId, modelId);
+            if (stored) {
+                console.log(`✅ Disk cache hit: "${text.substring(0, 50)}..."`);
+                return stored;
+            }
             // Not in cache, synthesize immediately
             console.log(`⚡ Cache miss, synthesizing immediately: "${text.substring(0, 50)}..."`);
-            return await this.ttsManager.synthesize(text, voiceId, modelId);
+            const audioData = await this.ttsManager.synthesize(text, voiceId, modelId);
+            this.writeDisk(text, voiceId, modelId, audioData);
+            return audioData;
         }
 
         // Wait for processing to complete
@@ -116,6 +169,13 @@ export class TTSCache {
             console.log(`✅ Cache hit: "${text.substring(0, 50)}..."`);
             return entry.audioData;
         }
+        if (entry.onDisk) {
+            const stored = this.readDisk(text, voiceId, modelId);
+            if (stored) {
+                console.log(`✅ Disk cache hit: "${text.substring(0, 50)}..."`);
+                return stored;
+            }
+        }
 
         // Fallback
         return await this.ttsManager.synthesize(text, voiceId, modelId);
@@ -127,7 +187,7 @@ export class TTSCache {
     isReady(text: string, voiceId: string, modelId?: string): boolean {
         const key = this.getCacheKey(text, voiceId, modelId);
         const entry = this.cache.get(key);
-        return entry?.status === 'ready' && !!entry.audioData;
+        return entry?.status === 'ready' && (!!entry.audioData || !!entry.onDisk);
     }
 
     /**
@@ -191,7 +251,8 @@ export class TTSCache {
                 entry.modelId
             );
 
-            entry.audioData = audioData;
+            if (this.writeDisk(entry.text, entry.voiceId, entry.modelId, audioData)) entry.onDisk = true;
+            else entry.audioData = audioData;
             entry.status = 'ready';
 
             const duration = Date.now() - startTime;
@@ -302,16 +363,23 @@ export class TTSCache {
         };
 
         this.translationCache.set(key, entry);
+        if (this.fuzzyIndex) {
+            const id = this.translationIds.get(key) ?? this.nextTranslationId++;
+            this.translationIds.set(key, id);
+            this.translationKeys.set(id, key);
+            this.fuzzyIndex.add(id, FuzzyMatcher.normalize(sourceText), targetLanguage);
+        }
     }
 
     /**
-     * Get cached translation with fuzzy matching
+     * Get cached translation with fuzzy matching (exact matches only when fuzzy is false)
      */
     getCachedTranslation(
         sourceText: string,
         targetLanguage: string,
         sourceLanguage?: string,
-        provider?: string
+        provider?: string,
+        fuzzy: boolean = true
     ): TranslationResult | null {
         // First try exact match
         const exactKey = this.getTranslationCacheKey(sourceText, targetLanguage, sourceLanguage, provider);
@@ -321,20 +389,36 @@ export class TTSCache {
             exactMatch.timestamp = Date.now();
             return exactMatch.result;
         }
+        if (!fuzzy) return null;
 
         // Try fuzzy matching if no exact match
         const candidates: Array<{ key: string; entry: TranslationCacheEntry; similarity: number }> = [];
-        
-        this.translationCache.forEach((entry, key) => {
-            // Match target language and provider
-            if (entry.targetLanguage === targetLanguage &&
-                (!provider || entry.provider === provider)) {
-                const similarity = FuzzyMatcher.normalizedSimilarity(sourceText, entry.sourceText);
-                if (similarity >= this.fuzzyMatchThreshold) {
-                    candidates.push({ key, entry, similarity });
+
+        if (this.fuzzyIndex) {
+            const matches = this.fuzzyIndex.find(FuzzyMatcher.normalize(sourceText), {
+                threshold: this.fuzzyMatchThreshold,
+                group: targetLanguage,
+                limit: 64
+            });
+            for (const match of matches) {
+                const key = this.translationKeys.get(match.id);
+                const entry = key !== undefined ? this.translationCache.get(key) : undefined;
+                if (key !== undefined && entry && (!provider || entry.provider === provider)) {
+                    candidates.push({ key, entry, similarity: match.similarity });
                 }
             }
-        });
+        } else {
+            this.translationCache.forEach((entry, key) => {
+                // Match target language and provider
+                if (entry.targetLanguage === targetLanguage &&
+                    (!provider || entry.provider === provider)) {
+                    const similarity = FuzzyMatcher.normalizedSimilarity(sourceText, entry.sourceText);
+                    if (similarity >= this.fuzzyMatchThreshold) {
+                        candidates.push({ key, entry, similarity });
+                    }
+                }
+            });
+        }
 
         if (candidates.length > 0) {
             // Sort by similarity and access count
@@ -382,6 +466,12 @@ export class TTSCache {
 
         if (oldestKey) {
             this.translationCache.delete(oldestKey);
+            const id = this.translationIds.get(oldestKey);
+            if (id !== undefined) {
+                this.fuzzyIndex?.remove(id);
+                this.translationIds.delete(oldestKey);
+                this.translationKeys.delete(id);
+            }
         }
     }
 
@@ -390,6 +480,9 @@ export class TTSCache {
      */
     clearTranslationCache(): void {
         this.translationCache.clear();
+        this.fuzzyIndex?.clear();
+        this.translationIds.clear();
+        this.translationKeys.clear();
     }
 
     /**
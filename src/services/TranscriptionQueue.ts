@@ -2,6 +2,7 @@ import { EventEmitter } from 'events';
 import { AudioSegment } from '../interfaces/AudioCaptureService';
 import { TranscriptionResult } from '../interfaces/SpeechToTextService';
 import { SpeechToTextService } from './SpeechToTextService';
+import { traceNowMs, traceSpan } from './LatencyTracer';
 
 export interface QueueItem {
   id: string;
@@ -10,6 +11,7 @@ export interface QueueItem {
   timestamp: number;
   retryCount: number;
   maxRetries: number;
+  queuedMs: number; // trace clock, for the segment's latency trace
 }
 
 export interface QueueConfig {
@@ -69,7 +71,8 @@ export class TranscriptionQueue extends EventEmitter {
       priority,
       timestamp: Date.now(),
       retryCount: 0,
-      maxRetries
+      maxRetries,
+      queuedMs: traceNowMs()
     };
 
     // Insert item in priority order (higher priority first)
@@ -113,6 +116,7 @@ export class TranscriptionQueue extends EventEmitter {
 
   private async processItem(item: QueueItem): Promise<void> {
     const startTime = Date.now();
+    traceSpan(item.segment.traceId, 'transcription-queue', 'main', item.queuedMs);
     
     this.processing.set(item.id, item);
     this.emit('itemProcessingStarted', { item });
@@ -129,7 +133,9 @@ export class TranscriptionQueue extends EventEmitter {
       this.lastProcessTime = Date.now();
 
       // Process transcription
+      const sttStartMs = traceNowMs();
       const result = await this.sttService.transcribe(item.segment);
+      traceSpan(item.segment.traceId, 'stt', 'main', sttStartMs);
       const processingTime = Date.now() - startTime;
 
       // Move to completed
@@ -156,6 +162,7 @@ export class TranscriptionQueue extends EventEmitter {
 
         // Add back to queue with delay
         setTimeout(() => {
+          item.queuedMs = traceNowMs();
           // Re-add to queue (maintain priority)
           const insertIndex = this.queue.findIndex(queueItem => queueItem.priority < item.priority);
           if (insertIndex === -1) {
@@ -0,0 +1,246 @@
+/**
+ * Transcripts of utterances heard before, found by the chunk's native audio
+ * fingerprint (one 32-bit Haitsma-Kalker word per frame, see AudioFingerprint.ts),
+ * so an intro, a jingle or a clip watched again skips STT even after a restart.
+ *
+ * Lookup is a bit-sampling LSH index: every INDEX_STRIDE-th word of a stored
+ * fingerprint is filed under TABLES keys, each made of KEY_BITS fixed bit
+ * positions of the word. A query files all of its words the same way, so the
+ * stored words are found whatever frame the chunk was cut at; entries that
+ * collect enough votes are then verified with the full bit error rate. The
+ * cache holds at most `capacity` entries (least recently used go first) and is
+ * saved to userData/utterance-cache.json.
+ */
+
+import { app } from 'electron';
+import * as fs from 'fs';
+import * as path from 'path';
+import { AudioFingerprintService } from './AudioFingerprint';
+
+export interface CachedUtterance {
+  text: string;
+  language: string;
+  duration?: number;
+}
+
+interface UtteranceEntry extends CachedUtterance {
+  id: number;
+  fingerprint: Uint32Array;
+  sourceLanguage: string; // the STT language setting it was transcribed with
+  usedAt: number;
+  hits: number;
+}
+
+interface PersistedEntry extends CachedUtterance {
+  fingerprint: string; // base64 of the little-endian words
+  sourceLanguage: string;
+  usedAt: number;
+  hits: number;
+}
+
+const FILE_VERSION = 1;
+const TABLES = 4;
+const KEY_BITS = 16;
+const INDEX_STRIDE = 4;
+const MIN_VOTES = 4;
+const MAX_CANDIDATES = 8;
+const SAVE_DELAY_MS = 5000;
+
+// KEY_BITS distinct bit positions per table, fixed so a saved cache keeps its keys
+const SAMPLED_BITS: number[][] = (() => {
+  let seed = 0x9e3779b9;
+  const tables: number[][] = [];
+  for (let t = 0; t < TABLES; t++) {
+    const bits: number[] = [];
+    while (bits.length < KEY_BITS) {
+      seed = (Math.imul(seed, 1664525) + 1013904223) >>> 0;
+      const bit = seed >>> 27;
+      if (!bits.includes(bit)) bits.push(bit);
+    }
+    tables.push(bits);
+  }
+  return tables;
+})();
+
+function wordKey(word: number, table: number): number {
+  let key = table << KEY_BITS;
+  const bits = SAMPLED_BITS[table];
+  for (let i = 0; i < KEY_BITS; i++) key |= ((word >>> bits[i]) & 1) << i;
+  return key;
+}
+
+export class UtteranceCache {
+  private static instance: UtteranceCache | null = null;
+
+  private entries = new Map<number, UtteranceEntry>(); // in use order, oldest first
+  private index = new Map<number, Set<number>>();
+  private nextId = 1;
+  private loaded = false;
+  private saveTimer: NodeJS.Timeout | null = null;
+
+  constructor(
+    private readonly filePath: string,
+    private readonly capacity: number = 400,
+    private readonly maxBitErrorRate: number = 0.2,
+    private readonly minFrames: number = 64,   // about 1.3 s of 20 ms VAD frames
+    private readonly maxFrames: number = 1500  // 30 s; longer chunks are not cached
+  ) {}
+
+  static getInstance(): UtteranceCache {
+    if (!UtteranceCache.instance) {
+      UtteranceCache.instance = new UtteranceCache(path.join(app.getPath('userData'), 'utterance-cache.json'));
+    }
+    return UtteranceCache.instance;
+  }
+
+  /** The transcript of a near-duplicate of fingerprint, or null. */
+  lookup(fingerprint: Uint32Array, sourceLanguage: string): CachedUtterance | null {
+    if (!this.cacheable(fingerprint)) return null;
+    this.load();
+
+    const votes = new Map<number, number>();
+    for (let i = 0; i < fingerprint.length; i++) {
+      const voted = new Set<number>(); // one vote per query word
+      for (let t = 0; t < TABLES; t++) {
+        const ids = this.index.get(wordKey(fingerprint[i], t));
+        if (!ids) continue;
+        for (const id of ids) {
+          if (voted.has(id)) continue;
+          voted.add(id);
+          votes.set(id, (votes.get(id) || 0) + 1);
+        }
+      }
+    }
+
+    const candidates = [...votes.entries()]
+      .filter(([, count]) => count >= MIN_VOTES)
+      .sort((a, b) => b[1] - a[1])
+      .slice(0, MAX_CANDIDATES);
+    for (const [id] of candidates) {
+      const entry = this.entries.get(id)!;
+      if (entry.sourceLanguage !== sourceLanguage) continue;
+      // A chunk that only contains (or extends) a cached one has a different transcript
+      const ratio = fingerprint.length / entry.fingerprint.length;
+      if (ratio < 0.85 || ratio > 1.15) continue;
+      if (AudioFingerprintService.fingerprintBitErrorRate(fingerprint, entry.fingerprint) > this.maxBitErrorRate) continue;
+      entry.usedAt = Date.now();
+      entry.hits++;
+      this.entries.delete(id);
+      this.entries.set(id, entry);
+      this.scheduleSave();
+      return { text: entry.text, language: entry.language, duration: entry.duration };
+    }
+    return null;
+  }
+
+  /** Caches the transcript of a chunk that went through STT. */
+  remember(fingerprint: Uint32Array, sourceLanguage: string, utterance: CachedUtterance): void {
+    if (!this.cacheable(fingerprint) || !utterance.text) return;
+    this.load();
+    this.insert({
+      ...utterance,
+      id: this.nextId++,
+      fingerprint: new Uint32Array(fingerprint),
+      sourceLanguage,
+      usedAt: Date.now(),
+      hits: 0
+    });
+    this.scheduleSave();
+  }
+
+  clear(): void {
+    this.entries.clear();
+    this.index.clear();
+    this.loaded = true;
+    this.scheduleSave();
+  }
+
+  getStats(): { entries: number; hits: number; indexKeys: number } {
+    let hits = 0;
+    for (const entry of this.entries.values()) hits += entry.hits;
+    return { entries: this.entries.size, hits, indexKeys: this.index.size };
+  }
+
+  private cacheable(fingerprint: Uint32Array | undefined): fingerprint is Uint32Array {
+    return !!fingerprint && fingerprint.length >= this.minFrames && fingerprint.length <= this.maxFrames;
+  }
+
+  private insert(entry: UtteranceEntry): void {
+    while (this.entries.size >= this.capacity) {
+      const oldest = this.entries.values().next().value as UtteranceEntry;
+      this.remove(oldest);
+    }
+    this.entries.set(entry.id, entry);
+    this.forEachKey(entry, key => {
+      let ids = this.index.get(key);
+      if (!ids) this.index.set(key, ids = new Set());
+      ids.add(entry.id);
+    });
+  }
+
+  private remove(entry: UtteranceEntry): void {
+    this.entries.delete(entry.id);
+    this.forEachKey(entry, key => {
+      const ids = this.index.get(key);
+      if (!ids) return;
+      ids.delete(entry.id);
+      if (ids.size === 0) this.index.delete(key);
+    });
+  }
+
+  private forEachKey(entry: UtteranceEntry, visit: (key: number) => void): void {
+    for (let i = 0; i < entry.fingerprint.length; i += INDEX_STRIDE) {
+      for (let t = 0; t < TABLES; t++) visit(wordKey(entry.fingerprint[i], t));
+    }
+  }
+
+  private load(): void {
+    if (this.loaded) return;
+    this.loaded = true;
+    try {
+      if (!fs.existsSync(this.filePath)) return;
+      const data = JSON.parse(fs.readFileSync(this.filePath, 'utf-8'));
+      if (data?.version !== FILE_VERSION || !Array.isArray(data.entries)) return;
+      const persisted = (data.entries as PersistedEntry[]).slice(-this.capacity);
+      for (const saved of persisted) {
+        const bytes = Buffer.from(saved.fingerprint, 'base64');
+        const fingerprint = new Uint32Array(bytes.length >>> 2);
+        for (let i = 0; i < fingerprint.length; i++) fingerprint[i] = bytes.readUInt32LE(i * 4);
+        if (!this.cacheable(fingerprint) || typeof saved.text !== 'string') continue;
+        this.insert({ ...saved, id: this.nextId++, fingerprint });
+      }
+      console.log(`[UtteranceCache] Loaded ${this.entries.size} cached utterances`);
+    } catch (error) {
+      console.warn('[UtteranceCache] Failed to load cache, starting empty:', error);
+    }
+  }
+
+  private scheduleSave(): void {
+    if (this.saveTimer) return;
+    this.saveTimer = setTimeout(() => {
+      this.saveTimer = null;
+      this.save().catch(error => console.warn('[UtteranceCache] Failed to save cache:', error));
+    }, SAVE_DELAY_MS);
+  }
+
+  private async save(): Promise<void> {
+    const entries: PersistedEntry[] = [];
+    for (const entry of this.entries.values()) {
+      const bytes = Buffer.alloc(entry.fingerprint.length * 4);
+      for (let i = 0; i < entry.fingerprint.length; i++) bytes.writeUInt32LE(entry.fingerprint[i], i * 4);
+      entries.push({
+        text: entry.text,
+        language: entry.language,
+        duration: entry.duration,
+        fingerprint: bytes.toString('base64'),
+        sourceLanguage: entry.sourceLanguage,
+        usedAt: entry.usedAt,
+        hits: entry.hits
+      });
+    }
+    // Written aside and renamed, so a crash mid-write keeps the previous file
+    const tempPath = `${this.filePath}.tmp`;
+    await fs.promises.writeFile(tempPath, JSON.stringify({ version: FILE_VERSION, entries }));
+    await fs.promises.rename(tempPath, this.filePath);
+  }
+}
@@ -5,9 +5,17 @@ import { ConfigurationManager } from './ConfigurationManager';
 import { ErrorReportingService } from './ErrorReportingService';
 import { ErrorCategory, ErrorSeverity } from '../types/ErrorTypes';
 import { BrowserWindow } from 'electron';
+import { reportUploadThroughput, uploadNativeTranscription } from '../ipc/handlers/wasapi-handlers';
+
+// Whisper endpoints pick the decoder from the file extension
+export function uploadFileName(audio: Blob): string {
+  if (audio.type === 'audio/ogg') return 'audio.ogg';
+  if (audio.type === 'audio/flac') return 'audio.flac';
+  return 'audio.wav';
+}
 
 export interface WhisperTranscriptionRequest {
-  audio: Blob;
+  audio: Blob; // WAV, or Ogg-Opus ('audio/ogg') / FLAC ('audio/flac') from the addon's encodeOpus() / encodeFlac()
   model?: string;
   language?: string;
   prompt?: string;
@@ -104,7 +112,7 @@ export class WhisperApiClient {
     try {
       // Prepare form data for managed API
       const formData = new FormData();
-      formData.append('file', request.audio, 'audio.wav');
+      formData.append('file', request.audio, uploadFileName(request.audio));
       formData.append('model', request.model || this.config.model);
       
       if (request.language) {
@@ -171,7 +179,7 @@ export class WhisperApiClient {
     }
 
     const formData = new FormData();
-    formData.append('file', request.audio, 'audio.wav');
+    formData.append('file', request.audio, uploadFileName(request.audio));
     formData.append('model', request.model || this.config.model);
     
     if (request.language) {
@@ -194,12 +202,36 @@ export class WhisperApiClient {
       signal: AbortSignal.timeout(this.config.timeout)
     };
 
+    // The same form posted by the addon off the JS thread; fetch when the addon lacks it
+    const fileBytes = Buffer.from(await request.audio.arrayBuffer());
+    const nativeUpload = () => uploadNativeTranscription(fileBytes, {
+      baseUrl: this.config.baseUrl,
+      apiKey,
+      model: request.model || this.config.model,
+      language: request.language,
+      prompt: request.prompt,
+      responseFormat: request.response_format || 'verbose_json',
+      temperature: request.temperature ?? this.config.temperature,
+      timeoutMs: this.config.timeout
+    }, uploadFileName(request.audio), request.audio.type || 'audio/wav');
+
     let lastError: Error | null = null;
     
     for (let attempt = 1; attempt <= this.config.maxRetries; attempt++) {
       try {
-        const response = await fetch(`${this.config.baseUrl}/audio/transcriptions`, requestOptions);
+        const startedAt = Date.now();
+        const uploaded = await nativeUpload();
+        const response = uploaded
+          ? new Response(uploaded.body, { status: uploaded.status })
+          : await fetch(`${this.config.baseUrl}/audio/transcriptions`, requestOptions);
         
+        if (response.ok && !uploaded) {
+          // The network's share of the request, for the native Opus bitrate picks
+          const processingMs = Number(response.headers.get('openai-processing-ms'));
+          const networkMs = Date.now() - startedAt - (Number.isFinite(processingMs) ? processingMs : 0);
+          reportUploadThroughput(request.audio.size, networkMs);
+        }
+
         if (!response.ok) {
           const errorData = await response.json().catch(() => ({}));
           const errorMessage = errorData.error?.message || response.statusText;
@@ -1,5 +1,6 @@
 import { EventEmitter } from 'events';
 import { AudioSegment } from '../interfaces/AudioCaptureService';
+import { getNativeDsp } from '../ipc/handlers/wasapi-handlers';
 
 export interface AudioConditioningConfig {
   // Sample rate and format
@@ -85,18 +86,39 @@ export class WhisperAudioConditioner extends EventEmitter {
   }
 
   async processAudioSegment(segment: AudioSegment): Promise<ConditionedAudio | null> {
+    // The addon already filtered, gated, normalized and limited native segments
+    if (segment.loudness && segment.sampleRate === this.config.targetSampleRate && segment.channelCount === 1) {
+      return this.finishChunk(segment.data, segment.loudness.lufs, segment.loudness.peakDb);
+    }
+
     // Step 1: Resample to 16kHz mono if needed
     let processedAudio = this.resampleToTarget(segment.data, segment.sampleRate, segment.channelCount);
     
-    // Step 2: Apply high-pass filter (remove rumble)
-    processedAudio = this.applyHighPassFilter(processedAudio, this.config.targetSampleRate);
-    
-    // Step 3: Apply low-pass filter (remove hiss)
-    processedAudio = this.applyLowPassFilter(processedAudio, this.config.targetSampleRate);
-    
-    // Step 4: Calculate LUFS and peak levels
-    const lufs = this.calculateLUFS(processedAudio, this.config.targetSampleRate);
-    const peakLevel = this.calculatePeakLevel(processedAudio);
+    let lufs: number;
+    let peakLevel: number;
+    const dsp = getNativeDsp();
+    if (dsp) {
+      // Steps 2-4 in the addon, in place on a copy the caller doesn't see
+      if (processedAudio === segment.data) processedAudio = processedAudio.slice();
+      dsp.filter(processedAudio, {
+        sampleRate: this.config.targetSampleRate,
+        highPassHz: this.config.highPassFreq,
+        lowPassHz: this.config.lowPassFreq
+      });
+      const levels = dsp.measure(processedAudio);
+      lufs = -0.691 + 10 * Math.log10(levels.rms + 1e-10); // same approximation as calculateLUFS
+      peakLevel = 20 * Math.log10(levels.peak + 1e-10);
+    } else {
+      // Step 2: Apply high-pass filter (remove rumble)
+      processedAudio = this.applyHighPassFilter(processedAudio, this.config.targetSampleRate);
+      
+      // Step 3: Apply low-pass filter (remove hiss)
+      processedAudio = this.applyLowPassFilter(processedAudio, this.config.targetSampleRate);
+      
+      // Step 4: Calculate LUFS and peak levels
+      lufs = this.calculateLUFS(processedAudio, this.config.targetSampleRate);
+      peakLevel = this.calculatePeakLevel(processedAudio);
+    }
     
     // Step 5: Apply noise gate
     const gatedAudio = this.applyNoiseGate(processedAudio, lufs);
@@ -150,6 +172,13 @@ export class WhisperAudioConditioner extends EventEmitter {
   private resample(data: Float32Array, sourceRate: number, targetRate: number): Float32Array {
     if (sourceRate === targetRate) return data;
     
+    const dsp = getNativeDsp();
+    if (dsp) {
+      const resampled = new Float32Array(Math.floor(data.length * targetRate / sourceRate));
+      dsp.resample(data, resampled, { inRate: sourceRate, outRate: targetRate });
+      return resampled;
+    }
+    
     const ratio = sourceRate / targetRate;
     const outputLength = Math.floor(data.length / ratio);
     const output = new Float32Array(outputLength);
@@ -322,19 +351,24 @@ export class WhisperAudioConditioner extends EventEmitter {
       offset += chunk.length;
     }
     
+    // Clear buffer
+    this.audioBuffer = [];
+    this.bufferStartTime = 0;
+    
     // Analyze the combined audio
     const lufs = this.calculateLUFS(combinedAudio, this.config.targetSampleRate);
     const peakLevel = this.calculatePeakLevel(combinedAudio);
+    return this.finishChunk(combinedAudio, lufs, peakLevel);
+  }
+
+  private finishChunk(combinedAudio: Float32Array, lufs: number, peakLevel: number): ConditionedAudio {
+    const duration = (combinedAudio.length / this.config.targetSampleRate) * 1000; // ms
     const containsSpeech = this.detectSpeech(combinedAudio, lufs);
     const isClean = this.isAudioClean(combinedAudio, lufs, peakLevel);
     
     // Determine if this should go to Whisper
     const shouldSendToWhisper = this.shouldSendToWhisper(containsSpeech, isClean, lufs, duration);
     
-    // Clear buffer
-    this.audioBuffer = [];
-    this.bufferStartTime = 0;
-    
     const result: ConditionedAudio = {
       audioData: combinedAudio,
       sampleRate: this.config.targetSampleRate,
@@ -0,0 +1,180 @@
+/**
+ * Picks the device and the model file the native Whisper engine runs, from a
+ * benchmark on this machine. Candidates are the configured model, then its
+ * quantized files (ggml-<model>-q8_0.bin, -q5_1, -q5_0, -q4_0 from
+ * whisper.cpp's quantize tool), then the smaller models likewise, as far as
+ * they're installed. Each is timed on every ggml device in the build (CPU,
+ * CUDA, Vulkan, Metal) that has the memory for it (free RAM for the CPU, VRAM
+ * for a GPU), in that order, until one meets the real-time target. Results
+ * persist in uiSettings.whisperBackend with a fingerprint of the CPU and
+ * devices, so the benchmark runs once per machine (again after a GPU or
+ * driver change).
+ *
+ * The benchmark runs from the background prewarm at app start; until it has,
+ * loads use the engine's default (the first GPU, else the CPU).
+ */
+
+import * as fs from 'fs';
+import * as os from 'os';
+import { ConfigurationManager } from './ConfigurationManager';
+import type { NativeWhisper, WhisperBackend } from '../ipc/handlers/wasapi-handlers';
+
+// Processing time over audio time a model must reach to be kept: half real
+// time leaves room for the rest of the pipeline and a busy machine
+const DEFAULT_TARGET_RTF = 0.5;
+
+// Smallest to largest; a benchmark only walks down from the configured model
+const MODEL_SIZES = ['tiny', 'base', 'small', 'medium', 'large', 'large-v2', 'large-v3'];
+
+// File suffixes of a model's variants, most precise first
+const QUANTIZATIONS = ['', '-q8_0', '-q5_1', '-q5_0', '-q4_0'];
+
+// Weights plus the decoder states and compute buffers, relative to the file
+const MEMORY_OVERHEAD = 1.3;
+
+interface WhisperBackendSettings {
+  targetRtf?: number;
+  autoModel?: boolean; // use a smaller model when the configured one misses the target (default true)
+  fingerprint?: string;
+  measuredAt?: string;
+  results?: Record<string, Record<string, number>>; // model variant -> device -> rtf
+}
+
+export interface WhisperBackendChoice {
+  model: string; // the configured model, or the variant ('small-q5_1') or smaller model to use instead
+  device?: string; // undefined: the engine's default
+  rtf?: number;
+}
+
+export class WhisperBackendSelector {
+  private benchmarks = new Map<string, Promise<void>>(); // configured model -> measured
+
+  constructor(private modelFile: (model: string) => string) {}
+
+  /**
+   * The measured choice for a configured model: the first candidate to meet
+   * the target, else the fastest one measured. Until measured, the most
+   * precise installed variant of the model that fits in free RAM.
+   */
+  choose(model: string): WhisperBackendChoice {
+    const settings = this.settings();
+    const target = settings?.targetRtf ?? DEFAULT_TARGET_RTF;
+    const measured = this.candidates(model, settings?.autoModel !== false)
+      .map(name => this.fastest(name))
+      .filter((choice): choice is Required<WhisperBackendChoice> => choice !== null);
+    const fastest = measured.slice().sort((a, b) => a.rtf - b.rtf)[0];
+    return measured.find(choice => choice.rtf <= target) ?? fastest ?? { model: this.variantWithRoom(model) };
+  }
+
+  /** The fastest measured device for exactly this model, if any */
+  device(model: string): string | undefined {
+    return this.fastest(model)?.device;
+  }
+
+  /**
+   * Benchmark unless this machine already has results; resolves once they're
+   * saved (or the benchmark couldn't run).
+   */
+  ensureMeasured(engine: NativeWhisper, model: string): Promise<void> {
+    let benchmark = this.benchmarks.get(model);
+    if (!benchmark) {
+      benchmark = this.measure(engine, model).catch((error) => {
+        console.warn('Whisper backend benchmark failed:', error instanceof Error ? error.message : error);
+      });
+      this.benchmarks.set(model, benchmark);
+    }
+    return benchmark;
+  }
+
+  private async measure(engine: NativeWhisper, model: string): Promise<void> {
+    const backends = await engine.backends();
+    if (backends.length === 0) return;
+    const fingerprint = this.fingerprint(backends);
+    const settings = this.settings() ?? {};
+    const candidates = this.candidates(model, settings.autoModel !== false);
+    if (settings.fingerprint === fingerprint && candidates.some(name => settings.results?.[name])) return;
+
+    const target = settings.targetRtf ?? DEFAULT_TARGET_RTF;
+    const results: Record<string, Record<string, number>> = {};
+    for (const name of candidates) {
+      const file = this.modelFile(name);
+      if (!fs.existsSync(file)) continue;
+      const devices = this.devicesWithRoom(backends, fs.statSync(file).size / (1024 * 1024));
+      if (devices.length === 0) {
+        console.log(`Whisper benchmark: ${name} doesn't fit in memory on any device`);
+        continue;
+      }
+      const rows = await engine.benchmark(file, { devices });
+      const measured: Record<string, number> = {};
+      for (const row of rows) {
+        if (row.ok) measured[row.device] = Number(row.rtf.toFixed(3));
+        else console.warn(`Whisper benchmark: ${name} on ${row.device} (${row.backend}) failed: ${row.error}`);
+      }
+      if (Object.keys(measured).length === 0) continue;
+      results[name] = measured;
+      console.log(`Whisper benchmark: ${name} ${Object.entries(measured).map(([d, rtf]) => `${d} rtf ${rtf}`).join(', ')}`);
+      if (Object.values(measured).some(rtf => rtf <= target)) break;
+    }
+    if (Object.keys(results).length === 0) return;
+    ConfigurationManager.getInstance().setValue('uiSettings.whisperBackend', {
+      ...settings,
+      fingerprint,
+      measuredAt: new Date().toISOString(),
+      results
+    });
+  }
+
+  private fastest(model: string): Required<WhisperBackendChoice> | null {
+    const devices = this.settings()?.results?.[model];
+    const [device, rtf] = Object.entries(devices ?? {}).sort((a, b) => a[1] - b[1])[0] ?? [];
+    return device === undefined || rtf === undefined ? null : { model, device, rtf };
+  }
+
+  // The model's variants, then (with autoModel) each smaller model's, in the
+  // order they're tried
+  private candidates(model: string, smaller: boolean): string[] {
+    const models = smaller ? [model, ...this.smallerModels(model)] : [model];
+    return models.flatMap(name => QUANTIZATIONS.map(suffix => name + suffix));
+  }
+
+  // Devices with memory for a file of this size: VRAM for a GPU, free RAM
+  // for the CPU
+  private devicesWithRoom(backends: WhisperBackend[], fileMb: number): string[] {
+    const needMb = fileMb * MEMORY_OVERHEAD;
+    return backends
+      .filter(b => (b.gpu && b.memoryMb > 0 ? b.memoryMb * 0.8 : this.freeRamMb()) >= needMb)
+      .map(b => b.device);
+  }
+
+  private variantWithRoom(model: string): string {
+    for (const name of this.candidates(model, false)) {
+      const file = this.modelFile(name);
+      if (fs.existsSync(file) && (fs.statSync(file).size / (1024 * 1024)) * MEMORY_OVERHEAD <= this.freeRamMb()) return name;
+    }
+    return model;
+  }
+
+  // What a model may take of RAM: what's free now, at most half of it all
+  private freeRamMb(): number {
+    return Math.min(os.freemem(), os.totalmem() / 2) / (1024 * 1024);
+  }
+
+  private smallerModels(model: string): string[] {
+    const index = MODEL_SIZES.indexOf(model.replace(/\.en$/, ''));
+    const suffix = model.endsWith('.en') ? '.en' : '';
+    return index <= 0 ? [] : MODEL_SIZES.slice(0, index).reverse()
+      .filter(name => !name.startsWith('large'))
+      .map(name => name + suffix);
+  }
+
+  // CPU model and thread count plus every device's description: a new GPU,
+  // driver or backend DLL set re-runs the benchmark
+  private fingerprint(backends: WhisperBackend[]): string {
+    const cpus = os.cpus();
+    return [`${cpus[0]?.model ?? 'cpu'} x${cpus.length}`, ...backends.map(b => `${b.device}=${b.backend}:${b.description}`)].join('|');
+  }
+
+  private settings(): WhisperBackendSettings | undefined {
+    return ConfigurationManager.getInstance().getValue<WhisperBackendSettings>('uiSettings.whisperBackend');
+  }
+}
@@ -1,5 +1,5 @@
 import { EventEmitter } from 'events';
-import { AudioSegment } from '../interfaces/AudioCaptureService';
+import { AudioFeatures, AudioSegment } from '../interfaces/AudioCaptureService';
 
 export interface WhisperPreFilterConfig {
   // Voice characteristics validation
@@ -59,16 +59,15 @@ export class WhisperPreFilter extends EventEmitter {
   }
 
   analyzeAudio(segment: AudioSegment): AudioAnalysis {
-    const data = segment.data;
-    const sampleRate = segment.sampleRate;
-
-    // Perform comprehensive audio analysis
-    const dominantFrequency = this.findDominantFrequency(data, sampleRate);
-    const harmonicContent = this.calculateHarmonicContent(data, sampleRate);
-    const modulationDepth = this.calculateModulationDepth(data);
-    const zeroCrossingRate = this.calculateZeroCrossingRate(data);
-    const spectralFlatness = this.calculateSpectralFlatness(data);
-    const noiseRatio = this.estimateNoiseRatio(data);
+    // Features from the native chunker make this O(1); otherwise scan the samples
+    const {
+      dominantFrequency,
+      harmonicContent,
+      modulationDepth,
+      zeroCrossingRate,
+      spectralFlatness,
+      noiseRatio
+    } = segment.features ? this.gateFeatures(segment.features) : this.extractFeatures(segment.data, segment.sampleRate);
 
     // Determine if this looks like voice
     const isVoiceLike = this.isVoiceLikeSignal(
@@ -126,6 +125,25 @@ export class WhisperPreFilter extends EventEmitter {
     return analysis;
   }
 
+  private extractFeatures(data: Float32Array, sampleRate: number): AudioFeatures {
+    return {
+      dominantFrequency: this.findDominantFrequency(data, sampleRate),
+      harmonicContent: this.calculateHarmonicContent(data, sampleRate),
+      modulationDepth: this.calculateModulationDepth(data),
+      zeroCrossingRate: this.calculateZeroCrossingRate(data),
+      spectralFlatness: this.calculateSpectralFlatness(data),
+      noiseRatio: this.estimateNoiseRatio(data)
+    };
+  }
+
+  // Native harmonic content is measured for any fundamental; apply the same
+  // voice-range gate as calculateHarmonicContent
+  private gateFeatures(features: AudioFeatures): AudioFeatures {
+    const f0 = features.dominantFrequency;
+    const inRange = f0 >= this.config.voiceFreqMin && f0 <= this.config.voiceFreqMax;
+    return inRange ? features : { ...features, harmonicContent: 0 };
+  }
+
   private findDominantFrequency(data: Float32Array, sampleRate: number): number {
     // Simple frequency analysis using autocorrelation
     const maxLag = Math.min(Math.floor(sampleRate / 50), data.length / 2); // 50Hz minimum
@@ -0,0 +1,175 @@
+import { spawn, ChildProcess } from 'child_process';
+import * as path from 'path';
+import * as fs from 'fs';
+import { openNativeAudioRing, NativeAudioRing } from '../ipc/handlers/wasapi-handlers';
+
+interface PendingChunk {
+  resolve: (result: { text: string; language?: string; processingMs?: number }) => void;
+  reject: (error: Error) => void;
+  timer: NodeJS.Timeout;
+}
+
+/**
+ * Long-lived faster-whisper worker fed through the addon's shared-memory audio
+ * ring: the model loads once per (model, language) and each chunk costs a
+ * memcpy plus a doorbell instead of a temp WAV and a Python spawn. Results come
+ * back as JSON lines on the worker's stdout, matched to chunks by seq.
+ */
+export class WhisperRingWorker {
+  private ring: NativeAudioRing | null = null;
+  private process: ChildProcess | null = null;
+  private starting: Promise<boolean> | null = null;
+  private pending = new Map<number, PendingChunk>();
+  private model = '';
+  private language = '';
+
+  constructor(
+    private readonly pythonExe: string,
+    private readonly whisperPath: string,
+    private readonly env: Record<string, string>
+  ) {}
+
+  /**
+   * Locate whisper_worker.py - packaged (ASAR unpacked) paths first
+   */
+  static findWorkerScript(): string | null {
+    const candidates = [
+      path.join(process.resourcesPath || '', 'app.asar.unpacked', 'dist', 'whisper', 'whisper_worker.py'),
+      path.join(process.resourcesPath || '', 'app', 'dist', 'whisper', 'whisper_worker.py'),
+      path.join(__dirname, '..', 'whisper', 'whisper_worker.py'),
+      path.join(process.cwd(), 'dist', 'whisper', 'whisper_worker.py'),
+      path.join(process.cwd(), 'src', 'whisper', 'whisper_worker.py')
+    ];
+    return candidates.find((p) => fs.existsSync(p)) || null;
+  }
+
+  /**
+   * Make sure a worker for model/language is running; false when the ring or
+   * the worker can't be brought up (callers fall back to one-shot Python).
+   */
+  async ensure(model: string, language: string): Promise<boolean> {
+    if (this.process && this.model === model && this.language === language) return true;
+    if (this.starting && this.model === model && this.language === language) return this.starting;
+    this.stop();
+    this.model = model;
+    this.language = language;
+    this.starting = this.start().finally(() => { this.starting = null; });
+    return this.starting;
+  }
+
+  /**
+   * Transcribe a 16 kHz pcm16 WAV chunk
+   */
+  transcribe(wav: Buffer, timeoutMs: number = 60000): Promise<{ text: string; language?: string; processingMs?: number }> {
+    if (!this.ring || !this.process) return Promise.reject(new Error('Whisper worker not running'));
+    const seq = this.ring.write(wav);
+    if (seq < 0) return Promise.reject(new Error('Whisper worker is behind; audio ring full'));
+    return new Promise((resolve, reject) => {
+      const timer = setTimeout(() => {
+        this.pending.delete(seq);
+        reject(new Error('Whisper transcription timeout'));
+      }, timeoutMs);
+      this.pending.set(seq, { resolve, reject, timer });
+    });
+  }
+
+  stop(): void {
+    const child = this.process;
+    this.process = null;
+    if (child && !child.killed) {
+      child.stdin?.end(); // the worker exits on stdin EOF
+      setTimeout(() => { if (child.exitCode === null) child.kill(); }, 2000);
+    }
+    if (this.ring) {
+      this.ring.close();
+      this.ring = null;
+    }
+    this.failPending(new Error('Whisper worker stopped'));
+  }
+
+  private start(): Promise<boolean> {
+    const script = WhisperRingWorker.findWorkerScript();
+    if (!script) return Promise.resolve(false);
+    const ring = openNativeAudioRing('whisper', { capacityKb: 4096, sampleRate: 16000 });
+    if (!ring) return Promise.resolve(false);
+    this.ring = ring;
+
+    console.log(`🚀 Starting persistent Whisper worker (model=${this.model}, language=${this.language})...`);
+    const child = spawn(this.pythonExe, [
+      script,
+      '--mapping', ring.mapping,
+      '--doorbell', ring.doorbell,
+      '--model', this.model,
+      '--language', this.language,
+      '--whisper-path', this.whisperPath
+    ], {
+      stdio: ['pipe', 'pipe', 'pipe'],
+      env: { ...this.env, PYTHONPATH: this.whisperPath, PYTHONIOENCODING: 'utf-8', PYTHONUTF8: '1' }
+    });
+    this.process = child;
+
+    return new Promise<boolean>((resolve) => {
+      let ready = false;
+      let buffer = '';
+      child.stdout!.on('data', (data: Buffer) => {
+        buffer += data.toString();
+        const lines = buffer.split('\n');
+        buffer = lines.pop() || '';
+        for (const line of lines) {
+          if (!line.trim()) continue;
+          let message: any;
+          try {
+            message = JSON.parse(line.trim());
+          } catch (e) {
+            continue; // stray library output
+          }
+          if (message.ready) {
+            ready = true;
+            console.log('✅ Persistent Whisper worker ready');
+            resolve(true);
+          } else if (typeof message.seq === 'number') {
+            this.settle(message);
+          } else if (message.error && !ready) {
+            console.warn('Whisper worker failed to start:', message.error);
+          }
+        }
+      });
+      child.stderr!.on('data', (data: Buffer) => {
+        console.log('🔍 Whisper worker stderr:', data.toString().trim());
+      });
+      child.on('close', (code: number) => {
+        console.log(`Persistent Whisper worker exited with code ${code}`);
+        if (this.process === child) {
+          this.process = null;
+          if (this.ring === ring) {
+            ring.close();
+            this.ring = null;
+          }
+          this.failPending(new Error('Whisper worker exited'));
+        }
+        if (!ready) resolve(false);
+      });
+      child.on('error', (error: Error) => {
+        console.warn('Failed to start Whisper worker:', error.message);
+        if (!ready) resolve(false);
+      });
+    });
+  }
+
+  private settle(message: { seq: number; text?: string; language?: string; processingMs?: number; error?: string }): void {
+    const entry = this.pending.get(message.seq);
+    if (!entry) return;
+    this.pending.delete(message.seq);
+    clearTimeout(entry.timer);
+    if (message.error) entry.reject(new Error(message.error));
+    else entry.resolve({ text: message.text || '', language: message.language, processingMs: message.processingMs });
+  }
+
+  private failPending(error: Error): void {
+    for (const entry of this.pending.values()) {
+      clearTimeout(entry.timer);
+      entry.reject(error);
+    }
+    this.pending.clear();
+  }
+}
@@ -4,7 +4,7 @@ import { BackendConfig } from './OpenSourceConfig';
 /**
  * WebSocket message types
  */
-export type WebSocketMessageType = 'transcribe' | 'translate' | 'tts' | 'chat';
+export type WebSocketMessageType = 'transcribe' | 'transcribe-stream' | 'translate' | 'tts' | 'chat';
 
 /**
  * WebSocket request message
@@ -34,6 +34,16 @@ interface PendingRequest {
   timeout: NodeJS.Timeout;
 }
 
+/**
+ * An utterance uploaded while it is still being spoken (openTranscriptionStream)
+ */
+export interface TranscriptionStream {
+  readonly id: string;
+  push(audio: Uint8Array): void;
+  finish(): Promise<any>; // resolves with the transcript, as transcribe() does
+  abort(): void;
+}
+
 /**
  * WebSocket connection state
  */
@@ -346,6 +356,69 @@ export class WhispraWebSocketClient {
     });
   }
 
+  /**
+   * Transcribe audio that is still arriving: one 'transcribe-stream' request
+   * whose messages share an id - phase 'open' with the format, a 'data' per
+   * push() in order, then 'end' (answered like 'transcribe') or 'abort'.
+   * format 'ogg' is one Ogg-Opus file split at page boundaries; 'pcm16' is raw
+   * little-endian samples at sampleRate.
+   */
+  public openTranscriptionStream(options: {
+    format: 'ogg' | 'pcm16';
+    sampleRate: number;
+    model?: string;
+    language?: string;
+  }): TranscriptionStream {
+    if (!this.isConnected()) {
+      throw new Error('WebSocket not connected');
+    }
+    const id = `${Date.now()}-${Math.random().toString(36).substr(2, 9)}`;
+    let seq = 0;
+    let closed = false;
+    const send = (data: any): void => {
+      const request: WebSocketRequest = { id, type: 'transcribe-stream', data };
+      this.ws!.send(JSON.stringify(request));
+    };
+    send({
+      phase: 'open',
+      format: options.format,
+      sampleRate: options.sampleRate,
+      model: options.model || 'whisper-1',
+      language: options.language
+    });
+    return {
+      id,
+      push: (audio: Uint8Array) => {
+        if (closed || !this.isConnected()) return;
+        send({ phase: 'data', seq: seq++, audio: Buffer.from(audio.buffer, audio.byteOffset, audio.byteLength).toString('base64') });
+      },
+      finish: () => {
+        if (closed) return Promise.reject(new Error('Transcription stream closed'));
+        closed = true;
+        if (!this.isConnected()) return Promise.reject(new Error('WebSocket not connected'));
+        return new Promise((resolve, reject) => {
+          const timeout = setTimeout(() => {
+            this.pendingRequests.delete(id);
+            reject(new Error('Request timeout'));
+          }, this.requestTimeout);
+          this.pendingRequests.set(id, { resolve, reject, timeout });
+          try {
+            send({ phase: 'end' });
+          } catch (error) {
+            clearTimeout(timeout);
+            this.pendingRequests.delete(id);
+            reject(error);
+          }
+        });
+      },
+      abort: () => {
+        if (closed) return;
+        closed = true;
+        if (this.isConnected()) send({ phase: 'abort' });
+      }
+    };
+  }
+
   /**
    * Translate text through WebSocket
    */
@@ -1,12 +1,16 @@
 import { EventEmitter } from 'events';
+import * as fs from 'fs';
 import { SoundEntry, SoundboardConfig, SoundboardSettings, SoundboardEvents, SoundboardError } from './types';
 import { SoundboardConfigManager } from './SoundboardConfigManager';
 import { SoundboardFileManager } from './SoundboardFileManager';
+import type { NativeSoundboard } from '../ipc/handlers/wasapi-handlers';
 
 export class SoundboardBackendService extends EventEmitter {
   private configManager: SoundboardConfigManager;
   private fileManager: SoundboardFileManager;
   private isInitialized: boolean = false;
+  private native: NativeSoundboard | null = null;
+  private nativeCacheDir = '';
 
   constructor() {
     super();
@@ -30,6 +34,71 @@ export class SoundboardBackendService extends EventEmitter {
     }
   }
 
+  // Plays through the audio addon's soundboard engine from now on, if it can
+  // open the virtual mic output. Clips load one at a time in the background:
+  // cached ones are only mapped, new ones decode once on the addon's threadpool.
+  async attachNativeEngine(engine: NativeSoundboard, cacheDir: string): Promise<void> {
+    let outputs: { mic: string | null; monitor: string | null };
+    try {
+      outputs = engine.startOutput();
+    } catch (error) {
+      console.warn('[Soundboard] Native output failed to start:', error);
+      return;
+    }
+    if (!outputs.mic) {
+      console.warn('[Soundboard] No virtual mic device for native playback; the renderer keeps playing clips');
+      engine.stopOutput();
+      return;
+    }
+    await fs.promises.mkdir(cacheDir, { recursive: true });
+    this.native = engine;
+    this.nativeCacheDir = cacheDir;
+    this.fileManager.setProbe((filePath) => engine.probe(filePath));
+    const settings = this.getSettings();
+    engine.setVolumes({ mic: settings.masterVolume, monitor: settings.headphonesVolume });
+    console.log(`[Soundboard] Native playback on ${outputs.mic}${outputs.monitor ? ` + ${outputs.monitor}` : ''}`);
+    void this.preloadNativeClips();
+  }
+
+  private async preloadNativeClips(): Promise<void> {
+    for (const sound of this.getAllSounds()) await this.loadNativeClip(sound);
+  }
+
+  private async loadNativeClip(sound: SoundEntry): Promise<boolean> {
+    if (!this.native) return false;
+    try {
+      const clip = await this.native.load(sound.id, sound.path, this.nativeCacheDir);
+      if (sound.duration === undefined) sound.duration = clip.durationMs / 1000;
+      return true;
+    } catch (error) {
+      console.warn(`[Soundboard] Native load failed for ${sound.path}:`, error);
+      return false;
+    }
+  }
+
+  // True when the native engine took the trigger; false leaves playback to the renderer
+  playNative(slot: number): boolean {
+    const sound = this.getSoundBySlot(slot);
+    if (!this.native || !sound) return false;
+    if (!this.getSettings().polyphonyMode) this.native.stop();
+    return this.native.play(sound.id);
+  }
+
+  stopNative(slot?: number): void {
+    if (!this.native) return;
+    if (slot === undefined) {
+      this.native.stop();
+      return;
+    }
+    const sound = this.getSoundBySlot(slot);
+    if (sound) this.native.stop(sound.id);
+  }
+
+  isPlayingNative(slot: number): boolean {
+    const sound = this.getSoundBySlot(slot);
+    return !!this.native && !!sound && this.native.isPlaying(sound.id);
+  }
+
   async addSound(filePath: string, slot: number): Promise<SoundEntry> {
     if (!this.isInitialized) {
       throw new Error('Soundboard backend not initialized');
@@ -65,6 +134,7 @@ export class SoundboardBackendService extends EventEmitter {
         addedAt: Date.now(),
         slot
       };
+      await this.loadNativeClip(soundEntry);
 
       // Add to config
       this.configManager.addSound(soundEntry);
@@ -87,6 +157,8 @@ export class SoundboardBackendService extends EventEmitter {
     const sound = this.getSoundBySlot(slot);
     if (!sound) return;
 
+    this.native?.unload(sound.id);
+
     // Remove from config
     this.configManager.removeSound(sound.id);
     await this.configManager.saveConfig();
@@ -133,6 +205,8 @@ export class SoundboardBackendService extends EventEmitter {
       this.emit(SoundboardEvents.DEVICE_CHANGED, settings.outputDevice);
     }
 
+    this.native?.setVolumes({ mic: settings.masterVolume, monitor: settings.headphonesVolume });
+
     if (settings.masterVolume !== undefined) {
       this.emit(SoundboardEvents.VOLUME_CHANGED, settings.masterVolume);
     }
@@ -8,8 +8,16 @@ export interface AudioMetadata {
   channels?: number;
 }
 
+// Native libavformat probe (the audio addon's probeSoundClip)
+export type MetadataProbe = (filePath: string) => Promise<{ durationMs: number; format: string; sampleRate: number; channels: number }>;
+
 export class SoundboardFileManager {
   private supportedFormats = ['.mp3', '.wav', '.ogg', '.aac', '.flac', '.m4a'];
+  private probe: MetadataProbe | null = null;
+
+  setProbe(probe: MetadataProbe): void {
+    this.probe = probe;
+  }
 
   async validateAudioFile(filePath: string): Promise<boolean> {
     try {
@@ -57,9 +65,21 @@ export class SoundboardFileManager {
   }
 
   async extractMetadata(filePath: string): Promise<AudioMetadata> {
+    if (this.probe) {
+      try {
+        const info = await this.probe(filePath);
+        return {
+          format: this.getFileExtension(filePath),
+          duration: info.durationMs > 0 ? info.durationMs / 1000 : undefined,
+          sampleRate: info.sampleRate,
+          channels: info.channels
+        };
+      } catch (error) {
+        console.warn('Native metadata probe failed:', error);
+      }
+    }
     try {
-      // For now, we'll use basic file system info
-      // In a full implementation, you might use a library like node-ffmpeg or music-metadata
+      // Without the native probe, basic file system info only
       const stats = await fs.promises.stat(filePath);
       
       return {
@@ -1,12 +1,16 @@
-import { ipcMain, dialog, IpcMainInvokeEvent } from 'electron';
+import { app, ipcMain, dialog, IpcMainInvokeEvent } from 'electron';
+import * as path from 'path';
 import { SoundboardBackendService } from './SoundboardBackendService';
 import { SoundEntry, SoundboardSettings } from './types';
+import { getNativeSoundboard } from '../ipc/handlers/wasapi-handlers';
 
 let soundboardService: SoundboardBackendService | null = null;
 
 export async function initializeSoundboardIPC(): Promise<void> {
   soundboardService = new SoundboardBackendService();
   await soundboardService.initialize();
+  const native = getNativeSoundboard();
+  if (native) await soundboardService.attachNativeEngine(native, path.join(app.getPath('userData'), 'soundboard-cache'));
 
   // Sound management
   ipcMain.handle('soundboard:add-sound', async (event: IpcMainInvokeEvent, filePath: string, slot: number) => {
@@ -39,26 +43,26 @@ export async function initializeSoundboardIPC(): Promise<void> {
     return soundboardService.getSoundBySlot(slot);
   });
 
-  // Playback controls - these will be handled in the renderer process
+  // Playback controls - the native engine plays when it's running (native: true),
+  // otherwise the renderer plays the returned sound itself
   ipcMain.handle('soundboard:play-sound', async (event: IpcMainInvokeEvent, slot: number) => {
-    // Just return the sound data, actual playback happens in renderer
     if (!soundboardService) throw new Error('Soundboard service not initialized');
-    return soundboardService.getSoundBySlot(slot);
+    const sound = soundboardService.getSoundBySlot(slot);
+    return sound && { ...sound, native: soundboardService.playNative(slot) };
   });
 
   ipcMain.handle('soundboard:stop-sound', async (event: IpcMainInvokeEvent, slot: number) => {
-    // Playback control handled in renderer
+    soundboardService?.stopNative(slot);
     return { success: true };
   });
 
   ipcMain.handle('soundboard:stop-all-sounds', async (event: IpcMainInvokeEvent) => {
-    // Playback control handled in renderer
+    soundboardService?.stopNative();
     return { success: true };
   });
 
   ipcMain.handle('soundboard:is-playing', async (event: IpcMainInvokeEvent, slot: number) => {
-    // Playback state handled in renderer
-    return false;
+    return soundboardService?.isPlayingNative(slot) ?? false;
   });
 
   // Settings management
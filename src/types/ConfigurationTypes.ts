@@ -130,6 +130,81 @@ export interface UISettings {
   uiLanguage: string;
   /** Whether to show notifications */
   showNotifications: boolean;
+  /** Stream partial captions from the native Whisper engine while capturing (local mode) */
+  streamingCaptions?: boolean;
+  /** Transcribe loopback audio only after a spoken keyword, spotted natively with a KWS2 DS-CNN model */
+  keywordSpotting?: {
+    enabled: boolean;
+    modelPath: string;
+    /** Smoothed keyword probability that counts as heard (default 0.8) */
+    threshold?: number;
+    /** How long utterances are transcribed after the keyword (default 8000) */
+    windowMs?: number;
+  };
+  /** In auto-detect mode, identify each utterance's language natively (LID1 model) before it is transcribed */
+  languageId?: {
+    enabled: boolean;
+    modelPath: string;
+    /** Probability below which the utterance's language stays unknown (default 0.6) */
+    minConfidence?: number;
+  };
+  /** How the native microphone capture opens the device on Windows */
+  microphoneStream?: {
+    /** Skip the endpoint's noise suppression, AGC and beamforming (default true; the app's own chain conditions the mic) */
+    raw?: boolean;
+    /** Default input for 'console' or 'communications' (call) use (default 'console') */
+    role?: 'console' | 'communications';
+  };
+  /**
+   * Who converts loopback audio to 16 kHz mono on Windows: the addon's own
+   * resampler ('native', default) or the Windows audio engine ('engine-converted')
+   */
+  captureConversion?: 'native' | 'engine-converted';
+  /**
+   * Render endpoints the system loopback records instead of the default one:
+   * ids or parts of names (wasapi:list-endpoints); several are mixed (Windows)
+   */
+  loopbackDevices?: string[];
+  /**
+   * Scale the chunker's pause and minimum length to the speaker's syllable
+   * rate and cut max-length chunks between syllables (default true)
+   */
+  adaptiveChunking?: boolean;
+  /**
+   * Where the PID loopback capture runs: in the main process (default) or in
+   * a utility process that hands it over through shared memory, so a capture
+   * crash does not take the app down
+   */
+  captureHost?: 'in-process' | 'utility';
+  /**
+   * Neural VAD (Silero v5 ONNX) on top of the native detector, batched across
+   * the loopback and microphone captures; needs an addon built with ONNX Runtime
+   */
+  neuralVad?: {
+    enabled: boolean;
+    modelPath?: string;
+    /** Speech probability that starts speech (default 0.5) */
+    threshold?: number;
+  };
+  /** Cut loopback chunks at speaker turn changes and tag them with a speaker cluster */
+  speakerTurns?: {
+    enabled: boolean;
+    /** SPK1 d-vector model; the built-in spectrum-shape embedding without one */
+    modelPath?: string;
+    /** Cosine distance that counts as a new speaker (default: the model's, 0.1 built in) */
+    threshold?: number;
+  };
+  /** Record whole capture sessions to disk natively, for QA and support */
+  sessionRecording?: {
+    enabled: boolean;
+    /** Where segment files go (default <userData>/recordings) */
+    directory?: string;
+    codec?: 'wav' | 'flac' | 'opus';
+    /** 'raw': the voice chain's input instead of what it delivers */
+    stream?: 'processed' | 'raw';
+    /** A new file every segmentSeconds (default 600) */
+    segmentSeconds?: number;
+  };
   /** Global push-to-talk hotkey (e.g. { ctrl: true, alt: false, shift: true, key: 'Space' }) */
   pttHotkey?: {
     ctrl: boolean;
@@ -191,10 +266,43 @@ export interface UISettings {
   captureSource?: string;
   /** Secure storage configuration for API keys */
   storageConfig?: StorageSettings;
+  /** OCR engine for watch boxes: PaddleOCR (default) or the addon's native Tesseract pool */
+  ocrEngine?: 'paddle' | 'tesseract';
   /** GPU acceleration mode for PaddleOCR (requires CUDA GPU) */
   ocrGpuMode?: 'normal' | 'fast';
+  /** Speak translations with local Piper voices into the native TTS render instead of the cloud voices */
+  localTts?: {
+    enabled: boolean;
+    /** Folder of <voice>.onnx + <voice>.onnx.json (and espeak-ng-data); default models/Piper */
+    voicesPath?: string;
+    /** Voice file name (without .onnx) per target language; otherwise the first <language>_*.onnx */
+    voices?: Record<string, string>;
+    /** Above 1 speaks slower */
+    lengthScale?: number;
+  };
+  /** Run PaddleOCR's models exported to ONNX in the addon (GPU via DirectML/Core ML) instead of the Python service */
+  paddleOnnx?: {
+    enabled: boolean;
+    /** <det>.onnx, <rec>.onnx, <rec>.txt (dictionary) and optionally cls.onnx; default PaddlePack/onnx */
+    modelDir?: string;
+    device?: 'auto' | 'cpu';
+  };
   /** Whether to pre-load Paddle OCR models on app startup for faster screen translation */
   paddleWarmupOnStartup?: boolean;
+  /** Whether to load and warm up the local Whisper model on app startup (local mode; default true) */
+  whisperWarmupOnStartup?: boolean;
+  /** Native Whisper device per model, from the first-run benchmark (WhisperBackendSelector) */
+  whisperBackend?: {
+    /** Processing time over audio time a model must reach (default 0.5) */
+    targetRtf?: number;
+    /** Try smaller installed models when the configured one's variants all miss the target (default true) */
+    autoModel?: boolean;
+    /** CPU and ggml devices the results were measured on; a change re-runs the benchmark */
+    fingerprint?: string;
+    measuredAt?: string;
+    /** model variant ('small', 'small-q5_1') -> device ('cpu', 'gpu:<n>') -> real-time factor */
+    results?: Record<string, Record<string, number>>;
+  };
   /** Whether to run Whispra in the background (minimize to tray instead of quitting) */
   runInBackground?: boolean;
   /** Bidirectional translation optimization settings */
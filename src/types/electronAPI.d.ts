@@ -17,7 +17,10 @@ interface ElectronAPI {
   setupClearAudioCapture: (callback: (data: any) => void) => void;
   setupWasapiWavCapture: (callback: (data: Buffer) => void) => void;
   setupWasapiUtteranceWav: (callback: (data: Buffer) => void) => void;
-  setupWasapiChunkWav: (callback: (data: Buffer) => void) => void;
+  setupWasapiChunkWav: (callback: (data: Buffer, traceId?: string, fingerprint?: Uint32Array, language?: string, timeMap?: Float64Array) => void) => void;
+  setupWasapiKeyword: (callback: (event: { keyword: string; score: number; windowMs: number }) => void) => void;
+  setupMicChunkWav: (callback: (data: Buffer, traceId?: string) => void) => void;
+  traceSpan: (traceId: string | undefined, name: string, startMs: number, endMs?: number) => void;
 
   // Desktop capture
   getDesktopSources: (types: Array<'screen' | 'window'>) => Promise<Array<{ id: string; name: string }>>;
@@ -27,8 +30,18 @@ interface ElectronAPI {
   startCaptureByProcess: (processName: string) => Promise<any>;
   startCaptureExcludeCurrent: () => Promise<any>;
   stopPerAppCapture: () => Promise<any>;
+  getCaptureHistory: (lastMs?: number) => Promise<{ success: boolean; history?: { data: Uint8Array; format: 'wav' | 'ogg'; fromMs: number; toMs: number; sampleRate: number } | null; error?: string }>;
+  listAudioEndpoints: () => Promise<Array<{ id: string; name: string; flow: 'render' | 'capture'; isDefault: boolean; isDefaultCommunications: boolean }>>;
+  startNativeMicCapture: (inputDevice?: string, armed?: boolean) => Promise<{ success: boolean; error?: string }>;
+  setNativeMicDelivery: (open: boolean) => Promise<{ success: boolean; delivering?: boolean; error?: string }>;
+  stopNativeMicCapture: () => Promise<{ success: boolean }>;
+  startNativeTtsRender: (options?: { device?: string; lowLatency?: boolean }) => Promise<{ success: boolean; device?: string; error?: string }>;
+  stopNativeTtsRender: () => Promise<{ success: boolean }>;
+  transcribeMediaFile: (file?: string, options?: { language?: string; translate?: boolean; concurrency?: number }) => Promise<{ success: boolean; canceled?: boolean; file?: string; transcript?: { text: string; language: string; segments: Array<{ startMs: number; endMs: number; text: string }>; pieces: number; failed: number; audioMs: number; wallMs: number; error?: string }; error?: string }>;
+  getNativeTtsRenderStats: () => Promise<{ queuedMs: number; pushedMs: number; playedMs: number; droppedMs: number; concealedMs: number; underruns: number; targetMs: number; jitterMs: number; startDelayMs: number } | null>;
   findAudioPidForProcess: (processName: string) => Promise<any>;
   enumerateAudioSessions: () => Promise<any>;
+  getSessionLevels: () => Promise<Array<{ pid: number; processName: string; peak: number; metered: boolean }>>;
 
   // Voice boost for whisper-level speech detection
   setVoiceBoostEnabled: (enabled: boolean) => Promise<{ success: boolean; enabled: boolean }>;
@@ -0,0 +1,87 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+"""
+Persistent faster-whisper worker - loads the model once and transcribes every
+chunk the app writes into its shared-memory audio ring (whispra_ring.py).
+Results go back as one JSON line per chunk on stdout:
+    {"seq": 3, "text": "...", "language": "en", "processingMs": 412.0}
+Exits when the ring is closed or stdin reaches EOF (the app went away).
+"""
+
+import argparse
+import json
+import os
+import sys
+import threading
+import time
+
+from whispra_ring import AudioRingReader
+
+
+def emit(message):
+    sys.stdout.write(json.dumps(message) + '\n')
+    sys.stdout.flush()
+
+
+def watch_parent():
+    # The app holds our stdin open for as long as it wants us
+    try:
+        while sys.stdin.read(4096):
+            pass
+    finally:
+        os._exit(0)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--mapping', required=True)
+    parser.add_argument('--doorbell', required=True)
+    parser.add_argument('--model', default='tiny')
+    parser.add_argument('--whisper-path', required=True)
+    parser.add_argument('--language', default='auto')
+    parser.add_argument('--temperature', type=float, default=0.0)
+    args = parser.parse_args()
+
+    # Same cache layout as the one-shot path in LocalWhisperService.ts
+    os.environ['HF_HOME'] = args.whisper_path
+    os.environ['HF_HUB_CACHE'] = args.whisper_path
+    os.environ['HUGGINGFACE_HUB_CACHE'] = args.whisper_path
+    if args.whisper_path not in sys.path:
+        sys.path.insert(0, args.whisper_path)
+
+    threading.Thread(target=watch_parent, daemon=True).start()
+
+    try:
+        import numpy
+        import faster_whisper
+        model = faster_whisper.WhisperModel(args.model, device='cpu', compute_type='int8', download_root=args.whisper_path)
+        ring = AudioRingReader(args.mapping, args.doorbell)
+    except Exception as e:
+        emit({'error': 'Worker start failed: %s' % e})
+        return 1
+
+    language = None if args.language == 'auto' else args.language
+    emit({'ready': True, 'sampleRate': ring.sample_rate})
+
+    for chunk in ring.chunks():
+        started = time.perf_counter()
+        try:
+            # The one copy on this side: int16 view -> float32 for the model
+            audio = numpy.frombuffer(chunk.samples, dtype=numpy.int16).astype(numpy.float32) / 32768.0
+            segments, info = model.transcribe(audio, language=language, temperature=args.temperature)
+            text = ' '.join(segment.text for segment in segments).strip()
+            emit({
+                'seq': chunk.seq,
+                'text': text,
+                'language': info.language if info else args.language,
+                'processingMs': (time.perf_counter() - started) * 1000.0,
+            })
+        except Exception as e:
+            emit({'seq': chunk.seq, 'error': 'Transcription error: %s' % e})
+
+    ring.close()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
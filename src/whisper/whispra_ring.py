@@ -0,0 +1,213 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+"""
+Reader side of the capture addon's shared-memory audio ring
+(native-audio-core/shm_audio_ring.h). A persistent worker opens the ring by the
+names openAudioRing returned and iterates pcm16 chunks straight out of the
+mapping - no temp files, no pipes for audio. Standard library only.
+
+    ring = AudioRingReader(mapping, doorbell)
+    for chunk in ring.chunks():
+        samples = chunk.samples          # memoryview of int16, valid until the next chunk
+        audio = numpy.frombuffer(samples, dtype=numpy.int16)
+
+The same ring carries image frames for the OCR worker (writeImageRing): poll()
+returns an ImageFrame for those, whose pixels view wraps as
+numpy.ndarray((height, width, channels), numpy.uint8, pixels, strides=(stride, channels, 1)).
+"""
+
+import ctypes
+import mmap
+import os
+import struct
+import sys
+
+MAGIC = b'WSAR'
+VERSION = 1
+DATA_OFFSET = 256
+RECORD_HEADER = 16
+WRITE_POS = 64
+READ_POS = 128
+DROPPED = 192
+CLOSED = 196
+KIND_PCM = 0
+KIND_PAD = 1
+KIND_GRAY8 = 2
+KIND_BGRA = 3
+IMAGE_HEADER = 16
+
+
+class AudioChunk(object):
+    __slots__ = ('seq', 'time_ms', 'samples')
+
+    def __init__(self, seq, time_ms, samples):
+        self.seq = seq
+        self.time_ms = time_ms
+        self.samples = samples
+
+
+class ImageFrame(object):
+    """One image record; pixels holds height rows of stride bytes (a multiple
+    of 16) and stays valid until done()."""
+    __slots__ = ('seq', 'time_ms', 'width', 'height', 'stride', 'channels', 'pixels')
+
+    def __init__(self, seq, time_ms, width, height, stride, channels, pixels):
+        self.seq = seq
+        self.time_ms = time_ms
+        self.width = width
+        self.height = height
+        self.stride = stride
+        self.channels = channels
+        self.pixels = pixels
+
+
+class _WindowsDoorbell(object):
+    SYNCHRONIZE = 0x00100000
+    WAIT_OBJECT_0 = 0
+    INFINITE = 0xFFFFFFFF
+
+    def __init__(self, name):
+        self._kernel32 = ctypes.WinDLL('kernel32', use_last_error=True)
+        self._kernel32.OpenEventW.restype = ctypes.c_void_p
+        self._kernel32.OpenEventW.argtypes = [ctypes.c_uint32, ctypes.c_int, ctypes.c_wchar_p]
+        self._kernel32.WaitForSingleObject.argtypes = [ctypes.c_void_p, ctypes.c_uint32]
+        self._kernel32.CloseHandle.argtypes = [ctypes.c_void_p]
+        self._handle = self._kernel32.OpenEventW(self.SYNCHRONIZE, 0, name)
+        if not self._handle:
+            raise OSError(ctypes.get_last_error(), 'OpenEvent failed for ' + name)
+
+    def wait(self, timeout_ms=None):
+        ms = self.INFINITE if timeout_ms is None else int(timeout_ms)
+        return self._kernel32.WaitForSingleObject(self._handle, ms) == self.WAIT_OBJECT_0
+
+    def close(self):
+        if self._handle:
+            self._kernel32.CloseHandle(self._handle)
+            self._handle = None
+
+
+class _PosixDoorbell(object):
+    # sem_open is variadic; opening an existing semaphore passes only the
+    # fixed arguments, which is safe to call through ctypes on arm64 too
+    def __init__(self, name):
+        self._libc = ctypes.CDLL(None, use_errno=True)
+        self._libc.sem_open.restype = ctypes.c_void_p
+        self._libc.sem_open.argtypes = [ctypes.c_char_p, ctypes.c_int]
+        self._libc.sem_wait.argtypes = [ctypes.c_void_p]
+        self._libc.sem_close.argtypes = [ctypes.c_void_p]
+        sem = self._libc.sem_open(name.encode('ascii'), 0)
+        if sem is None or sem == ctypes.c_void_p(-1).value:
+            raise OSError(ctypes.get_errno(), 'sem_open failed for ' + name)
+        self._sem = sem
+
+    def wait(self, timeout_ms=None):
+        # macOS has no sem_timedwait; the producer rings on close, so an
+        # unbounded wait always ends
+        while self._libc.sem_wait(self._sem) != 0:
+            if ctypes.get_errno() != 4:  # EINTR
+                raise OSError(ctypes.get_errno(), 'sem_wait failed')
+        return True
+
+    def close(self):
+        if self._sem:
+            self._libc.sem_close(self._sem)
+            self._sem = None
+
+
+def _open_posix_mapping(name):
+    libc = ctypes.CDLL(None, use_errno=True)
+    if not hasattr(libc, 'shm_open'):
+        libc = ctypes.CDLL('librt.so.1', use_errno=True)
+    libc.shm_open.restype = ctypes.c_int
+    libc.shm_open.argtypes = [ctypes.c_char_p, ctypes.c_int]
+    fd = libc.shm_open(name.encode('ascii'), os.O_RDWR)
+    if fd < 0:
+        raise OSError(ctypes.get_errno(), 'shm_open failed for ' + name)
+    try:
+        return mmap.mmap(fd, os.fstat(fd).st_size, mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE)
+    finally:
+        os.close(fd)
+
+
+class AudioRingReader(object):
+    """Single consumer of one ring. Not thread-safe."""
+
+    def __init__(self, mapping, doorbell):
+        if sys.platform == 'win32':
+            probe = mmap.mmap(-1, DATA_OFFSET, tagname=mapping)
+            capacity = struct.unpack_from('<I', probe, 8)[0]
+            probe.close()
+            self._map = mmap.mmap(-1, DATA_OFFSET + capacity, tagname=mapping)
+            self._bell = _WindowsDoorbell(doorbell)
+        else:
+            self._map = _open_posix_mapping(mapping)
+            self._bell = _PosixDoorbell(doorbell)
+        magic, version, capacity, rate, channels = struct.unpack_from('<4sIIII', self._map, 0)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError('not a version %d audio ring: %s' % (VERSION, mapping))
+        self.capacity = capacity
+        self.sample_rate = rate
+        self.channels = channels
+        self._view = memoryview(self._map)
+        self._read = struct.unpack_from('<Q', self._map, READ_POS)[0]
+
+    @property
+    def dropped(self):
+        return struct.unpack_from('<I', self._map, DROPPED)[0]
+
+    @property
+    def closed(self):
+        return struct.unpack_from('<I', self._map, CLOSED)[0] != 0
+
+    def _release(self, position):
+        self._read = position
+        struct.pack_into('<Q', self._map, READ_POS, position)
+
+    def poll(self):
+        """The next chunk (or ImageFrame) if one is published, else None."""
+        while True:
+            written = struct.unpack_from('<Q', self._map, WRITE_POS)[0]
+            if self._read >= written:
+                return None
+            offset = DATA_OFFSET + (self._read & (self.capacity - 1))
+            size, kind, _, seq, time_ms = struct.unpack_from('<IHHII', self._map, offset)
+            end = self._read + ((RECORD_HEADER + size + 15) & ~15)
+            if kind == KIND_PAD:
+                self._release(end)
+                continue
+            start = offset + RECORD_HEADER
+            self._pending = end
+            if kind in (KIND_GRAY8, KIND_BGRA):
+                width, height, stride, channels = struct.unpack_from('<IIII', self._map, start)
+                pixels = self._view[start + IMAGE_HEADER:start + size]
+                return ImageFrame(seq, time_ms, width, height, stride, channels, pixels)
+            samples = self._view[start:start + size].cast('h')
+            return AudioChunk(seq, time_ms, samples)
+
+    def done(self):
+        """Hands the last chunk's space back to the producer."""
+        pending = getattr(self, '_pending', None)
+        if pending is not None:
+            self._pending = None
+            self._release(pending)
+
+    def chunks(self):
+        """Yields chunks until the producer closes the ring; each chunk's
+        samples stay valid until the generator resumes."""
+        while True:
+            chunk = self.poll()
+            if chunk is not None:
+                try:
+                    yield chunk
+                finally:
+                    (chunk.pixels if isinstance(chunk, ImageFrame) else chunk.samples).release()
+                    self.done()
+                continue
+            if self.closed:
+                return
+            self._bell.wait()
+
+    def close(self):
+        self._bell.close()
+        self._view.release()
+        self._map.close()